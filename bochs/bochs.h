@@ -224,6 +224,40 @@ void print_statistics_tree(bx_param_c *node, int level = 0);
 #  endif
 #endif
 
+// Threaded SMP simulation (cpu: smp_threads=1) runs every emulated CPU in
+// its own host thread. Devices, local APICs and timers are protected by one
+// recursive simulator lock, invalidations of other CPUs' iCache are queued
+// for them and their TLB flushes are deferred to the next synchronization
+// point. See bxthread.cc for details.
+#if BX_SUPPORT_SMP
+BOCHSAPI extern bx_bool bx_smp_threads_active;
+
+#define BX_SMP_REQ_TLB_FLUSH    0x1
+#define BX_SMP_REQ_ICACHE_FLUSH 0x2
+
+void BOCHSAPI_MSVCONLY bx_smp_lock(void);
+void BOCHSAPI_MSVCONLY bx_smp_unlock(void);
+void BOCHSAPI_MSVCONLY bx_smp_unlock_all(void);
+int  BOCHSAPI_MSVCONLY bx_smp_current_cpu(void);
+void BOCHSAPI_MSVCONLY bx_smp_request(unsigned cpu, Bit32u request);
+void BOCHSAPI_MSVCONLY bx_smp_request_others(Bit32u request);
+void BOCHSAPI_MSVCONLY bx_smp_defer_smc(bx_phy_address pAddr, Bit32u mask);
+void BOCHSAPI_MSVCONLY bx_smp_defer_reset_write_stamps(void);
+void BOCHSAPI_MSVCONLY bx_smp_drain_smc(unsigned cpu);
+void BOCHSAPI_MSVCONLY bx_smp_defer_reset(unsigned type);
+bx_bool BOCHSAPI_MSVCONLY bx_smp_sync_requested(void);
+void bx_smp_run_threads(void);
+
+#  define BX_SMP_LOCK()   { if (bx_smp_threads_active) bx_smp_lock(); }
+#  define BX_SMP_UNLOCK() { if (bx_smp_threads_active) bx_smp_unlock(); }
+// serializing instructions apply the iCache invalidations of other CPUs
+#  define BX_SMP_DRAIN_SMC(cpu) { if (bx_smp_threads_active) bx_smp_drain_smc(cpu); }
+#else
+#  define BX_SMP_LOCK()
+#  define BX_SMP_UNLOCK()
+#  define BX_SMP_DRAIN_SMC(cpu)
+#endif
+
 //
 // Ways for the the external environment to report back information
 // to the debugger.
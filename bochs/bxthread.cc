@@ -22,18 +22,28 @@
 #include "bochs.h"
 #include "bxthread.h"
 
+#if !(BX_WITH_SDL || BX_WITH_SDL2) && !defined(WIN32)
+#include <sys/time.h>
+#endif
+
 // Bochs multi-threading support
 
+// The event is auto-reset: it stays set until a waiting thread consumes it,
+// so the event set before the wait is not lost. The Win32 event object
+// works like that, the other implementations keep the state in 'signalled'.
+
 void bx_create_event(bx_thread_event_t *thread_ev)
 {
 #if BX_WITH_SDL || BX_WITH_SDL2
   thread_ev->cond = SDL_CreateCond();
   thread_ev->lock = SDL_CreateMutex();
+  thread_ev->signalled = 0;
 #elif defined(WIN32)
   thread_ev->event = CreateEvent(NULL, FALSE, FALSE, "event");
 #else
   pthread_cond_init(&thread_ev->cond, NULL);
   pthread_mutex_init(&thread_ev->lock, NULL);
+  thread_ev->signalled = 0;
 #endif
 }
 
@@ -54,12 +64,14 @@ void bx_set_event(bx_thread_event_t *thread_ev)
 {
 #if BX_WITH_SDL || BX_WITH_SDL2
   SDL_LockMutex(thread_ev->lock);
+  thread_ev->signalled = 1;
   SDL_CondSignal(thread_ev->cond);
   SDL_UnlockMutex(thread_ev->lock);
 #elif defined(WIN32)
   SetEvent(thread_ev->event);
 #else
   pthread_mutex_lock(&thread_ev->lock);
+  thread_ev->signalled = 1;
   pthread_cond_signal(&thread_ev->cond);
   pthread_mutex_unlock(&thread_ev->lock);
 #endif
@@ -69,7 +81,9 @@ bx_bool bx_wait_for_event(bx_thread_event_t *thread_ev)
 {
 #if BX_WITH_SDL || BX_WITH_SDL2
   SDL_LockMutex(thread_ev->lock);
-  SDL_CondWait(thread_ev->cond, thread_ev->lock);
+  while (! thread_ev->signalled)
+    SDL_CondWait(thread_ev->cond, thread_ev->lock);
+  thread_ev->signalled = 0;
   SDL_UnlockMutex(thread_ev->lock);
   return 1;
 #elif defined(WIN32)
@@ -80,8 +94,435 @@ bx_bool bx_wait_for_event(bx_thread_event_t *thread_ev)
   }
 #else
   pthread_mutex_lock(&thread_ev->lock);
-  pthread_cond_wait(&thread_ev->cond, &thread_ev->lock);
+  while (! thread_ev->signalled)
+    pthread_cond_wait(&thread_ev->cond, &thread_ev->lock);
+  thread_ev->signalled = 0;
   pthread_mutex_unlock(&thread_ev->lock);
   return 1;
 #endif
 }
+
+// Wait until the event is set or 'usec' microseconds have passed.
+// Returns 1 if the event was set and 0 on timeout. The millisecond
+// timeouts are rounded up, a short wait must not become a busy loop.
+bx_bool bx_wait_for_event_timeout(bx_thread_event_t *thread_ev, Bit32u usec)
+{
+#if BX_WITH_SDL || BX_WITH_SDL2
+  bx_bool ret;
+  SDL_LockMutex(thread_ev->lock);
+  if (! thread_ev->signalled)
+    SDL_CondWaitTimeout(thread_ev->cond, thread_ev->lock, usec / 1000 + (usec % 1000 != 0));
+  ret = thread_ev->signalled;
+  thread_ev->signalled = 0;
+  SDL_UnlockMutex(thread_ev->lock);
+  return ret;
+#elif defined(WIN32)
+  if (WaitForSingleObject(thread_ev->event, usec / 1000 + (usec % 1000 != 0)) == WAIT_OBJECT_0) {
+    return 1;
+  } else {
+    return 0;
+  }
+#else
+  struct timeval now;
+  struct timespec deadline;
+  bx_bool ret;
+
+  gettimeofday(&now, NULL);
+  Bit64u nsec = ((Bit64u) now.tv_usec + usec) * 1000;
+  deadline.tv_sec = now.tv_sec + (time_t)(nsec / 1000000000);
+  deadline.tv_nsec = (long)(nsec % 1000000000);
+  pthread_mutex_lock(&thread_ev->lock);
+  while (! thread_ev->signalled) {
+    if (pthread_cond_timedwait(&thread_ev->cond, &thread_ev->lock, &deadline) != 0)
+      break; // timeout
+  }
+  ret = thread_ev->signalled;
+  thread_ev->signalled = 0;
+  pthread_mutex_unlock(&thread_ev->lock);
+  return ret;
+#endif
+}
+
+#if BX_SUPPORT_SMP
+
+#include "param_names.h"
+#include "cpu/cpu.h"
+
+#define LOG_THIS genlog->
+
+//
+// Threaded SMP simulation
+//
+// Every emulated CPU runs in its own host thread (CPU0 in the main thread).
+// The CPUs execute in rounds of 'thread_quantum' instructions, between the
+// rounds all CPU threads are parked and the main thread advances the emulated
+// time and applies the requests that one CPU posted for another one:
+//
+//  - devices, local APIC, timers and the physical memory slow path are
+//    accessed under one recursive simulator lock. The lock is also held
+//    across the read-modify-write memory accesses so LOCKed instructions
+//    remain atomic with respect to other CPUs.
+//  - iCache invalidations (self modifying code) of other CPUs are queued
+//    per CPU and the CPU is asked to stop its trace. The CPU applies its
+//    queue before the next trace lookup and on serializing instructions,
+//    as required by the SDM for cross-modifying code, the rest is applied
+//    at the end of the round.
+//  - TLB flushes of other CPUs are deferred until the end of the round.
+//  - pending events signalled to a running CPU by other threads are
+//    re-checked at the end of every round.
+//
+
+bx_bool bx_smp_threads_active = 0;
+
+static BX_MUTEX(smp_big_lock);
+static BX_THREAD_LOCAL unsigned smp_lock_depth = 0;
+static BX_THREAD_LOCAL int smp_cpu_id = -1;
+
+void bx_smp_lock(void)
+{
+  if (smp_lock_depth++ == 0) {
+    BX_LOCK(smp_big_lock);
+  }
+}
+
+void bx_smp_unlock(void)
+{
+  if (smp_lock_depth > 0 && --smp_lock_depth == 0) {
+    BX_UNLOCK(smp_big_lock);
+  }
+}
+
+// release the simulator lock regardless of the nesting level, used when
+// leaving the CPU loop by longjmp or at the end of the round
+void bx_smp_unlock_all(void)
+{
+  if (smp_lock_depth > 0) {
+    smp_lock_depth = 0;
+    BX_UNLOCK(smp_big_lock);
+  }
+}
+
+// returns the CPU served by the calling host thread, -1 for the main thread
+int bx_smp_current_cpu(void)
+{
+  return smp_cpu_id;
+}
+
+#define BX_SMP_SMC_QUEUE_SIZE 64
+
+struct bx_smp_smc_entry_t {
+  bx_phy_address pAddr;
+  Bit32u mask;
+};
+
+struct bx_smp_thread_t {
+  BX_THREAD_VAR(thread);
+  volatile Bit32u round;  // last round the CPU was asked to run
+  Bit32u requests;
+  Bit32u executed;
+  // iCache invalidations posted by other CPUs, protected by simulator lock
+  bx_smp_smc_entry_t smc_queue[BX_SMP_SMC_QUEUE_SIZE];
+  Bit32u smc_count;
+};
+
+static bx_smp_thread_t *smp_threads = NULL;
+static bx_bool smp_reset_write_stamps = 0;
+static int smp_pending_reset = -1;
+static volatile Bit32u smp_sync_request = 0;
+
+static Bit32u smp_round = 0;
+static volatile Bit32u smp_done = 0;
+static volatile Bit32u smp_exit = 0;
+static Bit32u smp_thread_quantum = 0;
+
+// post request to a CPU, it will be served at the end of the round
+void bx_smp_request(unsigned cpu, Bit32u request)
+{
+  BX_ATOMIC_OR32(&smp_threads[cpu].requests, request);
+}
+
+// post request to all the CPUs except one served by the calling thread
+void bx_smp_request_others(Bit32u request)
+{
+  for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
+    if ((int) i != smp_cpu_id)
+      bx_smp_request(i, request);
+  }
+}
+
+// queue the iCache invalidation for the CPUs except one served by the calling
+// thread and ask them to stop their traces, must be called with simulator
+// lock held
+void bx_smp_defer_smc(bx_phy_address pAddr, Bit32u mask)
+{
+  for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
+    if ((int) i == smp_cpu_id) continue;
+
+    // the trace cache shared with the calling CPU is already up to date
+    if (BX_CPU(i)->iCache != BX_CPU(smp_cpu_id)->iCache) {
+      bx_smp_thread_t *thread = &smp_threads[i];
+      if (thread->smc_count < BX_SMP_SMC_QUEUE_SIZE) {
+        thread->smc_queue[thread->smc_count].pAddr = pAddr;
+        thread->smc_queue[thread->smc_count].mask = mask;
+        BX_ATOMIC_STORE32(&thread->smc_count, thread->smc_count + 1);
+      }
+      else {
+        // too many modified pages, simply flush everything
+        bx_smp_request(i, BX_SMP_REQ_ICACHE_FLUSH);
+      }
+    }
+
+    BX_ATOMIC_OR32(&BX_CPU(i)->async_event, BX_ASYNC_EVENT_STOP_TRACE);
+  }
+}
+
+// the write stamps could be reset only when all the CPUs have flushed their
+// iCache, must be called with simulator lock held
+void bx_smp_defer_reset_write_stamps(void)
+{
+  smp_reset_write_stamps = 1;
+}
+
+// must be called with simulator lock held or when all CPU threads are parked
+static void bx_smp_apply_smc(unsigned cpu)
+{
+  bx_smp_thread_t *thread = &smp_threads[cpu];
+
+  if (BX_ATOMIC_AND32(&thread->requests, ~BX_SMP_REQ_ICACHE_FLUSH) & BX_SMP_REQ_ICACHE_FLUSH) {
+    BX_CPU(cpu)->iCache->flushICacheEntries();
+  }
+  else {
+    for (unsigned n=0; n<thread->smc_count; n++)
+      BX_CPU(cpu)->iCache->handleSMC(thread->smc_queue[n].pAddr, thread->smc_queue[n].mask);
+  }
+
+  BX_ATOMIC_STORE32(&thread->smc_count, 0);
+}
+
+// apply the iCache invalidations posted for the CPU by the other CPUs, called
+// by the CPU thread before the next trace lookup and on serializing
+// instructions
+void bx_smp_drain_smc(unsigned cpu)
+{
+  bx_smp_thread_t *thread = &smp_threads[cpu];
+
+  if (! BX_ATOMIC_LOAD32(&thread->smc_count) &&
+      ! (BX_ATOMIC_LOAD32(&thread->requests) & BX_SMP_REQ_ICACHE_FLUSH)) return;
+
+  bx_smp_lock();
+  bx_smp_apply_smc(cpu);
+  bx_smp_unlock();
+
+  // the rest of the current trace might be stale
+  BX_CPU(cpu)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
+}
+
+// must be called with simulator lock held
+void bx_smp_defer_reset(unsigned type)
+{
+  smp_pending_reset = type;
+  BX_ATOMIC_STORE32(&smp_sync_request, 1);
+}
+
+// check if the CPU threads should finish the round as soon as possible
+bx_bool bx_smp_sync_requested(void)
+{
+  return BX_ATOMIC_LOAD32(&smp_sync_request) || bx_pc_system.kill_bochs_request;
+}
+
+// called by the main thread when all the CPU threads are parked
+static void bx_smp_sync_point(void)
+{
+  for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
+    BX_CPU_C *cpu = BX_CPU(i);
+    Bit32u requests = smp_threads[i].requests;
+    // iCache flush request is served together with the queued invalidations
+    smp_threads[i].requests &= BX_SMP_REQ_ICACHE_FLUSH;
+
+    if (requests & BX_SMP_REQ_TLB_FLUSH)
+      cpu->TLB_flush();
+
+    // invalidations not drained by the CPU itself during the round
+    bx_smp_apply_smc(i);
+
+    // event could be signalled by another thread while the CPU was updating
+    // its own async_event field, make sure it is not lost
+    if (cpu->unmasked_events_pending())
+      cpu->async_event = 1;
+  }
+
+  if (smp_reset_write_stamps) {
+    pageWriteStampTable.resetWriteStamps();
+    smp_reset_write_stamps = 0;
+  }
+
+  if (smp_pending_reset >= 0) {
+    unsigned type = (unsigned) smp_pending_reset;
+    smp_pending_reset = -1;
+    bx_pc_system.Reset(type);
+  }
+
+  smp_sync_request = 0;
+}
+
+static void bx_smp_run_quantum(unsigned id)
+{
+  BX_CPU_C *cpu = BX_CPU(id);
+  Bit64u start = cpu->get_icount();
+
+  if (setjmp(BX_CPU_C::jmp_buf_env)) {
+    // can get here only from exception function or VMEXIT
+    cpu->icount++;
+    bx_smp_unlock_all();
+  }
+
+  while ((cpu->get_icount() - start) < smp_thread_quantum) {
+    if (bx_smp_sync_requested()) break;
+    bx_smp_drain_smc(id);
+    Bit64u icount = cpu->get_icount();
+    cpu->cpu_run_trace();
+    // no progress means the CPU is halted, nothing to do until next round
+    if (cpu->get_icount() == icount) break;
+  }
+
+  // read-modify-write sequence might leave the simulator lock taken
+  bx_smp_unlock_all();
+
+  smp_threads[id].executed = (Bit32u)(cpu->get_icount() - start);
+  cpu->icount_last_sync = cpu->get_icount();
+}
+
+// halted CPU without pending events has nothing to do in this round
+static bx_bool bx_smp_cpu_sleeping(unsigned id)
+{
+  BX_CPU_C *cpu = BX_CPU(id);
+
+  if (cpu->activity_state != BX_CPU_C::BX_ACTIVITY_STATE_HLT &&
+      cpu->activity_state != BX_CPU_C::BX_ACTIVITY_STATE_WAIT_FOR_SIPI) return 0;
+
+  return ! cpu->unmasked_events_pending();
+}
+
+// short busy wait first, the rounds are usually too short to give up the
+// host CPU immediately
+static BX_CPP_INLINE void bx_smp_pause(unsigned spin)
+{
+  if (spin < 64)
+    BX_CPU_RELAX();
+  else
+    BX_THREAD_YIELD();
+}
+
+BX_THREAD_FUNC(bx_smp_cpu_thread, indata)
+{
+  unsigned id = (unsigned)(bx_ptr_equiv_t) indata;
+  Bit32u round = 0;
+
+  smp_cpu_id = id;
+
+  while (1) {
+    // wait for the main thread to start the next round on this CPU
+    for (unsigned spin = 0; BX_ATOMIC_LOAD32(&smp_threads[id].round) == round; spin++)
+      bx_smp_pause(spin);
+    round = BX_ATOMIC_LOAD32(&smp_threads[id].round);
+
+    if (BX_ATOMIC_LOAD32(&smp_exit)) break;
+
+    bx_smp_run_quantum(id);
+
+    BX_ATOMIC_INC32(&smp_done);
+  }
+
+  BX_THREAD_EXIT;
+}
+
+// The main thread simulates CPU0 itself and starts the round only for the
+// application processors which are not sleeping.
+void bx_smp_run_threads(void)
+{
+  unsigned n;
+
+  smp_thread_quantum = SIM->get_param_num(BXPN_SMP_THREAD_QUANTUM)->get();
+
+  BX_INFO(("threaded SMP simulation: %d host threads, quantum=%d",
+      BX_SMP_PROCESSORS, smp_thread_quantum));
+
+  BX_INIT_MUTEX(smp_big_lock);
+  smp_threads = new bx_smp_thread_t[BX_SMP_PROCESSORS];
+  for (n=0; n<BX_SMP_PROCESSORS; n++) {
+    smp_threads[n].round = 0;
+    smp_threads[n].requests = 0;
+    smp_threads[n].executed = 0;
+    smp_threads[n].smc_count = 0;
+  }
+
+  // device models may run in the main thread only while CPUs are parked
+  bx_smp_threads_active = 1;
+
+  for (n=1; n<BX_SMP_PROCESSORS; n++) {
+    BX_THREAD_CREATE(bx_smp_cpu_thread, (void *)(bx_ptr_equiv_t) n, smp_threads[n].thread);
+  }
+
+  while (1) {
+    Bit32u running = 0;
+
+    smp_round++;
+    BX_ATOMIC_STORE32(&smp_done, 0);
+    for (n=1; n<BX_SMP_PROCESSORS; n++) {
+      if (bx_smp_cpu_sleeping(n)) {
+        smp_threads[n].executed = 0;
+      }
+      else {
+        running++;
+        BX_ATOMIC_STORE32(&smp_threads[n].round, smp_round);
+      }
+    }
+
+    smp_threads[0].executed = 0;
+    if (! bx_smp_cpu_sleeping(0)) {
+      smp_cpu_id = 0;
+      bx_smp_run_quantum(0);
+      smp_cpu_id = -1;
+    }
+
+    for (unsigned spin = 0; BX_ATOMIC_LOAD32(&smp_done) < running; spin++)
+      bx_smp_pause(spin);
+
+    bx_smp_sync_point();
+
+    if (bx_pc_system.kill_bochs_request)
+      break;
+
+    bx_bool all_halted = 1;
+    for (n=0; n<BX_SMP_PROCESSORS; n++) {
+      if (smp_threads[n].executed) {
+        all_halted = 0;
+        break;
+      }
+    }
+
+    // when all CPUs are halted skip directly to the next timer event
+    if (all_halted)
+      BX_TICKN(bx_pc_system.getNumCpuTicksLeftNextEvent());
+    else
+      BX_TICKN(smp_thread_quantum);
+  }
+
+  BX_ATOMIC_STORE32(&smp_exit, 1);
+  smp_round++;
+  for (n=1; n<BX_SMP_PROCESSORS; n++) {
+    BX_ATOMIC_STORE32(&smp_threads[n].round, smp_round);
+  }
+
+  for (n=1; n<BX_SMP_PROCESSORS; n++) {
+    BX_THREAD_JOIN(smp_threads[n].thread);
+  }
+
+  bx_smp_threads_active = 0;
+
+  delete [] smp_threads;
+  smp_threads = NULL;
+  BX_FINI_MUTEX(smp_big_lock);
+}
+
+#endif
@@ -46,6 +46,8 @@
 #define BX_INIT_MUTEX(mutex) mutex = SDL_CreateMutex()
 #define BX_FINI_MUTEX(mutex) SDL_DestroyMutex(mutex)
 #define BX_MSLEEP(val) SDL_Delay(val)
+#define BX_THREAD_JOIN(var) SDL_WaitThread(var, NULL)
+#define BX_THREAD_YIELD() SDL_Delay(0)
 
 #elif defined(WIN32)
 
@@ -60,10 +62,13 @@
 #define BX_INIT_MUTEX(mutex) InitializeCriticalSection(&(mutex))
 #define BX_FINI_MUTEX(mutex) DeleteCriticalSection(&(mutex))
 #define BX_MSLEEP(val) Sleep(val)
+#define BX_THREAD_JOIN(var) do { WaitForSingleObject(var, INFINITE); CloseHandle(var); } while (0)
+#define BX_THREAD_YIELD() SwitchToThread()
 
 #else
 
 #include <pthread.h>
+#include <sched.h>
 
 #define BX_THREAD_VAR(name) pthread_t (name)
 #define BX_THREAD_FUNC(name,arg) void name(void* arg)
@@ -77,6 +82,8 @@
 #define BX_INIT_MUTEX(mutex) pthread_mutex_init(&(mutex),NULL)
 #define BX_FINI_MUTEX(mutex) pthread_mutex_destroy(&(mutex))
 #define BX_MSLEEP(val) usleep(val*1000)
+#define BX_THREAD_JOIN(var) pthread_join(var, NULL)
+#define BX_THREAD_YIELD() sched_yield()
 
 #endif
 
@@ -85,11 +92,13 @@ typedef struct
 #if BX_WITH_SDL || BX_WITH_SDL2
   SDL_cond *cond;
   SDL_mutex *lock;  
+  bx_bool signalled;
 #elif defined(WIN32)
   HANDLE event;
 #else
   pthread_cond_t cond;
   pthread_mutex_t lock;
+  bx_bool signalled;
 #endif
 } bx_thread_event_t;
 
@@ -97,5 +106,6 @@ void BOCHSAPI_MSVCONLY bx_create_event(bx_thread_event_t *thread_ev);
 void BOCHSAPI_MSVCONLY bx_destroy_event(bx_thread_event_t *thread_ev);
 void BOCHSAPI_MSVCONLY bx_set_event(bx_thread_event_t *thread_ev);
 bx_bool BOCHSAPI_MSVCONLY bx_wait_for_event(bx_thread_event_t *thread_ev);
+bx_bool BOCHSAPI_MSVCONLY bx_wait_for_event_timeout(bx_thread_event_t *thread_ev, Bit32u usec);
 
 #endif
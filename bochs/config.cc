@@ -331,6 +331,11 @@ void bx_init_options()
     "Path to data for restore",
     "",
     BX_PATHNAME_LEN);
+  new bx_param_bool_c(menu,
+      "restore_cow",
+      "Map restored RAM copy-on-write",
+      "Map the saved RAM image copy-on-write instead of reading it",
+      0);
 
   // benchmarking mode, set by command line arg
   new bx_param_num_c(menu,
@@ -345,6 +350,19 @@ void bx_init_options()
       "dumpstats mode",
       "dump statistics period",
       0, BX_MAX_BIT32U, 0);
+
+  // periodic checkpoints, set by command line arg
+  new bx_param_num_c(menu,
+      "checkpoint",
+      "checkpoint period",
+      "save the Bochs state periodically",
+      0, BX_MAX_BIT32U, 0);
+  new bx_param_string_c(menu,
+    "checkpoint_path",
+    "Path to checkpoints",
+    "Path to the folders of periodic checkpoints",
+    "",
+    BX_PATHNAME_LEN);
   // unlock disk images
   new bx_param_bool_c(menu,
       "unlock_images",
@@ -385,10 +403,18 @@ void bx_init_options()
   };
 #undef bx_define_cpudb
 
+#if BX_SUPPORT_FIXED_CPU_MODEL
+  // the binary is specialized for the single CPU model
+  new bx_param_enum_c(cpu_param,
+      "model", "CPU configuration",
+      "Choose pre-defined CPU configuration",
+      cpu_names, BX_FIXED_CPU_MODEL, 0);
+#else
   new bx_param_enum_c(cpu_param,
       "model", "CPU configuration",
       "Choose pre-defined CPU configuration",
       cpu_names, 0, 0);
+#endif
 
   // cpu options
   bx_param_num_c *nprocessors = new bx_param_num_c(cpu_param,
@@ -423,6 +449,19 @@ void bx_init_options()
       "Maximum amount of instructions allowed to execute before returning control to another CPU.",
       BX_SMP_QUANTUM_MIN, BX_SMP_QUANTUM_MAX,
       16);
+  new bx_param_bool_c(cpu_param,
+      "smp_threads", "Run each CPU in its own host thread",
+      "Simulate every CPU in a separate host thread, the CPUs synchronize after 'thread_quantum' instructions.",
+      0);
+  new bx_param_num_c(cpu_param,
+      "thread_quantum", "Instructions between synchronizations of CPU threads",
+      "Amount of instructions each CPU thread executes before synchronizing with other CPUs and devices.",
+      1, BX_MAX_BIT32U,
+      2000);
+  new bx_param_bool_c(cpu_param,
+      "shared_trace_cache", "Share decoded traces between CPUs",
+      "All the CPUs decode into a single trace cache (ignored with 'smp_threads' enabled).",
+      0);
 #endif
   new bx_param_bool_c(cpu_param,
       "reset_on_triple_fault", "Enable CPU reset on triple fault",
@@ -451,6 +490,11 @@ void bx_init_options()
       "Set path to the configurable MSR definition file",
       "", BX_PATHNAME_LEN);
 #endif
+  new bx_param_filename_c(cpu_param,
+      "trace_cache",
+      "Decoded trace cache file",
+      "Set path to the file where decoded traces are saved at exit and loaded at start-up",
+      "", BX_PATHNAME_LEN);
 
   cpu_param->set_options(menu->SHOW_PARENT);
 
@@ -699,6 +743,11 @@ void bx_init_options()
       1, 2048,
       BX_DEFAULT_MEM_MEGS);
   host_ramsize->set_ask_format("Enter host memory size (MB): [%d] ");
+  new bx_param_bool_c(ram,
+      "hugepages",
+      "Use host huge pages for guest RAM",
+      "Advise the host to back the guest RAM with transparent huge pages",
+      0);
   ram->set_options(ram->SERIES_ASK);
 
   path = new bx_param_filename_c(rom,
@@ -2672,6 +2721,8 @@ static int parse_line_formatted(const char *context, int num_params, char *param
         SIM->get_param_num(BXPN_HOST_MEM_SIZE)->set(atol(&params[i][5]));
       } else if (!strncmp(params[i], "guest=", 6)) {
         SIM->get_param_num(BXPN_MEM_SIZE)->set(atol(&params[i][6]));
+      } else if (!strncmp(params[i], "hugepages=", 10)) {
+        SIM->get_param_bool(BXPN_MEM_HUGEPAGES)->set(atol(&params[i][10]));
       } else {
         PARSE_ERR(("%s: memory directive malformed.", context));
       }
@@ -3362,8 +3413,8 @@ int bx_write_configuration(const char *rc, int overwrite)
     fprintf(fp, ", options=\"%s\"\n", sparam->getptr());
   else
     fprintf(fp, "\n");
-  fprintf(fp, "memory: host=%d, guest=%d\n", SIM->get_param_num(BXPN_HOST_MEM_SIZE)->get(),
-    SIM->get_param_num(BXPN_MEM_SIZE)->get());
+  fprintf(fp, "memory: host=%d, guest=%d, hugepages=%d\n", SIM->get_param_num(BXPN_HOST_MEM_SIZE)->get(),
+    SIM->get_param_num(BXPN_MEM_SIZE)->get(), SIM->get_param_bool(BXPN_MEM_HUGEPAGES)->get());
 
   bx_write_param_list(fp, (bx_list_c*) SIM->get_param(BXPN_ROMIMAGE), "romimage", 0);
   bx_write_param_list(fp, (bx_list_c*) SIM->get_param(BXPN_VGA_ROMIMAGE), "vgaromimage", 0);
@@ -3424,10 +3475,13 @@ int bx_write_configuration(const char *rc, int overwrite)
   }
   fprintf(fp, "\n");
 #if BX_SUPPORT_SMP
-  fprintf(fp, "cpu: count=%u:%u:%u, ips=%u, quantum=%d, ",
+  fprintf(fp, "cpu: count=%u:%u:%u, ips=%u, quantum=%d, smp_threads=%d, thread_quantum=%u, shared_trace_cache=%d, ",
     SIM->get_param_num(BXPN_CPU_NPROCESSORS)->get(), SIM->get_param_num(BXPN_CPU_NCORES)->get(),
     SIM->get_param_num(BXPN_CPU_NTHREADS)->get(), SIM->get_param_num(BXPN_IPS)->get(),
-    SIM->get_param_num(BXPN_SMP_QUANTUM)->get());
+    SIM->get_param_num(BXPN_SMP_QUANTUM)->get(),
+    SIM->get_param_bool(BXPN_SMP_THREADS)->get(),
+    SIM->get_param_num(BXPN_SMP_THREAD_QUANTUM)->get(),
+    SIM->get_param_bool(BXPN_CPU_SHARED_TRACE_CACHE)->get());
 #else
   fprintf(fp, "cpu: count=1, ips=%u, ", SIM->get_param_num(BXPN_IPS)->get());
 #endif
@@ -3446,6 +3500,9 @@ int bx_write_configuration(const char *rc, int overwrite)
   if (!sparam->isempty())
     fprintf(fp, ", msrs=\"%s\"", sparam->getptr());
 #endif
+  sparam = SIM->get_param_string(BXPN_CPU_TRACE_CACHE);
+  if (!sparam->isempty())
+    fprintf(fp, ", trace_cache=\"%s\"", sparam->getptr());
   fprintf(fp, "\n");
 
 #if BX_CPU_LEVEL >= 4
@@ -24,32 +24,105 @@
 #ifndef BX_MEMACCESS_H
 #define BX_MEMACCESS_H
 
+// Inlined DTLB hit path of the byte/word/dword/qword virtual accesses.
+// The segment checks are resolved by agen_*() using the cached segment
+// state (flat segments and 64-bit mode need no check at all), so a TLB
+// hit costs a single compare before the host pointer dereference. TLB
+// misses and all the special cases take the out-of-line *_linear_*() path,
+// which checks the TLB with the same templates for its direct callers.
+
+// access.h is included by every user of cpu.h, the CPU register shortcuts
+// like BX_CPU_ID are not available here
+#if BX_SUPPORT_SMP
+#define BX_ACCESS_CPU_ID (BX_CPU_THIS_PTR bx_cpuid)
+#else
+#define BX_ACCESS_CPU_ID (0)
+#endif
+
+BX_CPP_INLINE Bit8u  ReadHostFromLittleEndian(Bit8u  *hostPtr) { return *hostPtr; }
+BX_CPP_INLINE Bit16u ReadHostFromLittleEndian(Bit16u *hostPtr) { return ReadHostWordFromLittleEndian(hostPtr); }
+BX_CPP_INLINE Bit32u ReadHostFromLittleEndian(Bit32u *hostPtr) { return ReadHostDWordFromLittleEndian(hostPtr); }
+BX_CPP_INLINE Bit64u ReadHostFromLittleEndian(Bit64u *hostPtr) { return ReadHostQWordFromLittleEndian(hostPtr); }
+
+BX_CPP_INLINE void WriteHostToLittleEndian(Bit8u  *hostPtr, Bit8u  data) { *hostPtr = data; }
+BX_CPP_INLINE void WriteHostToLittleEndian(Bit16u *hostPtr, Bit16u data) { WriteHostWordToLittleEndian(hostPtr, data); }
+BX_CPP_INLINE void WriteHostToLittleEndian(Bit32u *hostPtr, Bit32u data) { WriteHostDWordToLittleEndian(hostPtr, data); }
+BX_CPP_INLINE void WriteHostToLittleEndian(Bit64u *hostPtr, Bit64u data) { WriteHostQWordToLittleEndian(hostPtr, data); }
+
+template <typename T>
+  BX_CPP_INLINE bx_bool
+BX_CPU_C::read_linear_tlb_hit(bx_address laddr, T *data)
+{
+  const unsigned len = sizeof(T);
+  bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, len - 1);
+#if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
+  bx_address lpf = AlignedAccessLPFOf(laddr, ((len - 1) & BX_CPU_THIS_PTR alignment_check_mask));
+#else
+  bx_address lpf = LPFOf(laddr);
+#endif
+  if (tlbEntry->lpf == lpf && isReadOK(tlbEntry, BX_CPU_THIS_PTR user_pl)) {
+    Bit32u pageOffset = PAGE_OFFSET(laddr);
+    *data = ReadHostFromLittleEndian((T*) (tlbEntry->hostPageAddr | pageOffset));
+    BX_NOTIFY_CPU_LIN_MEMORY_ACCESS(BX_ACCESS_CPU_ID, laddr, (tlbEntry->ppf | pageOffset), len, tlbEntry->get_memtype(), BX_READ, (Bit8u*) data);
+    return 1;
+  }
+
+  return 0;
+}
+
+template <typename T>
+  BX_CPP_INLINE bx_bool
+BX_CPU_C::write_linear_tlb_hit(bx_address laddr, T data)
+{
+  const unsigned len = sizeof(T);
+  bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, len - 1);
+#if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
+  bx_address lpf = AlignedAccessLPFOf(laddr, ((len - 1) & BX_CPU_THIS_PTR alignment_check_mask));
+#else
+  bx_address lpf = LPFOf(laddr);
+#endif
+  if (tlbEntry->lpf == lpf && isWriteOK(tlbEntry, BX_CPU_THIS_PTR user_pl)) {
+    Bit32u pageOffset = PAGE_OFFSET(laddr);
+    bx_phy_address pAddr = tlbEntry->ppf | pageOffset;
+    BX_NOTIFY_CPU_LIN_MEMORY_ACCESS(BX_ACCESS_CPU_ID, laddr, pAddr, len, tlbEntry->get_memtype(), BX_WRITE, (Bit8u*) &data);
+    pageWriteStampTable.decWriteStamp(pAddr, len);
+    WriteHostToLittleEndian((T*) (tlbEntry->hostPageAddr | pageOffset), data);
+    return 1;
+  }
+
+  return 0;
+}
+
   BX_CPP_INLINE void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_virtual_byte_32(unsigned s, Bit32u offset, Bit8u data)
 {
   Bit32u laddr = agen_write32(s, offset, 1);
-  write_linear_byte(s, laddr, data);
+  if (! write_linear_tlb_hit(laddr, data))
+    write_linear_byte(s, laddr, data);
 }
 
   BX_CPP_INLINE void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_virtual_word_32(unsigned s, Bit32u offset, Bit16u data)
 {
   Bit32u laddr = agen_write32(s, offset, 2);
-  write_linear_word(s, laddr, data);
+  if (! write_linear_tlb_hit(laddr, data))
+    write_linear_word(s, laddr, data);
 }
 
   BX_CPP_INLINE void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_virtual_dword_32(unsigned s, Bit32u offset, Bit32u data)
 {
   Bit32u laddr = agen_write32(s, offset, 4);
-  write_linear_dword(s, laddr, data);
+  if (! write_linear_tlb_hit(laddr, data))
+    write_linear_dword(s, laddr, data);
 }
 
   BX_CPP_INLINE void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_virtual_qword_32(unsigned s, Bit32u offset, Bit64u data)
 {
   Bit32u laddr = agen_write32(s, offset, 8);
-  write_linear_qword(s, laddr, data);
+  if (! write_linear_tlb_hit(laddr, data))
+    write_linear_qword(s, laddr, data);
 }
 
 #if BX_CPU_LEVEL >= 6
@@ -109,6 +182,9 @@ BX_CPU_C::tickle_read_virtual_32(unsigned s, Bit32u offset)
 BX_CPU_C::read_virtual_byte_32(unsigned s, Bit32u offset)
 {
   Bit32u laddr = agen_read32(s, offset, 1);
+  Bit8u data;
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
   return read_linear_byte(s, laddr);
 }
 
@@ -116,6 +192,9 @@ BX_CPU_C::read_virtual_byte_32(unsigned s, Bit32u offset)
 BX_CPU_C::read_virtual_word_32(unsigned s, Bit32u offset)
 {
   Bit32u laddr = agen_read32(s, offset, 2);
+  Bit16u data;
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
   return read_linear_word(s, laddr);
 }
 
@@ -123,6 +202,9 @@ BX_CPU_C::read_virtual_word_32(unsigned s, Bit32u offset)
 BX_CPU_C::read_virtual_dword_32(unsigned s, Bit32u offset)
 {
   Bit32u laddr = agen_read32(s, offset, 4);
+  Bit32u data;
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
   return read_linear_dword(s, laddr);
 }
 
@@ -130,6 +212,9 @@ BX_CPU_C::read_virtual_dword_32(unsigned s, Bit32u offset)
 BX_CPU_C::read_virtual_qword_32(unsigned s, Bit32u offset)
 {
   Bit32u laddr = agen_read32(s, offset, 8);
+  Bit64u data;
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
   return read_linear_qword(s, laddr);
 }
 
@@ -183,28 +268,32 @@ BX_CPU_C::read_virtual_zmmword_aligned_32(unsigned s, Bit32u offset, BxPackedZmm
 BX_CPU_C::write_virtual_byte(unsigned s, bx_address offset, Bit8u data)
 {
   bx_address laddr = agen_write(s, offset, 1);
-  write_linear_byte(s, laddr, data);
+  if (! write_linear_tlb_hit(laddr, data))
+    write_linear_byte(s, laddr, data);
 }
 
   BX_CPP_INLINE void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_virtual_word(unsigned s, bx_address offset, Bit16u data)
 {
   bx_address laddr = agen_write(s, offset, 2);
-  write_linear_word(s, laddr, data);
+  if (! write_linear_tlb_hit(laddr, data))
+    write_linear_word(s, laddr, data);
 }
 
   BX_CPP_INLINE void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_virtual_dword(unsigned s, bx_address offset, Bit32u data)
 {
   bx_address laddr = agen_write(s, offset, 4);
-  write_linear_dword(s, laddr, data);
+  if (! write_linear_tlb_hit(laddr, data))
+    write_linear_dword(s, laddr, data);
 }
 
   BX_CPP_INLINE void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_virtual_qword(unsigned s, bx_address offset, Bit64u data)
 {
   bx_address laddr = agen_write(s, offset, 8);
-  write_linear_qword(s, laddr, data);
+  if (! write_linear_tlb_hit(laddr, data))
+    write_linear_qword(s, laddr, data);
 }
 
 #if BX_CPU_LEVEL >= 6
@@ -264,6 +353,9 @@ BX_CPU_C::tickle_read_virtual(unsigned s, bx_address offset)
 BX_CPU_C::read_virtual_byte(unsigned s, bx_address offset)
 {
   bx_address laddr = agen_read(s, offset, 1);
+  Bit8u data;
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
   return read_linear_byte(s, laddr);
 }
 
@@ -271,6 +363,9 @@ BX_CPU_C::read_virtual_byte(unsigned s, bx_address offset)
 BX_CPU_C::read_virtual_word(unsigned s, bx_address offset)
 {
   bx_address laddr = agen_read(s, offset, 2);
+  Bit16u data;
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
   return read_linear_word(s, laddr);
 }
 
@@ -278,6 +373,9 @@ BX_CPU_C::read_virtual_word(unsigned s, bx_address offset)
 BX_CPU_C::read_virtual_dword(unsigned s, bx_address offset)
 {
   bx_address laddr = agen_read(s, offset, 4);
+  Bit32u data;
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
   return read_linear_dword(s, laddr);
 }
 
@@ -285,6 +383,9 @@ BX_CPU_C::read_virtual_dword(unsigned s, bx_address offset)
 BX_CPU_C::read_virtual_qword(unsigned s, bx_address offset)
 {
   bx_address laddr = agen_read(s, offset, 8);
+  Bit64u data;
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
   return read_linear_qword(s, laddr);
 }
 
@@ -29,21 +29,8 @@
   void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_linear_byte(unsigned s, bx_address laddr, Bit8u data)
 {
-  bx_address lpf = LPFOf(laddr);
-  bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 0);
-  if (tlbEntry->lpf == lpf) {
-    // See if the TLB entry privilege level allows us write access from this CPL
-    if (isWriteOK(tlbEntry, USER_PL)) {
-      bx_hostpageaddr_t hostPageAddr = tlbEntry->hostPageAddr;
-      Bit32u pageOffset = PAGE_OFFSET(laddr);
-      bx_phy_address pAddr = tlbEntry->ppf | pageOffset;
-      BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 1, tlbEntry->get_memtype(), BX_WRITE, (Bit8u*) &data);
-      Bit8u *hostAddr = (Bit8u*) (hostPageAddr | pageOffset);
-      pageWriteStampTable.decWriteStamp(pAddr, 1);
-      *hostAddr = data;
-      return;
-    }
-  }
+  if (write_linear_tlb_hit(laddr, data))
+    return;
 
   if (access_write_linear(laddr, 1, CPL, BX_WRITE, 0x0, (void *) &data) < 0)
     exception(int_number(s), 0);
@@ -52,25 +39,8 @@ BX_CPU_C::write_linear_byte(unsigned s, bx_address laddr, Bit8u data)
   void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_linear_word(unsigned s, bx_address laddr, Bit16u data)
 {
-  bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 1);
-#if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
-  bx_address lpf = AlignedAccessLPFOf(laddr, (1 & BX_CPU_THIS_PTR alignment_check_mask));
-#else
-  bx_address lpf = LPFOf(laddr);
-#endif    
-  if (tlbEntry->lpf == lpf) {
-    // See if the TLB entry privilege level allows us write access from this CPL
-    if (isWriteOK(tlbEntry, USER_PL)) {
-      bx_hostpageaddr_t hostPageAddr = tlbEntry->hostPageAddr;
-      Bit32u pageOffset = PAGE_OFFSET(laddr);
-      bx_phy_address pAddr = tlbEntry->ppf | pageOffset;
-      BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 2, tlbEntry->get_memtype(), BX_WRITE, (Bit8u*) &data);
-      Bit16u *hostAddr = (Bit16u*) (hostPageAddr | pageOffset);
-      pageWriteStampTable.decWriteStamp(pAddr, 2);
-      WriteHostWordToLittleEndian(hostAddr, data);
-      return;
-    }
-  }
+  if (write_linear_tlb_hit(laddr, data))
+    return;
 
   if (access_write_linear(laddr, 2, CPL, BX_WRITE, 0x1, (void *) &data) < 0)
     exception(int_number(s), 0);
@@ -79,25 +49,8 @@ BX_CPU_C::write_linear_word(unsigned s, bx_address laddr, Bit16u data)
   void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_linear_dword(unsigned s, bx_address laddr, Bit32u data)
 {
-  bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 3);
-#if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
-  bx_address lpf = AlignedAccessLPFOf(laddr, (3 & BX_CPU_THIS_PTR alignment_check_mask));
-#else
-  bx_address lpf = LPFOf(laddr);
-#endif    
-  if (tlbEntry->lpf == lpf) {
-    // See if the TLB entry privilege level allows us write access from this CPL
-    if (isWriteOK(tlbEntry, USER_PL)) {
-      bx_hostpageaddr_t hostPageAddr = tlbEntry->hostPageAddr;
-      Bit32u pageOffset = PAGE_OFFSET(laddr);
-      bx_phy_address pAddr = tlbEntry->ppf | pageOffset;
-      BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 4, tlbEntry->get_memtype(), BX_WRITE, (Bit8u*) &data);
-      Bit32u *hostAddr = (Bit32u*) (hostPageAddr | pageOffset);
-      pageWriteStampTable.decWriteStamp(pAddr, 4);
-      WriteHostDWordToLittleEndian(hostAddr, data);
-      return;
-    }
-  }
+  if (write_linear_tlb_hit(laddr, data))
+    return;
 
   if (access_write_linear(laddr, 4, CPL, BX_WRITE, 0x3, (void *) &data) < 0)
     exception(int_number(s), 0);
@@ -106,25 +59,8 @@ BX_CPU_C::write_linear_dword(unsigned s, bx_address laddr, Bit32u data)
   void BX_CPP_AttrRegparmN(3)
 BX_CPU_C::write_linear_qword(unsigned s, bx_address laddr, Bit64u data)
 {
-  bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 7);
-#if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
-  bx_address lpf = AlignedAccessLPFOf(laddr, (7 & BX_CPU_THIS_PTR alignment_check_mask));
-#else
-  bx_address lpf = LPFOf(laddr);
-#endif    
-  if (tlbEntry->lpf == lpf) {
-    // See if the TLB entry privilege level allows us write access from this CPL
-    if (isWriteOK(tlbEntry, USER_PL)) {
-      bx_hostpageaddr_t hostPageAddr = tlbEntry->hostPageAddr;
-      Bit32u pageOffset = PAGE_OFFSET(laddr);
-      bx_phy_address pAddr = tlbEntry->ppf | pageOffset;
-      BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, pAddr, 8, tlbEntry->get_memtype(), BX_WRITE, (Bit8u*) &data);
-      Bit64u *hostAddr = (Bit64u*) (hostPageAddr | pageOffset);
-      pageWriteStampTable.decWriteStamp(pAddr, 8);
-      WriteHostQWordToLittleEndian(hostAddr, data);
-      return;
-    }
-  }
+  if (write_linear_tlb_hit(laddr, data))
+    return;
 
   if (access_write_linear(laddr, 8, CPL, BX_WRITE, 0x7, (void *) &data) < 0)
     exception(int_number(s), 0);
@@ -331,19 +267,8 @@ BX_CPU_C::read_linear_byte(unsigned s, bx_address laddr)
 {
   Bit8u data;
 
-  bx_address lpf = LPFOf(laddr);
-  bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 0);
-  if (tlbEntry->lpf == lpf) {
-    // See if the TLB entry privilege level allows us read access from this CPL
-    if (isReadOK(tlbEntry, USER_PL)) {
-      bx_hostpageaddr_t hostPageAddr = tlbEntry->hostPageAddr;
-      Bit32u pageOffset = PAGE_OFFSET(laddr);
-      Bit8u *hostAddr = (Bit8u*) (hostPageAddr | pageOffset);
-      data = *hostAddr;
-      BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, (tlbEntry->ppf | pageOffset), 1, tlbEntry->get_memtype(), BX_READ, (Bit8u*) &data);
-      return data;
-    }
-  }
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
 
   if (access_read_linear(laddr, 1, CPL, BX_READ, 0x0, (void *) &data) < 0)
     exception(int_number(s), 0);
@@ -356,23 +281,8 @@ BX_CPU_C::read_linear_word(unsigned s, bx_address laddr)
 {
   Bit16u data;
 
-  bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 1);
-#if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
-  bx_address lpf = AlignedAccessLPFOf(laddr, (1 & BX_CPU_THIS_PTR alignment_check_mask));
-#else
-  bx_address lpf = LPFOf(laddr);
-#endif    
-  if (tlbEntry->lpf == lpf) {
-    // See if the TLB entry privilege level allows us read access from this CPL
-    if (isReadOK(tlbEntry, USER_PL)) {
-      bx_hostpageaddr_t hostPageAddr = tlbEntry->hostPageAddr;
-      Bit32u pageOffset = PAGE_OFFSET(laddr);
-      Bit16u *hostAddr = (Bit16u*) (hostPageAddr | pageOffset);
-      data = ReadHostWordFromLittleEndian(hostAddr);
-      BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, (tlbEntry->ppf | pageOffset), 2, tlbEntry->get_memtype(), BX_READ, (Bit8u*) &data);
-      return data;
-    }
-  }
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
 
   if (access_read_linear(laddr, 2, CPL, BX_READ, 0x1, (void *) &data) < 0)
     exception(int_number(s), 0);
@@ -385,23 +295,8 @@ BX_CPU_C::read_linear_dword(unsigned s, bx_address laddr)
 {
   Bit32u data;
 
-  bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 3);
-#if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
-  bx_address lpf = AlignedAccessLPFOf(laddr, (3 & BX_CPU_THIS_PTR alignment_check_mask));
-#else
-  bx_address lpf = LPFOf(laddr);
-#endif    
-  if (tlbEntry->lpf == lpf) {
-    // See if the TLB entry privilege level allows us read access from this CPL
-    if (isReadOK(tlbEntry, USER_PL)) {
-      bx_hostpageaddr_t hostPageAddr = tlbEntry->hostPageAddr;
-      Bit32u pageOffset = PAGE_OFFSET(laddr);
-      Bit32u *hostAddr = (Bit32u*) (hostPageAddr | pageOffset);
-      data = ReadHostDWordFromLittleEndian(hostAddr);
-      BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, (tlbEntry->ppf | pageOffset), 4, tlbEntry->get_memtype(), BX_READ, (Bit8u*) &data);
-      return data;
-    }
-  }
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
 
   if (access_read_linear(laddr, 4, CPL, BX_READ, 0x3, (void *) &data) < 0)
     exception(int_number(s), 0);
@@ -414,23 +309,8 @@ BX_CPU_C::read_linear_qword(unsigned s, bx_address laddr)
 {
   Bit64u data;
 
-  bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 7);
-#if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
-  bx_address lpf = AlignedAccessLPFOf(laddr, (7 & BX_CPU_THIS_PTR alignment_check_mask));
-#else
-  bx_address lpf = LPFOf(laddr);
-#endif    
-  if (tlbEntry->lpf == lpf) {
-    // See if the TLB entry privilege level allows us read access from this CPL
-    if (isReadOK(tlbEntry, USER_PL)) {
-      bx_hostpageaddr_t hostPageAddr = tlbEntry->hostPageAddr;
-      Bit32u pageOffset = PAGE_OFFSET(laddr);
-      Bit64u *hostAddr = (Bit64u*) (hostPageAddr | pageOffset);
-      data = ReadHostQWordFromLittleEndian(hostAddr);
-      BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, (tlbEntry->ppf | pageOffset), 8, tlbEntry->get_memtype(), BX_READ, (Bit8u*) &data);
-      return data;
-    }
-  }
+  if (read_linear_tlb_hit(laddr, &data))
+    return data;
 
   if (access_read_linear(laddr, 8, CPL, BX_READ, 0x7, (void *) &data) < 0)
     exception(int_number(s), 0);
@@ -596,11 +476,53 @@ BX_CPU_C::read_linear_zmmword_aligned(unsigned s, bx_address laddr, BxPackedZmmR
 //////////////////////////////////////////////////////////////
 // special Read-Modify-Write operations                     //
 // address translation info is kept across read/write calls //
+// the simulator lock is held between read and write calls  //
+// to keep RMW atomic in threaded SMP simulation            //
 //////////////////////////////////////////////////////////////
 
+#if BX_SUPPORT_SMP
+
+// Plain stores of the other CPU threads do not take the simulator lock, so
+// the write back of a R-M-W instruction to RAM is a host compare-and-swap
+// against the value read. If another CPU stored to the location in between,
+// the instruction is restarted. It has not changed any state the restarted
+// instruction reads, the R-M-W handlers update registers and flags only
+// from the values they computed.
+
+// The access missed the TLB and was done through the physical memory.
+// Switch the write back to the host pointer of the TLB entry filled by
+// the access, if there is one.
+void BX_CPU_C::RMW_use_host_ptr(bx_TLB_entry *tlbEntry, bx_address lpf, bx_address laddr, unsigned len)
+{
+  if (BX_CPU_THIS_PTR address_xlation.pages == 1 && tlbEntry->lpf == lpf && isWriteOK(tlbEntry, USER_PL)) {
+    pageWriteStampTable.decWriteStamp(BX_CPU_THIS_PTR address_xlation.paddress1, len);
+    BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) (tlbEntry->hostPageAddr | PAGE_OFFSET(laddr));
+  }
+}
+
+void BX_CPU_C::RMW_restart(void)
+{
+  RIP = BX_CPU_THIS_PTR prev_rip;
+  if (BX_CPU_THIS_PTR speculative_rsp) {
+    RSP = BX_CPU_THIS_PTR prev_rsp;
+#if BX_SUPPORT_CET
+    SSP = BX_CPU_THIS_PTR prev_ssp;
+#endif
+  }
+  BX_CPU_THIS_PTR speculative_rsp = 0;
+
+  // the instruction did not complete, the CPU thread counts it on return
+  // and releases the simulator lock
+  BX_CPU_THIS_PTR icount--;
+  longjmp(BX_CPU_THIS_PTR jmp_buf_env, 1);
+}
+
+#endif
+
   Bit8u BX_CPP_AttrRegparmN(2)
 BX_CPU_C::read_RMW_linear_byte(unsigned s, bx_address laddr)
 {
+  BX_SMP_LOCK();
   Bit8u data;
   bx_address lpf = LPFOf(laddr);
   bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 0);
@@ -613,6 +535,9 @@ BX_CPU_C::read_RMW_linear_byte(unsigned s, bx_address laddr)
       Bit8u *hostAddr = (Bit8u*) (hostPageAddr | pageOffset);
       pageWriteStampTable.decWriteStamp(pAddr, 1);
       data = *hostAddr;
+#if BX_SUPPORT_SMP
+      BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
       BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
       BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
 #if BX_SUPPORT_MEMTYPE
@@ -626,12 +551,19 @@ BX_CPU_C::read_RMW_linear_byte(unsigned s, bx_address laddr)
   if (access_read_linear(laddr, 1, CPL, BX_RW, 0x0, (void *) &data) < 0)
     exception(int_number(s), 0);
 
+#if BX_SUPPORT_SMP
+  if (bx_smp_threads_active)
+    RMW_use_host_ptr(tlbEntry, lpf, laddr, 1);
+  BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
+
   return data;
 }
 
   Bit16u BX_CPP_AttrRegparmN(2)
 BX_CPU_C::read_RMW_linear_word(unsigned s, bx_address laddr)
 {
+  BX_SMP_LOCK();
   Bit16u data;
   bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 1);
 #if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
@@ -648,6 +580,9 @@ BX_CPU_C::read_RMW_linear_word(unsigned s, bx_address laddr)
       Bit16u *hostAddr = (Bit16u*) (hostPageAddr | pageOffset);
       pageWriteStampTable.decWriteStamp(pAddr, 2);
       data = ReadHostWordFromLittleEndian(hostAddr);
+#if BX_SUPPORT_SMP
+      BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
       BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
       BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
 #if BX_SUPPORT_MEMTYPE
@@ -661,12 +596,19 @@ BX_CPU_C::read_RMW_linear_word(unsigned s, bx_address laddr)
   if (access_read_linear(laddr, 2, CPL, BX_RW, 0x1, (void *) &data) < 0)
     exception(int_number(s), 0);
 
+#if BX_SUPPORT_SMP
+  if (bx_smp_threads_active)
+    RMW_use_host_ptr(tlbEntry, lpf, laddr, 2);
+  BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
+
   return data;
 }
 
   Bit32u BX_CPP_AttrRegparmN(2)
 BX_CPU_C::read_RMW_linear_dword(unsigned s, bx_address laddr)
 {
+  BX_SMP_LOCK();
   Bit32u data;
   bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 3);
 #if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
@@ -683,6 +625,9 @@ BX_CPU_C::read_RMW_linear_dword(unsigned s, bx_address laddr)
       Bit32u *hostAddr = (Bit32u*) (hostPageAddr | pageOffset);
       pageWriteStampTable.decWriteStamp(pAddr, 4);
       data = ReadHostDWordFromLittleEndian(hostAddr);
+#if BX_SUPPORT_SMP
+      BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
       BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
       BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
 #if BX_SUPPORT_MEMTYPE
@@ -696,12 +641,19 @@ BX_CPU_C::read_RMW_linear_dword(unsigned s, bx_address laddr)
   if (access_read_linear(laddr, 4, CPL, BX_RW, 0x3, (void *) &data) < 0)
     exception(int_number(s), 0);
 
+#if BX_SUPPORT_SMP
+  if (bx_smp_threads_active)
+    RMW_use_host_ptr(tlbEntry, lpf, laddr, 4);
+  BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
+
   return data;
 }
 
   Bit64u BX_CPP_AttrRegparmN(2)
 BX_CPU_C::read_RMW_linear_qword(unsigned s, bx_address laddr)
 {
+  BX_SMP_LOCK();
   Bit64u data;
   bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 7);
 #if BX_SUPPORT_ALIGNMENT_CHECK && BX_CPU_LEVEL >= 4
@@ -718,6 +670,9 @@ BX_CPU_C::read_RMW_linear_qword(unsigned s, bx_address laddr)
       Bit64u *hostAddr = (Bit64u*) (hostPageAddr | pageOffset);
       pageWriteStampTable.decWriteStamp(pAddr, 8);
       data = ReadHostQWordFromLittleEndian(hostAddr);
+#if BX_SUPPORT_SMP
+      BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
       BX_CPU_THIS_PTR address_xlation.pages = (bx_ptr_equiv_t) hostAddr;
       BX_CPU_THIS_PTR address_xlation.paddress1 = pAddr;
 #if BX_SUPPORT_MEMTYPE
@@ -731,6 +686,12 @@ BX_CPU_C::read_RMW_linear_qword(unsigned s, bx_address laddr)
   if (access_read_linear(laddr, 8, CPL, BX_RW, 0x7, (void *) &data) < 0)
     exception(int_number(s), 0);
 
+#if BX_SUPPORT_SMP
+  if (bx_smp_threads_active)
+    RMW_use_host_ptr(tlbEntry, lpf, laddr, 8);
+  BX_CPU_THIS_PTR address_xlation.rmw_data = data;
+#endif
+
   return data;
 }
 
@@ -743,12 +704,21 @@ BX_CPU_C::write_RMW_linear_byte(Bit8u val8)
   if (BX_CPU_THIS_PTR address_xlation.pages > 2) {
     // Pages > 2 means it stores a host address for direct access.
     Bit8u *hostAddr = (Bit8u *) BX_CPU_THIS_PTR address_xlation.pages;
+#if BX_SUPPORT_SMP
+    if (bx_smp_threads_active) {
+      if (! BX_ATOMIC_CAS8(hostAddr, BX_CPU_THIS_PTR address_xlation.rmw_data, val8))
+        RMW_restart();
+    }
+    else
+#endif
     *hostAddr = val8;
   }
   else {
     // address_xlation.pages must be 1
     access_write_physical(BX_CPU_THIS_PTR address_xlation.paddress1, 1, &val8);
   }
+
+  BX_SMP_UNLOCK();
 }
 
   void BX_CPP_AttrRegparmN(1)
@@ -757,6 +727,16 @@ BX_CPU_C::write_RMW_linear_word(Bit16u val16)
   if (BX_CPU_THIS_PTR address_xlation.pages > 2) {
     // Pages > 2 means it stores a host address for direct access.
     Bit16u *hostAddr = (Bit16u *) BX_CPU_THIS_PTR address_xlation.pages;
+#if BX_SUPPORT_SMP
+    if (bx_smp_threads_active) {
+      Bit16u old16, new16;
+      WriteHostWordToLittleEndian(&old16, (Bit16u) BX_CPU_THIS_PTR address_xlation.rmw_data);
+      WriteHostWordToLittleEndian(&new16, val16);
+      if (! BX_ATOMIC_CAS16(hostAddr, old16, new16))
+        RMW_restart();
+    }
+    else
+#endif
     WriteHostWordToLittleEndian(hostAddr, val16);
     BX_DBG_PHY_MEMORY_ACCESS(BX_CPU_ID,
         BX_CPU_THIS_PTR address_xlation.paddress1, 2, MEMTYPE(BX_CPU_THIS_PTR address_xlation.memtype1),
@@ -789,6 +769,8 @@ BX_CPU_C::write_RMW_linear_word(Bit16u val16)
         BX_WRITE, 0,  (Bit8u*) &val16);
 #endif
   }
+
+  BX_SMP_UNLOCK();
 }
 
   void BX_CPP_AttrRegparmN(1)
@@ -797,6 +779,16 @@ BX_CPU_C::write_RMW_linear_dword(Bit32u val32)
   if (BX_CPU_THIS_PTR address_xlation.pages > 2) {
     // Pages > 2 means it stores a host address for direct access.
     Bit32u *hostAddr = (Bit32u *) BX_CPU_THIS_PTR address_xlation.pages;
+#if BX_SUPPORT_SMP
+    if (bx_smp_threads_active) {
+      Bit32u old32, new32;
+      WriteHostDWordToLittleEndian(&old32, (Bit32u) BX_CPU_THIS_PTR address_xlation.rmw_data);
+      WriteHostDWordToLittleEndian(&new32, val32);
+      if (! BX_ATOMIC_CAS32(hostAddr, old32, new32))
+        RMW_restart();
+    }
+    else
+#endif
     WriteHostDWordToLittleEndian(hostAddr, val32);
     BX_DBG_PHY_MEMORY_ACCESS(BX_CPU_ID,
         BX_CPU_THIS_PTR address_xlation.paddress1, 4, MEMTYPE(BX_CPU_THIS_PTR address_xlation.memtype1),
@@ -839,6 +831,8 @@ BX_CPU_C::write_RMW_linear_dword(Bit32u val32)
         BX_WRITE, 0, (Bit8u*) &val32);
 #endif
   }
+
+  BX_SMP_UNLOCK();
 }
 
   void BX_CPP_AttrRegparmN(1)
@@ -847,6 +841,16 @@ BX_CPU_C::write_RMW_linear_qword(Bit64u val64)
   if (BX_CPU_THIS_PTR address_xlation.pages > 2) {
     // Pages > 2 means it stores a host address for direct access.
     Bit64u *hostAddr = (Bit64u *) BX_CPU_THIS_PTR address_xlation.pages;
+#if BX_SUPPORT_SMP
+    if (bx_smp_threads_active) {
+      Bit64u old64, new64;
+      WriteHostQWordToLittleEndian(&old64, BX_CPU_THIS_PTR address_xlation.rmw_data);
+      WriteHostQWordToLittleEndian(&new64, val64);
+      if (! BX_ATOMIC_CAS64(hostAddr, old64, new64))
+        RMW_restart();
+    }
+    else
+#endif
     WriteHostQWordToLittleEndian(hostAddr, val64);
     BX_DBG_PHY_MEMORY_ACCESS(BX_CPU_ID,
         BX_CPU_THIS_PTR address_xlation.paddress1, 8, MEMTYPE(BX_CPU_THIS_PTR address_xlation.memtype1),
@@ -889,12 +893,15 @@ BX_CPU_C::write_RMW_linear_qword(Bit64u val64)
         BX_WRITE, 0, (Bit8u*) &val64);
 #endif
   }
+
+  BX_SMP_UNLOCK();
 }
 
 #if BX_SUPPORT_X86_64
 
 void BX_CPU_C::read_RMW_linear_dqword_aligned_64(unsigned s, bx_address laddr, Bit64u *hi, Bit64u *lo)
 {
+  BX_SMP_LOCK();
   bx_address lpf = AlignedAccessLPFOf(laddr, 15);
   bx_TLB_entry *tlbEntry = BX_DTLB_ENTRY_OF(laddr, 0);
   if (tlbEntry->lpf == lpf) {
@@ -933,6 +940,26 @@ void BX_CPU_C::read_RMW_linear_dqword_aligned_64(unsigned s, bx_address laddr, B
 
 void BX_CPU_C::write_RMW_linear_dqword(Bit64u hi, Bit64u lo)
 {
+#if BX_SUPPORT_SMP
+  if (BX_CPU_THIS_PTR address_xlation.pages > 2) {
+    // No 16 byte host compare-and-swap, the write back of CMPXCHG16B is
+    // atomic only with respect to the R-M-W instructions of other CPUs.
+    Bit64u *hostAddr = (Bit64u *) BX_CPU_THIS_PTR address_xlation.pages;
+    WriteHostQWordToLittleEndian(hostAddr, lo);
+    WriteHostQWordToLittleEndian(hostAddr + 1, hi);
+    BX_DBG_PHY_MEMORY_ACCESS(BX_CPU_ID,
+        BX_CPU_THIS_PTR address_xlation.paddress1, 8, MEMTYPE(BX_CPU_THIS_PTR address_xlation.memtype1),
+        BX_WRITE, 0, (Bit8u*) &lo);
+    BX_DBG_PHY_MEMORY_ACCESS(BX_CPU_ID,
+        BX_CPU_THIS_PTR address_xlation.paddress1 + 8, 8, MEMTYPE(BX_CPU_THIS_PTR address_xlation.memtype1),
+        BX_WRITE, 0, (Bit8u*) &hi);
+    BX_SMP_UNLOCK();
+    return;
+  }
+#endif
+
+  // nested locking, each of the qword writes below releases one level
+  BX_SMP_LOCK();
   write_RMW_linear_qword(lo);
 
   BX_CPU_THIS_PTR address_xlation.paddress1 += 8;
@@ -24,23 +24,11 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::INC_EdR(bxInstruction_c *i)
-{
-  Bit32u erx = ++BX_READ_32BIT_REG(i->dst());
-  SET_FLAGS_OSZAP_ADD_32(erx - 1, 0, erx);
-  BX_CLEAR_64BIT_HIGH(i->dst());
+#include "flags_liveness.h"
 
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EdR, INC_EdR, + 1, SET_FLAGS_OSZAP_ADD_32)
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::DEC_EdR(bxInstruction_c *i)
-{
-  Bit32u erx = --BX_READ_32BIT_REG(i->dst());
-  SET_FLAGS_OSZAP_SUB_32(erx + 1, 0, erx);
-  BX_CLEAR_64BIT_HIGH(i->dst());
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EdR, DEC_EdR, - 1, SET_FLAGS_OSZAP_SUB_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_EdGdM(bxInstruction_c *i)
 {
@@ -58,20 +46,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_EdGdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_GdEdR(bxInstruction_c *i)
-{
-  Bit32u op1_32, op2_32, sum_32;
-
-  op1_32 = BX_READ_32BIT_REG(i->dst());
-  op2_32 = BX_READ_32BIT_REG(i->src());
-  sum_32 = op1_32 + op2_32;
-
-  BX_WRITE_32BIT_REGZ(i->dst(), sum_32);
-
-  SET_FLAGS_OSZAPC_ADD_32(op1_32, op2_32, sum_32);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_GdEdR, ADD_GdEdR, +, SET_FLAGS_OSZAPC_ADD_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_GdEdM(bxInstruction_c *i)
 {
@@ -226,19 +201,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SUB_EdGdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::SUB_GdEdR(bxInstruction_c *i)
-{
-  Bit32u op1_32, op2_32, diff_32;
-
-  op1_32 = BX_READ_32BIT_REG(i->dst());
-  op2_32 = BX_READ_32BIT_REG(i->src());
-  diff_32 = op1_32 - op2_32;
-  BX_WRITE_32BIT_REGZ(i->dst(), diff_32);
-
-  SET_FLAGS_OSZAPC_SUB_32(op1_32, op2_32, diff_32);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_GdEdR, SUB_GdEdR, -, SET_FLAGS_OSZAPC_SUB_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SUB_GdEdM(bxInstruction_c *i)
 {
@@ -388,20 +351,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_EdIdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_EdIdR(bxInstruction_c *i)
-{
-  Bit32u op1_32, op2_32, sum_32;
-
-  op1_32 = BX_READ_32BIT_REG(i->dst());
-  op2_32 = i->Id();
-  sum_32 = op1_32 + op2_32;
-
-  BX_WRITE_32BIT_REGZ(i->dst(), sum_32);
-
-  SET_FLAGS_OSZAPC_ADD_32(op1_32, op2_32, sum_32);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EdIdR, ADD_EdIdR, +, SET_FLAGS_OSZAPC_ADD_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADC_EdIdM(bxInstruction_c *i)
 {
@@ -446,18 +396,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SUB_EdIdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::SUB_EdIdR(bxInstruction_c *i)
-{
-  Bit32u op1_32, op2_32 = i->Id(), diff_32;
-
-  op1_32 = BX_READ_32BIT_REG(i->dst());
-  diff_32 = op1_32 - op2_32;
-  BX_WRITE_32BIT_REGZ(i->dst(), diff_32);
-
-  SET_FLAGS_OSZAPC_SUB_32(op1_32, op2_32, diff_32);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EdIdR, SUB_EdIdR, -, SET_FLAGS_OSZAPC_SUB_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMP_EdIdM(bxInstruction_c *i)
 {
@@ -24,6 +24,8 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
+#include "flags_liveness.h"
+
 #if BX_SUPPORT_X86_64
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_EqGqM(bxInstruction_c *i)
@@ -43,19 +45,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_EqGqM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_GqEqR(bxInstruction_c *i)
-{
-  Bit64u op1_64, op2_64, sum_64;
-
-  op1_64 = BX_READ_64BIT_REG(i->dst());
-  op2_64 = BX_READ_64BIT_REG(i->src());
-  sum_64 = op1_64 + op2_64;
-  BX_WRITE_64BIT_REG(i->dst(), sum_64);
-
-  SET_FLAGS_OSZAPC_ADD_64(op1_64, op2_64, sum_64);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_GqEqR, ADD_GqEqR, +, SET_FLAGS_OSZAPC_ADD_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_GqEqM(bxInstruction_c *i)
 {
@@ -219,20 +209,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SUB_EqGqM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::SUB_GqEqR(bxInstruction_c *i)
-{
-  Bit64u op1_64, op2_64, diff_64;
-
-  op1_64 = BX_READ_64BIT_REG(i->dst());
-  op2_64 = BX_READ_64BIT_REG(i->src());
-  diff_64 = op1_64 - op2_64;
-
-  BX_WRITE_64BIT_REG(i->dst(), diff_64);
-
-  SET_FLAGS_OSZAPC_SUB_64(op1_64, op2_64, diff_64);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_GqEqR, SUB_GqEqR, -, SET_FLAGS_OSZAPC_SUB_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SUB_GqEqM(bxInstruction_c *i)
 {
@@ -383,19 +360,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_EqIdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADD_EqIdR(bxInstruction_c *i)
-{
-  Bit64u op1_64, op2_64, sum_64;
-
-  op1_64 = BX_READ_64BIT_REG(i->dst());
-  op2_64 = (Bit32s) i->Id();
-  sum_64 = op1_64 + op2_64;
-  BX_WRITE_64BIT_REG(i->dst(), sum_64);
-
-  SET_FLAGS_OSZAPC_ADD_64(op1_64, op2_64, sum_64);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EqIdR, ADD_EqIdR, +, SET_FLAGS_OSZAPC_ADD_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::ADC_EqIdM(bxInstruction_c *i)
 {
@@ -445,19 +410,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SUB_EqIdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::SUB_EqIdR(bxInstruction_c *i)
-{
-  Bit64u op1_64, op2_64, diff_64;
-
-  op1_64 = BX_READ_64BIT_REG(i->dst());
-  op2_64 = (Bit32s) i->Id();
-  diff_64 = op1_64 - op2_64;
-  BX_WRITE_64BIT_REG(i->dst(), diff_64);
-
-  SET_FLAGS_OSZAPC_SUB_64(op1_64, op2_64, diff_64);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EqIdR, SUB_EqIdR, -, SET_FLAGS_OSZAPC_SUB_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMP_EqIdM(bxInstruction_c *i)
 {
@@ -524,13 +477,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::INC_EqM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::INC_EqR(bxInstruction_c *i)
-{
-  Bit64u rrx = ++BX_READ_64BIT_REG(i->dst());
-  SET_FLAGS_OSZAP_ADD_64(rrx - 1, 0, rrx);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EqR, INC_EqR, + 1, SET_FLAGS_OSZAP_ADD_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::DEC_EqM(bxInstruction_c *i)
 {
@@ -545,13 +492,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::DEC_EqM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::DEC_EqR(bxInstruction_c *i)
-{
-  Bit64u rrx = --BX_READ_64BIT_REG(i->dst());
-  SET_FLAGS_OSZAP_SUB_64(rrx + 1, 0, rrx);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EqR, DEC_EqR, - 1, SET_FLAGS_OSZAP_SUB_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPXCHG_EqGqM(bxInstruction_c *i)
 {
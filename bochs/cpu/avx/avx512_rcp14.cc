@@ -28,8208 +28,7 @@
 
 #if BX_SUPPORT_EVEX
 
-//
-// The table was reverse-engineered from VRCP14SS instruction implementation available
-// in the Intel Software Development Emulator rev6.20 (released February 13, 2014)
-// http://software.intel.com/en-us/articles/intel-software-development-emulator/
-//
-
-// TODO: find better way to emulate these instructions, I am sure the HW doesn't have 64K entry lookup table
-
-static const Bit16u rcp14_table[65536] = {
-    0xfffc, 0xfffa, 0xfff8, 0xfff6, 0xfff4, 0xfff2, 0xfff0, 0xffee, //     0
-    0xffec, 0xffea, 0xffe8, 0xffe6, 0xffe4, 0xffe2, 0xffe0, 0xffde, //     8
-    0xffdc, 0xffda, 0xffd9, 0xffd7, 0xffd5, 0xffd3, 0xffd1, 0xffcf, //    16
-    0xffcd, 0xffcb, 0xffc9, 0xffc7, 0xffc5, 0xffc3, 0xffc1, 0xffbf, //    24
-    0xffbd, 0xffbb, 0xffb9, 0xffb7, 0xffb5, 0xffb3, 0xffb1, 0xffaf, //    32
-    0xffad, 0xffab, 0xffa9, 0xffa7, 0xffa5, 0xffa3, 0xffa1, 0xff9f, //    40
-    0xff9d, 0xff9b, 0xff99, 0xff97, 0xff96, 0xff94, 0xff92, 0xff90, //    48
-    0xff8e, 0xff8c, 0xff8a, 0xff88, 0xff86, 0xff84, 0xff82, 0xff80, //    56
-    0xff7e, 0xff7c, 0xff7a, 0xff78, 0xff76, 0xff74, 0xff72, 0xff70, //    64
-    0xff6e, 0xff6c, 0xff6a, 0xff68, 0xff66, 0xff64, 0xff62, 0xff60, //    72
-    0xff5e, 0xff5c, 0xff5a, 0xff58, 0xff56, 0xff54, 0xff53, 0xff51, //    80
-    0xff4f, 0xff4d, 0xff4b, 0xff49, 0xff47, 0xff45, 0xff43, 0xff41, //    88
-    0xff3f, 0xff3d, 0xff3b, 0xff39, 0xff37, 0xff35, 0xff33, 0xff31, //    96
-    0xff2f, 0xff2d, 0xff2b, 0xff29, 0xff27, 0xff25, 0xff23, 0xff21, //   104
-    0xff1f, 0xff1d, 0xff1b, 0xff19, 0xff17, 0xff15, 0xff13, 0xff11, //   112
-    0xff10, 0xff0e, 0xff0c, 0xff0a, 0xff08, 0xff06, 0xff04, 0xff02, //   120
-    0xff00, 0xfefe, 0xfefc, 0xfefa, 0xfef8, 0xfef6, 0xfef4, 0xfef2, //   128
-    0xfef0, 0xfeee, 0xfeec, 0xfeea, 0xfee8, 0xfee6, 0xfee4, 0xfee2, //   136
-    0xfee0, 0xfede, 0xfedc, 0xfeda, 0xfed8, 0xfed6, 0xfed4, 0xfed2, //   144
-    0xfed0, 0xfece, 0xfecd, 0xfecb, 0xfec9, 0xfec7, 0xfec5, 0xfec3, //   152
-    0xfec1, 0xfebf, 0xfebd, 0xfebb, 0xfeb9, 0xfeb7, 0xfeb5, 0xfeb3, //   160
-    0xfeb1, 0xfeaf, 0xfead, 0xfeab, 0xfea9, 0xfea7, 0xfea5, 0xfea3, //   168
-    0xfea1, 0xfe9f, 0xfe9d, 0xfe9b, 0xfe99, 0xfe97, 0xfe95, 0xfe93, //   176
-    0xfe91, 0xfe8f, 0xfe8d, 0xfe8b, 0xfe8a, 0xfe88, 0xfe86, 0xfe84, //   184
-    0xfe82, 0xfe80, 0xfe7e, 0xfe7c, 0xfe7a, 0xfe78, 0xfe76, 0xfe74, //   192
-    0xfe72, 0xfe70, 0xfe6e, 0xfe6c, 0xfe6a, 0xfe68, 0xfe66, 0xfe64, //   200
-    0xfe62, 0xfe60, 0xfe5e, 0xfe5c, 0xfe5a, 0xfe58, 0xfe56, 0xfe54, //   208
-    0xfe52, 0xfe50, 0xfe4e, 0xfe4c, 0xfe4a, 0xfe48, 0xfe47, 0xfe45, //   216
-    0xfe43, 0xfe41, 0xfe3f, 0xfe3d, 0xfe3b, 0xfe39, 0xfe37, 0xfe35, //   224
-    0xfe33, 0xfe31, 0xfe2f, 0xfe2d, 0xfe2b, 0xfe29, 0xfe27, 0xfe25, //   232
-    0xfe23, 0xfe21, 0xfe1f, 0xfe1d, 0xfe1b, 0xfe19, 0xfe17, 0xfe15, //   240
-    0xfe13, 0xfe11, 0xfe0f, 0xfe0d, 0xfe0b, 0xfe09, 0xfe07, 0xfe05, //   248
-    0xfe04, 0xfe02, 0xfe00, 0xfdfe, 0xfdfc, 0xfdfa, 0xfdf8, 0xfdf6, //   256
-    0xfdf4, 0xfdf2, 0xfdf0, 0xfdee, 0xfdec, 0xfdea, 0xfde8, 0xfde6, //   264
-    0xfde4, 0xfde2, 0xfde0, 0xfdde, 0xfddc, 0xfdda, 0xfdd8, 0xfdd6, //   272
-    0xfdd4, 0xfdd2, 0xfdd0, 0xfdce, 0xfdcc, 0xfdca, 0xfdc8, 0xfdc6, //   280
-    0xfdc4, 0xfdc2, 0xfdc0, 0xfdbf, 0xfdbd, 0xfdbb, 0xfdb9, 0xfdb7, //   288
-    0xfdb5, 0xfdb3, 0xfdb1, 0xfdaf, 0xfdad, 0xfdab, 0xfda9, 0xfda7, //   296
-    0xfda5, 0xfda3, 0xfda1, 0xfd9f, 0xfd9d, 0xfd9b, 0xfd99, 0xfd97, //   304
-    0xfd95, 0xfd93, 0xfd91, 0xfd8f, 0xfd8d, 0xfd8b, 0xfd89, 0xfd87, //   312
-    0xfd85, 0xfd83, 0xfd81, 0xfd7f, 0xfd7d, 0xfd7c, 0xfd7a, 0xfd78, //   320
-    0xfd76, 0xfd74, 0xfd72, 0xfd70, 0xfd6e, 0xfd6c, 0xfd6a, 0xfd68, //   328
-    0xfd66, 0xfd64, 0xfd62, 0xfd60, 0xfd5e, 0xfd5c, 0xfd5a, 0xfd58, //   336
-    0xfd56, 0xfd54, 0xfd52, 0xfd50, 0xfd4e, 0xfd4c, 0xfd4a, 0xfd48, //   344
-    0xfd46, 0xfd44, 0xfd42, 0xfd40, 0xfd3e, 0xfd3c, 0xfd3a, 0xfd39, //   352
-    0xfd37, 0xfd35, 0xfd33, 0xfd31, 0xfd2f, 0xfd2d, 0xfd2b, 0xfd29, //   360
-    0xfd27, 0xfd25, 0xfd23, 0xfd21, 0xfd1f, 0xfd1d, 0xfd1b, 0xfd19, //   368
-    0xfd17, 0xfd15, 0xfd13, 0xfd11, 0xfd0f, 0xfd0d, 0xfd0b, 0xfd09, //   376
-    0xfd07, 0xfd05, 0xfd03, 0xfd01, 0xfcff, 0xfcfd, 0xfcfb, 0xfcf9, //   384
-    0xfcf7, 0xfcf6, 0xfcf4, 0xfcf2, 0xfcf0, 0xfcee, 0xfcec, 0xfcea, //   392
-    0xfce8, 0xfce6, 0xfce4, 0xfce2, 0xfce0, 0xfcde, 0xfcdc, 0xfcda, //   400
-    0xfcd8, 0xfcd6, 0xfcd4, 0xfcd2, 0xfcd0, 0xfcce, 0xfccc, 0xfcca, //   408
-    0xfcc8, 0xfcc6, 0xfcc4, 0xfcc2, 0xfcc0, 0xfcbe, 0xfcbc, 0xfcba, //   416
-    0xfcb8, 0xfcb6, 0xfcb4, 0xfcb3, 0xfcb1, 0xfcaf, 0xfcad, 0xfcab, //   424
-    0xfca9, 0xfca7, 0xfca5, 0xfca3, 0xfca1, 0xfc9f, 0xfc9d, 0xfc9b, //   432
-    0xfc99, 0xfc97, 0xfc95, 0xfc93, 0xfc91, 0xfc8f, 0xfc8d, 0xfc8b, //   440
-    0xfc89, 0xfc87, 0xfc85, 0xfc83, 0xfc81, 0xfc7f, 0xfc7d, 0xfc7b, //   448
-    0xfc79, 0xfc77, 0xfc75, 0xfc73, 0xfc71, 0xfc70, 0xfc6e, 0xfc6c, //   456
-    0xfc6a, 0xfc68, 0xfc66, 0xfc64, 0xfc62, 0xfc60, 0xfc5e, 0xfc5c, //   464
-    0xfc5a, 0xfc58, 0xfc56, 0xfc54, 0xfc52, 0xfc50, 0xfc4e, 0xfc4c, //   472
-    0xfc4a, 0xfc48, 0xfc46, 0xfc44, 0xfc42, 0xfc40, 0xfc3e, 0xfc3c, //   480
-    0xfc3a, 0xfc38, 0xfc36, 0xfc34, 0xfc32, 0xfc30, 0xfc2e, 0xfc2d, //   488
-    0xfc2b, 0xfc29, 0xfc27, 0xfc25, 0xfc23, 0xfc21, 0xfc1f, 0xfc1d, //   496
-    0xfc1b, 0xfc19, 0xfc17, 0xfc15, 0xfc13, 0xfc11, 0xfc0f, 0xfc0d, //   504
-    0xfc0b, 0xfc09, 0xfc07, 0xfc05, 0xfc03, 0xfc01, 0xfbff, 0xfbfd, //   512
-    0xfbfb, 0xfbf9, 0xfbf7, 0xfbf5, 0xfbf3, 0xfbf1, 0xfbef, 0xfbed, //   520
-    0xfbeb, 0xfbe9, 0xfbe8, 0xfbe6, 0xfbe4, 0xfbe2, 0xfbe0, 0xfbde, //   528
-    0xfbdc, 0xfbda, 0xfbd8, 0xfbd6, 0xfbd4, 0xfbd2, 0xfbd0, 0xfbce, //   536
-    0xfbcc, 0xfbca, 0xfbc8, 0xfbc6, 0xfbc4, 0xfbc2, 0xfbc0, 0xfbbe, //   544
-    0xfbbc, 0xfbba, 0xfbb8, 0xfbb6, 0xfbb4, 0xfbb2, 0xfbb0, 0xfbae, //   552
-    0xfbac, 0xfbaa, 0xfba8, 0xfba6, 0xfba5, 0xfba3, 0xfba1, 0xfb9f, //   560
-    0xfb9d, 0xfb9b, 0xfb99, 0xfb97, 0xfb95, 0xfb93, 0xfb91, 0xfb8f, //   568
-    0xfb8d, 0xfb8b, 0xfb89, 0xfb87, 0xfb85, 0xfb83, 0xfb81, 0xfb7f, //   576
-    0xfb7d, 0xfb7b, 0xfb79, 0xfb77, 0xfb75, 0xfb73, 0xfb71, 0xfb6f, //   584
-    0xfb6d, 0xfb6b, 0xfb69, 0xfb67, 0xfb65, 0xfb63, 0xfb62, 0xfb60, //   592
-    0xfb5e, 0xfb5c, 0xfb5a, 0xfb58, 0xfb56, 0xfb54, 0xfb52, 0xfb50, //   600
-    0xfb4e, 0xfb4c, 0xfb4a, 0xfb48, 0xfb46, 0xfb44, 0xfb42, 0xfb40, //   608
-    0xfb3e, 0xfb3c, 0xfb3a, 0xfb38, 0xfb36, 0xfb34, 0xfb32, 0xfb30, //   616
-    0xfb2e, 0xfb2c, 0xfb2a, 0xfb28, 0xfb26, 0xfb24, 0xfb22, 0xfb20, //   624
-    0xfb1f, 0xfb1d, 0xfb1b, 0xfb19, 0xfb17, 0xfb15, 0xfb13, 0xfb11, //   632
-    0xfb0f, 0xfb0d, 0xfb0b, 0xfb09, 0xfb07, 0xfb05, 0xfb03, 0xfb01, //   640
-    0xfaff, 0xfafd, 0xfafb, 0xfaf9, 0xfaf7, 0xfaf5, 0xfaf3, 0xfaf1, //   648
-    0xfaef, 0xfaed, 0xfaeb, 0xfae9, 0xfae7, 0xfae5, 0xfae3, 0xfae1, //   656
-    0xfadf, 0xfadd, 0xfadc, 0xfada, 0xfad8, 0xfad6, 0xfad4, 0xfad2, //   664
-    0xfad0, 0xface, 0xfacc, 0xfaca, 0xfac8, 0xfac6, 0xfac4, 0xfac2, //   672
-    0xfac0, 0xfabe, 0xfabc, 0xfaba, 0xfab8, 0xfab6, 0xfab4, 0xfab2, //   680
-    0xfab0, 0xfaae, 0xfaac, 0xfaaa, 0xfaa8, 0xfaa6, 0xfaa4, 0xfaa2, //   688
-    0xfaa0, 0xfa9e, 0xfa9c, 0xfa9a, 0xfa99, 0xfa97, 0xfa95, 0xfa93, //   696
-    0xfa91, 0xfa8f, 0xfa8d, 0xfa8b, 0xfa89, 0xfa87, 0xfa85, 0xfa83, //   704
-    0xfa81, 0xfa7f, 0xfa7d, 0xfa7b, 0xfa79, 0xfa77, 0xfa75, 0xfa73, //   712
-    0xfa71, 0xfa6f, 0xfa6d, 0xfa6b, 0xfa69, 0xfa67, 0xfa65, 0xfa63, //   720
-    0xfa61, 0xfa5f, 0xfa5d, 0xfa5b, 0xfa59, 0xfa57, 0xfa56, 0xfa54, //   728
-    0xfa52, 0xfa50, 0xfa4e, 0xfa4c, 0xfa4a, 0xfa48, 0xfa46, 0xfa44, //   736
-    0xfa42, 0xfa40, 0xfa3e, 0xfa3c, 0xfa3a, 0xfa38, 0xfa36, 0xfa34, //   744
-    0xfa32, 0xfa30, 0xfa2e, 0xfa2c, 0xfa2a, 0xfa28, 0xfa26, 0xfa24, //   752
-    0xfa22, 0xfa20, 0xfa1e, 0xfa1c, 0xfa1a, 0xfa18, 0xfa16, 0xfa14, //   760
-    0xfa13, 0xfa11, 0xfa0f, 0xfa0d, 0xfa0b, 0xfa09, 0xfa07, 0xfa05, //   768
-    0xfa03, 0xfa01, 0xf9ff, 0xf9fd, 0xf9fb, 0xf9f9, 0xf9f7, 0xf9f5, //   776
-    0xf9f3, 0xf9f1, 0xf9ef, 0xf9ed, 0xf9eb, 0xf9e9, 0xf9e7, 0xf9e5, //   784
-    0xf9e3, 0xf9e1, 0xf9df, 0xf9dd, 0xf9db, 0xf9d9, 0xf9d7, 0xf9d5, //   792
-    0xf9d3, 0xf9d1, 0xf9cf, 0xf9ce, 0xf9cc, 0xf9ca, 0xf9c8, 0xf9c6, //   800
-    0xf9c4, 0xf9c2, 0xf9c0, 0xf9be, 0xf9bc, 0xf9ba, 0xf9b8, 0xf9b6, //   808
-    0xf9b4, 0xf9b2, 0xf9b0, 0xf9ae, 0xf9ac, 0xf9aa, 0xf9a8, 0xf9a6, //   816
-    0xf9a4, 0xf9a2, 0xf9a0, 0xf99e, 0xf99c, 0xf99a, 0xf998, 0xf996, //   824
-    0xf994, 0xf992, 0xf990, 0xf98e, 0xf98c, 0xf98b, 0xf989, 0xf987, //   832
-    0xf985, 0xf983, 0xf981, 0xf97f, 0xf97d, 0xf97b, 0xf979, 0xf977, //   840
-    0xf975, 0xf973, 0xf971, 0xf96f, 0xf96d, 0xf96b, 0xf969, 0xf967, //   848
-    0xf965, 0xf963, 0xf961, 0xf95f, 0xf95d, 0xf95b, 0xf959, 0xf957, //   856
-    0xf955, 0xf953, 0xf951, 0xf94f, 0xf94d, 0xf94b, 0xf949, 0xf948, //   864
-    0xf946, 0xf944, 0xf942, 0xf940, 0xf93e, 0xf93c, 0xf93a, 0xf938, //   872
-    0xf936, 0xf934, 0xf932, 0xf930, 0xf92e, 0xf92c, 0xf92a, 0xf928, //   880
-    0xf926, 0xf924, 0xf922, 0xf920, 0xf91e, 0xf91c, 0xf91a, 0xf918, //   888
-    0xf916, 0xf914, 0xf912, 0xf910, 0xf90e, 0xf90c, 0xf90a, 0xf908, //   896
-    0xf906, 0xf905, 0xf903, 0xf901, 0xf8ff, 0xf8fd, 0xf8fb, 0xf8f9, //   904
-    0xf8f7, 0xf8f5, 0xf8f3, 0xf8f1, 0xf8ef, 0xf8ed, 0xf8eb, 0xf8e9, //   912
-    0xf8e7, 0xf8e5, 0xf8e3, 0xf8e1, 0xf8df, 0xf8dd, 0xf8db, 0xf8d9, //   920
-    0xf8d7, 0xf8d5, 0xf8d3, 0xf8d1, 0xf8cf, 0xf8cd, 0xf8cb, 0xf8c9, //   928
-    0xf8c7, 0xf8c5, 0xf8c3, 0xf8c2, 0xf8c0, 0xf8be, 0xf8bc, 0xf8ba, //   936
-    0xf8b8, 0xf8b6, 0xf8b4, 0xf8b2, 0xf8b0, 0xf8ae, 0xf8ac, 0xf8aa, //   944
-    0xf8a8, 0xf8a6, 0xf8a4, 0xf8a2, 0xf8a0, 0xf89e, 0xf89c, 0xf89a, //   952
-    0xf898, 0xf896, 0xf894, 0xf892, 0xf890, 0xf88e, 0xf88c, 0xf88a, //   960
-    0xf888, 0xf886, 0xf884, 0xf882, 0xf880, 0xf87f, 0xf87d, 0xf87b, //   968
-    0xf879, 0xf877, 0xf875, 0xf873, 0xf871, 0xf86f, 0xf86d, 0xf86b, //   976
-    0xf869, 0xf867, 0xf865, 0xf863, 0xf861, 0xf85f, 0xf85d, 0xf85b, //   984
-    0xf859, 0xf857, 0xf855, 0xf853, 0xf851, 0xf84f, 0xf84d, 0xf84b, //   992
-    0xf849, 0xf847, 0xf845, 0xf843, 0xf841, 0xf83f, 0xf83d, 0xf83c, //  1000
-    0xf83a, 0xf838, 0xf836, 0xf834, 0xf832, 0xf830, 0xf82e, 0xf82c, //  1008
-    0xf82a, 0xf828, 0xf826, 0xf824, 0xf822, 0xf820, 0xf81e, 0xf81c, //  1016
-    0xf81b, 0xf819, 0xf817, 0xf815, 0xf813, 0xf811, 0xf80f, 0xf80d, //  1024
-    0xf80b, 0xf809, 0xf807, 0xf806, 0xf804, 0xf802, 0xf800, 0xf7fe, //  1032
-    0xf7fc, 0xf7fa, 0xf7f8, 0xf7f6, 0xf7f4, 0xf7f2, 0xf7f1, 0xf7ef, //  1040
-    0xf7ed, 0xf7eb, 0xf7e9, 0xf7e7, 0xf7e5, 0xf7e3, 0xf7e1, 0xf7df, //  1048
-    0xf7dd, 0xf7dc, 0xf7da, 0xf7d8, 0xf7d6, 0xf7d4, 0xf7d2, 0xf7d0, //  1056
-    0xf7ce, 0xf7cc, 0xf7ca, 0xf7c8, 0xf7c7, 0xf7c5, 0xf7c3, 0xf7c1, //  1064
-    0xf7bf, 0xf7bd, 0xf7bb, 0xf7b9, 0xf7b7, 0xf7b5, 0xf7b3, 0xf7b2, //  1072
-    0xf7b0, 0xf7ae, 0xf7ac, 0xf7aa, 0xf7a8, 0xf7a6, 0xf7a4, 0xf7a2, //  1080
-    0xf7a0, 0xf79e, 0xf79d, 0xf79b, 0xf799, 0xf797, 0xf795, 0xf793, //  1088
-    0xf791, 0xf78f, 0xf78d, 0xf78b, 0xf789, 0xf788, 0xf786, 0xf784, //  1096
-    0xf782, 0xf780, 0xf77e, 0xf77c, 0xf77a, 0xf778, 0xf776, 0xf774, //  1104
-    0xf773, 0xf771, 0xf76f, 0xf76d, 0xf76b, 0xf769, 0xf767, 0xf765, //  1112
-    0xf763, 0xf761, 0xf75f, 0xf75e, 0xf75c, 0xf75a, 0xf758, 0xf756, //  1120
-    0xf754, 0xf752, 0xf750, 0xf74e, 0xf74c, 0xf74b, 0xf749, 0xf747, //  1128
-    0xf745, 0xf743, 0xf741, 0xf73f, 0xf73d, 0xf73b, 0xf739, 0xf737, //  1136
-    0xf736, 0xf734, 0xf732, 0xf730, 0xf72e, 0xf72c, 0xf72a, 0xf728, //  1144
-    0xf726, 0xf724, 0xf722, 0xf721, 0xf71f, 0xf71d, 0xf71b, 0xf719, //  1152
-    0xf717, 0xf715, 0xf713, 0xf711, 0xf70f, 0xf70d, 0xf70c, 0xf70a, //  1160
-    0xf708, 0xf706, 0xf704, 0xf702, 0xf700, 0xf6fe, 0xf6fc, 0xf6fa, //  1168
-    0xf6f8, 0xf6f7, 0xf6f5, 0xf6f3, 0xf6f1, 0xf6ef, 0xf6ed, 0xf6eb, //  1176
-    0xf6e9, 0xf6e7, 0xf6e5, 0xf6e3, 0xf6e2, 0xf6e0, 0xf6de, 0xf6dc, //  1184
-    0xf6da, 0xf6d8, 0xf6d6, 0xf6d4, 0xf6d2, 0xf6d0, 0xf6ce, 0xf6cd, //  1192
-    0xf6cb, 0xf6c9, 0xf6c7, 0xf6c5, 0xf6c3, 0xf6c1, 0xf6bf, 0xf6bd, //  1200
-    0xf6bb, 0xf6b9, 0xf6b8, 0xf6b6, 0xf6b4, 0xf6b2, 0xf6b0, 0xf6ae, //  1208
-    0xf6ac, 0xf6aa, 0xf6a8, 0xf6a6, 0xf6a4, 0xf6a3, 0xf6a1, 0xf69f, //  1216
-    0xf69d, 0xf69b, 0xf699, 0xf697, 0xf695, 0xf693, 0xf691, 0xf690, //  1224
-    0xf68e, 0xf68c, 0xf68a, 0xf688, 0xf686, 0xf684, 0xf682, 0xf680, //  1232
-    0xf67e, 0xf67c, 0xf67b, 0xf679, 0xf677, 0xf675, 0xf673, 0xf671, //  1240
-    0xf66f, 0xf66d, 0xf66b, 0xf669, 0xf667, 0xf666, 0xf664, 0xf662, //  1248
-    0xf660, 0xf65e, 0xf65c, 0xf65a, 0xf658, 0xf656, 0xf654, 0xf652, //  1256
-    0xf651, 0xf64f, 0xf64d, 0xf64b, 0xf649, 0xf647, 0xf645, 0xf643, //  1264
-    0xf641, 0xf63f, 0xf63d, 0xf63c, 0xf63a, 0xf638, 0xf636, 0xf634, //  1272
-    0xf632, 0xf630, 0xf62e, 0xf62c, 0xf62a, 0xf628, 0xf627, 0xf625, //  1280
-    0xf623, 0xf621, 0xf61f, 0xf61d, 0xf61b, 0xf619, 0xf617, 0xf615, //  1288
-    0xf613, 0xf612, 0xf610, 0xf60e, 0xf60c, 0xf60a, 0xf608, 0xf606, //  1296
-    0xf604, 0xf602, 0xf600, 0xf5fe, 0xf5fd, 0xf5fb, 0xf5f9, 0xf5f7, //  1304
-    0xf5f5, 0xf5f3, 0xf5f1, 0xf5ef, 0xf5ed, 0xf5eb, 0xf5e9, 0xf5e8, //  1312
-    0xf5e6, 0xf5e4, 0xf5e2, 0xf5e0, 0xf5de, 0xf5dc, 0xf5da, 0xf5d8, //  1320
-    0xf5d6, 0xf5d4, 0xf5d3, 0xf5d1, 0xf5cf, 0xf5cd, 0xf5cb, 0xf5c9, //  1328
-    0xf5c7, 0xf5c5, 0xf5c3, 0xf5c1, 0xf5c0, 0xf5be, 0xf5bc, 0xf5ba, //  1336
-    0xf5b8, 0xf5b6, 0xf5b4, 0xf5b2, 0xf5b0, 0xf5ae, 0xf5ac, 0xf5ab, //  1344
-    0xf5a9, 0xf5a7, 0xf5a5, 0xf5a3, 0xf5a1, 0xf59f, 0xf59d, 0xf59b, //  1352
-    0xf599, 0xf597, 0xf596, 0xf594, 0xf592, 0xf590, 0xf58e, 0xf58c, //  1360
-    0xf58a, 0xf588, 0xf586, 0xf584, 0xf582, 0xf581, 0xf57f, 0xf57d, //  1368
-    0xf57b, 0xf579, 0xf577, 0xf575, 0xf573, 0xf571, 0xf56f, 0xf56d, //  1376
-    0xf56c, 0xf56a, 0xf568, 0xf566, 0xf564, 0xf562, 0xf560, 0xf55e, //  1384
-    0xf55c, 0xf55a, 0xf558, 0xf557, 0xf555, 0xf553, 0xf551, 0xf54f, //  1392
-    0xf54d, 0xf54b, 0xf549, 0xf547, 0xf545, 0xf543, 0xf542, 0xf540, //  1400
-    0xf53e, 0xf53c, 0xf53a, 0xf538, 0xf536, 0xf534, 0xf532, 0xf530, //  1408
-    0xf52e, 0xf52d, 0xf52b, 0xf529, 0xf527, 0xf525, 0xf523, 0xf521, //  1416
-    0xf51f, 0xf51d, 0xf51b, 0xf519, 0xf518, 0xf516, 0xf514, 0xf512, //  1424
-    0xf510, 0xf50e, 0xf50c, 0xf50a, 0xf508, 0xf506, 0xf505, 0xf503, //  1432
-    0xf501, 0xf4ff, 0xf4fd, 0xf4fb, 0xf4f9, 0xf4f7, 0xf4f5, 0xf4f3, //  1440
-    0xf4f1, 0xf4f0, 0xf4ee, 0xf4ec, 0xf4ea, 0xf4e8, 0xf4e6, 0xf4e4, //  1448
-    0xf4e2, 0xf4e0, 0xf4de, 0xf4dc, 0xf4db, 0xf4d9, 0xf4d7, 0xf4d5, //  1456
-    0xf4d3, 0xf4d1, 0xf4cf, 0xf4cd, 0xf4cb, 0xf4c9, 0xf4c7, 0xf4c6, //  1464
-    0xf4c4, 0xf4c2, 0xf4c0, 0xf4be, 0xf4bc, 0xf4ba, 0xf4b8, 0xf4b6, //  1472
-    0xf4b4, 0xf4b2, 0xf4b1, 0xf4af, 0xf4ad, 0xf4ab, 0xf4a9, 0xf4a7, //  1480
-    0xf4a5, 0xf4a3, 0xf4a1, 0xf49f, 0xf49d, 0xf49c, 0xf49a, 0xf498, //  1488
-    0xf496, 0xf494, 0xf492, 0xf490, 0xf48e, 0xf48c, 0xf48a, 0xf488, //  1496
-    0xf487, 0xf485, 0xf483, 0xf481, 0xf47f, 0xf47d, 0xf47b, 0xf479, //  1504
-    0xf477, 0xf475, 0xf473, 0xf472, 0xf470, 0xf46e, 0xf46c, 0xf46a, //  1512
-    0xf468, 0xf466, 0xf464, 0xf462, 0xf460, 0xf45e, 0xf45d, 0xf45b, //  1520
-    0xf459, 0xf457, 0xf455, 0xf453, 0xf451, 0xf44f, 0xf44d, 0xf44b, //  1528
-    0xf44a, 0xf448, 0xf446, 0xf444, 0xf442, 0xf440, 0xf43e, 0xf43c, //  1536
-    0xf43a, 0xf438, 0xf436, 0xf435, 0xf433, 0xf431, 0xf42f, 0xf42d, //  1544
-    0xf42b, 0xf429, 0xf427, 0xf425, 0xf423, 0xf421, 0xf420, 0xf41e, //  1552
-    0xf41c, 0xf41a, 0xf418, 0xf416, 0xf414, 0xf412, 0xf410, 0xf40e, //  1560
-    0xf40c, 0xf40b, 0xf409, 0xf407, 0xf405, 0xf403, 0xf401, 0xf3ff, //  1568
-    0xf3fd, 0xf3fb, 0xf3f9, 0xf3f7, 0xf3f6, 0xf3f4, 0xf3f2, 0xf3f0, //  1576
-    0xf3ee, 0xf3ec, 0xf3ea, 0xf3e8, 0xf3e6, 0xf3e4, 0xf3e2, 0xf3e1, //  1584
-    0xf3df, 0xf3dd, 0xf3db, 0xf3d9, 0xf3d7, 0xf3d5, 0xf3d3, 0xf3d1, //  1592
-    0xf3cf, 0xf3cd, 0xf3cc, 0xf3ca, 0xf3c8, 0xf3c6, 0xf3c4, 0xf3c2, //  1600
-    0xf3c0, 0xf3be, 0xf3bc, 0xf3ba, 0xf3b8, 0xf3b7, 0xf3b5, 0xf3b3, //  1608
-    0xf3b1, 0xf3af, 0xf3ad, 0xf3ab, 0xf3a9, 0xf3a7, 0xf3a5, 0xf3a3, //  1616
-    0xf3a2, 0xf3a0, 0xf39e, 0xf39c, 0xf39a, 0xf398, 0xf396, 0xf394, //  1624
-    0xf392, 0xf390, 0xf38e, 0xf38d, 0xf38b, 0xf389, 0xf387, 0xf385, //  1632
-    0xf383, 0xf381, 0xf37f, 0xf37d, 0xf37b, 0xf37a, 0xf378, 0xf376, //  1640
-    0xf374, 0xf372, 0xf370, 0xf36e, 0xf36c, 0xf36a, 0xf368, 0xf366, //  1648
-    0xf365, 0xf363, 0xf361, 0xf35f, 0xf35d, 0xf35b, 0xf359, 0xf357, //  1656
-    0xf355, 0xf353, 0xf351, 0xf350, 0xf34e, 0xf34c, 0xf34a, 0xf348, //  1664
-    0xf346, 0xf344, 0xf342, 0xf340, 0xf33e, 0xf33c, 0xf33b, 0xf339, //  1672
-    0xf337, 0xf335, 0xf333, 0xf331, 0xf32f, 0xf32d, 0xf32b, 0xf329, //  1680
-    0xf327, 0xf326, 0xf324, 0xf322, 0xf320, 0xf31e, 0xf31c, 0xf31a, //  1688
-    0xf318, 0xf316, 0xf314, 0xf312, 0xf311, 0xf30f, 0xf30d, 0xf30b, //  1696
-    0xf309, 0xf307, 0xf305, 0xf303, 0xf301, 0xf2ff, 0xf2fd, 0xf2fc, //  1704
-    0xf2fa, 0xf2f8, 0xf2f6, 0xf2f4, 0xf2f2, 0xf2f0, 0xf2ee, 0xf2ec, //  1712
-    0xf2ea, 0xf2e8, 0xf2e7, 0xf2e5, 0xf2e3, 0xf2e1, 0xf2df, 0xf2dd, //  1720
-    0xf2db, 0xf2d9, 0xf2d7, 0xf2d5, 0xf2d3, 0xf2d2, 0xf2d0, 0xf2ce, //  1728
-    0xf2cc, 0xf2ca, 0xf2c8, 0xf2c6, 0xf2c4, 0xf2c2, 0xf2c0, 0xf2bf, //  1736
-    0xf2bd, 0xf2bb, 0xf2b9, 0xf2b7, 0xf2b5, 0xf2b3, 0xf2b1, 0xf2af, //  1744
-    0xf2ad, 0xf2ab, 0xf2aa, 0xf2a8, 0xf2a6, 0xf2a4, 0xf2a2, 0xf2a0, //  1752
-    0xf29e, 0xf29c, 0xf29a, 0xf298, 0xf296, 0xf295, 0xf293, 0xf291, //  1760
-    0xf28f, 0xf28d, 0xf28b, 0xf289, 0xf287, 0xf285, 0xf283, 0xf281, //  1768
-    0xf280, 0xf27e, 0xf27c, 0xf27a, 0xf278, 0xf276, 0xf274, 0xf272, //  1776
-    0xf270, 0xf26e, 0xf26c, 0xf26b, 0xf269, 0xf267, 0xf265, 0xf263, //  1784
-    0xf261, 0xf25f, 0xf25d, 0xf25b, 0xf259, 0xf257, 0xf256, 0xf254, //  1792
-    0xf252, 0xf250, 0xf24e, 0xf24c, 0xf24a, 0xf248, 0xf246, 0xf244, //  1800
-    0xf242, 0xf241, 0xf23f, 0xf23d, 0xf23b, 0xf239, 0xf237, 0xf235, //  1808
-    0xf233, 0xf231, 0xf22f, 0xf22d, 0xf22c, 0xf22a, 0xf228, 0xf226, //  1816
-    0xf224, 0xf222, 0xf220, 0xf21e, 0xf21c, 0xf21a, 0xf218, 0xf217, //  1824
-    0xf215, 0xf213, 0xf211, 0xf20f, 0xf20d, 0xf20b, 0xf209, 0xf207, //  1832
-    0xf205, 0xf203, 0xf202, 0xf200, 0xf1fe, 0xf1fc, 0xf1fa, 0xf1f8, //  1840
-    0xf1f6, 0xf1f4, 0xf1f2, 0xf1f0, 0xf1ef, 0xf1ed, 0xf1eb, 0xf1e9, //  1848
-    0xf1e7, 0xf1e5, 0xf1e3, 0xf1e1, 0xf1df, 0xf1dd, 0xf1db, 0xf1da, //  1856
-    0xf1d8, 0xf1d6, 0xf1d4, 0xf1d2, 0xf1d0, 0xf1ce, 0xf1cc, 0xf1ca, //  1864
-    0xf1c8, 0xf1c6, 0xf1c5, 0xf1c3, 0xf1c1, 0xf1bf, 0xf1bd, 0xf1bb, //  1872
-    0xf1b9, 0xf1b7, 0xf1b5, 0xf1b3, 0xf1b1, 0xf1b0, 0xf1ae, 0xf1ac, //  1880
-    0xf1aa, 0xf1a8, 0xf1a6, 0xf1a4, 0xf1a2, 0xf1a0, 0xf19e, 0xf19c, //  1888
-    0xf19b, 0xf199, 0xf197, 0xf195, 0xf193, 0xf191, 0xf18f, 0xf18d, //  1896
-    0xf18b, 0xf189, 0xf187, 0xf186, 0xf184, 0xf182, 0xf180, 0xf17e, //  1904
-    0xf17c, 0xf17a, 0xf178, 0xf176, 0xf174, 0xf172, 0xf171, 0xf16f, //  1912
-    0xf16d, 0xf16b, 0xf169, 0xf167, 0xf165, 0xf163, 0xf161, 0xf15f, //  1920
-    0xf15d, 0xf15c, 0xf15a, 0xf158, 0xf156, 0xf154, 0xf152, 0xf150, //  1928
-    0xf14e, 0xf14c, 0xf14a, 0xf148, 0xf147, 0xf145, 0xf143, 0xf141, //  1936
-    0xf13f, 0xf13d, 0xf13b, 0xf139, 0xf137, 0xf135, 0xf134, 0xf132, //  1944
-    0xf130, 0xf12e, 0xf12c, 0xf12a, 0xf128, 0xf126, 0xf124, 0xf122, //  1952
-    0xf120, 0xf11f, 0xf11d, 0xf11b, 0xf119, 0xf117, 0xf115, 0xf113, //  1960
-    0xf111, 0xf10f, 0xf10d, 0xf10b, 0xf10a, 0xf108, 0xf106, 0xf104, //  1968
-    0xf102, 0xf100, 0xf0fe, 0xf0fc, 0xf0fa, 0xf0f8, 0xf0f6, 0xf0f5, //  1976
-    0xf0f3, 0xf0f1, 0xf0ef, 0xf0ed, 0xf0eb, 0xf0e9, 0xf0e7, 0xf0e5, //  1984
-    0xf0e3, 0xf0e1, 0xf0e0, 0xf0de, 0xf0dc, 0xf0da, 0xf0d8, 0xf0d6, //  1992
-    0xf0d4, 0xf0d2, 0xf0d0, 0xf0ce, 0xf0cc, 0xf0cb, 0xf0c9, 0xf0c7, //  2000
-    0xf0c5, 0xf0c3, 0xf0c1, 0xf0bf, 0xf0bd, 0xf0bb, 0xf0b9, 0xf0b7, //  2008
-    0xf0b6, 0xf0b4, 0xf0b2, 0xf0b0, 0xf0ae, 0xf0ac, 0xf0aa, 0xf0a8, //  2016
-    0xf0a6, 0xf0a4, 0xf0a2, 0xf0a1, 0xf09f, 0xf09d, 0xf09b, 0xf099, //  2024
-    0xf097, 0xf095, 0xf093, 0xf091, 0xf08f, 0xf08d, 0xf08c, 0xf08a, //  2032
-    0xf088, 0xf086, 0xf084, 0xf082, 0xf080, 0xf07e, 0xf07c, 0xf07a, //  2040
-    0xf079, 0xf077, 0xf075, 0xf073, 0xf071, 0xf06f, 0xf06d, 0xf06c, //  2048
-    0xf06a, 0xf068, 0xf066, 0xf064, 0xf062, 0xf060, 0xf05f, 0xf05d, //  2056
-    0xf05b, 0xf059, 0xf057, 0xf055, 0xf053, 0xf052, 0xf050, 0xf04e, //  2064
-    0xf04c, 0xf04a, 0xf048, 0xf046, 0xf045, 0xf043, 0xf041, 0xf03f, //  2072
-    0xf03d, 0xf03b, 0xf039, 0xf038, 0xf036, 0xf034, 0xf032, 0xf030, //  2080
-    0xf02e, 0xf02d, 0xf02b, 0xf029, 0xf027, 0xf025, 0xf023, 0xf021, //  2088
-    0xf020, 0xf01e, 0xf01c, 0xf01a, 0xf018, 0xf016, 0xf014, 0xf013, //  2096
-    0xf011, 0xf00f, 0xf00d, 0xf00b, 0xf009, 0xf007, 0xf006, 0xf004, //  2104
-    0xf002, 0xf000, 0xeffe, 0xeffc, 0xeffa, 0xeff9, 0xeff7, 0xeff5, //  2112
-    0xeff3, 0xeff1, 0xefef, 0xefed, 0xefec, 0xefea, 0xefe8, 0xefe6, //  2120
-    0xefe4, 0xefe2, 0xefe1, 0xefdf, 0xefdd, 0xefdb, 0xefd9, 0xefd7, //  2128
-    0xefd5, 0xefd4, 0xefd2, 0xefd0, 0xefce, 0xefcc, 0xefca, 0xefc8, //  2136
-    0xefc7, 0xefc5, 0xefc3, 0xefc1, 0xefbf, 0xefbd, 0xefbb, 0xefba, //  2144
-    0xefb8, 0xefb6, 0xefb4, 0xefb2, 0xefb0, 0xefae, 0xefad, 0xefab, //  2152
-    0xefa9, 0xefa7, 0xefa5, 0xefa3, 0xefa1, 0xefa0, 0xef9e, 0xef9c, //  2160
-    0xef9a, 0xef98, 0xef96, 0xef95, 0xef93, 0xef91, 0xef8f, 0xef8d, //  2168
-    0xef8b, 0xef89, 0xef88, 0xef86, 0xef84, 0xef82, 0xef80, 0xef7e, //  2176
-    0xef7c, 0xef7b, 0xef79, 0xef77, 0xef75, 0xef73, 0xef71, 0xef6f, //  2184
-    0xef6e, 0xef6c, 0xef6a, 0xef68, 0xef66, 0xef64, 0xef62, 0xef61, //  2192
-    0xef5f, 0xef5d, 0xef5b, 0xef59, 0xef57, 0xef55, 0xef54, 0xef52, //  2200
-    0xef50, 0xef4e, 0xef4c, 0xef4a, 0xef49, 0xef47, 0xef45, 0xef43, //  2208
-    0xef41, 0xef3f, 0xef3d, 0xef3c, 0xef3a, 0xef38, 0xef36, 0xef34, //  2216
-    0xef32, 0xef30, 0xef2f, 0xef2d, 0xef2b, 0xef29, 0xef27, 0xef25, //  2224
-    0xef23, 0xef22, 0xef20, 0xef1e, 0xef1c, 0xef1a, 0xef18, 0xef16, //  2232
-    0xef15, 0xef13, 0xef11, 0xef0f, 0xef0d, 0xef0b, 0xef0a, 0xef08, //  2240
-    0xef06, 0xef04, 0xef02, 0xef00, 0xeefe, 0xeefd, 0xeefb, 0xeef9, //  2248
-    0xeef7, 0xeef5, 0xeef3, 0xeef1, 0xeef0, 0xeeee, 0xeeec, 0xeeea, //  2256
-    0xeee8, 0xeee6, 0xeee4, 0xeee3, 0xeee1, 0xeedf, 0xeedd, 0xeedb, //  2264
-    0xeed9, 0xeed7, 0xeed6, 0xeed4, 0xeed2, 0xeed0, 0xeece, 0xeecc, //  2272
-    0xeeca, 0xeec9, 0xeec7, 0xeec5, 0xeec3, 0xeec1, 0xeebf, 0xeebe, //  2280
-    0xeebc, 0xeeba, 0xeeb8, 0xeeb6, 0xeeb4, 0xeeb2, 0xeeb1, 0xeeaf, //  2288
-    0xeead, 0xeeab, 0xeea9, 0xeea7, 0xeea5, 0xeea4, 0xeea2, 0xeea0, //  2296
-    0xee9e, 0xee9c, 0xee9a, 0xee98, 0xee97, 0xee95, 0xee93, 0xee91, //  2304
-    0xee8f, 0xee8d, 0xee8b, 0xee8a, 0xee88, 0xee86, 0xee84, 0xee82, //  2312
-    0xee80, 0xee7e, 0xee7d, 0xee7b, 0xee79, 0xee77, 0xee75, 0xee73, //  2320
-    0xee72, 0xee70, 0xee6e, 0xee6c, 0xee6a, 0xee68, 0xee66, 0xee65, //  2328
-    0xee63, 0xee61, 0xee5f, 0xee5d, 0xee5b, 0xee59, 0xee58, 0xee56, //  2336
-    0xee54, 0xee52, 0xee50, 0xee4e, 0xee4c, 0xee4b, 0xee49, 0xee47, //  2344
-    0xee45, 0xee43, 0xee41, 0xee3f, 0xee3e, 0xee3c, 0xee3a, 0xee38, //  2352
-    0xee36, 0xee34, 0xee32, 0xee31, 0xee2f, 0xee2d, 0xee2b, 0xee29, //  2360
-    0xee27, 0xee26, 0xee24, 0xee22, 0xee20, 0xee1e, 0xee1c, 0xee1a, //  2368
-    0xee19, 0xee17, 0xee15, 0xee13, 0xee11, 0xee0f, 0xee0d, 0xee0c, //  2376
-    0xee0a, 0xee08, 0xee06, 0xee04, 0xee02, 0xee00, 0xedff, 0xedfd, //  2384
-    0xedfb, 0xedf9, 0xedf7, 0xedf5, 0xedf3, 0xedf2, 0xedf0, 0xedee, //  2392
-    0xedec, 0xedea, 0xede8, 0xede7, 0xede5, 0xede3, 0xede1, 0xeddf, //  2400
-    0xeddd, 0xeddb, 0xedda, 0xedd8, 0xedd6, 0xedd4, 0xedd2, 0xedd0, //  2408
-    0xedce, 0xedcd, 0xedcb, 0xedc9, 0xedc7, 0xedc5, 0xedc3, 0xedc1, //  2416
-    0xedc0, 0xedbe, 0xedbc, 0xedba, 0xedb8, 0xedb6, 0xedb4, 0xedb3, //  2424
-    0xedb1, 0xedaf, 0xedad, 0xedab, 0xeda9, 0xeda7, 0xeda6, 0xeda4, //  2432
-    0xeda2, 0xeda0, 0xed9e, 0xed9c, 0xed9b, 0xed99, 0xed97, 0xed95, //  2440
-    0xed93, 0xed91, 0xed8f, 0xed8e, 0xed8c, 0xed8a, 0xed88, 0xed86, //  2448
-    0xed84, 0xed82, 0xed81, 0xed7f, 0xed7d, 0xed7b, 0xed79, 0xed77, //  2456
-    0xed75, 0xed74, 0xed72, 0xed70, 0xed6e, 0xed6c, 0xed6a, 0xed68, //  2464
-    0xed67, 0xed65, 0xed63, 0xed61, 0xed5f, 0xed5d, 0xed5b, 0xed5a, //  2472
-    0xed58, 0xed56, 0xed54, 0xed52, 0xed50, 0xed4f, 0xed4d, 0xed4b, //  2480
-    0xed49, 0xed47, 0xed45, 0xed43, 0xed42, 0xed40, 0xed3e, 0xed3c, //  2488
-    0xed3a, 0xed38, 0xed36, 0xed35, 0xed33, 0xed31, 0xed2f, 0xed2d, //  2496
-    0xed2b, 0xed29, 0xed28, 0xed26, 0xed24, 0xed22, 0xed20, 0xed1e, //  2504
-    0xed1c, 0xed1b, 0xed19, 0xed17, 0xed15, 0xed13, 0xed11, 0xed0f, //  2512
-    0xed0e, 0xed0c, 0xed0a, 0xed08, 0xed06, 0xed04, 0xed03, 0xed01, //  2520
-    0xecff, 0xecfd, 0xecfb, 0xecf9, 0xecf7, 0xecf6, 0xecf4, 0xecf2, //  2528
-    0xecf0, 0xecee, 0xecec, 0xecea, 0xece9, 0xece7, 0xece5, 0xece3, //  2536
-    0xece1, 0xecdf, 0xecdd, 0xecdc, 0xecda, 0xecd8, 0xecd6, 0xecd4, //  2544
-    0xecd2, 0xecd0, 0xeccf, 0xeccd, 0xeccb, 0xecc9, 0xecc7, 0xecc5, //  2552
-    0xecc4, 0xecc2, 0xecc0, 0xecbe, 0xecbc, 0xecba, 0xecb8, 0xecb7, //  2560
-    0xecb5, 0xecb3, 0xecb1, 0xecaf, 0xecad, 0xecab, 0xecaa, 0xeca8, //  2568
-    0xeca6, 0xeca4, 0xeca2, 0xeca0, 0xec9e, 0xec9d, 0xec9b, 0xec99, //  2576
-    0xec97, 0xec95, 0xec93, 0xec91, 0xec90, 0xec8e, 0xec8c, 0xec8a, //  2584
-    0xec88, 0xec86, 0xec84, 0xec83, 0xec81, 0xec7f, 0xec7d, 0xec7b, //  2592
-    0xec79, 0xec78, 0xec76, 0xec74, 0xec72, 0xec70, 0xec6e, 0xec6c, //  2600
-    0xec6b, 0xec69, 0xec67, 0xec65, 0xec63, 0xec61, 0xec5f, 0xec5e, //  2608
-    0xec5c, 0xec5a, 0xec58, 0xec56, 0xec54, 0xec52, 0xec51, 0xec4f, //  2616
-    0xec4d, 0xec4b, 0xec49, 0xec47, 0xec45, 0xec44, 0xec42, 0xec40, //  2624
-    0xec3e, 0xec3c, 0xec3a, 0xec38, 0xec37, 0xec35, 0xec33, 0xec31, //  2632
-    0xec2f, 0xec2d, 0xec2c, 0xec2a, 0xec28, 0xec26, 0xec24, 0xec22, //  2640
-    0xec20, 0xec1f, 0xec1d, 0xec1b, 0xec19, 0xec17, 0xec15, 0xec13, //  2648
-    0xec12, 0xec10, 0xec0e, 0xec0c, 0xec0a, 0xec08, 0xec06, 0xec05, //  2656
-    0xec03, 0xec01, 0xebff, 0xebfd, 0xebfb, 0xebf9, 0xebf8, 0xebf6, //  2664
-    0xebf4, 0xebf2, 0xebf0, 0xebee, 0xebec, 0xebeb, 0xebe9, 0xebe7, //  2672
-    0xebe5, 0xebe3, 0xebe1, 0xebe0, 0xebde, 0xebdc, 0xebda, 0xebd8, //  2680
-    0xebd6, 0xebd4, 0xebd3, 0xebd1, 0xebcf, 0xebcd, 0xebcb, 0xebc9, //  2688
-    0xebc7, 0xebc6, 0xebc4, 0xebc2, 0xebc0, 0xebbe, 0xebbc, 0xebba, //  2696
-    0xebb9, 0xebb7, 0xebb5, 0xebb3, 0xebb1, 0xebaf, 0xebad, 0xebac, //  2704
-    0xebaa, 0xeba8, 0xeba6, 0xeba4, 0xeba2, 0xeba0, 0xeb9f, 0xeb9d, //  2712
-    0xeb9b, 0xeb99, 0xeb97, 0xeb95, 0xeb94, 0xeb92, 0xeb90, 0xeb8e, //  2720
-    0xeb8c, 0xeb8a, 0xeb88, 0xeb87, 0xeb85, 0xeb83, 0xeb81, 0xeb7f, //  2728
-    0xeb7d, 0xeb7b, 0xeb7a, 0xeb78, 0xeb76, 0xeb74, 0xeb72, 0xeb70, //  2736
-    0xeb6e, 0xeb6d, 0xeb6b, 0xeb69, 0xeb67, 0xeb65, 0xeb63, 0xeb61, //  2744
-    0xeb60, 0xeb5e, 0xeb5c, 0xeb5a, 0xeb58, 0xeb56, 0xeb55, 0xeb53, //  2752
-    0xeb51, 0xeb4f, 0xeb4d, 0xeb4b, 0xeb49, 0xeb48, 0xeb46, 0xeb44, //  2760
-    0xeb42, 0xeb40, 0xeb3e, 0xeb3c, 0xeb3b, 0xeb39, 0xeb37, 0xeb35, //  2768
-    0xeb33, 0xeb31, 0xeb2f, 0xeb2e, 0xeb2c, 0xeb2a, 0xeb28, 0xeb26, //  2776
-    0xeb24, 0xeb22, 0xeb21, 0xeb1f, 0xeb1d, 0xeb1b, 0xeb19, 0xeb17, //  2784
-    0xeb15, 0xeb14, 0xeb12, 0xeb10, 0xeb0e, 0xeb0c, 0xeb0a, 0xeb09, //  2792
-    0xeb07, 0xeb05, 0xeb03, 0xeb01, 0xeaff, 0xeafd, 0xeafc, 0xeafa, //  2800
-    0xeaf8, 0xeaf6, 0xeaf4, 0xeaf2, 0xeaf0, 0xeaef, 0xeaed, 0xeaeb, //  2808
-    0xeae9, 0xeae7, 0xeae5, 0xeae3, 0xeae2, 0xeae0, 0xeade, 0xeadc, //  2816
-    0xeada, 0xead8, 0xead6, 0xead5, 0xead3, 0xead1, 0xeacf, 0xeacd, //  2824
-    0xeacb, 0xeac9, 0xeac8, 0xeac6, 0xeac4, 0xeac2, 0xeac0, 0xeabe, //  2832
-    0xeabd, 0xeabb, 0xeab9, 0xeab7, 0xeab5, 0xeab3, 0xeab1, 0xeab0, //  2840
-    0xeaae, 0xeaac, 0xeaaa, 0xeaa8, 0xeaa6, 0xeaa4, 0xeaa3, 0xeaa1, //  2848
-    0xea9f, 0xea9d, 0xea9b, 0xea99, 0xea97, 0xea96, 0xea94, 0xea92, //  2856
-    0xea90, 0xea8e, 0xea8c, 0xea8a, 0xea89, 0xea87, 0xea85, 0xea83, //  2864
-    0xea81, 0xea7f, 0xea7d, 0xea7c, 0xea7a, 0xea78, 0xea76, 0xea74, //  2872
-    0xea72, 0xea71, 0xea6f, 0xea6d, 0xea6b, 0xea69, 0xea67, 0xea65, //  2880
-    0xea64, 0xea62, 0xea60, 0xea5e, 0xea5c, 0xea5a, 0xea58, 0xea57, //  2888
-    0xea55, 0xea53, 0xea51, 0xea4f, 0xea4d, 0xea4b, 0xea4a, 0xea48, //  2896
-    0xea46, 0xea44, 0xea42, 0xea40, 0xea3e, 0xea3d, 0xea3b, 0xea39, //  2904
-    0xea37, 0xea35, 0xea33, 0xea32, 0xea30, 0xea2e, 0xea2c, 0xea2a, //  2912
-    0xea28, 0xea26, 0xea25, 0xea23, 0xea21, 0xea1f, 0xea1d, 0xea1b, //  2920
-    0xea19, 0xea18, 0xea16, 0xea14, 0xea12, 0xea10, 0xea0e, 0xea0c, //  2928
-    0xea0b, 0xea09, 0xea07, 0xea05, 0xea03, 0xea01, 0xe9ff, 0xe9fe, //  2936
-    0xe9fc, 0xe9fa, 0xe9f8, 0xe9f6, 0xe9f4, 0xe9f2, 0xe9f1, 0xe9ef, //  2944
-    0xe9ed, 0xe9eb, 0xe9e9, 0xe9e7, 0xe9e6, 0xe9e4, 0xe9e2, 0xe9e0, //  2952
-    0xe9de, 0xe9dc, 0xe9da, 0xe9d9, 0xe9d7, 0xe9d5, 0xe9d3, 0xe9d1, //  2960
-    0xe9cf, 0xe9cd, 0xe9cc, 0xe9ca, 0xe9c8, 0xe9c6, 0xe9c4, 0xe9c2, //  2968
-    0xe9c0, 0xe9bf, 0xe9bd, 0xe9bb, 0xe9b9, 0xe9b7, 0xe9b5, 0xe9b3, //  2976
-    0xe9b2, 0xe9b0, 0xe9ae, 0xe9ac, 0xe9aa, 0xe9a8, 0xe9a6, 0xe9a5, //  2984
-    0xe9a3, 0xe9a1, 0xe99f, 0xe99d, 0xe99b, 0xe99a, 0xe998, 0xe996, //  2992
-    0xe994, 0xe992, 0xe990, 0xe98e, 0xe98d, 0xe98b, 0xe989, 0xe987, //  3000
-    0xe985, 0xe983, 0xe981, 0xe980, 0xe97e, 0xe97c, 0xe97a, 0xe978, //  3008
-    0xe976, 0xe974, 0xe973, 0xe971, 0xe96f, 0xe96d, 0xe96b, 0xe969, //  3016
-    0xe967, 0xe966, 0xe964, 0xe962, 0xe960, 0xe95e, 0xe95c, 0xe95a, //  3024
-    0xe959, 0xe957, 0xe955, 0xe953, 0xe951, 0xe94f, 0xe94e, 0xe94c, //  3032
-    0xe94a, 0xe948, 0xe946, 0xe944, 0xe942, 0xe941, 0xe93f, 0xe93d, //  3040
-    0xe93b, 0xe939, 0xe937, 0xe935, 0xe934, 0xe932, 0xe930, 0xe92e, //  3048
-    0xe92c, 0xe92a, 0xe928, 0xe927, 0xe925, 0xe923, 0xe921, 0xe91f, //  3056
-    0xe91d, 0xe91b, 0xe91a, 0xe918, 0xe916, 0xe914, 0xe912, 0xe910, //  3064
-    0xe910, 0xe90e, 0xe90c, 0xe90a, 0xe908, 0xe907, 0xe905, 0xe903, //  3072
-    0xe901, 0xe8ff, 0xe8fe, 0xe8fc, 0xe8fa, 0xe8f8, 0xe8f6, 0xe8f5, //  3080
-    0xe8f3, 0xe8f1, 0xe8ef, 0xe8ed, 0xe8ec, 0xe8ea, 0xe8e8, 0xe8e6, //  3088
-    0xe8e4, 0xe8e3, 0xe8e1, 0xe8df, 0xe8dd, 0xe8db, 0xe8da, 0xe8d8, //  3096
-    0xe8d6, 0xe8d4, 0xe8d2, 0xe8d1, 0xe8cf, 0xe8cd, 0xe8cb, 0xe8c9, //  3104
-    0xe8c8, 0xe8c6, 0xe8c4, 0xe8c2, 0xe8c0, 0xe8bf, 0xe8bd, 0xe8bb, //  3112
-    0xe8b9, 0xe8b7, 0xe8b6, 0xe8b4, 0xe8b2, 0xe8b0, 0xe8ae, 0xe8ad, //  3120
-    0xe8ab, 0xe8a9, 0xe8a7, 0xe8a5, 0xe8a4, 0xe8a2, 0xe8a0, 0xe89e, //  3128
-    0xe89c, 0xe89b, 0xe899, 0xe897, 0xe895, 0xe893, 0xe892, 0xe890, //  3136
-    0xe88e, 0xe88c, 0xe88a, 0xe889, 0xe887, 0xe885, 0xe883, 0xe881, //  3144
-    0xe880, 0xe87e, 0xe87c, 0xe87a, 0xe878, 0xe877, 0xe875, 0xe873, //  3152
-    0xe871, 0xe86f, 0xe86e, 0xe86c, 0xe86a, 0xe868, 0xe866, 0xe865, //  3160
-    0xe863, 0xe861, 0xe85f, 0xe85d, 0xe85c, 0xe85a, 0xe858, 0xe856, //  3168
-    0xe854, 0xe853, 0xe851, 0xe84f, 0xe84d, 0xe84b, 0xe84a, 0xe848, //  3176
-    0xe846, 0xe844, 0xe842, 0xe841, 0xe83f, 0xe83d, 0xe83b, 0xe839, //  3184
-    0xe838, 0xe836, 0xe834, 0xe832, 0xe830, 0xe82f, 0xe82d, 0xe82b, //  3192
-    0xe829, 0xe827, 0xe826, 0xe824, 0xe822, 0xe820, 0xe81e, 0xe81d, //  3200
-    0xe81b, 0xe819, 0xe817, 0xe815, 0xe814, 0xe812, 0xe810, 0xe80e, //  3208
-    0xe80c, 0xe80b, 0xe809, 0xe807, 0xe805, 0xe803, 0xe802, 0xe800, //  3216
-    0xe7fe, 0xe7fc, 0xe7fa, 0xe7f9, 0xe7f7, 0xe7f5, 0xe7f3, 0xe7f1, //  3224
-    0xe7f0, 0xe7ee, 0xe7ec, 0xe7ea, 0xe7e8, 0xe7e7, 0xe7e5, 0xe7e3, //  3232
-    0xe7e1, 0xe7df, 0xe7de, 0xe7dc, 0xe7da, 0xe7d8, 0xe7d7, 0xe7d5, //  3240
-    0xe7d3, 0xe7d1, 0xe7cf, 0xe7ce, 0xe7cc, 0xe7ca, 0xe7c8, 0xe7c6, //  3248
-    0xe7c5, 0xe7c3, 0xe7c1, 0xe7bf, 0xe7bd, 0xe7bc, 0xe7ba, 0xe7b8, //  3256
-    0xe7b6, 0xe7b4, 0xe7b3, 0xe7b1, 0xe7af, 0xe7ad, 0xe7ab, 0xe7aa, //  3264
-    0xe7a8, 0xe7a6, 0xe7a4, 0xe7a2, 0xe7a1, 0xe79f, 0xe79d, 0xe79b, //  3272
-    0xe799, 0xe798, 0xe796, 0xe794, 0xe792, 0xe790, 0xe78f, 0xe78d, //  3280
-    0xe78b, 0xe789, 0xe787, 0xe786, 0xe784, 0xe782, 0xe780, 0xe77e, //  3288
-    0xe77d, 0xe77b, 0xe779, 0xe777, 0xe775, 0xe774, 0xe772, 0xe770, //  3296
-    0xe76e, 0xe76c, 0xe76b, 0xe769, 0xe767, 0xe765, 0xe763, 0xe762, //  3304
-    0xe760, 0xe75e, 0xe75c, 0xe75a, 0xe759, 0xe757, 0xe755, 0xe753, //  3312
-    0xe751, 0xe750, 0xe74e, 0xe74c, 0xe74a, 0xe748, 0xe747, 0xe745, //  3320
-    0xe743, 0xe741, 0xe73f, 0xe73e, 0xe73c, 0xe73a, 0xe738, 0xe736, //  3328
-    0xe735, 0xe733, 0xe731, 0xe72f, 0xe72d, 0xe72c, 0xe72a, 0xe728, //  3336
-    0xe726, 0xe724, 0xe723, 0xe721, 0xe71f, 0xe71d, 0xe71b, 0xe71a, //  3344
-    0xe718, 0xe716, 0xe714, 0xe712, 0xe711, 0xe70f, 0xe70d, 0xe70b, //  3352
-    0xe709, 0xe708, 0xe706, 0xe704, 0xe702, 0xe700, 0xe6ff, 0xe6fd, //  3360
-    0xe6fb, 0xe6f9, 0xe6f7, 0xe6f6, 0xe6f4, 0xe6f2, 0xe6f0, 0xe6ee, //  3368
-    0xe6ed, 0xe6eb, 0xe6e9, 0xe6e7, 0xe6e5, 0xe6e4, 0xe6e2, 0xe6e0, //  3376
-    0xe6de, 0xe6dc, 0xe6db, 0xe6d9, 0xe6d7, 0xe6d5, 0xe6d3, 0xe6d2, //  3384
-    0xe6d0, 0xe6ce, 0xe6cc, 0xe6ca, 0xe6c9, 0xe6c7, 0xe6c5, 0xe6c3, //  3392
-    0xe6c1, 0xe6c0, 0xe6be, 0xe6bc, 0xe6ba, 0xe6b8, 0xe6b7, 0xe6b5, //  3400
-    0xe6b3, 0xe6b1, 0xe6af, 0xe6ae, 0xe6ac, 0xe6aa, 0xe6a8, 0xe6a7, //  3408
-    0xe6a5, 0xe6a3, 0xe6a1, 0xe69f, 0xe69e, 0xe69c, 0xe69a, 0xe698, //  3416
-    0xe696, 0xe695, 0xe693, 0xe691, 0xe68f, 0xe68d, 0xe68c, 0xe68a, //  3424
-    0xe688, 0xe686, 0xe684, 0xe683, 0xe681, 0xe67f, 0xe67d, 0xe67b, //  3432
-    0xe67a, 0xe678, 0xe676, 0xe674, 0xe672, 0xe671, 0xe66f, 0xe66d, //  3440
-    0xe66b, 0xe669, 0xe668, 0xe666, 0xe664, 0xe662, 0xe660, 0xe65f, //  3448
-    0xe65d, 0xe65b, 0xe659, 0xe657, 0xe656, 0xe654, 0xe652, 0xe650, //  3456
-    0xe64e, 0xe64d, 0xe64b, 0xe649, 0xe647, 0xe645, 0xe644, 0xe642, //  3464
-    0xe640, 0xe63e, 0xe63c, 0xe63b, 0xe639, 0xe637, 0xe635, 0xe633, //  3472
-    0xe632, 0xe630, 0xe62e, 0xe62c, 0xe62a, 0xe629, 0xe627, 0xe625, //  3480
-    0xe623, 0xe621, 0xe620, 0xe61e, 0xe61c, 0xe61a, 0xe618, 0xe617, //  3488
-    0xe615, 0xe613, 0xe611, 0xe60f, 0xe60e, 0xe60c, 0xe60a, 0xe608, //  3496
-    0xe606, 0xe605, 0xe603, 0xe601, 0xe5ff, 0xe5fd, 0xe5fc, 0xe5fa, //  3504
-    0xe5f8, 0xe5f6, 0xe5f4, 0xe5f3, 0xe5f1, 0xe5ef, 0xe5ed, 0xe5eb, //  3512
-    0xe5ea, 0xe5e8, 0xe5e6, 0xe5e4, 0xe5e2, 0xe5e1, 0xe5df, 0xe5dd, //  3520
-    0xe5db, 0xe5d9, 0xe5d8, 0xe5d6, 0xe5d4, 0xe5d2, 0xe5d0, 0xe5cf, //  3528
-    0xe5cd, 0xe5cb, 0xe5c9, 0xe5c7, 0xe5c6, 0xe5c4, 0xe5c2, 0xe5c0, //  3536
-    0xe5be, 0xe5bd, 0xe5bb, 0xe5b9, 0xe5b7, 0xe5b5, 0xe5b4, 0xe5b2, //  3544
-    0xe5b0, 0xe5ae, 0xe5ac, 0xe5ab, 0xe5a9, 0xe5a7, 0xe5a5, 0xe5a3, //  3552
-    0xe5a2, 0xe5a0, 0xe59e, 0xe59c, 0xe59a, 0xe599, 0xe597, 0xe595, //  3560
-    0xe593, 0xe591, 0xe590, 0xe58e, 0xe58c, 0xe58a, 0xe588, 0xe587, //  3568
-    0xe585, 0xe583, 0xe581, 0xe57f, 0xe57e, 0xe57c, 0xe57a, 0xe578, //  3576
-    0xe577, 0xe575, 0xe573, 0xe571, 0xe56f, 0xe56e, 0xe56c, 0xe56a, //  3584
-    0xe568, 0xe566, 0xe565, 0xe563, 0xe561, 0xe55f, 0xe55d, 0xe55c, //  3592
-    0xe55a, 0xe558, 0xe556, 0xe554, 0xe553, 0xe551, 0xe54f, 0xe54d, //  3600
-    0xe54b, 0xe54a, 0xe548, 0xe546, 0xe544, 0xe542, 0xe541, 0xe53f, //  3608
-    0xe53d, 0xe53b, 0xe539, 0xe538, 0xe536, 0xe534, 0xe532, 0xe530, //  3616
-    0xe52f, 0xe52d, 0xe52b, 0xe529, 0xe527, 0xe526, 0xe524, 0xe522, //  3624
-    0xe520, 0xe51e, 0xe51d, 0xe51b, 0xe519, 0xe517, 0xe515, 0xe514, //  3632
-    0xe512, 0xe510, 0xe50e, 0xe50c, 0xe50b, 0xe509, 0xe507, 0xe505, //  3640
-    0xe503, 0xe502, 0xe500, 0xe4fe, 0xe4fc, 0xe4fa, 0xe4f9, 0xe4f7, //  3648
-    0xe4f5, 0xe4f3, 0xe4f1, 0xe4f0, 0xe4ee, 0xe4ec, 0xe4ea, 0xe4e8, //  3656
-    0xe4e7, 0xe4e5, 0xe4e3, 0xe4e1, 0xe4df, 0xe4de, 0xe4dc, 0xe4da, //  3664
-    0xe4d8, 0xe4d6, 0xe4d5, 0xe4d3, 0xe4d1, 0xe4cf, 0xe4cd, 0xe4cc, //  3672
-    0xe4ca, 0xe4c8, 0xe4c6, 0xe4c4, 0xe4c3, 0xe4c1, 0xe4bf, 0xe4bd, //  3680
-    0xe4bb, 0xe4ba, 0xe4b8, 0xe4b6, 0xe4b4, 0xe4b2, 0xe4b1, 0xe4af, //  3688
-    0xe4ad, 0xe4ab, 0xe4a9, 0xe4a8, 0xe4a6, 0xe4a4, 0xe4a2, 0xe4a0, //  3696
-    0xe49f, 0xe49d, 0xe49b, 0xe499, 0xe497, 0xe496, 0xe494, 0xe492, //  3704
-    0xe490, 0xe48e, 0xe48d, 0xe48b, 0xe489, 0xe487, 0xe485, 0xe484, //  3712
-    0xe482, 0xe480, 0xe47e, 0xe47c, 0xe47b, 0xe479, 0xe477, 0xe475, //  3720
-    0xe473, 0xe472, 0xe470, 0xe46e, 0xe46c, 0xe46a, 0xe469, 0xe467, //  3728
-    0xe465, 0xe463, 0xe461, 0xe460, 0xe45e, 0xe45c, 0xe45a, 0xe458, //  3736
-    0xe457, 0xe455, 0xe453, 0xe451, 0xe44f, 0xe44e, 0xe44c, 0xe44a, //  3744
-    0xe448, 0xe446, 0xe445, 0xe443, 0xe441, 0xe43f, 0xe43e, 0xe43c, //  3752
-    0xe43a, 0xe438, 0xe436, 0xe435, 0xe433, 0xe431, 0xe42f, 0xe42d, //  3760
-    0xe42c, 0xe42a, 0xe428, 0xe426, 0xe424, 0xe423, 0xe421, 0xe41f, //  3768
-    0xe41d, 0xe41b, 0xe41a, 0xe418, 0xe416, 0xe414, 0xe412, 0xe411, //  3776
-    0xe40f, 0xe40d, 0xe40b, 0xe409, 0xe408, 0xe406, 0xe404, 0xe402, //  3784
-    0xe400, 0xe3ff, 0xe3fd, 0xe3fb, 0xe3f9, 0xe3f7, 0xe3f6, 0xe3f4, //  3792
-    0xe3f2, 0xe3f0, 0xe3ee, 0xe3ed, 0xe3eb, 0xe3e9, 0xe3e7, 0xe3e5, //  3800
-    0xe3e4, 0xe3e2, 0xe3e0, 0xe3de, 0xe3dc, 0xe3db, 0xe3d9, 0xe3d7, //  3808
-    0xe3d5, 0xe3d3, 0xe3d2, 0xe3d0, 0xe3ce, 0xe3cc, 0xe3ca, 0xe3c9, //  3816
-    0xe3c7, 0xe3c5, 0xe3c3, 0xe3c1, 0xe3c0, 0xe3be, 0xe3bc, 0xe3ba, //  3824
-    0xe3b8, 0xe3b7, 0xe3b5, 0xe3b3, 0xe3b1, 0xe3af, 0xe3ae, 0xe3ac, //  3832
-    0xe3aa, 0xe3a8, 0xe3a6, 0xe3a5, 0xe3a3, 0xe3a1, 0xe39f, 0xe39d, //  3840
-    0xe39c, 0xe39a, 0xe398, 0xe396, 0xe394, 0xe393, 0xe391, 0xe38f, //  3848
-    0xe38d, 0xe38b, 0xe38a, 0xe388, 0xe386, 0xe384, 0xe382, 0xe381, //  3856
-    0xe37f, 0xe37d, 0xe37b, 0xe379, 0xe378, 0xe376, 0xe374, 0xe372, //  3864
-    0xe370, 0xe36f, 0xe36d, 0xe36b, 0xe369, 0xe367, 0xe366, 0xe364, //  3872
-    0xe362, 0xe360, 0xe35e, 0xe35d, 0xe35b, 0xe359, 0xe357, 0xe355, //  3880
-    0xe354, 0xe352, 0xe350, 0xe34e, 0xe34c, 0xe34b, 0xe349, 0xe347, //  3888
-    0xe345, 0xe343, 0xe342, 0xe340, 0xe33e, 0xe33c, 0xe33a, 0xe339, //  3896
-    0xe337, 0xe335, 0xe333, 0xe331, 0xe330, 0xe32e, 0xe32c, 0xe32a, //  3904
-    0xe328, 0xe327, 0xe325, 0xe323, 0xe321, 0xe31f, 0xe31e, 0xe31c, //  3912
-    0xe31a, 0xe318, 0xe316, 0xe315, 0xe313, 0xe311, 0xe30f, 0xe30e, //  3920
-    0xe30c, 0xe30a, 0xe308, 0xe306, 0xe305, 0xe303, 0xe301, 0xe2ff, //  3928
-    0xe2fd, 0xe2fc, 0xe2fa, 0xe2f8, 0xe2f6, 0xe2f4, 0xe2f3, 0xe2f1, //  3936
-    0xe2ef, 0xe2ed, 0xe2eb, 0xe2ea, 0xe2e8, 0xe2e6, 0xe2e4, 0xe2e2, //  3944
-    0xe2e1, 0xe2df, 0xe2dd, 0xe2db, 0xe2d9, 0xe2d8, 0xe2d6, 0xe2d4, //  3952
-    0xe2d2, 0xe2d0, 0xe2cf, 0xe2cd, 0xe2cb, 0xe2c9, 0xe2c7, 0xe2c6, //  3960
-    0xe2c4, 0xe2c2, 0xe2c0, 0xe2be, 0xe2bd, 0xe2bb, 0xe2b9, 0xe2b7, //  3968
-    0xe2b5, 0xe2b4, 0xe2b2, 0xe2b0, 0xe2ae, 0xe2ac, 0xe2ab, 0xe2a9, //  3976
-    0xe2a7, 0xe2a5, 0xe2a3, 0xe2a2, 0xe2a0, 0xe29e, 0xe29c, 0xe29a, //  3984
-    0xe299, 0xe297, 0xe295, 0xe293, 0xe291, 0xe290, 0xe28e, 0xe28c, //  3992
-    0xe28a, 0xe288, 0xe287, 0xe285, 0xe283, 0xe281, 0xe27f, 0xe27e, //  4000
-    0xe27c, 0xe27a, 0xe278, 0xe276, 0xe275, 0xe273, 0xe271, 0xe26f, //  4008
-    0xe26d, 0xe26c, 0xe26a, 0xe268, 0xe266, 0xe264, 0xe263, 0xe261, //  4016
-    0xe25f, 0xe25d, 0xe25b, 0xe25a, 0xe258, 0xe256, 0xe254, 0xe252, //  4024
-    0xe251, 0xe24f, 0xe24d, 0xe24b, 0xe249, 0xe248, 0xe246, 0xe244, //  4032
-    0xe242, 0xe240, 0xe23f, 0xe23d, 0xe23b, 0xe239, 0xe237, 0xe236, //  4040
-    0xe234, 0xe232, 0xe230, 0xe22e, 0xe22d, 0xe22b, 0xe229, 0xe227, //  4048
-    0xe225, 0xe224, 0xe222, 0xe220, 0xe21e, 0xe21c, 0xe21b, 0xe219, //  4056
-    0xe217, 0xe215, 0xe213, 0xe212, 0xe210, 0xe20e, 0xe20c, 0xe20a, //  4064
-    0xe209, 0xe207, 0xe205, 0xe203, 0xe201, 0xe200, 0xe1fe, 0xe1fc, //  4072
-    0xe1fa, 0xe1f8, 0xe1f7, 0xe1f5, 0xe1f3, 0xe1f1, 0xe1ef, 0xe1ee, //  4080
-    0xe1ec, 0xe1ea, 0xe1e8, 0xe1e6, 0xe1e5, 0xe1e3, 0xe1e1, 0xe1df, //  4088
-    0xe1dd, 0xe1db, 0xe1da, 0xe1d8, 0xe1d6, 0xe1d4, 0xe1d3, 0xe1d1, //  4096
-    0xe1cf, 0xe1cd, 0xe1cc, 0xe1ca, 0xe1c8, 0xe1c6, 0xe1c5, 0xe1c3, //  4104
-    0xe1c1, 0xe1bf, 0xe1be, 0xe1bc, 0xe1ba, 0xe1b8, 0xe1b7, 0xe1b5, //  4112
-    0xe1b3, 0xe1b1, 0xe1b0, 0xe1ae, 0xe1ac, 0xe1aa, 0xe1a9, 0xe1a7, //  4120
-    0xe1a5, 0xe1a3, 0xe1a2, 0xe1a0, 0xe19e, 0xe19c, 0xe19b, 0xe199, //  4128
-    0xe197, 0xe195, 0xe194, 0xe192, 0xe190, 0xe18f, 0xe18d, 0xe18b, //  4136
-    0xe189, 0xe188, 0xe186, 0xe184, 0xe182, 0xe181, 0xe17f, 0xe17d, //  4144
-    0xe17b, 0xe17a, 0xe178, 0xe176, 0xe174, 0xe173, 0xe171, 0xe16f, //  4152
-    0xe16d, 0xe16c, 0xe16a, 0xe168, 0xe166, 0xe165, 0xe163, 0xe161, //  4160
-    0xe15f, 0xe15e, 0xe15c, 0xe15a, 0xe158, 0xe157, 0xe155, 0xe153, //  4168
-    0xe151, 0xe150, 0xe14e, 0xe14c, 0xe14a, 0xe149, 0xe147, 0xe145, //  4176
-    0xe144, 0xe142, 0xe140, 0xe13e, 0xe13d, 0xe13b, 0xe139, 0xe137, //  4184
-    0xe136, 0xe134, 0xe132, 0xe130, 0xe12f, 0xe12d, 0xe12b, 0xe129, //  4192
-    0xe128, 0xe126, 0xe124, 0xe122, 0xe121, 0xe11f, 0xe11d, 0xe11b, //  4200
-    0xe11a, 0xe118, 0xe116, 0xe114, 0xe113, 0xe111, 0xe10f, 0xe10d, //  4208
-    0xe10c, 0xe10a, 0xe108, 0xe106, 0xe105, 0xe103, 0xe101, 0xe0ff, //  4216
-    0xe0fe, 0xe0fc, 0xe0fa, 0xe0f9, 0xe0f7, 0xe0f5, 0xe0f3, 0xe0f2, //  4224
-    0xe0f0, 0xe0ee, 0xe0ec, 0xe0eb, 0xe0e9, 0xe0e7, 0xe0e5, 0xe0e4, //  4232
-    0xe0e2, 0xe0e0, 0xe0de, 0xe0dd, 0xe0db, 0xe0d9, 0xe0d7, 0xe0d6, //  4240
-    0xe0d4, 0xe0d2, 0xe0d0, 0xe0cf, 0xe0cd, 0xe0cb, 0xe0c9, 0xe0c8, //  4248
-    0xe0c6, 0xe0c4, 0xe0c2, 0xe0c1, 0xe0bf, 0xe0bd, 0xe0bb, 0xe0ba, //  4256
-    0xe0b8, 0xe0b6, 0xe0b4, 0xe0b3, 0xe0b1, 0xe0af, 0xe0ae, 0xe0ac, //  4264
-    0xe0aa, 0xe0a8, 0xe0a7, 0xe0a5, 0xe0a3, 0xe0a1, 0xe0a0, 0xe09e, //  4272
-    0xe09c, 0xe09a, 0xe099, 0xe097, 0xe095, 0xe093, 0xe092, 0xe090, //  4280
-    0xe08e, 0xe08c, 0xe08b, 0xe089, 0xe087, 0xe085, 0xe084, 0xe082, //  4288
-    0xe080, 0xe07e, 0xe07d, 0xe07b, 0xe079, 0xe077, 0xe076, 0xe074, //  4296
-    0xe072, 0xe070, 0xe06f, 0xe06d, 0xe06b, 0xe069, 0xe068, 0xe066, //  4304
-    0xe064, 0xe063, 0xe061, 0xe05f, 0xe05d, 0xe05c, 0xe05a, 0xe058, //  4312
-    0xe056, 0xe055, 0xe053, 0xe051, 0xe04f, 0xe04e, 0xe04c, 0xe04a, //  4320
-    0xe048, 0xe047, 0xe045, 0xe043, 0xe041, 0xe040, 0xe03e, 0xe03c, //  4328
-    0xe03a, 0xe039, 0xe037, 0xe035, 0xe033, 0xe032, 0xe030, 0xe02e, //  4336
-    0xe02c, 0xe02b, 0xe029, 0xe027, 0xe025, 0xe024, 0xe022, 0xe020, //  4344
-    0xe01f, 0xe01d, 0xe01b, 0xe019, 0xe018, 0xe016, 0xe014, 0xe012, //  4352
-    0xe011, 0xe00f, 0xe00d, 0xe00b, 0xe00a, 0xe008, 0xe006, 0xe004, //  4360
-    0xe003, 0xe001, 0xdfff, 0xdffd, 0xdffc, 0xdffa, 0xdff8, 0xdff6, //  4368
-    0xdff5, 0xdff3, 0xdff1, 0xdfef, 0xdfee, 0xdfec, 0xdfea, 0xdfe8, //  4376
-    0xdfe7, 0xdfe5, 0xdfe3, 0xdfe1, 0xdfe0, 0xdfde, 0xdfdc, 0xdfda, //  4384
-    0xdfd9, 0xdfd7, 0xdfd5, 0xdfd4, 0xdfd2, 0xdfd0, 0xdfce, 0xdfcd, //  4392
-    0xdfcb, 0xdfc9, 0xdfc7, 0xdfc6, 0xdfc4, 0xdfc2, 0xdfc0, 0xdfbf, //  4400
-    0xdfbd, 0xdfbb, 0xdfb9, 0xdfb8, 0xdfb6, 0xdfb4, 0xdfb2, 0xdfb1, //  4408
-    0xdfaf, 0xdfad, 0xdfab, 0xdfaa, 0xdfa8, 0xdfa6, 0xdfa4, 0xdfa3, //  4416
-    0xdfa1, 0xdf9f, 0xdf9d, 0xdf9c, 0xdf9a, 0xdf98, 0xdf96, 0xdf95, //  4424
-    0xdf93, 0xdf91, 0xdf8f, 0xdf8e, 0xdf8c, 0xdf8a, 0xdf89, 0xdf87, //  4432
-    0xdf85, 0xdf83, 0xdf82, 0xdf80, 0xdf7e, 0xdf7c, 0xdf7b, 0xdf79, //  4440
-    0xdf77, 0xdf75, 0xdf74, 0xdf72, 0xdf70, 0xdf6e, 0xdf6d, 0xdf6b, //  4448
-    0xdf69, 0xdf67, 0xdf66, 0xdf64, 0xdf62, 0xdf60, 0xdf5f, 0xdf5d, //  4456
-    0xdf5b, 0xdf59, 0xdf58, 0xdf56, 0xdf54, 0xdf52, 0xdf51, 0xdf4f, //  4464
-    0xdf4d, 0xdf4b, 0xdf4a, 0xdf48, 0xdf46, 0xdf44, 0xdf43, 0xdf41, //  4472
-    0xdf3f, 0xdf3e, 0xdf3c, 0xdf3a, 0xdf38, 0xdf37, 0xdf35, 0xdf33, //  4480
-    0xdf31, 0xdf30, 0xdf2e, 0xdf2c, 0xdf2a, 0xdf29, 0xdf27, 0xdf25, //  4488
-    0xdf23, 0xdf22, 0xdf20, 0xdf1e, 0xdf1c, 0xdf1b, 0xdf19, 0xdf17, //  4496
-    0xdf15, 0xdf14, 0xdf12, 0xdf10, 0xdf0e, 0xdf0d, 0xdf0b, 0xdf09, //  4504
-    0xdf07, 0xdf06, 0xdf04, 0xdf02, 0xdf00, 0xdeff, 0xdefd, 0xdefb, //  4512
-    0xdef9, 0xdef8, 0xdef6, 0xdef4, 0xdef3, 0xdef1, 0xdeef, 0xdeed, //  4520
-    0xdeec, 0xdeea, 0xdee8, 0xdee6, 0xdee5, 0xdee3, 0xdee1, 0xdedf, //  4528
-    0xdede, 0xdedc, 0xdeda, 0xded8, 0xded7, 0xded5, 0xded3, 0xded1, //  4536
-    0xded0, 0xdece, 0xdecc, 0xdeca, 0xdec9, 0xdec7, 0xdec5, 0xdec3, //  4544
-    0xdec2, 0xdec0, 0xdebe, 0xdebc, 0xdebb, 0xdeb9, 0xdeb7, 0xdeb5, //  4552
-    0xdeb4, 0xdeb2, 0xdeb0, 0xdeae, 0xdead, 0xdeab, 0xdea9, 0xdea8, //  4560
-    0xdea6, 0xdea4, 0xdea2, 0xdea1, 0xde9f, 0xde9d, 0xde9b, 0xde9a, //  4568
-    0xde98, 0xde96, 0xde94, 0xde93, 0xde91, 0xde8f, 0xde8d, 0xde8c, //  4576
-    0xde8a, 0xde88, 0xde86, 0xde85, 0xde83, 0xde81, 0xde7f, 0xde7e, //  4584
-    0xde7c, 0xde7a, 0xde78, 0xde77, 0xde75, 0xde73, 0xde71, 0xde70, //  4592
-    0xde6e, 0xde6c, 0xde6a, 0xde69, 0xde67, 0xde65, 0xde63, 0xde62, //  4600
-    0xde60, 0xde5e, 0xde5d, 0xde5b, 0xde59, 0xde57, 0xde56, 0xde54, //  4608
-    0xde52, 0xde50, 0xde4f, 0xde4d, 0xde4b, 0xde49, 0xde48, 0xde46, //  4616
-    0xde44, 0xde42, 0xde41, 0xde3f, 0xde3d, 0xde3b, 0xde3a, 0xde38, //  4624
-    0xde36, 0xde34, 0xde33, 0xde31, 0xde2f, 0xde2d, 0xde2c, 0xde2a, //  4632
-    0xde28, 0xde26, 0xde25, 0xde23, 0xde21, 0xde1f, 0xde1e, 0xde1c, //  4640
-    0xde1a, 0xde18, 0xde17, 0xde15, 0xde13, 0xde12, 0xde10, 0xde0e, //  4648
-    0xde0c, 0xde0b, 0xde09, 0xde07, 0xde05, 0xde04, 0xde02, 0xde00, //  4656
-    0xddfe, 0xddfd, 0xddfb, 0xddf9, 0xddf7, 0xddf6, 0xddf4, 0xddf2, //  4664
-    0xddf0, 0xddef, 0xdded, 0xddeb, 0xdde9, 0xdde8, 0xdde6, 0xdde4, //  4672
-    0xdde2, 0xdde1, 0xdddf, 0xdddd, 0xdddb, 0xddda, 0xddd8, 0xddd6, //  4680
-    0xddd4, 0xddd3, 0xddd1, 0xddcf, 0xddcd, 0xddcc, 0xddca, 0xddc8, //  4688
-    0xddc7, 0xddc5, 0xddc3, 0xddc1, 0xddc0, 0xddbe, 0xddbc, 0xddba, //  4696
-    0xddb9, 0xddb7, 0xddb5, 0xddb3, 0xddb2, 0xddb0, 0xddae, 0xddac, //  4704
-    0xddab, 0xdda9, 0xdda7, 0xdda5, 0xdda4, 0xdda2, 0xdda0, 0xdd9e, //  4712
-    0xdd9d, 0xdd9b, 0xdd99, 0xdd97, 0xdd96, 0xdd94, 0xdd92, 0xdd90, //  4720
-    0xdd8f, 0xdd8d, 0xdd8b, 0xdd89, 0xdd88, 0xdd86, 0xdd84, 0xdd82, //  4728
-    0xdd81, 0xdd7f, 0xdd7d, 0xdd7c, 0xdd7a, 0xdd78, 0xdd76, 0xdd75, //  4736
-    0xdd73, 0xdd71, 0xdd6f, 0xdd6e, 0xdd6c, 0xdd6a, 0xdd68, 0xdd67, //  4744
-    0xdd65, 0xdd63, 0xdd61, 0xdd60, 0xdd5e, 0xdd5c, 0xdd5a, 0xdd59, //  4752
-    0xdd57, 0xdd55, 0xdd53, 0xdd52, 0xdd50, 0xdd4e, 0xdd4c, 0xdd4b, //  4760
-    0xdd49, 0xdd47, 0xdd45, 0xdd44, 0xdd42, 0xdd40, 0xdd3e, 0xdd3d, //  4768
-    0xdd3b, 0xdd39, 0xdd37, 0xdd36, 0xdd34, 0xdd32, 0xdd31, 0xdd2f, //  4776
-    0xdd2d, 0xdd2b, 0xdd2a, 0xdd28, 0xdd26, 0xdd24, 0xdd23, 0xdd21, //  4784
-    0xdd1f, 0xdd1d, 0xdd1c, 0xdd1a, 0xdd18, 0xdd16, 0xdd15, 0xdd13, //  4792
-    0xdd11, 0xdd0f, 0xdd0e, 0xdd0c, 0xdd0a, 0xdd08, 0xdd07, 0xdd05, //  4800
-    0xdd03, 0xdd01, 0xdd00, 0xdcfe, 0xdcfc, 0xdcfa, 0xdcf9, 0xdcf7, //  4808
-    0xdcf5, 0xdcf3, 0xdcf2, 0xdcf0, 0xdcee, 0xdcec, 0xdceb, 0xdce9, //  4816
-    0xdce7, 0xdce6, 0xdce4, 0xdce2, 0xdce0, 0xdcdf, 0xdcdd, 0xdcdb, //  4824
-    0xdcd9, 0xdcd8, 0xdcd6, 0xdcd4, 0xdcd2, 0xdcd1, 0xdccf, 0xdccd, //  4832
-    0xdccb, 0xdcca, 0xdcc8, 0xdcc6, 0xdcc4, 0xdcc3, 0xdcc1, 0xdcbf, //  4840
-    0xdcbd, 0xdcbc, 0xdcba, 0xdcb8, 0xdcb6, 0xdcb5, 0xdcb3, 0xdcb1, //  4848
-    0xdcaf, 0xdcae, 0xdcac, 0xdcaa, 0xdca8, 0xdca7, 0xdca5, 0xdca3, //  4856
-    0xdca2, 0xdca0, 0xdc9e, 0xdc9c, 0xdc9b, 0xdc99, 0xdc97, 0xdc95, //  4864
-    0xdc94, 0xdc92, 0xdc90, 0xdc8e, 0xdc8d, 0xdc8b, 0xdc89, 0xdc87, //  4872
-    0xdc86, 0xdc84, 0xdc82, 0xdc80, 0xdc7f, 0xdc7d, 0xdc7b, 0xdc79, //  4880
-    0xdc78, 0xdc76, 0xdc74, 0xdc72, 0xdc71, 0xdc6f, 0xdc6d, 0xdc6b, //  4888
-    0xdc6a, 0xdc68, 0xdc66, 0xdc64, 0xdc63, 0xdc61, 0xdc5f, 0xdc5d, //  4896
-    0xdc5c, 0xdc5a, 0xdc58, 0xdc57, 0xdc55, 0xdc53, 0xdc51, 0xdc50, //  4904
-    0xdc4e, 0xdc4c, 0xdc4a, 0xdc49, 0xdc47, 0xdc45, 0xdc43, 0xdc42, //  4912
-    0xdc40, 0xdc3e, 0xdc3c, 0xdc3b, 0xdc39, 0xdc37, 0xdc35, 0xdc34, //  4920
-    0xdc32, 0xdc30, 0xdc2e, 0xdc2d, 0xdc2b, 0xdc29, 0xdc27, 0xdc26, //  4928
-    0xdc24, 0xdc22, 0xdc20, 0xdc1f, 0xdc1d, 0xdc1b, 0xdc19, 0xdc18, //  4936
-    0xdc16, 0xdc14, 0xdc12, 0xdc11, 0xdc0f, 0xdc0d, 0xdc0c, 0xdc0a, //  4944
-    0xdc08, 0xdc06, 0xdc05, 0xdc03, 0xdc01, 0xdbff, 0xdbfe, 0xdbfc, //  4952
-    0xdbfa, 0xdbf8, 0xdbf7, 0xdbf5, 0xdbf3, 0xdbf1, 0xdbf0, 0xdbee, //  4960
-    0xdbec, 0xdbea, 0xdbe9, 0xdbe7, 0xdbe5, 0xdbe3, 0xdbe2, 0xdbe0, //  4968
-    0xdbde, 0xdbdc, 0xdbdb, 0xdbd9, 0xdbd7, 0xdbd5, 0xdbd4, 0xdbd2, //  4976
-    0xdbd0, 0xdbce, 0xdbcd, 0xdbcb, 0xdbc9, 0xdbc7, 0xdbc6, 0xdbc4, //  4984
-    0xdbc2, 0xdbc1, 0xdbbf, 0xdbbd, 0xdbbb, 0xdbba, 0xdbb8, 0xdbb6, //  4992
-    0xdbb4, 0xdbb3, 0xdbb1, 0xdbaf, 0xdbad, 0xdbac, 0xdbaa, 0xdba8, //  5000
-    0xdba6, 0xdba5, 0xdba3, 0xdba1, 0xdb9f, 0xdb9e, 0xdb9c, 0xdb9a, //  5008
-    0xdb98, 0xdb97, 0xdb95, 0xdb93, 0xdb91, 0xdb90, 0xdb8e, 0xdb8c, //  5016
-    0xdb8a, 0xdb89, 0xdb87, 0xdb85, 0xdb83, 0xdb82, 0xdb80, 0xdb7e, //  5024
-    0xdb7c, 0xdb7b, 0xdb79, 0xdb77, 0xdb76, 0xdb74, 0xdb72, 0xdb70, //  5032
-    0xdb6f, 0xdb6d, 0xdb6b, 0xdb69, 0xdb68, 0xdb66, 0xdb64, 0xdb62, //  5040
-    0xdb61, 0xdb5f, 0xdb5d, 0xdb5b, 0xdb5a, 0xdb58, 0xdb56, 0xdb54, //  5048
-    0xdb53, 0xdb51, 0xdb4f, 0xdb4d, 0xdb4c, 0xdb4a, 0xdb48, 0xdb46, //  5056
-    0xdb45, 0xdb43, 0xdb41, 0xdb3f, 0xdb3e, 0xdb3c, 0xdb3a, 0xdb38, //  5064
-    0xdb37, 0xdb35, 0xdb33, 0xdb31, 0xdb30, 0xdb2e, 0xdb2c, 0xdb2b, //  5072
-    0xdb29, 0xdb27, 0xdb25, 0xdb24, 0xdb22, 0xdb20, 0xdb1e, 0xdb1d, //  5080
-    0xdb1b, 0xdb19, 0xdb17, 0xdb16, 0xdb14, 0xdb12, 0xdb10, 0xdb0f, //  5088
-    0xdb0d, 0xdb0b, 0xdb09, 0xdb08, 0xdb06, 0xdb04, 0xdb02, 0xdb01, //  5096
-    0xdaff, 0xdafd, 0xdafb, 0xdafa, 0xdaf8, 0xdaf6, 0xdaf4, 0xdaf3, //  5104
-    0xdaf1, 0xdaef, 0xdaed, 0xdaec, 0xdaea, 0xdae8, 0xdae6, 0xdae5, //  5112
-    0xdae3, 0xdae1, 0xdae0, 0xdade, 0xdadc, 0xdadb, 0xdad9, 0xdad7, //  5120
-    0xdad5, 0xdad4, 0xdad2, 0xdad0, 0xdacf, 0xdacd, 0xdacb, 0xdaca, //  5128
-    0xdac8, 0xdac6, 0xdac4, 0xdac3, 0xdac1, 0xdabf, 0xdabe, 0xdabc, //  5136
-    0xdaba, 0xdab9, 0xdab7, 0xdab5, 0xdab3, 0xdab2, 0xdab0, 0xdaae, //  5144
-    0xdaad, 0xdaab, 0xdaa9, 0xdaa8, 0xdaa6, 0xdaa4, 0xdaa3, 0xdaa1, //  5152
-    0xda9f, 0xda9d, 0xda9c, 0xda9a, 0xda98, 0xda97, 0xda95, 0xda93, //  5160
-    0xda92, 0xda90, 0xda8e, 0xda8c, 0xda8b, 0xda89, 0xda87, 0xda86, //  5168
-    0xda84, 0xda82, 0xda81, 0xda7f, 0xda7d, 0xda7b, 0xda7a, 0xda78, //  5176
-    0xda76, 0xda75, 0xda73, 0xda71, 0xda70, 0xda6e, 0xda6c, 0xda6a, //  5184
-    0xda69, 0xda67, 0xda65, 0xda64, 0xda62, 0xda60, 0xda5f, 0xda5d, //  5192
-    0xda5b, 0xda5a, 0xda58, 0xda56, 0xda54, 0xda53, 0xda51, 0xda4f, //  5200
-    0xda4e, 0xda4c, 0xda4a, 0xda49, 0xda47, 0xda45, 0xda43, 0xda42, //  5208
-    0xda40, 0xda3e, 0xda3d, 0xda3b, 0xda39, 0xda38, 0xda36, 0xda34, //  5216
-    0xda32, 0xda31, 0xda2f, 0xda2d, 0xda2c, 0xda2a, 0xda28, 0xda27, //  5224
-    0xda25, 0xda23, 0xda22, 0xda20, 0xda1e, 0xda1c, 0xda1b, 0xda19, //  5232
-    0xda17, 0xda16, 0xda14, 0xda12, 0xda11, 0xda0f, 0xda0d, 0xda0b, //  5240
-    0xda0a, 0xda08, 0xda06, 0xda05, 0xda03, 0xda01, 0xda00, 0xd9fe, //  5248
-    0xd9fc, 0xd9fa, 0xd9f9, 0xd9f7, 0xd9f5, 0xd9f4, 0xd9f2, 0xd9f0, //  5256
-    0xd9ef, 0xd9ed, 0xd9eb, 0xd9ea, 0xd9e8, 0xd9e6, 0xd9e4, 0xd9e3, //  5264
-    0xd9e1, 0xd9df, 0xd9de, 0xd9dc, 0xd9da, 0xd9d9, 0xd9d7, 0xd9d5, //  5272
-    0xd9d3, 0xd9d2, 0xd9d0, 0xd9ce, 0xd9cd, 0xd9cb, 0xd9c9, 0xd9c8, //  5280
-    0xd9c6, 0xd9c4, 0xd9c2, 0xd9c1, 0xd9bf, 0xd9bd, 0xd9bc, 0xd9ba, //  5288
-    0xd9b8, 0xd9b7, 0xd9b5, 0xd9b3, 0xd9b1, 0xd9b0, 0xd9ae, 0xd9ac, //  5296
-    0xd9ab, 0xd9a9, 0xd9a7, 0xd9a6, 0xd9a4, 0xd9a2, 0xd9a1, 0xd99f, //  5304
-    0xd99d, 0xd99b, 0xd99a, 0xd998, 0xd996, 0xd995, 0xd993, 0xd991, //  5312
-    0xd990, 0xd98e, 0xd98c, 0xd98a, 0xd989, 0xd987, 0xd985, 0xd984, //  5320
-    0xd982, 0xd980, 0xd97f, 0xd97d, 0xd97b, 0xd979, 0xd978, 0xd976, //  5328
-    0xd974, 0xd973, 0xd971, 0xd96f, 0xd96e, 0xd96c, 0xd96a, 0xd969, //  5336
-    0xd967, 0xd965, 0xd963, 0xd962, 0xd960, 0xd95e, 0xd95d, 0xd95b, //  5344
-    0xd959, 0xd958, 0xd956, 0xd954, 0xd952, 0xd951, 0xd94f, 0xd94d, //  5352
-    0xd94c, 0xd94a, 0xd948, 0xd947, 0xd945, 0xd943, 0xd941, 0xd940, //  5360
-    0xd93e, 0xd93c, 0xd93b, 0xd939, 0xd937, 0xd936, 0xd934, 0xd932, //  5368
-    0xd931, 0xd92f, 0xd92d, 0xd92b, 0xd92a, 0xd928, 0xd926, 0xd925, //  5376
-    0xd923, 0xd921, 0xd920, 0xd91e, 0xd91c, 0xd91a, 0xd919, 0xd917, //  5384
-    0xd915, 0xd914, 0xd912, 0xd910, 0xd90f, 0xd90d, 0xd90b, 0xd909, //  5392
-    0xd908, 0xd906, 0xd904, 0xd903, 0xd901, 0xd8ff, 0xd8fe, 0xd8fc, //  5400
-    0xd8fa, 0xd8f8, 0xd8f7, 0xd8f5, 0xd8f3, 0xd8f2, 0xd8f0, 0xd8ee, //  5408
-    0xd8ed, 0xd8eb, 0xd8e9, 0xd8e8, 0xd8e6, 0xd8e4, 0xd8e2, 0xd8e1, //  5416
-    0xd8df, 0xd8dd, 0xd8dc, 0xd8da, 0xd8d8, 0xd8d7, 0xd8d5, 0xd8d3, //  5424
-    0xd8d1, 0xd8d0, 0xd8ce, 0xd8cc, 0xd8cb, 0xd8c9, 0xd8c7, 0xd8c6, //  5432
-    0xd8c4, 0xd8c2, 0xd8c0, 0xd8bf, 0xd8bd, 0xd8bb, 0xd8ba, 0xd8b8, //  5440
-    0xd8b6, 0xd8b5, 0xd8b3, 0xd8b1, 0xd8b0, 0xd8ae, 0xd8ac, 0xd8aa, //  5448
-    0xd8a9, 0xd8a7, 0xd8a5, 0xd8a4, 0xd8a2, 0xd8a0, 0xd89f, 0xd89d, //  5456
-    0xd89b, 0xd899, 0xd898, 0xd896, 0xd894, 0xd893, 0xd891, 0xd88f, //  5464
-    0xd88e, 0xd88c, 0xd88a, 0xd888, 0xd887, 0xd885, 0xd883, 0xd882, //  5472
-    0xd880, 0xd87e, 0xd87d, 0xd87b, 0xd879, 0xd877, 0xd876, 0xd874, //  5480
-    0xd872, 0xd871, 0xd86f, 0xd86d, 0xd86c, 0xd86a, 0xd868, 0xd867, //  5488
-    0xd865, 0xd863, 0xd861, 0xd860, 0xd85e, 0xd85c, 0xd85b, 0xd859, //  5496
-    0xd857, 0xd856, 0xd854, 0xd852, 0xd850, 0xd84f, 0xd84d, 0xd84b, //  5504
-    0xd84a, 0xd848, 0xd846, 0xd845, 0xd843, 0xd841, 0xd83f, 0xd83e, //  5512
-    0xd83c, 0xd83a, 0xd839, 0xd837, 0xd835, 0xd834, 0xd832, 0xd830, //  5520
-    0xd82f, 0xd82d, 0xd82b, 0xd829, 0xd828, 0xd826, 0xd824, 0xd823, //  5528
-    0xd821, 0xd81f, 0xd81e, 0xd81c, 0xd81a, 0xd818, 0xd817, 0xd815, //  5536
-    0xd813, 0xd812, 0xd810, 0xd80e, 0xd80d, 0xd80b, 0xd809, 0xd807, //  5544
-    0xd806, 0xd804, 0xd802, 0xd801, 0xd7ff, 0xd7fd, 0xd7fc, 0xd7fa, //  5552
-    0xd7f8, 0xd7f7, 0xd7f5, 0xd7f3, 0xd7f1, 0xd7f0, 0xd7ee, 0xd7ec, //  5560
-    0xd7eb, 0xd7e9, 0xd7e7, 0xd7e6, 0xd7e4, 0xd7e2, 0xd7e0, 0xd7df, //  5568
-    0xd7dd, 0xd7db, 0xd7da, 0xd7d8, 0xd7d6, 0xd7d5, 0xd7d3, 0xd7d1, //  5576
-    0xd7cf, 0xd7ce, 0xd7cc, 0xd7ca, 0xd7c9, 0xd7c7, 0xd7c5, 0xd7c4, //  5584
-    0xd7c2, 0xd7c0, 0xd7be, 0xd7bd, 0xd7bb, 0xd7b9, 0xd7b8, 0xd7b6, //  5592
-    0xd7b4, 0xd7b3, 0xd7b1, 0xd7af, 0xd7ae, 0xd7ac, 0xd7aa, 0xd7a8, //  5600
-    0xd7a7, 0xd7a5, 0xd7a3, 0xd7a2, 0xd7a0, 0xd79e, 0xd79d, 0xd79b, //  5608
-    0xd799, 0xd797, 0xd796, 0xd794, 0xd792, 0xd791, 0xd78f, 0xd78d, //  5616
-    0xd78c, 0xd78a, 0xd788, 0xd786, 0xd785, 0xd783, 0xd781, 0xd780, //  5624
-    0xd77e, 0xd77c, 0xd77b, 0xd779, 0xd777, 0xd776, 0xd774, 0xd772, //  5632
-    0xd770, 0xd76f, 0xd76d, 0xd76b, 0xd76a, 0xd768, 0xd766, 0xd765, //  5640
-    0xd763, 0xd761, 0xd75f, 0xd75e, 0xd75c, 0xd75a, 0xd759, 0xd757, //  5648
-    0xd755, 0xd754, 0xd752, 0xd750, 0xd74e, 0xd74d, 0xd74b, 0xd749, //  5656
-    0xd748, 0xd746, 0xd744, 0xd743, 0xd741, 0xd73f, 0xd73e, 0xd73c, //  5664
-    0xd73a, 0xd738, 0xd737, 0xd735, 0xd733, 0xd732, 0xd730, 0xd72e, //  5672
-    0xd72d, 0xd72b, 0xd729, 0xd727, 0xd726, 0xd724, 0xd722, 0xd721, //  5680
-    0xd71f, 0xd71d, 0xd71c, 0xd71a, 0xd718, 0xd716, 0xd715, 0xd713, //  5688
-    0xd711, 0xd710, 0xd70e, 0xd70c, 0xd70b, 0xd709, 0xd707, 0xd705, //  5696
-    0xd704, 0xd702, 0xd700, 0xd6ff, 0xd6fd, 0xd6fb, 0xd6fa, 0xd6f8, //  5704
-    0xd6f6, 0xd6f5, 0xd6f3, 0xd6f1, 0xd6ef, 0xd6ee, 0xd6ec, 0xd6ea, //  5712
-    0xd6e9, 0xd6e7, 0xd6e5, 0xd6e4, 0xd6e2, 0xd6e0, 0xd6de, 0xd6dd, //  5720
-    0xd6db, 0xd6d9, 0xd6d8, 0xd6d6, 0xd6d4, 0xd6d3, 0xd6d1, 0xd6cf, //  5728
-    0xd6cd, 0xd6cc, 0xd6ca, 0xd6c8, 0xd6c7, 0xd6c5, 0xd6c3, 0xd6c2, //  5736
-    0xd6c0, 0xd6be, 0xd6bd, 0xd6bb, 0xd6b9, 0xd6b7, 0xd6b6, 0xd6b4, //  5744
-    0xd6b2, 0xd6b1, 0xd6af, 0xd6ad, 0xd6ac, 0xd6aa, 0xd6a8, 0xd6a6, //  5752
-    0xd6a5, 0xd6a3, 0xd6a1, 0xd6a0, 0xd69e, 0xd69c, 0xd69b, 0xd699, //  5760
-    0xd697, 0xd695, 0xd694, 0xd692, 0xd690, 0xd68f, 0xd68d, 0xd68b, //  5768
-    0xd68a, 0xd688, 0xd686, 0xd685, 0xd683, 0xd681, 0xd67f, 0xd67e, //  5776
-    0xd67c, 0xd67a, 0xd679, 0xd677, 0xd675, 0xd674, 0xd672, 0xd670, //  5784
-    0xd66e, 0xd66d, 0xd66b, 0xd669, 0xd668, 0xd666, 0xd664, 0xd663, //  5792
-    0xd661, 0xd65f, 0xd65d, 0xd65c, 0xd65a, 0xd658, 0xd657, 0xd655, //  5800
-    0xd653, 0xd652, 0xd650, 0xd64e, 0xd64c, 0xd64b, 0xd649, 0xd647, //  5808
-    0xd646, 0xd644, 0xd642, 0xd641, 0xd63f, 0xd63d, 0xd63c, 0xd63a, //  5816
-    0xd638, 0xd636, 0xd635, 0xd633, 0xd631, 0xd630, 0xd62e, 0xd62c, //  5824
-    0xd62b, 0xd629, 0xd627, 0xd625, 0xd624, 0xd622, 0xd620, 0xd61f, //  5832
-    0xd61d, 0xd61b, 0xd61a, 0xd618, 0xd616, 0xd614, 0xd613, 0xd611, //  5840
-    0xd60f, 0xd60e, 0xd60c, 0xd60a, 0xd609, 0xd607, 0xd605, 0xd604, //  5848
-    0xd602, 0xd600, 0xd5fe, 0xd5fd, 0xd5fb, 0xd5f9, 0xd5f8, 0xd5f6, //  5856
-    0xd5f4, 0xd5f3, 0xd5f1, 0xd5ef, 0xd5ed, 0xd5ec, 0xd5ea, 0xd5e8, //  5864
-    0xd5e7, 0xd5e5, 0xd5e3, 0xd5e2, 0xd5e0, 0xd5de, 0xd5dc, 0xd5db, //  5872
-    0xd5d9, 0xd5d7, 0xd5d6, 0xd5d4, 0xd5d2, 0xd5d1, 0xd5cf, 0xd5cd, //  5880
-    0xd5cc, 0xd5ca, 0xd5c8, 0xd5c6, 0xd5c5, 0xd5c3, 0xd5c1, 0xd5c0, //  5888
-    0xd5be, 0xd5bc, 0xd5bb, 0xd5b9, 0xd5b7, 0xd5b5, 0xd5b4, 0xd5b2, //  5896
-    0xd5b0, 0xd5af, 0xd5ad, 0xd5ab, 0xd5aa, 0xd5a8, 0xd5a6, 0xd5a4, //  5904
-    0xd5a3, 0xd5a1, 0xd59f, 0xd59e, 0xd59c, 0xd59a, 0xd599, 0xd597, //  5912
-    0xd595, 0xd593, 0xd592, 0xd590, 0xd58e, 0xd58d, 0xd58b, 0xd589, //  5920
-    0xd588, 0xd586, 0xd584, 0xd583, 0xd581, 0xd57f, 0xd57d, 0xd57c, //  5928
-    0xd57a, 0xd578, 0xd577, 0xd575, 0xd573, 0xd572, 0xd570, 0xd56e, //  5936
-    0xd56c, 0xd56b, 0xd569, 0xd567, 0xd566, 0xd564, 0xd562, 0xd561, //  5944
-    0xd55f, 0xd55d, 0xd55b, 0xd55a, 0xd558, 0xd556, 0xd555, 0xd553, //  5952
-    0xd551, 0xd550, 0xd54e, 0xd54c, 0xd54b, 0xd549, 0xd547, 0xd545, //  5960
-    0xd544, 0xd542, 0xd540, 0xd53f, 0xd53d, 0xd53b, 0xd53a, 0xd538, //  5968
-    0xd536, 0xd534, 0xd533, 0xd531, 0xd52f, 0xd52e, 0xd52c, 0xd52a, //  5976
-    0xd529, 0xd527, 0xd525, 0xd523, 0xd522, 0xd520, 0xd51e, 0xd51d, //  5984
-    0xd51b, 0xd519, 0xd518, 0xd516, 0xd514, 0xd512, 0xd511, 0xd50f, //  5992
-    0xd50d, 0xd50c, 0xd50a, 0xd508, 0xd507, 0xd505, 0xd503, 0xd502, //  6000
-    0xd500, 0xd4fe, 0xd4fc, 0xd4fb, 0xd4f9, 0xd4f7, 0xd4f6, 0xd4f4, //  6008
-    0xd4f2, 0xd4f1, 0xd4ef, 0xd4ed, 0xd4eb, 0xd4ea, 0xd4e8, 0xd4e6, //  6016
-    0xd4e5, 0xd4e3, 0xd4e1, 0xd4e0, 0xd4de, 0xd4dc, 0xd4da, 0xd4d9, //  6024
-    0xd4d7, 0xd4d5, 0xd4d4, 0xd4d2, 0xd4d0, 0xd4cf, 0xd4cd, 0xd4cb, //  6032
-    0xd4ca, 0xd4c8, 0xd4c6, 0xd4c4, 0xd4c3, 0xd4c1, 0xd4bf, 0xd4be, //  6040
-    0xd4bc, 0xd4ba, 0xd4b9, 0xd4b7, 0xd4b5, 0xd4b3, 0xd4b2, 0xd4b0, //  6048
-    0xd4ae, 0xd4ad, 0xd4ab, 0xd4a9, 0xd4a8, 0xd4a6, 0xd4a4, 0xd4a2, //  6056
-    0xd4a1, 0xd49f, 0xd49d, 0xd49c, 0xd49a, 0xd498, 0xd497, 0xd495, //  6064
-    0xd493, 0xd492, 0xd490, 0xd48e, 0xd48c, 0xd48b, 0xd489, 0xd487, //  6072
-    0xd486, 0xd484, 0xd482, 0xd481, 0xd47f, 0xd47d, 0xd47b, 0xd47a, //  6080
-    0xd478, 0xd476, 0xd475, 0xd473, 0xd471, 0xd470, 0xd46e, 0xd46c, //  6088
-    0xd46a, 0xd469, 0xd467, 0xd465, 0xd464, 0xd462, 0xd460, 0xd45f, //  6096
-    0xd45d, 0xd45b, 0xd459, 0xd458, 0xd456, 0xd454, 0xd453, 0xd451, //  6104
-    0xd44f, 0xd44e, 0xd44c, 0xd44a, 0xd449, 0xd447, 0xd445, 0xd443, //  6112
-    0xd442, 0xd440, 0xd43e, 0xd43d, 0xd43b, 0xd439, 0xd438, 0xd436, //  6120
-    0xd434, 0xd432, 0xd431, 0xd42f, 0xd42d, 0xd42c, 0xd42a, 0xd428, //  6128
-    0xd427, 0xd425, 0xd423, 0xd421, 0xd420, 0xd41e, 0xd41c, 0xd41b, //  6136
-    0xd419, 0xd417, 0xd416, 0xd414, 0xd412, 0xd411, 0xd40f, 0xd40d, //  6144
-    0xd40c, 0xd40a, 0xd409, 0xd407, 0xd405, 0xd404, 0xd402, 0xd400, //  6152
-    0xd3ff, 0xd3fd, 0xd3fb, 0xd3fa, 0xd3f8, 0xd3f6, 0xd3f5, 0xd3f3, //  6160
-    0xd3f1, 0xd3f0, 0xd3ee, 0xd3ed, 0xd3eb, 0xd3e9, 0xd3e8, 0xd3e6, //  6168
-    0xd3e4, 0xd3e3, 0xd3e1, 0xd3df, 0xd3de, 0xd3dc, 0xd3da, 0xd3d9, //  6176
-    0xd3d7, 0xd3d5, 0xd3d4, 0xd3d2, 0xd3d1, 0xd3cf, 0xd3cd, 0xd3cc, //  6184
-    0xd3ca, 0xd3c8, 0xd3c7, 0xd3c5, 0xd3c3, 0xd3c2, 0xd3c0, 0xd3be, //  6192
-    0xd3bd, 0xd3bb, 0xd3ba, 0xd3b8, 0xd3b6, 0xd3b5, 0xd3b3, 0xd3b1, //  6200
-    0xd3b0, 0xd3ae, 0xd3ac, 0xd3ab, 0xd3a9, 0xd3a7, 0xd3a6, 0xd3a4, //  6208
-    0xd3a2, 0xd3a1, 0xd39f, 0xd39e, 0xd39c, 0xd39a, 0xd399, 0xd397, //  6216
-    0xd395, 0xd394, 0xd392, 0xd390, 0xd38f, 0xd38d, 0xd38b, 0xd38a, //  6224
-    0xd388, 0xd386, 0xd385, 0xd383, 0xd382, 0xd380, 0xd37e, 0xd37d, //  6232
-    0xd37b, 0xd379, 0xd378, 0xd376, 0xd374, 0xd373, 0xd371, 0xd36f, //  6240
-    0xd36e, 0xd36c, 0xd36a, 0xd369, 0xd367, 0xd366, 0xd364, 0xd362, //  6248
-    0xd361, 0xd35f, 0xd35d, 0xd35c, 0xd35a, 0xd358, 0xd357, 0xd355, //  6256
-    0xd353, 0xd352, 0xd350, 0xd34e, 0xd34d, 0xd34b, 0xd34a, 0xd348, //  6264
-    0xd346, 0xd345, 0xd343, 0xd341, 0xd340, 0xd33e, 0xd33c, 0xd33b, //  6272
-    0xd339, 0xd337, 0xd336, 0xd334, 0xd332, 0xd331, 0xd32f, 0xd32e, //  6280
-    0xd32c, 0xd32a, 0xd329, 0xd327, 0xd325, 0xd324, 0xd322, 0xd320, //  6288
-    0xd31f, 0xd31d, 0xd31b, 0xd31a, 0xd318, 0xd317, 0xd315, 0xd313, //  6296
-    0xd312, 0xd310, 0xd30e, 0xd30d, 0xd30b, 0xd309, 0xd308, 0xd306, //  6304
-    0xd304, 0xd303, 0xd301, 0xd2ff, 0xd2fe, 0xd2fc, 0xd2fb, 0xd2f9, //  6312
-    0xd2f7, 0xd2f6, 0xd2f4, 0xd2f2, 0xd2f1, 0xd2ef, 0xd2ed, 0xd2ec, //  6320
-    0xd2ea, 0xd2e8, 0xd2e7, 0xd2e5, 0xd2e3, 0xd2e2, 0xd2e0, 0xd2df, //  6328
-    0xd2dd, 0xd2db, 0xd2da, 0xd2d8, 0xd2d6, 0xd2d5, 0xd2d3, 0xd2d1, //  6336
-    0xd2d0, 0xd2ce, 0xd2cc, 0xd2cb, 0xd2c9, 0xd2c7, 0xd2c6, 0xd2c4, //  6344
-    0xd2c3, 0xd2c1, 0xd2bf, 0xd2be, 0xd2bc, 0xd2ba, 0xd2b9, 0xd2b7, //  6352
-    0xd2b5, 0xd2b4, 0xd2b2, 0xd2b0, 0xd2af, 0xd2ad, 0xd2ab, 0xd2aa, //  6360
-    0xd2a8, 0xd2a7, 0xd2a5, 0xd2a3, 0xd2a2, 0xd2a0, 0xd29e, 0xd29d, //  6368
-    0xd29b, 0xd299, 0xd298, 0xd296, 0xd294, 0xd293, 0xd291, 0xd28f, //  6376
-    0xd28e, 0xd28c, 0xd28b, 0xd289, 0xd287, 0xd286, 0xd284, 0xd282, //  6384
-    0xd281, 0xd27f, 0xd27d, 0xd27c, 0xd27a, 0xd278, 0xd277, 0xd275, //  6392
-    0xd274, 0xd272, 0xd270, 0xd26f, 0xd26d, 0xd26b, 0xd26a, 0xd268, //  6400
-    0xd266, 0xd265, 0xd263, 0xd261, 0xd260, 0xd25e, 0xd25c, 0xd25b, //  6408
-    0xd259, 0xd258, 0xd256, 0xd254, 0xd253, 0xd251, 0xd24f, 0xd24e, //  6416
-    0xd24c, 0xd24a, 0xd249, 0xd247, 0xd245, 0xd244, 0xd242, 0xd240, //  6424
-    0xd23f, 0xd23d, 0xd23c, 0xd23a, 0xd238, 0xd237, 0xd235, 0xd233, //  6432
-    0xd232, 0xd230, 0xd22e, 0xd22d, 0xd22b, 0xd229, 0xd228, 0xd226, //  6440
-    0xd224, 0xd223, 0xd221, 0xd220, 0xd21e, 0xd21c, 0xd21b, 0xd219, //  6448
-    0xd217, 0xd216, 0xd214, 0xd212, 0xd211, 0xd20f, 0xd20d, 0xd20c, //  6456
-    0xd20a, 0xd208, 0xd207, 0xd205, 0xd204, 0xd202, 0xd200, 0xd1ff, //  6464
-    0xd1fd, 0xd1fb, 0xd1fa, 0xd1f8, 0xd1f6, 0xd1f5, 0xd1f3, 0xd1f1, //  6472
-    0xd1f0, 0xd1ee, 0xd1ec, 0xd1eb, 0xd1e9, 0xd1e8, 0xd1e6, 0xd1e4, //  6480
-    0xd1e3, 0xd1e1, 0xd1df, 0xd1de, 0xd1dc, 0xd1da, 0xd1d9, 0xd1d7, //  6488
-    0xd1d5, 0xd1d4, 0xd1d2, 0xd1d0, 0xd1cf, 0xd1cd, 0xd1cc, 0xd1ca, //  6496
-    0xd1c8, 0xd1c7, 0xd1c5, 0xd1c3, 0xd1c2, 0xd1c0, 0xd1be, 0xd1bd, //  6504
-    0xd1bb, 0xd1b9, 0xd1b8, 0xd1b6, 0xd1b5, 0xd1b3, 0xd1b1, 0xd1b0, //  6512
-    0xd1ae, 0xd1ac, 0xd1ab, 0xd1a9, 0xd1a7, 0xd1a6, 0xd1a4, 0xd1a2, //  6520
-    0xd1a1, 0xd19f, 0xd19d, 0xd19c, 0xd19a, 0xd199, 0xd197, 0xd195, //  6528
-    0xd194, 0xd192, 0xd190, 0xd18f, 0xd18d, 0xd18b, 0xd18a, 0xd188, //  6536
-    0xd186, 0xd185, 0xd183, 0xd181, 0xd180, 0xd17e, 0xd17d, 0xd17b, //  6544
-    0xd179, 0xd178, 0xd176, 0xd174, 0xd173, 0xd171, 0xd16f, 0xd16e, //  6552
-    0xd16c, 0xd16a, 0xd169, 0xd167, 0xd165, 0xd164, 0xd162, 0xd161, //  6560
-    0xd15f, 0xd15d, 0xd15c, 0xd15a, 0xd158, 0xd157, 0xd155, 0xd153, //  6568
-    0xd152, 0xd150, 0xd14e, 0xd14d, 0xd14b, 0xd149, 0xd148, 0xd146, //  6576
-    0xd145, 0xd143, 0xd141, 0xd140, 0xd13e, 0xd13c, 0xd13b, 0xd139, //  6584
-    0xd137, 0xd136, 0xd134, 0xd132, 0xd131, 0xd12f, 0xd12d, 0xd12c, //  6592
-    0xd12a, 0xd129, 0xd127, 0xd125, 0xd124, 0xd122, 0xd120, 0xd11f, //  6600
-    0xd11d, 0xd11b, 0xd11a, 0xd118, 0xd116, 0xd115, 0xd113, 0xd112, //  6608
-    0xd110, 0xd10e, 0xd10d, 0xd10b, 0xd109, 0xd108, 0xd106, 0xd104, //  6616
-    0xd103, 0xd101, 0xd0ff, 0xd0fe, 0xd0fc, 0xd0fa, 0xd0f9, 0xd0f7, //  6624
-    0xd0f6, 0xd0f4, 0xd0f2, 0xd0f1, 0xd0ef, 0xd0ed, 0xd0ec, 0xd0ea, //  6632
-    0xd0e8, 0xd0e7, 0xd0e5, 0xd0e3, 0xd0e2, 0xd0e0, 0xd0de, 0xd0dd, //  6640
-    0xd0db, 0xd0da, 0xd0d8, 0xd0d6, 0xd0d5, 0xd0d3, 0xd0d1, 0xd0d0, //  6648
-    0xd0ce, 0xd0cc, 0xd0cb, 0xd0c9, 0xd0c7, 0xd0c6, 0xd0c4, 0xd0c2, //  6656
-    0xd0c1, 0xd0bf, 0xd0be, 0xd0bc, 0xd0ba, 0xd0b9, 0xd0b7, 0xd0b5, //  6664
-    0xd0b4, 0xd0b2, 0xd0b0, 0xd0af, 0xd0ad, 0xd0ab, 0xd0aa, 0xd0a8, //  6672
-    0xd0a6, 0xd0a5, 0xd0a3, 0xd0a2, 0xd0a0, 0xd09e, 0xd09d, 0xd09b, //  6680
-    0xd099, 0xd098, 0xd096, 0xd094, 0xd093, 0xd091, 0xd08f, 0xd08e, //  6688
-    0xd08c, 0xd08a, 0xd089, 0xd087, 0xd086, 0xd084, 0xd082, 0xd081, //  6696
-    0xd07f, 0xd07d, 0xd07c, 0xd07a, 0xd078, 0xd077, 0xd075, 0xd073, //  6704
-    0xd072, 0xd070, 0xd06f, 0xd06d, 0xd06b, 0xd06a, 0xd068, 0xd066, //  6712
-    0xd065, 0xd063, 0xd061, 0xd060, 0xd05e, 0xd05c, 0xd05b, 0xd059, //  6720
-    0xd057, 0xd056, 0xd054, 0xd053, 0xd051, 0xd04f, 0xd04e, 0xd04c, //  6728
-    0xd04a, 0xd049, 0xd047, 0xd045, 0xd044, 0xd042, 0xd040, 0xd03f, //  6736
-    0xd03d, 0xd03b, 0xd03a, 0xd038, 0xd037, 0xd035, 0xd033, 0xd032, //  6744
-    0xd030, 0xd02e, 0xd02d, 0xd02b, 0xd029, 0xd028, 0xd026, 0xd024, //  6752
-    0xd023, 0xd021, 0xd01f, 0xd01e, 0xd01c, 0xd01b, 0xd019, 0xd017, //  6760
-    0xd016, 0xd014, 0xd012, 0xd011, 0xd00f, 0xd00d, 0xd00c, 0xd00a, //  6768
-    0xd008, 0xd007, 0xd005, 0xd003, 0xd002, 0xd000, 0xcfff, 0xcffd, //  6776
-    0xcffb, 0xcffa, 0xcff8, 0xcff6, 0xcff5, 0xcff3, 0xcff1, 0xcff0, //  6784
-    0xcfee, 0xcfec, 0xcfeb, 0xcfe9, 0xcfe7, 0xcfe6, 0xcfe4, 0xcfe3, //  6792
-    0xcfe1, 0xcfdf, 0xcfde, 0xcfdc, 0xcfda, 0xcfd9, 0xcfd7, 0xcfd5, //  6800
-    0xcfd4, 0xcfd2, 0xcfd0, 0xcfcf, 0xcfcd, 0xcfcc, 0xcfca, 0xcfc8, //  6808
-    0xcfc7, 0xcfc5, 0xcfc3, 0xcfc2, 0xcfc0, 0xcfbe, 0xcfbd, 0xcfbb, //  6816
-    0xcfb9, 0xcfb8, 0xcfb6, 0xcfb4, 0xcfb3, 0xcfb1, 0xcfb0, 0xcfae, //  6824
-    0xcfac, 0xcfab, 0xcfa9, 0xcfa7, 0xcfa6, 0xcfa4, 0xcfa2, 0xcfa1, //  6832
-    0xcf9f, 0xcf9d, 0xcf9c, 0xcf9a, 0xcf98, 0xcf97, 0xcf95, 0xcf94, //  6840
-    0xcf92, 0xcf90, 0xcf8f, 0xcf8d, 0xcf8b, 0xcf8a, 0xcf88, 0xcf86, //  6848
-    0xcf85, 0xcf83, 0xcf81, 0xcf80, 0xcf7e, 0xcf7c, 0xcf7b, 0xcf79, //  6856
-    0xcf78, 0xcf76, 0xcf74, 0xcf73, 0xcf71, 0xcf6f, 0xcf6e, 0xcf6c, //  6864
-    0xcf6a, 0xcf69, 0xcf67, 0xcf65, 0xcf64, 0xcf62, 0xcf60, 0xcf5f, //  6872
-    0xcf5d, 0xcf5c, 0xcf5a, 0xcf58, 0xcf57, 0xcf55, 0xcf53, 0xcf52, //  6880
-    0xcf50, 0xcf4e, 0xcf4d, 0xcf4b, 0xcf49, 0xcf48, 0xcf46, 0xcf44, //  6888
-    0xcf43, 0xcf41, 0xcf40, 0xcf3e, 0xcf3c, 0xcf3b, 0xcf39, 0xcf37, //  6896
-    0xcf36, 0xcf34, 0xcf32, 0xcf31, 0xcf2f, 0xcf2d, 0xcf2c, 0xcf2a, //  6904
-    0xcf29, 0xcf27, 0xcf25, 0xcf24, 0xcf22, 0xcf20, 0xcf1f, 0xcf1d, //  6912
-    0xcf1b, 0xcf1a, 0xcf18, 0xcf16, 0xcf15, 0xcf13, 0xcf11, 0xcf10, //  6920
-    0xcf0e, 0xcf0d, 0xcf0b, 0xcf09, 0xcf08, 0xcf06, 0xcf04, 0xcf03, //  6928
-    0xcf01, 0xceff, 0xcefe, 0xcefc, 0xcefa, 0xcef9, 0xcef7, 0xcef5, //  6936
-    0xcef4, 0xcef2, 0xcef1, 0xceef, 0xceed, 0xceec, 0xceea, 0xcee8, //  6944
-    0xcee7, 0xcee5, 0xcee3, 0xcee2, 0xcee0, 0xcede, 0xcedd, 0xcedb, //  6952
-    0xced9, 0xced8, 0xced6, 0xced5, 0xced3, 0xced1, 0xced0, 0xcece, //  6960
-    0xcecc, 0xcecb, 0xcec9, 0xcec7, 0xcec6, 0xcec4, 0xcec2, 0xcec1, //  6968
-    0xcebf, 0xcebd, 0xcebc, 0xceba, 0xceb9, 0xceb7, 0xceb5, 0xceb4, //  6976
-    0xceb2, 0xceb0, 0xceaf, 0xcead, 0xceab, 0xceaa, 0xcea8, 0xcea6, //  6984
-    0xcea5, 0xcea3, 0xcea1, 0xcea0, 0xce9e, 0xce9d, 0xce9b, 0xce99, //  6992
-    0xce98, 0xce96, 0xce94, 0xce93, 0xce91, 0xce8f, 0xce8e, 0xce8c, //  7000
-    0xce8a, 0xce89, 0xce87, 0xce85, 0xce84, 0xce82, 0xce81, 0xce7f, //  7008
-    0xce7d, 0xce7c, 0xce7a, 0xce78, 0xce77, 0xce75, 0xce73, 0xce72, //  7016
-    0xce70, 0xce6e, 0xce6d, 0xce6b, 0xce6a, 0xce68, 0xce66, 0xce65, //  7024
-    0xce63, 0xce61, 0xce60, 0xce5e, 0xce5c, 0xce5b, 0xce59, 0xce57, //  7032
-    0xce56, 0xce54, 0xce52, 0xce51, 0xce4f, 0xce4e, 0xce4c, 0xce4a, //  7040
-    0xce49, 0xce47, 0xce45, 0xce44, 0xce42, 0xce40, 0xce3f, 0xce3d, //  7048
-    0xce3b, 0xce3a, 0xce38, 0xce36, 0xce35, 0xce33, 0xce32, 0xce30, //  7056
-    0xce2e, 0xce2d, 0xce2b, 0xce29, 0xce28, 0xce26, 0xce24, 0xce23, //  7064
-    0xce21, 0xce1f, 0xce1e, 0xce1c, 0xce1a, 0xce19, 0xce17, 0xce16, //  7072
-    0xce14, 0xce12, 0xce11, 0xce0f, 0xce0d, 0xce0c, 0xce0a, 0xce08, //  7080
-    0xce07, 0xce05, 0xce03, 0xce02, 0xce00, 0xcdfe, 0xcdfd, 0xcdfb, //  7088
-    0xcdfa, 0xcdf8, 0xcdf6, 0xcdf5, 0xcdf3, 0xcdf1, 0xcdf0, 0xcdee, //  7096
-    0xcdec, 0xcdeb, 0xcde9, 0xcde7, 0xcde6, 0xcde4, 0xcde2, 0xcde1, //  7104
-    0xcddf, 0xcdde, 0xcddc, 0xcdda, 0xcdd9, 0xcdd7, 0xcdd5, 0xcdd4, //  7112
-    0xcdd2, 0xcdd0, 0xcdcf, 0xcdcd, 0xcdcb, 0xcdca, 0xcdc8, 0xcdc7, //  7120
-    0xcdc5, 0xcdc3, 0xcdc2, 0xcdc0, 0xcdbe, 0xcdbd, 0xcdbb, 0xcdb9, //  7128
-    0xcdb8, 0xcdb6, 0xcdb4, 0xcdb3, 0xcdb1, 0xcdaf, 0xcdae, 0xcdac, //  7136
-    0xcdab, 0xcda9, 0xcda7, 0xcda6, 0xcda4, 0xcda2, 0xcda1, 0xcd9f, //  7144
-    0xcd9d, 0xcd9c, 0xcd9a, 0xcd98, 0xcd97, 0xcd95, 0xcd93, 0xcd92, //  7152
-    0xcd90, 0xcd8f, 0xcd8d, 0xcd8b, 0xcd8a, 0xcd88, 0xcd86, 0xcd85, //  7160
-    0xcd83, 0xcd81, 0xcd7f, 0xcd7e, 0xcd7c, 0xcd7a, 0xcd79, 0xcd77, //  7168
-    0xcd76, 0xcd74, 0xcd72, 0xcd71, 0xcd6f, 0xcd6e, 0xcd6c, 0xcd6a, //  7176
-    0xcd69, 0xcd67, 0xcd66, 0xcd64, 0xcd62, 0xcd61, 0xcd5f, 0xcd5e, //  7184
-    0xcd5c, 0xcd5a, 0xcd59, 0xcd57, 0xcd56, 0xcd54, 0xcd52, 0xcd51, //  7192
-    0xcd4f, 0xcd4e, 0xcd4c, 0xcd4a, 0xcd49, 0xcd47, 0xcd46, 0xcd44, //  7200
-    0xcd42, 0xcd41, 0xcd3f, 0xcd3e, 0xcd3c, 0xcd3a, 0xcd39, 0xcd37, //  7208
-    0xcd36, 0xcd34, 0xcd32, 0xcd31, 0xcd2f, 0xcd2e, 0xcd2c, 0xcd2a, //  7216
-    0xcd29, 0xcd27, 0xcd25, 0xcd24, 0xcd22, 0xcd21, 0xcd1f, 0xcd1d, //  7224
-    0xcd1c, 0xcd1a, 0xcd19, 0xcd17, 0xcd15, 0xcd14, 0xcd12, 0xcd11, //  7232
-    0xcd0f, 0xcd0d, 0xcd0c, 0xcd0a, 0xcd09, 0xcd07, 0xcd05, 0xcd04, //  7240
-    0xcd02, 0xcd01, 0xccff, 0xccfd, 0xccfc, 0xccfa, 0xccf9, 0xccf7, //  7248
-    0xccf5, 0xccf4, 0xccf2, 0xccf1, 0xccef, 0xcced, 0xccec, 0xccea, //  7256
-    0xcce9, 0xcce7, 0xcce5, 0xcce4, 0xcce2, 0xcce1, 0xccdf, 0xccdd, //  7264
-    0xccdc, 0xccda, 0xccd9, 0xccd7, 0xccd5, 0xccd4, 0xccd2, 0xccd1, //  7272
-    0xcccf, 0xcccd, 0xcccc, 0xccca, 0xccc8, 0xccc7, 0xccc5, 0xccc4, //  7280
-    0xccc2, 0xccc0, 0xccbf, 0xccbd, 0xccbc, 0xccba, 0xccb8, 0xccb7, //  7288
-    0xccb5, 0xccb4, 0xccb2, 0xccb0, 0xccaf, 0xccad, 0xccac, 0xccaa, //  7296
-    0xcca8, 0xcca7, 0xcca5, 0xcca4, 0xcca2, 0xcca0, 0xcc9f, 0xcc9d, //  7304
-    0xcc9c, 0xcc9a, 0xcc98, 0xcc97, 0xcc95, 0xcc94, 0xcc92, 0xcc90, //  7312
-    0xcc8f, 0xcc8d, 0xcc8c, 0xcc8a, 0xcc88, 0xcc87, 0xcc85, 0xcc84, //  7320
-    0xcc82, 0xcc80, 0xcc7f, 0xcc7d, 0xcc7c, 0xcc7a, 0xcc78, 0xcc77, //  7328
-    0xcc75, 0xcc74, 0xcc72, 0xcc70, 0xcc6f, 0xcc6d, 0xcc6b, 0xcc6a, //  7336
-    0xcc68, 0xcc67, 0xcc65, 0xcc63, 0xcc62, 0xcc60, 0xcc5f, 0xcc5d, //  7344
-    0xcc5b, 0xcc5a, 0xcc58, 0xcc57, 0xcc55, 0xcc53, 0xcc52, 0xcc50, //  7352
-    0xcc4f, 0xcc4d, 0xcc4b, 0xcc4a, 0xcc48, 0xcc47, 0xcc45, 0xcc43, //  7360
-    0xcc42, 0xcc40, 0xcc3f, 0xcc3d, 0xcc3b, 0xcc3a, 0xcc38, 0xcc37, //  7368
-    0xcc35, 0xcc33, 0xcc32, 0xcc30, 0xcc2f, 0xcc2d, 0xcc2b, 0xcc2a, //  7376
-    0xcc28, 0xcc27, 0xcc25, 0xcc23, 0xcc22, 0xcc20, 0xcc1f, 0xcc1d, //  7384
-    0xcc1b, 0xcc1a, 0xcc18, 0xcc17, 0xcc15, 0xcc13, 0xcc12, 0xcc10, //  7392
-    0xcc0e, 0xcc0d, 0xcc0b, 0xcc0a, 0xcc08, 0xcc06, 0xcc05, 0xcc03, //  7400
-    0xcc02, 0xcc00, 0xcbfe, 0xcbfd, 0xcbfb, 0xcbfa, 0xcbf8, 0xcbf6, //  7408
-    0xcbf5, 0xcbf3, 0xcbf2, 0xcbf0, 0xcbee, 0xcbed, 0xcbeb, 0xcbea, //  7416
-    0xcbe8, 0xcbe6, 0xcbe5, 0xcbe3, 0xcbe2, 0xcbe0, 0xcbde, 0xcbdd, //  7424
-    0xcbdb, 0xcbda, 0xcbd8, 0xcbd6, 0xcbd5, 0xcbd3, 0xcbd2, 0xcbd0, //  7432
-    0xcbce, 0xcbcd, 0xcbcb, 0xcbca, 0xcbc8, 0xcbc6, 0xcbc5, 0xcbc3, //  7440
-    0xcbc2, 0xcbc0, 0xcbbe, 0xcbbd, 0xcbbb, 0xcbb9, 0xcbb8, 0xcbb6, //  7448
-    0xcbb5, 0xcbb3, 0xcbb1, 0xcbb0, 0xcbae, 0xcbad, 0xcbab, 0xcba9, //  7456
-    0xcba8, 0xcba6, 0xcba5, 0xcba3, 0xcba1, 0xcba0, 0xcb9e, 0xcb9d, //  7464
-    0xcb9b, 0xcb99, 0xcb98, 0xcb96, 0xcb95, 0xcb93, 0xcb91, 0xcb90, //  7472
-    0xcb8e, 0xcb8d, 0xcb8b, 0xcb89, 0xcb88, 0xcb86, 0xcb85, 0xcb83, //  7480
-    0xcb81, 0xcb80, 0xcb7e, 0xcb7d, 0xcb7b, 0xcb79, 0xcb78, 0xcb76, //  7488
-    0xcb75, 0xcb73, 0xcb71, 0xcb70, 0xcb6e, 0xcb6d, 0xcb6b, 0xcb69, //  7496
-    0xcb68, 0xcb66, 0xcb65, 0xcb63, 0xcb61, 0xcb60, 0xcb5e, 0xcb5c, //  7504
-    0xcb5b, 0xcb59, 0xcb58, 0xcb56, 0xcb54, 0xcb53, 0xcb51, 0xcb50, //  7512
-    0xcb4e, 0xcb4c, 0xcb4b, 0xcb49, 0xcb48, 0xcb46, 0xcb44, 0xcb43, //  7520
-    0xcb41, 0xcb40, 0xcb3e, 0xcb3c, 0xcb3b, 0xcb39, 0xcb38, 0xcb36, //  7528
-    0xcb34, 0xcb33, 0xcb31, 0xcb30, 0xcb2e, 0xcb2c, 0xcb2b, 0xcb29, //  7536
-    0xcb28, 0xcb26, 0xcb24, 0xcb23, 0xcb21, 0xcb20, 0xcb1e, 0xcb1c, //  7544
-    0xcb1b, 0xcb19, 0xcb18, 0xcb16, 0xcb14, 0xcb13, 0xcb11, 0xcb10, //  7552
-    0xcb0e, 0xcb0c, 0xcb0b, 0xcb09, 0xcb08, 0xcb06, 0xcb04, 0xcb03, //  7560
-    0xcb01, 0xcaff, 0xcafe, 0xcafc, 0xcafb, 0xcaf9, 0xcaf7, 0xcaf6, //  7568
-    0xcaf4, 0xcaf3, 0xcaf1, 0xcaef, 0xcaee, 0xcaec, 0xcaeb, 0xcae9, //  7576
-    0xcae7, 0xcae6, 0xcae4, 0xcae3, 0xcae1, 0xcadf, 0xcade, 0xcadc, //  7584
-    0xcadb, 0xcad9, 0xcad7, 0xcad6, 0xcad4, 0xcad3, 0xcad1, 0xcacf, //  7592
-    0xcace, 0xcacc, 0xcacb, 0xcac9, 0xcac7, 0xcac6, 0xcac4, 0xcac3, //  7600
-    0xcac1, 0xcabf, 0xcabe, 0xcabc, 0xcabb, 0xcab9, 0xcab7, 0xcab6, //  7608
-    0xcab4, 0xcab3, 0xcab1, 0xcaaf, 0xcaae, 0xcaac, 0xcaab, 0xcaa9, //  7616
-    0xcaa7, 0xcaa6, 0xcaa4, 0xcaa2, 0xcaa1, 0xca9f, 0xca9e, 0xca9c, //  7624
-    0xca9a, 0xca99, 0xca97, 0xca96, 0xca94, 0xca92, 0xca91, 0xca8f, //  7632
-    0xca8e, 0xca8c, 0xca8a, 0xca89, 0xca87, 0xca86, 0xca84, 0xca82, //  7640
-    0xca81, 0xca7f, 0xca7e, 0xca7c, 0xca7a, 0xca79, 0xca77, 0xca76, //  7648
-    0xca74, 0xca72, 0xca71, 0xca6f, 0xca6e, 0xca6c, 0xca6a, 0xca69, //  7656
-    0xca67, 0xca66, 0xca64, 0xca62, 0xca61, 0xca5f, 0xca5e, 0xca5c, //  7664
-    0xca5a, 0xca59, 0xca57, 0xca56, 0xca54, 0xca52, 0xca51, 0xca4f, //  7672
-    0xca4e, 0xca4c, 0xca4a, 0xca49, 0xca47, 0xca45, 0xca44, 0xca42, //  7680
-    0xca41, 0xca3f, 0xca3d, 0xca3c, 0xca3a, 0xca39, 0xca37, 0xca35, //  7688
-    0xca34, 0xca32, 0xca31, 0xca2f, 0xca2d, 0xca2c, 0xca2a, 0xca29, //  7696
-    0xca27, 0xca25, 0xca24, 0xca22, 0xca21, 0xca1f, 0xca1d, 0xca1c, //  7704
-    0xca1a, 0xca19, 0xca17, 0xca15, 0xca14, 0xca12, 0xca11, 0xca0f, //  7712
-    0xca0d, 0xca0c, 0xca0a, 0xca09, 0xca07, 0xca05, 0xca04, 0xca02, //  7720
-    0xca01, 0xc9ff, 0xc9fd, 0xc9fc, 0xc9fa, 0xc9f9, 0xc9f7, 0xc9f5, //  7728
-    0xc9f4, 0xc9f2, 0xc9f0, 0xc9ef, 0xc9ed, 0xc9ec, 0xc9ea, 0xc9e8, //  7736
-    0xc9e7, 0xc9e5, 0xc9e4, 0xc9e2, 0xc9e0, 0xc9df, 0xc9dd, 0xc9dc, //  7744
-    0xc9da, 0xc9d8, 0xc9d7, 0xc9d5, 0xc9d4, 0xc9d2, 0xc9d0, 0xc9cf, //  7752
-    0xc9cd, 0xc9cc, 0xc9ca, 0xc9c8, 0xc9c7, 0xc9c5, 0xc9c4, 0xc9c2, //  7760
-    0xc9c0, 0xc9bf, 0xc9bd, 0xc9bc, 0xc9ba, 0xc9b8, 0xc9b7, 0xc9b5, //  7768
-    0xc9b4, 0xc9b2, 0xc9b0, 0xc9af, 0xc9ad, 0xc9ac, 0xc9aa, 0xc9a8, //  7776
-    0xc9a7, 0xc9a5, 0xc9a4, 0xc9a2, 0xc9a0, 0xc99f, 0xc99d, 0xc99c, //  7784
-    0xc99a, 0xc998, 0xc997, 0xc995, 0xc993, 0xc992, 0xc990, 0xc98f, //  7792
-    0xc98d, 0xc98b, 0xc98a, 0xc988, 0xc987, 0xc985, 0xc983, 0xc982, //  7800
-    0xc980, 0xc97f, 0xc97d, 0xc97b, 0xc97a, 0xc978, 0xc977, 0xc975, //  7808
-    0xc973, 0xc972, 0xc970, 0xc96f, 0xc96d, 0xc96b, 0xc96a, 0xc968, //  7816
-    0xc967, 0xc965, 0xc963, 0xc962, 0xc960, 0xc95f, 0xc95d, 0xc95b, //  7824
-    0xc95a, 0xc958, 0xc957, 0xc955, 0xc953, 0xc952, 0xc950, 0xc94f, //  7832
-    0xc94d, 0xc94b, 0xc94a, 0xc948, 0xc947, 0xc945, 0xc943, 0xc942, //  7840
-    0xc940, 0xc93f, 0xc93d, 0xc93b, 0xc93a, 0xc938, 0xc936, 0xc935, //  7848
-    0xc933, 0xc932, 0xc930, 0xc92e, 0xc92d, 0xc92b, 0xc92a, 0xc928, //  7856
-    0xc926, 0xc925, 0xc923, 0xc922, 0xc920, 0xc91e, 0xc91d, 0xc91b, //  7864
-    0xc91a, 0xc918, 0xc916, 0xc915, 0xc913, 0xc912, 0xc910, 0xc90e, //  7872
-    0xc90d, 0xc90b, 0xc90a, 0xc908, 0xc906, 0xc905, 0xc903, 0xc902, //  7880
-    0xc900, 0xc8fe, 0xc8fd, 0xc8fb, 0xc8fa, 0xc8f8, 0xc8f6, 0xc8f5, //  7888
-    0xc8f3, 0xc8f2, 0xc8f0, 0xc8ee, 0xc8ed, 0xc8eb, 0xc8ea, 0xc8e8, //  7896
-    0xc8e6, 0xc8e5, 0xc8e3, 0xc8e2, 0xc8e0, 0xc8de, 0xc8dd, 0xc8db, //  7904
-    0xc8d9, 0xc8d8, 0xc8d6, 0xc8d5, 0xc8d3, 0xc8d1, 0xc8d0, 0xc8ce, //  7912
-    0xc8cd, 0xc8cb, 0xc8c9, 0xc8c8, 0xc8c6, 0xc8c5, 0xc8c3, 0xc8c1, //  7920
-    0xc8c0, 0xc8be, 0xc8bd, 0xc8bb, 0xc8b9, 0xc8b8, 0xc8b6, 0xc8b5, //  7928
-    0xc8b3, 0xc8b1, 0xc8b0, 0xc8ae, 0xc8ad, 0xc8ab, 0xc8a9, 0xc8a8, //  7936
-    0xc8a6, 0xc8a5, 0xc8a3, 0xc8a1, 0xc8a0, 0xc89e, 0xc89d, 0xc89b, //  7944
-    0xc899, 0xc898, 0xc896, 0xc895, 0xc893, 0xc891, 0xc890, 0xc88e, //  7952
-    0xc88d, 0xc88b, 0xc889, 0xc888, 0xc886, 0xc884, 0xc883, 0xc881, //  7960
-    0xc880, 0xc87e, 0xc87c, 0xc87b, 0xc879, 0xc878, 0xc876, 0xc874, //  7968
-    0xc873, 0xc871, 0xc870, 0xc86e, 0xc86c, 0xc86b, 0xc869, 0xc868, //  7976
-    0xc866, 0xc864, 0xc863, 0xc861, 0xc860, 0xc85e, 0xc85c, 0xc85b, //  7984
-    0xc859, 0xc858, 0xc856, 0xc854, 0xc853, 0xc851, 0xc850, 0xc84e, //  7992
-    0xc84c, 0xc84b, 0xc849, 0xc848, 0xc846, 0xc844, 0xc843, 0xc841, //  8000
-    0xc840, 0xc83e, 0xc83c, 0xc83b, 0xc839, 0xc838, 0xc836, 0xc834, //  8008
-    0xc833, 0xc831, 0xc830, 0xc82e, 0xc82c, 0xc82b, 0xc829, 0xc827, //  8016
-    0xc826, 0xc824, 0xc823, 0xc821, 0xc81f, 0xc81e, 0xc81c, 0xc81b, //  8024
-    0xc819, 0xc817, 0xc816, 0xc814, 0xc813, 0xc811, 0xc80f, 0xc80e, //  8032
-    0xc80c, 0xc80b, 0xc809, 0xc807, 0xc806, 0xc804, 0xc803, 0xc801, //  8040
-    0xc7ff, 0xc7fe, 0xc7fc, 0xc7fb, 0xc7f9, 0xc7f7, 0xc7f6, 0xc7f4, //  8048
-    0xc7f3, 0xc7f1, 0xc7ef, 0xc7ee, 0xc7ec, 0xc7eb, 0xc7e9, 0xc7e7, //  8056
-    0xc7e6, 0xc7e4, 0xc7e3, 0xc7e1, 0xc7df, 0xc7de, 0xc7dc, 0xc7db, //  8064
-    0xc7d9, 0xc7d7, 0xc7d6, 0xc7d4, 0xc7d3, 0xc7d1, 0xc7cf, 0xc7ce, //  8072
-    0xc7cc, 0xc7ca, 0xc7c9, 0xc7c7, 0xc7c6, 0xc7c4, 0xc7c2, 0xc7c1, //  8080
-    0xc7bf, 0xc7be, 0xc7bc, 0xc7ba, 0xc7b9, 0xc7b7, 0xc7b6, 0xc7b4, //  8088
-    0xc7b2, 0xc7b1, 0xc7af, 0xc7ae, 0xc7ac, 0xc7aa, 0xc7a9, 0xc7a7, //  8096
-    0xc7a6, 0xc7a4, 0xc7a2, 0xc7a1, 0xc79f, 0xc79e, 0xc79c, 0xc79a, //  8104
-    0xc799, 0xc797, 0xc796, 0xc794, 0xc792, 0xc791, 0xc78f, 0xc78e, //  8112
-    0xc78c, 0xc78a, 0xc789, 0xc787, 0xc786, 0xc784, 0xc782, 0xc781, //  8120
-    0xc77f, 0xc77e, 0xc77c, 0xc77a, 0xc779, 0xc777, 0xc776, 0xc774, //  8128
-    0xc772, 0xc771, 0xc76f, 0xc76d, 0xc76c, 0xc76a, 0xc769, 0xc767, //  8136
-    0xc765, 0xc764, 0xc762, 0xc761, 0xc75f, 0xc75d, 0xc75c, 0xc75a, //  8144
-    0xc759, 0xc757, 0xc755, 0xc754, 0xc752, 0xc751, 0xc74f, 0xc74d, //  8152
-    0xc74c, 0xc74a, 0xc749, 0xc747, 0xc745, 0xc744, 0xc742, 0xc741, //  8160
-    0xc73f, 0xc73d, 0xc73c, 0xc73a, 0xc739, 0xc737, 0xc735, 0xc734, //  8168
-    0xc732, 0xc731, 0xc72f, 0xc72d, 0xc72c, 0xc72a, 0xc729, 0xc727, //  8176
-    0xc725, 0xc724, 0xc722, 0xc721, 0xc71f, 0xc71d, 0xc71c, 0xc71a, //  8184
-    0xc719, 0xc717, 0xc715, 0xc714, 0xc712, 0xc711, 0xc70f, 0xc70e, //  8192
-    0xc70c, 0xc70a, 0xc709, 0xc707, 0xc706, 0xc704, 0xc703, 0xc701, //  8200
-    0xc700, 0xc6fe, 0xc6fc, 0xc6fb, 0xc6f9, 0xc6f8, 0xc6f6, 0xc6f5, //  8208
-    0xc6f3, 0xc6f2, 0xc6f0, 0xc6ee, 0xc6ed, 0xc6eb, 0xc6ea, 0xc6e8, //  8216
-    0xc6e7, 0xc6e5, 0xc6e4, 0xc6e2, 0xc6e0, 0xc6df, 0xc6dd, 0xc6dc, //  8224
-    0xc6da, 0xc6d9, 0xc6d7, 0xc6d6, 0xc6d4, 0xc6d2, 0xc6d1, 0xc6cf, //  8232
-    0xc6ce, 0xc6cc, 0xc6cb, 0xc6c9, 0xc6c8, 0xc6c6, 0xc6c4, 0xc6c3, //  8240
-    0xc6c1, 0xc6c0, 0xc6be, 0xc6bd, 0xc6bb, 0xc6ba, 0xc6b8, 0xc6b6, //  8248
-    0xc6b5, 0xc6b3, 0xc6b2, 0xc6b0, 0xc6af, 0xc6ad, 0xc6ac, 0xc6aa, //  8256
-    0xc6a8, 0xc6a7, 0xc6a5, 0xc6a4, 0xc6a2, 0xc6a1, 0xc69f, 0xc69e, //  8264
-    0xc69c, 0xc69a, 0xc699, 0xc697, 0xc696, 0xc694, 0xc693, 0xc691, //  8272
-    0xc690, 0xc68e, 0xc68c, 0xc68b, 0xc689, 0xc688, 0xc686, 0xc685, //  8280
-    0xc683, 0xc682, 0xc680, 0xc67e, 0xc67d, 0xc67b, 0xc67a, 0xc678, //  8288
-    0xc677, 0xc675, 0xc673, 0xc672, 0xc670, 0xc66f, 0xc66d, 0xc66c, //  8296
-    0xc66a, 0xc669, 0xc667, 0xc665, 0xc664, 0xc662, 0xc661, 0xc65f, //  8304
-    0xc65e, 0xc65c, 0xc65b, 0xc659, 0xc657, 0xc656, 0xc654, 0xc653, //  8312
-    0xc651, 0xc650, 0xc64e, 0xc64d, 0xc64b, 0xc649, 0xc648, 0xc646, //  8320
-    0xc645, 0xc643, 0xc642, 0xc640, 0xc63f, 0xc63d, 0xc63b, 0xc63a, //  8328
-    0xc638, 0xc637, 0xc635, 0xc634, 0xc632, 0xc631, 0xc62f, 0xc62d, //  8336
-    0xc62c, 0xc62a, 0xc629, 0xc627, 0xc626, 0xc624, 0xc623, 0xc621, //  8344
-    0xc61f, 0xc61e, 0xc61c, 0xc61b, 0xc619, 0xc618, 0xc616, 0xc615, //  8352
-    0xc613, 0xc611, 0xc610, 0xc60e, 0xc60d, 0xc60b, 0xc60a, 0xc608, //  8360
-    0xc607, 0xc605, 0xc603, 0xc602, 0xc600, 0xc5ff, 0xc5fd, 0xc5fc, //  8368
-    0xc5fa, 0xc5f9, 0xc5f7, 0xc5f5, 0xc5f4, 0xc5f2, 0xc5f1, 0xc5ef, //  8376
-    0xc5ee, 0xc5ec, 0xc5eb, 0xc5e9, 0xc5e7, 0xc5e6, 0xc5e4, 0xc5e3, //  8384
-    0xc5e1, 0xc5e0, 0xc5de, 0xc5dd, 0xc5db, 0xc5d9, 0xc5d8, 0xc5d6, //  8392
-    0xc5d5, 0xc5d3, 0xc5d2, 0xc5d0, 0xc5ce, 0xc5cd, 0xc5cb, 0xc5ca, //  8400
-    0xc5c8, 0xc5c7, 0xc5c5, 0xc5c4, 0xc5c2, 0xc5c0, 0xc5bf, 0xc5bd, //  8408
-    0xc5bc, 0xc5ba, 0xc5b9, 0xc5b7, 0xc5b6, 0xc5b4, 0xc5b2, 0xc5b1, //  8416
-    0xc5af, 0xc5ae, 0xc5ac, 0xc5ab, 0xc5a9, 0xc5a8, 0xc5a6, 0xc5a4, //  8424
-    0xc5a3, 0xc5a1, 0xc5a0, 0xc59e, 0xc59d, 0xc59b, 0xc59a, 0xc598, //  8432
-    0xc596, 0xc595, 0xc593, 0xc592, 0xc590, 0xc58f, 0xc58d, 0xc58c, //  8440
-    0xc58a, 0xc588, 0xc587, 0xc585, 0xc584, 0xc582, 0xc581, 0xc57f, //  8448
-    0xc57e, 0xc57c, 0xc57a, 0xc579, 0xc577, 0xc576, 0xc574, 0xc573, //  8456
-    0xc571, 0xc570, 0xc56e, 0xc56c, 0xc56b, 0xc569, 0xc568, 0xc566, //  8464
-    0xc565, 0xc563, 0xc562, 0xc560, 0xc55e, 0xc55d, 0xc55b, 0xc55a, //  8472
-    0xc558, 0xc557, 0xc555, 0xc554, 0xc552, 0xc550, 0xc54f, 0xc54d, //  8480
-    0xc54c, 0xc54a, 0xc549, 0xc547, 0xc546, 0xc544, 0xc542, 0xc541, //  8488
-    0xc53f, 0xc53e, 0xc53c, 0xc53b, 0xc539, 0xc537, 0xc536, 0xc534, //  8496
-    0xc533, 0xc531, 0xc530, 0xc52e, 0xc52d, 0xc52b, 0xc529, 0xc528, //  8504
-    0xc526, 0xc525, 0xc523, 0xc522, 0xc520, 0xc51f, 0xc51d, 0xc51b, //  8512
-    0xc51a, 0xc518, 0xc517, 0xc515, 0xc514, 0xc512, 0xc511, 0xc50f, //  8520
-    0xc50d, 0xc50c, 0xc50a, 0xc509, 0xc507, 0xc506, 0xc504, 0xc503, //  8528
-    0xc501, 0xc4ff, 0xc4fe, 0xc4fc, 0xc4fb, 0xc4f9, 0xc4f8, 0xc4f6, //  8536
-    0xc4f5, 0xc4f3, 0xc4f1, 0xc4f0, 0xc4ee, 0xc4ed, 0xc4eb, 0xc4ea, //  8544
-    0xc4e8, 0xc4e7, 0xc4e5, 0xc4e3, 0xc4e2, 0xc4e0, 0xc4df, 0xc4dd, //  8552
-    0xc4dc, 0xc4da, 0xc4d9, 0xc4d7, 0xc4d5, 0xc4d4, 0xc4d2, 0xc4d1, //  8560
-    0xc4cf, 0xc4ce, 0xc4cc, 0xc4cb, 0xc4c9, 0xc4c7, 0xc4c6, 0xc4c4, //  8568
-    0xc4c3, 0xc4c1, 0xc4c0, 0xc4be, 0xc4bd, 0xc4bb, 0xc4b9, 0xc4b8, //  8576
-    0xc4b6, 0xc4b5, 0xc4b3, 0xc4b2, 0xc4b0, 0xc4af, 0xc4ad, 0xc4ab, //  8584
-    0xc4aa, 0xc4a8, 0xc4a7, 0xc4a5, 0xc4a4, 0xc4a2, 0xc4a1, 0xc49f, //  8592
-    0xc49d, 0xc49c, 0xc49a, 0xc499, 0xc497, 0xc496, 0xc494, 0xc492, //  8600
-    0xc491, 0xc48f, 0xc48e, 0xc48c, 0xc48b, 0xc489, 0xc488, 0xc486, //  8608
-    0xc484, 0xc483, 0xc481, 0xc480, 0xc47e, 0xc47d, 0xc47b, 0xc47a, //  8616
-    0xc478, 0xc476, 0xc475, 0xc473, 0xc472, 0xc470, 0xc46f, 0xc46d, //  8624
-    0xc46c, 0xc46a, 0xc468, 0xc467, 0xc465, 0xc464, 0xc462, 0xc461, //  8632
-    0xc45f, 0xc45e, 0xc45c, 0xc45a, 0xc459, 0xc457, 0xc456, 0xc454, //  8640
-    0xc453, 0xc451, 0xc450, 0xc44e, 0xc44c, 0xc44b, 0xc449, 0xc448, //  8648
-    0xc446, 0xc445, 0xc443, 0xc442, 0xc440, 0xc43e, 0xc43d, 0xc43b, //  8656
-    0xc43a, 0xc438, 0xc437, 0xc435, 0xc434, 0xc432, 0xc430, 0xc42f, //  8664
-    0xc42d, 0xc42c, 0xc42a, 0xc429, 0xc427, 0xc426, 0xc424, 0xc422, //  8672
-    0xc421, 0xc41f, 0xc41e, 0xc41c, 0xc41b, 0xc419, 0xc418, 0xc416, //  8680
-    0xc414, 0xc413, 0xc411, 0xc410, 0xc40e, 0xc40d, 0xc40b, 0xc40a, //  8688
-    0xc408, 0xc406, 0xc405, 0xc403, 0xc402, 0xc400, 0xc3ff, 0xc3fd, //  8696
-    0xc3fc, 0xc3fa, 0xc3f8, 0xc3f7, 0xc3f5, 0xc3f4, 0xc3f2, 0xc3f1, //  8704
-    0xc3ef, 0xc3ed, 0xc3ec, 0xc3ea, 0xc3e9, 0xc3e7, 0xc3e6, 0xc3e4, //  8712
-    0xc3e3, 0xc3e1, 0xc3df, 0xc3de, 0xc3dc, 0xc3db, 0xc3d9, 0xc3d8, //  8720
-    0xc3d6, 0xc3d5, 0xc3d3, 0xc3d1, 0xc3d0, 0xc3ce, 0xc3cd, 0xc3cb, //  8728
-    0xc3ca, 0xc3c8, 0xc3c7, 0xc3c5, 0xc3c3, 0xc3c2, 0xc3c0, 0xc3bf, //  8736
-    0xc3bd, 0xc3bc, 0xc3ba, 0xc3b9, 0xc3b7, 0xc3b5, 0xc3b4, 0xc3b2, //  8744
-    0xc3b1, 0xc3af, 0xc3ae, 0xc3ac, 0xc3ab, 0xc3a9, 0xc3a7, 0xc3a6, //  8752
-    0xc3a4, 0xc3a3, 0xc3a1, 0xc3a0, 0xc39e, 0xc39d, 0xc39b, 0xc399, //  8760
-    0xc398, 0xc396, 0xc395, 0xc393, 0xc392, 0xc390, 0xc38f, 0xc38d, //  8768
-    0xc38b, 0xc38a, 0xc388, 0xc387, 0xc385, 0xc384, 0xc382, 0xc381, //  8776
-    0xc37f, 0xc37d, 0xc37c, 0xc37a, 0xc379, 0xc377, 0xc376, 0xc374, //  8784
-    0xc373, 0xc371, 0xc36f, 0xc36e, 0xc36c, 0xc36b, 0xc369, 0xc368, //  8792
-    0xc366, 0xc365, 0xc363, 0xc361, 0xc360, 0xc35e, 0xc35d, 0xc35b, //  8800
-    0xc35a, 0xc358, 0xc356, 0xc355, 0xc353, 0xc352, 0xc350, 0xc34f, //  8808
-    0xc34d, 0xc34c, 0xc34a, 0xc348, 0xc347, 0xc345, 0xc344, 0xc342, //  8816
-    0xc341, 0xc33f, 0xc33e, 0xc33c, 0xc33a, 0xc339, 0xc337, 0xc336, //  8824
-    0xc334, 0xc333, 0xc331, 0xc330, 0xc32e, 0xc32c, 0xc32b, 0xc329, //  8832
-    0xc328, 0xc326, 0xc325, 0xc323, 0xc322, 0xc320, 0xc31e, 0xc31d, //  8840
-    0xc31b, 0xc31a, 0xc318, 0xc317, 0xc315, 0xc314, 0xc312, 0xc310, //  8848
-    0xc30f, 0xc30d, 0xc30c, 0xc30a, 0xc309, 0xc307, 0xc306, 0xc304, //  8856
-    0xc302, 0xc301, 0xc2ff, 0xc2fe, 0xc2fc, 0xc2fb, 0xc2f9, 0xc2f8, //  8864
-    0xc2f6, 0xc2f4, 0xc2f3, 0xc2f1, 0xc2f0, 0xc2ee, 0xc2ed, 0xc2eb, //  8872
-    0xc2ea, 0xc2e8, 0xc2e6, 0xc2e5, 0xc2e3, 0xc2e2, 0xc2e0, 0xc2df, //  8880
-    0xc2dd, 0xc2dc, 0xc2da, 0xc2d8, 0xc2d7, 0xc2d5, 0xc2d4, 0xc2d2, //  8888
-    0xc2d1, 0xc2cf, 0xc2ce, 0xc2cc, 0xc2ca, 0xc2c9, 0xc2c7, 0xc2c6, //  8896
-    0xc2c4, 0xc2c3, 0xc2c1, 0xc2c0, 0xc2be, 0xc2bc, 0xc2bb, 0xc2b9, //  8904
-    0xc2b8, 0xc2b6, 0xc2b5, 0xc2b3, 0xc2b1, 0xc2b0, 0xc2ae, 0xc2ad, //  8912
-    0xc2ab, 0xc2aa, 0xc2a8, 0xc2a7, 0xc2a5, 0xc2a3, 0xc2a2, 0xc2a0, //  8920
-    0xc29f, 0xc29d, 0xc29c, 0xc29a, 0xc299, 0xc297, 0xc295, 0xc294, //  8928
-    0xc292, 0xc291, 0xc28f, 0xc28e, 0xc28c, 0xc28b, 0xc289, 0xc287, //  8936
-    0xc286, 0xc284, 0xc283, 0xc281, 0xc280, 0xc27e, 0xc27d, 0xc27b, //  8944
-    0xc279, 0xc278, 0xc276, 0xc275, 0xc273, 0xc272, 0xc270, 0xc26f, //  8952
-    0xc26d, 0xc26b, 0xc26a, 0xc268, 0xc267, 0xc265, 0xc264, 0xc262, //  8960
-    0xc261, 0xc25f, 0xc25d, 0xc25c, 0xc25a, 0xc259, 0xc257, 0xc256, //  8968
-    0xc254, 0xc253, 0xc251, 0xc24f, 0xc24e, 0xc24c, 0xc24b, 0xc249, //  8976
-    0xc248, 0xc246, 0xc245, 0xc243, 0xc241, 0xc240, 0xc23e, 0xc23d, //  8984
-    0xc23b, 0xc23a, 0xc238, 0xc237, 0xc235, 0xc233, 0xc232, 0xc230, //  8992
-    0xc22f, 0xc22d, 0xc22c, 0xc22a, 0xc229, 0xc227, 0xc225, 0xc224, //  9000
-    0xc222, 0xc221, 0xc21f, 0xc21e, 0xc21c, 0xc21a, 0xc219, 0xc217, //  9008
-    0xc216, 0xc214, 0xc213, 0xc211, 0xc210, 0xc20e, 0xc20c, 0xc20b, //  9016
-    0xc209, 0xc208, 0xc206, 0xc205, 0xc203, 0xc202, 0xc200, 0xc1fe, //  9024
-    0xc1fd, 0xc1fb, 0xc1fa, 0xc1f8, 0xc1f7, 0xc1f5, 0xc1f4, 0xc1f2, //  9032
-    0xc1f0, 0xc1ef, 0xc1ed, 0xc1ec, 0xc1ea, 0xc1e9, 0xc1e7, 0xc1e6, //  9040
-    0xc1e4, 0xc1e2, 0xc1e1, 0xc1df, 0xc1de, 0xc1dc, 0xc1db, 0xc1d9, //  9048
-    0xc1d8, 0xc1d6, 0xc1d4, 0xc1d3, 0xc1d1, 0xc1d0, 0xc1ce, 0xc1cd, //  9056
-    0xc1cb, 0xc1ca, 0xc1c8, 0xc1c6, 0xc1c5, 0xc1c3, 0xc1c2, 0xc1c0, //  9064
-    0xc1bf, 0xc1bd, 0xc1bc, 0xc1ba, 0xc1b8, 0xc1b7, 0xc1b5, 0xc1b4, //  9072
-    0xc1b2, 0xc1b1, 0xc1af, 0xc1ae, 0xc1ac, 0xc1aa, 0xc1a9, 0xc1a7, //  9080
-    0xc1a6, 0xc1a4, 0xc1a3, 0xc1a1, 0xc1a0, 0xc19e, 0xc19c, 0xc19b, //  9088
-    0xc199, 0xc198, 0xc196, 0xc195, 0xc193, 0xc192, 0xc190, 0xc18e, //  9096
-    0xc18d, 0xc18b, 0xc18a, 0xc188, 0xc187, 0xc185, 0xc184, 0xc182, //  9104
-    0xc180, 0xc17f, 0xc17d, 0xc17c, 0xc17a, 0xc179, 0xc177, 0xc175, //  9112
-    0xc174, 0xc172, 0xc171, 0xc16f, 0xc16e, 0xc16c, 0xc16b, 0xc169, //  9120
-    0xc167, 0xc166, 0xc164, 0xc163, 0xc161, 0xc160, 0xc15e, 0xc15d, //  9128
-    0xc15b, 0xc159, 0xc158, 0xc156, 0xc155, 0xc153, 0xc152, 0xc150, //  9136
-    0xc14f, 0xc14d, 0xc14b, 0xc14a, 0xc148, 0xc147, 0xc145, 0xc144, //  9144
-    0xc142, 0xc141, 0xc13f, 0xc13d, 0xc13c, 0xc13a, 0xc139, 0xc137, //  9152
-    0xc136, 0xc134, 0xc133, 0xc131, 0xc12f, 0xc12e, 0xc12c, 0xc12b, //  9160
-    0xc129, 0xc128, 0xc126, 0xc125, 0xc123, 0xc121, 0xc120, 0xc11e, //  9168
-    0xc11d, 0xc11b, 0xc11a, 0xc118, 0xc117, 0xc115, 0xc113, 0xc112, //  9176
-    0xc110, 0xc10f, 0xc10d, 0xc10c, 0xc10a, 0xc109, 0xc107, 0xc105, //  9184
-    0xc104, 0xc102, 0xc101, 0xc0ff, 0xc0fe, 0xc0fc, 0xc0fb, 0xc0f9, //  9192
-    0xc0f7, 0xc0f6, 0xc0f4, 0xc0f3, 0xc0f1, 0xc0f0, 0xc0ee, 0xc0ed, //  9200
-    0xc0eb, 0xc0e9, 0xc0e8, 0xc0e6, 0xc0e5, 0xc0e3, 0xc0e2, 0xc0e0, //  9208
-    0xc0de, 0xc0dc, 0xc0da, 0xc0d9, 0xc0d7, 0xc0d6, 0xc0d4, 0xc0d3, //  9216
-    0xc0d1, 0xc0d0, 0xc0ce, 0xc0cd, 0xc0cb, 0xc0ca, 0xc0c8, 0xc0c7, //  9224
-    0xc0c5, 0xc0c4, 0xc0c2, 0xc0c1, 0xc0bf, 0xc0be, 0xc0bc, 0xc0bb, //  9232
-    0xc0b9, 0xc0b8, 0xc0b6, 0xc0b5, 0xc0b3, 0xc0b1, 0xc0b0, 0xc0ae, //  9240
-    0xc0ad, 0xc0ab, 0xc0aa, 0xc0a8, 0xc0a7, 0xc0a5, 0xc0a4, 0xc0a2, //  9248
-    0xc0a1, 0xc09f, 0xc09e, 0xc09c, 0xc09b, 0xc099, 0xc098, 0xc096, //  9256
-    0xc095, 0xc093, 0xc092, 0xc090, 0xc08f, 0xc08d, 0xc08c, 0xc08a, //  9264
-    0xc089, 0xc087, 0xc085, 0xc084, 0xc082, 0xc081, 0xc07f, 0xc07e, //  9272
-    0xc07c, 0xc07b, 0xc079, 0xc078, 0xc076, 0xc075, 0xc073, 0xc072, //  9280
-    0xc070, 0xc06f, 0xc06d, 0xc06c, 0xc06a, 0xc069, 0xc067, 0xc066, //  9288
-    0xc064, 0xc063, 0xc061, 0xc060, 0xc05e, 0xc05d, 0xc05b, 0xc059, //  9296
-    0xc058, 0xc056, 0xc055, 0xc053, 0xc052, 0xc050, 0xc04f, 0xc04d, //  9304
-    0xc04c, 0xc04a, 0xc049, 0xc047, 0xc046, 0xc044, 0xc043, 0xc041, //  9312
-    0xc040, 0xc03e, 0xc03d, 0xc03b, 0xc03a, 0xc038, 0xc037, 0xc035, //  9320
-    0xc034, 0xc032, 0xc030, 0xc02f, 0xc02d, 0xc02c, 0xc02a, 0xc029, //  9328
-    0xc027, 0xc026, 0xc024, 0xc023, 0xc021, 0xc020, 0xc01e, 0xc01d, //  9336
-    0xc01b, 0xc01a, 0xc018, 0xc017, 0xc015, 0xc014, 0xc012, 0xc011, //  9344
-    0xc00f, 0xc00e, 0xc00c, 0xc00b, 0xc009, 0xc008, 0xc006, 0xc004, //  9352
-    0xc003, 0xc001, 0xc000, 0xbffe, 0xbffd, 0xbffb, 0xbffa, 0xbff8, //  9360
-    0xbff7, 0xbff5, 0xbff4, 0xbff2, 0xbff1, 0xbfef, 0xbfee, 0xbfec, //  9368
-    0xbfeb, 0xbfe9, 0xbfe8, 0xbfe6, 0xbfe5, 0xbfe3, 0xbfe2, 0xbfe0, //  9376
-    0xbfdf, 0xbfdd, 0xbfdc, 0xbfda, 0xbfd8, 0xbfd7, 0xbfd5, 0xbfd4, //  9384
-    0xbfd2, 0xbfd1, 0xbfcf, 0xbfce, 0xbfcc, 0xbfcb, 0xbfc9, 0xbfc8, //  9392
-    0xbfc6, 0xbfc5, 0xbfc3, 0xbfc2, 0xbfc0, 0xbfbf, 0xbfbd, 0xbfbc, //  9400
-    0xbfba, 0xbfb9, 0xbfb7, 0xbfb6, 0xbfb4, 0xbfb3, 0xbfb1, 0xbfb0, //  9408
-    0xbfae, 0xbfac, 0xbfab, 0xbfa9, 0xbfa8, 0xbfa6, 0xbfa5, 0xbfa3, //  9416
-    0xbfa2, 0xbfa0, 0xbf9f, 0xbf9d, 0xbf9c, 0xbf9a, 0xbf99, 0xbf97, //  9424
-    0xbf96, 0xbf94, 0xbf93, 0xbf91, 0xbf90, 0xbf8e, 0xbf8d, 0xbf8b, //  9432
-    0xbf8a, 0xbf88, 0xbf87, 0xbf85, 0xbf83, 0xbf82, 0xbf80, 0xbf7f, //  9440
-    0xbf7d, 0xbf7c, 0xbf7a, 0xbf79, 0xbf77, 0xbf76, 0xbf74, 0xbf73, //  9448
-    0xbf71, 0xbf70, 0xbf6e, 0xbf6d, 0xbf6b, 0xbf6a, 0xbf68, 0xbf67, //  9456
-    0xbf65, 0xbf64, 0xbf62, 0xbf61, 0xbf5f, 0xbf5e, 0xbf5c, 0xbf5b, //  9464
-    0xbf59, 0xbf57, 0xbf56, 0xbf54, 0xbf53, 0xbf51, 0xbf50, 0xbf4e, //  9472
-    0xbf4d, 0xbf4b, 0xbf4a, 0xbf48, 0xbf47, 0xbf45, 0xbf44, 0xbf42, //  9480
-    0xbf41, 0xbf3f, 0xbf3e, 0xbf3c, 0xbf3b, 0xbf39, 0xbf38, 0xbf36, //  9488
-    0xbf35, 0xbf33, 0xbf32, 0xbf30, 0xbf2f, 0xbf2d, 0xbf2b, 0xbf2a, //  9496
-    0xbf28, 0xbf27, 0xbf25, 0xbf24, 0xbf22, 0xbf21, 0xbf1f, 0xbf1e, //  9504
-    0xbf1c, 0xbf1b, 0xbf19, 0xbf18, 0xbf16, 0xbf15, 0xbf13, 0xbf12, //  9512
-    0xbf10, 0xbf0f, 0xbf0d, 0xbf0c, 0xbf0a, 0xbf09, 0xbf07, 0xbf06, //  9520
-    0xbf04, 0xbf02, 0xbf01, 0xbeff, 0xbefe, 0xbefc, 0xbefb, 0xbef9, //  9528
-    0xbef8, 0xbef6, 0xbef5, 0xbef3, 0xbef2, 0xbef0, 0xbeef, 0xbeed, //  9536
-    0xbeec, 0xbeea, 0xbee9, 0xbee7, 0xbee6, 0xbee4, 0xbee3, 0xbee1, //  9544
-    0xbee0, 0xbede, 0xbedd, 0xbedb, 0xbeda, 0xbed8, 0xbed6, 0xbed5, //  9552
-    0xbed3, 0xbed2, 0xbed0, 0xbecf, 0xbecd, 0xbecc, 0xbeca, 0xbec9, //  9560
-    0xbec7, 0xbec6, 0xbec4, 0xbec3, 0xbec1, 0xbec0, 0xbebe, 0xbebd, //  9568
-    0xbebb, 0xbeba, 0xbeb8, 0xbeb7, 0xbeb5, 0xbeb4, 0xbeb2, 0xbeb1, //  9576
-    0xbeaf, 0xbeae, 0xbeac, 0xbeaa, 0xbea9, 0xbea7, 0xbea6, 0xbea4, //  9584
-    0xbea3, 0xbea1, 0xbea0, 0xbe9e, 0xbe9d, 0xbe9b, 0xbe9a, 0xbe98, //  9592
-    0xbe97, 0xbe95, 0xbe94, 0xbe92, 0xbe91, 0xbe8f, 0xbe8e, 0xbe8c, //  9600
-    0xbe8b, 0xbe89, 0xbe88, 0xbe86, 0xbe85, 0xbe83, 0xbe82, 0xbe80, //  9608
-    0xbe7e, 0xbe7d, 0xbe7b, 0xbe7a, 0xbe78, 0xbe77, 0xbe75, 0xbe74, //  9616
-    0xbe72, 0xbe71, 0xbe6f, 0xbe6e, 0xbe6c, 0xbe6b, 0xbe69, 0xbe68, //  9624
-    0xbe66, 0xbe65, 0xbe63, 0xbe62, 0xbe60, 0xbe5f, 0xbe5d, 0xbe5c, //  9632
-    0xbe5a, 0xbe59, 0xbe57, 0xbe55, 0xbe54, 0xbe52, 0xbe51, 0xbe4f, //  9640
-    0xbe4e, 0xbe4c, 0xbe4b, 0xbe49, 0xbe48, 0xbe46, 0xbe45, 0xbe43, //  9648
-    0xbe42, 0xbe40, 0xbe3f, 0xbe3d, 0xbe3c, 0xbe3a, 0xbe39, 0xbe37, //  9656
-    0xbe36, 0xbe34, 0xbe33, 0xbe31, 0xbe30, 0xbe2e, 0xbe2d, 0xbe2b, //  9664
-    0xbe29, 0xbe28, 0xbe26, 0xbe25, 0xbe23, 0xbe22, 0xbe20, 0xbe1f, //  9672
-    0xbe1d, 0xbe1c, 0xbe1a, 0xbe19, 0xbe17, 0xbe16, 0xbe14, 0xbe13, //  9680
-    0xbe11, 0xbe10, 0xbe0e, 0xbe0d, 0xbe0b, 0xbe0a, 0xbe08, 0xbe07, //  9688
-    0xbe05, 0xbe04, 0xbe02, 0xbe01, 0xbdff, 0xbdfd, 0xbdfc, 0xbdfa, //  9696
-    0xbdf9, 0xbdf7, 0xbdf6, 0xbdf4, 0xbdf3, 0xbdf1, 0xbdf0, 0xbdee, //  9704
-    0xbded, 0xbdeb, 0xbdea, 0xbde8, 0xbde7, 0xbde5, 0xbde4, 0xbde2, //  9712
-    0xbde1, 0xbddf, 0xbdde, 0xbddc, 0xbddb, 0xbdd9, 0xbdd8, 0xbdd6, //  9720
-    0xbdd5, 0xbdd3, 0xbdd1, 0xbdd0, 0xbdce, 0xbdcd, 0xbdcb, 0xbdca, //  9728
-    0xbdc8, 0xbdc7, 0xbdc5, 0xbdc4, 0xbdc2, 0xbdc1, 0xbdbf, 0xbdbe, //  9736
-    0xbdbc, 0xbdbb, 0xbdb9, 0xbdb8, 0xbdb6, 0xbdb5, 0xbdb3, 0xbdb2, //  9744
-    0xbdb0, 0xbdaf, 0xbdad, 0xbdac, 0xbdaa, 0xbda8, 0xbda7, 0xbda5, //  9752
-    0xbda4, 0xbda2, 0xbda1, 0xbd9f, 0xbd9e, 0xbd9c, 0xbd9b, 0xbd99, //  9760
-    0xbd98, 0xbd96, 0xbd95, 0xbd93, 0xbd92, 0xbd90, 0xbd8f, 0xbd8d, //  9768
-    0xbd8c, 0xbd8a, 0xbd89, 0xbd87, 0xbd86, 0xbd84, 0xbd83, 0xbd81, //  9776
-    0xbd80, 0xbd7e, 0xbd7c, 0xbd7b, 0xbd79, 0xbd78, 0xbd76, 0xbd75, //  9784
-    0xbd73, 0xbd72, 0xbd70, 0xbd6f, 0xbd6d, 0xbd6c, 0xbd6a, 0xbd69, //  9792
-    0xbd67, 0xbd66, 0xbd64, 0xbd63, 0xbd61, 0xbd60, 0xbd5e, 0xbd5d, //  9800
-    0xbd5b, 0xbd5a, 0xbd58, 0xbd57, 0xbd55, 0xbd54, 0xbd52, 0xbd50, //  9808
-    0xbd4f, 0xbd4d, 0xbd4c, 0xbd4a, 0xbd49, 0xbd47, 0xbd46, 0xbd44, //  9816
-    0xbd43, 0xbd41, 0xbd40, 0xbd3e, 0xbd3d, 0xbd3b, 0xbd3a, 0xbd38, //  9824
-    0xbd37, 0xbd35, 0xbd34, 0xbd32, 0xbd31, 0xbd2f, 0xbd2e, 0xbd2c, //  9832
-    0xbd2b, 0xbd29, 0xbd27, 0xbd26, 0xbd24, 0xbd23, 0xbd21, 0xbd20, //  9840
-    0xbd1e, 0xbd1d, 0xbd1b, 0xbd1a, 0xbd18, 0xbd17, 0xbd15, 0xbd14, //  9848
-    0xbd12, 0xbd11, 0xbd0f, 0xbd0e, 0xbd0c, 0xbd0b, 0xbd09, 0xbd08, //  9856
-    0xbd06, 0xbd05, 0xbd03, 0xbd02, 0xbd00, 0xbcff, 0xbcfd, 0xbcfb, //  9864
-    0xbcfa, 0xbcf8, 0xbcf7, 0xbcf5, 0xbcf4, 0xbcf2, 0xbcf1, 0xbcef, //  9872
-    0xbcee, 0xbcec, 0xbceb, 0xbce9, 0xbce8, 0xbce6, 0xbce5, 0xbce3, //  9880
-    0xbce2, 0xbce0, 0xbcdf, 0xbcdd, 0xbcdc, 0xbcda, 0xbcd9, 0xbcd7, //  9888
-    0xbcd6, 0xbcd4, 0xbcd3, 0xbcd1, 0xbccf, 0xbcce, 0xbccc, 0xbccb, //  9896
-    0xbcc9, 0xbcc8, 0xbcc6, 0xbcc5, 0xbcc3, 0xbcc2, 0xbcc0, 0xbcbf, //  9904
-    0xbcbd, 0xbcbc, 0xbcba, 0xbcb9, 0xbcb7, 0xbcb6, 0xbcb4, 0xbcb3, //  9912
-    0xbcb1, 0xbcb0, 0xbcae, 0xbcad, 0xbcab, 0xbcaa, 0xbca8, 0xbca7, //  9920
-    0xbca5, 0xbca3, 0xbca2, 0xbca0, 0xbc9f, 0xbc9d, 0xbc9c, 0xbc9a, //  9928
-    0xbc99, 0xbc97, 0xbc96, 0xbc94, 0xbc93, 0xbc91, 0xbc90, 0xbc8e, //  9936
-    0xbc8d, 0xbc8b, 0xbc8a, 0xbc88, 0xbc87, 0xbc85, 0xbc84, 0xbc82, //  9944
-    0xbc81, 0xbc7f, 0xbc7e, 0xbc7c, 0xbc7a, 0xbc79, 0xbc77, 0xbc76, //  9952
-    0xbc74, 0xbc73, 0xbc71, 0xbc70, 0xbc6e, 0xbc6d, 0xbc6b, 0xbc6a, //  9960
-    0xbc68, 0xbc67, 0xbc65, 0xbc64, 0xbc62, 0xbc61, 0xbc5f, 0xbc5e, //  9968
-    0xbc5c, 0xbc5b, 0xbc59, 0xbc58, 0xbc56, 0xbc55, 0xbc53, 0xbc52, //  9976
-    0xbc50, 0xbc4e, 0xbc4d, 0xbc4b, 0xbc4a, 0xbc48, 0xbc47, 0xbc45, //  9984
-    0xbc44, 0xbc42, 0xbc41, 0xbc3f, 0xbc3e, 0xbc3c, 0xbc3b, 0xbc39, //  9992
-    0xbc38, 0xbc36, 0xbc35, 0xbc33, 0xbc32, 0xbc30, 0xbc2f, 0xbc2d, // 10000
-    0xbc2c, 0xbc2a, 0xbc29, 0xbc27, 0xbc26, 0xbc24, 0xbc22, 0xbc21, // 10008
-    0xbc1f, 0xbc1e, 0xbc1c, 0xbc1b, 0xbc19, 0xbc18, 0xbc16, 0xbc15, // 10016
-    0xbc13, 0xbc12, 0xbc10, 0xbc0f, 0xbc0d, 0xbc0c, 0xbc0a, 0xbc09, // 10024
-    0xbc07, 0xbc06, 0xbc04, 0xbc03, 0xbc01, 0xbc00, 0xbbfe, 0xbbfd, // 10032
-    0xbbfb, 0xbbf9, 0xbbf8, 0xbbf6, 0xbbf5, 0xbbf3, 0xbbf2, 0xbbf0, // 10040
-    0xbbef, 0xbbed, 0xbbec, 0xbbea, 0xbbe9, 0xbbe7, 0xbbe6, 0xbbe4, // 10048
-    0xbbe3, 0xbbe1, 0xbbe0, 0xbbde, 0xbbdd, 0xbbdb, 0xbbda, 0xbbd8, // 10056
-    0xbbd7, 0xbbd5, 0xbbd4, 0xbbd2, 0xbbd1, 0xbbcf, 0xbbcd, 0xbbcc, // 10064
-    0xbbca, 0xbbc9, 0xbbc7, 0xbbc6, 0xbbc4, 0xbbc3, 0xbbc1, 0xbbc0, // 10072
-    0xbbbe, 0xbbbd, 0xbbbb, 0xbbba, 0xbbb8, 0xbbb7, 0xbbb5, 0xbbb4, // 10080
-    0xbbb2, 0xbbb1, 0xbbaf, 0xbbae, 0xbbac, 0xbbab, 0xbba9, 0xbba8, // 10088
-    0xbba6, 0xbba5, 0xbba3, 0xbba1, 0xbba0, 0xbb9e, 0xbb9d, 0xbb9b, // 10096
-    0xbb9a, 0xbb98, 0xbb97, 0xbb95, 0xbb94, 0xbb92, 0xbb91, 0xbb8f, // 10104
-    0xbb8e, 0xbb8c, 0xbb8b, 0xbb89, 0xbb88, 0xbb86, 0xbb85, 0xbb83, // 10112
-    0xbb82, 0xbb80, 0xbb7f, 0xbb7d, 0xbb7c, 0xbb7a, 0xbb79, 0xbb77, // 10120
-    0xbb75, 0xbb74, 0xbb72, 0xbb71, 0xbb6f, 0xbb6e, 0xbb6c, 0xbb6b, // 10128
-    0xbb69, 0xbb68, 0xbb66, 0xbb65, 0xbb63, 0xbb62, 0xbb60, 0xbb5f, // 10136
-    0xbb5d, 0xbb5c, 0xbb5a, 0xbb59, 0xbb57, 0xbb56, 0xbb54, 0xbb53, // 10144
-    0xbb51, 0xbb50, 0xbb4e, 0xbb4c, 0xbb4b, 0xbb49, 0xbb48, 0xbb46, // 10152
-    0xbb45, 0xbb43, 0xbb42, 0xbb40, 0xbb3f, 0xbb3d, 0xbb3c, 0xbb3a, // 10160
-    0xbb39, 0xbb37, 0xbb36, 0xbb34, 0xbb33, 0xbb31, 0xbb30, 0xbb2e, // 10168
-    0xbb2d, 0xbb2b, 0xbb2a, 0xbb28, 0xbb27, 0xbb25, 0xbb24, 0xbb22, // 10176
-    0xbb20, 0xbb1f, 0xbb1d, 0xbb1c, 0xbb1a, 0xbb19, 0xbb17, 0xbb16, // 10184
-    0xbb14, 0xbb13, 0xbb11, 0xbb10, 0xbb0e, 0xbb0d, 0xbb0b, 0xbb0a, // 10192
-    0xbb08, 0xbb07, 0xbb05, 0xbb04, 0xbb02, 0xbb01, 0xbaff, 0xbafe, // 10200
-    0xbafc, 0xbafb, 0xbaf9, 0xbaf8, 0xbaf6, 0xbaf4, 0xbaf3, 0xbaf1, // 10208
-    0xbaf0, 0xbaee, 0xbaed, 0xbaeb, 0xbaea, 0xbae8, 0xbae7, 0xbae5, // 10216
-    0xbae4, 0xbae2, 0xbae1, 0xbadf, 0xbade, 0xbadc, 0xbadb, 0xbad9, // 10224
-    0xbad8, 0xbad6, 0xbad5, 0xbad3, 0xbad2, 0xbad0, 0xbacf, 0xbacd, // 10232
-    0xbacc, 0xbaca, 0xbac9, 0xbac7, 0xbac6, 0xbac4, 0xbac3, 0xbac1, // 10240
-    0xbac0, 0xbabe, 0xbabd, 0xbabb, 0xbaba, 0xbab8, 0xbab7, 0xbab5, // 10248
-    0xbab4, 0xbab2, 0xbab1, 0xbaaf, 0xbaae, 0xbaad, 0xbaab, 0xbaaa, // 10256
-    0xbaa8, 0xbaa7, 0xbaa5, 0xbaa4, 0xbaa2, 0xbaa1, 0xba9f, 0xba9e, // 10264
-    0xba9c, 0xba9b, 0xba99, 0xba98, 0xba96, 0xba95, 0xba93, 0xba92, // 10272
-    0xba91, 0xba8f, 0xba8e, 0xba8c, 0xba8b, 0xba89, 0xba88, 0xba86, // 10280
-    0xba85, 0xba83, 0xba82, 0xba80, 0xba7f, 0xba7d, 0xba7c, 0xba7a, // 10288
-    0xba79, 0xba77, 0xba76, 0xba74, 0xba73, 0xba72, 0xba70, 0xba6f, // 10296
-    0xba6d, 0xba6c, 0xba6a, 0xba69, 0xba67, 0xba66, 0xba64, 0xba63, // 10304
-    0xba61, 0xba60, 0xba5e, 0xba5d, 0xba5b, 0xba5a, 0xba58, 0xba57, // 10312
-    0xba56, 0xba54, 0xba53, 0xba51, 0xba50, 0xba4e, 0xba4d, 0xba4b, // 10320
-    0xba4a, 0xba48, 0xba47, 0xba45, 0xba44, 0xba42, 0xba41, 0xba3f, // 10328
-    0xba3e, 0xba3c, 0xba3b, 0xba3a, 0xba38, 0xba37, 0xba35, 0xba34, // 10336
-    0xba32, 0xba31, 0xba2f, 0xba2e, 0xba2c, 0xba2b, 0xba29, 0xba28, // 10344
-    0xba26, 0xba25, 0xba23, 0xba22, 0xba20, 0xba1f, 0xba1d, 0xba1c, // 10352
-    0xba1b, 0xba19, 0xba18, 0xba16, 0xba15, 0xba13, 0xba12, 0xba10, // 10360
-    0xba0f, 0xba0d, 0xba0c, 0xba0a, 0xba09, 0xba07, 0xba06, 0xba04, // 10368
-    0xba03, 0xba01, 0xba00, 0xb9ff, 0xb9fd, 0xb9fc, 0xb9fa, 0xb9f9, // 10376
-    0xb9f7, 0xb9f6, 0xb9f4, 0xb9f3, 0xb9f1, 0xb9f0, 0xb9ee, 0xb9ed, // 10384
-    0xb9eb, 0xb9ea, 0xb9e8, 0xb9e7, 0xb9e5, 0xb9e4, 0xb9e3, 0xb9e1, // 10392
-    0xb9e0, 0xb9de, 0xb9dd, 0xb9db, 0xb9da, 0xb9d8, 0xb9d7, 0xb9d5, // 10400
-    0xb9d4, 0xb9d2, 0xb9d1, 0xb9cf, 0xb9ce, 0xb9cc, 0xb9cb, 0xb9c9, // 10408
-    0xb9c8, 0xb9c6, 0xb9c5, 0xb9c4, 0xb9c2, 0xb9c1, 0xb9bf, 0xb9be, // 10416
-    0xb9bc, 0xb9bb, 0xb9b9, 0xb9b8, 0xb9b6, 0xb9b5, 0xb9b3, 0xb9b2, // 10424
-    0xb9b0, 0xb9af, 0xb9ad, 0xb9ac, 0xb9aa, 0xb9a9, 0xb9a8, 0xb9a6, // 10432
-    0xb9a5, 0xb9a3, 0xb9a2, 0xb9a0, 0xb99f, 0xb99d, 0xb99c, 0xb99a, // 10440
-    0xb999, 0xb997, 0xb996, 0xb994, 0xb993, 0xb991, 0xb990, 0xb98e, // 10448
-    0xb98d, 0xb98c, 0xb98a, 0xb989, 0xb987, 0xb986, 0xb984, 0xb983, // 10456
-    0xb981, 0xb980, 0xb97e, 0xb97d, 0xb97b, 0xb97a, 0xb978, 0xb977, // 10464
-    0xb975, 0xb974, 0xb972, 0xb971, 0xb96f, 0xb96e, 0xb96d, 0xb96b, // 10472
-    0xb96a, 0xb968, 0xb967, 0xb965, 0xb964, 0xb962, 0xb961, 0xb95f, // 10480
-    0xb95e, 0xb95c, 0xb95b, 0xb959, 0xb958, 0xb956, 0xb955, 0xb953, // 10488
-    0xb952, 0xb951, 0xb94f, 0xb94e, 0xb94c, 0xb94b, 0xb949, 0xb948, // 10496
-    0xb946, 0xb945, 0xb943, 0xb942, 0xb940, 0xb93f, 0xb93d, 0xb93c, // 10504
-    0xb93a, 0xb939, 0xb937, 0xb936, 0xb935, 0xb933, 0xb932, 0xb930, // 10512
-    0xb92f, 0xb92d, 0xb92c, 0xb92a, 0xb929, 0xb927, 0xb926, 0xb924, // 10520
-    0xb923, 0xb921, 0xb920, 0xb91e, 0xb91d, 0xb91b, 0xb91a, 0xb918, // 10528
-    0xb917, 0xb916, 0xb914, 0xb913, 0xb911, 0xb910, 0xb90e, 0xb90d, // 10536
-    0xb90b, 0xb90a, 0xb908, 0xb907, 0xb905, 0xb904, 0xb902, 0xb901, // 10544
-    0xb8ff, 0xb8fe, 0xb8fc, 0xb8fb, 0xb8fa, 0xb8f8, 0xb8f7, 0xb8f5, // 10552
-    0xb8f4, 0xb8f2, 0xb8f1, 0xb8ef, 0xb8ee, 0xb8ec, 0xb8eb, 0xb8e9, // 10560
-    0xb8e8, 0xb8e6, 0xb8e5, 0xb8e3, 0xb8e2, 0xb8e0, 0xb8df, 0xb8de, // 10568
-    0xb8dc, 0xb8db, 0xb8d9, 0xb8d8, 0xb8d6, 0xb8d5, 0xb8d3, 0xb8d2, // 10576
-    0xb8d0, 0xb8cf, 0xb8cd, 0xb8cc, 0xb8ca, 0xb8c9, 0xb8c7, 0xb8c6, // 10584
-    0xb8c4, 0xb8c3, 0xb8c1, 0xb8c0, 0xb8bf, 0xb8bd, 0xb8bc, 0xb8ba, // 10592
-    0xb8b9, 0xb8b7, 0xb8b6, 0xb8b4, 0xb8b3, 0xb8b1, 0xb8b0, 0xb8ae, // 10600
-    0xb8ad, 0xb8ab, 0xb8aa, 0xb8a8, 0xb8a7, 0xb8a5, 0xb8a4, 0xb8a3, // 10608
-    0xb8a1, 0xb8a0, 0xb89e, 0xb89d, 0xb89b, 0xb89a, 0xb898, 0xb897, // 10616
-    0xb895, 0xb894, 0xb892, 0xb891, 0xb88f, 0xb88e, 0xb88c, 0xb88b, // 10624
-    0xb889, 0xb888, 0xb887, 0xb885, 0xb884, 0xb882, 0xb881, 0xb87f, // 10632
-    0xb87e, 0xb87c, 0xb87b, 0xb879, 0xb878, 0xb876, 0xb875, 0xb873, // 10640
-    0xb872, 0xb870, 0xb86f, 0xb86d, 0xb86c, 0xb86a, 0xb869, 0xb868, // 10648
-    0xb866, 0xb865, 0xb863, 0xb862, 0xb860, 0xb85f, 0xb85d, 0xb85c, // 10656
-    0xb85a, 0xb859, 0xb857, 0xb856, 0xb854, 0xb853, 0xb851, 0xb850, // 10664
-    0xb84e, 0xb84d, 0xb84c, 0xb84a, 0xb849, 0xb847, 0xb846, 0xb844, // 10672
-    0xb843, 0xb841, 0xb840, 0xb83e, 0xb83d, 0xb83b, 0xb83a, 0xb838, // 10680
-    0xb837, 0xb835, 0xb834, 0xb832, 0xb831, 0xb830, 0xb82e, 0xb82d, // 10688
-    0xb82b, 0xb82a, 0xb828, 0xb827, 0xb825, 0xb824, 0xb822, 0xb821, // 10696
-    0xb81f, 0xb81e, 0xb81c, 0xb81b, 0xb819, 0xb818, 0xb816, 0xb815, // 10704
-    0xb813, 0xb812, 0xb811, 0xb80f, 0xb80e, 0xb80c, 0xb80b, 0xb809, // 10712
-    0xb808, 0xb806, 0xb805, 0xb803, 0xb802, 0xb800, 0xb7ff, 0xb7fd, // 10720
-    0xb7fc, 0xb7fa, 0xb7f9, 0xb7f7, 0xb7f6, 0xb7f5, 0xb7f3, 0xb7f2, // 10728
-    0xb7f0, 0xb7ef, 0xb7ed, 0xb7ec, 0xb7ea, 0xb7e9, 0xb7e7, 0xb7e6, // 10736
-    0xb7e4, 0xb7e3, 0xb7e1, 0xb7e0, 0xb7de, 0xb7dd, 0xb7db, 0xb7da, // 10744
-    0xb7d9, 0xb7d7, 0xb7d6, 0xb7d4, 0xb7d3, 0xb7d1, 0xb7d0, 0xb7ce, // 10752
-    0xb7cd, 0xb7cb, 0xb7ca, 0xb7c8, 0xb7c7, 0xb7c5, 0xb7c4, 0xb7c2, // 10760
-    0xb7c1, 0xb7bf, 0xb7be, 0xb7bc, 0xb7bb, 0xb7ba, 0xb7b8, 0xb7b7, // 10768
-    0xb7b5, 0xb7b4, 0xb7b2, 0xb7b1, 0xb7af, 0xb7ae, 0xb7ac, 0xb7ab, // 10776
-    0xb7a9, 0xb7a8, 0xb7a6, 0xb7a5, 0xb7a3, 0xb7a2, 0xb7a0, 0xb79f, // 10784
-    0xb79e, 0xb79c, 0xb79b, 0xb799, 0xb798, 0xb796, 0xb795, 0xb793, // 10792
-    0xb792, 0xb790, 0xb78f, 0xb78d, 0xb78c, 0xb78a, 0xb789, 0xb787, // 10800
-    0xb786, 0xb784, 0xb783, 0xb781, 0xb780, 0xb77f, 0xb77d, 0xb77c, // 10808
-    0xb77a, 0xb779, 0xb777, 0xb776, 0xb774, 0xb773, 0xb771, 0xb770, // 10816
-    0xb76e, 0xb76d, 0xb76b, 0xb76a, 0xb768, 0xb767, 0xb765, 0xb764, // 10824
-    0xb763, 0xb761, 0xb760, 0xb75e, 0xb75d, 0xb75b, 0xb75a, 0xb758, // 10832
-    0xb757, 0xb755, 0xb754, 0xb752, 0xb751, 0xb74f, 0xb74e, 0xb74c, // 10840
-    0xb74b, 0xb749, 0xb748, 0xb747, 0xb745, 0xb744, 0xb742, 0xb741, // 10848
-    0xb73f, 0xb73e, 0xb73c, 0xb73b, 0xb739, 0xb738, 0xb736, 0xb735, // 10856
-    0xb733, 0xb732, 0xb730, 0xb72f, 0xb72d, 0xb72c, 0xb72a, 0xb729, // 10864
-    0xb728, 0xb726, 0xb725, 0xb723, 0xb722, 0xb720, 0xb71f, 0xb71d, // 10872
-    0xb71c, 0xb71a, 0xb719, 0xb717, 0xb716, 0xb714, 0xb713, 0xb711, // 10880
-    0xb710, 0xb70e, 0xb70d, 0xb70c, 0xb70a, 0xb709, 0xb707, 0xb706, // 10888
-    0xb704, 0xb703, 0xb701, 0xb700, 0xb6fe, 0xb6fd, 0xb6fb, 0xb6fa, // 10896
-    0xb6f8, 0xb6f7, 0xb6f5, 0xb6f4, 0xb6f2, 0xb6f1, 0xb6f0, 0xb6ee, // 10904
-    0xb6ed, 0xb6eb, 0xb6ea, 0xb6e8, 0xb6e7, 0xb6e5, 0xb6e4, 0xb6e2, // 10912
-    0xb6e1, 0xb6df, 0xb6de, 0xb6dc, 0xb6db, 0xb6d9, 0xb6d8, 0xb6d6, // 10920
-    0xb6d5, 0xb6d3, 0xb6d2, 0xb6d1, 0xb6cf, 0xb6ce, 0xb6cc, 0xb6cb, // 10928
-    0xb6c9, 0xb6c8, 0xb6c6, 0xb6c5, 0xb6c3, 0xb6c2, 0xb6c0, 0xb6bf, // 10936
-    0xb6bd, 0xb6bc, 0xb6ba, 0xb6b9, 0xb6b7, 0xb6b6, 0xb6b5, 0xb6b3, // 10944
-    0xb6b2, 0xb6b0, 0xb6af, 0xb6ad, 0xb6ac, 0xb6aa, 0xb6a9, 0xb6a7, // 10952
-    0xb6a6, 0xb6a4, 0xb6a3, 0xb6a1, 0xb6a0, 0xb69e, 0xb69d, 0xb69b, // 10960
-    0xb69a, 0xb699, 0xb697, 0xb696, 0xb694, 0xb693, 0xb691, 0xb690, // 10968
-    0xb68e, 0xb68d, 0xb68b, 0xb68a, 0xb688, 0xb687, 0xb685, 0xb684, // 10976
-    0xb682, 0xb681, 0xb67f, 0xb67e, 0xb67c, 0xb67b, 0xb67a, 0xb678, // 10984
-    0xb677, 0xb675, 0xb674, 0xb672, 0xb671, 0xb66f, 0xb66e, 0xb66c, // 10992
-    0xb66b, 0xb669, 0xb668, 0xb666, 0xb665, 0xb663, 0xb662, 0xb660, // 11000
-    0xb65f, 0xb65e, 0xb65c, 0xb65b, 0xb659, 0xb658, 0xb656, 0xb655, // 11008
-    0xb653, 0xb652, 0xb650, 0xb64f, 0xb64d, 0xb64c, 0xb64a, 0xb649, // 11016
-    0xb647, 0xb646, 0xb644, 0xb643, 0xb642, 0xb640, 0xb63f, 0xb63d, // 11024
-    0xb63c, 0xb63a, 0xb639, 0xb637, 0xb636, 0xb634, 0xb633, 0xb631, // 11032
-    0xb630, 0xb62e, 0xb62d, 0xb62b, 0xb62a, 0xb628, 0xb627, 0xb625, // 11040
-    0xb624, 0xb623, 0xb621, 0xb620, 0xb61e, 0xb61d, 0xb61b, 0xb61a, // 11048
-    0xb618, 0xb617, 0xb615, 0xb614, 0xb612, 0xb611, 0xb60f, 0xb60e, // 11056
-    0xb60c, 0xb60b, 0xb609, 0xb608, 0xb607, 0xb605, 0xb604, 0xb602, // 11064
-    0xb601, 0xb5ff, 0xb5fe, 0xb5fc, 0xb5fb, 0xb5f9, 0xb5f8, 0xb5f6, // 11072
-    0xb5f5, 0xb5f3, 0xb5f2, 0xb5f0, 0xb5ef, 0xb5ed, 0xb5ec, 0xb5eb, // 11080
-    0xb5e9, 0xb5e8, 0xb5e6, 0xb5e5, 0xb5e3, 0xb5e2, 0xb5e0, 0xb5df, // 11088
-    0xb5dd, 0xb5dc, 0xb5da, 0xb5d9, 0xb5d7, 0xb5d6, 0xb5d4, 0xb5d3, // 11096
-    0xb5d1, 0xb5d0, 0xb5ce, 0xb5cd, 0xb5cc, 0xb5ca, 0xb5c9, 0xb5c7, // 11104
-    0xb5c6, 0xb5c4, 0xb5c3, 0xb5c1, 0xb5c0, 0xb5be, 0xb5bd, 0xb5bb, // 11112
-    0xb5ba, 0xb5b8, 0xb5b7, 0xb5b5, 0xb5b4, 0xb5b2, 0xb5b1, 0xb5b0, // 11120
-    0xb5ae, 0xb5ad, 0xb5ab, 0xb5aa, 0xb5a8, 0xb5a7, 0xb5a5, 0xb5a4, // 11128
-    0xb5a2, 0xb5a1, 0xb59f, 0xb59e, 0xb59c, 0xb59b, 0xb599, 0xb598, // 11136
-    0xb596, 0xb595, 0xb594, 0xb592, 0xb591, 0xb58f, 0xb58e, 0xb58c, // 11144
-    0xb58b, 0xb589, 0xb588, 0xb586, 0xb585, 0xb583, 0xb582, 0xb580, // 11152
-    0xb57f, 0xb57d, 0xb57c, 0xb57a, 0xb579, 0xb577, 0xb576, 0xb575, // 11160
-    0xb573, 0xb572, 0xb570, 0xb56f, 0xb56d, 0xb56c, 0xb56a, 0xb569, // 11168
-    0xb567, 0xb566, 0xb564, 0xb563, 0xb561, 0xb560, 0xb55e, 0xb55d, // 11176
-    0xb55b, 0xb55a, 0xb559, 0xb557, 0xb556, 0xb554, 0xb553, 0xb551, // 11184
-    0xb550, 0xb54e, 0xb54d, 0xb54b, 0xb54a, 0xb548, 0xb547, 0xb545, // 11192
-    0xb544, 0xb542, 0xb541, 0xb53f, 0xb53e, 0xb53d, 0xb53b, 0xb53a, // 11200
-    0xb538, 0xb537, 0xb535, 0xb534, 0xb532, 0xb531, 0xb52f, 0xb52e, // 11208
-    0xb52c, 0xb52b, 0xb529, 0xb528, 0xb526, 0xb525, 0xb523, 0xb522, // 11216
-    0xb520, 0xb51f, 0xb51e, 0xb51c, 0xb51b, 0xb519, 0xb518, 0xb516, // 11224
-    0xb515, 0xb513, 0xb512, 0xb510, 0xb50f, 0xb50d, 0xb50c, 0xb50a, // 11232
-    0xb509, 0xb507, 0xb506, 0xb504, 0xb503, 0xb502, 0xb500, 0xb4ff, // 11240
-    0xb4fd, 0xb4fc, 0xb4fa, 0xb4f9, 0xb4f7, 0xb4f6, 0xb4f4, 0xb4f3, // 11248
-    0xb4f1, 0xb4f0, 0xb4ee, 0xb4ed, 0xb4eb, 0xb4ea, 0xb4e8, 0xb4e7, // 11256
-    0xb4e5, 0xb4e3, 0xb4e2, 0xb4e0, 0xb4df, 0xb4dd, 0xb4dc, 0xb4da, // 11264
-    0xb4d9, 0xb4d8, 0xb4d6, 0xb4d5, 0xb4d3, 0xb4d2, 0xb4d0, 0xb4cf, // 11272
-    0xb4ce, 0xb4cc, 0xb4cb, 0xb4c9, 0xb4c8, 0xb4c6, 0xb4c5, 0xb4c3, // 11280
-    0xb4c2, 0xb4c1, 0xb4bf, 0xb4be, 0xb4bc, 0xb4bb, 0xb4b9, 0xb4b8, // 11288
-    0xb4b7, 0xb4b5, 0xb4b4, 0xb4b2, 0xb4b1, 0xb4af, 0xb4ae, 0xb4ad, // 11296
-    0xb4ab, 0xb4aa, 0xb4a8, 0xb4a7, 0xb4a5, 0xb4a4, 0xb4a2, 0xb4a1, // 11304
-    0xb4a0, 0xb49e, 0xb49d, 0xb49b, 0xb49a, 0xb498, 0xb497, 0xb496, // 11312
-    0xb494, 0xb493, 0xb491, 0xb490, 0xb48e, 0xb48d, 0xb48b, 0xb48a, // 11320
-    0xb489, 0xb487, 0xb486, 0xb484, 0xb483, 0xb481, 0xb480, 0xb47f, // 11328
-    0xb47d, 0xb47c, 0xb47a, 0xb479, 0xb477, 0xb476, 0xb475, 0xb473, // 11336
-    0xb472, 0xb470, 0xb46f, 0xb46d, 0xb46c, 0xb46a, 0xb469, 0xb468, // 11344
-    0xb466, 0xb465, 0xb463, 0xb462, 0xb460, 0xb45f, 0xb45e, 0xb45c, // 11352
-    0xb45b, 0xb459, 0xb458, 0xb456, 0xb455, 0xb454, 0xb452, 0xb451, // 11360
-    0xb44f, 0xb44e, 0xb44c, 0xb44b, 0xb449, 0xb448, 0xb447, 0xb445, // 11368
-    0xb444, 0xb442, 0xb441, 0xb43f, 0xb43e, 0xb43d, 0xb43b, 0xb43a, // 11376
-    0xb438, 0xb437, 0xb435, 0xb434, 0xb432, 0xb431, 0xb430, 0xb42e, // 11384
-    0xb42d, 0xb42b, 0xb42a, 0xb428, 0xb427, 0xb426, 0xb424, 0xb423, // 11392
-    0xb421, 0xb420, 0xb41e, 0xb41d, 0xb41c, 0xb41a, 0xb419, 0xb417, // 11400
-    0xb416, 0xb414, 0xb413, 0xb411, 0xb410, 0xb40f, 0xb40d, 0xb40c, // 11408
-    0xb40a, 0xb409, 0xb407, 0xb406, 0xb405, 0xb403, 0xb402, 0xb400, // 11416
-    0xb3ff, 0xb3fd, 0xb3fc, 0xb3fb, 0xb3f9, 0xb3f8, 0xb3f6, 0xb3f5, // 11424
-    0xb3f3, 0xb3f2, 0xb3f0, 0xb3ef, 0xb3ee, 0xb3ec, 0xb3eb, 0xb3e9, // 11432
-    0xb3e8, 0xb3e6, 0xb3e5, 0xb3e4, 0xb3e2, 0xb3e1, 0xb3df, 0xb3de, // 11440
-    0xb3dc, 0xb3db, 0xb3d9, 0xb3d8, 0xb3d7, 0xb3d5, 0xb3d4, 0xb3d2, // 11448
-    0xb3d1, 0xb3cf, 0xb3ce, 0xb3cd, 0xb3cb, 0xb3ca, 0xb3c8, 0xb3c7, // 11456
-    0xb3c5, 0xb3c4, 0xb3c3, 0xb3c1, 0xb3c0, 0xb3be, 0xb3bd, 0xb3bb, // 11464
-    0xb3ba, 0xb3b8, 0xb3b7, 0xb3b6, 0xb3b4, 0xb3b3, 0xb3b1, 0xb3b0, // 11472
-    0xb3ae, 0xb3ad, 0xb3ac, 0xb3aa, 0xb3a9, 0xb3a7, 0xb3a6, 0xb3a4, // 11480
-    0xb3a3, 0xb3a2, 0xb3a0, 0xb39f, 0xb39d, 0xb39c, 0xb39a, 0xb399, // 11488
-    0xb397, 0xb396, 0xb395, 0xb393, 0xb392, 0xb390, 0xb38f, 0xb38d, // 11496
-    0xb38c, 0xb38b, 0xb389, 0xb388, 0xb386, 0xb385, 0xb383, 0xb382, // 11504
-    0xb380, 0xb37f, 0xb37e, 0xb37c, 0xb37b, 0xb379, 0xb378, 0xb376, // 11512
-    0xb375, 0xb374, 0xb372, 0xb371, 0xb36f, 0xb36e, 0xb36c, 0xb36b, // 11520
-    0xb36a, 0xb368, 0xb367, 0xb365, 0xb364, 0xb362, 0xb361, 0xb35f, // 11528
-    0xb35e, 0xb35d, 0xb35b, 0xb35a, 0xb358, 0xb357, 0xb355, 0xb354, // 11536
-    0xb353, 0xb351, 0xb350, 0xb34e, 0xb34d, 0xb34b, 0xb34a, 0xb348, // 11544
-    0xb347, 0xb346, 0xb344, 0xb343, 0xb341, 0xb340, 0xb33e, 0xb33d, // 11552
-    0xb33c, 0xb33a, 0xb339, 0xb337, 0xb336, 0xb334, 0xb333, 0xb332, // 11560
-    0xb330, 0xb32f, 0xb32d, 0xb32c, 0xb32a, 0xb329, 0xb327, 0xb326, // 11568
-    0xb325, 0xb323, 0xb322, 0xb320, 0xb31f, 0xb31d, 0xb31c, 0xb31b, // 11576
-    0xb319, 0xb318, 0xb316, 0xb315, 0xb313, 0xb312, 0xb311, 0xb30f, // 11584
-    0xb30e, 0xb30c, 0xb30b, 0xb309, 0xb308, 0xb306, 0xb305, 0xb304, // 11592
-    0xb302, 0xb301, 0xb2ff, 0xb2fe, 0xb2fc, 0xb2fb, 0xb2fa, 0xb2f8, // 11600
-    0xb2f7, 0xb2f5, 0xb2f4, 0xb2f2, 0xb2f1, 0xb2ef, 0xb2ee, 0xb2ed, // 11608
-    0xb2eb, 0xb2ea, 0xb2e8, 0xb2e7, 0xb2e5, 0xb2e4, 0xb2e3, 0xb2e1, // 11616
-    0xb2e0, 0xb2de, 0xb2dd, 0xb2db, 0xb2da, 0xb2d9, 0xb2d7, 0xb2d6, // 11624
-    0xb2d4, 0xb2d3, 0xb2d1, 0xb2d0, 0xb2ce, 0xb2cd, 0xb2cc, 0xb2ca, // 11632
-    0xb2c9, 0xb2c7, 0xb2c6, 0xb2c4, 0xb2c3, 0xb2c2, 0xb2c0, 0xb2bf, // 11640
-    0xb2bd, 0xb2bc, 0xb2ba, 0xb2b9, 0xb2b8, 0xb2b6, 0xb2b5, 0xb2b3, // 11648
-    0xb2b2, 0xb2b0, 0xb2af, 0xb2ad, 0xb2ac, 0xb2ab, 0xb2a9, 0xb2a8, // 11656
-    0xb2a6, 0xb2a5, 0xb2a3, 0xb2a2, 0xb2a1, 0xb29f, 0xb29e, 0xb29c, // 11664
-    0xb29b, 0xb299, 0xb298, 0xb296, 0xb295, 0xb294, 0xb292, 0xb291, // 11672
-    0xb28f, 0xb28e, 0xb28c, 0xb28b, 0xb28a, 0xb288, 0xb287, 0xb285, // 11680
-    0xb284, 0xb282, 0xb281, 0xb280, 0xb27e, 0xb27d, 0xb27b, 0xb27a, // 11688
-    0xb278, 0xb277, 0xb275, 0xb274, 0xb273, 0xb271, 0xb270, 0xb26e, // 11696
-    0xb26d, 0xb26b, 0xb26a, 0xb269, 0xb267, 0xb266, 0xb264, 0xb263, // 11704
-    0xb261, 0xb260, 0xb25f, 0xb25d, 0xb25c, 0xb25a, 0xb259, 0xb257, // 11712
-    0xb256, 0xb254, 0xb253, 0xb252, 0xb250, 0xb24f, 0xb24d, 0xb24c, // 11720
-    0xb24a, 0xb249, 0xb248, 0xb246, 0xb245, 0xb243, 0xb242, 0xb240, // 11728
-    0xb23f, 0xb23d, 0xb23c, 0xb23b, 0xb239, 0xb238, 0xb236, 0xb235, // 11736
-    0xb233, 0xb232, 0xb231, 0xb22f, 0xb22e, 0xb22c, 0xb22b, 0xb229, // 11744
-    0xb228, 0xb227, 0xb225, 0xb224, 0xb222, 0xb221, 0xb21f, 0xb21e, // 11752
-    0xb21c, 0xb21b, 0xb21a, 0xb218, 0xb217, 0xb215, 0xb214, 0xb212, // 11760
-    0xb211, 0xb210, 0xb20e, 0xb20d, 0xb20b, 0xb20a, 0xb208, 0xb207, // 11768
-    0xb206, 0xb204, 0xb203, 0xb201, 0xb200, 0xb1fe, 0xb1fd, 0xb1fb, // 11776
-    0xb1fa, 0xb1f9, 0xb1f7, 0xb1f6, 0xb1f4, 0xb1f3, 0xb1f1, 0xb1f0, // 11784
-    0xb1ef, 0xb1ed, 0xb1ec, 0xb1ea, 0xb1e9, 0xb1e7, 0xb1e6, 0xb1e4, // 11792
-    0xb1e3, 0xb1e2, 0xb1e0, 0xb1df, 0xb1dd, 0xb1dc, 0xb1da, 0xb1d9, // 11800
-    0xb1d8, 0xb1d6, 0xb1d5, 0xb1d3, 0xb1d2, 0xb1d0, 0xb1cf, 0xb1ce, // 11808
-    0xb1cc, 0xb1cb, 0xb1c9, 0xb1c8, 0xb1c6, 0xb1c5, 0xb1c3, 0xb1c2, // 11816
-    0xb1c1, 0xb1bf, 0xb1be, 0xb1bc, 0xb1bb, 0xb1b9, 0xb1b8, 0xb1b7, // 11824
-    0xb1b5, 0xb1b4, 0xb1b2, 0xb1b1, 0xb1af, 0xb1ae, 0xb1ac, 0xb1ab, // 11832
-    0xb1aa, 0xb1a8, 0xb1a7, 0xb1a5, 0xb1a4, 0xb1a2, 0xb1a1, 0xb1a0, // 11840
-    0xb19e, 0xb19d, 0xb19b, 0xb19a, 0xb198, 0xb197, 0xb196, 0xb194, // 11848
-    0xb193, 0xb191, 0xb190, 0xb18e, 0xb18d, 0xb18b, 0xb18a, 0xb189, // 11856
-    0xb187, 0xb186, 0xb184, 0xb183, 0xb181, 0xb180, 0xb17f, 0xb17d, // 11864
-    0xb17c, 0xb17a, 0xb179, 0xb177, 0xb176, 0xb175, 0xb173, 0xb172, // 11872
-    0xb170, 0xb16f, 0xb16d, 0xb16c, 0xb16a, 0xb169, 0xb168, 0xb166, // 11880
-    0xb165, 0xb163, 0xb162, 0xb160, 0xb15f, 0xb15e, 0xb15c, 0xb15b, // 11888
-    0xb159, 0xb158, 0xb156, 0xb155, 0xb153, 0xb152, 0xb151, 0xb14f, // 11896
-    0xb14e, 0xb14c, 0xb14b, 0xb149, 0xb148, 0xb147, 0xb145, 0xb144, // 11904
-    0xb142, 0xb141, 0xb13f, 0xb13e, 0xb13d, 0xb13b, 0xb13a, 0xb138, // 11912
-    0xb137, 0xb135, 0xb134, 0xb132, 0xb131, 0xb130, 0xb12e, 0xb12d, // 11920
-    0xb12b, 0xb12a, 0xb128, 0xb127, 0xb126, 0xb124, 0xb123, 0xb121, // 11928
-    0xb120, 0xb11e, 0xb11d, 0xb11c, 0xb11a, 0xb119, 0xb117, 0xb116, // 11936
-    0xb114, 0xb113, 0xb111, 0xb110, 0xb10f, 0xb10d, 0xb10c, 0xb10a, // 11944
-    0xb109, 0xb107, 0xb106, 0xb105, 0xb103, 0xb102, 0xb100, 0xb0ff, // 11952
-    0xb0fd, 0xb0fc, 0xb0fa, 0xb0f9, 0xb0f8, 0xb0f6, 0xb0f5, 0xb0f3, // 11960
-    0xb0f2, 0xb0f0, 0xb0ef, 0xb0ee, 0xb0ec, 0xb0eb, 0xb0e9, 0xb0e8, // 11968
-    0xb0e6, 0xb0e5, 0xb0e4, 0xb0e2, 0xb0e1, 0xb0df, 0xb0de, 0xb0dc, // 11976
-    0xb0db, 0xb0d9, 0xb0d8, 0xb0d7, 0xb0d5, 0xb0d4, 0xb0d2, 0xb0d1, // 11984
-    0xb0cf, 0xb0ce, 0xb0cd, 0xb0cb, 0xb0ca, 0xb0c8, 0xb0c7, 0xb0c5, // 11992
-    0xb0c4, 0xb0c3, 0xb0c1, 0xb0c0, 0xb0be, 0xb0bd, 0xb0bb, 0xb0ba, // 12000
-    0xb0b8, 0xb0b7, 0xb0b6, 0xb0b4, 0xb0b3, 0xb0b1, 0xb0b0, 0xb0ae, // 12008
-    0xb0ad, 0xb0ac, 0xb0aa, 0xb0a9, 0xb0a7, 0xb0a6, 0xb0a4, 0xb0a3, // 12016
-    0xb0a1, 0xb0a0, 0xb09f, 0xb09d, 0xb09c, 0xb09a, 0xb099, 0xb097, // 12024
-    0xb096, 0xb095, 0xb093, 0xb092, 0xb090, 0xb08f, 0xb08d, 0xb08c, // 12032
-    0xb08b, 0xb089, 0xb088, 0xb086, 0xb085, 0xb083, 0xb082, 0xb080, // 12040
-    0xb07f, 0xb07e, 0xb07c, 0xb07b, 0xb079, 0xb078, 0xb076, 0xb075, // 12048
-    0xb074, 0xb072, 0xb071, 0xb06f, 0xb06e, 0xb06c, 0xb06b, 0xb069, // 12056
-    0xb068, 0xb067, 0xb065, 0xb064, 0xb062, 0xb061, 0xb05f, 0xb05e, // 12064
-    0xb05d, 0xb05b, 0xb05a, 0xb058, 0xb057, 0xb055, 0xb054, 0xb053, // 12072
-    0xb051, 0xb050, 0xb04e, 0xb04d, 0xb04b, 0xb04a, 0xb048, 0xb047, // 12080
-    0xb046, 0xb044, 0xb043, 0xb041, 0xb040, 0xb03e, 0xb03d, 0xb03c, // 12088
-    0xb03a, 0xb039, 0xb037, 0xb036, 0xb034, 0xb033, 0xb032, 0xb030, // 12096
-    0xb02f, 0xb02d, 0xb02c, 0xb02a, 0xb029, 0xb027, 0xb026, 0xb025, // 12104
-    0xb023, 0xb022, 0xb020, 0xb01f, 0xb01d, 0xb01c, 0xb01b, 0xb019, // 12112
-    0xb018, 0xb016, 0xb015, 0xb013, 0xb012, 0xb010, 0xb00f, 0xb00e, // 12120
-    0xb00c, 0xb00b, 0xb009, 0xb008, 0xb006, 0xb005, 0xb004, 0xb002, // 12128
-    0xb001, 0xafff, 0xaffe, 0xaffc, 0xaffb, 0xaffa, 0xaff8, 0xaff7, // 12136
-    0xaff5, 0xaff4, 0xaff2, 0xaff1, 0xafef, 0xafee, 0xafed, 0xafeb, // 12144
-    0xafea, 0xafe8, 0xafe7, 0xafe5, 0xafe4, 0xafe3, 0xafe1, 0xafe0, // 12152
-    0xafde, 0xafdd, 0xafdb, 0xafda, 0xafd9, 0xafd7, 0xafd6, 0xafd4, // 12160
-    0xafd3, 0xafd1, 0xafd0, 0xafce, 0xafcd, 0xafcc, 0xafca, 0xafc9, // 12168
-    0xafc7, 0xafc6, 0xafc4, 0xafc3, 0xafc2, 0xafc0, 0xafbf, 0xafbd, // 12176
-    0xafbc, 0xafba, 0xafb9, 0xafb7, 0xafb6, 0xafb5, 0xafb3, 0xafb2, // 12184
-    0xafb0, 0xafaf, 0xafad, 0xafac, 0xafab, 0xafa9, 0xafa8, 0xafa6, // 12192
-    0xafa5, 0xafa3, 0xafa2, 0xafa1, 0xaf9f, 0xaf9e, 0xaf9c, 0xaf9b, // 12200
-    0xaf99, 0xaf98, 0xaf96, 0xaf95, 0xaf94, 0xaf92, 0xaf91, 0xaf8f, // 12208
-    0xaf8e, 0xaf8c, 0xaf8b, 0xaf8a, 0xaf88, 0xaf87, 0xaf85, 0xaf84, // 12216
-    0xaf82, 0xaf81, 0xaf80, 0xaf7e, 0xaf7d, 0xaf7b, 0xaf7a, 0xaf78, // 12224
-    0xaf77, 0xaf75, 0xaf74, 0xaf73, 0xaf71, 0xaf70, 0xaf6e, 0xaf6d, // 12232
-    0xaf6b, 0xaf6a, 0xaf69, 0xaf67, 0xaf66, 0xaf64, 0xaf63, 0xaf61, // 12240
-    0xaf60, 0xaf5e, 0xaf5d, 0xaf5c, 0xaf5a, 0xaf59, 0xaf57, 0xaf56, // 12248
-    0xaf54, 0xaf53, 0xaf52, 0xaf50, 0xaf4f, 0xaf4d, 0xaf4c, 0xaf4a, // 12256
-    0xaf49, 0xaf48, 0xaf46, 0xaf45, 0xaf43, 0xaf42, 0xaf40, 0xaf3f, // 12264
-    0xaf3d, 0xaf3c, 0xaf3b, 0xaf39, 0xaf38, 0xaf36, 0xaf35, 0xaf33, // 12272
-    0xaf32, 0xaf31, 0xaf2f, 0xaf2e, 0xaf2c, 0xaf2b, 0xaf29, 0xaf28, // 12280
-    0xaf26, 0xaf24, 0xaf23, 0xaf21, 0xaf20, 0xaf1e, 0xaf1d, 0xaf1c, // 12288
-    0xaf1a, 0xaf19, 0xaf17, 0xaf16, 0xaf15, 0xaf13, 0xaf12, 0xaf10, // 12296
-    0xaf0f, 0xaf0e, 0xaf0c, 0xaf0b, 0xaf09, 0xaf08, 0xaf07, 0xaf05, // 12304
-    0xaf04, 0xaf02, 0xaf01, 0xaf00, 0xaefe, 0xaefd, 0xaefb, 0xaefa, // 12312
-    0xaef9, 0xaef7, 0xaef6, 0xaef4, 0xaef3, 0xaef2, 0xaef0, 0xaeef, // 12320
-    0xaeed, 0xaeec, 0xaeeb, 0xaee9, 0xaee8, 0xaee6, 0xaee5, 0xaee4, // 12328
-    0xaee2, 0xaee1, 0xaedf, 0xaede, 0xaedd, 0xaedb, 0xaeda, 0xaed8, // 12336
-    0xaed7, 0xaed6, 0xaed4, 0xaed3, 0xaed1, 0xaed0, 0xaecf, 0xaecd, // 12344
-    0xaecc, 0xaeca, 0xaec9, 0xaec8, 0xaec6, 0xaec5, 0xaec3, 0xaec2, // 12352
-    0xaec1, 0xaebf, 0xaebe, 0xaebc, 0xaebb, 0xaeba, 0xaeb8, 0xaeb7, // 12360
-    0xaeb5, 0xaeb4, 0xaeb3, 0xaeb1, 0xaeb0, 0xaeae, 0xaead, 0xaeac, // 12368
-    0xaeaa, 0xaea9, 0xaea7, 0xaea6, 0xaea5, 0xaea3, 0xaea2, 0xaea0, // 12376
-    0xae9f, 0xae9e, 0xae9c, 0xae9b, 0xae99, 0xae98, 0xae97, 0xae95, // 12384
-    0xae94, 0xae92, 0xae91, 0xae90, 0xae8e, 0xae8d, 0xae8b, 0xae8a, // 12392
-    0xae89, 0xae87, 0xae86, 0xae84, 0xae83, 0xae82, 0xae80, 0xae7f, // 12400
-    0xae7d, 0xae7c, 0xae7b, 0xae79, 0xae78, 0xae76, 0xae75, 0xae74, // 12408
-    0xae72, 0xae71, 0xae6f, 0xae6e, 0xae6d, 0xae6b, 0xae6a, 0xae68, // 12416
-    0xae67, 0xae66, 0xae64, 0xae63, 0xae61, 0xae60, 0xae5f, 0xae5d, // 12424
-    0xae5c, 0xae5a, 0xae59, 0xae58, 0xae56, 0xae55, 0xae53, 0xae52, // 12432
-    0xae51, 0xae4f, 0xae4e, 0xae4c, 0xae4b, 0xae4a, 0xae48, 0xae47, // 12440
-    0xae45, 0xae44, 0xae43, 0xae41, 0xae40, 0xae3e, 0xae3d, 0xae3c, // 12448
-    0xae3a, 0xae39, 0xae37, 0xae36, 0xae35, 0xae33, 0xae32, 0xae30, // 12456
-    0xae2f, 0xae2e, 0xae2c, 0xae2b, 0xae29, 0xae28, 0xae27, 0xae25, // 12464
-    0xae24, 0xae22, 0xae21, 0xae20, 0xae1e, 0xae1d, 0xae1b, 0xae1a, // 12472
-    0xae19, 0xae17, 0xae16, 0xae14, 0xae13, 0xae12, 0xae10, 0xae0f, // 12480
-    0xae0d, 0xae0c, 0xae0b, 0xae09, 0xae08, 0xae06, 0xae05, 0xae04, // 12488
-    0xae02, 0xae01, 0xadff, 0xadfe, 0xadfd, 0xadfb, 0xadfa, 0xadf8, // 12496
-    0xadf7, 0xadf6, 0xadf4, 0xadf3, 0xadf1, 0xadf0, 0xadef, 0xaded, // 12504
-    0xadec, 0xadea, 0xade9, 0xade8, 0xade6, 0xade5, 0xade3, 0xade2, // 12512
-    0xade1, 0xaddf, 0xadde, 0xaddc, 0xaddb, 0xadda, 0xadd8, 0xadd7, // 12520
-    0xadd5, 0xadd4, 0xadd3, 0xadd1, 0xadd0, 0xadce, 0xadcd, 0xadcc, // 12528
-    0xadca, 0xadc9, 0xadc7, 0xadc6, 0xadc5, 0xadc3, 0xadc2, 0xadc0, // 12536
-    0xadbf, 0xadbe, 0xadbc, 0xadbb, 0xadb9, 0xadb8, 0xadb7, 0xadb5, // 12544
-    0xadb4, 0xadb2, 0xadb1, 0xadb0, 0xadae, 0xadad, 0xadab, 0xadaa, // 12552
-    0xada9, 0xada7, 0xada6, 0xada4, 0xada3, 0xada2, 0xada0, 0xad9f, // 12560
-    0xad9d, 0xad9c, 0xad9b, 0xad99, 0xad98, 0xad96, 0xad95, 0xad94, // 12568
-    0xad92, 0xad91, 0xad8f, 0xad8e, 0xad8d, 0xad8b, 0xad8a, 0xad88, // 12576
-    0xad87, 0xad86, 0xad84, 0xad83, 0xad81, 0xad80, 0xad7f, 0xad7d, // 12584
-    0xad7c, 0xad7a, 0xad79, 0xad78, 0xad76, 0xad75, 0xad73, 0xad72, // 12592
-    0xad71, 0xad6f, 0xad6e, 0xad6c, 0xad6b, 0xad6a, 0xad68, 0xad67, // 12600
-    0xad65, 0xad64, 0xad63, 0xad61, 0xad60, 0xad5e, 0xad5d, 0xad5c, // 12608
-    0xad5a, 0xad59, 0xad57, 0xad56, 0xad55, 0xad53, 0xad52, 0xad50, // 12616
-    0xad4f, 0xad4e, 0xad4c, 0xad4b, 0xad49, 0xad48, 0xad47, 0xad45, // 12624
-    0xad44, 0xad42, 0xad41, 0xad40, 0xad3e, 0xad3d, 0xad3b, 0xad3a, // 12632
-    0xad39, 0xad37, 0xad36, 0xad34, 0xad33, 0xad32, 0xad30, 0xad2f, // 12640
-    0xad2d, 0xad2c, 0xad2b, 0xad29, 0xad28, 0xad26, 0xad25, 0xad24, // 12648
-    0xad22, 0xad21, 0xad1f, 0xad1e, 0xad1d, 0xad1b, 0xad1a, 0xad18, // 12656
-    0xad17, 0xad16, 0xad14, 0xad13, 0xad11, 0xad10, 0xad0f, 0xad0d, // 12664
-    0xad0c, 0xad0a, 0xad09, 0xad08, 0xad06, 0xad05, 0xad03, 0xad02, // 12672
-    0xad01, 0xacff, 0xacfe, 0xacfc, 0xacfb, 0xacfa, 0xacf8, 0xacf7, // 12680
-    0xacf5, 0xacf4, 0xacf3, 0xacf1, 0xacf0, 0xacee, 0xaced, 0xacec, // 12688
-    0xacea, 0xace9, 0xace7, 0xace6, 0xace5, 0xace3, 0xace2, 0xace0, // 12696
-    0xacdf, 0xacde, 0xacdc, 0xacdb, 0xacd9, 0xacd8, 0xacd7, 0xacd5, // 12704
-    0xacd4, 0xacd2, 0xacd1, 0xacd0, 0xacce, 0xaccd, 0xaccb, 0xacca, // 12712
-    0xacc9, 0xacc7, 0xacc6, 0xacc4, 0xacc3, 0xacc2, 0xacc0, 0xacbf, // 12720
-    0xacbd, 0xacbc, 0xacbb, 0xacb9, 0xacb8, 0xacb6, 0xacb5, 0xacb4, // 12728
-    0xacb2, 0xacb1, 0xacaf, 0xacae, 0xacad, 0xacab, 0xacaa, 0xaca8, // 12736
-    0xaca7, 0xaca6, 0xaca4, 0xaca3, 0xaca1, 0xaca0, 0xac9f, 0xac9d, // 12744
-    0xac9c, 0xac9a, 0xac99, 0xac98, 0xac96, 0xac95, 0xac93, 0xac92, // 12752
-    0xac91, 0xac8f, 0xac8e, 0xac8c, 0xac8b, 0xac8a, 0xac88, 0xac87, // 12760
-    0xac85, 0xac84, 0xac83, 0xac81, 0xac80, 0xac7e, 0xac7d, 0xac7c, // 12768
-    0xac7a, 0xac79, 0xac77, 0xac76, 0xac75, 0xac73, 0xac72, 0xac70, // 12776
-    0xac6f, 0xac6e, 0xac6c, 0xac6b, 0xac69, 0xac68, 0xac67, 0xac65, // 12784
-    0xac64, 0xac62, 0xac61, 0xac60, 0xac5e, 0xac5d, 0xac5b, 0xac5a, // 12792
-    0xac59, 0xac57, 0xac56, 0xac54, 0xac53, 0xac51, 0xac50, 0xac4f, // 12800
-    0xac4d, 0xac4c, 0xac4a, 0xac49, 0xac48, 0xac46, 0xac45, 0xac43, // 12808
-    0xac42, 0xac41, 0xac3f, 0xac3e, 0xac3c, 0xac3b, 0xac3a, 0xac38, // 12816
-    0xac37, 0xac35, 0xac34, 0xac33, 0xac31, 0xac30, 0xac2e, 0xac2d, // 12824
-    0xac2c, 0xac2a, 0xac29, 0xac27, 0xac26, 0xac25, 0xac23, 0xac22, // 12832
-    0xac20, 0xac1f, 0xac1e, 0xac1c, 0xac1b, 0xac19, 0xac18, 0xac17, // 12840
-    0xac15, 0xac14, 0xac12, 0xac11, 0xac10, 0xac0e, 0xac0d, 0xac0b, // 12848
-    0xac0a, 0xac09, 0xac07, 0xac06, 0xac04, 0xac03, 0xac02, 0xac00, // 12856
-    0xabff, 0xabfd, 0xabfc, 0xabfb, 0xabf9, 0xabf8, 0xabf6, 0xabf5, // 12864
-    0xabf4, 0xabf2, 0xabf1, 0xabef, 0xabee, 0xabed, 0xabeb, 0xabea, // 12872
-    0xabe8, 0xabe7, 0xabe6, 0xabe4, 0xabe3, 0xabe1, 0xabe0, 0xabdf, // 12880
-    0xabdd, 0xabdc, 0xabda, 0xabd9, 0xabd8, 0xabd6, 0xabd5, 0xabd3, // 12888
-    0xabd2, 0xabd1, 0xabcf, 0xabce, 0xabcc, 0xabcb, 0xabca, 0xabc8, // 12896
-    0xabc7, 0xabc5, 0xabc4, 0xabc3, 0xabc1, 0xabc0, 0xabbe, 0xabbd, // 12904
-    0xabbc, 0xabba, 0xabb9, 0xabb7, 0xabb6, 0xabb5, 0xabb3, 0xabb2, // 12912
-    0xabb0, 0xabaf, 0xabae, 0xabac, 0xabab, 0xaba9, 0xaba8, 0xaba7, // 12920
-    0xaba5, 0xaba4, 0xaba2, 0xaba1, 0xaba0, 0xab9e, 0xab9d, 0xab9b, // 12928
-    0xab9a, 0xab99, 0xab97, 0xab96, 0xab94, 0xab93, 0xab92, 0xab90, // 12936
-    0xab8f, 0xab8d, 0xab8c, 0xab8b, 0xab89, 0xab88, 0xab86, 0xab85, // 12944
-    0xab84, 0xab82, 0xab81, 0xab7f, 0xab7e, 0xab7d, 0xab7b, 0xab7a, // 12952
-    0xab78, 0xab77, 0xab76, 0xab74, 0xab73, 0xab71, 0xab70, 0xab6f, // 12960
-    0xab6d, 0xab6c, 0xab6a, 0xab69, 0xab68, 0xab66, 0xab65, 0xab63, // 12968
-    0xab62, 0xab61, 0xab5f, 0xab5e, 0xab5c, 0xab5b, 0xab5a, 0xab58, // 12976
-    0xab57, 0xab55, 0xab54, 0xab53, 0xab51, 0xab50, 0xab4e, 0xab4d, // 12984
-    0xab4c, 0xab4a, 0xab49, 0xab47, 0xab46, 0xab45, 0xab43, 0xab42, // 12992
-    0xab40, 0xab3f, 0xab3e, 0xab3c, 0xab3b, 0xab39, 0xab38, 0xab37, // 13000
-    0xab35, 0xab34, 0xab32, 0xab31, 0xab30, 0xab2e, 0xab2d, 0xab2b, // 13008
-    0xab2a, 0xab29, 0xab27, 0xab26, 0xab24, 0xab23, 0xab22, 0xab20, // 13016
-    0xab1f, 0xab1d, 0xab1c, 0xab1b, 0xab19, 0xab18, 0xab16, 0xab15, // 13024
-    0xab14, 0xab12, 0xab11, 0xab0f, 0xab0e, 0xab0d, 0xab0b, 0xab0a, // 13032
-    0xab08, 0xab07, 0xab06, 0xab04, 0xab03, 0xab01, 0xab00, 0xaaff, // 13040
-    0xaafd, 0xaafc, 0xaafa, 0xaaf9, 0xaaf8, 0xaaf6, 0xaaf5, 0xaaf3, // 13048
-    0xaaf2, 0xaaf1, 0xaaef, 0xaaee, 0xaaec, 0xaaeb, 0xaaea, 0xaae8, // 13056
-    0xaae7, 0xaae5, 0xaae4, 0xaae3, 0xaae1, 0xaae0, 0xaade, 0xaadd, // 13064
-    0xaadc, 0xaada, 0xaad9, 0xaad7, 0xaad6, 0xaad5, 0xaad3, 0xaad2, // 13072
-    0xaad0, 0xaacf, 0xaace, 0xaacc, 0xaacb, 0xaac9, 0xaac8, 0xaac7, // 13080
-    0xaac5, 0xaac4, 0xaac2, 0xaac1, 0xaac0, 0xaabe, 0xaabd, 0xaabb, // 13088
-    0xaaba, 0xaab9, 0xaab7, 0xaab6, 0xaab4, 0xaab3, 0xaab2, 0xaab0, // 13096
-    0xaaaf, 0xaaad, 0xaaac, 0xaaab, 0xaaa9, 0xaaa8, 0xaaa6, 0xaaa5, // 13104
-    0xaaa4, 0xaaa2, 0xaaa1, 0xaa9f, 0xaa9e, 0xaa9d, 0xaa9b, 0xaa9a, // 13112
-    0xaa98, 0xaa97, 0xaa96, 0xaa94, 0xaa93, 0xaa91, 0xaa90, 0xaa8f, // 13120
-    0xaa8d, 0xaa8c, 0xaa8a, 0xaa89, 0xaa88, 0xaa86, 0xaa85, 0xaa83, // 13128
-    0xaa82, 0xaa81, 0xaa7f, 0xaa7e, 0xaa7c, 0xaa7b, 0xaa7a, 0xaa78, // 13136
-    0xaa77, 0xaa75, 0xaa74, 0xaa73, 0xaa71, 0xaa70, 0xaa6e, 0xaa6d, // 13144
-    0xaa6c, 0xaa6a, 0xaa69, 0xaa67, 0xaa66, 0xaa65, 0xaa63, 0xaa62, // 13152
-    0xaa60, 0xaa5f, 0xaa5e, 0xaa5c, 0xaa5b, 0xaa59, 0xaa58, 0xaa57, // 13160
-    0xaa55, 0xaa54, 0xaa52, 0xaa51, 0xaa50, 0xaa4e, 0xaa4d, 0xaa4b, // 13168
-    0xaa4a, 0xaa49, 0xaa47, 0xaa46, 0xaa44, 0xaa43, 0xaa42, 0xaa40, // 13176
-    0xaa3f, 0xaa3d, 0xaa3c, 0xaa3b, 0xaa39, 0xaa38, 0xaa36, 0xaa35, // 13184
-    0xaa34, 0xaa32, 0xaa31, 0xaa2f, 0xaa2e, 0xaa2d, 0xaa2b, 0xaa2a, // 13192
-    0xaa28, 0xaa27, 0xaa26, 0xaa24, 0xaa23, 0xaa21, 0xaa20, 0xaa1f, // 13200
-    0xaa1d, 0xaa1c, 0xaa1a, 0xaa19, 0xaa18, 0xaa16, 0xaa15, 0xaa13, // 13208
-    0xaa12, 0xaa11, 0xaa0f, 0xaa0e, 0xaa0c, 0xaa0b, 0xaa0a, 0xaa08, // 13216
-    0xaa07, 0xaa05, 0xaa04, 0xaa03, 0xaa01, 0xaa00, 0xa9fe, 0xa9fd, // 13224
-    0xa9fc, 0xa9fa, 0xa9f9, 0xa9f7, 0xa9f6, 0xa9f5, 0xa9f3, 0xa9f2, // 13232
-    0xa9f0, 0xa9ef, 0xa9ee, 0xa9ec, 0xa9eb, 0xa9e9, 0xa9e8, 0xa9e7, // 13240
-    0xa9e5, 0xa9e4, 0xa9e2, 0xa9e1, 0xa9e0, 0xa9de, 0xa9dd, 0xa9db, // 13248
-    0xa9da, 0xa9d9, 0xa9d7, 0xa9d6, 0xa9d4, 0xa9d3, 0xa9d2, 0xa9d0, // 13256
-    0xa9cf, 0xa9cd, 0xa9cc, 0xa9cb, 0xa9c9, 0xa9c8, 0xa9c6, 0xa9c5, // 13264
-    0xa9c4, 0xa9c2, 0xa9c1, 0xa9bf, 0xa9be, 0xa9bd, 0xa9bb, 0xa9ba, // 13272
-    0xa9b8, 0xa9b7, 0xa9b6, 0xa9b4, 0xa9b3, 0xa9b1, 0xa9b0, 0xa9af, // 13280
-    0xa9ad, 0xa9ac, 0xa9aa, 0xa9a9, 0xa9a8, 0xa9a6, 0xa9a5, 0xa9a3, // 13288
-    0xa9a2, 0xa9a1, 0xa99f, 0xa99e, 0xa99c, 0xa99b, 0xa99a, 0xa998, // 13296
-    0xa997, 0xa995, 0xa994, 0xa993, 0xa991, 0xa990, 0xa98e, 0xa98d, // 13304
-    0xa98d, 0xa98c, 0xa98a, 0xa989, 0xa988, 0xa986, 0xa985, 0xa983, // 13312
-    0xa982, 0xa981, 0xa97f, 0xa97e, 0xa97d, 0xa97b, 0xa97a, 0xa979, // 13320
-    0xa977, 0xa976, 0xa974, 0xa973, 0xa972, 0xa970, 0xa96f, 0xa96e, // 13328
-    0xa96c, 0xa96b, 0xa96a, 0xa968, 0xa967, 0xa965, 0xa964, 0xa963, // 13336
-    0xa961, 0xa960, 0xa95f, 0xa95d, 0xa95c, 0xa95a, 0xa959, 0xa958, // 13344
-    0xa956, 0xa955, 0xa954, 0xa952, 0xa951, 0xa950, 0xa94e, 0xa94d, // 13352
-    0xa94b, 0xa94a, 0xa949, 0xa947, 0xa946, 0xa945, 0xa943, 0xa942, // 13360
-    0xa941, 0xa93f, 0xa93e, 0xa93c, 0xa93b, 0xa93a, 0xa938, 0xa937, // 13368
-    0xa936, 0xa934, 0xa933, 0xa932, 0xa930, 0xa92f, 0xa92d, 0xa92c, // 13376
-    0xa92b, 0xa929, 0xa928, 0xa927, 0xa925, 0xa924, 0xa923, 0xa921, // 13384
-    0xa920, 0xa91e, 0xa91d, 0xa91c, 0xa91a, 0xa919, 0xa918, 0xa916, // 13392
-    0xa915, 0xa913, 0xa912, 0xa911, 0xa90f, 0xa90e, 0xa90d, 0xa90b, // 13400
-    0xa90a, 0xa909, 0xa907, 0xa906, 0xa904, 0xa903, 0xa902, 0xa900, // 13408
-    0xa8ff, 0xa8fe, 0xa8fc, 0xa8fb, 0xa8fa, 0xa8f8, 0xa8f7, 0xa8f5, // 13416
-    0xa8f4, 0xa8f3, 0xa8f1, 0xa8f0, 0xa8ef, 0xa8ed, 0xa8ec, 0xa8eb, // 13424
-    0xa8e9, 0xa8e8, 0xa8e6, 0xa8e5, 0xa8e4, 0xa8e2, 0xa8e1, 0xa8e0, // 13432
-    0xa8de, 0xa8dd, 0xa8dc, 0xa8da, 0xa8d9, 0xa8d7, 0xa8d6, 0xa8d5, // 13440
-    0xa8d3, 0xa8d2, 0xa8d1, 0xa8cf, 0xa8ce, 0xa8cd, 0xa8cb, 0xa8ca, // 13448
-    0xa8c8, 0xa8c7, 0xa8c6, 0xa8c4, 0xa8c3, 0xa8c2, 0xa8c0, 0xa8bf, // 13456
-    0xa8bd, 0xa8bc, 0xa8bb, 0xa8b9, 0xa8b8, 0xa8b7, 0xa8b5, 0xa8b4, // 13464
-    0xa8b3, 0xa8b1, 0xa8b0, 0xa8ae, 0xa8ad, 0xa8ac, 0xa8aa, 0xa8a9, // 13472
-    0xa8a8, 0xa8a6, 0xa8a5, 0xa8a4, 0xa8a2, 0xa8a1, 0xa89f, 0xa89e, // 13480
-    0xa89d, 0xa89b, 0xa89a, 0xa899, 0xa897, 0xa896, 0xa895, 0xa893, // 13488
-    0xa892, 0xa890, 0xa88f, 0xa88e, 0xa88c, 0xa88b, 0xa88a, 0xa888, // 13496
-    0xa887, 0xa886, 0xa884, 0xa883, 0xa881, 0xa880, 0xa87f, 0xa87d, // 13504
-    0xa87c, 0xa87b, 0xa879, 0xa878, 0xa876, 0xa875, 0xa874, 0xa872, // 13512
-    0xa871, 0xa870, 0xa86e, 0xa86d, 0xa86c, 0xa86a, 0xa869, 0xa867, // 13520
-    0xa866, 0xa865, 0xa863, 0xa862, 0xa861, 0xa85f, 0xa85e, 0xa85d, // 13528
-    0xa85b, 0xa85a, 0xa858, 0xa857, 0xa856, 0xa854, 0xa853, 0xa852, // 13536
-    0xa850, 0xa84f, 0xa84e, 0xa84c, 0xa84b, 0xa849, 0xa848, 0xa847, // 13544
-    0xa845, 0xa844, 0xa843, 0xa841, 0xa840, 0xa83f, 0xa83d, 0xa83c, // 13552
-    0xa83a, 0xa839, 0xa838, 0xa836, 0xa835, 0xa834, 0xa832, 0xa831, // 13560
-    0xa830, 0xa82e, 0xa82d, 0xa82b, 0xa82a, 0xa829, 0xa827, 0xa826, // 13568
-    0xa825, 0xa823, 0xa822, 0xa820, 0xa81f, 0xa81e, 0xa81c, 0xa81b, // 13576
-    0xa81a, 0xa818, 0xa817, 0xa816, 0xa814, 0xa813, 0xa811, 0xa810, // 13584
-    0xa80f, 0xa80d, 0xa80c, 0xa80b, 0xa809, 0xa808, 0xa807, 0xa805, // 13592
-    0xa804, 0xa802, 0xa801, 0xa800, 0xa7fe, 0xa7fd, 0xa7fc, 0xa7fa, // 13600
-    0xa7f9, 0xa7f8, 0xa7f6, 0xa7f5, 0xa7f3, 0xa7f2, 0xa7f1, 0xa7ef, // 13608
-    0xa7ee, 0xa7ed, 0xa7eb, 0xa7ea, 0xa7e9, 0xa7e7, 0xa7e6, 0xa7e4, // 13616
-    0xa7e3, 0xa7e2, 0xa7e0, 0xa7df, 0xa7de, 0xa7dc, 0xa7db, 0xa7d9, // 13624
-    0xa7d8, 0xa7d7, 0xa7d5, 0xa7d4, 0xa7d3, 0xa7d1, 0xa7d0, 0xa7cf, // 13632
-    0xa7cd, 0xa7cc, 0xa7ca, 0xa7c9, 0xa7c8, 0xa7c6, 0xa7c5, 0xa7c4, // 13640
-    0xa7c2, 0xa7c1, 0xa7c0, 0xa7be, 0xa7bd, 0xa7bb, 0xa7ba, 0xa7b9, // 13648
-    0xa7b7, 0xa7b6, 0xa7b5, 0xa7b3, 0xa7b2, 0xa7b1, 0xa7af, 0xa7ae, // 13656
-    0xa7ac, 0xa7ab, 0xa7aa, 0xa7a8, 0xa7a7, 0xa7a6, 0xa7a4, 0xa7a3, // 13664
-    0xa7a2, 0xa7a0, 0xa79f, 0xa79d, 0xa79c, 0xa79b, 0xa799, 0xa798, // 13672
-    0xa797, 0xa795, 0xa794, 0xa792, 0xa791, 0xa790, 0xa78e, 0xa78d, // 13680
-    0xa78c, 0xa78a, 0xa789, 0xa788, 0xa786, 0xa785, 0xa783, 0xa782, // 13688
-    0xa781, 0xa77f, 0xa77e, 0xa77d, 0xa77b, 0xa77a, 0xa779, 0xa777, // 13696
-    0xa776, 0xa774, 0xa773, 0xa772, 0xa770, 0xa76f, 0xa76e, 0xa76c, // 13704
-    0xa76b, 0xa76a, 0xa768, 0xa767, 0xa765, 0xa764, 0xa763, 0xa761, // 13712
-    0xa760, 0xa75f, 0xa75d, 0xa75c, 0xa75b, 0xa759, 0xa758, 0xa756, // 13720
-    0xa755, 0xa754, 0xa752, 0xa751, 0xa750, 0xa74e, 0xa74d, 0xa74c, // 13728
-    0xa74a, 0xa749, 0xa747, 0xa746, 0xa745, 0xa743, 0xa742, 0xa741, // 13736
-    0xa73f, 0xa73e, 0xa73c, 0xa73b, 0xa73a, 0xa738, 0xa737, 0xa736, // 13744
-    0xa734, 0xa733, 0xa732, 0xa730, 0xa72f, 0xa72d, 0xa72c, 0xa72b, // 13752
-    0xa729, 0xa728, 0xa727, 0xa725, 0xa724, 0xa723, 0xa721, 0xa720, // 13760
-    0xa71e, 0xa71d, 0xa71c, 0xa71a, 0xa719, 0xa718, 0xa716, 0xa715, // 13768
-    0xa714, 0xa712, 0xa711, 0xa70f, 0xa70e, 0xa70d, 0xa70b, 0xa70a, // 13776
-    0xa709, 0xa707, 0xa706, 0xa705, 0xa703, 0xa702, 0xa700, 0xa6ff, // 13784
-    0xa6fe, 0xa6fc, 0xa6fb, 0xa6fa, 0xa6f8, 0xa6f7, 0xa6f5, 0xa6f4, // 13792
-    0xa6f3, 0xa6f1, 0xa6f0, 0xa6ef, 0xa6ed, 0xa6ec, 0xa6eb, 0xa6e9, // 13800
-    0xa6e8, 0xa6e6, 0xa6e5, 0xa6e4, 0xa6e2, 0xa6e1, 0xa6e0, 0xa6de, // 13808
-    0xa6dd, 0xa6dc, 0xa6da, 0xa6d9, 0xa6d7, 0xa6d6, 0xa6d5, 0xa6d3, // 13816
-    0xa6d2, 0xa6d1, 0xa6cf, 0xa6ce, 0xa6cd, 0xa6cb, 0xa6ca, 0xa6c8, // 13824
-    0xa6c7, 0xa6c6, 0xa6c4, 0xa6c3, 0xa6c2, 0xa6c0, 0xa6bf, 0xa6be, // 13832
-    0xa6bc, 0xa6bb, 0xa6b9, 0xa6b8, 0xa6b7, 0xa6b5, 0xa6b4, 0xa6b3, // 13840
-    0xa6b1, 0xa6b0, 0xa6af, 0xa6ad, 0xa6ac, 0xa6aa, 0xa6a9, 0xa6a8, // 13848
-    0xa6a6, 0xa6a5, 0xa6a4, 0xa6a2, 0xa6a1, 0xa69f, 0xa69e, 0xa69d, // 13856
-    0xa69b, 0xa69a, 0xa699, 0xa697, 0xa696, 0xa695, 0xa693, 0xa692, // 13864
-    0xa690, 0xa68f, 0xa68e, 0xa68c, 0xa68b, 0xa68a, 0xa688, 0xa687, // 13872
-    0xa686, 0xa684, 0xa683, 0xa681, 0xa680, 0xa67f, 0xa67d, 0xa67c, // 13880
-    0xa67b, 0xa679, 0xa678, 0xa677, 0xa675, 0xa674, 0xa672, 0xa671, // 13888
-    0xa670, 0xa66e, 0xa66d, 0xa66c, 0xa66a, 0xa669, 0xa668, 0xa666, // 13896
-    0xa665, 0xa663, 0xa662, 0xa661, 0xa65f, 0xa65e, 0xa65d, 0xa65b, // 13904
-    0xa65a, 0xa658, 0xa657, 0xa656, 0xa654, 0xa653, 0xa652, 0xa650, // 13912
-    0xa64f, 0xa64e, 0xa64c, 0xa64b, 0xa649, 0xa648, 0xa647, 0xa645, // 13920
-    0xa644, 0xa643, 0xa641, 0xa640, 0xa63f, 0xa63d, 0xa63c, 0xa63a, // 13928
-    0xa639, 0xa638, 0xa636, 0xa635, 0xa634, 0xa632, 0xa631, 0xa630, // 13936
-    0xa62e, 0xa62d, 0xa62b, 0xa62a, 0xa629, 0xa627, 0xa626, 0xa625, // 13944
-    0xa623, 0xa622, 0xa621, 0xa61f, 0xa61e, 0xa61c, 0xa61b, 0xa61a, // 13952
-    0xa618, 0xa617, 0xa616, 0xa614, 0xa613, 0xa612, 0xa610, 0xa60f, // 13960
-    0xa60d, 0xa60c, 0xa60b, 0xa609, 0xa608, 0xa607, 0xa605, 0xa604, // 13968
-    0xa602, 0xa601, 0xa600, 0xa5fe, 0xa5fd, 0xa5fc, 0xa5fa, 0xa5f9, // 13976
-    0xa5f8, 0xa5f6, 0xa5f5, 0xa5f3, 0xa5f2, 0xa5f1, 0xa5ef, 0xa5ee, // 13984
-    0xa5ed, 0xa5eb, 0xa5ea, 0xa5e9, 0xa5e7, 0xa5e6, 0xa5e4, 0xa5e3, // 13992
-    0xa5e2, 0xa5e0, 0xa5df, 0xa5de, 0xa5dc, 0xa5db, 0xa5da, 0xa5d8, // 14000
-    0xa5d7, 0xa5d5, 0xa5d4, 0xa5d3, 0xa5d1, 0xa5d0, 0xa5cf, 0xa5cd, // 14008
-    0xa5cc, 0xa5cb, 0xa5c9, 0xa5c8, 0xa5c6, 0xa5c5, 0xa5c4, 0xa5c2, // 14016
-    0xa5c1, 0xa5c0, 0xa5be, 0xa5bd, 0xa5bb, 0xa5ba, 0xa5b9, 0xa5b7, // 14024
-    0xa5b6, 0xa5b5, 0xa5b3, 0xa5b2, 0xa5b1, 0xa5af, 0xa5ae, 0xa5ac, // 14032
-    0xa5ab, 0xa5aa, 0xa5a8, 0xa5a7, 0xa5a6, 0xa5a4, 0xa5a3, 0xa5a2, // 14040
-    0xa5a0, 0xa59f, 0xa59d, 0xa59c, 0xa59b, 0xa599, 0xa598, 0xa597, // 14048
-    0xa595, 0xa594, 0xa593, 0xa591, 0xa590, 0xa58e, 0xa58d, 0xa58c, // 14056
-    0xa58a, 0xa589, 0xa588, 0xa586, 0xa585, 0xa584, 0xa582, 0xa581, // 14064
-    0xa57f, 0xa57e, 0xa57d, 0xa57b, 0xa57a, 0xa579, 0xa577, 0xa576, // 14072
-    0xa575, 0xa573, 0xa572, 0xa570, 0xa56f, 0xa56e, 0xa56c, 0xa56b, // 14080
-    0xa56a, 0xa568, 0xa567, 0xa565, 0xa564, 0xa563, 0xa561, 0xa560, // 14088
-    0xa55f, 0xa55d, 0xa55c, 0xa55b, 0xa559, 0xa558, 0xa556, 0xa555, // 14096
-    0xa554, 0xa552, 0xa551, 0xa550, 0xa54e, 0xa54d, 0xa54c, 0xa54a, // 14104
-    0xa549, 0xa547, 0xa546, 0xa545, 0xa543, 0xa542, 0xa541, 0xa53f, // 14112
-    0xa53e, 0xa53d, 0xa53b, 0xa53a, 0xa538, 0xa537, 0xa536, 0xa534, // 14120
-    0xa533, 0xa532, 0xa530, 0xa52f, 0xa52e, 0xa52c, 0xa52b, 0xa529, // 14128
-    0xa528, 0xa527, 0xa525, 0xa524, 0xa523, 0xa521, 0xa520, 0xa51e, // 14136
-    0xa51d, 0xa51c, 0xa51a, 0xa519, 0xa518, 0xa516, 0xa515, 0xa514, // 14144
-    0xa512, 0xa511, 0xa50f, 0xa50e, 0xa50d, 0xa50b, 0xa50a, 0xa509, // 14152
-    0xa507, 0xa506, 0xa505, 0xa503, 0xa502, 0xa500, 0xa4ff, 0xa4fe, // 14160
-    0xa4fc, 0xa4fb, 0xa4fa, 0xa4f8, 0xa4f7, 0xa4f6, 0xa4f4, 0xa4f3, // 14168
-    0xa4f1, 0xa4f0, 0xa4ef, 0xa4ed, 0xa4ec, 0xa4eb, 0xa4e9, 0xa4e8, // 14176
-    0xa4e7, 0xa4e5, 0xa4e4, 0xa4e2, 0xa4e1, 0xa4e0, 0xa4de, 0xa4dd, // 14184
-    0xa4dc, 0xa4da, 0xa4d9, 0xa4d7, 0xa4d6, 0xa4d5, 0xa4d3, 0xa4d2, // 14192
-    0xa4d1, 0xa4cf, 0xa4ce, 0xa4cd, 0xa4cb, 0xa4ca, 0xa4c8, 0xa4c7, // 14200
-    0xa4c6, 0xa4c4, 0xa4c3, 0xa4c2, 0xa4c0, 0xa4bf, 0xa4be, 0xa4bc, // 14208
-    0xa4bb, 0xa4b9, 0xa4b8, 0xa4b7, 0xa4b5, 0xa4b4, 0xa4b3, 0xa4b1, // 14216
-    0xa4b0, 0xa4af, 0xa4ad, 0xa4ac, 0xa4aa, 0xa4a9, 0xa4a8, 0xa4a6, // 14224
-    0xa4a5, 0xa4a4, 0xa4a2, 0xa4a1, 0xa4a0, 0xa49e, 0xa49d, 0xa49b, // 14232
-    0xa49a, 0xa499, 0xa497, 0xa496, 0xa495, 0xa493, 0xa492, 0xa491, // 14240
-    0xa48f, 0xa48e, 0xa48c, 0xa48b, 0xa48a, 0xa488, 0xa487, 0xa486, // 14248
-    0xa484, 0xa483, 0xa481, 0xa480, 0xa47f, 0xa47d, 0xa47c, 0xa47b, // 14256
-    0xa479, 0xa478, 0xa477, 0xa475, 0xa474, 0xa472, 0xa471, 0xa470, // 14264
-    0xa46e, 0xa46d, 0xa46c, 0xa46a, 0xa469, 0xa468, 0xa466, 0xa465, // 14272
-    0xa463, 0xa462, 0xa461, 0xa45f, 0xa45e, 0xa45d, 0xa45b, 0xa45a, // 14280
-    0xa459, 0xa457, 0xa456, 0xa454, 0xa453, 0xa452, 0xa450, 0xa44f, // 14288
-    0xa44e, 0xa44c, 0xa44b, 0xa44a, 0xa448, 0xa447, 0xa445, 0xa444, // 14296
-    0xa443, 0xa441, 0xa440, 0xa43f, 0xa43d, 0xa43c, 0xa43a, 0xa439, // 14304
-    0xa438, 0xa436, 0xa435, 0xa434, 0xa432, 0xa431, 0xa430, 0xa42e, // 14312
-    0xa42d, 0xa42b, 0xa42a, 0xa429, 0xa427, 0xa426, 0xa425, 0xa423, // 14320
-    0xa422, 0xa421, 0xa41f, 0xa41e, 0xa41c, 0xa41b, 0xa41a, 0xa418, // 14328
-    0xa418, 0xa417, 0xa415, 0xa414, 0xa413, 0xa411, 0xa410, 0xa40f, // 14336
-    0xa40d, 0xa40c, 0xa40b, 0xa409, 0xa408, 0xa407, 0xa405, 0xa404, // 14344
-    0xa403, 0xa401, 0xa400, 0xa3ff, 0xa3fd, 0xa3fc, 0xa3fb, 0xa3f9, // 14352
-    0xa3f8, 0xa3f7, 0xa3f5, 0xa3f4, 0xa3f3, 0xa3f1, 0xa3f0, 0xa3ef, // 14360
-    0xa3ed, 0xa3ec, 0xa3eb, 0xa3e9, 0xa3e8, 0xa3e7, 0xa3e5, 0xa3e4, // 14368
-    0xa3e3, 0xa3e1, 0xa3e0, 0xa3df, 0xa3dd, 0xa3dc, 0xa3db, 0xa3d9, // 14376
-    0xa3d8, 0xa3d7, 0xa3d5, 0xa3d4, 0xa3d3, 0xa3d2, 0xa3d0, 0xa3cf, // 14384
-    0xa3ce, 0xa3cc, 0xa3cb, 0xa3ca, 0xa3c8, 0xa3c7, 0xa3c6, 0xa3c4, // 14392
-    0xa3c3, 0xa3c2, 0xa3c0, 0xa3bf, 0xa3be, 0xa3bc, 0xa3bb, 0xa3ba, // 14400
-    0xa3b8, 0xa3b7, 0xa3b6, 0xa3b4, 0xa3b3, 0xa3b2, 0xa3b0, 0xa3af, // 14408
-    0xa3ae, 0xa3ac, 0xa3ab, 0xa3aa, 0xa3a8, 0xa3a7, 0xa3a6, 0xa3a4, // 14416
-    0xa3a3, 0xa3a2, 0xa3a0, 0xa39f, 0xa39e, 0xa39c, 0xa39b, 0xa39a, // 14424
-    0xa398, 0xa397, 0xa396, 0xa394, 0xa393, 0xa392, 0xa390, 0xa38f, // 14432
-    0xa38e, 0xa38c, 0xa38b, 0xa38a, 0xa388, 0xa387, 0xa386, 0xa384, // 14440
-    0xa383, 0xa382, 0xa380, 0xa37f, 0xa37e, 0xa37c, 0xa37b, 0xa37a, // 14448
-    0xa378, 0xa377, 0xa376, 0xa374, 0xa373, 0xa372, 0xa370, 0xa36f, // 14456
-    0xa36e, 0xa36c, 0xa36b, 0xa36a, 0xa368, 0xa367, 0xa366, 0xa364, // 14464
-    0xa363, 0xa362, 0xa360, 0xa35f, 0xa35e, 0xa35c, 0xa35b, 0xa35a, // 14472
-    0xa358, 0xa357, 0xa356, 0xa354, 0xa353, 0xa352, 0xa350, 0xa34f, // 14480
-    0xa34e, 0xa34c, 0xa34b, 0xa34a, 0xa349, 0xa347, 0xa346, 0xa345, // 14488
-    0xa343, 0xa342, 0xa341, 0xa33f, 0xa33e, 0xa33d, 0xa33b, 0xa33a, // 14496
-    0xa339, 0xa337, 0xa336, 0xa335, 0xa333, 0xa332, 0xa331, 0xa32f, // 14504
-    0xa32e, 0xa32d, 0xa32b, 0xa32a, 0xa329, 0xa327, 0xa326, 0xa325, // 14512
-    0xa323, 0xa322, 0xa321, 0xa31f, 0xa31e, 0xa31d, 0xa31b, 0xa31a, // 14520
-    0xa319, 0xa317, 0xa316, 0xa315, 0xa313, 0xa312, 0xa311, 0xa30f, // 14528
-    0xa30e, 0xa30d, 0xa30b, 0xa30a, 0xa309, 0xa307, 0xa306, 0xa305, // 14536
-    0xa303, 0xa302, 0xa301, 0xa2ff, 0xa2fe, 0xa2fd, 0xa2fb, 0xa2fa, // 14544
-    0xa2f9, 0xa2f7, 0xa2f6, 0xa2f5, 0xa2f3, 0xa2f2, 0xa2f1, 0xa2ef, // 14552
-    0xa2ee, 0xa2ed, 0xa2eb, 0xa2ea, 0xa2e9, 0xa2e7, 0xa2e6, 0xa2e5, // 14560
-    0xa2e3, 0xa2e2, 0xa2e1, 0xa2df, 0xa2de, 0xa2dd, 0xa2db, 0xa2da, // 14568
-    0xa2d9, 0xa2d7, 0xa2d6, 0xa2d5, 0xa2d3, 0xa2d2, 0xa2d1, 0xa2cf, // 14576
-    0xa2ce, 0xa2cd, 0xa2cb, 0xa2ca, 0xa2c9, 0xa2c7, 0xa2c6, 0xa2c5, // 14584
-    0xa2c4, 0xa2c2, 0xa2c1, 0xa2c0, 0xa2be, 0xa2bd, 0xa2bc, 0xa2ba, // 14592
-    0xa2b9, 0xa2b8, 0xa2b6, 0xa2b5, 0xa2b4, 0xa2b2, 0xa2b1, 0xa2b0, // 14600
-    0xa2ae, 0xa2ad, 0xa2ac, 0xa2aa, 0xa2a9, 0xa2a8, 0xa2a6, 0xa2a5, // 14608
-    0xa2a4, 0xa2a2, 0xa2a1, 0xa2a0, 0xa29e, 0xa29d, 0xa29c, 0xa29a, // 14616
-    0xa299, 0xa298, 0xa296, 0xa295, 0xa294, 0xa292, 0xa291, 0xa290, // 14624
-    0xa28e, 0xa28d, 0xa28c, 0xa28a, 0xa289, 0xa288, 0xa286, 0xa285, // 14632
-    0xa284, 0xa282, 0xa281, 0xa280, 0xa27e, 0xa27d, 0xa27c, 0xa27a, // 14640
-    0xa279, 0xa278, 0xa276, 0xa275, 0xa274, 0xa272, 0xa271, 0xa270, // 14648
-    0xa26e, 0xa26d, 0xa26c, 0xa26a, 0xa269, 0xa268, 0xa266, 0xa265, // 14656
-    0xa264, 0xa262, 0xa261, 0xa260, 0xa25e, 0xa25d, 0xa25c, 0xa25a, // 14664
-    0xa259, 0xa258, 0xa256, 0xa255, 0xa254, 0xa252, 0xa251, 0xa250, // 14672
-    0xa24e, 0xa24d, 0xa24c, 0xa24a, 0xa249, 0xa248, 0xa246, 0xa245, // 14680
-    0xa244, 0xa242, 0xa241, 0xa240, 0xa23e, 0xa23d, 0xa23c, 0xa23b, // 14688
-    0xa239, 0xa238, 0xa237, 0xa235, 0xa234, 0xa233, 0xa231, 0xa230, // 14696
-    0xa22f, 0xa22d, 0xa22c, 0xa22b, 0xa229, 0xa228, 0xa227, 0xa225, // 14704
-    0xa224, 0xa223, 0xa221, 0xa220, 0xa21f, 0xa21d, 0xa21c, 0xa21b, // 14712
-    0xa219, 0xa218, 0xa217, 0xa215, 0xa214, 0xa213, 0xa211, 0xa210, // 14720
-    0xa20f, 0xa20d, 0xa20c, 0xa20b, 0xa209, 0xa208, 0xa207, 0xa205, // 14728
-    0xa204, 0xa203, 0xa201, 0xa200, 0xa1ff, 0xa1fd, 0xa1fc, 0xa1fb, // 14736
-    0xa1f9, 0xa1f8, 0xa1f7, 0xa1f5, 0xa1f4, 0xa1f3, 0xa1f1, 0xa1f0, // 14744
-    0xa1ef, 0xa1ed, 0xa1ec, 0xa1eb, 0xa1e9, 0xa1e8, 0xa1e7, 0xa1e5, // 14752
-    0xa1e4, 0xa1e3, 0xa1e1, 0xa1e0, 0xa1df, 0xa1dd, 0xa1dc, 0xa1db, // 14760
-    0xa1d9, 0xa1d8, 0xa1d7, 0xa1d5, 0xa1d4, 0xa1d3, 0xa1d1, 0xa1d0, // 14768
-    0xa1cf, 0xa1cd, 0xa1cc, 0xa1cb, 0xa1c9, 0xa1c8, 0xa1c7, 0xa1c5, // 14776
-    0xa1c4, 0xa1c3, 0xa1c1, 0xa1c0, 0xa1bf, 0xa1bd, 0xa1bc, 0xa1bb, // 14784
-    0xa1b9, 0xa1b8, 0xa1b7, 0xa1b5, 0xa1b4, 0xa1b3, 0xa1b2, 0xa1b0, // 14792
-    0xa1af, 0xa1ae, 0xa1ac, 0xa1ab, 0xa1aa, 0xa1a8, 0xa1a7, 0xa1a6, // 14800
-    0xa1a4, 0xa1a3, 0xa1a2, 0xa1a0, 0xa19f, 0xa19e, 0xa19c, 0xa19b, // 14808
-    0xa19a, 0xa198, 0xa197, 0xa196, 0xa194, 0xa193, 0xa192, 0xa190, // 14816
-    0xa18f, 0xa18e, 0xa18c, 0xa18b, 0xa18a, 0xa188, 0xa187, 0xa186, // 14824
-    0xa184, 0xa183, 0xa182, 0xa180, 0xa17f, 0xa17e, 0xa17c, 0xa17b, // 14832
-    0xa17a, 0xa178, 0xa177, 0xa176, 0xa174, 0xa173, 0xa172, 0xa170, // 14840
-    0xa16f, 0xa16e, 0xa16c, 0xa16b, 0xa16a, 0xa168, 0xa167, 0xa166, // 14848
-    0xa164, 0xa163, 0xa162, 0xa160, 0xa15f, 0xa15e, 0xa15c, 0xa15b, // 14856
-    0xa15a, 0xa158, 0xa157, 0xa156, 0xa154, 0xa153, 0xa152, 0xa150, // 14864
-    0xa14f, 0xa14e, 0xa14c, 0xa14b, 0xa14a, 0xa148, 0xa147, 0xa146, // 14872
-    0xa144, 0xa143, 0xa142, 0xa140, 0xa13f, 0xa13e, 0xa13c, 0xa13b, // 14880
-    0xa13a, 0xa138, 0xa137, 0xa136, 0xa134, 0xa133, 0xa132, 0xa130, // 14888
-    0xa12f, 0xa12e, 0xa12c, 0xa12b, 0xa12a, 0xa129, 0xa127, 0xa126, // 14896
-    0xa125, 0xa123, 0xa122, 0xa121, 0xa11f, 0xa11e, 0xa11d, 0xa11b, // 14904
-    0xa11a, 0xa119, 0xa117, 0xa116, 0xa115, 0xa113, 0xa112, 0xa111, // 14912
-    0xa10f, 0xa10e, 0xa10d, 0xa10b, 0xa10a, 0xa109, 0xa107, 0xa106, // 14920
-    0xa105, 0xa103, 0xa102, 0xa101, 0xa0ff, 0xa0fe, 0xa0fd, 0xa0fb, // 14928
-    0xa0fa, 0xa0f9, 0xa0f7, 0xa0f6, 0xa0f5, 0xa0f3, 0xa0f2, 0xa0f1, // 14936
-    0xa0ef, 0xa0ee, 0xa0ed, 0xa0eb, 0xa0ea, 0xa0e9, 0xa0e7, 0xa0e6, // 14944
-    0xa0e5, 0xa0e3, 0xa0e2, 0xa0e1, 0xa0df, 0xa0de, 0xa0dd, 0xa0db, // 14952
-    0xa0da, 0xa0d9, 0xa0d7, 0xa0d6, 0xa0d5, 0xa0d3, 0xa0d2, 0xa0d1, // 14960
-    0xa0cf, 0xa0ce, 0xa0cd, 0xa0cb, 0xa0ca, 0xa0c9, 0xa0c7, 0xa0c6, // 14968
-    0xa0c5, 0xa0c3, 0xa0c2, 0xa0c1, 0xa0bf, 0xa0be, 0xa0bd, 0xa0bb, // 14976
-    0xa0ba, 0xa0b9, 0xa0b7, 0xa0b6, 0xa0b5, 0xa0b3, 0xa0b2, 0xa0b1, // 14984
-    0xa0af, 0xa0ae, 0xa0ad, 0xa0ab, 0xa0aa, 0xa0a9, 0xa0a7, 0xa0a6, // 14992
-    0xa0a5, 0xa0a3, 0xa0a2, 0xa0a1, 0xa0a0, 0xa09e, 0xa09d, 0xa09c, // 15000
-    0xa09a, 0xa099, 0xa098, 0xa096, 0xa095, 0xa094, 0xa092, 0xa091, // 15008
-    0xa090, 0xa08e, 0xa08d, 0xa08c, 0xa08a, 0xa089, 0xa088, 0xa086, // 15016
-    0xa085, 0xa084, 0xa082, 0xa081, 0xa080, 0xa07e, 0xa07d, 0xa07c, // 15024
-    0xa07a, 0xa079, 0xa078, 0xa076, 0xa075, 0xa074, 0xa072, 0xa071, // 15032
-    0xa070, 0xa06e, 0xa06d, 0xa06c, 0xa06a, 0xa069, 0xa068, 0xa066, // 15040
-    0xa065, 0xa064, 0xa062, 0xa061, 0xa060, 0xa05e, 0xa05d, 0xa05c, // 15048
-    0xa05a, 0xa059, 0xa058, 0xa056, 0xa055, 0xa054, 0xa052, 0xa051, // 15056
-    0xa050, 0xa04e, 0xa04d, 0xa04c, 0xa04a, 0xa049, 0xa048, 0xa046, // 15064
-    0xa045, 0xa044, 0xa042, 0xa041, 0xa040, 0xa03e, 0xa03d, 0xa03c, // 15072
-    0xa03a, 0xa039, 0xa038, 0xa036, 0xa035, 0xa034, 0xa032, 0xa031, // 15080
-    0xa030, 0xa02e, 0xa02d, 0xa02c, 0xa02a, 0xa029, 0xa028, 0xa026, // 15088
-    0xa025, 0xa024, 0xa022, 0xa021, 0xa020, 0xa01e, 0xa01d, 0xa01c, // 15096
-    0xa01b, 0xa019, 0xa018, 0xa017, 0xa015, 0xa014, 0xa013, 0xa011, // 15104
-    0xa010, 0xa00f, 0xa00d, 0xa00c, 0xa00b, 0xa009, 0xa008, 0xa007, // 15112
-    0xa005, 0xa004, 0xa003, 0xa001, 0xa000, 0x9fff, 0x9ffd, 0x9ffc, // 15120
-    0x9ffb, 0x9ff9, 0x9ff8, 0x9ff7, 0x9ff5, 0x9ff4, 0x9ff3, 0x9ff1, // 15128
-    0x9ff0, 0x9fef, 0x9fed, 0x9fec, 0x9feb, 0x9fe9, 0x9fe8, 0x9fe7, // 15136
-    0x9fe5, 0x9fe4, 0x9fe3, 0x9fe1, 0x9fe0, 0x9fdf, 0x9fdd, 0x9fdc, // 15144
-    0x9fdb, 0x9fd9, 0x9fd8, 0x9fd7, 0x9fd5, 0x9fd4, 0x9fd3, 0x9fd1, // 15152
-    0x9fd0, 0x9fcf, 0x9fcd, 0x9fcc, 0x9fcb, 0x9fc9, 0x9fc8, 0x9fc7, // 15160
-    0x9fc5, 0x9fc4, 0x9fc3, 0x9fc1, 0x9fc0, 0x9fbf, 0x9fbd, 0x9fbc, // 15168
-    0x9fbb, 0x9fb9, 0x9fb8, 0x9fb7, 0x9fb5, 0x9fb4, 0x9fb3, 0x9fb1, // 15176
-    0x9fb0, 0x9faf, 0x9fad, 0x9fac, 0x9fab, 0x9fa9, 0x9fa8, 0x9fa7, // 15184
-    0x9fa5, 0x9fa4, 0x9fa3, 0x9fa1, 0x9fa0, 0x9f9f, 0x9f9d, 0x9f9c, // 15192
-    0x9f9b, 0x9f99, 0x9f98, 0x9f97, 0x9f95, 0x9f94, 0x9f93, 0x9f92, // 15200
-    0x9f90, 0x9f8f, 0x9f8e, 0x9f8c, 0x9f8b, 0x9f8a, 0x9f88, 0x9f87, // 15208
-    0x9f86, 0x9f84, 0x9f83, 0x9f82, 0x9f80, 0x9f7f, 0x9f7e, 0x9f7c, // 15216
-    0x9f7b, 0x9f7a, 0x9f78, 0x9f77, 0x9f76, 0x9f74, 0x9f73, 0x9f72, // 15224
-    0x9f70, 0x9f6f, 0x9f6e, 0x9f6c, 0x9f6b, 0x9f6a, 0x9f68, 0x9f67, // 15232
-    0x9f66, 0x9f64, 0x9f63, 0x9f62, 0x9f60, 0x9f5f, 0x9f5e, 0x9f5c, // 15240
-    0x9f5b, 0x9f5a, 0x9f58, 0x9f57, 0x9f56, 0x9f54, 0x9f53, 0x9f52, // 15248
-    0x9f50, 0x9f4f, 0x9f4e, 0x9f4c, 0x9f4b, 0x9f4a, 0x9f48, 0x9f47, // 15256
-    0x9f46, 0x9f44, 0x9f43, 0x9f42, 0x9f40, 0x9f3f, 0x9f3e, 0x9f3c, // 15264
-    0x9f3b, 0x9f3a, 0x9f38, 0x9f37, 0x9f36, 0x9f34, 0x9f33, 0x9f32, // 15272
-    0x9f30, 0x9f2f, 0x9f2e, 0x9f2c, 0x9f2b, 0x9f2a, 0x9f28, 0x9f27, // 15280
-    0x9f26, 0x9f24, 0x9f23, 0x9f22, 0x9f20, 0x9f1f, 0x9f1e, 0x9f1c, // 15288
-    0x9f1b, 0x9f1a, 0x9f18, 0x9f17, 0x9f16, 0x9f14, 0x9f13, 0x9f12, // 15296
-    0x9f10, 0x9f0f, 0x9f0e, 0x9f0c, 0x9f0b, 0x9f0a, 0x9f09, 0x9f07, // 15304
-    0x9f06, 0x9f05, 0x9f03, 0x9f02, 0x9f01, 0x9eff, 0x9efe, 0x9efd, // 15312
-    0x9efb, 0x9efa, 0x9ef9, 0x9ef7, 0x9ef6, 0x9ef5, 0x9ef3, 0x9ef2, // 15320
-    0x9ef1, 0x9eef, 0x9eee, 0x9eed, 0x9eeb, 0x9eea, 0x9ee9, 0x9ee7, // 15328
-    0x9ee6, 0x9ee5, 0x9ee3, 0x9ee2, 0x9ee1, 0x9edf, 0x9ede, 0x9edd, // 15336
-    0x9edb, 0x9eda, 0x9ed9, 0x9ed7, 0x9ed6, 0x9ed5, 0x9ed3, 0x9ed2, // 15344
-    0x9ed1, 0x9ecf, 0x9ece, 0x9ecd, 0x9ecb, 0x9eca, 0x9ec9, 0x9ec7, // 15352
-    0x9ec6, 0x9ec4, 0x9ec3, 0x9ec2, 0x9ec0, 0x9ebf, 0x9ebe, 0x9ebc, // 15360
-    0x9ebb, 0x9eba, 0x9eb9, 0x9eb7, 0x9eb6, 0x9eb5, 0x9eb3, 0x9eb2, // 15368
-    0x9eb1, 0x9eaf, 0x9eae, 0x9ead, 0x9eac, 0x9eaa, 0x9ea9, 0x9ea8, // 15376
-    0x9ea6, 0x9ea5, 0x9ea4, 0x9ea3, 0x9ea1, 0x9ea0, 0x9e9f, 0x9e9d, // 15384
-    0x9e9c, 0x9e9b, 0x9e99, 0x9e98, 0x9e97, 0x9e96, 0x9e94, 0x9e93, // 15392
-    0x9e92, 0x9e90, 0x9e8f, 0x9e8e, 0x9e8d, 0x9e8b, 0x9e8a, 0x9e89, // 15400
-    0x9e87, 0x9e86, 0x9e85, 0x9e83, 0x9e82, 0x9e81, 0x9e80, 0x9e7e, // 15408
-    0x9e7d, 0x9e7c, 0x9e7a, 0x9e79, 0x9e78, 0x9e77, 0x9e75, 0x9e74, // 15416
-    0x9e73, 0x9e71, 0x9e70, 0x9e6f, 0x9e6d, 0x9e6c, 0x9e6b, 0x9e6a, // 15424
-    0x9e68, 0x9e67, 0x9e66, 0x9e64, 0x9e63, 0x9e62, 0x9e60, 0x9e5f, // 15432
-    0x9e5e, 0x9e5d, 0x9e5b, 0x9e5a, 0x9e59, 0x9e57, 0x9e56, 0x9e55, // 15440
-    0x9e54, 0x9e52, 0x9e51, 0x9e50, 0x9e4e, 0x9e4d, 0x9e4c, 0x9e4a, // 15448
-    0x9e49, 0x9e48, 0x9e47, 0x9e45, 0x9e44, 0x9e43, 0x9e41, 0x9e40, // 15456
-    0x9e3f, 0x9e3e, 0x9e3c, 0x9e3b, 0x9e3a, 0x9e38, 0x9e37, 0x9e36, // 15464
-    0x9e34, 0x9e33, 0x9e32, 0x9e31, 0x9e2f, 0x9e2e, 0x9e2d, 0x9e2b, // 15472
-    0x9e2a, 0x9e29, 0x9e28, 0x9e26, 0x9e25, 0x9e24, 0x9e22, 0x9e21, // 15480
-    0x9e20, 0x9e1e, 0x9e1d, 0x9e1c, 0x9e1b, 0x9e19, 0x9e18, 0x9e17, // 15488
-    0x9e15, 0x9e14, 0x9e13, 0x9e12, 0x9e10, 0x9e0f, 0x9e0e, 0x9e0c, // 15496
-    0x9e0b, 0x9e0a, 0x9e08, 0x9e07, 0x9e06, 0x9e05, 0x9e03, 0x9e02, // 15504
-    0x9e01, 0x9dff, 0x9dfe, 0x9dfd, 0x9dfb, 0x9dfa, 0x9df9, 0x9df8, // 15512
-    0x9df6, 0x9df5, 0x9df4, 0x9df2, 0x9df1, 0x9df0, 0x9def, 0x9ded, // 15520
-    0x9dec, 0x9deb, 0x9de9, 0x9de8, 0x9de7, 0x9de5, 0x9de4, 0x9de3, // 15528
-    0x9de2, 0x9de0, 0x9ddf, 0x9dde, 0x9ddc, 0x9ddb, 0x9dda, 0x9dd9, // 15536
-    0x9dd7, 0x9dd6, 0x9dd5, 0x9dd3, 0x9dd2, 0x9dd1, 0x9dcf, 0x9dce, // 15544
-    0x9dcd, 0x9dcc, 0x9dca, 0x9dc9, 0x9dc8, 0x9dc6, 0x9dc5, 0x9dc4, // 15552
-    0x9dc3, 0x9dc1, 0x9dc0, 0x9dbf, 0x9dbd, 0x9dbc, 0x9dbb, 0x9db9, // 15560
-    0x9db8, 0x9db7, 0x9db6, 0x9db4, 0x9db3, 0x9db2, 0x9db0, 0x9daf, // 15568
-    0x9dae, 0x9dad, 0x9dab, 0x9daa, 0x9da9, 0x9da7, 0x9da6, 0x9da5, // 15576
-    0x9da3, 0x9da2, 0x9da1, 0x9da0, 0x9d9e, 0x9d9d, 0x9d9c, 0x9d9a, // 15584
-    0x9d99, 0x9d98, 0x9d96, 0x9d95, 0x9d94, 0x9d93, 0x9d91, 0x9d90, // 15592
-    0x9d8f, 0x9d8d, 0x9d8c, 0x9d8b, 0x9d8a, 0x9d88, 0x9d87, 0x9d86, // 15600
-    0x9d84, 0x9d83, 0x9d82, 0x9d80, 0x9d7f, 0x9d7e, 0x9d7d, 0x9d7b, // 15608
-    0x9d7a, 0x9d79, 0x9d77, 0x9d76, 0x9d75, 0x9d74, 0x9d72, 0x9d71, // 15616
-    0x9d70, 0x9d6e, 0x9d6d, 0x9d6c, 0x9d6a, 0x9d69, 0x9d68, 0x9d67, // 15624
-    0x9d65, 0x9d64, 0x9d63, 0x9d61, 0x9d60, 0x9d5f, 0x9d5e, 0x9d5c, // 15632
-    0x9d5b, 0x9d5a, 0x9d58, 0x9d57, 0x9d56, 0x9d54, 0x9d53, 0x9d52, // 15640
-    0x9d51, 0x9d4f, 0x9d4e, 0x9d4d, 0x9d4b, 0x9d4a, 0x9d49, 0x9d47, // 15648
-    0x9d46, 0x9d45, 0x9d44, 0x9d42, 0x9d41, 0x9d40, 0x9d3e, 0x9d3d, // 15656
-    0x9d3c, 0x9d3b, 0x9d39, 0x9d38, 0x9d37, 0x9d35, 0x9d34, 0x9d33, // 15664
-    0x9d31, 0x9d30, 0x9d2f, 0x9d2e, 0x9d2c, 0x9d2b, 0x9d2a, 0x9d28, // 15672
-    0x9d27, 0x9d26, 0x9d25, 0x9d23, 0x9d22, 0x9d21, 0x9d1f, 0x9d1e, // 15680
-    0x9d1d, 0x9d1b, 0x9d1a, 0x9d19, 0x9d18, 0x9d16, 0x9d15, 0x9d14, // 15688
-    0x9d12, 0x9d11, 0x9d10, 0x9d0f, 0x9d0d, 0x9d0c, 0x9d0b, 0x9d09, // 15696
-    0x9d08, 0x9d07, 0x9d05, 0x9d04, 0x9d03, 0x9d02, 0x9d00, 0x9cff, // 15704
-    0x9cfe, 0x9cfc, 0x9cfb, 0x9cfa, 0x9cf9, 0x9cf7, 0x9cf6, 0x9cf5, // 15712
-    0x9cf3, 0x9cf2, 0x9cf1, 0x9cef, 0x9cee, 0x9ced, 0x9cec, 0x9cea, // 15720
-    0x9ce9, 0x9ce8, 0x9ce6, 0x9ce5, 0x9ce4, 0x9ce2, 0x9ce1, 0x9ce0, // 15728
-    0x9cdf, 0x9cdd, 0x9cdc, 0x9cdb, 0x9cd9, 0x9cd8, 0x9cd7, 0x9cd6, // 15736
-    0x9cd4, 0x9cd3, 0x9cd2, 0x9cd0, 0x9ccf, 0x9cce, 0x9ccc, 0x9ccb, // 15744
-    0x9cca, 0x9cc9, 0x9cc7, 0x9cc6, 0x9cc5, 0x9cc3, 0x9cc2, 0x9cc1, // 15752
-    0x9cc0, 0x9cbe, 0x9cbd, 0x9cbc, 0x9cba, 0x9cb9, 0x9cb8, 0x9cb6, // 15760
-    0x9cb5, 0x9cb4, 0x9cb3, 0x9cb1, 0x9cb0, 0x9caf, 0x9cad, 0x9cac, // 15768
-    0x9cab, 0x9caa, 0x9ca8, 0x9ca7, 0x9ca6, 0x9ca4, 0x9ca3, 0x9ca2, // 15776
-    0x9ca0, 0x9c9f, 0x9c9e, 0x9c9d, 0x9c9b, 0x9c9a, 0x9c99, 0x9c97, // 15784
-    0x9c96, 0x9c95, 0x9c94, 0x9c92, 0x9c91, 0x9c90, 0x9c8e, 0x9c8d, // 15792
-    0x9c8c, 0x9c8a, 0x9c89, 0x9c88, 0x9c87, 0x9c85, 0x9c84, 0x9c83, // 15800
-    0x9c81, 0x9c80, 0x9c7f, 0x9c7d, 0x9c7c, 0x9c7b, 0x9c7a, 0x9c78, // 15808
-    0x9c77, 0x9c76, 0x9c74, 0x9c73, 0x9c72, 0x9c71, 0x9c6f, 0x9c6e, // 15816
-    0x9c6d, 0x9c6b, 0x9c6a, 0x9c69, 0x9c67, 0x9c66, 0x9c65, 0x9c64, // 15824
-    0x9c62, 0x9c61, 0x9c60, 0x9c5e, 0x9c5d, 0x9c5c, 0x9c5b, 0x9c59, // 15832
-    0x9c58, 0x9c57, 0x9c55, 0x9c54, 0x9c53, 0x9c51, 0x9c50, 0x9c4f, // 15840
-    0x9c4e, 0x9c4c, 0x9c4b, 0x9c4a, 0x9c48, 0x9c47, 0x9c46, 0x9c45, // 15848
-    0x9c43, 0x9c42, 0x9c41, 0x9c3f, 0x9c3e, 0x9c3d, 0x9c3b, 0x9c3a, // 15856
-    0x9c39, 0x9c38, 0x9c36, 0x9c35, 0x9c34, 0x9c32, 0x9c31, 0x9c30, // 15864
-    0x9c2f, 0x9c2d, 0x9c2c, 0x9c2b, 0x9c29, 0x9c28, 0x9c27, 0x9c25, // 15872
-    0x9c24, 0x9c23, 0x9c22, 0x9c20, 0x9c1f, 0x9c1e, 0x9c1c, 0x9c1b, // 15880
-    0x9c1a, 0x9c18, 0x9c17, 0x9c16, 0x9c15, 0x9c13, 0x9c12, 0x9c11, // 15888
-    0x9c0f, 0x9c0e, 0x9c0d, 0x9c0c, 0x9c0a, 0x9c09, 0x9c08, 0x9c06, // 15896
-    0x9c05, 0x9c04, 0x9c02, 0x9c01, 0x9c00, 0x9bff, 0x9bfd, 0x9bfc, // 15904
-    0x9bfb, 0x9bf9, 0x9bf8, 0x9bf7, 0x9bf6, 0x9bf4, 0x9bf3, 0x9bf2, // 15912
-    0x9bf0, 0x9bef, 0x9bee, 0x9bec, 0x9beb, 0x9bea, 0x9be9, 0x9be7, // 15920
-    0x9be6, 0x9be5, 0x9be3, 0x9be2, 0x9be1, 0x9be0, 0x9bde, 0x9bdd, // 15928
-    0x9bdc, 0x9bda, 0x9bd9, 0x9bd8, 0x9bd6, 0x9bd5, 0x9bd4, 0x9bd3, // 15936
-    0x9bd1, 0x9bd0, 0x9bcf, 0x9bcd, 0x9bcc, 0x9bcb, 0x9bc9, 0x9bc8, // 15944
-    0x9bc7, 0x9bc6, 0x9bc4, 0x9bc3, 0x9bc2, 0x9bc0, 0x9bbf, 0x9bbe, // 15952
-    0x9bbd, 0x9bbb, 0x9bba, 0x9bb9, 0x9bb7, 0x9bb6, 0x9bb5, 0x9bb3, // 15960
-    0x9bb2, 0x9bb1, 0x9bb0, 0x9bae, 0x9bad, 0x9bac, 0x9baa, 0x9ba9, // 15968
-    0x9ba8, 0x9ba7, 0x9ba5, 0x9ba4, 0x9ba3, 0x9ba1, 0x9ba0, 0x9b9f, // 15976
-    0x9b9d, 0x9b9c, 0x9b9b, 0x9b9a, 0x9b98, 0x9b97, 0x9b96, 0x9b94, // 15984
-    0x9b93, 0x9b92, 0x9b91, 0x9b8f, 0x9b8e, 0x9b8d, 0x9b8b, 0x9b8a, // 15992
-    0x9b89, 0x9b87, 0x9b86, 0x9b85, 0x9b84, 0x9b82, 0x9b81, 0x9b80, // 16000
-    0x9b7e, 0x9b7d, 0x9b7c, 0x9b7b, 0x9b79, 0x9b78, 0x9b77, 0x9b75, // 16008
-    0x9b74, 0x9b73, 0x9b71, 0x9b70, 0x9b6f, 0x9b6e, 0x9b6c, 0x9b6b, // 16016
-    0x9b6a, 0x9b68, 0x9b67, 0x9b66, 0x9b64, 0x9b63, 0x9b62, 0x9b61, // 16024
-    0x9b5f, 0x9b5e, 0x9b5d, 0x9b5b, 0x9b5a, 0x9b59, 0x9b58, 0x9b56, // 16032
-    0x9b55, 0x9b54, 0x9b52, 0x9b51, 0x9b50, 0x9b4e, 0x9b4d, 0x9b4c, // 16040
-    0x9b4b, 0x9b49, 0x9b48, 0x9b47, 0x9b45, 0x9b44, 0x9b43, 0x9b42, // 16048
-    0x9b40, 0x9b3f, 0x9b3e, 0x9b3c, 0x9b3b, 0x9b3a, 0x9b38, 0x9b37, // 16056
-    0x9b36, 0x9b35, 0x9b33, 0x9b32, 0x9b31, 0x9b2f, 0x9b2e, 0x9b2d, // 16064
-    0x9b2c, 0x9b2a, 0x9b29, 0x9b28, 0x9b26, 0x9b25, 0x9b24, 0x9b22, // 16072
-    0x9b21, 0x9b20, 0x9b1f, 0x9b1d, 0x9b1c, 0x9b1b, 0x9b19, 0x9b18, // 16080
-    0x9b17, 0x9b16, 0x9b14, 0x9b13, 0x9b12, 0x9b10, 0x9b0f, 0x9b0e, // 16088
-    0x9b0c, 0x9b0b, 0x9b0a, 0x9b09, 0x9b07, 0x9b06, 0x9b05, 0x9b03, // 16096
-    0x9b02, 0x9b01, 0x9aff, 0x9afe, 0x9afd, 0x9afc, 0x9afa, 0x9af9, // 16104
-    0x9af8, 0x9af6, 0x9af5, 0x9af4, 0x9af3, 0x9af1, 0x9af0, 0x9aef, // 16112
-    0x9aed, 0x9aec, 0x9aeb, 0x9ae9, 0x9ae8, 0x9ae7, 0x9ae6, 0x9ae4, // 16120
-    0x9ae3, 0x9ae2, 0x9ae0, 0x9adf, 0x9ade, 0x9add, 0x9adb, 0x9ada, // 16128
-    0x9ad9, 0x9ad7, 0x9ad6, 0x9ad5, 0x9ad3, 0x9ad2, 0x9ad1, 0x9ad0, // 16136
-    0x9ace, 0x9acd, 0x9acc, 0x9aca, 0x9ac9, 0x9ac8, 0x9ac7, 0x9ac5, // 16144
-    0x9ac4, 0x9ac3, 0x9ac1, 0x9ac0, 0x9abf, 0x9abd, 0x9abc, 0x9abb, // 16152
-    0x9aba, 0x9ab8, 0x9ab7, 0x9ab6, 0x9ab4, 0x9ab3, 0x9ab2, 0x9ab0, // 16160
-    0x9aaf, 0x9aae, 0x9aad, 0x9aab, 0x9aaa, 0x9aa9, 0x9aa7, 0x9aa6, // 16168
-    0x9aa5, 0x9aa4, 0x9aa2, 0x9aa1, 0x9aa0, 0x9a9e, 0x9a9d, 0x9a9c, // 16176
-    0x9a9a, 0x9a99, 0x9a98, 0x9a97, 0x9a95, 0x9a94, 0x9a93, 0x9a91, // 16184
-    0x9a90, 0x9a8f, 0x9a8e, 0x9a8c, 0x9a8b, 0x9a8a, 0x9a88, 0x9a87, // 16192
-    0x9a86, 0x9a84, 0x9a83, 0x9a82, 0x9a81, 0x9a7f, 0x9a7e, 0x9a7d, // 16200
-    0x9a7b, 0x9a7a, 0x9a79, 0x9a78, 0x9a76, 0x9a75, 0x9a74, 0x9a72, // 16208
-    0x9a71, 0x9a70, 0x9a6e, 0x9a6d, 0x9a6c, 0x9a6b, 0x9a69, 0x9a68, // 16216
-    0x9a67, 0x9a65, 0x9a64, 0x9a63, 0x9a62, 0x9a60, 0x9a5f, 0x9a5e, // 16224
-    0x9a5c, 0x9a5b, 0x9a5a, 0x9a58, 0x9a57, 0x9a56, 0x9a55, 0x9a53, // 16232
-    0x9a52, 0x9a51, 0x9a4f, 0x9a4e, 0x9a4d, 0x9a4b, 0x9a4a, 0x9a49, // 16240
-    0x9a48, 0x9a46, 0x9a45, 0x9a44, 0x9a42, 0x9a41, 0x9a40, 0x9a3f, // 16248
-    0x9a3d, 0x9a3c, 0x9a3b, 0x9a39, 0x9a38, 0x9a37, 0x9a35, 0x9a34, // 16256
-    0x9a33, 0x9a32, 0x9a30, 0x9a2f, 0x9a2e, 0x9a2c, 0x9a2b, 0x9a2a, // 16264
-    0x9a29, 0x9a27, 0x9a26, 0x9a25, 0x9a23, 0x9a22, 0x9a21, 0x9a1f, // 16272
-    0x9a1e, 0x9a1d, 0x9a1c, 0x9a1a, 0x9a19, 0x9a18, 0x9a16, 0x9a15, // 16280
-    0x9a14, 0x9a13, 0x9a11, 0x9a10, 0x9a0f, 0x9a0d, 0x9a0c, 0x9a0b, // 16288
-    0x9a09, 0x9a08, 0x9a07, 0x9a06, 0x9a04, 0x9a03, 0x9a02, 0x9a00, // 16296
-    0x99ff, 0x99fe, 0x99fd, 0x99fb, 0x99fa, 0x99f9, 0x99f7, 0x99f6, // 16304
-    0x99f5, 0x99f3, 0x99f2, 0x99f1, 0x99f0, 0x99ee, 0x99ed, 0x99ec, // 16312
-    0x99ea, 0x99e9, 0x99e8, 0x99e6, 0x99e5, 0x99e4, 0x99e3, 0x99e1, // 16320
-    0x99e0, 0x99df, 0x99dd, 0x99dc, 0x99db, 0x99da, 0x99d8, 0x99d7, // 16328
-    0x99d6, 0x99d4, 0x99d3, 0x99d2, 0x99d0, 0x99cf, 0x99ce, 0x99cd, // 16336
-    0x99cb, 0x99ca, 0x99c9, 0x99c7, 0x99c6, 0x99c5, 0x99c4, 0x99c2, // 16344
-    0x99c1, 0x99c0, 0x99be, 0x99bd, 0x99bc, 0x99ba, 0x99b9, 0x99b8, // 16352
-    0x99b7, 0x99b5, 0x99b4, 0x99b3, 0x99b1, 0x99b0, 0x99af, 0x99ae, // 16360
-    0x99ac, 0x99ab, 0x99aa, 0x99a8, 0x99a7, 0x99a6, 0x99a4, 0x99a3, // 16368
-    0x99a2, 0x99a1, 0x999f, 0x999e, 0x999d, 0x999b, 0x999a, 0x9999, // 16376
-    0x9997, 0x9996, 0x9994, 0x9993, 0x9992, 0x9991, 0x998f, 0x998e, // 16384
-    0x998d, 0x998c, 0x998a, 0x9989, 0x9988, 0x9987, 0x9985, 0x9984, // 16392
-    0x9983, 0x9982, 0x9980, 0x997f, 0x997e, 0x997c, 0x997b, 0x997a, // 16400
-    0x9979, 0x9977, 0x9976, 0x9975, 0x9974, 0x9972, 0x9971, 0x9970, // 16408
-    0x996f, 0x996d, 0x996c, 0x996b, 0x996a, 0x9968, 0x9967, 0x9966, // 16416
-    0x9964, 0x9963, 0x9962, 0x9961, 0x995f, 0x995e, 0x995d, 0x995c, // 16424
-    0x995a, 0x9959, 0x9958, 0x9957, 0x9955, 0x9954, 0x9953, 0x9951, // 16432
-    0x9950, 0x994f, 0x994e, 0x994c, 0x994b, 0x994a, 0x9949, 0x9947, // 16440
-    0x9946, 0x9945, 0x9944, 0x9942, 0x9941, 0x9940, 0x993f, 0x993d, // 16448
-    0x993c, 0x993b, 0x9939, 0x9938, 0x9937, 0x9936, 0x9934, 0x9933, // 16456
-    0x9932, 0x9931, 0x992f, 0x992e, 0x992d, 0x992c, 0x992a, 0x9929, // 16464
-    0x9928, 0x9927, 0x9925, 0x9924, 0x9923, 0x9921, 0x9920, 0x991f, // 16472
-    0x991e, 0x991c, 0x991b, 0x991a, 0x9919, 0x9917, 0x9916, 0x9915, // 16480
-    0x9914, 0x9912, 0x9911, 0x9910, 0x990f, 0x990d, 0x990c, 0x990b, // 16488
-    0x9909, 0x9908, 0x9907, 0x9906, 0x9904, 0x9903, 0x9902, 0x9901, // 16496
-    0x98ff, 0x98fe, 0x98fd, 0x98fc, 0x98fa, 0x98f9, 0x98f8, 0x98f7, // 16504
-    0x98f5, 0x98f4, 0x98f3, 0x98f1, 0x98f0, 0x98ef, 0x98ee, 0x98ec, // 16512
-    0x98eb, 0x98ea, 0x98e9, 0x98e7, 0x98e6, 0x98e5, 0x98e4, 0x98e2, // 16520
-    0x98e1, 0x98e0, 0x98df, 0x98dd, 0x98dc, 0x98db, 0x98d9, 0x98d8, // 16528
-    0x98d7, 0x98d6, 0x98d4, 0x98d3, 0x98d2, 0x98d1, 0x98cf, 0x98ce, // 16536
-    0x98cd, 0x98cc, 0x98ca, 0x98c9, 0x98c8, 0x98c6, 0x98c5, 0x98c4, // 16544
-    0x98c3, 0x98c1, 0x98c0, 0x98bf, 0x98be, 0x98bc, 0x98bb, 0x98ba, // 16552
-    0x98b9, 0x98b7, 0x98b6, 0x98b5, 0x98b4, 0x98b2, 0x98b1, 0x98b0, // 16560
-    0x98ae, 0x98ad, 0x98ac, 0x98ab, 0x98a9, 0x98a8, 0x98a7, 0x98a6, // 16568
-    0x98a4, 0x98a3, 0x98a2, 0x98a1, 0x989f, 0x989e, 0x989d, 0x989c, // 16576
-    0x989a, 0x9899, 0x9898, 0x9896, 0x9895, 0x9894, 0x9893, 0x9891, // 16584
-    0x9890, 0x988f, 0x988e, 0x988c, 0x988b, 0x988a, 0x9889, 0x9887, // 16592
-    0x9886, 0x9885, 0x9884, 0x9882, 0x9881, 0x9880, 0x987e, 0x987d, // 16600
-    0x987c, 0x987b, 0x9879, 0x9878, 0x9877, 0x9876, 0x9874, 0x9873, // 16608
-    0x9872, 0x9871, 0x986f, 0x986e, 0x986d, 0x986c, 0x986a, 0x9869, // 16616
-    0x9868, 0x9866, 0x9865, 0x9864, 0x9863, 0x9861, 0x9860, 0x985f, // 16624
-    0x985e, 0x985c, 0x985b, 0x985a, 0x9859, 0x9857, 0x9856, 0x9855, // 16632
-    0x9854, 0x9852, 0x9851, 0x9850, 0x984e, 0x984d, 0x984c, 0x984b, // 16640
-    0x9849, 0x9848, 0x9847, 0x9846, 0x9844, 0x9843, 0x9842, 0x9841, // 16648
-    0x983f, 0x983e, 0x983d, 0x983b, 0x983a, 0x9839, 0x9838, 0x9836, // 16656
-    0x9835, 0x9834, 0x9833, 0x9831, 0x9830, 0x982f, 0x982e, 0x982c, // 16664
-    0x982b, 0x982a, 0x9829, 0x9827, 0x9826, 0x9825, 0x9823, 0x9822, // 16672
-    0x9821, 0x9820, 0x981e, 0x981d, 0x981c, 0x981b, 0x9819, 0x9818, // 16680
-    0x9817, 0x9816, 0x9814, 0x9813, 0x9812, 0x9811, 0x980f, 0x980e, // 16688
-    0x980d, 0x980b, 0x980a, 0x9809, 0x9808, 0x9806, 0x9805, 0x9804, // 16696
-    0x9803, 0x9801, 0x9800, 0x97ff, 0x97fe, 0x97fc, 0x97fb, 0x97fa, // 16704
-    0x97f9, 0x97f7, 0x97f6, 0x97f5, 0x97f3, 0x97f2, 0x97f1, 0x97f0, // 16712
-    0x97ee, 0x97ed, 0x97ec, 0x97eb, 0x97e9, 0x97e8, 0x97e7, 0x97e6, // 16720
-    0x97e4, 0x97e3, 0x97e2, 0x97e1, 0x97df, 0x97de, 0x97dd, 0x97db, // 16728
-    0x97da, 0x97d9, 0x97d8, 0x97d6, 0x97d5, 0x97d4, 0x97d3, 0x97d1, // 16736
-    0x97d0, 0x97cf, 0x97ce, 0x97cc, 0x97cb, 0x97ca, 0x97c8, 0x97c7, // 16744
-    0x97c6, 0x97c5, 0x97c3, 0x97c2, 0x97c1, 0x97c0, 0x97be, 0x97bd, // 16752
-    0x97bc, 0x97bb, 0x97b9, 0x97b8, 0x97b7, 0x97b6, 0x97b4, 0x97b3, // 16760
-    0x97b2, 0x97b0, 0x97af, 0x97ae, 0x97ad, 0x97ab, 0x97aa, 0x97a9, // 16768
-    0x97a8, 0x97a6, 0x97a5, 0x97a4, 0x97a3, 0x97a1, 0x97a0, 0x979f, // 16776
-    0x979e, 0x979c, 0x979b, 0x979a, 0x9798, 0x9797, 0x9796, 0x9795, // 16784
-    0x9793, 0x9792, 0x9791, 0x9790, 0x978e, 0x978d, 0x978c, 0x978b, // 16792
-    0x9789, 0x9788, 0x9787, 0x9786, 0x9784, 0x9783, 0x9782, 0x9780, // 16800
-    0x977f, 0x977e, 0x977d, 0x977b, 0x977a, 0x9779, 0x9778, 0x9776, // 16808
-    0x9775, 0x9774, 0x9773, 0x9771, 0x9770, 0x976f, 0x976e, 0x976c, // 16816
-    0x976b, 0x976a, 0x9768, 0x9767, 0x9766, 0x9765, 0x9763, 0x9762, // 16824
-    0x9761, 0x9760, 0x975e, 0x975d, 0x975c, 0x975b, 0x9759, 0x9758, // 16832
-    0x9757, 0x9756, 0x9754, 0x9753, 0x9752, 0x9750, 0x974f, 0x974e, // 16840
-    0x974d, 0x974b, 0x974a, 0x9749, 0x9748, 0x9746, 0x9745, 0x9744, // 16848
-    0x9743, 0x9741, 0x9740, 0x973f, 0x973d, 0x973c, 0x973b, 0x973a, // 16856
-    0x9738, 0x9737, 0x9736, 0x9735, 0x9733, 0x9732, 0x9731, 0x9730, // 16864
-    0x972e, 0x972d, 0x972c, 0x972b, 0x9729, 0x9728, 0x9727, 0x9725, // 16872
-    0x9724, 0x9723, 0x9722, 0x9720, 0x971f, 0x971e, 0x971d, 0x971b, // 16880
-    0x971a, 0x9719, 0x9718, 0x9716, 0x9715, 0x9714, 0x9713, 0x9711, // 16888
-    0x9710, 0x970f, 0x970d, 0x970c, 0x970b, 0x970a, 0x9708, 0x9707, // 16896
-    0x9706, 0x9705, 0x9703, 0x9702, 0x9701, 0x9700, 0x96fe, 0x96fd, // 16904
-    0x96fc, 0x96fb, 0x96f9, 0x96f8, 0x96f7, 0x96f5, 0x96f4, 0x96f3, // 16912
-    0x96f2, 0x96f0, 0x96ef, 0x96ee, 0x96ed, 0x96eb, 0x96ea, 0x96e9, // 16920
-    0x96e8, 0x96e6, 0x96e5, 0x96e4, 0x96e3, 0x96e1, 0x96e0, 0x96df, // 16928
-    0x96dd, 0x96dc, 0x96db, 0x96da, 0x96d8, 0x96d7, 0x96d6, 0x96d5, // 16936
-    0x96d3, 0x96d2, 0x96d1, 0x96d0, 0x96ce, 0x96cd, 0x96cc, 0x96ca, // 16944
-    0x96c9, 0x96c8, 0x96c7, 0x96c5, 0x96c4, 0x96c3, 0x96c2, 0x96c0, // 16952
-    0x96bf, 0x96be, 0x96bd, 0x96bb, 0x96ba, 0x96b9, 0x96b8, 0x96b6, // 16960
-    0x96b5, 0x96b4, 0x96b2, 0x96b1, 0x96b0, 0x96af, 0x96ad, 0x96ac, // 16968
-    0x96ab, 0x96aa, 0x96a8, 0x96a7, 0x96a6, 0x96a5, 0x96a3, 0x96a2, // 16976
-    0x96a1, 0x96a0, 0x969e, 0x969d, 0x969c, 0x969a, 0x9699, 0x9698, // 16984
-    0x9697, 0x9695, 0x9694, 0x9693, 0x9692, 0x9690, 0x968f, 0x968e, // 16992
-    0x968d, 0x968b, 0x968a, 0x9689, 0x9688, 0x9686, 0x9685, 0x9684, // 17000
-    0x9682, 0x9681, 0x9680, 0x967f, 0x967d, 0x967c, 0x967b, 0x967a, // 17008
-    0x9678, 0x9677, 0x9676, 0x9675, 0x9673, 0x9672, 0x9671, 0x9670, // 17016
-    0x966e, 0x966d, 0x966c, 0x966a, 0x9669, 0x9668, 0x9667, 0x9665, // 17024
-    0x9664, 0x9663, 0x9662, 0x9660, 0x965f, 0x965e, 0x965d, 0x965b, // 17032
-    0x965a, 0x9659, 0x9658, 0x9656, 0x9655, 0x9654, 0x9652, 0x9651, // 17040
-    0x9650, 0x964f, 0x964d, 0x964c, 0x964b, 0x964a, 0x9648, 0x9647, // 17048
-    0x9646, 0x9645, 0x9643, 0x9642, 0x9641, 0x963f, 0x963e, 0x963d, // 17056
-    0x963c, 0x963a, 0x9639, 0x9638, 0x9637, 0x9635, 0x9634, 0x9633, // 17064
-    0x9632, 0x9630, 0x962f, 0x962e, 0x962d, 0x962b, 0x962a, 0x9629, // 17072
-    0x9627, 0x9626, 0x9625, 0x9624, 0x9622, 0x9621, 0x9620, 0x961f, // 17080
-    0x961d, 0x961c, 0x961b, 0x961a, 0x9618, 0x9617, 0x9616, 0x9615, // 17088
-    0x9613, 0x9612, 0x9611, 0x960f, 0x960e, 0x960d, 0x960c, 0x960a, // 17096
-    0x9609, 0x9608, 0x9607, 0x9605, 0x9604, 0x9603, 0x9602, 0x9600, // 17104
-    0x95ff, 0x95fe, 0x95fd, 0x95fb, 0x95fa, 0x95f9, 0x95f7, 0x95f6, // 17112
-    0x95f5, 0x95f4, 0x95f2, 0x95f1, 0x95f0, 0x95ef, 0x95ed, 0x95ec, // 17120
-    0x95eb, 0x95ea, 0x95e8, 0x95e7, 0x95e6, 0x95e5, 0x95e3, 0x95e2, // 17128
-    0x95e1, 0x95df, 0x95de, 0x95dd, 0x95dc, 0x95da, 0x95d9, 0x95d8, // 17136
-    0x95d7, 0x95d5, 0x95d4, 0x95d3, 0x95d2, 0x95d0, 0x95cf, 0x95ce, // 17144
-    0x95cd, 0x95cb, 0x95ca, 0x95c9, 0x95c7, 0x95c6, 0x95c5, 0x95c4, // 17152
-    0x95c2, 0x95c1, 0x95c0, 0x95bf, 0x95bd, 0x95bc, 0x95bb, 0x95ba, // 17160
-    0x95b8, 0x95b7, 0x95b6, 0x95b4, 0x95b3, 0x95b2, 0x95b1, 0x95af, // 17168
-    0x95ae, 0x95ad, 0x95ac, 0x95aa, 0x95a9, 0x95a8, 0x95a7, 0x95a5, // 17176
-    0x95a4, 0x95a3, 0x95a2, 0x95a0, 0x959f, 0x959e, 0x959c, 0x959b, // 17184
-    0x959a, 0x9599, 0x9597, 0x9596, 0x9595, 0x9594, 0x9592, 0x9591, // 17192
-    0x9590, 0x958f, 0x958d, 0x958c, 0x958b, 0x958a, 0x9588, 0x9587, // 17200
-    0x9586, 0x9584, 0x9583, 0x9582, 0x9581, 0x957f, 0x957e, 0x957d, // 17208
-    0x957c, 0x957a, 0x9579, 0x9578, 0x9577, 0x9575, 0x9574, 0x9573, // 17216
-    0x9572, 0x9570, 0x956f, 0x956e, 0x956c, 0x956b, 0x956a, 0x9569, // 17224
-    0x9567, 0x9566, 0x9565, 0x9564, 0x9562, 0x9561, 0x9560, 0x955f, // 17232
-    0x955d, 0x955c, 0x955b, 0x955a, 0x9558, 0x9557, 0x9556, 0x9554, // 17240
-    0x9553, 0x9552, 0x9551, 0x954f, 0x954e, 0x954d, 0x954c, 0x954a, // 17248
-    0x9549, 0x9548, 0x9547, 0x9545, 0x9544, 0x9543, 0x9541, 0x9540, // 17256
-    0x953f, 0x953e, 0x953c, 0x953b, 0x953a, 0x9539, 0x9537, 0x9536, // 17264
-    0x9535, 0x9534, 0x9532, 0x9531, 0x9530, 0x952f, 0x952d, 0x952c, // 17272
-    0x952b, 0x9529, 0x9528, 0x9527, 0x9526, 0x9524, 0x9523, 0x9522, // 17280
-    0x9521, 0x951f, 0x951e, 0x951d, 0x951c, 0x951a, 0x9519, 0x9518, // 17288
-    0x9517, 0x9515, 0x9514, 0x9513, 0x9511, 0x9510, 0x950f, 0x950e, // 17296
-    0x950c, 0x950b, 0x950a, 0x9509, 0x9507, 0x9506, 0x9505, 0x9504, // 17304
-    0x9502, 0x9501, 0x9500, 0x94ff, 0x94fd, 0x94fc, 0x94fb, 0x94f9, // 17312
-    0x94f8, 0x94f7, 0x94f6, 0x94f4, 0x94f3, 0x94f2, 0x94f1, 0x94ef, // 17320
-    0x94ee, 0x94ed, 0x94ec, 0x94ea, 0x94e9, 0x94e8, 0x94e7, 0x94e5, // 17328
-    0x94e4, 0x94e3, 0x94e1, 0x94e0, 0x94df, 0x94de, 0x94dc, 0x94db, // 17336
-    0x94da, 0x94d9, 0x94d7, 0x94d6, 0x94d5, 0x94d4, 0x94d2, 0x94d1, // 17344
-    0x94d0, 0x94cf, 0x94cd, 0x94cc, 0x94cb, 0x94c9, 0x94c8, 0x94c7, // 17352
-    0x94c6, 0x94c4, 0x94c3, 0x94c2, 0x94c1, 0x94bf, 0x94be, 0x94bd, // 17360
-    0x94bc, 0x94ba, 0x94b9, 0x94b8, 0x94b6, 0x94b5, 0x94b4, 0x94b3, // 17368
-    0x94b1, 0x94b0, 0x94af, 0x94ae, 0x94ac, 0x94ab, 0x94aa, 0x94a9, // 17376
-    0x94a7, 0x94a6, 0x94a5, 0x94a4, 0x94a2, 0x94a1, 0x94a0, 0x949e, // 17384
-    0x949d, 0x949c, 0x949b, 0x9499, 0x9498, 0x9497, 0x9496, 0x9494, // 17392
-    0x9493, 0x9492, 0x9491, 0x948f, 0x948e, 0x948d, 0x948c, 0x948a, // 17400
-    0x9488, 0x9487, 0x9486, 0x9484, 0x9483, 0x9482, 0x9481, 0x947f, // 17408
-    0x947e, 0x947d, 0x947c, 0x947a, 0x9479, 0x9478, 0x9477, 0x9476, // 17416
-    0x9474, 0x9473, 0x9472, 0x9471, 0x946f, 0x946e, 0x946d, 0x946c, // 17424
-    0x946a, 0x9469, 0x9468, 0x9467, 0x9465, 0x9464, 0x9463, 0x9462, // 17432
-    0x9461, 0x945f, 0x945e, 0x945d, 0x945c, 0x945a, 0x9459, 0x9458, // 17440
-    0x9457, 0x9455, 0x9454, 0x9453, 0x9452, 0x9451, 0x944f, 0x944e, // 17448
-    0x944d, 0x944c, 0x944a, 0x9449, 0x9448, 0x9447, 0x9445, 0x9444, // 17456
-    0x9443, 0x9442, 0x9441, 0x943f, 0x943e, 0x943d, 0x943c, 0x943a, // 17464
-    0x9439, 0x9438, 0x9437, 0x9435, 0x9434, 0x9433, 0x9432, 0x9430, // 17472
-    0x942f, 0x942e, 0x942d, 0x942c, 0x942a, 0x9429, 0x9428, 0x9427, // 17480
-    0x9425, 0x9424, 0x9423, 0x9422, 0x9420, 0x941f, 0x941e, 0x941d, // 17488
-    0x941c, 0x941a, 0x9419, 0x9418, 0x9417, 0x9415, 0x9414, 0x9413, // 17496
-    0x9412, 0x9410, 0x940f, 0x940e, 0x940d, 0x940c, 0x940a, 0x9409, // 17504
-    0x9408, 0x9407, 0x9405, 0x9404, 0x9403, 0x9402, 0x9400, 0x93ff, // 17512
-    0x93fe, 0x93fd, 0x93fc, 0x93fa, 0x93f9, 0x93f8, 0x93f7, 0x93f5, // 17520
-    0x93f4, 0x93f3, 0x93f2, 0x93f0, 0x93ef, 0x93ee, 0x93ed, 0x93eb, // 17528
-    0x93ea, 0x93e9, 0x93e8, 0x93e7, 0x93e5, 0x93e4, 0x93e3, 0x93e2, // 17536
-    0x93e0, 0x93df, 0x93de, 0x93dd, 0x93db, 0x93da, 0x93d9, 0x93d8, // 17544
-    0x93d7, 0x93d5, 0x93d4, 0x93d3, 0x93d2, 0x93d0, 0x93cf, 0x93ce, // 17552
-    0x93cd, 0x93cb, 0x93ca, 0x93c9, 0x93c8, 0x93c7, 0x93c5, 0x93c4, // 17560
-    0x93c3, 0x93c2, 0x93c0, 0x93bf, 0x93be, 0x93bd, 0x93bb, 0x93ba, // 17568
-    0x93b9, 0x93b8, 0x93b6, 0x93b5, 0x93b4, 0x93b3, 0x93b2, 0x93b0, // 17576
-    0x93af, 0x93ae, 0x93ad, 0x93ab, 0x93aa, 0x93a9, 0x93a8, 0x93a6, // 17584
-    0x93a5, 0x93a4, 0x93a3, 0x93a2, 0x93a0, 0x939f, 0x939e, 0x939d, // 17592
-    0x939b, 0x939a, 0x9399, 0x9398, 0x9396, 0x9395, 0x9394, 0x9393, // 17600
-    0x9392, 0x9390, 0x938f, 0x938e, 0x938d, 0x938b, 0x938a, 0x9389, // 17608
-    0x9388, 0x9386, 0x9385, 0x9384, 0x9383, 0x9381, 0x9380, 0x937f, // 17616
-    0x937e, 0x937d, 0x937b, 0x937a, 0x9379, 0x9378, 0x9376, 0x9375, // 17624
-    0x9374, 0x9373, 0x9371, 0x9370, 0x936f, 0x936e, 0x936d, 0x936b, // 17632
-    0x936a, 0x9369, 0x9368, 0x9366, 0x9365, 0x9364, 0x9363, 0x9361, // 17640
-    0x9360, 0x935f, 0x935e, 0x935d, 0x935b, 0x935a, 0x9359, 0x9358, // 17648
-    0x9356, 0x9355, 0x9354, 0x9353, 0x9351, 0x9350, 0x934f, 0x934e, // 17656
-    0x934d, 0x934b, 0x934a, 0x9349, 0x9348, 0x9346, 0x9345, 0x9344, // 17664
-    0x9343, 0x9341, 0x9340, 0x933f, 0x933e, 0x933c, 0x933b, 0x933a, // 17672
-    0x9339, 0x9338, 0x9336, 0x9335, 0x9334, 0x9333, 0x9331, 0x9330, // 17680
-    0x932f, 0x932e, 0x932c, 0x932b, 0x932a, 0x9329, 0x9328, 0x9326, // 17688
-    0x9325, 0x9324, 0x9323, 0x9321, 0x9320, 0x931f, 0x931e, 0x931c, // 17696
-    0x931b, 0x931a, 0x9319, 0x9318, 0x9316, 0x9315, 0x9314, 0x9313, // 17704
-    0x9311, 0x9310, 0x930f, 0x930e, 0x930c, 0x930b, 0x930a, 0x9309, // 17712
-    0x9307, 0x9306, 0x9305, 0x9304, 0x9303, 0x9301, 0x9300, 0x92ff, // 17720
-    0x92fe, 0x92fc, 0x92fb, 0x92fa, 0x92f9, 0x92f7, 0x92f6, 0x92f5, // 17728
-    0x92f4, 0x92f3, 0x92f1, 0x92f0, 0x92ef, 0x92ee, 0x92ec, 0x92eb, // 17736
-    0x92ea, 0x92e9, 0x92e7, 0x92e6, 0x92e5, 0x92e4, 0x92e3, 0x92e1, // 17744
-    0x92e0, 0x92df, 0x92de, 0x92dc, 0x92db, 0x92da, 0x92d9, 0x92d7, // 17752
-    0x92d6, 0x92d5, 0x92d4, 0x92d2, 0x92d1, 0x92d0, 0x92cf, 0x92ce, // 17760
-    0x92cc, 0x92cb, 0x92ca, 0x92c9, 0x92c7, 0x92c6, 0x92c5, 0x92c4, // 17768
-    0x92c2, 0x92c1, 0x92c0, 0x92bf, 0x92be, 0x92bc, 0x92bb, 0x92ba, // 17776
-    0x92b9, 0x92b7, 0x92b6, 0x92b5, 0x92b4, 0x92b2, 0x92b1, 0x92b0, // 17784
-    0x92af, 0x92ae, 0x92ac, 0x92ab, 0x92aa, 0x92a9, 0x92a7, 0x92a6, // 17792
-    0x92a5, 0x92a4, 0x92a2, 0x92a1, 0x92a0, 0x929f, 0x929d, 0x929c, // 17800
-    0x929b, 0x929a, 0x9299, 0x9297, 0x9296, 0x9295, 0x9294, 0x9292, // 17808
-    0x9291, 0x9290, 0x928f, 0x928d, 0x928c, 0x928b, 0x928a, 0x9289, // 17816
-    0x9287, 0x9286, 0x9285, 0x9284, 0x9282, 0x9281, 0x9280, 0x927f, // 17824
-    0x927d, 0x927c, 0x927b, 0x927a, 0x9279, 0x9277, 0x9276, 0x9275, // 17832
-    0x9274, 0x9272, 0x9271, 0x9270, 0x926f, 0x926d, 0x926c, 0x926b, // 17840
-    0x926a, 0x9269, 0x9267, 0x9266, 0x9265, 0x9264, 0x9262, 0x9261, // 17848
-    0x9260, 0x925f, 0x925d, 0x925c, 0x925b, 0x925a, 0x9258, 0x9257, // 17856
-    0x9256, 0x9255, 0x9254, 0x9252, 0x9251, 0x9250, 0x924f, 0x924d, // 17864
-    0x924c, 0x924b, 0x924a, 0x9248, 0x9247, 0x9246, 0x9245, 0x9244, // 17872
-    0x9242, 0x9241, 0x9240, 0x923f, 0x923d, 0x923c, 0x923b, 0x923a, // 17880
-    0x9238, 0x9237, 0x9236, 0x9235, 0x9234, 0x9232, 0x9231, 0x9230, // 17888
-    0x922f, 0x922d, 0x922c, 0x922b, 0x922a, 0x9228, 0x9227, 0x9226, // 17896
-    0x9225, 0x9223, 0x9222, 0x9221, 0x9220, 0x921f, 0x921d, 0x921c, // 17904
-    0x921b, 0x921a, 0x9218, 0x9217, 0x9216, 0x9215, 0x9213, 0x9212, // 17912
-    0x9211, 0x9210, 0x920f, 0x920d, 0x920c, 0x920b, 0x920a, 0x9208, // 17920
-    0x9207, 0x9206, 0x9205, 0x9203, 0x9202, 0x9201, 0x9200, 0x91ff, // 17928
-    0x91fd, 0x91fc, 0x91fb, 0x91fa, 0x91f8, 0x91f7, 0x91f6, 0x91f5, // 17936
-    0x91f3, 0x91f2, 0x91f1, 0x91f0, 0x91ee, 0x91ed, 0x91ec, 0x91eb, // 17944
-    0x91ea, 0x91e8, 0x91e7, 0x91e6, 0x91e5, 0x91e3, 0x91e2, 0x91e1, // 17952
-    0x91e0, 0x91de, 0x91dd, 0x91dc, 0x91db, 0x91da, 0x91d8, 0x91d7, // 17960
-    0x91d6, 0x91d5, 0x91d3, 0x91d2, 0x91d1, 0x91d0, 0x91ce, 0x91cd, // 17968
-    0x91cc, 0x91cb, 0x91ca, 0x91c8, 0x91c7, 0x91c6, 0x91c5, 0x91c3, // 17976
-    0x91c2, 0x91c1, 0x91c0, 0x91be, 0x91bd, 0x91bc, 0x91bb, 0x91b9, // 17984
-    0x91b8, 0x91b7, 0x91b6, 0x91b5, 0x91b3, 0x91b2, 0x91b1, 0x91b0, // 17992
-    0x91ae, 0x91ad, 0x91ac, 0x91ab, 0x91a9, 0x91a8, 0x91a7, 0x91a6, // 18000
-    0x91a5, 0x91a3, 0x91a2, 0x91a1, 0x91a0, 0x919e, 0x919d, 0x919c, // 18008
-    0x919b, 0x9199, 0x9198, 0x9197, 0x9196, 0x9195, 0x9193, 0x9192, // 18016
-    0x9191, 0x9190, 0x918e, 0x918d, 0x918c, 0x918b, 0x9189, 0x9188, // 18024
-    0x9187, 0x9186, 0x9185, 0x9183, 0x9182, 0x9181, 0x9180, 0x917e, // 18032
-    0x917d, 0x917c, 0x917b, 0x9179, 0x9178, 0x9177, 0x9176, 0x9174, // 18040
-    0x9173, 0x9172, 0x9171, 0x9170, 0x916e, 0x916d, 0x916c, 0x916b, // 18048
-    0x9169, 0x9168, 0x9167, 0x9166, 0x9164, 0x9163, 0x9162, 0x9161, // 18056
-    0x9160, 0x915e, 0x915d, 0x915c, 0x915b, 0x9159, 0x9158, 0x9157, // 18064
-    0x9156, 0x9154, 0x9153, 0x9152, 0x9151, 0x9150, 0x914e, 0x914d, // 18072
-    0x914c, 0x914b, 0x9149, 0x9148, 0x9147, 0x9146, 0x9144, 0x9143, // 18080
-    0x9142, 0x9141, 0x913f, 0x913e, 0x913d, 0x913c, 0x913b, 0x9139, // 18088
-    0x9138, 0x9137, 0x9136, 0x9134, 0x9133, 0x9132, 0x9131, 0x912f, // 18096
-    0x912e, 0x912d, 0x912c, 0x912b, 0x9129, 0x9128, 0x9127, 0x9126, // 18104
-    0x9124, 0x9123, 0x9122, 0x9121, 0x911f, 0x911e, 0x911d, 0x911c, // 18112
-    0x911b, 0x9119, 0x9118, 0x9117, 0x9116, 0x9114, 0x9113, 0x9112, // 18120
-    0x9111, 0x910f, 0x910e, 0x910d, 0x910c, 0x910a, 0x9109, 0x9108, // 18128
-    0x9107, 0x9106, 0x9104, 0x9103, 0x9102, 0x9101, 0x90ff, 0x90fe, // 18136
-    0x90fd, 0x90fc, 0x90fa, 0x90f9, 0x90f8, 0x90f7, 0x90f6, 0x90f4, // 18144
-    0x90f3, 0x90f2, 0x90f1, 0x90ef, 0x90ee, 0x90ed, 0x90ec, 0x90ea, // 18152
-    0x90e9, 0x90e8, 0x90e7, 0x90e6, 0x90e4, 0x90e3, 0x90e2, 0x90e1, // 18160
-    0x90df, 0x90de, 0x90dd, 0x90dc, 0x90da, 0x90d9, 0x90d8, 0x90d7, // 18168
-    0x90d6, 0x90d4, 0x90d3, 0x90d2, 0x90d1, 0x90cf, 0x90ce, 0x90cd, // 18176
-    0x90cc, 0x90ca, 0x90c9, 0x90c8, 0x90c7, 0x90c5, 0x90c4, 0x90c3, // 18184
-    0x90c2, 0x90c1, 0x90bf, 0x90be, 0x90bd, 0x90bc, 0x90ba, 0x90b9, // 18192
-    0x90b8, 0x90b7, 0x90b5, 0x90b4, 0x90b3, 0x90b2, 0x90b1, 0x90af, // 18200
-    0x90ae, 0x90ad, 0x90ac, 0x90aa, 0x90a9, 0x90a8, 0x90a7, 0x90a5, // 18208
-    0x90a4, 0x90a3, 0x90a2, 0x90a1, 0x909f, 0x909e, 0x909d, 0x909c, // 18216
-    0x909a, 0x9099, 0x9098, 0x9097, 0x9095, 0x9094, 0x9093, 0x9092, // 18224
-    0x9090, 0x908f, 0x908e, 0x908d, 0x908c, 0x908a, 0x9089, 0x9088, // 18232
-    0x9087, 0x9085, 0x9084, 0x9083, 0x9082, 0x9080, 0x907f, 0x907e, // 18240
-    0x907d, 0x907c, 0x907a, 0x9079, 0x9078, 0x9077, 0x9075, 0x9074, // 18248
-    0x9073, 0x9072, 0x9070, 0x906f, 0x906e, 0x906d, 0x906c, 0x906a, // 18256
-    0x9069, 0x9068, 0x9067, 0x9065, 0x9064, 0x9063, 0x9062, 0x9060, // 18264
-    0x905f, 0x905e, 0x905d, 0x905b, 0x905a, 0x9059, 0x9058, 0x9057, // 18272
-    0x9055, 0x9054, 0x9053, 0x9052, 0x9050, 0x904f, 0x904e, 0x904d, // 18280
-    0x904b, 0x904a, 0x9049, 0x9048, 0x9047, 0x9045, 0x9044, 0x9043, // 18288
-    0x9042, 0x9040, 0x903f, 0x903e, 0x903d, 0x903b, 0x903a, 0x9039, // 18296
-    0x9038, 0x9037, 0x9035, 0x9034, 0x9033, 0x9032, 0x9030, 0x902f, // 18304
-    0x902e, 0x902d, 0x902b, 0x902a, 0x9029, 0x9028, 0x9026, 0x9025, // 18312
-    0x9024, 0x9023, 0x9022, 0x9020, 0x901f, 0x901e, 0x901d, 0x901b, // 18320
-    0x901a, 0x9019, 0x9018, 0x9016, 0x9015, 0x9014, 0x9013, 0x9012, // 18328
-    0x9010, 0x900f, 0x900e, 0x900d, 0x900b, 0x900a, 0x9009, 0x9008, // 18336
-    0x9006, 0x9005, 0x9004, 0x9003, 0x9002, 0x9000, 0x8fff, 0x8ffe, // 18344
-    0x8ffd, 0x8ffb, 0x8ffa, 0x8ff9, 0x8ff8, 0x8ff6, 0x8ff5, 0x8ff4, // 18352
-    0x8ff3, 0x8ff2, 0x8ff0, 0x8fef, 0x8fee, 0x8fed, 0x8feb, 0x8fea, // 18360
-    0x8fe9, 0x8fe8, 0x8fe6, 0x8fe5, 0x8fe4, 0x8fe3, 0x8fe1, 0x8fe0, // 18368
-    0x8fdf, 0x8fde, 0x8fdd, 0x8fdb, 0x8fda, 0x8fd9, 0x8fd8, 0x8fd6, // 18376
-    0x8fd5, 0x8fd4, 0x8fd3, 0x8fd1, 0x8fd0, 0x8fcf, 0x8fce, 0x8fcd, // 18384
-    0x8fcb, 0x8fca, 0x8fc9, 0x8fc8, 0x8fc6, 0x8fc5, 0x8fc4, 0x8fc3, // 18392
-    0x8fc1, 0x8fc0, 0x8fbf, 0x8fbe, 0x8fbd, 0x8fbb, 0x8fba, 0x8fb9, // 18400
-    0x8fb8, 0x8fb6, 0x8fb5, 0x8fb4, 0x8fb3, 0x8fb1, 0x8fb0, 0x8faf, // 18408
-    0x8fae, 0x8fac, 0x8fab, 0x8faa, 0x8fa9, 0x8fa8, 0x8fa6, 0x8fa5, // 18416
-    0x8fa4, 0x8fa3, 0x8fa1, 0x8fa0, 0x8f9f, 0x8f9e, 0x8f9c, 0x8f9b, // 18424
-    0x8f9b, 0x8f99, 0x8f98, 0x8f97, 0x8f96, 0x8f94, 0x8f93, 0x8f92, // 18432
-    0x8f91, 0x8f90, 0x8f8e, 0x8f8d, 0x8f8c, 0x8f8b, 0x8f8a, 0x8f88, // 18440
-    0x8f87, 0x8f86, 0x8f85, 0x8f84, 0x8f82, 0x8f81, 0x8f80, 0x8f7f, // 18448
-    0x8f7e, 0x8f7c, 0x8f7b, 0x8f7a, 0x8f79, 0x8f78, 0x8f76, 0x8f75, // 18456
-    0x8f74, 0x8f73, 0x8f72, 0x8f70, 0x8f6f, 0x8f6e, 0x8f6d, 0x8f6c, // 18464
-    0x8f6a, 0x8f69, 0x8f68, 0x8f67, 0x8f65, 0x8f64, 0x8f63, 0x8f62, // 18472
-    0x8f61, 0x8f5f, 0x8f5e, 0x8f5d, 0x8f5c, 0x8f5b, 0x8f59, 0x8f58, // 18480
-    0x8f57, 0x8f56, 0x8f55, 0x8f53, 0x8f52, 0x8f51, 0x8f50, 0x8f4f, // 18488
-    0x8f4d, 0x8f4c, 0x8f4b, 0x8f4a, 0x8f49, 0x8f47, 0x8f46, 0x8f45, // 18496
-    0x8f44, 0x8f43, 0x8f41, 0x8f40, 0x8f3f, 0x8f3e, 0x8f3d, 0x8f3b, // 18504
-    0x8f3a, 0x8f39, 0x8f38, 0x8f36, 0x8f35, 0x8f34, 0x8f33, 0x8f32, // 18512
-    0x8f30, 0x8f2f, 0x8f2e, 0x8f2d, 0x8f2c, 0x8f2a, 0x8f29, 0x8f28, // 18520
-    0x8f27, 0x8f26, 0x8f24, 0x8f23, 0x8f22, 0x8f21, 0x8f20, 0x8f1e, // 18528
-    0x8f1d, 0x8f1c, 0x8f1b, 0x8f1a, 0x8f18, 0x8f17, 0x8f16, 0x8f15, // 18536
-    0x8f14, 0x8f12, 0x8f11, 0x8f10, 0x8f0f, 0x8f0e, 0x8f0c, 0x8f0b, // 18544
-    0x8f0a, 0x8f09, 0x8f07, 0x8f06, 0x8f05, 0x8f04, 0x8f03, 0x8f01, // 18552
-    0x8f00, 0x8eff, 0x8efe, 0x8efd, 0x8efb, 0x8efa, 0x8ef9, 0x8ef8, // 18560
-    0x8ef7, 0x8ef5, 0x8ef4, 0x8ef3, 0x8ef2, 0x8ef1, 0x8eef, 0x8eee, // 18568
-    0x8eed, 0x8eec, 0x8eeb, 0x8ee9, 0x8ee8, 0x8ee7, 0x8ee6, 0x8ee5, // 18576
-    0x8ee3, 0x8ee2, 0x8ee1, 0x8ee0, 0x8edf, 0x8edd, 0x8edc, 0x8edb, // 18584
-    0x8eda, 0x8ed8, 0x8ed7, 0x8ed6, 0x8ed5, 0x8ed4, 0x8ed2, 0x8ed1, // 18592
-    0x8ed0, 0x8ecf, 0x8ece, 0x8ecc, 0x8ecb, 0x8eca, 0x8ec9, 0x8ec8, // 18600
-    0x8ec6, 0x8ec5, 0x8ec4, 0x8ec3, 0x8ec2, 0x8ec0, 0x8ebf, 0x8ebe, // 18608
-    0x8ebd, 0x8ebc, 0x8eba, 0x8eb9, 0x8eb8, 0x8eb7, 0x8eb6, 0x8eb4, // 18616
-    0x8eb3, 0x8eb2, 0x8eb1, 0x8eb0, 0x8eae, 0x8ead, 0x8eac, 0x8eab, // 18624
-    0x8ea9, 0x8ea8, 0x8ea7, 0x8ea6, 0x8ea5, 0x8ea3, 0x8ea2, 0x8ea1, // 18632
-    0x8ea0, 0x8e9f, 0x8e9d, 0x8e9c, 0x8e9b, 0x8e9a, 0x8e99, 0x8e97, // 18640
-    0x8e96, 0x8e95, 0x8e94, 0x8e93, 0x8e91, 0x8e90, 0x8e8f, 0x8e8e, // 18648
-    0x8e8d, 0x8e8b, 0x8e8a, 0x8e89, 0x8e88, 0x8e87, 0x8e85, 0x8e84, // 18656
-    0x8e83, 0x8e82, 0x8e81, 0x8e7f, 0x8e7e, 0x8e7d, 0x8e7c, 0x8e7a, // 18664
-    0x8e79, 0x8e78, 0x8e77, 0x8e76, 0x8e74, 0x8e73, 0x8e72, 0x8e71, // 18672
-    0x8e70, 0x8e6e, 0x8e6d, 0x8e6c, 0x8e6b, 0x8e6a, 0x8e68, 0x8e67, // 18680
-    0x8e66, 0x8e65, 0x8e64, 0x8e62, 0x8e61, 0x8e60, 0x8e5f, 0x8e5e, // 18688
-    0x8e5c, 0x8e5b, 0x8e5a, 0x8e59, 0x8e58, 0x8e56, 0x8e55, 0x8e54, // 18696
-    0x8e53, 0x8e52, 0x8e50, 0x8e4f, 0x8e4e, 0x8e4d, 0x8e4b, 0x8e4a, // 18704
-    0x8e49, 0x8e48, 0x8e47, 0x8e45, 0x8e44, 0x8e43, 0x8e42, 0x8e41, // 18712
-    0x8e3f, 0x8e3e, 0x8e3d, 0x8e3c, 0x8e3b, 0x8e39, 0x8e38, 0x8e37, // 18720
-    0x8e36, 0x8e35, 0x8e33, 0x8e32, 0x8e31, 0x8e30, 0x8e2f, 0x8e2d, // 18728
-    0x8e2c, 0x8e2b, 0x8e2a, 0x8e29, 0x8e27, 0x8e26, 0x8e25, 0x8e24, // 18736
-    0x8e23, 0x8e21, 0x8e20, 0x8e1f, 0x8e1e, 0x8e1c, 0x8e1b, 0x8e1a, // 18744
-    0x8e19, 0x8e18, 0x8e16, 0x8e15, 0x8e14, 0x8e13, 0x8e12, 0x8e10, // 18752
-    0x8e0f, 0x8e0e, 0x8e0d, 0x8e0c, 0x8e0a, 0x8e09, 0x8e08, 0x8e07, // 18760
-    0x8e06, 0x8e04, 0x8e03, 0x8e02, 0x8e01, 0x8e00, 0x8dfe, 0x8dfd, // 18768
-    0x8dfc, 0x8dfb, 0x8dfa, 0x8df8, 0x8df7, 0x8df6, 0x8df5, 0x8df4, // 18776
-    0x8df2, 0x8df1, 0x8df0, 0x8def, 0x8ded, 0x8dec, 0x8deb, 0x8dea, // 18784
-    0x8de9, 0x8de7, 0x8de6, 0x8de5, 0x8de4, 0x8de3, 0x8de1, 0x8de0, // 18792
-    0x8ddf, 0x8dde, 0x8ddd, 0x8ddb, 0x8dda, 0x8dd9, 0x8dd8, 0x8dd7, // 18800
-    0x8dd5, 0x8dd4, 0x8dd3, 0x8dd2, 0x8dd1, 0x8dcf, 0x8dce, 0x8dcd, // 18808
-    0x8dcc, 0x8dcb, 0x8dc9, 0x8dc8, 0x8dc7, 0x8dc6, 0x8dc5, 0x8dc3, // 18816
-    0x8dc2, 0x8dc1, 0x8dc0, 0x8dbe, 0x8dbd, 0x8dbc, 0x8dbb, 0x8dba, // 18824
-    0x8db8, 0x8db7, 0x8db6, 0x8db5, 0x8db4, 0x8db2, 0x8db1, 0x8db0, // 18832
-    0x8daf, 0x8dae, 0x8dac, 0x8dab, 0x8daa, 0x8da9, 0x8da8, 0x8da6, // 18840
-    0x8da5, 0x8da4, 0x8da3, 0x8da2, 0x8da0, 0x8d9f, 0x8d9e, 0x8d9d, // 18848
-    0x8d9c, 0x8d9a, 0x8d99, 0x8d98, 0x8d97, 0x8d96, 0x8d94, 0x8d93, // 18856
-    0x8d92, 0x8d91, 0x8d8f, 0x8d8e, 0x8d8d, 0x8d8c, 0x8d8b, 0x8d89, // 18864
-    0x8d88, 0x8d87, 0x8d86, 0x8d85, 0x8d83, 0x8d82, 0x8d81, 0x8d80, // 18872
-    0x8d7f, 0x8d7d, 0x8d7c, 0x8d7b, 0x8d7a, 0x8d79, 0x8d77, 0x8d76, // 18880
-    0x8d75, 0x8d74, 0x8d73, 0x8d71, 0x8d70, 0x8d6f, 0x8d6e, 0x8d6d, // 18888
-    0x8d6b, 0x8d6a, 0x8d69, 0x8d68, 0x8d67, 0x8d65, 0x8d64, 0x8d63, // 18896
-    0x8d62, 0x8d60, 0x8d5f, 0x8d5e, 0x8d5d, 0x8d5c, 0x8d5a, 0x8d59, // 18904
-    0x8d58, 0x8d57, 0x8d56, 0x8d54, 0x8d53, 0x8d52, 0x8d51, 0x8d50, // 18912
-    0x8d4e, 0x8d4d, 0x8d4c, 0x8d4b, 0x8d4a, 0x8d48, 0x8d47, 0x8d46, // 18920
-    0x8d45, 0x8d44, 0x8d42, 0x8d41, 0x8d40, 0x8d3f, 0x8d3e, 0x8d3c, // 18928
-    0x8d3b, 0x8d3a, 0x8d39, 0x8d38, 0x8d36, 0x8d35, 0x8d34, 0x8d33, // 18936
-    0x8d32, 0x8d30, 0x8d2f, 0x8d2e, 0x8d2d, 0x8d2b, 0x8d2a, 0x8d29, // 18944
-    0x8d28, 0x8d27, 0x8d25, 0x8d24, 0x8d23, 0x8d22, 0x8d21, 0x8d1f, // 18952
-    0x8d1e, 0x8d1d, 0x8d1c, 0x8d1b, 0x8d19, 0x8d18, 0x8d17, 0x8d16, // 18960
-    0x8d15, 0x8d13, 0x8d12, 0x8d11, 0x8d10, 0x8d0f, 0x8d0d, 0x8d0c, // 18968
-    0x8d0b, 0x8d0a, 0x8d09, 0x8d07, 0x8d06, 0x8d05, 0x8d04, 0x8d03, // 18976
-    0x8d01, 0x8d00, 0x8cff, 0x8cfe, 0x8cfc, 0x8cfb, 0x8cfa, 0x8cf9, // 18984
-    0x8cf8, 0x8cf6, 0x8cf5, 0x8cf4, 0x8cf3, 0x8cf2, 0x8cf0, 0x8cef, // 18992
-    0x8cee, 0x8ced, 0x8cec, 0x8cea, 0x8ce9, 0x8ce8, 0x8ce7, 0x8ce6, // 19000
-    0x8ce4, 0x8ce3, 0x8ce2, 0x8ce1, 0x8ce0, 0x8cde, 0x8cdd, 0x8cdc, // 19008
-    0x8cdb, 0x8cda, 0x8cd8, 0x8cd7, 0x8cd6, 0x8cd5, 0x8cd4, 0x8cd2, // 19016
-    0x8cd1, 0x8cd0, 0x8ccf, 0x8ccd, 0x8ccc, 0x8ccb, 0x8cca, 0x8cc9, // 19024
-    0x8cc7, 0x8cc6, 0x8cc5, 0x8cc4, 0x8cc3, 0x8cc1, 0x8cc0, 0x8cbf, // 19032
-    0x8cbe, 0x8cbd, 0x8cbb, 0x8cba, 0x8cb9, 0x8cb8, 0x8cb7, 0x8cb5, // 19040
-    0x8cb4, 0x8cb3, 0x8cb2, 0x8cb1, 0x8caf, 0x8cae, 0x8cad, 0x8cac, // 19048
-    0x8cab, 0x8ca9, 0x8ca8, 0x8ca7, 0x8ca6, 0x8ca5, 0x8ca3, 0x8ca2, // 19056
-    0x8ca1, 0x8ca0, 0x8c9e, 0x8c9d, 0x8c9c, 0x8c9b, 0x8c9a, 0x8c98, // 19064
-    0x8c97, 0x8c96, 0x8c95, 0x8c94, 0x8c92, 0x8c91, 0x8c90, 0x8c8f, // 19072
-    0x8c8e, 0x8c8c, 0x8c8b, 0x8c8a, 0x8c89, 0x8c88, 0x8c86, 0x8c85, // 19080
-    0x8c84, 0x8c83, 0x8c82, 0x8c80, 0x8c7f, 0x8c7e, 0x8c7d, 0x8c7c, // 19088
-    0x8c7a, 0x8c79, 0x8c78, 0x8c77, 0x8c76, 0x8c74, 0x8c73, 0x8c72, // 19096
-    0x8c71, 0x8c6f, 0x8c6e, 0x8c6d, 0x8c6c, 0x8c6b, 0x8c69, 0x8c68, // 19104
-    0x8c67, 0x8c66, 0x8c65, 0x8c63, 0x8c62, 0x8c61, 0x8c60, 0x8c5f, // 19112
-    0x8c5d, 0x8c5c, 0x8c5b, 0x8c5a, 0x8c59, 0x8c57, 0x8c56, 0x8c55, // 19120
-    0x8c54, 0x8c53, 0x8c51, 0x8c50, 0x8c4f, 0x8c4e, 0x8c4d, 0x8c4b, // 19128
-    0x8c4a, 0x8c49, 0x8c48, 0x8c47, 0x8c45, 0x8c44, 0x8c43, 0x8c42, // 19136
-    0x8c40, 0x8c3f, 0x8c3e, 0x8c3d, 0x8c3c, 0x8c3a, 0x8c39, 0x8c38, // 19144
-    0x8c37, 0x8c36, 0x8c34, 0x8c33, 0x8c32, 0x8c31, 0x8c30, 0x8c2e, // 19152
-    0x8c2d, 0x8c2c, 0x8c2b, 0x8c2a, 0x8c28, 0x8c27, 0x8c26, 0x8c25, // 19160
-    0x8c24, 0x8c22, 0x8c21, 0x8c20, 0x8c1f, 0x8c1e, 0x8c1c, 0x8c1b, // 19168
-    0x8c1a, 0x8c19, 0x8c18, 0x8c16, 0x8c15, 0x8c14, 0x8c13, 0x8c11, // 19176
-    0x8c10, 0x8c0f, 0x8c0e, 0x8c0d, 0x8c0b, 0x8c0a, 0x8c09, 0x8c08, // 19184
-    0x8c07, 0x8c05, 0x8c04, 0x8c03, 0x8c02, 0x8c01, 0x8bff, 0x8bfe, // 19192
-    0x8bfd, 0x8bfc, 0x8bfb, 0x8bf9, 0x8bf8, 0x8bf7, 0x8bf6, 0x8bf5, // 19200
-    0x8bf3, 0x8bf2, 0x8bf1, 0x8bf0, 0x8bef, 0x8bed, 0x8bec, 0x8beb, // 19208
-    0x8bea, 0x8be9, 0x8be7, 0x8be6, 0x8be5, 0x8be4, 0x8be2, 0x8be1, // 19216
-    0x8be0, 0x8bdf, 0x8bde, 0x8bdc, 0x8bdb, 0x8bda, 0x8bd9, 0x8bd8, // 19224
-    0x8bd6, 0x8bd5, 0x8bd4, 0x8bd3, 0x8bd2, 0x8bd0, 0x8bcf, 0x8bce, // 19232
-    0x8bcd, 0x8bcc, 0x8bca, 0x8bc9, 0x8bc8, 0x8bc7, 0x8bc6, 0x8bc4, // 19240
-    0x8bc3, 0x8bc2, 0x8bc1, 0x8bc0, 0x8bbe, 0x8bbd, 0x8bbc, 0x8bbb, // 19248
-    0x8bba, 0x8bb8, 0x8bb7, 0x8bb6, 0x8bb5, 0x8bb3, 0x8bb2, 0x8bb1, // 19256
-    0x8bb0, 0x8baf, 0x8bad, 0x8bac, 0x8bab, 0x8baa, 0x8ba9, 0x8ba7, // 19264
-    0x8ba6, 0x8ba5, 0x8ba4, 0x8ba3, 0x8ba1, 0x8ba0, 0x8b9f, 0x8b9e, // 19272
-    0x8b9d, 0x8b9b, 0x8b9a, 0x8b99, 0x8b98, 0x8b97, 0x8b95, 0x8b94, // 19280
-    0x8b93, 0x8b92, 0x8b91, 0x8b8f, 0x8b8e, 0x8b8d, 0x8b8c, 0x8b8b, // 19288
-    0x8b89, 0x8b88, 0x8b87, 0x8b86, 0x8b84, 0x8b83, 0x8b82, 0x8b81, // 19296
-    0x8b80, 0x8b7e, 0x8b7d, 0x8b7c, 0x8b7b, 0x8b7a, 0x8b78, 0x8b77, // 19304
-    0x8b76, 0x8b75, 0x8b74, 0x8b72, 0x8b71, 0x8b70, 0x8b6f, 0x8b6e, // 19312
-    0x8b6c, 0x8b6b, 0x8b6a, 0x8b69, 0x8b68, 0x8b66, 0x8b65, 0x8b64, // 19320
-    0x8b63, 0x8b62, 0x8b60, 0x8b5f, 0x8b5e, 0x8b5d, 0x8b5c, 0x8b5a, // 19328
-    0x8b59, 0x8b58, 0x8b57, 0x8b55, 0x8b54, 0x8b53, 0x8b52, 0x8b51, // 19336
-    0x8b4f, 0x8b4e, 0x8b4d, 0x8b4c, 0x8b4b, 0x8b49, 0x8b48, 0x8b47, // 19344
-    0x8b46, 0x8b45, 0x8b43, 0x8b42, 0x8b41, 0x8b40, 0x8b3f, 0x8b3d, // 19352
-    0x8b3c, 0x8b3b, 0x8b3a, 0x8b39, 0x8b37, 0x8b36, 0x8b35, 0x8b34, // 19360
-    0x8b33, 0x8b31, 0x8b30, 0x8b2f, 0x8b2e, 0x8b2d, 0x8b2b, 0x8b2a, // 19368
-    0x8b29, 0x8b28, 0x8b26, 0x8b25, 0x8b24, 0x8b23, 0x8b22, 0x8b20, // 19376
-    0x8b1f, 0x8b1e, 0x8b1d, 0x8b1c, 0x8b1a, 0x8b19, 0x8b18, 0x8b17, // 19384
-    0x8b16, 0x8b14, 0x8b13, 0x8b12, 0x8b11, 0x8b10, 0x8b0e, 0x8b0d, // 19392
-    0x8b0c, 0x8b0b, 0x8b0a, 0x8b08, 0x8b07, 0x8b06, 0x8b05, 0x8b04, // 19400
-    0x8b02, 0x8b01, 0x8b00, 0x8aff, 0x8afe, 0x8afc, 0x8afb, 0x8afa, // 19408
-    0x8af9, 0x8af7, 0x8af6, 0x8af5, 0x8af4, 0x8af3, 0x8af1, 0x8af0, // 19416
-    0x8aef, 0x8aee, 0x8aed, 0x8aeb, 0x8aea, 0x8ae9, 0x8ae8, 0x8ae7, // 19424
-    0x8ae5, 0x8ae4, 0x8ae3, 0x8ae2, 0x8ae1, 0x8adf, 0x8ade, 0x8add, // 19432
-    0x8adc, 0x8adb, 0x8ad9, 0x8ad8, 0x8ad7, 0x8ad6, 0x8ad5, 0x8ad3, // 19440
-    0x8ad2, 0x8ad1, 0x8ad0, 0x8acf, 0x8acd, 0x8acc, 0x8acb, 0x8aca, // 19448
-    0x8ac9, 0x8ac8, 0x8ac7, 0x8ac5, 0x8ac4, 0x8ac3, 0x8ac2, 0x8ac1, // 19456
-    0x8ac0, 0x8abe, 0x8abd, 0x8abc, 0x8abb, 0x8aba, 0x8ab9, 0x8ab7, // 19464
-    0x8ab6, 0x8ab5, 0x8ab4, 0x8ab3, 0x8ab2, 0x8ab0, 0x8aaf, 0x8aae, // 19472
-    0x8aad, 0x8aac, 0x8aaa, 0x8aa9, 0x8aa8, 0x8aa7, 0x8aa6, 0x8aa5, // 19480
-    0x8aa3, 0x8aa2, 0x8aa1, 0x8aa0, 0x8a9f, 0x8a9e, 0x8a9c, 0x8a9b, // 19488
-    0x8a9a, 0x8a99, 0x8a98, 0x8a97, 0x8a95, 0x8a94, 0x8a93, 0x8a92, // 19496
-    0x8a91, 0x8a8f, 0x8a8e, 0x8a8d, 0x8a8c, 0x8a8b, 0x8a8a, 0x8a88, // 19504
-    0x8a87, 0x8a86, 0x8a85, 0x8a84, 0x8a83, 0x8a81, 0x8a80, 0x8a7f, // 19512
-    0x8a7e, 0x8a7d, 0x8a7c, 0x8a7a, 0x8a79, 0x8a78, 0x8a77, 0x8a76, // 19520
-    0x8a74, 0x8a73, 0x8a72, 0x8a71, 0x8a70, 0x8a6f, 0x8a6d, 0x8a6c, // 19528
-    0x8a6b, 0x8a6a, 0x8a69, 0x8a68, 0x8a66, 0x8a65, 0x8a64, 0x8a63, // 19536
-    0x8a62, 0x8a61, 0x8a5f, 0x8a5e, 0x8a5d, 0x8a5c, 0x8a5b, 0x8a59, // 19544
-    0x8a58, 0x8a57, 0x8a56, 0x8a55, 0x8a54, 0x8a52, 0x8a51, 0x8a50, // 19552
-    0x8a4f, 0x8a4e, 0x8a4d, 0x8a4b, 0x8a4a, 0x8a49, 0x8a48, 0x8a47, // 19560
-    0x8a46, 0x8a44, 0x8a43, 0x8a42, 0x8a41, 0x8a40, 0x8a3e, 0x8a3d, // 19568
-    0x8a3c, 0x8a3b, 0x8a3a, 0x8a39, 0x8a37, 0x8a36, 0x8a35, 0x8a34, // 19576
-    0x8a33, 0x8a32, 0x8a30, 0x8a2f, 0x8a2e, 0x8a2d, 0x8a2c, 0x8a2b, // 19584
-    0x8a29, 0x8a28, 0x8a27, 0x8a26, 0x8a25, 0x8a23, 0x8a22, 0x8a21, // 19592
-    0x8a20, 0x8a1f, 0x8a1e, 0x8a1c, 0x8a1b, 0x8a1a, 0x8a19, 0x8a18, // 19600
-    0x8a17, 0x8a15, 0x8a14, 0x8a13, 0x8a12, 0x8a11, 0x8a10, 0x8a0e, // 19608
-    0x8a0d, 0x8a0c, 0x8a0b, 0x8a0a, 0x8a08, 0x8a07, 0x8a06, 0x8a05, // 19616
-    0x8a04, 0x8a03, 0x8a01, 0x8a00, 0x89ff, 0x89fe, 0x89fd, 0x89fc, // 19624
-    0x89fa, 0x89f9, 0x89f8, 0x89f7, 0x89f6, 0x89f5, 0x89f3, 0x89f2, // 19632
-    0x89f1, 0x89f0, 0x89ef, 0x89ed, 0x89ec, 0x89eb, 0x89ea, 0x89e9, // 19640
-    0x89e8, 0x89e6, 0x89e5, 0x89e4, 0x89e3, 0x89e2, 0x89e1, 0x89df, // 19648
-    0x89de, 0x89dd, 0x89dc, 0x89db, 0x89da, 0x89d8, 0x89d7, 0x89d6, // 19656
-    0x89d5, 0x89d4, 0x89d2, 0x89d1, 0x89d0, 0x89cf, 0x89ce, 0x89cd, // 19664
-    0x89cb, 0x89ca, 0x89c9, 0x89c8, 0x89c7, 0x89c6, 0x89c4, 0x89c3, // 19672
-    0x89c2, 0x89c1, 0x89c0, 0x89bf, 0x89bd, 0x89bc, 0x89bb, 0x89ba, // 19680
-    0x89b9, 0x89b7, 0x89b6, 0x89b5, 0x89b4, 0x89b3, 0x89b2, 0x89b0, // 19688
-    0x89af, 0x89ae, 0x89ad, 0x89ac, 0x89ab, 0x89a9, 0x89a8, 0x89a7, // 19696
-    0x89a6, 0x89a5, 0x89a4, 0x89a2, 0x89a1, 0x89a0, 0x899f, 0x899e, // 19704
-    0x899d, 0x899b, 0x899a, 0x8999, 0x8998, 0x8997, 0x8995, 0x8994, // 19712
-    0x8993, 0x8992, 0x8991, 0x8990, 0x898e, 0x898d, 0x898c, 0x898b, // 19720
-    0x898a, 0x8989, 0x8987, 0x8986, 0x8985, 0x8984, 0x8983, 0x8982, // 19728
-    0x8980, 0x897f, 0x897e, 0x897d, 0x897c, 0x897a, 0x8979, 0x8978, // 19736
-    0x8977, 0x8976, 0x8975, 0x8973, 0x8972, 0x8971, 0x8970, 0x896f, // 19744
-    0x896e, 0x896c, 0x896b, 0x896a, 0x8969, 0x8968, 0x8967, 0x8965, // 19752
-    0x8964, 0x8963, 0x8962, 0x8961, 0x895f, 0x895e, 0x895d, 0x895c, // 19760
-    0x895b, 0x895a, 0x8958, 0x8957, 0x8956, 0x8955, 0x8954, 0x8953, // 19768
-    0x8951, 0x8950, 0x894f, 0x894e, 0x894d, 0x894c, 0x894a, 0x8949, // 19776
-    0x8948, 0x8947, 0x8946, 0x8944, 0x8943, 0x8942, 0x8941, 0x8940, // 19784
-    0x893f, 0x893d, 0x893c, 0x893b, 0x893a, 0x8939, 0x8938, 0x8936, // 19792
-    0x8935, 0x8934, 0x8933, 0x8932, 0x8931, 0x892f, 0x892e, 0x892d, // 19800
-    0x892c, 0x892b, 0x8929, 0x8928, 0x8927, 0x8926, 0x8925, 0x8924, // 19808
-    0x8922, 0x8921, 0x8920, 0x891f, 0x891e, 0x891d, 0x891b, 0x891a, // 19816
-    0x8919, 0x8918, 0x8917, 0x8916, 0x8914, 0x8913, 0x8912, 0x8911, // 19824
-    0x8910, 0x890e, 0x890d, 0x890c, 0x890b, 0x890a, 0x8909, 0x8907, // 19832
-    0x8906, 0x8905, 0x8904, 0x8903, 0x8902, 0x8900, 0x88ff, 0x88fe, // 19840
-    0x88fd, 0x88fc, 0x88fb, 0x88f9, 0x88f8, 0x88f7, 0x88f6, 0x88f5, // 19848
-    0x88f3, 0x88f2, 0x88f1, 0x88f0, 0x88ef, 0x88ee, 0x88ec, 0x88eb, // 19856
-    0x88ea, 0x88e9, 0x88e8, 0x88e7, 0x88e5, 0x88e4, 0x88e3, 0x88e2, // 19864
-    0x88e1, 0x88e0, 0x88de, 0x88dd, 0x88dc, 0x88db, 0x88da, 0x88d8, // 19872
-    0x88d7, 0x88d6, 0x88d5, 0x88d4, 0x88d3, 0x88d1, 0x88d0, 0x88cf, // 19880
-    0x88ce, 0x88cd, 0x88cc, 0x88ca, 0x88c9, 0x88c8, 0x88c7, 0x88c6, // 19888
-    0x88c5, 0x88c3, 0x88c2, 0x88c1, 0x88c0, 0x88bf, 0x88bd, 0x88bc, // 19896
-    0x88bb, 0x88ba, 0x88b9, 0x88b8, 0x88b6, 0x88b5, 0x88b4, 0x88b3, // 19904
-    0x88b2, 0x88b1, 0x88af, 0x88ae, 0x88ad, 0x88ac, 0x88ab, 0x88aa, // 19912
-    0x88a8, 0x88a7, 0x88a6, 0x88a5, 0x88a4, 0x88a2, 0x88a1, 0x88a0, // 19920
-    0x889f, 0x889e, 0x889d, 0x889b, 0x889a, 0x8899, 0x8898, 0x8897, // 19928
-    0x8896, 0x8894, 0x8893, 0x8892, 0x8891, 0x8890, 0x888f, 0x888d, // 19936
-    0x888c, 0x888b, 0x888a, 0x8889, 0x8887, 0x8886, 0x8885, 0x8884, // 19944
-    0x8883, 0x8882, 0x8880, 0x887f, 0x887e, 0x887d, 0x887c, 0x887b, // 19952
-    0x8879, 0x8878, 0x8877, 0x8876, 0x8875, 0x8874, 0x8872, 0x8871, // 19960
-    0x8870, 0x886f, 0x886e, 0x886c, 0x886b, 0x886a, 0x8869, 0x8868, // 19968
-    0x8867, 0x8865, 0x8864, 0x8863, 0x8862, 0x8861, 0x8860, 0x885e, // 19976
-    0x885d, 0x885c, 0x885b, 0x885a, 0x8859, 0x8857, 0x8856, 0x8855, // 19984
-    0x8854, 0x8853, 0x8851, 0x8850, 0x884f, 0x884e, 0x884d, 0x884c, // 19992
-    0x884a, 0x8849, 0x8848, 0x8847, 0x8846, 0x8845, 0x8843, 0x8842, // 20000
-    0x8841, 0x8840, 0x883f, 0x883e, 0x883c, 0x883b, 0x883a, 0x8839, // 20008
-    0x8838, 0x8836, 0x8835, 0x8834, 0x8833, 0x8832, 0x8831, 0x882f, // 20016
-    0x882e, 0x882d, 0x882c, 0x882b, 0x882a, 0x8828, 0x8827, 0x8826, // 20024
-    0x8825, 0x8824, 0x8823, 0x8821, 0x8820, 0x881f, 0x881e, 0x881d, // 20032
-    0x881b, 0x881a, 0x8819, 0x8818, 0x8817, 0x8816, 0x8814, 0x8813, // 20040
-    0x8812, 0x8811, 0x8810, 0x880f, 0x880d, 0x880c, 0x880b, 0x880a, // 20048
-    0x8809, 0x8808, 0x8806, 0x8805, 0x8804, 0x8803, 0x8802, 0x8800, // 20056
-    0x87ff, 0x87fe, 0x87fd, 0x87fc, 0x87fb, 0x87f9, 0x87f8, 0x87f7, // 20064
-    0x87f6, 0x87f5, 0x87f4, 0x87f2, 0x87f1, 0x87f0, 0x87ef, 0x87ee, // 20072
-    0x87ed, 0x87eb, 0x87ea, 0x87e9, 0x87e8, 0x87e7, 0x87e5, 0x87e4, // 20080
-    0x87e3, 0x87e2, 0x87e1, 0x87e0, 0x87de, 0x87dd, 0x87dc, 0x87db, // 20088
-    0x87da, 0x87d9, 0x87d7, 0x87d6, 0x87d5, 0x87d4, 0x87d3, 0x87d2, // 20096
-    0x87d0, 0x87cf, 0x87ce, 0x87cd, 0x87cc, 0x87ca, 0x87c9, 0x87c8, // 20104
-    0x87c7, 0x87c6, 0x87c5, 0x87c3, 0x87c2, 0x87c1, 0x87c0, 0x87bf, // 20112
-    0x87be, 0x87bc, 0x87bb, 0x87ba, 0x87b9, 0x87b8, 0x87b7, 0x87b5, // 20120
-    0x87b4, 0x87b3, 0x87b2, 0x87b1, 0x87af, 0x87ae, 0x87ad, 0x87ac, // 20128
-    0x87ab, 0x87aa, 0x87a8, 0x87a7, 0x87a6, 0x87a5, 0x87a4, 0x87a3, // 20136
-    0x87a1, 0x87a0, 0x879f, 0x879e, 0x879d, 0x879c, 0x879a, 0x8799, // 20144
-    0x8798, 0x8797, 0x8796, 0x8794, 0x8793, 0x8792, 0x8791, 0x8790, // 20152
-    0x878f, 0x878d, 0x878c, 0x878b, 0x878a, 0x8789, 0x8788, 0x8786, // 20160
-    0x8785, 0x8784, 0x8783, 0x8782, 0x8781, 0x877f, 0x877e, 0x877d, // 20168
-    0x877c, 0x877b, 0x8779, 0x8778, 0x8777, 0x8776, 0x8775, 0x8774, // 20176
-    0x8772, 0x8771, 0x8770, 0x876f, 0x876e, 0x876d, 0x876b, 0x876a, // 20184
-    0x8769, 0x8768, 0x8767, 0x8766, 0x8764, 0x8763, 0x8762, 0x8761, // 20192
-    0x8760, 0x875e, 0x875d, 0x875c, 0x875b, 0x875a, 0x8759, 0x8757, // 20200
-    0x8756, 0x8755, 0x8754, 0x8753, 0x8752, 0x8750, 0x874f, 0x874e, // 20208
-    0x874d, 0x874c, 0x874b, 0x8749, 0x8748, 0x8747, 0x8746, 0x8745, // 20216
-    0x8744, 0x8742, 0x8741, 0x8740, 0x873f, 0x873e, 0x873c, 0x873b, // 20224
-    0x873a, 0x8739, 0x8738, 0x8737, 0x8735, 0x8734, 0x8733, 0x8732, // 20232
-    0x8731, 0x8730, 0x872e, 0x872d, 0x872c, 0x872b, 0x872a, 0x8729, // 20240
-    0x8727, 0x8726, 0x8725, 0x8724, 0x8723, 0x8721, 0x8720, 0x871f, // 20248
-    0x871e, 0x871d, 0x871c, 0x871a, 0x8719, 0x8718, 0x8717, 0x8716, // 20256
-    0x8715, 0x8713, 0x8712, 0x8711, 0x8710, 0x870f, 0x870e, 0x870c, // 20264
-    0x870b, 0x870a, 0x8709, 0x8708, 0x8706, 0x8705, 0x8704, 0x8703, // 20272
-    0x8702, 0x8701, 0x86ff, 0x86fe, 0x86fd, 0x86fc, 0x86fb, 0x86fa, // 20280
-    0x86f8, 0x86f7, 0x86f6, 0x86f5, 0x86f4, 0x86f3, 0x86f1, 0x86f0, // 20288
-    0x86ef, 0x86ee, 0x86ed, 0x86eb, 0x86ea, 0x86e9, 0x86e8, 0x86e7, // 20296
-    0x86e6, 0x86e4, 0x86e3, 0x86e2, 0x86e1, 0x86e0, 0x86df, 0x86dd, // 20304
-    0x86dc, 0x86db, 0x86da, 0x86d9, 0x86d8, 0x86d6, 0x86d5, 0x86d4, // 20312
-    0x86d3, 0x86d2, 0x86d0, 0x86cf, 0x86ce, 0x86cd, 0x86cc, 0x86cb, // 20320
-    0x86c9, 0x86c8, 0x86c7, 0x86c6, 0x86c5, 0x86c4, 0x86c2, 0x86c1, // 20328
-    0x86c0, 0x86bf, 0x86be, 0x86bd, 0x86bb, 0x86ba, 0x86b9, 0x86b8, // 20336
-    0x86b7, 0x86b5, 0x86b4, 0x86b3, 0x86b2, 0x86b1, 0x86b0, 0x86ae, // 20344
-    0x86ad, 0x86ac, 0x86ab, 0x86aa, 0x86a9, 0x86a7, 0x86a6, 0x86a5, // 20352
-    0x86a4, 0x86a3, 0x86a2, 0x86a0, 0x869f, 0x869e, 0x869d, 0x869c, // 20360
-    0x869a, 0x8699, 0x8698, 0x8697, 0x8696, 0x8695, 0x8693, 0x8692, // 20368
-    0x8691, 0x8690, 0x868f, 0x868e, 0x868c, 0x868b, 0x868a, 0x8689, // 20376
-    0x8688, 0x8687, 0x8685, 0x8684, 0x8683, 0x8682, 0x8681, 0x867f, // 20384
-    0x867e, 0x867d, 0x867c, 0x867b, 0x867a, 0x8678, 0x8677, 0x8676, // 20392
-    0x8675, 0x8674, 0x8673, 0x8671, 0x8670, 0x866f, 0x866e, 0x866d, // 20400
-    0x866c, 0x866a, 0x8669, 0x8668, 0x8667, 0x8666, 0x8664, 0x8663, // 20408
-    0x8662, 0x8661, 0x8660, 0x865f, 0x865d, 0x865c, 0x865b, 0x865a, // 20416
-    0x8659, 0x8658, 0x8656, 0x8655, 0x8654, 0x8653, 0x8652, 0x8651, // 20424
-    0x864f, 0x864e, 0x864d, 0x864c, 0x864b, 0x8649, 0x8648, 0x8647, // 20432
-    0x8646, 0x8645, 0x8644, 0x8642, 0x8641, 0x8640, 0x863f, 0x863e, // 20440
-    0x863d, 0x863b, 0x863a, 0x8639, 0x8638, 0x8637, 0x8636, 0x8634, // 20448
-    0x8633, 0x8632, 0x8631, 0x8630, 0x862e, 0x862d, 0x862c, 0x862b, // 20456
-    0x862a, 0x8629, 0x8627, 0x8626, 0x8625, 0x8624, 0x8623, 0x8622, // 20464
-    0x8620, 0x861f, 0x861e, 0x861d, 0x861c, 0x861b, 0x8619, 0x8618, // 20472
-    0x8616, 0x8615, 0x8614, 0x8613, 0x8611, 0x8610, 0x860f, 0x860e, // 20480
-    0x860d, 0x860c, 0x860b, 0x8609, 0x8608, 0x8607, 0x8606, 0x8605, // 20488
-    0x8604, 0x8603, 0x8601, 0x8600, 0x85ff, 0x85fe, 0x85fd, 0x85fc, // 20496
-    0x85fa, 0x85f9, 0x85f8, 0x85f7, 0x85f6, 0x85f5, 0x85f4, 0x85f2, // 20504
-    0x85f1, 0x85f0, 0x85ef, 0x85ee, 0x85ed, 0x85ec, 0x85ea, 0x85e9, // 20512
-    0x85e8, 0x85e7, 0x85e6, 0x85e5, 0x85e4, 0x85e2, 0x85e1, 0x85e0, // 20520
-    0x85df, 0x85de, 0x85dd, 0x85dc, 0x85da, 0x85d9, 0x85d8, 0x85d7, // 20528
-    0x85d6, 0x85d5, 0x85d4, 0x85d2, 0x85d1, 0x85d0, 0x85cf, 0x85ce, // 20536
-    0x85cd, 0x85cb, 0x85ca, 0x85c9, 0x85c8, 0x85c7, 0x85c6, 0x85c5, // 20544
-    0x85c3, 0x85c2, 0x85c1, 0x85c0, 0x85bf, 0x85be, 0x85bd, 0x85bb, // 20552
-    0x85ba, 0x85b9, 0x85b8, 0x85b7, 0x85b6, 0x85b5, 0x85b3, 0x85b2, // 20560
-    0x85b1, 0x85b0, 0x85af, 0x85ae, 0x85ad, 0x85ab, 0x85aa, 0x85a9, // 20568
-    0x85a8, 0x85a7, 0x85a6, 0x85a4, 0x85a3, 0x85a2, 0x85a1, 0x85a0, // 20576
-    0x859f, 0x859e, 0x859c, 0x859b, 0x859a, 0x8599, 0x8598, 0x8597, // 20584
-    0x8596, 0x8594, 0x8593, 0x8592, 0x8591, 0x8590, 0x858f, 0x858e, // 20592
-    0x858c, 0x858b, 0x858a, 0x8589, 0x8588, 0x8587, 0x8586, 0x8584, // 20600
-    0x8583, 0x8582, 0x8581, 0x8580, 0x857f, 0x857e, 0x857c, 0x857b, // 20608
-    0x857a, 0x8579, 0x8578, 0x8577, 0x8575, 0x8574, 0x8573, 0x8572, // 20616
-    0x8571, 0x8570, 0x856f, 0x856d, 0x856c, 0x856b, 0x856a, 0x8569, // 20624
-    0x8568, 0x8567, 0x8565, 0x8564, 0x8563, 0x8562, 0x8561, 0x8560, // 20632
-    0x855f, 0x855d, 0x855c, 0x855b, 0x855a, 0x8559, 0x8558, 0x8557, // 20640
-    0x8555, 0x8554, 0x8553, 0x8552, 0x8551, 0x8550, 0x854f, 0x854d, // 20648
-    0x854c, 0x854b, 0x854a, 0x8549, 0x8548, 0x8546, 0x8545, 0x8544, // 20656
-    0x8543, 0x8542, 0x8541, 0x8540, 0x853e, 0x853d, 0x853c, 0x853b, // 20664
-    0x853a, 0x8539, 0x8538, 0x8536, 0x8535, 0x8534, 0x8533, 0x8532, // 20672
-    0x8531, 0x8530, 0x852e, 0x852d, 0x852c, 0x852b, 0x852a, 0x8529, // 20680
-    0x8528, 0x8526, 0x8525, 0x8524, 0x8523, 0x8522, 0x8521, 0x8520, // 20688
-    0x851e, 0x851d, 0x851c, 0x851b, 0x851a, 0x8519, 0x8517, 0x8516, // 20696
-    0x8515, 0x8514, 0x8513, 0x8512, 0x8511, 0x850f, 0x850e, 0x850d, // 20704
-    0x850c, 0x850b, 0x850a, 0x8509, 0x8507, 0x8506, 0x8505, 0x8504, // 20712
-    0x8503, 0x8502, 0x8501, 0x84ff, 0x84fe, 0x84fd, 0x84fc, 0x84fb, // 20720
-    0x84fa, 0x84f9, 0x84f7, 0x84f6, 0x84f5, 0x84f4, 0x84f3, 0x84f2, // 20728
-    0x84f1, 0x84ef, 0x84ee, 0x84ed, 0x84ec, 0x84eb, 0x84ea, 0x84e8, // 20736
-    0x84e7, 0x84e6, 0x84e5, 0x84e4, 0x84e3, 0x84e2, 0x84e0, 0x84df, // 20744
-    0x84de, 0x84dd, 0x84dc, 0x84db, 0x84da, 0x84d8, 0x84d7, 0x84d6, // 20752
-    0x84d5, 0x84d4, 0x84d3, 0x84d2, 0x84d0, 0x84cf, 0x84ce, 0x84cd, // 20760
-    0x84cc, 0x84cb, 0x84ca, 0x84c8, 0x84c7, 0x84c6, 0x84c5, 0x84c4, // 20768
-    0x84c3, 0x84c1, 0x84c0, 0x84bf, 0x84be, 0x84bd, 0x84bc, 0x84bb, // 20776
-    0x84b9, 0x84b8, 0x84b7, 0x84b6, 0x84b5, 0x84b4, 0x84b3, 0x84b1, // 20784
-    0x84b0, 0x84af, 0x84ae, 0x84ad, 0x84ac, 0x84ab, 0x84a9, 0x84a8, // 20792
-    0x84a7, 0x84a6, 0x84a5, 0x84a4, 0x84a3, 0x84a1, 0x84a0, 0x849f, // 20800
-    0x849e, 0x849d, 0x849c, 0x849b, 0x8499, 0x8498, 0x8497, 0x8496, // 20808
-    0x8495, 0x8494, 0x8492, 0x8491, 0x8490, 0x848f, 0x848e, 0x848d, // 20816
-    0x848c, 0x848a, 0x8489, 0x8488, 0x8487, 0x8486, 0x8485, 0x8484, // 20824
-    0x8482, 0x8481, 0x8480, 0x847f, 0x847e, 0x847d, 0x847c, 0x847a, // 20832
-    0x8479, 0x8478, 0x8477, 0x8476, 0x8475, 0x8474, 0x8472, 0x8471, // 20840
-    0x8470, 0x846f, 0x846e, 0x846d, 0x846c, 0x846a, 0x8469, 0x8468, // 20848
-    0x8467, 0x8466, 0x8465, 0x8463, 0x8462, 0x8461, 0x8460, 0x845f, // 20856
-    0x845e, 0x845d, 0x845b, 0x845a, 0x8459, 0x8458, 0x8457, 0x8456, // 20864
-    0x8455, 0x8453, 0x8452, 0x8451, 0x8450, 0x844f, 0x844e, 0x844d, // 20872
-    0x844b, 0x844a, 0x8449, 0x8448, 0x8447, 0x8446, 0x8445, 0x8443, // 20880
-    0x8442, 0x8441, 0x8440, 0x843f, 0x843e, 0x843d, 0x843b, 0x843a, // 20888
-    0x8439, 0x8438, 0x8437, 0x8436, 0x8434, 0x8433, 0x8432, 0x8431, // 20896
-    0x8430, 0x842f, 0x842e, 0x842c, 0x842b, 0x842a, 0x8429, 0x8428, // 20904
-    0x8427, 0x8426, 0x8424, 0x8423, 0x8422, 0x8421, 0x8420, 0x841f, // 20912
-    0x841e, 0x841c, 0x841b, 0x841a, 0x8419, 0x8418, 0x8417, 0x8416, // 20920
-    0x8414, 0x8413, 0x8412, 0x8411, 0x8410, 0x840f, 0x840d, 0x840c, // 20928
-    0x840b, 0x840a, 0x8409, 0x8408, 0x8407, 0x8405, 0x8404, 0x8403, // 20936
-    0x8402, 0x8401, 0x8400, 0x83ff, 0x83fd, 0x83fc, 0x83fb, 0x83fa, // 20944
-    0x83f9, 0x83f8, 0x83f7, 0x83f5, 0x83f4, 0x83f3, 0x83f2, 0x83f1, // 20952
-    0x83f0, 0x83ef, 0x83ed, 0x83ec, 0x83eb, 0x83ea, 0x83e9, 0x83e8, // 20960
-    0x83e7, 0x83e5, 0x83e4, 0x83e3, 0x83e2, 0x83e1, 0x83e0, 0x83de, // 20968
-    0x83dd, 0x83dc, 0x83db, 0x83da, 0x83d9, 0x83d8, 0x83d6, 0x83d5, // 20976
-    0x83d4, 0x83d3, 0x83d2, 0x83d1, 0x83d0, 0x83ce, 0x83cd, 0x83cc, // 20984
-    0x83cb, 0x83ca, 0x83c9, 0x83c8, 0x83c6, 0x83c5, 0x83c4, 0x83c3, // 20992
-    0x83c2, 0x83c1, 0x83c0, 0x83be, 0x83bd, 0x83bc, 0x83bb, 0x83ba, // 21000
-    0x83b9, 0x83b8, 0x83b6, 0x83b5, 0x83b4, 0x83b3, 0x83b2, 0x83b1, // 21008
-    0x83af, 0x83ae, 0x83ad, 0x83ac, 0x83ab, 0x83aa, 0x83a9, 0x83a7, // 21016
-    0x83a6, 0x83a5, 0x83a4, 0x83a3, 0x83a2, 0x83a1, 0x839f, 0x839e, // 21024
-    0x839d, 0x839c, 0x839b, 0x839a, 0x8399, 0x8397, 0x8396, 0x8395, // 21032
-    0x8394, 0x8393, 0x8392, 0x8391, 0x838f, 0x838e, 0x838d, 0x838c, // 21040
-    0x838b, 0x838a, 0x8389, 0x8387, 0x8386, 0x8385, 0x8384, 0x8383, // 21048
-    0x8382, 0x8380, 0x837f, 0x837e, 0x837d, 0x837c, 0x837b, 0x837a, // 21056
-    0x8378, 0x8377, 0x8376, 0x8375, 0x8374, 0x8373, 0x8372, 0x8370, // 21064
-    0x836f, 0x836e, 0x836d, 0x836c, 0x836b, 0x836a, 0x8368, 0x8367, // 21072
-    0x8366, 0x8365, 0x8364, 0x8363, 0x8362, 0x8360, 0x835f, 0x835e, // 21080
-    0x835d, 0x835c, 0x835b, 0x8359, 0x8358, 0x8357, 0x8356, 0x8355, // 21088
-    0x8354, 0x8353, 0x8351, 0x8350, 0x834f, 0x834e, 0x834d, 0x834c, // 21096
-    0x834b, 0x8349, 0x8348, 0x8347, 0x8346, 0x8345, 0x8344, 0x8343, // 21104
-    0x8341, 0x8340, 0x833f, 0x833e, 0x833d, 0x833c, 0x833b, 0x8339, // 21112
-    0x8338, 0x8337, 0x8336, 0x8335, 0x8334, 0x8333, 0x8331, 0x8330, // 21120
-    0x832f, 0x832e, 0x832d, 0x832c, 0x832a, 0x8329, 0x8328, 0x8327, // 21128
-    0x8326, 0x8325, 0x8324, 0x8322, 0x8321, 0x8320, 0x831f, 0x831e, // 21136
-    0x831d, 0x831c, 0x831a, 0x8319, 0x8318, 0x8317, 0x8316, 0x8315, // 21144
-    0x8314, 0x8312, 0x8311, 0x8310, 0x830f, 0x830e, 0x830d, 0x830c, // 21152
-    0x830a, 0x8309, 0x8308, 0x8307, 0x8306, 0x8305, 0x8304, 0x8302, // 21160
-    0x8301, 0x8300, 0x82ff, 0x82fe, 0x82fd, 0x82fb, 0x82fa, 0x82f9, // 21168
-    0x82f8, 0x82f7, 0x82f6, 0x82f5, 0x82f3, 0x82f2, 0x82f1, 0x82f0, // 21176
-    0x82ef, 0x82ee, 0x82ed, 0x82eb, 0x82ea, 0x82e9, 0x82e8, 0x82e7, // 21184
-    0x82e6, 0x82e5, 0x82e3, 0x82e2, 0x82e1, 0x82e0, 0x82df, 0x82de, // 21192
-    0x82dd, 0x82db, 0x82da, 0x82d9, 0x82d8, 0x82d7, 0x82d6, 0x82d5, // 21200
-    0x82d3, 0x82d2, 0x82d1, 0x82d0, 0x82cf, 0x82ce, 0x82cc, 0x82cb, // 21208
-    0x82ca, 0x82c9, 0x82c8, 0x82c7, 0x82c6, 0x82c4, 0x82c3, 0x82c2, // 21216
-    0x82c1, 0x82c0, 0x82bf, 0x82be, 0x82bc, 0x82bb, 0x82ba, 0x82b9, // 21224
-    0x82b8, 0x82b7, 0x82b6, 0x82b4, 0x82b3, 0x82b2, 0x82b1, 0x82b0, // 21232
-    0x82af, 0x82ae, 0x82ac, 0x82ab, 0x82aa, 0x82a9, 0x82a8, 0x82a7, // 21240
-    0x82a6, 0x82a4, 0x82a3, 0x82a2, 0x82a1, 0x82a0, 0x829f, 0x829d, // 21248
-    0x829c, 0x829b, 0x829a, 0x8299, 0x8298, 0x8297, 0x8295, 0x8294, // 21256
-    0x8293, 0x8292, 0x8291, 0x8290, 0x828f, 0x828d, 0x828c, 0x828b, // 21264
-    0x828a, 0x8289, 0x8288, 0x8287, 0x8285, 0x8284, 0x8283, 0x8282, // 21272
-    0x8281, 0x8280, 0x827f, 0x827d, 0x827c, 0x827b, 0x827a, 0x8279, // 21280
-    0x8278, 0x8276, 0x8275, 0x8274, 0x8273, 0x8272, 0x8271, 0x8270, // 21288
-    0x826e, 0x826d, 0x826c, 0x826b, 0x826a, 0x8269, 0x8268, 0x8266, // 21296
-    0x8265, 0x8264, 0x8263, 0x8262, 0x8261, 0x8260, 0x825e, 0x825d, // 21304
-    0x825c, 0x825b, 0x825a, 0x8259, 0x8258, 0x8256, 0x8255, 0x8254, // 21312
-    0x8253, 0x8252, 0x8251, 0x8250, 0x824e, 0x824d, 0x824c, 0x824b, // 21320
-    0x824a, 0x8249, 0x8247, 0x8246, 0x8245, 0x8244, 0x8243, 0x8242, // 21328
-    0x8241, 0x823f, 0x823e, 0x823d, 0x823c, 0x823b, 0x823a, 0x8239, // 21336
-    0x8237, 0x8236, 0x8235, 0x8234, 0x8233, 0x8232, 0x8231, 0x822f, // 21344
-    0x822e, 0x822d, 0x822c, 0x822b, 0x822a, 0x8229, 0x8227, 0x8226, // 21352
-    0x8225, 0x8224, 0x8223, 0x8222, 0x8221, 0x821f, 0x821e, 0x821d, // 21360
-    0x821c, 0x821b, 0x821a, 0x8218, 0x8217, 0x8216, 0x8215, 0x8214, // 21368
-    0x8213, 0x8212, 0x8210, 0x820f, 0x820e, 0x820d, 0x820c, 0x820b, // 21376
-    0x820a, 0x8208, 0x8207, 0x8206, 0x8205, 0x8204, 0x8203, 0x8202, // 21384
-    0x8200, 0x81ff, 0x81fe, 0x81fd, 0x81fc, 0x81fb, 0x81fa, 0x81f8, // 21392
-    0x81f7, 0x81f6, 0x81f5, 0x81f4, 0x81f3, 0x81f2, 0x81f0, 0x81ef, // 21400
-    0x81ee, 0x81ed, 0x81ec, 0x81eb, 0x81e9, 0x81e8, 0x81e7, 0x81e6, // 21408
-    0x81e5, 0x81e4, 0x81e3, 0x81e1, 0x81e0, 0x81df, 0x81de, 0x81dd, // 21416
-    0x81dc, 0x81db, 0x81d9, 0x81d8, 0x81d7, 0x81d6, 0x81d5, 0x81d4, // 21424
-    0x81d3, 0x81d1, 0x81d0, 0x81cf, 0x81ce, 0x81cd, 0x81cc, 0x81cb, // 21432
-    0x81c9, 0x81c8, 0x81c7, 0x81c6, 0x81c5, 0x81c4, 0x81c2, 0x81c1, // 21440
-    0x81c0, 0x81bf, 0x81be, 0x81bd, 0x81bc, 0x81ba, 0x81b9, 0x81b8, // 21448
-    0x81b7, 0x81b6, 0x81b5, 0x81b4, 0x81b2, 0x81b1, 0x81b0, 0x81af, // 21456
-    0x81ae, 0x81ad, 0x81ac, 0x81aa, 0x81a9, 0x81a8, 0x81a7, 0x81a6, // 21464
-    0x81a5, 0x81a4, 0x81a2, 0x81a1, 0x81a0, 0x819f, 0x819e, 0x819d, // 21472
-    0x819c, 0x819a, 0x8199, 0x8198, 0x8197, 0x8196, 0x8195, 0x8193, // 21480
-    0x8192, 0x8191, 0x8190, 0x818f, 0x818e, 0x818d, 0x818b, 0x818a, // 21488
-    0x8189, 0x8188, 0x8187, 0x8186, 0x8185, 0x8183, 0x8182, 0x8181, // 21496
-    0x817f, 0x817e, 0x817d, 0x817c, 0x817b, 0x8179, 0x8178, 0x8177, // 21504
-    0x8176, 0x8175, 0x8174, 0x8173, 0x8172, 0x8170, 0x816f, 0x816e, // 21512
-    0x816d, 0x816c, 0x816b, 0x816a, 0x8169, 0x8167, 0x8166, 0x8165, // 21520
-    0x8164, 0x8163, 0x8162, 0x8161, 0x8160, 0x815f, 0x815d, 0x815c, // 21528
-    0x815b, 0x815a, 0x8159, 0x8158, 0x8157, 0x8156, 0x8154, 0x8153, // 21536
-    0x8152, 0x8151, 0x8150, 0x814f, 0x814e, 0x814d, 0x814c, 0x814a, // 21544
-    0x8149, 0x8148, 0x8147, 0x8146, 0x8145, 0x8144, 0x8143, 0x8141, // 21552
-    0x8140, 0x813f, 0x813e, 0x813d, 0x813c, 0x813b, 0x813a, 0x8138, // 21560
-    0x8137, 0x8136, 0x8135, 0x8134, 0x8133, 0x8132, 0x8131, 0x8130, // 21568
-    0x812e, 0x812d, 0x812c, 0x812b, 0x812a, 0x8129, 0x8128, 0x8127, // 21576
-    0x8125, 0x8124, 0x8123, 0x8122, 0x8121, 0x8120, 0x811f, 0x811e, // 21584
-    0x811d, 0x811b, 0x811a, 0x8119, 0x8118, 0x8117, 0x8116, 0x8115, // 21592
-    0x8114, 0x8112, 0x8111, 0x8110, 0x810f, 0x810e, 0x810d, 0x810c, // 21600
-    0x810b, 0x8109, 0x8108, 0x8107, 0x8106, 0x8105, 0x8104, 0x8103, // 21608
-    0x8102, 0x8101, 0x80ff, 0x80fe, 0x80fd, 0x80fc, 0x80fb, 0x80fa, // 21616
-    0x80f9, 0x80f8, 0x80f6, 0x80f5, 0x80f4, 0x80f3, 0x80f2, 0x80f1, // 21624
-    0x80f0, 0x80ef, 0x80ee, 0x80ec, 0x80eb, 0x80ea, 0x80e9, 0x80e8, // 21632
-    0x80e7, 0x80e6, 0x80e5, 0x80e3, 0x80e2, 0x80e1, 0x80e0, 0x80df, // 21640
-    0x80de, 0x80dd, 0x80dc, 0x80da, 0x80d9, 0x80d8, 0x80d7, 0x80d6, // 21648
-    0x80d5, 0x80d4, 0x80d3, 0x80d2, 0x80d0, 0x80cf, 0x80ce, 0x80cd, // 21656
-    0x80cc, 0x80cb, 0x80ca, 0x80c9, 0x80c7, 0x80c6, 0x80c5, 0x80c4, // 21664
-    0x80c3, 0x80c2, 0x80c1, 0x80c0, 0x80bf, 0x80bd, 0x80bc, 0x80bb, // 21672
-    0x80ba, 0x80b9, 0x80b8, 0x80b7, 0x80b6, 0x80b4, 0x80b3, 0x80b2, // 21680
-    0x80b1, 0x80b0, 0x80af, 0x80ae, 0x80ad, 0x80ab, 0x80aa, 0x80a9, // 21688
-    0x80a8, 0x80a7, 0x80a6, 0x80a5, 0x80a4, 0x80a3, 0x80a1, 0x80a0, // 21696
-    0x809f, 0x809e, 0x809d, 0x809c, 0x809b, 0x809a, 0x8098, 0x8097, // 21704
-    0x8096, 0x8095, 0x8094, 0x8093, 0x8092, 0x8091, 0x8090, 0x808e, // 21712
-    0x808d, 0x808c, 0x808b, 0x808a, 0x8089, 0x8088, 0x8087, 0x8085, // 21720
-    0x8084, 0x8083, 0x8082, 0x8081, 0x8080, 0x807f, 0x807e, 0x807c, // 21728
-    0x807b, 0x807a, 0x8079, 0x8078, 0x8077, 0x8076, 0x8075, 0x8074, // 21736
-    0x8072, 0x8071, 0x8070, 0x806f, 0x806e, 0x806d, 0x806c, 0x806b, // 21744
-    0x8069, 0x8068, 0x8067, 0x8066, 0x8065, 0x8064, 0x8063, 0x8062, // 21752
-    0x8061, 0x805f, 0x805e, 0x805d, 0x805c, 0x805b, 0x805a, 0x8059, // 21760
-    0x8058, 0x8056, 0x8055, 0x8054, 0x8053, 0x8052, 0x8051, 0x8050, // 21768
-    0x804f, 0x804d, 0x804c, 0x804b, 0x804a, 0x8049, 0x8048, 0x8047, // 21776
-    0x8046, 0x8045, 0x8043, 0x8042, 0x8041, 0x8040, 0x803f, 0x803e, // 21784
-    0x803d, 0x803c, 0x803a, 0x8039, 0x8038, 0x8037, 0x8036, 0x8035, // 21792
-    0x8034, 0x8033, 0x8031, 0x8030, 0x802f, 0x802e, 0x802d, 0x802c, // 21800
-    0x802b, 0x802a, 0x8029, 0x8027, 0x8026, 0x8025, 0x8024, 0x8023, // 21808
-    0x8022, 0x8021, 0x8020, 0x801e, 0x801d, 0x801c, 0x801b, 0x801a, // 21816
-    0x8019, 0x8018, 0x8017, 0x8016, 0x8014, 0x8013, 0x8012, 0x8011, // 21824
-    0x8010, 0x800f, 0x800e, 0x800d, 0x800b, 0x800a, 0x8009, 0x8008, // 21832
-    0x8007, 0x8006, 0x8005, 0x8004, 0x8002, 0x8001, 0x8000, 0x7fff, // 21840
-    0x7ffe, 0x7ffd, 0x7ffc, 0x7ffb, 0x7ffa, 0x7ff8, 0x7ff7, 0x7ff6, // 21848
-    0x7ff5, 0x7ff4, 0x7ff3, 0x7ff2, 0x7ff1, 0x7fef, 0x7fee, 0x7fed, // 21856
-    0x7fec, 0x7feb, 0x7fea, 0x7fe9, 0x7fe8, 0x7fe7, 0x7fe5, 0x7fe4, // 21864
-    0x7fe3, 0x7fe2, 0x7fe1, 0x7fe0, 0x7fdf, 0x7fde, 0x7fdc, 0x7fdb, // 21872
-    0x7fda, 0x7fd9, 0x7fd8, 0x7fd7, 0x7fd6, 0x7fd5, 0x7fd3, 0x7fd2, // 21880
-    0x7fd1, 0x7fd0, 0x7fcf, 0x7fce, 0x7fcd, 0x7fcc, 0x7fcb, 0x7fc9, // 21888
-    0x7fc8, 0x7fc7, 0x7fc6, 0x7fc5, 0x7fc4, 0x7fc3, 0x7fc2, 0x7fc0, // 21896
-    0x7fbf, 0x7fbe, 0x7fbd, 0x7fbc, 0x7fbb, 0x7fba, 0x7fb9, 0x7fb8, // 21904
-    0x7fb6, 0x7fb5, 0x7fb4, 0x7fb3, 0x7fb2, 0x7fb1, 0x7fb0, 0x7faf, // 21912
-    0x7fad, 0x7fac, 0x7fab, 0x7faa, 0x7fa9, 0x7fa8, 0x7fa7, 0x7fa6, // 21920
-    0x7fa4, 0x7fa3, 0x7fa2, 0x7fa1, 0x7fa0, 0x7f9f, 0x7f9e, 0x7f9d, // 21928
-    0x7f9c, 0x7f9a, 0x7f99, 0x7f98, 0x7f97, 0x7f96, 0x7f95, 0x7f94, // 21936
-    0x7f93, 0x7f91, 0x7f90, 0x7f8f, 0x7f8e, 0x7f8d, 0x7f8c, 0x7f8b, // 21944
-    0x7f8a, 0x7f89, 0x7f87, 0x7f86, 0x7f85, 0x7f84, 0x7f83, 0x7f82, // 21952
-    0x7f81, 0x7f80, 0x7f7e, 0x7f7d, 0x7f7c, 0x7f7b, 0x7f7a, 0x7f79, // 21960
-    0x7f78, 0x7f77, 0x7f75, 0x7f74, 0x7f73, 0x7f72, 0x7f71, 0x7f70, // 21968
-    0x7f6f, 0x7f6e, 0x7f6d, 0x7f6b, 0x7f6a, 0x7f69, 0x7f68, 0x7f67, // 21976
-    0x7f66, 0x7f65, 0x7f64, 0x7f62, 0x7f61, 0x7f60, 0x7f5f, 0x7f5e, // 21984
-    0x7f5d, 0x7f5c, 0x7f5b, 0x7f5a, 0x7f58, 0x7f57, 0x7f56, 0x7f55, // 21992
-    0x7f54, 0x7f53, 0x7f52, 0x7f51, 0x7f4f, 0x7f4e, 0x7f4d, 0x7f4c, // 22000
-    0x7f4b, 0x7f4a, 0x7f49, 0x7f48, 0x7f46, 0x7f45, 0x7f44, 0x7f43, // 22008
-    0x7f42, 0x7f41, 0x7f40, 0x7f3f, 0x7f3e, 0x7f3c, 0x7f3b, 0x7f3a, // 22016
-    0x7f39, 0x7f38, 0x7f37, 0x7f36, 0x7f35, 0x7f33, 0x7f32, 0x7f31, // 22024
-    0x7f30, 0x7f2f, 0x7f2e, 0x7f2d, 0x7f2c, 0x7f2a, 0x7f29, 0x7f28, // 22032
-    0x7f27, 0x7f26, 0x7f25, 0x7f24, 0x7f23, 0x7f22, 0x7f20, 0x7f1f, // 22040
-    0x7f1e, 0x7f1d, 0x7f1c, 0x7f1b, 0x7f1a, 0x7f19, 0x7f17, 0x7f16, // 22048
-    0x7f15, 0x7f14, 0x7f13, 0x7f12, 0x7f11, 0x7f10, 0x7f0f, 0x7f0d, // 22056
-    0x7f0c, 0x7f0b, 0x7f0a, 0x7f09, 0x7f08, 0x7f07, 0x7f06, 0x7f04, // 22064
-    0x7f03, 0x7f02, 0x7f01, 0x7f00, 0x7eff, 0x7efe, 0x7efd, 0x7efb, // 22072
-    0x7efa, 0x7ef9, 0x7ef8, 0x7ef7, 0x7ef6, 0x7ef5, 0x7ef4, 0x7ef3, // 22080
-    0x7ef1, 0x7ef0, 0x7eef, 0x7eee, 0x7eed, 0x7eec, 0x7eeb, 0x7eea, // 22088
-    0x7ee8, 0x7ee7, 0x7ee6, 0x7ee5, 0x7ee4, 0x7ee3, 0x7ee2, 0x7ee1, // 22096
-    0x7ee0, 0x7ede, 0x7edd, 0x7edc, 0x7edb, 0x7eda, 0x7ed9, 0x7ed8, // 22104
-    0x7ed7, 0x7ed5, 0x7ed4, 0x7ed3, 0x7ed2, 0x7ed1, 0x7ed0, 0x7ecf, // 22112
-    0x7ece, 0x7ecc, 0x7ecb, 0x7eca, 0x7ec9, 0x7ec8, 0x7ec7, 0x7ec6, // 22120
-    0x7ec5, 0x7ec4, 0x7ec2, 0x7ec1, 0x7ec0, 0x7ebf, 0x7ebe, 0x7ebd, // 22128
-    0x7ebc, 0x7ebb, 0x7eb9, 0x7eb8, 0x7eb7, 0x7eb6, 0x7eb5, 0x7eb4, // 22136
-    0x7eb3, 0x7eb2, 0x7eb1, 0x7eaf, 0x7eae, 0x7ead, 0x7eac, 0x7eab, // 22144
-    0x7eaa, 0x7ea9, 0x7ea8, 0x7ea6, 0x7ea5, 0x7ea4, 0x7ea3, 0x7ea2, // 22152
-    0x7ea1, 0x7ea0, 0x7e9f, 0x7e9d, 0x7e9c, 0x7e9b, 0x7e9a, 0x7e99, // 22160
-    0x7e98, 0x7e97, 0x7e96, 0x7e95, 0x7e93, 0x7e92, 0x7e91, 0x7e90, // 22168
-    0x7e8f, 0x7e8e, 0x7e8d, 0x7e8c, 0x7e8a, 0x7e89, 0x7e88, 0x7e87, // 22176
-    0x7e86, 0x7e85, 0x7e84, 0x7e83, 0x7e82, 0x7e80, 0x7e7f, 0x7e7e, // 22184
-    0x7e7d, 0x7e7c, 0x7e7b, 0x7e7a, 0x7e79, 0x7e77, 0x7e76, 0x7e75, // 22192
-    0x7e74, 0x7e73, 0x7e72, 0x7e71, 0x7e70, 0x7e6e, 0x7e6d, 0x7e6c, // 22200
-    0x7e6b, 0x7e6a, 0x7e69, 0x7e68, 0x7e67, 0x7e66, 0x7e64, 0x7e63, // 22208
-    0x7e62, 0x7e61, 0x7e60, 0x7e5f, 0x7e5e, 0x7e5d, 0x7e5b, 0x7e5a, // 22216
-    0x7e59, 0x7e58, 0x7e57, 0x7e56, 0x7e55, 0x7e54, 0x7e53, 0x7e51, // 22224
-    0x7e50, 0x7e4f, 0x7e4e, 0x7e4d, 0x7e4c, 0x7e4b, 0x7e4a, 0x7e48, // 22232
-    0x7e47, 0x7e46, 0x7e45, 0x7e44, 0x7e43, 0x7e42, 0x7e41, 0x7e3f, // 22240
-    0x7e3e, 0x7e3d, 0x7e3c, 0x7e3b, 0x7e3a, 0x7e39, 0x7e38, 0x7e37, // 22248
-    0x7e35, 0x7e34, 0x7e33, 0x7e32, 0x7e31, 0x7e30, 0x7e2f, 0x7e2e, // 22256
-    0x7e2c, 0x7e2b, 0x7e2a, 0x7e29, 0x7e28, 0x7e27, 0x7e26, 0x7e25, // 22264
-    0x7e24, 0x7e22, 0x7e21, 0x7e20, 0x7e1f, 0x7e1e, 0x7e1d, 0x7e1c, // 22272
-    0x7e1b, 0x7e19, 0x7e18, 0x7e17, 0x7e16, 0x7e15, 0x7e14, 0x7e13, // 22280
-    0x7e12, 0x7e10, 0x7e0f, 0x7e0e, 0x7e0d, 0x7e0c, 0x7e0b, 0x7e0a, // 22288
-    0x7e09, 0x7e08, 0x7e06, 0x7e05, 0x7e04, 0x7e03, 0x7e02, 0x7e01, // 22296
-    0x7e00, 0x7dff, 0x7dfd, 0x7dfc, 0x7dfb, 0x7dfa, 0x7df9, 0x7df8, // 22304
-    0x7df7, 0x7df6, 0x7df4, 0x7df3, 0x7df2, 0x7df1, 0x7df0, 0x7def, // 22312
-    0x7dee, 0x7ded, 0x7dec, 0x7dea, 0x7de9, 0x7de8, 0x7de7, 0x7de6, // 22320
-    0x7de5, 0x7de4, 0x7de3, 0x7de1, 0x7de0, 0x7ddf, 0x7dde, 0x7ddd, // 22328
-    0x7ddc, 0x7ddb, 0x7dda, 0x7dd9, 0x7dd7, 0x7dd6, 0x7dd5, 0x7dd4, // 22336
-    0x7dd3, 0x7dd2, 0x7dd1, 0x7dd0, 0x7dce, 0x7dcd, 0x7dcc, 0x7dcb, // 22344
-    0x7dca, 0x7dc9, 0x7dc8, 0x7dc7, 0x7dc5, 0x7dc4, 0x7dc3, 0x7dc2, // 22352
-    0x7dc1, 0x7dc0, 0x7dbf, 0x7dbe, 0x7dbd, 0x7dbb, 0x7dba, 0x7db9, // 22360
-    0x7db8, 0x7db7, 0x7db6, 0x7db5, 0x7db4, 0x7db2, 0x7db1, 0x7db0, // 22368
-    0x7daf, 0x7dae, 0x7dad, 0x7dac, 0x7dab, 0x7daa, 0x7da8, 0x7da7, // 22376
-    0x7da6, 0x7da5, 0x7da4, 0x7da3, 0x7da2, 0x7da1, 0x7d9f, 0x7d9e, // 22384
-    0x7d9d, 0x7d9c, 0x7d9b, 0x7d9a, 0x7d99, 0x7d98, 0x7d96, 0x7d95, // 22392
-    0x7d94, 0x7d93, 0x7d92, 0x7d91, 0x7d90, 0x7d8f, 0x7d8e, 0x7d8c, // 22400
-    0x7d8b, 0x7d8a, 0x7d89, 0x7d88, 0x7d87, 0x7d86, 0x7d85, 0x7d83, // 22408
-    0x7d82, 0x7d81, 0x7d80, 0x7d7f, 0x7d7e, 0x7d7d, 0x7d7c, 0x7d7b, // 22416
-    0x7d79, 0x7d78, 0x7d77, 0x7d76, 0x7d75, 0x7d74, 0x7d73, 0x7d72, // 22424
-    0x7d70, 0x7d6f, 0x7d6e, 0x7d6d, 0x7d6c, 0x7d6b, 0x7d6a, 0x7d69, // 22432
-    0x7d67, 0x7d66, 0x7d65, 0x7d64, 0x7d63, 0x7d62, 0x7d61, 0x7d60, // 22440
-    0x7d5f, 0x7d5d, 0x7d5c, 0x7d5b, 0x7d5a, 0x7d59, 0x7d58, 0x7d57, // 22448
-    0x7d56, 0x7d54, 0x7d53, 0x7d52, 0x7d51, 0x7d50, 0x7d4f, 0x7d4e, // 22456
-    0x7d4d, 0x7d4c, 0x7d4a, 0x7d49, 0x7d48, 0x7d47, 0x7d46, 0x7d45, // 22464
-    0x7d44, 0x7d43, 0x7d41, 0x7d40, 0x7d3f, 0x7d3e, 0x7d3d, 0x7d3c, // 22472
-    0x7d3b, 0x7d3a, 0x7d38, 0x7d37, 0x7d36, 0x7d35, 0x7d34, 0x7d33, // 22480
-    0x7d32, 0x7d31, 0x7d30, 0x7d2e, 0x7d2d, 0x7d2c, 0x7d2b, 0x7d2a, // 22488
-    0x7d29, 0x7d28, 0x7d27, 0x7d25, 0x7d24, 0x7d23, 0x7d22, 0x7d21, // 22496
-    0x7d20, 0x7d1f, 0x7d1e, 0x7d1d, 0x7d1b, 0x7d1a, 0x7d19, 0x7d18, // 22504
-    0x7d17, 0x7d16, 0x7d15, 0x7d14, 0x7d12, 0x7d11, 0x7d10, 0x7d0f, // 22512
-    0x7d0e, 0x7d0d, 0x7d0c, 0x7d0b, 0x7d09, 0x7d08, 0x7d07, 0x7d06, // 22520
-    0x7d05, 0x7d03, 0x7d02, 0x7d01, 0x7d00, 0x7cff, 0x7cfe, 0x7cfd, // 22528
-    0x7cfc, 0x7cfb, 0x7cfa, 0x7cf8, 0x7cf7, 0x7cf6, 0x7cf5, 0x7cf4, // 22536
-    0x7cf3, 0x7cf2, 0x7cf1, 0x7cf0, 0x7cef, 0x7ced, 0x7cec, 0x7ceb, // 22544
-    0x7cea, 0x7ce9, 0x7ce8, 0x7ce7, 0x7ce6, 0x7ce5, 0x7ce4, 0x7ce3, // 22552
-    0x7ce1, 0x7ce0, 0x7cdf, 0x7cde, 0x7cdd, 0x7cdc, 0x7cdb, 0x7cda, // 22560
-    0x7cd9, 0x7cd8, 0x7cd6, 0x7cd5, 0x7cd4, 0x7cd3, 0x7cd2, 0x7cd1, // 22568
-    0x7cd0, 0x7ccf, 0x7cce, 0x7ccd, 0x7ccc, 0x7cca, 0x7cc9, 0x7cc8, // 22576
-    0x7cc7, 0x7cc6, 0x7cc5, 0x7cc4, 0x7cc3, 0x7cc2, 0x7cc1, 0x7cbf, // 22584
-    0x7cbe, 0x7cbd, 0x7cbc, 0x7cbb, 0x7cba, 0x7cb9, 0x7cb8, 0x7cb7, // 22592
-    0x7cb6, 0x7cb5, 0x7cb3, 0x7cb2, 0x7cb1, 0x7cb0, 0x7caf, 0x7cae, // 22600
-    0x7cad, 0x7cac, 0x7cab, 0x7caa, 0x7ca8, 0x7ca7, 0x7ca6, 0x7ca5, // 22608
-    0x7ca4, 0x7ca3, 0x7ca2, 0x7ca1, 0x7ca0, 0x7c9f, 0x7c9e, 0x7c9c, // 22616
-    0x7c9b, 0x7c9a, 0x7c99, 0x7c98, 0x7c97, 0x7c96, 0x7c95, 0x7c94, // 22624
-    0x7c93, 0x7c91, 0x7c90, 0x7c8f, 0x7c8e, 0x7c8d, 0x7c8c, 0x7c8b, // 22632
-    0x7c8a, 0x7c89, 0x7c88, 0x7c86, 0x7c85, 0x7c84, 0x7c83, 0x7c82, // 22640
-    0x7c81, 0x7c80, 0x7c7f, 0x7c7e, 0x7c7d, 0x7c7c, 0x7c7a, 0x7c79, // 22648
-    0x7c78, 0x7c77, 0x7c76, 0x7c75, 0x7c74, 0x7c73, 0x7c72, 0x7c71, // 22656
-    0x7c6f, 0x7c6e, 0x7c6d, 0x7c6c, 0x7c6b, 0x7c6a, 0x7c69, 0x7c68, // 22664
-    0x7c67, 0x7c66, 0x7c65, 0x7c63, 0x7c62, 0x7c61, 0x7c60, 0x7c5f, // 22672
-    0x7c5e, 0x7c5d, 0x7c5c, 0x7c5b, 0x7c5a, 0x7c58, 0x7c57, 0x7c56, // 22680
-    0x7c55, 0x7c54, 0x7c53, 0x7c52, 0x7c51, 0x7c50, 0x7c4f, 0x7c4e, // 22688
-    0x7c4c, 0x7c4b, 0x7c4a, 0x7c49, 0x7c48, 0x7c47, 0x7c46, 0x7c45, // 22696
-    0x7c44, 0x7c43, 0x7c41, 0x7c40, 0x7c3f, 0x7c3e, 0x7c3d, 0x7c3c, // 22704
-    0x7c3b, 0x7c3a, 0x7c39, 0x7c38, 0x7c37, 0x7c35, 0x7c34, 0x7c33, // 22712
-    0x7c32, 0x7c31, 0x7c30, 0x7c2f, 0x7c2e, 0x7c2d, 0x7c2c, 0x7c2a, // 22720
-    0x7c29, 0x7c28, 0x7c27, 0x7c26, 0x7c25, 0x7c24, 0x7c23, 0x7c22, // 22728
-    0x7c21, 0x7c1f, 0x7c1e, 0x7c1d, 0x7c1c, 0x7c1b, 0x7c1a, 0x7c19, // 22736
-    0x7c18, 0x7c17, 0x7c16, 0x7c15, 0x7c13, 0x7c12, 0x7c11, 0x7c10, // 22744
-    0x7c0f, 0x7c0e, 0x7c0d, 0x7c0c, 0x7c0b, 0x7c0a, 0x7c08, 0x7c07, // 22752
-    0x7c06, 0x7c05, 0x7c04, 0x7c03, 0x7c02, 0x7c01, 0x7c00, 0x7bff, // 22760
-    0x7bfe, 0x7bfc, 0x7bfb, 0x7bfa, 0x7bf9, 0x7bf8, 0x7bf7, 0x7bf6, // 22768
-    0x7bf5, 0x7bf4, 0x7bf3, 0x7bf1, 0x7bf0, 0x7bef, 0x7bee, 0x7bed, // 22776
-    0x7bec, 0x7beb, 0x7bea, 0x7be9, 0x7be8, 0x7be7, 0x7be5, 0x7be4, // 22784
-    0x7be3, 0x7be2, 0x7be1, 0x7be0, 0x7bdf, 0x7bde, 0x7bdd, 0x7bdc, // 22792
-    0x7bda, 0x7bd9, 0x7bd8, 0x7bd7, 0x7bd6, 0x7bd5, 0x7bd4, 0x7bd3, // 22800
-    0x7bd2, 0x7bd1, 0x7bd0, 0x7bce, 0x7bcd, 0x7bcc, 0x7bcb, 0x7bca, // 22808
-    0x7bc9, 0x7bc8, 0x7bc7, 0x7bc6, 0x7bc5, 0x7bc3, 0x7bc2, 0x7bc1, // 22816
-    0x7bc0, 0x7bbf, 0x7bbe, 0x7bbd, 0x7bbc, 0x7bbb, 0x7bba, 0x7bb9, // 22824
-    0x7bb7, 0x7bb6, 0x7bb5, 0x7bb4, 0x7bb3, 0x7bb2, 0x7bb1, 0x7bb0, // 22832
-    0x7baf, 0x7bae, 0x7bac, 0x7bab, 0x7baa, 0x7ba9, 0x7ba8, 0x7ba7, // 22840
-    0x7ba6, 0x7ba5, 0x7ba4, 0x7ba3, 0x7ba1, 0x7ba0, 0x7b9f, 0x7b9e, // 22848
-    0x7b9d, 0x7b9c, 0x7b9b, 0x7b9a, 0x7b99, 0x7b98, 0x7b97, 0x7b95, // 22856
-    0x7b94, 0x7b93, 0x7b92, 0x7b91, 0x7b90, 0x7b8f, 0x7b8e, 0x7b8d, // 22864
-    0x7b8c, 0x7b8a, 0x7b89, 0x7b88, 0x7b87, 0x7b86, 0x7b85, 0x7b84, // 22872
-    0x7b83, 0x7b82, 0x7b81, 0x7b80, 0x7b7e, 0x7b7d, 0x7b7c, 0x7b7b, // 22880
-    0x7b7a, 0x7b79, 0x7b78, 0x7b77, 0x7b76, 0x7b75, 0x7b73, 0x7b72, // 22888
-    0x7b71, 0x7b70, 0x7b6f, 0x7b6e, 0x7b6d, 0x7b6c, 0x7b6b, 0x7b6a, // 22896
-    0x7b69, 0x7b67, 0x7b66, 0x7b65, 0x7b64, 0x7b63, 0x7b62, 0x7b61, // 22904
-    0x7b60, 0x7b5f, 0x7b5e, 0x7b5c, 0x7b5b, 0x7b5a, 0x7b59, 0x7b58, // 22912
-    0x7b57, 0x7b56, 0x7b55, 0x7b54, 0x7b53, 0x7b52, 0x7b50, 0x7b4f, // 22920
-    0x7b4e, 0x7b4d, 0x7b4c, 0x7b4b, 0x7b4a, 0x7b49, 0x7b48, 0x7b47, // 22928
-    0x7b45, 0x7b44, 0x7b43, 0x7b42, 0x7b41, 0x7b40, 0x7b3f, 0x7b3e, // 22936
-    0x7b3d, 0x7b3c, 0x7b3a, 0x7b39, 0x7b38, 0x7b37, 0x7b36, 0x7b35, // 22944
-    0x7b34, 0x7b33, 0x7b32, 0x7b31, 0x7b30, 0x7b2e, 0x7b2d, 0x7b2c, // 22952
-    0x7b2b, 0x7b2a, 0x7b29, 0x7b28, 0x7b27, 0x7b26, 0x7b25, 0x7b23, // 22960
-    0x7b22, 0x7b21, 0x7b20, 0x7b1f, 0x7b1e, 0x7b1d, 0x7b1c, 0x7b1b, // 22968
-    0x7b1a, 0x7b19, 0x7b17, 0x7b16, 0x7b15, 0x7b14, 0x7b13, 0x7b12, // 22976
-    0x7b11, 0x7b10, 0x7b0f, 0x7b0e, 0x7b0c, 0x7b0b, 0x7b0a, 0x7b09, // 22984
-    0x7b08, 0x7b07, 0x7b06, 0x7b05, 0x7b04, 0x7b03, 0x7b02, 0x7b00, // 22992
-    0x7aff, 0x7afe, 0x7afd, 0x7afc, 0x7afb, 0x7afa, 0x7af9, 0x7af8, // 23000
-    0x7af7, 0x7af5, 0x7af4, 0x7af3, 0x7af2, 0x7af1, 0x7af0, 0x7aef, // 23008
-    0x7aee, 0x7aed, 0x7aec, 0x7aeb, 0x7ae9, 0x7ae8, 0x7ae7, 0x7ae6, // 23016
-    0x7ae5, 0x7ae4, 0x7ae3, 0x7ae2, 0x7ae1, 0x7ae0, 0x7ade, 0x7add, // 23024
-    0x7adc, 0x7adb, 0x7ada, 0x7ad9, 0x7ad8, 0x7ad7, 0x7ad6, 0x7ad5, // 23032
-    0x7ad4, 0x7ad2, 0x7ad1, 0x7ad0, 0x7acf, 0x7ace, 0x7acd, 0x7acc, // 23040
-    0x7acb, 0x7aca, 0x7ac9, 0x7ac7, 0x7ac6, 0x7ac5, 0x7ac4, 0x7ac3, // 23048
-    0x7ac2, 0x7ac1, 0x7ac0, 0x7abf, 0x7abe, 0x7abc, 0x7abb, 0x7aba, // 23056
-    0x7ab9, 0x7ab8, 0x7ab7, 0x7ab6, 0x7ab5, 0x7ab4, 0x7ab3, 0x7ab2, // 23064
-    0x7ab0, 0x7aaf, 0x7aae, 0x7aad, 0x7aac, 0x7aab, 0x7aaa, 0x7aa9, // 23072
-    0x7aa8, 0x7aa7, 0x7aa5, 0x7aa4, 0x7aa3, 0x7aa2, 0x7aa1, 0x7aa0, // 23080
-    0x7a9f, 0x7a9e, 0x7a9d, 0x7a9c, 0x7a9b, 0x7a99, 0x7a98, 0x7a97, // 23088
-    0x7a96, 0x7a95, 0x7a94, 0x7a93, 0x7a92, 0x7a91, 0x7a90, 0x7a8e, // 23096
-    0x7a8d, 0x7a8c, 0x7a8b, 0x7a8a, 0x7a89, 0x7a88, 0x7a87, 0x7a86, // 23104
-    0x7a85, 0x7a84, 0x7a82, 0x7a81, 0x7a80, 0x7a7f, 0x7a7e, 0x7a7d, // 23112
-    0x7a7c, 0x7a7b, 0x7a7a, 0x7a79, 0x7a77, 0x7a76, 0x7a75, 0x7a74, // 23120
-    0x7a73, 0x7a72, 0x7a71, 0x7a70, 0x7a6f, 0x7a6e, 0x7a6d, 0x7a6b, // 23128
-    0x7a6a, 0x7a69, 0x7a68, 0x7a67, 0x7a66, 0x7a65, 0x7a64, 0x7a63, // 23136
-    0x7a62, 0x7a60, 0x7a5f, 0x7a5e, 0x7a5d, 0x7a5c, 0x7a5b, 0x7a5a, // 23144
-    0x7a59, 0x7a58, 0x7a57, 0x7a55, 0x7a54, 0x7a53, 0x7a52, 0x7a51, // 23152
-    0x7a50, 0x7a4f, 0x7a4e, 0x7a4d, 0x7a4c, 0x7a4b, 0x7a49, 0x7a48, // 23160
-    0x7a47, 0x7a46, 0x7a45, 0x7a44, 0x7a43, 0x7a42, 0x7a41, 0x7a40, // 23168
-    0x7a3e, 0x7a3d, 0x7a3c, 0x7a3b, 0x7a3a, 0x7a39, 0x7a38, 0x7a37, // 23176
-    0x7a36, 0x7a35, 0x7a34, 0x7a32, 0x7a31, 0x7a30, 0x7a2f, 0x7a2e, // 23184
-    0x7a2d, 0x7a2c, 0x7a2b, 0x7a2a, 0x7a29, 0x7a27, 0x7a26, 0x7a25, // 23192
-    0x7a24, 0x7a23, 0x7a22, 0x7a21, 0x7a20, 0x7a1f, 0x7a1e, 0x7a1d, // 23200
-    0x7a1b, 0x7a1a, 0x7a19, 0x7a18, 0x7a17, 0x7a16, 0x7a15, 0x7a14, // 23208
-    0x7a13, 0x7a12, 0x7a10, 0x7a0f, 0x7a0e, 0x7a0d, 0x7a0c, 0x7a0b, // 23216
-    0x7a0a, 0x7a09, 0x7a08, 0x7a07, 0x7a06, 0x7a04, 0x7a03, 0x7a02, // 23224
-    0x7a01, 0x7a00, 0x79ff, 0x79fe, 0x79fd, 0x79fc, 0x79fb, 0x79f9, // 23232
-    0x79f8, 0x79f7, 0x79f6, 0x79f5, 0x79f4, 0x79f3, 0x79f2, 0x79f1, // 23240
-    0x79f0, 0x79ee, 0x79ed, 0x79ec, 0x79eb, 0x79ea, 0x79e9, 0x79e8, // 23248
-    0x79e7, 0x79e6, 0x79e5, 0x79e4, 0x79e2, 0x79e1, 0x79e0, 0x79df, // 23256
-    0x79de, 0x79dd, 0x79dc, 0x79db, 0x79da, 0x79d9, 0x79d7, 0x79d6, // 23264
-    0x79d5, 0x79d4, 0x79d3, 0x79d2, 0x79d1, 0x79d0, 0x79cf, 0x79ce, // 23272
-    0x79cd, 0x79cb, 0x79ca, 0x79c9, 0x79c8, 0x79c7, 0x79c6, 0x79c5, // 23280
-    0x79c4, 0x79c3, 0x79c2, 0x79c0, 0x79bf, 0x79be, 0x79bd, 0x79bc, // 23288
-    0x79bb, 0x79ba, 0x79b9, 0x79b8, 0x79b7, 0x79b6, 0x79b4, 0x79b3, // 23296
-    0x79b2, 0x79b1, 0x79b0, 0x79af, 0x79ae, 0x79ad, 0x79ac, 0x79ab, // 23304
-    0x79a9, 0x79a8, 0x79a7, 0x79a6, 0x79a5, 0x79a4, 0x79a3, 0x79a2, // 23312
-    0x79a1, 0x79a0, 0x799f, 0x799d, 0x799c, 0x799b, 0x799a, 0x7999, // 23320
-    0x7998, 0x7997, 0x7996, 0x7995, 0x7994, 0x7992, 0x7991, 0x7990, // 23328
-    0x798f, 0x798e, 0x798d, 0x798c, 0x798b, 0x798a, 0x7989, 0x7988, // 23336
-    0x7986, 0x7985, 0x7984, 0x7983, 0x7982, 0x7981, 0x7980, 0x797f, // 23344
-    0x797e, 0x797d, 0x797b, 0x797a, 0x7979, 0x7978, 0x7977, 0x7976, // 23352
-    0x7975, 0x7974, 0x7973, 0x7972, 0x7970, 0x796f, 0x796e, 0x796d, // 23360
-    0x796c, 0x796b, 0x796a, 0x7969, 0x7968, 0x7967, 0x7966, 0x7964, // 23368
-    0x7963, 0x7962, 0x7961, 0x7960, 0x795f, 0x795e, 0x795d, 0x795c, // 23376
-    0x795b, 0x7959, 0x7958, 0x7957, 0x7956, 0x7955, 0x7954, 0x7953, // 23384
-    0x7952, 0x7951, 0x7950, 0x794f, 0x794d, 0x794c, 0x794b, 0x794a, // 23392
-    0x7949, 0x7948, 0x7947, 0x7946, 0x7945, 0x7944, 0x7942, 0x7941, // 23400
-    0x7940, 0x793f, 0x793e, 0x793d, 0x793c, 0x793b, 0x793a, 0x7939, // 23408
-    0x7938, 0x7936, 0x7935, 0x7934, 0x7933, 0x7932, 0x7931, 0x7930, // 23416
-    0x792f, 0x792e, 0x792d, 0x792b, 0x792a, 0x7929, 0x7928, 0x7927, // 23424
-    0x7926, 0x7925, 0x7924, 0x7923, 0x7922, 0x7921, 0x791f, 0x791e, // 23432
-    0x791d, 0x791c, 0x791b, 0x791a, 0x7919, 0x7918, 0x7917, 0x7916, // 23440
-    0x7914, 0x7913, 0x7912, 0x7911, 0x7910, 0x790f, 0x790e, 0x790d, // 23448
-    0x790c, 0x790b, 0x7909, 0x7908, 0x7907, 0x7906, 0x7905, 0x7904, // 23456
-    0x7903, 0x7902, 0x7901, 0x7900, 0x78ff, 0x78fd, 0x78fc, 0x78fb, // 23464
-    0x78fa, 0x78f9, 0x78f8, 0x78f7, 0x78f6, 0x78f5, 0x78f4, 0x78f2, // 23472
-    0x78f1, 0x78f0, 0x78ef, 0x78ee, 0x78ed, 0x78ec, 0x78eb, 0x78ea, // 23480
-    0x78e9, 0x78e8, 0x78e6, 0x78e5, 0x78e4, 0x78e3, 0x78e2, 0x78e1, // 23488
-    0x78e0, 0x78df, 0x78de, 0x78dd, 0x78db, 0x78da, 0x78d9, 0x78d8, // 23496
-    0x78d7, 0x78d6, 0x78d5, 0x78d4, 0x78d3, 0x78d2, 0x78d1, 0x78cf, // 23504
-    0x78ce, 0x78cd, 0x78cc, 0x78cb, 0x78ca, 0x78c9, 0x78c8, 0x78c7, // 23512
-    0x78c6, 0x78c4, 0x78c3, 0x78c2, 0x78c1, 0x78c0, 0x78bf, 0x78be, // 23520
-    0x78bd, 0x78bc, 0x78bb, 0x78ba, 0x78b8, 0x78b7, 0x78b6, 0x78b5, // 23528
-    0x78b4, 0x78b3, 0x78b2, 0x78b1, 0x78b0, 0x78af, 0x78ad, 0x78ac, // 23536
-    0x78ab, 0x78aa, 0x78a9, 0x78a8, 0x78a7, 0x78a6, 0x78a5, 0x78a4, // 23544
-    0x78a2, 0x78a1, 0x78a0, 0x789f, 0x789e, 0x789d, 0x789c, 0x789b, // 23552
-    0x7899, 0x7898, 0x7897, 0x7896, 0x7895, 0x7894, 0x7893, 0x7892, // 23560
-    0x7891, 0x7890, 0x788f, 0x788e, 0x788d, 0x788c, 0x788a, 0x7889, // 23568
-    0x7888, 0x7887, 0x7886, 0x7885, 0x7884, 0x7883, 0x7882, 0x7881, // 23576
-    0x7880, 0x787f, 0x787e, 0x787d, 0x787c, 0x787a, 0x7879, 0x7878, // 23584
-    0x7877, 0x7876, 0x7875, 0x7874, 0x7873, 0x7872, 0x7871, 0x7870, // 23592
-    0x786f, 0x786e, 0x786d, 0x786c, 0x786a, 0x7869, 0x7868, 0x7867, // 23600
-    0x7866, 0x7865, 0x7864, 0x7863, 0x7862, 0x7861, 0x7860, 0x785f, // 23608
-    0x785e, 0x785d, 0x785b, 0x785a, 0x7859, 0x7858, 0x7857, 0x7856, // 23616
-    0x7855, 0x7854, 0x7853, 0x7852, 0x7851, 0x7850, 0x784f, 0x784e, // 23624
-    0x784d, 0x784b, 0x784a, 0x7849, 0x7848, 0x7847, 0x7846, 0x7845, // 23632
-    0x7844, 0x7843, 0x7842, 0x7841, 0x7840, 0x783f, 0x783e, 0x783d, // 23640
-    0x783b, 0x783a, 0x7839, 0x7838, 0x7837, 0x7836, 0x7835, 0x7834, // 23648
-    0x7833, 0x7832, 0x7831, 0x7830, 0x782f, 0x782e, 0x782c, 0x782b, // 23656
-    0x782a, 0x7829, 0x7828, 0x7827, 0x7826, 0x7825, 0x7824, 0x7823, // 23664
-    0x7822, 0x7821, 0x7820, 0x781f, 0x781e, 0x781c, 0x781b, 0x781a, // 23672
-    0x7819, 0x7818, 0x7817, 0x7816, 0x7815, 0x7814, 0x7813, 0x7812, // 23680
-    0x7811, 0x7810, 0x780f, 0x780d, 0x780c, 0x780b, 0x780a, 0x7809, // 23688
-    0x7808, 0x7807, 0x7806, 0x7805, 0x7804, 0x7803, 0x7802, 0x7801, // 23696
-    0x7800, 0x77ff, 0x77fd, 0x77fc, 0x77fb, 0x77fa, 0x77f9, 0x77f8, // 23704
-    0x77f7, 0x77f6, 0x77f5, 0x77f4, 0x77f3, 0x77f2, 0x77f1, 0x77f0, // 23712
-    0x77ef, 0x77ed, 0x77ec, 0x77eb, 0x77ea, 0x77e9, 0x77e8, 0x77e7, // 23720
-    0x77e6, 0x77e5, 0x77e4, 0x77e3, 0x77e2, 0x77e1, 0x77e0, 0x77de, // 23728
-    0x77dd, 0x77dc, 0x77db, 0x77da, 0x77d9, 0x77d8, 0x77d7, 0x77d6, // 23736
-    0x77d5, 0x77d4, 0x77d3, 0x77d2, 0x77d1, 0x77d0, 0x77ce, 0x77cd, // 23744
-    0x77cc, 0x77cb, 0x77ca, 0x77c9, 0x77c8, 0x77c7, 0x77c6, 0x77c5, // 23752
-    0x77c4, 0x77c3, 0x77c2, 0x77c1, 0x77c0, 0x77be, 0x77bd, 0x77bc, // 23760
-    0x77bb, 0x77ba, 0x77b9, 0x77b8, 0x77b7, 0x77b6, 0x77b5, 0x77b4, // 23768
-    0x77b3, 0x77b2, 0x77b1, 0x77af, 0x77ae, 0x77ad, 0x77ac, 0x77ab, // 23776
-    0x77aa, 0x77a9, 0x77a8, 0x77a7, 0x77a6, 0x77a5, 0x77a4, 0x77a3, // 23784
-    0x77a2, 0x77a1, 0x779f, 0x779e, 0x779d, 0x779c, 0x779b, 0x779a, // 23792
-    0x7799, 0x7798, 0x7797, 0x7796, 0x7795, 0x7794, 0x7793, 0x7792, // 23800
-    0x7791, 0x778f, 0x778e, 0x778d, 0x778c, 0x778b, 0x778a, 0x7789, // 23808
-    0x7788, 0x7787, 0x7786, 0x7785, 0x7784, 0x7783, 0x7782, 0x7780, // 23816
-    0x777f, 0x777e, 0x777d, 0x777c, 0x777b, 0x777a, 0x7779, 0x7778, // 23824
-    0x7777, 0x7776, 0x7775, 0x7774, 0x7773, 0x7772, 0x7770, 0x776f, // 23832
-    0x776e, 0x776d, 0x776c, 0x776b, 0x776a, 0x7769, 0x7768, 0x7767, // 23840
-    0x7766, 0x7765, 0x7764, 0x7763, 0x7761, 0x7760, 0x775f, 0x775e, // 23848
-    0x775d, 0x775c, 0x775b, 0x775a, 0x7759, 0x7758, 0x7757, 0x7756, // 23856
-    0x7755, 0x7754, 0x7753, 0x7751, 0x7750, 0x774f, 0x774e, 0x774d, // 23864
-    0x774c, 0x774b, 0x774a, 0x7749, 0x7748, 0x7747, 0x7746, 0x7745, // 23872
-    0x7744, 0x7743, 0x7741, 0x7740, 0x773f, 0x773e, 0x773d, 0x773c, // 23880
-    0x773b, 0x773a, 0x7739, 0x7738, 0x7737, 0x7736, 0x7735, 0x7734, // 23888
-    0x7732, 0x7731, 0x7730, 0x772f, 0x772e, 0x772d, 0x772c, 0x772b, // 23896
-    0x772a, 0x7729, 0x7728, 0x7727, 0x7726, 0x7725, 0x7724, 0x7722, // 23904
-    0x7721, 0x7720, 0x771f, 0x771e, 0x771d, 0x771c, 0x771b, 0x771a, // 23912
-    0x7719, 0x7718, 0x7717, 0x7716, 0x7715, 0x7714, 0x7712, 0x7711, // 23920
-    0x7710, 0x770f, 0x770e, 0x770d, 0x770c, 0x770b, 0x770a, 0x7709, // 23928
-    0x7708, 0x7707, 0x7706, 0x7705, 0x7703, 0x7702, 0x7701, 0x7700, // 23936
-    0x76ff, 0x76fe, 0x76fd, 0x76fc, 0x76fb, 0x76fa, 0x76f9, 0x76f8, // 23944
-    0x76f7, 0x76f6, 0x76f5, 0x76f3, 0x76f2, 0x76f1, 0x76f0, 0x76ef, // 23952
-    0x76ee, 0x76ed, 0x76ec, 0x76eb, 0x76ea, 0x76e9, 0x76e8, 0x76e7, // 23960
-    0x76e6, 0x76e4, 0x76e3, 0x76e2, 0x76e1, 0x76e0, 0x76df, 0x76de, // 23968
-    0x76dd, 0x76dc, 0x76db, 0x76da, 0x76d9, 0x76d8, 0x76d7, 0x76d6, // 23976
-    0x76d4, 0x76d3, 0x76d2, 0x76d1, 0x76d0, 0x76cf, 0x76ce, 0x76cd, // 23984
-    0x76cc, 0x76cb, 0x76ca, 0x76c9, 0x76c8, 0x76c7, 0x76c6, 0x76c4, // 23992
-    0x76c3, 0x76c2, 0x76c1, 0x76c0, 0x76bf, 0x76be, 0x76bd, 0x76bc, // 24000
-    0x76bb, 0x76ba, 0x76b9, 0x76b8, 0x76b7, 0x76b5, 0x76b4, 0x76b3, // 24008
-    0x76b2, 0x76b1, 0x76b0, 0x76af, 0x76ae, 0x76ad, 0x76ac, 0x76ab, // 24016
-    0x76aa, 0x76a9, 0x76a8, 0x76a7, 0x76a5, 0x76a4, 0x76a3, 0x76a2, // 24024
-    0x76a1, 0x76a0, 0x769f, 0x769e, 0x769d, 0x769c, 0x769b, 0x769a, // 24032
-    0x7699, 0x7698, 0x7697, 0x7695, 0x7694, 0x7693, 0x7692, 0x7691, // 24040
-    0x7690, 0x768f, 0x768e, 0x768d, 0x768c, 0x768b, 0x768a, 0x7689, // 24048
-    0x7688, 0x7686, 0x7685, 0x7684, 0x7683, 0x7682, 0x7681, 0x7680, // 24056
-    0x767f, 0x767e, 0x767d, 0x767c, 0x767b, 0x767a, 0x7679, 0x7678, // 24064
-    0x7676, 0x7675, 0x7674, 0x7673, 0x7672, 0x7671, 0x7670, 0x766f, // 24072
-    0x766e, 0x766d, 0x766c, 0x766b, 0x766a, 0x7669, 0x7667, 0x7666, // 24080
-    0x7665, 0x7664, 0x7663, 0x7662, 0x7661, 0x7660, 0x765f, 0x765e, // 24088
-    0x765d, 0x765c, 0x765b, 0x765a, 0x7659, 0x7657, 0x7656, 0x7655, // 24096
-    0x7654, 0x7653, 0x7652, 0x7651, 0x7650, 0x764f, 0x764e, 0x764d, // 24104
-    0x764c, 0x764b, 0x764a, 0x7649, 0x7647, 0x7646, 0x7645, 0x7644, // 24112
-    0x7643, 0x7642, 0x7641, 0x7640, 0x763f, 0x763e, 0x763d, 0x763c, // 24120
-    0x763b, 0x763a, 0x7638, 0x7637, 0x7636, 0x7635, 0x7634, 0x7633, // 24128
-    0x7632, 0x7631, 0x7630, 0x762f, 0x762e, 0x762d, 0x762c, 0x762b, // 24136
-    0x762a, 0x7628, 0x7627, 0x7626, 0x7625, 0x7624, 0x7623, 0x7622, // 24144
-    0x7621, 0x7620, 0x761f, 0x761e, 0x761d, 0x761c, 0x761b, 0x761a, // 24152
-    0x7618, 0x7617, 0x7616, 0x7615, 0x7614, 0x7613, 0x7612, 0x7611, // 24160
-    0x7610, 0x760f, 0x760e, 0x760d, 0x760c, 0x760b, 0x7609, 0x7608, // 24168
-    0x7607, 0x7606, 0x7605, 0x7604, 0x7603, 0x7602, 0x7601, 0x7600, // 24176
-    0x75ff, 0x75fe, 0x75fd, 0x75fc, 0x75fb, 0x75f9, 0x75f8, 0x75f7, // 24184
-    0x75f6, 0x75f5, 0x75f4, 0x75f3, 0x75f2, 0x75f1, 0x75f0, 0x75ef, // 24192
-    0x75ee, 0x75ed, 0x75ec, 0x75ea, 0x75e9, 0x75e8, 0x75e7, 0x75e6, // 24200
-    0x75e5, 0x75e4, 0x75e3, 0x75e2, 0x75e1, 0x75e0, 0x75df, 0x75de, // 24208
-    0x75dd, 0x75dc, 0x75da, 0x75d9, 0x75d8, 0x75d7, 0x75d6, 0x75d5, // 24216
-    0x75d4, 0x75d3, 0x75d2, 0x75d1, 0x75d0, 0x75cf, 0x75ce, 0x75cd, // 24224
-    0x75cc, 0x75ca, 0x75c9, 0x75c8, 0x75c7, 0x75c6, 0x75c5, 0x75c4, // 24232
-    0x75c3, 0x75c2, 0x75c1, 0x75c0, 0x75bf, 0x75be, 0x75bd, 0x75bb, // 24240
-    0x75ba, 0x75b9, 0x75b8, 0x75b7, 0x75b6, 0x75b5, 0x75b4, 0x75b3, // 24248
-    0x75b2, 0x75b1, 0x75b0, 0x75af, 0x75ae, 0x75ad, 0x75ab, 0x75aa, // 24256
-    0x75a9, 0x75a8, 0x75a7, 0x75a6, 0x75a5, 0x75a4, 0x75a3, 0x75a2, // 24264
-    0x75a1, 0x75a0, 0x759f, 0x759e, 0x759d, 0x759b, 0x759a, 0x7599, // 24272
-    0x7598, 0x7597, 0x7596, 0x7595, 0x7594, 0x7593, 0x7592, 0x7591, // 24280
-    0x7590, 0x758f, 0x758e, 0x758c, 0x758b, 0x758a, 0x7589, 0x7588, // 24288
-    0x7587, 0x7586, 0x7585, 0x7584, 0x7583, 0x7582, 0x7581, 0x7580, // 24296
-    0x757f, 0x757e, 0x757c, 0x757b, 0x757a, 0x7579, 0x7578, 0x7577, // 24304
-    0x7576, 0x7575, 0x7574, 0x7573, 0x7572, 0x7571, 0x7570, 0x756f, // 24312
-    0x756e, 0x756c, 0x756b, 0x756a, 0x7569, 0x7568, 0x7567, 0x7566, // 24320
-    0x7565, 0x7564, 0x7563, 0x7562, 0x7561, 0x7560, 0x755f, 0x755d, // 24328
-    0x755c, 0x755b, 0x755a, 0x7559, 0x7558, 0x7557, 0x7556, 0x7555, // 24336
-    0x7554, 0x7553, 0x7552, 0x7551, 0x7550, 0x754f, 0x754d, 0x754c, // 24344
-    0x754b, 0x754a, 0x7549, 0x7548, 0x7547, 0x7546, 0x7545, 0x7544, // 24352
-    0x7543, 0x7542, 0x7541, 0x7540, 0x753e, 0x753d, 0x753c, 0x753b, // 24360
-    0x753a, 0x7539, 0x7538, 0x7537, 0x7536, 0x7535, 0x7534, 0x7533, // 24368
-    0x7532, 0x7531, 0x7530, 0x752e, 0x752d, 0x752c, 0x752b, 0x752a, // 24376
-    0x7529, 0x7528, 0x7527, 0x7526, 0x7525, 0x7524, 0x7523, 0x7522, // 24384
-    0x7521, 0x7520, 0x751e, 0x751d, 0x751c, 0x751b, 0x751a, 0x7519, // 24392
-    0x7518, 0x7517, 0x7516, 0x7515, 0x7514, 0x7513, 0x7512, 0x7511, // 24400
-    0x750f, 0x750e, 0x750d, 0x750c, 0x750b, 0x750a, 0x7509, 0x7508, // 24408
-    0x7507, 0x7506, 0x7505, 0x7504, 0x7503, 0x7502, 0x7501, 0x74ff, // 24416
-    0x74fe, 0x74fd, 0x74fc, 0x74fb, 0x74fa, 0x74f9, 0x74f8, 0x74f7, // 24424
-    0x74f6, 0x74f5, 0x74f4, 0x74f3, 0x74f2, 0x74f1, 0x74ef, 0x74ee, // 24432
-    0x74ed, 0x74ec, 0x74eb, 0x74ea, 0x74e9, 0x74e8, 0x74e7, 0x74e6, // 24440
-    0x74e5, 0x74e4, 0x74e3, 0x74e2, 0x74e0, 0x74df, 0x74de, 0x74dd, // 24448
-    0x74dc, 0x74db, 0x74da, 0x74d9, 0x74d8, 0x74d7, 0x74d6, 0x74d5, // 24456
-    0x74d4, 0x74d3, 0x74d2, 0x74d0, 0x74cf, 0x74ce, 0x74cd, 0x74cc, // 24464
-    0x74cb, 0x74ca, 0x74c9, 0x74c8, 0x74c7, 0x74c6, 0x74c5, 0x74c4, // 24472
-    0x74c3, 0x74c1, 0x74c0, 0x74bf, 0x74be, 0x74bd, 0x74bc, 0x74bb, // 24480
-    0x74ba, 0x74b9, 0x74b8, 0x74b7, 0x74b6, 0x74b5, 0x74b4, 0x74b3, // 24488
-    0x74b1, 0x74b0, 0x74af, 0x74ae, 0x74ad, 0x74ac, 0x74ab, 0x74aa, // 24496
-    0x74a9, 0x74a8, 0x74a7, 0x74a6, 0x74a5, 0x74a4, 0x74a3, 0x74a1, // 24504
-    0x74a0, 0x749f, 0x749e, 0x749d, 0x749c, 0x749b, 0x749a, 0x7499, // 24512
-    0x7498, 0x7497, 0x7496, 0x7495, 0x7494, 0x7492, 0x7491, 0x7490, // 24520
-    0x748f, 0x748e, 0x748d, 0x748c, 0x748b, 0x748a, 0x7489, 0x7488, // 24528
-    0x7487, 0x7486, 0x7485, 0x7484, 0x7482, 0x7481, 0x7480, 0x747f, // 24536
-    0x747e, 0x747d, 0x747c, 0x747b, 0x747a, 0x7479, 0x7478, 0x7477, // 24544
-    0x7476, 0x7475, 0x7474, 0x7472, 0x7471, 0x7470, 0x746f, 0x746e, // 24552
-    0x746d, 0x746c, 0x746b, 0x746a, 0x7469, 0x7468, 0x7467, 0x7466, // 24560
-    0x7465, 0x7463, 0x7462, 0x7461, 0x7460, 0x745f, 0x745e, 0x745d, // 24568
-    0x745b, 0x7459, 0x7458, 0x7457, 0x7456, 0x7455, 0x7454, 0x7453, // 24576
-    0x7452, 0x7451, 0x7450, 0x744f, 0x744e, 0x744d, 0x744c, 0x744b, // 24584
-    0x744a, 0x7449, 0x7448, 0x7447, 0x7446, 0x7445, 0x7444, 0x7442, // 24592
-    0x7441, 0x7440, 0x743f, 0x743e, 0x743d, 0x743c, 0x743b, 0x743a, // 24600
-    0x7439, 0x7438, 0x7437, 0x7436, 0x7435, 0x7434, 0x7433, 0x7432, // 24608
-    0x7431, 0x7430, 0x742f, 0x742e, 0x742d, 0x742b, 0x742a, 0x7429, // 24616
-    0x7428, 0x7427, 0x7426, 0x7425, 0x7424, 0x7423, 0x7422, 0x7421, // 24624
-    0x7420, 0x741f, 0x741e, 0x741d, 0x741c, 0x741b, 0x741a, 0x7419, // 24632
-    0x7418, 0x7417, 0x7416, 0x7414, 0x7413, 0x7412, 0x7411, 0x7410, // 24640
-    0x740f, 0x740e, 0x740d, 0x740c, 0x740b, 0x740a, 0x7409, 0x7408, // 24648
-    0x7407, 0x7406, 0x7405, 0x7404, 0x7403, 0x7402, 0x7401, 0x7400, // 24656
-    0x73ff, 0x73fe, 0x73fc, 0x73fb, 0x73fa, 0x73f9, 0x73f8, 0x73f7, // 24664
-    0x73f6, 0x73f5, 0x73f4, 0x73f3, 0x73f2, 0x73f1, 0x73f0, 0x73ef, // 24672
-    0x73ee, 0x73ed, 0x73ec, 0x73eb, 0x73ea, 0x73e9, 0x73e8, 0x73e7, // 24680
-    0x73e5, 0x73e4, 0x73e3, 0x73e2, 0x73e1, 0x73e0, 0x73df, 0x73de, // 24688
-    0x73dd, 0x73dc, 0x73db, 0x73da, 0x73d9, 0x73d8, 0x73d7, 0x73d6, // 24696
-    0x73d5, 0x73d4, 0x73d3, 0x73d2, 0x73d1, 0x73d0, 0x73ce, 0x73cd, // 24704
-    0x73cc, 0x73cb, 0x73ca, 0x73c9, 0x73c8, 0x73c7, 0x73c6, 0x73c5, // 24712
-    0x73c4, 0x73c3, 0x73c2, 0x73c1, 0x73c0, 0x73bf, 0x73be, 0x73bd, // 24720
-    0x73bc, 0x73bb, 0x73ba, 0x73b9, 0x73b7, 0x73b6, 0x73b5, 0x73b4, // 24728
-    0x73b3, 0x73b2, 0x73b1, 0x73b0, 0x73af, 0x73ae, 0x73ad, 0x73ac, // 24736
-    0x73ab, 0x73aa, 0x73a9, 0x73a8, 0x73a7, 0x73a6, 0x73a5, 0x73a4, // 24744
-    0x73a3, 0x73a2, 0x73a1, 0x739f, 0x739e, 0x739d, 0x739c, 0x739b, // 24752
-    0x739a, 0x7399, 0x7398, 0x7397, 0x7396, 0x7395, 0x7394, 0x7393, // 24760
-    0x7392, 0x7391, 0x7390, 0x738f, 0x738e, 0x738d, 0x738c, 0x738b, // 24768
-    0x738a, 0x7388, 0x7387, 0x7386, 0x7385, 0x7384, 0x7383, 0x7382, // 24776
-    0x7381, 0x7380, 0x737f, 0x737e, 0x737d, 0x737c, 0x737b, 0x737a, // 24784
-    0x7379, 0x7378, 0x7377, 0x7376, 0x7375, 0x7374, 0x7373, 0x7371, // 24792
-    0x7370, 0x736f, 0x736e, 0x736d, 0x736c, 0x736b, 0x736a, 0x7369, // 24800
-    0x7368, 0x7367, 0x7366, 0x7365, 0x7364, 0x7363, 0x7362, 0x7361, // 24808
-    0x7360, 0x735f, 0x735e, 0x735d, 0x735c, 0x735a, 0x7359, 0x7358, // 24816
-    0x7357, 0x7356, 0x7355, 0x7354, 0x7353, 0x7352, 0x7351, 0x7350, // 24824
-    0x734f, 0x734e, 0x734d, 0x734c, 0x734b, 0x734a, 0x7349, 0x7348, // 24832
-    0x7347, 0x7346, 0x7345, 0x7344, 0x7342, 0x7341, 0x7340, 0x733f, // 24840
-    0x733e, 0x733d, 0x733c, 0x733b, 0x733a, 0x7339, 0x7338, 0x7337, // 24848
-    0x7336, 0x7335, 0x7334, 0x7333, 0x7332, 0x7331, 0x7330, 0x732f, // 24856
-    0x732e, 0x732d, 0x732b, 0x732a, 0x7329, 0x7328, 0x7327, 0x7326, // 24864
-    0x7325, 0x7324, 0x7323, 0x7322, 0x7321, 0x7320, 0x731f, 0x731e, // 24872
-    0x731d, 0x731c, 0x731b, 0x731a, 0x7319, 0x7318, 0x7317, 0x7316, // 24880
-    0x7314, 0x7313, 0x7312, 0x7311, 0x7310, 0x730f, 0x730e, 0x730d, // 24888
-    0x730c, 0x730b, 0x730a, 0x7309, 0x7308, 0x7307, 0x7306, 0x7305, // 24896
-    0x7304, 0x7303, 0x7302, 0x7301, 0x7300, 0x72ff, 0x72fd, 0x72fc, // 24904
-    0x72fb, 0x72fa, 0x72f9, 0x72f8, 0x72f7, 0x72f6, 0x72f5, 0x72f4, // 24912
-    0x72f3, 0x72f2, 0x72f1, 0x72f0, 0x72ef, 0x72ee, 0x72ed, 0x72ec, // 24920
-    0x72eb, 0x72ea, 0x72e9, 0x72e8, 0x72e7, 0x72e5, 0x72e4, 0x72e3, // 24928
-    0x72e2, 0x72e1, 0x72e0, 0x72df, 0x72de, 0x72dd, 0x72dc, 0x72db, // 24936
-    0x72da, 0x72d9, 0x72d8, 0x72d7, 0x72d6, 0x72d5, 0x72d4, 0x72d3, // 24944
-    0x72d2, 0x72d1, 0x72d0, 0x72ce, 0x72cd, 0x72cc, 0x72cb, 0x72ca, // 24952
-    0x72c9, 0x72c8, 0x72c7, 0x72c6, 0x72c5, 0x72c4, 0x72c3, 0x72c2, // 24960
-    0x72c1, 0x72c0, 0x72bf, 0x72be, 0x72bd, 0x72bc, 0x72bb, 0x72ba, // 24968
-    0x72b9, 0x72b7, 0x72b6, 0x72b5, 0x72b4, 0x72b3, 0x72b2, 0x72b1, // 24976
-    0x72b0, 0x72af, 0x72ae, 0x72ad, 0x72ac, 0x72ab, 0x72aa, 0x72a9, // 24984
-    0x72a8, 0x72a7, 0x72a6, 0x72a5, 0x72a4, 0x72a3, 0x72a2, 0x72a0, // 24992
-    0x729f, 0x729e, 0x729d, 0x729c, 0x729b, 0x729a, 0x7299, 0x7298, // 25000
-    0x7297, 0x7296, 0x7295, 0x7294, 0x7293, 0x7292, 0x7291, 0x7290, // 25008
-    0x728f, 0x728e, 0x728d, 0x728c, 0x728b, 0x728a, 0x7288, 0x7287, // 25016
-    0x7286, 0x7285, 0x7284, 0x7283, 0x7282, 0x7281, 0x7280, 0x727f, // 25024
-    0x727e, 0x727d, 0x727c, 0x727b, 0x727a, 0x7279, 0x7278, 0x7277, // 25032
-    0x7276, 0x7275, 0x7274, 0x7273, 0x7271, 0x7270, 0x726f, 0x726e, // 25040
-    0x726d, 0x726c, 0x726b, 0x726a, 0x7269, 0x7268, 0x7267, 0x7266, // 25048
-    0x7265, 0x7264, 0x7263, 0x7262, 0x7261, 0x7260, 0x725f, 0x725e, // 25056
-    0x725d, 0x725c, 0x725a, 0x7259, 0x7258, 0x7257, 0x7256, 0x7255, // 25064
-    0x7254, 0x7253, 0x7252, 0x7251, 0x7250, 0x724f, 0x724e, 0x724d, // 25072
-    0x724c, 0x724b, 0x724a, 0x7249, 0x7248, 0x7247, 0x7246, 0x7245, // 25080
-    0x7244, 0x7242, 0x7241, 0x7240, 0x723f, 0x723e, 0x723d, 0x723c, // 25088
-    0x723b, 0x723a, 0x7239, 0x7238, 0x7237, 0x7236, 0x7235, 0x7234, // 25096
-    0x7233, 0x7232, 0x7231, 0x7230, 0x722f, 0x722e, 0x722d, 0x722b, // 25104
-    0x722a, 0x7229, 0x7228, 0x7227, 0x7226, 0x7225, 0x7224, 0x7223, // 25112
-    0x7222, 0x7221, 0x7220, 0x721f, 0x721e, 0x721d, 0x721c, 0x721b, // 25120
-    0x721a, 0x7219, 0x7218, 0x7217, 0x7216, 0x7214, 0x7213, 0x7212, // 25128
-    0x7211, 0x7210, 0x720f, 0x720e, 0x720d, 0x720c, 0x720b, 0x720a, // 25136
-    0x7209, 0x7208, 0x7207, 0x7206, 0x7205, 0x7204, 0x7203, 0x7202, // 25144
-    0x7201, 0x7200, 0x71ff, 0x71fd, 0x71fc, 0x71fb, 0x71fa, 0x71f9, // 25152
-    0x71f8, 0x71f7, 0x71f6, 0x71f5, 0x71f4, 0x71f3, 0x71f2, 0x71f1, // 25160
-    0x71f0, 0x71ef, 0x71ee, 0x71ed, 0x71ec, 0x71eb, 0x71ea, 0x71e9, // 25168
-    0x71e8, 0x71e7, 0x71e5, 0x71e4, 0x71e3, 0x71e2, 0x71e1, 0x71e0, // 25176
-    0x71df, 0x71de, 0x71dd, 0x71dc, 0x71db, 0x71da, 0x71d9, 0x71d8, // 25184
-    0x71d7, 0x71d6, 0x71d5, 0x71d4, 0x71d3, 0x71d2, 0x71d1, 0x71d0, // 25192
-    0x71ce, 0x71cd, 0x71cc, 0x71cb, 0x71ca, 0x71c9, 0x71c8, 0x71c7, // 25200
-    0x71c6, 0x71c5, 0x71c4, 0x71c3, 0x71c2, 0x71c1, 0x71c0, 0x71bf, // 25208
-    0x71be, 0x71bd, 0x71bc, 0x71bb, 0x71ba, 0x71b9, 0x71b7, 0x71b6, // 25216
-    0x71b5, 0x71b4, 0x71b3, 0x71b2, 0x71b1, 0x71b0, 0x71af, 0x71ae, // 25224
-    0x71ad, 0x71ac, 0x71ab, 0x71aa, 0x71a9, 0x71a8, 0x71a7, 0x71a6, // 25232
-    0x71a5, 0x71a4, 0x71a3, 0x71a2, 0x71a0, 0x719f, 0x719e, 0x719d, // 25240
-    0x719c, 0x719b, 0x719a, 0x7199, 0x7198, 0x7197, 0x7196, 0x7195, // 25248
-    0x7194, 0x7193, 0x7192, 0x7191, 0x7190, 0x718f, 0x718e, 0x718d, // 25256
-    0x718c, 0x718b, 0x718a, 0x7188, 0x7187, 0x7186, 0x7185, 0x7184, // 25264
-    0x7183, 0x7182, 0x7181, 0x7180, 0x717f, 0x717e, 0x717d, 0x717c, // 25272
-    0x717b, 0x717a, 0x7179, 0x7178, 0x7177, 0x7176, 0x7175, 0x7174, // 25280
-    0x7173, 0x7171, 0x7170, 0x716f, 0x716e, 0x716d, 0x716c, 0x716b, // 25288
-    0x716a, 0x7169, 0x7168, 0x7167, 0x7166, 0x7165, 0x7164, 0x7163, // 25296
-    0x7162, 0x7161, 0x7160, 0x715f, 0x715e, 0x715d, 0x715c, 0x715a, // 25304
-    0x7159, 0x7158, 0x7157, 0x7156, 0x7155, 0x7154, 0x7153, 0x7152, // 25312
-    0x7151, 0x7150, 0x714f, 0x714e, 0x714d, 0x714c, 0x714b, 0x714a, // 25320
-    0x7149, 0x7148, 0x7147, 0x7146, 0x7145, 0x7143, 0x7142, 0x7141, // 25328
-    0x7140, 0x713f, 0x713e, 0x713d, 0x713c, 0x713b, 0x713a, 0x7139, // 25336
-    0x7138, 0x7137, 0x7136, 0x7135, 0x7134, 0x7133, 0x7132, 0x7131, // 25344
-    0x7130, 0x712f, 0x712e, 0x712d, 0x712b, 0x712a, 0x7129, 0x7128, // 25352
-    0x7127, 0x7126, 0x7125, 0x7124, 0x7123, 0x7122, 0x7121, 0x7120, // 25360
-    0x711f, 0x711e, 0x711d, 0x711c, 0x711b, 0x711a, 0x7119, 0x7118, // 25368
-    0x7117, 0x7116, 0x7114, 0x7113, 0x7112, 0x7111, 0x7110, 0x710f, // 25376
-    0x710e, 0x710d, 0x710c, 0x710b, 0x710a, 0x7109, 0x7108, 0x7107, // 25384
-    0x7106, 0x7105, 0x7104, 0x7103, 0x7102, 0x7101, 0x7100, 0x70ff, // 25392
-    0x70fd, 0x70fc, 0x70fb, 0x70fa, 0x70f9, 0x70f8, 0x70f7, 0x70f6, // 25400
-    0x70f5, 0x70f4, 0x70f3, 0x70f2, 0x70f1, 0x70f0, 0x70ef, 0x70ee, // 25408
-    0x70ed, 0x70ec, 0x70eb, 0x70ea, 0x70e9, 0x70e8, 0x70e6, 0x70e5, // 25416
-    0x70e4, 0x70e3, 0x70e2, 0x70e1, 0x70e0, 0x70df, 0x70de, 0x70dd, // 25424
-    0x70dc, 0x70db, 0x70da, 0x70d9, 0x70d8, 0x70d7, 0x70d6, 0x70d5, // 25432
-    0x70d4, 0x70d3, 0x70d2, 0x70d1, 0x70d0, 0x70ce, 0x70cd, 0x70cc, // 25440
-    0x70cb, 0x70ca, 0x70c9, 0x70c8, 0x70c7, 0x70c6, 0x70c5, 0x70c4, // 25448
-    0x70c3, 0x70c2, 0x70c1, 0x70c0, 0x70bf, 0x70be, 0x70bd, 0x70bc, // 25456
-    0x70bb, 0x70ba, 0x70b9, 0x70b7, 0x70b6, 0x70b5, 0x70b4, 0x70b3, // 25464
-    0x70b2, 0x70b1, 0x70b0, 0x70af, 0x70ae, 0x70ad, 0x70ac, 0x70ab, // 25472
-    0x70aa, 0x70a9, 0x70a8, 0x70a7, 0x70a6, 0x70a5, 0x70a4, 0x70a3, // 25480
-    0x70a2, 0x70a0, 0x709f, 0x709e, 0x709d, 0x709c, 0x709b, 0x709a, // 25488
-    0x7099, 0x7098, 0x7097, 0x7096, 0x7095, 0x7094, 0x7093, 0x7092, // 25496
-    0x7091, 0x7090, 0x708f, 0x708e, 0x708d, 0x708c, 0x708b, 0x7089, // 25504
-    0x7088, 0x7087, 0x7086, 0x7085, 0x7084, 0x7083, 0x7082, 0x7081, // 25512
-    0x7080, 0x707f, 0x707e, 0x707d, 0x707c, 0x707b, 0x707a, 0x7079, // 25520
-    0x7078, 0x7077, 0x7076, 0x7075, 0x7074, 0x7073, 0x7071, 0x7070, // 25528
-    0x706f, 0x706e, 0x706d, 0x706c, 0x706b, 0x706a, 0x7069, 0x7068, // 25536
-    0x7067, 0x7066, 0x7065, 0x7064, 0x7063, 0x7062, 0x7061, 0x7060, // 25544
-    0x705f, 0x705e, 0x705d, 0x705c, 0x705a, 0x7059, 0x7058, 0x7057, // 25552
-    0x7056, 0x7055, 0x7054, 0x7053, 0x7052, 0x7051, 0x7050, 0x704f, // 25560
-    0x704e, 0x704d, 0x704c, 0x704b, 0x704a, 0x7049, 0x7048, 0x7047, // 25568
-    0x7046, 0x7045, 0x7043, 0x7042, 0x7041, 0x7040, 0x703f, 0x703e, // 25576
-    0x703d, 0x703c, 0x703b, 0x703a, 0x7039, 0x7038, 0x7037, 0x7036, // 25584
-    0x7035, 0x7034, 0x7033, 0x7032, 0x7031, 0x7030, 0x702f, 0x702e, // 25592
-    0x702c, 0x702a, 0x7029, 0x7028, 0x7027, 0x7026, 0x7025, 0x7024, // 25600
-    0x7023, 0x7022, 0x7021, 0x7020, 0x701f, 0x701e, 0x701d, 0x701c, // 25608
-    0x701b, 0x701a, 0x7019, 0x7018, 0x7017, 0x7016, 0x7015, 0x7014, // 25616
-    0x7013, 0x7012, 0x7011, 0x7010, 0x700f, 0x700e, 0x700d, 0x700c, // 25624
-    0x700b, 0x700a, 0x7009, 0x7008, 0x7007, 0x7006, 0x7005, 0x7004, // 25632
-    0x7003, 0x7002, 0x7001, 0x7000, 0x6fff, 0x6ffe, 0x6ffd, 0x6ffb, // 25640
-    0x6ffa, 0x6ff9, 0x6ff8, 0x6ff7, 0x6ff6, 0x6ff5, 0x6ff4, 0x6ff3, // 25648
-    0x6ff2, 0x6ff1, 0x6ff0, 0x6fef, 0x6fee, 0x6fed, 0x6fec, 0x6feb, // 25656
-    0x6fea, 0x6fe9, 0x6fe8, 0x6fe7, 0x6fe6, 0x6fe5, 0x6fe4, 0x6fe3, // 25664
-    0x6fe2, 0x6fe1, 0x6fe0, 0x6fdf, 0x6fde, 0x6fdd, 0x6fdc, 0x6fdb, // 25672
-    0x6fda, 0x6fd9, 0x6fd8, 0x6fd7, 0x6fd6, 0x6fd5, 0x6fd4, 0x6fd3, // 25680
-    0x6fd2, 0x6fd1, 0x6fd0, 0x6fcf, 0x6fce, 0x6fcd, 0x6fcb, 0x6fca, // 25688
-    0x6fc9, 0x6fc8, 0x6fc7, 0x6fc6, 0x6fc5, 0x6fc4, 0x6fc3, 0x6fc2, // 25696
-    0x6fc1, 0x6fc0, 0x6fbf, 0x6fbe, 0x6fbd, 0x6fbc, 0x6fbb, 0x6fba, // 25704
-    0x6fb9, 0x6fb8, 0x6fb7, 0x6fb6, 0x6fb5, 0x6fb4, 0x6fb3, 0x6fb2, // 25712
-    0x6fb1, 0x6fb0, 0x6faf, 0x6fae, 0x6fad, 0x6fac, 0x6fab, 0x6faa, // 25720
-    0x6fa9, 0x6fa8, 0x6fa7, 0x6fa6, 0x6fa5, 0x6fa4, 0x6fa3, 0x6fa2, // 25728
-    0x6fa1, 0x6fa0, 0x6f9f, 0x6f9e, 0x6f9c, 0x6f9b, 0x6f9a, 0x6f99, // 25736
-    0x6f98, 0x6f97, 0x6f96, 0x6f95, 0x6f94, 0x6f93, 0x6f92, 0x6f91, // 25744
-    0x6f90, 0x6f8f, 0x6f8e, 0x6f8d, 0x6f8c, 0x6f8b, 0x6f8a, 0x6f89, // 25752
-    0x6f88, 0x6f87, 0x6f86, 0x6f85, 0x6f84, 0x6f83, 0x6f82, 0x6f81, // 25760
-    0x6f80, 0x6f7f, 0x6f7e, 0x6f7d, 0x6f7c, 0x6f7b, 0x6f7a, 0x6f79, // 25768
-    0x6f78, 0x6f77, 0x6f76, 0x6f75, 0x6f74, 0x6f73, 0x6f72, 0x6f71, // 25776
-    0x6f70, 0x6f6f, 0x6f6e, 0x6f6c, 0x6f6b, 0x6f6a, 0x6f69, 0x6f68, // 25784
-    0x6f67, 0x6f66, 0x6f65, 0x6f64, 0x6f63, 0x6f62, 0x6f61, 0x6f60, // 25792
-    0x6f5f, 0x6f5e, 0x6f5d, 0x6f5c, 0x6f5b, 0x6f5a, 0x6f59, 0x6f58, // 25800
-    0x6f57, 0x6f56, 0x6f55, 0x6f54, 0x6f53, 0x6f52, 0x6f51, 0x6f50, // 25808
-    0x6f4f, 0x6f4e, 0x6f4d, 0x6f4c, 0x6f4b, 0x6f4a, 0x6f49, 0x6f48, // 25816
-    0x6f47, 0x6f46, 0x6f45, 0x6f44, 0x6f43, 0x6f42, 0x6f41, 0x6f40, // 25824
-    0x6f3f, 0x6f3d, 0x6f3c, 0x6f3b, 0x6f3a, 0x6f39, 0x6f38, 0x6f37, // 25832
-    0x6f36, 0x6f35, 0x6f34, 0x6f33, 0x6f32, 0x6f31, 0x6f30, 0x6f2f, // 25840
-    0x6f2e, 0x6f2d, 0x6f2c, 0x6f2b, 0x6f2a, 0x6f29, 0x6f28, 0x6f27, // 25848
-    0x6f26, 0x6f25, 0x6f24, 0x6f23, 0x6f22, 0x6f21, 0x6f20, 0x6f1f, // 25856
-    0x6f1e, 0x6f1d, 0x6f1c, 0x6f1b, 0x6f1a, 0x6f19, 0x6f18, 0x6f17, // 25864
-    0x6f16, 0x6f15, 0x6f14, 0x6f13, 0x6f12, 0x6f11, 0x6f10, 0x6f0f, // 25872
-    0x6f0d, 0x6f0c, 0x6f0b, 0x6f0a, 0x6f09, 0x6f08, 0x6f07, 0x6f06, // 25880
-    0x6f05, 0x6f04, 0x6f03, 0x6f02, 0x6f01, 0x6f00, 0x6eff, 0x6efe, // 25888
-    0x6efd, 0x6efc, 0x6efb, 0x6efa, 0x6ef9, 0x6ef8, 0x6ef7, 0x6ef6, // 25896
-    0x6ef5, 0x6ef4, 0x6ef3, 0x6ef2, 0x6ef1, 0x6ef0, 0x6eef, 0x6eee, // 25904
-    0x6eed, 0x6eec, 0x6eeb, 0x6eea, 0x6ee9, 0x6ee8, 0x6ee7, 0x6ee6, // 25912
-    0x6ee5, 0x6ee4, 0x6ee3, 0x6ee2, 0x6ee1, 0x6ee0, 0x6ede, 0x6edd, // 25920
-    0x6edc, 0x6edb, 0x6eda, 0x6ed9, 0x6ed8, 0x6ed7, 0x6ed6, 0x6ed5, // 25928
-    0x6ed4, 0x6ed3, 0x6ed2, 0x6ed1, 0x6ed0, 0x6ecf, 0x6ece, 0x6ecd, // 25936
-    0x6ecc, 0x6ecb, 0x6eca, 0x6ec9, 0x6ec8, 0x6ec7, 0x6ec6, 0x6ec5, // 25944
-    0x6ec4, 0x6ec3, 0x6ec2, 0x6ec1, 0x6ec0, 0x6ebf, 0x6ebe, 0x6ebd, // 25952
-    0x6ebc, 0x6ebb, 0x6eba, 0x6eb9, 0x6eb8, 0x6eb7, 0x6eb6, 0x6eb5, // 25960
-    0x6eb4, 0x6eb3, 0x6eb2, 0x6eb1, 0x6eb0, 0x6eae, 0x6ead, 0x6eac, // 25968
-    0x6eab, 0x6eaa, 0x6ea9, 0x6ea8, 0x6ea7, 0x6ea6, 0x6ea5, 0x6ea4, // 25976
-    0x6ea3, 0x6ea2, 0x6ea1, 0x6ea0, 0x6e9f, 0x6e9e, 0x6e9d, 0x6e9c, // 25984
-    0x6e9b, 0x6e9a, 0x6e99, 0x6e98, 0x6e97, 0x6e96, 0x6e95, 0x6e94, // 25992
-    0x6e93, 0x6e92, 0x6e91, 0x6e90, 0x6e8f, 0x6e8e, 0x6e8d, 0x6e8c, // 26000
-    0x6e8b, 0x6e8a, 0x6e89, 0x6e88, 0x6e87, 0x6e86, 0x6e85, 0x6e84, // 26008
-    0x6e83, 0x6e82, 0x6e81, 0x6e7f, 0x6e7e, 0x6e7d, 0x6e7c, 0x6e7b, // 26016
-    0x6e7a, 0x6e79, 0x6e78, 0x6e77, 0x6e76, 0x6e75, 0x6e74, 0x6e73, // 26024
-    0x6e72, 0x6e71, 0x6e70, 0x6e6f, 0x6e6e, 0x6e6d, 0x6e6c, 0x6e6b, // 26032
-    0x6e6a, 0x6e69, 0x6e68, 0x6e67, 0x6e66, 0x6e65, 0x6e64, 0x6e63, // 26040
-    0x6e62, 0x6e61, 0x6e60, 0x6e5f, 0x6e5e, 0x6e5d, 0x6e5c, 0x6e5b, // 26048
-    0x6e5a, 0x6e59, 0x6e58, 0x6e57, 0x6e56, 0x6e55, 0x6e54, 0x6e53, // 26056
-    0x6e52, 0x6e51, 0x6e4f, 0x6e4e, 0x6e4d, 0x6e4c, 0x6e4b, 0x6e4a, // 26064
-    0x6e49, 0x6e48, 0x6e47, 0x6e46, 0x6e45, 0x6e44, 0x6e43, 0x6e42, // 26072
-    0x6e41, 0x6e40, 0x6e3f, 0x6e3e, 0x6e3d, 0x6e3c, 0x6e3b, 0x6e3a, // 26080
-    0x6e39, 0x6e38, 0x6e37, 0x6e36, 0x6e35, 0x6e34, 0x6e33, 0x6e32, // 26088
-    0x6e31, 0x6e30, 0x6e2f, 0x6e2e, 0x6e2d, 0x6e2c, 0x6e2b, 0x6e2a, // 26096
-    0x6e29, 0x6e28, 0x6e27, 0x6e26, 0x6e25, 0x6e24, 0x6e23, 0x6e22, // 26104
-    0x6e21, 0x6e1f, 0x6e1e, 0x6e1d, 0x6e1c, 0x6e1b, 0x6e1a, 0x6e19, // 26112
-    0x6e18, 0x6e17, 0x6e16, 0x6e15, 0x6e14, 0x6e13, 0x6e12, 0x6e11, // 26120
-    0x6e10, 0x6e0f, 0x6e0e, 0x6e0d, 0x6e0c, 0x6e0b, 0x6e0a, 0x6e09, // 26128
-    0x6e08, 0x6e07, 0x6e06, 0x6e05, 0x6e04, 0x6e03, 0x6e02, 0x6e01, // 26136
-    0x6e00, 0x6dff, 0x6dfe, 0x6dfd, 0x6dfc, 0x6dfb, 0x6dfa, 0x6df9, // 26144
-    0x6df8, 0x6df7, 0x6df6, 0x6df5, 0x6df4, 0x6df3, 0x6df2, 0x6df0, // 26152
-    0x6def, 0x6dee, 0x6ded, 0x6dec, 0x6deb, 0x6dea, 0x6de9, 0x6de8, // 26160
-    0x6de7, 0x6de6, 0x6de5, 0x6de4, 0x6de3, 0x6de2, 0x6de1, 0x6de0, // 26168
-    0x6ddf, 0x6dde, 0x6ddd, 0x6ddc, 0x6ddb, 0x6dda, 0x6dd9, 0x6dd8, // 26176
-    0x6dd7, 0x6dd6, 0x6dd5, 0x6dd4, 0x6dd3, 0x6dd2, 0x6dd1, 0x6dd0, // 26184
-    0x6dcf, 0x6dce, 0x6dcd, 0x6dcc, 0x6dcb, 0x6dca, 0x6dc9, 0x6dc8, // 26192
-    0x6dc7, 0x6dc6, 0x6dc5, 0x6dc4, 0x6dc3, 0x6dc2, 0x6dc0, 0x6dbf, // 26200
-    0x6dbe, 0x6dbd, 0x6dbc, 0x6dbb, 0x6dba, 0x6db9, 0x6db8, 0x6db7, // 26208
-    0x6db6, 0x6db5, 0x6db4, 0x6db3, 0x6db2, 0x6db1, 0x6db0, 0x6daf, // 26216
-    0x6dae, 0x6dad, 0x6dac, 0x6dab, 0x6daa, 0x6da9, 0x6da8, 0x6da7, // 26224
-    0x6da6, 0x6da5, 0x6da4, 0x6da3, 0x6da2, 0x6da1, 0x6da0, 0x6d9f, // 26232
-    0x6d9e, 0x6d9d, 0x6d9c, 0x6d9b, 0x6d9a, 0x6d99, 0x6d98, 0x6d97, // 26240
-    0x6d96, 0x6d95, 0x6d94, 0x6d93, 0x6d91, 0x6d90, 0x6d8f, 0x6d8e, // 26248
-    0x6d8d, 0x6d8c, 0x6d8b, 0x6d8a, 0x6d89, 0x6d88, 0x6d87, 0x6d86, // 26256
-    0x6d85, 0x6d84, 0x6d83, 0x6d82, 0x6d81, 0x6d80, 0x6d7f, 0x6d7e, // 26264
-    0x6d7d, 0x6d7c, 0x6d7b, 0x6d7a, 0x6d79, 0x6d78, 0x6d77, 0x6d76, // 26272
-    0x6d75, 0x6d74, 0x6d73, 0x6d72, 0x6d71, 0x6d70, 0x6d6f, 0x6d6e, // 26280
-    0x6d6d, 0x6d6c, 0x6d6b, 0x6d6a, 0x6d69, 0x6d68, 0x6d67, 0x6d66, // 26288
-    0x6d65, 0x6d64, 0x6d63, 0x6d61, 0x6d60, 0x6d5f, 0x6d5e, 0x6d5d, // 26296
-    0x6d5c, 0x6d5b, 0x6d5a, 0x6d59, 0x6d58, 0x6d57, 0x6d56, 0x6d55, // 26304
-    0x6d54, 0x6d53, 0x6d52, 0x6d51, 0x6d50, 0x6d4f, 0x6d4e, 0x6d4d, // 26312
-    0x6d4c, 0x6d4b, 0x6d4a, 0x6d49, 0x6d48, 0x6d47, 0x6d46, 0x6d45, // 26320
-    0x6d44, 0x6d43, 0x6d42, 0x6d41, 0x6d40, 0x6d3f, 0x6d3e, 0x6d3d, // 26328
-    0x6d3c, 0x6d3b, 0x6d3a, 0x6d39, 0x6d38, 0x6d37, 0x6d36, 0x6d35, // 26336
-    0x6d34, 0x6d32, 0x6d31, 0x6d30, 0x6d2f, 0x6d2e, 0x6d2d, 0x6d2c, // 26344
-    0x6d2b, 0x6d2a, 0x6d29, 0x6d28, 0x6d27, 0x6d26, 0x6d25, 0x6d24, // 26352
-    0x6d23, 0x6d22, 0x6d21, 0x6d20, 0x6d1f, 0x6d1e, 0x6d1d, 0x6d1c, // 26360
-    0x6d1b, 0x6d1a, 0x6d19, 0x6d18, 0x6d17, 0x6d16, 0x6d15, 0x6d14, // 26368
-    0x6d13, 0x6d12, 0x6d11, 0x6d10, 0x6d0f, 0x6d0e, 0x6d0d, 0x6d0c, // 26376
-    0x6d0b, 0x6d0a, 0x6d09, 0x6d08, 0x6d07, 0x6d06, 0x6d05, 0x6d04, // 26384
-    0x6d02, 0x6d01, 0x6d00, 0x6cff, 0x6cfe, 0x6cfd, 0x6cfc, 0x6cfb, // 26392
-    0x6cfa, 0x6cf9, 0x6cf8, 0x6cf7, 0x6cf6, 0x6cf5, 0x6cf4, 0x6cf3, // 26400
-    0x6cf2, 0x6cf1, 0x6cf0, 0x6cef, 0x6cee, 0x6ced, 0x6cec, 0x6ceb, // 26408
-    0x6cea, 0x6ce9, 0x6ce8, 0x6ce7, 0x6ce6, 0x6ce5, 0x6ce4, 0x6ce3, // 26416
-    0x6ce2, 0x6ce1, 0x6ce0, 0x6cdf, 0x6cde, 0x6cdd, 0x6cdc, 0x6cdb, // 26424
-    0x6cda, 0x6cd9, 0x6cd8, 0x6cd7, 0x6cd6, 0x6cd5, 0x6cd3, 0x6cd2, // 26432
-    0x6cd1, 0x6cd0, 0x6ccf, 0x6cce, 0x6ccd, 0x6ccc, 0x6ccb, 0x6cca, // 26440
-    0x6cc9, 0x6cc8, 0x6cc7, 0x6cc6, 0x6cc5, 0x6cc4, 0x6cc3, 0x6cc2, // 26448
-    0x6cc1, 0x6cc0, 0x6cbf, 0x6cbe, 0x6cbd, 0x6cbc, 0x6cbb, 0x6cba, // 26456
-    0x6cb9, 0x6cb8, 0x6cb7, 0x6cb6, 0x6cb5, 0x6cb4, 0x6cb3, 0x6cb2, // 26464
-    0x6cb1, 0x6cb0, 0x6caf, 0x6cae, 0x6cad, 0x6cac, 0x6cab, 0x6caa, // 26472
-    0x6ca9, 0x6ca8, 0x6ca7, 0x6ca6, 0x6ca5, 0x6ca3, 0x6ca2, 0x6ca1, // 26480
-    0x6ca0, 0x6c9f, 0x6c9e, 0x6c9d, 0x6c9c, 0x6c9b, 0x6c9a, 0x6c99, // 26488
-    0x6c98, 0x6c97, 0x6c96, 0x6c95, 0x6c94, 0x6c93, 0x6c92, 0x6c91, // 26496
-    0x6c90, 0x6c8f, 0x6c8e, 0x6c8d, 0x6c8c, 0x6c8b, 0x6c8a, 0x6c89, // 26504
-    0x6c88, 0x6c87, 0x6c86, 0x6c85, 0x6c84, 0x6c83, 0x6c82, 0x6c81, // 26512
-    0x6c80, 0x6c7f, 0x6c7e, 0x6c7d, 0x6c7c, 0x6c7b, 0x6c7a, 0x6c79, // 26520
-    0x6c78, 0x6c77, 0x6c76, 0x6c74, 0x6c73, 0x6c72, 0x6c71, 0x6c70, // 26528
-    0x6c6f, 0x6c6e, 0x6c6d, 0x6c6c, 0x6c6b, 0x6c6a, 0x6c69, 0x6c68, // 26536
-    0x6c67, 0x6c66, 0x6c65, 0x6c64, 0x6c63, 0x6c62, 0x6c61, 0x6c60, // 26544
-    0x6c5f, 0x6c5e, 0x6c5d, 0x6c5c, 0x6c5b, 0x6c5a, 0x6c59, 0x6c58, // 26552
-    0x6c57, 0x6c56, 0x6c55, 0x6c54, 0x6c53, 0x6c52, 0x6c51, 0x6c50, // 26560
-    0x6c4f, 0x6c4e, 0x6c4d, 0x6c4c, 0x6c4b, 0x6c4a, 0x6c49, 0x6c48, // 26568
-    0x6c47, 0x6c46, 0x6c44, 0x6c43, 0x6c42, 0x6c41, 0x6c40, 0x6c3f, // 26576
-    0x6c3e, 0x6c3d, 0x6c3c, 0x6c3b, 0x6c3a, 0x6c39, 0x6c38, 0x6c37, // 26584
-    0x6c36, 0x6c35, 0x6c34, 0x6c33, 0x6c32, 0x6c31, 0x6c30, 0x6c2f, // 26592
-    0x6c2e, 0x6c2d, 0x6c2c, 0x6c2b, 0x6c2a, 0x6c29, 0x6c28, 0x6c27, // 26600
-    0x6c26, 0x6c25, 0x6c24, 0x6c23, 0x6c22, 0x6c21, 0x6c20, 0x6c1f, // 26608
-    0x6c1e, 0x6c1d, 0x6c1c, 0x6c1b, 0x6c1a, 0x6c19, 0x6c18, 0x6c17, // 26616
-    0x6c16, 0x6c15, 0x6c14, 0x6c13, 0x6c12, 0x6c11, 0x6c10, 0x6c0f, // 26624
-    0x6c0e, 0x6c0d, 0x6c0c, 0x6c0b, 0x6c0a, 0x6c09, 0x6c08, 0x6c07, // 26632
-    0x6c06, 0x6c05, 0x6c04, 0x6c03, 0x6c02, 0x6c01, 0x6c00, 0x6bff, // 26640
-    0x6bfe, 0x6bfd, 0x6bfc, 0x6bfb, 0x6bfa, 0x6bf9, 0x6bf8, 0x6bf7, // 26648
-    0x6bf6, 0x6bf5, 0x6bf4, 0x6bf3, 0x6bf2, 0x6bf1, 0x6bf0, 0x6bef, // 26656
-    0x6bee, 0x6bed, 0x6bec, 0x6beb, 0x6bea, 0x6be9, 0x6be8, 0x6be7, // 26664
-    0x6be6, 0x6be5, 0x6be4, 0x6be3, 0x6be2, 0x6be1, 0x6be0, 0x6bdf, // 26672
-    0x6bde, 0x6bdd, 0x6bdc, 0x6bdb, 0x6bda, 0x6bd9, 0x6bd8, 0x6bd7, // 26680
-    0x6bd6, 0x6bd5, 0x6bd4, 0x6bd3, 0x6bd2, 0x6bd1, 0x6bd0, 0x6bcf, // 26688
-    0x6bce, 0x6bcd, 0x6bcc, 0x6bcb, 0x6bca, 0x6bc9, 0x6bc8, 0x6bc7, // 26696
-    0x6bc6, 0x6bc5, 0x6bc4, 0x6bc3, 0x6bc2, 0x6bc1, 0x6bc0, 0x6bbf, // 26704
-    0x6bbe, 0x6bbd, 0x6bbc, 0x6bbb, 0x6bba, 0x6bb9, 0x6bb8, 0x6bb7, // 26712
-    0x6bb6, 0x6bb5, 0x6bb4, 0x6bb3, 0x6bb2, 0x6bb1, 0x6bb0, 0x6baf, // 26720
-    0x6bae, 0x6bad, 0x6bac, 0x6bab, 0x6baa, 0x6ba9, 0x6ba8, 0x6ba7, // 26728
-    0x6ba6, 0x6ba5, 0x6ba4, 0x6ba3, 0x6ba2, 0x6ba1, 0x6ba0, 0x6b9f, // 26736
-    0x6b9e, 0x6b9d, 0x6b9c, 0x6b9b, 0x6b9a, 0x6b99, 0x6b98, 0x6b97, // 26744
-    0x6b96, 0x6b95, 0x6b94, 0x6b93, 0x6b92, 0x6b91, 0x6b90, 0x6b8f, // 26752
-    0x6b8e, 0x6b8d, 0x6b8c, 0x6b8b, 0x6b8a, 0x6b89, 0x6b88, 0x6b87, // 26760
-    0x6b86, 0x6b85, 0x6b84, 0x6b83, 0x6b82, 0x6b81, 0x6b80, 0x6b7f, // 26768
-    0x6b7e, 0x6b7d, 0x6b7c, 0x6b7b, 0x6b7a, 0x6b79, 0x6b78, 0x6b77, // 26776
-    0x6b76, 0x6b75, 0x6b74, 0x6b73, 0x6b72, 0x6b71, 0x6b70, 0x6b6f, // 26784
-    0x6b6e, 0x6b6d, 0x6b6c, 0x6b6b, 0x6b6a, 0x6b69, 0x6b68, 0x6b67, // 26792
-    0x6b66, 0x6b65, 0x6b64, 0x6b63, 0x6b62, 0x6b61, 0x6b60, 0x6b5f, // 26800
-    0x6b5e, 0x6b5d, 0x6b5c, 0x6b5b, 0x6b5a, 0x6b59, 0x6b58, 0x6b57, // 26808
-    0x6b56, 0x6b55, 0x6b54, 0x6b53, 0x6b52, 0x6b51, 0x6b50, 0x6b4f, // 26816
-    0x6b4e, 0x6b4d, 0x6b4c, 0x6b4b, 0x6b4a, 0x6b49, 0x6b48, 0x6b47, // 26824
-    0x6b46, 0x6b45, 0x6b44, 0x6b43, 0x6b42, 0x6b41, 0x6b40, 0x6b3f, // 26832
-    0x6b3e, 0x6b3d, 0x6b3c, 0x6b3b, 0x6b3a, 0x6b39, 0x6b38, 0x6b37, // 26840
-    0x6b36, 0x6b35, 0x6b34, 0x6b33, 0x6b32, 0x6b31, 0x6b30, 0x6b2f, // 26848
-    0x6b2e, 0x6b2d, 0x6b2c, 0x6b2b, 0x6b2a, 0x6b29, 0x6b28, 0x6b27, // 26856
-    0x6b26, 0x6b25, 0x6b24, 0x6b23, 0x6b22, 0x6b21, 0x6b20, 0x6b1f, // 26864
-    0x6b1e, 0x6b1d, 0x6b1c, 0x6b1b, 0x6b1a, 0x6b19, 0x6b18, 0x6b17, // 26872
-    0x6b16, 0x6b14, 0x6b13, 0x6b12, 0x6b11, 0x6b10, 0x6b0f, 0x6b0e, // 26880
-    0x6b0d, 0x6b0c, 0x6b0b, 0x6b0a, 0x6b09, 0x6b08, 0x6b07, 0x6b06, // 26888
-    0x6b05, 0x6b04, 0x6b03, 0x6b02, 0x6b01, 0x6b00, 0x6aff, 0x6afe, // 26896
-    0x6afd, 0x6afc, 0x6afb, 0x6afa, 0x6af9, 0x6af8, 0x6af7, 0x6af6, // 26904
-    0x6af5, 0x6af4, 0x6af3, 0x6af2, 0x6af1, 0x6af0, 0x6aef, 0x6aee, // 26912
-    0x6aed, 0x6aec, 0x6aeb, 0x6aea, 0x6ae9, 0x6ae8, 0x6ae7, 0x6ae6, // 26920
-    0x6ae5, 0x6ae4, 0x6ae3, 0x6ae2, 0x6ae1, 0x6ae0, 0x6adf, 0x6ade, // 26928
-    0x6add, 0x6adc, 0x6adb, 0x6ada, 0x6ad9, 0x6ad8, 0x6ad7, 0x6ad6, // 26936
-    0x6ad5, 0x6ad4, 0x6ad3, 0x6ad2, 0x6ad1, 0x6ad0, 0x6acf, 0x6ace, // 26944
-    0x6acd, 0x6acc, 0x6acb, 0x6aca, 0x6ac9, 0x6ac8, 0x6ac7, 0x6ac6, // 26952
-    0x6ac5, 0x6ac4, 0x6ac3, 0x6ac2, 0x6ac1, 0x6ac0, 0x6abf, 0x6abe, // 26960
-    0x6abd, 0x6abc, 0x6abb, 0x6aba, 0x6ab9, 0x6ab8, 0x6ab7, 0x6ab6, // 26968
-    0x6ab5, 0x6ab4, 0x6ab3, 0x6ab2, 0x6ab1, 0x6ab0, 0x6aaf, 0x6aae, // 26976
-    0x6aad, 0x6aac, 0x6aab, 0x6aaa, 0x6aa9, 0x6aa8, 0x6aa7, 0x6aa6, // 26984
-    0x6aa5, 0x6aa4, 0x6aa3, 0x6aa2, 0x6aa1, 0x6aa0, 0x6a9f, 0x6a9e, // 26992
-    0x6a9d, 0x6a9c, 0x6a9b, 0x6a9a, 0x6a99, 0x6a98, 0x6a97, 0x6a96, // 27000
-    0x6a95, 0x6a94, 0x6a93, 0x6a92, 0x6a91, 0x6a90, 0x6a8f, 0x6a8e, // 27008
-    0x6a8d, 0x6a8c, 0x6a8b, 0x6a8a, 0x6a89, 0x6a88, 0x6a87, 0x6a86, // 27016
-    0x6a85, 0x6a84, 0x6a83, 0x6a82, 0x6a81, 0x6a80, 0x6a7f, 0x6a7e, // 27024
-    0x6a7d, 0x6a7c, 0x6a7b, 0x6a7a, 0x6a79, 0x6a78, 0x6a77, 0x6a76, // 27032
-    0x6a75, 0x6a74, 0x6a73, 0x6a72, 0x6a71, 0x6a70, 0x6a6f, 0x6a6e, // 27040
-    0x6a6d, 0x6a6c, 0x6a6b, 0x6a6a, 0x6a69, 0x6a68, 0x6a67, 0x6a66, // 27048
-    0x6a65, 0x6a64, 0x6a63, 0x6a62, 0x6a61, 0x6a60, 0x6a5f, 0x6a5e, // 27056
-    0x6a5d, 0x6a5c, 0x6a5b, 0x6a5a, 0x6a59, 0x6a58, 0x6a57, 0x6a56, // 27064
-    0x6a55, 0x6a54, 0x6a53, 0x6a52, 0x6a51, 0x6a50, 0x6a4f, 0x6a4e, // 27072
-    0x6a4d, 0x6a4c, 0x6a4b, 0x6a4a, 0x6a49, 0x6a48, 0x6a47, 0x6a46, // 27080
-    0x6a45, 0x6a44, 0x6a43, 0x6a42, 0x6a41, 0x6a40, 0x6a3f, 0x6a3e, // 27088
-    0x6a3d, 0x6a3c, 0x6a3b, 0x6a3a, 0x6a39, 0x6a38, 0x6a37, 0x6a36, // 27096
-    0x6a35, 0x6a34, 0x6a33, 0x6a32, 0x6a31, 0x6a30, 0x6a2f, 0x6a2e, // 27104
-    0x6a2d, 0x6a2c, 0x6a2b, 0x6a2a, 0x6a29, 0x6a28, 0x6a27, 0x6a26, // 27112
-    0x6a25, 0x6a24, 0x6a23, 0x6a22, 0x6a21, 0x6a20, 0x6a1f, 0x6a1e, // 27120
-    0x6a1d, 0x6a1c, 0x6a1b, 0x6a1a, 0x6a19, 0x6a18, 0x6a17, 0x6a16, // 27128
-    0x6a15, 0x6a14, 0x6a13, 0x6a12, 0x6a11, 0x6a10, 0x6a0f, 0x6a0e, // 27136
-    0x6a0d, 0x6a0c, 0x6a0b, 0x6a0a, 0x6a09, 0x6a08, 0x6a07, 0x6a06, // 27144
-    0x6a05, 0x6a04, 0x6a03, 0x6a02, 0x6a01, 0x6a00, 0x69ff, 0x69fe, // 27152
-    0x69fd, 0x69fc, 0x69fb, 0x69fa, 0x69f9, 0x69f8, 0x69f7, 0x69f6, // 27160
-    0x69f5, 0x69f4, 0x69f3, 0x69f2, 0x69f1, 0x69f0, 0x69ef, 0x69ee, // 27168
-    0x69ed, 0x69ec, 0x69eb, 0x69ea, 0x69e9, 0x69e8, 0x69e7, 0x69e6, // 27176
-    0x69e5, 0x69e4, 0x69e3, 0x69e2, 0x69e1, 0x69e0, 0x69df, 0x69de, // 27184
-    0x69dd, 0x69dc, 0x69db, 0x69da, 0x69d9, 0x69d8, 0x69d7, 0x69d6, // 27192
-    0x69d5, 0x69d4, 0x69d3, 0x69d2, 0x69d1, 0x69d0, 0x69cf, 0x69ce, // 27200
-    0x69cd, 0x69cc, 0x69cb, 0x69ca, 0x69c9, 0x69c8, 0x69c7, 0x69c6, // 27208
-    0x69c5, 0x69c4, 0x69c3, 0x69c2, 0x69c1, 0x69c0, 0x69bf, 0x69be, // 27216
-    0x69bd, 0x69bc, 0x69bb, 0x69ba, 0x69b9, 0x69b8, 0x69b7, 0x69b6, // 27224
-    0x69b5, 0x69b4, 0x69b3, 0x69b2, 0x69b1, 0x69b0, 0x69af, 0x69ae, // 27232
-    0x69ad, 0x69ac, 0x69ab, 0x69aa, 0x69a9, 0x69a8, 0x69a7, 0x69a6, // 27240
-    0x69a5, 0x69a4, 0x69a3, 0x69a2, 0x69a1, 0x69a0, 0x699f, 0x699e, // 27248
-    0x699d, 0x699c, 0x699b, 0x699a, 0x6999, 0x6998, 0x6997, 0x6996, // 27256
-    0x6995, 0x6994, 0x6993, 0x6992, 0x6991, 0x6990, 0x698f, 0x698e, // 27264
-    0x698d, 0x698c, 0x698b, 0x698a, 0x6989, 0x6988, 0x6987, 0x6986, // 27272
-    0x6985, 0x6984, 0x6983, 0x6982, 0x6981, 0x6980, 0x697f, 0x697e, // 27280
-    0x697d, 0x697c, 0x697b, 0x697a, 0x6979, 0x6978, 0x6977, 0x6976, // 27288
-    0x6975, 0x6974, 0x6973, 0x6972, 0x6971, 0x6970, 0x696f, 0x696e, // 27296
-    0x696d, 0x696c, 0x696b, 0x696a, 0x6969, 0x6968, 0x6967, 0x6966, // 27304
-    0x6965, 0x6964, 0x6963, 0x6962, 0x6961, 0x6960, 0x695f, 0x695e, // 27312
-    0x695d, 0x695c, 0x695b, 0x695a, 0x6959, 0x6958, 0x6957, 0x6956, // 27320
-    0x6955, 0x6954, 0x6953, 0x6952, 0x6951, 0x6950, 0x694f, 0x694e, // 27328
-    0x694d, 0x694c, 0x694b, 0x694a, 0x6949, 0x6948, 0x6947, 0x6946, // 27336
-    0x6945, 0x6944, 0x6943, 0x6942, 0x6941, 0x6940, 0x693f, 0x693e, // 27344
-    0x693d, 0x693c, 0x693b, 0x693a, 0x6939, 0x6938, 0x6937, 0x6936, // 27352
-    0x6935, 0x6934, 0x6933, 0x6932, 0x6931, 0x6930, 0x692f, 0x692e, // 27360
-    0x692d, 0x692c, 0x692b, 0x692a, 0x6929, 0x6928, 0x6927, 0x6926, // 27368
-    0x6925, 0x6924, 0x6923, 0x6922, 0x6921, 0x6920, 0x691f, 0x691e, // 27376
-    0x691d, 0x691c, 0x691b, 0x691a, 0x6919, 0x6918, 0x6917, 0x6916, // 27384
-    0x6915, 0x6913, 0x6912, 0x6911, 0x6910, 0x690f, 0x690e, 0x690d, // 27392
-    0x690c, 0x690b, 0x690a, 0x6909, 0x6908, 0x6907, 0x6906, 0x6905, // 27400
-    0x6904, 0x6903, 0x6902, 0x6901, 0x6900, 0x68ff, 0x68fe, 0x68fd, // 27408
-    0x68fc, 0x68fb, 0x68fa, 0x68f9, 0x68f8, 0x68f7, 0x68f6, 0x68f5, // 27416
-    0x68f4, 0x68f3, 0x68f2, 0x68f1, 0x68f0, 0x68ef, 0x68ee, 0x68ed, // 27424
-    0x68ec, 0x68eb, 0x68ea, 0x68e9, 0x68e8, 0x68e7, 0x68e6, 0x68e5, // 27432
-    0x68e4, 0x68e3, 0x68e2, 0x68e1, 0x68e0, 0x68df, 0x68de, 0x68dd, // 27440
-    0x68dc, 0x68db, 0x68da, 0x68d9, 0x68d8, 0x68d7, 0x68d6, 0x68d5, // 27448
-    0x68d4, 0x68d3, 0x68d2, 0x68d1, 0x68d0, 0x68cf, 0x68ce, 0x68cd, // 27456
-    0x68cc, 0x68cb, 0x68ca, 0x68c9, 0x68c8, 0x68c7, 0x68c6, 0x68c5, // 27464
-    0x68c4, 0x68c3, 0x68c2, 0x68c1, 0x68c0, 0x68bf, 0x68be, 0x68bd, // 27472
-    0x68bc, 0x68bb, 0x68ba, 0x68b9, 0x68b8, 0x68b7, 0x68b6, 0x68b5, // 27480
-    0x68b4, 0x68b3, 0x68b2, 0x68b1, 0x68b0, 0x68af, 0x68ae, 0x68ad, // 27488
-    0x68ac, 0x68ab, 0x68aa, 0x68a9, 0x68a8, 0x68a7, 0x68a6, 0x68a5, // 27496
-    0x68a4, 0x68a3, 0x68a2, 0x68a1, 0x68a0, 0x689f, 0x689e, 0x689d, // 27504
-    0x689c, 0x689b, 0x689a, 0x6899, 0x6898, 0x6897, 0x6896, 0x6895, // 27512
-    0x6894, 0x6893, 0x6892, 0x6891, 0x6890, 0x688f, 0x688e, 0x688d, // 27520
-    0x688c, 0x688b, 0x688a, 0x6889, 0x6888, 0x6887, 0x6886, 0x6885, // 27528
-    0x6884, 0x6883, 0x6882, 0x6881, 0x6880, 0x687f, 0x687e, 0x687d, // 27536
-    0x687c, 0x687b, 0x687a, 0x6879, 0x6878, 0x6877, 0x6876, 0x6875, // 27544
-    0x6874, 0x6873, 0x6872, 0x6871, 0x6870, 0x686f, 0x686e, 0x686d, // 27552
-    0x686c, 0x686b, 0x686a, 0x6869, 0x6868, 0x6867, 0x6866, 0x6865, // 27560
-    0x6864, 0x6863, 0x6862, 0x6861, 0x6860, 0x685f, 0x685e, 0x685d, // 27568
-    0x685c, 0x685b, 0x685a, 0x6859, 0x6858, 0x6857, 0x6856, 0x6855, // 27576
-    0x6854, 0x6853, 0x6852, 0x6851, 0x6850, 0x684f, 0x684e, 0x684d, // 27584
-    0x684c, 0x684b, 0x684a, 0x6849, 0x6848, 0x6847, 0x6846, 0x6845, // 27592
-    0x6844, 0x6843, 0x6842, 0x6841, 0x6840, 0x683f, 0x683e, 0x683d, // 27600
-    0x683c, 0x683b, 0x683a, 0x6839, 0x6838, 0x6837, 0x6836, 0x6835, // 27608
-    0x6834, 0x6833, 0x6832, 0x6831, 0x6830, 0x682f, 0x682e, 0x682d, // 27616
-    0x682c, 0x682b, 0x682a, 0x6829, 0x6828, 0x6827, 0x6826, 0x6825, // 27624
-    0x6824, 0x6823, 0x6822, 0x6821, 0x6820, 0x681f, 0x681e, 0x681d, // 27632
-    0x681c, 0x681b, 0x681a, 0x6819, 0x6818, 0x6817, 0x6816, 0x6815, // 27640
-    0x6815, 0x6814, 0x6813, 0x6812, 0x6811, 0x6810, 0x680f, 0x680e, // 27648
-    0x680d, 0x680c, 0x680b, 0x680a, 0x6809, 0x6808, 0x6807, 0x6806, // 27656
-    0x6805, 0x6804, 0x6803, 0x6802, 0x6801, 0x6800, 0x67ff, 0x67fe, // 27664
-    0x67fd, 0x67fc, 0x67fb, 0x67fa, 0x67f9, 0x67f8, 0x67f7, 0x67f6, // 27672
-    0x67f5, 0x67f4, 0x67f3, 0x67f2, 0x67f1, 0x67f0, 0x67ef, 0x67ee, // 27680
-    0x67ed, 0x67ec, 0x67eb, 0x67ea, 0x67e9, 0x67e8, 0x67e7, 0x67e7, // 27688
-    0x67e6, 0x67e5, 0x67e4, 0x67e3, 0x67e2, 0x67e1, 0x67e0, 0x67df, // 27696
-    0x67de, 0x67dd, 0x67dc, 0x67db, 0x67da, 0x67d9, 0x67d8, 0x67d7, // 27704
-    0x67d6, 0x67d5, 0x67d4, 0x67d3, 0x67d2, 0x67d1, 0x67d0, 0x67cf, // 27712
-    0x67ce, 0x67cd, 0x67cc, 0x67cb, 0x67ca, 0x67c9, 0x67c8, 0x67c7, // 27720
-    0x67c6, 0x67c5, 0x67c4, 0x67c3, 0x67c2, 0x67c1, 0x67c0, 0x67bf, // 27728
-    0x67be, 0x67bd, 0x67bc, 0x67bb, 0x67ba, 0x67b9, 0x67b9, 0x67b8, // 27736
-    0x67b7, 0x67b6, 0x67b5, 0x67b4, 0x67b3, 0x67b2, 0x67b1, 0x67b0, // 27744
-    0x67af, 0x67ae, 0x67ad, 0x67ac, 0x67ab, 0x67aa, 0x67a9, 0x67a8, // 27752
-    0x67a7, 0x67a6, 0x67a5, 0x67a4, 0x67a3, 0x67a2, 0x67a1, 0x67a0, // 27760
-    0x679f, 0x679e, 0x679d, 0x679c, 0x679b, 0x679a, 0x6799, 0x6798, // 27768
-    0x6797, 0x6796, 0x6795, 0x6794, 0x6793, 0x6792, 0x6791, 0x6790, // 27776
-    0x678f, 0x678e, 0x678d, 0x678c, 0x678c, 0x678b, 0x678a, 0x6789, // 27784
-    0x6788, 0x6787, 0x6786, 0x6785, 0x6784, 0x6783, 0x6782, 0x6781, // 27792
-    0x6780, 0x677f, 0x677e, 0x677d, 0x677c, 0x677b, 0x677a, 0x6779, // 27800
-    0x6778, 0x6777, 0x6776, 0x6775, 0x6774, 0x6773, 0x6772, 0x6771, // 27808
-    0x6770, 0x676f, 0x676e, 0x676d, 0x676c, 0x676b, 0x676a, 0x6769, // 27816
-    0x6768, 0x6767, 0x6766, 0x6765, 0x6764, 0x6763, 0x6762, 0x6761, // 27824
-    0x6760, 0x675f, 0x675e, 0x675e, 0x675d, 0x675c, 0x675b, 0x675a, // 27832
-    0x6759, 0x6758, 0x6757, 0x6756, 0x6755, 0x6754, 0x6753, 0x6752, // 27840
-    0x6751, 0x6750, 0x674f, 0x674e, 0x674d, 0x674c, 0x674b, 0x674a, // 27848
-    0x6749, 0x6748, 0x6747, 0x6746, 0x6745, 0x6744, 0x6743, 0x6742, // 27856
-    0x6741, 0x6740, 0x673f, 0x673e, 0x673d, 0x673c, 0x673b, 0x673a, // 27864
-    0x6739, 0x6738, 0x6737, 0x6736, 0x6735, 0x6734, 0x6733, 0x6732, // 27872
-    0x6731, 0x6731, 0x6730, 0x672f, 0x672e, 0x672d, 0x672c, 0x672b, // 27880
-    0x672a, 0x6729, 0x6728, 0x6727, 0x6726, 0x6725, 0x6724, 0x6723, // 27888
-    0x6722, 0x6721, 0x6720, 0x671f, 0x671e, 0x671d, 0x671c, 0x671b, // 27896
-    0x671a, 0x6719, 0x6718, 0x6717, 0x6716, 0x6715, 0x6714, 0x6713, // 27904
-    0x6712, 0x6711, 0x6710, 0x670f, 0x670e, 0x670d, 0x670c, 0x670b, // 27912
-    0x670a, 0x6709, 0x6708, 0x6707, 0x6706, 0x6705, 0x6704, 0x6703, // 27920
-    0x6703, 0x6702, 0x6701, 0x6700, 0x66ff, 0x66fe, 0x66fd, 0x66fc, // 27928
-    0x66fb, 0x66fa, 0x66f9, 0x66f8, 0x66f7, 0x66f6, 0x66f5, 0x66f4, // 27936
-    0x66f3, 0x66f2, 0x66f1, 0x66f0, 0x66ef, 0x66ee, 0x66ed, 0x66ec, // 27944
-    0x66eb, 0x66ea, 0x66e9, 0x66e8, 0x66e7, 0x66e6, 0x66e5, 0x66e4, // 27952
-    0x66e3, 0x66e2, 0x66e1, 0x66e0, 0x66df, 0x66de, 0x66dd, 0x66dc, // 27960
-    0x66db, 0x66da, 0x66d9, 0x66d8, 0x66d7, 0x66d6, 0x66d6, 0x66d5, // 27968
-    0x66d4, 0x66d3, 0x66d2, 0x66d1, 0x66d0, 0x66cf, 0x66ce, 0x66cd, // 27976
-    0x66cc, 0x66cb, 0x66ca, 0x66c9, 0x66c8, 0x66c7, 0x66c6, 0x66c5, // 27984
-    0x66c4, 0x66c3, 0x66c2, 0x66c1, 0x66c0, 0x66bf, 0x66be, 0x66bd, // 27992
-    0x66bc, 0x66bb, 0x66ba, 0x66b9, 0x66b8, 0x66b7, 0x66b6, 0x66b5, // 28000
-    0x66b4, 0x66b3, 0x66b2, 0x66b1, 0x66b0, 0x66af, 0x66ae, 0x66ad, // 28008
-    0x66ac, 0x66ab, 0x66aa, 0x66a9, 0x66a8, 0x66a8, 0x66a7, 0x66a6, // 28016
-    0x66a5, 0x66a4, 0x66a3, 0x66a2, 0x66a1, 0x66a0, 0x669f, 0x669e, // 28024
-    0x669d, 0x669c, 0x669b, 0x669a, 0x6699, 0x6698, 0x6697, 0x6696, // 28032
-    0x6695, 0x6694, 0x6693, 0x6692, 0x6691, 0x6690, 0x668f, 0x668e, // 28040
-    0x668d, 0x668c, 0x668b, 0x668a, 0x6689, 0x6688, 0x6687, 0x6686, // 28048
-    0x6685, 0x6684, 0x6683, 0x6682, 0x6681, 0x6680, 0x667f, 0x667e, // 28056
-    0x667d, 0x667c, 0x667b, 0x667b, 0x667a, 0x6679, 0x6678, 0x6677, // 28064
-    0x6676, 0x6675, 0x6674, 0x6673, 0x6672, 0x6671, 0x6670, 0x666f, // 28072
-    0x666e, 0x666d, 0x666c, 0x666b, 0x666a, 0x6669, 0x6668, 0x6667, // 28080
-    0x6666, 0x6665, 0x6664, 0x6663, 0x6662, 0x6661, 0x6660, 0x665f, // 28088
-    0x665e, 0x665d, 0x665c, 0x665b, 0x665a, 0x6659, 0x6658, 0x6657, // 28096
-    0x6656, 0x6655, 0x6654, 0x6653, 0x6652, 0x6651, 0x6650, 0x664f, // 28104
-    0x664e, 0x664d, 0x664d, 0x664c, 0x664b, 0x664a, 0x6649, 0x6648, // 28112
-    0x6647, 0x6646, 0x6645, 0x6644, 0x6643, 0x6642, 0x6641, 0x6640, // 28120
-    0x663f, 0x663e, 0x663d, 0x663c, 0x663b, 0x663a, 0x6639, 0x6638, // 28128
-    0x6637, 0x6636, 0x6635, 0x6634, 0x6633, 0x6632, 0x6631, 0x6630, // 28136
-    0x662f, 0x662e, 0x662d, 0x662c, 0x662b, 0x662a, 0x6629, 0x6628, // 28144
-    0x6627, 0x6626, 0x6625, 0x6624, 0x6623, 0x6622, 0x6621, 0x6620, // 28152
-    0x6620, 0x661f, 0x661e, 0x661d, 0x661c, 0x661b, 0x661a, 0x6619, // 28160
-    0x6618, 0x6617, 0x6616, 0x6615, 0x6614, 0x6613, 0x6612, 0x6611, // 28168
-    0x6610, 0x660f, 0x660e, 0x660d, 0x660c, 0x660b, 0x660a, 0x6609, // 28176
-    0x6608, 0x6607, 0x6606, 0x6605, 0x6604, 0x6603, 0x6602, 0x6601, // 28184
-    0x6600, 0x65ff, 0x65fe, 0x65fd, 0x65fc, 0x65fb, 0x65fa, 0x65f9, // 28192
-    0x65f8, 0x65f7, 0x65f6, 0x65f5, 0x65f4, 0x65f3, 0x65f2, 0x65f2, // 28200
-    0x65f1, 0x65f0, 0x65ef, 0x65ee, 0x65ed, 0x65ec, 0x65eb, 0x65ea, // 28208
-    0x65e9, 0x65e8, 0x65e7, 0x65e6, 0x65e5, 0x65e4, 0x65e3, 0x65e2, // 28216
-    0x65e1, 0x65e0, 0x65df, 0x65de, 0x65dd, 0x65dc, 0x65db, 0x65da, // 28224
-    0x65d9, 0x65d8, 0x65d7, 0x65d6, 0x65d5, 0x65d4, 0x65d3, 0x65d2, // 28232
-    0x65d1, 0x65d0, 0x65cf, 0x65ce, 0x65cd, 0x65cc, 0x65cb, 0x65ca, // 28240
-    0x65c9, 0x65c8, 0x65c7, 0x65c6, 0x65c5, 0x65c4, 0x65c4, 0x65c3, // 28248
-    0x65c2, 0x65c1, 0x65c0, 0x65bf, 0x65be, 0x65bd, 0x65bc, 0x65bb, // 28256
-    0x65ba, 0x65b9, 0x65b8, 0x65b7, 0x65b6, 0x65b5, 0x65b4, 0x65b3, // 28264
-    0x65b2, 0x65b1, 0x65b0, 0x65af, 0x65ae, 0x65ad, 0x65ac, 0x65ab, // 28272
-    0x65aa, 0x65a9, 0x65a8, 0x65a7, 0x65a6, 0x65a5, 0x65a4, 0x65a3, // 28280
-    0x65a2, 0x65a1, 0x65a0, 0x659f, 0x659e, 0x659d, 0x659c, 0x659b, // 28288
-    0x659a, 0x6599, 0x6598, 0x6597, 0x6597, 0x6596, 0x6595, 0x6594, // 28296
-    0x6593, 0x6592, 0x6591, 0x6590, 0x658f, 0x658e, 0x658d, 0x658c, // 28304
-    0x658b, 0x658a, 0x6589, 0x6588, 0x6587, 0x6586, 0x6585, 0x6584, // 28312
-    0x6583, 0x6582, 0x6581, 0x6580, 0x657f, 0x657e, 0x657d, 0x657c, // 28320
-    0x657b, 0x657a, 0x6579, 0x6578, 0x6577, 0x6576, 0x6575, 0x6574, // 28328
-    0x6573, 0x6572, 0x6571, 0x6570, 0x656f, 0x656e, 0x656d, 0x656c, // 28336
-    0x656b, 0x656a, 0x6569, 0x6569, 0x6568, 0x6567, 0x6566, 0x6565, // 28344
-    0x6564, 0x6563, 0x6562, 0x6561, 0x6560, 0x655f, 0x655e, 0x655d, // 28352
-    0x655c, 0x655b, 0x655a, 0x6559, 0x6558, 0x6557, 0x6556, 0x6555, // 28360
-    0x6554, 0x6553, 0x6552, 0x6551, 0x6550, 0x654f, 0x654e, 0x654d, // 28368
-    0x654c, 0x654b, 0x654a, 0x6549, 0x6548, 0x6547, 0x6546, 0x6545, // 28376
-    0x6544, 0x6543, 0x6542, 0x6541, 0x6540, 0x653f, 0x653e, 0x653d, // 28384
-    0x653c, 0x653c, 0x653b, 0x653a, 0x6539, 0x6538, 0x6537, 0x6536, // 28392
-    0x6535, 0x6534, 0x6533, 0x6532, 0x6531, 0x6530, 0x652f, 0x652e, // 28400
-    0x652d, 0x652c, 0x652b, 0x652a, 0x6529, 0x6528, 0x6527, 0x6526, // 28408
-    0x6525, 0x6524, 0x6523, 0x6522, 0x6521, 0x6520, 0x651f, 0x651e, // 28416
-    0x651d, 0x651c, 0x651b, 0x651a, 0x6519, 0x6518, 0x6517, 0x6516, // 28424
-    0x6515, 0x6514, 0x6513, 0x6512, 0x6511, 0x6510, 0x650f, 0x650e, // 28432
-    0x650e, 0x650d, 0x650c, 0x650b, 0x650a, 0x6509, 0x6508, 0x6507, // 28440
-    0x6506, 0x6505, 0x6504, 0x6503, 0x6502, 0x6501, 0x6500, 0x64ff, // 28448
-    0x64fe, 0x64fd, 0x64fc, 0x64fb, 0x64fa, 0x64f9, 0x64f8, 0x64f7, // 28456
-    0x64f6, 0x64f5, 0x64f4, 0x64f3, 0x64f2, 0x64f1, 0x64f0, 0x64ef, // 28464
-    0x64ee, 0x64ed, 0x64ec, 0x64eb, 0x64ea, 0x64e9, 0x64e8, 0x64e7, // 28472
-    0x64e6, 0x64e5, 0x64e4, 0x64e3, 0x64e2, 0x64e1, 0x64e1, 0x64e0, // 28480
-    0x64df, 0x64de, 0x64dd, 0x64dc, 0x64db, 0x64da, 0x64d9, 0x64d8, // 28488
-    0x64d7, 0x64d6, 0x64d5, 0x64d4, 0x64d3, 0x64d2, 0x64d1, 0x64d0, // 28496
-    0x64cf, 0x64ce, 0x64cd, 0x64cc, 0x64cb, 0x64ca, 0x64c9, 0x64c8, // 28504
-    0x64c7, 0x64c6, 0x64c5, 0x64c4, 0x64c3, 0x64c2, 0x64c1, 0x64c0, // 28512
-    0x64bf, 0x64be, 0x64bd, 0x64bc, 0x64bb, 0x64ba, 0x64b9, 0x64b8, // 28520
-    0x64b7, 0x64b6, 0x64b5, 0x64b4, 0x64b3, 0x64b3, 0x64b2, 0x64b1, // 28528
-    0x64b0, 0x64af, 0x64ae, 0x64ad, 0x64ac, 0x64ab, 0x64aa, 0x64a9, // 28536
-    0x64a8, 0x64a7, 0x64a6, 0x64a5, 0x64a4, 0x64a3, 0x64a2, 0x64a1, // 28544
-    0x64a0, 0x649f, 0x649e, 0x649d, 0x649c, 0x649b, 0x649a, 0x6499, // 28552
-    0x6498, 0x6497, 0x6496, 0x6495, 0x6494, 0x6493, 0x6492, 0x6491, // 28560
-    0x6490, 0x648f, 0x648e, 0x648d, 0x648c, 0x648b, 0x648a, 0x6489, // 28568
-    0x6488, 0x6487, 0x6486, 0x6486, 0x6485, 0x6484, 0x6483, 0x6482, // 28576
-    0x6481, 0x6480, 0x647f, 0x647e, 0x647d, 0x647c, 0x647b, 0x647a, // 28584
-    0x6479, 0x6478, 0x6477, 0x6476, 0x6475, 0x6474, 0x6473, 0x6472, // 28592
-    0x6471, 0x6470, 0x646f, 0x646e, 0x646d, 0x646c, 0x646b, 0x646a, // 28600
-    0x6469, 0x6468, 0x6467, 0x6466, 0x6465, 0x6464, 0x6463, 0x6462, // 28608
-    0x6461, 0x6460, 0x645f, 0x645e, 0x645d, 0x645c, 0x645b, 0x645a, // 28616
-    0x6459, 0x6458, 0x6458, 0x6457, 0x6456, 0x6455, 0x6454, 0x6453, // 28624
-    0x6452, 0x6451, 0x6450, 0x644f, 0x644e, 0x644d, 0x644c, 0x644b, // 28632
-    0x644a, 0x6449, 0x6448, 0x6447, 0x6446, 0x6445, 0x6444, 0x6443, // 28640
-    0x6442, 0x6441, 0x6440, 0x643f, 0x643e, 0x643d, 0x643c, 0x643b, // 28648
-    0x643a, 0x6439, 0x6438, 0x6437, 0x6436, 0x6435, 0x6434, 0x6433, // 28656
-    0x6432, 0x6431, 0x6430, 0x642f, 0x642e, 0x642d, 0x642c, 0x642b, // 28664
-    0x642b, 0x642a, 0x6429, 0x6428, 0x6427, 0x6426, 0x6425, 0x6424, // 28672
-    0x6423, 0x6422, 0x6421, 0x6420, 0x641f, 0x641f, 0x641e, 0x641d, // 28680
-    0x641c, 0x641b, 0x641a, 0x6419, 0x6418, 0x6417, 0x6416, 0x6415, // 28688
-    0x6414, 0x6413, 0x6412, 0x6411, 0x6410, 0x640f, 0x640e, 0x640d, // 28696
-    0x640c, 0x640b, 0x640a, 0x6409, 0x6408, 0x6408, 0x6407, 0x6406, // 28704
-    0x6405, 0x6404, 0x6403, 0x6402, 0x6401, 0x6400, 0x63ff, 0x63fe, // 28712
-    0x63fd, 0x63fc, 0x63fb, 0x63fa, 0x63f9, 0x63f8, 0x63f7, 0x63f6, // 28720
-    0x63f5, 0x63f4, 0x63f3, 0x63f2, 0x63f1, 0x63f1, 0x63f0, 0x63ef, // 28728
-    0x63ee, 0x63ed, 0x63ec, 0x63eb, 0x63ea, 0x63e9, 0x63e8, 0x63e7, // 28736
-    0x63e6, 0x63e5, 0x63e4, 0x63e3, 0x63e2, 0x63e1, 0x63e0, 0x63df, // 28744
-    0x63de, 0x63dd, 0x63dc, 0x63db, 0x63da, 0x63d9, 0x63d9, 0x63d8, // 28752
-    0x63d7, 0x63d6, 0x63d5, 0x63d4, 0x63d3, 0x63d2, 0x63d1, 0x63d0, // 28760
-    0x63cf, 0x63ce, 0x63cd, 0x63cc, 0x63cb, 0x63ca, 0x63c9, 0x63c8, // 28768
-    0x63c7, 0x63c6, 0x63c5, 0x63c4, 0x63c3, 0x63c2, 0x63c2, 0x63c1, // 28776
-    0x63c0, 0x63bf, 0x63be, 0x63bd, 0x63bc, 0x63bb, 0x63ba, 0x63b9, // 28784
-    0x63b8, 0x63b7, 0x63b6, 0x63b5, 0x63b4, 0x63b3, 0x63b2, 0x63b1, // 28792
-    0x63b0, 0x63af, 0x63ae, 0x63ad, 0x63ac, 0x63ab, 0x63aa, 0x63aa, // 28800
-    0x63a9, 0x63a8, 0x63a7, 0x63a6, 0x63a5, 0x63a4, 0x63a3, 0x63a2, // 28808
-    0x63a1, 0x63a0, 0x639f, 0x639e, 0x639d, 0x639c, 0x639b, 0x639a, // 28816
-    0x6399, 0x6398, 0x6397, 0x6396, 0x6395, 0x6394, 0x6393, 0x6393, // 28824
-    0x6392, 0x6391, 0x6390, 0x638f, 0x638e, 0x638d, 0x638c, 0x638b, // 28832
-    0x638a, 0x6389, 0x6388, 0x6387, 0x6386, 0x6385, 0x6384, 0x6383, // 28840
-    0x6382, 0x6381, 0x6380, 0x637f, 0x637e, 0x637d, 0x637c, 0x637c, // 28848
-    0x637b, 0x637a, 0x6379, 0x6378, 0x6377, 0x6376, 0x6375, 0x6374, // 28856
-    0x6373, 0x6372, 0x6371, 0x6370, 0x636f, 0x636e, 0x636d, 0x636c, // 28864
-    0x636b, 0x636a, 0x6369, 0x6368, 0x6367, 0x6366, 0x6365, 0x6364, // 28872
-    0x6364, 0x6363, 0x6362, 0x6361, 0x6360, 0x635f, 0x635e, 0x635d, // 28880
-    0x635c, 0x635b, 0x635a, 0x6359, 0x6358, 0x6357, 0x6356, 0x6355, // 28888
-    0x6354, 0x6353, 0x6352, 0x6351, 0x6350, 0x634f, 0x634e, 0x634d, // 28896
-    0x634d, 0x634c, 0x634b, 0x634a, 0x6349, 0x6348, 0x6347, 0x6346, // 28904
-    0x6345, 0x6344, 0x6343, 0x6342, 0x6341, 0x6340, 0x633f, 0x633e, // 28912
-    0x633d, 0x633c, 0x633b, 0x633a, 0x6339, 0x6338, 0x6337, 0x6336, // 28920
-    0x6336, 0x6335, 0x6334, 0x6333, 0x6332, 0x6331, 0x6330, 0x632f, // 28928
-    0x632e, 0x632d, 0x632c, 0x632b, 0x632a, 0x6329, 0x6328, 0x6327, // 28936
-    0x6326, 0x6325, 0x6324, 0x6323, 0x6322, 0x6321, 0x6320, 0x631f, // 28944
-    0x631e, 0x631e, 0x631d, 0x631c, 0x631b, 0x631a, 0x6319, 0x6318, // 28952
-    0x6317, 0x6316, 0x6315, 0x6314, 0x6313, 0x6312, 0x6311, 0x6310, // 28960
-    0x630f, 0x630e, 0x630d, 0x630c, 0x630b, 0x630a, 0x6309, 0x6308, // 28968
-    0x6307, 0x6307, 0x6306, 0x6305, 0x6304, 0x6303, 0x6302, 0x6301, // 28976
-    0x6300, 0x62ff, 0x62fe, 0x62fd, 0x62fc, 0x62fb, 0x62fa, 0x62f9, // 28984
-    0x62f8, 0x62f7, 0x62f6, 0x62f5, 0x62f4, 0x62f3, 0x62f2, 0x62f1, // 28992
-    0x62f0, 0x62ef, 0x62ef, 0x62ee, 0x62ed, 0x62ec, 0x62eb, 0x62ea, // 29000
-    0x62e9, 0x62e8, 0x62e7, 0x62e6, 0x62e5, 0x62e4, 0x62e3, 0x62e2, // 29008
-    0x62e1, 0x62e0, 0x62df, 0x62de, 0x62dd, 0x62dc, 0x62db, 0x62da, // 29016
-    0x62d9, 0x62d8, 0x62d8, 0x62d7, 0x62d6, 0x62d5, 0x62d4, 0x62d3, // 29024
-    0x62d2, 0x62d1, 0x62d0, 0x62cf, 0x62ce, 0x62cd, 0x62cc, 0x62cb, // 29032
-    0x62ca, 0x62c9, 0x62c8, 0x62c7, 0x62c6, 0x62c5, 0x62c4, 0x62c3, // 29040
-    0x62c2, 0x62c1, 0x62c1, 0x62c0, 0x62bf, 0x62be, 0x62bd, 0x62bc, // 29048
-    0x62bb, 0x62ba, 0x62b9, 0x62b8, 0x62b7, 0x62b6, 0x62b5, 0x62b4, // 29056
-    0x62b3, 0x62b2, 0x62b1, 0x62b0, 0x62af, 0x62ae, 0x62ad, 0x62ac, // 29064
-    0x62ab, 0x62aa, 0x62a9, 0x62a9, 0x62a8, 0x62a7, 0x62a6, 0x62a5, // 29072
-    0x62a4, 0x62a3, 0x62a2, 0x62a1, 0x62a0, 0x629f, 0x629e, 0x629d, // 29080
-    0x629c, 0x629b, 0x629a, 0x6299, 0x6298, 0x6297, 0x6296, 0x6295, // 29088
-    0x6294, 0x6293, 0x6292, 0x6292, 0x6291, 0x6290, 0x628f, 0x628e, // 29096
-    0x628d, 0x628c, 0x628b, 0x628a, 0x6289, 0x6288, 0x6287, 0x6286, // 29104
-    0x6285, 0x6284, 0x6283, 0x6282, 0x6281, 0x6280, 0x627f, 0x627e, // 29112
-    0x627d, 0x627c, 0x627b, 0x627a, 0x627a, 0x6279, 0x6278, 0x6277, // 29120
-    0x6276, 0x6275, 0x6274, 0x6273, 0x6272, 0x6271, 0x6270, 0x626f, // 29128
-    0x626e, 0x626d, 0x626c, 0x626b, 0x626a, 0x6269, 0x6268, 0x6267, // 29136
-    0x6266, 0x6265, 0x6264, 0x6263, 0x6263, 0x6262, 0x6261, 0x6260, // 29144
-    0x625f, 0x625e, 0x625d, 0x625c, 0x625b, 0x625a, 0x6259, 0x6258, // 29152
-    0x6257, 0x6256, 0x6255, 0x6254, 0x6253, 0x6252, 0x6251, 0x6250, // 29160
-    0x624f, 0x624e, 0x624d, 0x624c, 0x624c, 0x624b, 0x624a, 0x6249, // 29168
-    0x6248, 0x6247, 0x6246, 0x6245, 0x6244, 0x6243, 0x6242, 0x6241, // 29176
-    0x6240, 0x623f, 0x623e, 0x623d, 0x623c, 0x623b, 0x623a, 0x6239, // 29184
-    0x6238, 0x6237, 0x6236, 0x6235, 0x6234, 0x6234, 0x6233, 0x6232, // 29192
-    0x6231, 0x6230, 0x622f, 0x622e, 0x622d, 0x622c, 0x622b, 0x622a, // 29200
-    0x6229, 0x6228, 0x6227, 0x6226, 0x6225, 0x6224, 0x6223, 0x6222, // 29208
-    0x6221, 0x6220, 0x621f, 0x621e, 0x621d, 0x621d, 0x621c, 0x621b, // 29216
-    0x621a, 0x6219, 0x6218, 0x6217, 0x6216, 0x6215, 0x6214, 0x6213, // 29224
-    0x6212, 0x6211, 0x6210, 0x620f, 0x620e, 0x620d, 0x620c, 0x620b, // 29232
-    0x620a, 0x6209, 0x6208, 0x6207, 0x6206, 0x6206, 0x6205, 0x6204, // 29240
-    0x6203, 0x6202, 0x6201, 0x6200, 0x61ff, 0x61fe, 0x61fd, 0x61fc, // 29248
-    0x61fb, 0x61fa, 0x61f9, 0x61f8, 0x61f7, 0x61f6, 0x61f5, 0x61f4, // 29256
-    0x61f3, 0x61f2, 0x61f1, 0x61f0, 0x61ef, 0x61ee, 0x61ee, 0x61ed, // 29264
-    0x61ec, 0x61eb, 0x61ea, 0x61e9, 0x61e8, 0x61e7, 0x61e6, 0x61e5, // 29272
-    0x61e4, 0x61e3, 0x61e2, 0x61e1, 0x61e0, 0x61df, 0x61de, 0x61dd, // 29280
-    0x61dc, 0x61db, 0x61da, 0x61d9, 0x61d8, 0x61d7, 0x61d7, 0x61d6, // 29288
-    0x61d5, 0x61d4, 0x61d3, 0x61d2, 0x61d1, 0x61d0, 0x61cf, 0x61ce, // 29296
-    0x61cd, 0x61cc, 0x61cb, 0x61ca, 0x61c9, 0x61c8, 0x61c7, 0x61c6, // 29304
-    0x61c5, 0x61c4, 0x61c3, 0x61c2, 0x61c1, 0x61c0, 0x61bf, 0x61bf, // 29312
-    0x61be, 0x61bd, 0x61bc, 0x61bb, 0x61ba, 0x61b9, 0x61b8, 0x61b7, // 29320
-    0x61b6, 0x61b5, 0x61b4, 0x61b3, 0x61b2, 0x61b1, 0x61b0, 0x61af, // 29328
-    0x61ae, 0x61ad, 0x61ac, 0x61ab, 0x61aa, 0x61a9, 0x61a8, 0x61a8, // 29336
-    0x61a7, 0x61a6, 0x61a5, 0x61a4, 0x61a3, 0x61a2, 0x61a1, 0x61a0, // 29344
-    0x619f, 0x619e, 0x619d, 0x619c, 0x619b, 0x619a, 0x6199, 0x6198, // 29352
-    0x6197, 0x6196, 0x6195, 0x6194, 0x6193, 0x6192, 0x6191, 0x6191, // 29360
-    0x6190, 0x618f, 0x618e, 0x618d, 0x618c, 0x618b, 0x618a, 0x6189, // 29368
-    0x6188, 0x6187, 0x6186, 0x6185, 0x6184, 0x6183, 0x6182, 0x6181, // 29376
-    0x6180, 0x617f, 0x617e, 0x617d, 0x617c, 0x617b, 0x617a, 0x6179, // 29384
-    0x6179, 0x6178, 0x6177, 0x6176, 0x6175, 0x6174, 0x6173, 0x6172, // 29392
-    0x6171, 0x6170, 0x616f, 0x616e, 0x616d, 0x616c, 0x616b, 0x616a, // 29400
-    0x6169, 0x6168, 0x6167, 0x6166, 0x6165, 0x6164, 0x6163, 0x6162, // 29408
-    0x6162, 0x6161, 0x6160, 0x615f, 0x615e, 0x615d, 0x615c, 0x615b, // 29416
-    0x615a, 0x6159, 0x6158, 0x6157, 0x6156, 0x6155, 0x6154, 0x6153, // 29424
-    0x6152, 0x6151, 0x6150, 0x614f, 0x614e, 0x614d, 0x614c, 0x614b, // 29432
-    0x614b, 0x614a, 0x6149, 0x6148, 0x6147, 0x6146, 0x6145, 0x6144, // 29440
-    0x6143, 0x6142, 0x6141, 0x6140, 0x613f, 0x613e, 0x613d, 0x613c, // 29448
-    0x613b, 0x613a, 0x6139, 0x6138, 0x6137, 0x6136, 0x6135, 0x6134, // 29456
-    0x6133, 0x6133, 0x6132, 0x6131, 0x6130, 0x612f, 0x612e, 0x612d, // 29464
-    0x612c, 0x612b, 0x612a, 0x6129, 0x6128, 0x6127, 0x6126, 0x6125, // 29472
-    0x6124, 0x6123, 0x6122, 0x6121, 0x6120, 0x611f, 0x611e, 0x611d, // 29480
-    0x611c, 0x611c, 0x611b, 0x611a, 0x6119, 0x6118, 0x6117, 0x6116, // 29488
-    0x6115, 0x6114, 0x6113, 0x6112, 0x6111, 0x6110, 0x610f, 0x610e, // 29496
-    0x610d, 0x610c, 0x610b, 0x610a, 0x6109, 0x6108, 0x6107, 0x6106, // 29504
-    0x6105, 0x6104, 0x6104, 0x6103, 0x6102, 0x6101, 0x6100, 0x60ff, // 29512
-    0x60fe, 0x60fd, 0x60fc, 0x60fb, 0x60fa, 0x60f9, 0x60f8, 0x60f7, // 29520
-    0x60f6, 0x60f5, 0x60f4, 0x60f3, 0x60f2, 0x60f1, 0x60f0, 0x60ef, // 29528
-    0x60ee, 0x60ed, 0x60ed, 0x60ec, 0x60eb, 0x60ea, 0x60e9, 0x60e8, // 29536
-    0x60e7, 0x60e6, 0x60e5, 0x60e4, 0x60e3, 0x60e2, 0x60e1, 0x60e0, // 29544
-    0x60df, 0x60de, 0x60dd, 0x60dc, 0x60db, 0x60da, 0x60d9, 0x60d8, // 29552
-    0x60d7, 0x60d6, 0x60d6, 0x60d5, 0x60d4, 0x60d3, 0x60d2, 0x60d1, // 29560
-    0x60d0, 0x60cf, 0x60ce, 0x60cd, 0x60cc, 0x60cb, 0x60ca, 0x60c9, // 29568
-    0x60c8, 0x60c7, 0x60c6, 0x60c5, 0x60c4, 0x60c3, 0x60c2, 0x60c1, // 29576
-    0x60c0, 0x60bf, 0x60be, 0x60be, 0x60bd, 0x60bc, 0x60bb, 0x60ba, // 29584
-    0x60b9, 0x60b8, 0x60b7, 0x60b6, 0x60b5, 0x60b4, 0x60b3, 0x60b2, // 29592
-    0x60b1, 0x60b0, 0x60af, 0x60ae, 0x60ad, 0x60ac, 0x60ab, 0x60aa, // 29600
-    0x60a9, 0x60a8, 0x60a7, 0x60a7, 0x60a6, 0x60a5, 0x60a4, 0x60a3, // 29608
-    0x60a2, 0x60a1, 0x60a0, 0x609f, 0x609e, 0x609d, 0x609c, 0x609b, // 29616
-    0x609a, 0x6099, 0x6098, 0x6097, 0x6096, 0x6095, 0x6094, 0x6093, // 29624
-    0x6092, 0x6091, 0x6090, 0x608f, 0x608f, 0x608e, 0x608d, 0x608c, // 29632
-    0x608b, 0x608a, 0x6089, 0x6088, 0x6087, 0x6086, 0x6085, 0x6084, // 29640
-    0x6083, 0x6082, 0x6081, 0x6080, 0x607f, 0x607e, 0x607d, 0x607c, // 29648
-    0x607b, 0x607a, 0x6079, 0x6078, 0x6078, 0x6077, 0x6076, 0x6075, // 29656
-    0x6074, 0x6073, 0x6072, 0x6071, 0x6070, 0x606f, 0x606e, 0x606d, // 29664
-    0x606c, 0x606b, 0x606a, 0x6069, 0x6068, 0x6067, 0x6066, 0x6065, // 29672
-    0x6064, 0x6063, 0x6062, 0x6061, 0x6061, 0x6060, 0x605f, 0x605e, // 29680
-    0x605d, 0x605c, 0x605b, 0x605a, 0x6059, 0x6058, 0x6057, 0x6056, // 29688
-    0x6056, 0x6055, 0x6054, 0x6053, 0x6052, 0x6051, 0x6050, 0x604f, // 29696
-    0x604f, 0x604e, 0x604d, 0x604c, 0x604b, 0x604a, 0x6049, 0x6048, // 29704
-    0x6047, 0x6046, 0x6045, 0x6044, 0x6043, 0x6042, 0x6041, 0x6040, // 29712
-    0x6040, 0x603f, 0x603e, 0x603d, 0x603c, 0x603b, 0x603a, 0x6039, // 29720
-    0x6038, 0x6037, 0x6036, 0x6035, 0x6034, 0x6033, 0x6032, 0x6032, // 29728
-    0x6031, 0x6030, 0x602f, 0x602e, 0x602d, 0x602c, 0x602b, 0x602a, // 29736
-    0x6029, 0x6028, 0x6027, 0x6026, 0x6025, 0x6024, 0x6023, 0x6023, // 29744
-    0x6022, 0x6021, 0x6020, 0x601f, 0x601e, 0x601d, 0x601c, 0x601b, // 29752
-    0x601a, 0x6019, 0x6018, 0x6017, 0x6016, 0x6015, 0x6015, 0x6014, // 29760
-    0x6013, 0x6012, 0x6011, 0x6010, 0x600f, 0x600e, 0x600d, 0x600c, // 29768
-    0x600b, 0x600a, 0x6009, 0x6008, 0x6007, 0x6006, 0x6006, 0x6005, // 29776
-    0x6004, 0x6003, 0x6002, 0x6001, 0x6000, 0x5fff, 0x5ffe, 0x5ffd, // 29784
-    0x5ffc, 0x5ffb, 0x5ffa, 0x5ff9, 0x5ff8, 0x5ff8, 0x5ff7, 0x5ff6, // 29792
-    0x5ff5, 0x5ff4, 0x5ff3, 0x5ff2, 0x5ff1, 0x5ff0, 0x5fef, 0x5fee, // 29800
-    0x5fed, 0x5fec, 0x5feb, 0x5fea, 0x5fe9, 0x5fe9, 0x5fe8, 0x5fe7, // 29808
-    0x5fe6, 0x5fe5, 0x5fe4, 0x5fe3, 0x5fe2, 0x5fe1, 0x5fe0, 0x5fdf, // 29816
-    0x5fde, 0x5fdd, 0x5fdc, 0x5fdb, 0x5fdb, 0x5fda, 0x5fd9, 0x5fd8, // 29824
-    0x5fd7, 0x5fd6, 0x5fd5, 0x5fd4, 0x5fd3, 0x5fd2, 0x5fd1, 0x5fd0, // 29832
-    0x5fcf, 0x5fce, 0x5fcd, 0x5fcc, 0x5fcc, 0x5fcb, 0x5fca, 0x5fc9, // 29840
-    0x5fc8, 0x5fc7, 0x5fc6, 0x5fc5, 0x5fc4, 0x5fc3, 0x5fc2, 0x5fc1, // 29848
-    0x5fc0, 0x5fbf, 0x5fbe, 0x5fbe, 0x5fbd, 0x5fbc, 0x5fbb, 0x5fba, // 29856
-    0x5fb9, 0x5fb8, 0x5fb7, 0x5fb6, 0x5fb5, 0x5fb4, 0x5fb3, 0x5fb2, // 29864
-    0x5fb1, 0x5fb0, 0x5faf, 0x5faf, 0x5fae, 0x5fad, 0x5fac, 0x5fab, // 29872
-    0x5faa, 0x5fa9, 0x5fa8, 0x5fa7, 0x5fa6, 0x5fa5, 0x5fa4, 0x5fa3, // 29880
-    0x5fa2, 0x5fa1, 0x5fa1, 0x5fa0, 0x5f9f, 0x5f9e, 0x5f9d, 0x5f9c, // 29888
-    0x5f9b, 0x5f9a, 0x5f99, 0x5f98, 0x5f97, 0x5f96, 0x5f95, 0x5f94, // 29896
-    0x5f93, 0x5f92, 0x5f92, 0x5f91, 0x5f90, 0x5f8f, 0x5f8e, 0x5f8d, // 29904
-    0x5f8c, 0x5f8b, 0x5f8a, 0x5f89, 0x5f88, 0x5f87, 0x5f86, 0x5f85, // 29912
-    0x5f84, 0x5f84, 0x5f83, 0x5f82, 0x5f81, 0x5f80, 0x5f7f, 0x5f7e, // 29920
-    0x5f7d, 0x5f7c, 0x5f7b, 0x5f7a, 0x5f79, 0x5f78, 0x5f77, 0x5f76, // 29928
-    0x5f75, 0x5f75, 0x5f74, 0x5f73, 0x5f72, 0x5f71, 0x5f70, 0x5f6f, // 29936
-    0x5f6e, 0x5f6d, 0x5f6c, 0x5f6b, 0x5f6a, 0x5f69, 0x5f68, 0x5f67, // 29944
-    0x5f67, 0x5f66, 0x5f65, 0x5f64, 0x5f63, 0x5f62, 0x5f61, 0x5f60, // 29952
-    0x5f5f, 0x5f5e, 0x5f5d, 0x5f5c, 0x5f5b, 0x5f5a, 0x5f59, 0x5f58, // 29960
-    0x5f58, 0x5f57, 0x5f56, 0x5f55, 0x5f54, 0x5f53, 0x5f52, 0x5f51, // 29968
-    0x5f50, 0x5f4f, 0x5f4e, 0x5f4d, 0x5f4c, 0x5f4b, 0x5f4a, 0x5f49, // 29976
-    0x5f49, 0x5f48, 0x5f47, 0x5f46, 0x5f45, 0x5f44, 0x5f43, 0x5f42, // 29984
-    0x5f41, 0x5f40, 0x5f3f, 0x5f3e, 0x5f3d, 0x5f3c, 0x5f3b, 0x5f3b, // 29992
-    0x5f3a, 0x5f39, 0x5f38, 0x5f37, 0x5f36, 0x5f35, 0x5f34, 0x5f33, // 30000
-    0x5f32, 0x5f31, 0x5f30, 0x5f2f, 0x5f2e, 0x5f2d, 0x5f2c, 0x5f2c, // 30008
-    0x5f2b, 0x5f2a, 0x5f29, 0x5f28, 0x5f27, 0x5f26, 0x5f25, 0x5f24, // 30016
-    0x5f23, 0x5f22, 0x5f21, 0x5f20, 0x5f1f, 0x5f1e, 0x5f1e, 0x5f1d, // 30024
-    0x5f1c, 0x5f1b, 0x5f1a, 0x5f19, 0x5f18, 0x5f17, 0x5f16, 0x5f15, // 30032
-    0x5f14, 0x5f13, 0x5f12, 0x5f11, 0x5f10, 0x5f0f, 0x5f0f, 0x5f0e, // 30040
-    0x5f0d, 0x5f0c, 0x5f0b, 0x5f0a, 0x5f09, 0x5f08, 0x5f07, 0x5f06, // 30048
-    0x5f05, 0x5f04, 0x5f03, 0x5f02, 0x5f01, 0x5f01, 0x5f00, 0x5eff, // 30056
-    0x5efe, 0x5efd, 0x5efc, 0x5efb, 0x5efa, 0x5ef9, 0x5ef8, 0x5ef7, // 30064
-    0x5ef6, 0x5ef5, 0x5ef4, 0x5ef3, 0x5ef2, 0x5ef2, 0x5ef1, 0x5ef0, // 30072
-    0x5eef, 0x5eee, 0x5eed, 0x5eec, 0x5eeb, 0x5eea, 0x5ee9, 0x5ee8, // 30080
-    0x5ee7, 0x5ee6, 0x5ee5, 0x5ee4, 0x5ee4, 0x5ee3, 0x5ee2, 0x5ee1, // 30088
-    0x5ee0, 0x5edf, 0x5ede, 0x5edd, 0x5edc, 0x5edb, 0x5eda, 0x5ed9, // 30096
-    0x5ed8, 0x5ed7, 0x5ed6, 0x5ed5, 0x5ed5, 0x5ed4, 0x5ed3, 0x5ed2, // 30104
-    0x5ed1, 0x5ed0, 0x5ecf, 0x5ece, 0x5ecd, 0x5ecc, 0x5ecb, 0x5eca, // 30112
-    0x5ec9, 0x5ec8, 0x5ec7, 0x5ec7, 0x5ec6, 0x5ec5, 0x5ec4, 0x5ec3, // 30120
-    0x5ec2, 0x5ec1, 0x5ec0, 0x5ebf, 0x5ebe, 0x5ebd, 0x5ebc, 0x5ebb, // 30128
-    0x5eba, 0x5eb9, 0x5eb8, 0x5eb8, 0x5eb7, 0x5eb6, 0x5eb5, 0x5eb4, // 30136
-    0x5eb3, 0x5eb2, 0x5eb1, 0x5eb0, 0x5eaf, 0x5eae, 0x5ead, 0x5eac, // 30144
-    0x5eab, 0x5eaa, 0x5eaa, 0x5ea9, 0x5ea8, 0x5ea7, 0x5ea6, 0x5ea5, // 30152
-    0x5ea4, 0x5ea3, 0x5ea2, 0x5ea1, 0x5ea0, 0x5e9f, 0x5e9e, 0x5e9d, // 30160
-    0x5e9c, 0x5e9b, 0x5e9b, 0x5e9a, 0x5e99, 0x5e98, 0x5e97, 0x5e96, // 30168
-    0x5e95, 0x5e94, 0x5e93, 0x5e92, 0x5e91, 0x5e90, 0x5e8f, 0x5e8e, // 30176
-    0x5e8d, 0x5e8d, 0x5e8c, 0x5e8b, 0x5e8a, 0x5e89, 0x5e88, 0x5e87, // 30184
-    0x5e86, 0x5e85, 0x5e84, 0x5e83, 0x5e82, 0x5e81, 0x5e80, 0x5e7f, // 30192
-    0x5e7e, 0x5e7e, 0x5e7d, 0x5e7c, 0x5e7b, 0x5e7a, 0x5e79, 0x5e78, // 30200
-    0x5e77, 0x5e76, 0x5e75, 0x5e74, 0x5e73, 0x5e72, 0x5e71, 0x5e70, // 30208
-    0x5e70, 0x5e6f, 0x5e6e, 0x5e6d, 0x5e6c, 0x5e6b, 0x5e6a, 0x5e69, // 30216
-    0x5e68, 0x5e67, 0x5e66, 0x5e65, 0x5e64, 0x5e63, 0x5e62, 0x5e61, // 30224
-    0x5e61, 0x5e60, 0x5e5f, 0x5e5e, 0x5e5d, 0x5e5c, 0x5e5b, 0x5e5a, // 30232
-    0x5e59, 0x5e58, 0x5e57, 0x5e56, 0x5e55, 0x5e54, 0x5e53, 0x5e53, // 30240
-    0x5e52, 0x5e51, 0x5e50, 0x5e4f, 0x5e4e, 0x5e4d, 0x5e4c, 0x5e4b, // 30248
-    0x5e4a, 0x5e49, 0x5e48, 0x5e47, 0x5e46, 0x5e45, 0x5e44, 0x5e44, // 30256
-    0x5e43, 0x5e42, 0x5e41, 0x5e40, 0x5e3f, 0x5e3e, 0x5e3d, 0x5e3c, // 30264
-    0x5e3b, 0x5e3a, 0x5e39, 0x5e38, 0x5e37, 0x5e36, 0x5e36, 0x5e35, // 30272
-    0x5e34, 0x5e33, 0x5e32, 0x5e31, 0x5e30, 0x5e2f, 0x5e2e, 0x5e2d, // 30280
-    0x5e2c, 0x5e2b, 0x5e2a, 0x5e29, 0x5e28, 0x5e27, 0x5e27, 0x5e26, // 30288
-    0x5e25, 0x5e24, 0x5e23, 0x5e22, 0x5e21, 0x5e20, 0x5e1f, 0x5e1e, // 30296
-    0x5e1d, 0x5e1c, 0x5e1b, 0x5e1a, 0x5e19, 0x5e19, 0x5e18, 0x5e17, // 30304
-    0x5e16, 0x5e15, 0x5e14, 0x5e13, 0x5e12, 0x5e11, 0x5e10, 0x5e0f, // 30312
-    0x5e0e, 0x5e0d, 0x5e0c, 0x5e0b, 0x5e0a, 0x5e0a, 0x5e09, 0x5e08, // 30320
-    0x5e07, 0x5e06, 0x5e05, 0x5e04, 0x5e03, 0x5e02, 0x5e01, 0x5e00, // 30328
-    0x5dff, 0x5dfe, 0x5dfd, 0x5dfc, 0x5dfc, 0x5dfb, 0x5dfa, 0x5df9, // 30336
-    0x5df8, 0x5df7, 0x5df6, 0x5df5, 0x5df4, 0x5df3, 0x5df2, 0x5df1, // 30344
-    0x5df0, 0x5def, 0x5dee, 0x5ded, 0x5ded, 0x5dec, 0x5deb, 0x5dea, // 30352
-    0x5de9, 0x5de8, 0x5de7, 0x5de6, 0x5de5, 0x5de4, 0x5de3, 0x5de2, // 30360
-    0x5de1, 0x5de0, 0x5ddf, 0x5ddf, 0x5dde, 0x5ddd, 0x5ddc, 0x5ddb, // 30368
-    0x5dda, 0x5dd9, 0x5dd8, 0x5dd7, 0x5dd6, 0x5dd5, 0x5dd4, 0x5dd3, // 30376
-    0x5dd2, 0x5dd1, 0x5dd0, 0x5dd0, 0x5dcf, 0x5dce, 0x5dcd, 0x5dcc, // 30384
-    0x5dcb, 0x5dca, 0x5dc9, 0x5dc8, 0x5dc7, 0x5dc6, 0x5dc5, 0x5dc4, // 30392
-    0x5dc3, 0x5dc2, 0x5dc2, 0x5dc1, 0x5dc0, 0x5dbf, 0x5dbe, 0x5dbd, // 30400
-    0x5dbc, 0x5dbb, 0x5dba, 0x5db9, 0x5db8, 0x5db7, 0x5db6, 0x5db5, // 30408
-    0x5db4, 0x5db3, 0x5db3, 0x5db2, 0x5db1, 0x5db0, 0x5daf, 0x5dae, // 30416
-    0x5dad, 0x5dac, 0x5dab, 0x5daa, 0x5da9, 0x5da8, 0x5da7, 0x5da6, // 30424
-    0x5da5, 0x5da5, 0x5da4, 0x5da3, 0x5da2, 0x5da1, 0x5da0, 0x5d9f, // 30432
-    0x5d9e, 0x5d9d, 0x5d9c, 0x5d9b, 0x5d9a, 0x5d99, 0x5d98, 0x5d97, // 30440
-    0x5d96, 0x5d96, 0x5d95, 0x5d94, 0x5d93, 0x5d92, 0x5d91, 0x5d90, // 30448
-    0x5d8f, 0x5d8e, 0x5d8d, 0x5d8c, 0x5d8b, 0x5d8a, 0x5d89, 0x5d88, // 30456
-    0x5d88, 0x5d87, 0x5d86, 0x5d85, 0x5d84, 0x5d83, 0x5d82, 0x5d81, // 30464
-    0x5d80, 0x5d7f, 0x5d7e, 0x5d7d, 0x5d7c, 0x5d7b, 0x5d7a, 0x5d79, // 30472
-    0x5d79, 0x5d78, 0x5d77, 0x5d76, 0x5d75, 0x5d74, 0x5d73, 0x5d72, // 30480
-    0x5d71, 0x5d70, 0x5d6f, 0x5d6e, 0x5d6d, 0x5d6c, 0x5d6b, 0x5d6a, // 30488
-    0x5d6a, 0x5d69, 0x5d68, 0x5d67, 0x5d66, 0x5d65, 0x5d64, 0x5d63, // 30496
-    0x5d62, 0x5d61, 0x5d60, 0x5d5f, 0x5d5e, 0x5d5d, 0x5d5c, 0x5d5c, // 30504
-    0x5d5b, 0x5d5a, 0x5d59, 0x5d58, 0x5d57, 0x5d56, 0x5d55, 0x5d54, // 30512
-    0x5d53, 0x5d52, 0x5d51, 0x5d50, 0x5d4f, 0x5d4e, 0x5d4d, 0x5d4d, // 30520
-    0x5d4c, 0x5d4b, 0x5d4a, 0x5d49, 0x5d48, 0x5d47, 0x5d46, 0x5d45, // 30528
-    0x5d44, 0x5d43, 0x5d42, 0x5d41, 0x5d40, 0x5d3f, 0x5d3f, 0x5d3e, // 30536
-    0x5d3d, 0x5d3c, 0x5d3b, 0x5d3a, 0x5d39, 0x5d38, 0x5d37, 0x5d36, // 30544
-    0x5d35, 0x5d34, 0x5d33, 0x5d32, 0x5d31, 0x5d30, 0x5d30, 0x5d2f, // 30552
-    0x5d2e, 0x5d2d, 0x5d2c, 0x5d2b, 0x5d2a, 0x5d29, 0x5d28, 0x5d27, // 30560
-    0x5d26, 0x5d25, 0x5d24, 0x5d23, 0x5d22, 0x5d22, 0x5d21, 0x5d20, // 30568
-    0x5d1f, 0x5d1e, 0x5d1d, 0x5d1c, 0x5d1b, 0x5d1a, 0x5d19, 0x5d18, // 30576
-    0x5d17, 0x5d16, 0x5d15, 0x5d14, 0x5d13, 0x5d13, 0x5d12, 0x5d11, // 30584
-    0x5d10, 0x5d0f, 0x5d0e, 0x5d0d, 0x5d0c, 0x5d0b, 0x5d0a, 0x5d09, // 30592
-    0x5d08, 0x5d07, 0x5d06, 0x5d05, 0x5d05, 0x5d04, 0x5d03, 0x5d02, // 30600
-    0x5d01, 0x5d00, 0x5cff, 0x5cfe, 0x5cfd, 0x5cfc, 0x5cfb, 0x5cfa, // 30608
-    0x5cf9, 0x5cf8, 0x5cf7, 0x5cf6, 0x5cf6, 0x5cf5, 0x5cf4, 0x5cf3, // 30616
-    0x5cf2, 0x5cf1, 0x5cf0, 0x5cef, 0x5cee, 0x5ced, 0x5cec, 0x5ceb, // 30624
-    0x5cea, 0x5ce9, 0x5ce8, 0x5ce8, 0x5ce7, 0x5ce6, 0x5ce5, 0x5ce4, // 30632
-    0x5ce3, 0x5ce2, 0x5ce1, 0x5ce0, 0x5cdf, 0x5cde, 0x5cdd, 0x5cdc, // 30640
-    0x5cdb, 0x5cda, 0x5cd9, 0x5cd9, 0x5cd8, 0x5cd7, 0x5cd6, 0x5cd5, // 30648
-    0x5cd4, 0x5cd3, 0x5cd2, 0x5cd1, 0x5cd0, 0x5ccf, 0x5cce, 0x5ccd, // 30656
-    0x5ccc, 0x5ccb, 0x5ccb, 0x5cca, 0x5cc9, 0x5cc8, 0x5cc7, 0x5cc6, // 30664
-    0x5cc5, 0x5cc4, 0x5cc3, 0x5cc2, 0x5cc1, 0x5cc0, 0x5cbf, 0x5cbe, // 30672
-    0x5cbd, 0x5cbc, 0x5cbc, 0x5cbb, 0x5cba, 0x5cb9, 0x5cb8, 0x5cb7, // 30680
-    0x5cb6, 0x5cb5, 0x5cb4, 0x5cb3, 0x5cb2, 0x5cb1, 0x5cb0, 0x5caf, // 30688
-    0x5cae, 0x5cae, 0x5cad, 0x5cac, 0x5cab, 0x5caa, 0x5ca9, 0x5ca8, // 30696
-    0x5ca7, 0x5ca6, 0x5ca5, 0x5ca4, 0x5ca3, 0x5ca2, 0x5ca1, 0x5ca0, // 30704
-    0x5c9f, 0x5c9f, 0x5c9e, 0x5c9d, 0x5c9c, 0x5c9b, 0x5c9a, 0x5c99, // 30712
-    0x5c97, 0x5c96, 0x5c95, 0x5c94, 0x5c93, 0x5c92, 0x5c91, 0x5c90, // 30720
-    0x5c8f, 0x5c8e, 0x5c8d, 0x5c8c, 0x5c8c, 0x5c8b, 0x5c8a, 0x5c89, // 30728
-    0x5c88, 0x5c87, 0x5c86, 0x5c85, 0x5c84, 0x5c83, 0x5c82, 0x5c81, // 30736
-    0x5c81, 0x5c80, 0x5c7f, 0x5c7e, 0x5c7d, 0x5c7c, 0x5c7b, 0x5c7a, // 30744
-    0x5c79, 0x5c78, 0x5c77, 0x5c76, 0x5c76, 0x5c75, 0x5c74, 0x5c73, // 30752
-    0x5c72, 0x5c71, 0x5c70, 0x5c6f, 0x5c6e, 0x5c6d, 0x5c6c, 0x5c6b, // 30760
-    0x5c6b, 0x5c6a, 0x5c69, 0x5c68, 0x5c67, 0x5c66, 0x5c65, 0x5c64, // 30768
-    0x5c63, 0x5c62, 0x5c61, 0x5c60, 0x5c60, 0x5c5f, 0x5c5e, 0x5c5d, // 30776
-    0x5c5c, 0x5c5b, 0x5c5a, 0x5c59, 0x5c58, 0x5c57, 0x5c56, 0x5c55, // 30784
-    0x5c55, 0x5c54, 0x5c53, 0x5c52, 0x5c51, 0x5c50, 0x5c4f, 0x5c4e, // 30792
-    0x5c4d, 0x5c4c, 0x5c4b, 0x5c4a, 0x5c4a, 0x5c49, 0x5c48, 0x5c47, // 30800
-    0x5c46, 0x5c45, 0x5c44, 0x5c43, 0x5c42, 0x5c41, 0x5c40, 0x5c3f, // 30808
-    0x5c3f, 0x5c3e, 0x5c3d, 0x5c3c, 0x5c3b, 0x5c3a, 0x5c39, 0x5c38, // 30816
-    0x5c37, 0x5c36, 0x5c35, 0x5c34, 0x5c34, 0x5c33, 0x5c32, 0x5c31, // 30824
-    0x5c30, 0x5c2f, 0x5c2e, 0x5c2d, 0x5c2c, 0x5c2b, 0x5c2a, 0x5c29, // 30832
-    0x5c29, 0x5c28, 0x5c27, 0x5c26, 0x5c25, 0x5c24, 0x5c23, 0x5c22, // 30840
-    0x5c21, 0x5c20, 0x5c1f, 0x5c1f, 0x5c1e, 0x5c1d, 0x5c1c, 0x5c1b, // 30848
-    0x5c1a, 0x5c19, 0x5c18, 0x5c17, 0x5c16, 0x5c15, 0x5c14, 0x5c14, // 30856
-    0x5c13, 0x5c12, 0x5c11, 0x5c10, 0x5c0f, 0x5c0e, 0x5c0d, 0x5c0c, // 30864
-    0x5c0b, 0x5c0a, 0x5c09, 0x5c09, 0x5c08, 0x5c07, 0x5c06, 0x5c05, // 30872
-    0x5c04, 0x5c03, 0x5c02, 0x5c01, 0x5c00, 0x5bff, 0x5bfe, 0x5bfe, // 30880
-    0x5bfd, 0x5bfc, 0x5bfb, 0x5bfa, 0x5bf9, 0x5bf8, 0x5bf7, 0x5bf6, // 30888
-    0x5bf5, 0x5bf4, 0x5bf3, 0x5bf3, 0x5bf2, 0x5bf1, 0x5bf0, 0x5bef, // 30896
-    0x5bee, 0x5bed, 0x5bec, 0x5beb, 0x5bea, 0x5be9, 0x5be8, 0x5be8, // 30904
-    0x5be7, 0x5be6, 0x5be5, 0x5be4, 0x5be3, 0x5be2, 0x5be1, 0x5be0, // 30912
-    0x5bdf, 0x5bde, 0x5bdd, 0x5bdd, 0x5bdc, 0x5bdb, 0x5bda, 0x5bd9, // 30920
-    0x5bd8, 0x5bd7, 0x5bd6, 0x5bd5, 0x5bd4, 0x5bd3, 0x5bd2, 0x5bd2, // 30928
-    0x5bd1, 0x5bd0, 0x5bcf, 0x5bce, 0x5bcd, 0x5bcc, 0x5bcb, 0x5bca, // 30936
-    0x5bc9, 0x5bc8, 0x5bc7, 0x5bc7, 0x5bc6, 0x5bc5, 0x5bc4, 0x5bc3, // 30944
-    0x5bc2, 0x5bc1, 0x5bc0, 0x5bbf, 0x5bbe, 0x5bbd, 0x5bbc, 0x5bbc, // 30952
-    0x5bbb, 0x5bba, 0x5bb9, 0x5bb8, 0x5bb7, 0x5bb6, 0x5bb5, 0x5bb4, // 30960
-    0x5bb3, 0x5bb2, 0x5bb1, 0x5bb1, 0x5bb0, 0x5baf, 0x5bae, 0x5bad, // 30968
-    0x5bac, 0x5bab, 0x5baa, 0x5ba9, 0x5ba8, 0x5ba7, 0x5ba7, 0x5ba6, // 30976
-    0x5ba5, 0x5ba4, 0x5ba3, 0x5ba2, 0x5ba1, 0x5ba0, 0x5b9f, 0x5b9e, // 30984
-    0x5b9d, 0x5b9c, 0x5b9c, 0x5b9b, 0x5b9a, 0x5b99, 0x5b98, 0x5b97, // 30992
-    0x5b96, 0x5b95, 0x5b94, 0x5b93, 0x5b92, 0x5b91, 0x5b91, 0x5b90, // 31000
-    0x5b8f, 0x5b8e, 0x5b8d, 0x5b8c, 0x5b8b, 0x5b8a, 0x5b89, 0x5b88, // 31008
-    0x5b87, 0x5b86, 0x5b86, 0x5b85, 0x5b84, 0x5b83, 0x5b82, 0x5b81, // 31016
-    0x5b80, 0x5b7f, 0x5b7e, 0x5b7d, 0x5b7c, 0x5b7b, 0x5b7b, 0x5b7a, // 31024
-    0x5b79, 0x5b78, 0x5b77, 0x5b76, 0x5b75, 0x5b74, 0x5b73, 0x5b72, // 31032
-    0x5b71, 0x5b70, 0x5b70, 0x5b6f, 0x5b6e, 0x5b6d, 0x5b6c, 0x5b6b, // 31040
-    0x5b6a, 0x5b69, 0x5b68, 0x5b67, 0x5b66, 0x5b65, 0x5b65, 0x5b64, // 31048
-    0x5b63, 0x5b62, 0x5b61, 0x5b60, 0x5b5f, 0x5b5e, 0x5b5d, 0x5b5c, // 31056
-    0x5b5b, 0x5b5a, 0x5b5a, 0x5b59, 0x5b58, 0x5b57, 0x5b56, 0x5b55, // 31064
-    0x5b54, 0x5b53, 0x5b52, 0x5b51, 0x5b50, 0x5b4f, 0x5b4f, 0x5b4e, // 31072
-    0x5b4d, 0x5b4c, 0x5b4b, 0x5b4a, 0x5b49, 0x5b48, 0x5b47, 0x5b46, // 31080
-    0x5b45, 0x5b44, 0x5b44, 0x5b43, 0x5b42, 0x5b41, 0x5b40, 0x5b3f, // 31088
-    0x5b3e, 0x5b3d, 0x5b3c, 0x5b3b, 0x5b3a, 0x5b39, 0x5b39, 0x5b38, // 31096
-    0x5b37, 0x5b36, 0x5b35, 0x5b34, 0x5b33, 0x5b32, 0x5b31, 0x5b30, // 31104
-    0x5b2f, 0x5b2f, 0x5b2e, 0x5b2d, 0x5b2c, 0x5b2b, 0x5b2a, 0x5b29, // 31112
-    0x5b28, 0x5b27, 0x5b26, 0x5b25, 0x5b24, 0x5b24, 0x5b23, 0x5b22, // 31120
-    0x5b21, 0x5b20, 0x5b1f, 0x5b1e, 0x5b1d, 0x5b1c, 0x5b1b, 0x5b1a, // 31128
-    0x5b19, 0x5b19, 0x5b18, 0x5b17, 0x5b16, 0x5b15, 0x5b14, 0x5b13, // 31136
-    0x5b12, 0x5b11, 0x5b10, 0x5b0f, 0x5b0e, 0x5b0e, 0x5b0d, 0x5b0c, // 31144
-    0x5b0b, 0x5b0a, 0x5b09, 0x5b08, 0x5b07, 0x5b06, 0x5b05, 0x5b04, // 31152
-    0x5b03, 0x5b03, 0x5b02, 0x5b01, 0x5b00, 0x5aff, 0x5afe, 0x5afd, // 31160
-    0x5afc, 0x5afb, 0x5afa, 0x5af9, 0x5af8, 0x5af8, 0x5af7, 0x5af6, // 31168
-    0x5af5, 0x5af4, 0x5af3, 0x5af2, 0x5af1, 0x5af0, 0x5aef, 0x5aee, // 31176
-    0x5aed, 0x5aed, 0x5aec, 0x5aeb, 0x5aea, 0x5ae9, 0x5ae8, 0x5ae7, // 31184
-    0x5ae6, 0x5ae5, 0x5ae4, 0x5ae3, 0x5ae2, 0x5ae2, 0x5ae1, 0x5ae0, // 31192
-    0x5adf, 0x5ade, 0x5add, 0x5adc, 0x5adb, 0x5ada, 0x5ad9, 0x5ad8, // 31200
-    0x5ad7, 0x5ad7, 0x5ad6, 0x5ad5, 0x5ad4, 0x5ad3, 0x5ad2, 0x5ad1, // 31208
-    0x5ad0, 0x5acf, 0x5ace, 0x5acd, 0x5acc, 0x5acc, 0x5acb, 0x5aca, // 31216
-    0x5ac9, 0x5ac8, 0x5ac7, 0x5ac6, 0x5ac5, 0x5ac4, 0x5ac3, 0x5ac2, // 31224
-    0x5ac2, 0x5ac1, 0x5ac0, 0x5abf, 0x5abe, 0x5abd, 0x5abc, 0x5abb, // 31232
-    0x5aba, 0x5ab9, 0x5ab8, 0x5ab7, 0x5ab7, 0x5ab6, 0x5ab5, 0x5ab4, // 31240
-    0x5ab3, 0x5ab2, 0x5ab1, 0x5ab0, 0x5aaf, 0x5aae, 0x5aad, 0x5aac, // 31248
-    0x5aac, 0x5aab, 0x5aaa, 0x5aa9, 0x5aa8, 0x5aa7, 0x5aa6, 0x5aa5, // 31256
-    0x5aa4, 0x5aa3, 0x5aa2, 0x5aa1, 0x5aa1, 0x5aa0, 0x5a9f, 0x5a9e, // 31264
-    0x5a9d, 0x5a9c, 0x5a9b, 0x5a9a, 0x5a99, 0x5a98, 0x5a97, 0x5a96, // 31272
-    0x5a96, 0x5a95, 0x5a94, 0x5a93, 0x5a92, 0x5a91, 0x5a90, 0x5a8f, // 31280
-    0x5a8e, 0x5a8d, 0x5a8c, 0x5a8b, 0x5a8b, 0x5a8a, 0x5a89, 0x5a88, // 31288
-    0x5a87, 0x5a86, 0x5a85, 0x5a84, 0x5a83, 0x5a82, 0x5a81, 0x5a80, // 31296
-    0x5a80, 0x5a7f, 0x5a7e, 0x5a7d, 0x5a7c, 0x5a7b, 0x5a7a, 0x5a79, // 31304
-    0x5a78, 0x5a77, 0x5a76, 0x5a75, 0x5a75, 0x5a74, 0x5a73, 0x5a72, // 31312
-    0x5a71, 0x5a70, 0x5a6f, 0x5a6e, 0x5a6d, 0x5a6c, 0x5a6b, 0x5a6a, // 31320
-    0x5a6a, 0x5a69, 0x5a68, 0x5a67, 0x5a66, 0x5a65, 0x5a64, 0x5a63, // 31328
-    0x5a62, 0x5a61, 0x5a60, 0x5a5f, 0x5a5f, 0x5a5e, 0x5a5d, 0x5a5c, // 31336
-    0x5a5b, 0x5a5a, 0x5a59, 0x5a58, 0x5a57, 0x5a56, 0x5a55, 0x5a54, // 31344
-    0x5a54, 0x5a53, 0x5a52, 0x5a51, 0x5a50, 0x5a4f, 0x5a4e, 0x5a4d, // 31352
-    0x5a4c, 0x5a4b, 0x5a4a, 0x5a4a, 0x5a49, 0x5a48, 0x5a47, 0x5a46, // 31360
-    0x5a45, 0x5a44, 0x5a43, 0x5a42, 0x5a41, 0x5a40, 0x5a3f, 0x5a3f, // 31368
-    0x5a3e, 0x5a3d, 0x5a3c, 0x5a3b, 0x5a3a, 0x5a39, 0x5a38, 0x5a37, // 31376
-    0x5a36, 0x5a35, 0x5a34, 0x5a34, 0x5a33, 0x5a32, 0x5a31, 0x5a30, // 31384
-    0x5a2f, 0x5a2e, 0x5a2d, 0x5a2c, 0x5a2b, 0x5a2a, 0x5a29, 0x5a29, // 31392
-    0x5a28, 0x5a27, 0x5a26, 0x5a25, 0x5a24, 0x5a23, 0x5a22, 0x5a21, // 31400
-    0x5a20, 0x5a1f, 0x5a1e, 0x5a1e, 0x5a1d, 0x5a1c, 0x5a1b, 0x5a1a, // 31408
-    0x5a19, 0x5a18, 0x5a17, 0x5a16, 0x5a15, 0x5a14, 0x5a13, 0x5a13, // 31416
-    0x5a12, 0x5a11, 0x5a10, 0x5a0f, 0x5a0e, 0x5a0d, 0x5a0c, 0x5a0b, // 31424
-    0x5a0a, 0x5a09, 0x5a08, 0x5a08, 0x5a07, 0x5a06, 0x5a05, 0x5a04, // 31432
-    0x5a03, 0x5a02, 0x5a01, 0x5a00, 0x59ff, 0x59fe, 0x59fd, 0x59fd, // 31440
-    0x59fc, 0x59fb, 0x59fa, 0x59f9, 0x59f8, 0x59f7, 0x59f6, 0x59f5, // 31448
-    0x59f4, 0x59f3, 0x59f2, 0x59f2, 0x59f1, 0x59f0, 0x59ef, 0x59ee, // 31456
-    0x59ed, 0x59ec, 0x59eb, 0x59ea, 0x59e9, 0x59e8, 0x59e7, 0x59e7, // 31464
-    0x59e6, 0x59e5, 0x59e4, 0x59e3, 0x59e2, 0x59e1, 0x59e0, 0x59df, // 31472
-    0x59de, 0x59dd, 0x59dc, 0x59dc, 0x59db, 0x59da, 0x59d9, 0x59d8, // 31480
-    0x59d7, 0x59d6, 0x59d5, 0x59d4, 0x59d3, 0x59d2, 0x59d2, 0x59d1, // 31488
-    0x59d0, 0x59cf, 0x59ce, 0x59cd, 0x59cc, 0x59cb, 0x59ca, 0x59c9, // 31496
-    0x59c8, 0x59c7, 0x59c7, 0x59c6, 0x59c5, 0x59c4, 0x59c3, 0x59c2, // 31504
-    0x59c1, 0x59c0, 0x59bf, 0x59be, 0x59bd, 0x59bc, 0x59bc, 0x59bb, // 31512
-    0x59ba, 0x59b9, 0x59b8, 0x59b7, 0x59b6, 0x59b5, 0x59b4, 0x59b3, // 31520
-    0x59b2, 0x59b1, 0x59b1, 0x59b0, 0x59af, 0x59ae, 0x59ad, 0x59ac, // 31528
-    0x59ab, 0x59aa, 0x59a9, 0x59a8, 0x59a7, 0x59a6, 0x59a6, 0x59a5, // 31536
-    0x59a4, 0x59a3, 0x59a2, 0x59a1, 0x59a0, 0x599f, 0x599e, 0x599d, // 31544
-    0x599c, 0x599b, 0x599b, 0x599a, 0x5999, 0x5998, 0x5997, 0x5996, // 31552
-    0x5995, 0x5994, 0x5993, 0x5992, 0x5991, 0x5990, 0x5990, 0x598f, // 31560
-    0x598e, 0x598d, 0x598c, 0x598b, 0x598a, 0x5989, 0x5988, 0x5987, // 31568
-    0x5986, 0x5985, 0x5985, 0x5984, 0x5983, 0x5982, 0x5981, 0x5980, // 31576
-    0x597f, 0x597e, 0x597d, 0x597c, 0x597b, 0x597a, 0x597a, 0x5979, // 31584
-    0x5978, 0x5977, 0x5976, 0x5975, 0x5974, 0x5973, 0x5972, 0x5971, // 31592
-    0x5970, 0x596f, 0x596f, 0x596e, 0x596d, 0x596c, 0x596b, 0x596a, // 31600
-    0x5969, 0x5968, 0x5967, 0x5966, 0x5965, 0x5964, 0x5964, 0x5963, // 31608
-    0x5962, 0x5961, 0x5960, 0x595f, 0x595e, 0x595d, 0x595c, 0x595b, // 31616
-    0x595a, 0x595a, 0x5959, 0x5958, 0x5957, 0x5956, 0x5955, 0x5954, // 31624
-    0x5953, 0x5952, 0x5951, 0x5950, 0x594f, 0x594f, 0x594e, 0x594d, // 31632
-    0x594c, 0x594b, 0x594a, 0x5949, 0x5948, 0x5947, 0x5946, 0x5945, // 31640
-    0x5944, 0x5944, 0x5943, 0x5942, 0x5941, 0x5940, 0x593f, 0x593e, // 31648
-    0x593d, 0x593c, 0x593b, 0x593a, 0x5939, 0x5939, 0x5938, 0x5937, // 31656
-    0x5936, 0x5935, 0x5934, 0x5933, 0x5932, 0x5931, 0x5930, 0x592f, // 31664
-    0x592e, 0x592e, 0x592d, 0x592c, 0x592b, 0x592a, 0x5929, 0x5928, // 31672
-    0x5927, 0x5926, 0x5925, 0x5924, 0x5923, 0x5923, 0x5922, 0x5921, // 31680
-    0x5920, 0x591f, 0x591e, 0x591d, 0x591c, 0x591b, 0x591a, 0x5919, // 31688
-    0x5918, 0x5918, 0x5917, 0x5916, 0x5915, 0x5914, 0x5913, 0x5912, // 31696
-    0x5911, 0x5910, 0x590f, 0x590e, 0x590d, 0x590d, 0x590c, 0x590b, // 31704
-    0x590a, 0x5909, 0x5908, 0x5907, 0x5906, 0x5905, 0x5904, 0x5903, // 31712
-    0x5902, 0x5902, 0x5901, 0x5900, 0x58ff, 0x58fe, 0x58fd, 0x58fc, // 31720
-    0x58fb, 0x58fa, 0x58f9, 0x58f8, 0x58f7, 0x58f7, 0x58f6, 0x58f5, // 31728
-    0x58f4, 0x58f3, 0x58f2, 0x58f1, 0x58f0, 0x58ef, 0x58ee, 0x58ed, // 31736
-    0x58eb, 0x58ea, 0x58e9, 0x58e8, 0x58e7, 0x58e7, 0x58e6, 0x58e5, // 31744
-    0x58e4, 0x58e3, 0x58e2, 0x58e1, 0x58e0, 0x58df, 0x58de, 0x58de, // 31752
-    0x58dd, 0x58dc, 0x58db, 0x58da, 0x58d9, 0x58d8, 0x58d7, 0x58d6, // 31760
-    0x58d5, 0x58d5, 0x58d4, 0x58d3, 0x58d2, 0x58d1, 0x58d0, 0x58cf, // 31768
-    0x58ce, 0x58cd, 0x58cd, 0x58cc, 0x58cb, 0x58ca, 0x58c9, 0x58c8, // 31776
-    0x58c7, 0x58c6, 0x58c5, 0x58c4, 0x58c4, 0x58c3, 0x58c2, 0x58c1, // 31784
-    0x58c0, 0x58bf, 0x58be, 0x58bd, 0x58bc, 0x58bb, 0x58bb, 0x58ba, // 31792
-    0x58b9, 0x58b8, 0x58b7, 0x58b6, 0x58b5, 0x58b4, 0x58b3, 0x58b3, // 31800
-    0x58b2, 0x58b1, 0x58b0, 0x58af, 0x58ae, 0x58ad, 0x58ac, 0x58ab, // 31808
-    0x58aa, 0x58aa, 0x58a9, 0x58a8, 0x58a7, 0x58a6, 0x58a5, 0x58a4, // 31816
-    0x58a3, 0x58a2, 0x58a1, 0x58a1, 0x58a0, 0x589f, 0x589e, 0x589d, // 31824
-    0x589c, 0x589b, 0x589a, 0x5899, 0x5899, 0x5898, 0x5897, 0x5896, // 31832
-    0x5895, 0x5894, 0x5893, 0x5892, 0x5891, 0x5890, 0x5890, 0x588f, // 31840
-    0x588e, 0x588d, 0x588c, 0x588b, 0x588a, 0x5889, 0x5888, 0x5887, // 31848
-    0x5887, 0x5886, 0x5885, 0x5884, 0x5883, 0x5882, 0x5881, 0x5880, // 31856
-    0x587f, 0x587f, 0x587e, 0x587d, 0x587c, 0x587b, 0x587a, 0x5879, // 31864
-    0x5878, 0x5877, 0x5876, 0x5876, 0x5875, 0x5874, 0x5873, 0x5872, // 31872
-    0x5871, 0x5870, 0x586f, 0x586e, 0x586d, 0x586d, 0x586c, 0x586b, // 31880
-    0x586a, 0x5869, 0x5868, 0x5867, 0x5866, 0x5865, 0x5865, 0x5864, // 31888
-    0x5863, 0x5862, 0x5861, 0x5860, 0x585f, 0x585e, 0x585d, 0x585c, // 31896
-    0x585c, 0x585b, 0x585a, 0x5859, 0x5858, 0x5857, 0x5856, 0x5855, // 31904
-    0x5854, 0x5853, 0x5853, 0x5852, 0x5851, 0x5850, 0x584f, 0x584e, // 31912
-    0x584d, 0x584c, 0x584b, 0x584b, 0x584a, 0x5849, 0x5848, 0x5847, // 31920
-    0x5846, 0x5845, 0x5844, 0x5843, 0x5842, 0x5842, 0x5841, 0x5840, // 31928
-    0x583f, 0x583e, 0x583d, 0x583c, 0x583b, 0x583a, 0x5839, 0x5839, // 31936
-    0x5838, 0x5837, 0x5836, 0x5835, 0x5834, 0x5833, 0x5832, 0x5831, // 31944
-    0x5831, 0x5830, 0x582f, 0x582e, 0x582d, 0x582c, 0x582b, 0x582a, // 31952
-    0x5829, 0x5828, 0x5828, 0x5827, 0x5826, 0x5825, 0x5824, 0x5823, // 31960
-    0x5822, 0x5821, 0x5820, 0x581f, 0x581f, 0x581e, 0x581d, 0x581c, // 31968
-    0x581b, 0x581a, 0x5819, 0x5818, 0x5817, 0x5817, 0x5816, 0x5815, // 31976
-    0x5814, 0x5813, 0x5812, 0x5811, 0x5810, 0x580f, 0x580e, 0x580e, // 31984
-    0x580d, 0x580c, 0x580b, 0x580a, 0x5809, 0x5808, 0x5807, 0x5806, // 31992
-    0x5806, 0x5805, 0x5804, 0x5803, 0x5802, 0x5801, 0x5800, 0x57ff, // 32000
-    0x57fe, 0x57fd, 0x57fd, 0x57fc, 0x57fb, 0x57fa, 0x57f9, 0x57f8, // 32008
-    0x57f7, 0x57f6, 0x57f5, 0x57f4, 0x57f4, 0x57f3, 0x57f2, 0x57f1, // 32016
-    0x57f0, 0x57ef, 0x57ee, 0x57ed, 0x57ec, 0x57ec, 0x57eb, 0x57ea, // 32024
-    0x57e9, 0x57e8, 0x57e7, 0x57e6, 0x57e5, 0x57e4, 0x57e3, 0x57e3, // 32032
-    0x57e2, 0x57e1, 0x57e0, 0x57df, 0x57de, 0x57dd, 0x57dc, 0x57db, // 32040
-    0x57da, 0x57da, 0x57d9, 0x57d8, 0x57d7, 0x57d6, 0x57d5, 0x57d4, // 32048
-    0x57d3, 0x57d2, 0x57d2, 0x57d1, 0x57d0, 0x57cf, 0x57ce, 0x57cd, // 32056
-    0x57cc, 0x57cb, 0x57ca, 0x57c9, 0x57c9, 0x57c8, 0x57c7, 0x57c6, // 32064
-    0x57c5, 0x57c4, 0x57c3, 0x57c2, 0x57c1, 0x57c0, 0x57c0, 0x57bf, // 32072
-    0x57be, 0x57bd, 0x57bc, 0x57bb, 0x57ba, 0x57b9, 0x57b8, 0x57b8, // 32080
-    0x57b7, 0x57b6, 0x57b5, 0x57b4, 0x57b3, 0x57b2, 0x57b1, 0x57b0, // 32088
-    0x57af, 0x57af, 0x57ae, 0x57ad, 0x57ac, 0x57ab, 0x57aa, 0x57a9, // 32096
-    0x57a8, 0x57a7, 0x57a6, 0x57a6, 0x57a5, 0x57a4, 0x57a3, 0x57a2, // 32104
-    0x57a1, 0x57a0, 0x579f, 0x579e, 0x579e, 0x579d, 0x579c, 0x579b, // 32112
-    0x579a, 0x5799, 0x5798, 0x5797, 0x5796, 0x5795, 0x5795, 0x5794, // 32120
-    0x5793, 0x5792, 0x5791, 0x5790, 0x578f, 0x578e, 0x578d, 0x578c, // 32128
-    0x578c, 0x578b, 0x578a, 0x5789, 0x5788, 0x5787, 0x5786, 0x5785, // 32136
-    0x5784, 0x5784, 0x5783, 0x5782, 0x5781, 0x5780, 0x577f, 0x577e, // 32144
-    0x577d, 0x577c, 0x577b, 0x577b, 0x577a, 0x5779, 0x5778, 0x5777, // 32152
-    0x5776, 0x5775, 0x5774, 0x5773, 0x5772, 0x5772, 0x5771, 0x5770, // 32160
-    0x576f, 0x576e, 0x576d, 0x576c, 0x576b, 0x576a, 0x576a, 0x5769, // 32168
-    0x5768, 0x5767, 0x5766, 0x5765, 0x5764, 0x5763, 0x5762, 0x5761, // 32176
-    0x5761, 0x5760, 0x575f, 0x575e, 0x575d, 0x575c, 0x575b, 0x575a, // 32184
-    0x5759, 0x5758, 0x5758, 0x5757, 0x5756, 0x5755, 0x5754, 0x5753, // 32192
-    0x5752, 0x5751, 0x5750, 0x5750, 0x574f, 0x574e, 0x574d, 0x574c, // 32200
-    0x574b, 0x574a, 0x5749, 0x5748, 0x5747, 0x5747, 0x5746, 0x5745, // 32208
-    0x5744, 0x5743, 0x5742, 0x5741, 0x5740, 0x573f, 0x573e, 0x573e, // 32216
-    0x573d, 0x573c, 0x573b, 0x573a, 0x5739, 0x5738, 0x5737, 0x5736, // 32224
-    0x5736, 0x5735, 0x5734, 0x5733, 0x5732, 0x5731, 0x5730, 0x572f, // 32232
-    0x572e, 0x572d, 0x572d, 0x572c, 0x572b, 0x572a, 0x5729, 0x5728, // 32240
-    0x5727, 0x5726, 0x5725, 0x5724, 0x5724, 0x5723, 0x5722, 0x5721, // 32248
-    0x5720, 0x571f, 0x571e, 0x571d, 0x571c, 0x571c, 0x571b, 0x571a, // 32256
-    0x5719, 0x5718, 0x5717, 0x5716, 0x5715, 0x5714, 0x5713, 0x5713, // 32264
-    0x5712, 0x5711, 0x5710, 0x570f, 0x570e, 0x570d, 0x570c, 0x570b, // 32272
-    0x570a, 0x570a, 0x5709, 0x5708, 0x5707, 0x5706, 0x5705, 0x5704, // 32280
-    0x5703, 0x5702, 0x5702, 0x5701, 0x5700, 0x56ff, 0x56fe, 0x56fd, // 32288
-    0x56fc, 0x56fb, 0x56fa, 0x56f9, 0x56f9, 0x56f8, 0x56f7, 0x56f6, // 32296
-    0x56f5, 0x56f4, 0x56f3, 0x56f2, 0x56f1, 0x56f0, 0x56f0, 0x56ef, // 32304
-    0x56ee, 0x56ed, 0x56ec, 0x56eb, 0x56ea, 0x56e9, 0x56e8, 0x56e8, // 32312
-    0x56e7, 0x56e6, 0x56e5, 0x56e4, 0x56e3, 0x56e2, 0x56e1, 0x56e0, // 32320
-    0x56df, 0x56df, 0x56de, 0x56dd, 0x56dc, 0x56db, 0x56da, 0x56d9, // 32328
-    0x56d8, 0x56d7, 0x56d6, 0x56d6, 0x56d5, 0x56d4, 0x56d3, 0x56d2, // 32336
-    0x56d1, 0x56d0, 0x56cf, 0x56ce, 0x56ce, 0x56cd, 0x56cc, 0x56cb, // 32344
-    0x56ca, 0x56c9, 0x56c8, 0x56c7, 0x56c6, 0x56c5, 0x56c5, 0x56c4, // 32352
-    0x56c3, 0x56c2, 0x56c1, 0x56c0, 0x56bf, 0x56be, 0x56bd, 0x56bc, // 32360
-    0x56bc, 0x56bb, 0x56ba, 0x56b9, 0x56b8, 0x56b7, 0x56b6, 0x56b5, // 32368
-    0x56b4, 0x56b4, 0x56b3, 0x56b2, 0x56b1, 0x56b0, 0x56af, 0x56ae, // 32376
-    0x56ad, 0x56ac, 0x56ab, 0x56ab, 0x56aa, 0x56a9, 0x56a8, 0x56a7, // 32384
-    0x56a6, 0x56a5, 0x56a4, 0x56a3, 0x56a2, 0x56a2, 0x56a1, 0x56a0, // 32392
-    0x569f, 0x569e, 0x569d, 0x569c, 0x569b, 0x569a, 0x569a, 0x5699, // 32400
-    0x5698, 0x5697, 0x5696, 0x5695, 0x5694, 0x5693, 0x5692, 0x5691, // 32408
-    0x5691, 0x5690, 0x568f, 0x568e, 0x568d, 0x568c, 0x568b, 0x568a, // 32416
-    0x5689, 0x5688, 0x5688, 0x5687, 0x5686, 0x5685, 0x5684, 0x5683, // 32424
-    0x5682, 0x5681, 0x5680, 0x5680, 0x567f, 0x567e, 0x567d, 0x567c, // 32432
-    0x567b, 0x567a, 0x5679, 0x5678, 0x5677, 0x5677, 0x5676, 0x5675, // 32440
-    0x5674, 0x5673, 0x5672, 0x5671, 0x5670, 0x566f, 0x566e, 0x566e, // 32448
-    0x566d, 0x566c, 0x566b, 0x566a, 0x5669, 0x5668, 0x5667, 0x5666, // 32456
-    0x5666, 0x5665, 0x5664, 0x5663, 0x5662, 0x5661, 0x5660, 0x565f, // 32464
-    0x565e, 0x565d, 0x565d, 0x565c, 0x565b, 0x565a, 0x5659, 0x5658, // 32472
-    0x5657, 0x5656, 0x5655, 0x5654, 0x5654, 0x5653, 0x5652, 0x5651, // 32480
-    0x5650, 0x564f, 0x564e, 0x564d, 0x564c, 0x564c, 0x564b, 0x564a, // 32488
-    0x5649, 0x5648, 0x5647, 0x5646, 0x5645, 0x5644, 0x5643, 0x5643, // 32496
-    0x5642, 0x5641, 0x5640, 0x563f, 0x563e, 0x563d, 0x563c, 0x563b, // 32504
-    0x563b, 0x563a, 0x5639, 0x5638, 0x5637, 0x5636, 0x5635, 0x5634, // 32512
-    0x5633, 0x5632, 0x5632, 0x5631, 0x5630, 0x562f, 0x562e, 0x562d, // 32520
-    0x562c, 0x562b, 0x562a, 0x5629, 0x5629, 0x5628, 0x5627, 0x5626, // 32528
-    0x5625, 0x5624, 0x5623, 0x5622, 0x5621, 0x5621, 0x5620, 0x561f, // 32536
-    0x561e, 0x561d, 0x561c, 0x561b, 0x561a, 0x5619, 0x5618, 0x5618, // 32544
-    0x5617, 0x5616, 0x5615, 0x5614, 0x5613, 0x5612, 0x5611, 0x5610, // 32552
-    0x560f, 0x560f, 0x560e, 0x560d, 0x560c, 0x560b, 0x560a, 0x5609, // 32560
-    0x5608, 0x5607, 0x5607, 0x5606, 0x5605, 0x5604, 0x5603, 0x5602, // 32568
-    0x5601, 0x5600, 0x55ff, 0x55fe, 0x55fe, 0x55fd, 0x55fc, 0x55fb, // 32576
-    0x55fa, 0x55f9, 0x55f8, 0x55f7, 0x55f6, 0x55f5, 0x55f5, 0x55f4, // 32584
-    0x55f3, 0x55f2, 0x55f1, 0x55f0, 0x55ef, 0x55ee, 0x55ed, 0x55ed, // 32592
-    0x55ec, 0x55eb, 0x55ea, 0x55e9, 0x55e8, 0x55e7, 0x55e6, 0x55e5, // 32600
-    0x55e4, 0x55e4, 0x55e3, 0x55e2, 0x55e1, 0x55e0, 0x55df, 0x55de, // 32608
-    0x55dd, 0x55dc, 0x55db, 0x55db, 0x55da, 0x55d9, 0x55d8, 0x55d7, // 32616
-    0x55d6, 0x55d5, 0x55d4, 0x55d3, 0x55d3, 0x55d2, 0x55d1, 0x55d0, // 32624
-    0x55cf, 0x55ce, 0x55cd, 0x55cc, 0x55cb, 0x55ca, 0x55ca, 0x55c9, // 32632
-    0x55c8, 0x55c7, 0x55c6, 0x55c5, 0x55c4, 0x55c3, 0x55c2, 0x55c1, // 32640
-    0x55c1, 0x55c0, 0x55bf, 0x55be, 0x55bd, 0x55bc, 0x55bb, 0x55ba, // 32648
-    0x55b9, 0x55b9, 0x55b8, 0x55b7, 0x55b6, 0x55b5, 0x55b4, 0x55b3, // 32656
-    0x55b2, 0x55b1, 0x55b0, 0x55b0, 0x55af, 0x55ae, 0x55ad, 0x55ac, // 32664
-    0x55ab, 0x55aa, 0x55a9, 0x55a8, 0x55a7, 0x55a7, 0x55a6, 0x55a5, // 32672
-    0x55a4, 0x55a3, 0x55a2, 0x55a1, 0x55a0, 0x559f, 0x559f, 0x559e, // 32680
-    0x559d, 0x559c, 0x559b, 0x559a, 0x5599, 0x5598, 0x5597, 0x5596, // 32688
-    0x5596, 0x5595, 0x5594, 0x5593, 0x5592, 0x5591, 0x5590, 0x558f, // 32696
-    0x558e, 0x558d, 0x558d, 0x558c, 0x558b, 0x558a, 0x5589, 0x5588, // 32704
-    0x5587, 0x5586, 0x5585, 0x5585, 0x5584, 0x5583, 0x5582, 0x5581, // 32712
-    0x5580, 0x557f, 0x557e, 0x557d, 0x557c, 0x557c, 0x557b, 0x557a, // 32720
-    0x5579, 0x5578, 0x5577, 0x5576, 0x5575, 0x5574, 0x5573, 0x5573, // 32728
-    0x5572, 0x5571, 0x5570, 0x556f, 0x556e, 0x556d, 0x556c, 0x556b, // 32736
-    0x556b, 0x556a, 0x5569, 0x5568, 0x5567, 0x5566, 0x5565, 0x5564, // 32744
-    0x5563, 0x5562, 0x5562, 0x5561, 0x5560, 0x555f, 0x555e, 0x555d, // 32752
-    0x555c, 0x555b, 0x555a, 0x5559, 0x5559, 0x5558, 0x5557, 0x5556, // 32760
-    0x5555, 0x5554, 0x5553, 0x5552, 0x5551, 0x5550, 0x554f, 0x554e, // 32768
-    0x554d, 0x554d, 0x554c, 0x554b, 0x554a, 0x5549, 0x5548, 0x5547, // 32776
-    0x5546, 0x5546, 0x5545, 0x5544, 0x5543, 0x5542, 0x5541, 0x5540, // 32784
-    0x553f, 0x553e, 0x553e, 0x553d, 0x553c, 0x553b, 0x553a, 0x5539, // 32792
-    0x5538, 0x5537, 0x5537, 0x5536, 0x5535, 0x5534, 0x5533, 0x5532, // 32800
-    0x5531, 0x5530, 0x5530, 0x552f, 0x552e, 0x552d, 0x552c, 0x552b, // 32808
-    0x552a, 0x5529, 0x5528, 0x5528, 0x5527, 0x5526, 0x5525, 0x5524, // 32816
-    0x5523, 0x5522, 0x5521, 0x5521, 0x5520, 0x551f, 0x551e, 0x551d, // 32824
-    0x551c, 0x551b, 0x551a, 0x5519, 0x5519, 0x5518, 0x5517, 0x5516, // 32832
-    0x5515, 0x5514, 0x5513, 0x5512, 0x5512, 0x5511, 0x5510, 0x550f, // 32840
-    0x550e, 0x550d, 0x550c, 0x550b, 0x550b, 0x550a, 0x5509, 0x5508, // 32848
-    0x5507, 0x5506, 0x5505, 0x5504, 0x5503, 0x5503, 0x5502, 0x5501, // 32856
-    0x5500, 0x54ff, 0x54fe, 0x54fd, 0x54fc, 0x54fc, 0x54fb, 0x54fa, // 32864
-    0x54f9, 0x54f8, 0x54f7, 0x54f6, 0x54f5, 0x54f4, 0x54f4, 0x54f3, // 32872
-    0x54f2, 0x54f1, 0x54f0, 0x54ef, 0x54ee, 0x54ed, 0x54ed, 0x54ec, // 32880
-    0x54eb, 0x54ea, 0x54e9, 0x54e8, 0x54e7, 0x54e6, 0x54e6, 0x54e5, // 32888
-    0x54e4, 0x54e3, 0x54e2, 0x54e1, 0x54e0, 0x54df, 0x54de, 0x54de, // 32896
-    0x54dd, 0x54dc, 0x54db, 0x54da, 0x54d9, 0x54d8, 0x54d7, 0x54d7, // 32904
-    0x54d6, 0x54d5, 0x54d4, 0x54d3, 0x54d2, 0x54d1, 0x54d0, 0x54cf, // 32912
-    0x54cf, 0x54ce, 0x54cd, 0x54cc, 0x54cb, 0x54ca, 0x54c9, 0x54c8, // 32920
-    0x54c8, 0x54c7, 0x54c6, 0x54c5, 0x54c4, 0x54c3, 0x54c2, 0x54c1, // 32928
-    0x54c1, 0x54c0, 0x54bf, 0x54be, 0x54bd, 0x54bc, 0x54bb, 0x54ba, // 32936
-    0x54b9, 0x54b9, 0x54b8, 0x54b7, 0x54b6, 0x54b5, 0x54b4, 0x54b3, // 32944
-    0x54b2, 0x54b2, 0x54b1, 0x54b0, 0x54af, 0x54ae, 0x54ad, 0x54ac, // 32952
-    0x54ab, 0x54aa, 0x54aa, 0x54a9, 0x54a8, 0x54a7, 0x54a6, 0x54a5, // 32960
-    0x54a4, 0x54a3, 0x54a3, 0x54a2, 0x54a1, 0x54a0, 0x549f, 0x549e, // 32968
-    0x549d, 0x549c, 0x549c, 0x549b, 0x549a, 0x5499, 0x5498, 0x5497, // 32976
-    0x5496, 0x5495, 0x5494, 0x5494, 0x5493, 0x5492, 0x5491, 0x5490, // 32984
-    0x548f, 0x548e, 0x548d, 0x548d, 0x548c, 0x548b, 0x548a, 0x5489, // 32992
-    0x5488, 0x5487, 0x5486, 0x5485, 0x5485, 0x5484, 0x5483, 0x5482, // 33000
-    0x5481, 0x5480, 0x547f, 0x547e, 0x547e, 0x547d, 0x547c, 0x547b, // 33008
-    0x547a, 0x5479, 0x5478, 0x5477, 0x5477, 0x5476, 0x5475, 0x5474, // 33016
-    0x5473, 0x5472, 0x5471, 0x5470, 0x546f, 0x546f, 0x546e, 0x546d, // 33024
-    0x546c, 0x546b, 0x546a, 0x5469, 0x5468, 0x5468, 0x5467, 0x5466, // 33032
-    0x5465, 0x5464, 0x5463, 0x5462, 0x5461, 0x5461, 0x5460, 0x545f, // 33040
-    0x545e, 0x545d, 0x545c, 0x545b, 0x545a, 0x5459, 0x5459, 0x5458, // 33048
-    0x5457, 0x5456, 0x5455, 0x5454, 0x5453, 0x5452, 0x5452, 0x5451, // 33056
-    0x5450, 0x544f, 0x544e, 0x544d, 0x544c, 0x544b, 0x544a, 0x544a, // 33064
-    0x5449, 0x5448, 0x5447, 0x5446, 0x5445, 0x5444, 0x5443, 0x5443, // 33072
-    0x5442, 0x5441, 0x5440, 0x543f, 0x543e, 0x543d, 0x543c, 0x543c, // 33080
-    0x543b, 0x543a, 0x5439, 0x5438, 0x5437, 0x5436, 0x5435, 0x5434, // 33088
-    0x5434, 0x5433, 0x5432, 0x5431, 0x5430, 0x542f, 0x542e, 0x542d, // 33096
-    0x542d, 0x542c, 0x542b, 0x542a, 0x5429, 0x5428, 0x5427, 0x5426, // 33104
-    0x5425, 0x5425, 0x5424, 0x5423, 0x5422, 0x5421, 0x5420, 0x541f, // 33112
-    0x541e, 0x541e, 0x541d, 0x541c, 0x541b, 0x541a, 0x5419, 0x5418, // 33120
-    0x5417, 0x5417, 0x5416, 0x5415, 0x5414, 0x5413, 0x5412, 0x5411, // 33128
-    0x5410, 0x540f, 0x540f, 0x540e, 0x540d, 0x540c, 0x540b, 0x540a, // 33136
-    0x5409, 0x5408, 0x5408, 0x5407, 0x5406, 0x5405, 0x5404, 0x5403, // 33144
-    0x5402, 0x5401, 0x5400, 0x5400, 0x53ff, 0x53fe, 0x53fd, 0x53fc, // 33152
-    0x53fb, 0x53fa, 0x53f9, 0x53f9, 0x53f8, 0x53f7, 0x53f6, 0x53f5, // 33160
-    0x53f4, 0x53f3, 0x53f2, 0x53f2, 0x53f1, 0x53f0, 0x53ef, 0x53ee, // 33168
-    0x53ed, 0x53ec, 0x53eb, 0x53ea, 0x53ea, 0x53e9, 0x53e8, 0x53e7, // 33176
-    0x53e6, 0x53e5, 0x53e4, 0x53e3, 0x53e3, 0x53e2, 0x53e1, 0x53e0, // 33184
-    0x53df, 0x53de, 0x53dd, 0x53dc, 0x53db, 0x53db, 0x53da, 0x53d9, // 33192
-    0x53d8, 0x53d7, 0x53d6, 0x53d5, 0x53d4, 0x53d4, 0x53d3, 0x53d2, // 33200
-    0x53d1, 0x53d0, 0x53cf, 0x53ce, 0x53cd, 0x53cd, 0x53cc, 0x53cb, // 33208
-    0x53ca, 0x53c9, 0x53c8, 0x53c7, 0x53c6, 0x53c5, 0x53c5, 0x53c4, // 33216
-    0x53c3, 0x53c2, 0x53c1, 0x53c0, 0x53bf, 0x53be, 0x53be, 0x53bd, // 33224
-    0x53bc, 0x53bb, 0x53ba, 0x53b9, 0x53b8, 0x53b7, 0x53b6, 0x53b6, // 33232
-    0x53b5, 0x53b4, 0x53b3, 0x53b2, 0x53b1, 0x53b0, 0x53af, 0x53af, // 33240
-    0x53ae, 0x53ad, 0x53ac, 0x53ab, 0x53aa, 0x53a9, 0x53a8, 0x53a8, // 33248
-    0x53a7, 0x53a6, 0x53a5, 0x53a4, 0x53a3, 0x53a2, 0x53a1, 0x53a0, // 33256
-    0x53a0, 0x539f, 0x539e, 0x539d, 0x539c, 0x539b, 0x539a, 0x5399, // 33264
-    0x5399, 0x5398, 0x5397, 0x5396, 0x5395, 0x5394, 0x5393, 0x5392, // 33272
-    0x5392, 0x5391, 0x5390, 0x538f, 0x538e, 0x538d, 0x538c, 0x538b, // 33280
-    0x538a, 0x538a, 0x5389, 0x5388, 0x5387, 0x5386, 0x5385, 0x5384, // 33288
-    0x5383, 0x5383, 0x5382, 0x5381, 0x5380, 0x537f, 0x537e, 0x537d, // 33296
-    0x537c, 0x537b, 0x537b, 0x537a, 0x5379, 0x5378, 0x5377, 0x5376, // 33304
-    0x5375, 0x5374, 0x5374, 0x5373, 0x5372, 0x5371, 0x5370, 0x536f, // 33312
-    0x536e, 0x536d, 0x536d, 0x536c, 0x536b, 0x536a, 0x5369, 0x5368, // 33320
-    0x5367, 0x5366, 0x5365, 0x5365, 0x5364, 0x5363, 0x5362, 0x5361, // 33328
-    0x5360, 0x535f, 0x535e, 0x535e, 0x535d, 0x535c, 0x535b, 0x535a, // 33336
-    0x5359, 0x5358, 0x5357, 0x5356, 0x5356, 0x5355, 0x5354, 0x5353, // 33344
-    0x5352, 0x5351, 0x5350, 0x534f, 0x534f, 0x534e, 0x534d, 0x534c, // 33352
-    0x534b, 0x534a, 0x5349, 0x5348, 0x5348, 0x5347, 0x5346, 0x5345, // 33360
-    0x5344, 0x5343, 0x5342, 0x5341, 0x5340, 0x5340, 0x533f, 0x533e, // 33368
-    0x533d, 0x533c, 0x533b, 0x533a, 0x5339, 0x5339, 0x5338, 0x5337, // 33376
-    0x5336, 0x5335, 0x5334, 0x5333, 0x5332, 0x5331, 0x5331, 0x5330, // 33384
-    0x532f, 0x532e, 0x532d, 0x532c, 0x532b, 0x532a, 0x532a, 0x5329, // 33392
-    0x5328, 0x5327, 0x5326, 0x5325, 0x5324, 0x5323, 0x5323, 0x5322, // 33400
-    0x5321, 0x5320, 0x531f, 0x531e, 0x531d, 0x531c, 0x531b, 0x531b, // 33408
-    0x531a, 0x5319, 0x5318, 0x5317, 0x5316, 0x5315, 0x5314, 0x5314, // 33416
-    0x5313, 0x5312, 0x5311, 0x5310, 0x530f, 0x530e, 0x530d, 0x530c, // 33424
-    0x530c, 0x530b, 0x530a, 0x5309, 0x5308, 0x5307, 0x5306, 0x5305, // 33432
-    0x5305, 0x5304, 0x5303, 0x5302, 0x5301, 0x5300, 0x52ff, 0x52fe, // 33440
-    0x52fe, 0x52fd, 0x52fc, 0x52fb, 0x52fa, 0x52f9, 0x52f8, 0x52f7, // 33448
-    0x52f6, 0x52f6, 0x52f5, 0x52f4, 0x52f3, 0x52f2, 0x52f1, 0x52f0, // 33456
-    0x52ef, 0x52ef, 0x52ee, 0x52ed, 0x52ec, 0x52eb, 0x52ea, 0x52e9, // 33464
-    0x52e8, 0x52e7, 0x52e7, 0x52e6, 0x52e5, 0x52e4, 0x52e3, 0x52e2, // 33472
-    0x52e1, 0x52e0, 0x52e0, 0x52df, 0x52de, 0x52dd, 0x52dc, 0x52db, // 33480
-    0x52da, 0x52d9, 0x52d9, 0x52d8, 0x52d7, 0x52d6, 0x52d5, 0x52d4, // 33488
-    0x52d3, 0x52d2, 0x52d1, 0x52d1, 0x52d0, 0x52cf, 0x52ce, 0x52cd, // 33496
-    0x52cc, 0x52cb, 0x52ca, 0x52ca, 0x52c9, 0x52c8, 0x52c7, 0x52c6, // 33504
-    0x52c5, 0x52c4, 0x52c3, 0x52c2, 0x52c2, 0x52c1, 0x52c0, 0x52bf, // 33512
-    0x52be, 0x52bd, 0x52bc, 0x52bb, 0x52bb, 0x52ba, 0x52b9, 0x52b8, // 33520
-    0x52b7, 0x52b6, 0x52b5, 0x52b4, 0x52b4, 0x52b3, 0x52b2, 0x52b1, // 33528
-    0x52b0, 0x52af, 0x52ae, 0x52ad, 0x52ac, 0x52ac, 0x52ab, 0x52aa, // 33536
-    0x52a9, 0x52a8, 0x52a7, 0x52a6, 0x52a5, 0x52a5, 0x52a4, 0x52a3, // 33544
-    0x52a2, 0x52a1, 0x52a0, 0x529f, 0x529e, 0x529e, 0x529d, 0x529c, // 33552
-    0x529b, 0x529a, 0x5299, 0x5298, 0x5297, 0x5296, 0x5296, 0x5295, // 33560
-    0x5294, 0x5293, 0x5292, 0x5291, 0x5290, 0x528f, 0x528f, 0x528e, // 33568
-    0x528d, 0x528c, 0x528b, 0x528a, 0x5289, 0x5288, 0x5287, 0x5287, // 33576
-    0x5286, 0x5285, 0x5284, 0x5283, 0x5282, 0x5281, 0x5280, 0x5280, // 33584
-    0x527f, 0x527e, 0x527d, 0x527c, 0x527b, 0x527a, 0x5279, 0x5279, // 33592
-    0x5278, 0x5277, 0x5276, 0x5275, 0x5274, 0x5273, 0x5272, 0x5271, // 33600
-    0x5271, 0x5270, 0x526f, 0x526e, 0x526d, 0x526c, 0x526b, 0x526a, // 33608
-    0x526a, 0x5269, 0x5268, 0x5267, 0x5266, 0x5265, 0x5264, 0x5263, // 33616
-    0x5262, 0x5262, 0x5261, 0x5260, 0x525f, 0x525e, 0x525d, 0x525c, // 33624
-    0x525b, 0x525b, 0x525a, 0x5259, 0x5258, 0x5257, 0x5256, 0x5255, // 33632
-    0x5254, 0x5254, 0x5253, 0x5252, 0x5251, 0x5250, 0x524f, 0x524e, // 33640
-    0x524d, 0x524c, 0x524c, 0x524b, 0x524a, 0x5249, 0x5248, 0x5247, // 33648
-    0x5246, 0x5245, 0x5245, 0x5244, 0x5243, 0x5242, 0x5241, 0x5240, // 33656
-    0x523f, 0x523e, 0x523d, 0x523d, 0x523c, 0x523b, 0x523a, 0x5239, // 33664
-    0x5238, 0x5237, 0x5236, 0x5236, 0x5235, 0x5234, 0x5233, 0x5232, // 33672
-    0x5231, 0x5230, 0x522f, 0x522f, 0x522e, 0x522d, 0x522c, 0x522b, // 33680
-    0x522a, 0x5229, 0x5228, 0x5227, 0x5227, 0x5226, 0x5225, 0x5224, // 33688
-    0x5223, 0x5222, 0x5221, 0x5220, 0x5220, 0x521f, 0x521e, 0x521d, // 33696
-    0x521c, 0x521b, 0x521a, 0x5219, 0x5218, 0x5218, 0x5217, 0x5216, // 33704
-    0x5215, 0x5214, 0x5213, 0x5212, 0x5211, 0x5211, 0x5210, 0x520f, // 33712
-    0x520e, 0x520d, 0x520c, 0x520b, 0x520a, 0x520a, 0x5209, 0x5208, // 33720
-    0x5207, 0x5206, 0x5205, 0x5204, 0x5203, 0x5202, 0x5202, 0x5201, // 33728
-    0x5200, 0x51ff, 0x51fe, 0x51fd, 0x51fc, 0x51fb, 0x51fb, 0x51fa, // 33736
-    0x51f9, 0x51f8, 0x51f7, 0x51f6, 0x51f5, 0x51f4, 0x51f3, 0x51f3, // 33744
-    0x51f2, 0x51f1, 0x51f0, 0x51ef, 0x51ee, 0x51ed, 0x51ec, 0x51ec, // 33752
-    0x51eb, 0x51ea, 0x51e9, 0x51e8, 0x51e7, 0x51e6, 0x51e5, 0x51e5, // 33760
-    0x51e4, 0x51e3, 0x51e2, 0x51e1, 0x51e0, 0x51df, 0x51de, 0x51dd, // 33768
-    0x51dd, 0x51dc, 0x51db, 0x51da, 0x51d9, 0x51d8, 0x51d7, 0x51d6, // 33776
-    0x51d6, 0x51d5, 0x51d4, 0x51d3, 0x51d2, 0x51d1, 0x51d0, 0x51cf, // 33784
-    0x51cf, 0x51ce, 0x51cd, 0x51cc, 0x51cc, 0x51cb, 0x51ca, 0x51c9, // 33792
-    0x51c8, 0x51c7, 0x51c6, 0x51c6, 0x51c5, 0x51c4, 0x51c3, 0x51c2, // 33800
-    0x51c1, 0x51c0, 0x51bf, 0x51bf, 0x51be, 0x51bd, 0x51bc, 0x51bb, // 33808
-    0x51ba, 0x51b9, 0x51b9, 0x51b8, 0x51b7, 0x51b6, 0x51b5, 0x51b4, // 33816
-    0x51b3, 0x51b3, 0x51b2, 0x51b1, 0x51b0, 0x51af, 0x51ae, 0x51ad, // 33824
-    0x51ad, 0x51ac, 0x51ab, 0x51aa, 0x51a9, 0x51a8, 0x51a7, 0x51a7, // 33832
-    0x51a6, 0x51a5, 0x51a4, 0x51a3, 0x51a2, 0x51a1, 0x51a0, 0x51a0, // 33840
-    0x519f, 0x519e, 0x519d, 0x519c, 0x519b, 0x519a, 0x519a, 0x5199, // 33848
-    0x5198, 0x5197, 0x5196, 0x5195, 0x5194, 0x5194, 0x5193, 0x5192, // 33856
-    0x5191, 0x5190, 0x518f, 0x518e, 0x518e, 0x518d, 0x518c, 0x518b, // 33864
-    0x518a, 0x5189, 0x5188, 0x5188, 0x5187, 0x5186, 0x5185, 0x5184, // 33872
-    0x5183, 0x5182, 0x5181, 0x5181, 0x5180, 0x517f, 0x517e, 0x517d, // 33880
-    0x517c, 0x517b, 0x517b, 0x517a, 0x5179, 0x5178, 0x5177, 0x5176, // 33888
-    0x5175, 0x5175, 0x5174, 0x5173, 0x5172, 0x5171, 0x5170, 0x516f, // 33896
-    0x516f, 0x516e, 0x516d, 0x516c, 0x516b, 0x516a, 0x5169, 0x5169, // 33904
-    0x5168, 0x5167, 0x5166, 0x5165, 0x5164, 0x5163, 0x5162, 0x5162, // 33912
-    0x5161, 0x5160, 0x515f, 0x515e, 0x515d, 0x515c, 0x515c, 0x515b, // 33920
-    0x515a, 0x5159, 0x5158, 0x5157, 0x5156, 0x5156, 0x5155, 0x5154, // 33928
-    0x5153, 0x5152, 0x5151, 0x5150, 0x5150, 0x514f, 0x514e, 0x514d, // 33936
-    0x514c, 0x514b, 0x514a, 0x5149, 0x5149, 0x5148, 0x5147, 0x5146, // 33944
-    0x5145, 0x5144, 0x5143, 0x5143, 0x5142, 0x5141, 0x5140, 0x513f, // 33952
-    0x513e, 0x513d, 0x513d, 0x513c, 0x513b, 0x513a, 0x5139, 0x5138, // 33960
-    0x5137, 0x5137, 0x5136, 0x5135, 0x5134, 0x5133, 0x5132, 0x5131, // 33968
-    0x5131, 0x5130, 0x512f, 0x512e, 0x512d, 0x512c, 0x512b, 0x512a, // 33976
-    0x512a, 0x5129, 0x5128, 0x5127, 0x5126, 0x5125, 0x5124, 0x5124, // 33984
-    0x5123, 0x5122, 0x5121, 0x5120, 0x511f, 0x511e, 0x511e, 0x511d, // 33992
-    0x511c, 0x511b, 0x511a, 0x5119, 0x5118, 0x5118, 0x5117, 0x5116, // 34000
-    0x5115, 0x5114, 0x5113, 0x5112, 0x5112, 0x5111, 0x5110, 0x510f, // 34008
-    0x510e, 0x510d, 0x510c, 0x510b, 0x510b, 0x510a, 0x5109, 0x5108, // 34016
-    0x5107, 0x5106, 0x5105, 0x5105, 0x5104, 0x5103, 0x5102, 0x5101, // 34024
-    0x5100, 0x50ff, 0x50ff, 0x50fe, 0x50fd, 0x50fc, 0x50fb, 0x50fa, // 34032
-    0x50f9, 0x50f9, 0x50f8, 0x50f7, 0x50f6, 0x50f5, 0x50f4, 0x50f3, // 34040
-    0x50f3, 0x50f2, 0x50f1, 0x50f0, 0x50ef, 0x50ee, 0x50ed, 0x50ec, // 34048
-    0x50ec, 0x50eb, 0x50ea, 0x50e9, 0x50e8, 0x50e7, 0x50e6, 0x50e6, // 34056
-    0x50e5, 0x50e4, 0x50e3, 0x50e2, 0x50e1, 0x50e0, 0x50e0, 0x50df, // 34064
-    0x50de, 0x50dd, 0x50dc, 0x50db, 0x50da, 0x50da, 0x50d9, 0x50d8, // 34072
-    0x50d7, 0x50d6, 0x50d5, 0x50d4, 0x50d3, 0x50d3, 0x50d2, 0x50d1, // 34080
-    0x50d0, 0x50cf, 0x50ce, 0x50cd, 0x50cd, 0x50cc, 0x50cb, 0x50ca, // 34088
-    0x50c9, 0x50c8, 0x50c7, 0x50c7, 0x50c6, 0x50c5, 0x50c4, 0x50c3, // 34096
-    0x50c2, 0x50c1, 0x50c1, 0x50c0, 0x50bf, 0x50be, 0x50bd, 0x50bc, // 34104
-    0x50bb, 0x50bb, 0x50ba, 0x50b9, 0x50b8, 0x50b7, 0x50b6, 0x50b5, // 34112
-    0x50b4, 0x50b4, 0x50b3, 0x50b2, 0x50b1, 0x50b0, 0x50af, 0x50ae, // 34120
-    0x50ae, 0x50ad, 0x50ac, 0x50ab, 0x50aa, 0x50a9, 0x50a8, 0x50a8, // 34128
-    0x50a7, 0x50a6, 0x50a5, 0x50a4, 0x50a3, 0x50a2, 0x50a2, 0x50a1, // 34136
-    0x50a0, 0x509f, 0x509e, 0x509d, 0x509c, 0x509c, 0x509b, 0x509a, // 34144
-    0x5099, 0x5098, 0x5097, 0x5096, 0x5095, 0x5095, 0x5094, 0x5093, // 34152
-    0x5092, 0x5091, 0x5090, 0x508f, 0x508f, 0x508e, 0x508d, 0x508c, // 34160
-    0x508b, 0x508a, 0x5089, 0x5089, 0x5088, 0x5087, 0x5086, 0x5085, // 34168
-    0x5084, 0x5083, 0x5083, 0x5082, 0x5081, 0x5080, 0x507f, 0x507e, // 34176
-    0x507d, 0x507c, 0x507c, 0x507b, 0x507a, 0x5079, 0x5078, 0x5077, // 34184
-    0x5076, 0x5076, 0x5075, 0x5074, 0x5073, 0x5072, 0x5071, 0x5070, // 34192
-    0x5070, 0x506f, 0x506e, 0x506d, 0x506c, 0x506b, 0x506a, 0x506a, // 34200
-    0x5069, 0x5068, 0x5067, 0x5066, 0x5065, 0x5064, 0x5064, 0x5063, // 34208
-    0x5062, 0x5061, 0x5060, 0x505f, 0x505e, 0x505d, 0x505d, 0x505c, // 34216
-    0x505b, 0x505a, 0x5059, 0x5058, 0x5057, 0x5057, 0x5056, 0x5055, // 34224
-    0x5054, 0x5053, 0x5052, 0x5051, 0x5051, 0x5050, 0x504f, 0x504e, // 34232
-    0x504d, 0x504c, 0x504b, 0x504b, 0x504a, 0x5049, 0x5048, 0x5047, // 34240
-    0x5046, 0x5045, 0x5045, 0x5044, 0x5043, 0x5042, 0x5041, 0x5040, // 34248
-    0x503f, 0x503e, 0x503e, 0x503d, 0x503c, 0x503b, 0x503a, 0x5039, // 34256
-    0x5038, 0x5038, 0x5037, 0x5036, 0x5035, 0x5034, 0x5033, 0x5032, // 34264
-    0x5032, 0x5031, 0x5030, 0x502f, 0x502e, 0x502d, 0x502c, 0x502c, // 34272
-    0x502b, 0x502a, 0x5029, 0x5028, 0x5027, 0x5026, 0x5026, 0x5025, // 34280
-    0x5024, 0x5023, 0x5022, 0x5021, 0x5020, 0x501f, 0x501f, 0x501e, // 34288
-    0x501d, 0x501c, 0x501b, 0x501a, 0x5019, 0x5019, 0x5018, 0x5017, // 34296
-    0x5016, 0x5015, 0x5014, 0x5013, 0x5013, 0x5012, 0x5011, 0x5010, // 34304
-    0x500f, 0x500e, 0x500d, 0x500d, 0x500c, 0x500b, 0x500a, 0x5009, // 34312
-    0x5008, 0x5007, 0x5006, 0x5006, 0x5005, 0x5004, 0x5003, 0x5002, // 34320
-    0x5001, 0x5000, 0x5000, 0x4fff, 0x4ffe, 0x4ffd, 0x4ffc, 0x4ffb, // 34328
-    0x4ffa, 0x4ffa, 0x4ff9, 0x4ff8, 0x4ff7, 0x4ff6, 0x4ff5, 0x4ff4, // 34336
-    0x4ff4, 0x4ff3, 0x4ff2, 0x4ff1, 0x4ff0, 0x4fef, 0x4fee, 0x4fee, // 34344
-    0x4fed, 0x4fec, 0x4feb, 0x4fea, 0x4fe9, 0x4fe8, 0x4fe7, 0x4fe7, // 34352
-    0x4fe6, 0x4fe5, 0x4fe4, 0x4fe3, 0x4fe2, 0x4fe1, 0x4fe1, 0x4fe0, // 34360
-    0x4fdf, 0x4fde, 0x4fdd, 0x4fdc, 0x4fdb, 0x4fdb, 0x4fda, 0x4fd9, // 34368
-    0x4fd8, 0x4fd7, 0x4fd6, 0x4fd5, 0x4fd5, 0x4fd4, 0x4fd3, 0x4fd2, // 34376
-    0x4fd1, 0x4fd0, 0x4fcf, 0x4fcf, 0x4fce, 0x4fcd, 0x4fcc, 0x4fcb, // 34384
-    0x4fca, 0x4fc9, 0x4fc8, 0x4fc8, 0x4fc7, 0x4fc6, 0x4fc5, 0x4fc4, // 34392
-    0x4fc3, 0x4fc2, 0x4fc2, 0x4fc1, 0x4fc0, 0x4fbf, 0x4fbe, 0x4fbd, // 34400
-    0x4fbc, 0x4fbc, 0x4fbb, 0x4fba, 0x4fb9, 0x4fb8, 0x4fb7, 0x4fb6, // 34408
-    0x4fb6, 0x4fb5, 0x4fb4, 0x4fb3, 0x4fb2, 0x4fb1, 0x4fb0, 0x4fb0, // 34416
-    0x4faf, 0x4fae, 0x4fad, 0x4fac, 0x4fab, 0x4faa, 0x4fa9, 0x4fa9, // 34424
-    0x4fa8, 0x4fa7, 0x4fa6, 0x4fa5, 0x4fa4, 0x4fa3, 0x4fa3, 0x4fa2, // 34432
-    0x4fa1, 0x4fa0, 0x4f9f, 0x4f9e, 0x4f9d, 0x4f9d, 0x4f9c, 0x4f9b, // 34440
-    0x4f9a, 0x4f99, 0x4f98, 0x4f97, 0x4f97, 0x4f96, 0x4f95, 0x4f94, // 34448
-    0x4f93, 0x4f92, 0x4f91, 0x4f90, 0x4f90, 0x4f8f, 0x4f8e, 0x4f8d, // 34456
-    0x4f8c, 0x4f8b, 0x4f8a, 0x4f8a, 0x4f89, 0x4f88, 0x4f87, 0x4f86, // 34464
-    0x4f85, 0x4f84, 0x4f84, 0x4f83, 0x4f82, 0x4f81, 0x4f80, 0x4f7f, // 34472
-    0x4f7e, 0x4f7e, 0x4f7d, 0x4f7c, 0x4f7b, 0x4f7a, 0x4f79, 0x4f78, // 34480
-    0x4f78, 0x4f77, 0x4f76, 0x4f75, 0x4f74, 0x4f73, 0x4f72, 0x4f71, // 34488
-    0x4f71, 0x4f70, 0x4f6f, 0x4f6e, 0x4f6d, 0x4f6c, 0x4f6b, 0x4f6b, // 34496
-    0x4f6a, 0x4f69, 0x4f68, 0x4f67, 0x4f66, 0x4f65, 0x4f65, 0x4f64, // 34504
-    0x4f63, 0x4f62, 0x4f61, 0x4f60, 0x4f5f, 0x4f5f, 0x4f5e, 0x4f5d, // 34512
-    0x4f5c, 0x4f5b, 0x4f5a, 0x4f59, 0x4f59, 0x4f58, 0x4f57, 0x4f56, // 34520
-    0x4f55, 0x4f54, 0x4f53, 0x4f52, 0x4f52, 0x4f51, 0x4f50, 0x4f4f, // 34528
-    0x4f4e, 0x4f4d, 0x4f4c, 0x4f4c, 0x4f4b, 0x4f4a, 0x4f49, 0x4f48, // 34536
-    0x4f47, 0x4f46, 0x4f46, 0x4f45, 0x4f44, 0x4f43, 0x4f42, 0x4f41, // 34544
-    0x4f40, 0x4f40, 0x4f3f, 0x4f3e, 0x4f3d, 0x4f3c, 0x4f3b, 0x4f3a, // 34552
-    0x4f3a, 0x4f39, 0x4f38, 0x4f37, 0x4f36, 0x4f35, 0x4f34, 0x4f33, // 34560
-    0x4f33, 0x4f32, 0x4f31, 0x4f30, 0x4f2f, 0x4f2e, 0x4f2d, 0x4f2d, // 34568
-    0x4f2c, 0x4f2b, 0x4f2a, 0x4f29, 0x4f28, 0x4f27, 0x4f27, 0x4f26, // 34576
-    0x4f25, 0x4f24, 0x4f23, 0x4f22, 0x4f21, 0x4f21, 0x4f20, 0x4f1f, // 34584
-    0x4f1e, 0x4f1d, 0x4f1c, 0x4f1b, 0x4f1a, 0x4f1a, 0x4f19, 0x4f18, // 34592
-    0x4f17, 0x4f16, 0x4f15, 0x4f14, 0x4f14, 0x4f13, 0x4f12, 0x4f11, // 34600
-    0x4f10, 0x4f0f, 0x4f0e, 0x4f0e, 0x4f0d, 0x4f0c, 0x4f0b, 0x4f0a, // 34608
-    0x4f09, 0x4f08, 0x4f08, 0x4f07, 0x4f06, 0x4f05, 0x4f04, 0x4f03, // 34616
-    0x4f02, 0x4f02, 0x4f01, 0x4f00, 0x4eff, 0x4efe, 0x4efd, 0x4efc, // 34624
-    0x4efb, 0x4efb, 0x4efa, 0x4ef9, 0x4ef8, 0x4ef7, 0x4ef6, 0x4ef5, // 34632
-    0x4ef5, 0x4ef4, 0x4ef3, 0x4ef2, 0x4ef1, 0x4ef0, 0x4eef, 0x4eef, // 34640
-    0x4eee, 0x4eed, 0x4eec, 0x4eeb, 0x4eea, 0x4ee9, 0x4ee9, 0x4ee8, // 34648
-    0x4ee7, 0x4ee6, 0x4ee5, 0x4ee4, 0x4ee3, 0x4ee3, 0x4ee2, 0x4ee1, // 34656
-    0x4ee0, 0x4edf, 0x4ede, 0x4edd, 0x4edc, 0x4edc, 0x4edb, 0x4eda, // 34664
-    0x4ed9, 0x4ed8, 0x4ed7, 0x4ed6, 0x4ed6, 0x4ed5, 0x4ed4, 0x4ed3, // 34672
-    0x4ed2, 0x4ed1, 0x4ed0, 0x4ed0, 0x4ecf, 0x4ece, 0x4ecd, 0x4ecc, // 34680
-    0x4ecb, 0x4eca, 0x4eca, 0x4ec9, 0x4ec8, 0x4ec7, 0x4ec6, 0x4ec5, // 34688
-    0x4ec4, 0x4ec3, 0x4ec3, 0x4ec2, 0x4ec1, 0x4ec0, 0x4ebf, 0x4ebe, // 34696
-    0x4ebd, 0x4ebd, 0x4ebc, 0x4ebb, 0x4eba, 0x4eb9, 0x4eb8, 0x4eb7, // 34704
-    0x4eb7, 0x4eb6, 0x4eb5, 0x4eb4, 0x4eb3, 0x4eb2, 0x4eb1, 0x4eb1, // 34712
-    0x4eb0, 0x4eaf, 0x4eae, 0x4ead, 0x4eac, 0x4eab, 0x4eab, 0x4eaa, // 34720
-    0x4ea9, 0x4ea8, 0x4ea7, 0x4ea6, 0x4ea5, 0x4ea4, 0x4ea4, 0x4ea3, // 34728
-    0x4ea2, 0x4ea1, 0x4ea0, 0x4e9f, 0x4e9e, 0x4e9e, 0x4e9d, 0x4e9c, // 34736
-    0x4e9b, 0x4e9a, 0x4e99, 0x4e98, 0x4e98, 0x4e97, 0x4e96, 0x4e95, // 34744
-    0x4e94, 0x4e93, 0x4e92, 0x4e92, 0x4e91, 0x4e90, 0x4e8f, 0x4e8e, // 34752
-    0x4e8d, 0x4e8c, 0x4e8c, 0x4e8b, 0x4e8a, 0x4e89, 0x4e88, 0x4e87, // 34760
-    0x4e86, 0x4e85, 0x4e85, 0x4e84, 0x4e83, 0x4e82, 0x4e81, 0x4e80, // 34768
-    0x4e7f, 0x4e7f, 0x4e7e, 0x4e7d, 0x4e7c, 0x4e7b, 0x4e7a, 0x4e79, // 34776
-    0x4e79, 0x4e78, 0x4e77, 0x4e76, 0x4e75, 0x4e74, 0x4e73, 0x4e73, // 34784
-    0x4e72, 0x4e71, 0x4e70, 0x4e6f, 0x4e6e, 0x4e6d, 0x4e6d, 0x4e6c, // 34792
-    0x4e6b, 0x4e6a, 0x4e69, 0x4e68, 0x4e67, 0x4e66, 0x4e66, 0x4e65, // 34800
-    0x4e64, 0x4e63, 0x4e62, 0x4e61, 0x4e60, 0x4e60, 0x4e5f, 0x4e5e, // 34808
-    0x4e5e, 0x4e5d, 0x4e5c, 0x4e5b, 0x4e5a, 0x4e59, 0x4e58, 0x4e58, // 34816
-    0x4e57, 0x4e56, 0x4e55, 0x4e54, 0x4e53, 0x4e53, 0x4e52, 0x4e51, // 34824
-    0x4e50, 0x4e4f, 0x4e4e, 0x4e4d, 0x4e4d, 0x4e4c, 0x4e4b, 0x4e4a, // 34832
-    0x4e49, 0x4e48, 0x4e48, 0x4e47, 0x4e46, 0x4e45, 0x4e44, 0x4e43, // 34840
-    0x4e42, 0x4e42, 0x4e41, 0x4e40, 0x4e3f, 0x4e3e, 0x4e3d, 0x4e3d, // 34848
-    0x4e3c, 0x4e3b, 0x4e3a, 0x4e39, 0x4e38, 0x4e37, 0x4e37, 0x4e36, // 34856
-    0x4e35, 0x4e34, 0x4e33, 0x4e32, 0x4e32, 0x4e31, 0x4e30, 0x4e2f, // 34864
-    0x4e2e, 0x4e2d, 0x4e2c, 0x4e2c, 0x4e2b, 0x4e2a, 0x4e29, 0x4e28, // 34872
-    0x4e27, 0x4e27, 0x4e26, 0x4e25, 0x4e24, 0x4e23, 0x4e22, 0x4e21, // 34880
-    0x4e21, 0x4e20, 0x4e1f, 0x4e1e, 0x4e1d, 0x4e1c, 0x4e1c, 0x4e1b, // 34888
-    0x4e1a, 0x4e19, 0x4e18, 0x4e17, 0x4e16, 0x4e16, 0x4e15, 0x4e14, // 34896
-    0x4e13, 0x4e12, 0x4e11, 0x4e11, 0x4e10, 0x4e0f, 0x4e0e, 0x4e0d, // 34904
-    0x4e0c, 0x4e0b, 0x4e0b, 0x4e0a, 0x4e09, 0x4e08, 0x4e07, 0x4e06, // 34912
-    0x4e06, 0x4e05, 0x4e04, 0x4e03, 0x4e02, 0x4e01, 0x4e00, 0x4e00, // 34920
-    0x4dff, 0x4dfe, 0x4dfd, 0x4dfc, 0x4dfb, 0x4dfb, 0x4dfa, 0x4df9, // 34928
-    0x4df8, 0x4df7, 0x4df6, 0x4df5, 0x4df5, 0x4df4, 0x4df3, 0x4df2, // 34936
-    0x4df1, 0x4df0, 0x4df0, 0x4def, 0x4dee, 0x4ded, 0x4dec, 0x4deb, // 34944
-    0x4dea, 0x4dea, 0x4de9, 0x4de8, 0x4de7, 0x4de6, 0x4de5, 0x4de5, // 34952
-    0x4de4, 0x4de3, 0x4de2, 0x4de1, 0x4de0, 0x4ddf, 0x4ddf, 0x4dde, // 34960
-    0x4ddd, 0x4ddc, 0x4ddb, 0x4dda, 0x4dda, 0x4dd9, 0x4dd8, 0x4dd7, // 34968
-    0x4dd6, 0x4dd5, 0x4dd4, 0x4dd4, 0x4dd3, 0x4dd2, 0x4dd1, 0x4dd0, // 34976
-    0x4dcf, 0x4dcf, 0x4dce, 0x4dcd, 0x4dcc, 0x4dcb, 0x4dca, 0x4dca, // 34984
-    0x4dc9, 0x4dc8, 0x4dc7, 0x4dc6, 0x4dc5, 0x4dc4, 0x4dc4, 0x4dc3, // 34992
-    0x4dc2, 0x4dc1, 0x4dc0, 0x4dbf, 0x4dbf, 0x4dbe, 0x4dbd, 0x4dbc, // 35000
-    0x4dbb, 0x4dba, 0x4db9, 0x4db9, 0x4db8, 0x4db7, 0x4db6, 0x4db5, // 35008
-    0x4db4, 0x4db4, 0x4db3, 0x4db2, 0x4db1, 0x4db0, 0x4daf, 0x4dae, // 35016
-    0x4dae, 0x4dad, 0x4dac, 0x4dab, 0x4daa, 0x4da9, 0x4da9, 0x4da8, // 35024
-    0x4da7, 0x4da6, 0x4da5, 0x4da4, 0x4da3, 0x4da3, 0x4da2, 0x4da1, // 35032
-    0x4da0, 0x4d9f, 0x4d9e, 0x4d9e, 0x4d9d, 0x4d9c, 0x4d9b, 0x4d9a, // 35040
-    0x4d99, 0x4d98, 0x4d98, 0x4d97, 0x4d96, 0x4d95, 0x4d94, 0x4d93, // 35048
-    0x4d93, 0x4d92, 0x4d91, 0x4d90, 0x4d8f, 0x4d8e, 0x4d8d, 0x4d8d, // 35056
-    0x4d8c, 0x4d8b, 0x4d8a, 0x4d89, 0x4d88, 0x4d88, 0x4d87, 0x4d86, // 35064
-    0x4d85, 0x4d84, 0x4d83, 0x4d82, 0x4d82, 0x4d81, 0x4d80, 0x4d7f, // 35072
-    0x4d7e, 0x4d7d, 0x4d7d, 0x4d7c, 0x4d7b, 0x4d7a, 0x4d79, 0x4d78, // 35080
-    0x4d77, 0x4d77, 0x4d76, 0x4d75, 0x4d74, 0x4d73, 0x4d72, 0x4d72, // 35088
-    0x4d71, 0x4d70, 0x4d6f, 0x4d6e, 0x4d6d, 0x4d6c, 0x4d6c, 0x4d6b, // 35096
-    0x4d6a, 0x4d69, 0x4d68, 0x4d67, 0x4d67, 0x4d66, 0x4d65, 0x4d64, // 35104
-    0x4d63, 0x4d62, 0x4d61, 0x4d61, 0x4d60, 0x4d5f, 0x4d5e, 0x4d5d, // 35112
-    0x4d5c, 0x4d5c, 0x4d5b, 0x4d5a, 0x4d59, 0x4d58, 0x4d57, 0x4d56, // 35120
-    0x4d56, 0x4d55, 0x4d54, 0x4d53, 0x4d52, 0x4d51, 0x4d51, 0x4d50, // 35128
-    0x4d4f, 0x4d4e, 0x4d4d, 0x4d4c, 0x4d4b, 0x4d4b, 0x4d4a, 0x4d49, // 35136
-    0x4d48, 0x4d47, 0x4d46, 0x4d46, 0x4d45, 0x4d44, 0x4d43, 0x4d42, // 35144
-    0x4d41, 0x4d40, 0x4d40, 0x4d3f, 0x4d3e, 0x4d3d, 0x4d3c, 0x4d3b, // 35152
-    0x4d3b, 0x4d3a, 0x4d39, 0x4d38, 0x4d37, 0x4d36, 0x4d36, 0x4d35, // 35160
-    0x4d34, 0x4d33, 0x4d32, 0x4d31, 0x4d30, 0x4d30, 0x4d2f, 0x4d2e, // 35168
-    0x4d2d, 0x4d2c, 0x4d2b, 0x4d2b, 0x4d2a, 0x4d29, 0x4d28, 0x4d27, // 35176
-    0x4d26, 0x4d25, 0x4d25, 0x4d24, 0x4d23, 0x4d22, 0x4d21, 0x4d20, // 35184
-    0x4d20, 0x4d1f, 0x4d1e, 0x4d1d, 0x4d1c, 0x4d1b, 0x4d1a, 0x4d1a, // 35192
-    0x4d19, 0x4d18, 0x4d17, 0x4d16, 0x4d15, 0x4d15, 0x4d14, 0x4d13, // 35200
-    0x4d12, 0x4d11, 0x4d10, 0x4d0f, 0x4d0f, 0x4d0e, 0x4d0d, 0x4d0c, // 35208
-    0x4d0b, 0x4d0a, 0x4d0a, 0x4d09, 0x4d08, 0x4d07, 0x4d06, 0x4d05, // 35216
-    0x4d04, 0x4d04, 0x4d03, 0x4d02, 0x4d01, 0x4d00, 0x4cff, 0x4cff, // 35224
-    0x4cfe, 0x4cfd, 0x4cfc, 0x4cfb, 0x4cfa, 0x4cf9, 0x4cf9, 0x4cf8, // 35232
-    0x4cf7, 0x4cf6, 0x4cf5, 0x4cf4, 0x4cf4, 0x4cf3, 0x4cf2, 0x4cf1, // 35240
-    0x4cf0, 0x4cef, 0x4cee, 0x4cee, 0x4ced, 0x4cec, 0x4ceb, 0x4cea, // 35248
-    0x4ce9, 0x4ce9, 0x4ce8, 0x4ce7, 0x4ce6, 0x4ce5, 0x4ce4, 0x4ce3, // 35256
-    0x4ce3, 0x4ce2, 0x4ce1, 0x4ce0, 0x4cdf, 0x4cde, 0x4cde, 0x4cdd, // 35264
-    0x4cdc, 0x4cdb, 0x4cda, 0x4cd9, 0x4cd8, 0x4cd8, 0x4cd7, 0x4cd6, // 35272
-    0x4cd5, 0x4cd4, 0x4cd3, 0x4cd3, 0x4cd2, 0x4cd1, 0x4cd0, 0x4ccf, // 35280
-    0x4cce, 0x4ccd, 0x4ccd, 0x4ccc, 0x4ccb, 0x4cca, 0x4cc9, 0x4cc8, // 35288
-    0x4cc8, 0x4cc7, 0x4cc6, 0x4cc5, 0x4cc4, 0x4cc3, 0x4cc2, 0x4cc2, // 35296
-    0x4cc1, 0x4cc0, 0x4cbf, 0x4cbe, 0x4cbd, 0x4cbd, 0x4cbc, 0x4cbb, // 35304
-    0x4cba, 0x4cb9, 0x4cb8, 0x4cb7, 0x4cb7, 0x4cb6, 0x4cb5, 0x4cb4, // 35312
-    0x4cb3, 0x4cb2, 0x4cb2, 0x4cb1, 0x4cb0, 0x4caf, 0x4cae, 0x4cad, // 35320
-    0x4cad, 0x4cac, 0x4cab, 0x4caa, 0x4ca9, 0x4ca8, 0x4ca7, 0x4ca7, // 35328
-    0x4ca6, 0x4ca5, 0x4ca4, 0x4ca3, 0x4ca2, 0x4ca2, 0x4ca1, 0x4ca0, // 35336
-    0x4c9f, 0x4c9e, 0x4c9d, 0x4c9c, 0x4c9c, 0x4c9b, 0x4c9a, 0x4c99, // 35344
-    0x4c98, 0x4c97, 0x4c97, 0x4c96, 0x4c95, 0x4c94, 0x4c93, 0x4c92, // 35352
-    0x4c91, 0x4c91, 0x4c90, 0x4c8f, 0x4c8e, 0x4c8d, 0x4c8c, 0x4c8c, // 35360
-    0x4c8b, 0x4c8a, 0x4c89, 0x4c88, 0x4c87, 0x4c86, 0x4c86, 0x4c85, // 35368
-    0x4c84, 0x4c83, 0x4c82, 0x4c81, 0x4c81, 0x4c80, 0x4c7f, 0x4c7e, // 35376
-    0x4c7d, 0x4c7c, 0x4c7b, 0x4c7b, 0x4c7a, 0x4c79, 0x4c78, 0x4c77, // 35384
-    0x4c76, 0x4c76, 0x4c75, 0x4c74, 0x4c73, 0x4c72, 0x4c71, 0x4c70, // 35392
-    0x4c70, 0x4c6f, 0x4c6e, 0x4c6d, 0x4c6c, 0x4c6b, 0x4c6b, 0x4c6a, // 35400
-    0x4c69, 0x4c68, 0x4c67, 0x4c66, 0x4c65, 0x4c65, 0x4c64, 0x4c63, // 35408
-    0x4c62, 0x4c61, 0x4c60, 0x4c60, 0x4c5f, 0x4c5e, 0x4c5d, 0x4c5c, // 35416
-    0x4c5b, 0x4c5a, 0x4c5a, 0x4c59, 0x4c58, 0x4c57, 0x4c56, 0x4c55, // 35424
-    0x4c55, 0x4c54, 0x4c53, 0x4c52, 0x4c51, 0x4c50, 0x4c4f, 0x4c4f, // 35432
-    0x4c4e, 0x4c4d, 0x4c4c, 0x4c4b, 0x4c4a, 0x4c4a, 0x4c49, 0x4c48, // 35440
-    0x4c47, 0x4c46, 0x4c45, 0x4c44, 0x4c44, 0x4c43, 0x4c42, 0x4c41, // 35448
-    0x4c40, 0x4c3f, 0x4c3f, 0x4c3e, 0x4c3d, 0x4c3c, 0x4c3b, 0x4c3a, // 35456
-    0x4c39, 0x4c39, 0x4c38, 0x4c37, 0x4c36, 0x4c35, 0x4c34, 0x4c34, // 35464
-    0x4c33, 0x4c32, 0x4c31, 0x4c30, 0x4c2f, 0x4c2e, 0x4c2e, 0x4c2d, // 35472
-    0x4c2c, 0x4c2b, 0x4c2a, 0x4c29, 0x4c29, 0x4c28, 0x4c27, 0x4c26, // 35480
-    0x4c25, 0x4c24, 0x4c23, 0x4c23, 0x4c22, 0x4c21, 0x4c20, 0x4c1f, // 35488
-    0x4c1e, 0x4c1e, 0x4c1d, 0x4c1c, 0x4c1b, 0x4c1a, 0x4c19, 0x4c19, // 35496
-    0x4c18, 0x4c17, 0x4c16, 0x4c15, 0x4c14, 0x4c13, 0x4c13, 0x4c12, // 35504
-    0x4c11, 0x4c10, 0x4c0f, 0x4c0e, 0x4c0e, 0x4c0d, 0x4c0c, 0x4c0b, // 35512
-    0x4c0a, 0x4c09, 0x4c08, 0x4c08, 0x4c07, 0x4c06, 0x4c05, 0x4c04, // 35520
-    0x4c03, 0x4c03, 0x4c02, 0x4c01, 0x4c00, 0x4bff, 0x4bfe, 0x4bfd, // 35528
-    0x4bfd, 0x4bfc, 0x4bfb, 0x4bfa, 0x4bf9, 0x4bf8, 0x4bf8, 0x4bf7, // 35536
-    0x4bf6, 0x4bf5, 0x4bf4, 0x4bf3, 0x4bf2, 0x4bf2, 0x4bf1, 0x4bf0, // 35544
-    0x4bef, 0x4bee, 0x4bed, 0x4bed, 0x4bec, 0x4beb, 0x4bea, 0x4be9, // 35552
-    0x4be8, 0x4be7, 0x4be7, 0x4be6, 0x4be5, 0x4be4, 0x4be3, 0x4be2, // 35560
-    0x4be2, 0x4be1, 0x4be0, 0x4bdf, 0x4bde, 0x4bdd, 0x4bdc, 0x4bdc, // 35568
-    0x4bdb, 0x4bda, 0x4bd9, 0x4bd8, 0x4bd7, 0x4bd7, 0x4bd6, 0x4bd5, // 35576
-    0x4bd4, 0x4bd3, 0x4bd2, 0x4bd1, 0x4bd1, 0x4bd0, 0x4bcf, 0x4bce, // 35584
-    0x4bcd, 0x4bcc, 0x4bcc, 0x4bcb, 0x4bca, 0x4bc9, 0x4bc8, 0x4bc7, // 35592
-    0x4bc6, 0x4bc6, 0x4bc5, 0x4bc4, 0x4bc3, 0x4bc2, 0x4bc1, 0x4bc1, // 35600
-    0x4bc0, 0x4bbf, 0x4bbe, 0x4bbd, 0x4bbc, 0x4bbb, 0x4bbb, 0x4bba, // 35608
-    0x4bb9, 0x4bb8, 0x4bb7, 0x4bb6, 0x4bb6, 0x4bb5, 0x4bb4, 0x4bb3, // 35616
-    0x4bb2, 0x4bb1, 0x4bb0, 0x4bb0, 0x4baf, 0x4bae, 0x4bad, 0x4bac, // 35624
-    0x4bab, 0x4bab, 0x4baa, 0x4ba9, 0x4ba8, 0x4ba7, 0x4ba6, 0x4ba5, // 35632
-    0x4ba5, 0x4ba4, 0x4ba3, 0x4ba2, 0x4ba1, 0x4ba0, 0x4ba0, 0x4b9f, // 35640
-    0x4b9e, 0x4b9d, 0x4b9c, 0x4b9b, 0x4b9a, 0x4b9a, 0x4b99, 0x4b98, // 35648
-    0x4b97, 0x4b96, 0x4b95, 0x4b95, 0x4b94, 0x4b93, 0x4b92, 0x4b91, // 35656
-    0x4b90, 0x4b8f, 0x4b8f, 0x4b8e, 0x4b8d, 0x4b8c, 0x4b8b, 0x4b8a, // 35664
-    0x4b8a, 0x4b89, 0x4b88, 0x4b87, 0x4b86, 0x4b85, 0x4b85, 0x4b84, // 35672
-    0x4b83, 0x4b82, 0x4b81, 0x4b80, 0x4b7f, 0x4b7f, 0x4b7e, 0x4b7d, // 35680
-    0x4b7c, 0x4b7b, 0x4b7a, 0x4b7a, 0x4b79, 0x4b78, 0x4b77, 0x4b76, // 35688
-    0x4b75, 0x4b74, 0x4b74, 0x4b73, 0x4b72, 0x4b71, 0x4b70, 0x4b6f, // 35696
-    0x4b6f, 0x4b6e, 0x4b6d, 0x4b6c, 0x4b6b, 0x4b6a, 0x4b69, 0x4b69, // 35704
-    0x4b68, 0x4b67, 0x4b66, 0x4b65, 0x4b64, 0x4b64, 0x4b63, 0x4b62, // 35712
-    0x4b61, 0x4b60, 0x4b5f, 0x4b5e, 0x4b5e, 0x4b5d, 0x4b5c, 0x4b5b, // 35720
-    0x4b5a, 0x4b59, 0x4b59, 0x4b58, 0x4b57, 0x4b56, 0x4b55, 0x4b54, // 35728
-    0x4b53, 0x4b53, 0x4b52, 0x4b51, 0x4b50, 0x4b4f, 0x4b4e, 0x4b4e, // 35736
-    0x4b4d, 0x4b4c, 0x4b4b, 0x4b4a, 0x4b49, 0x4b48, 0x4b48, 0x4b47, // 35744
-    0x4b46, 0x4b45, 0x4b44, 0x4b43, 0x4b43, 0x4b42, 0x4b41, 0x4b40, // 35752
-    0x4b3f, 0x4b3e, 0x4b3d, 0x4b3d, 0x4b3c, 0x4b3b, 0x4b3a, 0x4b39, // 35760
-    0x4b38, 0x4b38, 0x4b37, 0x4b36, 0x4b35, 0x4b34, 0x4b33, 0x4b32, // 35768
-    0x4b32, 0x4b31, 0x4b30, 0x4b2f, 0x4b2e, 0x4b2d, 0x4b2d, 0x4b2c, // 35776
-    0x4b2b, 0x4b2a, 0x4b29, 0x4b28, 0x4b27, 0x4b27, 0x4b26, 0x4b25, // 35784
-    0x4b24, 0x4b23, 0x4b22, 0x4b22, 0x4b21, 0x4b20, 0x4b1f, 0x4b1e, // 35792
-    0x4b1d, 0x4b1c, 0x4b1c, 0x4b1b, 0x4b1a, 0x4b19, 0x4b18, 0x4b17, // 35800
-    0x4b17, 0x4b16, 0x4b15, 0x4b14, 0x4b13, 0x4b12, 0x4b11, 0x4b11, // 35808
-    0x4b10, 0x4b0f, 0x4b0e, 0x4b0d, 0x4b0c, 0x4b0c, 0x4b0b, 0x4b0a, // 35816
-    0x4b09, 0x4b08, 0x4b07, 0x4b06, 0x4b06, 0x4b05, 0x4b04, 0x4b03, // 35824
-    0x4b02, 0x4b01, 0x4b01, 0x4b00, 0x4aff, 0x4afe, 0x4afd, 0x4afc, // 35832
-    0x4afc, 0x4afb, 0x4afa, 0x4af9, 0x4af8, 0x4af7, 0x4af7, 0x4af6, // 35840
-    0x4af5, 0x4af4, 0x4af3, 0x4af2, 0x4af2, 0x4af1, 0x4af0, 0x4aef, // 35848
-    0x4aee, 0x4aed, 0x4aed, 0x4aec, 0x4aeb, 0x4aea, 0x4ae9, 0x4ae8, // 35856
-    0x4ae8, 0x4ae7, 0x4ae6, 0x4ae5, 0x4ae4, 0x4ae4, 0x4ae3, 0x4ae2, // 35864
-    0x4ae1, 0x4ae0, 0x4adf, 0x4adf, 0x4ade, 0x4add, 0x4adc, 0x4adb, // 35872
-    0x4ada, 0x4ada, 0x4ad9, 0x4ad8, 0x4ad7, 0x4ad6, 0x4ad5, 0x4ad5, // 35880
-    0x4ad4, 0x4ad3, 0x4ad2, 0x4ad1, 0x4ad1, 0x4ad0, 0x4acf, 0x4ace, // 35888
-    0x4acd, 0x4acc, 0x4acc, 0x4acb, 0x4aca, 0x4ac9, 0x4ac8, 0x4ac7, // 35896
-    0x4ac7, 0x4ac6, 0x4ac5, 0x4ac4, 0x4ac3, 0x4ac2, 0x4ac2, 0x4ac1, // 35904
-    0x4ac0, 0x4abf, 0x4abe, 0x4abe, 0x4abd, 0x4abc, 0x4abb, 0x4aba, // 35912
-    0x4ab9, 0x4ab9, 0x4ab8, 0x4ab7, 0x4ab6, 0x4ab5, 0x4ab4, 0x4ab4, // 35920
-    0x4ab3, 0x4ab2, 0x4ab1, 0x4ab0, 0x4aaf, 0x4aaf, 0x4aae, 0x4aad, // 35928
-    0x4aac, 0x4aab, 0x4aab, 0x4aaa, 0x4aa9, 0x4aa8, 0x4aa7, 0x4aa6, // 35936
-    0x4aa6, 0x4aa5, 0x4aa4, 0x4aa3, 0x4aa2, 0x4aa1, 0x4aa1, 0x4aa0, // 35944
-    0x4a9f, 0x4a9e, 0x4a9d, 0x4a9c, 0x4a9c, 0x4a9b, 0x4a9a, 0x4a99, // 35952
-    0x4a98, 0x4a98, 0x4a97, 0x4a96, 0x4a95, 0x4a94, 0x4a93, 0x4a93, // 35960
-    0x4a92, 0x4a91, 0x4a90, 0x4a8f, 0x4a8e, 0x4a8e, 0x4a8d, 0x4a8c, // 35968
-    0x4a8b, 0x4a8a, 0x4a89, 0x4a89, 0x4a88, 0x4a87, 0x4a86, 0x4a85, // 35976
-    0x4a85, 0x4a84, 0x4a83, 0x4a82, 0x4a81, 0x4a80, 0x4a80, 0x4a7f, // 35984
-    0x4a7e, 0x4a7d, 0x4a7c, 0x4a7b, 0x4a7b, 0x4a7a, 0x4a79, 0x4a78, // 35992
-    0x4a77, 0x4a76, 0x4a76, 0x4a75, 0x4a74, 0x4a73, 0x4a72, 0x4a72, // 36000
-    0x4a71, 0x4a70, 0x4a6f, 0x4a6e, 0x4a6d, 0x4a6d, 0x4a6c, 0x4a6b, // 36008
-    0x4a6a, 0x4a69, 0x4a68, 0x4a68, 0x4a67, 0x4a66, 0x4a65, 0x4a64, // 36016
-    0x4a63, 0x4a63, 0x4a62, 0x4a61, 0x4a60, 0x4a5f, 0x4a5f, 0x4a5e, // 36024
-    0x4a5d, 0x4a5c, 0x4a5b, 0x4a5a, 0x4a5a, 0x4a59, 0x4a58, 0x4a57, // 36032
-    0x4a56, 0x4a55, 0x4a55, 0x4a54, 0x4a53, 0x4a52, 0x4a51, 0x4a50, // 36040
-    0x4a50, 0x4a4f, 0x4a4e, 0x4a4d, 0x4a4c, 0x4a4c, 0x4a4b, 0x4a4a, // 36048
-    0x4a49, 0x4a48, 0x4a47, 0x4a47, 0x4a46, 0x4a45, 0x4a44, 0x4a43, // 36056
-    0x4a42, 0x4a42, 0x4a41, 0x4a40, 0x4a3f, 0x4a3e, 0x4a3d, 0x4a3d, // 36064
-    0x4a3c, 0x4a3b, 0x4a3a, 0x4a39, 0x4a39, 0x4a38, 0x4a37, 0x4a36, // 36072
-    0x4a35, 0x4a34, 0x4a34, 0x4a33, 0x4a32, 0x4a31, 0x4a30, 0x4a2f, // 36080
-    0x4a2f, 0x4a2e, 0x4a2d, 0x4a2c, 0x4a2b, 0x4a2a, 0x4a2a, 0x4a29, // 36088
-    0x4a28, 0x4a27, 0x4a26, 0x4a26, 0x4a25, 0x4a24, 0x4a23, 0x4a22, // 36096
-    0x4a21, 0x4a21, 0x4a20, 0x4a1f, 0x4a1e, 0x4a1d, 0x4a1c, 0x4a1c, // 36104
-    0x4a1b, 0x4a1a, 0x4a19, 0x4a18, 0x4a17, 0x4a17, 0x4a16, 0x4a15, // 36112
-    0x4a14, 0x4a13, 0x4a13, 0x4a12, 0x4a11, 0x4a10, 0x4a0f, 0x4a0e, // 36120
-    0x4a0e, 0x4a0d, 0x4a0c, 0x4a0b, 0x4a0a, 0x4a09, 0x4a09, 0x4a08, // 36128
-    0x4a07, 0x4a06, 0x4a05, 0x4a04, 0x4a04, 0x4a03, 0x4a02, 0x4a01, // 36136
-    0x4a00, 0x4a00, 0x49ff, 0x49fe, 0x49fd, 0x49fc, 0x49fb, 0x49fb, // 36144
-    0x49fa, 0x49f9, 0x49f8, 0x49f7, 0x49f6, 0x49f6, 0x49f5, 0x49f4, // 36152
-    0x49f3, 0x49f2, 0x49f1, 0x49f1, 0x49f0, 0x49ef, 0x49ee, 0x49ed, // 36160
-    0x49ed, 0x49ec, 0x49eb, 0x49ea, 0x49e9, 0x49e8, 0x49e8, 0x49e7, // 36168
-    0x49e6, 0x49e5, 0x49e4, 0x49e3, 0x49e3, 0x49e2, 0x49e1, 0x49e0, // 36176
-    0x49df, 0x49de, 0x49de, 0x49dd, 0x49dc, 0x49db, 0x49da, 0x49da, // 36184
-    0x49d9, 0x49d8, 0x49d7, 0x49d6, 0x49d5, 0x49d5, 0x49d4, 0x49d3, // 36192
-    0x49d2, 0x49d1, 0x49d0, 0x49d0, 0x49cf, 0x49ce, 0x49cd, 0x49cc, // 36200
-    0x49cb, 0x49cb, 0x49ca, 0x49c9, 0x49c8, 0x49c7, 0x49c7, 0x49c6, // 36208
-    0x49c5, 0x49c4, 0x49c3, 0x49c2, 0x49c2, 0x49c1, 0x49c0, 0x49bf, // 36216
-    0x49be, 0x49bd, 0x49bd, 0x49bc, 0x49bb, 0x49ba, 0x49b9, 0x49b8, // 36224
-    0x49b8, 0x49b7, 0x49b6, 0x49b5, 0x49b4, 0x49b4, 0x49b3, 0x49b2, // 36232
-    0x49b1, 0x49b0, 0x49af, 0x49af, 0x49ae, 0x49ad, 0x49ac, 0x49ab, // 36240
-    0x49aa, 0x49aa, 0x49a9, 0x49a8, 0x49a7, 0x49a6, 0x49a5, 0x49a5, // 36248
-    0x49a4, 0x49a3, 0x49a2, 0x49a1, 0x49a1, 0x49a0, 0x499f, 0x499e, // 36256
-    0x499d, 0x499c, 0x499c, 0x499b, 0x499a, 0x4999, 0x4998, 0x4997, // 36264
-    0x4997, 0x4996, 0x4995, 0x4994, 0x4993, 0x4992, 0x4992, 0x4991, // 36272
-    0x4990, 0x498f, 0x498e, 0x498e, 0x498d, 0x498c, 0x498b, 0x498a, // 36280
-    0x4989, 0x4989, 0x4988, 0x4987, 0x4986, 0x4985, 0x4984, 0x4984, // 36288
-    0x4983, 0x4982, 0x4981, 0x4980, 0x497f, 0x497f, 0x497e, 0x497d, // 36296
-    0x497c, 0x497b, 0x497b, 0x497a, 0x4979, 0x4978, 0x4977, 0x4976, // 36304
-    0x4976, 0x4975, 0x4974, 0x4973, 0x4972, 0x4971, 0x4971, 0x4970, // 36312
-    0x496f, 0x496e, 0x496d, 0x496c, 0x496c, 0x496b, 0x496a, 0x4969, // 36320
-    0x4968, 0x4968, 0x4967, 0x4966, 0x4965, 0x4964, 0x4963, 0x4963, // 36328
-    0x4962, 0x4961, 0x4960, 0x495f, 0x495e, 0x495e, 0x495d, 0x495c, // 36336
-    0x495b, 0x495a, 0x4959, 0x4959, 0x4958, 0x4957, 0x4956, 0x4955, // 36344
-    0x4955, 0x4954, 0x4953, 0x4952, 0x4951, 0x4950, 0x4950, 0x494f, // 36352
-    0x494e, 0x494d, 0x494c, 0x494b, 0x494b, 0x494a, 0x4949, 0x4948, // 36360
-    0x4947, 0x4946, 0x4946, 0x4945, 0x4944, 0x4943, 0x4942, 0x4941, // 36368
-    0x4941, 0x4940, 0x493f, 0x493e, 0x493d, 0x493d, 0x493c, 0x493b, // 36376
-    0x493a, 0x4939, 0x4938, 0x4938, 0x4937, 0x4936, 0x4935, 0x4934, // 36384
-    0x4933, 0x4933, 0x4932, 0x4931, 0x4930, 0x492f, 0x492e, 0x492e, // 36392
-    0x492d, 0x492c, 0x492b, 0x492a, 0x492a, 0x4929, 0x4928, 0x4927, // 36400
-    0x4926, 0x4925, 0x4925, 0x4924, 0x4923, 0x4922, 0x4921, 0x4920, // 36408
-    0x4920, 0x491f, 0x491e, 0x491d, 0x491c, 0x491b, 0x491b, 0x491a, // 36416
-    0x4919, 0x4918, 0x4917, 0x4917, 0x4916, 0x4915, 0x4914, 0x4913, // 36424
-    0x4912, 0x4912, 0x4911, 0x4910, 0x490f, 0x490e, 0x490d, 0x490d, // 36432
-    0x490c, 0x490b, 0x490a, 0x4909, 0x4908, 0x4908, 0x4907, 0x4906, // 36440
-    0x4905, 0x4904, 0x4904, 0x4903, 0x4902, 0x4901, 0x4900, 0x48ff, // 36448
-    0x48ff, 0x48fe, 0x48fd, 0x48fc, 0x48fb, 0x48fa, 0x48fa, 0x48f9, // 36456
-    0x48f8, 0x48f7, 0x48f6, 0x48f5, 0x48f5, 0x48f4, 0x48f3, 0x48f2, // 36464
-    0x48f1, 0x48f1, 0x48f0, 0x48ef, 0x48ee, 0x48ed, 0x48ec, 0x48ec, // 36472
-    0x48eb, 0x48ea, 0x48e9, 0x48e8, 0x48e7, 0x48e7, 0x48e6, 0x48e5, // 36480
-    0x48e4, 0x48e3, 0x48e2, 0x48e2, 0x48e1, 0x48e0, 0x48df, 0x48de, // 36488
-    0x48de, 0x48dd, 0x48dc, 0x48db, 0x48da, 0x48d9, 0x48d9, 0x48d8, // 36496
-    0x48d7, 0x48d6, 0x48d5, 0x48d4, 0x48d4, 0x48d3, 0x48d2, 0x48d1, // 36504
-    0x48d0, 0x48cf, 0x48cf, 0x48ce, 0x48cd, 0x48cc, 0x48cb, 0x48cb, // 36512
-    0x48ca, 0x48c9, 0x48c8, 0x48c7, 0x48c6, 0x48c6, 0x48c5, 0x48c4, // 36520
-    0x48c3, 0x48c2, 0x48c1, 0x48c1, 0x48c0, 0x48bf, 0x48be, 0x48bd, // 36528
-    0x48bc, 0x48bc, 0x48bb, 0x48ba, 0x48b9, 0x48b8, 0x48b8, 0x48b7, // 36536
-    0x48b6, 0x48b5, 0x48b4, 0x48b3, 0x48b3, 0x48b2, 0x48b1, 0x48b0, // 36544
-    0x48af, 0x48ae, 0x48ae, 0x48ad, 0x48ac, 0x48ab, 0x48aa, 0x48a9, // 36552
-    0x48a9, 0x48a8, 0x48a7, 0x48a6, 0x48a5, 0x48a5, 0x48a4, 0x48a3, // 36560
-    0x48a2, 0x48a1, 0x48a0, 0x48a0, 0x489f, 0x489e, 0x489d, 0x489c, // 36568
-    0x489b, 0x489b, 0x489a, 0x4899, 0x4898, 0x4897, 0x4896, 0x4896, // 36576
-    0x4895, 0x4894, 0x4893, 0x4892, 0x4892, 0x4891, 0x4890, 0x488f, // 36584
-    0x488e, 0x488d, 0x488d, 0x488c, 0x488b, 0x488a, 0x4889, 0x4888, // 36592
-    0x4888, 0x4887, 0x4886, 0x4885, 0x4884, 0x4883, 0x4883, 0x4882, // 36600
-    0x4881, 0x4880, 0x487f, 0x487f, 0x487e, 0x487d, 0x487c, 0x487b, // 36608
-    0x487a, 0x487a, 0x4879, 0x4878, 0x4877, 0x4876, 0x4875, 0x4875, // 36616
-    0x4874, 0x4873, 0x4872, 0x4871, 0x4870, 0x4870, 0x486f, 0x486e, // 36624
-    0x486d, 0x486c, 0x486c, 0x486b, 0x486a, 0x4869, 0x4868, 0x4867, // 36632
-    0x4867, 0x4866, 0x4865, 0x4864, 0x4863, 0x4862, 0x4862, 0x4861, // 36640
-    0x4860, 0x485f, 0x485e, 0x485d, 0x485d, 0x485c, 0x485b, 0x485a, // 36648
-    0x4859, 0x4859, 0x4858, 0x4857, 0x4856, 0x4855, 0x4854, 0x4854, // 36656
-    0x4853, 0x4852, 0x4851, 0x4850, 0x484f, 0x484f, 0x484e, 0x484d, // 36664
-    0x484c, 0x484b, 0x484a, 0x484a, 0x4849, 0x4848, 0x4847, 0x4846, // 36672
-    0x4846, 0x4845, 0x4844, 0x4843, 0x4842, 0x4841, 0x4841, 0x4840, // 36680
-    0x483f, 0x483e, 0x483d, 0x483c, 0x483c, 0x483b, 0x483a, 0x4839, // 36688
-    0x4838, 0x4837, 0x4837, 0x4836, 0x4835, 0x4834, 0x4833, 0x4833, // 36696
-    0x4832, 0x4831, 0x4830, 0x482f, 0x482e, 0x482e, 0x482d, 0x482c, // 36704
-    0x482b, 0x482a, 0x4829, 0x4829, 0x4828, 0x4827, 0x4826, 0x4825, // 36712
-    0x4824, 0x4824, 0x4823, 0x4822, 0x4821, 0x4820, 0x4820, 0x481f, // 36720
-    0x481e, 0x481d, 0x481c, 0x481b, 0x481b, 0x481a, 0x4819, 0x4818, // 36728
-    0x4817, 0x4816, 0x4816, 0x4815, 0x4814, 0x4813, 0x4812, 0x4811, // 36736
-    0x4811, 0x4810, 0x480f, 0x480e, 0x480d, 0x480d, 0x480c, 0x480b, // 36744
-    0x480a, 0x4809, 0x4808, 0x4808, 0x4807, 0x4806, 0x4805, 0x4804, // 36752
-    0x4803, 0x4803, 0x4802, 0x4801, 0x4800, 0x47ff, 0x47fe, 0x47fe, // 36760
-    0x47fd, 0x47fc, 0x47fb, 0x47fa, 0x47fa, 0x47f9, 0x47f8, 0x47f7, // 36768
-    0x47f6, 0x47f5, 0x47f5, 0x47f4, 0x47f3, 0x47f2, 0x47f1, 0x47f0, // 36776
-    0x47f0, 0x47ef, 0x47ee, 0x47ed, 0x47ec, 0x47eb, 0x47eb, 0x47ea, // 36784
-    0x47e9, 0x47e8, 0x47e7, 0x47e7, 0x47e6, 0x47e5, 0x47e4, 0x47e3, // 36792
-    0x47e2, 0x47e2, 0x47e1, 0x47e0, 0x47df, 0x47de, 0x47dd, 0x47dd, // 36800
-    0x47dc, 0x47db, 0x47da, 0x47d9, 0x47d8, 0x47d8, 0x47d7, 0x47d6, // 36808
-    0x47d5, 0x47d4, 0x47d4, 0x47d3, 0x47d2, 0x47d1, 0x47d0, 0x47cf, // 36816
-    0x47cf, 0x47ce, 0x47cd, 0x47cc, 0x47cb, 0x47ca, 0x47ca, 0x47c9, // 36824
-    0x47c8, 0x47c7, 0x47c6, 0x47c5, 0x47c5, 0x47c4, 0x47c3, 0x47c2, // 36832
-    0x47c1, 0x47c1, 0x47c0, 0x47bf, 0x47be, 0x47bd, 0x47bc, 0x47bc, // 36840
-    0x47bb, 0x47ba, 0x47b9, 0x47b8, 0x47b7, 0x47b7, 0x47b6, 0x47b5, // 36848
-    0x47b4, 0x47b3, 0x47b2, 0x47b2, 0x47b1, 0x47b0, 0x47af, 0x47ae, // 36856
-    0x47ad, 0x47ac, 0x47ab, 0x47aa, 0x47a9, 0x47a8, 0x47a8, 0x47a7, // 36864
-    0x47a6, 0x47a5, 0x47a4, 0x47a4, 0x47a3, 0x47a2, 0x47a1, 0x47a0, // 36872
-    0x47a0, 0x479f, 0x479e, 0x479d, 0x479c, 0x479b, 0x479b, 0x479a, // 36880
-    0x4799, 0x4798, 0x4797, 0x4797, 0x4796, 0x4795, 0x4794, 0x4793, // 36888
-    0x4793, 0x4792, 0x4791, 0x4790, 0x478f, 0x478f, 0x478e, 0x478d, // 36896
-    0x478c, 0x478b, 0x478a, 0x478a, 0x4789, 0x4788, 0x4787, 0x4786, // 36904
-    0x4786, 0x4785, 0x4784, 0x4783, 0x4782, 0x4782, 0x4781, 0x4780, // 36912
-    0x477f, 0x477e, 0x477d, 0x477d, 0x477c, 0x477b, 0x477a, 0x4779, // 36920
-    0x4779, 0x4778, 0x4777, 0x4776, 0x4775, 0x4775, 0x4774, 0x4773, // 36928
-    0x4772, 0x4771, 0x4771, 0x4770, 0x476f, 0x476e, 0x476d, 0x476c, // 36936
-    0x476c, 0x476b, 0x476a, 0x4769, 0x4768, 0x4768, 0x4767, 0x4766, // 36944
-    0x4765, 0x4764, 0x4764, 0x4763, 0x4762, 0x4761, 0x4760, 0x475f, // 36952
-    0x475f, 0x475e, 0x475d, 0x475c, 0x475b, 0x475b, 0x475a, 0x4759, // 36960
-    0x4758, 0x4757, 0x4757, 0x4756, 0x4755, 0x4754, 0x4753, 0x4753, // 36968
-    0x4752, 0x4751, 0x4750, 0x474f, 0x474e, 0x474e, 0x474d, 0x474c, // 36976
-    0x474b, 0x474a, 0x474a, 0x4749, 0x4748, 0x4747, 0x4746, 0x4746, // 36984
-    0x4745, 0x4744, 0x4743, 0x4742, 0x4742, 0x4741, 0x4740, 0x473f, // 36992
-    0x473e, 0x473d, 0x473d, 0x473c, 0x473b, 0x473a, 0x4739, 0x4739, // 37000
-    0x4738, 0x4737, 0x4736, 0x4735, 0x4735, 0x4734, 0x4733, 0x4732, // 37008
-    0x4731, 0x4730, 0x4730, 0x472f, 0x472e, 0x472d, 0x472c, 0x472c, // 37016
-    0x472b, 0x472a, 0x4729, 0x4728, 0x4728, 0x4727, 0x4726, 0x4725, // 37024
-    0x4724, 0x4724, 0x4723, 0x4722, 0x4721, 0x4720, 0x471f, 0x471f, // 37032
-    0x471e, 0x471d, 0x471c, 0x471b, 0x471b, 0x471a, 0x4719, 0x4718, // 37040
-    0x4717, 0x4717, 0x4716, 0x4715, 0x4714, 0x4713, 0x4712, 0x4712, // 37048
-    0x4711, 0x4710, 0x470f, 0x470e, 0x470e, 0x470d, 0x470c, 0x470b, // 37056
-    0x470a, 0x470a, 0x4709, 0x4708, 0x4707, 0x4706, 0x4706, 0x4705, // 37064
-    0x4704, 0x4703, 0x4702, 0x4701, 0x4701, 0x4700, 0x46ff, 0x46fe, // 37072
-    0x46fd, 0x46fd, 0x46fc, 0x46fb, 0x46fa, 0x46f9, 0x46f9, 0x46f8, // 37080
-    0x46f7, 0x46f6, 0x46f5, 0x46f5, 0x46f4, 0x46f3, 0x46f2, 0x46f1, // 37088
-    0x46f0, 0x46f0, 0x46ef, 0x46ee, 0x46ed, 0x46ec, 0x46ec, 0x46eb, // 37096
-    0x46ea, 0x46e9, 0x46e8, 0x46e8, 0x46e7, 0x46e6, 0x46e5, 0x46e4, // 37104
-    0x46e3, 0x46e3, 0x46e2, 0x46e1, 0x46e0, 0x46df, 0x46df, 0x46de, // 37112
-    0x46dd, 0x46dc, 0x46db, 0x46db, 0x46da, 0x46d9, 0x46d8, 0x46d7, // 37120
-    0x46d7, 0x46d6, 0x46d5, 0x46d4, 0x46d3, 0x46d2, 0x46d2, 0x46d1, // 37128
-    0x46d0, 0x46cf, 0x46ce, 0x46ce, 0x46cd, 0x46cc, 0x46cb, 0x46ca, // 37136
-    0x46ca, 0x46c9, 0x46c8, 0x46c7, 0x46c6, 0x46c5, 0x46c5, 0x46c4, // 37144
-    0x46c3, 0x46c2, 0x46c1, 0x46c1, 0x46c0, 0x46bf, 0x46be, 0x46bd, // 37152
-    0x46bd, 0x46bc, 0x46bb, 0x46ba, 0x46b9, 0x46b9, 0x46b8, 0x46b7, // 37160
-    0x46b6, 0x46b5, 0x46b4, 0x46b4, 0x46b3, 0x46b2, 0x46b1, 0x46b0, // 37168
-    0x46b0, 0x46af, 0x46ae, 0x46ad, 0x46ac, 0x46ac, 0x46ab, 0x46aa, // 37176
-    0x46a9, 0x46a8, 0x46a8, 0x46a7, 0x46a6, 0x46a5, 0x46a4, 0x46a3, // 37184
-    0x46a3, 0x46a2, 0x46a1, 0x46a0, 0x469f, 0x469f, 0x469e, 0x469d, // 37192
-    0x469c, 0x469b, 0x469b, 0x469a, 0x4699, 0x4698, 0x4697, 0x4696, // 37200
-    0x4696, 0x4695, 0x4694, 0x4693, 0x4692, 0x4692, 0x4691, 0x4690, // 37208
-    0x468f, 0x468e, 0x468e, 0x468d, 0x468c, 0x468b, 0x468a, 0x468a, // 37216
-    0x4689, 0x4688, 0x4687, 0x4686, 0x4685, 0x4685, 0x4684, 0x4683, // 37224
-    0x4682, 0x4681, 0x4681, 0x4680, 0x467f, 0x467e, 0x467d, 0x467d, // 37232
-    0x467c, 0x467b, 0x467a, 0x4679, 0x4678, 0x4678, 0x4677, 0x4676, // 37240
-    0x4675, 0x4674, 0x4674, 0x4673, 0x4672, 0x4671, 0x4670, 0x4670, // 37248
-    0x466f, 0x466e, 0x466d, 0x466c, 0x466c, 0x466b, 0x466a, 0x4669, // 37256
-    0x4668, 0x4667, 0x4667, 0x4666, 0x4665, 0x4664, 0x4663, 0x4663, // 37264
-    0x4662, 0x4661, 0x4660, 0x465f, 0x465f, 0x465e, 0x465d, 0x465c, // 37272
-    0x465b, 0x465b, 0x465a, 0x4659, 0x4658, 0x4657, 0x4656, 0x4656, // 37280
-    0x4655, 0x4654, 0x4653, 0x4652, 0x4652, 0x4651, 0x4650, 0x464f, // 37288
-    0x464e, 0x464e, 0x464d, 0x464c, 0x464b, 0x464a, 0x4649, 0x4649, // 37296
-    0x4648, 0x4647, 0x4646, 0x4645, 0x4645, 0x4644, 0x4643, 0x4642, // 37304
-    0x4641, 0x4641, 0x4640, 0x463f, 0x463e, 0x463d, 0x463d, 0x463c, // 37312
-    0x463b, 0x463a, 0x4639, 0x4638, 0x4638, 0x4637, 0x4636, 0x4635, // 37320
-    0x4634, 0x4634, 0x4633, 0x4632, 0x4631, 0x4630, 0x4630, 0x462f, // 37328
-    0x462e, 0x462d, 0x462c, 0x462b, 0x462b, 0x462a, 0x4629, 0x4628, // 37336
-    0x4627, 0x4627, 0x4626, 0x4625, 0x4624, 0x4623, 0x4623, 0x4622, // 37344
-    0x4621, 0x4620, 0x461f, 0x461f, 0x461e, 0x461d, 0x461c, 0x461b, // 37352
-    0x461a, 0x461a, 0x4619, 0x4618, 0x4617, 0x4616, 0x4616, 0x4615, // 37360
-    0x4614, 0x4613, 0x4612, 0x4612, 0x4611, 0x4610, 0x460f, 0x460e, // 37368
-    0x460e, 0x460d, 0x460c, 0x460b, 0x460a, 0x4609, 0x4609, 0x4608, // 37376
-    0x4607, 0x4606, 0x4605, 0x4605, 0x4604, 0x4603, 0x4602, 0x4601, // 37384
-    0x4601, 0x4600, 0x45ff, 0x45fe, 0x45fd, 0x45fc, 0x45fc, 0x45fb, // 37392
-    0x45fa, 0x45f9, 0x45f8, 0x45f8, 0x45f7, 0x45f6, 0x45f5, 0x45f4, // 37400
-    0x45f4, 0x45f3, 0x45f2, 0x45f1, 0x45f0, 0x45f0, 0x45ef, 0x45ee, // 37408
-    0x45ed, 0x45ec, 0x45eb, 0x45eb, 0x45ea, 0x45e9, 0x45e8, 0x45e7, // 37416
-    0x45e7, 0x45e6, 0x45e5, 0x45e4, 0x45e3, 0x45e3, 0x45e2, 0x45e1, // 37424
-    0x45e0, 0x45df, 0x45de, 0x45de, 0x45dd, 0x45dc, 0x45db, 0x45da, // 37432
-    0x45da, 0x45d9, 0x45d8, 0x45d7, 0x45d6, 0x45d6, 0x45d5, 0x45d4, // 37440
-    0x45d3, 0x45d2, 0x45d2, 0x45d1, 0x45d0, 0x45cf, 0x45ce, 0x45cd, // 37448
-    0x45cd, 0x45cc, 0x45cb, 0x45ca, 0x45c9, 0x45c9, 0x45c8, 0x45c7, // 37456
-    0x45c6, 0x45c5, 0x45c5, 0x45c4, 0x45c3, 0x45c2, 0x45c1, 0x45c0, // 37464
-    0x45c0, 0x45bf, 0x45be, 0x45bd, 0x45bc, 0x45bc, 0x45bb, 0x45ba, // 37472
-    0x45b9, 0x45b8, 0x45b8, 0x45b7, 0x45b6, 0x45b5, 0x45b4, 0x45b4, // 37480
-    0x45b3, 0x45b2, 0x45b1, 0x45b0, 0x45af, 0x45af, 0x45ae, 0x45ad, // 37488
-    0x45ac, 0x45ab, 0x45ab, 0x45aa, 0x45a9, 0x45a8, 0x45a7, 0x45a7, // 37496
-    0x45a6, 0x45a5, 0x45a4, 0x45a3, 0x45a3, 0x45a2, 0x45a1, 0x45a0, // 37504
-    0x459f, 0x459e, 0x459e, 0x459d, 0x459c, 0x459b, 0x459a, 0x459a, // 37512
-    0x4599, 0x4598, 0x4597, 0x4596, 0x4596, 0x4595, 0x4594, 0x4593, // 37520
-    0x4592, 0x4591, 0x4591, 0x4590, 0x458f, 0x458e, 0x458d, 0x458d, // 37528
-    0x458c, 0x458b, 0x458a, 0x4589, 0x4589, 0x4588, 0x4587, 0x4586, // 37536
-    0x4585, 0x4585, 0x4584, 0x4583, 0x4582, 0x4581, 0x4580, 0x4580, // 37544
-    0x457f, 0x457e, 0x457d, 0x457c, 0x457c, 0x457b, 0x457a, 0x4579, // 37552
-    0x4578, 0x4578, 0x4577, 0x4576, 0x4575, 0x4574, 0x4573, 0x4573, // 37560
-    0x4572, 0x4571, 0x4570, 0x456f, 0x456f, 0x456e, 0x456d, 0x456c, // 37568
-    0x456b, 0x456b, 0x456a, 0x4569, 0x4568, 0x4567, 0x4567, 0x4566, // 37576
-    0x4565, 0x4564, 0x4563, 0x4562, 0x4562, 0x4561, 0x4560, 0x455f, // 37584
-    0x455e, 0x455e, 0x455d, 0x455c, 0x455b, 0x455a, 0x455a, 0x4559, // 37592
-    0x4558, 0x4557, 0x4556, 0x4556, 0x4555, 0x4554, 0x4553, 0x4552, // 37600
-    0x4551, 0x4551, 0x4550, 0x454f, 0x454e, 0x454d, 0x454d, 0x454c, // 37608
-    0x454b, 0x454a, 0x4549, 0x4549, 0x4548, 0x4547, 0x4546, 0x4545, // 37616
-    0x4544, 0x4544, 0x4543, 0x4542, 0x4541, 0x4540, 0x4540, 0x453f, // 37624
-    0x453e, 0x453d, 0x453c, 0x453c, 0x453b, 0x453a, 0x4539, 0x4538, // 37632
-    0x4538, 0x4537, 0x4536, 0x4535, 0x4534, 0x4533, 0x4533, 0x4532, // 37640
-    0x4531, 0x4530, 0x452f, 0x452f, 0x452e, 0x452d, 0x452c, 0x452b, // 37648
-    0x452b, 0x452a, 0x4529, 0x4528, 0x4527, 0x4526, 0x4526, 0x4525, // 37656
-    0x4524, 0x4523, 0x4522, 0x4522, 0x4521, 0x4520, 0x451f, 0x451e, // 37664
-    0x451e, 0x451d, 0x451c, 0x451b, 0x451a, 0x451a, 0x4519, 0x4518, // 37672
-    0x4517, 0x4516, 0x4515, 0x4515, 0x4514, 0x4513, 0x4512, 0x4511, // 37680
-    0x4511, 0x4510, 0x450f, 0x450e, 0x450d, 0x450d, 0x450c, 0x450b, // 37688
-    0x450a, 0x4509, 0x4509, 0x4508, 0x4507, 0x4506, 0x4505, 0x4504, // 37696
-    0x4504, 0x4503, 0x4502, 0x4501, 0x4500, 0x4500, 0x44ff, 0x44fe, // 37704
-    0x44fd, 0x44fc, 0x44fc, 0x44fb, 0x44fa, 0x44f9, 0x44f8, 0x44f7, // 37712
-    0x44f7, 0x44f6, 0x44f5, 0x44f4, 0x44f3, 0x44f3, 0x44f2, 0x44f1, // 37720
-    0x44f0, 0x44ef, 0x44ef, 0x44ee, 0x44ed, 0x44ec, 0x44eb, 0x44eb, // 37728
-    0x44ea, 0x44e9, 0x44e8, 0x44e7, 0x44e6, 0x44e6, 0x44e5, 0x44e4, // 37736
-    0x44e3, 0x44e2, 0x44e2, 0x44e1, 0x44e0, 0x44df, 0x44de, 0x44de, // 37744
-    0x44dd, 0x44dc, 0x44db, 0x44da, 0x44d9, 0x44d9, 0x44d8, 0x44d7, // 37752
-    0x44d6, 0x44d5, 0x44d5, 0x44d4, 0x44d3, 0x44d2, 0x44d1, 0x44d1, // 37760
-    0x44d0, 0x44cf, 0x44ce, 0x44cd, 0x44cd, 0x44cc, 0x44cb, 0x44ca, // 37768
-    0x44c9, 0x44c8, 0x44c8, 0x44c7, 0x44c6, 0x44c5, 0x44c4, 0x44c4, // 37776
-    0x44c3, 0x44c2, 0x44c1, 0x44c0, 0x44c0, 0x44bf, 0x44be, 0x44bd, // 37784
-    0x44bc, 0x44bc, 0x44bb, 0x44ba, 0x44b9, 0x44b8, 0x44b7, 0x44b7, // 37792
-    0x44b6, 0x44b5, 0x44b4, 0x44b3, 0x44b3, 0x44b2, 0x44b1, 0x44b0, // 37800
-    0x44af, 0x44af, 0x44ae, 0x44ad, 0x44ac, 0x44ab, 0x44aa, 0x44aa, // 37808
-    0x44a9, 0x44a8, 0x44a7, 0x44a6, 0x44a6, 0x44a5, 0x44a4, 0x44a3, // 37816
-    0x44a2, 0x44a2, 0x44a1, 0x44a0, 0x449f, 0x449e, 0x449e, 0x449d, // 37824
-    0x449c, 0x449b, 0x449a, 0x4499, 0x4499, 0x4498, 0x4497, 0x4496, // 37832
-    0x4495, 0x4495, 0x4494, 0x4493, 0x4492, 0x4491, 0x4491, 0x4490, // 37840
-    0x448f, 0x448e, 0x448d, 0x448c, 0x448c, 0x448b, 0x448a, 0x4489, // 37848
-    0x4488, 0x4488, 0x4487, 0x4486, 0x4485, 0x4484, 0x4484, 0x4483, // 37856
-    0x4482, 0x4481, 0x4480, 0x4480, 0x447f, 0x447e, 0x447d, 0x447c, // 37864
-    0x447b, 0x447b, 0x447a, 0x4479, 0x4478, 0x4477, 0x4477, 0x4476, // 37872
-    0x4475, 0x4474, 0x4473, 0x4473, 0x4472, 0x4471, 0x4470, 0x446f, // 37880
-    0x446e, 0x446d, 0x446c, 0x446c, 0x446b, 0x446a, 0x4469, 0x4468, // 37888
-    0x4468, 0x4467, 0x4466, 0x4465, 0x4464, 0x4464, 0x4463, 0x4462, // 37896
-    0x4461, 0x4460, 0x4460, 0x445f, 0x445e, 0x445d, 0x445d, 0x445c, // 37904
-    0x445b, 0x445a, 0x4459, 0x4459, 0x4458, 0x4457, 0x4456, 0x4455, // 37912
-    0x4455, 0x4454, 0x4453, 0x4452, 0x4451, 0x4451, 0x4450, 0x444f, // 37920
-    0x444e, 0x444d, 0x444d, 0x444c, 0x444b, 0x444a, 0x4449, 0x4449, // 37928
-    0x4448, 0x4447, 0x4446, 0x4445, 0x4445, 0x4444, 0x4443, 0x4442, // 37936
-    0x4441, 0x4441, 0x4440, 0x443f, 0x443e, 0x443e, 0x443d, 0x443c, // 37944
-    0x443b, 0x443a, 0x443a, 0x4439, 0x4438, 0x4437, 0x4436, 0x4436, // 37952
-    0x4435, 0x4434, 0x4433, 0x4432, 0x4432, 0x4431, 0x4430, 0x442f, // 37960
-    0x442e, 0x442e, 0x442d, 0x442c, 0x442b, 0x442a, 0x442a, 0x4429, // 37968
-    0x4428, 0x4427, 0x4426, 0x4426, 0x4425, 0x4424, 0x4423, 0x4422, // 37976
-    0x4422, 0x4421, 0x4420, 0x441f, 0x441f, 0x441e, 0x441d, 0x441c, // 37984
-    0x441b, 0x441b, 0x441a, 0x4419, 0x4418, 0x4417, 0x4417, 0x4416, // 37992
-    0x4415, 0x4414, 0x4413, 0x4413, 0x4412, 0x4411, 0x4410, 0x440f, // 38000
-    0x440f, 0x440e, 0x440d, 0x440c, 0x440b, 0x440b, 0x440a, 0x4409, // 38008
-    0x4408, 0x4407, 0x4407, 0x4406, 0x4405, 0x4404, 0x4403, 0x4403, // 38016
-    0x4402, 0x4401, 0x4400, 0x4400, 0x43ff, 0x43fe, 0x43fd, 0x43fc, // 38024
-    0x43fc, 0x43fb, 0x43fa, 0x43f9, 0x43f8, 0x43f8, 0x43f7, 0x43f6, // 38032
-    0x43f5, 0x43f4, 0x43f4, 0x43f3, 0x43f2, 0x43f1, 0x43f0, 0x43f0, // 38040
-    0x43ef, 0x43ee, 0x43ed, 0x43ec, 0x43ec, 0x43eb, 0x43ea, 0x43e9, // 38048
-    0x43e8, 0x43e8, 0x43e7, 0x43e6, 0x43e5, 0x43e4, 0x43e4, 0x43e3, // 38056
-    0x43e2, 0x43e1, 0x43e1, 0x43e0, 0x43df, 0x43de, 0x43dd, 0x43dd, // 38064
-    0x43dc, 0x43db, 0x43da, 0x43d9, 0x43d9, 0x43d8, 0x43d7, 0x43d6, // 38072
-    0x43d5, 0x43d5, 0x43d4, 0x43d3, 0x43d2, 0x43d1, 0x43d1, 0x43d0, // 38080
-    0x43cf, 0x43ce, 0x43cd, 0x43cd, 0x43cc, 0x43cb, 0x43ca, 0x43c9, // 38088
-    0x43c9, 0x43c8, 0x43c7, 0x43c6, 0x43c5, 0x43c5, 0x43c4, 0x43c3, // 38096
-    0x43c2, 0x43c2, 0x43c1, 0x43c0, 0x43bf, 0x43be, 0x43be, 0x43bd, // 38104
-    0x43bc, 0x43bb, 0x43ba, 0x43ba, 0x43b9, 0x43b8, 0x43b7, 0x43b6, // 38112
-    0x43b6, 0x43b5, 0x43b4, 0x43b3, 0x43b2, 0x43b2, 0x43b1, 0x43b0, // 38120
-    0x43af, 0x43ae, 0x43ae, 0x43ad, 0x43ac, 0x43ab, 0x43aa, 0x43aa, // 38128
-    0x43a9, 0x43a8, 0x43a7, 0x43a6, 0x43a6, 0x43a5, 0x43a4, 0x43a3, // 38136
-    0x43a3, 0x43a2, 0x43a1, 0x43a0, 0x439f, 0x439f, 0x439e, 0x439d, // 38144
-    0x439c, 0x439b, 0x439b, 0x439a, 0x4399, 0x4398, 0x4397, 0x4397, // 38152
-    0x4396, 0x4395, 0x4394, 0x4393, 0x4393, 0x4392, 0x4391, 0x4390, // 38160
-    0x438f, 0x438f, 0x438e, 0x438d, 0x438c, 0x438b, 0x438b, 0x438a, // 38168
-    0x4389, 0x4388, 0x4387, 0x4387, 0x4386, 0x4385, 0x4384, 0x4383, // 38176
-    0x4383, 0x4382, 0x4381, 0x4380, 0x4380, 0x437f, 0x437e, 0x437d, // 38184
-    0x437c, 0x437c, 0x437b, 0x437a, 0x4379, 0x4378, 0x4378, 0x4377, // 38192
-    0x4376, 0x4375, 0x4374, 0x4374, 0x4373, 0x4372, 0x4371, 0x4370, // 38200
-    0x4370, 0x436f, 0x436e, 0x436d, 0x436c, 0x436c, 0x436b, 0x436a, // 38208
-    0x4369, 0x4368, 0x4368, 0x4367, 0x4366, 0x4365, 0x4364, 0x4364, // 38216
-    0x4363, 0x4362, 0x4361, 0x4361, 0x4360, 0x435f, 0x435e, 0x435d, // 38224
-    0x435d, 0x435c, 0x435b, 0x435a, 0x4359, 0x4359, 0x4358, 0x4357, // 38232
-    0x4356, 0x4355, 0x4355, 0x4354, 0x4353, 0x4352, 0x4351, 0x4351, // 38240
-    0x4350, 0x434f, 0x434e, 0x434d, 0x434d, 0x434c, 0x434b, 0x434a, // 38248
-    0x4349, 0x4349, 0x4348, 0x4347, 0x4346, 0x4345, 0x4345, 0x4344, // 38256
-    0x4343, 0x4342, 0x4342, 0x4341, 0x4340, 0x433f, 0x433e, 0x433e, // 38264
-    0x433d, 0x433c, 0x433b, 0x433a, 0x433a, 0x4339, 0x4338, 0x4337, // 38272
-    0x4336, 0x4336, 0x4335, 0x4334, 0x4333, 0x4332, 0x4332, 0x4331, // 38280
-    0x4330, 0x432f, 0x432e, 0x432e, 0x432d, 0x432c, 0x432b, 0x432a, // 38288
-    0x432a, 0x4329, 0x4328, 0x4327, 0x4326, 0x4326, 0x4325, 0x4324, // 38296
-    0x4323, 0x4323, 0x4322, 0x4321, 0x4320, 0x431f, 0x431f, 0x431e, // 38304
-    0x431d, 0x431c, 0x431b, 0x431b, 0x431a, 0x4319, 0x4318, 0x4317, // 38312
-    0x4317, 0x4316, 0x4315, 0x4314, 0x4313, 0x4313, 0x4312, 0x4311, // 38320
-    0x4310, 0x430f, 0x430f, 0x430e, 0x430d, 0x430c, 0x430b, 0x430b, // 38328
-    0x430a, 0x4309, 0x4308, 0x4307, 0x4307, 0x4306, 0x4305, 0x4304, // 38336
-    0x4304, 0x4303, 0x4302, 0x4301, 0x4300, 0x4300, 0x42ff, 0x42fe, // 38344
-    0x42fd, 0x42fc, 0x42fc, 0x42fb, 0x42fa, 0x42f9, 0x42f8, 0x42f8, // 38352
-    0x42f7, 0x42f6, 0x42f5, 0x42f4, 0x42f4, 0x42f3, 0x42f2, 0x42f1, // 38360
-    0x42f0, 0x42f0, 0x42ef, 0x42ee, 0x42ed, 0x42ec, 0x42ec, 0x42eb, // 38368
-    0x42ea, 0x42e9, 0x42e8, 0x42e8, 0x42e7, 0x42e6, 0x42e5, 0x42e5, // 38376
-    0x42e4, 0x42e3, 0x42e2, 0x42e1, 0x42e1, 0x42e0, 0x42df, 0x42de, // 38384
-    0x42dd, 0x42dd, 0x42dc, 0x42db, 0x42da, 0x42d9, 0x42d9, 0x42d8, // 38392
-    0x42d7, 0x42d6, 0x42d5, 0x42d5, 0x42d4, 0x42d3, 0x42d2, 0x42d1, // 38400
-    0x42d1, 0x42d0, 0x42cf, 0x42ce, 0x42cd, 0x42cd, 0x42cc, 0x42cb, // 38408
-    0x42ca, 0x42c9, 0x42c9, 0x42c8, 0x42c7, 0x42c6, 0x42c6, 0x42c5, // 38416
-    0x42c4, 0x42c3, 0x42c2, 0x42c2, 0x42c1, 0x42c0, 0x42bf, 0x42be, // 38424
-    0x42be, 0x42bd, 0x42bc, 0x42bb, 0x42ba, 0x42ba, 0x42b9, 0x42b8, // 38432
-    0x42b7, 0x42b6, 0x42b6, 0x42b5, 0x42b4, 0x42b3, 0x42b2, 0x42b2, // 38440
-    0x42b1, 0x42b0, 0x42af, 0x42ae, 0x42ae, 0x42ad, 0x42ac, 0x42ab, // 38448
-    0x42aa, 0x42aa, 0x42a9, 0x42a8, 0x42a7, 0x42a7, 0x42a6, 0x42a5, // 38456
-    0x42a4, 0x42a3, 0x42a3, 0x42a2, 0x42a1, 0x42a0, 0x429f, 0x429f, // 38464
-    0x429e, 0x429d, 0x429c, 0x429b, 0x429b, 0x429a, 0x4299, 0x4298, // 38472
-    0x4297, 0x4297, 0x4296, 0x4295, 0x4294, 0x4293, 0x4293, 0x4292, // 38480
-    0x4291, 0x4290, 0x428f, 0x428f, 0x428e, 0x428d, 0x428c, 0x428b, // 38488
-    0x428b, 0x428a, 0x4289, 0x4288, 0x4288, 0x4287, 0x4286, 0x4285, // 38496
-    0x4284, 0x4284, 0x4283, 0x4282, 0x4281, 0x4280, 0x4280, 0x427f, // 38504
-    0x427e, 0x427d, 0x427c, 0x427c, 0x427b, 0x427a, 0x4279, 0x4278, // 38512
-    0x4278, 0x4277, 0x4276, 0x4275, 0x4274, 0x4274, 0x4273, 0x4272, // 38520
-    0x4271, 0x4270, 0x4270, 0x426f, 0x426e, 0x426d, 0x426c, 0x426c, // 38528
-    0x426b, 0x426a, 0x4269, 0x4269, 0x4268, 0x4267, 0x4266, 0x4265, // 38536
-    0x4265, 0x4264, 0x4263, 0x4262, 0x4261, 0x4261, 0x4260, 0x425f, // 38544
-    0x425e, 0x425d, 0x425d, 0x425c, 0x425b, 0x425a, 0x4259, 0x4259, // 38552
-    0x4258, 0x4257, 0x4256, 0x4255, 0x4255, 0x4254, 0x4253, 0x4252, // 38560
-    0x4251, 0x4251, 0x4250, 0x424f, 0x424e, 0x424d, 0x424d, 0x424c, // 38568
-    0x424b, 0x424a, 0x424a, 0x4249, 0x4248, 0x4247, 0x4246, 0x4246, // 38576
-    0x4245, 0x4244, 0x4243, 0x4242, 0x4242, 0x4241, 0x4240, 0x423f, // 38584
-    0x423e, 0x423e, 0x423d, 0x423c, 0x423b, 0x423a, 0x423a, 0x4239, // 38592
-    0x4238, 0x4237, 0x4236, 0x4236, 0x4235, 0x4234, 0x4233, 0x4232, // 38600
-    0x4232, 0x4231, 0x4230, 0x422f, 0x422e, 0x422e, 0x422d, 0x422c, // 38608
-    0x422b, 0x422b, 0x422a, 0x4229, 0x4228, 0x4227, 0x4227, 0x4226, // 38616
-    0x4225, 0x4224, 0x4223, 0x4223, 0x4222, 0x4221, 0x4220, 0x421f, // 38624
-    0x421f, 0x421e, 0x421d, 0x421c, 0x421b, 0x421b, 0x421a, 0x4219, // 38632
-    0x4218, 0x4217, 0x4217, 0x4216, 0x4215, 0x4214, 0x4213, 0x4213, // 38640
-    0x4212, 0x4211, 0x4210, 0x420f, 0x420f, 0x420e, 0x420d, 0x420c, // 38648
-    0x420c, 0x420b, 0x420a, 0x4209, 0x4208, 0x4208, 0x4207, 0x4206, // 38656
-    0x4205, 0x4204, 0x4204, 0x4203, 0x4202, 0x4201, 0x4200, 0x4200, // 38664
-    0x41ff, 0x41fe, 0x41fd, 0x41fc, 0x41fc, 0x41fb, 0x41fa, 0x41f9, // 38672
-    0x41f8, 0x41f8, 0x41f7, 0x41f6, 0x41f5, 0x41f4, 0x41f4, 0x41f3, // 38680
-    0x41f2, 0x41f1, 0x41f0, 0x41f0, 0x41ef, 0x41ee, 0x41ed, 0x41ec, // 38688
-    0x41ec, 0x41eb, 0x41ea, 0x41e9, 0x41e9, 0x41e8, 0x41e7, 0x41e6, // 38696
-    0x41e5, 0x41e5, 0x41e4, 0x41e3, 0x41e2, 0x41e1, 0x41e1, 0x41e0, // 38704
-    0x41df, 0x41de, 0x41dd, 0x41dd, 0x41dc, 0x41db, 0x41da, 0x41d9, // 38712
-    0x41d9, 0x41d8, 0x41d7, 0x41d6, 0x41d5, 0x41d5, 0x41d4, 0x41d3, // 38720
-    0x41d2, 0x41d1, 0x41d1, 0x41d0, 0x41cf, 0x41ce, 0x41cd, 0x41cd, // 38728
-    0x41cc, 0x41cb, 0x41ca, 0x41ca, 0x41c9, 0x41c8, 0x41c7, 0x41c6, // 38736
-    0x41c6, 0x41c5, 0x41c4, 0x41c3, 0x41c2, 0x41c2, 0x41c1, 0x41c0, // 38744
-    0x41bf, 0x41be, 0x41be, 0x41bd, 0x41bc, 0x41bb, 0x41ba, 0x41ba, // 38752
-    0x41b9, 0x41b8, 0x41b7, 0x41b6, 0x41b6, 0x41b5, 0x41b4, 0x41b3, // 38760
-    0x41b2, 0x41b2, 0x41b1, 0x41b0, 0x41af, 0x41ae, 0x41ae, 0x41ad, // 38768
-    0x41ac, 0x41ab, 0x41ab, 0x41aa, 0x41a9, 0x41a8, 0x41a7, 0x41a7, // 38776
-    0x41a6, 0x41a5, 0x41a4, 0x41a3, 0x41a3, 0x41a2, 0x41a1, 0x41a0, // 38784
-    0x419f, 0x419f, 0x419e, 0x419d, 0x419c, 0x419b, 0x419b, 0x419a, // 38792
-    0x4199, 0x4198, 0x4197, 0x4197, 0x4196, 0x4195, 0x4194, 0x4193, // 38800
-    0x4193, 0x4192, 0x4191, 0x4190, 0x418f, 0x418f, 0x418e, 0x418d, // 38808
-    0x418c, 0x418c, 0x418b, 0x418a, 0x4189, 0x4188, 0x4188, 0x4187, // 38816
-    0x4186, 0x4185, 0x4184, 0x4184, 0x4183, 0x4182, 0x4181, 0x4180, // 38824
-    0x4180, 0x417f, 0x417e, 0x417d, 0x417c, 0x417c, 0x417b, 0x417a, // 38832
-    0x4179, 0x4178, 0x4178, 0x4177, 0x4176, 0x4175, 0x4174, 0x4174, // 38840
-    0x4173, 0x4172, 0x4171, 0x4170, 0x4170, 0x416f, 0x416e, 0x416d, // 38848
-    0x416d, 0x416c, 0x416b, 0x416a, 0x4169, 0x4169, 0x4168, 0x4167, // 38856
-    0x4166, 0x4165, 0x4165, 0x4164, 0x4163, 0x4162, 0x4161, 0x4161, // 38864
-    0x4160, 0x415f, 0x415e, 0x415d, 0x415d, 0x415c, 0x415b, 0x415a, // 38872
-    0x4159, 0x4159, 0x4158, 0x4157, 0x4156, 0x4155, 0x4155, 0x4154, // 38880
-    0x4153, 0x4152, 0x4151, 0x4151, 0x4150, 0x414f, 0x414e, 0x414e, // 38888
-    0x414d, 0x414c, 0x414b, 0x414a, 0x414a, 0x4149, 0x4148, 0x4147, // 38896
-    0x4146, 0x4146, 0x4145, 0x4144, 0x4143, 0x4142, 0x4142, 0x4141, // 38904
-    0x4140, 0x413f, 0x413e, 0x413d, 0x413c, 0x413c, 0x413b, 0x413a, // 38912
-    0x4139, 0x4138, 0x4138, 0x4137, 0x4136, 0x4135, 0x4135, 0x4134, // 38920
-    0x4133, 0x4132, 0x4131, 0x4131, 0x4130, 0x412f, 0x412e, 0x412e, // 38928
-    0x412d, 0x412c, 0x412b, 0x412a, 0x412a, 0x4129, 0x4128, 0x4127, // 38936
-    0x4127, 0x4126, 0x4125, 0x4124, 0x4123, 0x4123, 0x4122, 0x4121, // 38944
-    0x4120, 0x4120, 0x411f, 0x411e, 0x411d, 0x411c, 0x411c, 0x411b, // 38952
-    0x411a, 0x4119, 0x4119, 0x4118, 0x4117, 0x4116, 0x4115, 0x4115, // 38960
-    0x4114, 0x4113, 0x4112, 0x4112, 0x4111, 0x4110, 0x410f, 0x410e, // 38968
-    0x410e, 0x410d, 0x410c, 0x410b, 0x410b, 0x410a, 0x4109, 0x4108, // 38976
-    0x4107, 0x4107, 0x4106, 0x4105, 0x4104, 0x4103, 0x4103, 0x4102, // 38984
-    0x4101, 0x4100, 0x4100, 0x40ff, 0x40fe, 0x40fd, 0x40fc, 0x40fc, // 38992
-    0x40fb, 0x40fa, 0x40f9, 0x40f9, 0x40f8, 0x40f7, 0x40f6, 0x40f5, // 39000
-    0x40f5, 0x40f4, 0x40f3, 0x40f2, 0x40f2, 0x40f1, 0x40f0, 0x40ef, // 39008
-    0x40ee, 0x40ee, 0x40ed, 0x40ec, 0x40eb, 0x40eb, 0x40ea, 0x40e9, // 39016
-    0x40e8, 0x40e7, 0x40e7, 0x40e6, 0x40e5, 0x40e4, 0x40e4, 0x40e3, // 39024
-    0x40e2, 0x40e1, 0x40e0, 0x40e0, 0x40df, 0x40de, 0x40dd, 0x40dd, // 39032
-    0x40dc, 0x40db, 0x40da, 0x40d9, 0x40d9, 0x40d8, 0x40d7, 0x40d6, // 39040
-    0x40d6, 0x40d5, 0x40d4, 0x40d3, 0x40d2, 0x40d2, 0x40d1, 0x40d0, // 39048
-    0x40cf, 0x40cf, 0x40ce, 0x40cd, 0x40cc, 0x40cb, 0x40cb, 0x40ca, // 39056
-    0x40c9, 0x40c8, 0x40c7, 0x40c7, 0x40c6, 0x40c5, 0x40c4, 0x40c4, // 39064
-    0x40c3, 0x40c2, 0x40c1, 0x40c0, 0x40c0, 0x40bf, 0x40be, 0x40bd, // 39072
-    0x40bd, 0x40bc, 0x40bb, 0x40ba, 0x40b9, 0x40b9, 0x40b8, 0x40b7, // 39080
-    0x40b6, 0x40b6, 0x40b5, 0x40b4, 0x40b3, 0x40b2, 0x40b2, 0x40b1, // 39088
-    0x40b0, 0x40af, 0x40af, 0x40ae, 0x40ad, 0x40ac, 0x40ab, 0x40ab, // 39096
-    0x40aa, 0x40a9, 0x40a8, 0x40a8, 0x40a7, 0x40a6, 0x40a5, 0x40a4, // 39104
-    0x40a4, 0x40a3, 0x40a2, 0x40a1, 0x40a1, 0x40a0, 0x409f, 0x409e, // 39112
-    0x409d, 0x409d, 0x409c, 0x409b, 0x409a, 0x409a, 0x4099, 0x4098, // 39120
-    0x4097, 0x4096, 0x4096, 0x4095, 0x4094, 0x4093, 0x4092, 0x4092, // 39128
-    0x4091, 0x4090, 0x408f, 0x408f, 0x408e, 0x408d, 0x408c, 0x408b, // 39136
-    0x408b, 0x408a, 0x4089, 0x4088, 0x4088, 0x4087, 0x4086, 0x4085, // 39144
-    0x4084, 0x4084, 0x4083, 0x4082, 0x4081, 0x4081, 0x4080, 0x407f, // 39152
-    0x407e, 0x407d, 0x407d, 0x407c, 0x407b, 0x407a, 0x407a, 0x4079, // 39160
-    0x4078, 0x4077, 0x4076, 0x4076, 0x4075, 0x4074, 0x4073, 0x4073, // 39168
-    0x4072, 0x4071, 0x4070, 0x406f, 0x406f, 0x406e, 0x406d, 0x406c, // 39176
-    0x406c, 0x406b, 0x406a, 0x4069, 0x4068, 0x4068, 0x4067, 0x4066, // 39184
-    0x4065, 0x4065, 0x4064, 0x4063, 0x4062, 0x4061, 0x4061, 0x4060, // 39192
-    0x405f, 0x405e, 0x405e, 0x405d, 0x405c, 0x405b, 0x405a, 0x405a, // 39200
-    0x4059, 0x4058, 0x4057, 0x4056, 0x4056, 0x4055, 0x4054, 0x4053, // 39208
-    0x4053, 0x4052, 0x4051, 0x4050, 0x404f, 0x404f, 0x404e, 0x404d, // 39216
-    0x404c, 0x404c, 0x404b, 0x404a, 0x4049, 0x4048, 0x4048, 0x4047, // 39224
-    0x4046, 0x4045, 0x4045, 0x4044, 0x4043, 0x4042, 0x4041, 0x4041, // 39232
-    0x4040, 0x403f, 0x403e, 0x403e, 0x403d, 0x403c, 0x403b, 0x403a, // 39240
-    0x403a, 0x4039, 0x4038, 0x4037, 0x4037, 0x4036, 0x4035, 0x4034, // 39248
-    0x4033, 0x4033, 0x4032, 0x4031, 0x4030, 0x4030, 0x402f, 0x402e, // 39256
-    0x402d, 0x402c, 0x402c, 0x402b, 0x402a, 0x4029, 0x4029, 0x4028, // 39264
-    0x4027, 0x4026, 0x4025, 0x4025, 0x4024, 0x4023, 0x4022, 0x4021, // 39272
-    0x4021, 0x4020, 0x401f, 0x401e, 0x401e, 0x401d, 0x401c, 0x401b, // 39280
-    0x401a, 0x401a, 0x4019, 0x4018, 0x4017, 0x4017, 0x4016, 0x4015, // 39288
-    0x4014, 0x4013, 0x4013, 0x4012, 0x4011, 0x4010, 0x4010, 0x400f, // 39296
-    0x400e, 0x400d, 0x400c, 0x400c, 0x400b, 0x400a, 0x4009, 0x4009, // 39304
-    0x4008, 0x4007, 0x4006, 0x4005, 0x4005, 0x4004, 0x4003, 0x4002, // 39312
-    0x4002, 0x4001, 0x4000, 0x3fff, 0x3ffe, 0x3ffe, 0x3ffd, 0x3ffc, // 39320
-    0x3ffb, 0x3ffb, 0x3ffa, 0x3ff9, 0x3ff8, 0x3ff7, 0x3ff7, 0x3ff6, // 39328
-    0x3ff5, 0x3ff4, 0x3ff4, 0x3ff3, 0x3ff2, 0x3ff1, 0x3ff0, 0x3ff0, // 39336
-    0x3fef, 0x3fee, 0x3fed, 0x3fed, 0x3fec, 0x3feb, 0x3fea, 0x3fe9, // 39344
-    0x3fe9, 0x3fe8, 0x3fe7, 0x3fe6, 0x3fe5, 0x3fe5, 0x3fe4, 0x3fe3, // 39352
-    0x3fe2, 0x3fe2, 0x3fe1, 0x3fe0, 0x3fdf, 0x3fde, 0x3fde, 0x3fdd, // 39360
-    0x3fdc, 0x3fdb, 0x3fdb, 0x3fda, 0x3fd9, 0x3fd8, 0x3fd7, 0x3fd7, // 39368
-    0x3fd6, 0x3fd5, 0x3fd4, 0x3fd4, 0x3fd3, 0x3fd2, 0x3fd1, 0x3fd0, // 39376
-    0x3fd0, 0x3fcf, 0x3fce, 0x3fcd, 0x3fcd, 0x3fcc, 0x3fcb, 0x3fca, // 39384
-    0x3fc9, 0x3fc9, 0x3fc8, 0x3fc7, 0x3fc6, 0x3fc6, 0x3fc5, 0x3fc4, // 39392
-    0x3fc3, 0x3fc2, 0x3fc2, 0x3fc1, 0x3fc0, 0x3fbf, 0x3fbf, 0x3fbe, // 39400
-    0x3fbd, 0x3fbc, 0x3fbb, 0x3fbb, 0x3fba, 0x3fb9, 0x3fb8, 0x3fb8, // 39408
-    0x3fb7, 0x3fb6, 0x3fb5, 0x3fb4, 0x3fb4, 0x3fb3, 0x3fb2, 0x3fb1, // 39416
-    0x3fb1, 0x3fb0, 0x3faf, 0x3fae, 0x3fad, 0x3fad, 0x3fac, 0x3fab, // 39424
-    0x3faa, 0x3fa9, 0x3fa9, 0x3fa8, 0x3fa7, 0x3fa6, 0x3fa6, 0x3fa5, // 39432
-    0x3fa4, 0x3fa3, 0x3fa2, 0x3fa2, 0x3fa1, 0x3fa0, 0x3f9f, 0x3f9f, // 39440
-    0x3f9e, 0x3f9d, 0x3f9c, 0x3f9b, 0x3f9b, 0x3f9a, 0x3f99, 0x3f98, // 39448
-    0x3f98, 0x3f97, 0x3f96, 0x3f95, 0x3f94, 0x3f94, 0x3f93, 0x3f92, // 39456
-    0x3f91, 0x3f91, 0x3f90, 0x3f8f, 0x3f8e, 0x3f8d, 0x3f8d, 0x3f8c, // 39464
-    0x3f8b, 0x3f8a, 0x3f8a, 0x3f89, 0x3f88, 0x3f87, 0x3f86, 0x3f86, // 39472
-    0x3f85, 0x3f84, 0x3f83, 0x3f83, 0x3f82, 0x3f81, 0x3f80, 0x3f7f, // 39480
-    0x3f7f, 0x3f7e, 0x3f7d, 0x3f7c, 0x3f7c, 0x3f7b, 0x3f7a, 0x3f79, // 39488
-    0x3f78, 0x3f78, 0x3f77, 0x3f76, 0x3f75, 0x3f74, 0x3f74, 0x3f73, // 39496
-    0x3f72, 0x3f71, 0x3f71, 0x3f70, 0x3f6f, 0x3f6e, 0x3f6d, 0x3f6d, // 39504
-    0x3f6c, 0x3f6b, 0x3f6a, 0x3f6a, 0x3f69, 0x3f68, 0x3f67, 0x3f66, // 39512
-    0x3f66, 0x3f65, 0x3f64, 0x3f63, 0x3f63, 0x3f62, 0x3f61, 0x3f60, // 39520
-    0x3f5f, 0x3f5f, 0x3f5e, 0x3f5d, 0x3f5c, 0x3f5c, 0x3f5b, 0x3f5a, // 39528
-    0x3f59, 0x3f58, 0x3f58, 0x3f57, 0x3f56, 0x3f55, 0x3f55, 0x3f54, // 39536
-    0x3f53, 0x3f52, 0x3f51, 0x3f51, 0x3f50, 0x3f4f, 0x3f4e, 0x3f4e, // 39544
-    0x3f4d, 0x3f4c, 0x3f4b, 0x3f4a, 0x3f4a, 0x3f49, 0x3f48, 0x3f47, // 39552
-    0x3f47, 0x3f46, 0x3f45, 0x3f44, 0x3f43, 0x3f43, 0x3f42, 0x3f41, // 39560
-    0x3f40, 0x3f40, 0x3f3f, 0x3f3e, 0x3f3d, 0x3f3c, 0x3f3c, 0x3f3b, // 39568
-    0x3f3a, 0x3f39, 0x3f38, 0x3f38, 0x3f37, 0x3f36, 0x3f35, 0x3f35, // 39576
-    0x3f34, 0x3f33, 0x3f32, 0x3f31, 0x3f31, 0x3f30, 0x3f2f, 0x3f2e, // 39584
-    0x3f2e, 0x3f2d, 0x3f2c, 0x3f2b, 0x3f2a, 0x3f2a, 0x3f29, 0x3f28, // 39592
-    0x3f27, 0x3f27, 0x3f26, 0x3f25, 0x3f24, 0x3f23, 0x3f23, 0x3f22, // 39600
-    0x3f21, 0x3f20, 0x3f20, 0x3f1f, 0x3f1e, 0x3f1d, 0x3f1c, 0x3f1c, // 39608
-    0x3f1b, 0x3f1a, 0x3f19, 0x3f19, 0x3f18, 0x3f17, 0x3f16, 0x3f15, // 39616
-    0x3f15, 0x3f14, 0x3f13, 0x3f12, 0x3f12, 0x3f11, 0x3f10, 0x3f0f, // 39624
-    0x3f0e, 0x3f0e, 0x3f0d, 0x3f0c, 0x3f0b, 0x3f0b, 0x3f0a, 0x3f09, // 39632
-    0x3f08, 0x3f07, 0x3f07, 0x3f06, 0x3f05, 0x3f04, 0x3f03, 0x3f03, // 39640
-    0x3f02, 0x3f01, 0x3f00, 0x3f00, 0x3eff, 0x3efe, 0x3efd, 0x3efc, // 39648
-    0x3efc, 0x3efb, 0x3efa, 0x3ef9, 0x3ef9, 0x3ef8, 0x3ef7, 0x3ef6, // 39656
-    0x3ef5, 0x3ef5, 0x3ef4, 0x3ef3, 0x3ef2, 0x3ef2, 0x3ef1, 0x3ef0, // 39664
-    0x3eef, 0x3eee, 0x3eee, 0x3eed, 0x3eec, 0x3eeb, 0x3eeb, 0x3eea, // 39672
-    0x3ee9, 0x3ee8, 0x3ee7, 0x3ee7, 0x3ee6, 0x3ee5, 0x3ee4, 0x3ee4, // 39680
-    0x3ee3, 0x3ee2, 0x3ee1, 0x3ee0, 0x3ee0, 0x3edf, 0x3ede, 0x3edd, // 39688
-    0x3edd, 0x3edc, 0x3edb, 0x3eda, 0x3ed9, 0x3ed9, 0x3ed8, 0x3ed7, // 39696
-    0x3ed6, 0x3ed6, 0x3ed5, 0x3ed4, 0x3ed3, 0x3ed2, 0x3ed2, 0x3ed1, // 39704
-    0x3ed0, 0x3ecf, 0x3ecf, 0x3ece, 0x3ecd, 0x3ecc, 0x3ecb, 0x3ecb, // 39712
-    0x3eca, 0x3ec9, 0x3ec8, 0x3ec7, 0x3ec7, 0x3ec6, 0x3ec5, 0x3ec4, // 39720
-    0x3ec4, 0x3ec3, 0x3ec2, 0x3ec1, 0x3ec0, 0x3ec0, 0x3ebf, 0x3ebe, // 39728
-    0x3ebd, 0x3ebd, 0x3ebc, 0x3ebb, 0x3eba, 0x3eb9, 0x3eb9, 0x3eb8, // 39736
-    0x3eb7, 0x3eb6, 0x3eb6, 0x3eb5, 0x3eb4, 0x3eb3, 0x3eb2, 0x3eb2, // 39744
-    0x3eb1, 0x3eb0, 0x3eaf, 0x3eaf, 0x3eae, 0x3ead, 0x3eac, 0x3eab, // 39752
-    0x3eab, 0x3eaa, 0x3ea9, 0x3ea8, 0x3ea8, 0x3ea7, 0x3ea6, 0x3ea5, // 39760
-    0x3ea4, 0x3ea4, 0x3ea3, 0x3ea2, 0x3ea1, 0x3ea1, 0x3ea0, 0x3e9f, // 39768
-    0x3e9e, 0x3e9d, 0x3e9d, 0x3e9c, 0x3e9b, 0x3e9a, 0x3e9a, 0x3e99, // 39776
-    0x3e98, 0x3e97, 0x3e96, 0x3e96, 0x3e95, 0x3e94, 0x3e93, 0x3e92, // 39784
-    0x3e92, 0x3e91, 0x3e90, 0x3e8f, 0x3e8f, 0x3e8e, 0x3e8d, 0x3e8c, // 39792
-    0x3e8b, 0x3e8b, 0x3e8a, 0x3e89, 0x3e88, 0x3e88, 0x3e87, 0x3e86, // 39800
-    0x3e85, 0x3e84, 0x3e84, 0x3e83, 0x3e82, 0x3e81, 0x3e81, 0x3e80, // 39808
-    0x3e7f, 0x3e7e, 0x3e7d, 0x3e7d, 0x3e7c, 0x3e7b, 0x3e7a, 0x3e7a, // 39816
-    0x3e79, 0x3e78, 0x3e77, 0x3e76, 0x3e76, 0x3e75, 0x3e74, 0x3e73, // 39824
-    0x3e73, 0x3e72, 0x3e71, 0x3e70, 0x3e6f, 0x3e6f, 0x3e6e, 0x3e6d, // 39832
-    0x3e6c, 0x3e6c, 0x3e6b, 0x3e6a, 0x3e69, 0x3e68, 0x3e68, 0x3e67, // 39840
-    0x3e66, 0x3e65, 0x3e65, 0x3e64, 0x3e63, 0x3e62, 0x3e61, 0x3e61, // 39848
-    0x3e60, 0x3e5f, 0x3e5e, 0x3e5e, 0x3e5d, 0x3e5c, 0x3e5b, 0x3e5a, // 39856
-    0x3e5a, 0x3e59, 0x3e58, 0x3e57, 0x3e56, 0x3e56, 0x3e55, 0x3e54, // 39864
-    0x3e53, 0x3e53, 0x3e52, 0x3e51, 0x3e50, 0x3e4f, 0x3e4f, 0x3e4e, // 39872
-    0x3e4d, 0x3e4c, 0x3e4c, 0x3e4b, 0x3e4a, 0x3e49, 0x3e48, 0x3e48, // 39880
-    0x3e47, 0x3e46, 0x3e45, 0x3e45, 0x3e44, 0x3e43, 0x3e42, 0x3e41, // 39888
-    0x3e41, 0x3e40, 0x3e3f, 0x3e3e, 0x3e3e, 0x3e3d, 0x3e3c, 0x3e3b, // 39896
-    0x3e3a, 0x3e3a, 0x3e39, 0x3e38, 0x3e37, 0x3e37, 0x3e36, 0x3e35, // 39904
-    0x3e34, 0x3e33, 0x3e33, 0x3e32, 0x3e31, 0x3e30, 0x3e30, 0x3e2f, // 39912
-    0x3e2e, 0x3e2d, 0x3e2c, 0x3e2c, 0x3e2b, 0x3e2a, 0x3e29, 0x3e29, // 39920
-    0x3e28, 0x3e27, 0x3e26, 0x3e25, 0x3e25, 0x3e24, 0x3e23, 0x3e22, // 39928
-    0x3e21, 0x3e20, 0x3e1f, 0x3e1f, 0x3e1e, 0x3e1d, 0x3e1c, 0x3e1c, // 39936
-    0x3e1b, 0x3e1a, 0x3e19, 0x3e19, 0x3e18, 0x3e17, 0x3e16, 0x3e16, // 39944
-    0x3e15, 0x3e14, 0x3e13, 0x3e12, 0x3e12, 0x3e11, 0x3e10, 0x3e0f, // 39952
-    0x3e0f, 0x3e0e, 0x3e0d, 0x3e0c, 0x3e0c, 0x3e0b, 0x3e0a, 0x3e09, // 39960
-    0x3e09, 0x3e08, 0x3e07, 0x3e06, 0x3e06, 0x3e05, 0x3e04, 0x3e03, // 39968
-    0x3e02, 0x3e02, 0x3e01, 0x3e00, 0x3dff, 0x3dff, 0x3dfe, 0x3dfd, // 39976
-    0x3dfc, 0x3dfc, 0x3dfb, 0x3dfa, 0x3df9, 0x3df9, 0x3df8, 0x3df7, // 39984
-    0x3df6, 0x3df5, 0x3df5, 0x3df4, 0x3df3, 0x3df2, 0x3df2, 0x3df1, // 39992
-    0x3df0, 0x3def, 0x3def, 0x3dee, 0x3ded, 0x3dec, 0x3dec, 0x3deb, // 40000
-    0x3dea, 0x3de9, 0x3de8, 0x3de8, 0x3de7, 0x3de6, 0x3de5, 0x3de5, // 40008
-    0x3de4, 0x3de3, 0x3de2, 0x3de2, 0x3de1, 0x3de0, 0x3ddf, 0x3ddf, // 40016
-    0x3dde, 0x3ddd, 0x3ddc, 0x3ddc, 0x3ddb, 0x3dda, 0x3dd9, 0x3dd8, // 40024
-    0x3dd8, 0x3dd7, 0x3dd6, 0x3dd5, 0x3dd5, 0x3dd4, 0x3dd3, 0x3dd2, // 40032
-    0x3dd2, 0x3dd1, 0x3dd0, 0x3dcf, 0x3dcf, 0x3dce, 0x3dcd, 0x3dcc, // 40040
-    0x3dcb, 0x3dcb, 0x3dca, 0x3dc9, 0x3dc8, 0x3dc8, 0x3dc7, 0x3dc6, // 40048
-    0x3dc5, 0x3dc5, 0x3dc4, 0x3dc3, 0x3dc2, 0x3dc2, 0x3dc1, 0x3dc0, // 40056
-    0x3dbf, 0x3dbe, 0x3dbe, 0x3dbd, 0x3dbc, 0x3dbb, 0x3dbb, 0x3dba, // 40064
-    0x3db9, 0x3db8, 0x3db8, 0x3db7, 0x3db6, 0x3db5, 0x3db5, 0x3db4, // 40072
-    0x3db3, 0x3db2, 0x3db2, 0x3db1, 0x3db0, 0x3daf, 0x3dae, 0x3dae, // 40080
-    0x3dad, 0x3dac, 0x3dab, 0x3dab, 0x3daa, 0x3da9, 0x3da8, 0x3da8, // 40088
-    0x3da7, 0x3da6, 0x3da5, 0x3da5, 0x3da4, 0x3da3, 0x3da2, 0x3da1, // 40096
-    0x3da1, 0x3da0, 0x3d9f, 0x3d9e, 0x3d9e, 0x3d9d, 0x3d9c, 0x3d9b, // 40104
-    0x3d9b, 0x3d9a, 0x3d99, 0x3d98, 0x3d98, 0x3d97, 0x3d96, 0x3d95, // 40112
-    0x3d94, 0x3d94, 0x3d93, 0x3d92, 0x3d91, 0x3d91, 0x3d90, 0x3d8f, // 40120
-    0x3d8e, 0x3d8e, 0x3d8d, 0x3d8c, 0x3d8b, 0x3d8b, 0x3d8a, 0x3d89, // 40128
-    0x3d88, 0x3d88, 0x3d87, 0x3d86, 0x3d85, 0x3d84, 0x3d84, 0x3d83, // 40136
-    0x3d82, 0x3d81, 0x3d81, 0x3d80, 0x3d7f, 0x3d7e, 0x3d7e, 0x3d7d, // 40144
-    0x3d7c, 0x3d7b, 0x3d7b, 0x3d7a, 0x3d79, 0x3d78, 0x3d77, 0x3d77, // 40152
-    0x3d76, 0x3d75, 0x3d74, 0x3d74, 0x3d73, 0x3d72, 0x3d71, 0x3d71, // 40160
-    0x3d70, 0x3d6f, 0x3d6e, 0x3d6e, 0x3d6d, 0x3d6c, 0x3d6b, 0x3d6a, // 40168
-    0x3d6a, 0x3d69, 0x3d68, 0x3d67, 0x3d67, 0x3d66, 0x3d65, 0x3d64, // 40176
-    0x3d64, 0x3d63, 0x3d62, 0x3d61, 0x3d61, 0x3d60, 0x3d5f, 0x3d5e, // 40184
-    0x3d5e, 0x3d5d, 0x3d5c, 0x3d5b, 0x3d5a, 0x3d5a, 0x3d59, 0x3d58, // 40192
-    0x3d57, 0x3d57, 0x3d56, 0x3d55, 0x3d54, 0x3d54, 0x3d53, 0x3d52, // 40200
-    0x3d51, 0x3d51, 0x3d50, 0x3d4f, 0x3d4e, 0x3d4d, 0x3d4d, 0x3d4c, // 40208
-    0x3d4b, 0x3d4a, 0x3d4a, 0x3d49, 0x3d48, 0x3d47, 0x3d47, 0x3d46, // 40216
-    0x3d45, 0x3d44, 0x3d44, 0x3d43, 0x3d42, 0x3d41, 0x3d40, 0x3d40, // 40224
-    0x3d3f, 0x3d3e, 0x3d3d, 0x3d3d, 0x3d3c, 0x3d3b, 0x3d3a, 0x3d3a, // 40232
-    0x3d39, 0x3d38, 0x3d37, 0x3d37, 0x3d36, 0x3d35, 0x3d34, 0x3d33, // 40240
-    0x3d33, 0x3d32, 0x3d31, 0x3d30, 0x3d30, 0x3d2f, 0x3d2e, 0x3d2d, // 40248
-    0x3d2d, 0x3d2c, 0x3d2b, 0x3d2a, 0x3d2a, 0x3d29, 0x3d28, 0x3d27, // 40256
-    0x3d27, 0x3d26, 0x3d25, 0x3d24, 0x3d23, 0x3d23, 0x3d22, 0x3d21, // 40264
-    0x3d20, 0x3d20, 0x3d1f, 0x3d1e, 0x3d1d, 0x3d1d, 0x3d1c, 0x3d1b, // 40272
-    0x3d1a, 0x3d1a, 0x3d19, 0x3d18, 0x3d17, 0x3d16, 0x3d16, 0x3d15, // 40280
-    0x3d14, 0x3d13, 0x3d13, 0x3d12, 0x3d11, 0x3d10, 0x3d10, 0x3d0f, // 40288
-    0x3d0e, 0x3d0d, 0x3d0d, 0x3d0c, 0x3d0b, 0x3d0a, 0x3d09, 0x3d09, // 40296
-    0x3d08, 0x3d07, 0x3d06, 0x3d06, 0x3d05, 0x3d04, 0x3d03, 0x3d03, // 40304
-    0x3d02, 0x3d01, 0x3d00, 0x3d00, 0x3cff, 0x3cfe, 0x3cfd, 0x3cfd, // 40312
-    0x3cfc, 0x3cfb, 0x3cfa, 0x3cf9, 0x3cf9, 0x3cf8, 0x3cf7, 0x3cf6, // 40320
-    0x3cf6, 0x3cf5, 0x3cf4, 0x3cf3, 0x3cf3, 0x3cf2, 0x3cf1, 0x3cf0, // 40328
-    0x3cf0, 0x3cef, 0x3cee, 0x3ced, 0x3cec, 0x3cec, 0x3ceb, 0x3cea, // 40336
-    0x3ce9, 0x3ce9, 0x3ce8, 0x3ce7, 0x3ce6, 0x3ce6, 0x3ce5, 0x3ce4, // 40344
-    0x3ce3, 0x3ce3, 0x3ce2, 0x3ce1, 0x3ce0, 0x3cdf, 0x3cdf, 0x3cde, // 40352
-    0x3cdd, 0x3cdc, 0x3cdc, 0x3cdb, 0x3cda, 0x3cd9, 0x3cd9, 0x3cd8, // 40360
-    0x3cd7, 0x3cd6, 0x3cd6, 0x3cd5, 0x3cd4, 0x3cd3, 0x3cd3, 0x3cd2, // 40368
-    0x3cd1, 0x3cd0, 0x3ccf, 0x3ccf, 0x3cce, 0x3ccd, 0x3ccc, 0x3ccc, // 40376
-    0x3ccb, 0x3cca, 0x3cc9, 0x3cc9, 0x3cc8, 0x3cc7, 0x3cc6, 0x3cc6, // 40384
-    0x3cc5, 0x3cc4, 0x3cc3, 0x3cc2, 0x3cc2, 0x3cc1, 0x3cc0, 0x3cbf, // 40392
-    0x3cbf, 0x3cbe, 0x3cbd, 0x3cbc, 0x3cbc, 0x3cbb, 0x3cba, 0x3cb9, // 40400
-    0x3cb9, 0x3cb8, 0x3cb7, 0x3cb6, 0x3cb5, 0x3cb5, 0x3cb4, 0x3cb3, // 40408
-    0x3cb2, 0x3cb2, 0x3cb1, 0x3cb0, 0x3caf, 0x3caf, 0x3cae, 0x3cad, // 40416
-    0x3cac, 0x3cac, 0x3cab, 0x3caa, 0x3ca9, 0x3ca9, 0x3ca8, 0x3ca7, // 40424
-    0x3ca6, 0x3ca5, 0x3ca5, 0x3ca4, 0x3ca3, 0x3ca2, 0x3ca2, 0x3ca1, // 40432
-    0x3ca0, 0x3c9f, 0x3c9f, 0x3c9e, 0x3c9d, 0x3c9c, 0x3c9c, 0x3c9b, // 40440
-    0x3c9a, 0x3c99, 0x3c98, 0x3c98, 0x3c97, 0x3c96, 0x3c95, 0x3c95, // 40448
-    0x3c94, 0x3c93, 0x3c92, 0x3c92, 0x3c91, 0x3c90, 0x3c8f, 0x3c8f, // 40456
-    0x3c8e, 0x3c8d, 0x3c8c, 0x3c8b, 0x3c8b, 0x3c8a, 0x3c89, 0x3c88, // 40464
-    0x3c88, 0x3c87, 0x3c86, 0x3c85, 0x3c85, 0x3c84, 0x3c83, 0x3c82, // 40472
-    0x3c82, 0x3c81, 0x3c80, 0x3c7f, 0x3c7f, 0x3c7e, 0x3c7d, 0x3c7c, // 40480
-    0x3c7b, 0x3c7b, 0x3c7a, 0x3c79, 0x3c78, 0x3c78, 0x3c77, 0x3c76, // 40488
-    0x3c75, 0x3c75, 0x3c74, 0x3c73, 0x3c72, 0x3c72, 0x3c71, 0x3c70, // 40496
-    0x3c6f, 0x3c6e, 0x3c6e, 0x3c6d, 0x3c6c, 0x3c6b, 0x3c6b, 0x3c6a, // 40504
-    0x3c69, 0x3c68, 0x3c68, 0x3c67, 0x3c66, 0x3c65, 0x3c65, 0x3c64, // 40512
-    0x3c63, 0x3c62, 0x3c61, 0x3c61, 0x3c60, 0x3c5f, 0x3c5e, 0x3c5e, // 40520
-    0x3c5d, 0x3c5c, 0x3c5b, 0x3c5b, 0x3c5a, 0x3c59, 0x3c58, 0x3c58, // 40528
-    0x3c57, 0x3c56, 0x3c55, 0x3c55, 0x3c54, 0x3c53, 0x3c52, 0x3c51, // 40536
-    0x3c51, 0x3c50, 0x3c4f, 0x3c4e, 0x3c4e, 0x3c4d, 0x3c4c, 0x3c4b, // 40544
-    0x3c4b, 0x3c4a, 0x3c49, 0x3c48, 0x3c48, 0x3c47, 0x3c46, 0x3c45, // 40552
-    0x3c44, 0x3c44, 0x3c43, 0x3c42, 0x3c41, 0x3c41, 0x3c40, 0x3c3f, // 40560
-    0x3c3e, 0x3c3e, 0x3c3d, 0x3c3c, 0x3c3b, 0x3c3b, 0x3c3a, 0x3c39, // 40568
-    0x3c38, 0x3c37, 0x3c37, 0x3c36, 0x3c35, 0x3c34, 0x3c34, 0x3c33, // 40576
-    0x3c32, 0x3c31, 0x3c31, 0x3c30, 0x3c2f, 0x3c2e, 0x3c2e, 0x3c2d, // 40584
-    0x3c2c, 0x3c2b, 0x3c2b, 0x3c2a, 0x3c29, 0x3c28, 0x3c27, 0x3c27, // 40592
-    0x3c26, 0x3c25, 0x3c24, 0x3c24, 0x3c23, 0x3c22, 0x3c21, 0x3c21, // 40600
-    0x3c20, 0x3c1f, 0x3c1e, 0x3c1e, 0x3c1d, 0x3c1c, 0x3c1b, 0x3c1a, // 40608
-    0x3c1a, 0x3c19, 0x3c18, 0x3c17, 0x3c17, 0x3c16, 0x3c15, 0x3c14, // 40616
-    0x3c14, 0x3c13, 0x3c12, 0x3c11, 0x3c11, 0x3c10, 0x3c0f, 0x3c0e, // 40624
-    0x3c0d, 0x3c0d, 0x3c0c, 0x3c0b, 0x3c0a, 0x3c0a, 0x3c09, 0x3c08, // 40632
-    0x3c07, 0x3c07, 0x3c06, 0x3c05, 0x3c04, 0x3c04, 0x3c03, 0x3c02, // 40640
-    0x3c01, 0x3c01, 0x3c00, 0x3bff, 0x3bfe, 0x3bfd, 0x3bfd, 0x3bfc, // 40648
-    0x3bfb, 0x3bfa, 0x3bfa, 0x3bf9, 0x3bf8, 0x3bf7, 0x3bf7, 0x3bf6, // 40656
-    0x3bf5, 0x3bf4, 0x3bf4, 0x3bf3, 0x3bf2, 0x3bf1, 0x3bf0, 0x3bf0, // 40664
-    0x3bef, 0x3bee, 0x3bed, 0x3bed, 0x3bec, 0x3beb, 0x3bea, 0x3bea, // 40672
-    0x3be9, 0x3be8, 0x3be7, 0x3be7, 0x3be6, 0x3be5, 0x3be4, 0x3be3, // 40680
-    0x3be3, 0x3be2, 0x3be1, 0x3be0, 0x3be0, 0x3bdf, 0x3bde, 0x3bdd, // 40688
-    0x3bdd, 0x3bdc, 0x3bdb, 0x3bda, 0x3bda, 0x3bd9, 0x3bd8, 0x3bd7, // 40696
-    0x3bd7, 0x3bd6, 0x3bd5, 0x3bd4, 0x3bd3, 0x3bd3, 0x3bd2, 0x3bd1, // 40704
-    0x3bd0, 0x3bd0, 0x3bcf, 0x3bce, 0x3bcd, 0x3bcd, 0x3bcc, 0x3bcb, // 40712
-    0x3bca, 0x3bca, 0x3bc9, 0x3bc8, 0x3bc7, 0x3bc6, 0x3bc6, 0x3bc5, // 40720
-    0x3bc4, 0x3bc3, 0x3bc3, 0x3bc2, 0x3bc1, 0x3bc0, 0x3bc0, 0x3bbf, // 40728
-    0x3bbe, 0x3bbd, 0x3bbd, 0x3bbc, 0x3bbb, 0x3bba, 0x3bb9, 0x3bb9, // 40736
-    0x3bb8, 0x3bb7, 0x3bb6, 0x3bb6, 0x3bb5, 0x3bb4, 0x3bb3, 0x3bb3, // 40744
-    0x3bb2, 0x3bb1, 0x3bb0, 0x3bb0, 0x3baf, 0x3bae, 0x3bad, 0x3bac, // 40752
-    0x3bac, 0x3bab, 0x3baa, 0x3ba9, 0x3ba9, 0x3ba8, 0x3ba7, 0x3ba6, // 40760
-    0x3ba6, 0x3ba5, 0x3ba4, 0x3ba3, 0x3ba3, 0x3ba2, 0x3ba1, 0x3ba0, // 40768
-    0x3ba0, 0x3b9f, 0x3b9e, 0x3b9d, 0x3b9c, 0x3b9c, 0x3b9b, 0x3b9a, // 40776
-    0x3b99, 0x3b99, 0x3b98, 0x3b97, 0x3b96, 0x3b96, 0x3b95, 0x3b94, // 40784
-    0x3b93, 0x3b93, 0x3b92, 0x3b91, 0x3b90, 0x3b8f, 0x3b8f, 0x3b8e, // 40792
-    0x3b8d, 0x3b8c, 0x3b8c, 0x3b8b, 0x3b8a, 0x3b89, 0x3b89, 0x3b88, // 40800
-    0x3b87, 0x3b86, 0x3b86, 0x3b85, 0x3b84, 0x3b83, 0x3b82, 0x3b82, // 40808
-    0x3b81, 0x3b80, 0x3b7f, 0x3b7f, 0x3b7e, 0x3b7d, 0x3b7c, 0x3b7c, // 40816
-    0x3b7b, 0x3b7a, 0x3b79, 0x3b79, 0x3b78, 0x3b77, 0x3b76, 0x3b76, // 40824
-    0x3b75, 0x3b74, 0x3b73, 0x3b72, 0x3b72, 0x3b71, 0x3b70, 0x3b6f, // 40832
-    0x3b6f, 0x3b6e, 0x3b6d, 0x3b6c, 0x3b6c, 0x3b6b, 0x3b6a, 0x3b69, // 40840
-    0x3b69, 0x3b68, 0x3b67, 0x3b66, 0x3b65, 0x3b65, 0x3b64, 0x3b63, // 40848
-    0x3b62, 0x3b62, 0x3b61, 0x3b60, 0x3b5f, 0x3b5f, 0x3b5e, 0x3b5d, // 40856
-    0x3b5c, 0x3b5c, 0x3b5b, 0x3b5a, 0x3b59, 0x3b58, 0x3b58, 0x3b57, // 40864
-    0x3b56, 0x3b55, 0x3b55, 0x3b54, 0x3b53, 0x3b52, 0x3b52, 0x3b51, // 40872
-    0x3b50, 0x3b4f, 0x3b4f, 0x3b4e, 0x3b4d, 0x3b4c, 0x3b4c, 0x3b4b, // 40880
-    0x3b4a, 0x3b49, 0x3b48, 0x3b48, 0x3b47, 0x3b46, 0x3b45, 0x3b45, // 40888
-    0x3b44, 0x3b43, 0x3b42, 0x3b42, 0x3b41, 0x3b40, 0x3b3f, 0x3b3f, // 40896
-    0x3b3e, 0x3b3d, 0x3b3c, 0x3b3b, 0x3b3b, 0x3b3a, 0x3b39, 0x3b38, // 40904
-    0x3b38, 0x3b37, 0x3b36, 0x3b35, 0x3b35, 0x3b34, 0x3b33, 0x3b32, // 40912
-    0x3b32, 0x3b31, 0x3b30, 0x3b2f, 0x3b2e, 0x3b2e, 0x3b2d, 0x3b2c, // 40920
-    0x3b2b, 0x3b2b, 0x3b2a, 0x3b29, 0x3b28, 0x3b28, 0x3b27, 0x3b26, // 40928
-    0x3b25, 0x3b25, 0x3b24, 0x3b23, 0x3b22, 0x3b22, 0x3b21, 0x3b20, // 40936
-    0x3b1f, 0x3b1e, 0x3b1e, 0x3b1d, 0x3b1c, 0x3b1b, 0x3b1b, 0x3b1a, // 40944
-    0x3b19, 0x3b18, 0x3b18, 0x3b17, 0x3b16, 0x3b15, 0x3b15, 0x3b14, // 40952
-    0x3b14, 0x3b13, 0x3b12, 0x3b11, 0x3b10, 0x3b10, 0x3b0f, 0x3b0e, // 40960
-    0x3b0d, 0x3b0d, 0x3b0c, 0x3b0b, 0x3b0a, 0x3b0a, 0x3b09, 0x3b08, // 40968
-    0x3b07, 0x3b07, 0x3b06, 0x3b05, 0x3b04, 0x3b04, 0x3b03, 0x3b02, // 40976
-    0x3b01, 0x3b01, 0x3b00, 0x3aff, 0x3afe, 0x3afe, 0x3afd, 0x3afc, // 40984
-    0x3afb, 0x3afb, 0x3afa, 0x3af9, 0x3af8, 0x3af8, 0x3af7, 0x3af6, // 40992
-    0x3af5, 0x3af5, 0x3af4, 0x3af3, 0x3af2, 0x3af2, 0x3af1, 0x3af0, // 41000
-    0x3aef, 0x3aef, 0x3aee, 0x3aed, 0x3aec, 0x3aec, 0x3aeb, 0x3aea, // 41008
-    0x3ae9, 0x3ae9, 0x3ae8, 0x3ae7, 0x3ae6, 0x3ae6, 0x3ae5, 0x3ae4, // 41016
-    0x3ae3, 0x3ae3, 0x3ae2, 0x3ae1, 0x3ae0, 0x3ae0, 0x3adf, 0x3ade, // 41024
-    0x3add, 0x3add, 0x3adc, 0x3adb, 0x3ada, 0x3ada, 0x3ad9, 0x3ad8, // 41032
-    0x3ad7, 0x3ad7, 0x3ad6, 0x3ad5, 0x3ad4, 0x3ad4, 0x3ad3, 0x3ad2, // 41040
-    0x3ad1, 0x3ad1, 0x3ad0, 0x3acf, 0x3ace, 0x3ace, 0x3acd, 0x3acc, // 41048
-    0x3acb, 0x3acb, 0x3aca, 0x3ac9, 0x3ac8, 0x3ac8, 0x3ac7, 0x3ac6, // 41056
-    0x3ac5, 0x3ac5, 0x3ac4, 0x3ac3, 0x3ac2, 0x3ac2, 0x3ac1, 0x3ac0, // 41064
-    0x3abf, 0x3abf, 0x3abe, 0x3abd, 0x3abc, 0x3abc, 0x3abb, 0x3aba, // 41072
-    0x3ab9, 0x3ab9, 0x3ab8, 0x3ab7, 0x3ab6, 0x3ab6, 0x3ab5, 0x3ab4, // 41080
-    0x3ab3, 0x3ab2, 0x3ab2, 0x3ab1, 0x3ab0, 0x3aaf, 0x3aaf, 0x3aae, // 41088
-    0x3aad, 0x3aac, 0x3aac, 0x3aab, 0x3aaa, 0x3aa9, 0x3aa9, 0x3aa8, // 41096
-    0x3aa7, 0x3aa6, 0x3aa6, 0x3aa5, 0x3aa4, 0x3aa3, 0x3aa3, 0x3aa2, // 41104
-    0x3aa1, 0x3aa0, 0x3aa0, 0x3a9f, 0x3a9e, 0x3a9d, 0x3a9d, 0x3a9c, // 41112
-    0x3a9b, 0x3a9a, 0x3a9a, 0x3a99, 0x3a98, 0x3a97, 0x3a97, 0x3a96, // 41120
-    0x3a95, 0x3a94, 0x3a94, 0x3a93, 0x3a92, 0x3a91, 0x3a91, 0x3a90, // 41128
-    0x3a8f, 0x3a8e, 0x3a8e, 0x3a8d, 0x3a8c, 0x3a8b, 0x3a8b, 0x3a8a, // 41136
-    0x3a89, 0x3a88, 0x3a88, 0x3a87, 0x3a86, 0x3a85, 0x3a85, 0x3a84, // 41144
-    0x3a83, 0x3a82, 0x3a82, 0x3a81, 0x3a80, 0x3a7f, 0x3a7f, 0x3a7e, // 41152
-    0x3a7d, 0x3a7c, 0x3a7c, 0x3a7b, 0x3a7a, 0x3a79, 0x3a79, 0x3a78, // 41160
-    0x3a77, 0x3a76, 0x3a76, 0x3a75, 0x3a74, 0x3a73, 0x3a73, 0x3a72, // 41168
-    0x3a71, 0x3a70, 0x3a70, 0x3a6f, 0x3a6e, 0x3a6d, 0x3a6d, 0x3a6c, // 41176
-    0x3a6b, 0x3a6a, 0x3a6a, 0x3a69, 0x3a68, 0x3a67, 0x3a67, 0x3a66, // 41184
-    0x3a65, 0x3a64, 0x3a64, 0x3a63, 0x3a62, 0x3a61, 0x3a61, 0x3a60, // 41192
-    0x3a5f, 0x3a5e, 0x3a5e, 0x3a5d, 0x3a5c, 0x3a5b, 0x3a5b, 0x3a5a, // 41200
-    0x3a59, 0x3a58, 0x3a58, 0x3a57, 0x3a56, 0x3a55, 0x3a55, 0x3a54, // 41208
-    0x3a53, 0x3a52, 0x3a51, 0x3a51, 0x3a50, 0x3a4f, 0x3a4e, 0x3a4e, // 41216
-    0x3a4d, 0x3a4c, 0x3a4b, 0x3a4b, 0x3a4a, 0x3a49, 0x3a48, 0x3a48, // 41224
-    0x3a47, 0x3a46, 0x3a45, 0x3a45, 0x3a44, 0x3a43, 0x3a42, 0x3a42, // 41232
-    0x3a41, 0x3a40, 0x3a3f, 0x3a3f, 0x3a3e, 0x3a3d, 0x3a3c, 0x3a3c, // 41240
-    0x3a3b, 0x3a3a, 0x3a39, 0x3a39, 0x3a38, 0x3a37, 0x3a36, 0x3a36, // 41248
-    0x3a35, 0x3a34, 0x3a33, 0x3a33, 0x3a32, 0x3a31, 0x3a30, 0x3a30, // 41256
-    0x3a2f, 0x3a2e, 0x3a2d, 0x3a2d, 0x3a2c, 0x3a2b, 0x3a2a, 0x3a2a, // 41264
-    0x3a29, 0x3a28, 0x3a27, 0x3a27, 0x3a26, 0x3a25, 0x3a24, 0x3a24, // 41272
-    0x3a23, 0x3a22, 0x3a21, 0x3a21, 0x3a20, 0x3a1f, 0x3a1e, 0x3a1e, // 41280
-    0x3a1d, 0x3a1c, 0x3a1b, 0x3a1b, 0x3a1a, 0x3a19, 0x3a18, 0x3a18, // 41288
-    0x3a17, 0x3a16, 0x3a15, 0x3a15, 0x3a14, 0x3a13, 0x3a12, 0x3a12, // 41296
-    0x3a11, 0x3a10, 0x3a0f, 0x3a0f, 0x3a0e, 0x3a0d, 0x3a0c, 0x3a0c, // 41304
-    0x3a0b, 0x3a0a, 0x3a09, 0x3a09, 0x3a08, 0x3a07, 0x3a06, 0x3a06, // 41312
-    0x3a05, 0x3a04, 0x3a03, 0x3a03, 0x3a02, 0x3a01, 0x3a00, 0x3a00, // 41320
-    0x39ff, 0x39fe, 0x39fd, 0x39fd, 0x39fc, 0x39fb, 0x39fa, 0x39fa, // 41328
-    0x39f9, 0x39f8, 0x39f7, 0x39f7, 0x39f6, 0x39f5, 0x39f4, 0x39f4, // 41336
-    0x39f3, 0x39f2, 0x39f1, 0x39f0, 0x39f0, 0x39ef, 0x39ee, 0x39ed, // 41344
-    0x39ed, 0x39ec, 0x39eb, 0x39ea, 0x39ea, 0x39e9, 0x39e8, 0x39e7, // 41352
-    0x39e7, 0x39e6, 0x39e5, 0x39e4, 0x39e4, 0x39e3, 0x39e2, 0x39e1, // 41360
-    0x39e1, 0x39e0, 0x39df, 0x39de, 0x39de, 0x39dd, 0x39dc, 0x39db, // 41368
-    0x39db, 0x39da, 0x39d9, 0x39d8, 0x39d8, 0x39d7, 0x39d6, 0x39d5, // 41376
-    0x39d5, 0x39d4, 0x39d3, 0x39d2, 0x39d2, 0x39d1, 0x39d0, 0x39cf, // 41384
-    0x39cf, 0x39ce, 0x39cd, 0x39cc, 0x39cc, 0x39cb, 0x39ca, 0x39c9, // 41392
-    0x39c9, 0x39c8, 0x39c7, 0x39c6, 0x39c6, 0x39c5, 0x39c4, 0x39c3, // 41400
-    0x39c3, 0x39c2, 0x39c1, 0x39c0, 0x39c0, 0x39bf, 0x39be, 0x39bd, // 41408
-    0x39bd, 0x39bc, 0x39bb, 0x39ba, 0x39ba, 0x39b9, 0x39b8, 0x39b7, // 41416
-    0x39b7, 0x39b6, 0x39b5, 0x39b4, 0x39b4, 0x39b3, 0x39b2, 0x39b1, // 41424
-    0x39b1, 0x39b0, 0x39af, 0x39ae, 0x39ae, 0x39ad, 0x39ac, 0x39ab, // 41432
-    0x39ab, 0x39aa, 0x39a9, 0x39a8, 0x39a8, 0x39a7, 0x39a6, 0x39a5, // 41440
-    0x39a5, 0x39a4, 0x39a3, 0x39a2, 0x39a2, 0x39a1, 0x39a0, 0x399f, // 41448
-    0x399f, 0x399e, 0x399d, 0x399c, 0x399c, 0x399b, 0x399a, 0x3999, // 41456
-    0x3999, 0x3998, 0x3997, 0x3996, 0x3996, 0x3995, 0x3994, 0x3993, // 41464
-    0x3993, 0x3992, 0x3991, 0x3990, 0x398f, 0x398f, 0x398e, 0x398d, // 41472
-    0x398c, 0x398c, 0x398b, 0x398a, 0x3989, 0x3989, 0x3988, 0x3987, // 41480
-    0x3986, 0x3986, 0x3985, 0x3984, 0x3983, 0x3983, 0x3982, 0x3981, // 41488
-    0x3980, 0x3980, 0x397f, 0x397e, 0x397d, 0x397d, 0x397c, 0x397b, // 41496
-    0x397a, 0x397a, 0x3979, 0x3978, 0x3977, 0x3977, 0x3976, 0x3975, // 41504
-    0x3974, 0x3974, 0x3973, 0x3972, 0x3971, 0x3971, 0x3970, 0x396f, // 41512
-    0x396e, 0x396e, 0x396d, 0x396c, 0x396b, 0x396b, 0x396a, 0x3969, // 41520
-    0x3968, 0x3968, 0x3967, 0x3966, 0x3965, 0x3965, 0x3964, 0x3963, // 41528
-    0x3962, 0x3962, 0x3961, 0x3960, 0x395f, 0x395f, 0x395e, 0x395d, // 41536
-    0x395c, 0x395c, 0x395b, 0x395a, 0x3959, 0x3959, 0x3958, 0x3957, // 41544
-    0x3956, 0x3956, 0x3955, 0x3954, 0x3953, 0x3953, 0x3952, 0x3951, // 41552
-    0x3950, 0x3950, 0x394f, 0x394e, 0x394d, 0x394d, 0x394c, 0x394b, // 41560
-    0x394a, 0x394a, 0x3949, 0x3948, 0x3947, 0x3947, 0x3946, 0x3945, // 41568
-    0x3944, 0x3944, 0x3943, 0x3942, 0x3941, 0x3941, 0x3940, 0x393f, // 41576
-    0x393e, 0x393e, 0x393d, 0x393c, 0x393b, 0x393b, 0x393a, 0x3939, // 41584
-    0x3938, 0x3938, 0x3937, 0x3936, 0x3935, 0x3935, 0x3934, 0x3933, // 41592
-    0x3932, 0x3931, 0x3931, 0x3930, 0x392f, 0x392e, 0x392e, 0x392d, // 41600
-    0x392c, 0x392b, 0x392b, 0x392a, 0x3929, 0x3928, 0x3928, 0x3927, // 41608
-    0x3926, 0x3925, 0x3925, 0x3924, 0x3923, 0x3922, 0x3922, 0x3921, // 41616
-    0x3920, 0x391f, 0x391f, 0x391e, 0x391d, 0x391c, 0x391c, 0x391b, // 41624
-    0x391a, 0x3919, 0x3919, 0x3918, 0x3917, 0x3916, 0x3916, 0x3915, // 41632
-    0x3914, 0x3913, 0x3913, 0x3912, 0x3911, 0x3910, 0x3910, 0x390f, // 41640
-    0x390e, 0x390d, 0x390d, 0x390c, 0x390b, 0x390a, 0x390a, 0x3909, // 41648
-    0x3908, 0x3907, 0x3907, 0x3906, 0x3905, 0x3904, 0x3904, 0x3903, // 41656
-    0x3902, 0x3901, 0x3901, 0x3900, 0x38ff, 0x38fe, 0x38fe, 0x38fd, // 41664
-    0x38fc, 0x38fb, 0x38fb, 0x38fa, 0x38f9, 0x38f8, 0x38f8, 0x38f7, // 41672
-    0x38f6, 0x38f5, 0x38f5, 0x38f4, 0x38f3, 0x38f2, 0x38f2, 0x38f1, // 41680
-    0x38f0, 0x38ef, 0x38ef, 0x38ee, 0x38ed, 0x38ec, 0x38ec, 0x38eb, // 41688
-    0x38ea, 0x38e9, 0x38e9, 0x38e8, 0x38e7, 0x38e6, 0x38e6, 0x38e5, // 41696
-    0x38e4, 0x38e3, 0x38e3, 0x38e2, 0x38e1, 0x38e0, 0x38e0, 0x38df, // 41704
-    0x38de, 0x38dd, 0x38dd, 0x38dc, 0x38db, 0x38da, 0x38da, 0x38d9, // 41712
-    0x38d8, 0x38d7, 0x38d7, 0x38d6, 0x38d5, 0x38d4, 0x38d4, 0x38d3, // 41720
-    0x38d2, 0x38d1, 0x38d0, 0x38d0, 0x38cf, 0x38ce, 0x38cd, 0x38cd, // 41728
-    0x38cc, 0x38cb, 0x38ca, 0x38ca, 0x38c9, 0x38c8, 0x38c7, 0x38c7, // 41736
-    0x38c6, 0x38c5, 0x38c4, 0x38c4, 0x38c3, 0x38c2, 0x38c1, 0x38c1, // 41744
-    0x38c0, 0x38bf, 0x38be, 0x38be, 0x38bd, 0x38bc, 0x38bb, 0x38bb, // 41752
-    0x38ba, 0x38b9, 0x38b8, 0x38b8, 0x38b7, 0x38b6, 0x38b5, 0x38b5, // 41760
-    0x38b4, 0x38b3, 0x38b2, 0x38b2, 0x38b1, 0x38b0, 0x38af, 0x38af, // 41768
-    0x38ae, 0x38ad, 0x38ac, 0x38ac, 0x38ab, 0x38aa, 0x38a9, 0x38a9, // 41776
-    0x38a8, 0x38a7, 0x38a6, 0x38a6, 0x38a5, 0x38a4, 0x38a3, 0x38a3, // 41784
-    0x38a2, 0x38a1, 0x38a0, 0x38a0, 0x389f, 0x389e, 0x389d, 0x389d, // 41792
-    0x389c, 0x389b, 0x389a, 0x389a, 0x3899, 0x3898, 0x3897, 0x3897, // 41800
-    0x3896, 0x3895, 0x3894, 0x3894, 0x3893, 0x3892, 0x3891, 0x3891, // 41808
-    0x3890, 0x388f, 0x388e, 0x388e, 0x388d, 0x388c, 0x388b, 0x388b, // 41816
-    0x388a, 0x3889, 0x3888, 0x3888, 0x3887, 0x3886, 0x3885, 0x3885, // 41824
-    0x3884, 0x3883, 0x3882, 0x3882, 0x3881, 0x3880, 0x387f, 0x387f, // 41832
-    0x387e, 0x387d, 0x387c, 0x387c, 0x387b, 0x387a, 0x3879, 0x3879, // 41840
-    0x3878, 0x3877, 0x3876, 0x3876, 0x3875, 0x3874, 0x3873, 0x3873, // 41848
-    0x3872, 0x3871, 0x3870, 0x386f, 0x386f, 0x386e, 0x386d, 0x386c, // 41856
-    0x386c, 0x386b, 0x386a, 0x3869, 0x3869, 0x3868, 0x3867, 0x3866, // 41864
-    0x3866, 0x3865, 0x3864, 0x3863, 0x3863, 0x3862, 0x3861, 0x3860, // 41872
-    0x3860, 0x385f, 0x385e, 0x385d, 0x385d, 0x385c, 0x385b, 0x385a, // 41880
-    0x385a, 0x3859, 0x3858, 0x3857, 0x3857, 0x3856, 0x3855, 0x3854, // 41888
-    0x3854, 0x3853, 0x3852, 0x3851, 0x3851, 0x3850, 0x384f, 0x384e, // 41896
-    0x384e, 0x384d, 0x384c, 0x384b, 0x384b, 0x384a, 0x3849, 0x3848, // 41904
-    0x3848, 0x3847, 0x3846, 0x3845, 0x3845, 0x3844, 0x3843, 0x3842, // 41912
-    0x3842, 0x3841, 0x3840, 0x383f, 0x383f, 0x383e, 0x383d, 0x383c, // 41920
-    0x383c, 0x383b, 0x383a, 0x3839, 0x3839, 0x3838, 0x3837, 0x3836, // 41928
-    0x3836, 0x3835, 0x3834, 0x3833, 0x3833, 0x3832, 0x3831, 0x3830, // 41936
-    0x3830, 0x382f, 0x382e, 0x382d, 0x382d, 0x382c, 0x382b, 0x382a, // 41944
-    0x382a, 0x3829, 0x3828, 0x3827, 0x3827, 0x3826, 0x3825, 0x3824, // 41952
-    0x3824, 0x3823, 0x3822, 0x3821, 0x3821, 0x3820, 0x381f, 0x381e, // 41960
-    0x381e, 0x381d, 0x381c, 0x381b, 0x381b, 0x381a, 0x3819, 0x3818, // 41968
-    0x3818, 0x3817, 0x3816, 0x3815, 0x3815, 0x3814, 0x3813, 0x3812, // 41976
-    0x3812, 0x3811, 0x3811, 0x3810, 0x380f, 0x380e, 0x380e, 0x380d, // 41984
-    0x380c, 0x380b, 0x380b, 0x380a, 0x3809, 0x3808, 0x3808, 0x3807, // 41992
-    0x3806, 0x3805, 0x3805, 0x3804, 0x3803, 0x3803, 0x3802, 0x3801, // 42000
-    0x3800, 0x3800, 0x37ff, 0x37fe, 0x37fd, 0x37fd, 0x37fc, 0x37fb, // 42008
-    0x37fa, 0x37fa, 0x37f9, 0x37f8, 0x37f7, 0x37f7, 0x37f6, 0x37f5, // 42016
-    0x37f5, 0x37f4, 0x37f3, 0x37f2, 0x37f2, 0x37f1, 0x37f0, 0x37ef, // 42024
-    0x37ef, 0x37ee, 0x37ed, 0x37ec, 0x37ec, 0x37eb, 0x37ea, 0x37ea, // 42032
-    0x37e9, 0x37e8, 0x37e7, 0x37e7, 0x37e6, 0x37e5, 0x37e4, 0x37e4, // 42040
-    0x37e3, 0x37e2, 0x37e1, 0x37e1, 0x37e0, 0x37df, 0x37de, 0x37de, // 42048
-    0x37dd, 0x37dc, 0x37dc, 0x37db, 0x37da, 0x37d9, 0x37d9, 0x37d8, // 42056
-    0x37d7, 0x37d6, 0x37d6, 0x37d5, 0x37d4, 0x37d3, 0x37d3, 0x37d2, // 42064
-    0x37d1, 0x37d0, 0x37d0, 0x37cf, 0x37ce, 0x37ce, 0x37cd, 0x37cc, // 42072
-    0x37cb, 0x37cb, 0x37ca, 0x37c9, 0x37c8, 0x37c8, 0x37c7, 0x37c6, // 42080
-    0x37c5, 0x37c5, 0x37c4, 0x37c3, 0x37c2, 0x37c2, 0x37c1, 0x37c0, // 42088
-    0x37c0, 0x37bf, 0x37be, 0x37bd, 0x37bd, 0x37bc, 0x37bb, 0x37ba, // 42096
-    0x37ba, 0x37b9, 0x37b8, 0x37b7, 0x37b7, 0x37b6, 0x37b5, 0x37b4, // 42104
-    0x37b4, 0x37b3, 0x37b2, 0x37b2, 0x37b1, 0x37b0, 0x37af, 0x37af, // 42112
-    0x37ae, 0x37ad, 0x37ac, 0x37ac, 0x37ab, 0x37aa, 0x37a9, 0x37a9, // 42120
-    0x37a8, 0x37a7, 0x37a6, 0x37a6, 0x37a5, 0x37a4, 0x37a4, 0x37a3, // 42128
-    0x37a2, 0x37a1, 0x37a1, 0x37a0, 0x379f, 0x379e, 0x379e, 0x379d, // 42136
-    0x379c, 0x379b, 0x379b, 0x379a, 0x3799, 0x3799, 0x3798, 0x3797, // 42144
-    0x3796, 0x3796, 0x3795, 0x3794, 0x3793, 0x3793, 0x3792, 0x3791, // 42152
-    0x3790, 0x3790, 0x378f, 0x378e, 0x378d, 0x378d, 0x378c, 0x378b, // 42160
-    0x378b, 0x378a, 0x3789, 0x3788, 0x3788, 0x3787, 0x3786, 0x3785, // 42168
-    0x3785, 0x3784, 0x3783, 0x3782, 0x3782, 0x3781, 0x3780, 0x377f, // 42176
-    0x377f, 0x377e, 0x377d, 0x377d, 0x377c, 0x377b, 0x377a, 0x377a, // 42184
-    0x3779, 0x3778, 0x3777, 0x3777, 0x3776, 0x3775, 0x3774, 0x3774, // 42192
-    0x3773, 0x3772, 0x3771, 0x3771, 0x3770, 0x376f, 0x376f, 0x376e, // 42200
-    0x376d, 0x376c, 0x376c, 0x376b, 0x376a, 0x3769, 0x3769, 0x3768, // 42208
-    0x3767, 0x3766, 0x3766, 0x3765, 0x3764, 0x3763, 0x3763, 0x3762, // 42216
-    0x3761, 0x3761, 0x3760, 0x375f, 0x375e, 0x375e, 0x375d, 0x375c, // 42224
-    0x375b, 0x375b, 0x375a, 0x3759, 0x3758, 0x3758, 0x3757, 0x3756, // 42232
-    0x3756, 0x3755, 0x3754, 0x3753, 0x3753, 0x3752, 0x3751, 0x3750, // 42240
-    0x3750, 0x374f, 0x374e, 0x374d, 0x374d, 0x374c, 0x374b, 0x374a, // 42248
-    0x374a, 0x3749, 0x3748, 0x3748, 0x3747, 0x3746, 0x3745, 0x3745, // 42256
-    0x3744, 0x3743, 0x3742, 0x3742, 0x3741, 0x3740, 0x373f, 0x373f, // 42264
-    0x373e, 0x373d, 0x373c, 0x373c, 0x373b, 0x373a, 0x373a, 0x3739, // 42272
-    0x3738, 0x3737, 0x3737, 0x3736, 0x3735, 0x3734, 0x3734, 0x3733, // 42280
-    0x3732, 0x3731, 0x3731, 0x3730, 0x372f, 0x372e, 0x372e, 0x372d, // 42288
-    0x372c, 0x372c, 0x372b, 0x372a, 0x3729, 0x3729, 0x3728, 0x3727, // 42296
-    0x3726, 0x3726, 0x3725, 0x3724, 0x3723, 0x3723, 0x3722, 0x3721, // 42304
-    0x3720, 0x3720, 0x371f, 0x371e, 0x371e, 0x371d, 0x371c, 0x371b, // 42312
-    0x371b, 0x371a, 0x3719, 0x3718, 0x3718, 0x3717, 0x3716, 0x3715, // 42320
-    0x3715, 0x3714, 0x3713, 0x3712, 0x3712, 0x3711, 0x3710, 0x3710, // 42328
-    0x370f, 0x370e, 0x370d, 0x370d, 0x370c, 0x370b, 0x370a, 0x370a, // 42336
-    0x3709, 0x3708, 0x3707, 0x3707, 0x3706, 0x3705, 0x3705, 0x3704, // 42344
-    0x3703, 0x3702, 0x3702, 0x3701, 0x3700, 0x36ff, 0x36ff, 0x36fe, // 42352
-    0x36fd, 0x36fc, 0x36fc, 0x36fb, 0x36fa, 0x36f9, 0x36f9, 0x36f8, // 42360
-    0x36f7, 0x36f7, 0x36f6, 0x36f5, 0x36f4, 0x36f4, 0x36f3, 0x36f2, // 42368
-    0x36f1, 0x36f1, 0x36f0, 0x36ef, 0x36ee, 0x36ee, 0x36ed, 0x36ec, // 42376
-    0x36eb, 0x36eb, 0x36ea, 0x36e9, 0x36e9, 0x36e8, 0x36e7, 0x36e6, // 42384
-    0x36e6, 0x36e5, 0x36e4, 0x36e3, 0x36e3, 0x36e2, 0x36e1, 0x36e0, // 42392
-    0x36e0, 0x36df, 0x36de, 0x36dd, 0x36dd, 0x36dc, 0x36db, 0x36db, // 42400
-    0x36da, 0x36d9, 0x36d8, 0x36d8, 0x36d7, 0x36d6, 0x36d5, 0x36d5, // 42408
-    0x36d4, 0x36d3, 0x36d2, 0x36d2, 0x36d1, 0x36d0, 0x36cf, 0x36cf, // 42416
-    0x36ce, 0x36cd, 0x36cd, 0x36cc, 0x36cb, 0x36ca, 0x36ca, 0x36c9, // 42424
-    0x36c8, 0x36c7, 0x36c7, 0x36c6, 0x36c5, 0x36c4, 0x36c4, 0x36c3, // 42432
-    0x36c2, 0x36c1, 0x36c1, 0x36c0, 0x36bf, 0x36bf, 0x36be, 0x36bd, // 42440
-    0x36bc, 0x36bc, 0x36bb, 0x36ba, 0x36b9, 0x36b9, 0x36b8, 0x36b7, // 42448
-    0x36b6, 0x36b6, 0x36b5, 0x36b4, 0x36b4, 0x36b3, 0x36b2, 0x36b1, // 42456
-    0x36b1, 0x36b0, 0x36af, 0x36ae, 0x36ae, 0x36ad, 0x36ac, 0x36ab, // 42464
-    0x36ab, 0x36aa, 0x36a9, 0x36a8, 0x36a8, 0x36a7, 0x36a6, 0x36a6, // 42472
-    0x36a5, 0x36a4, 0x36a3, 0x36a3, 0x36a2, 0x36a1, 0x36a0, 0x36a0, // 42480
-    0x369f, 0x369e, 0x369d, 0x369d, 0x369c, 0x369b, 0x369a, 0x369a, // 42488
-    0x3699, 0x3698, 0x3698, 0x3697, 0x3696, 0x3695, 0x3695, 0x3694, // 42496
-    0x3693, 0x3692, 0x3692, 0x3691, 0x3690, 0x368f, 0x368f, 0x368e, // 42504
-    0x368d, 0x368c, 0x368c, 0x368b, 0x368a, 0x368a, 0x3689, 0x3688, // 42512
-    0x3687, 0x3687, 0x3686, 0x3685, 0x3684, 0x3684, 0x3683, 0x3682, // 42520
-    0x3681, 0x3681, 0x3680, 0x367f, 0x367e, 0x367e, 0x367d, 0x367c, // 42528
-    0x367c, 0x367b, 0x367a, 0x3679, 0x3679, 0x3678, 0x3677, 0x3676, // 42536
-    0x3676, 0x3675, 0x3674, 0x3673, 0x3673, 0x3672, 0x3671, 0x3671, // 42544
-    0x3670, 0x366f, 0x366e, 0x366e, 0x366d, 0x366c, 0x366b, 0x366b, // 42552
-    0x366a, 0x3669, 0x3668, 0x3668, 0x3667, 0x3666, 0x3665, 0x3665, // 42560
-    0x3664, 0x3663, 0x3663, 0x3662, 0x3661, 0x3660, 0x3660, 0x365f, // 42568
-    0x365e, 0x365d, 0x365d, 0x365c, 0x365b, 0x365a, 0x365a, 0x3659, // 42576
-    0x3658, 0x3657, 0x3657, 0x3656, 0x3655, 0x3655, 0x3654, 0x3653, // 42584
-    0x3652, 0x3652, 0x3651, 0x3650, 0x364f, 0x364f, 0x364e, 0x364d, // 42592
-    0x364c, 0x364c, 0x364b, 0x364a, 0x3649, 0x3649, 0x3648, 0x3647, // 42600
-    0x3647, 0x3646, 0x3645, 0x3644, 0x3644, 0x3643, 0x3642, 0x3641, // 42608
-    0x3641, 0x3640, 0x363f, 0x363e, 0x363e, 0x363d, 0x363c, 0x363b, // 42616
-    0x363b, 0x363a, 0x3639, 0x3639, 0x3638, 0x3637, 0x3636, 0x3636, // 42624
-    0x3635, 0x3634, 0x3633, 0x3633, 0x3632, 0x3631, 0x3630, 0x3630, // 42632
-    0x362f, 0x362e, 0x362d, 0x362d, 0x362c, 0x362b, 0x362b, 0x362a, // 42640
-    0x3629, 0x3628, 0x3628, 0x3627, 0x3626, 0x3625, 0x3625, 0x3624, // 42648
-    0x3623, 0x3622, 0x3622, 0x3621, 0x3620, 0x3620, 0x361f, 0x361e, // 42656
-    0x361d, 0x361d, 0x361c, 0x361b, 0x361a, 0x361a, 0x3619, 0x3618, // 42664
-    0x3617, 0x3617, 0x3616, 0x3615, 0x3614, 0x3614, 0x3613, 0x3612, // 42672
-    0x3612, 0x3611, 0x3610, 0x360f, 0x360f, 0x360e, 0x360d, 0x360c, // 42680
-    0x360c, 0x360b, 0x360a, 0x3609, 0x3609, 0x3608, 0x3607, 0x3606, // 42688
-    0x3606, 0x3605, 0x3604, 0x3604, 0x3603, 0x3602, 0x3601, 0x3601, // 42696
-    0x3600, 0x35ff, 0x35fe, 0x35fe, 0x35fd, 0x35fc, 0x35fb, 0x35fb, // 42704
-    0x35fa, 0x35f9, 0x35f8, 0x35f8, 0x35f7, 0x35f6, 0x35f6, 0x35f5, // 42712
-    0x35f4, 0x35f3, 0x35f3, 0x35f2, 0x35f1, 0x35f0, 0x35f0, 0x35ef, // 42720
-    0x35ee, 0x35ed, 0x35ed, 0x35ec, 0x35eb, 0x35ea, 0x35ea, 0x35e9, // 42728
-    0x35e8, 0x35e8, 0x35e7, 0x35e6, 0x35e5, 0x35e5, 0x35e4, 0x35e3, // 42736
-    0x35e2, 0x35e2, 0x35e1, 0x35e0, 0x35df, 0x35df, 0x35de, 0x35dd, // 42744
-    0x35dd, 0x35dc, 0x35db, 0x35da, 0x35da, 0x35d9, 0x35d8, 0x35d7, // 42752
-    0x35d7, 0x35d6, 0x35d5, 0x35d4, 0x35d4, 0x35d3, 0x35d2, 0x35d1, // 42760
-    0x35d1, 0x35d0, 0x35cf, 0x35cf, 0x35ce, 0x35cd, 0x35cc, 0x35cc, // 42768
-    0x35cb, 0x35ca, 0x35c9, 0x35c9, 0x35c8, 0x35c7, 0x35c6, 0x35c6, // 42776
-    0x35c5, 0x35c4, 0x35c3, 0x35c3, 0x35c2, 0x35c1, 0x35c1, 0x35c0, // 42784
-    0x35bf, 0x35be, 0x35be, 0x35bd, 0x35bc, 0x35bb, 0x35bb, 0x35ba, // 42792
-    0x35b9, 0x35b8, 0x35b8, 0x35b7, 0x35b6, 0x35b5, 0x35b5, 0x35b4, // 42800
-    0x35b3, 0x35b3, 0x35b2, 0x35b1, 0x35b0, 0x35b0, 0x35af, 0x35ae, // 42808
-    0x35ad, 0x35ad, 0x35ac, 0x35ab, 0x35aa, 0x35aa, 0x35a9, 0x35a8, // 42816
-    0x35a7, 0x35a7, 0x35a6, 0x35a5, 0x35a5, 0x35a4, 0x35a3, 0x35a2, // 42824
-    0x35a2, 0x35a1, 0x35a0, 0x359f, 0x359f, 0x359e, 0x359d, 0x359c, // 42832
-    0x359c, 0x359b, 0x359a, 0x3599, 0x3599, 0x3598, 0x3597, 0x3597, // 42840
-    0x3596, 0x3595, 0x3594, 0x3594, 0x3593, 0x3592, 0x3591, 0x3591, // 42848
-    0x3590, 0x358f, 0x358e, 0x358e, 0x358d, 0x358c, 0x358c, 0x358b, // 42856
-    0x358a, 0x3589, 0x3589, 0x3588, 0x3587, 0x3586, 0x3586, 0x3585, // 42864
-    0x3584, 0x3583, 0x3583, 0x3582, 0x3581, 0x3580, 0x3580, 0x357f, // 42872
-    0x357e, 0x357e, 0x357d, 0x357c, 0x357b, 0x357b, 0x357a, 0x3579, // 42880
-    0x3578, 0x3578, 0x3577, 0x3576, 0x3575, 0x3575, 0x3574, 0x3573, // 42888
-    0x3572, 0x3572, 0x3571, 0x3570, 0x3570, 0x356f, 0x356e, 0x356d, // 42896
-    0x356d, 0x356c, 0x356b, 0x356a, 0x356a, 0x3569, 0x3568, 0x3567, // 42904
-    0x3567, 0x3566, 0x3565, 0x3564, 0x3564, 0x3563, 0x3562, 0x3562, // 42912
-    0x3561, 0x3560, 0x355f, 0x355f, 0x355e, 0x355d, 0x355c, 0x355c, // 42920
-    0x355b, 0x355a, 0x3559, 0x3559, 0x3558, 0x3557, 0x3556, 0x3556, // 42928
-    0x3555, 0x3554, 0x3554, 0x3553, 0x3552, 0x3551, 0x3551, 0x3550, // 42936
-    0x354f, 0x354e, 0x354e, 0x354d, 0x354c, 0x354b, 0x354b, 0x354a, // 42944
-    0x3549, 0x3548, 0x3548, 0x3547, 0x3546, 0x3546, 0x3545, 0x3544, // 42952
-    0x3543, 0x3543, 0x3542, 0x3541, 0x3540, 0x3540, 0x353f, 0x353e, // 42960
-    0x353d, 0x353d, 0x353c, 0x353b, 0x353b, 0x353a, 0x3539, 0x3538, // 42968
-    0x3538, 0x3537, 0x3536, 0x3535, 0x3535, 0x3534, 0x3533, 0x3532, // 42976
-    0x3532, 0x3531, 0x3530, 0x352f, 0x352f, 0x352e, 0x352d, 0x352d, // 42984
-    0x352c, 0x352b, 0x352a, 0x352a, 0x3529, 0x3528, 0x3527, 0x3527, // 42992
-    0x3526, 0x3525, 0x3524, 0x3524, 0x3523, 0x3522, 0x3521, 0x3521, // 43000
-    0x3520, 0x351f, 0x351f, 0x351e, 0x351d, 0x351c, 0x351c, 0x351b, // 43008
-    0x351a, 0x351a, 0x3519, 0x3518, 0x3517, 0x3517, 0x3516, 0x3515, // 43016
-    0x3514, 0x3514, 0x3513, 0x3512, 0x3512, 0x3511, 0x3510, 0x350f, // 43024
-    0x350f, 0x350e, 0x350d, 0x350d, 0x350c, 0x350b, 0x350a, 0x350a, // 43032
-    0x3509, 0x3508, 0x3507, 0x3507, 0x3506, 0x3505, 0x3505, 0x3504, // 43040
-    0x3503, 0x3502, 0x3502, 0x3501, 0x3500, 0x3500, 0x34ff, 0x34fe, // 43048
-    0x34fd, 0x34fd, 0x34fc, 0x34fb, 0x34fb, 0x34fa, 0x34f9, 0x34f8, // 43056
-    0x34f8, 0x34f7, 0x34f6, 0x34f5, 0x34f5, 0x34f4, 0x34f3, 0x34f3, // 43064
-    0x34f2, 0x34f1, 0x34f0, 0x34f0, 0x34ef, 0x34ee, 0x34ee, 0x34ed, // 43072
-    0x34ec, 0x34eb, 0x34eb, 0x34ea, 0x34e9, 0x34e9, 0x34e8, 0x34e7, // 43080
-    0x34e6, 0x34e6, 0x34e5, 0x34e4, 0x34e3, 0x34e3, 0x34e2, 0x34e1, // 43088
-    0x34e1, 0x34e0, 0x34df, 0x34de, 0x34de, 0x34dd, 0x34dc, 0x34dc, // 43096
-    0x34db, 0x34da, 0x34d9, 0x34d9, 0x34d8, 0x34d7, 0x34d6, 0x34d6, // 43104
-    0x34d5, 0x34d4, 0x34d4, 0x34d3, 0x34d2, 0x34d1, 0x34d1, 0x34d0, // 43112
-    0x34cf, 0x34cf, 0x34ce, 0x34cd, 0x34cc, 0x34cc, 0x34cb, 0x34ca, // 43120
-    0x34ca, 0x34c9, 0x34c8, 0x34c7, 0x34c7, 0x34c6, 0x34c5, 0x34c4, // 43128
-    0x34c4, 0x34c3, 0x34c2, 0x34c2, 0x34c1, 0x34c0, 0x34bf, 0x34bf, // 43136
-    0x34be, 0x34bd, 0x34bd, 0x34bc, 0x34bb, 0x34ba, 0x34ba, 0x34b9, // 43144
-    0x34b8, 0x34b7, 0x34b7, 0x34b6, 0x34b5, 0x34b5, 0x34b4, 0x34b3, // 43152
-    0x34b2, 0x34b2, 0x34b1, 0x34b0, 0x34b0, 0x34af, 0x34ae, 0x34ad, // 43160
-    0x34ad, 0x34ac, 0x34ab, 0x34ab, 0x34aa, 0x34a9, 0x34a8, 0x34a8, // 43168
-    0x34a7, 0x34a6, 0x34a5, 0x34a5, 0x34a4, 0x34a3, 0x34a3, 0x34a2, // 43176
-    0x34a1, 0x34a0, 0x34a0, 0x349f, 0x349e, 0x349e, 0x349d, 0x349c, // 43184
-    0x349b, 0x349b, 0x349a, 0x3499, 0x3499, 0x3498, 0x3497, 0x3496, // 43192
-    0x3496, 0x3495, 0x3494, 0x3493, 0x3493, 0x3492, 0x3491, 0x3491, // 43200
-    0x3490, 0x348f, 0x348e, 0x348e, 0x348d, 0x348c, 0x348c, 0x348b, // 43208
-    0x348a, 0x3489, 0x3489, 0x3488, 0x3487, 0x3486, 0x3486, 0x3485, // 43216
-    0x3484, 0x3484, 0x3483, 0x3482, 0x3481, 0x3481, 0x3480, 0x347f, // 43224
-    0x347f, 0x347e, 0x347d, 0x347c, 0x347c, 0x347b, 0x347a, 0x347a, // 43232
-    0x3479, 0x3478, 0x3477, 0x3477, 0x3476, 0x3475, 0x3474, 0x3474, // 43240
-    0x3473, 0x3472, 0x3472, 0x3471, 0x3470, 0x346f, 0x346f, 0x346e, // 43248
-    0x346d, 0x346d, 0x346c, 0x346b, 0x346a, 0x346a, 0x3469, 0x3468, // 43256
-    0x3468, 0x3467, 0x3466, 0x3465, 0x3465, 0x3464, 0x3463, 0x3462, // 43264
-    0x3462, 0x3461, 0x3460, 0x3460, 0x345f, 0x345e, 0x345d, 0x345d, // 43272
-    0x345c, 0x345b, 0x345b, 0x345a, 0x3459, 0x3458, 0x3458, 0x3457, // 43280
-    0x3456, 0x3455, 0x3455, 0x3454, 0x3453, 0x3453, 0x3452, 0x3451, // 43288
-    0x3450, 0x3450, 0x344f, 0x344e, 0x344e, 0x344d, 0x344c, 0x344b, // 43296
-    0x344b, 0x344a, 0x3449, 0x3449, 0x3448, 0x3447, 0x3446, 0x3446, // 43304
-    0x3445, 0x3444, 0x3443, 0x3443, 0x3442, 0x3441, 0x3441, 0x3440, // 43312
-    0x343f, 0x343e, 0x343e, 0x343d, 0x343c, 0x343c, 0x343b, 0x343a, // 43320
-    0x3439, 0x3439, 0x3438, 0x3437, 0x3436, 0x3436, 0x3435, 0x3434, // 43328
-    0x3434, 0x3433, 0x3432, 0x3431, 0x3431, 0x3430, 0x342f, 0x342f, // 43336
-    0x342e, 0x342d, 0x342c, 0x342c, 0x342b, 0x342a, 0x342a, 0x3429, // 43344
-    0x3428, 0x3427, 0x3427, 0x3426, 0x3425, 0x3424, 0x3424, 0x3423, // 43352
-    0x3422, 0x3422, 0x3421, 0x3420, 0x341f, 0x341f, 0x341e, 0x341d, // 43360
-    0x341d, 0x341c, 0x341b, 0x341a, 0x341a, 0x3419, 0x3418, 0x3418, // 43368
-    0x3417, 0x3416, 0x3415, 0x3415, 0x3414, 0x3413, 0x3412, 0x3412, // 43376
-    0x3411, 0x3410, 0x3410, 0x340f, 0x340e, 0x340d, 0x340d, 0x340c, // 43384
-    0x340b, 0x340b, 0x340a, 0x3409, 0x3408, 0x3408, 0x3407, 0x3406, // 43392
-    0x3405, 0x3405, 0x3404, 0x3403, 0x3403, 0x3402, 0x3401, 0x3400, // 43400
-    0x3400, 0x33ff, 0x33fe, 0x33fe, 0x33fd, 0x33fc, 0x33fb, 0x33fb, // 43408
-    0x33fa, 0x33f9, 0x33f9, 0x33f8, 0x33f7, 0x33f6, 0x33f6, 0x33f5, // 43416
-    0x33f4, 0x33f3, 0x33f3, 0x33f2, 0x33f1, 0x33f1, 0x33f0, 0x33ef, // 43424
-    0x33ee, 0x33ee, 0x33ed, 0x33ec, 0x33ec, 0x33eb, 0x33ea, 0x33e9, // 43432
-    0x33e9, 0x33e8, 0x33e7, 0x33e6, 0x33e6, 0x33e5, 0x33e4, 0x33e4, // 43440
-    0x33e3, 0x33e2, 0x33e1, 0x33e1, 0x33e0, 0x33df, 0x33df, 0x33de, // 43448
-    0x33dd, 0x33dc, 0x33dc, 0x33db, 0x33da, 0x33da, 0x33d9, 0x33d8, // 43456
-    0x33d7, 0x33d7, 0x33d6, 0x33d5, 0x33d4, 0x33d4, 0x33d3, 0x33d2, // 43464
-    0x33d2, 0x33d1, 0x33d0, 0x33cf, 0x33cf, 0x33ce, 0x33cd, 0x33cd, // 43472
-    0x33cc, 0x33cb, 0x33ca, 0x33ca, 0x33c9, 0x33c8, 0x33c8, 0x33c7, // 43480
-    0x33c6, 0x33c5, 0x33c5, 0x33c4, 0x33c3, 0x33c2, 0x33c2, 0x33c1, // 43488
-    0x33c0, 0x33c0, 0x33bf, 0x33be, 0x33bd, 0x33bd, 0x33bc, 0x33bb, // 43496
-    0x33bb, 0x33ba, 0x33b9, 0x33b8, 0x33b8, 0x33b7, 0x33b6, 0x33b5, // 43504
-    0x33b5, 0x33b4, 0x33b3, 0x33b3, 0x33b2, 0x33b1, 0x33b0, 0x33b0, // 43512
-    0x33af, 0x33ae, 0x33ae, 0x33ad, 0x33ac, 0x33ab, 0x33ab, 0x33aa, // 43520
-    0x33a9, 0x33a9, 0x33a8, 0x33a7, 0x33a6, 0x33a6, 0x33a5, 0x33a4, // 43528
-    0x33a3, 0x33a3, 0x33a2, 0x33a1, 0x33a1, 0x33a0, 0x339f, 0x339e, // 43536
-    0x339e, 0x339d, 0x339c, 0x339c, 0x339b, 0x339a, 0x3399, 0x3399, // 43544
-    0x3398, 0x3397, 0x3396, 0x3396, 0x3395, 0x3394, 0x3394, 0x3393, // 43552
-    0x3392, 0x3391, 0x3391, 0x3390, 0x338f, 0x338f, 0x338e, 0x338d, // 43560
-    0x338c, 0x338c, 0x338b, 0x338a, 0x338a, 0x3389, 0x3388, 0x3387, // 43568
-    0x3387, 0x3386, 0x3385, 0x3384, 0x3384, 0x3383, 0x3382, 0x3382, // 43576
-    0x3381, 0x3380, 0x337f, 0x337f, 0x337e, 0x337d, 0x337d, 0x337c, // 43584
-    0x337b, 0x337a, 0x337a, 0x3379, 0x3378, 0x3378, 0x3377, 0x3376, // 43592
-    0x3375, 0x3375, 0x3374, 0x3373, 0x3372, 0x3372, 0x3371, 0x3370, // 43600
-    0x3370, 0x336f, 0x336e, 0x336d, 0x336d, 0x336c, 0x336b, 0x336b, // 43608
-    0x336a, 0x3369, 0x3368, 0x3368, 0x3367, 0x3366, 0x3365, 0x3365, // 43616
-    0x3364, 0x3363, 0x3363, 0x3362, 0x3361, 0x3360, 0x3360, 0x335f, // 43624
-    0x335e, 0x335e, 0x335d, 0x335c, 0x335b, 0x335b, 0x335a, 0x3359, // 43632
-    0x3359, 0x3358, 0x3357, 0x3356, 0x3356, 0x3355, 0x3354, 0x3353, // 43640
-    0x3353, 0x3352, 0x3351, 0x3351, 0x3350, 0x334f, 0x334e, 0x334e, // 43648
-    0x334d, 0x334c, 0x334c, 0x334b, 0x334a, 0x3349, 0x3349, 0x3348, // 43656
-    0x3347, 0x3346, 0x3346, 0x3345, 0x3344, 0x3344, 0x3343, 0x3342, // 43664
-    0x3341, 0x3341, 0x3340, 0x333f, 0x333f, 0x333e, 0x333d, 0x333c, // 43672
-    0x333c, 0x333b, 0x333a, 0x333a, 0x3339, 0x3338, 0x3337, 0x3337, // 43680
-    0x3336, 0x3335, 0x3334, 0x3334, 0x3333, 0x3332, 0x3332, 0x3331, // 43688
-    0x3330, 0x332f, 0x332f, 0x332e, 0x332d, 0x332d, 0x332c, 0x332b, // 43696
-    0x332a, 0x332a, 0x3329, 0x3328, 0x3328, 0x3327, 0x3326, 0x3325, // 43704
-    0x3325, 0x3324, 0x3323, 0x3322, 0x3322, 0x3321, 0x3320, 0x3320, // 43712
-    0x331f, 0x331e, 0x331d, 0x331d, 0x331c, 0x331b, 0x331b, 0x331a, // 43720
-    0x3319, 0x3318, 0x3318, 0x3317, 0x3316, 0x3315, 0x3315, 0x3314, // 43728
-    0x3313, 0x3313, 0x3312, 0x3311, 0x3310, 0x3310, 0x330f, 0x330e, // 43736
-    0x330e, 0x330d, 0x330c, 0x330b, 0x330b, 0x330a, 0x3309, 0x3309, // 43744
-    0x3308, 0x3307, 0x3306, 0x3306, 0x3305, 0x3304, 0x3303, 0x3303, // 43752
-    0x3302, 0x3301, 0x3301, 0x3300, 0x32ff, 0x32fe, 0x32fe, 0x32fd, // 43760
-    0x32fc, 0x32fc, 0x32fb, 0x32fa, 0x32f9, 0x32f9, 0x32f8, 0x32f7, // 43768
-    0x32f7, 0x32f6, 0x32f5, 0x32f4, 0x32f4, 0x32f3, 0x32f2, 0x32f1, // 43776
-    0x32f1, 0x32f0, 0x32ef, 0x32ef, 0x32ee, 0x32ed, 0x32ec, 0x32ec, // 43784
-    0x32eb, 0x32ea, 0x32ea, 0x32e9, 0x32e8, 0x32e7, 0x32e7, 0x32e6, // 43792
-    0x32e5, 0x32e4, 0x32e4, 0x32e3, 0x32e2, 0x32e2, 0x32e1, 0x32e0, // 43800
-    0x32df, 0x32df, 0x32de, 0x32dd, 0x32dd, 0x32dc, 0x32db, 0x32da, // 43808
-    0x32da, 0x32d9, 0x32d8, 0x32d8, 0x32d7, 0x32d6, 0x32d5, 0x32d5, // 43816
-    0x32d4, 0x32d3, 0x32d2, 0x32d2, 0x32d1, 0x32d0, 0x32d0, 0x32cf, // 43824
-    0x32ce, 0x32cd, 0x32cd, 0x32cc, 0x32cb, 0x32cb, 0x32ca, 0x32c9, // 43832
-    0x32c8, 0x32c8, 0x32c7, 0x32c6, 0x32c5, 0x32c5, 0x32c4, 0x32c3, // 43840
-    0x32c3, 0x32c2, 0x32c1, 0x32c0, 0x32c0, 0x32bf, 0x32be, 0x32be, // 43848
-    0x32bd, 0x32bc, 0x32bb, 0x32bb, 0x32ba, 0x32b9, 0x32b9, 0x32b8, // 43856
-    0x32b7, 0x32b6, 0x32b6, 0x32b5, 0x32b4, 0x32b3, 0x32b3, 0x32b2, // 43864
-    0x32b1, 0x32b1, 0x32b0, 0x32af, 0x32ae, 0x32ae, 0x32ad, 0x32ac, // 43872
-    0x32ac, 0x32ab, 0x32aa, 0x32a9, 0x32a9, 0x32a8, 0x32a7, 0x32a7, // 43880
-    0x32a6, 0x32a5, 0x32a4, 0x32a4, 0x32a3, 0x32a2, 0x32a1, 0x32a1, // 43888
-    0x32a0, 0x329f, 0x329f, 0x329e, 0x329d, 0x329c, 0x329c, 0x329b, // 43896
-    0x329a, 0x329a, 0x3299, 0x3298, 0x3297, 0x3297, 0x3296, 0x3295, // 43904
-    0x3294, 0x3294, 0x3293, 0x3292, 0x3292, 0x3291, 0x3290, 0x328f, // 43912
-    0x328f, 0x328e, 0x328d, 0x328d, 0x328c, 0x328b, 0x328a, 0x328a, // 43920
-    0x3289, 0x3288, 0x3288, 0x3287, 0x3286, 0x3285, 0x3285, 0x3284, // 43928
-    0x3283, 0x3282, 0x3282, 0x3281, 0x3280, 0x3280, 0x327f, 0x327e, // 43936
-    0x327d, 0x327d, 0x327c, 0x327b, 0x327b, 0x327a, 0x3279, 0x3278, // 43944
-    0x3278, 0x3277, 0x3276, 0x3275, 0x3275, 0x3274, 0x3273, 0x3273, // 43952
-    0x3272, 0x3271, 0x3270, 0x3270, 0x326f, 0x326e, 0x326e, 0x326d, // 43960
-    0x326c, 0x326b, 0x326b, 0x326a, 0x3269, 0x3269, 0x3268, 0x3267, // 43968
-    0x3266, 0x3266, 0x3265, 0x3264, 0x3263, 0x3263, 0x3262, 0x3261, // 43976
-    0x3261, 0x3260, 0x325f, 0x325e, 0x325e, 0x325d, 0x325c, 0x325c, // 43984
-    0x325b, 0x325a, 0x3259, 0x3259, 0x3258, 0x3257, 0x3257, 0x3256, // 43992
-    0x3255, 0x3254, 0x3254, 0x3253, 0x3252, 0x3251, 0x3251, 0x3250, // 44000
-    0x324f, 0x324f, 0x324e, 0x324d, 0x324c, 0x324c, 0x324b, 0x324a, // 44008
-    0x324a, 0x3249, 0x3248, 0x3247, 0x3247, 0x3246, 0x3245, 0x3244, // 44016
-    0x3244, 0x3243, 0x3242, 0x3242, 0x3241, 0x3240, 0x323f, 0x323f, // 44024
-    0x323d, 0x323c, 0x323c, 0x323b, 0x323a, 0x3239, 0x3239, 0x3238, // 44032
-    0x3237, 0x3237, 0x3236, 0x3235, 0x3234, 0x3234, 0x3233, 0x3232, // 44040
-    0x3232, 0x3231, 0x3230, 0x3230, 0x322f, 0x322e, 0x322d, 0x322d, // 44048
-    0x322c, 0x322b, 0x322b, 0x322a, 0x3229, 0x3228, 0x3228, 0x3227, // 44056
-    0x3226, 0x3226, 0x3225, 0x3224, 0x3223, 0x3223, 0x3222, 0x3221, // 44064
-    0x3221, 0x3220, 0x321f, 0x321f, 0x321e, 0x321d, 0x321c, 0x321c, // 44072
-    0x321b, 0x321a, 0x321a, 0x3219, 0x3218, 0x3217, 0x3217, 0x3216, // 44080
-    0x3215, 0x3215, 0x3214, 0x3213, 0x3212, 0x3212, 0x3211, 0x3210, // 44088
-    0x3210, 0x320f, 0x320e, 0x320d, 0x320d, 0x320c, 0x320b, 0x320b, // 44096
-    0x320a, 0x3209, 0x3209, 0x3208, 0x3207, 0x3206, 0x3206, 0x3205, // 44104
-    0x3204, 0x3204, 0x3203, 0x3202, 0x3201, 0x3201, 0x3200, 0x31ff, // 44112
-    0x31ff, 0x31fe, 0x31fd, 0x31fc, 0x31fc, 0x31fb, 0x31fa, 0x31fa, // 44120
-    0x31f9, 0x31f8, 0x31f8, 0x31f7, 0x31f6, 0x31f5, 0x31f5, 0x31f4, // 44128
-    0x31f3, 0x31f3, 0x31f2, 0x31f1, 0x31f0, 0x31f0, 0x31ef, 0x31ee, // 44136
-    0x31ee, 0x31ed, 0x31ec, 0x31eb, 0x31eb, 0x31ea, 0x31e9, 0x31e9, // 44144
-    0x31e8, 0x31e7, 0x31e7, 0x31e6, 0x31e5, 0x31e4, 0x31e4, 0x31e3, // 44152
-    0x31e2, 0x31e2, 0x31e1, 0x31e0, 0x31df, 0x31df, 0x31de, 0x31dd, // 44160
-    0x31dd, 0x31dc, 0x31db, 0x31da, 0x31da, 0x31d9, 0x31d8, 0x31d8, // 44168
-    0x31d7, 0x31d6, 0x31d5, 0x31d5, 0x31d4, 0x31d3, 0x31d3, 0x31d2, // 44176
-    0x31d1, 0x31d1, 0x31d0, 0x31cf, 0x31ce, 0x31ce, 0x31cd, 0x31cc, // 44184
-    0x31cc, 0x31cb, 0x31ca, 0x31c9, 0x31c9, 0x31c8, 0x31c7, 0x31c7, // 44192
-    0x31c6, 0x31c5, 0x31c4, 0x31c4, 0x31c3, 0x31c2, 0x31c2, 0x31c1, // 44200
-    0x31c0, 0x31c0, 0x31bf, 0x31be, 0x31bd, 0x31bd, 0x31bc, 0x31bb, // 44208
-    0x31bb, 0x31ba, 0x31b9, 0x31b8, 0x31b8, 0x31b7, 0x31b6, 0x31b6, // 44216
-    0x31b5, 0x31b4, 0x31b3, 0x31b3, 0x31b2, 0x31b1, 0x31b1, 0x31b0, // 44224
-    0x31af, 0x31ae, 0x31ae, 0x31ad, 0x31ac, 0x31ac, 0x31ab, 0x31aa, // 44232
-    0x31aa, 0x31a9, 0x31a8, 0x31a7, 0x31a7, 0x31a6, 0x31a5, 0x31a5, // 44240
-    0x31a4, 0x31a3, 0x31a2, 0x31a2, 0x31a1, 0x31a0, 0x31a0, 0x319f, // 44248
-    0x319e, 0x319d, 0x319d, 0x319c, 0x319b, 0x319b, 0x319a, 0x3199, // 44256
-    0x3199, 0x3198, 0x3197, 0x3196, 0x3196, 0x3195, 0x3194, 0x3194, // 44264
-    0x3193, 0x3192, 0x3191, 0x3191, 0x3190, 0x318f, 0x318f, 0x318e, // 44272
-    0x318d, 0x318c, 0x318c, 0x318b, 0x318a, 0x318a, 0x3189, 0x3188, // 44280
-    0x3188, 0x3187, 0x3186, 0x3185, 0x3185, 0x3184, 0x3183, 0x3183, // 44288
-    0x3182, 0x3181, 0x3180, 0x3180, 0x317f, 0x317e, 0x317e, 0x317d, // 44296
-    0x317c, 0x317b, 0x317b, 0x317a, 0x3179, 0x3179, 0x3178, 0x3177, // 44304
-    0x3176, 0x3176, 0x3175, 0x3174, 0x3174, 0x3173, 0x3172, 0x3172, // 44312
-    0x3171, 0x3170, 0x316f, 0x316f, 0x316e, 0x316d, 0x316d, 0x316c, // 44320
-    0x316b, 0x316a, 0x316a, 0x3169, 0x3168, 0x3168, 0x3167, 0x3166, // 44328
-    0x3165, 0x3165, 0x3164, 0x3163, 0x3163, 0x3162, 0x3161, 0x3161, // 44336
-    0x3160, 0x315f, 0x315e, 0x315e, 0x315d, 0x315c, 0x315c, 0x315b, // 44344
-    0x315a, 0x3159, 0x3159, 0x3158, 0x3157, 0x3157, 0x3156, 0x3155, // 44352
-    0x3154, 0x3154, 0x3153, 0x3152, 0x3152, 0x3151, 0x3150, 0x314f, // 44360
-    0x314f, 0x314e, 0x314d, 0x314d, 0x314c, 0x314b, 0x314b, 0x314a, // 44368
-    0x3149, 0x3148, 0x3148, 0x3147, 0x3146, 0x3146, 0x3145, 0x3144, // 44376
-    0x3143, 0x3143, 0x3142, 0x3141, 0x3141, 0x3140, 0x313f, 0x313e, // 44384
-    0x313e, 0x313d, 0x313c, 0x313c, 0x313b, 0x313a, 0x313a, 0x3139, // 44392
-    0x3138, 0x3137, 0x3137, 0x3136, 0x3135, 0x3135, 0x3134, 0x3133, // 44400
-    0x3132, 0x3132, 0x3131, 0x3130, 0x3130, 0x312f, 0x312e, 0x312d, // 44408
-    0x312d, 0x312c, 0x312b, 0x312b, 0x312a, 0x3129, 0x3128, 0x3128, // 44416
-    0x3127, 0x3126, 0x3126, 0x3125, 0x3124, 0x3124, 0x3123, 0x3122, // 44424
-    0x3121, 0x3121, 0x3120, 0x311f, 0x311f, 0x311e, 0x311d, 0x311c, // 44432
-    0x311c, 0x311b, 0x311a, 0x311a, 0x3119, 0x3118, 0x3117, 0x3117, // 44440
-    0x3116, 0x3115, 0x3115, 0x3114, 0x3113, 0x3113, 0x3112, 0x3111, // 44448
-    0x3110, 0x3110, 0x310f, 0x310e, 0x310e, 0x310d, 0x310c, 0x310b, // 44456
-    0x310b, 0x310a, 0x3109, 0x3109, 0x3108, 0x3107, 0x3106, 0x3106, // 44464
-    0x3105, 0x3104, 0x3104, 0x3103, 0x3102, 0x3102, 0x3101, 0x3100, // 44472
-    0x30ff, 0x30ff, 0x30fe, 0x30fd, 0x30fd, 0x30fc, 0x30fb, 0x30fa, // 44480
-    0x30fa, 0x30f9, 0x30f8, 0x30f8, 0x30f7, 0x30f6, 0x30f5, 0x30f5, // 44488
-    0x30f4, 0x30f3, 0x30f3, 0x30f2, 0x30f1, 0x30f0, 0x30f0, 0x30ef, // 44496
-    0x30ee, 0x30ee, 0x30ed, 0x30ec, 0x30ec, 0x30eb, 0x30ea, 0x30e9, // 44504
-    0x30e9, 0x30e8, 0x30e7, 0x30e7, 0x30e6, 0x30e5, 0x30e4, 0x30e4, // 44512
-    0x30e3, 0x30e2, 0x30e2, 0x30e1, 0x30e0, 0x30df, 0x30df, 0x30de, // 44520
-    0x30dd, 0x30dd, 0x30dc, 0x30db, 0x30db, 0x30da, 0x30d9, 0x30d8, // 44528
-    0x30d8, 0x30d7, 0x30d6, 0x30d6, 0x30d5, 0x30d4, 0x30d3, 0x30d3, // 44536
-    0x30d2, 0x30d1, 0x30d1, 0x30d0, 0x30cf, 0x30ce, 0x30ce, 0x30cd, // 44544
-    0x30cc, 0x30cc, 0x30cb, 0x30ca, 0x30c9, 0x30c9, 0x30c8, 0x30c7, // 44552
-    0x30c7, 0x30c6, 0x30c5, 0x30c5, 0x30c4, 0x30c3, 0x30c2, 0x30c2, // 44560
-    0x30c1, 0x30c0, 0x30c0, 0x30bf, 0x30be, 0x30bd, 0x30bd, 0x30bc, // 44568
-    0x30bb, 0x30bb, 0x30ba, 0x30b9, 0x30b8, 0x30b8, 0x30b7, 0x30b6, // 44576
-    0x30b6, 0x30b5, 0x30b4, 0x30b4, 0x30b3, 0x30b2, 0x30b1, 0x30b1, // 44584
-    0x30b0, 0x30af, 0x30af, 0x30ae, 0x30ad, 0x30ac, 0x30ac, 0x30ab, // 44592
-    0x30aa, 0x30aa, 0x30a9, 0x30a8, 0x30a7, 0x30a7, 0x30a6, 0x30a5, // 44600
-    0x30a5, 0x30a4, 0x30a3, 0x30a2, 0x30a2, 0x30a1, 0x30a0, 0x30a0, // 44608
-    0x309f, 0x309e, 0x309e, 0x309d, 0x309c, 0x309b, 0x309b, 0x309a, // 44616
-    0x3099, 0x3099, 0x3098, 0x3097, 0x3096, 0x3096, 0x3095, 0x3094, // 44624
-    0x3094, 0x3093, 0x3092, 0x3091, 0x3091, 0x3090, 0x308f, 0x308f, // 44632
-    0x308e, 0x308d, 0x308d, 0x308c, 0x308b, 0x308a, 0x308a, 0x3089, // 44640
-    0x3088, 0x3088, 0x3087, 0x3086, 0x3085, 0x3085, 0x3084, 0x3083, // 44648
-    0x3083, 0x3082, 0x3081, 0x3080, 0x3080, 0x307f, 0x307e, 0x307e, // 44656
-    0x307d, 0x307c, 0x307c, 0x307b, 0x307a, 0x3079, 0x3079, 0x3078, // 44664
-    0x3077, 0x3077, 0x3076, 0x3075, 0x3074, 0x3074, 0x3073, 0x3072, // 44672
-    0x3072, 0x3071, 0x3070, 0x306f, 0x306f, 0x306e, 0x306d, 0x306d, // 44680
-    0x306c, 0x306b, 0x306a, 0x306a, 0x3069, 0x3068, 0x3068, 0x3067, // 44688
-    0x3066, 0x3066, 0x3065, 0x3064, 0x3063, 0x3063, 0x3062, 0x3061, // 44696
-    0x3061, 0x3060, 0x305f, 0x305e, 0x305e, 0x305d, 0x305c, 0x305c, // 44704
-    0x305b, 0x305a, 0x3059, 0x3059, 0x3058, 0x3057, 0x3057, 0x3056, // 44712
-    0x3055, 0x3055, 0x3054, 0x3053, 0x3052, 0x3052, 0x3051, 0x3050, // 44720
-    0x3050, 0x304f, 0x304e, 0x304d, 0x304d, 0x304c, 0x304b, 0x304b, // 44728
-    0x304a, 0x3049, 0x3048, 0x3048, 0x3047, 0x3046, 0x3046, 0x3045, // 44736
-    0x3044, 0x3043, 0x3043, 0x3042, 0x3041, 0x3041, 0x3040, 0x303f, // 44744
-    0x303f, 0x303e, 0x303d, 0x303c, 0x303c, 0x303b, 0x303a, 0x303a, // 44752
-    0x3039, 0x3038, 0x3037, 0x3037, 0x3036, 0x3035, 0x3035, 0x3034, // 44760
-    0x3033, 0x3032, 0x3032, 0x3031, 0x3030, 0x3030, 0x302f, 0x302e, // 44768
-    0x302e, 0x302d, 0x302c, 0x302b, 0x302b, 0x302a, 0x3029, 0x3029, // 44776
-    0x3028, 0x3027, 0x3026, 0x3026, 0x3025, 0x3024, 0x3024, 0x3023, // 44784
-    0x3022, 0x3021, 0x3021, 0x3020, 0x301f, 0x301f, 0x301e, 0x301d, // 44792
-    0x301d, 0x301c, 0x301b, 0x301a, 0x301a, 0x3019, 0x3018, 0x3018, // 44800
-    0x3017, 0x3016, 0x3015, 0x3015, 0x3014, 0x3013, 0x3013, 0x3012, // 44808
-    0x3011, 0x3010, 0x3010, 0x300f, 0x300e, 0x300e, 0x300d, 0x300c, // 44816
-    0x300b, 0x300b, 0x300a, 0x3009, 0x3009, 0x3008, 0x3007, 0x3007, // 44824
-    0x3006, 0x3005, 0x3004, 0x3004, 0x3003, 0x3002, 0x3002, 0x3001, // 44832
-    0x3000, 0x2fff, 0x2fff, 0x2ffe, 0x2ffd, 0x2ffd, 0x2ffc, 0x2ffb, // 44840
-    0x2ffa, 0x2ffa, 0x2ff9, 0x2ff8, 0x2ff8, 0x2ff7, 0x2ff6, 0x2ff6, // 44848
-    0x2ff5, 0x2ff4, 0x2ff3, 0x2ff3, 0x2ff2, 0x2ff1, 0x2ff1, 0x2ff0, // 44856
-    0x2fef, 0x2fee, 0x2fee, 0x2fed, 0x2fec, 0x2fec, 0x2feb, 0x2fea, // 44864
-    0x2fe9, 0x2fe9, 0x2fe8, 0x2fe7, 0x2fe7, 0x2fe6, 0x2fe5, 0x2fe4, // 44872
-    0x2fe4, 0x2fe3, 0x2fe2, 0x2fe2, 0x2fe1, 0x2fe0, 0x2fe0, 0x2fdf, // 44880
-    0x2fde, 0x2fdd, 0x2fdd, 0x2fdc, 0x2fdb, 0x2fdb, 0x2fda, 0x2fd9, // 44888
-    0x2fd8, 0x2fd8, 0x2fd7, 0x2fd6, 0x2fd6, 0x2fd5, 0x2fd4, 0x2fd3, // 44896
-    0x2fd3, 0x2fd2, 0x2fd1, 0x2fd1, 0x2fd0, 0x2fcf, 0x2fcf, 0x2fce, // 44904
-    0x2fcd, 0x2fcc, 0x2fcc, 0x2fcb, 0x2fca, 0x2fca, 0x2fc9, 0x2fc8, // 44912
-    0x2fc7, 0x2fc7, 0x2fc6, 0x2fc5, 0x2fc5, 0x2fc4, 0x2fc3, 0x2fc2, // 44920
-    0x2fc2, 0x2fc1, 0x2fc0, 0x2fc0, 0x2fbf, 0x2fbe, 0x2fbd, 0x2fbd, // 44928
-    0x2fbc, 0x2fbb, 0x2fbb, 0x2fba, 0x2fb9, 0x2fb9, 0x2fb8, 0x2fb7, // 44936
-    0x2fb6, 0x2fb6, 0x2fb5, 0x2fb4, 0x2fb4, 0x2fb3, 0x2fb2, 0x2fb1, // 44944
-    0x2fb1, 0x2fb0, 0x2faf, 0x2faf, 0x2fae, 0x2fad, 0x2fac, 0x2fac, // 44952
-    0x2fab, 0x2faa, 0x2faa, 0x2fa9, 0x2fa8, 0x2fa8, 0x2fa7, 0x2fa6, // 44960
-    0x2fa5, 0x2fa5, 0x2fa4, 0x2fa3, 0x2fa3, 0x2fa2, 0x2fa1, 0x2fa0, // 44968
-    0x2fa0, 0x2f9f, 0x2f9e, 0x2f9e, 0x2f9d, 0x2f9c, 0x2f9b, 0x2f9b, // 44976
-    0x2f9a, 0x2f99, 0x2f99, 0x2f98, 0x2f97, 0x2f97, 0x2f96, 0x2f95, // 44984
-    0x2f94, 0x2f94, 0x2f93, 0x2f92, 0x2f92, 0x2f91, 0x2f90, 0x2f8f, // 44992
-    0x2f8f, 0x2f8e, 0x2f8d, 0x2f8d, 0x2f8c, 0x2f8b, 0x2f8a, 0x2f8a, // 45000
-    0x2f89, 0x2f88, 0x2f88, 0x2f87, 0x2f86, 0x2f85, 0x2f85, 0x2f84, // 45008
-    0x2f83, 0x2f83, 0x2f82, 0x2f81, 0x2f81, 0x2f80, 0x2f7f, 0x2f7e, // 45016
-    0x2f7e, 0x2f7d, 0x2f7c, 0x2f7c, 0x2f7b, 0x2f7a, 0x2f79, 0x2f79, // 45024
-    0x2f78, 0x2f77, 0x2f77, 0x2f76, 0x2f75, 0x2f74, 0x2f74, 0x2f73, // 45032
-    0x2f72, 0x2f72, 0x2f71, 0x2f70, 0x2f70, 0x2f6f, 0x2f6e, 0x2f6d, // 45040
-    0x2f6d, 0x2f6c, 0x2f6b, 0x2f6b, 0x2f6a, 0x2f69, 0x2f68, 0x2f68, // 45048
-    0x2f68, 0x2f67, 0x2f67, 0x2f66, 0x2f65, 0x2f65, 0x2f64, 0x2f63, // 45056
-    0x2f62, 0x2f62, 0x2f61, 0x2f60, 0x2f60, 0x2f5f, 0x2f5e, 0x2f5e, // 45064
-    0x2f5d, 0x2f5c, 0x2f5b, 0x2f5b, 0x2f5a, 0x2f59, 0x2f59, 0x2f58, // 45072
-    0x2f57, 0x2f57, 0x2f56, 0x2f55, 0x2f54, 0x2f54, 0x2f53, 0x2f52, // 45080
-    0x2f52, 0x2f51, 0x2f50, 0x2f50, 0x2f4f, 0x2f4e, 0x2f4e, 0x2f4d, // 45088
-    0x2f4c, 0x2f4b, 0x2f4b, 0x2f4a, 0x2f49, 0x2f49, 0x2f48, 0x2f47, // 45096
-    0x2f47, 0x2f46, 0x2f45, 0x2f44, 0x2f44, 0x2f43, 0x2f42, 0x2f42, // 45104
-    0x2f41, 0x2f40, 0x2f40, 0x2f3f, 0x2f3e, 0x2f3d, 0x2f3d, 0x2f3c, // 45112
-    0x2f3b, 0x2f3b, 0x2f3a, 0x2f39, 0x2f39, 0x2f38, 0x2f37, 0x2f36, // 45120
-    0x2f36, 0x2f35, 0x2f34, 0x2f34, 0x2f33, 0x2f32, 0x2f32, 0x2f31, // 45128
-    0x2f30, 0x2f30, 0x2f2f, 0x2f2e, 0x2f2d, 0x2f2d, 0x2f2c, 0x2f2b, // 45136
-    0x2f2b, 0x2f2a, 0x2f29, 0x2f29, 0x2f28, 0x2f27, 0x2f26, 0x2f26, // 45144
-    0x2f25, 0x2f24, 0x2f24, 0x2f23, 0x2f22, 0x2f22, 0x2f21, 0x2f20, // 45152
-    0x2f1f, 0x2f1f, 0x2f1e, 0x2f1d, 0x2f1d, 0x2f1c, 0x2f1b, 0x2f1b, // 45160
-    0x2f1a, 0x2f19, 0x2f19, 0x2f18, 0x2f17, 0x2f16, 0x2f16, 0x2f15, // 45168
-    0x2f14, 0x2f14, 0x2f13, 0x2f12, 0x2f12, 0x2f11, 0x2f10, 0x2f0f, // 45176
-    0x2f0f, 0x2f0e, 0x2f0d, 0x2f0d, 0x2f0c, 0x2f0b, 0x2f0b, 0x2f0a, // 45184
-    0x2f09, 0x2f08, 0x2f08, 0x2f07, 0x2f06, 0x2f06, 0x2f05, 0x2f04, // 45192
-    0x2f04, 0x2f03, 0x2f02, 0x2f02, 0x2f01, 0x2f00, 0x2eff, 0x2eff, // 45200
-    0x2efe, 0x2efd, 0x2efd, 0x2efc, 0x2efb, 0x2efb, 0x2efa, 0x2ef9, // 45208
-    0x2ef8, 0x2ef8, 0x2ef7, 0x2ef6, 0x2ef6, 0x2ef5, 0x2ef4, 0x2ef4, // 45216
-    0x2ef3, 0x2ef2, 0x2ef1, 0x2ef1, 0x2ef0, 0x2eef, 0x2eef, 0x2eee, // 45224
-    0x2eed, 0x2eed, 0x2eec, 0x2eeb, 0x2eea, 0x2eea, 0x2ee9, 0x2ee8, // 45232
-    0x2ee8, 0x2ee7, 0x2ee6, 0x2ee6, 0x2ee5, 0x2ee4, 0x2ee4, 0x2ee3, // 45240
-    0x2ee2, 0x2ee1, 0x2ee1, 0x2ee0, 0x2edf, 0x2edf, 0x2ede, 0x2edd, // 45248
-    0x2edd, 0x2edc, 0x2edb, 0x2eda, 0x2eda, 0x2ed9, 0x2ed8, 0x2ed8, // 45256
-    0x2ed7, 0x2ed6, 0x2ed6, 0x2ed5, 0x2ed4, 0x2ed3, 0x2ed3, 0x2ed2, // 45264
-    0x2ed1, 0x2ed1, 0x2ed0, 0x2ecf, 0x2ecf, 0x2ece, 0x2ecd, 0x2ecd, // 45272
-    0x2ecc, 0x2ecb, 0x2eca, 0x2eca, 0x2ec9, 0x2ec8, 0x2ec8, 0x2ec7, // 45280
-    0x2ec6, 0x2ec6, 0x2ec5, 0x2ec4, 0x2ec3, 0x2ec3, 0x2ec2, 0x2ec1, // 45288
-    0x2ec1, 0x2ec0, 0x2ebf, 0x2ebf, 0x2ebe, 0x2ebd, 0x2ebc, 0x2ebc, // 45296
-    0x2ebb, 0x2eba, 0x2eba, 0x2eb9, 0x2eb8, 0x2eb8, 0x2eb7, 0x2eb6, // 45304
-    0x2eb6, 0x2eb5, 0x2eb4, 0x2eb3, 0x2eb3, 0x2eb2, 0x2eb1, 0x2eb1, // 45312
-    0x2eb0, 0x2eaf, 0x2eaf, 0x2eae, 0x2ead, 0x2eac, 0x2eac, 0x2eab, // 45320
-    0x2eaa, 0x2eaa, 0x2ea9, 0x2ea8, 0x2ea8, 0x2ea7, 0x2ea6, 0x2ea5, // 45328
-    0x2ea5, 0x2ea4, 0x2ea3, 0x2ea3, 0x2ea2, 0x2ea1, 0x2ea1, 0x2ea0, // 45336
-    0x2e9f, 0x2e9e, 0x2e9e, 0x2e9d, 0x2e9c, 0x2e9c, 0x2e9b, 0x2e9a, // 45344
-    0x2e9a, 0x2e99, 0x2e98, 0x2e98, 0x2e97, 0x2e96, 0x2e95, 0x2e95, // 45352
-    0x2e94, 0x2e93, 0x2e93, 0x2e92, 0x2e91, 0x2e91, 0x2e90, 0x2e8f, // 45360
-    0x2e8e, 0x2e8e, 0x2e8d, 0x2e8c, 0x2e8c, 0x2e8b, 0x2e8a, 0x2e8a, // 45368
-    0x2e89, 0x2e88, 0x2e87, 0x2e87, 0x2e86, 0x2e85, 0x2e85, 0x2e84, // 45376
-    0x2e83, 0x2e83, 0x2e82, 0x2e81, 0x2e81, 0x2e80, 0x2e7f, 0x2e7e, // 45384
-    0x2e7e, 0x2e7d, 0x2e7c, 0x2e7c, 0x2e7b, 0x2e7a, 0x2e7a, 0x2e79, // 45392
-    0x2e78, 0x2e77, 0x2e77, 0x2e76, 0x2e75, 0x2e75, 0x2e74, 0x2e73, // 45400
-    0x2e73, 0x2e72, 0x2e71, 0x2e70, 0x2e70, 0x2e6f, 0x2e6e, 0x2e6e, // 45408
-    0x2e6d, 0x2e6c, 0x2e6c, 0x2e6b, 0x2e6a, 0x2e69, 0x2e69, 0x2e68, // 45416
-    0x2e67, 0x2e67, 0x2e66, 0x2e65, 0x2e65, 0x2e64, 0x2e63, 0x2e63, // 45424
-    0x2e62, 0x2e61, 0x2e60, 0x2e60, 0x2e5f, 0x2e5e, 0x2e5e, 0x2e5d, // 45432
-    0x2e5c, 0x2e5c, 0x2e5b, 0x2e5a, 0x2e59, 0x2e59, 0x2e58, 0x2e57, // 45440
-    0x2e57, 0x2e56, 0x2e55, 0x2e55, 0x2e54, 0x2e53, 0x2e52, 0x2e52, // 45448
-    0x2e51, 0x2e50, 0x2e50, 0x2e4f, 0x2e4e, 0x2e4e, 0x2e4d, 0x2e4c, // 45456
-    0x2e4c, 0x2e4b, 0x2e4a, 0x2e49, 0x2e49, 0x2e48, 0x2e47, 0x2e47, // 45464
-    0x2e46, 0x2e45, 0x2e45, 0x2e44, 0x2e43, 0x2e42, 0x2e42, 0x2e41, // 45472
-    0x2e40, 0x2e40, 0x2e3f, 0x2e3e, 0x2e3e, 0x2e3d, 0x2e3c, 0x2e3b, // 45480
-    0x2e3b, 0x2e3a, 0x2e39, 0x2e39, 0x2e38, 0x2e37, 0x2e37, 0x2e36, // 45488
-    0x2e35, 0x2e35, 0x2e34, 0x2e33, 0x2e32, 0x2e32, 0x2e31, 0x2e30, // 45496
-    0x2e30, 0x2e2f, 0x2e2e, 0x2e2e, 0x2e2d, 0x2e2c, 0x2e2b, 0x2e2b, // 45504
-    0x2e2a, 0x2e29, 0x2e29, 0x2e28, 0x2e27, 0x2e27, 0x2e26, 0x2e25, // 45512
-    0x2e24, 0x2e24, 0x2e23, 0x2e22, 0x2e22, 0x2e21, 0x2e20, 0x2e20, // 45520
-    0x2e1f, 0x2e1e, 0x2e1d, 0x2e1d, 0x2e1c, 0x2e1b, 0x2e1b, 0x2e1a, // 45528
-    0x2e19, 0x2e19, 0x2e18, 0x2e17, 0x2e17, 0x2e16, 0x2e15, 0x2e14, // 45536
-    0x2e14, 0x2e13, 0x2e12, 0x2e12, 0x2e11, 0x2e10, 0x2e10, 0x2e0f, // 45544
-    0x2e0e, 0x2e0d, 0x2e0d, 0x2e0c, 0x2e0b, 0x2e0b, 0x2e0a, 0x2e09, // 45552
-    0x2e09, 0x2e08, 0x2e07, 0x2e06, 0x2e06, 0x2e05, 0x2e04, 0x2e04, // 45560
-    0x2e03, 0x2e02, 0x2e02, 0x2e01, 0x2e00, 0x2e00, 0x2dff, 0x2dfe, // 45568
-    0x2dfd, 0x2dfd, 0x2dfc, 0x2dfb, 0x2dfb, 0x2dfa, 0x2df9, 0x2df9, // 45576
-    0x2df8, 0x2df7, 0x2df6, 0x2df6, 0x2df5, 0x2df4, 0x2df4, 0x2df3, // 45584
-    0x2df2, 0x2df2, 0x2df1, 0x2df0, 0x2def, 0x2def, 0x2dee, 0x2ded, // 45592
-    0x2ded, 0x2dec, 0x2deb, 0x2deb, 0x2dea, 0x2de9, 0x2de9, 0x2de8, // 45600
-    0x2de7, 0x2de6, 0x2de6, 0x2de5, 0x2de4, 0x2de4, 0x2de3, 0x2de2, // 45608
-    0x2de2, 0x2de1, 0x2de0, 0x2ddf, 0x2ddf, 0x2dde, 0x2ddd, 0x2ddd, // 45616
-    0x2ddc, 0x2ddb, 0x2ddb, 0x2dda, 0x2dd9, 0x2dd8, 0x2dd8, 0x2dd7, // 45624
-    0x2dd6, 0x2dd6, 0x2dd5, 0x2dd4, 0x2dd4, 0x2dd3, 0x2dd2, 0x2dd1, // 45632
-    0x2dd1, 0x2dd0, 0x2dcf, 0x2dcf, 0x2dce, 0x2dcd, 0x2dcd, 0x2dcc, // 45640
-    0x2dcb, 0x2dcb, 0x2dca, 0x2dc9, 0x2dc8, 0x2dc8, 0x2dc7, 0x2dc6, // 45648
-    0x2dc6, 0x2dc5, 0x2dc4, 0x2dc4, 0x2dc3, 0x2dc2, 0x2dc1, 0x2dc1, // 45656
-    0x2dc0, 0x2dbf, 0x2dbf, 0x2dbe, 0x2dbd, 0x2dbd, 0x2dbc, 0x2dbb, // 45664
-    0x2dba, 0x2dba, 0x2db9, 0x2db8, 0x2db8, 0x2db7, 0x2db6, 0x2db6, // 45672
-    0x2db5, 0x2db4, 0x2db4, 0x2db3, 0x2db2, 0x2db1, 0x2db1, 0x2db0, // 45680
-    0x2daf, 0x2daf, 0x2dae, 0x2dad, 0x2dad, 0x2dac, 0x2dab, 0x2daa, // 45688
-    0x2daa, 0x2da9, 0x2da8, 0x2da8, 0x2da7, 0x2da6, 0x2da6, 0x2da5, // 45696
-    0x2da4, 0x2da3, 0x2da3, 0x2da2, 0x2da1, 0x2da1, 0x2da0, 0x2d9f, // 45704
-    0x2d9f, 0x2d9e, 0x2d9d, 0x2d9d, 0x2d9c, 0x2d9b, 0x2d9a, 0x2d9a, // 45712
-    0x2d99, 0x2d98, 0x2d98, 0x2d97, 0x2d96, 0x2d96, 0x2d95, 0x2d94, // 45720
-    0x2d93, 0x2d93, 0x2d92, 0x2d91, 0x2d91, 0x2d90, 0x2d8f, 0x2d8f, // 45728
-    0x2d8e, 0x2d8d, 0x2d8c, 0x2d8c, 0x2d8b, 0x2d8a, 0x2d8a, 0x2d89, // 45736
-    0x2d88, 0x2d88, 0x2d87, 0x2d86, 0x2d85, 0x2d85, 0x2d84, 0x2d83, // 45744
-    0x2d83, 0x2d82, 0x2d81, 0x2d81, 0x2d80, 0x2d7f, 0x2d7f, 0x2d7e, // 45752
-    0x2d7d, 0x2d7c, 0x2d7c, 0x2d7b, 0x2d7a, 0x2d7a, 0x2d79, 0x2d78, // 45760
-    0x2d78, 0x2d77, 0x2d76, 0x2d75, 0x2d75, 0x2d74, 0x2d73, 0x2d73, // 45768
-    0x2d72, 0x2d71, 0x2d71, 0x2d70, 0x2d6f, 0x2d6e, 0x2d6e, 0x2d6d, // 45776
-    0x2d6c, 0x2d6c, 0x2d6b, 0x2d6a, 0x2d6a, 0x2d69, 0x2d68, 0x2d68, // 45784
-    0x2d67, 0x2d66, 0x2d65, 0x2d65, 0x2d64, 0x2d63, 0x2d63, 0x2d62, // 45792
-    0x2d61, 0x2d61, 0x2d60, 0x2d5f, 0x2d5e, 0x2d5e, 0x2d5d, 0x2d5c, // 45800
-    0x2d5c, 0x2d5b, 0x2d5a, 0x2d5a, 0x2d59, 0x2d58, 0x2d57, 0x2d57, // 45808
-    0x2d56, 0x2d55, 0x2d55, 0x2d54, 0x2d53, 0x2d53, 0x2d52, 0x2d51, // 45816
-    0x2d51, 0x2d50, 0x2d4f, 0x2d4e, 0x2d4e, 0x2d4d, 0x2d4c, 0x2d4c, // 45824
-    0x2d4b, 0x2d4a, 0x2d4a, 0x2d49, 0x2d48, 0x2d47, 0x2d47, 0x2d46, // 45832
-    0x2d45, 0x2d45, 0x2d44, 0x2d43, 0x2d43, 0x2d42, 0x2d41, 0x2d40, // 45840
-    0x2d40, 0x2d3f, 0x2d3e, 0x2d3e, 0x2d3d, 0x2d3c, 0x2d3c, 0x2d3b, // 45848
-    0x2d3a, 0x2d39, 0x2d39, 0x2d38, 0x2d37, 0x2d37, 0x2d36, 0x2d35, // 45856
-    0x2d35, 0x2d34, 0x2d33, 0x2d33, 0x2d32, 0x2d31, 0x2d30, 0x2d30, // 45864
-    0x2d2f, 0x2d2e, 0x2d2e, 0x2d2d, 0x2d2c, 0x2d2c, 0x2d2b, 0x2d2a, // 45872
-    0x2d29, 0x2d29, 0x2d28, 0x2d27, 0x2d27, 0x2d26, 0x2d25, 0x2d25, // 45880
-    0x2d24, 0x2d23, 0x2d22, 0x2d22, 0x2d21, 0x2d20, 0x2d20, 0x2d1f, // 45888
-    0x2d1e, 0x2d1e, 0x2d1d, 0x2d1c, 0x2d1c, 0x2d1b, 0x2d1a, 0x2d19, // 45896
-    0x2d19, 0x2d18, 0x2d17, 0x2d17, 0x2d16, 0x2d15, 0x2d15, 0x2d14, // 45904
-    0x2d13, 0x2d12, 0x2d12, 0x2d11, 0x2d10, 0x2d10, 0x2d0f, 0x2d0e, // 45912
-    0x2d0e, 0x2d0d, 0x2d0c, 0x2d0b, 0x2d0b, 0x2d0a, 0x2d09, 0x2d09, // 45920
-    0x2d08, 0x2d07, 0x2d07, 0x2d06, 0x2d05, 0x2d04, 0x2d04, 0x2d03, // 45928
-    0x2d02, 0x2d02, 0x2d01, 0x2d00, 0x2d00, 0x2cff, 0x2cfe, 0x2cfe, // 45936
-    0x2cfd, 0x2cfc, 0x2cfb, 0x2cfb, 0x2cfa, 0x2cf9, 0x2cf9, 0x2cf8, // 45944
-    0x2cf7, 0x2cf7, 0x2cf6, 0x2cf5, 0x2cf4, 0x2cf4, 0x2cf3, 0x2cf2, // 45952
-    0x2cf2, 0x2cf1, 0x2cf0, 0x2cf0, 0x2cef, 0x2cee, 0x2ced, 0x2ced, // 45960
-    0x2cec, 0x2ceb, 0x2ceb, 0x2cea, 0x2ce9, 0x2ce9, 0x2ce8, 0x2ce7, // 45968
-    0x2ce7, 0x2ce6, 0x2ce5, 0x2ce4, 0x2ce4, 0x2ce3, 0x2ce2, 0x2ce2, // 45976
-    0x2ce1, 0x2ce0, 0x2ce0, 0x2cdf, 0x2cde, 0x2cdd, 0x2cdd, 0x2cdc, // 45984
-    0x2cdb, 0x2cdb, 0x2cda, 0x2cd9, 0x2cd9, 0x2cd8, 0x2cd7, 0x2cd6, // 45992
-    0x2cd6, 0x2cd5, 0x2cd4, 0x2cd4, 0x2cd3, 0x2cd2, 0x2cd2, 0x2cd1, // 46000
-    0x2cd0, 0x2cd0, 0x2ccf, 0x2cce, 0x2ccd, 0x2ccd, 0x2ccc, 0x2ccb, // 46008
-    0x2ccb, 0x2cca, 0x2cc9, 0x2cc9, 0x2cc8, 0x2cc7, 0x2cc6, 0x2cc6, // 46016
-    0x2cc5, 0x2cc4, 0x2cc4, 0x2cc3, 0x2cc2, 0x2cc2, 0x2cc1, 0x2cc0, // 46024
-    0x2cbf, 0x2cbf, 0x2cbe, 0x2cbd, 0x2cbd, 0x2cbc, 0x2cbb, 0x2cbb, // 46032
-    0x2cba, 0x2cb9, 0x2cb8, 0x2cb8, 0x2cb7, 0x2cb6, 0x2cb6, 0x2cb5, // 46040
-    0x2cb4, 0x2cb4, 0x2cb3, 0x2cb2, 0x2cb2, 0x2cb1, 0x2cb0, 0x2caf, // 46048
-    0x2caf, 0x2cae, 0x2cad, 0x2cad, 0x2cac, 0x2cab, 0x2cab, 0x2caa, // 46056
-    0x2ca9, 0x2ca8, 0x2ca8, 0x2ca7, 0x2ca6, 0x2ca6, 0x2ca5, 0x2ca4, // 46064
-    0x2ca4, 0x2ca3, 0x2ca2, 0x2ca1, 0x2ca1, 0x2ca0, 0x2c9f, 0x2c9f, // 46072
-    0x2c9e, 0x2c9d, 0x2c9d, 0x2c9c, 0x2c9b, 0x2c9b, 0x2c9a, 0x2c99, // 46080
-    0x2c99, 0x2c98, 0x2c97, 0x2c97, 0x2c96, 0x2c95, 0x2c94, 0x2c94, // 46088
-    0x2c93, 0x2c92, 0x2c92, 0x2c91, 0x2c90, 0x2c90, 0x2c8f, 0x2c8e, // 46096
-    0x2c8e, 0x2c8d, 0x2c8c, 0x2c8c, 0x2c8b, 0x2c8a, 0x2c8a, 0x2c89, // 46104
-    0x2c88, 0x2c88, 0x2c87, 0x2c86, 0x2c85, 0x2c85, 0x2c84, 0x2c83, // 46112
-    0x2c83, 0x2c82, 0x2c81, 0x2c81, 0x2c80, 0x2c7f, 0x2c7f, 0x2c7e, // 46120
-    0x2c7d, 0x2c7d, 0x2c7c, 0x2c7b, 0x2c7b, 0x2c7a, 0x2c79, 0x2c79, // 46128
-    0x2c78, 0x2c77, 0x2c76, 0x2c76, 0x2c75, 0x2c74, 0x2c74, 0x2c73, // 46136
-    0x2c72, 0x2c72, 0x2c71, 0x2c70, 0x2c70, 0x2c6f, 0x2c6e, 0x2c6e, // 46144
-    0x2c6d, 0x2c6c, 0x2c6c, 0x2c6b, 0x2c6a, 0x2c6a, 0x2c69, 0x2c68, // 46152
-    0x2c67, 0x2c67, 0x2c66, 0x2c65, 0x2c65, 0x2c64, 0x2c63, 0x2c63, // 46160
-    0x2c62, 0x2c61, 0x2c61, 0x2c60, 0x2c5f, 0x2c5f, 0x2c5e, 0x2c5d, // 46168
-    0x2c5d, 0x2c5c, 0x2c5b, 0x2c5b, 0x2c5a, 0x2c59, 0x2c58, 0x2c58, // 46176
-    0x2c57, 0x2c56, 0x2c56, 0x2c55, 0x2c54, 0x2c54, 0x2c53, 0x2c52, // 46184
-    0x2c52, 0x2c51, 0x2c50, 0x2c50, 0x2c4f, 0x2c4e, 0x2c4e, 0x2c4d, // 46192
-    0x2c4c, 0x2c4c, 0x2c4b, 0x2c4a, 0x2c49, 0x2c49, 0x2c48, 0x2c47, // 46200
-    0x2c47, 0x2c46, 0x2c45, 0x2c45, 0x2c44, 0x2c43, 0x2c43, 0x2c42, // 46208
-    0x2c41, 0x2c41, 0x2c40, 0x2c3f, 0x2c3f, 0x2c3e, 0x2c3d, 0x2c3d, // 46216
-    0x2c3c, 0x2c3b, 0x2c3a, 0x2c3a, 0x2c39, 0x2c38, 0x2c38, 0x2c37, // 46224
-    0x2c36, 0x2c36, 0x2c35, 0x2c34, 0x2c34, 0x2c33, 0x2c32, 0x2c32, // 46232
-    0x2c31, 0x2c30, 0x2c30, 0x2c2f, 0x2c2e, 0x2c2e, 0x2c2d, 0x2c2c, // 46240
-    0x2c2b, 0x2c2b, 0x2c2a, 0x2c29, 0x2c29, 0x2c28, 0x2c27, 0x2c27, // 46248
-    0x2c26, 0x2c25, 0x2c25, 0x2c24, 0x2c23, 0x2c23, 0x2c22, 0x2c21, // 46256
-    0x2c21, 0x2c20, 0x2c1f, 0x2c1f, 0x2c1e, 0x2c1d, 0x2c1c, 0x2c1c, // 46264
-    0x2c1b, 0x2c1a, 0x2c1a, 0x2c19, 0x2c18, 0x2c18, 0x2c17, 0x2c16, // 46272
-    0x2c16, 0x2c15, 0x2c14, 0x2c14, 0x2c13, 0x2c12, 0x2c12, 0x2c11, // 46280
-    0x2c10, 0x2c10, 0x2c0f, 0x2c0e, 0x2c0d, 0x2c0d, 0x2c0c, 0x2c0b, // 46288
-    0x2c0b, 0x2c0a, 0x2c09, 0x2c09, 0x2c08, 0x2c07, 0x2c07, 0x2c06, // 46296
-    0x2c05, 0x2c05, 0x2c04, 0x2c03, 0x2c03, 0x2c02, 0x2c01, 0x2c01, // 46304
-    0x2c00, 0x2bff, 0x2bfe, 0x2bfe, 0x2bfd, 0x2bfc, 0x2bfc, 0x2bfb, // 46312
-    0x2bfa, 0x2bfa, 0x2bf9, 0x2bf8, 0x2bf8, 0x2bf7, 0x2bf6, 0x2bf6, // 46320
-    0x2bf5, 0x2bf4, 0x2bf4, 0x2bf3, 0x2bf2, 0x2bf2, 0x2bf1, 0x2bf0, // 46328
-    0x2bf0, 0x2bef, 0x2bee, 0x2bed, 0x2bed, 0x2bec, 0x2beb, 0x2beb, // 46336
-    0x2bea, 0x2be9, 0x2be9, 0x2be8, 0x2be7, 0x2be7, 0x2be6, 0x2be5, // 46344
-    0x2be5, 0x2be4, 0x2be3, 0x2be3, 0x2be2, 0x2be1, 0x2be1, 0x2be0, // 46352
-    0x2bdf, 0x2bde, 0x2bde, 0x2bdd, 0x2bdc, 0x2bdc, 0x2bdb, 0x2bda, // 46360
-    0x2bda, 0x2bd9, 0x2bd8, 0x2bd8, 0x2bd7, 0x2bd6, 0x2bd6, 0x2bd5, // 46368
-    0x2bd4, 0x2bd4, 0x2bd3, 0x2bd2, 0x2bd2, 0x2bd1, 0x2bd0, 0x2bcf, // 46376
-    0x2bcf, 0x2bce, 0x2bcd, 0x2bcd, 0x2bcc, 0x2bcb, 0x2bcb, 0x2bca, // 46384
-    0x2bc9, 0x2bc9, 0x2bc8, 0x2bc7, 0x2bc7, 0x2bc6, 0x2bc5, 0x2bc5, // 46392
-    0x2bc4, 0x2bc3, 0x2bc3, 0x2bc2, 0x2bc1, 0x2bc0, 0x2bc0, 0x2bbf, // 46400
-    0x2bbe, 0x2bbe, 0x2bbd, 0x2bbc, 0x2bbc, 0x2bbb, 0x2bba, 0x2bba, // 46408
-    0x2bb9, 0x2bb8, 0x2bb8, 0x2bb7, 0x2bb6, 0x2bb6, 0x2bb5, 0x2bb4, // 46416
-    0x2bb4, 0x2bb3, 0x2bb2, 0x2bb1, 0x2bb1, 0x2bb0, 0x2baf, 0x2baf, // 46424
-    0x2bae, 0x2bad, 0x2bad, 0x2bac, 0x2bab, 0x2bab, 0x2baa, 0x2ba9, // 46432
-    0x2ba9, 0x2ba8, 0x2ba7, 0x2ba7, 0x2ba6, 0x2ba5, 0x2ba5, 0x2ba4, // 46440
-    0x2ba3, 0x2ba2, 0x2ba2, 0x2ba1, 0x2ba0, 0x2ba0, 0x2b9f, 0x2b9e, // 46448
-    0x2b9e, 0x2b9d, 0x2b9c, 0x2b9c, 0x2b9b, 0x2b9a, 0x2b9a, 0x2b99, // 46456
-    0x2b98, 0x2b98, 0x2b97, 0x2b96, 0x2b96, 0x2b95, 0x2b94, 0x2b93, // 46464
-    0x2b93, 0x2b92, 0x2b91, 0x2b91, 0x2b90, 0x2b8f, 0x2b8f, 0x2b8e, // 46472
-    0x2b8d, 0x2b8d, 0x2b8c, 0x2b8b, 0x2b8b, 0x2b8a, 0x2b89, 0x2b89, // 46480
-    0x2b88, 0x2b87, 0x2b87, 0x2b86, 0x2b85, 0x2b84, 0x2b84, 0x2b83, // 46488
-    0x2b82, 0x2b82, 0x2b81, 0x2b80, 0x2b80, 0x2b7f, 0x2b7e, 0x2b7e, // 46496
-    0x2b7d, 0x2b7c, 0x2b7c, 0x2b7b, 0x2b7a, 0x2b7a, 0x2b79, 0x2b78, // 46504
-    0x2b78, 0x2b77, 0x2b76, 0x2b75, 0x2b75, 0x2b74, 0x2b73, 0x2b73, // 46512
-    0x2b72, 0x2b71, 0x2b71, 0x2b70, 0x2b6f, 0x2b6f, 0x2b6e, 0x2b6d, // 46520
-    0x2b6d, 0x2b6c, 0x2b6b, 0x2b6b, 0x2b6a, 0x2b69, 0x2b69, 0x2b68, // 46528
-    0x2b67, 0x2b66, 0x2b66, 0x2b65, 0x2b64, 0x2b64, 0x2b63, 0x2b62, // 46536
-    0x2b62, 0x2b61, 0x2b60, 0x2b60, 0x2b5f, 0x2b5e, 0x2b5e, 0x2b5d, // 46544
-    0x2b5c, 0x2b5c, 0x2b5b, 0x2b5a, 0x2b5a, 0x2b59, 0x2b58, 0x2b57, // 46552
-    0x2b57, 0x2b56, 0x2b55, 0x2b55, 0x2b54, 0x2b53, 0x2b53, 0x2b52, // 46560
-    0x2b51, 0x2b51, 0x2b50, 0x2b4f, 0x2b4f, 0x2b4e, 0x2b4d, 0x2b4d, // 46568
-    0x2b4c, 0x2b4b, 0x2b4b, 0x2b4a, 0x2b49, 0x2b48, 0x2b48, 0x2b47, // 46576
-    0x2b46, 0x2b46, 0x2b45, 0x2b44, 0x2b44, 0x2b43, 0x2b42, 0x2b42, // 46584
-    0x2b41, 0x2b40, 0x2b40, 0x2b3f, 0x2b3e, 0x2b3e, 0x2b3d, 0x2b3c, // 46592
-    0x2b3c, 0x2b3b, 0x2b3a, 0x2b3a, 0x2b39, 0x2b38, 0x2b37, 0x2b37, // 46600
-    0x2b36, 0x2b35, 0x2b35, 0x2b34, 0x2b33, 0x2b33, 0x2b32, 0x2b31, // 46608
-    0x2b31, 0x2b30, 0x2b2f, 0x2b2f, 0x2b2e, 0x2b2d, 0x2b2d, 0x2b2c, // 46616
-    0x2b2b, 0x2b2b, 0x2b2a, 0x2b29, 0x2b28, 0x2b28, 0x2b27, 0x2b26, // 46624
-    0x2b26, 0x2b25, 0x2b24, 0x2b24, 0x2b23, 0x2b22, 0x2b22, 0x2b21, // 46632
-    0x2b20, 0x2b20, 0x2b1f, 0x2b1e, 0x2b1e, 0x2b1d, 0x2b1c, 0x2b1c, // 46640
-    0x2b1b, 0x2b1a, 0x2b19, 0x2b19, 0x2b18, 0x2b17, 0x2b17, 0x2b16, // 46648
-    0x2b15, 0x2b15, 0x2b14, 0x2b13, 0x2b13, 0x2b12, 0x2b11, 0x2b11, // 46656
-    0x2b10, 0x2b0f, 0x2b0f, 0x2b0e, 0x2b0d, 0x2b0d, 0x2b0c, 0x2b0b, // 46664
-    0x2b0a, 0x2b0a, 0x2b09, 0x2b08, 0x2b08, 0x2b07, 0x2b06, 0x2b06, // 46672
-    0x2b05, 0x2b04, 0x2b04, 0x2b03, 0x2b02, 0x2b02, 0x2b01, 0x2b00, // 46680
-    0x2b00, 0x2aff, 0x2afe, 0x2afe, 0x2afd, 0x2afc, 0x2afb, 0x2afb, // 46688
-    0x2afa, 0x2af9, 0x2af9, 0x2af8, 0x2af7, 0x2af7, 0x2af6, 0x2af5, // 46696
-    0x2af5, 0x2af4, 0x2af3, 0x2af3, 0x2af2, 0x2af1, 0x2af1, 0x2af0, // 46704
-    0x2aef, 0x2aef, 0x2aee, 0x2aed, 0x2aec, 0x2aec, 0x2aeb, 0x2aea, // 46712
-    0x2aea, 0x2ae9, 0x2ae8, 0x2ae8, 0x2ae7, 0x2ae6, 0x2ae6, 0x2ae5, // 46720
-    0x2ae4, 0x2ae4, 0x2ae3, 0x2ae2, 0x2ae2, 0x2ae1, 0x2ae0, 0x2ae0, // 46728
-    0x2adf, 0x2ade, 0x2add, 0x2add, 0x2adc, 0x2adb, 0x2adb, 0x2ada, // 46736
-    0x2ad9, 0x2ad9, 0x2ad8, 0x2ad7, 0x2ad7, 0x2ad6, 0x2ad5, 0x2ad5, // 46744
-    0x2ad4, 0x2ad3, 0x2ad3, 0x2ad2, 0x2ad1, 0x2ad1, 0x2ad0, 0x2acf, // 46752
-    0x2ace, 0x2ace, 0x2acd, 0x2acc, 0x2acc, 0x2acb, 0x2aca, 0x2aca, // 46760
-    0x2ac9, 0x2ac8, 0x2ac8, 0x2ac7, 0x2ac6, 0x2ac6, 0x2ac5, 0x2ac4, // 46768
-    0x2ac4, 0x2ac3, 0x2ac2, 0x2ac2, 0x2ac1, 0x2ac0, 0x2abf, 0x2abf, // 46776
-    0x2abe, 0x2abd, 0x2abd, 0x2abc, 0x2abb, 0x2abb, 0x2aba, 0x2ab9, // 46784
-    0x2ab9, 0x2ab8, 0x2ab7, 0x2ab7, 0x2ab6, 0x2ab5, 0x2ab5, 0x2ab4, // 46792
-    0x2ab3, 0x2ab3, 0x2ab2, 0x2ab1, 0x2ab0, 0x2ab0, 0x2aaf, 0x2aae, // 46800
-    0x2aae, 0x2aad, 0x2aac, 0x2aac, 0x2aab, 0x2aaa, 0x2aaa, 0x2aa9, // 46808
-    0x2aa8, 0x2aa8, 0x2aa7, 0x2aa6, 0x2aa6, 0x2aa5, 0x2aa4, 0x2aa4, // 46816
-    0x2aa3, 0x2aa2, 0x2aa1, 0x2aa1, 0x2aa0, 0x2a9f, 0x2a9f, 0x2a9e, // 46824
-    0x2a9d, 0x2a9d, 0x2a9c, 0x2a9b, 0x2a9b, 0x2a9a, 0x2a99, 0x2a99, // 46832
-    0x2a98, 0x2a97, 0x2a97, 0x2a96, 0x2a95, 0x2a95, 0x2a94, 0x2a93, // 46840
-    0x2a93, 0x2a92, 0x2a91, 0x2a90, 0x2a90, 0x2a8f, 0x2a8e, 0x2a8e, // 46848
-    0x2a8d, 0x2a8c, 0x2a8c, 0x2a8b, 0x2a8a, 0x2a8a, 0x2a89, 0x2a88, // 46856
-    0x2a88, 0x2a87, 0x2a86, 0x2a86, 0x2a85, 0x2a84, 0x2a84, 0x2a83, // 46864
-    0x2a82, 0x2a81, 0x2a81, 0x2a80, 0x2a7f, 0x2a7f, 0x2a7e, 0x2a7d, // 46872
-    0x2a7d, 0x2a7c, 0x2a7b, 0x2a7b, 0x2a7a, 0x2a79, 0x2a79, 0x2a78, // 46880
-    0x2a77, 0x2a77, 0x2a76, 0x2a75, 0x2a75, 0x2a74, 0x2a73, 0x2a72, // 46888
-    0x2a72, 0x2a71, 0x2a70, 0x2a70, 0x2a6f, 0x2a6e, 0x2a6e, 0x2a6d, // 46896
-    0x2a6c, 0x2a6c, 0x2a6b, 0x2a6a, 0x2a6a, 0x2a69, 0x2a68, 0x2a68, // 46904
-    0x2a67, 0x2a66, 0x2a66, 0x2a65, 0x2a64, 0x2a63, 0x2a63, 0x2a62, // 46912
-    0x2a61, 0x2a61, 0x2a60, 0x2a5f, 0x2a5f, 0x2a5e, 0x2a5d, 0x2a5d, // 46920
-    0x2a5c, 0x2a5b, 0x2a5b, 0x2a5a, 0x2a59, 0x2a59, 0x2a58, 0x2a57, // 46928
-    0x2a57, 0x2a56, 0x2a55, 0x2a54, 0x2a54, 0x2a53, 0x2a52, 0x2a52, // 46936
-    0x2a51, 0x2a50, 0x2a50, 0x2a4f, 0x2a4e, 0x2a4e, 0x2a4d, 0x2a4c, // 46944
-    0x2a4c, 0x2a4b, 0x2a4a, 0x2a4a, 0x2a49, 0x2a48, 0x2a48, 0x2a47, // 46952
-    0x2a46, 0x2a45, 0x2a45, 0x2a44, 0x2a43, 0x2a43, 0x2a42, 0x2a41, // 46960
-    0x2a41, 0x2a40, 0x2a3f, 0x2a3f, 0x2a3e, 0x2a3d, 0x2a3d, 0x2a3c, // 46968
-    0x2a3b, 0x2a3b, 0x2a3a, 0x2a39, 0x2a39, 0x2a38, 0x2a37, 0x2a36, // 46976
-    0x2a36, 0x2a35, 0x2a34, 0x2a34, 0x2a33, 0x2a32, 0x2a32, 0x2a31, // 46984
-    0x2a30, 0x2a30, 0x2a2f, 0x2a2e, 0x2a2e, 0x2a2d, 0x2a2c, 0x2a2c, // 46992
-    0x2a2b, 0x2a2a, 0x2a2a, 0x2a29, 0x2a28, 0x2a27, 0x2a27, 0x2a26, // 47000
-    0x2a25, 0x2a25, 0x2a24, 0x2a23, 0x2a23, 0x2a22, 0x2a21, 0x2a21, // 47008
-    0x2a20, 0x2a1f, 0x2a1f, 0x2a1e, 0x2a1d, 0x2a1d, 0x2a1c, 0x2a1b, // 47016
-    0x2a1b, 0x2a1a, 0x2a19, 0x2a18, 0x2a18, 0x2a17, 0x2a16, 0x2a16, // 47024
-    0x2a15, 0x2a14, 0x2a14, 0x2a13, 0x2a12, 0x2a12, 0x2a11, 0x2a10, // 47032
-    0x2a10, 0x2a0f, 0x2a0e, 0x2a0e, 0x2a0d, 0x2a0c, 0x2a0c, 0x2a0b, // 47040
-    0x2a0a, 0x2a09, 0x2a09, 0x2a08, 0x2a07, 0x2a07, 0x2a06, 0x2a05, // 47048
-    0x2a05, 0x2a04, 0x2a03, 0x2a03, 0x2a02, 0x2a01, 0x2a01, 0x2a00, // 47056
-    0x29ff, 0x29ff, 0x29fe, 0x29fd, 0x29fd, 0x29fc, 0x29fb, 0x29fa, // 47064
-    0x29fa, 0x29f9, 0x29f8, 0x29f8, 0x29f7, 0x29f6, 0x29f6, 0x29f5, // 47072
-    0x29f4, 0x29f4, 0x29f3, 0x29f2, 0x29f2, 0x29f1, 0x29f0, 0x29f0, // 47080
-    0x29ef, 0x29ee, 0x29ee, 0x29ed, 0x29ec, 0x29eb, 0x29eb, 0x29ea, // 47088
-    0x29e9, 0x29e9, 0x29e8, 0x29e7, 0x29e7, 0x29e6, 0x29e5, 0x29e5, // 47096
-    0x29e3, 0x29e2, 0x29e1, 0x29e0, 0x29e0, 0x29df, 0x29de, 0x29de, // 47104
-    0x29dd, 0x29dc, 0x29dc, 0x29db, 0x29da, 0x29da, 0x29d9, 0x29d8, // 47112
-    0x29d8, 0x29d7, 0x29d6, 0x29d6, 0x29d5, 0x29d4, 0x29d4, 0x29d3, // 47120
-    0x29d2, 0x29d2, 0x29d1, 0x29d0, 0x29d0, 0x29cf, 0x29ce, 0x29ce, // 47128
-    0x29cd, 0x29cc, 0x29cc, 0x29cb, 0x29ca, 0x29ca, 0x29c9, 0x29c8, // 47136
-    0x29c8, 0x29c7, 0x29c6, 0x29c6, 0x29c5, 0x29c4, 0x29c4, 0x29c3, // 47144
-    0x29c2, 0x29c2, 0x29c1, 0x29c0, 0x29c0, 0x29bf, 0x29be, 0x29be, // 47152
-    0x29bd, 0x29bc, 0x29bc, 0x29bb, 0x29ba, 0x29ba, 0x29b9, 0x29b8, // 47160
-    0x29b8, 0x29b7, 0x29b6, 0x29b6, 0x29b5, 0x29b4, 0x29b4, 0x29b3, // 47168
-    0x29b2, 0x29b2, 0x29b1, 0x29b0, 0x29b0, 0x29af, 0x29ae, 0x29ae, // 47176
-    0x29ad, 0x29ac, 0x29ac, 0x29ab, 0x29aa, 0x29aa, 0x29a9, 0x29a8, // 47184
-    0x29a8, 0x29a7, 0x29a6, 0x29a6, 0x29a5, 0x29a4, 0x29a4, 0x29a3, // 47192
-    0x29a2, 0x29a2, 0x29a1, 0x29a0, 0x29a0, 0x299f, 0x299e, 0x299d, // 47200
-    0x299d, 0x299c, 0x299b, 0x299b, 0x299a, 0x2999, 0x2999, 0x2998, // 47208
-    0x2997, 0x2997, 0x2996, 0x2995, 0x2995, 0x2994, 0x2993, 0x2993, // 47216
-    0x2992, 0x2991, 0x2991, 0x2990, 0x298f, 0x298f, 0x298e, 0x298d, // 47224
-    0x298d, 0x298c, 0x298b, 0x298b, 0x298a, 0x2989, 0x2989, 0x2988, // 47232
-    0x2987, 0x2987, 0x2986, 0x2985, 0x2985, 0x2984, 0x2983, 0x2983, // 47240
-    0x2982, 0x2981, 0x2981, 0x2980, 0x297f, 0x297f, 0x297e, 0x297d, // 47248
-    0x297d, 0x297c, 0x297b, 0x297b, 0x297a, 0x2979, 0x2979, 0x2978, // 47256
-    0x2977, 0x2977, 0x2976, 0x2975, 0x2975, 0x2974, 0x2973, 0x2973, // 47264
-    0x2972, 0x2971, 0x2971, 0x2970, 0x296f, 0x296f, 0x296e, 0x296d, // 47272
-    0x296d, 0x296c, 0x296b, 0x296b, 0x296a, 0x2969, 0x2969, 0x2968, // 47280
-    0x2967, 0x2967, 0x2966, 0x2965, 0x2965, 0x2964, 0x2963, 0x2963, // 47288
-    0x2962, 0x2961, 0x2961, 0x2960, 0x295f, 0x295f, 0x295e, 0x295d, // 47296
-    0x295d, 0x295c, 0x295b, 0x295b, 0x295a, 0x2959, 0x2958, 0x2958, // 47304
-    0x2957, 0x2956, 0x2956, 0x2955, 0x2954, 0x2954, 0x2953, 0x2952, // 47312
-    0x2952, 0x2951, 0x2950, 0x2950, 0x294f, 0x294e, 0x294e, 0x294d, // 47320
-    0x294c, 0x294c, 0x294b, 0x294a, 0x294a, 0x2949, 0x2948, 0x2948, // 47328
-    0x2947, 0x2946, 0x2946, 0x2945, 0x2944, 0x2944, 0x2943, 0x2942, // 47336
-    0x2942, 0x2941, 0x2940, 0x2940, 0x293f, 0x293e, 0x293e, 0x293d, // 47344
-    0x293c, 0x293c, 0x293b, 0x293a, 0x293a, 0x2939, 0x2938, 0x2938, // 47352
-    0x2937, 0x2936, 0x2936, 0x2935, 0x2934, 0x2934, 0x2933, 0x2932, // 47360
-    0x2932, 0x2931, 0x2930, 0x2930, 0x292f, 0x292e, 0x292e, 0x292d, // 47368
-    0x292c, 0x292c, 0x292b, 0x292a, 0x292a, 0x2929, 0x2928, 0x2928, // 47376
-    0x2927, 0x2926, 0x2926, 0x2925, 0x2924, 0x2924, 0x2923, 0x2922, // 47384
-    0x2922, 0x2921, 0x2920, 0x2920, 0x291f, 0x291e, 0x291e, 0x291d, // 47392
-    0x291c, 0x291c, 0x291b, 0x291a, 0x291a, 0x2919, 0x2918, 0x2918, // 47400
-    0x2917, 0x2916, 0x2916, 0x2915, 0x2914, 0x2913, 0x2913, 0x2912, // 47408
-    0x2911, 0x2911, 0x2910, 0x290f, 0x290f, 0x290e, 0x290d, 0x290d, // 47416
-    0x290c, 0x290b, 0x290b, 0x290a, 0x2909, 0x2909, 0x2908, 0x2907, // 47424
-    0x2907, 0x2906, 0x2905, 0x2905, 0x2904, 0x2903, 0x2903, 0x2902, // 47432
-    0x2901, 0x2901, 0x2900, 0x28ff, 0x28ff, 0x28fe, 0x28fd, 0x28fd, // 47440
-    0x28fc, 0x28fb, 0x28fb, 0x28fa, 0x28f9, 0x28f9, 0x28f8, 0x28f7, // 47448
-    0x28f7, 0x28f6, 0x28f5, 0x28f5, 0x28f4, 0x28f3, 0x28f3, 0x28f2, // 47456
-    0x28f1, 0x28f1, 0x28f0, 0x28ef, 0x28ef, 0x28ee, 0x28ed, 0x28ed, // 47464
-    0x28ec, 0x28eb, 0x28eb, 0x28ea, 0x28e9, 0x28e9, 0x28e8, 0x28e7, // 47472
-    0x28e7, 0x28e6, 0x28e5, 0x28e5, 0x28e4, 0x28e3, 0x28e3, 0x28e2, // 47480
-    0x28e1, 0x28e1, 0x28e0, 0x28df, 0x28df, 0x28de, 0x28dd, 0x28dd, // 47488
-    0x28dc, 0x28db, 0x28db, 0x28da, 0x28d9, 0x28d9, 0x28d8, 0x28d7, // 47496
-    0x28d7, 0x28d6, 0x28d5, 0x28d5, 0x28d4, 0x28d3, 0x28d3, 0x28d2, // 47504
-    0x28d1, 0x28d1, 0x28d0, 0x28cf, 0x28ce, 0x28ce, 0x28cd, 0x28cc, // 47512
-    0x28cc, 0x28cb, 0x28ca, 0x28ca, 0x28c9, 0x28c8, 0x28c8, 0x28c7, // 47520
-    0x28c6, 0x28c6, 0x28c5, 0x28c4, 0x28c4, 0x28c3, 0x28c2, 0x28c2, // 47528
-    0x28c1, 0x28c0, 0x28c0, 0x28bf, 0x28be, 0x28be, 0x28bd, 0x28bc, // 47536
-    0x28bc, 0x28bb, 0x28ba, 0x28ba, 0x28b9, 0x28b8, 0x28b8, 0x28b7, // 47544
-    0x28b6, 0x28b6, 0x28b5, 0x28b4, 0x28b4, 0x28b3, 0x28b2, 0x28b2, // 47552
-    0x28b1, 0x28b0, 0x28b0, 0x28af, 0x28ae, 0x28ae, 0x28ad, 0x28ac, // 47560
-    0x28ac, 0x28ab, 0x28aa, 0x28aa, 0x28a9, 0x28a8, 0x28a8, 0x28a7, // 47568
-    0x28a6, 0x28a6, 0x28a5, 0x28a4, 0x28a4, 0x28a3, 0x28a2, 0x28a2, // 47576
-    0x28a1, 0x28a0, 0x28a0, 0x289f, 0x289e, 0x289e, 0x289d, 0x289c, // 47584
-    0x289c, 0x289b, 0x289a, 0x289a, 0x2899, 0x2898, 0x2898, 0x2897, // 47592
-    0x2896, 0x2896, 0x2895, 0x2894, 0x2894, 0x2893, 0x2892, 0x2892, // 47600
-    0x2891, 0x2890, 0x2890, 0x288f, 0x288e, 0x288e, 0x288d, 0x288c, // 47608
-    0x288c, 0x288b, 0x288a, 0x2889, 0x2889, 0x2888, 0x2887, 0x2887, // 47616
-    0x2886, 0x2885, 0x2885, 0x2884, 0x2883, 0x2883, 0x2882, 0x2881, // 47624
-    0x2881, 0x2880, 0x287f, 0x287f, 0x287e, 0x287d, 0x287d, 0x287c, // 47632
-    0x287b, 0x287b, 0x287a, 0x2879, 0x2879, 0x2878, 0x2877, 0x2877, // 47640
-    0x2876, 0x2875, 0x2875, 0x2874, 0x2873, 0x2873, 0x2872, 0x2871, // 47648
-    0x2871, 0x2870, 0x286f, 0x286f, 0x286e, 0x286d, 0x286d, 0x286c, // 47656
-    0x286b, 0x286b, 0x286a, 0x2869, 0x2869, 0x2868, 0x2867, 0x2867, // 47664
-    0x2866, 0x2865, 0x2865, 0x2864, 0x2863, 0x2863, 0x2862, 0x2861, // 47672
-    0x2861, 0x2860, 0x285f, 0x285f, 0x285e, 0x285d, 0x285d, 0x285c, // 47680
-    0x285b, 0x285b, 0x285a, 0x2859, 0x2859, 0x2858, 0x2857, 0x2857, // 47688
-    0x2856, 0x2855, 0x2855, 0x2854, 0x2853, 0x2853, 0x2852, 0x2851, // 47696
-    0x2851, 0x2850, 0x284f, 0x284f, 0x284e, 0x284d, 0x284d, 0x284c, // 47704
-    0x284b, 0x284b, 0x284a, 0x2849, 0x2849, 0x2848, 0x2847, 0x2846, // 47712
-    0x2846, 0x2845, 0x2844, 0x2844, 0x2843, 0x2842, 0x2842, 0x2841, // 47720
-    0x2840, 0x2840, 0x283f, 0x283e, 0x283e, 0x283d, 0x283c, 0x283c, // 47728
-    0x283b, 0x283a, 0x283a, 0x2839, 0x2838, 0x2838, 0x2837, 0x2836, // 47736
-    0x2836, 0x2835, 0x2834, 0x2834, 0x2833, 0x2832, 0x2832, 0x2831, // 47744
-    0x2830, 0x2830, 0x282f, 0x282e, 0x282e, 0x282d, 0x282c, 0x282c, // 47752
-    0x282b, 0x282a, 0x282a, 0x2829, 0x2828, 0x2828, 0x2827, 0x2826, // 47760
-    0x2826, 0x2825, 0x2824, 0x2824, 0x2823, 0x2822, 0x2822, 0x2821, // 47768
-    0x2820, 0x2820, 0x281f, 0x281e, 0x281e, 0x281d, 0x281c, 0x281c, // 47776
-    0x281b, 0x281a, 0x281a, 0x2819, 0x2818, 0x2818, 0x2817, 0x2816, // 47784
-    0x2816, 0x2815, 0x2814, 0x2814, 0x2813, 0x2812, 0x2812, 0x2811, // 47792
-    0x2810, 0x2810, 0x280f, 0x280e, 0x280e, 0x280d, 0x280c, 0x280c, // 47800
-    0x280b, 0x280a, 0x280a, 0x2809, 0x2808, 0x2808, 0x2807, 0x2806, // 47808
-    0x2806, 0x2805, 0x2804, 0x2804, 0x2803, 0x2802, 0x2801, 0x2801, // 47816
-    0x2800, 0x27ff, 0x27ff, 0x27fe, 0x27fd, 0x27fd, 0x27fc, 0x27fb, // 47824
-    0x27fb, 0x27fa, 0x27f9, 0x27f9, 0x27f8, 0x27f7, 0x27f7, 0x27f6, // 47832
-    0x27f5, 0x27f5, 0x27f4, 0x27f3, 0x27f3, 0x27f2, 0x27f1, 0x27f1, // 47840
-    0x27f0, 0x27ef, 0x27ef, 0x27ee, 0x27ed, 0x27ed, 0x27ec, 0x27eb, // 47848
-    0x27eb, 0x27ea, 0x27e9, 0x27e9, 0x27e8, 0x27e7, 0x27e7, 0x27e6, // 47856
-    0x27e5, 0x27e5, 0x27e4, 0x27e3, 0x27e3, 0x27e2, 0x27e1, 0x27e1, // 47864
-    0x27e0, 0x27df, 0x27df, 0x27de, 0x27dd, 0x27dd, 0x27dc, 0x27db, // 47872
-    0x27db, 0x27da, 0x27d9, 0x27d9, 0x27d8, 0x27d7, 0x27d7, 0x27d6, // 47880
-    0x27d5, 0x27d5, 0x27d4, 0x27d3, 0x27d3, 0x27d2, 0x27d1, 0x27d1, // 47888
-    0x27d0, 0x27cf, 0x27cf, 0x27ce, 0x27cd, 0x27cd, 0x27cc, 0x27cb, // 47896
-    0x27cb, 0x27ca, 0x27c9, 0x27c9, 0x27c8, 0x27c7, 0x27c7, 0x27c6, // 47904
-    0x27c5, 0x27c5, 0x27c4, 0x27c3, 0x27c3, 0x27c2, 0x27c1, 0x27c1, // 47912
-    0x27c0, 0x27bf, 0x27bf, 0x27be, 0x27bd, 0x27bc, 0x27bc, 0x27bb, // 47920
-    0x27ba, 0x27ba, 0x27b9, 0x27b8, 0x27b8, 0x27b7, 0x27b6, 0x27b6, // 47928
-    0x27b5, 0x27b4, 0x27b4, 0x27b3, 0x27b2, 0x27b2, 0x27b1, 0x27b0, // 47936
-    0x27b0, 0x27af, 0x27ae, 0x27ae, 0x27ad, 0x27ac, 0x27ac, 0x27ab, // 47944
-    0x27aa, 0x27aa, 0x27a9, 0x27a8, 0x27a8, 0x27a7, 0x27a6, 0x27a6, // 47952
-    0x27a5, 0x27a4, 0x27a4, 0x27a3, 0x27a2, 0x27a2, 0x27a1, 0x27a0, // 47960
-    0x27a0, 0x279f, 0x279e, 0x279e, 0x279d, 0x279c, 0x279c, 0x279b, // 47968
-    0x279a, 0x279a, 0x2799, 0x2798, 0x2798, 0x2797, 0x2796, 0x2796, // 47976
-    0x2795, 0x2794, 0x2794, 0x2793, 0x2792, 0x2792, 0x2791, 0x2790, // 47984
-    0x2790, 0x278f, 0x278e, 0x278e, 0x278d, 0x278c, 0x278c, 0x278b, // 47992
-    0x278a, 0x278a, 0x2789, 0x2788, 0x2788, 0x2787, 0x2786, 0x2786, // 48000
-    0x2785, 0x2784, 0x2784, 0x2783, 0x2782, 0x2782, 0x2781, 0x2780, // 48008
-    0x2780, 0x277f, 0x277e, 0x277e, 0x277d, 0x277c, 0x277c, 0x277b, // 48016
-    0x277a, 0x277a, 0x2779, 0x2778, 0x2777, 0x2777, 0x2776, 0x2775, // 48024
-    0x2775, 0x2774, 0x2773, 0x2773, 0x2772, 0x2771, 0x2771, 0x2770, // 48032
-    0x276f, 0x276f, 0x276e, 0x276d, 0x276d, 0x276c, 0x276b, 0x276b, // 48040
-    0x276a, 0x2769, 0x2769, 0x2768, 0x2767, 0x2767, 0x2766, 0x2765, // 48048
-    0x2765, 0x2764, 0x2763, 0x2763, 0x2762, 0x2761, 0x2761, 0x2760, // 48056
-    0x275f, 0x275f, 0x275e, 0x275d, 0x275d, 0x275c, 0x275b, 0x275b, // 48064
-    0x275a, 0x2759, 0x2759, 0x2758, 0x2757, 0x2757, 0x2756, 0x2755, // 48072
-    0x2755, 0x2754, 0x2753, 0x2753, 0x2752, 0x2751, 0x2751, 0x2750, // 48080
-    0x274f, 0x274f, 0x274e, 0x274d, 0x274d, 0x274c, 0x274b, 0x274b, // 48088
-    0x274a, 0x2749, 0x2749, 0x2748, 0x2747, 0x2747, 0x2746, 0x2745, // 48096
-    0x2745, 0x2744, 0x2743, 0x2743, 0x2742, 0x2741, 0x2741, 0x2740, // 48104
-    0x273f, 0x273f, 0x273e, 0x273d, 0x273d, 0x273c, 0x273b, 0x273b, // 48112
-    0x273a, 0x2739, 0x2739, 0x2738, 0x2737, 0x2737, 0x2736, 0x2735, // 48120
-    0x2734, 0x2733, 0x2732, 0x2732, 0x2731, 0x2730, 0x2730, 0x272f, // 48128
-    0x272e, 0x272e, 0x272d, 0x272c, 0x272c, 0x272b, 0x272a, 0x272a, // 48136
-    0x2729, 0x2728, 0x2728, 0x2727, 0x2726, 0x2726, 0x2725, 0x2724, // 48144
-    0x2724, 0x2723, 0x2722, 0x2722, 0x2721, 0x2720, 0x2720, 0x271f, // 48152
-    0x271e, 0x271e, 0x271d, 0x271c, 0x271c, 0x271b, 0x271a, 0x271a, // 48160
-    0x2719, 0x2719, 0x2718, 0x2717, 0x2717, 0x2716, 0x2715, 0x2715, // 48168
-    0x2714, 0x2713, 0x2713, 0x2712, 0x2711, 0x2711, 0x2710, 0x270f, // 48176
-    0x270f, 0x270e, 0x270d, 0x270d, 0x270c, 0x270b, 0x270b, 0x270a, // 48184
-    0x2709, 0x2709, 0x2708, 0x2707, 0x2707, 0x2706, 0x2705, 0x2705, // 48192
-    0x2704, 0x2703, 0x2703, 0x2702, 0x2701, 0x2701, 0x2700, 0x2700, // 48200
-    0x26ff, 0x26fe, 0x26fe, 0x26fd, 0x26fc, 0x26fc, 0x26fb, 0x26fa, // 48208
-    0x26fa, 0x26f9, 0x26f8, 0x26f8, 0x26f7, 0x26f6, 0x26f6, 0x26f5, // 48216
-    0x26f4, 0x26f4, 0x26f3, 0x26f2, 0x26f2, 0x26f1, 0x26f0, 0x26f0, // 48224
-    0x26ef, 0x26ee, 0x26ee, 0x26ed, 0x26ec, 0x26ec, 0x26eb, 0x26ea, // 48232
-    0x26ea, 0x26e9, 0x26e8, 0x26e8, 0x26e7, 0x26e6, 0x26e6, 0x26e5, // 48240
-    0x26e5, 0x26e4, 0x26e3, 0x26e3, 0x26e2, 0x26e1, 0x26e1, 0x26e0, // 48248
-    0x26df, 0x26df, 0x26de, 0x26dd, 0x26dd, 0x26dc, 0x26db, 0x26db, // 48256
-    0x26da, 0x26d9, 0x26d9, 0x26d8, 0x26d7, 0x26d7, 0x26d6, 0x26d5, // 48264
-    0x26d5, 0x26d4, 0x26d3, 0x26d3, 0x26d2, 0x26d1, 0x26d1, 0x26d0, // 48272
-    0x26cf, 0x26cf, 0x26ce, 0x26cd, 0x26cd, 0x26cc, 0x26cc, 0x26cb, // 48280
-    0x26ca, 0x26ca, 0x26c9, 0x26c8, 0x26c8, 0x26c7, 0x26c6, 0x26c6, // 48288
-    0x26c5, 0x26c4, 0x26c4, 0x26c3, 0x26c2, 0x26c2, 0x26c1, 0x26c0, // 48296
-    0x26c0, 0x26bf, 0x26be, 0x26be, 0x26bd, 0x26bc, 0x26bc, 0x26bb, // 48304
-    0x26ba, 0x26ba, 0x26b9, 0x26b8, 0x26b8, 0x26b7, 0x26b6, 0x26b6, // 48312
-    0x26b5, 0x26b4, 0x26b4, 0x26b3, 0x26b2, 0x26b2, 0x26b1, 0x26b1, // 48320
-    0x26b0, 0x26af, 0x26af, 0x26ae, 0x26ad, 0x26ad, 0x26ac, 0x26ab, // 48328
-    0x26ab, 0x26aa, 0x26a9, 0x26a9, 0x26a8, 0x26a7, 0x26a7, 0x26a6, // 48336
-    0x26a5, 0x26a5, 0x26a4, 0x26a3, 0x26a3, 0x26a2, 0x26a1, 0x26a1, // 48344
-    0x26a0, 0x269f, 0x269f, 0x269e, 0x269d, 0x269d, 0x269c, 0x269b, // 48352
-    0x269b, 0x269a, 0x2699, 0x2699, 0x2698, 0x2698, 0x2697, 0x2696, // 48360
-    0x2696, 0x2695, 0x2694, 0x2694, 0x2693, 0x2692, 0x2692, 0x2691, // 48368
-    0x2690, 0x2690, 0x268f, 0x268e, 0x268e, 0x268d, 0x268c, 0x268c, // 48376
-    0x268b, 0x268a, 0x268a, 0x2689, 0x2688, 0x2688, 0x2687, 0x2686, // 48384
-    0x2686, 0x2685, 0x2684, 0x2684, 0x2683, 0x2682, 0x2682, 0x2681, // 48392
-    0x2680, 0x2680, 0x267f, 0x267e, 0x267e, 0x267d, 0x267d, 0x267c, // 48400
-    0x267b, 0x267b, 0x267a, 0x2679, 0x2679, 0x2678, 0x2677, 0x2677, // 48408
-    0x2676, 0x2675, 0x2675, 0x2674, 0x2673, 0x2673, 0x2672, 0x2671, // 48416
-    0x2671, 0x2670, 0x266f, 0x266f, 0x266e, 0x266d, 0x266d, 0x266c, // 48424
-    0x266b, 0x266b, 0x266a, 0x2669, 0x2669, 0x2668, 0x2667, 0x2667, // 48432
-    0x2666, 0x2665, 0x2665, 0x2664, 0x2664, 0x2663, 0x2662, 0x2662, // 48440
-    0x2661, 0x2660, 0x2660, 0x265f, 0x265e, 0x265e, 0x265d, 0x265c, // 48448
-    0x265c, 0x265b, 0x265a, 0x265a, 0x2659, 0x2658, 0x2658, 0x2657, // 48456
-    0x2656, 0x2656, 0x2655, 0x2654, 0x2654, 0x2653, 0x2652, 0x2652, // 48464
-    0x2651, 0x2650, 0x2650, 0x264f, 0x264e, 0x264e, 0x264d, 0x264c, // 48472
-    0x264c, 0x264b, 0x264a, 0x264a, 0x2649, 0x2649, 0x2648, 0x2647, // 48480
-    0x2647, 0x2646, 0x2645, 0x2645, 0x2644, 0x2643, 0x2643, 0x2642, // 48488
-    0x2641, 0x2641, 0x2640, 0x263f, 0x263f, 0x263e, 0x263d, 0x263d, // 48496
-    0x263c, 0x263b, 0x263b, 0x263a, 0x2639, 0x2639, 0x2638, 0x2637, // 48504
-    0x2637, 0x2636, 0x2635, 0x2635, 0x2634, 0x2633, 0x2633, 0x2632, // 48512
-    0x2631, 0x2631, 0x2630, 0x2630, 0x262f, 0x262e, 0x262e, 0x262d, // 48520
-    0x262c, 0x262c, 0x262b, 0x262a, 0x262a, 0x2629, 0x2628, 0x2628, // 48528
-    0x2627, 0x2626, 0x2626, 0x2625, 0x2624, 0x2624, 0x2623, 0x2622, // 48536
-    0x2622, 0x2621, 0x2620, 0x2620, 0x261f, 0x261e, 0x261e, 0x261d, // 48544
-    0x261c, 0x261c, 0x261b, 0x261a, 0x261a, 0x2619, 0x2618, 0x2618, // 48552
-    0x2617, 0x2616, 0x2616, 0x2615, 0x2615, 0x2614, 0x2613, 0x2613, // 48560
-    0x2612, 0x2611, 0x2611, 0x2610, 0x260f, 0x260f, 0x260e, 0x260d, // 48568
-    0x260d, 0x260c, 0x260b, 0x260b, 0x260a, 0x2609, 0x2609, 0x2608, // 48576
-    0x2607, 0x2607, 0x2606, 0x2605, 0x2605, 0x2604, 0x2603, 0x2603, // 48584
-    0x2602, 0x2601, 0x2601, 0x2600, 0x25ff, 0x25ff, 0x25fe, 0x25fd, // 48592
-    0x25fd, 0x25fc, 0x25fc, 0x25fb, 0x25fa, 0x25fa, 0x25f9, 0x25f8, // 48600
-    0x25f8, 0x25f7, 0x25f6, 0x25f6, 0x25f5, 0x25f4, 0x25f4, 0x25f3, // 48608
-    0x25f2, 0x25f2, 0x25f1, 0x25f0, 0x25f0, 0x25ef, 0x25ee, 0x25ee, // 48616
-    0x25ed, 0x25ec, 0x25ec, 0x25eb, 0x25ea, 0x25ea, 0x25e9, 0x25e8, // 48624
-    0x25e8, 0x25e7, 0x25e6, 0x25e6, 0x25e5, 0x25e4, 0x25e4, 0x25e3, // 48632
-    0x25e3, 0x25e2, 0x25e1, 0x25e1, 0x25e0, 0x25df, 0x25df, 0x25de, // 48640
-    0x25dd, 0x25dd, 0x25dc, 0x25db, 0x25db, 0x25da, 0x25d9, 0x25d9, // 48648
-    0x25d8, 0x25d7, 0x25d7, 0x25d6, 0x25d5, 0x25d5, 0x25d4, 0x25d3, // 48656
-    0x25d3, 0x25d2, 0x25d1, 0x25d1, 0x25d0, 0x25cf, 0x25cf, 0x25ce, // 48664
-    0x25cd, 0x25cd, 0x25cc, 0x25cb, 0x25cb, 0x25ca, 0x25c9, 0x25c9, // 48672
-    0x25c8, 0x25c8, 0x25c7, 0x25c6, 0x25c6, 0x25c5, 0x25c4, 0x25c4, // 48680
-    0x25c3, 0x25c2, 0x25c2, 0x25c1, 0x25c0, 0x25c0, 0x25bf, 0x25be, // 48688
-    0x25be, 0x25bd, 0x25bc, 0x25bc, 0x25bb, 0x25ba, 0x25ba, 0x25b9, // 48696
-    0x25b8, 0x25b8, 0x25b7, 0x25b6, 0x25b6, 0x25b5, 0x25b4, 0x25b4, // 48704
-    0x25b3, 0x25b2, 0x25b2, 0x25b1, 0x25b0, 0x25b0, 0x25af, 0x25af, // 48712
-    0x25ae, 0x25ad, 0x25ad, 0x25ac, 0x25ab, 0x25ab, 0x25aa, 0x25a9, // 48720
-    0x25a9, 0x25a8, 0x25a7, 0x25a7, 0x25a6, 0x25a5, 0x25a5, 0x25a4, // 48728
-    0x25a3, 0x25a3, 0x25a2, 0x25a1, 0x25a1, 0x25a0, 0x259f, 0x259f, // 48736
-    0x259e, 0x259d, 0x259d, 0x259c, 0x259b, 0x259b, 0x259a, 0x2599, // 48744
-    0x2599, 0x2598, 0x2597, 0x2597, 0x2596, 0x2595, 0x2595, 0x2594, // 48752
-    0x2594, 0x2593, 0x2592, 0x2592, 0x2591, 0x2590, 0x2590, 0x258f, // 48760
-    0x258e, 0x258e, 0x258d, 0x258c, 0x258c, 0x258b, 0x258a, 0x258a, // 48768
-    0x2589, 0x2588, 0x2588, 0x2587, 0x2586, 0x2586, 0x2585, 0x2584, // 48776
-    0x2584, 0x2583, 0x2582, 0x2582, 0x2581, 0x2580, 0x2580, 0x257f, // 48784
-    0x257e, 0x257e, 0x257d, 0x257c, 0x257c, 0x257b, 0x257b, 0x257a, // 48792
-    0x2579, 0x2579, 0x2578, 0x2577, 0x2577, 0x2576, 0x2575, 0x2575, // 48800
-    0x2574, 0x2573, 0x2573, 0x2572, 0x2571, 0x2571, 0x2570, 0x256f, // 48808
-    0x256f, 0x256e, 0x256d, 0x256d, 0x256c, 0x256b, 0x256b, 0x256a, // 48816
-    0x2569, 0x2569, 0x2568, 0x2567, 0x2567, 0x2566, 0x2565, 0x2565, // 48824
-    0x2564, 0x2563, 0x2563, 0x2562, 0x2561, 0x2561, 0x2560, 0x2560, // 48832
-    0x255f, 0x255e, 0x255e, 0x255d, 0x255c, 0x255c, 0x255b, 0x255a, // 48840
-    0x255a, 0x2559, 0x2558, 0x2558, 0x2557, 0x2556, 0x2556, 0x2555, // 48848
-    0x2554, 0x2554, 0x2553, 0x2552, 0x2552, 0x2551, 0x2550, 0x2550, // 48856
-    0x254f, 0x254e, 0x254e, 0x254d, 0x254c, 0x254c, 0x254b, 0x254a, // 48864
-    0x254a, 0x2549, 0x2548, 0x2548, 0x2547, 0x2547, 0x2546, 0x2545, // 48872
-    0x2545, 0x2544, 0x2543, 0x2543, 0x2542, 0x2541, 0x2541, 0x2540, // 48880
-    0x253f, 0x253f, 0x253e, 0x253d, 0x253d, 0x253c, 0x253b, 0x253b, // 48888
-    0x253a, 0x2539, 0x2539, 0x2538, 0x2537, 0x2537, 0x2536, 0x2535, // 48896
-    0x2535, 0x2534, 0x2533, 0x2533, 0x2532, 0x2531, 0x2531, 0x2530, // 48904
-    0x252f, 0x252f, 0x252e, 0x252d, 0x252d, 0x252c, 0x252c, 0x252b, // 48912
-    0x252a, 0x252a, 0x2529, 0x2528, 0x2528, 0x2527, 0x2526, 0x2526, // 48920
-    0x2525, 0x2524, 0x2524, 0x2523, 0x2522, 0x2522, 0x2521, 0x2520, // 48928
-    0x2520, 0x251f, 0x251e, 0x251e, 0x251d, 0x251c, 0x251c, 0x251b, // 48936
-    0x251a, 0x251a, 0x2519, 0x2518, 0x2518, 0x2517, 0x2516, 0x2516, // 48944
-    0x2515, 0x2514, 0x2514, 0x2513, 0x2513, 0x2512, 0x2511, 0x2511, // 48952
-    0x2510, 0x250f, 0x250f, 0x250e, 0x250d, 0x250d, 0x250c, 0x250b, // 48960
-    0x250b, 0x250a, 0x2509, 0x2509, 0x2508, 0x2507, 0x2507, 0x2506, // 48968
-    0x2505, 0x2505, 0x2504, 0x2503, 0x2503, 0x2502, 0x2501, 0x2501, // 48976
-    0x2500, 0x24ff, 0x24ff, 0x24fe, 0x24fd, 0x24fd, 0x24fc, 0x24fb, // 48984
-    0x24fb, 0x24fa, 0x24f9, 0x24f9, 0x24f8, 0x24f8, 0x24f7, 0x24f6, // 48992
-    0x24f6, 0x24f5, 0x24f4, 0x24f4, 0x24f3, 0x24f2, 0x24f2, 0x24f1, // 49000
-    0x24f0, 0x24f0, 0x24ef, 0x24ee, 0x24ee, 0x24ed, 0x24ec, 0x24ec, // 49008
-    0x24eb, 0x24ea, 0x24ea, 0x24e9, 0x24e8, 0x24e8, 0x24e7, 0x24e6, // 49016
-    0x24e6, 0x24e5, 0x24e4, 0x24e4, 0x24e3, 0x24e2, 0x24e2, 0x24e1, // 49024
-    0x24e0, 0x24e0, 0x24df, 0x24df, 0x24de, 0x24dd, 0x24dd, 0x24dc, // 49032
-    0x24db, 0x24db, 0x24da, 0x24d9, 0x24d9, 0x24d8, 0x24d7, 0x24d7, // 49040
-    0x24d6, 0x24d5, 0x24d5, 0x24d4, 0x24d3, 0x24d3, 0x24d2, 0x24d1, // 49048
-    0x24d1, 0x24d0, 0x24cf, 0x24cf, 0x24ce, 0x24cd, 0x24cd, 0x24cc, // 49056
-    0x24cb, 0x24cb, 0x24ca, 0x24c9, 0x24c9, 0x24c8, 0x24c7, 0x24c7, // 49064
-    0x24c6, 0x24c5, 0x24c5, 0x24c4, 0x24c4, 0x24c3, 0x24c2, 0x24c2, // 49072
-    0x24c1, 0x24c0, 0x24c0, 0x24bf, 0x24be, 0x24be, 0x24bd, 0x24bc, // 49080
-    0x24bc, 0x24bb, 0x24ba, 0x24ba, 0x24b9, 0x24b8, 0x24b8, 0x24b7, // 49088
-    0x24b6, 0x24b6, 0x24b5, 0x24b4, 0x24b4, 0x24b3, 0x24b2, 0x24b2, // 49096
-    0x24b1, 0x24b0, 0x24b0, 0x24af, 0x24ae, 0x24ae, 0x24ad, 0x24ac, // 49104
-    0x24ac, 0x24ab, 0x24ab, 0x24aa, 0x24a9, 0x24a9, 0x24a8, 0x24a7, // 49112
-    0x24a7, 0x24a6, 0x24a5, 0x24a5, 0x24a4, 0x24a3, 0x24a3, 0x24a2, // 49120
-    0x24a1, 0x24a1, 0x24a0, 0x249f, 0x249f, 0x249e, 0x249d, 0x249d, // 49128
-    0x249c, 0x249b, 0x249b, 0x249a, 0x2499, 0x2499, 0x2498, 0x2497, // 49136
-    0x2497, 0x2496, 0x2495, 0x2495, 0x2494, 0x2493, 0x2493, 0x2492, // 49144
-    0x2491, 0x2490, 0x2490, 0x248f, 0x248e, 0x248e, 0x248d, 0x248c, // 49152
-    0x248c, 0x248b, 0x248b, 0x248a, 0x2489, 0x2489, 0x2488, 0x2487, // 49160
-    0x2487, 0x2486, 0x2485, 0x2485, 0x2484, 0x2483, 0x2483, 0x2482, // 49168
-    0x2481, 0x2481, 0x2480, 0x2480, 0x247f, 0x247e, 0x247e, 0x247d, // 49176
-    0x247c, 0x247c, 0x247b, 0x247a, 0x247a, 0x2479, 0x2478, 0x2478, // 49184
-    0x2477, 0x2476, 0x2476, 0x2475, 0x2475, 0x2474, 0x2473, 0x2473, // 49192
-    0x2472, 0x2471, 0x2471, 0x2470, 0x246f, 0x246f, 0x246e, 0x246d, // 49200
-    0x246d, 0x246c, 0x246c, 0x246b, 0x246a, 0x246a, 0x2469, 0x2468, // 49208
-    0x2468, 0x2467, 0x2466, 0x2466, 0x2465, 0x2464, 0x2464, 0x2463, // 49216
-    0x2462, 0x2462, 0x2461, 0x2461, 0x2460, 0x245f, 0x245f, 0x245e, // 49224
-    0x245d, 0x245d, 0x245c, 0x245b, 0x245b, 0x245a, 0x2459, 0x2459, // 49232
-    0x2458, 0x2457, 0x2457, 0x2456, 0x2456, 0x2455, 0x2454, 0x2454, // 49240
-    0x2453, 0x2452, 0x2452, 0x2451, 0x2450, 0x2450, 0x244f, 0x244e, // 49248
-    0x244e, 0x244d, 0x244c, 0x244c, 0x244b, 0x244b, 0x244a, 0x2449, // 49256
-    0x2449, 0x2448, 0x2447, 0x2447, 0x2446, 0x2445, 0x2445, 0x2444, // 49264
-    0x2443, 0x2443, 0x2442, 0x2441, 0x2441, 0x2440, 0x2440, 0x243f, // 49272
-    0x243e, 0x243e, 0x243d, 0x243c, 0x243c, 0x243b, 0x243a, 0x243a, // 49280
-    0x2439, 0x2438, 0x2438, 0x2437, 0x2436, 0x2436, 0x2435, 0x2435, // 49288
-    0x2434, 0x2433, 0x2433, 0x2432, 0x2431, 0x2431, 0x2430, 0x242f, // 49296
-    0x242f, 0x242e, 0x242d, 0x242d, 0x242c, 0x242c, 0x242b, 0x242a, // 49304
-    0x242a, 0x2429, 0x2428, 0x2428, 0x2427, 0x2426, 0x2426, 0x2425, // 49312
-    0x2424, 0x2424, 0x2423, 0x2422, 0x2422, 0x2421, 0x2421, 0x2420, // 49320
-    0x241f, 0x241f, 0x241e, 0x241d, 0x241d, 0x241c, 0x241b, 0x241b, // 49328
-    0x241a, 0x2419, 0x2419, 0x2418, 0x2417, 0x2417, 0x2416, 0x2416, // 49336
-    0x2415, 0x2414, 0x2414, 0x2413, 0x2412, 0x2412, 0x2411, 0x2410, // 49344
-    0x2410, 0x240f, 0x240e, 0x240e, 0x240d, 0x240c, 0x240c, 0x240b, // 49352
-    0x240b, 0x240a, 0x2409, 0x2409, 0x2408, 0x2407, 0x2407, 0x2406, // 49360
-    0x2405, 0x2405, 0x2404, 0x2403, 0x2403, 0x2402, 0x2401, 0x2401, // 49368
-    0x2400, 0x2400, 0x23ff, 0x23fe, 0x23fe, 0x23fd, 0x23fc, 0x23fc, // 49376
-    0x23fb, 0x23fa, 0x23fa, 0x23f9, 0x23f8, 0x23f8, 0x23f7, 0x23f6, // 49384
-    0x23f6, 0x23f5, 0x23f5, 0x23f4, 0x23f3, 0x23f3, 0x23f2, 0x23f1, // 49392
-    0x23f1, 0x23f0, 0x23ef, 0x23ef, 0x23ee, 0x23ed, 0x23ed, 0x23ec, // 49400
-    0x23ec, 0x23eb, 0x23ea, 0x23ea, 0x23e9, 0x23e8, 0x23e8, 0x23e7, // 49408
-    0x23e6, 0x23e6, 0x23e5, 0x23e4, 0x23e4, 0x23e3, 0x23e2, 0x23e2, // 49416
-    0x23e1, 0x23e1, 0x23e0, 0x23df, 0x23df, 0x23de, 0x23dd, 0x23dd, // 49424
-    0x23dc, 0x23db, 0x23db, 0x23da, 0x23d9, 0x23d9, 0x23d8, 0x23d7, // 49432
-    0x23d7, 0x23d6, 0x23d6, 0x23d5, 0x23d4, 0x23d4, 0x23d3, 0x23d2, // 49440
-    0x23d2, 0x23d1, 0x23d0, 0x23d0, 0x23cf, 0x23ce, 0x23ce, 0x23cd, // 49448
-    0x23cc, 0x23cc, 0x23cb, 0x23cb, 0x23ca, 0x23c9, 0x23c9, 0x23c8, // 49456
-    0x23c7, 0x23c7, 0x23c6, 0x23c5, 0x23c5, 0x23c4, 0x23c3, 0x23c3, // 49464
-    0x23c2, 0x23c1, 0x23c1, 0x23c0, 0x23c0, 0x23bf, 0x23be, 0x23be, // 49472
-    0x23bd, 0x23bc, 0x23bc, 0x23bb, 0x23ba, 0x23ba, 0x23b9, 0x23b8, // 49480
-    0x23b8, 0x23b7, 0x23b6, 0x23b6, 0x23b5, 0x23b5, 0x23b4, 0x23b3, // 49488
-    0x23b3, 0x23b2, 0x23b1, 0x23b1, 0x23b0, 0x23af, 0x23af, 0x23ae, // 49496
-    0x23ad, 0x23ad, 0x23ac, 0x23ab, 0x23ab, 0x23aa, 0x23aa, 0x23a9, // 49504
-    0x23a8, 0x23a8, 0x23a7, 0x23a6, 0x23a6, 0x23a5, 0x23a4, 0x23a4, // 49512
-    0x23a3, 0x23a2, 0x23a2, 0x23a1, 0x23a1, 0x23a0, 0x239f, 0x239f, // 49520
-    0x239e, 0x239d, 0x239d, 0x239c, 0x239b, 0x239b, 0x239a, 0x2399, // 49528
-    0x2399, 0x2398, 0x2397, 0x2397, 0x2396, 0x2396, 0x2395, 0x2394, // 49536
-    0x2394, 0x2393, 0x2392, 0x2392, 0x2391, 0x2390, 0x2390, 0x238f, // 49544
-    0x238e, 0x238e, 0x238d, 0x238c, 0x238c, 0x238b, 0x238b, 0x238a, // 49552
-    0x2389, 0x2389, 0x2388, 0x2387, 0x2387, 0x2386, 0x2385, 0x2385, // 49560
-    0x2384, 0x2383, 0x2383, 0x2382, 0x2381, 0x2381, 0x2380, 0x2380, // 49568
-    0x237f, 0x237e, 0x237e, 0x237d, 0x237c, 0x237c, 0x237b, 0x237a, // 49576
-    0x237a, 0x2379, 0x2378, 0x2378, 0x2377, 0x2376, 0x2376, 0x2375, // 49584
-    0x2375, 0x2374, 0x2373, 0x2373, 0x2372, 0x2371, 0x2371, 0x2370, // 49592
-    0x236f, 0x236f, 0x236e, 0x236d, 0x236d, 0x236c, 0x236b, 0x236b, // 49600
-    0x236a, 0x236a, 0x2369, 0x2368, 0x2368, 0x2367, 0x2366, 0x2366, // 49608
-    0x2365, 0x2364, 0x2364, 0x2363, 0x2362, 0x2362, 0x2361, 0x2361, // 49616
-    0x2360, 0x235f, 0x235f, 0x235e, 0x235d, 0x235d, 0x235c, 0x235b, // 49624
-    0x235b, 0x235a, 0x2359, 0x2359, 0x2358, 0x2357, 0x2357, 0x2356, // 49632
-    0x2356, 0x2355, 0x2354, 0x2354, 0x2353, 0x2352, 0x2352, 0x2351, // 49640
-    0x2350, 0x2350, 0x234f, 0x234e, 0x234e, 0x234d, 0x234c, 0x234c, // 49648
-    0x234b, 0x234b, 0x234a, 0x2349, 0x2349, 0x2348, 0x2347, 0x2347, // 49656
-    0x2346, 0x2345, 0x2345, 0x2344, 0x2343, 0x2343, 0x2342, 0x2341, // 49664
-    0x2341, 0x2340, 0x2340, 0x233f, 0x233e, 0x233e, 0x233d, 0x233c, // 49672
-    0x233c, 0x233b, 0x233a, 0x233a, 0x2339, 0x2338, 0x2338, 0x2337, // 49680
-    0x2336, 0x2336, 0x2335, 0x2335, 0x2334, 0x2333, 0x2333, 0x2332, // 49688
-    0x2331, 0x2331, 0x2330, 0x232f, 0x232f, 0x232e, 0x232d, 0x232d, // 49696
-    0x232c, 0x232b, 0x232b, 0x232a, 0x232a, 0x2329, 0x2328, 0x2328, // 49704
-    0x2327, 0x2326, 0x2326, 0x2325, 0x2324, 0x2324, 0x2323, 0x2322, // 49712
-    0x2322, 0x2321, 0x2321, 0x2320, 0x231f, 0x231f, 0x231e, 0x231d, // 49720
-    0x231d, 0x231c, 0x231b, 0x231b, 0x231a, 0x2319, 0x2319, 0x2318, // 49728
-    0x2317, 0x2317, 0x2316, 0x2316, 0x2315, 0x2314, 0x2314, 0x2313, // 49736
-    0x2312, 0x2312, 0x2311, 0x2310, 0x2310, 0x230f, 0x230e, 0x230e, // 49744
-    0x230d, 0x230c, 0x230c, 0x230b, 0x230b, 0x230a, 0x2309, 0x2309, // 49752
-    0x2308, 0x2307, 0x2307, 0x2306, 0x2305, 0x2305, 0x2304, 0x2303, // 49760
-    0x2303, 0x2302, 0x2301, 0x2301, 0x2300, 0x2300, 0x22ff, 0x22fe, // 49768
-    0x22fe, 0x22fd, 0x22fc, 0x22fc, 0x22fb, 0x22fa, 0x22fa, 0x22f9, // 49776
-    0x22f8, 0x22f8, 0x22f7, 0x22f6, 0x22f6, 0x22f5, 0x22f5, 0x22f4, // 49784
-    0x22f3, 0x22f3, 0x22f2, 0x22f1, 0x22f1, 0x22f0, 0x22ef, 0x22ef, // 49792
-    0x22ee, 0x22ed, 0x22ed, 0x22ec, 0x22eb, 0x22eb, 0x22ea, 0x22ea, // 49800
-    0x22e9, 0x22e8, 0x22e8, 0x22e7, 0x22e6, 0x22e6, 0x22e5, 0x22e4, // 49808
-    0x22e4, 0x22e3, 0x22e2, 0x22e2, 0x22e1, 0x22e1, 0x22e0, 0x22df, // 49816
-    0x22df, 0x22de, 0x22dd, 0x22dd, 0x22dc, 0x22db, 0x22db, 0x22da, // 49824
-    0x22d9, 0x22d9, 0x22d8, 0x22d7, 0x22d7, 0x22d6, 0x22d6, 0x22d5, // 49832
-    0x22d4, 0x22d4, 0x22d3, 0x22d2, 0x22d2, 0x22d1, 0x22d0, 0x22d0, // 49840
-    0x22cf, 0x22ce, 0x22ce, 0x22cd, 0x22cc, 0x22cc, 0x22cb, 0x22cb, // 49848
-    0x22ca, 0x22c9, 0x22c9, 0x22c8, 0x22c7, 0x22c7, 0x22c6, 0x22c5, // 49856
-    0x22c5, 0x22c4, 0x22c3, 0x22c3, 0x22c2, 0x22c1, 0x22c1, 0x22c0, // 49864
-    0x22c0, 0x22bf, 0x22be, 0x22be, 0x22bd, 0x22bc, 0x22bc, 0x22bb, // 49872
-    0x22ba, 0x22ba, 0x22b9, 0x22b8, 0x22b8, 0x22b7, 0x22b6, 0x22b6, // 49880
-    0x22b5, 0x22b5, 0x22b4, 0x22b3, 0x22b3, 0x22b2, 0x22b1, 0x22b1, // 49888
-    0x22b0, 0x22af, 0x22af, 0x22ae, 0x22ad, 0x22ad, 0x22ac, 0x22ab, // 49896
-    0x22ab, 0x22aa, 0x22aa, 0x22a9, 0x22a8, 0x22a8, 0x22a7, 0x22a6, // 49904
-    0x22a6, 0x22a5, 0x22a4, 0x22a4, 0x22a3, 0x22a2, 0x22a2, 0x22a1, // 49912
-    0x22a1, 0x22a0, 0x229f, 0x229f, 0x229e, 0x229d, 0x229d, 0x229c, // 49920
-    0x229b, 0x229b, 0x229a, 0x2299, 0x2299, 0x2298, 0x2297, 0x2297, // 49928
-    0x2296, 0x2296, 0x2295, 0x2294, 0x2294, 0x2293, 0x2292, 0x2292, // 49936
-    0x2291, 0x2290, 0x2290, 0x228f, 0x228e, 0x228e, 0x228d, 0x228c, // 49944
-    0x228c, 0x228b, 0x228b, 0x228a, 0x2289, 0x2289, 0x2288, 0x2287, // 49952
-    0x2287, 0x2286, 0x2285, 0x2285, 0x2284, 0x2283, 0x2283, 0x2282, // 49960
-    0x2281, 0x2281, 0x2280, 0x2280, 0x227f, 0x227e, 0x227e, 0x227d, // 49968
-    0x227c, 0x227c, 0x227b, 0x227a, 0x227a, 0x2279, 0x2278, 0x2278, // 49976
-    0x2277, 0x2276, 0x2276, 0x2275, 0x2275, 0x2274, 0x2273, 0x2273, // 49984
-    0x2272, 0x2271, 0x2271, 0x2270, 0x226f, 0x226f, 0x226e, 0x226d, // 49992
-    0x226d, 0x226c, 0x226b, 0x226b, 0x226a, 0x226a, 0x2269, 0x2268, // 50000
-    0x2268, 0x2267, 0x2266, 0x2266, 0x2265, 0x2264, 0x2264, 0x2263, // 50008
-    0x2262, 0x2262, 0x2261, 0x2260, 0x2260, 0x225f, 0x225f, 0x225e, // 50016
-    0x225d, 0x225d, 0x225c, 0x225b, 0x225b, 0x225a, 0x2259, 0x2259, // 50024
-    0x2258, 0x2257, 0x2257, 0x2256, 0x2256, 0x2255, 0x2254, 0x2254, // 50032
-    0x2253, 0x2252, 0x2252, 0x2251, 0x2250, 0x2250, 0x224f, 0x224e, // 50040
-    0x224e, 0x224d, 0x224c, 0x224c, 0x224b, 0x224b, 0x224a, 0x2249, // 50048
-    0x2249, 0x2248, 0x2247, 0x2247, 0x2246, 0x2245, 0x2245, 0x2244, // 50056
-    0x2243, 0x2243, 0x2242, 0x2241, 0x2241, 0x2240, 0x2240, 0x223f, // 50064
-    0x223e, 0x223e, 0x223d, 0x223c, 0x223c, 0x223b, 0x223a, 0x223a, // 50072
-    0x2239, 0x2238, 0x2238, 0x2237, 0x2236, 0x2236, 0x2235, 0x2235, // 50080
-    0x2234, 0x2233, 0x2233, 0x2232, 0x2231, 0x2231, 0x2230, 0x222f, // 50088
-    0x222f, 0x222e, 0x222d, 0x222d, 0x222c, 0x222b, 0x222b, 0x222a, // 50096
-    0x222a, 0x2229, 0x2228, 0x2228, 0x2227, 0x2226, 0x2226, 0x2225, // 50104
-    0x2224, 0x2224, 0x2223, 0x2222, 0x2222, 0x2221, 0x2220, 0x2220, // 50112
-    0x221f, 0x221f, 0x221e, 0x221d, 0x221d, 0x221c, 0x221b, 0x221b, // 50120
-    0x221a, 0x2219, 0x2219, 0x2218, 0x2217, 0x2217, 0x2216, 0x2216, // 50128
-    0x2215, 0x2214, 0x2214, 0x2213, 0x2212, 0x2212, 0x2211, 0x2210, // 50136
-    0x2210, 0x220f, 0x220e, 0x220e, 0x220d, 0x220c, 0x220c, 0x220b, // 50144
-    0x220b, 0x220a, 0x2209, 0x2209, 0x2208, 0x2207, 0x2207, 0x2206, // 50152
-    0x2205, 0x2205, 0x2204, 0x2203, 0x2203, 0x2202, 0x2201, 0x2201, // 50160
-    0x2200, 0x2200, 0x21ff, 0x21fe, 0x21fe, 0x21fd, 0x21fc, 0x21fc, // 50168
-    0x21fa, 0x21f9, 0x21f9, 0x21f8, 0x21f7, 0x21f7, 0x21f6, 0x21f6, // 50176
-    0x21f5, 0x21f4, 0x21f4, 0x21f3, 0x21f2, 0x21f2, 0x21f1, 0x21f0, // 50184
-    0x21f0, 0x21ef, 0x21ef, 0x21ee, 0x21ed, 0x21ed, 0x21ec, 0x21eb, // 50192
-    0x21eb, 0x21ea, 0x21e9, 0x21e9, 0x21e8, 0x21e8, 0x21e7, 0x21e6, // 50200
-    0x21e6, 0x21e5, 0x21e4, 0x21e4, 0x21e3, 0x21e3, 0x21e2, 0x21e1, // 50208
-    0x21e1, 0x21e0, 0x21df, 0x21df, 0x21de, 0x21dd, 0x21dd, 0x21dc, // 50216
-    0x21dc, 0x21db, 0x21da, 0x21da, 0x21d9, 0x21d8, 0x21d8, 0x21d7, // 50224
-    0x21d6, 0x21d6, 0x21d5, 0x21d5, 0x21d4, 0x21d3, 0x21d3, 0x21d2, // 50232
-    0x21d1, 0x21d1, 0x21d0, 0x21cf, 0x21cf, 0x21ce, 0x21ce, 0x21cd, // 50240
-    0x21cc, 0x21cc, 0x21cb, 0x21ca, 0x21ca, 0x21c9, 0x21c8, 0x21c8, // 50248
-    0x21c7, 0x21c7, 0x21c6, 0x21c5, 0x21c5, 0x21c4, 0x21c3, 0x21c3, // 50256
-    0x21c2, 0x21c2, 0x21c1, 0x21c0, 0x21c0, 0x21bf, 0x21be, 0x21be, // 50264
-    0x21bd, 0x21bc, 0x21bc, 0x21bb, 0x21bb, 0x21ba, 0x21b9, 0x21b9, // 50272
-    0x21b8, 0x21b7, 0x21b7, 0x21b6, 0x21b5, 0x21b5, 0x21b4, 0x21b4, // 50280
-    0x21b3, 0x21b2, 0x21b2, 0x21b1, 0x21b0, 0x21b0, 0x21af, 0x21ae, // 50288
-    0x21ae, 0x21ad, 0x21ad, 0x21ac, 0x21ab, 0x21ab, 0x21aa, 0x21a9, // 50296
-    0x21a9, 0x21a8, 0x21a7, 0x21a7, 0x21a6, 0x21a6, 0x21a5, 0x21a4, // 50304
-    0x21a4, 0x21a3, 0x21a2, 0x21a2, 0x21a1, 0x21a0, 0x21a0, 0x219f, // 50312
-    0x219f, 0x219e, 0x219d, 0x219d, 0x219c, 0x219b, 0x219b, 0x219a, // 50320
-    0x219a, 0x2199, 0x2198, 0x2198, 0x2197, 0x2196, 0x2196, 0x2195, // 50328
-    0x2194, 0x2194, 0x2193, 0x2193, 0x2192, 0x2191, 0x2191, 0x2190, // 50336
-    0x218f, 0x218f, 0x218e, 0x218d, 0x218d, 0x218c, 0x218c, 0x218b, // 50344
-    0x218a, 0x218a, 0x2189, 0x2188, 0x2188, 0x2187, 0x2186, 0x2186, // 50352
-    0x2185, 0x2185, 0x2184, 0x2183, 0x2183, 0x2182, 0x2181, 0x2181, // 50360
-    0x2180, 0x217f, 0x217f, 0x217e, 0x217e, 0x217d, 0x217c, 0x217c, // 50368
-    0x217b, 0x217a, 0x217a, 0x2179, 0x2179, 0x2178, 0x2177, 0x2177, // 50376
-    0x2176, 0x2175, 0x2175, 0x2174, 0x2173, 0x2173, 0x2172, 0x2172, // 50384
-    0x2171, 0x2170, 0x2170, 0x216f, 0x216e, 0x216e, 0x216d, 0x216c, // 50392
-    0x216c, 0x216b, 0x216b, 0x216a, 0x2169, 0x2169, 0x2168, 0x2167, // 50400
-    0x2167, 0x2166, 0x2165, 0x2165, 0x2164, 0x2164, 0x2163, 0x2162, // 50408
-    0x2162, 0x2161, 0x2160, 0x2160, 0x215f, 0x215e, 0x215e, 0x215d, // 50416
-    0x215d, 0x215c, 0x215b, 0x215b, 0x215a, 0x2159, 0x2159, 0x2158, // 50424
-    0x2158, 0x2157, 0x2156, 0x2156, 0x2155, 0x2154, 0x2154, 0x2153, // 50432
-    0x2152, 0x2152, 0x2151, 0x2151, 0x2150, 0x214f, 0x214f, 0x214e, // 50440
-    0x214d, 0x214d, 0x214c, 0x214b, 0x214b, 0x214a, 0x214a, 0x2149, // 50448
-    0x2148, 0x2148, 0x2147, 0x2146, 0x2146, 0x2145, 0x2144, 0x2144, // 50456
-    0x2143, 0x2143, 0x2142, 0x2141, 0x2141, 0x2140, 0x213f, 0x213f, // 50464
-    0x213e, 0x213d, 0x213d, 0x213c, 0x213c, 0x213b, 0x213a, 0x213a, // 50472
-    0x2139, 0x2138, 0x2138, 0x2137, 0x2136, 0x2136, 0x2135, 0x2135, // 50480
-    0x2134, 0x2133, 0x2133, 0x2132, 0x2131, 0x2131, 0x2130, 0x2130, // 50488
-    0x212f, 0x212e, 0x212e, 0x212d, 0x212c, 0x212c, 0x212b, 0x212a, // 50496
-    0x212a, 0x2129, 0x2129, 0x2128, 0x2127, 0x2127, 0x2126, 0x2125, // 50504
-    0x2125, 0x2124, 0x2123, 0x2123, 0x2122, 0x2122, 0x2121, 0x2120, // 50512
-    0x2120, 0x211f, 0x211e, 0x211e, 0x211d, 0x211c, 0x211c, 0x211b, // 50520
-    0x211b, 0x211a, 0x2119, 0x2119, 0x2118, 0x2117, 0x2117, 0x2116, // 50528
-    0x2115, 0x2115, 0x2114, 0x2114, 0x2113, 0x2112, 0x2112, 0x2111, // 50536
-    0x2110, 0x2110, 0x210f, 0x210f, 0x210e, 0x210d, 0x210d, 0x210c, // 50544
-    0x210b, 0x210b, 0x210a, 0x2109, 0x2109, 0x2108, 0x2108, 0x2107, // 50552
-    0x2106, 0x2106, 0x2105, 0x2104, 0x2104, 0x2103, 0x2102, 0x2102, // 50560
-    0x2101, 0x2101, 0x2100, 0x20ff, 0x20ff, 0x20fe, 0x20fd, 0x20fd, // 50568
-    0x20fc, 0x20fb, 0x20fb, 0x20fa, 0x20fa, 0x20f9, 0x20f8, 0x20f8, // 50576
-    0x20f7, 0x20f6, 0x20f6, 0x20f5, 0x20f4, 0x20f4, 0x20f3, 0x20f3, // 50584
-    0x20f2, 0x20f1, 0x20f1, 0x20f0, 0x20ef, 0x20ef, 0x20ee, 0x20ed, // 50592
-    0x20ed, 0x20ec, 0x20ec, 0x20eb, 0x20ea, 0x20ea, 0x20e9, 0x20e8, // 50600
-    0x20e8, 0x20e7, 0x20e7, 0x20e6, 0x20e5, 0x20e5, 0x20e4, 0x20e3, // 50608
-    0x20e3, 0x20e2, 0x20e1, 0x20e1, 0x20e0, 0x20e0, 0x20df, 0x20de, // 50616
-    0x20de, 0x20dd, 0x20dc, 0x20dc, 0x20db, 0x20da, 0x20da, 0x20d9, // 50624
-    0x20d9, 0x20d8, 0x20d7, 0x20d7, 0x20d6, 0x20d5, 0x20d5, 0x20d4, // 50632
-    0x20d3, 0x20d3, 0x20d2, 0x20d2, 0x20d1, 0x20d0, 0x20d0, 0x20cf, // 50640
-    0x20ce, 0x20ce, 0x20cd, 0x20cc, 0x20cc, 0x20cb, 0x20cb, 0x20ca, // 50648
-    0x20c9, 0x20c9, 0x20c8, 0x20c7, 0x20c7, 0x20c6, 0x20c6, 0x20c5, // 50656
-    0x20c4, 0x20c4, 0x20c3, 0x20c2, 0x20c2, 0x20c1, 0x20c0, 0x20c0, // 50664
-    0x20bf, 0x20bf, 0x20be, 0x20bd, 0x20bd, 0x20bc, 0x20bb, 0x20bb, // 50672
-    0x20ba, 0x20b9, 0x20b9, 0x20b8, 0x20b8, 0x20b7, 0x20b6, 0x20b6, // 50680
-    0x20b5, 0x20b4, 0x20b4, 0x20b3, 0x20b2, 0x20b2, 0x20b1, 0x20b1, // 50688
-    0x20b0, 0x20af, 0x20af, 0x20ae, 0x20ad, 0x20ad, 0x20ac, 0x20ab, // 50696
-    0x20ab, 0x20aa, 0x20aa, 0x20a9, 0x20a8, 0x20a8, 0x20a7, 0x20a6, // 50704
-    0x20a6, 0x20a5, 0x20a4, 0x20a4, 0x20a3, 0x20a3, 0x20a2, 0x20a1, // 50712
-    0x20a1, 0x20a0, 0x209f, 0x209f, 0x209e, 0x209e, 0x209d, 0x209c, // 50720
-    0x209c, 0x209b, 0x209a, 0x209a, 0x2099, 0x2098, 0x2098, 0x2097, // 50728
-    0x2097, 0x2096, 0x2095, 0x2095, 0x2094, 0x2093, 0x2093, 0x2092, // 50736
-    0x2091, 0x2091, 0x2090, 0x2090, 0x208f, 0x208e, 0x208e, 0x208d, // 50744
-    0x208c, 0x208c, 0x208b, 0x208a, 0x208a, 0x2089, 0x2089, 0x2088, // 50752
-    0x2087, 0x2087, 0x2086, 0x2085, 0x2085, 0x2084, 0x2083, 0x2083, // 50760
-    0x2082, 0x2082, 0x2081, 0x2080, 0x2080, 0x207f, 0x207e, 0x207e, // 50768
-    0x207d, 0x207d, 0x207c, 0x207b, 0x207b, 0x207a, 0x2079, 0x2079, // 50776
-    0x2078, 0x2077, 0x2077, 0x2076, 0x2076, 0x2075, 0x2074, 0x2074, // 50784
-    0x2073, 0x2072, 0x2072, 0x2071, 0x2070, 0x2070, 0x206f, 0x206f, // 50792
-    0x206e, 0x206d, 0x206d, 0x206c, 0x206b, 0x206b, 0x206a, 0x2069, // 50800
-    0x2069, 0x2068, 0x2068, 0x2067, 0x2066, 0x2066, 0x2065, 0x2064, // 50808
-    0x2064, 0x2063, 0x2062, 0x2062, 0x2061, 0x2061, 0x2060, 0x205f, // 50816
-    0x205f, 0x205e, 0x205d, 0x205d, 0x205c, 0x205b, 0x205b, 0x205a, // 50824
-    0x205a, 0x2059, 0x2058, 0x2058, 0x2057, 0x2056, 0x2056, 0x2055, // 50832
-    0x2055, 0x2054, 0x2053, 0x2053, 0x2052, 0x2051, 0x2051, 0x2050, // 50840
-    0x204f, 0x204f, 0x204e, 0x204e, 0x204d, 0x204c, 0x204c, 0x204b, // 50848
-    0x204a, 0x204a, 0x2049, 0x2048, 0x2048, 0x2047, 0x2047, 0x2046, // 50856
-    0x2045, 0x2045, 0x2044, 0x2043, 0x2043, 0x2042, 0x2041, 0x2041, // 50864
-    0x2040, 0x2040, 0x203f, 0x203e, 0x203e, 0x203d, 0x203c, 0x203c, // 50872
-    0x203b, 0x203a, 0x203a, 0x2039, 0x2039, 0x2038, 0x2037, 0x2037, // 50880
-    0x2036, 0x2035, 0x2035, 0x2034, 0x2034, 0x2033, 0x2032, 0x2032, // 50888
-    0x2031, 0x2030, 0x2030, 0x202f, 0x202e, 0x202e, 0x202d, 0x202d, // 50896
-    0x202c, 0x202b, 0x202b, 0x202a, 0x2029, 0x2029, 0x2028, 0x2027, // 50904
-    0x2027, 0x2026, 0x2026, 0x2025, 0x2024, 0x2024, 0x2023, 0x2022, // 50912
-    0x2022, 0x2021, 0x2020, 0x2020, 0x201f, 0x201f, 0x201e, 0x201d, // 50920
-    0x201d, 0x201c, 0x201b, 0x201b, 0x201a, 0x2019, 0x2019, 0x2018, // 50928
-    0x2018, 0x2017, 0x2016, 0x2016, 0x2015, 0x2014, 0x2014, 0x2013, // 50936
-    0x2013, 0x2012, 0x2011, 0x2011, 0x2010, 0x200f, 0x200f, 0x200e, // 50944
-    0x200d, 0x200d, 0x200c, 0x200c, 0x200b, 0x200a, 0x200a, 0x2009, // 50952
-    0x2008, 0x2008, 0x2007, 0x2006, 0x2006, 0x2005, 0x2005, 0x2004, // 50960
-    0x2003, 0x2003, 0x2002, 0x2001, 0x2001, 0x2000, 0x1fff, 0x1fff, // 50968
-    0x1ffe, 0x1ffe, 0x1ffd, 0x1ffc, 0x1ffc, 0x1ffb, 0x1ffa, 0x1ffa, // 50976
-    0x1ff9, 0x1ff8, 0x1ff8, 0x1ff7, 0x1ff7, 0x1ff6, 0x1ff5, 0x1ff5, // 50984
-    0x1ff4, 0x1ff3, 0x1ff3, 0x1ff2, 0x1ff1, 0x1ff1, 0x1ff0, 0x1ff0, // 50992
-    0x1fef, 0x1fee, 0x1fee, 0x1fed, 0x1fec, 0x1fec, 0x1feb, 0x1feb, // 51000
-    0x1fea, 0x1fe9, 0x1fe9, 0x1fe8, 0x1fe7, 0x1fe7, 0x1fe6, 0x1fe5, // 51008
-    0x1fe5, 0x1fe4, 0x1fe4, 0x1fe3, 0x1fe2, 0x1fe2, 0x1fe1, 0x1fe0, // 51016
-    0x1fe0, 0x1fdf, 0x1fde, 0x1fde, 0x1fdd, 0x1fdd, 0x1fdc, 0x1fdb, // 51024
-    0x1fdb, 0x1fda, 0x1fd9, 0x1fd9, 0x1fd8, 0x1fd7, 0x1fd7, 0x1fd6, // 51032
-    0x1fd6, 0x1fd5, 0x1fd4, 0x1fd4, 0x1fd3, 0x1fd2, 0x1fd2, 0x1fd1, // 51040
-    0x1fd0, 0x1fd0, 0x1fcf, 0x1fcf, 0x1fce, 0x1fcd, 0x1fcd, 0x1fcc, // 51048
-    0x1fcb, 0x1fcb, 0x1fca, 0x1fca, 0x1fc9, 0x1fc8, 0x1fc8, 0x1fc7, // 51056
-    0x1fc6, 0x1fc6, 0x1fc5, 0x1fc4, 0x1fc4, 0x1fc3, 0x1fc3, 0x1fc2, // 51064
-    0x1fc1, 0x1fc1, 0x1fc0, 0x1fbf, 0x1fbf, 0x1fbe, 0x1fbd, 0x1fbd, // 51072
-    0x1fbc, 0x1fbc, 0x1fbb, 0x1fba, 0x1fba, 0x1fb9, 0x1fb8, 0x1fb8, // 51080
-    0x1fb7, 0x1fb6, 0x1fb6, 0x1fb5, 0x1fb5, 0x1fb4, 0x1fb3, 0x1fb3, // 51088
-    0x1fb2, 0x1fb1, 0x1fb1, 0x1fb0, 0x1faf, 0x1faf, 0x1fae, 0x1fae, // 51096
-    0x1fad, 0x1fac, 0x1fac, 0x1fab, 0x1faa, 0x1faa, 0x1fa9, 0x1fa8, // 51104
-    0x1fa8, 0x1fa7, 0x1fa7, 0x1fa6, 0x1fa5, 0x1fa5, 0x1fa4, 0x1fa3, // 51112
-    0x1fa3, 0x1fa2, 0x1fa2, 0x1fa1, 0x1fa0, 0x1fa0, 0x1f9f, 0x1f9e, // 51120
-    0x1f9e, 0x1f9d, 0x1f9c, 0x1f9c, 0x1f9b, 0x1f9b, 0x1f9a, 0x1f99, // 51128
-    0x1f99, 0x1f98, 0x1f97, 0x1f97, 0x1f96, 0x1f95, 0x1f95, 0x1f94, // 51136
-    0x1f94, 0x1f93, 0x1f92, 0x1f92, 0x1f91, 0x1f90, 0x1f90, 0x1f8f, // 51144
-    0x1f8e, 0x1f8e, 0x1f8d, 0x1f8d, 0x1f8c, 0x1f8b, 0x1f8b, 0x1f8a, // 51152
-    0x1f89, 0x1f89, 0x1f88, 0x1f87, 0x1f87, 0x1f86, 0x1f86, 0x1f85, // 51160
-    0x1f84, 0x1f84, 0x1f83, 0x1f82, 0x1f82, 0x1f81, 0x1f81, 0x1f80, // 51168
-    0x1f7f, 0x1f7f, 0x1f7e, 0x1f7d, 0x1f7d, 0x1f7c, 0x1f7b, 0x1f7b, // 51176
-    0x1f7a, 0x1f7a, 0x1f79, 0x1f78, 0x1f78, 0x1f77, 0x1f76, 0x1f76, // 51184
-    0x1f75, 0x1f74, 0x1f74, 0x1f73, 0x1f73, 0x1f72, 0x1f71, 0x1f71, // 51192
-    0x1f6f, 0x1f6e, 0x1f6d, 0x1f6d, 0x1f6c, 0x1f6b, 0x1f6b, 0x1f6a, // 51200
-    0x1f6a, 0x1f69, 0x1f68, 0x1f68, 0x1f67, 0x1f66, 0x1f66, 0x1f65, // 51208
-    0x1f65, 0x1f64, 0x1f63, 0x1f63, 0x1f62, 0x1f61, 0x1f61, 0x1f60, // 51216
-    0x1f60, 0x1f5f, 0x1f5e, 0x1f5e, 0x1f5d, 0x1f5c, 0x1f5c, 0x1f5b, // 51224
-    0x1f5b, 0x1f5a, 0x1f59, 0x1f59, 0x1f58, 0x1f57, 0x1f57, 0x1f56, // 51232
-    0x1f56, 0x1f55, 0x1f54, 0x1f54, 0x1f53, 0x1f52, 0x1f52, 0x1f51, // 51240
-    0x1f51, 0x1f50, 0x1f4f, 0x1f4f, 0x1f4e, 0x1f4d, 0x1f4d, 0x1f4c, // 51248
-    0x1f4c, 0x1f4b, 0x1f4a, 0x1f4a, 0x1f49, 0x1f48, 0x1f48, 0x1f47, // 51256
-    0x1f47, 0x1f46, 0x1f45, 0x1f45, 0x1f44, 0x1f44, 0x1f43, 0x1f42, // 51264
-    0x1f42, 0x1f41, 0x1f40, 0x1f40, 0x1f3f, 0x1f3f, 0x1f3e, 0x1f3d, // 51272
-    0x1f3d, 0x1f3c, 0x1f3b, 0x1f3b, 0x1f3a, 0x1f3a, 0x1f39, 0x1f38, // 51280
-    0x1f38, 0x1f37, 0x1f36, 0x1f36, 0x1f35, 0x1f35, 0x1f34, 0x1f33, // 51288
-    0x1f33, 0x1f32, 0x1f31, 0x1f31, 0x1f30, 0x1f30, 0x1f2f, 0x1f2e, // 51296
-    0x1f2e, 0x1f2d, 0x1f2c, 0x1f2c, 0x1f2b, 0x1f2b, 0x1f2a, 0x1f29, // 51304
-    0x1f29, 0x1f28, 0x1f27, 0x1f27, 0x1f26, 0x1f26, 0x1f25, 0x1f24, // 51312
-    0x1f24, 0x1f23, 0x1f22, 0x1f22, 0x1f21, 0x1f21, 0x1f20, 0x1f1f, // 51320
-    0x1f1f, 0x1f1e, 0x1f1e, 0x1f1d, 0x1f1c, 0x1f1c, 0x1f1b, 0x1f1a, // 51328
-    0x1f1a, 0x1f19, 0x1f19, 0x1f18, 0x1f17, 0x1f17, 0x1f16, 0x1f15, // 51336
-    0x1f15, 0x1f14, 0x1f14, 0x1f13, 0x1f12, 0x1f12, 0x1f11, 0x1f10, // 51344
-    0x1f10, 0x1f0f, 0x1f0f, 0x1f0e, 0x1f0d, 0x1f0d, 0x1f0c, 0x1f0b, // 51352
-    0x1f0b, 0x1f0a, 0x1f0a, 0x1f09, 0x1f08, 0x1f08, 0x1f07, 0x1f06, // 51360
-    0x1f06, 0x1f05, 0x1f05, 0x1f04, 0x1f03, 0x1f03, 0x1f02, 0x1f01, // 51368
-    0x1f01, 0x1f00, 0x1f00, 0x1eff, 0x1efe, 0x1efe, 0x1efd, 0x1efc, // 51376
-    0x1efc, 0x1efb, 0x1efb, 0x1efa, 0x1ef9, 0x1ef9, 0x1ef8, 0x1ef7, // 51384
-    0x1ef7, 0x1ef6, 0x1ef6, 0x1ef5, 0x1ef4, 0x1ef4, 0x1ef3, 0x1ef3, // 51392
-    0x1ef2, 0x1ef1, 0x1ef1, 0x1ef0, 0x1eef, 0x1eef, 0x1eee, 0x1eee, // 51400
-    0x1eed, 0x1eec, 0x1eec, 0x1eeb, 0x1eea, 0x1eea, 0x1ee9, 0x1ee9, // 51408
-    0x1ee8, 0x1ee7, 0x1ee7, 0x1ee6, 0x1ee5, 0x1ee5, 0x1ee4, 0x1ee4, // 51416
-    0x1ee3, 0x1ee2, 0x1ee2, 0x1ee1, 0x1ee0, 0x1ee0, 0x1edf, 0x1edf, // 51424
-    0x1ede, 0x1edd, 0x1edd, 0x1edc, 0x1edb, 0x1edb, 0x1eda, 0x1eda, // 51432
-    0x1ed9, 0x1ed8, 0x1ed8, 0x1ed7, 0x1ed6, 0x1ed6, 0x1ed5, 0x1ed5, // 51440
-    0x1ed4, 0x1ed3, 0x1ed3, 0x1ed2, 0x1ed1, 0x1ed1, 0x1ed0, 0x1ed0, // 51448
-    0x1ecf, 0x1ece, 0x1ece, 0x1ecd, 0x1ecd, 0x1ecc, 0x1ecb, 0x1ecb, // 51456
-    0x1eca, 0x1ec9, 0x1ec9, 0x1ec8, 0x1ec8, 0x1ec7, 0x1ec6, 0x1ec6, // 51464
-    0x1ec5, 0x1ec4, 0x1ec4, 0x1ec3, 0x1ec3, 0x1ec2, 0x1ec1, 0x1ec1, // 51472
-    0x1ec0, 0x1ebf, 0x1ebf, 0x1ebe, 0x1ebe, 0x1ebd, 0x1ebc, 0x1ebc, // 51480
-    0x1ebb, 0x1eba, 0x1eba, 0x1eb9, 0x1eb9, 0x1eb8, 0x1eb7, 0x1eb7, // 51488
-    0x1eb6, 0x1eb5, 0x1eb5, 0x1eb4, 0x1eb4, 0x1eb3, 0x1eb2, 0x1eb2, // 51496
-    0x1eb1, 0x1eb0, 0x1eb0, 0x1eaf, 0x1eaf, 0x1eae, 0x1ead, 0x1ead, // 51504
-    0x1eac, 0x1eab, 0x1eab, 0x1eaa, 0x1eaa, 0x1ea9, 0x1ea8, 0x1ea8, // 51512
-    0x1ea7, 0x1ea7, 0x1ea6, 0x1ea5, 0x1ea5, 0x1ea4, 0x1ea3, 0x1ea3, // 51520
-    0x1ea2, 0x1ea2, 0x1ea1, 0x1ea0, 0x1ea0, 0x1e9f, 0x1e9e, 0x1e9e, // 51528
-    0x1e9d, 0x1e9d, 0x1e9c, 0x1e9b, 0x1e9b, 0x1e9a, 0x1e99, 0x1e99, // 51536
-    0x1e98, 0x1e98, 0x1e97, 0x1e96, 0x1e96, 0x1e95, 0x1e94, 0x1e94, // 51544
-    0x1e93, 0x1e93, 0x1e92, 0x1e91, 0x1e91, 0x1e90, 0x1e8f, 0x1e8f, // 51552
-    0x1e8e, 0x1e8e, 0x1e8d, 0x1e8c, 0x1e8c, 0x1e8b, 0x1e8a, 0x1e8a, // 51560
-    0x1e89, 0x1e89, 0x1e88, 0x1e87, 0x1e87, 0x1e86, 0x1e85, 0x1e85, // 51568
-    0x1e84, 0x1e84, 0x1e83, 0x1e82, 0x1e82, 0x1e81, 0x1e80, 0x1e80, // 51576
-    0x1e7f, 0x1e7f, 0x1e7e, 0x1e7d, 0x1e7d, 0x1e7c, 0x1e7c, 0x1e7b, // 51584
-    0x1e7a, 0x1e7a, 0x1e79, 0x1e78, 0x1e78, 0x1e77, 0x1e77, 0x1e76, // 51592
-    0x1e75, 0x1e75, 0x1e74, 0x1e73, 0x1e73, 0x1e72, 0x1e72, 0x1e71, // 51600
-    0x1e70, 0x1e70, 0x1e6f, 0x1e6e, 0x1e6e, 0x1e6d, 0x1e6d, 0x1e6c, // 51608
-    0x1e6b, 0x1e6b, 0x1e6a, 0x1e69, 0x1e69, 0x1e68, 0x1e68, 0x1e67, // 51616
-    0x1e66, 0x1e66, 0x1e65, 0x1e64, 0x1e64, 0x1e63, 0x1e63, 0x1e62, // 51624
-    0x1e61, 0x1e61, 0x1e60, 0x1e5f, 0x1e5f, 0x1e5e, 0x1e5e, 0x1e5d, // 51632
-    0x1e5c, 0x1e5c, 0x1e5b, 0x1e5a, 0x1e5a, 0x1e59, 0x1e59, 0x1e58, // 51640
-    0x1e57, 0x1e57, 0x1e56, 0x1e56, 0x1e55, 0x1e54, 0x1e54, 0x1e53, // 51648
-    0x1e52, 0x1e52, 0x1e51, 0x1e51, 0x1e50, 0x1e4f, 0x1e4f, 0x1e4e, // 51656
-    0x1e4d, 0x1e4d, 0x1e4c, 0x1e4c, 0x1e4b, 0x1e4a, 0x1e4a, 0x1e49, // 51664
-    0x1e48, 0x1e48, 0x1e47, 0x1e47, 0x1e46, 0x1e45, 0x1e45, 0x1e44, // 51672
-    0x1e43, 0x1e43, 0x1e42, 0x1e42, 0x1e41, 0x1e40, 0x1e40, 0x1e3f, // 51680
-    0x1e3e, 0x1e3e, 0x1e3d, 0x1e3d, 0x1e3c, 0x1e3b, 0x1e3b, 0x1e3a, // 51688
-    0x1e39, 0x1e39, 0x1e38, 0x1e38, 0x1e37, 0x1e36, 0x1e36, 0x1e35, // 51696
-    0x1e34, 0x1e34, 0x1e33, 0x1e33, 0x1e32, 0x1e31, 0x1e31, 0x1e30, // 51704
-    0x1e30, 0x1e2f, 0x1e2e, 0x1e2e, 0x1e2d, 0x1e2c, 0x1e2c, 0x1e2b, // 51712
-    0x1e2b, 0x1e2a, 0x1e29, 0x1e29, 0x1e28, 0x1e27, 0x1e27, 0x1e26, // 51720
-    0x1e26, 0x1e25, 0x1e24, 0x1e24, 0x1e23, 0x1e22, 0x1e22, 0x1e21, // 51728
-    0x1e21, 0x1e20, 0x1e1f, 0x1e1f, 0x1e1e, 0x1e1d, 0x1e1d, 0x1e1c, // 51736
-    0x1e1c, 0x1e1b, 0x1e1a, 0x1e1a, 0x1e19, 0x1e18, 0x1e18, 0x1e17, // 51744
-    0x1e17, 0x1e16, 0x1e15, 0x1e15, 0x1e14, 0x1e13, 0x1e13, 0x1e12, // 51752
-    0x1e12, 0x1e11, 0x1e10, 0x1e10, 0x1e0f, 0x1e0e, 0x1e0e, 0x1e0d, // 51760
-    0x1e0d, 0x1e0c, 0x1e0b, 0x1e0b, 0x1e0a, 0x1e09, 0x1e09, 0x1e08, // 51768
-    0x1e08, 0x1e07, 0x1e06, 0x1e06, 0x1e05, 0x1e05, 0x1e04, 0x1e03, // 51776
-    0x1e03, 0x1e02, 0x1e01, 0x1e01, 0x1e00, 0x1e00, 0x1dff, 0x1dfe, // 51784
-    0x1dfe, 0x1dfd, 0x1dfc, 0x1dfc, 0x1dfb, 0x1dfb, 0x1dfa, 0x1df9, // 51792
-    0x1df9, 0x1df8, 0x1df7, 0x1df7, 0x1df6, 0x1df6, 0x1df5, 0x1df4, // 51800
-    0x1df4, 0x1df3, 0x1df2, 0x1df2, 0x1df1, 0x1df1, 0x1df0, 0x1def, // 51808
-    0x1def, 0x1dee, 0x1ded, 0x1ded, 0x1dec, 0x1dec, 0x1deb, 0x1dea, // 51816
-    0x1dea, 0x1de9, 0x1de8, 0x1de8, 0x1de7, 0x1de7, 0x1de6, 0x1de5, // 51824
-    0x1de5, 0x1de4, 0x1de3, 0x1de3, 0x1de2, 0x1de2, 0x1de1, 0x1de0, // 51832
-    0x1de0, 0x1ddf, 0x1ddf, 0x1dde, 0x1ddd, 0x1ddd, 0x1ddc, 0x1ddb, // 51840
-    0x1ddb, 0x1dda, 0x1dda, 0x1dd9, 0x1dd8, 0x1dd8, 0x1dd7, 0x1dd6, // 51848
-    0x1dd6, 0x1dd5, 0x1dd5, 0x1dd4, 0x1dd3, 0x1dd3, 0x1dd2, 0x1dd1, // 51856
-    0x1dd1, 0x1dd0, 0x1dd0, 0x1dcf, 0x1dce, 0x1dce, 0x1dcd, 0x1dcc, // 51864
-    0x1dcc, 0x1dcb, 0x1dcb, 0x1dca, 0x1dc9, 0x1dc9, 0x1dc8, 0x1dc7, // 51872
-    0x1dc7, 0x1dc6, 0x1dc6, 0x1dc5, 0x1dc4, 0x1dc4, 0x1dc3, 0x1dc2, // 51880
-    0x1dc2, 0x1dc1, 0x1dc1, 0x1dc0, 0x1dbf, 0x1dbf, 0x1dbe, 0x1dbd, // 51888
-    0x1dbd, 0x1dbc, 0x1dbc, 0x1dbb, 0x1dba, 0x1dba, 0x1db9, 0x1db8, // 51896
-    0x1db8, 0x1db7, 0x1db7, 0x1db6, 0x1db5, 0x1db5, 0x1db4, 0x1db4, // 51904
-    0x1db3, 0x1db2, 0x1db2, 0x1db1, 0x1db0, 0x1db0, 0x1daf, 0x1daf, // 51912
-    0x1dae, 0x1dad, 0x1dad, 0x1dac, 0x1dab, 0x1dab, 0x1daa, 0x1daa, // 51920
-    0x1da9, 0x1da8, 0x1da8, 0x1da7, 0x1da6, 0x1da6, 0x1da5, 0x1da5, // 51928
-    0x1da4, 0x1da3, 0x1da3, 0x1da2, 0x1da1, 0x1da1, 0x1da0, 0x1da0, // 51936
-    0x1d9f, 0x1d9e, 0x1d9e, 0x1d9d, 0x1d9c, 0x1d9c, 0x1d9b, 0x1d9b, // 51944
-    0x1d9a, 0x1d99, 0x1d99, 0x1d98, 0x1d97, 0x1d97, 0x1d96, 0x1d96, // 51952
-    0x1d95, 0x1d94, 0x1d94, 0x1d93, 0x1d92, 0x1d92, 0x1d91, 0x1d91, // 51960
-    0x1d90, 0x1d8f, 0x1d8f, 0x1d8e, 0x1d8e, 0x1d8d, 0x1d8c, 0x1d8c, // 51968
-    0x1d8b, 0x1d8a, 0x1d8a, 0x1d89, 0x1d89, 0x1d88, 0x1d87, 0x1d87, // 51976
-    0x1d86, 0x1d85, 0x1d85, 0x1d84, 0x1d84, 0x1d83, 0x1d82, 0x1d82, // 51984
-    0x1d81, 0x1d80, 0x1d80, 0x1d7f, 0x1d7f, 0x1d7e, 0x1d7d, 0x1d7d, // 51992
-    0x1d7c, 0x1d7b, 0x1d7b, 0x1d7a, 0x1d7a, 0x1d79, 0x1d78, 0x1d78, // 52000
-    0x1d77, 0x1d76, 0x1d76, 0x1d75, 0x1d75, 0x1d74, 0x1d73, 0x1d73, // 52008
-    0x1d72, 0x1d71, 0x1d71, 0x1d70, 0x1d70, 0x1d6f, 0x1d6e, 0x1d6e, // 52016
-    0x1d6d, 0x1d6c, 0x1d6c, 0x1d6b, 0x1d6b, 0x1d6a, 0x1d69, 0x1d69, // 52024
-    0x1d68, 0x1d68, 0x1d67, 0x1d66, 0x1d66, 0x1d65, 0x1d64, 0x1d64, // 52032
-    0x1d63, 0x1d63, 0x1d62, 0x1d61, 0x1d61, 0x1d60, 0x1d5f, 0x1d5f, // 52040
-    0x1d5e, 0x1d5e, 0x1d5d, 0x1d5c, 0x1d5c, 0x1d5b, 0x1d5a, 0x1d5a, // 52048
-    0x1d59, 0x1d59, 0x1d58, 0x1d57, 0x1d57, 0x1d56, 0x1d55, 0x1d55, // 52056
-    0x1d54, 0x1d54, 0x1d53, 0x1d52, 0x1d52, 0x1d51, 0x1d50, 0x1d50, // 52064
-    0x1d4f, 0x1d4f, 0x1d4e, 0x1d4d, 0x1d4d, 0x1d4c, 0x1d4b, 0x1d4b, // 52072
-    0x1d4a, 0x1d4a, 0x1d49, 0x1d48, 0x1d48, 0x1d47, 0x1d46, 0x1d46, // 52080
-    0x1d45, 0x1d45, 0x1d44, 0x1d43, 0x1d43, 0x1d42, 0x1d41, 0x1d41, // 52088
-    0x1d40, 0x1d40, 0x1d3f, 0x1d3e, 0x1d3e, 0x1d3d, 0x1d3d, 0x1d3c, // 52096
-    0x1d3b, 0x1d3b, 0x1d3a, 0x1d39, 0x1d39, 0x1d38, 0x1d38, 0x1d37, // 52104
-    0x1d36, 0x1d36, 0x1d35, 0x1d34, 0x1d34, 0x1d33, 0x1d33, 0x1d32, // 52112
-    0x1d31, 0x1d31, 0x1d30, 0x1d2f, 0x1d2f, 0x1d2e, 0x1d2e, 0x1d2d, // 52120
-    0x1d2c, 0x1d2c, 0x1d2b, 0x1d2a, 0x1d2a, 0x1d29, 0x1d29, 0x1d28, // 52128
-    0x1d27, 0x1d27, 0x1d26, 0x1d25, 0x1d25, 0x1d24, 0x1d24, 0x1d23, // 52136
-    0x1d22, 0x1d22, 0x1d21, 0x1d20, 0x1d20, 0x1d1f, 0x1d1f, 0x1d1e, // 52144
-    0x1d1d, 0x1d1d, 0x1d1c, 0x1d1b, 0x1d1b, 0x1d1a, 0x1d1a, 0x1d19, // 52152
-    0x1d18, 0x1d18, 0x1d17, 0x1d17, 0x1d16, 0x1d15, 0x1d15, 0x1d14, // 52160
-    0x1d13, 0x1d13, 0x1d12, 0x1d12, 0x1d11, 0x1d10, 0x1d10, 0x1d0f, // 52168
-    0x1d0e, 0x1d0e, 0x1d0d, 0x1d0d, 0x1d0c, 0x1d0b, 0x1d0b, 0x1d0a, // 52176
-    0x1d09, 0x1d09, 0x1d08, 0x1d08, 0x1d07, 0x1d06, 0x1d06, 0x1d05, // 52184
-    0x1d04, 0x1d04, 0x1d03, 0x1d03, 0x1d02, 0x1d01, 0x1d01, 0x1d00, // 52192
-    0x1cff, 0x1cff, 0x1cfe, 0x1cfe, 0x1cfd, 0x1cfc, 0x1cfc, 0x1cfb, // 52200
-    0x1cfa, 0x1cfa, 0x1cf9, 0x1cf9, 0x1cf8, 0x1cf7, 0x1cf7, 0x1cf6, // 52208
-    0x1cf5, 0x1cf5, 0x1cf4, 0x1cf4, 0x1cf3, 0x1cf2, 0x1cf2, 0x1cf1, // 52216
-    0x1cf1, 0x1cf0, 0x1cef, 0x1cef, 0x1cee, 0x1ced, 0x1ced, 0x1cec, // 52224
-    0x1cec, 0x1ceb, 0x1cea, 0x1cea, 0x1ce9, 0x1ce9, 0x1ce8, 0x1ce7, // 52232
-    0x1ce7, 0x1ce6, 0x1ce5, 0x1ce5, 0x1ce4, 0x1ce4, 0x1ce3, 0x1ce2, // 52240
-    0x1ce2, 0x1ce1, 0x1ce1, 0x1ce0, 0x1cdf, 0x1cdf, 0x1cde, 0x1cdd, // 52248
-    0x1cdd, 0x1cdc, 0x1cdc, 0x1cdb, 0x1cda, 0x1cda, 0x1cd9, 0x1cd9, // 52256
-    0x1cd8, 0x1cd7, 0x1cd7, 0x1cd6, 0x1cd5, 0x1cd5, 0x1cd4, 0x1cd4, // 52264
-    0x1cd3, 0x1cd2, 0x1cd2, 0x1cd1, 0x1cd1, 0x1cd0, 0x1ccf, 0x1ccf, // 52272
-    0x1cce, 0x1ccd, 0x1ccd, 0x1ccc, 0x1ccc, 0x1ccb, 0x1cca, 0x1cca, // 52280
-    0x1cc9, 0x1cc9, 0x1cc8, 0x1cc7, 0x1cc7, 0x1cc6, 0x1cc5, 0x1cc5, // 52288
-    0x1cc4, 0x1cc4, 0x1cc3, 0x1cc2, 0x1cc2, 0x1cc1, 0x1cc1, 0x1cc0, // 52296
-    0x1cbf, 0x1cbf, 0x1cbe, 0x1cbd, 0x1cbd, 0x1cbc, 0x1cbc, 0x1cbb, // 52304
-    0x1cba, 0x1cba, 0x1cb9, 0x1cb9, 0x1cb8, 0x1cb7, 0x1cb7, 0x1cb6, // 52312
-    0x1cb5, 0x1cb5, 0x1cb4, 0x1cb4, 0x1cb3, 0x1cb2, 0x1cb2, 0x1cb1, // 52320
-    0x1cb1, 0x1cb0, 0x1caf, 0x1caf, 0x1cae, 0x1cad, 0x1cad, 0x1cac, // 52328
-    0x1cac, 0x1cab, 0x1caa, 0x1caa, 0x1ca9, 0x1ca9, 0x1ca8, 0x1ca7, // 52336
-    0x1ca7, 0x1ca6, 0x1ca5, 0x1ca5, 0x1ca4, 0x1ca4, 0x1ca3, 0x1ca2, // 52344
-    0x1ca2, 0x1ca1, 0x1ca1, 0x1ca0, 0x1c9f, 0x1c9f, 0x1c9e, 0x1c9d, // 52352
-    0x1c9d, 0x1c9c, 0x1c9c, 0x1c9b, 0x1c9a, 0x1c9a, 0x1c99, 0x1c99, // 52360
-    0x1c98, 0x1c97, 0x1c97, 0x1c96, 0x1c95, 0x1c95, 0x1c94, 0x1c94, // 52368
-    0x1c93, 0x1c92, 0x1c92, 0x1c91, 0x1c91, 0x1c90, 0x1c8f, 0x1c8f, // 52376
-    0x1c8e, 0x1c8d, 0x1c8d, 0x1c8c, 0x1c8c, 0x1c8b, 0x1c8a, 0x1c8a, // 52384
-    0x1c89, 0x1c89, 0x1c88, 0x1c87, 0x1c87, 0x1c86, 0x1c85, 0x1c85, // 52392
-    0x1c84, 0x1c84, 0x1c83, 0x1c82, 0x1c82, 0x1c81, 0x1c81, 0x1c80, // 52400
-    0x1c7f, 0x1c7f, 0x1c7e, 0x1c7d, 0x1c7d, 0x1c7c, 0x1c7c, 0x1c7b, // 52408
-    0x1c7a, 0x1c7a, 0x1c79, 0x1c79, 0x1c78, 0x1c77, 0x1c77, 0x1c76, // 52416
-    0x1c75, 0x1c75, 0x1c74, 0x1c74, 0x1c73, 0x1c72, 0x1c72, 0x1c71, // 52424
-    0x1c71, 0x1c70, 0x1c6f, 0x1c6f, 0x1c6e, 0x1c6d, 0x1c6d, 0x1c6c, // 52432
-    0x1c6c, 0x1c6b, 0x1c6a, 0x1c6a, 0x1c69, 0x1c69, 0x1c68, 0x1c67, // 52440
-    0x1c67, 0x1c66, 0x1c65, 0x1c65, 0x1c64, 0x1c64, 0x1c63, 0x1c62, // 52448
-    0x1c62, 0x1c61, 0x1c61, 0x1c60, 0x1c5f, 0x1c5f, 0x1c5e, 0x1c5d, // 52456
-    0x1c5d, 0x1c5c, 0x1c5c, 0x1c5b, 0x1c5a, 0x1c5a, 0x1c59, 0x1c59, // 52464
-    0x1c58, 0x1c57, 0x1c57, 0x1c56, 0x1c55, 0x1c55, 0x1c54, 0x1c54, // 52472
-    0x1c53, 0x1c52, 0x1c52, 0x1c51, 0x1c51, 0x1c50, 0x1c4f, 0x1c4f, // 52480
-    0x1c4e, 0x1c4d, 0x1c4d, 0x1c4c, 0x1c4c, 0x1c4b, 0x1c4a, 0x1c4a, // 52488
-    0x1c49, 0x1c49, 0x1c48, 0x1c47, 0x1c47, 0x1c46, 0x1c45, 0x1c45, // 52496
-    0x1c44, 0x1c44, 0x1c43, 0x1c42, 0x1c42, 0x1c41, 0x1c41, 0x1c40, // 52504
-    0x1c3f, 0x1c3f, 0x1c3e, 0x1c3d, 0x1c3d, 0x1c3c, 0x1c3c, 0x1c3b, // 52512
-    0x1c3a, 0x1c3a, 0x1c39, 0x1c39, 0x1c38, 0x1c37, 0x1c37, 0x1c36, // 52520
-    0x1c35, 0x1c35, 0x1c34, 0x1c34, 0x1c33, 0x1c32, 0x1c32, 0x1c31, // 52528
-    0x1c31, 0x1c30, 0x1c2f, 0x1c2f, 0x1c2e, 0x1c2d, 0x1c2d, 0x1c2c, // 52536
-    0x1c2c, 0x1c2b, 0x1c2a, 0x1c2a, 0x1c29, 0x1c29, 0x1c28, 0x1c27, // 52544
-    0x1c27, 0x1c26, 0x1c25, 0x1c25, 0x1c24, 0x1c24, 0x1c23, 0x1c22, // 52552
-    0x1c22, 0x1c21, 0x1c21, 0x1c20, 0x1c1f, 0x1c1f, 0x1c1e, 0x1c1d, // 52560
-    0x1c1d, 0x1c1c, 0x1c1c, 0x1c1b, 0x1c1a, 0x1c1a, 0x1c19, 0x1c19, // 52568
-    0x1c18, 0x1c17, 0x1c17, 0x1c16, 0x1c15, 0x1c15, 0x1c14, 0x1c14, // 52576
-    0x1c13, 0x1c12, 0x1c12, 0x1c11, 0x1c11, 0x1c10, 0x1c0f, 0x1c0f, // 52584
-    0x1c0e, 0x1c0d, 0x1c0d, 0x1c0c, 0x1c0c, 0x1c0b, 0x1c0a, 0x1c0a, // 52592
-    0x1c09, 0x1c09, 0x1c08, 0x1c07, 0x1c07, 0x1c06, 0x1c05, 0x1c05, // 52600
-    0x1c04, 0x1c04, 0x1c03, 0x1c02, 0x1c02, 0x1c01, 0x1c01, 0x1c00, // 52608
-    0x1bff, 0x1bff, 0x1bfe, 0x1bfd, 0x1bfd, 0x1bfc, 0x1bfc, 0x1bfb, // 52616
-    0x1bfa, 0x1bfa, 0x1bf9, 0x1bf9, 0x1bf8, 0x1bf7, 0x1bf7, 0x1bf6, // 52624
-    0x1bf5, 0x1bf5, 0x1bf4, 0x1bf4, 0x1bf3, 0x1bf2, 0x1bf2, 0x1bf1, // 52632
-    0x1bf1, 0x1bf0, 0x1bef, 0x1bef, 0x1bee, 0x1bed, 0x1bed, 0x1bec, // 52640
-    0x1bec, 0x1beb, 0x1bea, 0x1bea, 0x1be9, 0x1be9, 0x1be8, 0x1be7, // 52648
-    0x1be7, 0x1be6, 0x1be5, 0x1be5, 0x1be4, 0x1be4, 0x1be3, 0x1be2, // 52656
-    0x1be2, 0x1be1, 0x1be1, 0x1be0, 0x1bdf, 0x1bdf, 0x1bde, 0x1bdd, // 52664
-    0x1bdd, 0x1bdc, 0x1bdc, 0x1bdb, 0x1bda, 0x1bda, 0x1bd9, 0x1bd9, // 52672
-    0x1bd8, 0x1bd7, 0x1bd7, 0x1bd6, 0x1bd5, 0x1bd5, 0x1bd4, 0x1bd4, // 52680
-    0x1bd3, 0x1bd2, 0x1bd2, 0x1bd1, 0x1bd1, 0x1bd0, 0x1bcf, 0x1bcf, // 52688
-    0x1bce, 0x1bcd, 0x1bcd, 0x1bcc, 0x1bcc, 0x1bcb, 0x1bca, 0x1bca, // 52696
-    0x1bc9, 0x1bc9, 0x1bc8, 0x1bc7, 0x1bc7, 0x1bc6, 0x1bc5, 0x1bc5, // 52704
-    0x1bc4, 0x1bc4, 0x1bc3, 0x1bc2, 0x1bc2, 0x1bc1, 0x1bc1, 0x1bc0, // 52712
-    0x1bbf, 0x1bbf, 0x1bbe, 0x1bbd, 0x1bbd, 0x1bbc, 0x1bbc, 0x1bbb, // 52720
-    0x1bba, 0x1bba, 0x1bb9, 0x1bb9, 0x1bb8, 0x1bb7, 0x1bb7, 0x1bb6, // 52728
-    0x1bb6, 0x1bb5, 0x1bb4, 0x1bb4, 0x1bb3, 0x1bb2, 0x1bb2, 0x1bb1, // 52736
-    0x1bb1, 0x1bb0, 0x1baf, 0x1baf, 0x1bae, 0x1bae, 0x1bad, 0x1bac, // 52744
-    0x1bac, 0x1bab, 0x1baa, 0x1baa, 0x1ba9, 0x1ba9, 0x1ba8, 0x1ba7, // 52752
-    0x1ba7, 0x1ba6, 0x1ba6, 0x1ba5, 0x1ba4, 0x1ba4, 0x1ba3, 0x1ba2, // 52760
-    0x1ba2, 0x1ba1, 0x1ba1, 0x1ba0, 0x1b9f, 0x1b9f, 0x1b9e, 0x1b9e, // 52768
-    0x1b9d, 0x1b9c, 0x1b9c, 0x1b9b, 0x1b9a, 0x1b9a, 0x1b99, 0x1b99, // 52776
-    0x1b98, 0x1b97, 0x1b97, 0x1b96, 0x1b96, 0x1b95, 0x1b94, 0x1b94, // 52784
-    0x1b93, 0x1b92, 0x1b92, 0x1b91, 0x1b91, 0x1b90, 0x1b8f, 0x1b8f, // 52792
-    0x1b8e, 0x1b8e, 0x1b8d, 0x1b8c, 0x1b8c, 0x1b8b, 0x1b8a, 0x1b8a, // 52800
-    0x1b89, 0x1b89, 0x1b88, 0x1b87, 0x1b87, 0x1b86, 0x1b86, 0x1b85, // 52808
-    0x1b84, 0x1b84, 0x1b83, 0x1b82, 0x1b82, 0x1b81, 0x1b81, 0x1b80, // 52816
-    0x1b7f, 0x1b7f, 0x1b7e, 0x1b7e, 0x1b7d, 0x1b7c, 0x1b7c, 0x1b7b, // 52824
-    0x1b7a, 0x1b7a, 0x1b79, 0x1b79, 0x1b78, 0x1b77, 0x1b77, 0x1b76, // 52832
-    0x1b76, 0x1b75, 0x1b74, 0x1b74, 0x1b73, 0x1b72, 0x1b72, 0x1b71, // 52840
-    0x1b71, 0x1b70, 0x1b6f, 0x1b6f, 0x1b6e, 0x1b6e, 0x1b6d, 0x1b6c, // 52848
-    0x1b6c, 0x1b6b, 0x1b6a, 0x1b6a, 0x1b69, 0x1b69, 0x1b68, 0x1b67, // 52856
-    0x1b67, 0x1b66, 0x1b66, 0x1b65, 0x1b64, 0x1b64, 0x1b63, 0x1b62, // 52864
-    0x1b62, 0x1b61, 0x1b61, 0x1b60, 0x1b5f, 0x1b5f, 0x1b5e, 0x1b5e, // 52872
-    0x1b5d, 0x1b5c, 0x1b5c, 0x1b5b, 0x1b5a, 0x1b5a, 0x1b59, 0x1b59, // 52880
-    0x1b58, 0x1b57, 0x1b57, 0x1b56, 0x1b56, 0x1b55, 0x1b54, 0x1b54, // 52888
-    0x1b53, 0x1b52, 0x1b52, 0x1b51, 0x1b51, 0x1b50, 0x1b4f, 0x1b4f, // 52896
-    0x1b4e, 0x1b4e, 0x1b4d, 0x1b4c, 0x1b4c, 0x1b4b, 0x1b4a, 0x1b4a, // 52904
-    0x1b49, 0x1b49, 0x1b48, 0x1b47, 0x1b47, 0x1b46, 0x1b46, 0x1b45, // 52912
-    0x1b44, 0x1b44, 0x1b43, 0x1b42, 0x1b42, 0x1b41, 0x1b41, 0x1b40, // 52920
-    0x1b3f, 0x1b3f, 0x1b3e, 0x1b3e, 0x1b3d, 0x1b3c, 0x1b3c, 0x1b3b, // 52928
-    0x1b3a, 0x1b3a, 0x1b39, 0x1b39, 0x1b38, 0x1b37, 0x1b37, 0x1b36, // 52936
-    0x1b36, 0x1b35, 0x1b34, 0x1b34, 0x1b33, 0x1b32, 0x1b32, 0x1b31, // 52944
-    0x1b31, 0x1b30, 0x1b2f, 0x1b2f, 0x1b2e, 0x1b2e, 0x1b2d, 0x1b2c, // 52952
-    0x1b2c, 0x1b2b, 0x1b2a, 0x1b2a, 0x1b29, 0x1b29, 0x1b28, 0x1b27, // 52960
-    0x1b27, 0x1b26, 0x1b26, 0x1b25, 0x1b24, 0x1b24, 0x1b23, 0x1b22, // 52968
-    0x1b22, 0x1b21, 0x1b21, 0x1b20, 0x1b1f, 0x1b1f, 0x1b1e, 0x1b1e, // 52976
-    0x1b1d, 0x1b1c, 0x1b1c, 0x1b1b, 0x1b1a, 0x1b1a, 0x1b19, 0x1b19, // 52984
-    0x1b18, 0x1b17, 0x1b17, 0x1b16, 0x1b16, 0x1b15, 0x1b14, 0x1b14, // 52992
-    0x1b13, 0x1b12, 0x1b12, 0x1b11, 0x1b11, 0x1b10, 0x1b0f, 0x1b0f, // 53000
-    0x1b0e, 0x1b0e, 0x1b0d, 0x1b0c, 0x1b0c, 0x1b0b, 0x1b0a, 0x1b0a, // 53008
-    0x1b09, 0x1b09, 0x1b08, 0x1b07, 0x1b07, 0x1b06, 0x1b06, 0x1b05, // 53016
-    0x1b04, 0x1b04, 0x1b03, 0x1b02, 0x1b02, 0x1b01, 0x1b01, 0x1b00, // 53024
-    0x1aff, 0x1aff, 0x1afe, 0x1afe, 0x1afd, 0x1afc, 0x1afc, 0x1afb, // 53032
-    0x1afa, 0x1afa, 0x1af9, 0x1af9, 0x1af8, 0x1af7, 0x1af7, 0x1af6, // 53040
-    0x1af6, 0x1af5, 0x1af4, 0x1af4, 0x1af3, 0x1af2, 0x1af2, 0x1af1, // 53048
-    0x1af1, 0x1af0, 0x1aef, 0x1aef, 0x1aee, 0x1aee, 0x1aed, 0x1aec, // 53056
-    0x1aec, 0x1aeb, 0x1aea, 0x1aea, 0x1ae9, 0x1ae9, 0x1ae8, 0x1ae7, // 53064
-    0x1ae7, 0x1ae6, 0x1ae6, 0x1ae5, 0x1ae4, 0x1ae4, 0x1ae3, 0x1ae2, // 53072
-    0x1ae2, 0x1ae1, 0x1ae1, 0x1ae0, 0x1adf, 0x1adf, 0x1ade, 0x1ade, // 53080
-    0x1add, 0x1adc, 0x1adc, 0x1adb, 0x1ada, 0x1ada, 0x1ad9, 0x1ad9, // 53088
-    0x1ad8, 0x1ad7, 0x1ad7, 0x1ad6, 0x1ad6, 0x1ad5, 0x1ad4, 0x1ad4, // 53096
-    0x1ad3, 0x1ad2, 0x1ad2, 0x1ad1, 0x1ad1, 0x1ad0, 0x1acf, 0x1acf, // 53104
-    0x1ace, 0x1ace, 0x1acd, 0x1acc, 0x1acc, 0x1acb, 0x1aca, 0x1aca, // 53112
-    0x1ac9, 0x1ac9, 0x1ac8, 0x1ac7, 0x1ac7, 0x1ac6, 0x1ac6, 0x1ac5, // 53120
-    0x1ac4, 0x1ac4, 0x1ac3, 0x1ac2, 0x1ac2, 0x1ac1, 0x1ac1, 0x1ac0, // 53128
-    0x1abf, 0x1abf, 0x1abe, 0x1abe, 0x1abd, 0x1abc, 0x1abc, 0x1abb, // 53136
-    0x1aba, 0x1aba, 0x1ab9, 0x1ab9, 0x1ab8, 0x1ab7, 0x1ab7, 0x1ab6, // 53144
-    0x1ab6, 0x1ab5, 0x1ab4, 0x1ab4, 0x1ab3, 0x1ab2, 0x1ab2, 0x1ab1, // 53152
-    0x1ab1, 0x1ab0, 0x1aaf, 0x1aaf, 0x1aae, 0x1aae, 0x1aad, 0x1aac, // 53160
-    0x1aac, 0x1aab, 0x1aaa, 0x1aaa, 0x1aa9, 0x1aa9, 0x1aa8, 0x1aa7, // 53168
-    0x1aa7, 0x1aa6, 0x1aa6, 0x1aa5, 0x1aa4, 0x1aa4, 0x1aa3, 0x1aa2, // 53176
-    0x1aa2, 0x1aa1, 0x1aa1, 0x1aa0, 0x1a9f, 0x1a9f, 0x1a9e, 0x1a9e, // 53184
-    0x1a9d, 0x1a9c, 0x1a9c, 0x1a9b, 0x1a9a, 0x1a9a, 0x1a99, 0x1a99, // 53192
-    0x1a98, 0x1a97, 0x1a97, 0x1a96, 0x1a96, 0x1a95, 0x1a94, 0x1a94, // 53200
-    0x1a93, 0x1a92, 0x1a92, 0x1a91, 0x1a91, 0x1a90, 0x1a8f, 0x1a8f, // 53208
-    0x1a8e, 0x1a8e, 0x1a8d, 0x1a8c, 0x1a8c, 0x1a8b, 0x1a8a, 0x1a8a, // 53216
-    0x1a89, 0x1a89, 0x1a88, 0x1a87, 0x1a87, 0x1a86, 0x1a86, 0x1a85, // 53224
-    0x1a84, 0x1a84, 0x1a83, 0x1a82, 0x1a82, 0x1a81, 0x1a81, 0x1a80, // 53232
-    0x1a7f, 0x1a7f, 0x1a7e, 0x1a7e, 0x1a7d, 0x1a7c, 0x1a7c, 0x1a7b, // 53240
-    0x1a7b, 0x1a7a, 0x1a79, 0x1a79, 0x1a78, 0x1a77, 0x1a77, 0x1a76, // 53248
-    0x1a76, 0x1a75, 0x1a74, 0x1a74, 0x1a73, 0x1a73, 0x1a72, 0x1a71, // 53256
-    0x1a71, 0x1a70, 0x1a70, 0x1a6f, 0x1a6e, 0x1a6e, 0x1a6d, 0x1a6d, // 53264
-    0x1a6c, 0x1a6b, 0x1a6b, 0x1a6a, 0x1a6a, 0x1a69, 0x1a68, 0x1a68, // 53272
-    0x1a67, 0x1a67, 0x1a66, 0x1a65, 0x1a65, 0x1a64, 0x1a64, 0x1a63, // 53280
-    0x1a62, 0x1a62, 0x1a61, 0x1a61, 0x1a60, 0x1a5f, 0x1a5f, 0x1a5e, // 53288
-    0x1a5e, 0x1a5d, 0x1a5c, 0x1a5c, 0x1a5b, 0x1a5b, 0x1a5a, 0x1a59, // 53296
-    0x1a59, 0x1a58, 0x1a57, 0x1a57, 0x1a56, 0x1a56, 0x1a55, 0x1a54, // 53304
-    0x1a54, 0x1a53, 0x1a53, 0x1a52, 0x1a51, 0x1a51, 0x1a50, 0x1a50, // 53312
-    0x1a4f, 0x1a4e, 0x1a4e, 0x1a4d, 0x1a4d, 0x1a4c, 0x1a4b, 0x1a4b, // 53320
-    0x1a4a, 0x1a4a, 0x1a49, 0x1a48, 0x1a48, 0x1a47, 0x1a47, 0x1a46, // 53328
-    0x1a45, 0x1a45, 0x1a44, 0x1a44, 0x1a43, 0x1a42, 0x1a42, 0x1a41, // 53336
-    0x1a41, 0x1a40, 0x1a3f, 0x1a3f, 0x1a3e, 0x1a3e, 0x1a3d, 0x1a3c, // 53344
-    0x1a3c, 0x1a3b, 0x1a3b, 0x1a3a, 0x1a39, 0x1a39, 0x1a38, 0x1a38, // 53352
-    0x1a37, 0x1a36, 0x1a36, 0x1a35, 0x1a34, 0x1a34, 0x1a33, 0x1a33, // 53360
-    0x1a32, 0x1a31, 0x1a31, 0x1a30, 0x1a30, 0x1a2f, 0x1a2e, 0x1a2e, // 53368
-    0x1a2d, 0x1a2d, 0x1a2c, 0x1a2b, 0x1a2b, 0x1a2a, 0x1a2a, 0x1a29, // 53376
-    0x1a28, 0x1a28, 0x1a27, 0x1a27, 0x1a26, 0x1a25, 0x1a25, 0x1a24, // 53384
-    0x1a24, 0x1a23, 0x1a22, 0x1a22, 0x1a21, 0x1a21, 0x1a20, 0x1a1f, // 53392
-    0x1a1f, 0x1a1e, 0x1a1e, 0x1a1d, 0x1a1c, 0x1a1c, 0x1a1b, 0x1a1b, // 53400
-    0x1a1a, 0x1a19, 0x1a19, 0x1a18, 0x1a18, 0x1a17, 0x1a16, 0x1a16, // 53408
-    0x1a15, 0x1a15, 0x1a14, 0x1a13, 0x1a13, 0x1a12, 0x1a11, 0x1a11, // 53416
-    0x1a10, 0x1a10, 0x1a0f, 0x1a0e, 0x1a0e, 0x1a0d, 0x1a0d, 0x1a0c, // 53424
-    0x1a0b, 0x1a0b, 0x1a0a, 0x1a0a, 0x1a09, 0x1a08, 0x1a08, 0x1a07, // 53432
-    0x1a07, 0x1a06, 0x1a05, 0x1a05, 0x1a04, 0x1a04, 0x1a03, 0x1a02, // 53440
-    0x1a02, 0x1a01, 0x1a01, 0x1a00, 0x19ff, 0x19ff, 0x19fe, 0x19fe, // 53448
-    0x19fd, 0x19fc, 0x19fc, 0x19fb, 0x19fb, 0x19fa, 0x19f9, 0x19f9, // 53456
-    0x19f8, 0x19f8, 0x19f7, 0x19f6, 0x19f6, 0x19f5, 0x19f5, 0x19f4, // 53464
-    0x19f3, 0x19f3, 0x19f2, 0x19f2, 0x19f1, 0x19f0, 0x19f0, 0x19ef, // 53472
-    0x19ee, 0x19ee, 0x19ed, 0x19ed, 0x19ec, 0x19eb, 0x19eb, 0x19ea, // 53480
-    0x19ea, 0x19e9, 0x19e8, 0x19e8, 0x19e7, 0x19e7, 0x19e6, 0x19e5, // 53488
-    0x19e5, 0x19e4, 0x19e4, 0x19e3, 0x19e2, 0x19e2, 0x19e1, 0x19e1, // 53496
-    0x19e0, 0x19df, 0x19df, 0x19de, 0x19de, 0x19dd, 0x19dc, 0x19dc, // 53504
-    0x19db, 0x19db, 0x19da, 0x19d9, 0x19d9, 0x19d8, 0x19d8, 0x19d7, // 53512
-    0x19d6, 0x19d6, 0x19d5, 0x19d5, 0x19d4, 0x19d3, 0x19d3, 0x19d2, // 53520
-    0x19d2, 0x19d1, 0x19d0, 0x19d0, 0x19cf, 0x19ce, 0x19ce, 0x19cd, // 53528
-    0x19cd, 0x19cc, 0x19cb, 0x19cb, 0x19ca, 0x19ca, 0x19c9, 0x19c8, // 53536
-    0x19c8, 0x19c7, 0x19c7, 0x19c6, 0x19c5, 0x19c5, 0x19c4, 0x19c4, // 53544
-    0x19c3, 0x19c2, 0x19c2, 0x19c1, 0x19c1, 0x19c0, 0x19bf, 0x19bf, // 53552
-    0x19be, 0x19be, 0x19bd, 0x19bc, 0x19bc, 0x19bb, 0x19bb, 0x19ba, // 53560
-    0x19b9, 0x19b9, 0x19b8, 0x19b8, 0x19b7, 0x19b6, 0x19b6, 0x19b5, // 53568
-    0x19b5, 0x19b4, 0x19b3, 0x19b3, 0x19b2, 0x19b2, 0x19b1, 0x19b0, // 53576
-    0x19b0, 0x19af, 0x19af, 0x19ae, 0x19ad, 0x19ad, 0x19ac, 0x19ab, // 53584
-    0x19ab, 0x19aa, 0x19aa, 0x19a9, 0x19a8, 0x19a8, 0x19a7, 0x19a7, // 53592
-    0x19a6, 0x19a5, 0x19a5, 0x19a4, 0x19a4, 0x19a3, 0x19a2, 0x19a2, // 53600
-    0x19a1, 0x19a1, 0x19a0, 0x199f, 0x199f, 0x199e, 0x199e, 0x199d, // 53608
-    0x199c, 0x199c, 0x199b, 0x199b, 0x199a, 0x1999, 0x1999, 0x1998, // 53616
-    0x1998, 0x1997, 0x1996, 0x1996, 0x1995, 0x1995, 0x1994, 0x1993, // 53624
-    0x1993, 0x1992, 0x1992, 0x1991, 0x1990, 0x1990, 0x198f, 0x198f, // 53632
-    0x198e, 0x198d, 0x198d, 0x198c, 0x198c, 0x198b, 0x198a, 0x198a, // 53640
-    0x1989, 0x1988, 0x1988, 0x1987, 0x1987, 0x1986, 0x1985, 0x1985, // 53648
-    0x1984, 0x1984, 0x1983, 0x1982, 0x1982, 0x1981, 0x1981, 0x1980, // 53656
-    0x197f, 0x197f, 0x197e, 0x197e, 0x197d, 0x197c, 0x197c, 0x197b, // 53664
-    0x197b, 0x197a, 0x1979, 0x1979, 0x1978, 0x1978, 0x1977, 0x1976, // 53672
-    0x1976, 0x1975, 0x1975, 0x1974, 0x1973, 0x1973, 0x1972, 0x1972, // 53680
-    0x1971, 0x1970, 0x1970, 0x196f, 0x196f, 0x196e, 0x196d, 0x196d, // 53688
-    0x196c, 0x196c, 0x196b, 0x196a, 0x196a, 0x1969, 0x1969, 0x1968, // 53696
-    0x1967, 0x1967, 0x1966, 0x1965, 0x1965, 0x1964, 0x1964, 0x1963, // 53704
-    0x1962, 0x1962, 0x1961, 0x1961, 0x1960, 0x195f, 0x195f, 0x195e, // 53712
-    0x195e, 0x195d, 0x195c, 0x195c, 0x195b, 0x195b, 0x195a, 0x1959, // 53720
-    0x1959, 0x1958, 0x1958, 0x1957, 0x1956, 0x1956, 0x1955, 0x1955, // 53728
-    0x1954, 0x1953, 0x1953, 0x1952, 0x1952, 0x1951, 0x1950, 0x1950, // 53736
-    0x194f, 0x194f, 0x194e, 0x194d, 0x194d, 0x194c, 0x194c, 0x194b, // 53744
-    0x194a, 0x194a, 0x1949, 0x1949, 0x1948, 0x1947, 0x1947, 0x1946, // 53752
-    0x1946, 0x1945, 0x1944, 0x1944, 0x1943, 0x1942, 0x1942, 0x1941, // 53760
-    0x1941, 0x1940, 0x193f, 0x193f, 0x193e, 0x193e, 0x193d, 0x193c, // 53768
-    0x193c, 0x193b, 0x193b, 0x193a, 0x1939, 0x1939, 0x1938, 0x1938, // 53776
-    0x1937, 0x1936, 0x1936, 0x1935, 0x1935, 0x1934, 0x1933, 0x1933, // 53784
-    0x1932, 0x1932, 0x1931, 0x1930, 0x1930, 0x192f, 0x192f, 0x192e, // 53792
-    0x192d, 0x192d, 0x192c, 0x192c, 0x192b, 0x192a, 0x192a, 0x1929, // 53800
-    0x1929, 0x1928, 0x1927, 0x1927, 0x1926, 0x1926, 0x1925, 0x1924, // 53808
-    0x1924, 0x1923, 0x1922, 0x1922, 0x1921, 0x1921, 0x1920, 0x191f, // 53816
-    0x191f, 0x191e, 0x191e, 0x191d, 0x191c, 0x191c, 0x191b, 0x191b, // 53824
-    0x191a, 0x1919, 0x1919, 0x1918, 0x1918, 0x1917, 0x1916, 0x1916, // 53832
-    0x1915, 0x1915, 0x1914, 0x1913, 0x1913, 0x1912, 0x1912, 0x1911, // 53840
-    0x1910, 0x1910, 0x190f, 0x190f, 0x190e, 0x190d, 0x190d, 0x190c, // 53848
-    0x190c, 0x190b, 0x190a, 0x190a, 0x1909, 0x1909, 0x1908, 0x1907, // 53856
-    0x1907, 0x1906, 0x1906, 0x1905, 0x1904, 0x1904, 0x1903, 0x1903, // 53864
-    0x1902, 0x1901, 0x1901, 0x1900, 0x18ff, 0x18ff, 0x18fe, 0x18fe, // 53872
-    0x18fd, 0x18fc, 0x18fc, 0x18fb, 0x18fb, 0x18fa, 0x18f9, 0x18f9, // 53880
-    0x18f8, 0x18f8, 0x18f7, 0x18f6, 0x18f6, 0x18f5, 0x18f5, 0x18f4, // 53888
-    0x18f3, 0x18f3, 0x18f2, 0x18f2, 0x18f1, 0x18f0, 0x18f0, 0x18ef, // 53896
-    0x18ef, 0x18ee, 0x18ed, 0x18ed, 0x18ec, 0x18ec, 0x18eb, 0x18ea, // 53904
-    0x18ea, 0x18e9, 0x18e9, 0x18e8, 0x18e7, 0x18e7, 0x18e6, 0x18e6, // 53912
-    0x18e5, 0x18e4, 0x18e4, 0x18e3, 0x18e3, 0x18e2, 0x18e1, 0x18e1, // 53920
-    0x18e0, 0x18e0, 0x18df, 0x18de, 0x18de, 0x18dd, 0x18dc, 0x18dc, // 53928
-    0x18db, 0x18db, 0x18da, 0x18d9, 0x18d9, 0x18d8, 0x18d8, 0x18d7, // 53936
-    0x18d6, 0x18d6, 0x18d5, 0x18d5, 0x18d4, 0x18d3, 0x18d3, 0x18d2, // 53944
-    0x18d2, 0x18d1, 0x18d0, 0x18d0, 0x18cf, 0x18cf, 0x18ce, 0x18cd, // 53952
-    0x18cd, 0x18cc, 0x18cc, 0x18cb, 0x18ca, 0x18ca, 0x18c9, 0x18c9, // 53960
-    0x18c8, 0x18c7, 0x18c7, 0x18c6, 0x18c6, 0x18c5, 0x18c4, 0x18c4, // 53968
-    0x18c3, 0x18c3, 0x18c2, 0x18c1, 0x18c1, 0x18c0, 0x18c0, 0x18bf, // 53976
-    0x18be, 0x18be, 0x18bd, 0x18bd, 0x18bc, 0x18bb, 0x18bb, 0x18ba, // 53984
-    0x18b9, 0x18b9, 0x18b8, 0x18b8, 0x18b7, 0x18b6, 0x18b6, 0x18b5, // 53992
-    0x18b5, 0x18b4, 0x18b3, 0x18b3, 0x18b2, 0x18b2, 0x18b1, 0x18b0, // 54000
-    0x18b0, 0x18af, 0x18af, 0x18ae, 0x18ad, 0x18ad, 0x18ac, 0x18ac, // 54008
-    0x18ab, 0x18aa, 0x18aa, 0x18a9, 0x18a9, 0x18a8, 0x18a7, 0x18a7, // 54016
-    0x18a6, 0x18a6, 0x18a5, 0x18a4, 0x18a4, 0x18a3, 0x18a3, 0x18a2, // 54024
-    0x18a1, 0x18a1, 0x18a0, 0x18a0, 0x189f, 0x189e, 0x189e, 0x189d, // 54032
-    0x189d, 0x189c, 0x189b, 0x189b, 0x189a, 0x1899, 0x1899, 0x1898, // 54040
-    0x1898, 0x1897, 0x1896, 0x1896, 0x1895, 0x1895, 0x1894, 0x1893, // 54048
-    0x1893, 0x1892, 0x1892, 0x1891, 0x1890, 0x1890, 0x188f, 0x188f, // 54056
-    0x188e, 0x188d, 0x188d, 0x188c, 0x188c, 0x188b, 0x188a, 0x188a, // 54064
-    0x1889, 0x1889, 0x1888, 0x1887, 0x1887, 0x1886, 0x1886, 0x1885, // 54072
-    0x1884, 0x1884, 0x1883, 0x1883, 0x1882, 0x1881, 0x1881, 0x1880, // 54080
-    0x1880, 0x187f, 0x187e, 0x187e, 0x187d, 0x187d, 0x187c, 0x187b, // 54088
-    0x187b, 0x187a, 0x187a, 0x1879, 0x1878, 0x1878, 0x1877, 0x1876, // 54096
-    0x1876, 0x1875, 0x1875, 0x1874, 0x1873, 0x1873, 0x1872, 0x1872, // 54104
-    0x1871, 0x1870, 0x1870, 0x186f, 0x186f, 0x186e, 0x186d, 0x186d, // 54112
-    0x186c, 0x186c, 0x186b, 0x186a, 0x186a, 0x1869, 0x1869, 0x1868, // 54120
-    0x1867, 0x1867, 0x1866, 0x1866, 0x1865, 0x1864, 0x1864, 0x1863, // 54128
-    0x1863, 0x1862, 0x1861, 0x1861, 0x1860, 0x1860, 0x185f, 0x185e, // 54136
-    0x185e, 0x185d, 0x185d, 0x185c, 0x185b, 0x185b, 0x185a, 0x185a, // 54144
-    0x1859, 0x1858, 0x1858, 0x1857, 0x1857, 0x1856, 0x1855, 0x1855, // 54152
-    0x1854, 0x1853, 0x1853, 0x1852, 0x1852, 0x1851, 0x1850, 0x1850, // 54160
-    0x184f, 0x184f, 0x184e, 0x184d, 0x184d, 0x184c, 0x184c, 0x184b, // 54168
-    0x184a, 0x184a, 0x1849, 0x1849, 0x1848, 0x1847, 0x1847, 0x1846, // 54176
-    0x1846, 0x1845, 0x1844, 0x1844, 0x1843, 0x1843, 0x1842, 0x1841, // 54184
-    0x1841, 0x1840, 0x1840, 0x183f, 0x183e, 0x183e, 0x183d, 0x183d, // 54192
-    0x183c, 0x183b, 0x183b, 0x183a, 0x183a, 0x1839, 0x1838, 0x1838, // 54200
-    0x1837, 0x1837, 0x1836, 0x1835, 0x1835, 0x1834, 0x1834, 0x1833, // 54208
-    0x1832, 0x1832, 0x1831, 0x1830, 0x1830, 0x182f, 0x182f, 0x182e, // 54216
-    0x182d, 0x182d, 0x182c, 0x182c, 0x182b, 0x182a, 0x182a, 0x1829, // 54224
-    0x1829, 0x1828, 0x1827, 0x1827, 0x1826, 0x1826, 0x1825, 0x1824, // 54232
-    0x1824, 0x1823, 0x1823, 0x1822, 0x1821, 0x1821, 0x1820, 0x1820, // 54240
-    0x181f, 0x181e, 0x181e, 0x181d, 0x181d, 0x181c, 0x181b, 0x181b, // 54248
-    0x181a, 0x181a, 0x1819, 0x1818, 0x1818, 0x1817, 0x1817, 0x1816, // 54256
-    0x1815, 0x1815, 0x1814, 0x1814, 0x1813, 0x1812, 0x1812, 0x1811, // 54264
-    0x1810, 0x180f, 0x180f, 0x180e, 0x180e, 0x180d, 0x180c, 0x180c, // 54272
-    0x180b, 0x180b, 0x180a, 0x1809, 0x1809, 0x1808, 0x1808, 0x1807, // 54280
-    0x1807, 0x1806, 0x1805, 0x1805, 0x1804, 0x1804, 0x1803, 0x1802, // 54288
-    0x1802, 0x1801, 0x1801, 0x1800, 0x17ff, 0x17ff, 0x17fe, 0x17fe, // 54296
-    0x17fd, 0x17fc, 0x17fc, 0x17fb, 0x17fb, 0x17fa, 0x17fa, 0x17f9, // 54304
-    0x17f8, 0x17f8, 0x17f7, 0x17f7, 0x17f6, 0x17f5, 0x17f5, 0x17f4, // 54312
-    0x17f4, 0x17f3, 0x17f2, 0x17f2, 0x17f1, 0x17f1, 0x17f0, 0x17ef, // 54320
-    0x17ef, 0x17ee, 0x17ee, 0x17ed, 0x17ec, 0x17ec, 0x17eb, 0x17eb, // 54328
-    0x17ea, 0x17ea, 0x17e9, 0x17e8, 0x17e8, 0x17e7, 0x17e7, 0x17e6, // 54336
-    0x17e5, 0x17e5, 0x17e4, 0x17e4, 0x17e3, 0x17e2, 0x17e2, 0x17e1, // 54344
-    0x17e1, 0x17e0, 0x17df, 0x17df, 0x17de, 0x17de, 0x17dd, 0x17dd, // 54352
-    0x17dc, 0x17db, 0x17db, 0x17da, 0x17da, 0x17d9, 0x17d8, 0x17d8, // 54360
-    0x17d7, 0x17d7, 0x17d6, 0x17d5, 0x17d5, 0x17d4, 0x17d4, 0x17d3, // 54368
-    0x17d2, 0x17d2, 0x17d1, 0x17d1, 0x17d0, 0x17cf, 0x17cf, 0x17ce, // 54376
-    0x17ce, 0x17cd, 0x17cd, 0x17cc, 0x17cb, 0x17cb, 0x17ca, 0x17ca, // 54384
-    0x17c9, 0x17c8, 0x17c8, 0x17c7, 0x17c7, 0x17c6, 0x17c5, 0x17c5, // 54392
-    0x17c4, 0x17c4, 0x17c3, 0x17c2, 0x17c2, 0x17c1, 0x17c1, 0x17c0, // 54400
-    0x17c0, 0x17bf, 0x17be, 0x17be, 0x17bd, 0x17bd, 0x17bc, 0x17bb, // 54408
-    0x17bb, 0x17ba, 0x17ba, 0x17b9, 0x17b8, 0x17b8, 0x17b7, 0x17b7, // 54416
-    0x17b6, 0x17b5, 0x17b5, 0x17b4, 0x17b4, 0x17b3, 0x17b2, 0x17b2, // 54424
-    0x17b1, 0x17b1, 0x17b0, 0x17b0, 0x17af, 0x17ae, 0x17ae, 0x17ad, // 54432
-    0x17ad, 0x17ac, 0x17ab, 0x17ab, 0x17aa, 0x17aa, 0x17a9, 0x17a8, // 54440
-    0x17a8, 0x17a7, 0x17a7, 0x17a6, 0x17a5, 0x17a5, 0x17a4, 0x17a4, // 54448
-    0x17a3, 0x17a3, 0x17a2, 0x17a1, 0x17a1, 0x17a0, 0x17a0, 0x179f, // 54456
-    0x179e, 0x179e, 0x179d, 0x179d, 0x179c, 0x179b, 0x179b, 0x179a, // 54464
-    0x179a, 0x1799, 0x1798, 0x1798, 0x1797, 0x1797, 0x1796, 0x1795, // 54472
-    0x1795, 0x1794, 0x1794, 0x1793, 0x1793, 0x1792, 0x1791, 0x1791, // 54480
-    0x1790, 0x1790, 0x178f, 0x178e, 0x178e, 0x178d, 0x178d, 0x178c, // 54488
-    0x178b, 0x178b, 0x178a, 0x178a, 0x1789, 0x1788, 0x1788, 0x1787, // 54496
-    0x1787, 0x1786, 0x1786, 0x1785, 0x1784, 0x1784, 0x1783, 0x1783, // 54504
-    0x1782, 0x1781, 0x1781, 0x1780, 0x1780, 0x177f, 0x177e, 0x177e, // 54512
-    0x177d, 0x177d, 0x177c, 0x177b, 0x177b, 0x177a, 0x177a, 0x1779, // 54520
-    0x1779, 0x1778, 0x1777, 0x1777, 0x1776, 0x1776, 0x1775, 0x1774, // 54528
-    0x1774, 0x1773, 0x1773, 0x1772, 0x1771, 0x1771, 0x1770, 0x1770, // 54536
-    0x176f, 0x176e, 0x176e, 0x176d, 0x176d, 0x176c, 0x176b, 0x176b, // 54544
-    0x176a, 0x176a, 0x1769, 0x1769, 0x1768, 0x1767, 0x1767, 0x1766, // 54552
-    0x1766, 0x1765, 0x1764, 0x1764, 0x1763, 0x1763, 0x1762, 0x1761, // 54560
-    0x1761, 0x1760, 0x1760, 0x175f, 0x175e, 0x175e, 0x175d, 0x175d, // 54568
-    0x175c, 0x175c, 0x175b, 0x175a, 0x175a, 0x1759, 0x1759, 0x1758, // 54576
-    0x1757, 0x1757, 0x1756, 0x1756, 0x1755, 0x1754, 0x1754, 0x1753, // 54584
-    0x1753, 0x1752, 0x1751, 0x1751, 0x1750, 0x1750, 0x174f, 0x174e, // 54592
-    0x174e, 0x174d, 0x174d, 0x174c, 0x174c, 0x174b, 0x174a, 0x174a, // 54600
-    0x1749, 0x1749, 0x1748, 0x1747, 0x1747, 0x1746, 0x1746, 0x1745, // 54608
-    0x1744, 0x1744, 0x1743, 0x1743, 0x1742, 0x1741, 0x1741, 0x1740, // 54616
-    0x1740, 0x173f, 0x173f, 0x173e, 0x173d, 0x173d, 0x173c, 0x173c, // 54624
-    0x173b, 0x173a, 0x173a, 0x1739, 0x1739, 0x1738, 0x1737, 0x1737, // 54632
-    0x1736, 0x1736, 0x1735, 0x1734, 0x1734, 0x1733, 0x1733, 0x1732, // 54640
-    0x1731, 0x1731, 0x1730, 0x1730, 0x172f, 0x172f, 0x172e, 0x172d, // 54648
-    0x172d, 0x172c, 0x172c, 0x172b, 0x172a, 0x172a, 0x1729, 0x1729, // 54656
-    0x1728, 0x1727, 0x1727, 0x1726, 0x1726, 0x1725, 0x1724, 0x1724, // 54664
-    0x1723, 0x1723, 0x1722, 0x1722, 0x1721, 0x1720, 0x1720, 0x171f, // 54672
-    0x171f, 0x171e, 0x171d, 0x171d, 0x171c, 0x171c, 0x171b, 0x171a, // 54680
-    0x171a, 0x1719, 0x1719, 0x1718, 0x1717, 0x1717, 0x1716, 0x1716, // 54688
-    0x1715, 0x1714, 0x1714, 0x1713, 0x1713, 0x1712, 0x1712, 0x1711, // 54696
-    0x1710, 0x1710, 0x170f, 0x170f, 0x170e, 0x170d, 0x170d, 0x170c, // 54704
-    0x170c, 0x170b, 0x170a, 0x170a, 0x1709, 0x1709, 0x1708, 0x1707, // 54712
-    0x1707, 0x1706, 0x1706, 0x1705, 0x1705, 0x1704, 0x1703, 0x1703, // 54720
-    0x1702, 0x1702, 0x1701, 0x1700, 0x1700, 0x16ff, 0x16ff, 0x16fe, // 54728
-    0x16fd, 0x16fd, 0x16fc, 0x16fc, 0x16fb, 0x16fa, 0x16fa, 0x16f9, // 54736
-    0x16f9, 0x16f8, 0x16f7, 0x16f7, 0x16f6, 0x16f6, 0x16f5, 0x16f5, // 54744
-    0x16f4, 0x16f3, 0x16f3, 0x16f2, 0x16f2, 0x16f1, 0x16f0, 0x16f0, // 54752
-    0x16ef, 0x16ef, 0x16ee, 0x16ed, 0x16ed, 0x16ec, 0x16ec, 0x16eb, // 54760
-    0x16ea, 0x16ea, 0x16e9, 0x16e9, 0x16e8, 0x16e8, 0x16e7, 0x16e6, // 54768
-    0x16e6, 0x16e5, 0x16e5, 0x16e4, 0x16e3, 0x16e3, 0x16e2, 0x16e2, // 54776
-    0x16e1, 0x16e0, 0x16e0, 0x16df, 0x16df, 0x16de, 0x16dd, 0x16dd, // 54784
-    0x16dc, 0x16dc, 0x16db, 0x16da, 0x16da, 0x16d9, 0x16d9, 0x16d8, // 54792
-    0x16d8, 0x16d7, 0x16d6, 0x16d6, 0x16d5, 0x16d5, 0x16d4, 0x16d3, // 54800
-    0x16d3, 0x16d2, 0x16d2, 0x16d1, 0x16d0, 0x16d0, 0x16cf, 0x16cf, // 54808
-    0x16ce, 0x16cd, 0x16cd, 0x16cc, 0x16cc, 0x16cb, 0x16cb, 0x16ca, // 54816
-    0x16c9, 0x16c9, 0x16c8, 0x16c8, 0x16c7, 0x16c6, 0x16c6, 0x16c5, // 54824
-    0x16c5, 0x16c4, 0x16c3, 0x16c3, 0x16c2, 0x16c2, 0x16c1, 0x16c0, // 54832
-    0x16c0, 0x16bf, 0x16bf, 0x16be, 0x16bd, 0x16bd, 0x16bc, 0x16bc, // 54840
-    0x16bb, 0x16bb, 0x16ba, 0x16b9, 0x16b9, 0x16b8, 0x16b8, 0x16b7, // 54848
-    0x16b6, 0x16b6, 0x16b5, 0x16b5, 0x16b4, 0x16b3, 0x16b3, 0x16b2, // 54856
-    0x16b2, 0x16b1, 0x16b0, 0x16b0, 0x16af, 0x16af, 0x16ae, 0x16ae, // 54864
-    0x16ad, 0x16ac, 0x16ac, 0x16ab, 0x16ab, 0x16aa, 0x16a9, 0x16a9, // 54872
-    0x16a8, 0x16a8, 0x16a7, 0x16a6, 0x16a6, 0x16a5, 0x16a5, 0x16a4, // 54880
-    0x16a3, 0x16a3, 0x16a2, 0x16a2, 0x16a1, 0x16a0, 0x16a0, 0x169f, // 54888
-    0x169f, 0x169e, 0x169e, 0x169d, 0x169c, 0x169c, 0x169b, 0x169b, // 54896
-    0x169a, 0x1699, 0x1699, 0x1698, 0x1698, 0x1697, 0x1696, 0x1696, // 54904
-    0x1695, 0x1695, 0x1694, 0x1693, 0x1693, 0x1692, 0x1692, 0x1691, // 54912
-    0x1691, 0x1690, 0x168f, 0x168f, 0x168e, 0x168e, 0x168d, 0x168c, // 54920
-    0x168c, 0x168b, 0x168b, 0x168a, 0x1689, 0x1689, 0x1688, 0x1688, // 54928
-    0x1687, 0x1686, 0x1686, 0x1685, 0x1685, 0x1684, 0x1683, 0x1683, // 54936
-    0x1682, 0x1682, 0x1681, 0x1681, 0x1680, 0x167f, 0x167f, 0x167e, // 54944
-    0x167e, 0x167d, 0x167c, 0x167c, 0x167b, 0x167b, 0x167a, 0x1679, // 54952
-    0x1679, 0x1678, 0x1678, 0x1677, 0x1676, 0x1676, 0x1675, 0x1675, // 54960
-    0x1674, 0x1674, 0x1673, 0x1672, 0x1672, 0x1671, 0x1671, 0x1670, // 54968
-    0x166f, 0x166f, 0x166e, 0x166e, 0x166d, 0x166c, 0x166c, 0x166b, // 54976
-    0x166b, 0x166a, 0x1669, 0x1669, 0x1668, 0x1668, 0x1667, 0x1666, // 54984
-    0x1666, 0x1665, 0x1665, 0x1664, 0x1664, 0x1663, 0x1662, 0x1662, // 54992
-    0x1661, 0x1661, 0x1660, 0x165f, 0x165f, 0x165e, 0x165e, 0x165d, // 55000
-    0x165c, 0x165c, 0x165b, 0x165b, 0x165a, 0x1659, 0x1659, 0x1658, // 55008
-    0x1658, 0x1657, 0x1657, 0x1656, 0x1655, 0x1655, 0x1654, 0x1654, // 55016
-    0x1653, 0x1652, 0x1652, 0x1651, 0x1651, 0x1650, 0x164f, 0x164f, // 55024
-    0x164e, 0x164e, 0x164d, 0x164c, 0x164c, 0x164b, 0x164b, 0x164a, // 55032
-    0x164a, 0x1649, 0x1648, 0x1648, 0x1647, 0x1647, 0x1646, 0x1645, // 55040
-    0x1645, 0x1644, 0x1644, 0x1643, 0x1642, 0x1642, 0x1641, 0x1641, // 55048
-    0x1640, 0x163f, 0x163f, 0x163e, 0x163e, 0x163d, 0x163c, 0x163c, // 55056
-    0x163b, 0x163b, 0x163a, 0x163a, 0x1639, 0x1638, 0x1638, 0x1637, // 55064
-    0x1637, 0x1636, 0x1635, 0x1635, 0x1634, 0x1634, 0x1633, 0x1632, // 55072
-    0x1632, 0x1631, 0x1631, 0x1630, 0x162f, 0x162f, 0x162e, 0x162e, // 55080
-    0x162d, 0x162d, 0x162c, 0x162b, 0x162b, 0x162a, 0x162a, 0x1629, // 55088
-    0x1628, 0x1628, 0x1627, 0x1627, 0x1626, 0x1625, 0x1625, 0x1624, // 55096
-    0x1624, 0x1623, 0x1622, 0x1622, 0x1621, 0x1621, 0x1620, 0x161f, // 55104
-    0x161f, 0x161e, 0x161e, 0x161d, 0x161d, 0x161c, 0x161b, 0x161b, // 55112
-    0x161a, 0x161a, 0x1619, 0x1618, 0x1618, 0x1617, 0x1617, 0x1616, // 55120
-    0x1615, 0x1615, 0x1614, 0x1614, 0x1613, 0x1612, 0x1612, 0x1611, // 55128
-    0x1611, 0x1610, 0x1610, 0x160f, 0x160e, 0x160e, 0x160d, 0x160d, // 55136
-    0x160c, 0x160b, 0x160b, 0x160a, 0x160a, 0x1609, 0x1608, 0x1608, // 55144
-    0x1607, 0x1607, 0x1606, 0x1605, 0x1605, 0x1604, 0x1604, 0x1603, // 55152
-    0x1602, 0x1602, 0x1601, 0x1601, 0x1600, 0x1600, 0x15ff, 0x15fe, // 55160
-    0x15fe, 0x15fd, 0x15fd, 0x15fc, 0x15fb, 0x15fb, 0x15fa, 0x15fa, // 55168
-    0x15f9, 0x15f8, 0x15f8, 0x15f7, 0x15f7, 0x15f6, 0x15f5, 0x15f5, // 55176
-    0x15f4, 0x15f4, 0x15f3, 0x15f3, 0x15f2, 0x15f1, 0x15f1, 0x15f0, // 55184
-    0x15f0, 0x15ef, 0x15ee, 0x15ee, 0x15ed, 0x15ed, 0x15ec, 0x15eb, // 55192
-    0x15eb, 0x15ea, 0x15ea, 0x15e9, 0x15e8, 0x15e8, 0x15e7, 0x15e7, // 55200
-    0x15e6, 0x15e5, 0x15e5, 0x15e4, 0x15e4, 0x15e3, 0x15e3, 0x15e2, // 55208
-    0x15e1, 0x15e1, 0x15e0, 0x15e0, 0x15df, 0x15de, 0x15de, 0x15dd, // 55216
-    0x15dd, 0x15dc, 0x15db, 0x15db, 0x15da, 0x15da, 0x15d9, 0x15d8, // 55224
-    0x15d8, 0x15d7, 0x15d7, 0x15d6, 0x15d6, 0x15d5, 0x15d4, 0x15d4, // 55232
-    0x15d3, 0x15d3, 0x15d2, 0x15d1, 0x15d1, 0x15d0, 0x15d0, 0x15cf, // 55240
-    0x15ce, 0x15ce, 0x15cd, 0x15cd, 0x15cc, 0x15cb, 0x15cb, 0x15ca, // 55248
-    0x15ca, 0x15c9, 0x15c8, 0x15c8, 0x15c7, 0x15c7, 0x15c6, 0x15c6, // 55256
-    0x15c5, 0x15c4, 0x15c4, 0x15c3, 0x15c3, 0x15c2, 0x15c1, 0x15c1, // 55264
-    0x15c0, 0x15c0, 0x15bf, 0x15be, 0x15be, 0x15bd, 0x15bd, 0x15bc, // 55272
-    0x15bb, 0x15bb, 0x15ba, 0x15ba, 0x15b9, 0x15b9, 0x15b8, 0x15b7, // 55280
-    0x15b7, 0x15b6, 0x15b6, 0x15b5, 0x15b4, 0x15b4, 0x15b3, 0x15b3, // 55288
-    0x15b2, 0x15b1, 0x15b0, 0x15b0, 0x15af, 0x15af, 0x15ae, 0x15ad, // 55296
-    0x15ad, 0x15ac, 0x15ac, 0x15ab, 0x15aa, 0x15aa, 0x15a9, 0x15a9, // 55304
-    0x15a8, 0x15a8, 0x15a7, 0x15a6, 0x15a6, 0x15a5, 0x15a5, 0x15a4, // 55312
-    0x15a3, 0x15a3, 0x15a2, 0x15a2, 0x15a1, 0x15a1, 0x15a0, 0x159f, // 55320
-    0x159f, 0x159e, 0x159e, 0x159d, 0x159c, 0x159c, 0x159b, 0x159b, // 55328
-    0x159a, 0x159a, 0x1599, 0x1598, 0x1598, 0x1597, 0x1597, 0x1596, // 55336
-    0x1595, 0x1595, 0x1594, 0x1594, 0x1593, 0x1593, 0x1592, 0x1591, // 55344
-    0x1591, 0x1590, 0x1590, 0x158f, 0x158e, 0x158e, 0x158d, 0x158d, // 55352
-    0x158c, 0x158c, 0x158b, 0x158a, 0x158a, 0x1589, 0x1589, 0x1588, // 55360
-    0x1587, 0x1587, 0x1586, 0x1586, 0x1585, 0x1585, 0x1584, 0x1583, // 55368
-    0x1583, 0x1582, 0x1582, 0x1581, 0x1580, 0x1580, 0x157f, 0x157f, // 55376
-    0x157e, 0x157e, 0x157d, 0x157c, 0x157c, 0x157b, 0x157b, 0x157a, // 55384
-    0x1579, 0x1579, 0x1578, 0x1578, 0x1577, 0x1577, 0x1576, 0x1575, // 55392
-    0x1575, 0x1574, 0x1574, 0x1573, 0x1572, 0x1572, 0x1571, 0x1571, // 55400
-    0x1570, 0x1570, 0x156f, 0x156e, 0x156e, 0x156d, 0x156d, 0x156c, // 55408
-    0x156b, 0x156b, 0x156a, 0x156a, 0x1569, 0x1569, 0x1568, 0x1567, // 55416
-    0x1567, 0x1566, 0x1566, 0x1565, 0x1564, 0x1564, 0x1563, 0x1563, // 55424
-    0x1562, 0x1561, 0x1561, 0x1560, 0x1560, 0x155f, 0x155f, 0x155e, // 55432
-    0x155d, 0x155d, 0x155c, 0x155c, 0x155b, 0x155a, 0x155a, 0x1559, // 55440
-    0x1559, 0x1558, 0x1558, 0x1557, 0x1556, 0x1556, 0x1555, 0x1555, // 55448
-    0x1554, 0x1553, 0x1553, 0x1552, 0x1552, 0x1551, 0x1551, 0x1550, // 55456
-    0x154f, 0x154f, 0x154e, 0x154e, 0x154d, 0x154c, 0x154c, 0x154b, // 55464
-    0x154b, 0x154a, 0x154a, 0x1549, 0x1548, 0x1548, 0x1547, 0x1547, // 55472
-    0x1546, 0x1545, 0x1545, 0x1544, 0x1544, 0x1543, 0x1543, 0x1542, // 55480
-    0x1541, 0x1541, 0x1540, 0x1540, 0x153f, 0x153e, 0x153e, 0x153d, // 55488
-    0x153d, 0x153c, 0x153c, 0x153b, 0x153a, 0x153a, 0x1539, 0x1539, // 55496
-    0x1538, 0x1537, 0x1537, 0x1536, 0x1536, 0x1535, 0x1535, 0x1534, // 55504
-    0x1533, 0x1533, 0x1532, 0x1532, 0x1531, 0x1530, 0x1530, 0x152f, // 55512
-    0x152f, 0x152e, 0x152e, 0x152d, 0x152c, 0x152c, 0x152b, 0x152b, // 55520
-    0x152a, 0x1529, 0x1529, 0x1528, 0x1528, 0x1527, 0x1527, 0x1526, // 55528
-    0x1525, 0x1525, 0x1524, 0x1524, 0x1523, 0x1522, 0x1522, 0x1521, // 55536
-    0x1521, 0x1520, 0x1520, 0x151f, 0x151e, 0x151e, 0x151d, 0x151d, // 55544
-    0x151c, 0x151b, 0x151b, 0x151a, 0x151a, 0x1519, 0x1518, 0x1518, // 55552
-    0x1517, 0x1517, 0x1516, 0x1516, 0x1515, 0x1514, 0x1514, 0x1513, // 55560
-    0x1513, 0x1512, 0x1511, 0x1511, 0x1510, 0x1510, 0x150f, 0x150f, // 55568
-    0x150e, 0x150d, 0x150d, 0x150c, 0x150c, 0x150b, 0x150a, 0x150a, // 55576
-    0x1509, 0x1509, 0x1508, 0x1508, 0x1507, 0x1506, 0x1506, 0x1505, // 55584
-    0x1505, 0x1504, 0x1503, 0x1503, 0x1502, 0x1502, 0x1501, 0x1501, // 55592
-    0x1500, 0x14ff, 0x14ff, 0x14fe, 0x14fe, 0x14fd, 0x14fc, 0x14fc, // 55600
-    0x14fb, 0x14fb, 0x14fa, 0x14fa, 0x14f9, 0x14f8, 0x14f8, 0x14f7, // 55608
-    0x14f7, 0x14f6, 0x14f5, 0x14f5, 0x14f4, 0x14f4, 0x14f3, 0x14f3, // 55616
-    0x14f2, 0x14f1, 0x14f1, 0x14f0, 0x14f0, 0x14ef, 0x14ee, 0x14ee, // 55624
-    0x14ed, 0x14ed, 0x14ec, 0x14ec, 0x14eb, 0x14ea, 0x14ea, 0x14e9, // 55632
-    0x14e9, 0x14e8, 0x14e7, 0x14e7, 0x14e6, 0x14e6, 0x14e5, 0x14e5, // 55640
-    0x14e4, 0x14e3, 0x14e3, 0x14e2, 0x14e2, 0x14e1, 0x14e0, 0x14e0, // 55648
-    0x14df, 0x14df, 0x14de, 0x14de, 0x14dd, 0x14dc, 0x14dc, 0x14db, // 55656
-    0x14db, 0x14da, 0x14d9, 0x14d9, 0x14d8, 0x14d8, 0x14d7, 0x14d7, // 55664
-    0x14d6, 0x14d5, 0x14d5, 0x14d4, 0x14d4, 0x14d3, 0x14d2, 0x14d2, // 55672
-    0x14d1, 0x14d1, 0x14d0, 0x14cf, 0x14cf, 0x14ce, 0x14ce, 0x14cd, // 55680
-    0x14cd, 0x14cc, 0x14cb, 0x14cb, 0x14ca, 0x14ca, 0x14c9, 0x14c8, // 55688
-    0x14c8, 0x14c7, 0x14c7, 0x14c6, 0x14c6, 0x14c5, 0x14c4, 0x14c4, // 55696
-    0x14c3, 0x14c3, 0x14c2, 0x14c1, 0x14c1, 0x14c0, 0x14c0, 0x14bf, // 55704
-    0x14bf, 0x14be, 0x14bd, 0x14bd, 0x14bc, 0x14bc, 0x14bb, 0x14ba, // 55712
-    0x14ba, 0x14b9, 0x14b9, 0x14b8, 0x14b8, 0x14b7, 0x14b6, 0x14b6, // 55720
-    0x14b5, 0x14b5, 0x14b4, 0x14b3, 0x14b3, 0x14b2, 0x14b2, 0x14b1, // 55728
-    0x14b1, 0x14b0, 0x14af, 0x14af, 0x14ae, 0x14ae, 0x14ad, 0x14ac, // 55736
-    0x14ac, 0x14ab, 0x14ab, 0x14aa, 0x14aa, 0x14a9, 0x14a8, 0x14a8, // 55744
-    0x14a7, 0x14a7, 0x14a6, 0x14a5, 0x14a5, 0x14a4, 0x14a4, 0x14a3, // 55752
-    0x14a3, 0x14a2, 0x14a1, 0x14a1, 0x14a0, 0x14a0, 0x149f, 0x149e, // 55760
-    0x149e, 0x149d, 0x149d, 0x149c, 0x149c, 0x149b, 0x149a, 0x149a, // 55768
-    0x1499, 0x1499, 0x1498, 0x1497, 0x1497, 0x1496, 0x1496, 0x1495, // 55776
-    0x1495, 0x1494, 0x1493, 0x1493, 0x1492, 0x1492, 0x1491, 0x1490, // 55784
-    0x1490, 0x148f, 0x148f, 0x148e, 0x148e, 0x148d, 0x148c, 0x148c, // 55792
-    0x148b, 0x148b, 0x148a, 0x1489, 0x1489, 0x1488, 0x1488, 0x1487, // 55800
-    0x1487, 0x1486, 0x1485, 0x1485, 0x1484, 0x1484, 0x1483, 0x1482, // 55808
-    0x1482, 0x1481, 0x1481, 0x1480, 0x147f, 0x147f, 0x147e, 0x147e, // 55816
-    0x147d, 0x147d, 0x147c, 0x147b, 0x147b, 0x147a, 0x147a, 0x1479, // 55824
-    0x1478, 0x1478, 0x1477, 0x1477, 0x1476, 0x1476, 0x1475, 0x1474, // 55832
-    0x1474, 0x1473, 0x1473, 0x1472, 0x1471, 0x1471, 0x1470, 0x1470, // 55840
-    0x146f, 0x146f, 0x146e, 0x146d, 0x146d, 0x146c, 0x146c, 0x146b, // 55848
-    0x146a, 0x146a, 0x1469, 0x1469, 0x1468, 0x1468, 0x1467, 0x1466, // 55856
-    0x1466, 0x1465, 0x1465, 0x1464, 0x1463, 0x1463, 0x1462, 0x1462, // 55864
-    0x1461, 0x1461, 0x1460, 0x145f, 0x145f, 0x145e, 0x145e, 0x145d, // 55872
-    0x145c, 0x145c, 0x145b, 0x145b, 0x145a, 0x145a, 0x1459, 0x1458, // 55880
-    0x1458, 0x1457, 0x1457, 0x1456, 0x1455, 0x1455, 0x1454, 0x1454, // 55888
-    0x1453, 0x1453, 0x1452, 0x1451, 0x1451, 0x1450, 0x1450, 0x144f, // 55896
-    0x144e, 0x144e, 0x144d, 0x144d, 0x144c, 0x144c, 0x144b, 0x144a, // 55904
-    0x144a, 0x1449, 0x1449, 0x1448, 0x1447, 0x1447, 0x1446, 0x1446, // 55912
-    0x1445, 0x1445, 0x1444, 0x1443, 0x1443, 0x1442, 0x1442, 0x1441, // 55920
-    0x1440, 0x1440, 0x143f, 0x143f, 0x143e, 0x143e, 0x143d, 0x143c, // 55928
-    0x143c, 0x143b, 0x143b, 0x143a, 0x1439, 0x1439, 0x1438, 0x1438, // 55936
-    0x1437, 0x1436, 0x1436, 0x1435, 0x1435, 0x1434, 0x1434, 0x1433, // 55944
-    0x1432, 0x1432, 0x1431, 0x1431, 0x1430, 0x142f, 0x142f, 0x142e, // 55952
-    0x142e, 0x142d, 0x142d, 0x142c, 0x142b, 0x142b, 0x142a, 0x142a, // 55960
-    0x1429, 0x1428, 0x1428, 0x1427, 0x1427, 0x1426, 0x1426, 0x1425, // 55968
-    0x1424, 0x1424, 0x1423, 0x1423, 0x1422, 0x1421, 0x1421, 0x1420, // 55976
-    0x1420, 0x141f, 0x141f, 0x141e, 0x141d, 0x141d, 0x141c, 0x141c, // 55984
-    0x141b, 0x141a, 0x141a, 0x1419, 0x1419, 0x1418, 0x1418, 0x1417, // 55992
-    0x1416, 0x1416, 0x1415, 0x1415, 0x1414, 0x1413, 0x1413, 0x1412, // 56000
-    0x1412, 0x1411, 0x1411, 0x1410, 0x140f, 0x140f, 0x140e, 0x140e, // 56008
-    0x140d, 0x140c, 0x140c, 0x140b, 0x140b, 0x140a, 0x140a, 0x1409, // 56016
-    0x1408, 0x1408, 0x1407, 0x1407, 0x1406, 0x1405, 0x1405, 0x1404, // 56024
-    0x1404, 0x1403, 0x1403, 0x1402, 0x1401, 0x1401, 0x1400, 0x1400, // 56032
-    0x13ff, 0x13fe, 0x13fe, 0x13fd, 0x13fd, 0x13fc, 0x13fc, 0x13fb, // 56040
-    0x13fa, 0x13fa, 0x13f9, 0x13f9, 0x13f8, 0x13f7, 0x13f7, 0x13f6, // 56048
-    0x13f6, 0x13f5, 0x13f5, 0x13f4, 0x13f3, 0x13f3, 0x13f2, 0x13f2, // 56056
-    0x13f1, 0x13f0, 0x13f0, 0x13ef, 0x13ef, 0x13ee, 0x13ed, 0x13ed, // 56064
-    0x13ec, 0x13ec, 0x13eb, 0x13eb, 0x13ea, 0x13e9, 0x13e9, 0x13e8, // 56072
-    0x13e8, 0x13e7, 0x13e6, 0x13e6, 0x13e5, 0x13e5, 0x13e4, 0x13e4, // 56080
-    0x13e3, 0x13e2, 0x13e2, 0x13e1, 0x13e1, 0x13e0, 0x13df, 0x13df, // 56088
-    0x13de, 0x13de, 0x13dd, 0x13dd, 0x13dc, 0x13db, 0x13db, 0x13da, // 56096
-    0x13da, 0x13d9, 0x13d8, 0x13d8, 0x13d7, 0x13d7, 0x13d6, 0x13d6, // 56104
-    0x13d5, 0x13d4, 0x13d4, 0x13d3, 0x13d3, 0x13d2, 0x13d1, 0x13d1, // 56112
-    0x13d0, 0x13d0, 0x13cf, 0x13cf, 0x13ce, 0x13cd, 0x13cd, 0x13cc, // 56120
-    0x13cc, 0x13cb, 0x13ca, 0x13ca, 0x13c9, 0x13c9, 0x13c8, 0x13c8, // 56128
-    0x13c7, 0x13c6, 0x13c6, 0x13c5, 0x13c5, 0x13c4, 0x13c3, 0x13c3, // 56136
-    0x13c2, 0x13c2, 0x13c1, 0x13c1, 0x13c0, 0x13bf, 0x13bf, 0x13be, // 56144
-    0x13be, 0x13bd, 0x13bc, 0x13bc, 0x13bb, 0x13bb, 0x13ba, 0x13ba, // 56152
-    0x13b9, 0x13b8, 0x13b8, 0x13b7, 0x13b7, 0x13b6, 0x13b5, 0x13b5, // 56160
-    0x13b4, 0x13b4, 0x13b3, 0x13b3, 0x13b2, 0x13b1, 0x13b1, 0x13b0, // 56168
-    0x13b0, 0x13af, 0x13ae, 0x13ae, 0x13ad, 0x13ad, 0x13ac, 0x13ac, // 56176
-    0x13ab, 0x13aa, 0x13aa, 0x13a9, 0x13a9, 0x13a8, 0x13a7, 0x13a7, // 56184
-    0x13a6, 0x13a6, 0x13a5, 0x13a4, 0x13a4, 0x13a3, 0x13a3, 0x13a2, // 56192
-    0x13a2, 0x13a1, 0x13a0, 0x13a0, 0x139f, 0x139f, 0x139e, 0x139d, // 56200
-    0x139d, 0x139c, 0x139c, 0x139b, 0x139b, 0x139a, 0x1399, 0x1399, // 56208
-    0x1398, 0x1398, 0x1397, 0x1396, 0x1396, 0x1395, 0x1395, 0x1394, // 56216
-    0x1394, 0x1393, 0x1392, 0x1392, 0x1391, 0x1391, 0x1390, 0x138f, // 56224
-    0x138f, 0x138e, 0x138e, 0x138d, 0x138d, 0x138c, 0x138b, 0x138b, // 56232
-    0x138a, 0x138a, 0x1389, 0x1388, 0x1388, 0x1387, 0x1387, 0x1386, // 56240
-    0x1386, 0x1385, 0x1384, 0x1384, 0x1383, 0x1383, 0x1382, 0x1381, // 56248
-    0x1381, 0x1380, 0x1380, 0x137f, 0x137f, 0x137e, 0x137d, 0x137d, // 56256
-    0x137c, 0x137c, 0x137b, 0x137a, 0x137a, 0x1379, 0x1379, 0x1378, // 56264
-    0x1378, 0x1377, 0x1376, 0x1376, 0x1375, 0x1375, 0x1374, 0x1373, // 56272
-    0x1373, 0x1372, 0x1372, 0x1371, 0x1371, 0x1370, 0x136f, 0x136f, // 56280
-    0x136e, 0x136e, 0x136d, 0x136c, 0x136c, 0x136b, 0x136b, 0x136a, // 56288
-    0x136a, 0x1369, 0x1368, 0x1368, 0x1367, 0x1367, 0x1366, 0x1365, // 56296
-    0x1365, 0x1364, 0x1364, 0x1363, 0x1363, 0x1362, 0x1361, 0x1361, // 56304
-    0x1360, 0x1360, 0x135f, 0x135e, 0x135e, 0x135d, 0x135d, 0x135c, // 56312
-    0x135b, 0x135a, 0x135a, 0x1359, 0x1359, 0x1358, 0x1358, 0x1357, // 56320
-    0x1356, 0x1356, 0x1355, 0x1355, 0x1354, 0x1354, 0x1353, 0x1352, // 56328
-    0x1352, 0x1351, 0x1351, 0x1350, 0x1350, 0x134f, 0x134e, 0x134e, // 56336
-    0x134d, 0x134d, 0x134c, 0x134c, 0x134b, 0x134a, 0x134a, 0x1349, // 56344
-    0x1349, 0x1348, 0x1348, 0x1347, 0x1346, 0x1346, 0x1345, 0x1345, // 56352
-    0x1344, 0x1344, 0x1343, 0x1342, 0x1342, 0x1341, 0x1341, 0x1340, // 56360
-    0x1340, 0x133f, 0x133e, 0x133e, 0x133d, 0x133d, 0x133c, 0x133c, // 56368
-    0x133b, 0x133a, 0x133a, 0x1339, 0x1339, 0x1338, 0x1338, 0x1337, // 56376
-    0x1336, 0x1336, 0x1335, 0x1335, 0x1334, 0x1334, 0x1333, 0x1332, // 56384
-    0x1332, 0x1331, 0x1331, 0x1330, 0x1330, 0x132f, 0x132e, 0x132e, // 56392
-    0x132d, 0x132d, 0x132c, 0x132c, 0x132b, 0x132a, 0x132a, 0x1329, // 56400
-    0x1329, 0x1328, 0x1327, 0x1327, 0x1326, 0x1326, 0x1325, 0x1325, // 56408
-    0x1324, 0x1323, 0x1323, 0x1322, 0x1322, 0x1321, 0x1321, 0x1320, // 56416
-    0x131f, 0x131f, 0x131e, 0x131e, 0x131d, 0x131d, 0x131c, 0x131b, // 56424
-    0x131b, 0x131a, 0x131a, 0x1319, 0x1319, 0x1318, 0x1317, 0x1317, // 56432
-    0x1316, 0x1316, 0x1315, 0x1315, 0x1314, 0x1313, 0x1313, 0x1312, // 56440
-    0x1312, 0x1311, 0x1311, 0x1310, 0x130f, 0x130f, 0x130e, 0x130e, // 56448
-    0x130d, 0x130d, 0x130c, 0x130b, 0x130b, 0x130a, 0x130a, 0x1309, // 56456
-    0x1309, 0x1308, 0x1307, 0x1307, 0x1306, 0x1306, 0x1305, 0x1305, // 56464
-    0x1304, 0x1303, 0x1303, 0x1302, 0x1302, 0x1301, 0x1301, 0x1300, // 56472
-    0x12ff, 0x12ff, 0x12fe, 0x12fe, 0x12fd, 0x12fd, 0x12fc, 0x12fb, // 56480
-    0x12fb, 0x12fa, 0x12fa, 0x12f9, 0x12f9, 0x12f8, 0x12f7, 0x12f7, // 56488
-    0x12f6, 0x12f6, 0x12f5, 0x12f5, 0x12f4, 0x12f3, 0x12f3, 0x12f2, // 56496
-    0x12f2, 0x12f1, 0x12f1, 0x12f0, 0x12ef, 0x12ef, 0x12ee, 0x12ee, // 56504
-    0x12ed, 0x12ed, 0x12ec, 0x12eb, 0x12eb, 0x12ea, 0x12ea, 0x12e9, // 56512
-    0x12e9, 0x12e8, 0x12e7, 0x12e7, 0x12e6, 0x12e6, 0x12e5, 0x12e5, // 56520
-    0x12e4, 0x12e3, 0x12e3, 0x12e2, 0x12e2, 0x12e1, 0x12e1, 0x12e0, // 56528
-    0x12df, 0x12df, 0x12de, 0x12de, 0x12dd, 0x12dd, 0x12dc, 0x12db, // 56536
-    0x12db, 0x12da, 0x12da, 0x12d9, 0x12d9, 0x12d8, 0x12d7, 0x12d7, // 56544
-    0x12d6, 0x12d6, 0x12d5, 0x12d5, 0x12d4, 0x12d3, 0x12d3, 0x12d2, // 56552
-    0x12d2, 0x12d1, 0x12d1, 0x12d0, 0x12cf, 0x12cf, 0x12ce, 0x12ce, // 56560
-    0x12cd, 0x12cd, 0x12cc, 0x12cb, 0x12cb, 0x12ca, 0x12ca, 0x12c9, // 56568
-    0x12c9, 0x12c8, 0x12c7, 0x12c7, 0x12c6, 0x12c6, 0x12c5, 0x12c4, // 56576
-    0x12c4, 0x12c3, 0x12c3, 0x12c2, 0x12c2, 0x12c1, 0x12c0, 0x12c0, // 56584
-    0x12bf, 0x12bf, 0x12be, 0x12be, 0x12bd, 0x12bc, 0x12bc, 0x12bb, // 56592
-    0x12bb, 0x12ba, 0x12ba, 0x12b9, 0x12b8, 0x12b8, 0x12b7, 0x12b7, // 56600
-    0x12b6, 0x12b6, 0x12b5, 0x12b4, 0x12b4, 0x12b3, 0x12b3, 0x12b2, // 56608
-    0x12b2, 0x12b1, 0x12b0, 0x12b0, 0x12af, 0x12af, 0x12ae, 0x12ae, // 56616
-    0x12ad, 0x12ac, 0x12ac, 0x12ab, 0x12ab, 0x12aa, 0x12aa, 0x12a9, // 56624
-    0x12a8, 0x12a8, 0x12a7, 0x12a7, 0x12a6, 0x12a6, 0x12a5, 0x12a4, // 56632
-    0x12a4, 0x12a3, 0x12a3, 0x12a2, 0x12a2, 0x12a1, 0x12a0, 0x12a0, // 56640
-    0x129f, 0x129f, 0x129e, 0x129e, 0x129d, 0x129c, 0x129c, 0x129b, // 56648
-    0x129b, 0x129a, 0x129a, 0x1299, 0x1298, 0x1298, 0x1297, 0x1297, // 56656
-    0x1296, 0x1296, 0x1295, 0x1294, 0x1294, 0x1293, 0x1293, 0x1292, // 56664
-    0x1292, 0x1291, 0x1290, 0x1290, 0x128f, 0x128f, 0x128e, 0x128e, // 56672
-    0x128d, 0x128c, 0x128c, 0x128b, 0x128b, 0x128a, 0x128a, 0x1289, // 56680
-    0x1288, 0x1288, 0x1287, 0x1287, 0x1286, 0x1286, 0x1285, 0x1284, // 56688
-    0x1284, 0x1283, 0x1283, 0x1282, 0x1282, 0x1281, 0x1280, 0x1280, // 56696
-    0x127f, 0x127f, 0x127e, 0x127e, 0x127d, 0x127c, 0x127c, 0x127b, // 56704
-    0x127b, 0x127a, 0x127a, 0x1279, 0x1278, 0x1278, 0x1277, 0x1277, // 56712
-    0x1276, 0x1276, 0x1275, 0x1274, 0x1274, 0x1273, 0x1273, 0x1272, // 56720
-    0x1272, 0x1271, 0x1270, 0x1270, 0x126f, 0x126f, 0x126e, 0x126e, // 56728
-    0x126d, 0x126c, 0x126c, 0x126b, 0x126b, 0x126a, 0x126a, 0x1269, // 56736
-    0x1268, 0x1268, 0x1267, 0x1267, 0x1266, 0x1265, 0x1265, 0x1264, // 56744
-    0x1264, 0x1263, 0x1263, 0x1262, 0x1261, 0x1261, 0x1260, 0x1260, // 56752
-    0x125f, 0x125f, 0x125e, 0x125d, 0x125d, 0x125c, 0x125c, 0x125b, // 56760
-    0x125b, 0x125a, 0x1259, 0x1259, 0x1258, 0x1258, 0x1257, 0x1257, // 56768
-    0x1256, 0x1255, 0x1255, 0x1254, 0x1254, 0x1253, 0x1253, 0x1252, // 56776
-    0x1251, 0x1251, 0x1250, 0x1250, 0x124f, 0x124f, 0x124e, 0x124d, // 56784
-    0x124d, 0x124c, 0x124c, 0x124b, 0x124b, 0x124a, 0x1249, 0x1249, // 56792
-    0x1248, 0x1248, 0x1247, 0x1247, 0x1246, 0x1245, 0x1245, 0x1244, // 56800
-    0x1244, 0x1243, 0x1243, 0x1242, 0x1241, 0x1241, 0x1240, 0x1240, // 56808
-    0x123f, 0x123f, 0x123e, 0x123d, 0x123d, 0x123c, 0x123c, 0x123b, // 56816
-    0x123b, 0x123a, 0x1239, 0x1239, 0x1238, 0x1238, 0x1237, 0x1237, // 56824
-    0x1236, 0x1235, 0x1235, 0x1234, 0x1234, 0x1233, 0x1233, 0x1232, // 56832
-    0x1231, 0x1231, 0x1230, 0x1230, 0x122f, 0x122f, 0x122e, 0x122d, // 56840
-    0x122d, 0x122c, 0x122c, 0x122b, 0x122b, 0x122a, 0x1229, 0x1229, // 56848
-    0x1228, 0x1228, 0x1227, 0x1227, 0x1226, 0x1225, 0x1225, 0x1224, // 56856
-    0x1224, 0x1223, 0x1223, 0x1222, 0x1221, 0x1221, 0x1220, 0x1220, // 56864
-    0x121f, 0x121f, 0x121e, 0x121d, 0x121d, 0x121c, 0x121c, 0x121b, // 56872
-    0x121b, 0x121a, 0x1219, 0x1219, 0x1218, 0x1218, 0x1217, 0x1217, // 56880
-    0x1216, 0x1215, 0x1215, 0x1214, 0x1214, 0x1213, 0x1213, 0x1212, // 56888
-    0x1211, 0x1211, 0x1210, 0x1210, 0x120f, 0x120f, 0x120e, 0x120d, // 56896
-    0x120d, 0x120c, 0x120c, 0x120b, 0x120b, 0x120a, 0x1209, 0x1209, // 56904
-    0x1208, 0x1208, 0x1207, 0x1207, 0x1206, 0x1205, 0x1205, 0x1204, // 56912
-    0x1204, 0x1203, 0x1202, 0x1202, 0x1201, 0x1201, 0x1200, 0x1200, // 56920
-    0x11ff, 0x11fe, 0x11fe, 0x11fd, 0x11fd, 0x11fc, 0x11fc, 0x11fb, // 56928
-    0x11fa, 0x11fa, 0x11f9, 0x11f9, 0x11f8, 0x11f8, 0x11f7, 0x11f6, // 56936
-    0x11f6, 0x11f5, 0x11f5, 0x11f4, 0x11f4, 0x11f3, 0x11f2, 0x11f2, // 56944
-    0x11f1, 0x11f1, 0x11f0, 0x11f0, 0x11ef, 0x11ee, 0x11ee, 0x11ed, // 56952
-    0x11ed, 0x11ec, 0x11ec, 0x11eb, 0x11ea, 0x11ea, 0x11e9, 0x11e9, // 56960
-    0x11e8, 0x11e8, 0x11e7, 0x11e6, 0x11e6, 0x11e5, 0x11e5, 0x11e4, // 56968
-    0x11e4, 0x11e3, 0x11e2, 0x11e2, 0x11e1, 0x11e1, 0x11e0, 0x11e0, // 56976
-    0x11df, 0x11de, 0x11de, 0x11dd, 0x11dd, 0x11dc, 0x11dc, 0x11db, // 56984
-    0x11da, 0x11da, 0x11d9, 0x11d9, 0x11d8, 0x11d8, 0x11d7, 0x11d6, // 56992
-    0x11d6, 0x11d5, 0x11d5, 0x11d4, 0x11d4, 0x11d3, 0x11d2, 0x11d2, // 57000
-    0x11d1, 0x11d1, 0x11d0, 0x11d0, 0x11cf, 0x11ce, 0x11ce, 0x11cd, // 57008
-    0x11cd, 0x11cc, 0x11cc, 0x11cb, 0x11ca, 0x11ca, 0x11c9, 0x11c9, // 57016
-    0x11c8, 0x11c8, 0x11c7, 0x11c6, 0x11c6, 0x11c5, 0x11c5, 0x11c4, // 57024
-    0x11c4, 0x11c3, 0x11c2, 0x11c2, 0x11c1, 0x11c1, 0x11c0, 0x11c0, // 57032
-    0x11bf, 0x11be, 0x11be, 0x11bd, 0x11bd, 0x11bc, 0x11bc, 0x11bb, // 57040
-    0x11ba, 0x11ba, 0x11b9, 0x11b9, 0x11b8, 0x11b8, 0x11b7, 0x11b6, // 57048
-    0x11b6, 0x11b5, 0x11b5, 0x11b4, 0x11b4, 0x11b3, 0x11b2, 0x11b2, // 57056
-    0x11b1, 0x11b1, 0x11b0, 0x11b0, 0x11af, 0x11ae, 0x11ae, 0x11ad, // 57064
-    0x11ad, 0x11ac, 0x11ac, 0x11ab, 0x11aa, 0x11aa, 0x11a9, 0x11a9, // 57072
-    0x11a8, 0x11a8, 0x11a7, 0x11a6, 0x11a6, 0x11a5, 0x11a5, 0x11a4, // 57080
-    0x11a4, 0x11a3, 0x11a2, 0x11a2, 0x11a1, 0x11a1, 0x11a0, 0x119f, // 57088
-    0x119f, 0x119e, 0x119e, 0x119d, 0x119d, 0x119c, 0x119b, 0x119b, // 57096
-    0x119a, 0x119a, 0x1199, 0x1199, 0x1198, 0x1197, 0x1197, 0x1196, // 57104
-    0x1196, 0x1195, 0x1195, 0x1194, 0x1193, 0x1193, 0x1192, 0x1192, // 57112
-    0x1191, 0x1191, 0x1190, 0x118f, 0x118f, 0x118e, 0x118e, 0x118d, // 57120
-    0x118d, 0x118c, 0x118b, 0x118b, 0x118a, 0x118a, 0x1189, 0x1189, // 57128
-    0x1188, 0x1187, 0x1187, 0x1186, 0x1186, 0x1185, 0x1185, 0x1184, // 57136
-    0x1183, 0x1183, 0x1182, 0x1182, 0x1181, 0x1181, 0x1180, 0x117f, // 57144
-    0x117f, 0x117e, 0x117e, 0x117d, 0x117d, 0x117c, 0x117b, 0x117b, // 57152
-    0x117a, 0x117a, 0x1179, 0x1179, 0x1178, 0x1177, 0x1177, 0x1176, // 57160
-    0x1176, 0x1175, 0x1175, 0x1174, 0x1173, 0x1173, 0x1172, 0x1172, // 57168
-    0x1171, 0x1171, 0x1170, 0x116f, 0x116f, 0x116e, 0x116e, 0x116d, // 57176
-    0x116d, 0x116c, 0x116b, 0x116b, 0x116a, 0x116a, 0x1169, 0x1169, // 57184
-    0x1168, 0x1167, 0x1167, 0x1166, 0x1166, 0x1165, 0x1165, 0x1164, // 57192
-    0x1163, 0x1163, 0x1162, 0x1162, 0x1161, 0x1161, 0x1160, 0x115f, // 57200
-    0x115f, 0x115e, 0x115e, 0x115d, 0x115d, 0x115c, 0x115b, 0x115b, // 57208
-    0x115a, 0x115a, 0x1159, 0x1159, 0x1158, 0x1157, 0x1157, 0x1156, // 57216
-    0x1156, 0x1155, 0x1155, 0x1154, 0x1153, 0x1153, 0x1152, 0x1152, // 57224
-    0x1151, 0x1151, 0x1150, 0x114f, 0x114f, 0x114e, 0x114e, 0x114d, // 57232
-    0x114d, 0x114c, 0x114b, 0x114b, 0x114a, 0x114a, 0x1149, 0x1149, // 57240
-    0x1148, 0x1147, 0x1147, 0x1146, 0x1146, 0x1145, 0x1145, 0x1144, // 57248
-    0x1143, 0x1143, 0x1142, 0x1142, 0x1141, 0x1140, 0x1140, 0x113f, // 57256
-    0x113f, 0x113e, 0x113e, 0x113d, 0x113c, 0x113c, 0x113b, 0x113b, // 57264
-    0x113a, 0x113a, 0x1139, 0x1138, 0x1138, 0x1137, 0x1137, 0x1136, // 57272
-    0x1136, 0x1135, 0x1134, 0x1134, 0x1133, 0x1133, 0x1132, 0x1132, // 57280
-    0x1131, 0x1130, 0x1130, 0x112f, 0x112f, 0x112e, 0x112e, 0x112d, // 57288
-    0x112c, 0x112c, 0x112b, 0x112b, 0x112a, 0x112a, 0x1129, 0x1128, // 57296
-    0x1128, 0x1127, 0x1127, 0x1126, 0x1126, 0x1125, 0x1124, 0x1124, // 57304
-    0x1123, 0x1123, 0x1122, 0x1122, 0x1121, 0x1120, 0x1120, 0x111f, // 57312
-    0x111f, 0x111e, 0x111e, 0x111d, 0x111c, 0x111c, 0x111b, 0x111b, // 57320
-    0x111a, 0x111a, 0x1119, 0x1118, 0x1118, 0x1117, 0x1117, 0x1116, // 57328
-    0x1116, 0x1115, 0x1114, 0x1114, 0x1113, 0x1113, 0x1112, 0x1112, // 57336
-    0x1111, 0x1110, 0x110f, 0x110f, 0x110e, 0x110e, 0x110d, 0x110d, // 57344
-    0x110c, 0x110b, 0x110b, 0x110a, 0x110a, 0x1109, 0x1109, 0x1108, // 57352
-    0x1107, 0x1107, 0x1106, 0x1106, 0x1105, 0x1105, 0x1104, 0x1104, // 57360
-    0x1103, 0x1102, 0x1102, 0x1101, 0x1101, 0x1100, 0x1100, 0x10ff, // 57368
-    0x10fe, 0x10fe, 0x10fd, 0x10fd, 0x10fc, 0x10fc, 0x10fb, 0x10fa, // 57376
-    0x10fa, 0x10f9, 0x10f9, 0x10f8, 0x10f8, 0x10f7, 0x10f7, 0x10f6, // 57384
-    0x10f5, 0x10f5, 0x10f4, 0x10f4, 0x10f3, 0x10f3, 0x10f2, 0x10f1, // 57392
-    0x10f1, 0x10f0, 0x10f0, 0x10ef, 0x10ef, 0x10ee, 0x10ee, 0x10ed, // 57400
-    0x10ec, 0x10ec, 0x10eb, 0x10eb, 0x10ea, 0x10ea, 0x10e9, 0x10e8, // 57408
-    0x10e8, 0x10e7, 0x10e7, 0x10e6, 0x10e6, 0x10e5, 0x10e4, 0x10e4, // 57416
-    0x10e3, 0x10e3, 0x10e2, 0x10e2, 0x10e1, 0x10e1, 0x10e0, 0x10df, // 57424
-    0x10df, 0x10de, 0x10de, 0x10dd, 0x10dd, 0x10dc, 0x10db, 0x10db, // 57432
-    0x10da, 0x10da, 0x10d9, 0x10d9, 0x10d8, 0x10d7, 0x10d7, 0x10d6, // 57440
-    0x10d6, 0x10d5, 0x10d5, 0x10d4, 0x10d4, 0x10d3, 0x10d2, 0x10d2, // 57448
-    0x10d1, 0x10d1, 0x10d0, 0x10d0, 0x10cf, 0x10ce, 0x10ce, 0x10cd, // 57456
-    0x10cd, 0x10cc, 0x10cc, 0x10cb, 0x10cb, 0x10ca, 0x10c9, 0x10c9, // 57464
-    0x10c8, 0x10c8, 0x10c7, 0x10c7, 0x10c6, 0x10c5, 0x10c5, 0x10c4, // 57472
-    0x10c4, 0x10c3, 0x10c3, 0x10c2, 0x10c1, 0x10c1, 0x10c0, 0x10c0, // 57480
-    0x10bf, 0x10bf, 0x10be, 0x10be, 0x10bd, 0x10bc, 0x10bc, 0x10bb, // 57488
-    0x10bb, 0x10ba, 0x10ba, 0x10b9, 0x10b8, 0x10b8, 0x10b7, 0x10b7, // 57496
-    0x10b6, 0x10b6, 0x10b5, 0x10b4, 0x10b4, 0x10b3, 0x10b3, 0x10b2, // 57504
-    0x10b2, 0x10b1, 0x10b1, 0x10b0, 0x10af, 0x10af, 0x10ae, 0x10ae, // 57512
-    0x10ad, 0x10ad, 0x10ac, 0x10ab, 0x10ab, 0x10aa, 0x10aa, 0x10a9, // 57520
-    0x10a9, 0x10a8, 0x10a8, 0x10a7, 0x10a6, 0x10a6, 0x10a5, 0x10a5, // 57528
-    0x10a4, 0x10a4, 0x10a3, 0x10a2, 0x10a2, 0x10a1, 0x10a1, 0x10a0, // 57536
-    0x10a0, 0x109f, 0x109e, 0x109e, 0x109d, 0x109d, 0x109c, 0x109c, // 57544
-    0x109b, 0x109b, 0x109a, 0x1099, 0x1099, 0x1098, 0x1098, 0x1097, // 57552
-    0x1097, 0x1096, 0x1095, 0x1095, 0x1094, 0x1094, 0x1093, 0x1093, // 57560
-    0x1092, 0x1091, 0x1091, 0x1090, 0x1090, 0x108f, 0x108f, 0x108e, // 57568
-    0x108e, 0x108d, 0x108c, 0x108c, 0x108b, 0x108b, 0x108a, 0x108a, // 57576
-    0x1089, 0x1088, 0x1088, 0x1087, 0x1087, 0x1086, 0x1086, 0x1085, // 57584
-    0x1085, 0x1084, 0x1083, 0x1083, 0x1082, 0x1082, 0x1081, 0x1081, // 57592
-    0x1080, 0x107f, 0x107f, 0x107e, 0x107e, 0x107d, 0x107d, 0x107c, // 57600
-    0x107b, 0x107b, 0x107a, 0x107a, 0x1079, 0x1079, 0x1078, 0x1078, // 57608
-    0x1077, 0x1076, 0x1076, 0x1075, 0x1075, 0x1074, 0x1074, 0x1073, // 57616
-    0x1072, 0x1072, 0x1071, 0x1071, 0x1070, 0x1070, 0x106f, 0x106f, // 57624
-    0x106e, 0x106d, 0x106d, 0x106c, 0x106c, 0x106b, 0x106b, 0x106a, // 57632
-    0x1069, 0x1069, 0x1068, 0x1068, 0x1067, 0x1067, 0x1066, 0x1065, // 57640
-    0x1065, 0x1064, 0x1064, 0x1063, 0x1063, 0x1062, 0x1062, 0x1061, // 57648
-    0x1060, 0x1060, 0x105f, 0x105f, 0x105e, 0x105e, 0x105d, 0x105c, // 57656
-    0x105c, 0x105b, 0x105b, 0x105a, 0x105a, 0x1059, 0x1058, 0x1058, // 57664
-    0x1057, 0x1057, 0x1056, 0x1056, 0x1055, 0x1055, 0x1054, 0x1053, // 57672
-    0x1053, 0x1052, 0x1052, 0x1051, 0x1051, 0x1050, 0x104f, 0x104f, // 57680
-    0x104e, 0x104e, 0x104d, 0x104d, 0x104c, 0x104c, 0x104b, 0x104a, // 57688
-    0x104a, 0x1049, 0x1049, 0x1048, 0x1048, 0x1047, 0x1046, 0x1046, // 57696
-    0x1045, 0x1045, 0x1044, 0x1044, 0x1043, 0x1042, 0x1042, 0x1041, // 57704
-    0x1041, 0x1040, 0x1040, 0x103f, 0x103f, 0x103e, 0x103d, 0x103d, // 57712
-    0x103c, 0x103c, 0x103b, 0x103b, 0x103a, 0x1039, 0x1039, 0x1038, // 57720
-    0x1038, 0x1037, 0x1037, 0x1036, 0x1035, 0x1035, 0x1034, 0x1034, // 57728
-    0x1033, 0x1033, 0x1032, 0x1032, 0x1031, 0x1030, 0x1030, 0x102f, // 57736
-    0x102f, 0x102e, 0x102e, 0x102d, 0x102c, 0x102c, 0x102b, 0x102b, // 57744
-    0x102a, 0x102a, 0x1029, 0x1029, 0x1028, 0x1027, 0x1027, 0x1026, // 57752
-    0x1026, 0x1025, 0x1025, 0x1024, 0x1023, 0x1023, 0x1022, 0x1022, // 57760
-    0x1021, 0x1021, 0x1020, 0x101f, 0x101f, 0x101e, 0x101e, 0x101d, // 57768
-    0x101d, 0x101c, 0x101c, 0x101b, 0x101a, 0x101a, 0x1019, 0x1019, // 57776
-    0x1018, 0x1018, 0x1017, 0x1016, 0x1016, 0x1015, 0x1015, 0x1014, // 57784
-    0x1014, 0x1013, 0x1012, 0x1012, 0x1011, 0x1011, 0x1010, 0x1010, // 57792
-    0x100f, 0x100f, 0x100e, 0x100d, 0x100d, 0x100c, 0x100c, 0x100b, // 57800
-    0x100b, 0x100a, 0x1009, 0x1009, 0x1008, 0x1008, 0x1007, 0x1007, // 57808
-    0x1006, 0x1006, 0x1005, 0x1004, 0x1004, 0x1003, 0x1003, 0x1002, // 57816
-    0x1002, 0x1001, 0x1000, 0x1000, 0x0fff, 0x0fff, 0x0ffe, 0x0ffe, // 57824
-    0x0ffd, 0x0ffc, 0x0ffc, 0x0ffb, 0x0ffb, 0x0ffa, 0x0ffa, 0x0ff9, // 57832
-    0x0ff9, 0x0ff8, 0x0ff7, 0x0ff7, 0x0ff6, 0x0ff6, 0x0ff5, 0x0ff5, // 57840
-    0x0ff4, 0x0ff3, 0x0ff3, 0x0ff2, 0x0ff2, 0x0ff1, 0x0ff1, 0x0ff0, // 57848
-    0x0ff0, 0x0fef, 0x0fee, 0x0fee, 0x0fed, 0x0fed, 0x0fec, 0x0fec, // 57856
-    0x0feb, 0x0fea, 0x0fea, 0x0fe9, 0x0fe9, 0x0fe8, 0x0fe8, 0x0fe7, // 57864
-    0x0fe6, 0x0fe6, 0x0fe5, 0x0fe5, 0x0fe4, 0x0fe4, 0x0fe3, 0x0fe3, // 57872
-    0x0fe2, 0x0fe1, 0x0fe1, 0x0fe0, 0x0fe0, 0x0fdf, 0x0fdf, 0x0fde, // 57880
-    0x0fdd, 0x0fdd, 0x0fdc, 0x0fdc, 0x0fdb, 0x0fdb, 0x0fda, 0x0fd9, // 57888
-    0x0fd9, 0x0fd8, 0x0fd8, 0x0fd7, 0x0fd7, 0x0fd6, 0x0fd6, 0x0fd5, // 57896
-    0x0fd4, 0x0fd4, 0x0fd3, 0x0fd3, 0x0fd2, 0x0fd2, 0x0fd1, 0x0fd0, // 57904
-    0x0fd0, 0x0fcf, 0x0fcf, 0x0fce, 0x0fce, 0x0fcd, 0x0fcd, 0x0fcc, // 57912
-    0x0fcb, 0x0fcb, 0x0fca, 0x0fca, 0x0fc9, 0x0fc9, 0x0fc8, 0x0fc7, // 57920
-    0x0fc7, 0x0fc6, 0x0fc6, 0x0fc5, 0x0fc5, 0x0fc4, 0x0fc3, 0x0fc3, // 57928
-    0x0fc2, 0x0fc2, 0x0fc1, 0x0fc1, 0x0fc0, 0x0fc0, 0x0fbf, 0x0fbe, // 57936
-    0x0fbe, 0x0fbd, 0x0fbd, 0x0fbc, 0x0fbc, 0x0fbb, 0x0fba, 0x0fba, // 57944
-    0x0fb9, 0x0fb9, 0x0fb8, 0x0fb8, 0x0fb7, 0x0fb6, 0x0fb6, 0x0fb5, // 57952
-    0x0fb5, 0x0fb4, 0x0fb4, 0x0fb3, 0x0fb3, 0x0fb2, 0x0fb1, 0x0fb1, // 57960
-    0x0fb0, 0x0fb0, 0x0faf, 0x0faf, 0x0fae, 0x0fad, 0x0fad, 0x0fac, // 57968
-    0x0fac, 0x0fab, 0x0fab, 0x0faa, 0x0faa, 0x0fa9, 0x0fa8, 0x0fa8, // 57976
-    0x0fa7, 0x0fa7, 0x0fa6, 0x0fa6, 0x0fa5, 0x0fa4, 0x0fa4, 0x0fa3, // 57984
-    0x0fa3, 0x0fa2, 0x0fa2, 0x0fa1, 0x0fa0, 0x0fa0, 0x0f9f, 0x0f9f, // 57992
-    0x0f9e, 0x0f9e, 0x0f9d, 0x0f9d, 0x0f9c, 0x0f9b, 0x0f9b, 0x0f9a, // 58000
-    0x0f9a, 0x0f99, 0x0f99, 0x0f98, 0x0f97, 0x0f97, 0x0f96, 0x0f96, // 58008
-    0x0f95, 0x0f95, 0x0f94, 0x0f93, 0x0f93, 0x0f92, 0x0f92, 0x0f91, // 58016
-    0x0f91, 0x0f90, 0x0f90, 0x0f8f, 0x0f8e, 0x0f8e, 0x0f8d, 0x0f8d, // 58024
-    0x0f8c, 0x0f8c, 0x0f8b, 0x0f8a, 0x0f8a, 0x0f89, 0x0f89, 0x0f88, // 58032
-    0x0f88, 0x0f87, 0x0f87, 0x0f86, 0x0f85, 0x0f85, 0x0f84, 0x0f84, // 58040
-    0x0f83, 0x0f83, 0x0f82, 0x0f81, 0x0f81, 0x0f80, 0x0f80, 0x0f7f, // 58048
-    0x0f7f, 0x0f7e, 0x0f7d, 0x0f7d, 0x0f7c, 0x0f7c, 0x0f7b, 0x0f7b, // 58056
-    0x0f7a, 0x0f7a, 0x0f79, 0x0f78, 0x0f78, 0x0f77, 0x0f77, 0x0f76, // 58064
-    0x0f76, 0x0f75, 0x0f74, 0x0f74, 0x0f73, 0x0f73, 0x0f72, 0x0f72, // 58072
-    0x0f71, 0x0f70, 0x0f70, 0x0f6f, 0x0f6f, 0x0f6e, 0x0f6e, 0x0f6d, // 58080
-    0x0f6d, 0x0f6c, 0x0f6b, 0x0f6b, 0x0f6a, 0x0f6a, 0x0f69, 0x0f69, // 58088
-    0x0f68, 0x0f67, 0x0f67, 0x0f66, 0x0f66, 0x0f65, 0x0f65, 0x0f64, // 58096
-    0x0f64, 0x0f63, 0x0f62, 0x0f62, 0x0f61, 0x0f61, 0x0f60, 0x0f60, // 58104
-    0x0f5f, 0x0f5e, 0x0f5e, 0x0f5d, 0x0f5d, 0x0f5c, 0x0f5c, 0x0f5b, // 58112
-    0x0f5a, 0x0f5a, 0x0f59, 0x0f59, 0x0f58, 0x0f58, 0x0f57, 0x0f57, // 58120
-    0x0f56, 0x0f55, 0x0f55, 0x0f54, 0x0f54, 0x0f53, 0x0f53, 0x0f52, // 58128
-    0x0f51, 0x0f51, 0x0f50, 0x0f50, 0x0f4f, 0x0f4f, 0x0f4e, 0x0f4e, // 58136
-    0x0f4d, 0x0f4c, 0x0f4c, 0x0f4b, 0x0f4b, 0x0f4a, 0x0f4a, 0x0f49, // 58144
-    0x0f48, 0x0f48, 0x0f47, 0x0f47, 0x0f46, 0x0f46, 0x0f45, 0x0f44, // 58152
-    0x0f44, 0x0f43, 0x0f43, 0x0f42, 0x0f42, 0x0f41, 0x0f41, 0x0f40, // 58160
-    0x0f3f, 0x0f3f, 0x0f3e, 0x0f3e, 0x0f3d, 0x0f3d, 0x0f3c, 0x0f3b, // 58168
-    0x0f3b, 0x0f3a, 0x0f3a, 0x0f39, 0x0f39, 0x0f38, 0x0f37, 0x0f37, // 58176
-    0x0f36, 0x0f36, 0x0f35, 0x0f35, 0x0f34, 0x0f34, 0x0f33, 0x0f32, // 58184
-    0x0f32, 0x0f31, 0x0f31, 0x0f30, 0x0f30, 0x0f2f, 0x0f2e, 0x0f2e, // 58192
-    0x0f2d, 0x0f2d, 0x0f2c, 0x0f2c, 0x0f2b, 0x0f2b, 0x0f2a, 0x0f29, // 58200
-    0x0f29, 0x0f28, 0x0f28, 0x0f27, 0x0f27, 0x0f26, 0x0f25, 0x0f25, // 58208
-    0x0f24, 0x0f24, 0x0f23, 0x0f23, 0x0f22, 0x0f21, 0x0f21, 0x0f20, // 58216
-    0x0f20, 0x0f1f, 0x0f1f, 0x0f1e, 0x0f1e, 0x0f1d, 0x0f1c, 0x0f1c, // 58224
-    0x0f1b, 0x0f1b, 0x0f1a, 0x0f1a, 0x0f19, 0x0f18, 0x0f18, 0x0f17, // 58232
-    0x0f17, 0x0f16, 0x0f16, 0x0f15, 0x0f14, 0x0f14, 0x0f13, 0x0f13, // 58240
-    0x0f12, 0x0f12, 0x0f11, 0x0f11, 0x0f10, 0x0f0f, 0x0f0f, 0x0f0e, // 58248
-    0x0f0e, 0x0f0d, 0x0f0d, 0x0f0c, 0x0f0b, 0x0f0b, 0x0f0a, 0x0f0a, // 58256
-    0x0f09, 0x0f09, 0x0f08, 0x0f08, 0x0f07, 0x0f06, 0x0f06, 0x0f05, // 58264
-    0x0f05, 0x0f04, 0x0f04, 0x0f03, 0x0f02, 0x0f02, 0x0f01, 0x0f01, // 58272
-    0x0f00, 0x0f00, 0x0eff, 0x0efe, 0x0efe, 0x0efd, 0x0efd, 0x0efc, // 58280
-    0x0efc, 0x0efb, 0x0efb, 0x0efa, 0x0ef9, 0x0ef9, 0x0ef8, 0x0ef8, // 58288
-    0x0ef7, 0x0ef7, 0x0ef6, 0x0ef5, 0x0ef5, 0x0ef4, 0x0ef4, 0x0ef3, // 58296
-    0x0ef3, 0x0ef2, 0x0ef1, 0x0ef1, 0x0ef0, 0x0ef0, 0x0eef, 0x0eef, // 58304
-    0x0eee, 0x0eee, 0x0eed, 0x0eec, 0x0eec, 0x0eeb, 0x0eeb, 0x0eea, // 58312
-    0x0eea, 0x0ee9, 0x0ee8, 0x0ee8, 0x0ee7, 0x0ee7, 0x0ee6, 0x0ee6, // 58320
-    0x0ee5, 0x0ee5, 0x0ee4, 0x0ee3, 0x0ee3, 0x0ee2, 0x0ee2, 0x0ee1, // 58328
-    0x0ee1, 0x0ee0, 0x0edf, 0x0edf, 0x0ede, 0x0ede, 0x0edd, 0x0edd, // 58336
-    0x0edc, 0x0edb, 0x0edb, 0x0eda, 0x0eda, 0x0ed9, 0x0ed9, 0x0ed8, // 58344
-    0x0ed8, 0x0ed7, 0x0ed6, 0x0ed6, 0x0ed5, 0x0ed5, 0x0ed4, 0x0ed4, // 58352
-    0x0ed3, 0x0ed2, 0x0ed2, 0x0ed1, 0x0ed1, 0x0ed0, 0x0ed0, 0x0ecf, // 58360
-    0x0ecf, 0x0ece, 0x0ece, 0x0ecd, 0x0ecd, 0x0ecc, 0x0ecc, 0x0ecb, // 58368
-    0x0ecb, 0x0eca, 0x0ec9, 0x0ec9, 0x0ec8, 0x0ec8, 0x0ec7, 0x0ec7, // 58376
-    0x0ec6, 0x0ec6, 0x0ec5, 0x0ec4, 0x0ec4, 0x0ec3, 0x0ec3, 0x0ec2, // 58384
-    0x0ec2, 0x0ec1, 0x0ec1, 0x0ec0, 0x0ebf, 0x0ebf, 0x0ebe, 0x0ebe, // 58392
-    0x0ebd, 0x0ebd, 0x0ebc, 0x0ebc, 0x0ebb, 0x0eba, 0x0eba, 0x0eb9, // 58400
-    0x0eb9, 0x0eb8, 0x0eb8, 0x0eb7, 0x0eb7, 0x0eb6, 0x0eb5, 0x0eb5, // 58408
-    0x0eb4, 0x0eb4, 0x0eb3, 0x0eb3, 0x0eb2, 0x0eb1, 0x0eb1, 0x0eb0, // 58416
-    0x0eb0, 0x0eaf, 0x0eaf, 0x0eae, 0x0eae, 0x0ead, 0x0eac, 0x0eac, // 58424
-    0x0eab, 0x0eab, 0x0eaa, 0x0eaa, 0x0ea9, 0x0ea9, 0x0ea8, 0x0ea7, // 58432
-    0x0ea7, 0x0ea6, 0x0ea6, 0x0ea5, 0x0ea5, 0x0ea4, 0x0ea4, 0x0ea3, // 58440
-    0x0ea2, 0x0ea2, 0x0ea1, 0x0ea1, 0x0ea0, 0x0ea0, 0x0e9f, 0x0e9f, // 58448
-    0x0e9e, 0x0e9d, 0x0e9d, 0x0e9c, 0x0e9c, 0x0e9b, 0x0e9b, 0x0e9a, // 58456
-    0x0e9a, 0x0e99, 0x0e98, 0x0e98, 0x0e97, 0x0e97, 0x0e96, 0x0e96, // 58464
-    0x0e95, 0x0e95, 0x0e94, 0x0e93, 0x0e93, 0x0e92, 0x0e92, 0x0e91, // 58472
-    0x0e91, 0x0e90, 0x0e90, 0x0e8f, 0x0e8e, 0x0e8e, 0x0e8d, 0x0e8d, // 58480
-    0x0e8c, 0x0e8c, 0x0e8b, 0x0e8b, 0x0e8a, 0x0e89, 0x0e89, 0x0e88, // 58488
-    0x0e88, 0x0e87, 0x0e87, 0x0e86, 0x0e86, 0x0e85, 0x0e84, 0x0e84, // 58496
-    0x0e83, 0x0e83, 0x0e82, 0x0e82, 0x0e81, 0x0e81, 0x0e80, 0x0e7f, // 58504
-    0x0e7f, 0x0e7e, 0x0e7e, 0x0e7d, 0x0e7d, 0x0e7c, 0x0e7c, 0x0e7b, // 58512
-    0x0e7a, 0x0e7a, 0x0e79, 0x0e79, 0x0e78, 0x0e78, 0x0e77, 0x0e76, // 58520
-    0x0e76, 0x0e75, 0x0e75, 0x0e74, 0x0e74, 0x0e73, 0x0e73, 0x0e72, // 58528
-    0x0e71, 0x0e71, 0x0e70, 0x0e70, 0x0e6f, 0x0e6f, 0x0e6e, 0x0e6e, // 58536
-    0x0e6d, 0x0e6c, 0x0e6c, 0x0e6b, 0x0e6b, 0x0e6a, 0x0e6a, 0x0e69, // 58544
-    0x0e69, 0x0e68, 0x0e67, 0x0e67, 0x0e66, 0x0e66, 0x0e65, 0x0e65, // 58552
-    0x0e64, 0x0e64, 0x0e63, 0x0e62, 0x0e62, 0x0e61, 0x0e61, 0x0e60, // 58560
-    0x0e60, 0x0e5f, 0x0e5f, 0x0e5e, 0x0e5d, 0x0e5d, 0x0e5c, 0x0e5c, // 58568
-    0x0e5b, 0x0e5b, 0x0e5a, 0x0e5a, 0x0e59, 0x0e58, 0x0e58, 0x0e57, // 58576
-    0x0e57, 0x0e56, 0x0e56, 0x0e55, 0x0e55, 0x0e54, 0x0e53, 0x0e53, // 58584
-    0x0e52, 0x0e52, 0x0e51, 0x0e51, 0x0e50, 0x0e50, 0x0e4f, 0x0e4e, // 58592
-    0x0e4e, 0x0e4d, 0x0e4d, 0x0e4c, 0x0e4c, 0x0e4b, 0x0e4b, 0x0e4a, // 58600
-    0x0e49, 0x0e49, 0x0e48, 0x0e48, 0x0e47, 0x0e47, 0x0e46, 0x0e46, // 58608
-    0x0e45, 0x0e44, 0x0e44, 0x0e43, 0x0e43, 0x0e42, 0x0e42, 0x0e41, // 58616
-    0x0e41, 0x0e40, 0x0e3f, 0x0e3f, 0x0e3e, 0x0e3e, 0x0e3d, 0x0e3d, // 58624
-    0x0e3c, 0x0e3b, 0x0e3b, 0x0e3a, 0x0e3a, 0x0e39, 0x0e39, 0x0e38, // 58632
-    0x0e38, 0x0e37, 0x0e36, 0x0e36, 0x0e35, 0x0e35, 0x0e34, 0x0e34, // 58640
-    0x0e33, 0x0e33, 0x0e32, 0x0e31, 0x0e31, 0x0e30, 0x0e30, 0x0e2f, // 58648
-    0x0e2f, 0x0e2e, 0x0e2e, 0x0e2d, 0x0e2c, 0x0e2c, 0x0e2b, 0x0e2b, // 58656
-    0x0e2a, 0x0e2a, 0x0e29, 0x0e29, 0x0e28, 0x0e27, 0x0e27, 0x0e26, // 58664
-    0x0e26, 0x0e25, 0x0e25, 0x0e24, 0x0e24, 0x0e23, 0x0e22, 0x0e22, // 58672
-    0x0e21, 0x0e21, 0x0e20, 0x0e20, 0x0e1f, 0x0e1f, 0x0e1e, 0x0e1d, // 58680
-    0x0e1d, 0x0e1c, 0x0e1c, 0x0e1b, 0x0e1b, 0x0e1a, 0x0e1a, 0x0e19, // 58688
-    0x0e18, 0x0e18, 0x0e17, 0x0e17, 0x0e16, 0x0e16, 0x0e15, 0x0e15, // 58696
-    0x0e14, 0x0e13, 0x0e13, 0x0e12, 0x0e12, 0x0e11, 0x0e11, 0x0e10, // 58704
-    0x0e10, 0x0e0f, 0x0e0e, 0x0e0e, 0x0e0d, 0x0e0d, 0x0e0c, 0x0e0c, // 58712
-    0x0e0b, 0x0e0b, 0x0e0a, 0x0e09, 0x0e09, 0x0e08, 0x0e08, 0x0e07, // 58720
-    0x0e07, 0x0e06, 0x0e05, 0x0e05, 0x0e04, 0x0e04, 0x0e03, 0x0e03, // 58728
-    0x0e02, 0x0e02, 0x0e01, 0x0e00, 0x0e00, 0x0dff, 0x0dff, 0x0dfe, // 58736
-    0x0dfe, 0x0dfd, 0x0dfd, 0x0dfc, 0x0dfb, 0x0dfb, 0x0dfa, 0x0dfa, // 58744
-    0x0df9, 0x0df9, 0x0df8, 0x0df8, 0x0df7, 0x0df6, 0x0df6, 0x0df5, // 58752
-    0x0df5, 0x0df4, 0x0df4, 0x0df3, 0x0df3, 0x0df2, 0x0df1, 0x0df1, // 58760
-    0x0df0, 0x0df0, 0x0def, 0x0def, 0x0dee, 0x0dee, 0x0ded, 0x0dec, // 58768
-    0x0dec, 0x0deb, 0x0deb, 0x0dea, 0x0dea, 0x0de9, 0x0de9, 0x0de8, // 58776
-    0x0de7, 0x0de7, 0x0de6, 0x0de6, 0x0de5, 0x0de5, 0x0de4, 0x0de4, // 58784
-    0x0de3, 0x0de2, 0x0de2, 0x0de1, 0x0de1, 0x0de0, 0x0de0, 0x0ddf, // 58792
-    0x0ddf, 0x0dde, 0x0ddd, 0x0ddd, 0x0ddc, 0x0ddc, 0x0ddb, 0x0ddb, // 58800
-    0x0dda, 0x0dda, 0x0dd9, 0x0dd8, 0x0dd8, 0x0dd7, 0x0dd7, 0x0dd6, // 58808
-    0x0dd6, 0x0dd5, 0x0dd5, 0x0dd4, 0x0dd3, 0x0dd3, 0x0dd2, 0x0dd2, // 58816
-    0x0dd1, 0x0dd1, 0x0dd0, 0x0dd0, 0x0dcf, 0x0dce, 0x0dce, 0x0dcd, // 58824
-    0x0dcd, 0x0dcc, 0x0dcc, 0x0dcb, 0x0dca, 0x0dca, 0x0dc9, 0x0dc9, // 58832
-    0x0dc8, 0x0dc8, 0x0dc7, 0x0dc7, 0x0dc6, 0x0dc5, 0x0dc5, 0x0dc4, // 58840
-    0x0dc4, 0x0dc3, 0x0dc3, 0x0dc2, 0x0dc2, 0x0dc1, 0x0dc0, 0x0dc0, // 58848
-    0x0dbf, 0x0dbf, 0x0dbe, 0x0dbe, 0x0dbd, 0x0dbd, 0x0dbc, 0x0dbb, // 58856
-    0x0dbb, 0x0dba, 0x0dba, 0x0db9, 0x0db9, 0x0db8, 0x0db8, 0x0db7, // 58864
-    0x0db6, 0x0db6, 0x0db5, 0x0db5, 0x0db4, 0x0db4, 0x0db3, 0x0db3, // 58872
-    0x0db2, 0x0db1, 0x0db1, 0x0db0, 0x0db0, 0x0daf, 0x0daf, 0x0dae, // 58880
-    0x0dae, 0x0dad, 0x0dac, 0x0dac, 0x0dab, 0x0dab, 0x0daa, 0x0daa, // 58888
-    0x0da9, 0x0da9, 0x0da8, 0x0da7, 0x0da7, 0x0da6, 0x0da6, 0x0da5, // 58896
-    0x0da5, 0x0da4, 0x0da4, 0x0da3, 0x0da2, 0x0da2, 0x0da1, 0x0da1, // 58904
-    0x0da0, 0x0da0, 0x0d9f, 0x0d9f, 0x0d9e, 0x0d9d, 0x0d9d, 0x0d9c, // 58912
-    0x0d9c, 0x0d9b, 0x0d9b, 0x0d9a, 0x0d9a, 0x0d99, 0x0d98, 0x0d98, // 58920
-    0x0d97, 0x0d97, 0x0d96, 0x0d96, 0x0d95, 0x0d94, 0x0d94, 0x0d93, // 58928
-    0x0d93, 0x0d92, 0x0d92, 0x0d91, 0x0d91, 0x0d90, 0x0d8f, 0x0d8f, // 58936
-    0x0d8e, 0x0d8e, 0x0d8d, 0x0d8d, 0x0d8c, 0x0d8c, 0x0d8b, 0x0d8a, // 58944
-    0x0d8a, 0x0d89, 0x0d89, 0x0d88, 0x0d88, 0x0d87, 0x0d87, 0x0d86, // 58952
-    0x0d85, 0x0d85, 0x0d84, 0x0d84, 0x0d83, 0x0d83, 0x0d82, 0x0d82, // 58960
-    0x0d81, 0x0d80, 0x0d80, 0x0d7f, 0x0d7f, 0x0d7e, 0x0d7e, 0x0d7d, // 58968
-    0x0d7d, 0x0d7c, 0x0d7b, 0x0d7b, 0x0d7a, 0x0d7a, 0x0d79, 0x0d79, // 58976
-    0x0d78, 0x0d78, 0x0d77, 0x0d76, 0x0d76, 0x0d75, 0x0d75, 0x0d74, // 58984
-    0x0d74, 0x0d73, 0x0d73, 0x0d72, 0x0d71, 0x0d71, 0x0d70, 0x0d70, // 58992
-    0x0d6f, 0x0d6f, 0x0d6e, 0x0d6e, 0x0d6d, 0x0d6c, 0x0d6c, 0x0d6b, // 59000
-    0x0d6b, 0x0d6a, 0x0d6a, 0x0d69, 0x0d69, 0x0d68, 0x0d67, 0x0d67, // 59008
-    0x0d66, 0x0d66, 0x0d65, 0x0d65, 0x0d64, 0x0d64, 0x0d63, 0x0d62, // 59016
-    0x0d62, 0x0d61, 0x0d61, 0x0d60, 0x0d60, 0x0d5f, 0x0d5f, 0x0d5e, // 59024
-    0x0d5d, 0x0d5d, 0x0d5c, 0x0d5c, 0x0d5b, 0x0d5b, 0x0d5a, 0x0d59, // 59032
-    0x0d59, 0x0d58, 0x0d58, 0x0d57, 0x0d57, 0x0d56, 0x0d56, 0x0d55, // 59040
-    0x0d54, 0x0d54, 0x0d53, 0x0d53, 0x0d52, 0x0d52, 0x0d51, 0x0d51, // 59048
-    0x0d50, 0x0d4f, 0x0d4f, 0x0d4e, 0x0d4e, 0x0d4d, 0x0d4d, 0x0d4c, // 59056
-    0x0d4c, 0x0d4b, 0x0d4a, 0x0d4a, 0x0d49, 0x0d49, 0x0d48, 0x0d48, // 59064
-    0x0d47, 0x0d47, 0x0d46, 0x0d45, 0x0d45, 0x0d44, 0x0d44, 0x0d43, // 59072
-    0x0d43, 0x0d42, 0x0d42, 0x0d41, 0x0d40, 0x0d40, 0x0d3f, 0x0d3f, // 59080
-    0x0d3e, 0x0d3e, 0x0d3d, 0x0d3d, 0x0d3c, 0x0d3b, 0x0d3b, 0x0d3a, // 59088
-    0x0d3a, 0x0d39, 0x0d39, 0x0d38, 0x0d38, 0x0d37, 0x0d36, 0x0d36, // 59096
-    0x0d35, 0x0d35, 0x0d34, 0x0d34, 0x0d33, 0x0d33, 0x0d32, 0x0d31, // 59104
-    0x0d31, 0x0d30, 0x0d30, 0x0d2f, 0x0d2f, 0x0d2e, 0x0d2e, 0x0d2d, // 59112
-    0x0d2c, 0x0d2c, 0x0d2b, 0x0d2b, 0x0d2a, 0x0d2a, 0x0d29, 0x0d29, // 59120
-    0x0d28, 0x0d27, 0x0d27, 0x0d26, 0x0d26, 0x0d25, 0x0d25, 0x0d24, // 59128
-    0x0d24, 0x0d23, 0x0d22, 0x0d22, 0x0d21, 0x0d21, 0x0d20, 0x0d20, // 59136
-    0x0d1f, 0x0d1e, 0x0d1e, 0x0d1d, 0x0d1d, 0x0d1c, 0x0d1c, 0x0d1b, // 59144
-    0x0d1b, 0x0d1a, 0x0d19, 0x0d19, 0x0d18, 0x0d18, 0x0d17, 0x0d17, // 59152
-    0x0d16, 0x0d16, 0x0d15, 0x0d14, 0x0d14, 0x0d13, 0x0d13, 0x0d12, // 59160
-    0x0d12, 0x0d11, 0x0d11, 0x0d10, 0x0d0f, 0x0d0f, 0x0d0e, 0x0d0e, // 59168
-    0x0d0d, 0x0d0d, 0x0d0c, 0x0d0c, 0x0d0b, 0x0d0a, 0x0d0a, 0x0d09, // 59176
-    0x0d09, 0x0d08, 0x0d08, 0x0d07, 0x0d07, 0x0d06, 0x0d05, 0x0d05, // 59184
-    0x0d04, 0x0d04, 0x0d03, 0x0d03, 0x0d02, 0x0d02, 0x0d01, 0x0d00, // 59192
-    0x0d00, 0x0cff, 0x0cff, 0x0cfe, 0x0cfe, 0x0cfd, 0x0cfd, 0x0cfc, // 59200
-    0x0cfb, 0x0cfb, 0x0cfa, 0x0cfa, 0x0cf9, 0x0cf9, 0x0cf8, 0x0cf8, // 59208
-    0x0cf7, 0x0cf6, 0x0cf6, 0x0cf5, 0x0cf5, 0x0cf4, 0x0cf4, 0x0cf3, // 59216
-    0x0cf3, 0x0cf2, 0x0cf1, 0x0cf1, 0x0cf0, 0x0cf0, 0x0cef, 0x0cef, // 59224
-    0x0cee, 0x0cee, 0x0ced, 0x0cec, 0x0cec, 0x0ceb, 0x0ceb, 0x0cea, // 59232
-    0x0cea, 0x0ce9, 0x0ce8, 0x0ce8, 0x0ce7, 0x0ce7, 0x0ce6, 0x0ce6, // 59240
-    0x0ce5, 0x0ce5, 0x0ce4, 0x0ce3, 0x0ce3, 0x0ce2, 0x0ce2, 0x0ce1, // 59248
-    0x0ce1, 0x0ce0, 0x0ce0, 0x0cdf, 0x0cde, 0x0cde, 0x0cdd, 0x0cdd, // 59256
-    0x0cdc, 0x0cdc, 0x0cdb, 0x0cdb, 0x0cda, 0x0cd9, 0x0cd9, 0x0cd8, // 59264
-    0x0cd8, 0x0cd7, 0x0cd7, 0x0cd6, 0x0cd6, 0x0cd5, 0x0cd4, 0x0cd4, // 59272
-    0x0cd3, 0x0cd3, 0x0cd2, 0x0cd2, 0x0cd1, 0x0cd1, 0x0cd0, 0x0ccf, // 59280
-    0x0ccf, 0x0cce, 0x0cce, 0x0ccd, 0x0ccd, 0x0ccc, 0x0ccc, 0x0ccb, // 59288
-    0x0cca, 0x0cca, 0x0cc9, 0x0cc9, 0x0cc8, 0x0cc8, 0x0cc7, 0x0cc7, // 59296
-    0x0cc6, 0x0cc5, 0x0cc5, 0x0cc4, 0x0cc4, 0x0cc3, 0x0cc3, 0x0cc2, // 59304
-    0x0cc2, 0x0cc1, 0x0cc0, 0x0cc0, 0x0cbf, 0x0cbf, 0x0cbe, 0x0cbe, // 59312
-    0x0cbd, 0x0cbd, 0x0cbc, 0x0cbb, 0x0cbb, 0x0cba, 0x0cba, 0x0cb9, // 59320
-    0x0cb9, 0x0cb8, 0x0cb8, 0x0cb7, 0x0cb6, 0x0cb6, 0x0cb5, 0x0cb5, // 59328
-    0x0cb4, 0x0cb4, 0x0cb3, 0x0cb3, 0x0cb2, 0x0cb1, 0x0cb1, 0x0cb0, // 59336
-    0x0cb0, 0x0caf, 0x0caf, 0x0cae, 0x0cad, 0x0cad, 0x0cac, 0x0cac, // 59344
-    0x0cab, 0x0cab, 0x0caa, 0x0caa, 0x0ca9, 0x0ca8, 0x0ca8, 0x0ca7, // 59352
-    0x0ca7, 0x0ca6, 0x0ca6, 0x0ca5, 0x0ca5, 0x0ca4, 0x0ca3, 0x0ca3, // 59360
-    0x0ca2, 0x0ca2, 0x0ca1, 0x0ca1, 0x0ca0, 0x0ca0, 0x0c9f, 0x0c9e, // 59368
-    0x0c9e, 0x0c9d, 0x0c9d, 0x0c9c, 0x0c9c, 0x0c9b, 0x0c9b, 0x0c9a, // 59376
-    0x0c99, 0x0c99, 0x0c98, 0x0c98, 0x0c97, 0x0c97, 0x0c96, 0x0c96, // 59384
-    0x0c96, 0x0c95, 0x0c95, 0x0c94, 0x0c94, 0x0c93, 0x0c93, 0x0c92, // 59392
-    0x0c92, 0x0c91, 0x0c91, 0x0c90, 0x0c8f, 0x0c8f, 0x0c8e, 0x0c8e, // 59400
-    0x0c8d, 0x0c8d, 0x0c8c, 0x0c8c, 0x0c8b, 0x0c8b, 0x0c8a, 0x0c89, // 59408
-    0x0c89, 0x0c88, 0x0c88, 0x0c87, 0x0c87, 0x0c86, 0x0c86, 0x0c85, // 59416
-    0x0c85, 0x0c84, 0x0c83, 0x0c83, 0x0c82, 0x0c82, 0x0c81, 0x0c81, // 59424
-    0x0c80, 0x0c80, 0x0c7f, 0x0c7f, 0x0c7e, 0x0c7d, 0x0c7d, 0x0c7c, // 59432
-    0x0c7c, 0x0c7b, 0x0c7b, 0x0c7a, 0x0c7a, 0x0c79, 0x0c79, 0x0c78, // 59440
-    0x0c77, 0x0c77, 0x0c76, 0x0c76, 0x0c75, 0x0c75, 0x0c74, 0x0c74, // 59448
-    0x0c73, 0x0c73, 0x0c72, 0x0c71, 0x0c71, 0x0c70, 0x0c70, 0x0c6f, // 59456
-    0x0c6f, 0x0c6e, 0x0c6e, 0x0c6d, 0x0c6d, 0x0c6c, 0x0c6b, 0x0c6b, // 59464
-    0x0c6a, 0x0c6a, 0x0c69, 0x0c69, 0x0c68, 0x0c68, 0x0c67, 0x0c67, // 59472
-    0x0c66, 0x0c66, 0x0c65, 0x0c64, 0x0c64, 0x0c63, 0x0c63, 0x0c62, // 59480
-    0x0c62, 0x0c61, 0x0c61, 0x0c60, 0x0c60, 0x0c5f, 0x0c5e, 0x0c5e, // 59488
-    0x0c5d, 0x0c5d, 0x0c5c, 0x0c5c, 0x0c5b, 0x0c5b, 0x0c5a, 0x0c5a, // 59496
-    0x0c59, 0x0c58, 0x0c58, 0x0c57, 0x0c57, 0x0c56, 0x0c56, 0x0c55, // 59504
-    0x0c55, 0x0c54, 0x0c54, 0x0c53, 0x0c52, 0x0c52, 0x0c51, 0x0c51, // 59512
-    0x0c50, 0x0c50, 0x0c4f, 0x0c4f, 0x0c4e, 0x0c4e, 0x0c4d, 0x0c4c, // 59520
-    0x0c4c, 0x0c4b, 0x0c4b, 0x0c4a, 0x0c4a, 0x0c49, 0x0c49, 0x0c48, // 59528
-    0x0c48, 0x0c47, 0x0c46, 0x0c46, 0x0c45, 0x0c45, 0x0c44, 0x0c44, // 59536
-    0x0c43, 0x0c43, 0x0c42, 0x0c42, 0x0c41, 0x0c40, 0x0c40, 0x0c3f, // 59544
-    0x0c3f, 0x0c3e, 0x0c3e, 0x0c3d, 0x0c3d, 0x0c3c, 0x0c3c, 0x0c3b, // 59552
-    0x0c3a, 0x0c3a, 0x0c39, 0x0c39, 0x0c38, 0x0c38, 0x0c37, 0x0c37, // 59560
-    0x0c36, 0x0c36, 0x0c35, 0x0c34, 0x0c34, 0x0c33, 0x0c33, 0x0c32, // 59568
-    0x0c32, 0x0c31, 0x0c31, 0x0c30, 0x0c30, 0x0c2f, 0x0c2e, 0x0c2e, // 59576
-    0x0c2d, 0x0c2d, 0x0c2c, 0x0c2c, 0x0c2b, 0x0c2b, 0x0c2a, 0x0c2a, // 59584
-    0x0c29, 0x0c28, 0x0c28, 0x0c27, 0x0c27, 0x0c26, 0x0c26, 0x0c25, // 59592
-    0x0c25, 0x0c24, 0x0c24, 0x0c23, 0x0c22, 0x0c22, 0x0c21, 0x0c21, // 59600
-    0x0c20, 0x0c20, 0x0c1f, 0x0c1f, 0x0c1e, 0x0c1e, 0x0c1d, 0x0c1c, // 59608
-    0x0c1c, 0x0c1b, 0x0c1b, 0x0c1a, 0x0c1a, 0x0c19, 0x0c19, 0x0c18, // 59616
-    0x0c18, 0x0c17, 0x0c16, 0x0c16, 0x0c15, 0x0c15, 0x0c14, 0x0c14, // 59624
-    0x0c13, 0x0c13, 0x0c12, 0x0c12, 0x0c11, 0x0c10, 0x0c10, 0x0c0f, // 59632
-    0x0c0f, 0x0c0e, 0x0c0e, 0x0c0d, 0x0c0d, 0x0c0c, 0x0c0c, 0x0c0b, // 59640
-    0x0c0b, 0x0c0a, 0x0c09, 0x0c09, 0x0c08, 0x0c08, 0x0c07, 0x0c07, // 59648
-    0x0c06, 0x0c06, 0x0c05, 0x0c05, 0x0c04, 0x0c03, 0x0c03, 0x0c02, // 59656
-    0x0c02, 0x0c01, 0x0c01, 0x0c00, 0x0c00, 0x0bff, 0x0bff, 0x0bfe, // 59664
-    0x0bfd, 0x0bfd, 0x0bfc, 0x0bfc, 0x0bfb, 0x0bfb, 0x0bfa, 0x0bfa, // 59672
-    0x0bf9, 0x0bf9, 0x0bf8, 0x0bf7, 0x0bf7, 0x0bf6, 0x0bf6, 0x0bf5, // 59680
-    0x0bf5, 0x0bf4, 0x0bf4, 0x0bf3, 0x0bf3, 0x0bf2, 0x0bf1, 0x0bf1, // 59688
-    0x0bf0, 0x0bf0, 0x0bef, 0x0bef, 0x0bee, 0x0bee, 0x0bed, 0x0bed, // 59696
-    0x0bec, 0x0beb, 0x0beb, 0x0bea, 0x0bea, 0x0be9, 0x0be9, 0x0be8, // 59704
-    0x0be8, 0x0be7, 0x0be7, 0x0be6, 0x0be5, 0x0be5, 0x0be4, 0x0be4, // 59712
-    0x0be3, 0x0be3, 0x0be2, 0x0be2, 0x0be1, 0x0be1, 0x0be0, 0x0bdf, // 59720
-    0x0bdf, 0x0bde, 0x0bde, 0x0bdd, 0x0bdd, 0x0bdc, 0x0bdc, 0x0bdb, // 59728
-    0x0bdb, 0x0bda, 0x0bd9, 0x0bd9, 0x0bd8, 0x0bd8, 0x0bd7, 0x0bd7, // 59736
-    0x0bd6, 0x0bd6, 0x0bd5, 0x0bd5, 0x0bd4, 0x0bd3, 0x0bd3, 0x0bd2, // 59744
-    0x0bd2, 0x0bd1, 0x0bd1, 0x0bd0, 0x0bd0, 0x0bcf, 0x0bcf, 0x0bce, // 59752
-    0x0bcd, 0x0bcd, 0x0bcc, 0x0bcc, 0x0bcb, 0x0bcb, 0x0bca, 0x0bca, // 59760
-    0x0bc9, 0x0bc9, 0x0bc8, 0x0bc7, 0x0bc7, 0x0bc6, 0x0bc6, 0x0bc5, // 59768
-    0x0bc5, 0x0bc4, 0x0bc4, 0x0bc3, 0x0bc3, 0x0bc2, 0x0bc1, 0x0bc1, // 59776
-    0x0bc0, 0x0bc0, 0x0bbf, 0x0bbf, 0x0bbe, 0x0bbe, 0x0bbd, 0x0bbd, // 59784
-    0x0bbc, 0x0bbb, 0x0bbb, 0x0bba, 0x0bba, 0x0bb9, 0x0bb9, 0x0bb8, // 59792
-    0x0bb8, 0x0bb7, 0x0bb7, 0x0bb6, 0x0bb5, 0x0bb5, 0x0bb4, 0x0bb4, // 59800
-    0x0bb3, 0x0bb3, 0x0bb2, 0x0bb2, 0x0bb1, 0x0bb1, 0x0bb0, 0x0baf, // 59808
-    0x0baf, 0x0bae, 0x0bae, 0x0bad, 0x0bad, 0x0bac, 0x0bac, 0x0bab, // 59816
-    0x0bab, 0x0baa, 0x0baa, 0x0ba9, 0x0ba8, 0x0ba8, 0x0ba7, 0x0ba7, // 59824
-    0x0ba6, 0x0ba6, 0x0ba5, 0x0ba5, 0x0ba4, 0x0ba4, 0x0ba3, 0x0ba2, // 59832
-    0x0ba2, 0x0ba1, 0x0ba1, 0x0ba0, 0x0ba0, 0x0b9f, 0x0b9f, 0x0b9e, // 59840
-    0x0b9e, 0x0b9d, 0x0b9c, 0x0b9c, 0x0b9b, 0x0b9b, 0x0b9a, 0x0b9a, // 59848
-    0x0b99, 0x0b99, 0x0b98, 0x0b98, 0x0b97, 0x0b96, 0x0b96, 0x0b95, // 59856
-    0x0b95, 0x0b94, 0x0b94, 0x0b93, 0x0b93, 0x0b92, 0x0b92, 0x0b91, // 59864
-    0x0b90, 0x0b90, 0x0b8f, 0x0b8f, 0x0b8e, 0x0b8e, 0x0b8d, 0x0b8d, // 59872
-    0x0b8c, 0x0b8c, 0x0b8b, 0x0b8a, 0x0b8a, 0x0b89, 0x0b89, 0x0b88, // 59880
-    0x0b88, 0x0b87, 0x0b87, 0x0b86, 0x0b86, 0x0b85, 0x0b84, 0x0b84, // 59888
-    0x0b83, 0x0b83, 0x0b82, 0x0b82, 0x0b81, 0x0b81, 0x0b80, 0x0b80, // 59896
-    0x0b7f, 0x0b7e, 0x0b7e, 0x0b7d, 0x0b7d, 0x0b7c, 0x0b7c, 0x0b7b, // 59904
-    0x0b7b, 0x0b7a, 0x0b7a, 0x0b79, 0x0b78, 0x0b78, 0x0b77, 0x0b77, // 59912
-    0x0b76, 0x0b76, 0x0b75, 0x0b75, 0x0b74, 0x0b74, 0x0b73, 0x0b72, // 59920
-    0x0b72, 0x0b71, 0x0b71, 0x0b70, 0x0b70, 0x0b6f, 0x0b6f, 0x0b6e, // 59928
-    0x0b6e, 0x0b6d, 0x0b6c, 0x0b6c, 0x0b6b, 0x0b6b, 0x0b6a, 0x0b6a, // 59936
-    0x0b69, 0x0b69, 0x0b68, 0x0b68, 0x0b67, 0x0b66, 0x0b66, 0x0b65, // 59944
-    0x0b65, 0x0b64, 0x0b64, 0x0b63, 0x0b63, 0x0b62, 0x0b62, 0x0b61, // 59952
-    0x0b60, 0x0b60, 0x0b5f, 0x0b5f, 0x0b5e, 0x0b5e, 0x0b5d, 0x0b5d, // 59960
-    0x0b5c, 0x0b5c, 0x0b5b, 0x0b5a, 0x0b5a, 0x0b59, 0x0b59, 0x0b58, // 59968
-    0x0b58, 0x0b57, 0x0b57, 0x0b56, 0x0b56, 0x0b55, 0x0b54, 0x0b54, // 59976
-    0x0b53, 0x0b53, 0x0b52, 0x0b52, 0x0b51, 0x0b51, 0x0b50, 0x0b50, // 59984
-    0x0b4f, 0x0b4f, 0x0b4e, 0x0b4d, 0x0b4d, 0x0b4c, 0x0b4c, 0x0b4b, // 59992
-    0x0b4b, 0x0b4a, 0x0b4a, 0x0b49, 0x0b49, 0x0b48, 0x0b47, 0x0b47, // 60000
-    0x0b46, 0x0b46, 0x0b45, 0x0b45, 0x0b44, 0x0b44, 0x0b43, 0x0b43, // 60008
-    0x0b42, 0x0b41, 0x0b41, 0x0b40, 0x0b40, 0x0b3f, 0x0b3f, 0x0b3e, // 60016
-    0x0b3e, 0x0b3d, 0x0b3d, 0x0b3c, 0x0b3b, 0x0b3b, 0x0b3a, 0x0b3a, // 60024
-    0x0b39, 0x0b39, 0x0b38, 0x0b38, 0x0b37, 0x0b37, 0x0b36, 0x0b35, // 60032
-    0x0b35, 0x0b34, 0x0b34, 0x0b33, 0x0b33, 0x0b32, 0x0b32, 0x0b31, // 60040
-    0x0b31, 0x0b30, 0x0b2f, 0x0b2f, 0x0b2e, 0x0b2e, 0x0b2d, 0x0b2d, // 60048
-    0x0b2c, 0x0b2c, 0x0b2b, 0x0b2b, 0x0b2a, 0x0b29, 0x0b29, 0x0b28, // 60056
-    0x0b28, 0x0b27, 0x0b27, 0x0b26, 0x0b26, 0x0b25, 0x0b25, 0x0b24, // 60064
-    0x0b23, 0x0b23, 0x0b22, 0x0b22, 0x0b21, 0x0b21, 0x0b20, 0x0b20, // 60072
-    0x0b1f, 0x0b1f, 0x0b1e, 0x0b1d, 0x0b1d, 0x0b1c, 0x0b1c, 0x0b1b, // 60080
-    0x0b1b, 0x0b1a, 0x0b1a, 0x0b19, 0x0b19, 0x0b18, 0x0b17, 0x0b17, // 60088
-    0x0b16, 0x0b16, 0x0b15, 0x0b15, 0x0b14, 0x0b14, 0x0b13, 0x0b13, // 60096
-    0x0b12, 0x0b11, 0x0b11, 0x0b10, 0x0b10, 0x0b0f, 0x0b0f, 0x0b0e, // 60104
-    0x0b0e, 0x0b0d, 0x0b0d, 0x0b0c, 0x0b0b, 0x0b0b, 0x0b0a, 0x0b0a, // 60112
-    0x0b09, 0x0b09, 0x0b08, 0x0b08, 0x0b07, 0x0b07, 0x0b06, 0x0b05, // 60120
-    0x0b05, 0x0b04, 0x0b04, 0x0b03, 0x0b03, 0x0b02, 0x0b02, 0x0b01, // 60128
-    0x0b01, 0x0b00, 0x0aff, 0x0aff, 0x0afe, 0x0afe, 0x0afd, 0x0afd, // 60136
-    0x0afc, 0x0afc, 0x0afb, 0x0afb, 0x0afa, 0x0af9, 0x0af9, 0x0af8, // 60144
-    0x0af8, 0x0af7, 0x0af7, 0x0af6, 0x0af6, 0x0af5, 0x0af5, 0x0af4, // 60152
-    0x0af4, 0x0af3, 0x0af2, 0x0af2, 0x0af1, 0x0af1, 0x0af0, 0x0af0, // 60160
-    0x0aef, 0x0aef, 0x0aee, 0x0aee, 0x0aed, 0x0aec, 0x0aec, 0x0aeb, // 60168
-    0x0aeb, 0x0aea, 0x0aea, 0x0ae9, 0x0ae9, 0x0ae8, 0x0ae8, 0x0ae7, // 60176
-    0x0ae6, 0x0ae6, 0x0ae5, 0x0ae5, 0x0ae4, 0x0ae4, 0x0ae3, 0x0ae3, // 60184
-    0x0ae2, 0x0ae2, 0x0ae1, 0x0ae0, 0x0ae0, 0x0adf, 0x0adf, 0x0ade, // 60192
-    0x0ade, 0x0add, 0x0add, 0x0adc, 0x0adc, 0x0adb, 0x0ada, 0x0ada, // 60200
-    0x0ad9, 0x0ad9, 0x0ad8, 0x0ad8, 0x0ad7, 0x0ad7, 0x0ad6, 0x0ad6, // 60208
-    0x0ad5, 0x0ad4, 0x0ad4, 0x0ad3, 0x0ad3, 0x0ad2, 0x0ad2, 0x0ad1, // 60216
-    0x0ad1, 0x0ad0, 0x0ad0, 0x0acf, 0x0ace, 0x0ace, 0x0acd, 0x0acd, // 60224
-    0x0acc, 0x0acc, 0x0acb, 0x0acb, 0x0aca, 0x0aca, 0x0ac9, 0x0ac8, // 60232
-    0x0ac8, 0x0ac7, 0x0ac7, 0x0ac6, 0x0ac6, 0x0ac5, 0x0ac5, 0x0ac4, // 60240
-    0x0ac4, 0x0ac3, 0x0ac2, 0x0ac2, 0x0ac1, 0x0ac1, 0x0ac0, 0x0ac0, // 60248
-    0x0abf, 0x0abf, 0x0abe, 0x0abe, 0x0abd, 0x0abc, 0x0abc, 0x0abb, // 60256
-    0x0abb, 0x0aba, 0x0aba, 0x0ab9, 0x0ab9, 0x0ab8, 0x0ab8, 0x0ab7, // 60264
-    0x0ab6, 0x0ab6, 0x0ab5, 0x0ab5, 0x0ab4, 0x0ab4, 0x0ab3, 0x0ab3, // 60272
-    0x0ab2, 0x0ab2, 0x0ab1, 0x0ab0, 0x0ab0, 0x0aaf, 0x0aaf, 0x0aae, // 60280
-    0x0aae, 0x0aad, 0x0aad, 0x0aac, 0x0aac, 0x0aab, 0x0aaa, 0x0aaa, // 60288
-    0x0aa9, 0x0aa9, 0x0aa8, 0x0aa8, 0x0aa7, 0x0aa7, 0x0aa6, 0x0aa6, // 60296
-    0x0aa5, 0x0aa4, 0x0aa4, 0x0aa3, 0x0aa3, 0x0aa2, 0x0aa2, 0x0aa1, // 60304
-    0x0aa1, 0x0aa0, 0x0aa0, 0x0a9f, 0x0a9e, 0x0a9e, 0x0a9d, 0x0a9d, // 60312
-    0x0a9c, 0x0a9c, 0x0a9b, 0x0a9b, 0x0a9a, 0x0a9a, 0x0a99, 0x0a98, // 60320
-    0x0a98, 0x0a97, 0x0a97, 0x0a96, 0x0a96, 0x0a95, 0x0a95, 0x0a94, // 60328
-    0x0a94, 0x0a93, 0x0a93, 0x0a92, 0x0a91, 0x0a91, 0x0a90, 0x0a90, // 60336
-    0x0a8f, 0x0a8f, 0x0a8e, 0x0a8e, 0x0a8d, 0x0a8d, 0x0a8c, 0x0a8b, // 60344
-    0x0a8b, 0x0a8a, 0x0a8a, 0x0a89, 0x0a89, 0x0a88, 0x0a88, 0x0a87, // 60352
-    0x0a87, 0x0a86, 0x0a85, 0x0a85, 0x0a84, 0x0a84, 0x0a83, 0x0a83, // 60360
-    0x0a82, 0x0a82, 0x0a81, 0x0a81, 0x0a80, 0x0a7f, 0x0a7f, 0x0a7e, // 60368
-    0x0a7e, 0x0a7d, 0x0a7d, 0x0a7c, 0x0a7c, 0x0a7b, 0x0a7b, 0x0a7a, // 60376
-    0x0a79, 0x0a79, 0x0a78, 0x0a78, 0x0a77, 0x0a77, 0x0a76, 0x0a76, // 60384
-    0x0a75, 0x0a75, 0x0a74, 0x0a73, 0x0a73, 0x0a72, 0x0a72, 0x0a71, // 60392
-    0x0a71, 0x0a70, 0x0a70, 0x0a6f, 0x0a6f, 0x0a6e, 0x0a6d, 0x0a6d, // 60400
-    0x0a6c, 0x0a6c, 0x0a6b, 0x0a6b, 0x0a6a, 0x0a6a, 0x0a69, 0x0a69, // 60408
-    0x0a69, 0x0a68, 0x0a68, 0x0a67, 0x0a67, 0x0a66, 0x0a66, 0x0a65, // 60416
-    0x0a65, 0x0a64, 0x0a64, 0x0a63, 0x0a63, 0x0a62, 0x0a61, 0x0a61, // 60424
-    0x0a60, 0x0a60, 0x0a5f, 0x0a5f, 0x0a5e, 0x0a5e, 0x0a5d, 0x0a5d, // 60432
-    0x0a5c, 0x0a5c, 0x0a5b, 0x0a5a, 0x0a5a, 0x0a59, 0x0a59, 0x0a58, // 60440
-    0x0a58, 0x0a57, 0x0a57, 0x0a56, 0x0a56, 0x0a55, 0x0a55, 0x0a54, // 60448
-    0x0a54, 0x0a53, 0x0a52, 0x0a52, 0x0a51, 0x0a51, 0x0a50, 0x0a50, // 60456
-    0x0a4f, 0x0a4f, 0x0a4e, 0x0a4e, 0x0a4d, 0x0a4d, 0x0a4c, 0x0a4b, // 60464
-    0x0a4b, 0x0a4a, 0x0a4a, 0x0a49, 0x0a49, 0x0a48, 0x0a48, 0x0a47, // 60472
-    0x0a47, 0x0a46, 0x0a46, 0x0a45, 0x0a44, 0x0a44, 0x0a43, 0x0a43, // 60480
-    0x0a42, 0x0a42, 0x0a41, 0x0a41, 0x0a40, 0x0a40, 0x0a3f, 0x0a3f, // 60488
-    0x0a3e, 0x0a3d, 0x0a3d, 0x0a3c, 0x0a3c, 0x0a3b, 0x0a3b, 0x0a3a, // 60496
-    0x0a3a, 0x0a39, 0x0a39, 0x0a38, 0x0a38, 0x0a37, 0x0a37, 0x0a36, // 60504
-    0x0a35, 0x0a35, 0x0a34, 0x0a34, 0x0a33, 0x0a33, 0x0a32, 0x0a32, // 60512
-    0x0a31, 0x0a31, 0x0a30, 0x0a30, 0x0a2f, 0x0a2e, 0x0a2e, 0x0a2d, // 60520
-    0x0a2d, 0x0a2c, 0x0a2c, 0x0a2b, 0x0a2b, 0x0a2a, 0x0a2a, 0x0a29, // 60528
-    0x0a29, 0x0a28, 0x0a27, 0x0a27, 0x0a26, 0x0a26, 0x0a25, 0x0a25, // 60536
-    0x0a24, 0x0a24, 0x0a23, 0x0a23, 0x0a22, 0x0a22, 0x0a21, 0x0a20, // 60544
-    0x0a20, 0x0a1f, 0x0a1f, 0x0a1e, 0x0a1e, 0x0a1d, 0x0a1d, 0x0a1c, // 60552
-    0x0a1c, 0x0a1b, 0x0a1b, 0x0a1a, 0x0a1a, 0x0a19, 0x0a18, 0x0a18, // 60560
-    0x0a17, 0x0a17, 0x0a16, 0x0a16, 0x0a15, 0x0a15, 0x0a14, 0x0a14, // 60568
-    0x0a13, 0x0a13, 0x0a12, 0x0a11, 0x0a11, 0x0a10, 0x0a10, 0x0a0f, // 60576
-    0x0a0f, 0x0a0e, 0x0a0e, 0x0a0d, 0x0a0d, 0x0a0c, 0x0a0c, 0x0a0b, // 60584
-    0x0a0a, 0x0a0a, 0x0a09, 0x0a09, 0x0a08, 0x0a08, 0x0a07, 0x0a07, // 60592
-    0x0a06, 0x0a06, 0x0a05, 0x0a05, 0x0a04, 0x0a03, 0x0a03, 0x0a02, // 60600
-    0x0a02, 0x0a01, 0x0a01, 0x0a00, 0x0a00, 0x09ff, 0x09ff, 0x09fe, // 60608
-    0x09fe, 0x09fd, 0x09fd, 0x09fc, 0x09fb, 0x09fb, 0x09fa, 0x09fa, // 60616
-    0x09f9, 0x09f9, 0x09f8, 0x09f8, 0x09f7, 0x09f7, 0x09f6, 0x09f6, // 60624
-    0x09f5, 0x09f4, 0x09f4, 0x09f3, 0x09f3, 0x09f2, 0x09f2, 0x09f1, // 60632
-    0x09f1, 0x09f0, 0x09f0, 0x09ef, 0x09ef, 0x09ee, 0x09ed, 0x09ed, // 60640
-    0x09ec, 0x09ec, 0x09eb, 0x09eb, 0x09ea, 0x09ea, 0x09e9, 0x09e9, // 60648
-    0x09e8, 0x09e8, 0x09e7, 0x09e6, 0x09e6, 0x09e5, 0x09e5, 0x09e4, // 60656
-    0x09e4, 0x09e3, 0x09e3, 0x09e2, 0x09e2, 0x09e1, 0x09e1, 0x09e0, // 60664
-    0x09e0, 0x09df, 0x09de, 0x09de, 0x09dd, 0x09dd, 0x09dc, 0x09dc, // 60672
-    0x09db, 0x09db, 0x09da, 0x09da, 0x09d9, 0x09d9, 0x09d8, 0x09d7, // 60680
-    0x09d7, 0x09d6, 0x09d6, 0x09d5, 0x09d5, 0x09d4, 0x09d4, 0x09d3, // 60688
-    0x09d3, 0x09d2, 0x09d2, 0x09d1, 0x09d0, 0x09d0, 0x09cf, 0x09cf, // 60696
-    0x09ce, 0x09ce, 0x09cd, 0x09cd, 0x09cc, 0x09cc, 0x09cb, 0x09cb, // 60704
-    0x09ca, 0x09c9, 0x09c9, 0x09c8, 0x09c8, 0x09c7, 0x09c7, 0x09c6, // 60712
-    0x09c6, 0x09c5, 0x09c5, 0x09c4, 0x09c4, 0x09c3, 0x09c2, 0x09c2, // 60720
-    0x09c1, 0x09c1, 0x09c0, 0x09c0, 0x09bf, 0x09bf, 0x09be, 0x09be, // 60728
-    0x09bd, 0x09bd, 0x09bc, 0x09bc, 0x09bb, 0x09ba, 0x09ba, 0x09b9, // 60736
-    0x09b9, 0x09b8, 0x09b8, 0x09b7, 0x09b7, 0x09b6, 0x09b6, 0x09b5, // 60744
-    0x09b5, 0x09b4, 0x09b3, 0x09b3, 0x09b2, 0x09b2, 0x09b1, 0x09b1, // 60752
-    0x09b0, 0x09b0, 0x09af, 0x09af, 0x09ae, 0x09ae, 0x09ad, 0x09ac, // 60760
-    0x09ac, 0x09ab, 0x09ab, 0x09aa, 0x09aa, 0x09a9, 0x09a9, 0x09a8, // 60768
-    0x09a8, 0x09a7, 0x09a7, 0x09a6, 0x09a5, 0x09a5, 0x09a4, 0x09a4, // 60776
-    0x09a3, 0x09a3, 0x09a2, 0x09a2, 0x09a1, 0x09a1, 0x09a0, 0x09a0, // 60784
-    0x099f, 0x099f, 0x099e, 0x099d, 0x099d, 0x099c, 0x099c, 0x099b, // 60792
-    0x099b, 0x099a, 0x099a, 0x0999, 0x0999, 0x0998, 0x0998, 0x0997, // 60800
-    0x0996, 0x0996, 0x0995, 0x0995, 0x0994, 0x0994, 0x0993, 0x0993, // 60808
-    0x0992, 0x0992, 0x0991, 0x0991, 0x0990, 0x098f, 0x098f, 0x098e, // 60816
-    0x098e, 0x098d, 0x098d, 0x098c, 0x098c, 0x098b, 0x098b, 0x098a, // 60824
-    0x098a, 0x0989, 0x0988, 0x0988, 0x0987, 0x0987, 0x0986, 0x0986, // 60832
-    0x0985, 0x0985, 0x0984, 0x0984, 0x0983, 0x0983, 0x0982, 0x0982, // 60840
-    0x0981, 0x0980, 0x0980, 0x097f, 0x097f, 0x097e, 0x097e, 0x097d, // 60848
-    0x097d, 0x097c, 0x097c, 0x097b, 0x097b, 0x097a, 0x0979, 0x0979, // 60856
-    0x0978, 0x0978, 0x0977, 0x0977, 0x0976, 0x0976, 0x0975, 0x0975, // 60864
-    0x0974, 0x0974, 0x0973, 0x0972, 0x0972, 0x0971, 0x0971, 0x0970, // 60872
-    0x0970, 0x096f, 0x096f, 0x096e, 0x096e, 0x096d, 0x096d, 0x096c, // 60880
-    0x096b, 0x096b, 0x096a, 0x096a, 0x0969, 0x0969, 0x0968, 0x0968, // 60888
-    0x0967, 0x0967, 0x0966, 0x0966, 0x0965, 0x0965, 0x0964, 0x0963, // 60896
-    0x0963, 0x0962, 0x0962, 0x0961, 0x0961, 0x0960, 0x0960, 0x095f, // 60904
-    0x095f, 0x095e, 0x095e, 0x095d, 0x095c, 0x095c, 0x095b, 0x095b, // 60912
-    0x095a, 0x095a, 0x0959, 0x0959, 0x0958, 0x0958, 0x0957, 0x0957, // 60920
-    0x0956, 0x0955, 0x0955, 0x0954, 0x0954, 0x0953, 0x0953, 0x0952, // 60928
-    0x0952, 0x0951, 0x0951, 0x0950, 0x0950, 0x094f, 0x094e, 0x094e, // 60936
-    0x094d, 0x094d, 0x094c, 0x094c, 0x094b, 0x094b, 0x094a, 0x094a, // 60944
-    0x0949, 0x0949, 0x0948, 0x0947, 0x0947, 0x0946, 0x0946, 0x0945, // 60952
-    0x0945, 0x0944, 0x0944, 0x0943, 0x0943, 0x0942, 0x0942, 0x0941, // 60960
-    0x0941, 0x0940, 0x093f, 0x093f, 0x093e, 0x093e, 0x093d, 0x093d, // 60968
-    0x093c, 0x093c, 0x093b, 0x093b, 0x093a, 0x093a, 0x0939, 0x0938, // 60976
-    0x0938, 0x0937, 0x0937, 0x0936, 0x0936, 0x0935, 0x0935, 0x0934, // 60984
-    0x0934, 0x0933, 0x0933, 0x0932, 0x0931, 0x0931, 0x0930, 0x0930, // 60992
-    0x092f, 0x092f, 0x092e, 0x092e, 0x092d, 0x092d, 0x092c, 0x092c, // 61000
-    0x092b, 0x092a, 0x092a, 0x0929, 0x0929, 0x0928, 0x0928, 0x0927, // 61008
-    0x0927, 0x0926, 0x0926, 0x0925, 0x0925, 0x0924, 0x0924, 0x0923, // 61016
-    0x0922, 0x0922, 0x0921, 0x0921, 0x0920, 0x0920, 0x091f, 0x091f, // 61024
-    0x091e, 0x091e, 0x091d, 0x091d, 0x091c, 0x091b, 0x091b, 0x091a, // 61032
-    0x091a, 0x0919, 0x0919, 0x0918, 0x0918, 0x0917, 0x0917, 0x0916, // 61040
-    0x0916, 0x0915, 0x0914, 0x0914, 0x0913, 0x0913, 0x0912, 0x0912, // 61048
-    0x0911, 0x0911, 0x0910, 0x0910, 0x090f, 0x090f, 0x090e, 0x090d, // 61056
-    0x090d, 0x090c, 0x090c, 0x090b, 0x090b, 0x090a, 0x090a, 0x0909, // 61064
-    0x0909, 0x0908, 0x0908, 0x0907, 0x0907, 0x0906, 0x0905, 0x0905, // 61072
-    0x0904, 0x0904, 0x0903, 0x0903, 0x0902, 0x0902, 0x0901, 0x0901, // 61080
-    0x0900, 0x0900, 0x08ff, 0x08fe, 0x08fe, 0x08fd, 0x08fd, 0x08fc, // 61088
-    0x08fc, 0x08fb, 0x08fb, 0x08fa, 0x08fa, 0x08f9, 0x08f9, 0x08f8, // 61096
-    0x08f7, 0x08f7, 0x08f6, 0x08f6, 0x08f5, 0x08f5, 0x08f4, 0x08f4, // 61104
-    0x08f3, 0x08f3, 0x08f2, 0x08f2, 0x08f1, 0x08f0, 0x08f0, 0x08ef, // 61112
-    0x08ef, 0x08ee, 0x08ee, 0x08ed, 0x08ed, 0x08ec, 0x08ec, 0x08eb, // 61120
-    0x08eb, 0x08ea, 0x08ea, 0x08e9, 0x08e8, 0x08e8, 0x08e7, 0x08e7, // 61128
-    0x08e6, 0x08e6, 0x08e5, 0x08e5, 0x08e4, 0x08e4, 0x08e3, 0x08e3, // 61136
-    0x08e2, 0x08e1, 0x08e1, 0x08e0, 0x08e0, 0x08df, 0x08df, 0x08de, // 61144
-    0x08de, 0x08dd, 0x08dd, 0x08dc, 0x08dc, 0x08db, 0x08da, 0x08da, // 61152
-    0x08d9, 0x08d9, 0x08d8, 0x08d8, 0x08d7, 0x08d7, 0x08d6, 0x08d6, // 61160
-    0x08d5, 0x08d5, 0x08d4, 0x08d3, 0x08d3, 0x08d2, 0x08d2, 0x08d1, // 61168
-    0x08d1, 0x08d0, 0x08d0, 0x08cf, 0x08cf, 0x08ce, 0x08ce, 0x08cd, // 61176
-    0x08cd, 0x08cc, 0x08cb, 0x08cb, 0x08ca, 0x08ca, 0x08c9, 0x08c9, // 61184
-    0x08c8, 0x08c8, 0x08c7, 0x08c7, 0x08c6, 0x08c6, 0x08c5, 0x08c4, // 61192
-    0x08c4, 0x08c3, 0x08c3, 0x08c2, 0x08c2, 0x08c1, 0x08c1, 0x08c0, // 61200
-    0x08c0, 0x08bf, 0x08bf, 0x08be, 0x08bd, 0x08bd, 0x08bc, 0x08bc, // 61208
-    0x08bb, 0x08bb, 0x08ba, 0x08ba, 0x08b9, 0x08b9, 0x08b8, 0x08b8, // 61216
-    0x08b7, 0x08b6, 0x08b6, 0x08b5, 0x08b5, 0x08b4, 0x08b4, 0x08b3, // 61224
-    0x08b3, 0x08b2, 0x08b2, 0x08b1, 0x08b1, 0x08b0, 0x08af, 0x08af, // 61232
-    0x08ae, 0x08ae, 0x08ad, 0x08ad, 0x08ac, 0x08ac, 0x08ab, 0x08ab, // 61240
-    0x08aa, 0x08aa, 0x08a9, 0x08a9, 0x08a8, 0x08a7, 0x08a7, 0x08a6, // 61248
-    0x08a6, 0x08a5, 0x08a5, 0x08a4, 0x08a4, 0x08a3, 0x08a3, 0x08a2, // 61256
-    0x08a2, 0x08a1, 0x08a0, 0x08a0, 0x089f, 0x089f, 0x089e, 0x089e, // 61264
-    0x089d, 0x089d, 0x089c, 0x089c, 0x089b, 0x089b, 0x089a, 0x0899, // 61272
-    0x0899, 0x0898, 0x0898, 0x0897, 0x0897, 0x0896, 0x0896, 0x0895, // 61280
-    0x0895, 0x0894, 0x0894, 0x0893, 0x0892, 0x0892, 0x0891, 0x0891, // 61288
-    0x0890, 0x0890, 0x088f, 0x088f, 0x088e, 0x088e, 0x088d, 0x088d, // 61296
-    0x088c, 0x088c, 0x088b, 0x088a, 0x088a, 0x0889, 0x0889, 0x0888, // 61304
-    0x0888, 0x0887, 0x0887, 0x0886, 0x0886, 0x0885, 0x0885, 0x0884, // 61312
-    0x0883, 0x0883, 0x0882, 0x0882, 0x0881, 0x0881, 0x0880, 0x0880, // 61320
-    0x087f, 0x087f, 0x087e, 0x087e, 0x087d, 0x087c, 0x087c, 0x087b, // 61328
-    0x087b, 0x087a, 0x087a, 0x0879, 0x0879, 0x0878, 0x0878, 0x0877, // 61336
-    0x0877, 0x0876, 0x0875, 0x0875, 0x0874, 0x0874, 0x0873, 0x0873, // 61344
-    0x0872, 0x0872, 0x0871, 0x0871, 0x0870, 0x0870, 0x086f, 0x086f, // 61352
-    0x086e, 0x086d, 0x086d, 0x086c, 0x086c, 0x086b, 0x086b, 0x086a, // 61360
-    0x086a, 0x0869, 0x0869, 0x0868, 0x0868, 0x0867, 0x0866, 0x0866, // 61368
-    0x0865, 0x0865, 0x0864, 0x0864, 0x0863, 0x0863, 0x0862, 0x0862, // 61376
-    0x0861, 0x0861, 0x0860, 0x085f, 0x085f, 0x085e, 0x085e, 0x085d, // 61384
-    0x085d, 0x085c, 0x085c, 0x085b, 0x085b, 0x085a, 0x085a, 0x0859, // 61392
-    0x0858, 0x0858, 0x0857, 0x0857, 0x0856, 0x0856, 0x0855, 0x0855, // 61400
-    0x0854, 0x0854, 0x0853, 0x0853, 0x0852, 0x0852, 0x0851, 0x0850, // 61408
-    0x0850, 0x084f, 0x084f, 0x084e, 0x084e, 0x084d, 0x084d, 0x084c, // 61416
-    0x084c, 0x084b, 0x084b, 0x084a, 0x0849, 0x0849, 0x0848, 0x0848, // 61424
-    0x0847, 0x0847, 0x0846, 0x0846, 0x0845, 0x0845, 0x0844, 0x0844, // 61432
-    0x0844, 0x0843, 0x0843, 0x0842, 0x0842, 0x0841, 0x0841, 0x0840, // 61440
-    0x0840, 0x083f, 0x083f, 0x083e, 0x083e, 0x083d, 0x083d, 0x083c, // 61448
-    0x083c, 0x083b, 0x083a, 0x083a, 0x0839, 0x0839, 0x0838, 0x0838, // 61456
-    0x0837, 0x0837, 0x0836, 0x0836, 0x0835, 0x0835, 0x0834, 0x0834, // 61464
-    0x0833, 0x0833, 0x0832, 0x0831, 0x0831, 0x0830, 0x0830, 0x082f, // 61472
-    0x082f, 0x082e, 0x082e, 0x082d, 0x082d, 0x082c, 0x082c, 0x082b, // 61480
-    0x082b, 0x082a, 0x082a, 0x0829, 0x0828, 0x0828, 0x0827, 0x0827, // 61488
-    0x0826, 0x0826, 0x0825, 0x0825, 0x0824, 0x0824, 0x0823, 0x0823, // 61496
-    0x0822, 0x0822, 0x0821, 0x0821, 0x0820, 0x081f, 0x081f, 0x081e, // 61504
-    0x081e, 0x081d, 0x081d, 0x081c, 0x081c, 0x081b, 0x081b, 0x081a, // 61512
-    0x081a, 0x0819, 0x0819, 0x0818, 0x0818, 0x0817, 0x0816, 0x0816, // 61520
-    0x0815, 0x0815, 0x0814, 0x0814, 0x0813, 0x0813, 0x0812, 0x0812, // 61528
-    0x0811, 0x0811, 0x0810, 0x0810, 0x080f, 0x080f, 0x080e, 0x080d, // 61536
-    0x080d, 0x080c, 0x080c, 0x080b, 0x080b, 0x080a, 0x080a, 0x0809, // 61544
-    0x0809, 0x0808, 0x0808, 0x0807, 0x0807, 0x0806, 0x0806, 0x0805, // 61552
-    0x0804, 0x0804, 0x0803, 0x0803, 0x0802, 0x0802, 0x0801, 0x0801, // 61560
-    0x0800, 0x0800, 0x07ff, 0x07ff, 0x07fe, 0x07fe, 0x07fd, 0x07fd, // 61568
-    0x07fc, 0x07fb, 0x07fb, 0x07fa, 0x07fa, 0x07f9, 0x07f9, 0x07f8, // 61576
-    0x07f8, 0x07f7, 0x07f7, 0x07f6, 0x07f6, 0x07f5, 0x07f5, 0x07f4, // 61584
-    0x07f4, 0x07f3, 0x07f2, 0x07f2, 0x07f1, 0x07f1, 0x07f0, 0x07f0, // 61592
-    0x07ef, 0x07ef, 0x07ee, 0x07ee, 0x07ed, 0x07ed, 0x07ec, 0x07ec, // 61600
-    0x07eb, 0x07eb, 0x07ea, 0x07e9, 0x07e9, 0x07e8, 0x07e8, 0x07e7, // 61608
-    0x07e7, 0x07e6, 0x07e6, 0x07e5, 0x07e5, 0x07e4, 0x07e4, 0x07e3, // 61616
-    0x07e3, 0x07e2, 0x07e2, 0x07e1, 0x07e0, 0x07e0, 0x07df, 0x07df, // 61624
-    0x07de, 0x07de, 0x07dd, 0x07dd, 0x07dc, 0x07dc, 0x07db, 0x07db, // 61632
-    0x07da, 0x07da, 0x07d9, 0x07d9, 0x07d8, 0x07d7, 0x07d7, 0x07d6, // 61640
-    0x07d6, 0x07d5, 0x07d5, 0x07d4, 0x07d4, 0x07d3, 0x07d3, 0x07d2, // 61648
-    0x07d2, 0x07d1, 0x07d1, 0x07d0, 0x07d0, 0x07cf, 0x07ce, 0x07ce, // 61656
-    0x07cd, 0x07cd, 0x07cc, 0x07cc, 0x07cb, 0x07cb, 0x07ca, 0x07ca, // 61664
-    0x07c9, 0x07c9, 0x07c8, 0x07c8, 0x07c7, 0x07c7, 0x07c6, 0x07c5, // 61672
-    0x07c5, 0x07c4, 0x07c4, 0x07c3, 0x07c3, 0x07c2, 0x07c2, 0x07c1, // 61680
-    0x07c1, 0x07c0, 0x07c0, 0x07bf, 0x07bf, 0x07be, 0x07be, 0x07bd, // 61688
-    0x07bd, 0x07bc, 0x07bb, 0x07bb, 0x07ba, 0x07ba, 0x07b9, 0x07b9, // 61696
-    0x07b8, 0x07b8, 0x07b7, 0x07b7, 0x07b6, 0x07b6, 0x07b5, 0x07b5, // 61704
-    0x07b4, 0x07b4, 0x07b3, 0x07b2, 0x07b2, 0x07b1, 0x07b1, 0x07b0, // 61712
-    0x07b0, 0x07af, 0x07af, 0x07ae, 0x07ae, 0x07ad, 0x07ad, 0x07ac, // 61720
-    0x07ac, 0x07ab, 0x07ab, 0x07aa, 0x07a9, 0x07a9, 0x07a8, 0x07a8, // 61728
-    0x07a7, 0x07a7, 0x07a6, 0x07a6, 0x07a5, 0x07a5, 0x07a4, 0x07a4, // 61736
-    0x07a3, 0x07a3, 0x07a2, 0x07a2, 0x07a1, 0x07a0, 0x07a0, 0x079f, // 61744
-    0x079f, 0x079e, 0x079e, 0x079d, 0x079d, 0x079c, 0x079c, 0x079b, // 61752
-    0x079b, 0x079a, 0x079a, 0x0799, 0x0799, 0x0798, 0x0797, 0x0797, // 61760
-    0x0796, 0x0796, 0x0795, 0x0795, 0x0794, 0x0794, 0x0793, 0x0793, // 61768
-    0x0792, 0x0792, 0x0791, 0x0791, 0x0790, 0x0790, 0x078f, 0x078e, // 61776
-    0x078e, 0x078d, 0x078d, 0x078c, 0x078c, 0x078b, 0x078b, 0x078a, // 61784
-    0x078a, 0x0789, 0x0789, 0x0788, 0x0788, 0x0787, 0x0787, 0x0786, // 61792
-    0x0785, 0x0785, 0x0784, 0x0784, 0x0783, 0x0783, 0x0782, 0x0782, // 61800
-    0x0781, 0x0781, 0x0780, 0x0780, 0x077f, 0x077f, 0x077e, 0x077e, // 61808
-    0x077d, 0x077c, 0x077c, 0x077b, 0x077b, 0x077a, 0x077a, 0x0779, // 61816
-    0x0779, 0x0778, 0x0778, 0x0777, 0x0777, 0x0776, 0x0776, 0x0775, // 61824
-    0x0775, 0x0774, 0x0773, 0x0773, 0x0772, 0x0772, 0x0771, 0x0771, // 61832
-    0x0770, 0x0770, 0x076f, 0x076f, 0x076e, 0x076e, 0x076d, 0x076d, // 61840
-    0x076c, 0x076c, 0x076b, 0x076a, 0x076a, 0x0769, 0x0769, 0x0768, // 61848
-    0x0768, 0x0767, 0x0767, 0x0766, 0x0766, 0x0765, 0x0765, 0x0764, // 61856
-    0x0764, 0x0763, 0x0763, 0x0762, 0x0761, 0x0761, 0x0760, 0x0760, // 61864
-    0x075f, 0x075f, 0x075e, 0x075e, 0x075d, 0x075d, 0x075c, 0x075c, // 61872
-    0x075b, 0x075b, 0x075a, 0x075a, 0x0759, 0x0758, 0x0758, 0x0757, // 61880
-    0x0757, 0x0756, 0x0756, 0x0755, 0x0755, 0x0754, 0x0754, 0x0753, // 61888
-    0x0753, 0x0752, 0x0752, 0x0751, 0x0751, 0x0750, 0x074f, 0x074f, // 61896
-    0x074e, 0x074e, 0x074d, 0x074d, 0x074c, 0x074c, 0x074b, 0x074b, // 61904
-    0x074a, 0x074a, 0x0749, 0x0749, 0x0748, 0x0748, 0x0747, 0x0746, // 61912
-    0x0746, 0x0745, 0x0745, 0x0744, 0x0744, 0x0743, 0x0743, 0x0742, // 61920
-    0x0742, 0x0741, 0x0741, 0x0740, 0x0740, 0x073f, 0x073f, 0x073e, // 61928
-    0x073d, 0x073d, 0x073c, 0x073c, 0x073b, 0x073b, 0x073a, 0x073a, // 61936
-    0x0739, 0x0739, 0x0738, 0x0738, 0x0737, 0x0737, 0x0736, 0x0736, // 61944
-    0x0735, 0x0734, 0x0734, 0x0733, 0x0733, 0x0732, 0x0732, 0x0731, // 61952
-    0x0731, 0x0730, 0x0730, 0x072f, 0x072f, 0x072e, 0x072e, 0x072d, // 61960
-    0x072d, 0x072c, 0x072b, 0x072b, 0x072a, 0x072a, 0x0729, 0x0729, // 61968
-    0x0728, 0x0728, 0x0727, 0x0727, 0x0726, 0x0726, 0x0725, 0x0725, // 61976
-    0x0724, 0x0724, 0x0723, 0x0722, 0x0722, 0x0721, 0x0721, 0x0720, // 61984
-    0x0720, 0x071f, 0x071f, 0x071e, 0x071e, 0x071d, 0x071d, 0x071c, // 61992
-    0x071c, 0x071b, 0x071b, 0x071a, 0x0719, 0x0719, 0x0718, 0x0718, // 62000
-    0x0717, 0x0717, 0x0716, 0x0716, 0x0715, 0x0715, 0x0714, 0x0714, // 62008
-    0x0713, 0x0713, 0x0712, 0x0712, 0x0711, 0x0710, 0x0710, 0x070f, // 62016
-    0x070f, 0x070e, 0x070e, 0x070d, 0x070d, 0x070c, 0x070c, 0x070b, // 62024
-    0x070b, 0x070a, 0x070a, 0x0709, 0x0709, 0x0708, 0x0707, 0x0707, // 62032
-    0x0706, 0x0706, 0x0705, 0x0705, 0x0704, 0x0704, 0x0703, 0x0703, // 62040
-    0x0702, 0x0702, 0x0701, 0x0701, 0x0700, 0x0700, 0x06ff, 0x06fe, // 62048
-    0x06fe, 0x06fd, 0x06fd, 0x06fc, 0x06fc, 0x06fb, 0x06fb, 0x06fa, // 62056
-    0x06fa, 0x06f9, 0x06f9, 0x06f8, 0x06f8, 0x06f7, 0x06f7, 0x06f6, // 62064
-    0x06f5, 0x06f5, 0x06f4, 0x06f4, 0x06f3, 0x06f3, 0x06f2, 0x06f2, // 62072
-    0x06f1, 0x06f1, 0x06f0, 0x06f0, 0x06ef, 0x06ef, 0x06ee, 0x06ee, // 62080
-    0x06ed, 0x06ec, 0x06ec, 0x06eb, 0x06eb, 0x06ea, 0x06ea, 0x06e9, // 62088
-    0x06e9, 0x06e8, 0x06e8, 0x06e7, 0x06e7, 0x06e6, 0x06e6, 0x06e5, // 62096
-    0x06e5, 0x06e4, 0x06e3, 0x06e3, 0x06e2, 0x06e2, 0x06e1, 0x06e1, // 62104
-    0x06e0, 0x06e0, 0x06df, 0x06df, 0x06de, 0x06de, 0x06dd, 0x06dd, // 62112
-    0x06dc, 0x06dc, 0x06db, 0x06da, 0x06da, 0x06d9, 0x06d9, 0x06d8, // 62120
-    0x06d8, 0x06d7, 0x06d7, 0x06d6, 0x06d6, 0x06d5, 0x06d5, 0x06d4, // 62128
-    0x06d4, 0x06d3, 0x06d3, 0x06d2, 0x06d1, 0x06d1, 0x06d0, 0x06d0, // 62136
-    0x06cf, 0x06cf, 0x06ce, 0x06ce, 0x06cd, 0x06cd, 0x06cc, 0x06cc, // 62144
-    0x06cb, 0x06cb, 0x06ca, 0x06ca, 0x06c9, 0x06c8, 0x06c8, 0x06c7, // 62152
-    0x06c7, 0x06c6, 0x06c6, 0x06c5, 0x06c5, 0x06c4, 0x06c4, 0x06c3, // 62160
-    0x06c3, 0x06c2, 0x06c2, 0x06c1, 0x06c1, 0x06c0, 0x06bf, 0x06bf, // 62168
-    0x06be, 0x06be, 0x06bd, 0x06bd, 0x06bc, 0x06bc, 0x06bb, 0x06bb, // 62176
-    0x06ba, 0x06ba, 0x06b9, 0x06b9, 0x06b8, 0x06b8, 0x06b7, 0x06b6, // 62184
-    0x06b6, 0x06b5, 0x06b5, 0x06b4, 0x06b4, 0x06b3, 0x06b3, 0x06b2, // 62192
-    0x06b2, 0x06b1, 0x06b1, 0x06b0, 0x06b0, 0x06af, 0x06af, 0x06ae, // 62200
-    0x06ae, 0x06ad, 0x06ac, 0x06ac, 0x06ab, 0x06ab, 0x06aa, 0x06aa, // 62208
-    0x06a9, 0x06a9, 0x06a8, 0x06a8, 0x06a7, 0x06a7, 0x06a6, 0x06a6, // 62216
-    0x06a5, 0x06a5, 0x06a4, 0x06a3, 0x06a3, 0x06a2, 0x06a2, 0x06a1, // 62224
-    0x06a1, 0x06a0, 0x06a0, 0x069f, 0x069f, 0x069e, 0x069e, 0x069d, // 62232
-    0x069d, 0x069c, 0x069c, 0x069b, 0x069a, 0x069a, 0x0699, 0x0699, // 62240
-    0x0698, 0x0698, 0x0697, 0x0697, 0x0696, 0x0696, 0x0695, 0x0695, // 62248
-    0x0694, 0x0694, 0x0693, 0x0693, 0x0692, 0x0691, 0x0691, 0x0690, // 62256
-    0x0690, 0x068f, 0x068f, 0x068e, 0x068e, 0x068d, 0x068d, 0x068c, // 62264
-    0x068c, 0x068b, 0x068b, 0x068a, 0x068a, 0x0689, 0x0688, 0x0688, // 62272
-    0x0687, 0x0687, 0x0686, 0x0686, 0x0685, 0x0685, 0x0684, 0x0684, // 62280
-    0x0683, 0x0683, 0x0682, 0x0682, 0x0681, 0x0681, 0x0680, 0x067f, // 62288
-    0x067f, 0x067e, 0x067e, 0x067d, 0x067d, 0x067c, 0x067c, 0x067b, // 62296
-    0x067b, 0x067a, 0x067a, 0x0679, 0x0679, 0x0678, 0x0678, 0x0677, // 62304
-    0x0676, 0x0676, 0x0675, 0x0675, 0x0674, 0x0674, 0x0673, 0x0673, // 62312
-    0x0672, 0x0672, 0x0671, 0x0671, 0x0670, 0x0670, 0x066f, 0x066f, // 62320
-    0x066e, 0x066d, 0x066d, 0x066c, 0x066c, 0x066b, 0x066b, 0x066a, // 62328
-    0x066a, 0x0669, 0x0669, 0x0668, 0x0668, 0x0667, 0x0667, 0x0666, // 62336
-    0x0666, 0x0665, 0x0664, 0x0664, 0x0663, 0x0663, 0x0662, 0x0662, // 62344
-    0x0661, 0x0661, 0x0660, 0x0660, 0x065f, 0x065f, 0x065e, 0x065e, // 62352
-    0x065d, 0x065d, 0x065c, 0x065b, 0x065b, 0x065a, 0x065a, 0x0659, // 62360
-    0x0659, 0x0658, 0x0658, 0x0657, 0x0657, 0x0656, 0x0656, 0x0655, // 62368
-    0x0655, 0x0654, 0x0654, 0x0653, 0x0652, 0x0652, 0x0651, 0x0651, // 62376
-    0x0650, 0x0650, 0x064f, 0x064f, 0x064e, 0x064e, 0x064d, 0x064d, // 62384
-    0x064c, 0x064c, 0x064b, 0x064b, 0x064a, 0x0649, 0x0649, 0x0648, // 62392
-    0x0648, 0x0647, 0x0647, 0x0646, 0x0646, 0x0645, 0x0645, 0x0644, // 62400
-    0x0644, 0x0643, 0x0643, 0x0642, 0x0642, 0x0641, 0x0640, 0x0640, // 62408
-    0x063f, 0x063f, 0x063e, 0x063e, 0x063d, 0x063d, 0x063c, 0x063c, // 62416
-    0x063b, 0x063b, 0x063a, 0x063a, 0x0639, 0x0639, 0x0638, 0x0637, // 62424
-    0x0637, 0x0636, 0x0636, 0x0635, 0x0635, 0x0634, 0x0634, 0x0633, // 62432
-    0x0633, 0x0632, 0x0632, 0x0631, 0x0631, 0x0630, 0x0630, 0x062f, // 62440
-    0x062e, 0x062e, 0x062d, 0x062d, 0x062c, 0x062c, 0x062b, 0x062b, // 62448
-    0x062a, 0x062a, 0x0629, 0x0629, 0x0628, 0x0628, 0x0627, 0x0627, // 62456
-    0x0627, 0x0626, 0x0626, 0x0625, 0x0625, 0x0624, 0x0624, 0x0623, // 62464
-    0x0623, 0x0622, 0x0622, 0x0621, 0x0621, 0x0620, 0x0620, 0x061f, // 62472
-    0x061f, 0x061e, 0x061e, 0x061d, 0x061d, 0x061c, 0x061c, 0x061b, // 62480
-    0x061a, 0x061a, 0x0619, 0x0619, 0x0618, 0x0618, 0x0617, 0x0617, // 62488
-    0x0616, 0x0616, 0x0615, 0x0615, 0x0614, 0x0614, 0x0613, 0x0613, // 62496
-    0x0612, 0x0612, 0x0611, 0x0611, 0x0610, 0x0610, 0x060f, 0x060e, // 62504
-    0x060e, 0x060d, 0x060d, 0x060c, 0x060c, 0x060b, 0x060b, 0x060a, // 62512
-    0x060a, 0x0609, 0x0609, 0x0608, 0x0608, 0x0607, 0x0607, 0x0606, // 62520
-    0x0606, 0x0605, 0x0605, 0x0604, 0x0604, 0x0603, 0x0602, 0x0602, // 62528
-    0x0601, 0x0601, 0x0600, 0x0600, 0x05ff, 0x05ff, 0x05fe, 0x05fe, // 62536
-    0x05fd, 0x05fd, 0x05fc, 0x05fc, 0x05fb, 0x05fb, 0x05fa, 0x05fa, // 62544
-    0x05f9, 0x05f9, 0x05f8, 0x05f8, 0x05f7, 0x05f7, 0x05f6, 0x05f5, // 62552
-    0x05f5, 0x05f4, 0x05f4, 0x05f3, 0x05f3, 0x05f2, 0x05f2, 0x05f1, // 62560
-    0x05f1, 0x05f0, 0x05f0, 0x05ef, 0x05ef, 0x05ee, 0x05ee, 0x05ed, // 62568
-    0x05ed, 0x05ec, 0x05ec, 0x05eb, 0x05eb, 0x05ea, 0x05e9, 0x05e9, // 62576
-    0x05e8, 0x05e8, 0x05e7, 0x05e7, 0x05e6, 0x05e6, 0x05e5, 0x05e5, // 62584
-    0x05e4, 0x05e4, 0x05e3, 0x05e3, 0x05e2, 0x05e2, 0x05e1, 0x05e1, // 62592
-    0x05e0, 0x05e0, 0x05df, 0x05df, 0x05de, 0x05dd, 0x05dd, 0x05dc, // 62600
-    0x05dc, 0x05db, 0x05db, 0x05da, 0x05da, 0x05d9, 0x05d9, 0x05d8, // 62608
-    0x05d8, 0x05d7, 0x05d7, 0x05d6, 0x05d6, 0x05d5, 0x05d5, 0x05d4, // 62616
-    0x05d4, 0x05d3, 0x05d3, 0x05d2, 0x05d1, 0x05d1, 0x05d0, 0x05d0, // 62624
-    0x05cf, 0x05cf, 0x05ce, 0x05ce, 0x05cd, 0x05cd, 0x05cc, 0x05cc, // 62632
-    0x05cb, 0x05cb, 0x05ca, 0x05ca, 0x05c9, 0x05c9, 0x05c8, 0x05c8, // 62640
-    0x05c7, 0x05c7, 0x05c6, 0x05c5, 0x05c5, 0x05c4, 0x05c4, 0x05c3, // 62648
-    0x05c3, 0x05c2, 0x05c2, 0x05c1, 0x05c1, 0x05c0, 0x05c0, 0x05bf, // 62656
-    0x05bf, 0x05be, 0x05be, 0x05bd, 0x05bd, 0x05bc, 0x05bc, 0x05bb, // 62664
-    0x05bb, 0x05ba, 0x05b9, 0x05b9, 0x05b8, 0x05b8, 0x05b7, 0x05b7, // 62672
-    0x05b6, 0x05b6, 0x05b5, 0x05b5, 0x05b4, 0x05b4, 0x05b3, 0x05b3, // 62680
-    0x05b2, 0x05b2, 0x05b1, 0x05b1, 0x05b0, 0x05b0, 0x05af, 0x05af, // 62688
-    0x05ae, 0x05ad, 0x05ad, 0x05ac, 0x05ac, 0x05ab, 0x05ab, 0x05aa, // 62696
-    0x05aa, 0x05a9, 0x05a9, 0x05a8, 0x05a8, 0x05a7, 0x05a7, 0x05a6, // 62704
-    0x05a6, 0x05a5, 0x05a5, 0x05a4, 0x05a4, 0x05a3, 0x05a3, 0x05a2, // 62712
-    0x05a2, 0x05a1, 0x05a0, 0x05a0, 0x059f, 0x059f, 0x059e, 0x059e, // 62720
-    0x059d, 0x059d, 0x059c, 0x059c, 0x059b, 0x059b, 0x059a, 0x059a, // 62728
-    0x0599, 0x0599, 0x0598, 0x0598, 0x0597, 0x0597, 0x0596, 0x0596, // 62736
-    0x0595, 0x0594, 0x0594, 0x0593, 0x0593, 0x0592, 0x0592, 0x0591, // 62744
-    0x0591, 0x0590, 0x0590, 0x058f, 0x058f, 0x058e, 0x058e, 0x058d, // 62752
-    0x058d, 0x058c, 0x058c, 0x058b, 0x058b, 0x058a, 0x058a, 0x0589, // 62760
-    0x0588, 0x0588, 0x0587, 0x0587, 0x0586, 0x0586, 0x0585, 0x0585, // 62768
-    0x0584, 0x0584, 0x0583, 0x0583, 0x0582, 0x0582, 0x0581, 0x0581, // 62776
-    0x0580, 0x0580, 0x057f, 0x057f, 0x057e, 0x057e, 0x057d, 0x057c, // 62784
-    0x057c, 0x057b, 0x057b, 0x057a, 0x057a, 0x0579, 0x0579, 0x0578, // 62792
-    0x0578, 0x0577, 0x0577, 0x0576, 0x0576, 0x0575, 0x0575, 0x0574, // 62800
-    0x0574, 0x0573, 0x0573, 0x0572, 0x0572, 0x0571, 0x0570, 0x0570, // 62808
-    0x056f, 0x056f, 0x056e, 0x056e, 0x056d, 0x056d, 0x056c, 0x056c, // 62816
-    0x056b, 0x056b, 0x056a, 0x056a, 0x0569, 0x0569, 0x0568, 0x0568, // 62824
-    0x0567, 0x0567, 0x0566, 0x0566, 0x0565, 0x0564, 0x0564, 0x0563, // 62832
-    0x0563, 0x0562, 0x0562, 0x0561, 0x0561, 0x0560, 0x0560, 0x055f, // 62840
-    0x055f, 0x055e, 0x055e, 0x055d, 0x055d, 0x055c, 0x055c, 0x055b, // 62848
-    0x055b, 0x055a, 0x055a, 0x0559, 0x0558, 0x0558, 0x0557, 0x0557, // 62856
-    0x0556, 0x0556, 0x0555, 0x0555, 0x0554, 0x0554, 0x0553, 0x0553, // 62864
-    0x0552, 0x0552, 0x0551, 0x0551, 0x0550, 0x0550, 0x054f, 0x054f, // 62872
-    0x054e, 0x054e, 0x054d, 0x054c, 0x054c, 0x054b, 0x054b, 0x054a, // 62880
-    0x054a, 0x0549, 0x0549, 0x0548, 0x0548, 0x0547, 0x0547, 0x0546, // 62888
-    0x0546, 0x0545, 0x0545, 0x0544, 0x0544, 0x0543, 0x0543, 0x0542, // 62896
-    0x0542, 0x0541, 0x0541, 0x0540, 0x053f, 0x053f, 0x053e, 0x053e, // 62904
-    0x053d, 0x053d, 0x053c, 0x053c, 0x053b, 0x053b, 0x053a, 0x053a, // 62912
-    0x0539, 0x0539, 0x0538, 0x0538, 0x0537, 0x0537, 0x0536, 0x0536, // 62920
-    0x0535, 0x0535, 0x0534, 0x0533, 0x0533, 0x0532, 0x0532, 0x0531, // 62928
-    0x0531, 0x0530, 0x0530, 0x052f, 0x052f, 0x052e, 0x052e, 0x052d, // 62936
-    0x052d, 0x052c, 0x052c, 0x052b, 0x052b, 0x052a, 0x052a, 0x0529, // 62944
-    0x0529, 0x0528, 0x0527, 0x0527, 0x0526, 0x0526, 0x0525, 0x0525, // 62952
-    0x0524, 0x0524, 0x0523, 0x0523, 0x0522, 0x0522, 0x0521, 0x0521, // 62960
-    0x0520, 0x0520, 0x051f, 0x051f, 0x051e, 0x051e, 0x051d, 0x051d, // 62968
-    0x051c, 0x051b, 0x051b, 0x051a, 0x051a, 0x0519, 0x0519, 0x0518, // 62976
-    0x0518, 0x0517, 0x0517, 0x0516, 0x0516, 0x0515, 0x0515, 0x0514, // 62984
-    0x0514, 0x0513, 0x0513, 0x0512, 0x0512, 0x0511, 0x0511, 0x0510, // 62992
-    0x050f, 0x050f, 0x050e, 0x050e, 0x050d, 0x050d, 0x050c, 0x050c, // 63000
-    0x050b, 0x050b, 0x050a, 0x050a, 0x0509, 0x0509, 0x0508, 0x0508, // 63008
-    0x0507, 0x0507, 0x0506, 0x0506, 0x0505, 0x0505, 0x0504, 0x0503, // 63016
-    0x0503, 0x0502, 0x0502, 0x0501, 0x0501, 0x0500, 0x0500, 0x04ff, // 63024
-    0x04ff, 0x04fe, 0x04fe, 0x04fd, 0x04fd, 0x04fc, 0x04fc, 0x04fb, // 63032
-    0x04fb, 0x04fa, 0x04fa, 0x04f9, 0x04f9, 0x04f8, 0x04f7, 0x04f7, // 63040
-    0x04f6, 0x04f6, 0x04f5, 0x04f5, 0x04f4, 0x04f4, 0x04f3, 0x04f3, // 63048
-    0x04f2, 0x04f2, 0x04f1, 0x04f1, 0x04f0, 0x04f0, 0x04ef, 0x04ef, // 63056
-    0x04ee, 0x04ee, 0x04ed, 0x04ed, 0x04ec, 0x04ec, 0x04eb, 0x04ea, // 63064
-    0x04ea, 0x04e9, 0x04e9, 0x04e8, 0x04e8, 0x04e7, 0x04e7, 0x04e6, // 63072
-    0x04e6, 0x04e5, 0x04e5, 0x04e4, 0x04e4, 0x04e3, 0x04e3, 0x04e2, // 63080
-    0x04e2, 0x04e1, 0x04e1, 0x04e0, 0x04e0, 0x04df, 0x04de, 0x04de, // 63088
-    0x04dd, 0x04dd, 0x04dc, 0x04dc, 0x04db, 0x04db, 0x04da, 0x04da, // 63096
-    0x04d9, 0x04d9, 0x04d8, 0x04d8, 0x04d7, 0x04d7, 0x04d6, 0x04d6, // 63104
-    0x04d5, 0x04d5, 0x04d4, 0x04d4, 0x04d3, 0x04d2, 0x04d2, 0x04d1, // 63112
-    0x04d1, 0x04d0, 0x04d0, 0x04cf, 0x04cf, 0x04ce, 0x04ce, 0x04cd, // 63120
-    0x04cd, 0x04cc, 0x04cc, 0x04cb, 0x04cb, 0x04ca, 0x04ca, 0x04c9, // 63128
-    0x04c9, 0x04c8, 0x04c8, 0x04c7, 0x04c6, 0x04c6, 0x04c5, 0x04c5, // 63136
-    0x04c4, 0x04c4, 0x04c3, 0x04c3, 0x04c2, 0x04c2, 0x04c1, 0x04c1, // 63144
-    0x04c0, 0x04c0, 0x04bf, 0x04bf, 0x04be, 0x04be, 0x04bd, 0x04bd, // 63152
-    0x04bc, 0x04bc, 0x04bb, 0x04ba, 0x04ba, 0x04b9, 0x04b9, 0x04b8, // 63160
-    0x04b8, 0x04b7, 0x04b7, 0x04b6, 0x04b6, 0x04b5, 0x04b5, 0x04b4, // 63168
-    0x04b4, 0x04b3, 0x04b3, 0x04b2, 0x04b2, 0x04b1, 0x04b1, 0x04b0, // 63176
-    0x04b0, 0x04af, 0x04ae, 0x04ae, 0x04ad, 0x04ad, 0x04ac, 0x04ac, // 63184
-    0x04ab, 0x04ab, 0x04aa, 0x04aa, 0x04a9, 0x04a9, 0x04a8, 0x04a8, // 63192
-    0x04a7, 0x04a7, 0x04a6, 0x04a6, 0x04a5, 0x04a5, 0x04a4, 0x04a4, // 63200
-    0x04a3, 0x04a2, 0x04a2, 0x04a1, 0x04a1, 0x04a0, 0x04a0, 0x049f, // 63208
-    0x049f, 0x049e, 0x049e, 0x049d, 0x049d, 0x049c, 0x049c, 0x049b, // 63216
-    0x049b, 0x049a, 0x049a, 0x0499, 0x0499, 0x0498, 0x0498, 0x0497, // 63224
-    0x0497, 0x0496, 0x0495, 0x0495, 0x0494, 0x0494, 0x0493, 0x0493, // 63232
-    0x0492, 0x0492, 0x0491, 0x0491, 0x0490, 0x0490, 0x048f, 0x048f, // 63240
-    0x048e, 0x048e, 0x048d, 0x048d, 0x048c, 0x048c, 0x048b, 0x048b, // 63248
-    0x048a, 0x0489, 0x0489, 0x0488, 0x0488, 0x0487, 0x0487, 0x0486, // 63256
-    0x0486, 0x0485, 0x0485, 0x0484, 0x0484, 0x0483, 0x0483, 0x0482, // 63264
-    0x0482, 0x0481, 0x0481, 0x0480, 0x0480, 0x047f, 0x047f, 0x047e, // 63272
-    0x047d, 0x047d, 0x047c, 0x047c, 0x047b, 0x047b, 0x047a, 0x047a, // 63280
-    0x0479, 0x0479, 0x0478, 0x0478, 0x0477, 0x0477, 0x0476, 0x0476, // 63288
-    0x0475, 0x0475, 0x0474, 0x0474, 0x0473, 0x0473, 0x0472, 0x0471, // 63296
-    0x0471, 0x0470, 0x0470, 0x046f, 0x046f, 0x046e, 0x046e, 0x046d, // 63304
-    0x046d, 0x046c, 0x046c, 0x046b, 0x046b, 0x046a, 0x046a, 0x0469, // 63312
-    0x0469, 0x0468, 0x0468, 0x0467, 0x0467, 0x0466, 0x0465, 0x0465, // 63320
-    0x0464, 0x0464, 0x0463, 0x0463, 0x0462, 0x0462, 0x0461, 0x0461, // 63328
-    0x0460, 0x0460, 0x045f, 0x045f, 0x045e, 0x045e, 0x045d, 0x045d, // 63336
-    0x045c, 0x045c, 0x045b, 0x045b, 0x045a, 0x0459, 0x0459, 0x0458, // 63344
-    0x0458, 0x0457, 0x0457, 0x0456, 0x0456, 0x0455, 0x0455, 0x0454, // 63352
-    0x0454, 0x0453, 0x0453, 0x0452, 0x0452, 0x0451, 0x0451, 0x0450, // 63360
-    0x0450, 0x044f, 0x044f, 0x044e, 0x044d, 0x044d, 0x044c, 0x044c, // 63368
-    0x044b, 0x044b, 0x044a, 0x044a, 0x0449, 0x0449, 0x0448, 0x0448, // 63376
-    0x0447, 0x0447, 0x0446, 0x0446, 0x0445, 0x0445, 0x0444, 0x0444, // 63384
-    0x0443, 0x0443, 0x0442, 0x0441, 0x0441, 0x0440, 0x0440, 0x043f, // 63392
-    0x043f, 0x043e, 0x043e, 0x043d, 0x043d, 0x043c, 0x043c, 0x043b, // 63400
-    0x043b, 0x043a, 0x043a, 0x0439, 0x0439, 0x0438, 0x0438, 0x0437, // 63408
-    0x0437, 0x0436, 0x0436, 0x0435, 0x0434, 0x0434, 0x0433, 0x0433, // 63416
-    0x0432, 0x0432, 0x0431, 0x0431, 0x0430, 0x0430, 0x042f, 0x042f, // 63424
-    0x042e, 0x042e, 0x042d, 0x042d, 0x042c, 0x042c, 0x042b, 0x042b, // 63432
-    0x042a, 0x042a, 0x0429, 0x0428, 0x0428, 0x0427, 0x0427, 0x0426, // 63440
-    0x0426, 0x0425, 0x0425, 0x0424, 0x0424, 0x0423, 0x0423, 0x0422, // 63448
-    0x0422, 0x0421, 0x0421, 0x0420, 0x0420, 0x041f, 0x041f, 0x041e, // 63456
-    0x041e, 0x041d, 0x041c, 0x041c, 0x041b, 0x041b, 0x041a, 0x041a, // 63464
-    0x0419, 0x0419, 0x0418, 0x0418, 0x0417, 0x0417, 0x0416, 0x0416, // 63472
-    0x0415, 0x0415, 0x0414, 0x0414, 0x0413, 0x0413, 0x0412, 0x0412, // 63480
-    0x0412, 0x0411, 0x0411, 0x0410, 0x0410, 0x040f, 0x040f, 0x040e, // 63488
-    0x040e, 0x040d, 0x040d, 0x040c, 0x040c, 0x040b, 0x040b, 0x040a, // 63496
-    0x040a, 0x0409, 0x0409, 0x0408, 0x0408, 0x0407, 0x0407, 0x0406, // 63504
-    0x0406, 0x0405, 0x0405, 0x0404, 0x0404, 0x0403, 0x0403, 0x0402, // 63512
-    0x0402, 0x0401, 0x0401, 0x0400, 0x0400, 0x03ff, 0x03fe, 0x03fe, // 63520
-    0x03fd, 0x03fd, 0x03fc, 0x03fc, 0x03fb, 0x03fb, 0x03fa, 0x03fa, // 63528
-    0x03f9, 0x03f9, 0x03f8, 0x03f8, 0x03f7, 0x03f7, 0x03f6, 0x03f6, // 63536
-    0x03f5, 0x03f5, 0x03f4, 0x03f4, 0x03f3, 0x03f3, 0x03f2, 0x03f2, // 63544
-    0x03f1, 0x03f1, 0x03f0, 0x03f0, 0x03ef, 0x03ef, 0x03ee, 0x03ee, // 63552
-    0x03ed, 0x03ed, 0x03ec, 0x03eb, 0x03eb, 0x03ea, 0x03ea, 0x03e9, // 63560
-    0x03e9, 0x03e8, 0x03e8, 0x03e7, 0x03e7, 0x03e6, 0x03e6, 0x03e5, // 63568
-    0x03e5, 0x03e4, 0x03e4, 0x03e3, 0x03e3, 0x03e2, 0x03e2, 0x03e1, // 63576
-    0x03e1, 0x03e0, 0x03e0, 0x03df, 0x03df, 0x03de, 0x03de, 0x03dd, // 63584
-    0x03dd, 0x03dc, 0x03dc, 0x03db, 0x03db, 0x03da, 0x03d9, 0x03d9, // 63592
-    0x03d8, 0x03d8, 0x03d7, 0x03d7, 0x03d6, 0x03d6, 0x03d5, 0x03d5, // 63600
-    0x03d4, 0x03d4, 0x03d3, 0x03d3, 0x03d2, 0x03d2, 0x03d1, 0x03d1, // 63608
-    0x03d0, 0x03d0, 0x03cf, 0x03cf, 0x03ce, 0x03ce, 0x03cd, 0x03cd, // 63616
-    0x03cc, 0x03cc, 0x03cb, 0x03cb, 0x03ca, 0x03ca, 0x03c9, 0x03c9, // 63624
-    0x03c8, 0x03c8, 0x03c7, 0x03c6, 0x03c6, 0x03c5, 0x03c5, 0x03c4, // 63632
-    0x03c4, 0x03c3, 0x03c3, 0x03c2, 0x03c2, 0x03c1, 0x03c1, 0x03c0, // 63640
-    0x03c0, 0x03bf, 0x03bf, 0x03be, 0x03be, 0x03bd, 0x03bd, 0x03bc, // 63648
-    0x03bc, 0x03bb, 0x03bb, 0x03ba, 0x03ba, 0x03b9, 0x03b9, 0x03b8, // 63656
-    0x03b8, 0x03b7, 0x03b7, 0x03b6, 0x03b6, 0x03b5, 0x03b5, 0x03b4, // 63664
-    0x03b3, 0x03b3, 0x03b2, 0x03b2, 0x03b1, 0x03b1, 0x03b0, 0x03b0, // 63672
-    0x03af, 0x03af, 0x03ae, 0x03ae, 0x03ad, 0x03ad, 0x03ac, 0x03ac, // 63680
-    0x03ab, 0x03ab, 0x03aa, 0x03aa, 0x03a9, 0x03a9, 0x03a8, 0x03a8, // 63688
-    0x03a7, 0x03a7, 0x03a6, 0x03a6, 0x03a5, 0x03a5, 0x03a4, 0x03a4, // 63696
-    0x03a3, 0x03a3, 0x03a2, 0x03a2, 0x03a1, 0x03a0, 0x03a0, 0x039f, // 63704
-    0x039f, 0x039e, 0x039e, 0x039d, 0x039d, 0x039c, 0x039c, 0x039b, // 63712
-    0x039b, 0x039a, 0x039a, 0x0399, 0x0399, 0x0398, 0x0398, 0x0397, // 63720
-    0x0397, 0x0396, 0x0396, 0x0395, 0x0395, 0x0394, 0x0394, 0x0393, // 63728
-    0x0393, 0x0392, 0x0392, 0x0391, 0x0391, 0x0390, 0x0390, 0x038f, // 63736
-    0x038f, 0x038e, 0x038d, 0x038d, 0x038c, 0x038c, 0x038b, 0x038b, // 63744
-    0x038a, 0x038a, 0x0389, 0x0389, 0x0388, 0x0388, 0x0387, 0x0387, // 63752
-    0x0386, 0x0386, 0x0385, 0x0385, 0x0384, 0x0384, 0x0383, 0x0383, // 63760
-    0x0382, 0x0382, 0x0381, 0x0381, 0x0380, 0x0380, 0x037f, 0x037f, // 63768
-    0x037e, 0x037e, 0x037d, 0x037d, 0x037c, 0x037b, 0x037b, 0x037a, // 63776
-    0x037a, 0x0379, 0x0379, 0x0378, 0x0378, 0x0377, 0x0377, 0x0376, // 63784
-    0x0376, 0x0375, 0x0375, 0x0374, 0x0374, 0x0373, 0x0373, 0x0372, // 63792
-    0x0372, 0x0371, 0x0371, 0x0370, 0x0370, 0x036f, 0x036f, 0x036e, // 63800
-    0x036e, 0x036d, 0x036d, 0x036c, 0x036c, 0x036b, 0x036b, 0x036a, // 63808
-    0x036a, 0x0369, 0x0368, 0x0368, 0x0367, 0x0367, 0x0366, 0x0366, // 63816
-    0x0365, 0x0365, 0x0364, 0x0364, 0x0363, 0x0363, 0x0362, 0x0362, // 63824
-    0x0361, 0x0361, 0x0360, 0x0360, 0x035f, 0x035f, 0x035e, 0x035e, // 63832
-    0x035d, 0x035d, 0x035c, 0x035c, 0x035b, 0x035b, 0x035a, 0x035a, // 63840
-    0x0359, 0x0359, 0x0358, 0x0358, 0x0357, 0x0357, 0x0356, 0x0355, // 63848
-    0x0355, 0x0354, 0x0354, 0x0353, 0x0353, 0x0352, 0x0352, 0x0351, // 63856
-    0x0351, 0x0350, 0x0350, 0x034f, 0x034f, 0x034e, 0x034e, 0x034d, // 63864
-    0x034d, 0x034c, 0x034c, 0x034b, 0x034b, 0x034a, 0x034a, 0x0349, // 63872
-    0x0349, 0x0348, 0x0348, 0x0347, 0x0347, 0x0346, 0x0346, 0x0345, // 63880
-    0x0345, 0x0344, 0x0344, 0x0343, 0x0342, 0x0342, 0x0341, 0x0341, // 63888
-    0x0340, 0x0340, 0x033f, 0x033f, 0x033e, 0x033e, 0x033d, 0x033d, // 63896
-    0x033c, 0x033c, 0x033b, 0x033b, 0x033a, 0x033a, 0x0339, 0x0339, // 63904
-    0x0338, 0x0338, 0x0337, 0x0337, 0x0336, 0x0336, 0x0335, 0x0335, // 63912
-    0x0334, 0x0334, 0x0333, 0x0333, 0x0332, 0x0332, 0x0331, 0x0330, // 63920
-    0x0330, 0x032f, 0x032f, 0x032e, 0x032e, 0x032d, 0x032d, 0x032c, // 63928
-    0x032c, 0x032b, 0x032b, 0x032a, 0x032a, 0x0329, 0x0329, 0x0328, // 63936
-    0x0328, 0x0327, 0x0327, 0x0326, 0x0326, 0x0325, 0x0325, 0x0324, // 63944
-    0x0324, 0x0323, 0x0323, 0x0322, 0x0322, 0x0321, 0x0321, 0x0320, // 63952
-    0x0320, 0x031f, 0x031f, 0x031e, 0x031d, 0x031d, 0x031c, 0x031c, // 63960
-    0x031b, 0x031b, 0x031a, 0x031a, 0x0319, 0x0319, 0x0318, 0x0318, // 63968
-    0x0317, 0x0317, 0x0316, 0x0316, 0x0315, 0x0315, 0x0314, 0x0314, // 63976
-    0x0313, 0x0313, 0x0312, 0x0312, 0x0311, 0x0311, 0x0310, 0x0310, // 63984
-    0x030f, 0x030f, 0x030e, 0x030e, 0x030d, 0x030d, 0x030c, 0x030c, // 63992
-    0x030b, 0x030a, 0x030a, 0x0309, 0x0309, 0x0308, 0x0308, 0x0307, // 64000
-    0x0307, 0x0306, 0x0306, 0x0305, 0x0305, 0x0304, 0x0304, 0x0303, // 64008
-    0x0303, 0x0302, 0x0302, 0x0301, 0x0301, 0x0300, 0x0300, 0x02ff, // 64016
-    0x02ff, 0x02fe, 0x02fe, 0x02fd, 0x02fd, 0x02fc, 0x02fc, 0x02fb, // 64024
-    0x02fb, 0x02fa, 0x02fa, 0x02f9, 0x02f9, 0x02f8, 0x02f7, 0x02f7, // 64032
-    0x02f6, 0x02f6, 0x02f5, 0x02f5, 0x02f4, 0x02f4, 0x02f3, 0x02f3, // 64040
-    0x02f2, 0x02f2, 0x02f1, 0x02f1, 0x02f0, 0x02f0, 0x02ef, 0x02ef, // 64048
-    0x02ee, 0x02ee, 0x02ed, 0x02ed, 0x02ec, 0x02ec, 0x02eb, 0x02eb, // 64056
-    0x02ea, 0x02ea, 0x02e9, 0x02e9, 0x02e8, 0x02e8, 0x02e7, 0x02e7, // 64064
-    0x02e6, 0x02e6, 0x02e5, 0x02e4, 0x02e4, 0x02e3, 0x02e3, 0x02e2, // 64072
-    0x02e2, 0x02e1, 0x02e1, 0x02e0, 0x02e0, 0x02df, 0x02df, 0x02de, // 64080
-    0x02de, 0x02dd, 0x02dd, 0x02dc, 0x02dc, 0x02db, 0x02db, 0x02da, // 64088
-    0x02da, 0x02d9, 0x02d9, 0x02d8, 0x02d8, 0x02d7, 0x02d7, 0x02d6, // 64096
-    0x02d6, 0x02d5, 0x02d5, 0x02d4, 0x02d4, 0x02d3, 0x02d2, 0x02d2, // 64104
-    0x02d1, 0x02d1, 0x02d0, 0x02d0, 0x02cf, 0x02cf, 0x02ce, 0x02ce, // 64112
-    0x02cd, 0x02cd, 0x02cc, 0x02cc, 0x02cb, 0x02cb, 0x02ca, 0x02ca, // 64120
-    0x02c9, 0x02c9, 0x02c8, 0x02c8, 0x02c7, 0x02c7, 0x02c6, 0x02c6, // 64128
-    0x02c5, 0x02c5, 0x02c4, 0x02c4, 0x02c3, 0x02c3, 0x02c2, 0x02c2, // 64136
-    0x02c1, 0x02c1, 0x02c0, 0x02bf, 0x02bf, 0x02be, 0x02be, 0x02bd, // 64144
-    0x02bd, 0x02bc, 0x02bc, 0x02bb, 0x02bb, 0x02ba, 0x02ba, 0x02b9, // 64152
-    0x02b9, 0x02b8, 0x02b8, 0x02b7, 0x02b7, 0x02b6, 0x02b6, 0x02b5, // 64160
-    0x02b5, 0x02b4, 0x02b4, 0x02b3, 0x02b3, 0x02b2, 0x02b2, 0x02b1, // 64168
-    0x02b1, 0x02b0, 0x02b0, 0x02af, 0x02af, 0x02ae, 0x02ae, 0x02ad, // 64176
-    0x02ac, 0x02ac, 0x02ab, 0x02ab, 0x02aa, 0x02aa, 0x02a9, 0x02a9, // 64184
-    0x02a8, 0x02a8, 0x02a7, 0x02a7, 0x02a6, 0x02a6, 0x02a5, 0x02a5, // 64192
-    0x02a4, 0x02a4, 0x02a3, 0x02a3, 0x02a2, 0x02a2, 0x02a1, 0x02a1, // 64200
-    0x02a0, 0x02a0, 0x029f, 0x029f, 0x029e, 0x029e, 0x029d, 0x029d, // 64208
-    0x029c, 0x029c, 0x029b, 0x029b, 0x029a, 0x0299, 0x0299, 0x0298, // 64216
-    0x0298, 0x0297, 0x0297, 0x0296, 0x0296, 0x0295, 0x0295, 0x0294, // 64224
-    0x0294, 0x0293, 0x0293, 0x0292, 0x0292, 0x0291, 0x0291, 0x0290, // 64232
-    0x0290, 0x028f, 0x028f, 0x028e, 0x028e, 0x028d, 0x028d, 0x028c, // 64240
-    0x028c, 0x028b, 0x028b, 0x028a, 0x028a, 0x0289, 0x0289, 0x0288, // 64248
-    0x0288, 0x0287, 0x0286, 0x0286, 0x0285, 0x0285, 0x0284, 0x0284, // 64256
-    0x0283, 0x0283, 0x0282, 0x0282, 0x0281, 0x0281, 0x0280, 0x0280, // 64264
-    0x027f, 0x027f, 0x027e, 0x027e, 0x027d, 0x027d, 0x027c, 0x027c, // 64272
-    0x027b, 0x027b, 0x027a, 0x027a, 0x0279, 0x0279, 0x0278, 0x0278, // 64280
-    0x0277, 0x0277, 0x0276, 0x0276, 0x0275, 0x0274, 0x0274, 0x0273, // 64288
-    0x0273, 0x0272, 0x0272, 0x0271, 0x0271, 0x0270, 0x0270, 0x026f, // 64296
-    0x026f, 0x026e, 0x026e, 0x026d, 0x026d, 0x026c, 0x026c, 0x026b, // 64304
-    0x026b, 0x026a, 0x026a, 0x0269, 0x0269, 0x0268, 0x0268, 0x0267, // 64312
-    0x0267, 0x0266, 0x0266, 0x0265, 0x0265, 0x0264, 0x0264, 0x0263, // 64320
-    0x0263, 0x0262, 0x0261, 0x0261, 0x0260, 0x0260, 0x025f, 0x025f, // 64328
-    0x025e, 0x025e, 0x025d, 0x025d, 0x025c, 0x025c, 0x025b, 0x025b, // 64336
-    0x025a, 0x025a, 0x0259, 0x0259, 0x0258, 0x0258, 0x0257, 0x0257, // 64344
-    0x0256, 0x0256, 0x0255, 0x0255, 0x0254, 0x0254, 0x0253, 0x0253, // 64352
-    0x0252, 0x0252, 0x0251, 0x0251, 0x0250, 0x0250, 0x024f, 0x024e, // 64360
-    0x024e, 0x024d, 0x024d, 0x024c, 0x024c, 0x024b, 0x024b, 0x024a, // 64368
-    0x024a, 0x0249, 0x0249, 0x0248, 0x0248, 0x0247, 0x0247, 0x0246, // 64376
-    0x0246, 0x0245, 0x0245, 0x0244, 0x0244, 0x0243, 0x0243, 0x0242, // 64384
-    0x0242, 0x0241, 0x0241, 0x0240, 0x0240, 0x023f, 0x023f, 0x023e, // 64392
-    0x023e, 0x023d, 0x023d, 0x023c, 0x023b, 0x023b, 0x023a, 0x023a, // 64400
-    0x0239, 0x0239, 0x0238, 0x0238, 0x0237, 0x0237, 0x0236, 0x0236, // 64408
-    0x0235, 0x0235, 0x0234, 0x0234, 0x0233, 0x0233, 0x0232, 0x0232, // 64416
-    0x0231, 0x0231, 0x0230, 0x0230, 0x022f, 0x022f, 0x022e, 0x022e, // 64424
-    0x022d, 0x022d, 0x022c, 0x022c, 0x022b, 0x022b, 0x022a, 0x0229, // 64432
-    0x0229, 0x0228, 0x0228, 0x0227, 0x0227, 0x0226, 0x0226, 0x0225, // 64440
-    0x0225, 0x0224, 0x0224, 0x0223, 0x0223, 0x0222, 0x0222, 0x0221, // 64448
-    0x0221, 0x0220, 0x0220, 0x021f, 0x021f, 0x021e, 0x021e, 0x021d, // 64456
-    0x021d, 0x021c, 0x021c, 0x021b, 0x021b, 0x021a, 0x021a, 0x0219, // 64464
-    0x0219, 0x0218, 0x0218, 0x0217, 0x0216, 0x0216, 0x0215, 0x0215, // 64472
-    0x0214, 0x0214, 0x0213, 0x0213, 0x0212, 0x0212, 0x0211, 0x0211, // 64480
-    0x0210, 0x0210, 0x020f, 0x020f, 0x020e, 0x020e, 0x020d, 0x020d, // 64488
-    0x020c, 0x020c, 0x020b, 0x020b, 0x020a, 0x020a, 0x0209, 0x0209, // 64496
-    0x0208, 0x0208, 0x0207, 0x0207, 0x0206, 0x0206, 0x0205, 0x0205, // 64504
-    0x0205, 0x0204, 0x0204, 0x0203, 0x0203, 0x0202, 0x0202, 0x0201, // 64512
-    0x0201, 0x0200, 0x0200, 0x01ff, 0x01ff, 0x01fe, 0x01fe, 0x01fd, // 64520
-    0x01fd, 0x01fc, 0x01fc, 0x01fb, 0x01fb, 0x01fa, 0x01fa, 0x01f9, // 64528
-    0x01f9, 0x01f8, 0x01f8, 0x01f7, 0x01f7, 0x01f6, 0x01f6, 0x01f5, // 64536
-    0x01f5, 0x01f4, 0x01f4, 0x01f3, 0x01f3, 0x01f2, 0x01f2, 0x01f1, // 64544
-    0x01f1, 0x01f0, 0x01f0, 0x01ef, 0x01ef, 0x01ee, 0x01ee, 0x01ed, // 64552
-    0x01ed, 0x01ec, 0x01ec, 0x01eb, 0x01eb, 0x01ea, 0x01ea, 0x01e9, // 64560
-    0x01e9, 0x01e8, 0x01e8, 0x01e7, 0x01e7, 0x01e6, 0x01e6, 0x01e5, // 64568
-    0x01e5, 0x01e4, 0x01e4, 0x01e3, 0x01e3, 0x01e2, 0x01e2, 0x01e1, // 64576
-    0x01e1, 0x01e0, 0x01e0, 0x01df, 0x01df, 0x01de, 0x01de, 0x01dd, // 64584
-    0x01dd, 0x01dc, 0x01dc, 0x01db, 0x01db, 0x01da, 0x01d9, 0x01d9, // 64592
-    0x01d8, 0x01d8, 0x01d7, 0x01d7, 0x01d6, 0x01d6, 0x01d5, 0x01d5, // 64600
-    0x01d4, 0x01d4, 0x01d3, 0x01d3, 0x01d2, 0x01d2, 0x01d1, 0x01d1, // 64608
-    0x01d0, 0x01d0, 0x01cf, 0x01cf, 0x01ce, 0x01ce, 0x01cd, 0x01cd, // 64616
-    0x01cc, 0x01cc, 0x01cb, 0x01cb, 0x01ca, 0x01ca, 0x01c9, 0x01c9, // 64624
-    0x01c8, 0x01c8, 0x01c7, 0x01c7, 0x01c6, 0x01c6, 0x01c5, 0x01c5, // 64632
-    0x01c4, 0x01c4, 0x01c3, 0x01c3, 0x01c2, 0x01c2, 0x01c1, 0x01c1, // 64640
-    0x01c0, 0x01c0, 0x01bf, 0x01bf, 0x01be, 0x01be, 0x01bd, 0x01bd, // 64648
-    0x01bc, 0x01bc, 0x01bb, 0x01bb, 0x01ba, 0x01ba, 0x01b9, 0x01b9, // 64656
-    0x01b8, 0x01b8, 0x01b7, 0x01b7, 0x01b6, 0x01b6, 0x01b5, 0x01b5, // 64664
-    0x01b4, 0x01b4, 0x01b3, 0x01b3, 0x01b2, 0x01b2, 0x01b1, 0x01b1, // 64672
-    0x01b0, 0x01b0, 0x01af, 0x01ae, 0x01ae, 0x01ad, 0x01ad, 0x01ac, // 64680
-    0x01ac, 0x01ab, 0x01ab, 0x01aa, 0x01aa, 0x01a9, 0x01a9, 0x01a8, // 64688
-    0x01a8, 0x01a7, 0x01a7, 0x01a6, 0x01a6, 0x01a5, 0x01a5, 0x01a4, // 64696
-    0x01a4, 0x01a3, 0x01a3, 0x01a2, 0x01a2, 0x01a1, 0x01a1, 0x01a0, // 64704
-    0x01a0, 0x019f, 0x019f, 0x019e, 0x019e, 0x019d, 0x019d, 0x019c, // 64712
-    0x019c, 0x019b, 0x019b, 0x019a, 0x019a, 0x0199, 0x0199, 0x0198, // 64720
-    0x0198, 0x0197, 0x0197, 0x0196, 0x0196, 0x0195, 0x0195, 0x0194, // 64728
-    0x0194, 0x0193, 0x0193, 0x0192, 0x0192, 0x0191, 0x0191, 0x0190, // 64736
-    0x0190, 0x018f, 0x018f, 0x018e, 0x018e, 0x018d, 0x018d, 0x018c, // 64744
-    0x018c, 0x018b, 0x018b, 0x018a, 0x018a, 0x0189, 0x0189, 0x0188, // 64752
-    0x0188, 0x0187, 0x0187, 0x0186, 0x0186, 0x0185, 0x0185, 0x0184, // 64760
-    0x0184, 0x0183, 0x0182, 0x0182, 0x0181, 0x0181, 0x0180, 0x0180, // 64768
-    0x017f, 0x017f, 0x017e, 0x017e, 0x017d, 0x017d, 0x017c, 0x017c, // 64776
-    0x017b, 0x017b, 0x017a, 0x017a, 0x0179, 0x0179, 0x0178, 0x0178, // 64784
-    0x0177, 0x0177, 0x0176, 0x0176, 0x0175, 0x0175, 0x0174, 0x0174, // 64792
-    0x0173, 0x0173, 0x0172, 0x0172, 0x0171, 0x0171, 0x0170, 0x0170, // 64800
-    0x016f, 0x016f, 0x016e, 0x016e, 0x016d, 0x016d, 0x016c, 0x016c, // 64808
-    0x016b, 0x016b, 0x016a, 0x016a, 0x0169, 0x0169, 0x0168, 0x0168, // 64816
-    0x0167, 0x0167, 0x0166, 0x0166, 0x0165, 0x0165, 0x0164, 0x0164, // 64824
-    0x0163, 0x0163, 0x0162, 0x0162, 0x0161, 0x0161, 0x0160, 0x0160, // 64832
-    0x015f, 0x015f, 0x015e, 0x015e, 0x015d, 0x015d, 0x015c, 0x015c, // 64840
-    0x015b, 0x015b, 0x015a, 0x015a, 0x0159, 0x0159, 0x0158, 0x0157, // 64848
-    0x0157, 0x0156, 0x0156, 0x0155, 0x0155, 0x0154, 0x0154, 0x0153, // 64856
-    0x0153, 0x0152, 0x0152, 0x0151, 0x0151, 0x0150, 0x0150, 0x014f, // 64864
-    0x014f, 0x014e, 0x014e, 0x014d, 0x014d, 0x014c, 0x014c, 0x014b, // 64872
-    0x014b, 0x014a, 0x014a, 0x0149, 0x0149, 0x0148, 0x0148, 0x0147, // 64880
-    0x0147, 0x0146, 0x0146, 0x0145, 0x0145, 0x0144, 0x0144, 0x0143, // 64888
-    0x0143, 0x0142, 0x0142, 0x0141, 0x0141, 0x0140, 0x0140, 0x013f, // 64896
-    0x013f, 0x013e, 0x013e, 0x013d, 0x013d, 0x013c, 0x013c, 0x013b, // 64904
-    0x013b, 0x013a, 0x013a, 0x0139, 0x0139, 0x0138, 0x0138, 0x0137, // 64912
-    0x0137, 0x0136, 0x0136, 0x0135, 0x0135, 0x0134, 0x0134, 0x0133, // 64920
-    0x0133, 0x0132, 0x0132, 0x0131, 0x0131, 0x0130, 0x0130, 0x012f, // 64928
-    0x012f, 0x012e, 0x012e, 0x012d, 0x012c, 0x012c, 0x012b, 0x012b, // 64936
-    0x012a, 0x012a, 0x0129, 0x0129, 0x0128, 0x0128, 0x0127, 0x0127, // 64944
-    0x0126, 0x0126, 0x0125, 0x0125, 0x0124, 0x0124, 0x0123, 0x0123, // 64952
-    0x0122, 0x0122, 0x0121, 0x0121, 0x0120, 0x0120, 0x011f, 0x011f, // 64960
-    0x011e, 0x011e, 0x011d, 0x011d, 0x011c, 0x011c, 0x011b, 0x011b, // 64968
-    0x011a, 0x011a, 0x0119, 0x0119, 0x0118, 0x0118, 0x0117, 0x0117, // 64976
-    0x0116, 0x0116, 0x0115, 0x0115, 0x0114, 0x0114, 0x0113, 0x0113, // 64984
-    0x0112, 0x0112, 0x0111, 0x0111, 0x0110, 0x0110, 0x010f, 0x010f, // 64992
-    0x010e, 0x010e, 0x010d, 0x010d, 0x010c, 0x010c, 0x010b, 0x010b, // 65000
-    0x010a, 0x010a, 0x0109, 0x0109, 0x0108, 0x0108, 0x0107, 0x0107, // 65008
-    0x0106, 0x0106, 0x0105, 0x0105, 0x0104, 0x0104, 0x0103, 0x0103, // 65016
-    0x0102, 0x0101, 0x0101, 0x0100, 0x0100, 0x00ff, 0x00ff, 0x00fe, // 65024
-    0x00fe, 0x00fd, 0x00fd, 0x00fc, 0x00fc, 0x00fb, 0x00fb, 0x00fa, // 65032
-    0x00fa, 0x00f9, 0x00f9, 0x00f8, 0x00f8, 0x00f7, 0x00f7, 0x00f6, // 65040
-    0x00f6, 0x00f5, 0x00f5, 0x00f4, 0x00f4, 0x00f3, 0x00f3, 0x00f2, // 65048
-    0x00f2, 0x00f1, 0x00f1, 0x00f0, 0x00f0, 0x00ef, 0x00ef, 0x00ee, // 65056
-    0x00ee, 0x00ed, 0x00ed, 0x00ec, 0x00ec, 0x00eb, 0x00eb, 0x00ea, // 65064
-    0x00ea, 0x00e9, 0x00e9, 0x00e8, 0x00e8, 0x00e7, 0x00e7, 0x00e6, // 65072
-    0x00e6, 0x00e5, 0x00e5, 0x00e4, 0x00e4, 0x00e3, 0x00e3, 0x00e2, // 65080
-    0x00e2, 0x00e1, 0x00e1, 0x00e0, 0x00e0, 0x00df, 0x00df, 0x00de, // 65088
-    0x00de, 0x00dd, 0x00dd, 0x00dc, 0x00dc, 0x00db, 0x00db, 0x00da, // 65096
-    0x00da, 0x00d9, 0x00d9, 0x00d8, 0x00d8, 0x00d7, 0x00d6, 0x00d6, // 65104
-    0x00d5, 0x00d5, 0x00d4, 0x00d4, 0x00d3, 0x00d3, 0x00d2, 0x00d2, // 65112
-    0x00d1, 0x00d1, 0x00d0, 0x00d0, 0x00cf, 0x00cf, 0x00ce, 0x00ce, // 65120
-    0x00cd, 0x00cd, 0x00cc, 0x00cc, 0x00cb, 0x00cb, 0x00ca, 0x00ca, // 65128
-    0x00c9, 0x00c9, 0x00c8, 0x00c8, 0x00c7, 0x00c7, 0x00c6, 0x00c6, // 65136
-    0x00c5, 0x00c5, 0x00c4, 0x00c4, 0x00c3, 0x00c3, 0x00c2, 0x00c2, // 65144
-    0x00c1, 0x00c1, 0x00c0, 0x00c0, 0x00bf, 0x00bf, 0x00be, 0x00be, // 65152
-    0x00bd, 0x00bd, 0x00bc, 0x00bc, 0x00bb, 0x00bb, 0x00ba, 0x00ba, // 65160
-    0x00b9, 0x00b9, 0x00b8, 0x00b8, 0x00b7, 0x00b7, 0x00b6, 0x00b6, // 65168
-    0x00b5, 0x00b5, 0x00b4, 0x00b4, 0x00b3, 0x00b3, 0x00b2, 0x00b2, // 65176
-    0x00b1, 0x00b1, 0x00b0, 0x00b0, 0x00af, 0x00af, 0x00ae, 0x00ae, // 65184
-    0x00ad, 0x00ad, 0x00ac, 0x00ab, 0x00ab, 0x00aa, 0x00aa, 0x00a9, // 65192
-    0x00a9, 0x00a8, 0x00a8, 0x00a7, 0x00a7, 0x00a6, 0x00a6, 0x00a5, // 65200
-    0x00a5, 0x00a4, 0x00a4, 0x00a3, 0x00a3, 0x00a2, 0x00a2, 0x00a1, // 65208
-    0x00a1, 0x00a0, 0x00a0, 0x009f, 0x009f, 0x009e, 0x009e, 0x009d, // 65216
-    0x009d, 0x009c, 0x009c, 0x009b, 0x009b, 0x009a, 0x009a, 0x0099, // 65224
-    0x0099, 0x0098, 0x0098, 0x0097, 0x0097, 0x0096, 0x0096, 0x0095, // 65232
-    0x0095, 0x0094, 0x0094, 0x0093, 0x0093, 0x0092, 0x0092, 0x0091, // 65240
-    0x0091, 0x0090, 0x0090, 0x008f, 0x008f, 0x008e, 0x008e, 0x008d, // 65248
-    0x008d, 0x008c, 0x008c, 0x008b, 0x008b, 0x008a, 0x008a, 0x0089, // 65256
-    0x0089, 0x0088, 0x0088, 0x0087, 0x0087, 0x0086, 0x0086, 0x0085, // 65264
-    0x0085, 0x0084, 0x0084, 0x0083, 0x0083, 0x0082, 0x0082, 0x0081, // 65272
-    0x0081, 0x0080, 0x007f, 0x007f, 0x007e, 0x007e, 0x007d, 0x007d, // 65280
-    0x007c, 0x007c, 0x007b, 0x007b, 0x007a, 0x007a, 0x0079, 0x0079, // 65288
-    0x0078, 0x0078, 0x0077, 0x0077, 0x0076, 0x0076, 0x0075, 0x0075, // 65296
-    0x0074, 0x0074, 0x0073, 0x0073, 0x0072, 0x0072, 0x0071, 0x0071, // 65304
-    0x0070, 0x0070, 0x006f, 0x006f, 0x006e, 0x006e, 0x006d, 0x006d, // 65312
-    0x006c, 0x006c, 0x006b, 0x006b, 0x006a, 0x006a, 0x0069, 0x0069, // 65320
-    0x0068, 0x0068, 0x0067, 0x0067, 0x0066, 0x0066, 0x0065, 0x0065, // 65328
-    0x0064, 0x0064, 0x0063, 0x0063, 0x0062, 0x0062, 0x0061, 0x0061, // 65336
-    0x0060, 0x0060, 0x005f, 0x005f, 0x005e, 0x005e, 0x005d, 0x005d, // 65344
-    0x005c, 0x005c, 0x005b, 0x005b, 0x005a, 0x005a, 0x0059, 0x0059, // 65352
-    0x0058, 0x0058, 0x0057, 0x0057, 0x0056, 0x0056, 0x0055, 0x0054, // 65360
-    0x0054, 0x0053, 0x0053, 0x0052, 0x0052, 0x0051, 0x0051, 0x0050, // 65368
-    0x0050, 0x004f, 0x004f, 0x004e, 0x004e, 0x004d, 0x004d, 0x004c, // 65376
-    0x004c, 0x004b, 0x004b, 0x004a, 0x004a, 0x0049, 0x0049, 0x0048, // 65384
-    0x0048, 0x0047, 0x0047, 0x0046, 0x0046, 0x0045, 0x0045, 0x0044, // 65392
-    0x0044, 0x0043, 0x0043, 0x0042, 0x0042, 0x0041, 0x0041, 0x0040, // 65400
-    0x0040, 0x003f, 0x003f, 0x003e, 0x003e, 0x003d, 0x003d, 0x003c, // 65408
-    0x003c, 0x003b, 0x003b, 0x003a, 0x003a, 0x0039, 0x0039, 0x0038, // 65416
-    0x0038, 0x0037, 0x0037, 0x0036, 0x0036, 0x0035, 0x0035, 0x0034, // 65424
-    0x0034, 0x0033, 0x0033, 0x0032, 0x0032, 0x0031, 0x0031, 0x0030, // 65432
-    0x0030, 0x002f, 0x002f, 0x002e, 0x002e, 0x002d, 0x002d, 0x002c, // 65440
-    0x002c, 0x002b, 0x002b, 0x002a, 0x0029, 0x0029, 0x0028, 0x0028, // 65448
-    0x0027, 0x0027, 0x0026, 0x0026, 0x0025, 0x0025, 0x0024, 0x0024, // 65456
-    0x0023, 0x0023, 0x0022, 0x0022, 0x0021, 0x0021, 0x0020, 0x0020, // 65464
-    0x001f, 0x001f, 0x001e, 0x001e, 0x001d, 0x001d, 0x001c, 0x001c, // 65472
-    0x001b, 0x001b, 0x001a, 0x001a, 0x0019, 0x0019, 0x0018, 0x0018, // 65480
-    0x0017, 0x0017, 0x0016, 0x0016, 0x0015, 0x0015, 0x0014, 0x0014, // 65488
-    0x0013, 0x0013, 0x0012, 0x0012, 0x0011, 0x0011, 0x0010, 0x0010, // 65496
-    0x000f, 0x000f, 0x000e, 0x000e, 0x000d, 0x000d, 0x000c, 0x000c, // 65504
-    0x000b, 0x000b, 0x000a, 0x000a, 0x0009, 0x0009, 0x0008, 0x0008, // 65512
-    0x0007, 0x0007, 0x0006, 0x0006, 0x0005, 0x0005, 0x0004, 0x0004, // 65520
-    0x0003, 0x0003, 0x0002, 0x0002, 0x0001, 0x0001, 0x0000, 0x0000, // 65528
-};
+#include "avx512_rcp14.h"
 
 extern float_status_t mxcsr_to_softfloat_status_word(bx_mxcsr_t mxcsr);
 
@@ -8244,7 +43,7 @@ static Bit32u rcp14_table_lookup(Bit32u mant, unsigned bias, Bit16s *exp)
    *  14th bit after the decimal point by round-to-nearest, regardless
    *  of the current rounding mode.
    *
-   * Using precalculated 64K-entry table.
+   * Using piecewise linear interpolation of precalculated 64K-entry table.
    */
 
   Bit16s r_exp = 2*bias - 1 - *exp;
@@ -8256,7 +55,7 @@ static Bit32u rcp14_table_lookup(Bit32u mant, unsigned bias, Bit16s *exp)
   }
   else {
     /* The input to the table is the 16 most significant bits of the 23-bit mantissa */
-    mant = rcp14_table[mant >> 7];
+    mant = rcp14_interpolate(mant >> 7);
   }
 
   *exp = r_exp;
@@ -0,0 +1,68 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//   Copyright (c) 2014-2018 Stanislav Shwartsman
+//          Written by Stanislav Shwartsman [sshwarts at sourceforge net]
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BX_AVX512_RCP14_H
+#define BX_AVX512_RCP14_H
+
+//
+// The table was reverse-engineered from VRCP14SS instruction implementation available
+// in the Intel Software Development Emulator rev6.20 (released February 13, 2014)
+// http://software.intel.com/en-us/articles/intel-software-development-emulator/
+//
+// The original 64K-entry table is piecewise linear: the 16-bit index is split
+// into 64 intervals of 1024 entries and every entry of the interval is
+// computed exactly by linear interpolation (base - slope * offset) >> 9.
+//
+// The coefficients are generated by misc/avx512_rcp14_gen.pl from the
+// original tables in misc/avx512_rcp14_tables.h, "make check" compares
+// every entry.
+//
+
+static const Bit32u rcp14_base[64] = {
+    0x1fff900, 0x1f03600, 0x1e0f200, 0x1d22000, 0x1c3bb00, 0x1b5c700, 0x1a83300, 0x19b0600,
+    0x18e3200, 0x181bc00, 0x1759800, 0x169ca00, 0x15e4c00, 0x1531b00, 0x1483100, 0x13d8c00,
+    0x1332f00, 0x1291100, 0x11f3600, 0x1159300, 0x10c2d00, 0x102ff00, 0x0fa0a00, 0x0f14500,
+    0x0e8b600, 0x0e05800, 0x0d82d00, 0x0d02a00, 0x0c85700, 0x0c0ad00, 0x0b92e00, 0x0b1d700,
+    0x0aaaa00, 0x0a39f00, 0x09cbc00, 0x095f800, 0x08f5a00, 0x088dd00, 0x0828000, 0x07c4300,
+    0x0762800, 0x0702500, 0x06a4100, 0x0647b00, 0x05ed100, 0x0593d00, 0x053c600, 0x04e6800,
+    0x0492300, 0x043f500, 0x03ede00, 0x039e200, 0x034f600, 0x0302100, 0x02b6400, 0x026b700,
+    0x0222200, 0x01d9f00, 0x0192d00, 0x014d300, 0x0108900, 0x00c4f00, 0x0082500, 0x0040b00
+};
+
+static const Bit16u rcp14_slope[64] = {
+    0x3f1, 0x3d1, 0x3b5, 0x399, 0x37d, 0x365, 0x34b, 0x335,
+    0x31d, 0x309, 0x2f3, 0x2df, 0x2cd, 0x2bb, 0x2a9, 0x297,
+    0x287, 0x277, 0x269, 0x259, 0x24b, 0x23d, 0x231, 0x223,
+    0x217, 0x20b, 0x201, 0x1f5, 0x1eb, 0x1df, 0x1d5, 0x1cb,
+    0x1c3, 0x1b9, 0x1b1, 0x1a7, 0x19f, 0x197, 0x18f, 0x187,
+    0x181, 0x179, 0x171, 0x16b, 0x165, 0x15d, 0x157, 0x151,
+    0x14b, 0x145, 0x13f, 0x13b, 0x135, 0x12f, 0x12b, 0x125,
+    0x121, 0x11d, 0x117, 0x113, 0x10f, 0x10b, 0x107, 0x103
+};
+
+BX_CPP_INLINE Bit32u rcp14_interpolate(Bit32u index)
+{
+  return (rcp14_base[index >> 10] - rcp14_slope[index >> 10] * (index & 0x3ff)) >> 9;
+}
+
+#endif
@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//   Copyright (c) 2014-2108 Stanislav Shwartsman
+//          Written by Stanislav Shwartsman [sshwarts at sourceforge net]
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BX_AVX512_RSQRT14_H
+#define BX_AVX512_RSQRT14_H
+
+//
+// The tables were reverse-engineered from VSQRT14SS instruction implementation available
+// in the Intel Software Development Emulator rev6.20 (released February 13, 2014)
+// http://software.intel.com/en-us/articles/intel-software-development-emulator/
+//
+// Both original 32K-entry tables are piecewise linear: the 15-bit index is
+// split into 32 intervals of 1024 entries and every entry of the interval is
+// computed exactly by linear interpolation (base - slope * offset) >> 9.
+//
+// The coefficients are generated by misc/avx512_rcp14_gen.pl from the
+// original tables in misc/avx512_rcp14_tables.h, "make check" compares
+// every entry.
+//
+
+static const Bit32u rsqrt14_base0[32] = {
+    0x0d40a80, 0x0c8fc80, 0x0be6e00, 0x0b45200, 0x0aaa600, 0x0a15b80, 0x0987080, 0x08fdc80,
+    0x0879e80, 0x07fad80, 0x0780280, 0x0709e80, 0x0697a80, 0x0629500, 0x05be880, 0x0557580,
+    0x04f3380, 0x0492180, 0x0433f80, 0x03d8c80, 0x0380180, 0x0329f00, 0x02d6200, 0x0284c00,
+    0x0235900, 0x01e8680, 0x019d380, 0x0153f00, 0x010ca80, 0x00c6e80, 0x0083000, 0x0040b00
+};
+
+static const Bit16u rsqrt14_slope0[32] = {
+    0x2c3, 0x2a3, 0x287, 0x26b, 0x253, 0x23b, 0x225, 0x20f,
+    0x1fd, 0x1eb, 0x1d9, 0x1c9, 0x1b9, 0x1ab, 0x19d, 0x191,
+    0x185, 0x179, 0x16d, 0x163, 0x159, 0x14f, 0x145, 0x13d,
+    0x135, 0x12d, 0x125, 0x11d, 0x117, 0x10f, 0x109, 0x103
+};
+
+static const Bit32u rsqrt14_base1[32] = {
+    0x1fff480, 0x1f05080, 0x1e16280, 0x1d31900, 0x1c56700, 0x1b84380, 0x1aba680, 0x19f8880,
+    0x193dd00, 0x188a080, 0x17dcb80, 0x1735a00, 0x1694100, 0x15f7d00, 0x1560f80, 0x14ced80,
+    0x1441380, 0x13b8180, 0x1332f80, 0x12b1c00, 0x1234680, 0x11ba980, 0x1144400, 0x10d1180,
+    0x1060f80, 0x0ff3d80, 0x0f89b00, 0x0f21f00, 0x0ebcf80, 0x0e5ab00, 0x0dfa780, 0x0d9cd00
+};
+
+static const Bit16u rsqrt14_slope1[32] = {
+    0x3e9, 0x3bb, 0x393, 0x36d, 0x349, 0x327, 0x307, 0x2eb,
+    0x2cf, 0x2b5, 0x29d, 0x287, 0x271, 0x25b, 0x249, 0x237,
+    0x225, 0x215, 0x205, 0x1f5, 0x1e7, 0x1d9, 0x1cd, 0x1c1,
+    0x1b5, 0x1a9, 0x19f, 0x193, 0x189, 0x181, 0x177, 0x16f
+};
+
+BX_CPP_INLINE Bit32u rsqrt14_interpolate(Bit32u index, unsigned odd_exp)
+{
+  const Bit32u *base = odd_exp ? rsqrt14_base1 : rsqrt14_base0;
+  const Bit16u *slope = odd_exp ? rsqrt14_slope1 : rsqrt14_slope0;
+
+  return (base[index >> 10] - slope[index >> 10] * (index & 0x3ff)) >> 9;
+}
+
+#endif
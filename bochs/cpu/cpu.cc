@@ -26,7 +26,11 @@
 
 #include "cpustats.h"
 
+#if BX_SUPPORT_SMP
+BX_THREAD_LOCAL jmp_buf BX_CPU_C::jmp_buf_env;
+#else
 jmp_buf BX_CPU_C::jmp_buf_env;
+#endif
 
 void BX_CPU_C::cpu_loop(void)
 {
@@ -96,6 +100,18 @@ void BX_CPU_C::cpu_loop(void)
 
     for(;;) {
 
+#if BX_SUPPORT_JIT
+      if (entry->jitCode) {
+        // the whole trace is executed by single call to compiled host code
+        if (jitExecuteTrace(entry)) break;
+
+        entry = getICacheEntry();
+        i = entry->i;
+        last = i + (entry->tlen);
+        continue;
+      }
+#endif
+
 #if BX_DEBUGGER
       if (BX_CPU_THIS_PTR trace)
         debug_disasm_instruction(BX_CPU_THIS_PTR prev_rip);
@@ -139,10 +155,14 @@ void BX_CPU_C::cpu_run_trace(void)
   // check on events which occurred for previous instructions (traps)
   // and ones which are asynchronous to the CPU (hardware interrupts)
   if (BX_CPU_THIS_PTR async_event) {
+    // events processing might access devices and other CPUs' local APIC
+    BX_SMP_LOCK();
     if (handleAsyncEvent()) {
+      BX_SMP_UNLOCK();
       // If request to return to caller ASAP.
       return;
     }
+    BX_SMP_UNLOCK();
   }
 
   bxICacheEntry_c *entry = getICacheEntry();
@@ -160,6 +180,16 @@ void BX_CPU_C::cpu_run_trace(void)
     BX_CPU_THIS_PTR async_event &= ~BX_ASYNC_EVENT_STOP_TRACE;
   }
 #else
+#if BX_SUPPORT_JIT
+  if (entry->jitCode) {
+    if (jitExecuteTrace(entry)) {
+      // clear stop trace magic indication that probably was set by repeat or branch32/64
+      BX_CPU_THIS_PTR async_event &= ~BX_ASYNC_EVENT_STOP_TRACE;
+    }
+    return;
+  }
+#endif
+
   bxInstruction_c *last = i + (entry->tlen);
 
   for(;;) {
@@ -198,7 +228,7 @@ bxICacheEntry_c* BX_CPU_C::getICacheEntry(void)
   INC_ICACHE_STAT(iCacheLookups);
 
   bx_phy_address pAddr = BX_CPU_THIS_PTR pAddrFetchPage + eipBiased;
-  bxICacheEntry_c *entry = BX_CPU_THIS_PTR iCache.find_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
+  bxICacheEntry_c *entry = BX_CPU_THIS_PTR iCache->find_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
 
   if (entry == NULL)
   {
@@ -207,6 +237,15 @@ bxICacheEntry_c* BX_CPU_C::getICacheEntry(void)
     INC_ICACHE_STAT(iCacheMisses);
     entry = serveICacheMiss((Bit32u) eipBiased, pAddr);
   }
+#if BX_SUPPORT_SUPERBLOCKS
+  else if (++entry->execCount == BX_SUPERBLOCK_HOT_THRESHOLD) {
+    buildSuperblock(entry);
+  }
+#elif BX_SUPPORT_JIT
+  else if (++entry->execCount == BX_JIT_HOT_THRESHOLD) {
+    jitCompileTrace(entry);
+  }
+#endif
 
 #if BX_SUPPORT_CET
   if (WaitingForEndbranch(CPL)) {
@@ -250,7 +289,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::linkTrace(bxInstruction_c *i)
     return;
   }
 
-  bxInstruction_c *next = i->getNextTrace(BX_CPU_THIS_PTR iCache.traceLinkTimeStamp);
+  bxInstruction_c *next = i->getNextTrace(BX_CPU_THIS_PTR iCache->traceLinkTimeStamp);
   if (next) {
     BX_EXECUTE_INSTRUCTION(next);
     return;
@@ -265,11 +304,15 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::linkTrace(bxInstruction_c *i)
   INC_ICACHE_STAT(iCacheLookups);
 
   bx_phy_address pAddr = BX_CPU_THIS_PTR pAddrFetchPage + eipBiased;
-  bxICacheEntry_c *entry = BX_CPU_THIS_PTR iCache.find_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
+  bxICacheEntry_c *entry = BX_CPU_THIS_PTR iCache->find_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
 
   if (entry != NULL) // link traces - handle only hit cases
   {
-    i->setNextTrace(entry->i, BX_CPU_THIS_PTR iCache.traceLinkTimeStamp);
+#if BX_SUPPORT_SUPERBLOCKS
+    if (++entry->execCount == BX_SUPERBLOCK_HOT_THRESHOLD)
+      buildSuperblock(entry);
+#endif
+    i->setNextTrace(entry->i, BX_CPU_THIS_PTR iCache->traceLinkTimeStamp);
     i = entry->i;
     BX_EXECUTE_INSTRUCTION(i);
   }
@@ -440,9 +440,13 @@ BOCHSAPI extern BX_CPU_C   bx_cpu;
 #endif
 
 // notify internal debugger/instrumentation about memory access
-#define BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, paddr, size, memtype, rw, dataptr) {              \
-  BX_INSTR_LIN_ACCESS(BX_CPU_ID, (laddr), (paddr), (size), (memtype), (rw));                 \
-  BX_DBG_LIN_MEMORY_ACCESS(BX_CPU_ID, (laddr), (paddr), (size), (memtype), (rw), (dataptr)); \
+#define BX_NOTIFY_LIN_MEMORY_ACCESS(laddr, paddr, size, memtype, rw, dataptr) \
+  BX_NOTIFY_CPU_LIN_MEMORY_ACCESS(BX_CPU_ID, laddr, paddr, size, memtype, rw, dataptr)
+
+// same with explicit CPU id, for the code built without NEED_CPU_REG_SHORTCUTS
+#define BX_NOTIFY_CPU_LIN_MEMORY_ACCESS(cpu, laddr, paddr, size, memtype, rw, dataptr) { \
+  BX_INSTR_LIN_ACCESS((cpu), (laddr), (paddr), (size), (memtype), (rw));                 \
+  BX_DBG_LIN_MEMORY_ACCESS((cpu), (laddr), (paddr), (size), (memtype), (rw), (dataptr)); \
 }
 
 #define BX_NOTIFY_PHY_MEMORY_ACCESS(paddr, size, memtype, rw, why, dataptr) {              \
@@ -795,6 +799,20 @@ struct bx_cpu_statistics;
 
 #include "cpuid.h"
 
+#if BX_SUPPORT_FIXED_CPU_MODEL
+// The CPU features are fixed to a single cpudb model at compile time.
+// cpudb_fixed.h is generated by configure from the model constructor and
+// lists its enable_cpu_extension() calls, so every feature check resolves
+// to a compile time constant and the code of absent features is dropped.
+template <unsigned feature> struct bx_fixed_isa_extension {
+  enum { supported = 0
+#define BX_FIXED_ISA_EXTENSION(f) || (feature == (f))
+#include "cpudb_fixed.h"
+#undef BX_FIXED_ISA_EXTENSION
+  };
+};
+#endif
+
 class BOCHSAPI BX_CPU_C : public logfunctions {
 
 public: // for now...
@@ -807,8 +825,13 @@ public: // for now...
 
   Bit32u ia_extensions_bitmask[BX_ISA_EXTENSIONS_ARRAY_SIZE];
 
+#if BX_SUPPORT_FIXED_CPU_MODEL
+#define BX_CPUID_SUPPORT_ISA_EXTENSION(feature) \
+   (bx_fixed_isa_extension<feature>::supported)
+#else
 #define BX_CPUID_SUPPORT_ISA_EXTENSION(feature) \
    (BX_CPU_THIS_PTR ia_extensions_bitmask[feature/32] & (1<<(feature%32)))
+#endif
 
 #if BX_SUPPORT_VMX
   Bit32u vmx_extensions_bitmask;
@@ -1068,6 +1091,17 @@ public: // for now...
   Bit32u  event_mask;
   Bit32u  async_event;
 
+  // in threaded SMP simulation events could be signalled by another thread
+#if BX_SUPPORT_SMP
+  BX_SMF BX_CPP_INLINE void signal_event(Bit32u event) {
+    BX_ATOMIC_OR32(&BX_CPU_THIS_PTR pending_event, event);
+    if (! is_masked_event(event)) BX_CPU_THIS_PTR async_event = 1;
+  }
+
+  BX_SMF BX_CPP_INLINE void clear_event(Bit32u event) {
+    BX_ATOMIC_AND32(&BX_CPU_THIS_PTR pending_event, ~event);
+  }
+#else
   BX_SMF BX_CPP_INLINE void signal_event(Bit32u event) {
     BX_CPU_THIS_PTR pending_event |= event;
     if (! is_masked_event(event)) BX_CPU_THIS_PTR async_event = 1;
@@ -1076,6 +1110,7 @@ public: // for now...
   BX_SMF BX_CPP_INLINE void clear_event(Bit32u event) {
     BX_CPU_THIS_PTR pending_event &= ~event;
   }
+#endif
 
   BX_SMF BX_CPP_INLINE void mask_event(Bit32u event) {
     BX_CPU_THIS_PTR event_mask |= event;
@@ -1123,7 +1158,12 @@ public: // for now...
 #endif
 
   // for exceptions
+#if BX_SUPPORT_SMP
+  // threaded SMP simulation runs every CPU in its own host thread
+  static BX_THREAD_LOCAL jmp_buf jmp_buf_env;
+#else
   static jmp_buf jmp_buf_env;
+#endif
   unsigned last_exception_type;
 
   // Boundaries of current code page, based on EIP
@@ -1193,17 +1233,23 @@ public: // for now...
 #define BX_ITLB_SIZE 1024
   TLB<BX_DTLB_SIZE> DTLB BX_CPP_AlignN(32);
   TLB<BX_ITLB_SIZE> ITLB BX_CPP_AlignN(32);
+  SecondLevelTLB<BX_STLB_SETS, BX_STLB_WAYS> STLB;
 
 #if BX_CPU_LEVEL >= 6
   struct {
     Bit64u entry[4];
   } PDPTR_CACHE;
+
+  PageWalkCache<BX_PWC_SIZE> PWC;
 #endif
 
-  // An instruction cache.  Each entry should be exactly 32 bytes, and
-  // this structure should be aligned on a 32-byte boundary to be friendly
-  // with the host cache lines.
-  bxICache_c iCache BX_CPP_AlignN(32);
+#if BX_SUPPORT_VMX >= 2 || BX_SUPPORT_SVM
+  NestedTLB<BX_NTLB_SIZE> NTLB;
+#endif
+
+  // An instruction cache.  Allocated by initialize(), it might be shared
+  // by all the CPUs (see 'shared_trace_cache' option).
+  bxICache_c *iCache;
   Bit32u fetchModeMask;
 
   struct {
@@ -1223,6 +1269,10 @@ public: // for now...
 #if BX_SUPPORT_MEMTYPE
     BxMemtype memtype1;       // memory type of the page 1
     BxMemtype memtype2;       // memory type of the page 2
+#endif
+#if BX_SUPPORT_SMP
+    Bit64u rmw_data;          // value read by the R-M-W instruction, the write
+                              // back through the host pointer compares it
 #endif
   } address_xlation;
 
@@ -4238,6 +4288,47 @@ public: // for now...
   BX_SMF void BxError(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
 #if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
   BX_SMF void BxEndTrace(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+#if BX_SUPPORT_SUPERBLOCKS
+  BX_SMF void BxSuperblockBranch(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+#endif
+
+  // flag-less handler variants used for instructions with dead flags
+  BX_SMF void ADD_GdEdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void SUB_GdEdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void AND_GdEdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void OR_GdEdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void XOR_GdEdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void ADD_EdIdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void SUB_EdIdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void AND_EdIdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void OR_EdIdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void XOR_EdIdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void INC_EdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void DEC_EdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void ZERO_IDIOM_GdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+#if BX_SUPPORT_X86_64
+  BX_SMF void ADD_GqEqR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void SUB_GqEqR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void AND_GqEqR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void OR_GqEqR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void XOR_GqEqR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void ADD_EqIdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void SUB_EqIdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void AND_EqIdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void OR_EqIdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void XOR_EqIdR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void INC_EqR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF void DEC_EqR_NoFlags(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+#endif
+
+  // fused instruction pairs
+#define bx_define_fusion(first, second, fused) \
+  BX_SMF void fused(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+#define bx_define_fusion_jcc(first, fused) \
+  BX_SMF void fused(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+#include "decoder/fusion.def"
+#undef bx_define_fusion
+#undef bx_define_fusion_jcc
 #endif
 
 #if BX_CPU_LEVEL >= 6
@@ -4301,8 +4392,30 @@ public: // for now...
   BX_SMF bxICacheEntry_c *serveICacheMiss(Bit32u eipBiased, bx_phy_address pAddr);
   BX_SMF bxICacheEntry_c* getICacheEntry(void);
   BX_SMF bx_bool mergeTraces(bxICacheEntry_c *entry, bxInstruction_c *i, bx_phy_address pAddr);
+  BX_SMF bx_bool serveTraceCacheFile(bxICacheEntry_c *entry, const Bit8u *fetchPtr, unsigned remainingInPage, unsigned quantum);
 #if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS && BX_ENABLE_TRACE_LINKING
   BX_SMF void linkTrace(bxInstruction_c *i) BX_CPP_AttrRegparmN(1);
+#endif
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  BX_SMF void eliminateDeadFlags(bxICacheEntry_c *entry);
+  BX_SMF void fuseInstructions(bxICacheEntry_c *entry);
+  BX_SMF void unfuseInstruction(bxInstruction_c *i);
+  BX_SMF bx_bool branchCondition(unsigned cond);
+  static int nearBranchCondition(Bit16u ia_opcode);
+#endif
+#if BX_SUPPORT_SUPERBLOCKS
+  BX_SMF void buildSuperblock(bxICacheEntry_c *entry);
+  BX_SMF bx_bool isSuperblock(const bxICacheEntry_c *e);
+#endif
+#if BX_SUPPORT_JIT
+  BX_SMF void jitCompileTrace(bxICacheEntry_c *entry);
+  BX_SMF void jitFlush(void);
+  static Bit32u jitCommit(BX_CPU_C *cpu);
+  BX_SMF BX_CPP_INLINE Bit32u jitExecuteTrace(bxICacheEntry_c *entry)
+  {
+    // returns non-zero if the trace was stopped by async event
+    return ((Bit32u (*)(void)) entry->jitCode)();
+  }
 #endif
   BX_SMF void prefetch(void);
   BX_SMF void updateFetchModeMask(void);
@@ -4346,6 +4459,10 @@ public: // for now...
   BX_SMF void write_linear_zmmword_aligned(unsigned seg, bx_address off, const BxPackedZmmRegister *data) BX_CPP_AttrRegparmN(3);
 #endif
 
+  // inlined DTLB hit path of the byte/word/dword/qword accesses
+  template <typename T> BX_SMF bx_bool read_linear_tlb_hit(bx_address laddr, T *data);
+  template <typename T> BX_SMF bx_bool write_linear_tlb_hit(bx_address laddr, T data);
+
   BX_SMF void tickle_read_linear(unsigned seg, bx_address offset) BX_CPP_AttrRegparmN(2);
   BX_SMF void tickle_read_virtual_32(unsigned seg, Bit32u offset) BX_CPP_AttrRegparmN(2);
   BX_SMF void tickle_read_virtual(unsigned seg, bx_address offset) BX_CPP_AttrRegparmN(2);
@@ -4427,6 +4544,11 @@ public: // for now...
   BX_SMF void write_RMW_linear_dqword(Bit64u hi, Bit64u lo);
 #endif
 
+#if BX_SUPPORT_SMP
+  BX_SMF void RMW_use_host_ptr(bx_TLB_entry *tlbEntry, bx_address lpf, bx_address laddr, unsigned len);
+  BX_SMF void RMW_restart(void) BX_CPP_AttrNoReturn();
+#endif
+
   // write of word/dword to new stack could happen only in legacy mode
   BX_SMF void write_new_stack_word(bx_segment_reg_t *seg, Bit32u offset, unsigned curr_pl, Bit16u data);
   BX_SMF void write_new_stack_dword(bx_segment_reg_t *seg, Bit32u offset, unsigned curr_pl, Bit32u data);
@@ -4483,7 +4605,9 @@ public: // for now...
        bx_descriptor_t *descriptor, bx_address rip, unsigned cpl);
 
 #if BX_SUPPORT_REPEAT_SPEEDUPS
-  BX_SMF Bit32u FastRepMOVSB(unsigned srcSeg, Bit32u srcOff, unsigned dstSeg, Bit32u dstOff, Bit32u byteCount, Bit32u granularity);
+  BX_SMF Bit64u FastRepCheckSeg(unsigned seg, Bit32u offset, bx_bool write, bx_address *laddr);
+
+  BX_SMF Bit32u FastRepMOVSB(unsigned srcSeg, Bit32u srcOff, unsigned dstSeg, Bit32u dstOff, Bit64u byteCount, Bit32u granularity);
   BX_SMF Bit32u FastRepMOVSB(bx_address laddrSrc, bx_address laddrDst, Bit64u byteCount, Bit32u granularity);
 
   BX_SMF Bit32u FastRepSTOSB(unsigned dstSeg, Bit32u dstOff, Bit8u  val, Bit32u  byteCount);
@@ -4493,6 +4617,15 @@ public: // for now...
   BX_SMF Bit32u FastRepSTOSB(bx_address laddrDst, Bit8u  val, Bit32u  byteCount);
   BX_SMF Bit32u FastRepSTOSW(bx_address laddrDst, Bit16u val, Bit32u  wordCount);
   BX_SMF Bit32u FastRepSTOSD(bx_address laddrDst, Bit32u val, Bit32u dwordCount);
+#if BX_SUPPORT_X86_64
+  BX_SMF Bit32u FastRepSTOSQ(bx_address laddrDst, Bit64u val, Bit32u qwordCount);
+#endif
+  BX_SMF Bit32u FastRepSTOS(bx_address laddrDst, Bit64u val, unsigned len, Bit32u count);
+
+  BX_SMF Bit32u FastRepCMPSB(unsigned srcSeg, Bit32u srcOff, unsigned dstSeg, Bit32u dstOff, Bit32u byteCount, bx_bool repz);
+  BX_SMF Bit32u FastRepCMPSB(bx_address laddrSrc, bx_address laddrDst, Bit64u byteCount, bx_bool repz);
+  BX_SMF Bit32u FastRepSCASB(unsigned dstSeg, Bit32u dstOff, Bit8u val, Bit32u byteCount, bx_bool repz);
+  BX_SMF Bit32u FastRepSCASB(bx_address laddrDst, Bit8u val, Bit64u byteCount, bx_bool repz);
 
   BX_SMF Bit32u FastRepINSW(Bit32u dstOff, Bit16u port, Bit32u wordCount);
   BX_SMF Bit32u FastRepOUTSW(unsigned srcSeg, Bit32u srcOff, Bit16u port, Bit32u wordCount);
@@ -4520,6 +4653,8 @@ public: // for now...
   BX_SMF bx_phy_address translate_linear_PAE(bx_address laddr, Bit32u &lpf_mask, unsigned user, unsigned rw);
   BX_SMF int check_entry_PAE(const char *s, Bit64u entry, Bit64u reserved, unsigned rw, bx_bool *nx_fault);
   BX_SMF void update_access_dirty_PAE(bx_phy_address *entry_addr, Bit64u *entry, BxMemtype *entry_memtype, unsigned max_level, unsigned leaf, unsigned write);
+  BX_SMF int pwc_lookup(bx_address laddr, int max_level, unsigned rw, Bit64u *entry, Bit64u &curr_entry, Bit32u &combined_access, bx_bool &nx, bx_bool &nx_fault);
+  BX_SMF void pwc_fill(bx_address laddr, int start, int leaf, const Bit64u *entry, const Bit32u *level_access, const bx_bool *level_nx);
 #endif
 #if BX_SUPPORT_X86_64
   BX_SMF bx_phy_address translate_linear_long_mode(bx_address laddr, Bit32u &lpf_mask, Bit32u &pkey, unsigned user, unsigned rw);
@@ -4545,9 +4680,15 @@ public: // for now...
 
 #if BX_CPU_LEVEL >= 6
   BX_SMF void TLB_flushNonGlobal(void);
+  BX_SMF void TLB_flushASID(bx_bool invalidate);
+#endif
+#if BX_SUPPORT_VMX >= 2
+  BX_SMF void TLB_flushVPID(bx_bool invalidate);
 #endif
   BX_SMF void TLB_flush(void);
+  BX_SMF Bit32u tlb_asid(void);
   BX_SMF void TLB_invlpg(bx_address laddr);
+  BX_SMF void TLB_writeProtect(void);
   BX_SMF void inhibit_interrupts(unsigned mask);
   BX_SMF bx_bool interrupts_inhibited(unsigned mask);
   BX_SMF const char *strseg(bx_segment_reg_t *seg);
@@ -4564,7 +4705,7 @@ public: // for now...
 
   BX_SMF bx_bool SetCR0(bxInstruction_c *i, bx_address val);
   BX_SMF bx_bool check_CR0(bx_address val) BX_CPP_AttrRegparmN(1);
-  BX_SMF bx_bool SetCR3(bx_address val) BX_CPP_AttrRegparmN(1);
+  BX_SMF bx_bool SetCR3(bx_address val, bx_bool invalidate = 1) BX_CPP_AttrRegparmN(2);
 #if BX_CPU_LEVEL >= 5
   BX_SMF bx_bool SetCR4(bxInstruction_c *i, bx_address val);
   BX_SMF bx_bool check_CR4(bx_address val) BX_CPP_AttrRegparmN(1);
@@ -4593,7 +4734,7 @@ public: // for now...
   BX_SMF void shutdown(void);
   BX_SMF void enter_sleep_state(unsigned state);
   BX_SMF void handleCpuModeChange(void);
-  BX_SMF void handleCpuContextChange(void);
+  BX_SMF void handleCpuContextChange(bx_bool flushTLB = 1);
   BX_SMF void handleInterruptMaskChange(void);
 #if BX_CPU_LEVEL >= 4
   BX_SMF void handleAlignmentCheck(void);
@@ -5199,6 +5340,21 @@ enum {
   BX_FETCH_MODE_EVEX_OK   = (1 << 5)
 };
 
+// address space tag of the translations cached in the second level TLB
+BX_CPP_INLINE Bit32u BX_CPU_C::tlb_asid(void)
+{
+  Bit32u asid = 0;
+#if BX_CPU_LEVEL >= 6
+  if (BX_CPU_THIS_PTR cr4.get_PCIDE())
+    asid = (Bit32u) BX_CPU_THIS_PTR cr3 & 0xfff;
+#endif
+#if BX_SUPPORT_VMX >= 2
+  if (BX_CPU_THIS_PTR in_vmx_guest && SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_VPID_ENABLE))
+    asid |= Bit32u(BX_CPU_THIS_PTR vmcs.vpid) << 12;
+#endif
+  return asid;
+}
+
 //
 // updateFetchModeMask - has to be called everytime 
 //   CS.L / CS.D_B / CR0.PE, CR0.TS or CR0.EM / CR4.OSFXSR / CR4.OSXSAVE changes
@@ -39,6 +39,13 @@ struct bx_cpu_statistics
   Bit64u iCacheLookups;
   Bit64u iCachePrefetch;
   Bit64u iCacheMisses;
+  Bit64u iCacheTraceFileHits;
+  Bit64u iCacheEvictions;
+  Bit64u iCacheMemPoolReclaims;
+  Bit64u iCacheSuperblocks;
+  Bit64u iCacheJitTraces;
+  Bit64u iCacheDeadFlags;
+  Bit64u iCacheFusedPairs;
 
   // tlb lookup statistics
   Bit64u tlbLookups;
@@ -47,6 +54,10 @@ struct bx_cpu_statistics
   Bit64u tlbMisses;
   Bit64u tlbExecuteMisses;
   Bit64u tlbWriteMisses;
+  Bit64u stlbHits;
+  Bit64u stlbMisses;
+  Bit64u pwcHits;
+  Bit64u ntlbHits;
 
   // tlb flush statistics
   Bit64u tlbGlobalFlushes;
@@ -57,13 +68,17 @@ struct bx_cpu_statistics
 
   // self modifying code statistics
   Bit64u smc;
+  Bit64u smcUncachedFetches;
 
   bx_cpu_statistics():
-      iCacheLookups(0), iCachePrefetch(0), iCacheMisses(0),
+      iCacheLookups(0), iCachePrefetch(0), iCacheMisses(0), iCacheTraceFileHits(0),
+      iCacheEvictions(0), iCacheMemPoolReclaims(0), iCacheSuperblocks(0), iCacheJitTraces(0),
+      iCacheDeadFlags(0), iCacheFusedPairs(0),
       tlbLookups(0), tlbExecuteLookups(0), tlbWriteLookups(0),
       tlbMisses(0), tlbExecuteMisses(0), tlbWriteMisses(0),
+      stlbHits(0), stlbMisses(0), pwcHits(0), ntlbHits(0),
       tlbGlobalFlushes(0), tlbNonGlobalFlushes(0),
-      stackPrefetch(0), smc(0) {}
+      stackPrefetch(0), smc(0), smcUncachedFetches(0) {}
   
 };
 
@@ -388,6 +388,8 @@ const Bit64u BX_SVM_CR_WRITE_MASK = (BX_CONST64(1) << 63);
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR0Rd(bxInstruction_c *i)
 {
+  BX_SMP_DRAIN_SMC(BX_CPU_ID);
+
   // CPL is always 0 in real mode
   if (/* !real_mode() && */ CPL!=0) {
     BX_ERROR(("%s: CPL!=0 not in real mode", i->getIaOpcodeNameShort()));
@@ -445,6 +447,8 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR2Rd(bxInstruction_c *i)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR3Rd(bxInstruction_c *i)
 {
+  BX_SMP_DRAIN_SMC(BX_CPU_ID);
+
   // CPL is always 0 in real mode
   if (/* !real_mode() && */ CPL!=0) {
     BX_ERROR(("%s: CPL!=0 not in real mode", i->getIaOpcodeNameShort()));
@@ -490,6 +494,8 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR3Rd(bxInstruction_c *i)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR4Rd(bxInstruction_c *i)
 {
+  BX_SMP_DRAIN_SMC(BX_CPU_ID);
+
 #if BX_CPU_LEVEL >= 5
   // CPL is always 0 in real mode
   if (/* !real_mode() && */ CPL!=0) {
@@ -620,6 +626,8 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_RdCR4(bxInstruction_c *i)
 #if BX_SUPPORT_X86_64
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR0Rq(bxInstruction_c *i)
 {
+  BX_SMP_DRAIN_SMC(BX_CPU_ID);
+
   if (CPL!=0) {
     BX_ERROR(("%s: #GP(0) if CPL is not 0", i->getIaOpcodeNameShort()));
     exception(BX_GP_EXCEPTION, 0);
@@ -677,6 +685,8 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR2Rq(bxInstruction_c *i)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR3Rq(bxInstruction_c *i)
 {
+  BX_SMP_DRAIN_SMC(BX_CPU_ID);
+
   if (i->dst() != 3) {
     BX_ERROR(("%s: #UD - register index out of range", i->getIaOpcodeNameShort()));
     exception(BX_UD_EXCEPTION, 0);
@@ -708,12 +718,14 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR3Rq(bxInstruction_c *i)
 #endif
 
   // allow bit 63 (hint that TLB doesn't need to be cleared) to be set when
-  // PCIDE is set, but ignore the hint if given
+  // PCIDE is set, the translations tagged with the new PCID are kept then
+  bx_bool invalidate = 1;
   if (BX_CPU_THIS_PTR cr4.get_PCIDE()) {
+    invalidate = ! (val_64 >> 63);
     val_64 &= ~(BX_CONST64(1)<<63);
   }
 
-  if (! SetCR3(val_64))
+  if (! SetCR3(val_64, invalidate))
     exception(BX_GP_EXCEPTION, 0);
 
   BX_INSTR_TLB_CNTRL(BX_CPU_ID, BX_INSTR_MOV_CR3, val_64);
@@ -723,6 +735,8 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR3Rq(bxInstruction_c *i)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR4Rq(bxInstruction_c *i)
 {
+  BX_SMP_DRAIN_SMC(BX_CPU_ID);
+
   if (i->dst() != 4) {
     BX_ERROR(("%s: #UD - register index out of range", i->getIaOpcodeNameShort()));
     exception(BX_UD_EXCEPTION, 0);
@@ -1370,7 +1384,7 @@ bx_bool BX_CPU_C::SetCR4(bxInstruction_c *i, bx_address val)
 }
 #endif // BX_CPU_LEVEL >= 5
 
-bx_bool BX_CPP_AttrRegparmN(1) BX_CPU_C::SetCR3(bx_address val)
+bx_bool BX_CPP_AttrRegparmN(2) BX_CPU_C::SetCR3(bx_address val, bx_bool invalidate)
 {
 #if BX_SUPPORT_X86_64
   if (long_mode()) {
@@ -1385,11 +1399,10 @@ bx_bool BX_CPP_AttrRegparmN(1) BX_CPU_C::SetCR3(bx_address val)
 
   // flush TLB even if value does not change
 #if BX_CPU_LEVEL >= 6
-  if (BX_CPU_THIS_PTR cr4.get_PGE())
-    TLB_flushNonGlobal(); // Don't flush Global entries.
-  else
+  TLB_flushASID(invalidate); // Don't flush Global entries and other address spaces.
+#else
+  TLB_flush();               // Flush Global entries also.
 #endif
-    TLB_flush();          // Flush Global entries also.
 
   return 1;
 }
@@ -515,6 +515,8 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::JMP16_Ep(bxInstruction_c *i)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::IRET16(bxInstruction_c *i)
 {
+  BX_SMP_DRAIN_SMC(BX_CPU_ID);
+
   BX_INSTR_FAR_BRANCH_ORIGIN();
 
   invalidate_prefetch_q();
@@ -451,6 +451,8 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::JMP64_Ep(bxInstruction_c *i)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::IRET64(bxInstruction_c *i)
 {
+  BX_SMP_DRAIN_SMC(BX_CPU_ID);
+
   invalidate_prefetch_q();
 
   BX_INSTR_FAR_BRANCH_ORIGIN();
@@ -2630,7 +2630,7 @@ void BX_CPU_C::init_FetchDecodeTables(void)
     }
 
     unsigned ia_opcode_feature = BxOpcodeFeatures[n];
-    if (! BX_CPUID_SUPPORT_ISA_EXTENSION(ia_opcode_feature)) {
+    if (! is_cpu_extension_supported(ia_opcode_feature)) {
       BxOpcodesTable[n].execute1 = &BX_CPU_C::BxError;
       BxOpcodesTable[n].execute2 = &BX_CPU_C::BxError;
       // won't allow this new #UD opcode to check prepare_SSE and similar
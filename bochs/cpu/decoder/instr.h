@@ -405,6 +405,31 @@ public:
   }
 #endif
 
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  // condition code of conditional branch fused with the previous instruction
+  BX_CPP_INLINE void setFusedCond(unsigned cond) {
+    metaData[BX_INSTR_METADATA_DST] = cond;
+  }
+  BX_CPP_INLINE unsigned fusedCond() const {
+    return metaData[BX_INSTR_METADATA_DST];
+  }
+#endif
+
+#if BX_SUPPORT_SUPERBLOCKS
+  // backward branch inside of superblock: branch condition (or 16 for
+  // unconditional jump) and length of the loop body in bytes
+  BX_CPP_INLINE void setSuperblockBranch(unsigned cond, Bit32u bodyLen) {
+    metaData[BX_INSTR_METADATA_DST] = cond;
+    modRMForm.Id = bodyLen;
+  }
+  BX_CPP_INLINE unsigned superblockCond() const {
+    return metaData[BX_INSTR_METADATA_DST];
+  }
+  BX_CPP_INLINE Bit32u superblockBodyLen() const {
+    return modRMForm.Id;
+  }
+#endif
+
 };
 // <TAG-CLASS-INSTRUCTION-END>
 
@@ -99,7 +99,10 @@ bx_bool BX_CPU_C::handleWaitForEvent(void)
       return 1; // Return to caller of cpu_loop.
     }
 
-    BX_TICKN(10); // when in HLT run time faster for single CPU
+    if (bx_pc_system.checkpoint_request)
+      bx_pc_system.save_checkpoint();
+
+    bx_pc_system.idle_tick(); // when in HLT run time faster for single CPU
   }
 
   return 0;
@@ -180,6 +183,9 @@ bx_bool BX_CPU_C::handleAsyncEvent(void)
     if (handleWaitForEvent()) return 1;
   }
 
+  if (bx_pc_system.checkpoint_request)
+    bx_pc_system.save_checkpoint();
+
   if (bx_pc_system.kill_bochs_request) {
     // setting kill_bochs_request causes the cpu loop to return ASAP.
     return 1; // Return to caller of cpu_loop.
@@ -27,236 +27,341 @@
 //
 // Repeat Speedups methods
 //
+// The bulk string engine processes as many iterations of a repeated string
+// instruction as possible in one call. The source and destination are walked
+// page by page through the host pointers of the data TLB, so a transfer may
+// cross page boundaries as long as every page is already cached in the TLB.
+// The engine stops at the first TLB miss, when the next timer event is due
+// or when an asynchronous event (e.g. interrupt or self modifying code
+// detected by the write to a code page) is pending; the rest of the work is
+// left to the next iteration of the repeat loop.
+//
 
 #if BX_SUPPORT_REPEAT_SPEEDUPS
-Bit32u BX_CPU_C::FastRepMOVSB(unsigned srcSeg, Bit32u srcOff, unsigned dstSeg, Bit32u dstOff, Bit32u byteCount, Bit32u granularity)
+
+// Returns the number of bytes which could be accessed through segment 'seg'
+// starting from offset 'offset' without limit checks, or zero if the segment
+// requires full checks. The linear address is returned in 'laddr'.
+Bit64u BX_CPU_C::FastRepCheckSeg(unsigned seg, Bit32u offset, bx_bool write, bx_address *laddr)
 {
   BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
 
-  bx_address laddrSrc, laddrDst;
+  bx_segment_reg_t *segPtr = &BX_CPU_THIS_PTR sregs[seg];
+  Bit64u bytes;
 
-  bx_segment_reg_t *srcSegPtr = &BX_CPU_THIS_PTR sregs[srcSeg];
-  if (srcSegPtr->cache.valid & SegAccessROK4G) {
-    laddrSrc = srcOff;
+  if (segPtr->cache.valid & (write ? SegAccessWOK4G : SegAccessROK4G)) {
+    *laddr = offset;
+    bytes = BX_CONST64(0x100000000) - offset;
   }
   else {
-    if (!(srcSegPtr->cache.valid & SegAccessROK))
+    if (!(segPtr->cache.valid & (write ? SegAccessWOK : SegAccessROK)))
       return 0;
-    if ((srcOff | 0xfff) > srcSegPtr->cache.u.segment.limit_scaled)
+    if (offset > segPtr->cache.u.segment.limit_scaled)
       return 0;
 
-    laddrSrc = get_laddr32(srcSeg, srcOff);
-  }
-
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (dstSegPtr->cache.valid & SegAccessWOK4G) {
-    laddrDst = dstOff;
-  }
-  else {
-    if (!(dstSegPtr->cache.valid & SegAccessWOK))
-      return 0;
-    if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-      return 0;
+    *laddr = get_laddr32(seg, offset);
+    bytes = (Bit64u) segPtr->cache.u.segment.limit_scaled - offset + 1;
 
-    laddrDst = get_laddr32(dstSeg, dstOff);
+    // do not wrap around 4G of linear address space
+    Bit64u bytesLeft = BX_CONST64(0x100000000) - (Bit32u) *laddr;
+    if (bytes > bytesLeft)
+      bytes = bytesLeft;
   }
 
-  return FastRepMOVSB(laddrSrc, laddrDst, byteCount, granularity);
+  return bytes;
 }
 
-Bit32u BX_CPU_C::FastRepMOVSB(bx_address laddrSrc, bx_address laddrDst, Bit64u byteCount, Bit32u granularity)
+Bit32u BX_CPU_C::FastRepMOVSB(unsigned srcSeg, Bit32u srcOff, unsigned dstSeg, Bit32u dstOff, Bit64u byteCount, Bit32u granularity)
 {
-  Bit8u *hostAddrSrc = v2h_read_byte(laddrSrc, USER_PL);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrSrc) return 0;
+  bx_address laddrSrc, laddrDst;
 
-  Bit8u *hostAddrDst = v2h_write_byte(laddrDst, USER_PL);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
+  Bit64u bytesSrc = FastRepCheckSeg(srcSeg, srcOff, 0, &laddrSrc);
+  if (! bytesSrc) return 0;
+  Bit64u bytesDst = FastRepCheckSeg(dstSeg, dstOff, 1, &laddrDst);
+  if (! bytesDst) return 0;
 
-  assert(! BX_CPU_THIS_PTR get_DF());
+  Bit64u count = byteCount;
+  if (count > bytesSrc)
+    count = bytesSrc;
+  if (count > bytesDst)
+    count = bytesDst;
 
-  // See how many bytes can fit in the rest of this page.
-  Bit32u bytesFitSrc = 0x1000 - PAGE_OFFSET(laddrSrc);
-  Bit32u bytesFitDst = 0x1000 - PAGE_OFFSET(laddrDst);
+  return FastRepMOVSB(laddrSrc, laddrDst, count, granularity);
+}
+
+Bit32u BX_CPU_C::FastRepMOVSB(bx_address laddrSrc, bx_address laddrDst, Bit64u byteCount, Bit32u granularity)
+{
+  assert(! BX_CPU_THIS_PTR get_DF());
 
-  // Restrict word count to the number that will fit in either
-  // source or dest pages.
-  if (byteCount > bytesFitSrc)
-    byteCount = bytesFitSrc;
-  if (byteCount > bytesFitDst)
-    byteCount = bytesFitDst;
   if (byteCount > bx_pc_system.getNumCpuTicksLeftNextEvent())
     byteCount = bx_pc_system.getNumCpuTicksLeftNextEvent();
 
-  byteCount &= ~(granularity-1);
-
-  // If after all the restrictions, there is anything left to do...
-  if (byteCount) {
-    // Transfer data directly using host addresses
-    for (unsigned j=0; j<byteCount; j++) {
-      * (Bit8u *) hostAddrDst = * (Bit8u *) hostAddrSrc;
-      hostAddrDst++;
-      hostAddrSrc++;
+  Bit32u count = (Bit32u) byteCount & ~(granularity-1), done = 0;
+
+  while (done < count) {
+    Bit8u *hostAddrSrc = v2h_read_byte(laddrSrc + done, USER_PL);
+    // Check that native host access was not vetoed for that page
+    if (!hostAddrSrc) break;
+
+    Bit8u *hostAddrDst = v2h_write_byte(laddrDst + done, USER_PL);
+    // Check that native host access was not vetoed for that page
+    if (!hostAddrDst) break;
+
+    // See how many bytes can fit in the rest of source and dest pages,
+    // an element crossing the page boundary is left to the slow path.
+    Bit32u len = count - done;
+    Bit32u bytesFitSrc = 0x1000 - PAGE_OFFSET(laddrSrc + done);
+    Bit32u bytesFitDst = 0x1000 - PAGE_OFFSET(laddrDst + done);
+    if (len > bytesFitSrc)
+      len = bytesFitSrc;
+    if (len > bytesFitDst)
+      len = bytesFitDst;
+    len &= ~(granularity-1);
+    if (! len) break;
+
+    if (hostAddrDst > hostAddrSrc && hostAddrDst < hostAddrSrc + len) {
+      // Destination overlaps the source ahead of it, the guest sees the
+      // data written by the previous iterations. Copy in chunks of the
+      // distance between them, which replicates the pattern exactly as
+      // element by element copy does.
+      Bit32u dist = (Bit32u)(hostAddrDst - hostAddrSrc);
+      if (dist < granularity) break;
+
+      for (Bit32u n = 0; n < len; n += dist)
+        memcpy(hostAddrDst + n, hostAddrSrc + n, (len - n) < dist ? (len - n) : dist);
+    }
+    else {
+      memmove(hostAddrDst, hostAddrSrc, len);
     }
+
+    done += len;
+
+    if (BX_CPU_THIS_PTR async_event) break;
   }
 
-  return byteCount;
+  return done;
 }
 
 Bit32u BX_CPU_C::FastRepSTOSB(unsigned dstSeg, Bit32u dstOff, Bit8u val, Bit32u count)
 {
   bx_address laddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
-
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (dstSegPtr->cache.valid & SegAccessWOK4G) {
-    laddrDst = dstOff;
-  }
-  else {
-    if (!(dstSegPtr->cache.valid & SegAccessWOK))
-      return 0;
-    if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-      return 0;
-
-    laddrDst = get_laddr32(dstSeg, dstOff);
-  }
+  Bit64u bytesDst = FastRepCheckSeg(dstSeg, dstOff, 1, &laddrDst);
+  if (count > bytesDst)
+    count = (Bit32u) bytesDst;
 
-  return FastRepSTOSB(laddrDst, val, count);
+  return count ? FastRepSTOS(laddrDst, val, 1, count) : 0;
 }
 
 Bit32u BX_CPU_C::FastRepSTOSB(bx_address laddrDst, Bit8u val, Bit32u count)
 {
-  Bit8u *hostAddrDst = v2h_write_byte(laddrDst, USER_PL);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
-
-  assert(! BX_CPU_THIS_PTR get_DF());
+  return FastRepSTOS(laddrDst, val, 1, count);
+}
 
-  // See how many bytes can fit in the rest of this page.
-  Bit32u bytesFitDst = 0x1000 - PAGE_OFFSET(laddrDst);
+Bit32u BX_CPU_C::FastRepSTOSW(unsigned dstSeg, Bit32u dstOff, Bit16u val, Bit32u count)
+{
+  bx_address laddrDst;
 
-  // Restrict word count to the number that will fit in either
-  // source or dest pages.
-  if (count > bytesFitDst)
-    count = bytesFitDst;
-  if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
-    count = bx_pc_system.getNumCpuTicksLeftNextEvent();
+  Bit64u wordsDst = FastRepCheckSeg(dstSeg, dstOff, 1, &laddrDst) >> 1;
+  if (count > wordsDst)
+    count = (Bit32u) wordsDst;
 
-  // If after all the restrictions, there is anything left to do...
-  if (count) {
-    // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      * (Bit8u *) hostAddrDst = val;
-      hostAddrDst++;
-    }
-  }
+  return count ? FastRepSTOS(laddrDst, val, 2, count) : 0;
+}
 
-  return count;
+Bit32u BX_CPU_C::FastRepSTOSW(bx_address laddrDst, Bit16u val, Bit32u count)
+{
+  return FastRepSTOS(laddrDst, val, 2, count);
 }
 
-Bit32u BX_CPU_C::FastRepSTOSW(unsigned dstSeg, Bit32u dstOff, Bit16u val, Bit32u count)
+Bit32u BX_CPU_C::FastRepSTOSD(unsigned dstSeg, Bit32u dstOff, Bit32u val, Bit32u count)
 {
   bx_address laddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
+  Bit64u dwordsDst = FastRepCheckSeg(dstSeg, dstOff, 1, &laddrDst) >> 2;
+  if (count > dwordsDst)
+    count = (Bit32u) dwordsDst;
 
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (dstSegPtr->cache.valid & SegAccessWOK4G) {
-    laddrDst = dstOff;
-  }
-  else {
-    if (!(dstSegPtr->cache.valid & SegAccessWOK))
-      return 0;
-    if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-      return 0;
-
-    laddrDst = get_laddr32(dstSeg, dstOff);
-  }
+  return count ? FastRepSTOS(laddrDst, val, 4, count) : 0;
+}
 
-  return FastRepSTOSW(laddrDst, val, count);
+Bit32u BX_CPU_C::FastRepSTOSD(bx_address laddrDst, Bit32u val, Bit32u count)
+{
+  return FastRepSTOS(laddrDst, val, 4, count);
 }
 
-Bit32u BX_CPU_C::FastRepSTOSW(bx_address laddrDst, Bit16u val, Bit32u count)
+#if BX_SUPPORT_X86_64
+Bit32u BX_CPU_C::FastRepSTOSQ(bx_address laddrDst, Bit64u val, Bit32u count)
 {
-  Bit8u *hostAddrDst = v2h_write_byte(laddrDst, USER_PL);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
+  return FastRepSTOS(laddrDst, val, 8, count);
+}
+#endif
 
+// Store 'count' elements of 'len' bytes, returns number of elements stored
+Bit32u BX_CPU_C::FastRepSTOS(bx_address laddrDst, Bit64u val, unsigned len, Bit32u count)
+{
   assert(! BX_CPU_THIS_PTR get_DF());
 
-  // See how many words can fit in the rest of this page.
-  Bit32u wordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 1;
-
-  // Restrict word count to the number that will fit in either
-  // source or dest pages.
-  if (count > wordsFitDst)
-    count = wordsFitDst;
   if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
     count = bx_pc_system.getNumCpuTicksLeftNextEvent();
 
-  // If after all the restrictions, there is anything left to do...
-  if (count) {
+  Bit32u done = 0;
+
+  while (done < count) {
+    bx_address laddr = laddrDst + (bx_address) done * len;
+
+    Bit8u *hostAddrDst = v2h_write_byte(laddr, USER_PL);
+    // Check that native host access was not vetoed for that page
+    if (!hostAddrDst) break;
+
+    // See how many elements can fit in the rest of this page.
+    Bit32u n = count - done;
+    Bit32u elementsFitDst = (0x1000 - PAGE_OFFSET(laddr)) / len;
+    if (n > elementsFitDst)
+      n = elementsFitDst;
+    if (! n) break;
+
     // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      WriteHostWordToLittleEndian((Bit16u*)hostAddrDst, val);
-      hostAddrDst += 2;
+    switch(len) {
+    case 1:
+      memset(hostAddrDst, (Bit8u) val, n);
+      break;
+    case 2:
+      for (Bit32u j=0; j<n; j++, hostAddrDst += 2)
+        WriteHostWordToLittleEndian((Bit16u*)hostAddrDst, (Bit16u) val);
+      break;
+    case 4:
+      for (Bit32u j=0; j<n; j++, hostAddrDst += 4)
+        WriteHostDWordToLittleEndian((Bit32u*)hostAddrDst, (Bit32u) val);
+      break;
+    default:
+      for (Bit32u j=0; j<n; j++, hostAddrDst += 8)
+        WriteHostQWordToLittleEndian((Bit64u*)hostAddrDst, val);
+      break;
     }
+
+    done += n;
+
+    if (BX_CPU_THIS_PTR async_event) break;
   }
 
-  return count;
+  return done;
 }
 
-Bit32u BX_CPU_C::FastRepSTOSD(unsigned dstSeg, Bit32u dstOff, Bit32u val, Bit32u count)
+//
+// REPE/REPNE CMPSB and SCASB skip over the iterations which don't terminate
+// the repeat loop. The returned count never includes the terminating
+// iteration, it is executed by the caller and sets the arithmetic flags.
+//
+
+Bit32u BX_CPU_C::FastRepCMPSB(unsigned srcSeg, Bit32u srcOff, unsigned dstSeg, Bit32u dstOff, Bit32u byteCount, bx_bool repz)
 {
-  bx_address laddrDst;
+  bx_address laddrSrc, laddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
+  Bit64u bytesSrc = FastRepCheckSeg(srcSeg, srcOff, 0, &laddrSrc);
+  if (! bytesSrc) return 0;
+  Bit64u bytesDst = FastRepCheckSeg(dstSeg, dstOff, 0, &laddrDst);
+  if (! bytesDst) return 0;
 
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (dstSegPtr->cache.valid & SegAccessWOK4G) {
-    laddrDst = dstOff;
-  }
-  else {
-    if (!(dstSegPtr->cache.valid & SegAccessWOK))
-      return 0;
-    if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-      return 0;
+  Bit64u count = byteCount;
+  if (count > bytesSrc)
+    count = bytesSrc;
+  if (count > bytesDst)
+    count = bytesDst;
 
-    laddrDst = get_laddr32(dstSeg, dstOff);
+  return FastRepCMPSB(laddrSrc, laddrDst, count, repz);
+}
+
+Bit32u BX_CPU_C::FastRepCMPSB(bx_address laddrSrc, bx_address laddrDst, Bit64u byteCount, bx_bool repz)
+{
+  assert(! BX_CPU_THIS_PTR get_DF());
+
+  if (byteCount > bx_pc_system.getNumCpuTicksLeftNextEvent())
+    byteCount = bx_pc_system.getNumCpuTicksLeftNextEvent();
+
+  Bit32u count = (Bit32u) byteCount, done = 0;
+
+  while (done < count) {
+    Bit8u *hostAddrSrc = v2h_read_byte(laddrSrc + done, USER_PL);
+    if (!hostAddrSrc) break;
+    Bit8u *hostAddrDst = v2h_read_byte(laddrDst + done, USER_PL);
+    if (!hostAddrDst) break;
+
+    Bit32u len = count - done;
+    Bit32u bytesFitSrc = 0x1000 - PAGE_OFFSET(laddrSrc + done);
+    Bit32u bytesFitDst = 0x1000 - PAGE_OFFSET(laddrDst + done);
+    if (len > bytesFitSrc)
+      len = bytesFitSrc;
+    if (len > bytesFitDst)
+      len = bytesFitDst;
+
+    Bit32u n = 0;
+    if (repz) {
+      // find first mismatch
+      if (memcmp(hostAddrSrc, hostAddrDst, len) == 0)
+        n = len;
+      else
+        while (hostAddrSrc[n] == hostAddrDst[n]) n++;
+    }
+    else {
+      // find first match
+      while (n < len && hostAddrSrc[n] != hostAddrDst[n]) n++;
+    }
+
+    done += n;
+
+    if (n < len || BX_CPU_THIS_PTR async_event) break;
   }
 
-  return FastRepSTOSD(laddrDst, val, count);
+  return done;
 }
 
-Bit32u BX_CPU_C::FastRepSTOSD(bx_address laddrDst, Bit32u val, Bit32u count)
+Bit32u BX_CPU_C::FastRepSCASB(unsigned dstSeg, Bit32u dstOff, Bit8u val, Bit32u byteCount, bx_bool repz)
 {
-  Bit8u *hostAddrDst = v2h_write_byte(laddrDst, USER_PL);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
+  bx_address laddrDst;
+
+  Bit64u bytesDst = FastRepCheckSeg(dstSeg, dstOff, 0, &laddrDst);
+  if (byteCount > bytesDst)
+    byteCount = (Bit32u) bytesDst;
+
+  return byteCount ? FastRepSCASB(laddrDst, val, byteCount, repz) : 0;
+}
 
+Bit32u BX_CPU_C::FastRepSCASB(bx_address laddrDst, Bit8u val, Bit64u byteCount, bx_bool repz)
+{
   assert(! BX_CPU_THIS_PTR get_DF());
 
-  // See how many dwords can fit in the rest of this page.
-  Bit32u dwordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 2;
+  if (byteCount > bx_pc_system.getNumCpuTicksLeftNextEvent())
+    byteCount = bx_pc_system.getNumCpuTicksLeftNextEvent();
 
-  // Restrict dword count to the number that will fit in either
-  // source or dest pages.
-  if (count > dwordsFitDst)
-    count = dwordsFitDst;
-  if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
-    count = bx_pc_system.getNumCpuTicksLeftNextEvent();
+  Bit32u count = (Bit32u) byteCount, done = 0;
 
-  // If after all the restrictions, there is anything left to do...
-  if (count) {
-    // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      WriteHostDWordToLittleEndian((Bit32u*)hostAddrDst, val);
-      hostAddrDst += 4;
+  while (done < count) {
+    Bit8u *hostAddrDst = v2h_read_byte(laddrDst + done, USER_PL);
+    if (!hostAddrDst) break;
+
+    Bit32u len = count - done;
+    Bit32u bytesFitDst = 0x1000 - PAGE_OFFSET(laddrDst + done);
+    if (len > bytesFitDst)
+      len = bytesFitDst;
+
+    Bit32u n = 0;
+    if (repz) {
+      // find first byte different from AL
+      while (n < len && hostAddrDst[n] == val) n++;
+    }
+    else {
+      // find first byte equal to AL
+      Bit8u *match = (Bit8u *) memchr(hostAddrDst, val, len);
+      n = match ? (Bit32u)(match - hostAddrDst) : len;
     }
+
+    done += n;
+
+    if (n < len || BX_CPU_THIS_PTR async_event) break;
   }
 
-  return count;
+  return done;
 }
+
 #endif
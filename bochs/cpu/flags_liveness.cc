@@ -0,0 +1,155 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2020  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+/////////////////////////////////////////////////////////////////////////
+
+#define NEED_CPU_REG_SHORTCUTS 1
+#include "bochs.h"
+#include "cpu.h"
+#define LOG_THIS BX_CPU_THIS_PTR
+
+#include "cpustats.h"
+
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+
+//
+// Lazy flags elimination.
+//
+// When an arithmetic instruction is immediately followed in the trace by
+// register-only instruction which overwrites all the OSZAPC flags without
+// reading them, the flags produced by the first instruction can never be
+// observed. The trace builder switches such instructions to the flag-less
+// handler variants which skip the lazy flags bookkeeping. Both variants are
+// generated from the same handler body, see flags_liveness.h.
+//
+// The flags would become visible if the trace stops between the two
+// instructions, so the flag-less handler checks for pending async event
+// and falls back to computing the flags when there is one. Otherwise the
+// next instruction is executed without checking for async events, which
+// only delays the event by single instruction. The window is limited to
+// one instruction for the same reason: any other instruction could fault
+// or stop the trace before the flags are overwritten.
+//
+
+struct bxDeadFlagsHandler {
+  BxExecutePtr_tR handler;
+  BxExecutePtr_tR noflags;
+};
+
+// instructions with flag-less variant
+static const bxDeadFlagsHandler deadFlagsHandlers[] = {
+  { &BX_CPU_C::ADD_GdEdR, &BX_CPU_C::ADD_GdEdR_NoFlags },
+  { &BX_CPU_C::SUB_GdEdR, &BX_CPU_C::SUB_GdEdR_NoFlags },
+  { &BX_CPU_C::AND_GdEdR, &BX_CPU_C::AND_GdEdR_NoFlags },
+  { &BX_CPU_C::OR_GdEdR,  &BX_CPU_C::OR_GdEdR_NoFlags  },
+  { &BX_CPU_C::XOR_GdEdR, &BX_CPU_C::XOR_GdEdR_NoFlags },
+  { &BX_CPU_C::ADD_EdIdR, &BX_CPU_C::ADD_EdIdR_NoFlags },
+  { &BX_CPU_C::SUB_EdIdR, &BX_CPU_C::SUB_EdIdR_NoFlags },
+  { &BX_CPU_C::AND_EdIdR, &BX_CPU_C::AND_EdIdR_NoFlags },
+  { &BX_CPU_C::OR_EdIdR,  &BX_CPU_C::OR_EdIdR_NoFlags  },
+  { &BX_CPU_C::XOR_EdIdR, &BX_CPU_C::XOR_EdIdR_NoFlags },
+  { &BX_CPU_C::INC_EdR,   &BX_CPU_C::INC_EdR_NoFlags   },
+  { &BX_CPU_C::DEC_EdR,   &BX_CPU_C::DEC_EdR_NoFlags   },
+  { &BX_CPU_C::ZERO_IDIOM_GdR, &BX_CPU_C::ZERO_IDIOM_GdR_NoFlags },
+#if BX_SUPPORT_X86_64
+  { &BX_CPU_C::ADD_GqEqR, &BX_CPU_C::ADD_GqEqR_NoFlags },
+  { &BX_CPU_C::SUB_GqEqR, &BX_CPU_C::SUB_GqEqR_NoFlags },
+  { &BX_CPU_C::AND_GqEqR, &BX_CPU_C::AND_GqEqR_NoFlags },
+  { &BX_CPU_C::OR_GqEqR,  &BX_CPU_C::OR_GqEqR_NoFlags  },
+  { &BX_CPU_C::XOR_GqEqR, &BX_CPU_C::XOR_GqEqR_NoFlags },
+  { &BX_CPU_C::ADD_EqIdR, &BX_CPU_C::ADD_EqIdR_NoFlags },
+  { &BX_CPU_C::SUB_EqIdR, &BX_CPU_C::SUB_EqIdR_NoFlags },
+  { &BX_CPU_C::AND_EqIdR, &BX_CPU_C::AND_EqIdR_NoFlags },
+  { &BX_CPU_C::OR_EqIdR,  &BX_CPU_C::OR_EqIdR_NoFlags  },
+  { &BX_CPU_C::XOR_EqIdR, &BX_CPU_C::XOR_EqIdR_NoFlags },
+  { &BX_CPU_C::INC_EqR,   &BX_CPU_C::INC_EqR_NoFlags   },
+  { &BX_CPU_C::DEC_EqR,   &BX_CPU_C::DEC_EqR_NoFlags   },
+#endif
+};
+
+// register-only instructions which overwrite all OSZAPC flags without
+// reading them and cannot fault
+static const BxExecutePtr_tR flagsKillHandlers[] = {
+  &BX_CPU_C::ADD_EbIbR, &BX_CPU_C::ADD_GbEbR, &BX_CPU_C::ADD_EwIwR, &BX_CPU_C::ADD_GwEwR,
+  &BX_CPU_C::ADD_EdIdR, &BX_CPU_C::ADD_GdEdR,
+  &BX_CPU_C::SUB_EbIbR, &BX_CPU_C::SUB_GbEbR, &BX_CPU_C::SUB_EwIwR, &BX_CPU_C::SUB_GwEwR,
+  &BX_CPU_C::SUB_EdIdR, &BX_CPU_C::SUB_GdEdR,
+  &BX_CPU_C::AND_EbIbR, &BX_CPU_C::AND_GbEbR, &BX_CPU_C::AND_EwIwR, &BX_CPU_C::AND_GwEwR,
+  &BX_CPU_C::AND_EdIdR, &BX_CPU_C::AND_GdEdR,
+  &BX_CPU_C::OR_EbIbR,  &BX_CPU_C::OR_GbEbR,  &BX_CPU_C::OR_EwIwR,  &BX_CPU_C::OR_GwEwR,
+  &BX_CPU_C::OR_EdIdR,  &BX_CPU_C::OR_GdEdR,
+  &BX_CPU_C::XOR_EbIbR, &BX_CPU_C::XOR_GbEbR, &BX_CPU_C::XOR_EwIwR, &BX_CPU_C::XOR_GwEwR,
+  &BX_CPU_C::XOR_EdIdR, &BX_CPU_C::XOR_GdEdR,
+  &BX_CPU_C::CMP_EbIbR, &BX_CPU_C::CMP_GbEbR, &BX_CPU_C::CMP_EwIwR, &BX_CPU_C::CMP_GwEwR,
+  &BX_CPU_C::CMP_EdIdR, &BX_CPU_C::CMP_GdEdR,
+  &BX_CPU_C::TEST_EbIbR, &BX_CPU_C::TEST_EbGbR, &BX_CPU_C::TEST_EwIwR, &BX_CPU_C::TEST_EwGwR,
+  &BX_CPU_C::TEST_EdIdR, &BX_CPU_C::TEST_EdGdR,
+  &BX_CPU_C::ZERO_IDIOM_GwR, &BX_CPU_C::ZERO_IDIOM_GdR,
+#if BX_SUPPORT_X86_64
+  &BX_CPU_C::ADD_EqIdR, &BX_CPU_C::ADD_GqEqR,
+  &BX_CPU_C::SUB_EqIdR, &BX_CPU_C::SUB_GqEqR,
+  &BX_CPU_C::AND_EqIdR, &BX_CPU_C::AND_GqEqR,
+  &BX_CPU_C::OR_EqIdR,  &BX_CPU_C::OR_GqEqR,
+  &BX_CPU_C::XOR_EqIdR, &BX_CPU_C::XOR_GqEqR,
+  &BX_CPU_C::CMP_EqIdR, &BX_CPU_C::CMP_GqEqR,
+  &BX_CPU_C::TEST_EqIdR, &BX_CPU_C::TEST_EqGqR,
+#endif
+};
+
+#define BX_DEAD_FLAGS_HANDLERS (sizeof(deadFlagsHandlers) / sizeof(deadFlagsHandlers[0]))
+#define BX_FLAGS_KILL_HANDLERS (sizeof(flagsKillHandlers) / sizeof(flagsKillHandlers[0]))
+
+static bx_bool killsFlags(const bxInstruction_c *i)
+{
+  if (! i->modC0()) return 0;
+
+  for (unsigned n=0; n < BX_FLAGS_KILL_HANDLERS; n++) {
+    if (i->execute1 == flagsKillHandlers[n]) return 1;
+  }
+
+  return 0;
+}
+
+void BX_CPU_C::eliminateDeadFlags(bxICacheEntry_c *entry)
+{
+  // the last instruction of the trace is BxEndTrace, no flags are killed
+  // there so the flags are live on trace exit
+  bx_bool flagsLive = 1;
+
+  // walk the trace backwards, the flags of the instruction are dead if
+  // the next instruction overwrites them
+  for (int n = entry->tlen - 1; n >= 0; n--) {
+    bxInstruction_c *i = entry->i + n;
+    bx_bool kills = killsFlags(i);
+
+    if (! flagsLive && i->modC0()) {
+      for (unsigned h=0; h < BX_DEAD_FLAGS_HANDLERS; h++) {
+        if (i->execute1 == deadFlagsHandlers[h].handler) {
+          i->execute1 = deadFlagsHandlers[h].noflags;
+          INC_ICACHE_STAT(iCacheDeadFlags);
+          break;
+        }
+      }
+    }
+
+    flagsLive = ! kills;
+  }
+}
+
+#endif
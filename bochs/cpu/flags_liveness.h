@@ -0,0 +1,154 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2020  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BX_FLAGS_LIVENESS_H
+#define BX_FLAGS_LIVENESS_H
+
+//
+// Register form handlers which have a flag-less variant for the lazy flags
+// elimination (see flags_liveness.cc). The regular handler and its _NoFlags
+// variant are expanded from the same body, they only differ in the way the
+// instruction completes:
+//
+//   BX_NEXT_INSTR_LIVE_FLAGS  update the lazy flags and go to the next
+//                             instruction
+//   BX_NEXT_INSTR_DEAD_FLAGS  update the lazy flags only when an async event
+//                             is pending and the trace stops, otherwise go
+//                             to the next instruction directly
+//
+
+#define BX_NEXT_INSTR_LIVE_FLAGS(i, set_flags) { \
+  set_flags;                                     \
+  BX_NEXT_INSTR(i);                              \
+}
+
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+
+#define BX_NEXT_INSTR_DEAD_FLAGS(i, set_flags) { \
+  if (BX_CPU_THIS_PTR async_event) {             \
+    set_flags;                                   \
+    BX_COMMIT_INSTRUCTION(i);                    \
+    return;                                      \
+  }                                              \
+  BX_COMMIT_INSTRUCTION(i);                      \
+  ++i;                                           \
+  BX_EXECUTE_INSTRUCTION(i);                     \
+}
+
+#define BX_FLAGS_HANDLERS(form, insn, op, set_flags)        \
+  form(insn, op, set_flags, BX_NEXT_INSTR_LIVE_FLAGS)       \
+  form(insn##_NoFlags, op, set_flags, BX_NEXT_INSTR_DEAD_FLAGS)
+
+#else
+
+#define BX_FLAGS_HANDLERS(form, insn, op, set_flags)        \
+  form(insn, op, set_flags, BX_NEXT_INSTR_LIVE_FLAGS)
+
+#endif
+
+// logical instructions only need the result for the flags
+#define SET_FLAGS_OSZAPC_AND_32(op1, op2, result) SET_FLAGS_OSZAPC_LOGIC_32(result)
+#define SET_FLAGS_OSZAPC_OR_32(op1, op2, result)  SET_FLAGS_OSZAPC_LOGIC_32(result)
+#define SET_FLAGS_OSZAPC_XOR_32(op1, op2, result) SET_FLAGS_OSZAPC_LOGIC_32(result)
+
+#define BX_FORM_GdEdR(name, op, set_flags, next)                     \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name(bxInstruction_c *i)       \
+{                                                                    \
+  Bit32u op1_32 = BX_READ_32BIT_REG(i->dst());                       \
+  Bit32u op2_32 = BX_READ_32BIT_REG(i->src());                       \
+  Bit32u result_32 = op1_32 op op2_32;                               \
+  BX_WRITE_32BIT_REGZ(i->dst(), result_32);                          \
+                                                                     \
+  next(i, set_flags(op1_32, op2_32, result_32));                     \
+}
+
+#define BX_FORM_EdIdR(name, op, set_flags, next)                     \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name(bxInstruction_c *i)       \
+{                                                                    \
+  Bit32u op1_32 = BX_READ_32BIT_REG(i->dst());                       \
+  Bit32u op2_32 = i->Id();                                           \
+  Bit32u result_32 = op1_32 op op2_32;                               \
+  BX_WRITE_32BIT_REGZ(i->dst(), result_32);                          \
+                                                                     \
+  next(i, set_flags(op1_32, op2_32, result_32));                     \
+}
+
+// op is +1 for INC and -1 for DEC, op2 of SET_FLAGS_OSZAP_ADD/SUB is unused
+#define BX_FORM_EdR(name, op, set_flags, next)                       \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name(bxInstruction_c *i)       \
+{                                                                    \
+  Bit32u op1_32 = BX_READ_32BIT_REG(i->dst());                       \
+  Bit32u result_32 = op1_32 op;                                      \
+  BX_WRITE_32BIT_REGZ(i->dst(), result_32);                          \
+                                                                     \
+  next(i, set_flags(op1_32, 0, result_32));                          \
+}
+
+// the register is cleared whatever the value, op is not used
+#define BX_FORM_ZERO_IDIOM_GdR(name, op, set_flags, next)            \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name(bxInstruction_c *i)       \
+{                                                                    \
+  BX_WRITE_32BIT_REGZ(i->dst(), 0);                                  \
+                                                                     \
+  next(i, set_flags(0, 0, 0));                                       \
+}
+
+#if BX_SUPPORT_X86_64
+
+#define SET_FLAGS_OSZAPC_AND_64(op1, op2, result) SET_FLAGS_OSZAPC_LOGIC_64(result)
+#define SET_FLAGS_OSZAPC_OR_64(op1, op2, result)  SET_FLAGS_OSZAPC_LOGIC_64(result)
+#define SET_FLAGS_OSZAPC_XOR_64(op1, op2, result) SET_FLAGS_OSZAPC_LOGIC_64(result)
+
+#define BX_FORM_GqEqR(name, op, set_flags, next)                     \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name(bxInstruction_c *i)       \
+{                                                                    \
+  Bit64u op1_64 = BX_READ_64BIT_REG(i->dst());                       \
+  Bit64u op2_64 = BX_READ_64BIT_REG(i->src());                       \
+  Bit64u result_64 = op1_64 op op2_64;                               \
+  BX_WRITE_64BIT_REG(i->dst(), result_64);                           \
+                                                                     \
+  next(i, set_flags(op1_64, op2_64, result_64));                     \
+}
+
+#define BX_FORM_EqIdR(name, op, set_flags, next)                     \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name(bxInstruction_c *i)       \
+{                                                                    \
+  Bit64u op1_64 = BX_READ_64BIT_REG(i->dst());                       \
+  Bit64u op2_64 = (Bit32s) i->Id();                                  \
+  Bit64u result_64 = op1_64 op op2_64;                               \
+  BX_WRITE_64BIT_REG(i->dst(), result_64);                           \
+                                                                     \
+  next(i, set_flags(op1_64, op2_64, result_64));                     \
+}
+
+#define BX_FORM_EqR(name, op, set_flags, next)                       \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::name(bxInstruction_c *i)       \
+{                                                                    \
+  Bit64u op1_64 = BX_READ_64BIT_REG(i->dst());                       \
+  Bit64u result_64 = op1_64 op;                                      \
+  BX_WRITE_64BIT_REG(i->dst(), result_64);                           \
+                                                                     \
+  next(i, set_flags(op1_64, 0, result_64));                          \
+}
+
+#endif
+
+#endif
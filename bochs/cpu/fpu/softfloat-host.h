@@ -0,0 +1,285 @@
+/*============================================================================
+This C header file is part of the SoftFloat IEC/IEEE Floating-point Arithmetic
+Package, Release 2b.
+=============================================================================*/
+
+/*============================================================================
+ * Host FPU fast path for Bochs (x86 achitecture simulator)
+ * ==========================================================================*/
+
+#ifndef _SOFTFLOAT_HOST_H_
+#define _SOFTFLOAT_HOST_H_
+
+/*----------------------------------------------------------------------------
+| The fast path requires host IEEE single and double precision arithmetic
+| without excess precision (SSE2 math) running in round to nearest mode.
+*----------------------------------------------------------------------------*/
+#if BX_SUPPORT_HOST_FPU && defined(__SSE2_MATH__)
+#define HOST_FPU_FASTPATH 1
+#else
+#define HOST_FPU_FASTPATH 0
+#endif
+
+#if HOST_FPU_FASTPATH
+
+/*----------------------------------------------------------------------------
+| Single and double precision add/sub/mul/div/sqrt and single precision
+| multiply-add are executed by the host when the result is guaranteed to be
+| identical to the software implementation: round to nearest even, operands
+| and result well inside of the normal range. The host exception flags are
+| not used, instead the rounding error of the host result is computed
+| exactly (error-free transformations) to raise the inexact flag and to tell
+| whether the result was rounded up. Otherwise the caller falls back to the
+| software implementation.
+*----------------------------------------------------------------------------*/
+
+union host_float32_t { float32 u; float f; };
+union host_float64_t { float64 u; double f; };
+
+BX_CPP_INLINE float host_float32_val(float32 a)
+{
+    host_float32_t h; h.u = a; return h.f;
+}
+
+BX_CPP_INLINE float32 host_float32_bits(float a)
+{
+    host_float32_t h; h.f = a; return h.u;
+}
+
+BX_CPP_INLINE double host_float64_val(float64 a)
+{
+    host_float64_t h; h.u = a; return h.f;
+}
+
+BX_CPP_INLINE float64 host_float64_bits(double a)
+{
+    host_float64_t h; h.f = a; return h.u;
+}
+
+/*----------------------------------------------------------------------------
+| Returns 1 if the value is normal and at least a quarter of the exponent
+| range away from underflow and overflow, so neither special operands nor
+| tiny or huge results are involved and the error terms are representable.
+*----------------------------------------------------------------------------*/
+
+BX_CPP_INLINE int host_float32_in_range(float32 a)
+{
+    Bit32u exp = (a >> 23) & 0xFF;
+    return (exp >= 0x20) && (exp < 0xE0);
+}
+
+BX_CPP_INLINE int host_float64_in_range(float64 a)
+{
+    Bit32u exp = (Bit32u)(a >> 52) & 0x7FF;
+    return (exp >= 0x100) && (exp < 0x700);
+}
+
+/*----------------------------------------------------------------------------
+| Raises the inexact flag if the rounding error `err' (exact result minus
+| the returned result `z') is not zero and records if the magnitude of the
+| result was rounded up.
+*----------------------------------------------------------------------------*/
+
+BX_CPP_INLINE void host_raise_inexact(double z, double err, float_status_t &status)
+{
+    if (err != 0) {
+        float_raise(status, float_flag_inexact);
+#ifdef FLOATX80
+        if ((z > 0) == (err < 0)) set_float_rounding_up(status);
+#endif
+    }
+}
+
+/*----------------------------------------------------------------------------
+| Exact product of two double precision values as the sum `p' + `e'
+| (Dekker's algorithm, or host FMA when available).
+*----------------------------------------------------------------------------*/
+
+BX_CPP_INLINE void host_float64_two_prod(double a, double b, double &p, double &e)
+{
+    p = a * b;
+#if defined(__FMA__)
+    e = __builtin_fma(a, b, -p);
+#else
+    const double split = 134217729.0; /* 2^27 + 1 */
+    double ta = split * a, ah = ta - (ta - a), al = a - ah;
+    double tb = split * b, bh = tb - (tb - b), bl = b - bh;
+    e = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+#endif
+}
+
+/*----------------------------------------------------------------------------
+| Single precision operations
+*----------------------------------------------------------------------------*/
+
+BX_CPP_INLINE int host_float32_add(float32 a, float32 b, float32 &z, float_status_t &status)
+{
+    if (get_float_rounding_mode(status) != float_round_nearest_even ||
+        !host_float32_in_range(a) || !host_float32_in_range(b)) return 0;
+
+    float fa = host_float32_val(a), fb = host_float32_val(b);
+    float fz = fa + fb;
+    z = host_float32_bits(fz);
+    if (! host_float32_in_range(z)) return 0;
+
+    /* Knuth's TwoSum */
+    float bv = fz - fa;
+    float err = (fa - (fz - bv)) + (fb - bv);
+    host_raise_inexact(fz, err, status);
+    return 1;
+}
+
+BX_CPP_INLINE int host_float32_mul(float32 a, float32 b, float32 &z, float_status_t &status)
+{
+    if (get_float_rounding_mode(status) != float_round_nearest_even ||
+        !host_float32_in_range(a) || !host_float32_in_range(b)) return 0;
+
+    /* product of two 24-bit significands is exact in double precision */
+    double p = (double) host_float32_val(a) * (double) host_float32_val(b);
+    float fz = (float) p;
+    z = host_float32_bits(fz);
+    if (! host_float32_in_range(z)) return 0;
+
+    host_raise_inexact(fz, p - (double) fz, status);
+    return 1;
+}
+
+BX_CPP_INLINE int host_float32_div(float32 a, float32 b, float32 &z, float_status_t &status)
+{
+    if (get_float_rounding_mode(status) != float_round_nearest_even ||
+        !host_float32_in_range(a) || !host_float32_in_range(b)) return 0;
+
+    float fa = host_float32_val(a), fb = host_float32_val(b);
+    float fz = fa / fb;
+    z = host_float32_bits(fz);
+    if (! host_float32_in_range(z)) return 0;
+
+    /* a - z*b is exact in double precision, the quotient error has the sign
+       of the remainder divided by b */
+    double r = (double) fa - (double) fz * (double) fb;
+    host_raise_inexact(fz, (fb < 0) ? -r : r, status);
+    return 1;
+}
+
+BX_CPP_INLINE int host_float32_sqrt(float32 a, float32 &z, float_status_t &status)
+{
+    if (get_float_rounding_mode(status) != float_round_nearest_even ||
+        !host_float32_in_range(a) || (a & 0x80000000)) return 0;
+
+    float fz = __builtin_sqrtf(host_float32_val(a));
+    z = host_float32_bits(fz);
+
+    double r = (double) host_float32_val(a) - (double) fz * (double) fz;
+    host_raise_inexact(fz, r, status);
+    return 1;
+}
+
+BX_CPP_INLINE int host_float32_muladd(float32 a, float32 b, float32 c, float32 &z, float_status_t &status)
+{
+    if (get_float_rounding_mode(status) != float_round_nearest_even ||
+        !host_float32_in_range(a) || !host_float32_in_range(b) ||
+        !host_float32_in_range(c)) return 0;
+
+    /* exact product in double precision, then TwoSum with the addend */
+    double p = (double) host_float32_val(a) * (double) host_float32_val(b);
+    double fc = (double) host_float32_val(c);
+    double s = p + fc;
+    double bv = s - p;
+    double e = (p - (s - bv)) + (fc - bv);
+
+    /* s exactly halfway between two single precision values and the true
+       sum is not: rounding of s might go in the wrong direction */
+    if (e != 0 && (host_float64_bits(s) & 0x1FFFFFFF) == 0x10000000) return 0;
+
+    float fz = (float) s;
+    z = host_float32_bits(fz);
+    if (! host_float32_in_range(z)) return 0;
+
+    double err = s - (double) fz;
+    host_raise_inexact(fz, (err != 0) ? err : e, status);
+    return 1;
+}
+
+/*----------------------------------------------------------------------------
+| Double precision operations
+*----------------------------------------------------------------------------*/
+
+BX_CPP_INLINE int host_float64_add(float64 a, float64 b, float64 &z, float_status_t &status)
+{
+    if (get_float_rounding_mode(status) != float_round_nearest_even ||
+        !host_float64_in_range(a) || !host_float64_in_range(b)) return 0;
+
+    double fa = host_float64_val(a), fb = host_float64_val(b);
+    double fz = fa + fb;
+    z = host_float64_bits(fz);
+    if (! host_float64_in_range(z)) return 0;
+
+    /* Knuth's TwoSum */
+    double bv = fz - fa;
+    double err = (fa - (fz - bv)) + (fb - bv);
+    host_raise_inexact(fz, err, status);
+    return 1;
+}
+
+BX_CPP_INLINE int host_float64_mul(float64 a, float64 b, float64 &z, float_status_t &status)
+{
+    if (get_float_rounding_mode(status) != float_round_nearest_even ||
+        !host_float64_in_range(a) || !host_float64_in_range(b)) return 0;
+
+    double fz, err;
+    host_float64_two_prod(host_float64_val(a), host_float64_val(b), fz, err);
+    z = host_float64_bits(fz);
+    if (! host_float64_in_range(z)) return 0;
+
+    host_raise_inexact(fz, err, status);
+    return 1;
+}
+
+BX_CPP_INLINE int host_float64_div(float64 a, float64 b, float64 &z, float_status_t &status)
+{
+    if (get_float_rounding_mode(status) != float_round_nearest_even ||
+        !host_float64_in_range(a) || !host_float64_in_range(b)) return 0;
+
+    double fa = host_float64_val(a), fb = host_float64_val(b);
+    double fz = fa / fb;
+    z = host_float64_bits(fz);
+    if (! host_float64_in_range(z)) return 0;
+
+    /* remainder a - (p + e) where p + e = z*b exactly, a - p is exact */
+    double p, e;
+    host_float64_two_prod(fz, fb, p, e);
+    double d = fa - p;
+    if (d != e) {
+        float_raise(status, float_flag_inexact);
+#ifdef FLOATX80
+        /* |z| > |a/b| when |z*b| > |a| */
+        if ((fa > 0) ? (e > d) : (e < d)) set_float_rounding_up(status);
+#endif
+    }
+    return 1;
+}
+
+BX_CPP_INLINE int host_float64_sqrt(float64 a, float64 &z, float_status_t &status)
+{
+    if (get_float_rounding_mode(status) != float_round_nearest_even ||
+        !host_float64_in_range(a) || (a & BX_CONST64(0x8000000000000000))) return 0;
+
+    double fa = host_float64_val(a);
+    double fz = __builtin_sqrt(fa);
+    z = host_float64_bits(fz);
+
+    double p, e;
+    host_float64_two_prod(fz, fz, p, e);
+    double d = fa - p;
+    if (d != e) {
+        float_raise(status, float_flag_inexact);
+#ifdef FLOATX80
+        if (e > d) set_float_rounding_up(status);
+#endif
+    }
+    return 1;
+}
+
+#endif // HOST_FPU_FASTPATH
+
+#endif
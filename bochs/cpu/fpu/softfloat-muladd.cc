@@ -53,6 +53,11 @@ these four paragraphs for those parts of this code that are retained.
 *----------------------------------------------------------------------------*/
 #include "softfloat-specialize.h"
 
+/*----------------------------------------------------------------------------
+| Host FPU fast path for single precision fused multiply-add.
+*----------------------------------------------------------------------------*/
+#include "softfloat-host.h"
+
 /*----------------------------------------------------------------------------
 | Takes three single-precision floating-point values `a', `b' and `c', one of
 | which is a NaN, and returns the appropriate NaN result.  If any of  `a',
@@ -134,6 +139,15 @@ static float64 propagateFloat64MulAddNaN(float64 a, float64 b, float64 c, float_
 
 float32 float32_muladd(float32 a, float32 b, float32 c, int flags, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    {
+        float32 ha = (flags & float_muladd_negate_product) ? (a ^ 0x80000000) : a;
+        float32 hc = (flags & float_muladd_negate_c) ? (c ^ 0x80000000) : c;
+        float32 z;
+        if (host_float32_muladd(ha, b, hc, z, status)) return z;
+    }
+#endif
+
     int aSign, bSign, cSign, zSign;
     Bit16s aExp, bExp, cExp, pExp, zExp;
     Bit32u aSig, bSig, cSig;
@@ -56,6 +56,11 @@ these four paragraphs for those parts of this code that are retained.
 *----------------------------------------------------------------------------*/
 #include "softfloat-specialize.h"
 
+/*----------------------------------------------------------------------------
+| Host FPU fast path for the basic single and double precision operations.
+*----------------------------------------------------------------------------*/
+#include "softfloat-host.h"
+
 /*----------------------------------------------------------------------------
 | Returns the result of converting the 32-bit two's complement integer `a'
 | to the single-precision floating-point format.  The conversion is performed
@@ -1004,6 +1009,11 @@ static float32 subFloat32Sigs(float32 a, float32 b, int zSign, float_status_t &s
 
 float32 float32_add(float32 a, float32 b, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    float32 z;
+    if (host_float32_add(a, b, z, status)) return z;
+#endif
+
     int aSign = extractFloat32Sign(a);
     int bSign = extractFloat32Sign(b);
 
@@ -1023,6 +1033,11 @@ float32 float32_add(float32 a, float32 b, float_status_t &status)
 
 float32 float32_sub(float32 a, float32 b, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    float32 z;
+    if (host_float32_add(a, b ^ 0x80000000, z, status)) return z;
+#endif
+
     int aSign = extractFloat32Sign(a);
     int bSign = extractFloat32Sign(b);
 
@@ -1042,6 +1057,11 @@ float32 float32_sub(float32 a, float32 b, float_status_t &status)
 
 float32 float32_mul(float32 a, float32 b, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    float32 z;
+    if (host_float32_mul(a, b, z, status)) return z;
+#endif
+
     int aSign, bSign, zSign;
     Bit16s aExp, bExp, zExp;
     Bit32u aSig, bSig;
@@ -1114,6 +1134,11 @@ float32 float32_mul(float32 a, float32 b, float_status_t &status)
 
 float32 float32_div(float32 a, float32 b, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    float32 z;
+    if (host_float32_div(a, b, z, status)) return z;
+#endif
+
     int aSign, bSign, zSign;
     Bit16s aExp, bExp, zExp;
     Bit32u aSig, bSig, zSig;
@@ -1185,6 +1210,11 @@ float32 float32_div(float32 a, float32 b, float_status_t &status)
 
 float32 float32_sqrt(float32 a, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    float32 z;
+    if (host_float32_sqrt(a, z, status)) return z;
+#endif
+
     int aSign;
     Bit16s aExp, zExp;
     Bit32u aSig, zSig;
@@ -2230,6 +2260,11 @@ static float64 subFloat64Sigs(float64 a, float64 b, int zSign, float_status_t &s
 
 float64 float64_add(float64 a, float64 b, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    float64 z;
+    if (host_float64_add(a, b, z, status)) return z;
+#endif
+
     int aSign = extractFloat64Sign(a);
     int bSign = extractFloat64Sign(b);
 
@@ -2249,6 +2284,11 @@ float64 float64_add(float64 a, float64 b, float_status_t &status)
 
 float64 float64_sub(float64 a, float64 b, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    float64 z;
+    if (host_float64_add(a, b ^ BX_CONST64(0x8000000000000000), z, status)) return z;
+#endif
+
     int aSign = extractFloat64Sign(a);
     int bSign = extractFloat64Sign(b);
 
@@ -2268,6 +2308,11 @@ float64 float64_sub(float64 a, float64 b, float_status_t &status)
 
 float64 float64_mul(float64 a, float64 b, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    float64 z;
+    if (host_float64_mul(a, b, z, status)) return z;
+#endif
+
     int aSign, bSign, zSign;
     Bit16s aExp, bExp, zExp;
     Bit64u aSig, bSig, zSig0, zSig1;
@@ -2338,6 +2383,11 @@ float64 float64_mul(float64 a, float64 b, float_status_t &status)
 
 float64 float64_div(float64 a, float64 b, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    float64 z;
+    if (host_float64_div(a, b, z, status)) return z;
+#endif
+
     int aSign, bSign, zSign;
     Bit16s aExp, bExp, zExp;
     Bit64u aSig, bSig, zSig;
@@ -2417,6 +2467,11 @@ float64 float64_div(float64 a, float64 b, float_status_t &status)
 
 float64 float64_sqrt(float64 a, float_status_t &status)
 {
+#if HOST_FPU_FASTPATH
+    float64 z;
+    if (host_float64_sqrt(a, z, status)) return z;
+#endif
+
     int aSign;
     Bit16s aExp, zExp;
     Bit64u aSig, zSig, doubleZSig;
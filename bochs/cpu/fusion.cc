@@ -0,0 +1,370 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2020  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+/////////////////////////////////////////////////////////////////////////
+
+#define NEED_CPU_REG_SHORTCUTS 1
+#include "bochs.h"
+#include "cpu.h"
+#define LOG_THIS BX_CPU_THIS_PTR
+
+#include "cpustats.h"
+
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+
+//
+// Instruction fusion.
+//
+// Common pairs of adjacent instructions found in the trace (listed in
+// decoder/fusion.def) are executed by single fused handler installed for
+// the first instruction of the pair. Both instructions stay in the trace
+// and are committed separately, so the RIP, icount and instrumentation
+// callbacks are the same as without fusion. The fused handler saves the
+// indirect dispatch of the second instruction and for compare and branch
+// pairs evaluates the branch condition directly from the operands instead
+// of going through lazy flags.
+//
+// The trace could be stopped between the two instructions by async event
+// (for example after self modifying code was detected), in this case the
+// second instruction is executed by its own handler in the next trace.
+//
+
+// commit the first instruction and move to the second one
+#define BX_FUSED_NEXT(i) {                             \
+  BX_COMMIT_INSTRUCTION(i);                            \
+  if (BX_CPU_THIS_PTR async_event) return;             \
+  ++i;                                                 \
+  BX_INSTR_BEFORE_EXECUTION(BX_CPU_ID, (i));           \
+  RIP += (i)->ilen();                                  \
+}
+
+#if BX_SUPPORT_X86_64
+#define BX_FUSED_BRANCH_NEAR(i) {                                             \
+  if (long64_mode()) {                                                        \
+    Bit64u new_RIP = RIP + (Bit32s) (i)->Id();                                \
+    if (! IsCanonical(new_RIP)) {                                             \
+      BX_ERROR(("branch_near64: canonical RIP violation"));                   \
+      exception(BX_GP_EXCEPTION, 0);                                          \
+    }                                                                         \
+    RIP = new_RIP;                                                            \
+  }                                                                           \
+  else {                                                                      \
+    BX_FUSED_BRANCH_NEAR32(i);                                                \
+  }                                                                           \
+}
+#else
+#define BX_FUSED_BRANCH_NEAR(i) BX_FUSED_BRANCH_NEAR32(i)
+#endif
+
+#define BX_FUSED_BRANCH_NEAR32(i) {                                           \
+  Bit32u new_EIP = EIP + (Bit32s) (i)->Id();                                  \
+  if (new_EIP > BX_CPU_THIS_PTR sregs[BX_SEG_REG_CS].cache.u.segment.limit_scaled) { \
+    BX_ERROR(("branch_near32: offset outside of CS limits"));                 \
+    exception(BX_GP_EXCEPTION, 0);                                            \
+  }                                                                           \
+  EIP = new_EIP;                                                              \
+}
+
+// Execute the conditional branch fused with the previous instruction. The
+// 'cond' expression is evaluated for the branch instruction and returns -1
+// when the condition cannot be derived from the operands directly.
+#define BX_FUSED_JCC(i, cond) {                                               \
+  BX_FUSED_NEXT(i);                                                           \
+  int taken = (cond);                                                         \
+  if (taken < 0) taken = branchCondition((i)->fusedCond());                   \
+  if (taken) {                                                                \
+    BX_FUSED_BRANCH_NEAR(i);                                                  \
+    BX_INSTR_CNEAR_BRANCH_TAKEN(BX_CPU_ID, PREV_RIP, RIP);                    \
+    BX_LINK_TRACE(i);                                                         \
+  }                                                                           \
+  BX_INSTR_CNEAR_BRANCH_NOT_TAKEN(BX_CPU_ID, PREV_RIP);                       \
+  BX_NEXT_INSTR(i);                                                           \
+}
+
+// Branch conditions after SUB/CMP, AND/TEST and DEC, computed from the
+// operands. Parity, overflow (and carry for DEC) are left to lazy flags.
+#define BX_DEFINE_FUSED_CONDITIONS(size)                                      \
+static BX_CPP_INLINE int fusedCondSub##size(unsigned cc, Bit##size##u op1, Bit##size##u op2) \
+{                                                                             \
+  switch(cc) {                                                                \
+    case 0x2: return op1 <  op2;                                              \
+    case 0x3: return op1 >= op2;                                              \
+    case 0x4: return op1 == op2;                                              \
+    case 0x5: return op1 != op2;                                              \
+    case 0x6: return op1 <= op2;                                              \
+    case 0x7: return op1 >  op2;                                              \
+    case 0x8: return (Bit##size##s) (op1 - op2) <  0;                         \
+    case 0x9: return (Bit##size##s) (op1 - op2) >= 0;                         \
+    case 0xC: return (Bit##size##s) op1 <  (Bit##size##s) op2;                \
+    case 0xD: return (Bit##size##s) op1 >= (Bit##size##s) op2;                \
+    case 0xE: return (Bit##size##s) op1 <= (Bit##size##s) op2;                \
+    case 0xF: return (Bit##size##s) op1 >  (Bit##size##s) op2;                \
+    default:  return -1;                                                      \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+static BX_CPP_INLINE int fusedCondLogic##size(unsigned cc, Bit##size##u result) \
+{                                                                             \
+  switch(cc) {                                                                \
+    case 0x0: return 0;                                                       \
+    case 0x1: return 1;                                                       \
+    case 0x2: return 0;                                                       \
+    case 0x3: return 1;                                                       \
+    case 0x4: return result == 0;                                             \
+    case 0x5: return result != 0;                                             \
+    case 0x6: return result == 0;                                             \
+    case 0x7: return result != 0;                                             \
+    case 0x8: case 0xC: return (Bit##size##s) result <  0;                    \
+    case 0x9: case 0xD: return (Bit##size##s) result >= 0;                    \
+    case 0xE: return (Bit##size##s) result <= 0;                              \
+    case 0xF: return (Bit##size##s) result >  0;                              \
+    default:  return -1;                                                      \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+static BX_CPP_INLINE int fusedCondDec##size(unsigned cc, Bit##size##u result) \
+{                                                                             \
+  Bit##size##s op1 = (Bit##size##s) (result + 1);                             \
+  switch(cc) {                                                                \
+    case 0x4: return result == 0;                                             \
+    case 0x5: return result != 0;                                             \
+    case 0x8: return (Bit##size##s) result <  0;                              \
+    case 0x9: return (Bit##size##s) result >= 0;                              \
+    case 0xC: return op1 <= 0;                                                \
+    case 0xD: return op1 >  0;                                                \
+    case 0xE: return op1 <= 1;                                                \
+    case 0xF: return op1 >  1;                                                \
+    default:  return -1;                                                      \
+  }                                                                           \
+}
+
+BX_DEFINE_FUSED_CONDITIONS(32)
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMP_GdEdR_Jcc(bxInstruction_c *i)
+{
+  Bit32u op1_32 = BX_READ_32BIT_REG(i->dst());
+  Bit32u op2_32 = BX_READ_32BIT_REG(i->src());
+  Bit32u diff_32 = op1_32 - op2_32;
+  SET_FLAGS_OSZAPC_SUB_32(op1_32, op2_32, diff_32);
+
+  BX_FUSED_JCC(i, fusedCondSub32(i->fusedCond(), op1_32, op2_32));
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMP_EdIdR_Jcc(bxInstruction_c *i)
+{
+  Bit32u op1_32 = BX_READ_32BIT_REG(i->dst());
+  Bit32u op2_32 = i->Id();
+  Bit32u diff_32 = op1_32 - op2_32;
+  SET_FLAGS_OSZAPC_SUB_32(op1_32, op2_32, diff_32);
+
+  BX_FUSED_JCC(i, fusedCondSub32(i->fusedCond(), op1_32, op2_32));
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::TEST_EdGdR_Jcc(bxInstruction_c *i)
+{
+  Bit32u op1_32 = BX_READ_32BIT_REG(i->dst()) & BX_READ_32BIT_REG(i->src());
+  SET_FLAGS_OSZAPC_LOGIC_32(op1_32);
+
+  BX_FUSED_JCC(i, fusedCondLogic32(i->fusedCond(), op1_32));
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::TEST_EdIdR_Jcc(bxInstruction_c *i)
+{
+  Bit32u op1_32 = BX_READ_32BIT_REG(i->dst()) & i->Id();
+  SET_FLAGS_OSZAPC_LOGIC_32(op1_32);
+
+  BX_FUSED_JCC(i, fusedCondLogic32(i->fusedCond(), op1_32));
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::DEC_EdR_Jcc(bxInstruction_c *i)
+{
+  Bit32u erx = --BX_READ_32BIT_REG(i->dst());
+  SET_FLAGS_OSZAP_SUB_32(erx + 1, 0, erx);
+  BX_CLEAR_64BIT_HIGH(i->dst());
+
+  BX_FUSED_JCC(i, fusedCondDec32(i->fusedCond(), erx));
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::PUSH_EdR_PUSH_EdR(bxInstruction_c *i)
+{
+  push_32(BX_READ_32BIT_REG(i->dst()));
+
+  BX_FUSED_NEXT(i);
+
+  push_32(BX_READ_32BIT_REG(i->dst()));
+
+  BX_NEXT_INSTR(i);
+}
+
+#define BX_FUSED_LOAD_OP32(insn)                                              \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV32_GdEdM_##insn##_GdEdR(bxInstruction_c *i) \
+{                                                                             \
+  Bit32u eaddr = (Bit32u) BX_CPU_RESOLVE_ADDR_32(i);                          \
+  Bit32u val32 = read_virtual_dword_32(i->seg(), eaddr);                      \
+                                                                              \
+  BX_WRITE_32BIT_REGZ(i->dst(), val32);                                       \
+                                                                              \
+  BX_FUSED_NEXT(i);                                                           \
+                                                                              \
+  insn##_GdEdR(i);                                                            \
+}
+
+BX_FUSED_LOAD_OP32(ADD)
+BX_FUSED_LOAD_OP32(SUB)
+BX_FUSED_LOAD_OP32(AND)
+BX_FUSED_LOAD_OP32(OR)
+BX_FUSED_LOAD_OP32(XOR)
+BX_FUSED_LOAD_OP32(CMP)
+
+#if BX_SUPPORT_X86_64
+
+BX_DEFINE_FUSED_CONDITIONS(64)
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMP_GqEqR_Jcc(bxInstruction_c *i)
+{
+  Bit64u op1_64 = BX_READ_64BIT_REG(i->dst());
+  Bit64u op2_64 = BX_READ_64BIT_REG(i->src());
+  Bit64u diff_64 = op1_64 - op2_64;
+  SET_FLAGS_OSZAPC_SUB_64(op1_64, op2_64, diff_64);
+
+  BX_FUSED_JCC(i, fusedCondSub64(i->fusedCond(), op1_64, op2_64));
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMP_EqIdR_Jcc(bxInstruction_c *i)
+{
+  Bit64u op1_64 = BX_READ_64BIT_REG(i->dst());
+  Bit64u op2_64 = (Bit32s) i->Id();
+  Bit64u diff_64 = op1_64 - op2_64;
+  SET_FLAGS_OSZAPC_SUB_64(op1_64, op2_64, diff_64);
+
+  BX_FUSED_JCC(i, fusedCondSub64(i->fusedCond(), op1_64, op2_64));
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::TEST_EqGqR_Jcc(bxInstruction_c *i)
+{
+  Bit64u op1_64 = BX_READ_64BIT_REG(i->dst()) & BX_READ_64BIT_REG(i->src());
+  SET_FLAGS_OSZAPC_LOGIC_64(op1_64);
+
+  BX_FUSED_JCC(i, fusedCondLogic64(i->fusedCond(), op1_64));
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::TEST_EqIdR_Jcc(bxInstruction_c *i)
+{
+  Bit64u op1_64 = BX_READ_64BIT_REG(i->dst()) & (Bit64u) (Bit32s) i->Id();
+  SET_FLAGS_OSZAPC_LOGIC_64(op1_64);
+
+  BX_FUSED_JCC(i, fusedCondLogic64(i->fusedCond(), op1_64));
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::DEC_EqR_Jcc(bxInstruction_c *i)
+{
+  Bit64u rrx = --BX_READ_64BIT_REG(i->dst());
+  SET_FLAGS_OSZAP_SUB_64(rrx + 1, 0, rrx);
+
+  BX_FUSED_JCC(i, fusedCondDec64(i->fusedCond(), rrx));
+}
+
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::PUSH_EqR_PUSH_EqR(bxInstruction_c *i)
+{
+  push_64(BX_READ_64BIT_REG(i->dst()));
+
+  BX_FUSED_NEXT(i);
+
+  push_64(BX_READ_64BIT_REG(i->dst()));
+
+  BX_NEXT_INSTR(i);
+}
+
+#define BX_FUSED_LOAD_OP64(insn)                                              \
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_GqEqM_##insn##_GqEqR(bxInstruction_c *i) \
+{                                                                             \
+  bx_address eaddr = BX_CPU_RESOLVE_ADDR_64(i);                               \
+  Bit64u val64 = read_linear_qword(i->seg(), get_laddr64(i->seg(), eaddr));   \
+                                                                              \
+  BX_WRITE_64BIT_REG(i->dst(), val64);                                        \
+                                                                              \
+  BX_FUSED_NEXT(i);                                                           \
+                                                                              \
+  insn##_GqEqR(i);                                                            \
+}
+
+BX_FUSED_LOAD_OP64(ADD)
+BX_FUSED_LOAD_OP64(SUB)
+BX_FUSED_LOAD_OP64(AND)
+BX_FUSED_LOAD_OP64(OR)
+BX_FUSED_LOAD_OP64(XOR)
+BX_FUSED_LOAD_OP64(CMP)
+
+#endif
+
+struct bxFusionPair {
+  BxExecutePtr_tR first;
+  BxExecutePtr_tR second; // NULL for any near conditional branch
+  BxExecutePtr_tR fused;
+};
+
+static const bxFusionPair fusionTable[] = {
+#define bx_define_fusion(first, second, fused) \
+  { &BX_CPU_C::first, &BX_CPU_C::second, &BX_CPU_C::fused },
+#define bx_define_fusion_jcc(first, fused) \
+  { &BX_CPU_C::first, NULL, &BX_CPU_C::fused },
+#include "decoder/fusion.def"
+#undef bx_define_fusion
+#undef bx_define_fusion_jcc
+};
+
+#define BX_FUSION_PAIRS (sizeof(fusionTable) / sizeof(fusionTable[0]))
+
+void BX_CPU_C::fuseInstructions(bxICacheEntry_c *entry)
+{
+  // the last instruction of the trace is BxEndTrace, never fused
+  for (unsigned n=0; n+1 < entry->tlen; n++) {
+    bxInstruction_c *i = entry->i + n, *next = i + 1;
+
+    for (unsigned f=0; f < BX_FUSION_PAIRS; f++) {
+      if (i->execute1 != fusionTable[f].first) continue;
+
+      if (fusionTable[f].second == NULL) {
+        int cond = nearBranchCondition(next->getIaOpcode());
+        if (cond < 0 || cond > 0xF) continue;
+        // 16-bit branches are not fused
+        if (! long64_mode() && ! next->os32L()) continue;
+        next->setFusedCond(cond);
+      }
+      else if (next->execute1 != fusionTable[f].second) continue;
+
+      i->execute1 = fusionTable[f].fused;
+      INC_ICACHE_STAT(iCacheFusedPairs);
+      n++; // the second instruction cannot start another pair
+      break;
+    }
+  }
+}
+
+void BX_CPU_C::unfuseInstruction(bxInstruction_c *i)
+{
+  for (unsigned f=0; f < BX_FUSION_PAIRS; f++) {
+    if (i->execute1 == fusionTable[f].fused) {
+      i->execute1 = fusionTable[f].first;
+      return;
+    }
+  }
+}
+
+#endif
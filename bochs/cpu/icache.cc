@@ -32,6 +32,7 @@
 #include "decoder/ia_opcodes.h"
 
 bxPageWriteStampTable pageWriteStampTable;
+bxTraceCacheFile_c traceCacheFile;
 
 extern int fetchDecode32(const Bit8u *fetchPtr, bx_bool is_32, bxInstruction_c *i, unsigned remainingInPage);
 #if BX_SUPPORT_X86_64
@@ -41,8 +42,31 @@ extern int assignHandler(bxInstruction_c *i, Bit32u fetchModeMask);
 
 void flushICaches(void)
 {
+#if BX_SUPPORT_SMP
+  // other CPUs are running in their own threads, they flush their iCache
+  // before the next trace lookup. Until all of them did the write stamps
+  // must be kept for their stale entries.
+  int cpu = bx_smp_current_cpu();
+  if (bx_smp_threads_active && cpu >= 0) {
+    BX_SMP_LOCK();
+    BX_CPU(cpu)->iCache->flushICacheEntries();
+    BX_CPU(cpu)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
+    for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
+      if ((int) i != cpu) {
+        bx_smp_request(i, BX_SMP_REQ_ICACHE_FLUSH);
+        BX_ATOMIC_OR32(&BX_CPU(i)->async_event, BX_ASYNC_EVENT_STOP_TRACE);
+      }
+    }
+    bx_smp_defer_reset_write_stamps();
+    BX_SMP_UNLOCK();
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
-    BX_CPU(i)->iCache.flushICacheEntries();
+    // the trace cache shared by the CPUs is flushed only once
+    if (i == 0 || BX_CPU(i)->iCache != BX_CPU(0)->iCache)
+      BX_CPU(i)->iCache->flushICacheEntries();
     BX_CPU(i)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
   }
 
@@ -53,9 +77,24 @@ void handleSMC(bx_phy_address pAddr, Bit32u mask)
 {
   INC_SMC_STAT(smc);
 
+  pageWriteStampTable.incSMCRate(pAddr);
+
+#if BX_SUPPORT_SMP
+  int cpu = bx_smp_current_cpu();
+  if (bx_smp_threads_active && cpu >= 0) {
+    BX_SMP_LOCK();
+    BX_CPU(cpu)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
+    BX_CPU(cpu)->iCache->handleSMC(pAddr, mask);
+    bx_smp_defer_smc(pAddr, mask);
+    BX_SMP_UNLOCK();
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
     BX_CPU(i)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
-    BX_CPU(i)->iCache.handleSMC(pAddr, mask);
+    if (i == 0 || BX_CPU(i)->iCache != BX_CPU(0)->iCache)
+      BX_CPU(i)->iCache->handleSMC(pAddr, mask);
   }
 }
 
@@ -63,7 +102,12 @@ void handleSMC(bx_phy_address pAddr, Bit32u mask)
 
 void BX_CPU_C::BxEndTrace(bxInstruction_c *i)
 {
-  // do nothing, return to main cpu_loop
+#if BX_SUPPORT_SUPERBLOCKS
+  // the trace ended without branch, try to link it to the fall-through trace
+  // (the tail of the superblock is reached this way)
+  linkTrace(i);
+#endif
+  // otherwise do nothing, return to main cpu_loop
 }
 
 void genDummyICacheEntry(bxInstruction_c *i)
@@ -71,23 +115,175 @@ void genDummyICacheEntry(bxInstruction_c *i)
   i->setILen(0);
   i->setIaOpcode(BX_INSERTED_OPCODE);
   i->execute1 = &BX_CPU_C::BxEndTrace;
+#if BX_SUPPORT_SUPERBLOCKS
+  i->setNextTrace(NULL, 0);
+#endif
+}
+
+// evaluate condition code of conditional branch (Intel encoding order)
+bx_bool BX_CPU_C::branchCondition(unsigned cond)
+{
+  switch(cond) {
+    case 0x0: return   get_OF();
+    case 0x1: return ! get_OF();
+    case 0x2: return   get_CF();
+    case 0x3: return ! get_CF();
+    case 0x4: return   get_ZF();
+    case 0x5: return ! get_ZF();
+    case 0x6: return   get_CF() || get_ZF();
+    case 0x7: return ! get_CF() && ! get_ZF();
+    case 0x8: return   get_SF();
+    case 0x9: return ! get_SF();
+    case 0xA: return   get_PF();
+    case 0xB: return ! get_PF();
+    case 0xC: return getB_SF() != getB_OF();
+    case 0xD: return getB_SF() == getB_OF();
+    case 0xE: return   get_ZF() || (getB_SF() != getB_OF());
+    case 0xF: return ! get_ZF() && (getB_SF() == getB_OF());
+    default:
+      return 1; // unconditional jump
+  }
+}
+
+// returns condition code of the direct near branch (16 for unconditional
+// jump) or -1 for any other instruction
+int BX_CPU_C::nearBranchCondition(Bit16u ia_opcode)
+{
+#define BX_NEAR_BRANCH_JCC(cc, cond)                                   \
+  case BX_IA_J##cc##_Jw:  case BX_IA_J##cc##_Jbw:                      \
+  case BX_IA_J##cc##_Jd:  case BX_IA_J##cc##_Jbd:                      \
+  BX_NEAR_BRANCH_JCC64(cc)                                             \
+    return (cond);
+
+#if BX_SUPPORT_X86_64
+#define BX_NEAR_BRANCH_JCC64(cc) case BX_IA_J##cc##_Jq: case BX_IA_J##cc##_Jbq:
+#else
+#define BX_NEAR_BRANCH_JCC64(cc)
+#endif
+
+  switch(ia_opcode) {
+    BX_NEAR_BRANCH_JCC(O,    0x0)
+    BX_NEAR_BRANCH_JCC(NO,   0x1)
+    BX_NEAR_BRANCH_JCC(B,    0x2)
+    BX_NEAR_BRANCH_JCC(NB,   0x3)
+    BX_NEAR_BRANCH_JCC(Z,    0x4)
+    BX_NEAR_BRANCH_JCC(NZ,   0x5)
+    BX_NEAR_BRANCH_JCC(BE,   0x6)
+    BX_NEAR_BRANCH_JCC(NBE,  0x7)
+    BX_NEAR_BRANCH_JCC(S,    0x8)
+    BX_NEAR_BRANCH_JCC(NS,   0x9)
+    BX_NEAR_BRANCH_JCC(P,    0xA)
+    BX_NEAR_BRANCH_JCC(NP,   0xB)
+    BX_NEAR_BRANCH_JCC(L,    0xC)
+    BX_NEAR_BRANCH_JCC(NL,   0xD)
+    BX_NEAR_BRANCH_JCC(LE,   0xE)
+    BX_NEAR_BRANCH_JCC(NLE,  0xF)
+    BX_NEAR_BRANCH_JCC(MP,   0x10) // JMP
+    default:
+      return -1;
+  }
+
+#undef BX_NEAR_BRANCH_JCC
+#undef BX_NEAR_BRANCH_JCC64
 }
 
+#if BX_SUPPORT_SUPERBLOCKS
+
+// Backward branch of the unrolled loop inside of superblock. The branch
+// target is the start of the loop body which is the next instruction in
+// the superblock, the fall-through path leaves the superblock.
+void BX_CPP_AttrRegparmN(1) BX_CPU_C::BxSuperblockBranch(bxInstruction_c *i)
+{
+  if (branchCondition(i->superblockCond())) {
+    // the branch target was checked when the superblock was built
+    RIP -= i->superblockBodyLen();
+#if BX_INSTRUMENTATION
+    if (i->superblockCond() > 0xF)
+      BX_INSTR_UCNEAR_BRANCH(BX_CPU_ID, BX_INSTR_IS_JMP, PREV_RIP, RIP);
+    else
+      BX_INSTR_CNEAR_BRANCH_TAKEN(BX_CPU_ID, PREV_RIP, RIP);
+#endif
+    BX_NEXT_INSTR(i);
+  }
+
+  BX_INSTR_CNEAR_BRANCH_NOT_TAKEN(BX_CPU_ID, PREV_RIP);
+  BX_LINK_TRACE(i);
+}
+
+#endif // BX_SUPPORT_SUPERBLOCKS
+
 #endif
 
+void bxICache_c::reclaimMemPoolSegment(void)
+{
+  mpoolSegment = (mpoolSegment + 1) % BxICacheMemPoolSegments;
+  mpindex = mpoolSegment * BxICacheMemPoolSegmentSize;
+
+  // traces from the reclaimed segment might be linked into other traces
+  if (breakLinks()) return;
+
+  const bxInstruction_c *start = &mpool[mpindex];
+  const bxInstruction_c *end = start + BxICacheMemPoolSegmentSize;
+
+  bxICacheEntry_c *e = entry;
+  for (unsigned n=0; n < BxICacheEntries; n++, e++) {
+    if (e->pAddr != BX_ICACHE_INVALID_PHY_ADDRESS && e->i >= start && e->i < end) {
+      e->pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
+      e->traceMask = 0;
+    }
+  }
+
+  for (unsigned n=0; n < BX_ICACHE_PAGE_SPLIT_ENTRIES; n++) {
+    if (pageSplitIndex[n].ppf != BX_ICACHE_INVALID_PHY_ADDRESS &&
+        pageSplitIndex[n].e->pAddr == BX_ICACHE_INVALID_PHY_ADDRESS)
+    {
+      pageSplitIndex[n].ppf = BX_ICACHE_INVALID_PHY_ADDRESS;
+    }
+  }
+}
+
 bxICacheEntry_c* BX_CPU_C::serveICacheMiss(Bit32u eipBiased, bx_phy_address pAddr)
 {
-  bxICacheEntry_c *entry = BX_CPU_THIS_PTR iCache.get_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
+  bxICacheEntry_c *entry;
 
-  BX_CPU_THIS_PTR iCache.alloc_trace(entry);
+  // code and data thrash in the page, decode a single instruction and
+  // execute it without caching
+  bx_bool uncached = pageWriteStampTable.isSMCThrashing(pAddr);
+  pageWriteStampTable.decSMCRate(pAddr);
+
+  if (uncached) {
+    INC_SMC_STAT(smcUncachedFetches);
+    entry = BX_CPU_THIS_PTR iCache->get_uncached_entry();
+  }
+  else {
+    entry = BX_CPU_THIS_PTR iCache->get_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
+
+#if InstrumentICACHE
+    if (entry->pAddr != BX_ICACHE_INVALID_PHY_ADDRESS)
+      INC_ICACHE_STAT(iCacheEvictions);
+    if (BX_CPU_THIS_PTR iCache->mempool_segment_full())
+      INC_ICACHE_STAT(iCacheMemPoolReclaims);
+#endif
+
+    BX_CPU_THIS_PTR iCache->alloc_trace(entry);
+  }
 
   // Cache miss. We weren't so lucky, but let's be optimistic - try to build 
   // trace from incoming instruction bytes stream !
   entry->pAddr = pAddr;
   entry->traceMask = 0;
+  if (! uncached)
+    BX_CPU_THIS_PTR iCache->link_page(entry);
+#if BX_SUPPORT_SUPERBLOCKS || BX_SUPPORT_JIT
+  entry->execCount = 0;
+#endif
+#if BX_SUPPORT_JIT
+  entry->jitCode = NULL;
+#endif
 
   unsigned remainingInPage = BX_CPU_THIS_PTR eipPageWindowSize - eipBiased;
   const Bit8u *fetchPtr = BX_CPU_THIS_PTR eipFetchPtr + eipBiased;
+  const Bit8u *traceFetchPtr = fetchPtr;
   int ret;
 
   bxInstruction_c *i = entry->i;
@@ -101,11 +297,18 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(Bit32u eipBiased, bx_phy_address pAdd
 #endif
 
   // Don't allow traces longer than cpu_loop can execute
-  static unsigned quantum =
+  static unsigned max_quantum =
 #if BX_SUPPORT_SMP
-    (BX_SMP_PROCESSORS > 1) ? SIM->get_param_num(BXPN_SMP_QUANTUM)->get() :
+    (BX_SMP_PROCESSORS > 1 && ! bx_smp_threads_active) ? SIM->get_param_num(BXPN_SMP_QUANTUM)->get() :
 #endif
     BX_MAX_TRACE_LENGTH;
+
+  unsigned quantum = uncached ? 1 : max_quantum;
+
+  if (traceCacheFile.is_enabled() && ! uncached) {
+    if (serveTraceCacheFile(entry, fetchPtr, remainingInPage, quantum))
+      return entry;
+  }
  
   for (unsigned n=0;n < quantum;n++)
   {
@@ -141,7 +344,8 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(Bit32u eipBiased, bx_phy_address pAdd
       genDummyICacheEntry(++i);
 #endif
 
-      BX_CPU_THIS_PTR iCache.commit_page_split_trace(BX_CPU_THIS_PTR pAddrFetchPage, entry);
+      if (! uncached)
+        BX_CPU_THIS_PTR iCache->commit_page_split_trace(BX_CPU_THIS_PTR pAddrFetchPage, entry);
       return entry;
     }
 
@@ -170,11 +374,20 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(Bit32u eipBiased, bx_phy_address pAdd
     fetchPtr += iLen;
 
     // try to find a trace starting from current pAddr and merge
-    if (remainingInPage >= 15) { // avoid merging with page split trace
+    if (remainingInPage >= 15 && ! uncached) { // avoid merging with page split trace
+      unsigned decoded = entry->tlen;
       if (mergeTraces(entry, i, pAddr)) {
           entry->traceMask |= traceMask;
           pageWriteStampTable.markICacheMask(pAddr, entry->traceMask);
-          BX_CPU_THIS_PTR iCache.commit_trace(entry->tlen);
+          // the merged instructions are optimized and linked already,
+          // record only the ones decoded here
+          if (traceCacheFile.is_enabled())
+            traceCacheFile.record(entry->pAddr, BX_CPU_THIS_PTR fetchModeMask, entry->i, decoded, traceFetchPtr);
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+          eliminateDeadFlags(entry);
+          fuseInstructions(entry);
+#endif
+          BX_CPU_THIS_PTR iCache->commit_trace(entry->tlen);
           return entry;
       }
     }
@@ -191,17 +404,93 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(Bit32u eipBiased, bx_phy_address pAdd
   genDummyICacheEntry(i);
 #endif
 
-  BX_CPU_THIS_PTR iCache.commit_trace(entry->tlen);
+  if (uncached)
+    return entry;
+
+  if (traceCacheFile.is_enabled())
+    traceCacheFile.record(entry->pAddr, BX_CPU_THIS_PTR fetchModeMask, entry->i, entry->tlen, traceFetchPtr);
+
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  eliminateDeadFlags(entry);
+  fuseInstructions(entry);
+#endif
+
+  BX_CPU_THIS_PTR iCache->commit_trace(entry->tlen);
 
   return entry;
 }
 
+// Build the trace from the persistent trace cache if the code bytes were
+// not changed since the trace was recorded.
+bx_bool BX_CPU_C::serveTraceCacheFile(bxICacheEntry_c *entry, const Bit8u *fetchPtr, unsigned remainingInPage, unsigned quantum)
+{
+  BX_SMP_LOCK();
+
+  bxTraceCacheRecord_c *rec = traceCacheFile.find(entry->pAddr, BX_CPU_THIS_PTR fetchModeMask, fetchPtr, remainingInPage);
+  if (rec == NULL || rec->tlen > quantum) {
+    BX_SMP_UNLOCK();
+    return 0;
+  }
+
+  INC_ICACHE_STAT(iCacheTraceFileHits);
+
+  bxInstruction_c *i = entry->i;
+  memcpy(i, rec->instructions(), sizeof(bxInstruction_c) * rec->tlen);
+  entry->tlen = rec->tlen;
+
+  BX_SMP_UNLOCK();
+
+  Bit32u pageOffset = PAGE_OFFSET((Bit32u) entry->pAddr);
+  Bit32u traceMask = 0;
+
+  for (unsigned n=0; n < entry->tlen; n++, i++)
+  {
+    // function pointers are not stored in the file, assign them again
+    assignHandler(i, BX_CPU_THIS_PTR fetchModeMask);
+
+    unsigned iLen = i->ilen();
+
+#ifdef BX_INSTR_STORE_OPCODE_BYTES
+    i->set_opcode_bytes(fetchPtr);
+#endif
+    BX_INSTR_OPCODE(BX_CPU_ID, i, fetchPtr, iLen,
+       BX_CPU_THIS_PTR sregs[BX_SEG_REG_CS].cache.u.segment.d_b, long64_mode());
+
+    traceMask |= 1 <<  (pageOffset >> 7);
+    traceMask |= 1 << ((pageOffset + iLen - 1) >> 7);
+
+    pageOffset += iLen;
+    fetchPtr += iLen;
+  }
+
+  entry->traceMask |= traceMask;
+
+  pageWriteStampTable.markICacheMask(entry->pAddr, entry->traceMask);
+
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+  entry->tlen++; /* Add the inserted end of trace opcode */
+  genDummyICacheEntry(i);
+
+  eliminateDeadFlags(entry);
+  fuseInstructions(entry);
+#endif
+
+  BX_CPU_THIS_PTR iCache->commit_trace(entry->tlen);
+
+  return 1;
+}
+
 bx_bool BX_CPU_C::mergeTraces(bxICacheEntry_c *entry, bxInstruction_c *i, bx_phy_address pAddr)
 {
-  bxICacheEntry_c *e = BX_CPU_THIS_PTR iCache.find_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
+  bxICacheEntry_c *e = BX_CPU_THIS_PTR iCache->find_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
 
   if (e != NULL)
   {
+#if BX_SUPPORT_SUPERBLOCKS
+    // superblock is reached through the trace link, don't duplicate it
+    if (isSuperblock(e)) return 0;
+#endif
+
     // determine max amount of instruction to take from another entry
     unsigned max_length = e->tlen;
 
@@ -226,6 +515,96 @@ bx_bool BX_CPU_C::mergeTraces(bxICacheEntry_c *entry, bxInstruction_c *i, bx_phy
   return 0;
 }
 
+#if BX_SUPPORT_SUPERBLOCKS
+
+bx_bool BX_CPU_C::isSuperblock(const bxICacheEntry_c *e)
+{
+  for (unsigned n=0; n < e->tlen; n++) {
+    if (e->i[n].execute1 == &BX_CPU_C::BxSuperblockBranch) return 1;
+  }
+
+  return 0;
+}
+
+// The trace became hot. If it is a tight loop closed by a direct branch back
+// to the trace start, rebuild it as a superblock with the loop body unrolled
+// so the loop iterates without leaving the trace. The superblock ends right
+// after the last copy of the loop branch, the fall-through path is reached
+// through the trace link of the end-of-trace opcode.
+void BX_CPU_C::buildSuperblock(bxICacheEntry_c *entry)
+{
+  if (BX_SMP_PROCESSORS > 1) return;
+
+  // do not reclaim trace memory while trace might be executing
+  if (BX_CPU_THIS_PTR iCache->mempool_segment_full()) return;
+
+  bx_address startRIP = RIP, nextRIP = RIP;
+  unsigned n, len = 0;
+  int cond = -1;
+
+  for (n=0; n < entry->tlen; n++) {
+    bxInstruction_c *i = entry->i + n;
+    if (i->getIaOpcode() == BX_INSERTED_OPCODE || i->execute1 == &BX_CPU_C::BxSuperblockBranch)
+      return;
+
+    nextRIP += i->ilen();
+
+    cond = nearBranchCondition(i->getIaOpcode());
+    if (cond < 0) continue;
+
+    bx_address target;
+#if BX_SUPPORT_X86_64
+    if (long64_mode())
+      target = nextRIP + (Bit32s) i->Id();
+    else
+#endif
+    if (i->os32L())
+      target = (Bit32u) (nextRIP + i->Id());
+    else
+      target = (Bit16u) (nextRIP + i->Iw());
+
+    if (target == startRIP) {
+      len = n + 1;
+      break;
+    }
+  }
+
+  // the loop body has to fit into superblock at least twice
+  unsigned copies = BX_MAX_TRACE_LENGTH / (len ? len : BX_MAX_TRACE_LENGTH + 1);
+  if (copies < 2) return;
+
+  Bit32u bodyLen = (Bit32u) (nextRIP - startRIP);
+
+  bxInstruction_c *superblock = &BX_CPU_THIS_PTR iCache->mpool[BX_CPU_THIS_PTR iCache->mpindex];
+  bxInstruction_c *i = superblock;
+
+  for (n=0; n < copies; n++, i += len) {
+    memcpy(i, entry->i, sizeof(bxInstruction_c) * len);
+
+    bxInstruction_c *branch = i + len - 1;
+    branch->setNextTrace(NULL, 0);
+    if (n < copies - 1) {
+      branch->execute1 = &BX_CPU_C::BxSuperblockBranch;
+      branch->setSuperblockBranch(cond, bodyLen);
+      // the instruction cannot be fused with the loop branch anymore
+      if (len > 1) unfuseInstruction(branch - 1);
+    }
+  }
+
+  genDummyICacheEntry(i);
+
+  // the loop might be linked to itself already, redirect it to the superblock
+  entry->i[len - 1].setNextTrace(superblock, BX_CPU_THIS_PTR iCache->traceLinkTimeStamp);
+
+  entry->i = superblock;
+  entry->tlen = copies * len + 1;
+  BX_CPU_THIS_PTR iCache->commit_trace(entry->tlen);
+
+  INC_ICACHE_STAT(iCacheSuperblocks);
+}
+
+#endif // BX_SUPPORT_SUPERBLOCKS
+
 void BX_CPU_C::boundaryFetch(const Bit8u *fetchPtr, unsigned remainingInPage, bxInstruction_c *i)
 {
   unsigned j, k;
@@ -293,3 +672,234 @@ void BX_CPU_C::boundaryFetch(const Bit8u *fetchPtr, unsigned remainingInPage, bx
   BX_INSTR_OPCODE(BX_CPU_ID, i, fetchBuffer, i->ilen(),
       BX_CPU_THIS_PTR sregs[BX_SEG_REG_CS].cache.u.segment.d_b, long64_mode());
 }
+
+#undef LOG_THIS
+#define LOG_THIS BX_CPU(0)->
+
+#define BX_TRACE_CACHE_FILE_MAGIC   "BXTRACE"
+#define BX_TRACE_CACHE_FILE_VERSION 2
+
+struct bxTraceCacheFileHeader_t {
+  char magic[8];
+  Bit32u version;
+  Bit32u signature;
+  Bit32u poolUsed;
+  Bit32u reserved;
+};
+
+// FNV-1a
+Bit32u bxTraceCacheFile_c::hashCode(const Bit8u *code, unsigned len)
+{
+  Bit32u hash = 0x811c9dc5;
+  for (unsigned n=0; n < len; n++) {
+    hash ^= code[n];
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+bx_bool bxTraceCacheFile_c::alloc_pool(Bit32u size)
+{
+  if (size <= poolSize) return 1;
+
+  Bit32u newSize = poolSize ? poolSize : (1024 * 1024);
+  while (newSize < size) newSize *= 2;
+
+  Bit8u *newPool = (Bit8u *) realloc(pool, newSize);
+  if (newPool == NULL) return 0;
+
+  pool = newPool;
+  poolSize = newSize;
+  return 1;
+}
+
+void bxTraceCacheFile_c::link_record(Bit32u offset)
+{
+  bxTraceCacheRecord_c *rec = get_record(offset);
+  unsigned index = hash(rec->pAddr, rec->fetchModeMask);
+  rec->next = hashTable[index];
+  hashTable[index] = offset;
+}
+
+// The instructions are passed to the handler tables as they are, check what
+// the decoder would never produce.
+bx_bool bxTraceCacheFile_c::valid_record(bxTraceCacheRecord_c *rec)
+{
+  if (rec->tlen == 0 || rec->tlen > BX_MAX_TRACE_LENGTH) return 0;
+  if (PAGE_OFFSET((Bit32u) rec->pAddr) + rec->codeLen > 4096) return 0;
+
+  const bxInstruction_c *i = rec->instructions();
+  unsigned codeLen = 0;
+  for (unsigned n=0; n < rec->tlen; n++) {
+    if (i[n].getIaOpcode() >= BX_IA_LAST) return 0;
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+    if (i[n].getIaOpcode() == BX_INSERTED_OPCODE) return 0;
+#endif
+    if (i[n].ilen() == 0 || i[n].ilen() > 15) return 0;
+    codeLen += i[n].ilen();
+  }
+
+  return (codeLen == rec->codeLen);
+}
+
+void bxTraceCacheFile_c::load(const char *path)
+{
+  unsigned n;
+
+  // traces decoded for another CPU configuration cannot be reused
+  signature = hashCode((const Bit8u *) BX_CPU(0)->ia_extensions_bitmask, sizeof(BX_CPU(0)->ia_extensions_bitmask));
+  signature ^= (BX_IA_LAST << 16) ^ sizeof(bxInstruction_c);
+
+  hashTable = new Bit32u[BX_TRACE_CACHE_HASH_SIZE];
+  for (n=0; n < BX_TRACE_CACHE_HASH_SIZE; n++)
+    hashTable[n] = 0;
+  poolUsed = 0;
+
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    BX_INFO(("trace cache file '%s' not found, it will be created at exit", path));
+    return;
+  }
+
+  bxTraceCacheFileHeader_t header;
+  if (fread(&header, sizeof(header), 1, fp) != 1 ||
+      memcmp(header.magic, BX_TRACE_CACHE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != BX_TRACE_CACHE_FILE_VERSION || header.poolUsed > BX_TRACE_CACHE_MAX_POOL)
+  {
+    BX_ERROR(("trace cache file '%s' is not valid, ignored", path));
+    fclose(fp);
+    return;
+  }
+
+  if (header.signature != signature) {
+    BX_INFO(("trace cache file '%s' was created for another CPU configuration, ignored", path));
+    fclose(fp);
+    return;
+  }
+
+  if (! alloc_pool(header.poolUsed) || fread(pool, 1, header.poolUsed, fp) != header.poolUsed) {
+    BX_ERROR(("failed to read trace cache file '%s'", path));
+    fclose(fp);
+    return;
+  }
+  fclose(fp);
+
+  // rebuild the hash chains, stop at the first broken record
+  Bit32u offset = 0, records = 0;
+  while (offset + sizeof(bxTraceCacheRecord_c) <= header.poolUsed) {
+    bxTraceCacheRecord_c *rec = (bxTraceCacheRecord_c *)(pool + offset);
+    Bit32u size = (sizeof(bxTraceCacheRecord_c) + sizeof(bxInstruction_c) * rec->tlen + rec->codeLen + 7) & ~7;
+    // the record must be complete before its instructions are looked at
+    if ((offset + size) > header.poolUsed || ! valid_record(rec)) break;
+    link_record(offset + 1);
+    offset += size;
+    records++;
+  }
+  poolUsed = offset;
+
+  BX_INFO(("loaded %d traces from trace cache file '%s'", records, path));
+}
+
+void bxTraceCacheFile_c::save(const char *path)
+{
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    BX_ERROR(("failed to create trace cache file '%s'", path));
+    return;
+  }
+
+  bxTraceCacheFileHeader_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BX_TRACE_CACHE_FILE_MAGIC, sizeof(header.magic));
+  header.version = BX_TRACE_CACHE_FILE_VERSION;
+  header.signature = signature;
+  header.poolUsed = poolUsed;
+
+  if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+      (poolUsed > 0 && fwrite(pool, 1, poolUsed, fp) != poolUsed))
+  {
+    BX_ERROR(("failed to write trace cache file '%s'", path));
+  }
+
+  fclose(fp);
+}
+
+bxTraceCacheRecord_c* bxTraceCacheFile_c::find(bx_phy_address pAddr, unsigned fetchModeMask, const Bit8u *fetchPtr, unsigned remainingInPage)
+{
+  for (Bit32u offset = hashTable[hash(pAddr, fetchModeMask)]; offset != 0;) {
+    bxTraceCacheRecord_c *rec = get_record(offset);
+    if (rec->pAddr == pAddr && rec->fetchModeMask == fetchModeMask &&
+        rec->codeLen <= remainingInPage && memcmp(rec->code(), fetchPtr, rec->codeLen) == 0)
+    {
+      return rec;
+    }
+    offset = rec->next;
+  }
+
+  return NULL;
+}
+
+void bxTraceCacheFile_c::record(bx_phy_address pAddr, unsigned fetchModeMask, const bxInstruction_c *i, unsigned tlen, const Bit8u *code)
+{
+  unsigned n, codeLen = 0;
+
+  // strip the inserted end of trace opcode
+  for (n=0; n < tlen; n++) {
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+    if (i[n].getIaOpcode() == BX_INSERTED_OPCODE) break;
+#endif
+    codeLen += i[n].ilen();
+  }
+  if (n == 0 || n < tlen-1) return;
+  tlen = n;
+  // same limit as in load()
+  if (tlen > BX_MAX_TRACE_LENGTH) return;
+
+  // page split traces are not recorded
+  if (PAGE_OFFSET((Bit32u) pAddr) + codeLen > 4096) return;
+
+  BX_SMP_LOCK();
+
+  Bit32u codeHash = hashCode(code, codeLen);
+
+  for (Bit32u offset = hashTable[hash(pAddr, fetchModeMask)]; offset != 0;) {
+    bxTraceCacheRecord_c *rec = get_record(offset);
+    if (rec->pAddr == pAddr && rec->fetchModeMask == fetchModeMask && rec->codeHash == codeHash &&
+        rec->tlen == tlen && rec->codeLen == codeLen && memcmp(rec->code(), code, codeLen) == 0)
+    {
+      BX_SMP_UNLOCK();
+      return; // already recorded
+    }
+    offset = rec->next;
+  }
+
+  Bit32u size = (sizeof(bxTraceCacheRecord_c) + sizeof(bxInstruction_c) * tlen + codeLen + 7) & ~7;
+  if ((poolUsed + size) > BX_TRACE_CACHE_MAX_POOL || ! alloc_pool(poolUsed + size)) {
+    BX_SMP_UNLOCK();
+    return;
+  }
+
+  bxTraceCacheRecord_c *rec = (bxTraceCacheRecord_c *)(pool + poolUsed);
+  memset(rec, 0, size);
+  rec->pAddr = pAddr;
+  rec->fetchModeMask = fetchModeMask;
+  rec->codeHash = codeHash;
+  rec->tlen = tlen;
+  rec->codeLen = codeLen;
+
+  bxInstruction_c *ri = rec->instructions();
+  memcpy(ri, i, sizeof(bxInstruction_c) * tlen);
+  for (n=0; n < tlen; n++) {
+    // host pointers are meaningless in another run, the recorded
+    // instructions come from the decoder and were not linked to other
+    // traces yet
+    ri[n].execute1 = NULL;
+    ri[n].handlers.next = NULL;
+  }
+  memcpy(rec->code(), code, codeLen);
+
+  link_record(poolUsed + 1);
+  poolUsed += size;
+
+  BX_SMP_UNLOCK();
+}
@@ -26,17 +26,27 @@
 
 extern void handleSMC(bx_phy_address pAddr, Bit32u mask);
 
+// SMC rate of a page is raised by every invalidation of decoded code from
+// the page and lowered by every decode from it. Code of the pages above the
+// threshold (code and data thrashing) is decoded one instruction at a time
+// and executed without caching it.
+#define BX_SMC_RATE_INC       16
+#define BX_SMC_RATE_THRESHOLD 128
+#define BX_SMC_RATE_MAX       255
+
 class bxPageWriteStampTable
 {
   const Bit32u PHY_MEM_PAGES = 1024*1024;
   Bit32u *fineGranularityMapping;
+  Bit8u *smcRate;
 
 public:
   bxPageWriteStampTable() {
     fineGranularityMapping = new Bit32u[PHY_MEM_PAGES];
+    smcRate = new Bit8u[PHY_MEM_PAGES];
     resetWriteStamps();
   }
- ~bxPageWriteStampTable() { delete [] fineGranularityMapping; }
+ ~bxPageWriteStampTable() { delete [] fineGranularityMapping; delete [] smcRate; }
 
   BX_CPP_INLINE static Bit32u hash(bx_phy_address pAddr) {
     // can share writeStamps between multiple pages if >32 bit phy address
@@ -53,12 +63,17 @@ public:
     Bit32u mask  = 1 << (PAGE_OFFSET((Bit32u) pAddr) >> 7);
            mask |= 1 << (PAGE_OFFSET((Bit32u) pAddr + len - 1) >> 7);
 
-    fineGranularityMapping[hash(pAddr)] |= mask;
+    markICacheMask(pAddr, mask);
   }
 
   BX_CPP_INLINE void markICacheMask(bx_phy_address pAddr, Bit32u mask)
   {
+#if BX_SUPPORT_SMP
+    // the table is shared by CPU threads in threaded SMP simulation
+    BX_ATOMIC_OR32(&fineGranularityMapping[hash(pAddr)], mask);
+#else
     fineGranularityMapping[hash(pAddr)] |= mask;
+#endif
   }
 
   // whole page is being altered
@@ -84,11 +99,33 @@ public:
        if (fineGranularityMapping[index] & mask) {
           // one of the CPUs might be running trace from this page
           handleSMC(pAddr, mask);
+#if BX_SUPPORT_SMP
+          BX_ATOMIC_AND32(&fineGranularityMapping[index], ~mask);
+#else
           fineGranularityMapping[index] &= ~mask;
+#endif
        }       
     }
   }
 
+  BX_CPP_INLINE void incSMCRate(bx_phy_address pAddr)
+  {
+    Bit32u index = hash(pAddr);
+    unsigned rate = smcRate[index] + BX_SMC_RATE_INC;
+    smcRate[index] = (rate > BX_SMC_RATE_MAX) ? BX_SMC_RATE_MAX : rate;
+  }
+
+  BX_CPP_INLINE void decSMCRate(bx_phy_address pAddr)
+  {
+    Bit32u index = hash(pAddr);
+    if (smcRate[index]) smcRate[index]--;
+  }
+
+  BX_CPP_INLINE bx_bool isSMCThrashing(bx_phy_address pAddr) const
+  {
+    return smcRate[hash(pAddr)] >= BX_SMC_RATE_THRESHOLD;
+  }
+
   BX_CPP_INLINE void resetWriteStamps(void);
 };
 
@@ -96,6 +133,7 @@ BX_CPP_INLINE void bxPageWriteStampTable::resetWriteStamps(void)
 {
   for (Bit32u i=0; i<PHY_MEM_PAGES; i++) {
     fineGranularityMapping[i] = 0;
+    smcRate[i] = 0;
   }
 }
 
@@ -104,6 +142,22 @@ extern bxPageWriteStampTable pageWriteStampTable;
 #define BxICacheEntries (64  * 1024)  // Must be a power of 2.
 #define BxICacheMemPool (576 * 1024)
 
+// The iCache is organized as BxICacheSets sets of BX_ICACHE_WAYS entries,
+// the least recently used entry of the set is replaced on miss.
+#define BxICacheSets (BxICacheEntries / BX_ICACHE_WAYS)
+
+// The trace memory pool is split into segments which are reclaimed one
+// by one (oldest first) instead of flushing the whole iCache when the
+// pool is exhausted.
+#define BxICacheMemPoolSegments 8
+#define BxICacheMemPoolSegmentSize (BxICacheMemPool / BxICacheMemPoolSegments)
+
+// Reverse map of the physical pages to the traces decoded from them: every
+// trace is linked into the list of the bucket of its (first) page, so SMC
+// only visits the traces of the written page.
+#define BxICachePageBuckets (4 * 1024)  // Must be a power of 2.
+#define BxICacheNoPageBucket 0xffffffff
+
 struct bxICacheEntry_c
 {
   bx_phy_address pAddr; // Physical address of the instruction
@@ -111,10 +165,39 @@ struct bxICacheEntry_c
 
   Bit32u tlen;          // Trace length in instructions
   bxInstruction_c *i;
+
+#if BX_ICACHE_WAYS > 1
+  Bit32u lruStamp;      // Time of the last access for LRU replacement
+#endif
+
+#if BX_SUPPORT_SUPERBLOCKS || BX_SUPPORT_JIT
+  Bit32u execCount;     // Number of times the trace was looked up
+#endif
+
+#if BX_SUPPORT_JIT
+  void *jitCode;        // Host code compiled for the hot trace (or NULL)
+#endif
+
+  Bit32u pageBucket;    // Reverse map bucket the entry is linked into
+  Bit32u pageNext;      // Next/previous entry in the bucket list
+  Bit32u pagePrev;      //   (entry index + 1, 0 ends the list)
 };
 
 #define BX_MAX_TRACE_LENGTH 32
 
+#if BX_SUPPORT_SUPERBLOCKS
+// A trace looked up that many times is considered hot and if it is a tight
+// loop it is rebuilt as a superblock with the loop body unrolled.
+#define BX_SUPERBLOCK_HOT_THRESHOLD 16
+#endif
+
+#if BX_SUPPORT_JIT
+// A trace looked up that many times is compiled into host code
+#define BX_JIT_HOT_THRESHOLD 32
+// Host code buffer size (per CPU), flushed completely when exhausted
+#define BX_JIT_CODE_BUFFER_SIZE (4 * 1024 * 1024)
+#endif
+
 static const bx_phy_address BX_ICACHE_INVALID_PHY_ADDRESS = bx_phy_address(-1);
 
 BX_CPP_INLINE void flushSMC(bxICacheEntry_c *e)
@@ -135,9 +218,19 @@ public:
   bxICacheEntry_c entry[BxICacheEntries];
   bxInstruction_c mpool[BxICacheMemPool];
   unsigned mpindex;
+  unsigned mpoolSegment;
+
+#if BX_ICACHE_WAYS > 1
+  Bit32u lruClock;
+#endif
 
   Bit32u traceLinkTimeStamp;
 
+#if BX_SUPPORT_JIT
+  Bit8u *jitBuffer;     // host code of the compiled traces
+  unsigned jitIndex;
+#endif
+
 #define BX_ICACHE_PAGE_SPLIT_ENTRIES 8 /* must be power of two */
   struct pageSplitEntryIndex {
     bx_phy_address ppf; // Physical address of 2nd page of the trace 
@@ -145,25 +238,91 @@ public:
   } pageSplitIndex[BX_ICACHE_PAGE_SPLIT_ENTRIES];
   int nextPageSplitIndex;
 
+  Bit32u pageBucket[BxICachePageBuckets]; // first entry index + 1, 0 if empty
+
+  // single instruction trace decoded from a SMC thrashing page, never
+  // looked up (the decoded instruction and the end-of-trace opcode)
+  bxICacheEntry_c uncachedEntry;
+  bxInstruction_c uncachedTrace[2];
+
+  // number of CPUs using the trace cache, more than one only when
+  // the CPUs are simulated round-robin by a single host thread
+  unsigned users;
+
 public:
-  bxICache_c() { flushICacheEntries(); }
+  bxICache_c(): users(1) {
+#if BX_SUPPORT_JIT
+    jitBuffer = NULL;
+    jitIndex = 0;
+#endif
+    flushICacheEntries();
+  }
 
+  // returns the set index
   BX_CPP_INLINE static unsigned hash(bx_phy_address pAddr, unsigned fetchModeMask)
   {
-//  return ((pAddr + (pAddr << 2) + (pAddr>>6)) & (BxICacheEntries-1)) ^ fetchModeMask;
-    return ((pAddr) & (BxICacheEntries-1)) ^ fetchModeMask;
+//  return ((pAddr + (pAddr << 2) + (pAddr>>6)) & (BxICacheSets-1)) ^ fetchModeMask;
+    return ((pAddr) & (BxICacheSets-1)) ^ fetchModeMask;
   }
 
-  BX_CPP_INLINE void alloc_trace(bxICacheEntry_c *e)
+  BX_CPP_INLINE bx_bool mempool_segment_full(void) const
   {
     // took +1 garbend for instruction chaining speedup (end-of-trace opcode)
-    if ((mpindex + BX_MAX_TRACE_LENGTH + 1) > BxICacheMemPool) {
-      flushICacheEntries();
+    return (mpindex + BX_MAX_TRACE_LENGTH + 1) > (mpoolSegment + 1) * BxICacheMemPoolSegmentSize;
+  }
+
+  BX_CPP_INLINE void alloc_trace(bxICacheEntry_c *e)
+  {
+    if (mempool_segment_full()) {
+      reclaimMemPoolSegment();
     }
     e->i = &mpool[mpindex];
     e->tlen = 0;
   }
 
+  void reclaimMemPoolSegment(void);
+
+  BX_CPP_INLINE static unsigned page_bucket(bx_phy_address pAddr)
+  {
+    return bxPageWriteStampTable::hash(pAddr) & (BxICachePageBuckets-1);
+  }
+
+  BX_CPP_INLINE void unlink_page(bxICacheEntry_c *e)
+  {
+    if (e->pageBucket == BxICacheNoPageBucket) return;
+
+    if (e->pagePrev)
+      entry[e->pagePrev-1].pageNext = e->pageNext;
+    else
+      pageBucket[e->pageBucket] = e->pageNext;
+    if (e->pageNext)
+      entry[e->pageNext-1].pagePrev = e->pagePrev;
+
+    e->pageBucket = BxICacheNoPageBucket;
+  }
+
+  // link the entry into the reverse map list of the page of its trace
+  BX_CPP_INLINE void link_page(bxICacheEntry_c *e)
+  {
+    unlink_page(e);
+
+    Bit32u bucket = page_bucket(e->pAddr);
+    Bit32u index = (Bit32u)(e - entry) + 1;
+    e->pageBucket = bucket;
+    e->pagePrev = 0;
+    e->pageNext = pageBucket[bucket];
+    if (e->pageNext)
+      entry[e->pageNext-1].pagePrev = index;
+    pageBucket[bucket] = index;
+  }
+
+  BX_CPP_INLINE bxICacheEntry_c* get_uncached_entry(void)
+  {
+    uncachedEntry.i = uncachedTrace;
+    uncachedEntry.tlen = 0;
+    return &uncachedEntry;
+  }
+
   BX_CPP_INLINE void commit_trace(unsigned len) { mpindex += len; }
 
   BX_CPP_INLINE void commit_page_split_trace(bx_phy_address paddr, bxICacheEntry_c *e)
@@ -184,18 +343,49 @@ public:
 
   BX_CPP_INLINE void flushICacheEntries(void);
 
+  // returns the entry to be replaced by new trace
   BX_CPP_INLINE bxICacheEntry_c* get_entry(bx_phy_address pAddr, unsigned fetchModeMask)
   {
+#if BX_ICACHE_WAYS > 1
+    bxICacheEntry_c* e = &(entry[hash(pAddr, fetchModeMask) * BX_ICACHE_WAYS]);
+    bxICacheEntry_c* victim = e;
+
+    for (unsigned n=0; n < BX_ICACHE_WAYS; n++, e++) {
+      if (e->pAddr == BX_ICACHE_INVALID_PHY_ADDRESS) {
+        victim = e;
+        break;
+      }
+      if ((Bit32u)(lruClock - e->lruStamp) > (Bit32u)(lruClock - victim->lruStamp))
+        victim = e;
+    }
+
+    victim->lruStamp = ++lruClock;
+    return victim;
+#else
     return &(entry[hash(pAddr, fetchModeMask)]);
+#endif
   }
 
   BX_CPP_INLINE bxICacheEntry_c* find_entry(bx_phy_address pAddr, unsigned fetchModeMask)
   {
+#if BX_ICACHE_WAYS > 1
+    bxICacheEntry_c* e = &(entry[hash(pAddr, fetchModeMask) * BX_ICACHE_WAYS]);
+
+    for (unsigned n=0; n < BX_ICACHE_WAYS; n++, e++) {
+      if (e->pAddr == pAddr) {
+        e->lruStamp = ++lruClock;
+        return e;
+      }
+    }
+
+    return NULL;
+#else
     bxICacheEntry_c* e = get_entry(pAddr, fetchModeMask);
     if (e->pAddr != pAddr)
        return NULL;
 
     return e;
+#endif
   }
 
   BX_CPP_INLINE bx_bool breakLinks()
@@ -217,13 +407,25 @@ BX_CPP_INLINE void bxICache_c::flushICacheEntries(void)
   for (i=0; i<BxICacheEntries; i++, e++) {
     e->pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
     e->traceMask = 0;
+#if BX_ICACHE_WAYS > 1
+    e->lruStamp = 0;
+#endif
+    e->pageBucket = BxICacheNoPageBucket;
   }
 
+  for (i=0; i<BxICachePageBuckets; i++)
+    pageBucket[i] = 0;
+
+#if BX_ICACHE_WAYS > 1
+  lruClock = 0;
+#endif
+
   nextPageSplitIndex = 0;
   for (i=0;i<BX_ICACHE_PAGE_SPLIT_ENTRIES;i++)
     pageSplitIndex[i].ppf = BX_ICACHE_INVALID_PHY_ADDRESS;
 
   mpindex = 0;
+  mpoolSegment = 0;
 
   traceLinkTimeStamp = 0;
 }
@@ -231,9 +433,7 @@ BX_CPP_INLINE void bxICache_c::flushICacheEntries(void)
 BX_CPP_INLINE void bxICache_c::handleSMC(bx_phy_address pAddr, Bit32u mask)
 {
   Bit32u pAddrIndex = bxPageWriteStampTable::hash(pAddr);
-
-  // break all links bewteen traces
-  if (breakLinks()) return;
+  bx_bool flushed = 0;
 
   // Need to invalidate all traces in the trace cache that might include an
   // instruction that was modified.  But this is not enough, it is possible
@@ -253,25 +453,95 @@ BX_CPP_INLINE void bxICache_c::handleSMC(bx_phy_address pAddr, Bit32u mask)
         if (pAddrIndex == bxPageWriteStampTable::hash(pageSplitIndex[i].ppf)) {
           pageSplitIndex[i].ppf = BX_ICACHE_INVALID_PHY_ADDRESS;
           flushSMC(pageSplitIndex[i].e);
+          flushed = 1;
         }
       }
     }
   }
 
-  bxICacheEntry_c *e = get_entry(LPFOf(pAddr), 0);
-
-  // go over 32 "cache lines" of 128 byte each
-  for (unsigned n=0; n < 32; n++) {
-    Bit32u line_mask = (1 << n);
-    if (line_mask > mask) break;
-    for (unsigned index=0; index < 128; index++, e++) {
-      if (pAddrIndex == bxPageWriteStampTable::hash(e->pAddr) && (e->traceMask & mask) != 0) {
-        flushSMC(e);
-      }
+  // visit only the traces of the written page (and the pages sharing the
+  // reverse map bucket), entries invalidated meanwhile are dropped lazily
+  Bit32u n = pageBucket[pAddrIndex & (BxICachePageBuckets-1)];
+  while (n) {
+    bxICacheEntry_c *e = &entry[n-1];
+    n = e->pageNext;
+    if (e->pAddr == BX_ICACHE_INVALID_PHY_ADDRESS) {
+      unlink_page(e);
+    }
+    else if (pAddrIndex == bxPageWriteStampTable::hash(e->pAddr) && (e->traceMask & mask) != 0) {
+      flushSMC(e);
+      unlink_page(e);
+      flushed = 1;
     }
   }
+
+  // break all links bewteen traces, not needed if no trace was invalidated
+  if (flushed) breakLinks();
 }
 
 extern void flushICaches(void);
 
+// Persistent decoded-trace cache (cpu: trace_cache=<file>).
+//
+// Decoded traces are recorded together with the code bytes they were decoded
+// from, saved into the file at exit and loaded back at the next start. On
+// iCache miss a recorded trace is used only if its code bytes match the guest
+// memory contents, so the same BIOS, boot loader and kernel code is not
+// decoded again on every boot of the same image.
+
+#define BX_TRACE_CACHE_HASH_SIZE (64 * 1024)  // Must be a power of 2.
+#define BX_TRACE_CACHE_MAX_POOL  (64 * 1024 * 1024)
+
+struct bxTraceCacheRecord_c
+{
+  Bit64u pAddr;         // Physical address of the trace
+  Bit32u fetchModeMask;
+  Bit32u codeHash;      // Hash of the code bytes
+  Bit16u tlen;          // Trace length in instructions, without end-of-trace opcode
+  Bit16u codeLen;       // Length of the code bytes
+  Bit32u next;          // Next record in hash chain (pool offset + 1), 0 if none
+
+  // the record is followed by decoded instructions and code bytes
+  BX_CPP_INLINE bxInstruction_c *instructions() { return (bxInstruction_c *)(this + 1); }
+  BX_CPP_INLINE Bit8u *code() { return (Bit8u *)(instructions() + tlen); }
+};
+
+class BOCHSAPI bxTraceCacheFile_c {
+  Bit8u *pool;
+  Bit32u poolSize;
+  Bit32u poolUsed;
+  Bit32u *hashTable;
+  Bit32u signature;     // CPU configuration the traces were decoded for
+
+  BX_CPP_INLINE static unsigned hash(bx_phy_address pAddr, unsigned fetchModeMask)
+  {
+    return ((Bit32u)(pAddr ^ (pAddr >> 16)) ^ fetchModeMask) & (BX_TRACE_CACHE_HASH_SIZE-1);
+  }
+
+  BX_CPP_INLINE bxTraceCacheRecord_c *get_record(Bit32u offset)
+  {
+    return (bxTraceCacheRecord_c *)(pool + offset - 1);
+  }
+
+  static Bit32u hashCode(const Bit8u *code, unsigned len);
+
+  bx_bool alloc_pool(Bit32u size);
+  void link_record(Bit32u offset);
+  static bx_bool valid_record(bxTraceCacheRecord_c *rec);
+
+public:
+  bxTraceCacheFile_c(): pool(NULL), poolSize(0), poolUsed(0), hashTable(NULL), signature(0) {}
+ ~bxTraceCacheFile_c() { free(pool); delete [] hashTable; }
+
+  BX_CPP_INLINE bx_bool is_enabled(void) const { return hashTable != NULL; }
+
+  void load(const char *path);
+  void save(const char *path);
+
+  bxTraceCacheRecord_c *find(bx_phy_address pAddr, unsigned fetchModeMask, const Bit8u *fetchPtr, unsigned remainingInPage);
+  void record(bx_phy_address pAddr, unsigned fetchModeMask, const bxInstruction_c *i, unsigned tlen, const Bit8u *code);
+};
+
+extern bxTraceCacheFile_c traceCacheFile;
+
 #endif
@@ -61,6 +61,7 @@ BX_CPU_C::BX_CPU_C(unsigned id): bx_cpuid(id)
 #endif
 
   stats = NULL;
+  iCache = NULL;
 
   srand(time(NULL)); // initialize random generator for RDRAND/RDSEED
 }
@@ -97,6 +98,12 @@ static bx_cpuid_t *cpuid_factory(BX_CPU_C *cpu)
 // BX_CPU_C constructor
 void BX_CPU_C::initialize(void)
 {
+#if BX_SUPPORT_FIXED_CPU_MODEL
+  bx_param_enum_c *model = SIM->get_param_enum(BXPN_CPU_MODEL);
+  if (model->get() != BX_FIXED_CPU_MODEL)
+    BX_PANIC(("Bochs is compiled for the '%s' CPU model only", model->get_choice(BX_FIXED_CPU_MODEL)));
+#endif
+
 #if BX_CPU_LEVEL >= 4
   BX_CPU_THIS_PTR cpuid = cpuid_factory(this);
   if (! BX_CPU_THIS_PTR cpuid)
@@ -114,6 +121,28 @@ void BX_CPU_C::initialize(void)
 
   init_FetchDecodeTables(); // must be called after init_isa_features_bitmask()
 
+  bx_bool shared_icache = 0;
+#if BX_SUPPORT_SMP
+  // CPUs simulated round-robin by a single host thread never execute traces
+  // concurrently, so they can share a single decoded trace cache
+  if (BX_CPU_ID > 0 && SIM->get_param_bool(BXPN_CPU_SHARED_TRACE_CACHE)->get()) {
+    if (SIM->get_param_bool(BXPN_SMP_THREADS)->get()) {
+      if (BX_CPU_ID == 1)
+        BX_ERROR(("shared_trace_cache is not supported together with smp_threads, ignored"));
+    }
+    else {
+      shared_icache = 1;
+    }
+  }
+#endif
+  if (shared_icache) {
+    BX_CPU_THIS_PTR iCache = BX_CPU(0)->iCache;
+    BX_CPU_THIS_PTR iCache->users++;
+  }
+  else {
+    BX_CPU_THIS_PTR iCache = new bxICache_c;
+  }
+
 #if BX_CPU_LEVEL >= 6
   xsave_xrestor_init();
 #endif
@@ -152,6 +181,13 @@ void BX_CPU_C::init_statistics(void)
   new bx_shadow_num_c(cpu, "iCacheLookups", &stats->iCacheLookups);
   new bx_shadow_num_c(cpu, "iCachePrefetch", &stats->iCachePrefetch);
   new bx_shadow_num_c(cpu, "iCacheMisses", &stats->iCacheMisses);
+  new bx_shadow_num_c(cpu, "iCacheTraceFileHits", &stats->iCacheTraceFileHits);
+  new bx_shadow_num_c(cpu, "iCacheEvictions", &stats->iCacheEvictions);
+  new bx_shadow_num_c(cpu, "iCacheMemPoolReclaims", &stats->iCacheMemPoolReclaims);
+  new bx_shadow_num_c(cpu, "iCacheSuperblocks", &stats->iCacheSuperblocks);
+  new bx_shadow_num_c(cpu, "iCacheJitTraces", &stats->iCacheJitTraces);
+  new bx_shadow_num_c(cpu, "iCacheDeadFlags", &stats->iCacheDeadFlags);
+  new bx_shadow_num_c(cpu, "iCacheFusedPairs", &stats->iCacheFusedPairs);
 #endif
 
 #if InstrumentTLB
@@ -161,6 +197,10 @@ void BX_CPU_C::init_statistics(void)
   new bx_shadow_num_c(cpu, "tlbMisses", &stats->tlbMisses);
   new bx_shadow_num_c(cpu, "tlbExecuteMisses", &stats->tlbExecuteMisses);
   new bx_shadow_num_c(cpu, "tlbWriteMisses", &stats->tlbWriteMisses);
+  new bx_shadow_num_c(cpu, "stlbHits", &stats->stlbHits);
+  new bx_shadow_num_c(cpu, "stlbMisses", &stats->stlbMisses);
+  new bx_shadow_num_c(cpu, "pwcHits", &stats->pwcHits);
+  new bx_shadow_num_c(cpu, "ntlbHits", &stats->ntlbHits);
 #endif
 
 #if InstrumentTLBFlush
@@ -174,6 +214,7 @@ void BX_CPU_C::init_statistics(void)
 
 #if InstrumentSMC
   new bx_shadow_num_c(cpu, "smc", &stats->smc);
+  new bx_shadow_num_c(cpu, "smcUncachedFetches", &stats->smcUncachedFetches);
 #endif
 
 #endif
@@ -674,6 +715,12 @@ BX_CPU_C::~BX_CPU_C()
   delete stats;
 #endif
 
+  // the trace cache is allocated by initialize()
+  if (BX_CPU_THIS_PTR iCache) {
+    if (--BX_CPU_THIS_PTR iCache->users == 0)
+      delete BX_CPU_THIS_PTR iCache;
+  }
+
   BX_INSTR_EXIT(BX_CPU_ID);
   BX_DEBUG(("Exit."));
 }
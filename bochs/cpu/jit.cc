@@ -0,0 +1,323 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2020  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+/////////////////////////////////////////////////////////////////////////
+
+#define NEED_CPU_REG_SHORTCUTS 1
+#include "bochs.h"
+#include "cpu.h"
+#define LOG_THIS BX_CPU_THIS_PTR
+
+#include "cpustats.h"
+
+#if BX_SUPPORT_JIT
+
+#include <sys/mman.h>
+
+//
+// Hot traces are compiled into host x86-64 code by stitching together
+// pre-built code templates and patching their immediate operands. The
+// compiled trace does exactly what the cpu_loop does for every instruction
+// of the trace: advances RIP, calls the instruction handler with constant
+// bxInstruction_c pointer (or executes native template for few simple
+// instructions) and commits the instruction. Every call site in the
+// compiled code has single target so the host branch predictor does not
+// suffer from the indirect call in the middle of the cpu_loop.
+//
+// The compiled code references the trace instructions, it becomes
+// unreachable together with its iCache entry, so self modifying code
+// invalidation (bxPageWriteStampTable::decWriteStamp -> handleSMC) and
+// iCache flushes are handled without any extra work.
+//
+
+// Max amount of host code generated for single guest instruction
+#define BX_JIT_MAX_INSTR_CODE 96
+
+// prologue: push rbx; mov rbx, imm64 (cpu)
+static const Bit8u jit_prologue[] = { 0x53, 0x48, 0xBB, 0,0,0,0,0,0,0,0 };
+#define JIT_PROLOGUE_CPU 3
+
+// epilogue: pop rbx; ret
+static const Bit8u jit_epilogue[] = { 0x5B, 0xC3 };
+
+// RIP += ilen: mov rax, imm64 (&RIP); add qword [rax], imm8
+static const Bit8u jit_advance_rip[] = {
+  0x48, 0xB8, 0,0,0,0,0,0,0,0,
+#if BX_SUPPORT_X86_64
+  0x48,
+#endif
+  0x83, 0x00, 0
+};
+#define JIT_ADVANCE_RIP_PTR   2
+#define JIT_ADVANCE_RIP_ILEN (sizeof(jit_advance_rip) - 1)
+
+// handler call: [mov rdi, rbx]; mov rdi/rsi, imm64 (i); mov rax, imm64 (handler); call rax
+static const Bit8u jit_call_handler[] = {
+#if BX_USE_CPU_SMF
+  0x48, 0xBF, 0,0,0,0,0,0,0,0,
+#else
+  0x48, 0x89, 0xDF,
+  0x48, 0xBE, 0,0,0,0,0,0,0,0,
+#endif
+  0x48, 0xB8, 0,0,0,0,0,0,0,0,
+  0xFF, 0xD0
+};
+#define JIT_CALL_HANDLER_INSTR (sizeof(jit_call_handler) - 20)
+#define JIT_CALL_HANDLER_FUNC  (sizeof(jit_call_handler) - 10)
+
+// commit: mov rdi, rbx; mov rax, imm64 (jitCommit); call rax; test eax, eax; jnz rel32 (exit)
+static const Bit8u jit_commit[] = {
+  0x48, 0x89, 0xDF,
+  0x48, 0xB8, 0,0,0,0,0,0,0,0,
+  0xFF, 0xD0,
+  0x85, 0xC0,
+  0x0F, 0x85, 0,0,0,0
+};
+#define JIT_COMMIT_FUNC 5
+#define JIT_COMMIT_EXIT (sizeof(jit_commit) - 4)
+
+// MOV r32, r32: mov rax, imm64 (&src); mov eax, [rax]; mov rcx, imm64 (&dst); mov [rcx], rax
+// MOV r64, r64: mov rax, imm64 (&src); mov rax, [rax]; mov rcx, imm64 (&dst); mov [rcx], rax
+static const Bit8u jit_mov32_reg[] = {
+  0x48, 0xB8, 0,0,0,0,0,0,0,0,
+  0x8B, 0x00,
+  0x48, 0xB9, 0,0,0,0,0,0,0,0,
+#if BX_SUPPORT_X86_64
+  0x48,
+#endif
+  0x89, 0x01
+};
+static const Bit8u jit_mov64_reg[] = {
+  0x48, 0xB8, 0,0,0,0,0,0,0,0,
+  0x48, 0x8B, 0x00,
+  0x48, 0xB9, 0,0,0,0,0,0,0,0,
+  0x48, 0x89, 0x01
+};
+#define JIT_MOV_REG_SRC    2
+#define JIT_MOV32_REG_DST 14
+#define JIT_MOV64_REG_DST 15
+
+// MOV r32, imm32: mov eax, imm32; mov rcx, imm64 (&dst); mov [rcx], rax
+// MOV r64, imm64: mov rax, imm64; mov rcx, imm64 (&dst); mov [rcx], rax
+static const Bit8u jit_mov32_imm[] = {
+  0xB8, 0,0,0,0,
+  0x48, 0xB9, 0,0,0,0,0,0,0,0,
+#if BX_SUPPORT_X86_64
+  0x48,
+#endif
+  0x89, 0x01
+};
+static const Bit8u jit_mov64_imm[] = {
+  0x48, 0xB8, 0,0,0,0,0,0,0,0,
+  0x48, 0xB9, 0,0,0,0,0,0,0,0,
+  0x48, 0x89, 0x01
+};
+#define JIT_MOV32_IMM_VAL  1
+#define JIT_MOV32_IMM_DST  7
+#define JIT_MOV64_IMM_VAL  2
+#define JIT_MOV64_IMM_DST 12
+
+class bxJitEmitter {
+  Bit8u *code;
+public:
+  bxJitEmitter(Bit8u *ptr): code(ptr) {}
+
+  Bit8u *ptr() const { return code; }
+
+  // copy the template and return pointer to the copy for patching
+  Bit8u *emit(const Bit8u *tmpl, unsigned len) {
+    Bit8u *copy = code;
+    memcpy(code, tmpl, len);
+    code += len;
+    return copy;
+  }
+
+  static void patch64(Bit8u *where, Bit64u val) { memcpy(where, &val, 8); }
+  static void patch32(Bit8u *where, Bit32u val) { memcpy(where, &val, 4); }
+};
+
+#define JIT_EMIT(e, tmpl) (e).emit((tmpl), sizeof(tmpl))
+
+// The code buffer is never writable and executable at the same time: the
+// pages the trace is emitted into are switched to read-write for the
+// compilation and back to read-execute before the trace can run.
+static bx_bool jitProtect(Bit8u *buffer, unsigned offset, unsigned len, int prot)
+{
+  static Bit32u page_size = 0;
+  if (! page_size) page_size = (Bit32u) sysconf(_SC_PAGESIZE);
+
+  Bit32u first = offset & ~(page_size - 1);
+  Bit32u last = (offset + len + page_size - 1) & ~(page_size - 1);
+  if (last > BX_JIT_CODE_BUFFER_SIZE) last = BX_JIT_CODE_BUFFER_SIZE;
+
+  return mprotect(buffer + first, last - first, prot) == 0;
+}
+
+// get host address of the instruction handler
+static void *jitHandlerAddress(BxExecutePtr_tR handler)
+{
+#if BX_USE_CPU_SMF
+  return (void *) handler;
+#else
+  // Itanium C++ ABI: member function pointer is {function address, this adjustment},
+  // the address is odd for virtual functions
+  struct { Bit64u ptr; Bit64s adj; } mfp;
+  BX_ASSERT(sizeof(mfp) == sizeof(handler));
+  memcpy(&mfp, &handler, sizeof(mfp));
+  if ((mfp.ptr & 1) != 0 || mfp.adj != 0) return NULL;
+  return (void *)(bx_ptr_equiv_t) mfp.ptr;
+#endif
+}
+
+// Instruction commit, called by the compiled trace after every instruction.
+// Mirrors the cpu_loop, returns non-zero when the trace has to be stopped.
+Bit32u BX_CPU_C::jitCommit(BX_CPU_C *cpu)
+{
+#if BX_SUPPORT_X86_64
+  cpu->prev_rip = cpu->gen_reg[BX_64BIT_REG_RIP].rrx; // commit new RIP
+#else
+  cpu->prev_rip = cpu->gen_reg[BX_32BIT_REG_EIP].dword.erx; // commit new RIP
+#endif
+  cpu->icount++;
+
+  BX_SYNC_TIME_IF_SINGLE_PROCESSOR(0);
+
+  return cpu->async_event;
+}
+
+void BX_CPU_C::jitFlush(void)
+{
+  bxICacheEntry_c *e = BX_CPU_THIS_PTR iCache->entry;
+  for (unsigned n=0; n < BxICacheEntries; n++, e++)
+    e->jitCode = NULL;
+
+  BX_CPU_THIS_PTR iCache->jitIndex = 0;
+}
+
+// Called between traces only, so none of the compiled code is executing
+void BX_CPU_C::jitCompileTrace(bxICacheEntry_c *entry)
+{
+  static bx_bool jitUnavailable = 0;
+  if (jitUnavailable) return;
+
+  // compiled code is bound to the CPU, traces shared by CPUs are interpreted
+  if (BX_CPU_THIS_PTR iCache->users > 1) return;
+
+  if (BX_CPU_THIS_PTR iCache->jitBuffer == NULL) {
+    void *buffer = mmap(NULL, BX_JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) {
+      BX_ERROR(("JIT: failed to allocate the code buffer, traces are interpreted"));
+      jitUnavailable = 1;
+      return;
+    }
+    BX_CPU_THIS_PTR iCache->jitBuffer = (Bit8u *) buffer;
+    BX_CPU_THIS_PTR iCache->jitIndex = 0;
+  }
+
+  unsigned maxCodeSize = sizeof(jit_prologue) + sizeof(jit_epilogue) + entry->tlen * BX_JIT_MAX_INSTR_CODE;
+  if (BX_CPU_THIS_PTR iCache->jitIndex + maxCodeSize > BX_JIT_CODE_BUFFER_SIZE)
+    jitFlush();
+
+  Bit8u *buffer = BX_CPU_THIS_PTR iCache->jitBuffer;
+  unsigned index = BX_CPU_THIS_PTR iCache->jitIndex;
+  if (! jitProtect(buffer, index, maxCodeSize, PROT_READ | PROT_WRITE)) {
+    BX_ERROR(("JIT: failed to make the code buffer writable, traces are interpreted"));
+    jitUnavailable = 1;
+    return;
+  }
+
+  Bit8u *start = buffer + index;
+  bxJitEmitter e(start);
+  Bit8u *exits[BX_MAX_TRACE_LENGTH];
+  unsigned nexits = 0;
+  bx_bool compiled = 1;
+
+  Bit8u *code = JIT_EMIT(e, jit_prologue);
+  bxJitEmitter::patch64(code + JIT_PROLOGUE_CPU, (Bit64u)(bx_ptr_equiv_t) BX_CPU_THIS);
+
+  bxInstruction_c *i = entry->i;
+  for (unsigned n=0; n < entry->tlen; n++, i++) {
+    code = JIT_EMIT(e, jit_advance_rip);
+    bxJitEmitter::patch64(code + JIT_ADVANCE_RIP_PTR, (Bit64u)(bx_ptr_equiv_t) &RIP);
+    code[JIT_ADVANCE_RIP_ILEN] = i->ilen();
+
+    // native templates for simple data moves between registers
+    if (i->execute1 == &BX_CPU_C::MOV_GdEdR) {
+      code = JIT_EMIT(e, jit_mov32_reg);
+      bxJitEmitter::patch64(code + JIT_MOV_REG_SRC, (Bit64u)(bx_ptr_equiv_t) &BX_CPU_THIS_PTR gen_reg[i->src()]);
+      bxJitEmitter::patch64(code + JIT_MOV32_REG_DST, (Bit64u)(bx_ptr_equiv_t) &BX_CPU_THIS_PTR gen_reg[i->dst()]);
+    }
+    else if (i->execute1 == &BX_CPU_C::MOV_EdIdR) {
+      code = JIT_EMIT(e, jit_mov32_imm);
+      bxJitEmitter::patch32(code + JIT_MOV32_IMM_VAL, i->Id());
+      bxJitEmitter::patch64(code + JIT_MOV32_IMM_DST, (Bit64u)(bx_ptr_equiv_t) &BX_CPU_THIS_PTR gen_reg[i->dst()]);
+    }
+#if BX_SUPPORT_X86_64
+    else if (i->execute1 == &BX_CPU_C::MOV_GqEqR) {
+      code = JIT_EMIT(e, jit_mov64_reg);
+      bxJitEmitter::patch64(code + JIT_MOV_REG_SRC, (Bit64u)(bx_ptr_equiv_t) &BX_CPU_THIS_PTR gen_reg[i->src()]);
+      bxJitEmitter::patch64(code + JIT_MOV64_REG_DST, (Bit64u)(bx_ptr_equiv_t) &BX_CPU_THIS_PTR gen_reg[i->dst()]);
+    }
+    else if (i->execute1 == &BX_CPU_C::MOV_EqIdR || i->execute1 == &BX_CPU_C::MOV_RRXIq) {
+      Bit64u imm = (i->execute1 == &BX_CPU_C::MOV_RRXIq) ? i->Iq() : (Bit64u)(Bit64s)(Bit32s) i->Id();
+      code = JIT_EMIT(e, jit_mov64_imm);
+      bxJitEmitter::patch64(code + JIT_MOV64_IMM_VAL, imm);
+      bxJitEmitter::patch64(code + JIT_MOV64_IMM_DST, (Bit64u)(bx_ptr_equiv_t) &BX_CPU_THIS_PTR gen_reg[i->dst()]);
+    }
+#endif
+    else {
+      void *handler = jitHandlerAddress(i->execute1);
+      if (! handler) {
+        compiled = 0; // leave the trace interpreted
+        break;
+      }
+
+      code = JIT_EMIT(e, jit_call_handler);
+      bxJitEmitter::patch64(code + JIT_CALL_HANDLER_INSTR, (Bit64u)(bx_ptr_equiv_t) i);
+      bxJitEmitter::patch64(code + JIT_CALL_HANDLER_FUNC, (Bit64u)(bx_ptr_equiv_t) handler);
+    }
+
+    code = JIT_EMIT(e, jit_commit);
+    bxJitEmitter::patch64(code + JIT_COMMIT_FUNC, (Bit64u)(bx_ptr_equiv_t) &BX_CPU_C::jitCommit);
+    exits[nexits++] = code + JIT_COMMIT_EXIT;
+  }
+
+  if (compiled) {
+    // commit of the last instruction left the stop indication in eax
+    Bit8u *exit = JIT_EMIT(e, jit_epilogue);
+    for (unsigned n=0; n < nexits; n++)
+      bxJitEmitter::patch32(exits[n], (Bit32u)(exit - (exits[n] + 4)));
+
+    BX_ASSERT(e.ptr() - start <= (int) maxCodeSize);
+  }
+
+  // the pages may hold previously compiled traces, restore them in any case
+  if (! jitProtect(buffer, index, maxCodeSize, PROT_READ | PROT_EXEC))
+    BX_PANIC(("JIT: failed to make the code buffer executable"));
+
+  if (compiled) {
+    BX_CPU_THIS_PTR iCache->jitIndex += (unsigned)(e.ptr() - start);
+    entry->jitCode = start;
+
+    INC_ICACHE_STAT(iCacheJitTraces);
+  }
+}
+
+#endif // BX_SUPPORT_JIT
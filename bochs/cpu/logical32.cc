@@ -24,12 +24,9 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::ZERO_IDIOM_GdR(bxInstruction_c *i)
-{
-  BX_WRITE_32BIT_REGZ(i->dst(), 0);
-  SET_FLAGS_OSZAPC_LOGIC_32(0);
-  BX_NEXT_INSTR(i);
-}
+#include "flags_liveness.h"
+
+BX_FLAGS_HANDLERS(BX_FORM_ZERO_IDIOM_GdR, ZERO_IDIOM_GdR, ^, SET_FLAGS_OSZAPC_XOR_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_EdGdM(bxInstruction_c *i)
 {
@@ -47,19 +44,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_EdGdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_GdEdR(bxInstruction_c *i)
-{
-  Bit32u op1_32, op2_32;
-
-  op1_32 = BX_READ_32BIT_REG(i->dst());
-  op2_32 = BX_READ_32BIT_REG(i->src());
-  op1_32 ^= op2_32;
-  BX_WRITE_32BIT_REGZ(i->dst(), op1_32);
-
-  SET_FLAGS_OSZAPC_LOGIC_32(op1_32);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_GdEdR, XOR_GdEdR, ^, SET_FLAGS_OSZAPC_XOR_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_GdEdM(bxInstruction_c *i)
 {
@@ -92,16 +77,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_EdIdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_EdIdR(bxInstruction_c *i)
-{
-  Bit32u op1_32 = BX_READ_32BIT_REG(i->dst());
-  op1_32 ^= i->Id();
-  BX_WRITE_32BIT_REGZ(i->dst(), op1_32);
-
-  SET_FLAGS_OSZAPC_LOGIC_32(op1_32);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EdIdR, XOR_EdIdR, ^, SET_FLAGS_OSZAPC_XOR_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_EdIdM(bxInstruction_c *i)
 {
@@ -118,16 +94,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_EdIdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_EdIdR(bxInstruction_c *i)
-{
-  Bit32u op1_32 = BX_READ_32BIT_REG(i->dst());
-  op1_32 |= i->Id();
-  BX_WRITE_32BIT_REGZ(i->dst(), op1_32);
-
-  SET_FLAGS_OSZAPC_LOGIC_32(op1_32);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EdIdR, OR_EdIdR, |, SET_FLAGS_OSZAPC_OR_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::NOT_EdM(bxInstruction_c *i)
 {
@@ -165,19 +132,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_EdGdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_GdEdR(bxInstruction_c *i)
-{
-  Bit32u op1_32, op2_32;
-
-  op1_32 = BX_READ_32BIT_REG(i->dst());
-  op2_32 = BX_READ_32BIT_REG(i->src());
-  op1_32 |= op2_32;
-  BX_WRITE_32BIT_REGZ(i->dst(), op1_32);
-
-  SET_FLAGS_OSZAPC_LOGIC_32(op1_32);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_GdEdR, OR_GdEdR, |, SET_FLAGS_OSZAPC_OR_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_GdEdM(bxInstruction_c *i)
 {
@@ -211,19 +166,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::AND_EdGdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::AND_GdEdR(bxInstruction_c *i)
-{
-  Bit32u op1_32, op2_32;
-
-  op1_32 = BX_READ_32BIT_REG(i->dst());
-  op2_32 = BX_READ_32BIT_REG(i->src());
-  op1_32 &= op2_32;
-  BX_WRITE_32BIT_REGZ(i->dst(), op1_32);
-
-  SET_FLAGS_OSZAPC_LOGIC_32(op1_32);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_GdEdR, AND_GdEdR, &, SET_FLAGS_OSZAPC_AND_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::AND_GdEdM(bxInstruction_c *i)
 {
@@ -256,16 +199,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::AND_EdIdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::AND_EdIdR(bxInstruction_c *i)
-{
-  Bit32u op1_32 = BX_READ_32BIT_REG(i->dst());
-  op1_32 &= i->Id();
-  BX_WRITE_32BIT_REGZ(i->dst(), op1_32);
-
-  SET_FLAGS_OSZAPC_LOGIC_32(op1_32);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EdIdR, AND_EdIdR, &, SET_FLAGS_OSZAPC_AND_32)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::TEST_EdGdR(bxInstruction_c *i)
 {
@@ -24,6 +24,8 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
+#include "flags_liveness.h"
+
 #if BX_SUPPORT_X86_64
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_EqGqM(bxInstruction_c *i)
@@ -42,20 +44,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_EqGqM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_GqEqR(bxInstruction_c *i)
-{
-  Bit64u op1_64, op2_64;
-
-  op1_64 = BX_READ_64BIT_REG(i->dst());
-  op2_64 = BX_READ_64BIT_REG(i->src());
-  op1_64 ^= op2_64;
-
-  BX_WRITE_64BIT_REG(i->dst(), op1_64);
-
-  SET_FLAGS_OSZAPC_LOGIC_64(op1_64);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_GqEqR, XOR_GqEqR, ^, SET_FLAGS_OSZAPC_XOR_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_GqEqM(bxInstruction_c *i)
 {
@@ -89,18 +78,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_EqIdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::XOR_EqIdR(bxInstruction_c *i)
-{
-  Bit64u op1_64, op2_64 = (Bit32s) i->Id();
-
-  op1_64 = BX_READ_64BIT_REG(i->dst());
-  op1_64 ^= op2_64;
-  BX_WRITE_64BIT_REG(i->dst(), op1_64);
-
-  SET_FLAGS_OSZAPC_LOGIC_64(op1_64);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EqIdR, XOR_EqIdR, ^, SET_FLAGS_OSZAPC_XOR_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_EqIdM(bxInstruction_c *i)
 {
@@ -117,18 +95,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_EqIdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_EqIdR(bxInstruction_c *i)
-{
-  Bit64u op1_64, op2_64 = (Bit32s) i->Id();
-
-  op1_64 = BX_READ_64BIT_REG(i->dst());
-  op1_64 |= op2_64;
-  BX_WRITE_64BIT_REG(i->dst(), op1_64);
-
-  SET_FLAGS_OSZAPC_LOGIC_64(op1_64);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EqIdR, OR_EqIdR, |, SET_FLAGS_OSZAPC_OR_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::NOT_EqM(bxInstruction_c *i)
 {
@@ -166,20 +133,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_EqGqM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_GqEqR(bxInstruction_c *i)
-{
-  Bit64u op1_64, op2_64;
-
-  op1_64 = BX_READ_64BIT_REG(i->dst());
-  op2_64 = BX_READ_64BIT_REG(i->src());
-  op1_64 |= op2_64;
-
-  BX_WRITE_64BIT_REG(i->dst(), op1_64);
-
-  SET_FLAGS_OSZAPC_LOGIC_64(op1_64);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_GqEqR, OR_GqEqR, |, SET_FLAGS_OSZAPC_OR_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OR_GqEqM(bxInstruction_c *i)
 {
@@ -214,20 +168,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::AND_EqGqM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::AND_GqEqR(bxInstruction_c *i)
-{
-  Bit64u op1_64, op2_64;
-
-  op1_64 = BX_READ_64BIT_REG(i->dst());
-  op2_64 = BX_READ_64BIT_REG(i->src());
-  op1_64 &= op2_64;
-
-  BX_WRITE_64BIT_REG(i->dst(), op1_64);
-
-  SET_FLAGS_OSZAPC_LOGIC_64(op1_64);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_GqEqR, AND_GqEqR, &, SET_FLAGS_OSZAPC_AND_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::AND_GqEqM(bxInstruction_c *i)
 {
@@ -261,18 +202,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::AND_EqIdM(bxInstruction_c *i)
   BX_NEXT_INSTR(i);
 }
 
-void BX_CPP_AttrRegparmN(1) BX_CPU_C::AND_EqIdR(bxInstruction_c *i)
-{
-  Bit64u op1_64, op2_64 = (Bit32s) i->Id();
-
-  op1_64 = BX_READ_64BIT_REG(i->dst());
-  op1_64 &= op2_64;
-  BX_WRITE_64BIT_REG(i->dst(), op1_64);
-
-  SET_FLAGS_OSZAPC_LOGIC_64(op1_64);
-
-  BX_NEXT_INSTR(i);
-}
+BX_FLAGS_HANDLERS(BX_FORM_EqIdR, AND_EqIdR, &, SET_FLAGS_OSZAPC_AND_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::TEST_EqGqR(bxInstruction_c *i)
 {
@@ -39,8 +39,12 @@ bx_bool BX_CPP_AttrRegparmN(2) BX_CPU_C::rdmsr(Bit32u index, Bit64u *msr)
 #if BX_CPU_LEVEL >= 6
   if (is_cpu_extension_supported(BX_ISA_X2APIC)) {
     if (is_x2apic_msr_range(index)) {
-      if (BX_CPU_THIS_PTR msr.apicbase & 0x400)  // X2APIC mode
-        return BX_CPU_THIS_PTR lapic.read_x2apic(index, msr);
+      if (BX_CPU_THIS_PTR msr.apicbase & 0x400) { // X2APIC mode
+        BX_SMP_LOCK();
+        bx_bool ok = BX_CPU_THIS_PTR lapic.read_x2apic(index, msr);
+        BX_SMP_UNLOCK();
+        return ok;
+      }
       else
         return 0;
     }
@@ -558,8 +562,12 @@ bx_bool BX_CPP_AttrRegparmN(2) BX_CPU_C::wrmsr(Bit32u index, Bit64u val_64)
 #if BX_CPU_LEVEL >= 6
   if (is_cpu_extension_supported(BX_ISA_X2APIC)) {
     if (is_x2apic_msr_range(index)) {
-      if (BX_CPU_THIS_PTR msr.apicbase & 0x400)  // X2APIC mode
-        return BX_CPU_THIS_PTR lapic.write_x2apic(index, val32_hi, val32_lo);
+      if (BX_CPU_THIS_PTR msr.apicbase & 0x400) { // X2APIC mode
+        BX_SMP_LOCK();
+        bx_bool ok = BX_CPU_THIS_PTR lapic.write_x2apic(index, val32_hi, val32_lo);
+        BX_SMP_UNLOCK();
+        return ok;
+      }
       else
         return 0;
     }
@@ -1123,6 +1131,8 @@ bx_bool BX_CPU_C::relocate_apic(Bit64u val_64)
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::WRMSR(bxInstruction_c *i)
 {
+  BX_SMP_DRAIN_SMC(BX_CPU_ID);
+
 #if BX_CPU_LEVEL >= 5
   // CPL is always 0 in real mode
   if (/* !real_mode() && */ CPL!=0) {
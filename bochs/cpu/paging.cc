@@ -387,6 +387,13 @@ void BX_CPU_C::TLB_flush(void)
 
   BX_CPU_THIS_PTR DTLB.flush();
   BX_CPU_THIS_PTR ITLB.flush();
+  BX_CPU_THIS_PTR STLB.flush();
+#if BX_CPU_LEVEL >= 6
+  BX_CPU_THIS_PTR PWC.flush();
+#endif
+#if BX_SUPPORT_VMX >= 2 || BX_SUPPORT_SVM
+  BX_CPU_THIS_PTR NTLB.flush();
+#endif
 
 #if BX_SUPPORT_MONITOR_MWAIT
   // invalidating of the TLB might change translation for monitored page
@@ -395,7 +402,29 @@ void BX_CPU_C::TLB_flush(void)
 #endif
 
   // break all links bewteen traces
-  BX_CPU_THIS_PTR iCache.breakLinks();
+  BX_CPU_THIS_PTR iCache->breakLinks();
+}
+
+// The memory restarted the dirty page tracking: writes through the cached
+// host pointers have to take a write translation again to mark the page.
+void BX_CPU_C::TLB_writeProtect(void)
+{
+  invalidate_stack_cache();
+
+  for (unsigned tlb_entry_num=0; tlb_entry_num < BX_DTLB_SIZE; tlb_entry_num++) {
+    BX_CPU_THIS_PTR DTLB.entry[tlb_entry_num].accessBits &= ~(TLB_SysWriteOK | TLB_UserWriteOK |
+        TLB_SysWriteShadowStackOK | TLB_UserWriteShadowStackOK);
+  }
+
+  // the VMCS and VMCB are written through the host pointer directly
+#if BX_SUPPORT_VMX
+  if (BX_CPU_THIS_PTR vmcshostptr)
+    BX_MEM(0)->set_dirty_page(A20ADDR(BX_CPU_THIS_PTR vmcsptr));
+#endif
+#if BX_SUPPORT_SVM
+  if (BX_CPU_THIS_PTR vmcbhostptr)
+    BX_MEM(0)->set_dirty_page(A20ADDR(BX_CPU_THIS_PTR vmcbptr));
+#endif
 }
 
 #if BX_CPU_LEVEL >= 6
@@ -408,6 +437,42 @@ void BX_CPU_C::TLB_flushNonGlobal(void)
 
   BX_CPU_THIS_PTR DTLB.flushNonGlobal();
   BX_CPU_THIS_PTR ITLB.flushNonGlobal();
+  BX_CPU_THIS_PTR STLB.flushNonGlobal();
+#if BX_CPU_LEVEL >= 6
+  BX_CPU_THIS_PTR PWC.flush();
+#endif
+#if BX_SUPPORT_VMX >= 2 || BX_SUPPORT_SVM
+  BX_CPU_THIS_PTR NTLB.flush();
+#endif
+
+#if BX_SUPPORT_MONITOR_MWAIT
+  // invalidating of the TLB might change translation for monitored page
+  // and cause subsequent MWAIT instruction to wait forever
+  BX_CPU_THIS_PTR monitor.reset_monitor();
+#endif
+
+  // break all links bewteen traces
+  BX_CPU_THIS_PTR iCache->breakLinks();
+}
+#endif
+
+#if BX_CPU_LEVEL >= 6
+// Address space switch (MOV CR3). The first level TLBs are not tagged and
+// lose all non-global translations, the second level TLB keeps translations
+// tagged with other PCIDs and VPIDs and also translations of the new PCID
+// unless the invalidation is requested.
+void BX_CPU_C::TLB_flushASID(bx_bool invalidate)
+{
+  INC_TLBFLUSH_STAT(tlbNonGlobalFlushes);
+
+  invalidate_prefetch_q();
+  invalidate_stack_cache();
+
+  BX_CPU_THIS_PTR DTLB.flushNonGlobal();
+  BX_CPU_THIS_PTR ITLB.flushNonGlobal();
+  if (invalidate)
+    BX_CPU_THIS_PTR STLB.flushASID(tlb_asid());
+  BX_CPU_THIS_PTR PWC.flush();
 
 #if BX_SUPPORT_MONITOR_MWAIT
   // invalidating of the TLB might change translation for monitored page
@@ -416,7 +481,34 @@ void BX_CPU_C::TLB_flushNonGlobal(void)
 #endif
 
   // break all links bewteen traces
-  BX_CPU_THIS_PTR iCache.breakLinks();
+  BX_CPU_THIS_PTR iCache->breakLinks();
+}
+#endif
+
+#if BX_SUPPORT_VMX >= 2
+// VM entry and VM exit. Translations of the guest and the host are tagged
+// with VPID in the second level TLB, translations tagged with VPID 0 are
+// invalidated when VPID is not enabled.
+void BX_CPU_C::TLB_flushVPID(bx_bool invalidate)
+{
+  INC_TLBFLUSH_STAT(tlbGlobalFlushes);
+
+  invalidate_prefetch_q();
+  invalidate_stack_cache();
+
+  BX_CPU_THIS_PTR DTLB.flush();
+  BX_CPU_THIS_PTR ITLB.flush();
+  if (invalidate)
+    BX_CPU_THIS_PTR STLB.flushVPID(0);
+  BX_CPU_THIS_PTR PWC.flush();
+  BX_CPU_THIS_PTR NTLB.flush();
+
+#if BX_SUPPORT_MONITOR_MWAIT
+  BX_CPU_THIS_PTR monitor.reset_monitor();
+#endif
+
+  // break all links bewteen traces
+  BX_CPU_THIS_PTR iCache->breakLinks();
 }
 #endif
 
@@ -428,6 +520,11 @@ void BX_CPU_C::TLB_invlpg(bx_address laddr)
   BX_DEBUG(("TLB_invlpg(0x" FMT_ADDRX "): invalidate TLB entry", laddr));
   BX_CPU_THIS_PTR DTLB.invlpg(laddr);
   BX_CPU_THIS_PTR ITLB.invlpg(laddr);
+  BX_CPU_THIS_PTR STLB.invlpg(laddr);
+#if BX_CPU_LEVEL >= 6
+  // INVLPG invalidates all the paging structure cache entries
+  BX_CPU_THIS_PTR PWC.flush();
+#endif
 
 #if BX_SUPPORT_MONITOR_MWAIT
   // invalidating of the TLB entry might change translation for monitored
@@ -436,7 +533,7 @@ void BX_CPU_C::TLB_invlpg(bx_address laddr)
 #endif
 
   // break all links bewteen traces
-  BX_CPU_THIS_PTR iCache.breakLinks();
+  BX_CPU_THIS_PTR iCache->breakLinks();
 }
 
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INVLPG(bxInstruction_c* i)
@@ -515,6 +612,13 @@ void BX_CPU_C::page_fault(unsigned fault, bx_address laddr, unsigned user, unsig
 
   BX_CPU_THIS_PTR cr2 = laddr;
 
+#if BX_CPU_LEVEL >= 6
+  // page fault invalidates paging structure cache entries used for the
+  // faulting address so the fault handler fixing the paging structures
+  // does not have to invalidate them
+  BX_CPU_THIS_PTR PWC.invlpg(laddr);
+#endif
+
 #if BX_SUPPORT_X86_64
   BX_DEBUG(("page fault for address %08x%08x @ %08x%08x",
              GET32H(laddr), GET32L(laddr), GET32H(RIP), GET32L(RIP)));
@@ -676,6 +780,51 @@ BX_CPP_INLINE Bit32u calculate_pat(Bit32u entry, Bit32u lpf_mask)
 }
 #endif
 
+// Look for the lowest level paging structure entry used for translation of
+// the linear address in the paging structure cache. Returns the level the
+// page walk should continue from, max_level if nothing was found.
+int BX_CPU_C::pwc_lookup(bx_address laddr, int max_level, unsigned rw, Bit64u *entry, Bit64u &curr_entry, Bit32u &combined_access, bx_bool &nx, bx_bool &nx_fault)
+{
+  for (int level = BX_LEVEL_PDE; level <= max_level; level++) {
+    bx_PWC_entry *pwc = BX_CPU_THIS_PTR PWC.lookup(laddr, level);
+    if (! pwc) continue;
+
+    // XD bit is reserved when EFER.NXE=0, re-walk to report the fault
+    if (pwc->nx && ! BX_CPU_THIS_PTR efer.get_NXE())
+      break;
+
+    INC_TLB_STAT(pwcHits);
+
+    // accessed bits of the cached entries were already set when the
+    // entries were put into the cache
+    entry[level] = pwc->entry;
+    for (int n = level + 1; n <= max_level; n++)
+      entry[n] = 0x20;
+
+    curr_entry = pwc->entry;
+    combined_access = pwc->combined_access;
+    nx = pwc->nx;
+    if (nx && rw == BX_EXECUTE)
+      nx_fault = 1;
+
+    return level - 1;
+  }
+
+  return max_level;
+}
+
+// Put the non-leaf paging structure entries read during the page walk
+// into the paging structure cache
+void BX_CPU_C::pwc_fill(bx_address laddr, int start, int leaf, const Bit64u *entry, const Bit32u *level_access, const bx_bool *level_nx)
+{
+  for (int level = start; level > leaf; level--) {
+    bx_PWC_entry *pwc = BX_CPU_THIS_PTR PWC.alloc(laddr, level);
+    pwc->entry = entry[level];
+    pwc->combined_access = level_access[level];
+    pwc->nx = level_nx[level];
+  }
+}
+
 #if BX_SUPPORT_X86_64
 
 // Translate a linear address to a physical address in long mode
@@ -699,7 +848,17 @@ bx_phy_address BX_CPU_C::translate_linear_long_mode(bx_address laddr, Bit32u &lp
   if (! BX_CPU_THIS_PTR efer.get_NXE())
     reserved |= PAGE_DIRECTORY_NX_BIT;
 
-  for (leaf = BX_LEVEL_PML4;; --leaf) {
+  // access rights accumulated down to every walked level, used to fill
+  // the paging structure cache when the translation completes
+  Bit32u level_access[4];
+  bx_bool level_nx[4], nx = 0;
+  int start = pwc_lookup(laddr, BX_LEVEL_PML4, rw, entry, curr_entry, combined_access, nx, nx_fault);
+  if (start < BX_LEVEL_PML4) {
+    ppf = curr_entry & BX_CONST64(0x000ffffffffff000);
+    offset_mask >>= 9 * (BX_LEVEL_PML4 - start);
+  }
+
+  for (leaf = start;; --leaf) {
     entry_addr[leaf] = ppf + ((laddr >> (9 + 9*leaf)) & 0xff8);
 #if BX_SUPPORT_VMX >= 2
     if (BX_CPU_THIS_PTR in_vmx_guest) {
@@ -747,6 +906,9 @@ bx_phy_address BX_CPU_C::translate_linear_long_mode(bx_address laddr, Bit32u &lp
     }
 
     combined_access &= curr_entry; // U/S and R/W
+    nx |= (curr_entry & PAGE_DIRECTORY_NX_BIT) != 0;
+    level_access[leaf] = combined_access;
+    level_nx[leaf] = nx;
   }
 
   bx_bool isWrite = (rw & 1); // write or r-m-w
@@ -828,6 +990,8 @@ bx_phy_address BX_CPU_C::translate_linear_long_mode(bx_address laddr, Bit32u &lp
   // Update A/D bits if needed
   update_access_dirty_PAE(entry_addr, entry, entry_memtype, BX_LEVEL_PML4, leaf, isWrite);
 
+  pwc_fill(laddr, start, leaf, entry, level_access, level_nx);
+
   return (ppf | combined_access);
 }
 
@@ -971,11 +1135,18 @@ bx_phy_address BX_CPU_C::translate_linear_PAE(bx_address laddr, Bit32u &lpf_mask
   if (! BX_CPU_THIS_PTR efer.get_NXE())
     reserved |= PAGE_DIRECTORY_NX_BIT;
 
-  Bit64u pdpte = translate_linear_load_PDPTR(laddr, user, rw);
-  bx_phy_address ppf = pdpte & BX_CONST64(0x000ffffffffff000);
-  Bit64u curr_entry = pdpte;
+  // access rights accumulated down to every walked level, used to fill
+  // the paging structure cache when the translation completes
+  Bit32u level_access[2];
+  bx_bool level_nx[2], nx = 0;
+  Bit64u curr_entry;
+  int start = pwc_lookup(laddr, BX_LEVEL_PDE, rw, entry, curr_entry, combined_access, nx, nx_fault);
+  if (start == BX_LEVEL_PDE)
+    curr_entry = translate_linear_load_PDPTR(laddr, user, rw);
 
-  for (leaf = BX_LEVEL_PDE;; --leaf) {
+  bx_phy_address ppf = curr_entry & BX_CONST64(0x000ffffffffff000);
+
+  for (leaf = start;; --leaf) {
     entry_addr[leaf] = ppf + ((laddr >> (9 + 9*leaf)) & 0xff8);
 #if BX_SUPPORT_VMX >= 2
     if (BX_CPU_THIS_PTR in_vmx_guest) {
@@ -1018,6 +1189,9 @@ bx_phy_address BX_CPU_C::translate_linear_PAE(bx_address laddr, Bit32u &lpf_mask
     }
 
     combined_access &= curr_entry; // U/S and R/W
+    nx |= (curr_entry & PAGE_DIRECTORY_NX_BIT) != 0;
+    level_access[leaf] = combined_access;
+    level_nx[leaf] = nx;
   }
 
   bx_bool isWrite = (rw & 1); // write or r-m-w
@@ -1075,6 +1249,8 @@ bx_phy_address BX_CPU_C::translate_linear_PAE(bx_address laddr, Bit32u &lpf_mask
   // Update A/D bits if needed
   update_access_dirty_PAE(entry_addr, entry, entry_memtype, BX_LEVEL_PDE, leaf, isWrite);
 
+  pwc_fill(laddr, start, leaf, entry, level_access, level_nx);
+
   return (ppf | combined_access);
 }
 
@@ -1309,6 +1485,65 @@ bx_phy_address BX_CPU_C::translate_linear(bx_TLB_entry *tlbEntry, bx_address lad
   Bit32u pkey = 0;
 #endif
 
+  // The STLB keeps translations defined by the guest page tables only,
+  // translations involving EPT or nested paging always take the page walk
+  bx_bool useSTLB = BX_CPU_THIS_PTR cr0.get_PG()
+#if BX_SUPPORT_VMX >= 2
+        && ! (BX_CPU_THIS_PTR in_vmx_guest && SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_EPT_ENABLE))
+#endif
+#if BX_SUPPORT_SVM
+        && ! (BX_CPU_THIS_PTR in_svm_guest && SVM_NESTED_PAGING_ENABLED)
+#endif
+    ;
+
+  if (useSTLB) {
+    bx_STLB_entry *stlbEntry = BX_CPU_THIS_PTR STLB.lookup(laddr, isExecute, tlb_asid());
+    if (stlbEntry) {
+      // the access must be allowed by the cached entry, otherwise re-walk
+      // the page tables to update accessed/dirty bits or raise the fault
+      Bit32u accessOK;
+      if (isExecute)
+        accessOK = stlbEntry->accessBits & (1 << user);
+      else {
+        accessOK = stlbEntry->accessBits & (1 << (isShadowStack | (isWrite<<1) | user));
+#if BX_SUPPORT_PKEYS
+        accessOK &= isWrite ? BX_CPU_THIS_PTR wr_pkey[stlbEntry->pkey] : BX_CPU_THIS_PTR rd_pkey[stlbEntry->pkey];
+#endif
+      }
+
+      if (accessOK) {
+        INC_TLB_STAT(stlbHits);
+
+        lpf_mask = stlbEntry->lpf_mask;
+        paddress = A20ADDR(stlbEntry->ppf | (laddr & lpf_mask));
+        ppf = PPFOf(paddress);
+
+        tlbEntry->lpf = lpf | TLB_NoHostPtr;
+        tlbEntry->lpf_mask = lpf_mask;
+#if BX_SUPPORT_PKEYS
+        tlbEntry->pkey = stlbEntry->pkey;
+#endif
+        tlbEntry->ppf = ppf;
+        tlbEntry->accessBits = stlbEntry->accessBits;
+#if BX_SUPPORT_MEMTYPE
+        combined_access = stlbEntry->pat_memtype << 9;
+#endif
+
+#if BX_CPU_LEVEL >= 5
+        if (lpf_mask > 0xfff) {
+          if (isExecute)
+            BX_CPU_THIS_PTR ITLB.split_large = true;
+          else
+            BX_CPU_THIS_PTR DTLB.split_large = true;
+        }
+#endif
+        goto set_host_ptr;
+      }
+    }
+
+    INC_TLB_STAT(stlbMisses);
+  }
+
   if(BX_CPU_THIS_PTR cr0.get_PG())
   {
     BX_DEBUG(("page walk for%s address 0x" FMT_LIN_ADDRX, isShadowStack ? " shadow stack" : "", laddr));
@@ -1452,11 +1687,30 @@ bx_phy_address BX_CPU_C::translate_linear(bx_TLB_entry *tlbEntry, bx_address lad
     tlbEntry->accessBits |= TLB_GlobalPage;
 #endif
 
+  if (useSTLB) {
+    bx_STLB_entry *stlbEntry = BX_CPU_THIS_PTR STLB.alloc(laddr, lpf_mask, isExecute, tlb_asid());
+    stlbEntry->ppf = paddress & ~((bx_phy_address) lpf_mask);
+    stlbEntry->accessBits = tlbEntry->accessBits;
+#if BX_SUPPORT_PKEYS
+    stlbEntry->pkey = pkey;
+#endif
+#if BX_SUPPORT_MEMTYPE
+    stlbEntry->pat_memtype = combined_access >> 9;
+#endif
+  }
+
+set_host_ptr:
   // Attempt to get a host pointer to this physical page. Put that
   // pointer in the TLB cache. Note if the request is vetoed, NULL
   // will be returned, and it's OK to OR zero in anyways.
   tlbEntry->hostPageAddr = BX_CPU_THIS_PTR getHostMemAddr(ppf, rw);
   if (tlbEntry->hostPageAddr) {
+    // The host pointer was obtained for a read, the write access cached in
+    // the STLB must not bypass the memory: the first write takes the write
+    // translation which vetoes ROM and tracks the dirty pages.
+    if (! isWrite)
+      tlbEntry->accessBits &= ~(TLB_SysWriteOK | TLB_UserWriteOK |
+          TLB_SysWriteShadowStackOK | TLB_UserWriteShadowStackOK);
     // All access allowed also via direct pointer
 #if BX_X86_DEBUGGER
     if (! hwbreakpoint_check(laddr, BX_HWDebugMemW, BX_HWDebugMemRW))
@@ -1813,14 +2067,31 @@ bx_phy_address BX_CPU_C::nested_walk(bx_phy_address guest_paddr, unsigned rw, bx
 {
   SVM_HOST_STATE *host_state = &BX_CPU_THIS_PTR vmcb.host_state;
 
+  // once translated for the same kind of access the nested page walk has
+  // no side effects anymore
+  if (is_page_walk) {
+    bx_NTLB_entry *ntlb = BX_CPU_THIS_PTR NTLB.lookup(guest_paddr, rw);
+    if (ntlb) {
+      INC_TLB_STAT(ntlbHits);
+      return ntlb->hpf | PAGE_OFFSET(guest_paddr);
+    }
+  }
+
   BX_DEBUG(("Nested walk for guest paddr 0x" FMT_PHY_ADDRX, guest_paddr));
 
+  bx_phy_address paddr;
+
   if (host_state->efer.get_LMA())
-    return nested_walk_long_mode(guest_paddr, rw, is_page_walk);
+    paddr = nested_walk_long_mode(guest_paddr, rw, is_page_walk);
   else if (host_state->cr4.get_PAE())
-    return nested_walk_PAE(guest_paddr, rw, is_page_walk);
+    paddr = nested_walk_PAE(guest_paddr, rw, is_page_walk);
   else
-    return nested_walk_legacy(guest_paddr, rw, is_page_walk);
+    paddr = nested_walk_legacy(guest_paddr, rw, is_page_walk);
+
+  if (is_page_walk)
+    BX_CPU_THIS_PTR NTLB.insert(guest_paddr, paddr, rw);
+
+  return paddr;
 }
 
 #endif
@@ -1889,6 +2160,18 @@ bx_phy_address BX_CPU_C::translate_guest_physical(bx_phy_address guest_paddr, bx
   Bit32u combined_access = 0x7, access_mask = 0;
   Bit64u offset_mask = BX_CONST64(0x0000ffffffffffff);
 
+  // translations of the guest paging structures accesses done on behalf
+  // of a linear address translation are kept in the nested TLB, they have
+  // no side effects once the EPT accessed and dirty bits are updated
+  bx_bool use_ntlb = is_page_walk && guest_laddr_valid && ! SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_PML_ENABLE);
+  if (use_ntlb) {
+    bx_NTLB_entry *ntlb = BX_CPU_THIS_PTR NTLB.lookup(guest_paddr, rw);
+    if (ntlb) {
+      INC_TLB_STAT(ntlbHits);
+      return ntlb->hpf | PAGE_OFFSET(guest_paddr);
+    }
+  }
+
   BX_DEBUG(("EPT walk for guest paddr 0x" FMT_PHY_ADDRX, guest_paddr));
 
   // when EPT A/D enabled treat guest page table accesses as writes
@@ -2045,6 +2328,10 @@ bx_phy_address BX_CPU_C::translate_guest_physical(bx_phy_address guest_paddr, bx
     update_ept_access_dirty(entry_addr, entry, MEMTYPE(eptptr_memtype), leaf, rw & 1);
   }
 
+  // rw is the access the permissions and the EPT dirty bit were handled for
+  if (use_ntlb)
+    BX_CPU_THIS_PTR NTLB.insert(guest_paddr, ppf, rw);
+
   Bit32u page_offset = PAGE_OFFSET(guest_paddr);
   return ppf | page_offset;
 }
@@ -2580,9 +2867,12 @@ int BX_CPU_C::access_read_linear(bx_address laddr, unsigned len, unsigned curr_p
 
 void BX_CPU_C::access_write_physical(bx_phy_address paddr, unsigned len, void *data)
 {
+  BX_SMP_LOCK();
+
 #if BX_SUPPORT_VMX && BX_SUPPORT_X86_64
   if (is_virtual_apic_page(paddr)) {
     VMX_Virtual_Apic_Write(paddr, len, data);
+    BX_SMP_UNLOCK();
     return;
   }
 #endif
@@ -2590,15 +2880,20 @@ void BX_CPU_C::access_write_physical(bx_phy_address paddr, unsigned len, void *d
 #if BX_SUPPORT_APIC
   if (BX_CPU_THIS_PTR lapic.is_selected(paddr)) {
     BX_CPU_THIS_PTR lapic.write(paddr, data, len);
+    BX_SMP_UNLOCK();
     return;
   }
 #endif
 
   BX_MEM(0)->writePhysicalPage(BX_CPU_THIS, paddr, len, data);
+
+  BX_SMP_UNLOCK();
 }
 
 void BX_CPU_C::access_read_physical(bx_phy_address paddr, unsigned len, void *data)
 {
+  BX_SMP_LOCK();
+
 #if BX_SUPPORT_VMX && BX_SUPPORT_X86_64
   if (is_virtual_apic_page(paddr)) {
     paddr = VMX_Virtual_Apic_Read(paddr, len, data);
@@ -2608,11 +2903,14 @@ void BX_CPU_C::access_read_physical(bx_phy_address paddr, unsigned len, void *da
 #if BX_SUPPORT_APIC
   if (BX_CPU_THIS_PTR lapic.is_selected(paddr)) {
     BX_CPU_THIS_PTR lapic.read(paddr, data, len);
+    BX_SMP_UNLOCK();
     return;
   }
 #endif
 
   BX_MEM(0)->readPhysicalPage(BX_CPU_THIS, paddr, len, data);
+
+  BX_SMP_UNLOCK();
 }
 
 bx_hostpageaddr_t BX_CPU_C::getHostMemAddr(bx_phy_address paddr, unsigned rw)
@@ -2627,7 +2925,11 @@ bx_hostpageaddr_t BX_CPU_C::getHostMemAddr(bx_phy_address paddr, unsigned rw)
     return 0; // Vetoed!  APIC address space
 #endif
 
-  return (bx_hostpageaddr_t) BX_MEM(0)->getHostMemAddr(BX_CPU_THIS, paddr, rw);
+  BX_SMP_LOCK();
+  bx_hostpageaddr_t hostAddr = (bx_hostpageaddr_t) BX_MEM(0)->getHostMemAddr(BX_CPU_THIS, paddr, rw);
+  BX_SMP_UNLOCK();
+
+  return hostAddr;
 }
 
 #if BX_LARGE_RAMFILE
@@ -24,54 +24,80 @@
 #ifndef BX_SIMD_INT_COMPARE_FUNCTIONS_H
 #define BX_SIMD_INT_COMPARE_FUNCTIONS_H
 
+#include "simd_host.h"
+
 // compare less than (signed)
 
 BX_CPP_INLINE void xmm_pcmpltb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmplt_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmubyte(n) = (op1->xmmsbyte(n) < op2->xmmsbyte(n)) ? 0xff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpltb_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  return (Bit32u) _mm_movemask_epi8(_mm_cmplt_epi8(xmm_host_load(op1), xmm_host_load(op2)));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<16; n++) {
     if (op1->xmmsbyte(n) < op2->xmmsbyte(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 BX_CPP_INLINE void xmm_pcmpltw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmplt_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) = (op1->xmm16s(n) < op2->xmm16s(n)) ? 0xffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpltw_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  return (Bit32u) _mm_movemask_epi8(_mm_packs_epi16(_mm_cmplt_epi16(xmm_host_load(op1), xmm_host_load(op2)), _mm_setzero_si128()));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<8; n++) {
     if (op1->xmm16s(n) < op2->xmm16s(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 BX_CPP_INLINE void xmm_pcmpltd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmplt_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     op1->xmm32u(n) = (op1->xmm32s(n) < op2->xmm32s(n)) ? 0xffffffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpltd_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  return (Bit32u) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(xmm_host_load(op1), xmm_host_load(op2))));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<4; n++) {
     if (op1->xmm32s(n) < op2->xmm32s(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 BX_CPP_INLINE void xmm_pcmpltq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
@@ -292,66 +318,98 @@ BX_CPP_INLINE Bit32u xmm_pcmpleuq_mask(const BxPackedXmmRegister *op1, const BxP
 
 BX_CPP_INLINE void xmm_pcmpgtb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmpgt_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmubyte(n) = (op1->xmmsbyte(n) > op2->xmmsbyte(n)) ? 0xff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpgtb_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  return (Bit32u) _mm_movemask_epi8(_mm_cmpgt_epi8(xmm_host_load(op1), xmm_host_load(op2)));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<16; n++) {
     if (op1->xmmsbyte(n) > op2->xmmsbyte(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 BX_CPP_INLINE void xmm_pcmpgtw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmpgt_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) = (op1->xmm16s(n) > op2->xmm16s(n)) ? 0xffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpgtw_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  return (Bit32u) _mm_movemask_epi8(_mm_packs_epi16(_mm_cmpgt_epi16(xmm_host_load(op1), xmm_host_load(op2)), _mm_setzero_si128()));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<8; n++) {
     if (op1->xmm16s(n) > op2->xmm16s(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 BX_CPP_INLINE void xmm_pcmpgtd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmpgt_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     op1->xmm32u(n) = (op1->xmm32s(n) > op2->xmm32s(n)) ? 0xffffffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpgtd_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  return (Bit32u) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(xmm_host_load(op1), xmm_host_load(op2))));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<4; n++) {
     if (op1->xmm32s(n) > op2->xmm32s(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 BX_CPP_INLINE void xmm_pcmpgtq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_2
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmpgt_epi64);
+#else
   for(unsigned n=0; n<2; n++) {
     op1->xmm64u(n) = (op1->xmm64s(n) > op2->xmm64s(n)) ? BX_CONST64(0xffffffffffffffff) : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpgtq_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_2
+  return (Bit32u) _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(xmm_host_load(op1), xmm_host_load(op2))));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<2; n++) {
     if (op1->xmm64s(n) > op2->xmm64s(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 // compare greater than (unsigned)
@@ -556,66 +614,98 @@ BX_CPP_INLINE Bit32u xmm_pcmpgeuq_mask(const BxPackedXmmRegister *op1, const BxP
 
 BX_CPP_INLINE void xmm_pcmpeqb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmpeq_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmubyte(n) = (op1->xmmubyte(n) == op2->xmmubyte(n)) ? 0xff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpeqb_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  return (Bit32u) _mm_movemask_epi8(_mm_cmpeq_epi8(xmm_host_load(op1), xmm_host_load(op2)));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<16; n++) {
     if (op1->xmmubyte(n) == op2->xmmubyte(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 BX_CPP_INLINE void xmm_pcmpeqw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmpeq_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) = (op1->xmm16u(n) == op2->xmm16u(n)) ? 0xffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpeqw_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  return (Bit32u) _mm_movemask_epi8(_mm_packs_epi16(_mm_cmpeq_epi16(xmm_host_load(op1), xmm_host_load(op2)), _mm_setzero_si128()));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<8; n++) {
     if (op1->xmm16u(n) == op2->xmm16u(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 BX_CPP_INLINE void xmm_pcmpeqd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmpeq_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     op1->xmm32u(n) = (op1->xmm32u(n) == op2->xmm32u(n)) ? 0xffffffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpeqd_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  return (Bit32u) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(xmm_host_load(op1), xmm_host_load(op2))));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<4; n++) {
     if (op1->xmm32u(n) == op2->xmm32u(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 BX_CPP_INLINE void xmm_pcmpeqq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  BX_HOST_SIMD_2OP(op1, op2, _mm_cmpeq_epi64);
+#else
   for(unsigned n=0; n<2; n++) {
     op1->xmm64u(n) = (op1->xmm64u(n) == op2->xmm64u(n)) ? BX_CONST64(0xffffffffffffffff) : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE Bit32u xmm_pcmpeqq_mask(const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  return (Bit32u) _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(xmm_host_load(op1), xmm_host_load(op2))));
+#else
   Bit32u mask = 0;
   for(unsigned n=0; n<2; n++) {
     if (op1->xmm64u(n) == op2->xmm64u(n)) mask |= (1 << n);
   }
   return mask;
+#endif
 }
 
 // compare not equal
@@ -0,0 +1,81 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2020  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BX_SIMD_HOST_H
+#define BX_SIMD_HOST_H
+
+// Host SIMD backend of the packed integer helpers (simd_int.h and
+// simd_compare.h). The instruction set extensions are selected at compile
+// time from the compiler target (e.g. CXXFLAGS=-march=native), helpers
+// without a host implementation use the generic per-lane code.
+
+#define BX_HOST_SSE2   0
+#define BX_HOST_SSSE3  0
+#define BX_HOST_SSE4_1 0
+#define BX_HOST_SSE4_2 0
+
+#if BX_SUPPORT_HOST_SIMD && defined(__SSE2__) && !defined(BX_BIG_ENDIAN)
+
+#undef  BX_HOST_SSE2
+#define BX_HOST_SSE2 1
+#include <emmintrin.h>
+
+#if defined(__SSSE3__)
+#undef  BX_HOST_SSSE3
+#define BX_HOST_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+#if defined(__SSE4_1__)
+#undef  BX_HOST_SSE4_1
+#define BX_HOST_SSE4_1 1
+#include <smmintrin.h>
+#endif
+
+#if defined(__SSE4_2__)
+#undef  BX_HOST_SSE4_2
+#define BX_HOST_SSE4_2 1
+#include <nmmintrin.h>
+#endif
+
+BX_CPP_INLINE __m128i xmm_host_load(const BxPackedXmmRegister *op)
+{
+  return _mm_loadu_si128((const __m128i *) op);
+}
+
+BX_CPP_INLINE void xmm_host_store(BxPackedXmmRegister *op, __m128i val)
+{
+  _mm_storeu_si128((__m128i *) op, val);
+}
+
+BX_CPP_INLINE __m128i xmm_host_shift_count(Bit64u shift_64)
+{
+  return _mm_set_epi64x(0, (long long) shift_64);
+}
+
+// op1 = f(op1, op2) using host intrinsic
+#define BX_HOST_SIMD_2OP(op1, op2, func) \
+  xmm_host_store((op1), func(xmm_host_load(op1), xmm_host_load(op2)))
+
+#endif // BX_SUPPORT_HOST_SIMD
+
+#endif
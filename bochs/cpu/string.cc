@@ -124,7 +124,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB16_YbXb(bxInstruction_c *i)
 // 32 bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB32_YbXb(bxInstruction_c *i)
 {
-  Bit32s increment = 0;
+  Bit64s increment = 0;
 
 #if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
   /* If conditions are right, we can transfer IO to physical memory
@@ -156,15 +156,15 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB32_YbXb(bxInstruction_c *i)
     increment = BX_CPU_THIS_PTR get_DF() ? -1 : 1;
   }
 
-  RSI = ESI + increment;
-  RDI = EDI + increment;
+  RSI = (Bit32u)(ESI + increment);
+  RDI = (Bit32u)(EDI + increment);
 }
 
 #if BX_SUPPORT_X86_64
 // 64 bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB64_YbXb(bxInstruction_c *i)
 {
-  Bit32s increment = 0;
+  Bit64s increment = 0;
 
   Bit64u rsi = RSI;
   Bit64u rdi = RDI;
@@ -298,7 +298,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD16_YdXd(bxInstruction_c *i)
 /* 32 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD32_YdXd(bxInstruction_c *i)
 {
-  Bit32s increment = 0;
+  Bit64s increment = 0;
 
   Bit32u esi = ESI;
   Bit32u edi = EDI;
@@ -309,7 +309,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD32_YdXd(bxInstruction_c *i)
    */
   if (i->repUsedL() && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
   {
-    Bit32u byteCount = FastRepMOVSB(i->seg(), esi, BX_SEG_REG_ES, edi, ECX*4, 4);
+    Bit32u byteCount = FastRepMOVSB(i->seg(), esi, BX_SEG_REG_ES, edi, (Bit64u) ECX * 4, 4);
     if (byteCount) {
       Bit32u dwordCount = byteCount >> 2;
 
@@ -337,8 +337,8 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD32_YdXd(bxInstruction_c *i)
   }
 
   // zero extension of RSI/RDI
-  RSI = esi + increment;
-  RDI = edi + increment;
+  RSI = (Bit32u)(esi + increment);
+  RDI = (Bit32u)(edi + increment);
 }
 
 #if BX_SUPPORT_X86_64
@@ -346,7 +346,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD32_YdXd(bxInstruction_c *i)
 /* 32 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD64_YdXd(bxInstruction_c *i)
 {
-  Bit32s increment = 0;
+  Bit64s increment = 0;
 
   Bit64u rsi = RSI;
   Bit64u rdi = RDI;
@@ -357,7 +357,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD64_YdXd(bxInstruction_c *i)
    */
   if (i->repUsedL() && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
   {
-    Bit32u byteCount = FastRepMOVSB(get_laddr64(i->seg(), rsi), rdi, ECX*4, 4);
+    Bit32u byteCount = FastRepMOVSB(get_laddr64(i->seg(), rsi), rdi, (Bit64u) ECX * 4, 4);
     if (byteCount) {
       Bit32u dwordCount = byteCount >> 2;
 
@@ -414,7 +414,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSQ32_YqXq(bxInstruction_c *i)
 /* 64 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSQ64_YqXq(bxInstruction_c *i)
 {
-  Bit32s increment = 0;
+  Bit64s increment = 0;
 
   Bit64u rsi = RSI;
   Bit64u rdi = RDI;
@@ -425,7 +425,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSQ64_YqXq(bxInstruction_c *i)
    */
   if (i->repUsedL() && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
   {
-    Bit32u byteCount = FastRepMOVSB(get_laddr64(i->seg(), rsi), rdi, ECX*8, 8);
+    Bit32u byteCount = FastRepMOVSB(get_laddr64(i->seg(), rsi), rdi, (Bit64u) ECX * 8, 8);
     if (byteCount) {
       Bit32u qwordCount = byteCount >> 3;
 
@@ -578,6 +578,23 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSB32_XbYb(bxInstruction_c *i)
   Bit32u esi = ESI;
   Bit32u edi = EDI;
 
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can skip the iterations which don't
+   * terminate the repeat loop in a batch. The last iteration is done
+   * below and sets the flags.
+   */
+  if (i->repUsedL() && ECX > 1 && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u byteCount = FastRepCMPSB(i->seg(), esi, BX_SEG_REG_ES, edi, ECX-1, i->lockRepUsedValue() == 3);
+    if (byteCount) {
+      BX_TICKN(byteCount);
+      RCX = ECX - byteCount;
+      esi += byteCount;
+      edi += byteCount;
+    }
+  }
+#endif
+
   op1_8 = read_virtual_byte(i->seg(), esi);
   op2_8 = read_virtual_byte(BX_SEG_REG_ES, edi);
 
@@ -608,6 +625,23 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSB64_XbYb(bxInstruction_c *i)
   Bit64u rsi = RSI;
   Bit64u rdi = RDI;
 
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can skip the iterations which don't
+   * terminate the repeat loop in a batch. The last iteration is done
+   * below and sets the flags.
+   */
+  if (i->repUsedL() && RCX > 1 && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u byteCount = FastRepCMPSB(get_laddr64(i->seg(), rsi), rdi, RCX-1, i->lockRepUsedValue() == 3);
+    if (byteCount) {
+      BX_TICKN(byteCount);
+      RCX -= byteCount;
+      rsi += byteCount;
+      rdi += byteCount;
+    }
+  }
+#endif
+
   op1_8 = read_linear_byte(i->seg(), get_laddr64(i->seg(), rsi));
   op2_8 = read_linear_byte(BX_SEG_REG_ES, rdi);
 
@@ -972,6 +1006,22 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASB32_ALYb(bxInstruction_c *i)
 
   Bit32u edi = EDI;
 
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can skip the iterations which don't
+   * terminate the repeat loop in a batch. The last iteration is done
+   * below and sets the flags.
+   */
+  if (i->repUsedL() && ECX > 1 && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u byteCount = FastRepSCASB(BX_SEG_REG_ES, edi, op1_8, ECX-1, i->lockRepUsedValue() == 3);
+    if (byteCount) {
+      BX_TICKN(byteCount);
+      RCX = ECX - byteCount;
+      edi += byteCount;
+    }
+  }
+#endif
+
   op2_8 = read_virtual_byte(BX_SEG_REG_ES, edi);
   diff_8 = op1_8 - op2_8;
 
@@ -996,6 +1046,22 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASB64_ALYb(bxInstruction_c *i)
 
   Bit64u rdi = RDI;
 
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can skip the iterations which don't
+   * terminate the repeat loop in a batch. The last iteration is done
+   * below and sets the flags.
+   */
+  if (i->repUsedL() && RCX > 1 && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u byteCount = FastRepSCASB(rdi, op1_8, RCX-1, i->lockRepUsedValue() == 3);
+    if (byteCount) {
+      BX_TICKN(byteCount);
+      RCX -= byteCount;
+      rdi += byteCount;
+    }
+  }
+#endif
+
   op2_8 = read_virtual_byte(BX_SEG_REG_ES, rdi);
 
   diff_8 = op1_8 - op2_8;
@@ -1299,7 +1365,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB16_YbAL(bxInstruction_c *i)
 // 32 bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB32_YbAL(bxInstruction_c *i)
 {
-  Bit32s increment = 0;
+  Bit64s increment = 0;
   Bit32u edi = EDI;
 
 #if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
@@ -1333,7 +1399,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB32_YbAL(bxInstruction_c *i)
   }
 
   // zero extension of RDI
-  RDI = edi + increment;
+  RDI = (Bit32u)(edi + increment);
 }
 
 #if BX_SUPPORT_X86_64
@@ -1341,7 +1407,7 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB32_YbAL(bxInstruction_c *i)
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB64_YbAL(bxInstruction_c *i)
 {
   Bit64u rdi = RDI;
-  Bit32s increment = 0;
+  Bit64s increment = 0;
 
 #if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
   /* If conditions are right, we can transfer IO to physical memory
@@ -1397,19 +1463,38 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW16_YwAX(bxInstruction_c *i)
 /* 16 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW32_YwAX(bxInstruction_c *i)
 {
+  Bit64s increment = 0;
   Bit32u edi = EDI;
 
-  write_virtual_word(BX_SEG_REG_ES, edi, AX);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u wordCount = FastRepSTOSW(BX_SEG_REG_ES, edi, AX, ECX);
+    if (wordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.
+      BX_TICKN(wordCount-1);
+
+      // Decrement eCX. Note, the main loop will decrement 1 also.
+      RCX = ECX - (wordCount-1);
 
-  if (BX_CPU_THIS_PTR get_DF()) {
-    edi -= 2;
+      increment = (Bit64s) wordCount << 1;
+    }
   }
-  else {
-    edi += 2;
+
+  if (increment == 0)
+#endif
+  {
+    write_virtual_word(BX_SEG_REG_ES, edi, AX);
+
+    increment = BX_CPU_THIS_PTR get_DF() ? -2 : 2;
   }
 
   // zero extension of RDI
-  RDI = edi;
+  RDI = (Bit32u)(edi + increment);
 }
 
 #if BX_SUPPORT_X86_64
@@ -1417,17 +1502,36 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW32_YwAX(bxInstruction_c *i)
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW64_YwAX(bxInstruction_c *i)
 {
   Bit64u rdi = RDI;
+  Bit64s increment = 0;
 
-  write_linear_word(BX_SEG_REG_ES, rdi, AX);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u wordCount = FastRepSTOSW(rdi, AX, ECX);
+    if (wordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.
+      BX_TICKN(wordCount-1);
 
-  if (BX_CPU_THIS_PTR get_DF()) {
-    rdi -= 2;
+      // Decrement RCX. Note, the main loop will decrement 1 also.
+      RCX -= (wordCount-1);
+
+      increment = (Bit64s) wordCount << 1;
+    }
   }
-  else {
-    rdi += 2;
+
+  if (increment == 0)
+#endif
+  {
+    write_linear_word(BX_SEG_REG_ES, rdi, AX);
+
+    increment = BX_CPU_THIS_PTR get_DF() ? -2 : 2;
   }
 
-  RDI = rdi;
+  RDI = rdi + increment;
 }
 #endif
 
@@ -1451,19 +1555,38 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD16_YdEAX(bxInstruction_c *i)
 /* 32 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD32_YdEAX(bxInstruction_c *i)
 {
+  Bit64s increment = 0;
   Bit32u edi = EDI;
 
-  write_virtual_dword(BX_SEG_REG_ES, edi, EAX);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u dwordCount = FastRepSTOSD(BX_SEG_REG_ES, edi, EAX, ECX);
+    if (dwordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.
+      BX_TICKN(dwordCount-1);
+
+      // Decrement eCX. Note, the main loop will decrement 1 also.
+      RCX = ECX - (dwordCount-1);
 
-  if (BX_CPU_THIS_PTR get_DF()) {
-    edi -= 4;
+      increment = (Bit64s) dwordCount << 2;
+    }
   }
-  else {
-    edi += 4;
+
+  if (increment == 0)
+#endif
+  {
+    write_virtual_dword(BX_SEG_REG_ES, edi, EAX);
+
+    increment = BX_CPU_THIS_PTR get_DF() ? -4 : 4;
   }
 
   // zero extension of RDI
-  RDI = edi;
+  RDI = (Bit32u)(edi + increment);
 }
 
 #if BX_SUPPORT_X86_64
@@ -1472,17 +1595,36 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD32_YdEAX(bxInstruction_c *i)
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD64_YdEAX(bxInstruction_c *i)
 {
   Bit64u rdi = RDI;
+  Bit64s increment = 0;
 
-  write_linear_dword(BX_SEG_REG_ES, rdi, EAX);
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u dwordCount = FastRepSTOSD(rdi, EAX, ECX);
+    if (dwordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.
+      BX_TICKN(dwordCount-1);
 
-  if (BX_CPU_THIS_PTR get_DF()) {
-    rdi -= 4;
+      // Decrement RCX. Note, the main loop will decrement 1 also.
+      RCX -= (dwordCount-1);
+
+      increment = (Bit64s) dwordCount << 2;
+    }
   }
-  else {
-    rdi += 4;
+
+  if (increment == 0)
+#endif
+  {
+    write_linear_dword(BX_SEG_REG_ES, rdi, EAX);
+
+    increment = BX_CPU_THIS_PTR get_DF() ? -4 : 4;
   }
 
-  RDI = rdi;
+  RDI = rdi + increment;
 }
 
 /* 64 bit opsize mode, 32 bit address size */
@@ -1507,17 +1649,36 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSQ32_YqRAX(bxInstruction_c *i)
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSQ64_YqRAX(bxInstruction_c *i)
 {
   Bit64u rdi = RDI;
+  Bit64s increment = 0;
+
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  /* If conditions are right, we can transfer IO to physical memory
+   * in a batch, rather than one instruction at a time.
+   */
+  if (i->repUsedL() && !BX_CPU_THIS_PTR get_DF() && !BX_CPU_THIS_PTR async_event)
+  {
+    Bit32u qwordCount = FastRepSTOSQ(rdi, RAX, ECX);
+    if (qwordCount) {
+      // Decrement the ticks count by the number of iterations, minus
+      // one, since the main cpu loop will decrement one.
+      BX_TICKN(qwordCount-1);
 
-  write_linear_qword(BX_SEG_REG_ES, rdi, RAX);
+      // Decrement RCX. Note, the main loop will decrement 1 also.
+      RCX -= (qwordCount-1);
 
-  if (BX_CPU_THIS_PTR get_DF()) {
-    rdi -= 8;
+      increment = (Bit64s) qwordCount << 3;
+    }
   }
-  else {
-    rdi += 8;
+
+  if (increment == 0)
+#endif
+  {
+    write_linear_qword(BX_SEG_REG_ES, rdi, RAX);
+
+    increment = BX_CPU_THIS_PTR get_DF() ? -8 : 8;
   }
 
-  RDI = rdi;
+  RDI = rdi + increment;
 }
 
 #endif
@@ -257,4 +257,310 @@ public:
   }
 };
 
+// Second level TLB (STLB) backs up the DTLB and ITLB. It is set associative
+// and keeps large page translations as single entry covering the whole page
+// so that accesses to different 4K parts of the large page do not require
+// page walk. Host pointers are not cached, they are resolved again when the
+// first level TLB entry is filled from the STLB.
+
+#define BX_STLB_SETS 256
+#define BX_STLB_WAYS 4
+
+struct bx_STLB_entry
+{
+  bx_address lpf;       // linear address of the page start
+  bx_phy_address ppf;   // physical address of the page start
+  Bit32u accessBits;
+  Bit32u lpf_mask;      // linear address mask of the page size
+#if BX_SUPPORT_PKEYS
+  Bit32u pkey;
+#endif
+#if BX_SUPPORT_MEMTYPE
+  Bit32u pat_memtype;   // effective memory type from page tables
+#endif
+  bx_bool code;         // entry was filled for code fetch (ITLB)
+  Bit32u asid;          // address space tag, VPID in bits 27:12 and PCID in bits 11:0
+
+  BX_CPP_INLINE bx_bool valid() const { return lpf != BX_INVALID_TLB_ENTRY; }
+
+  BX_CPP_INLINE void invalidate() {
+    lpf = BX_INVALID_TLB_ENTRY;
+    accessBits = 0;
+  }
+
+  BX_CPP_INLINE bx_bool matchAddress(bx_address laddr) const {
+    return (laddr & ~((bx_address) lpf_mask)) == lpf;
+  }
+
+  // global translations are shared by all PCIDs of the same VPID
+  BX_CPP_INLINE bx_bool matchASID(Bit32u tag) const {
+    return asid == tag || ((accessBits & TLB_GlobalPage) && (asid >> 12) == (tag >> 12));
+  }
+
+  BX_CPP_INLINE bx_bool match(bx_address laddr, bx_bool isCode, Bit32u tag) const {
+    return matchAddress(laddr) && code == isCode && matchASID(tag);
+  }
+};
+
+template <unsigned sets, unsigned ways>
+struct SecondLevelTLB {
+  bx_STLB_entry entry[sets][ways];
+#if BX_CPU_LEVEL >= 5
+  bx_bool split_large;
+#endif
+
+public:
+  SecondLevelTLB() { flush(); }
+
+  // 4K pages are indexed by the 4K linear page frame and large pages by
+  // 2M linear page frame
+  BX_CPP_INLINE unsigned get_set_of(bx_address laddr, Bit32u lpf_mask) const
+  {
+    if (lpf_mask > 0xfff)
+      return unsigned(laddr >> 21) & (sets-1);
+    else
+      return unsigned(laddr >> 12) & (sets-1);
+  }
+
+  BX_CPP_INLINE bx_STLB_entry *lookup_set(unsigned set, bx_address laddr, bx_bool code, Bit32u asid)
+  {
+    bx_STLB_entry *e = entry[set];
+
+    for (unsigned way=0; way < ways; way++) {
+      if (e[way].match(laddr, code, asid)) {
+        // keep the set ordered from most to least recently used
+        if (way > 0) {
+          bx_STLB_entry hit = e[way];
+          for (; way > 0; way--) e[way] = e[way-1];
+          e[0] = hit;
+        }
+        return &e[0];
+      }
+    }
+
+    return NULL;
+  }
+
+  BX_CPP_INLINE bx_STLB_entry *lookup(bx_address laddr, bx_bool code, Bit32u asid)
+  {
+    bx_STLB_entry *e = lookup_set(get_set_of(laddr, 0xfff), laddr, code, asid);
+#if BX_CPU_LEVEL >= 5
+    if (! e && split_large)
+      e = lookup_set(get_set_of(laddr, 0x1fffff), laddr, code, asid);
+#endif
+    return e;
+  }
+
+  // allocate entry for new translation, the least recently used entry
+  // of the set is replaced
+  BX_CPP_INLINE bx_STLB_entry *alloc(bx_address laddr, Bit32u lpf_mask, bx_bool code, Bit32u asid)
+  {
+    bx_STLB_entry *e = entry[get_set_of(laddr, lpf_mask)];
+
+    for (unsigned way=ways-1; way > 0; way--) e[way] = e[way-1];
+
+    e[0].lpf = laddr & ~((bx_address) lpf_mask);
+    e[0].lpf_mask = lpf_mask;
+    e[0].code = code;
+    e[0].asid = asid;
+#if BX_CPU_LEVEL >= 5
+    if (lpf_mask > 0xfff) split_large = true;
+#endif
+    return &e[0];
+  }
+
+  BX_CPP_INLINE void flush(void)
+  {
+    for (unsigned set=0; set < sets; set++)
+      for (unsigned way=0; way < ways; way++)
+        entry[set][way].invalidate();
+
+#if BX_CPU_LEVEL >= 5
+    split_large = false;
+#endif
+  }
+
+#if BX_CPU_LEVEL >= 6
+  BX_CPP_INLINE void flushNonGlobal(void)
+  {
+    Bit32u lpf_mask = 0;
+
+    for (unsigned set=0; set < sets; set++) {
+      for (unsigned way=0; way < ways; way++) {
+        bx_STLB_entry *e = &entry[set][way];
+        if (e->valid()) {
+          if (!(e->accessBits & TLB_GlobalPage))
+            e->invalidate();
+          else
+            lpf_mask |= e->lpf_mask;
+        }
+      }
+    }
+
+    split_large = (lpf_mask > 0xfff);
+  }
+#endif
+
+  // invalidate non-global translations tagged with the address space tag
+  BX_CPP_INLINE void flushASID(Bit32u asid)
+  {
+    for (unsigned set=0; set < sets; set++) {
+      for (unsigned way=0; way < ways; way++) {
+        bx_STLB_entry *e = &entry[set][way];
+        if (e->asid == asid && !(e->accessBits & TLB_GlobalPage))
+          e->invalidate();
+      }
+    }
+  }
+
+  // invalidate all translations tagged with the VPID
+  BX_CPP_INLINE void flushVPID(Bit32u vpid)
+  {
+    for (unsigned set=0; set < sets; set++) {
+      for (unsigned way=0; way < ways; way++) {
+        bx_STLB_entry *e = &entry[set][way];
+        if ((e->asid >> 12) == vpid)
+          e->invalidate();
+      }
+    }
+  }
+
+  BX_CPP_INLINE void invlpg(bx_address laddr)
+  {
+#if BX_CPU_LEVEL >= 5
+    if (split_large) {
+      // a page larger than 2M could be cached in any set
+      Bit32u lpf_mask = 0;
+
+      for (unsigned set=0; set < sets; set++) {
+        for (unsigned way=0; way < ways; way++) {
+          bx_STLB_entry *e = &entry[set][way];
+          if (e->valid()) {
+            if (e->matchAddress(laddr))
+              e->invalidate();
+            else
+              lpf_mask |= e->lpf_mask;
+          }
+        }
+      }
+
+      split_large = (lpf_mask > 0xfff);
+    }
+    else
+#endif
+    {
+      bx_STLB_entry *e = entry[get_set_of(laddr, 0xfff)];
+      for (unsigned way=0; way < ways; way++) {
+        if (e[way].valid() && e[way].matchAddress(laddr))
+          e[way].invalidate();
+      }
+    }
+  }
+};
+
+#define BX_PWC_SIZE  32
+#define BX_NTLB_SIZE 64
+
+// Paging structure cache entry keeps a present non-leaf paging structure
+// entry referencing the next level table together with the access rights
+// accumulated from all the paging structure entries above it
+struct bx_PWC_entry
+{
+  bx_address tag;          // linear address bits translated down to the entry
+  Bit64u entry;            // the paging structure entry with A bit set
+  Bit32u combined_access;  // U/S and R/W accumulated down to the entry
+  bx_bool nx;              // execute disable set in any entry down to the entry
+};
+
+template <unsigned size>
+struct PageWalkCache {
+  bx_PWC_entry entry[3][size]; // PDE, PDPTE and PML4E levels
+
+public:
+  PageWalkCache() { flush(); }
+
+  // level 1 is PDE, level 2 is PDPTE and level 3 is PML4E
+  BX_CPP_INLINE bx_PWC_entry *lookup(bx_address laddr, unsigned level)
+  {
+    bx_address tag = laddr >> (12 + 9*level);
+    bx_PWC_entry *e = &entry[level-1][unsigned(tag) & (size-1)];
+    return (e->tag == tag) ? e : NULL;
+  }
+
+  BX_CPP_INLINE bx_PWC_entry *alloc(bx_address laddr, unsigned level)
+  {
+    bx_address tag = laddr >> (12 + 9*level);
+    bx_PWC_entry *e = &entry[level-1][unsigned(tag) & (size-1)];
+    e->tag = tag;
+    return e;
+  }
+
+  BX_CPP_INLINE void flush(void)
+  {
+    for (unsigned level=0; level < 3; level++)
+      for (unsigned n=0; n < size; n++)
+        entry[level][n].tag = BX_INVALID_TLB_ENTRY;
+  }
+
+  // invalidate entries used for translation of the linear address only
+  BX_CPP_INLINE void invlpg(bx_address laddr)
+  {
+    for (unsigned level=1; level <= 3; level++) {
+      bx_PWC_entry *e = lookup(laddr, level);
+      if (e) e->tag = BX_INVALID_TLB_ENTRY;
+    }
+  }
+};
+
+// Nested TLB caches guest physical to host physical translations of the
+// guest paging structures accesses when EPT or nested paging is enabled.
+// An entry only serves the kind of access its nested walk was done for: a
+// write hit needs a walk that checked the write permission and updated the
+// nested accessed and dirty bits.
+#define BX_NTLB_READ  0x1
+#define BX_NTLB_WRITE 0x2
+
+struct bx_NTLB_entry
+{
+  bx_phy_address gpf;      // guest physical page frame
+  bx_phy_address hpf;      // host physical page frame
+  Bit32u access;           // BX_NTLB_READ and BX_NTLB_WRITE
+};
+
+template <unsigned size>
+struct NestedTLB {
+  bx_NTLB_entry entry[size];
+
+public:
+  NestedTLB() { flush(); }
+
+  BX_CPP_INLINE bx_NTLB_entry *lookup(bx_phy_address gpa, unsigned rw)
+  {
+    bx_phy_address gpf = gpa & ~BX_CONST64(0xfff);
+    bx_NTLB_entry *e = &entry[unsigned(gpa >> 12) & (size-1)];
+    Bit32u access = (rw & 1) ? BX_NTLB_WRITE : BX_NTLB_READ; // write or r-m-w
+    return (e->gpf == gpf && (e->access & access) != 0) ? e : NULL;
+  }
+
+  // the nested walk for the access rw completed without a fault
+  BX_CPP_INLINE void insert(bx_phy_address gpa, bx_phy_address hpa, unsigned rw)
+  {
+    bx_NTLB_entry *e = &entry[unsigned(gpa >> 12) & (size-1)];
+    bx_phy_address gpf = gpa & ~BX_CONST64(0xfff);
+    if (e->gpf != gpf) {
+      e->gpf = gpf;
+      e->access = 0;
+    }
+    e->hpf = hpa & ~BX_CONST64(0xfff);
+    // a successful write walk implies the read permission
+    e->access |= (rw & 1) ? (BX_NTLB_READ | BX_NTLB_WRITE) : BX_NTLB_READ;
+  }
+
+  BX_CPP_INLINE void flush(void)
+  {
+    for (unsigned n=0; n < size; n++)
+      entry[n].gpf = BX_INVALID_TLB_ENTRY;
+  }
+};
+
 #endif
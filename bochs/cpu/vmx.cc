@@ -2049,7 +2049,7 @@ Bit32u BX_CPU_C::VMenterLoadCheckGuestState(Bit64u *qualification)
   // Handle special case of CS.LIMIT demotion (new descriptor limit is
   // smaller than current one)
   if (BX_CPU_THIS_PTR sregs[BX_SEG_REG_CS].cache.u.segment.limit_scaled > guest.sregs[BX_SEG_REG_CS].cache.u.segment.limit_scaled)
-    BX_CPU_THIS_PTR iCache.flushICacheEntries();
+    BX_CPU_THIS_PTR iCache->flushICacheEntries();
 #endif
   
   for(unsigned segreg=0; segreg<6; segreg++)
@@ -2118,7 +2118,12 @@ Bit32u BX_CPU_C::VMenterLoadCheckGuestState(Bit64u *qualification)
   if (vm->vmexec_ctrls2 & VMX_VM_EXEC_CTRL2_INTERRUPT_WINDOW_VMEXIT)
     signal_event(BX_EVENT_VMX_INTERRUPT_WINDOW_EXITING);
 
+#if BX_SUPPORT_VMX >= 2
+  TLB_flushVPID(! (vm->vmexec_ctrls3 & VMX_VM_EXEC_CTRL3_VPID_ENABLE));
+  handleCpuContextChange(0);
+#else
   handleCpuContextChange();
+#endif
 
 #if BX_SUPPORT_MONITOR_MWAIT
   BX_CPU_THIS_PTR monitor.reset_monitor();
@@ -2623,7 +2628,12 @@ void BX_CPU_C::VMexitLoadHostState(void)
 
   BX_CPU_THIS_PTR activity_state = BX_ACTIVITY_STATE_ACTIVE;
 
+#if BX_SUPPORT_VMX >= 2
+  TLB_flushVPID(! (BX_CPU_THIS_PTR vmcs.vmexec_ctrls3 & VMX_VM_EXEC_CTRL3_VPID_ENABLE));
+  handleCpuContextChange(0);
+#else
   handleCpuContextChange();
+#endif
 
 #if BX_SUPPORT_MONITOR_MWAIT
   BX_CPU_THIS_PTR monitor.reset_monitor();
@@ -570,6 +570,7 @@ public:
   void add(bx_param_c *param);
   bx_param_c *get(int index);
   bx_param_c *get_by_name(const char *name);
+  bx_listitem_t *get_list() { return list; }
   int get_size() const { return size; }
   int get_choice() const { return choice; }
   void set_choice(int new_choice) { choice = new_choice; }
@@ -1461,6 +1461,7 @@ void HandleRfbClient(SOCKET sClient)
             rfbKeyboardEvent[rfbKeyboardEvents].down = ke.downFlag;
             rfbKeyboardEvents++;
             bKeyboardInUse = 0;
+            bx_pc_system.idle_wakeup();
           }
           break;
         }
@@ -1492,6 +1493,7 @@ void HandleRfbClient(SOCKET sClient)
             }
             rfbKeyboardEvents++;
             bKeyboardInUse = 0;
+            bx_pc_system.idle_wakeup();
           }
           break;
         }
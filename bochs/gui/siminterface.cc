@@ -1304,16 +1304,19 @@ bx_bool bx_real_sim_c::restore_bochs_param(bx_list_c *root, const char *sr_path,
                   fp2 = fopen(devdata, "rb");
                   if (fp2 != NULL) {
                     FILE **fpp = ((bx_shadow_filedata_c*)param)->get_fpp();
-                    // If the temporary backing store file wasn't created, do it now.
-                    if (*fpp == NULL)
-                      *fpp = tmpfile();
-                    if (*fpp != NULL) {
-                      while (!feof(fp2)) {
-                        char buffer[64];
-                        size_t chars = fread(buffer, 1, sizeof(buffer), fp2);
-                        fwrite(buffer, 1, chars, *fpp);
+                    // Without a backing store the restore handler reads the data.
+                    if (fpp != NULL) {
+                      // If the temporary backing store file wasn't created, do it now.
+                      if (*fpp == NULL)
+                        *fpp = tmpfile();
+                      if (*fpp != NULL) {
+                        while (!feof(fp2)) {
+                          char buffer[64];
+                          size_t chars = fread(buffer, 1, sizeof(buffer), fp2);
+                          fwrite(buffer, 1, chars, *fpp);
+                        }
+                        fflush(*fpp);
                       }
-                      fflush(*fpp);
                     }
                     ((bx_shadow_filedata_c*)param)->restore(fp2);
                     fclose(fp2);
@@ -1420,11 +1423,14 @@ bx_bool bx_real_sim_c::save_sr_param(FILE *fp, bx_param_c *node, const char *sr_
         sprintf(tmpstr, "%s/%s.%s", sr_path, node->get_parent()->get_name(), node->get_name());
       else
         sprintf(tmpstr, "%s.%s", node->get_parent()->get_name(), node->get_name());
+      // Replace an old file instead of overwriting it, it could be mapped
+      // copy-on-write by a Bochs session restored from it.
+      remove(tmpstr);
       fp2 = fopen(tmpstr, "wb");
       if (fp2 != NULL) {
         FILE **fpp = ((bx_shadow_filedata_c*)node)->get_fpp();
         // If the backing store hasn't been created, just save an empty 0 byte placeholder file.
-        if (*fpp != NULL) {
+        if ((fpp != NULL) && (*fpp != NULL)) {
           while (!feof(*fpp)) {
             char buffer[64];
             size_t chars = fread (buffer, 1, sizeof(buffer), *fpp);
@@ -1439,9 +1445,10 @@ bx_bool bx_real_sim_c::save_sr_param(FILE *fp, bx_param_c *node, const char *sr_
     case BXT_LIST:
       {
         fprintf(fp, "{\n");
+        // walk the chained list, indexing it is slow for the large lists
         bx_list_c *list = (bx_list_c*)node;
-        for (i=0; i < list->get_size(); i++) {
-          save_sr_param(fp, list->get(i), sr_path, level+1);
+        for (bx_listitem_t *item = list->get_list(); item != NULL; item = item->next) {
+          save_sr_param(fp, item->param, sr_path, level+1);
         }
         for (i=0; i<level; i++)
           fprintf(fp, "  ");
@@ -1286,6 +1286,7 @@ void dokey(rfbBool down, rfbKeySym key, rfbClientPtr cl)
     rfbKeyboardEvent[rfbKeyboardEvents].down = down;
     rfbKeyboardEvents++;
     BX_UNLOCK(bKeyboardInUse);
+    bx_pc_system.idle_wakeup();
   }
 }
 
@@ -1316,6 +1317,7 @@ void doptr(int buttonMask, int x, int y, rfbClientPtr cl)
     }
     rfbKeyboardEvents++;
     BX_UNLOCK(bKeyboardInUse);
+    bx_pc_system.idle_wakeup();
   }
 }
 
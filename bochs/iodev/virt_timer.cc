@@ -546,3 +546,16 @@ void bx_virt_timer_c::set_realtime_delay()
 {
   real_time_delay = GET_VIRT_REALTIME64_USEC() - last_real_time;
 }
+
+Bit64u bx_virt_timer_c::realtime_usec_left(void)
+{
+#if BX_HAVE_REALTIME_USEC
+  if (init_done) {
+    Bit64u real_time_total = GET_VIRT_REALTIME64_USEC() - last_real_time - real_time_delay + total_real_usec;
+    Bit64u next_event_ticks = total_ticks + s[1].virtual_next_event_time;
+    if (next_event_ticks > real_time_total)
+      return next_event_ticks - real_time_total;
+  }
+#endif
+  return 0;
+}
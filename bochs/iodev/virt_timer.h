@@ -151,6 +151,9 @@ public:
   //Determine the real time elapsed during runtime config or between save and
   //restore.
   void set_realtime_delay(void);
+
+  //Host time in microseconds until the next real time timer is due.
+  Bit64u realtime_usec_left(void);
 };
 
 BOCHSAPI extern bx_virt_timer_c bx_virt_timer;
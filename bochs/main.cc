@@ -570,6 +570,10 @@ void print_usage(void)
     "  -dumpstats N     dump bochs stats every N millions of emulated ticks\n"
 #endif
     "  -r path          restore the Bochs state from path\n"
+    "  -rcow path       restore the Bochs state from path, map saved RAM copy-on-write\n"
+    "  -checkpoint N path\n"
+    "                   save the Bochs state to a new folder in path every N millions\n"
+    "                   of emulated ticks, saving only RAM changed since the last one\n"
     "  -log filename    specify Bochs log file name\n"
     "  -unlock          unlock Bochs images leftover from previous session\n"
 #if BX_DEBUGGER
@@ -734,6 +738,22 @@ int bx_init_main(int argc, char *argv[])
         SIM->get_param_string(BXPN_RESTORE_PATH)->set(argv[arg]);
       }
     }
+    else if (!strcmp("-rcow", argv[arg])) {
+      if (++arg >= argc) BX_PANIC(("-rcow must be followed by a path"));
+      else {
+        SIM->get_param_enum(BXPN_BOCHS_START)->set(BX_QUICK_START);
+        SIM->get_param_bool(BXPN_RESTORE_FLAG)->set(1);
+        SIM->get_param_bool(BXPN_RESTORE_COW)->set(1);
+        SIM->get_param_string(BXPN_RESTORE_PATH)->set(argv[arg]);
+      }
+    }
+    else if (!strcmp("-checkpoint", argv[arg])) {
+      if ((arg + 2) >= argc) BX_PANIC(("-checkpoint must be followed by a number and a path"));
+      else {
+        SIM->get_param_num(BXPN_CHECKPOINT)->set(atoi(argv[++arg]));
+        SIM->get_param_string(BXPN_CHECKPOINT_PATH)->set(argv[++arg]);
+      }
+    }
 #ifdef WIN32
     else if (!strcmp("-noconsole", argv[arg])) {
       // already handled in main() / WinMain()
@@ -1068,6 +1088,10 @@ int bx_begin_simulation(int argc, char *argv[])
       // that kill_bochs_request was set by the GUI interface.
     }
 #if BX_SUPPORT_SMP
+    else if (SIM->get_param_bool(BXPN_SMP_THREADS)->get()) {
+      // threaded SMP simulation: each processor runs in its own host thread
+      bx_smp_run_threads();
+    }
     else {
       // SMP simulation: do a few instructions on each processor, then switch
       // to another.  Increasing quantum speeds up overall performance, but
@@ -1129,6 +1153,7 @@ void bx_stop_simulation(void)
 
 void bx_sr_after_restore_state(void)
 {
+  bx_pc_system.after_restore_state();
 #if BX_SUPPORT_SMP == 0
   BX_CPU(0)->after_restore_state();
 #else
@@ -1203,6 +1228,8 @@ void bx_init_hardware()
   BX_INFO(("CPU configuration"));
 #if BX_SUPPORT_SMP
   BX_INFO(("  SMP support: yes, quantum=%d", SIM->get_param_num(BXPN_SMP_QUANTUM)->get()));
+  if (SIM->get_param_bool(BXPN_SMP_THREADS)->get())
+    BX_INFO(("  SMP threads: yes, thread_quantum=%d", SIM->get_param_num(BXPN_SMP_THREAD_QUANTUM)->get()));
 #else
   BX_INFO(("  SMP support: no"));
 #endif
@@ -1275,6 +1302,7 @@ void bx_init_hardware()
   BX_INFO(("  RepeatSpeedups support: %s", BX_SUPPORT_REPEAT_SPEEDUPS?"yes":"no"));
   BX_INFO(("  Fast function calls: %s", BX_FAST_FUNC_CALL?"yes":"no"));
   BX_INFO(("  Handlers Chaining speedups: %s", BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS?"yes":"no"));
+  BX_INFO(("  iCache associativity: %d-way", BX_ICACHE_WAYS));
   BX_INFO(("Devices configuration"));
   BX_INFO(("  PCI support: %s", BX_SUPPORT_PCI?"i440FX i430FX i440BX":"no"));
 #if BX_SUPPORT_NE2K || BX_SUPPORT_E1000
@@ -1375,6 +1403,11 @@ void bx_init_hardware()
   }
 #endif
 
+  // preload decoded traces saved by the previous run
+  const char *trace_cache = SIM->get_param_string(BXPN_CPU_TRACE_CACHE)->getptr();
+  if (strlen(trace_cache) > 0)
+    traceCacheFile.load(trace_cache);
+
   DEV_init_devices();
   // unload optional plugins which are unused and marked for removal
   SIM->opt_plugin_ctrl("*", 0);
@@ -1400,6 +1433,17 @@ void bx_init_hardware()
     }
   }
 
+  // set periodic timer for saving checkpoints of the Bochs state, it is
+  // registered after the state of the timers so that a restored session
+  // saves checkpoints only if requested again
+  int checkpoint = SIM->get_param_num(BXPN_CHECKPOINT)->get();
+  if (checkpoint) {
+    BX_INFO(("Save checkpoint to '%s' every %d millions of ticks",
+             SIM->get_param_string(BXPN_CHECKPOINT_PATH)->getptr(), checkpoint));
+    bx_pc_system.register_timer_ticks(&bx_pc_system, bx_pc_system_c::checkpointTimer,
+        (Bit64u) checkpoint * 1000000, 1 /* continuous */, 1, "checkpoint.timer");
+  }
+
   bx_gui->init_signal_handlers();
   bx_pc_system.start_timers();
 
@@ -1445,6 +1489,9 @@ int bx_atexit(void)
   }
 #endif
 
+  if (traceCacheFile.is_enabled())
+    traceCacheFile.save(SIM->get_param_string(BXPN_CPU_TRACE_CACHE)->getptr());
+
   BX_MEM(0)->cleanup_memory();
 
   bx_pc_system.exit();
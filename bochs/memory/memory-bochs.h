@@ -79,9 +79,38 @@ struct memory_handler_struct {
 #define SMRAM_CODE  1
 #define SMRAM_DATA  2
 
+// Physical memory map: every 4K page of the physical address space refers
+// to a region descriptor with the memory handler and the memory type of the
+// page pre-resolved from the RAM size, PAM and SMRAM state.
+enum {
+  BX_MEM_PAGE_RAM = 0,  // guest RAM
+  BX_MEM_PAGE_SHADOW,   // shadow RAM, no direct access
+  BX_MEM_PAGE_CPU_RAM,  // RAM under the video memory, devices have no access
+  BX_MEM_PAGE_EXROM,    // expansion ROM 0xc0000-0xdffff
+  BX_MEM_PAGE_BIOS_LOW, // last 128K of BIOS ROM mapped to 0xe0000-0xfffff
+  BX_MEM_PAGE_BIOS,     // BIOS ROM below 4G
+  BX_MEM_PAGE_NONE      // no memory, reads return all ones, writes are ignored
+};
+
+struct memory_region_struct {
+  struct memory_handler_struct *handler; // handler covering (a part of) the page
+  Bit8u read;      // memory type of reads not claimed by the handler
+  Bit8u write;     // memory type of writes not claimed by the handler
+  Bit8u smram;     // SMRAM accesses bypassing the handler outside of SMM
+  Bit8u smram_smm; // SMRAM accesses bypassing the handler in SMM
+};
+
+#define BX_MEM_REGION_RAM   0
+#define BX_MEM_REGION_NONE  1
+#define BX_MEM_MAX_REGIONS  4096
+
 class BOCHSAPI BX_MEM_C : public logfunctions {
 private:
   struct memory_handler_struct **memory_handlers;
+  struct memory_region_struct *regions;
+  unsigned num_regions;
+  Bit16u  *page_map;
+  Bit32u   map_pages;
   bx_bool pci_enabled;
   bx_bool bios_write_enabled;
   bx_bool smram_available;
@@ -91,6 +120,7 @@ private:
   Bit64u  len, allocated;  // could be > 4G
   Bit8u   *actual_vector;
   Bit8u   *vector;   // aligned correctly
+  Bit64u   mapped_len; // length of host mapping backing the vector, 0 if heap allocated
   Bit8u  **blocks;
   Bit8u   *rom;      // 512k BIOS rom space + 128k expansion rom space
   Bit8u   *bogus;    // 4k for unexisting memory
@@ -98,6 +128,24 @@ private:
   bx_bool memory_type[13][2];
 
   Bit32u used_blocks;
+
+  // dirty page tracking for incremental saving of the mapped guest RAM
+  Bit32u  *dirty_pages; // one bit per 4K page of RAM, set when the page is written
+  Bit64u   dirty_pages_len;
+  char    *ram_base; // saved RAM image the next one is based on, NULL if none
+  bx_bool  save_live; // save the next RAM image in the background
+
+  // live snapshot of the mapped guest RAM streamed to disk by a background
+  // thread, the pages not saved yet are write protected in the TLBs and the
+  // first write to one of them copies its original contents aside
+  Bit32u  *snap_pages;   // one bit per 4K page of RAM saved by the snapshot
+  Bit32u  *snap_pending; // one bit per page neither saved nor copied aside yet
+  Bit8u  **snap_copy;    // original contents of the pages copied aside
+  FILE    *snap_fp;
+  char    *snap_dir;     // folder of the saved state the image belongs to
+  bx_bool  snap_delta;   // the image is incremental
+  bx_bool  snap_error;
+
 #if BX_LARGE_RAMFILE
   static Bit8u * const swapped_out; // NULL; // (NULL - sizeof(Bit8u));
   Bit32u  next_swapout_idx;
@@ -157,6 +205,29 @@ public:
   BX_MEM_SMF Bit64u  get_memory_len(void);
   BX_MEM_SMF void allocate_block(Bit32u index);
   BX_MEM_SMF Bit8u* alloc_vector_aligned(Bit64u bytes, Bit64u alignment);
+  BX_MEM_SMF Bit8u* alloc_vector_mapped(Bit64u bytes);
+  BX_MEM_SMF void free_vector(void);
+  BX_MEM_SMF const struct memory_region_struct* get_region(bx_phy_address a20addr);
+  BX_MEM_SMF void resolve_page(bx_phy_address addr, struct memory_region_struct *region);
+  BX_MEM_SMF Bit16u get_region_index(const struct memory_region_struct *region);
+  BX_MEM_SMF void compact_regions(void);
+  BX_MEM_SMF void alloc_page_map(Bit64u pages);
+  BX_MEM_SMF void update_page_map(bx_phy_address begin_addr, bx_phy_address end_addr);
+  BX_MEM_SMF void release_zero_block(Bit8u *block);
+  BX_MEM_SMF void load_ram_image(FILE *fp);
+  BX_MEM_SMF void restore_ram_image(FILE *fp);
+  BX_MEM_SMF void save_ram_delta(FILE *fp);
+  BX_MEM_SMF void apply_ram_delta(FILE *fp);
+
+  BX_MEM_SMF void    set_dirty_page(bx_phy_address a20addr);
+  BX_MEM_SMF bx_bool is_dirty_page(bx_phy_address a20addr);
+  BX_MEM_SMF void    set_ram_base(const char *checkpoint_path);
+  BX_MEM_SMF void    set_save_live(bx_bool enabled);
+  BX_MEM_SMF bx_bool start_ram_snapshot(FILE *fp);
+  BX_MEM_SMF void    save_page_aside(Bit64u page);
+  BX_MEM_SMF void    copy_snapshot_pages(Bit8u *buf, Bit64u page, unsigned num_pages);
+  BX_MEM_SMF void    write_ram_snapshot(void);
+  BX_MEM_SMF void    finish_ram_snapshot(void);
 
 #if BX_SUPPORT_MONITOR_MWAIT
   BX_MEM_SMF bx_bool is_monitor(bx_phy_address begin_addr, unsigned len);
@@ -166,8 +237,11 @@ public:
   void register_state(void);
 
   friend void ramfile_save_handler(void *devptr, FILE *fp);
+  friend void ram_image_save_handler(void *devptr, FILE *fp);
+  friend void ram_image_restore_handler(void *devptr, FILE *fp);
   friend Bit64s memory_param_save_handler(void *devptr, bx_param_c *param);
   friend void memory_param_restore_handler(void *devptr, bx_param_c *param, Bit64s val);
+  friend void memtype_restore_handler(void *devptr, bx_list_c *list);
 };
 
 BOCHSAPI extern BX_MEM_C bx_mem;
@@ -195,6 +269,41 @@ BX_CPP_INLINE Bit8u* BX_MEM_C::get_vector(bx_phy_address addr)
   return BX_MEM_THIS blocks[block] + (Bit32u)(addr & (BX_MEM_BLOCK_LEN-1));
 }
 
+BX_CPP_INLINE const struct memory_region_struct* BX_MEM_C::get_region(bx_phy_address a20addr)
+{
+  Bit64u page = a20addr >> 12;
+  if (page < BX_MEM_THIS map_pages)
+    return &BX_MEM_THIS regions[BX_MEM_THIS page_map[page]];
+  else
+    return &BX_MEM_THIS regions[BX_MEM_REGION_NONE];
+}
+
+// the page must be in RAM
+BX_CPP_INLINE void BX_MEM_C::set_dirty_page(bx_phy_address a20addr)
+{
+  Bit64u page = a20addr >> 12;
+  Bit32u *dirty = &BX_MEM_THIS dirty_pages[page >> 5];
+  Bit32u bit = 1 << (page & 31);
+  // CPU threads mark pages in the same word concurrently
+  if (! (*dirty & bit))
+    BX_ATOMIC_OR32(dirty, bit);
+  if (BX_MEM_THIS snap_pending != NULL)
+    save_page_aside(page);
+}
+
+// pages outside of RAM are never clean
+BX_CPP_INLINE bx_bool BX_MEM_C::is_dirty_page(bx_phy_address a20addr)
+{
+  Bit64u page = a20addr >> 12;
+  if (page >= BX_MEM_THIS dirty_pages_len) return 1;
+  return (BX_MEM_THIS dirty_pages[page >> 5] >> (page & 31)) & 1;
+}
+
+BX_CPP_INLINE void BX_MEM_C::set_save_live(bx_bool enabled)
+{
+  BX_MEM_THIS save_live = enabled;
+}
+
 BX_CPP_INLINE Bit64u BX_MEM_C::get_memory_len(void)
 {
   return (BX_MEM_THIS len);
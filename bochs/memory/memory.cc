@@ -38,9 +38,10 @@
 
 void BX_MEM_C::writePhysicalPage(BX_CPU_C *cpu, bx_phy_address addr, unsigned len, void *data)
 {
-  Bit8u *data_ptr;
+  Bit8u *ptr, *data_ptr;
   bx_phy_address a20addr = A20ADDR(addr);
-  struct memory_handler_struct *memory_handler = NULL;
+  const struct memory_region_struct *region = BX_MEM_THIS get_region(a20addr);
+  struct memory_handler_struct *memory_handler;
 
   // Note: accesses should always be contained within a single page
   if ((addr>>12) != ((addr+len-1)>>12)) {
@@ -51,340 +52,187 @@ void BX_MEM_C::writePhysicalPage(BX_CPU_C *cpu, bx_phy_address addr, unsigned le
   BX_MEM_THIS check_monitor(a20addr, len);
 #endif
 
-  bx_bool is_bios = (a20addr >= (bx_phy_address)~BIOS_MASK);
-#if BX_PHY_ADDRESS_LONG
-  if (a20addr > BX_CONST64(0xffffffff)) is_bios = 0;
-#endif
-
   if (cpu != NULL) {
 #if BX_SUPPORT_IODEBUG
     bx_devices.pluginIODebug->mem_write(cpu, a20addr, len, data);
 #endif
 
-    if ((a20addr >= 0x000a0000 && a20addr < 0x000c0000) && BX_MEM_THIS smram_available)
+    if (region->smram_smm)
     {
       // SMRAM memory space
-      if (BX_MEM_THIS smram_enable || (cpu->smm_mode() && !BX_MEM_THIS smram_restricted))
+      if ((cpu->smm_mode() ? region->smram_smm : region->smram) & SMRAM_DATA)
         goto mem_write;
     }
   }
 
-  memory_handler = BX_MEM_THIS memory_handlers[a20addr >> 20];
-  while (memory_handler) {
-    if (memory_handler->write_handler != NULL) {
-      if (memory_handler->begin <= a20addr &&
-          memory_handler->end >= a20addr &&
-          memory_handler->write_handler(a20addr, len, data, memory_handler->param))
-      {
-        return;
-      }
+  memory_handler = region->handler;
+  if (memory_handler && memory_handler->write_handler != NULL) {
+    if (memory_handler->begin <= a20addr &&
+        memory_handler->end >= a20addr &&
+        memory_handler->write_handler(a20addr, len, data, memory_handler->param))
+    {
+      return;
     }
-    memory_handler = memory_handler->next;
   }
 
 mem_write:
 
-  // all memory access fits in single 4K page
-  if (a20addr < BX_MEM_THIS len && ! is_bios) {
-    // all of data is within limits of physical memory
-    if (a20addr < 0x000a0000 || a20addr >= 0x00100000)
-    {
-      if (len == 8) {
-        pageWriteStampTable.decWriteStamp(a20addr, 8);
-        WriteHostQWordToLittleEndian((Bit64u*) BX_MEM_THIS get_vector(a20addr), *(Bit64u*)data);
-        return;
-      }
-      if (len == 4) {
-        pageWriteStampTable.decWriteStamp(a20addr, 4);
-        WriteHostDWordToLittleEndian((Bit32u*) BX_MEM_THIS get_vector(a20addr), *(Bit32u*)data);
-        return;
-      }
-      if (len == 2) {
-        pageWriteStampTable.decWriteStamp(a20addr, 2);
-        WriteHostWordToLittleEndian((Bit16u*) BX_MEM_THIS get_vector(a20addr), *(Bit16u*)data);
-        return;
-      }
-      if (len == 1) {
-        pageWriteStampTable.decWriteStamp(a20addr, 1);
-        * (BX_MEM_THIS get_vector(a20addr)) = * (Bit8u *) data;
-        return;
-      }
-      // len == other, just fall thru to special cases handling
-    }
-
-    pageWriteStampTable.decWriteStamp(a20addr);
-
-#ifdef BX_LITTLE_ENDIAN
-    data_ptr = (Bit8u *) data;
-#else // BX_BIG_ENDIAN
-    data_ptr = (Bit8u *) data + (len - 1);
-#endif
-
-    if (a20addr < 0x000a0000 || a20addr >= 0x00100000)
-    {
-      // addr *not* in range 000A0000 .. 000FFFFF
-      while(1) {
-        *(BX_MEM_THIS get_vector(a20addr)) = *data_ptr;
-        if (len == 1) return;
-        len--;
-        a20addr++;
-#ifdef BX_LITTLE_ENDIAN
-        data_ptr++;
-#else // BX_BIG_ENDIAN
-        data_ptr--;
-#endif
-      }
-    }
-
-    // addr must be in range 000A0000 .. 000FFFFF
-
-    for(unsigned i=0; i<len; i++) {
+  switch (region->write) {
+    case BX_MEM_PAGE_CPU_RAM:
+      // devices are not allowed to access SMMRAM under VGA memory
+      if (! cpu) return;
+      // fall through
+    case BX_MEM_PAGE_RAM:
+    case BX_MEM_PAGE_SHADOW:
+      BX_MEM_THIS set_dirty_page(a20addr);
+      ptr = BX_MEM_THIS get_vector(a20addr);
+      break;
+    case BX_MEM_PAGE_BIOS_LOW:
+      // volatile BIOS write support, last 128K of BIOS ROM
+      ptr = &BX_MEM_THIS rom[BIOS_MAP_LAST128K(a20addr)];
+      break;
+    case BX_MEM_PAGE_BIOS:
+      // volatile BIOS write support
+      ptr = &BX_MEM_THIS rom[a20addr & BIOS_MASK];
+      break;
+    default:
+      // write to ROM or outside limits of physical memory, ignore
+      BX_DEBUG(("Write to ROM or outside the limits of physical memory (0x" FMT_PHY_ADDRX ") (ignore)", a20addr));
+      return;
+  }
 
-      // SMMRAM
-      if (a20addr < 0x000c0000) {
-        // devices are not allowed to access SMMRAM under VGA memory
-        if (cpu) {
-          *(BX_MEM_THIS get_vector(a20addr)) = *data_ptr;
-        }
-        goto inc_one;
-      }
+  // all memory access fits in single 4K page
+  if (len == 8) {
+    pageWriteStampTable.decWriteStamp(a20addr, 8);
+    WriteHostQWordToLittleEndian((Bit64u*) ptr, *(Bit64u*)data);
+    return;
+  }
+  if (len == 4) {
+    pageWriteStampTable.decWriteStamp(a20addr, 4);
+    WriteHostDWordToLittleEndian((Bit32u*) ptr, *(Bit32u*)data);
+    return;
+  }
+  if (len == 2) {
+    pageWriteStampTable.decWriteStamp(a20addr, 2);
+    WriteHostWordToLittleEndian((Bit16u*) ptr, *(Bit16u*)data);
+    return;
+  }
+  if (len == 1) {
+    pageWriteStampTable.decWriteStamp(a20addr, 1);
+    *ptr = * (Bit8u *) data;
+    return;
+  }
+  // len == other, just fall thru to special cases handling
 
-      // adapter ROM     C0000 .. DFFFF
-      // ROM BIOS memory E0000 .. FFFFF
-#if BX_SUPPORT_PCI == 0
-      // ignore write to ROM
-#else
-      // Write Based on 440fx Programming
-      if (BX_MEM_THIS pci_enabled && ((a20addr & 0xfffc0000) == 0x000c0000)) {
-        unsigned area = (unsigned)(a20addr >> 14) & 0x0f;
-        if (area > BX_MEM_AREA_F0000) area = BX_MEM_AREA_F0000;
-        if (BX_MEM_THIS memory_type[area][1] == 1) {
-          // Writes to ShadowRAM
-          BX_DEBUG(("Writing to ShadowRAM: address 0x" FMT_PHY_ADDRX ", data %02x", a20addr, *data_ptr));
-          *(BX_MEM_THIS get_vector(a20addr)) = *data_ptr;
-        } else if ((area >= BX_MEM_AREA_E0000) && BX_MEM_THIS bios_write_enabled) {
-          // volatile BIOS write support
-#ifdef BX_LITTLE_ENDIAN
-          data_ptr = (Bit8u *) data;
-#else // BX_BIG_ENDIAN
-          data_ptr = (Bit8u *) data + (len - 1);
-#endif
-          for (unsigned i = 0; i < len; i++) {
-            BX_MEM_THIS rom[BIOS_MAP_LAST128K(a20addr)] = *data_ptr;
-            a20addr++;
-#ifdef BX_LITTLE_ENDIAN
-            data_ptr++;
-#else // BX_BIG_ENDIAN
-            data_ptr--;
-#endif
-          }
-        } else {
-          // Writes to ROM, Inhibit
-          BX_DEBUG(("Write to ROM ignored: address 0x" FMT_PHY_ADDRX ", data %02x", a20addr, *data_ptr));
-        }
-      }
-#endif
+  pageWriteStampTable.decWriteStamp(a20addr);
 
-inc_one:
-      a20addr++;
 #ifdef BX_LITTLE_ENDIAN
-      data_ptr++;
+  data_ptr = (Bit8u *) data;
 #else // BX_BIG_ENDIAN
-      data_ptr--;
+  data_ptr = (Bit8u *) data + (len - 1);
 #endif
 
-    }
-  } else if (BX_MEM_THIS bios_write_enabled && (a20addr >= (bx_phy_address)~BIOS_MASK)) {
-    // volatile BIOS write support
+  for (unsigned i = 0; i < len; i++) {
+    *ptr++ = *data_ptr;
 #ifdef BX_LITTLE_ENDIAN
-    data_ptr = (Bit8u *) data;
+    data_ptr++;
 #else // BX_BIG_ENDIAN
-    data_ptr = (Bit8u *) data + (len - 1);
+    data_ptr--;
 #endif
-    for (unsigned i = 0; i < len; i++) {
-      BX_MEM_THIS rom[a20addr & BIOS_MASK] = *data_ptr;
-      a20addr++;
-#ifdef BX_LITTLE_ENDIAN
-      data_ptr++;
-#else // BX_BIG_ENDIAN
-      data_ptr--;
-#endif
-    }
-  } else {
-    // access outside limits of physical memory, ignore
-    BX_DEBUG(("Write outside the limits of physical memory (0x" FMT_PHY_ADDRX ") (ignore)", a20addr));
   }
 }
 
 void BX_MEM_C::readPhysicalPage(BX_CPU_C *cpu, bx_phy_address addr, unsigned len, void *data)
 {
-  Bit8u *data_ptr;
+  Bit8u *ptr, *data_ptr;
   bx_phy_address a20addr = A20ADDR(addr);
-  struct memory_handler_struct *memory_handler = NULL;
+  const struct memory_region_struct *region = BX_MEM_THIS get_region(a20addr);
+  struct memory_handler_struct *memory_handler;
 
   // Note: accesses should always be contained within a single page
   if ((addr>>12) != ((addr+len-1)>>12)) {
     BX_PANIC(("readPhysicalPage: cross page access at address 0x" FMT_PHY_ADDRX ", len=%d", addr, len));
   }
 
-  bx_bool is_bios = (a20addr >= (bx_phy_address)~BIOS_MASK);
-#if BX_PHY_ADDRESS_LONG
-  if (a20addr > BX_CONST64(0xffffffff)) is_bios = 0;
-#endif
-
   if (cpu != NULL) {
 #if BX_SUPPORT_IODEBUG
     bx_devices.pluginIODebug->mem_read(cpu, a20addr, len, data);
 #endif
 
-    if ((a20addr >= 0x000a0000 && a20addr < 0x000c0000) && BX_MEM_THIS smram_available)
+    if (region->smram_smm)
     {
       // SMRAM memory space
-      if (BX_MEM_THIS smram_enable || (cpu->smm_mode() && !BX_MEM_THIS smram_restricted))
+      if ((cpu->smm_mode() ? region->smram_smm : region->smram) & SMRAM_DATA)
         goto mem_read;
     }
   }
 
-  memory_handler = BX_MEM_THIS memory_handlers[a20addr >> 20];
-  while (memory_handler) {
-    if (memory_handler->begin <= a20addr &&
-          memory_handler->end >= a20addr &&
-          memory_handler->read_handler(a20addr, len, data, memory_handler->param))
-    {
-      return;
-    }
-    memory_handler = memory_handler->next;
+  memory_handler = region->handler;
+  if (memory_handler &&
+      memory_handler->begin <= a20addr &&
+      memory_handler->end >= a20addr &&
+      memory_handler->read_handler(a20addr, len, data, memory_handler->param))
+  {
+    return;
   }
 
 mem_read:
 
-  if (a20addr < BX_MEM_THIS len && ! is_bios) {
-    // all of data is within limits of physical memory
-    if (a20addr < 0x000a0000 || a20addr >= 0x00100000)
-    {
-      if (len == 8) {
-        * (Bit64u*) data = ReadHostQWordFromLittleEndian((Bit64u*) BX_MEM_THIS get_vector(a20addr));
-        return;
-      }
-      if (len == 4) {
-        * (Bit32u*) data = ReadHostDWordFromLittleEndian((Bit32u*) BX_MEM_THIS get_vector(a20addr));
-        return;
-      }
-      if (len == 2) {
-        * (Bit16u*) data = ReadHostWordFromLittleEndian((Bit16u*) BX_MEM_THIS get_vector(a20addr));
-        return;
-      }
-      if (len == 1) {
-        * (Bit8u *) data = * (BX_MEM_THIS get_vector(a20addr));
-        return;
-      }
-      // len == other case can just fall thru to special cases handling
-    }
-
-#ifdef BX_LITTLE_ENDIAN
-    data_ptr = (Bit8u *) data;
-#else // BX_BIG_ENDIAN
-    data_ptr = (Bit8u *) data + (len - 1);
-#endif
-
-    if (a20addr < 0x000a0000 || a20addr >= 0x00100000)
-    {
-      // addr *not* in range 000A0000 .. 000FFFFF
-      while(1) {
-        *data_ptr = *(BX_MEM_THIS get_vector(a20addr));
-        if (len == 1) return;
-        len--;
-        a20addr++;
-#ifdef BX_LITTLE_ENDIAN
-        data_ptr++;
-#else // BX_BIG_ENDIAN
-        data_ptr--;
-#endif
-      }
-    }
-
-    // addr must be in range 000A0000 .. 000FFFFF
-
-    for (unsigned i=0; i<len; i++) {
-
-      // SMMRAM
-      if (a20addr < 0x000c0000) {
-        // devices are not allowed to access SMMRAM under VGA memory
-        if (cpu) *data_ptr = *(BX_MEM_THIS get_vector(a20addr));
-        goto inc_one;
-      }
-
-#if BX_SUPPORT_PCI
-      if (BX_MEM_THIS pci_enabled && ((a20addr & 0xfffc0000) == 0x000c0000)) {
-        unsigned area = (unsigned)(a20addr >> 14) & 0x0f;
-        if (area > BX_MEM_AREA_F0000) area = BX_MEM_AREA_F0000;
-        if (BX_MEM_THIS memory_type[area][0] == 0) {
-          // Read from ROM
-          if ((a20addr & 0xfffe0000) == 0x000e0000) {
-            // last 128K of BIOS ROM mapped to 0xE0000-0xFFFFF
-            *data_ptr = BX_MEM_THIS rom[BIOS_MAP_LAST128K(a20addr)];
-          } else {
-            *data_ptr = BX_MEM_THIS rom[(a20addr & EXROM_MASK) + BIOSROMSZ];
-          }
-        } else {
-          // Read from ShadowRAM
-          *data_ptr = *(BX_MEM_THIS get_vector(a20addr));
-        }
-      }
-      else
-#endif  // #if BX_SUPPORT_PCI
-      {
-        if ((a20addr & 0xfffc0000) != 0x000c0000) {
-          *data_ptr = *(BX_MEM_THIS get_vector(a20addr));
-        }
-        else if ((a20addr & 0xfffe0000) == 0x000e0000) {
-          // last 128K of BIOS ROM mapped to 0xE0000-0xFFFFF
-          *data_ptr = BX_MEM_THIS rom[BIOS_MAP_LAST128K(a20addr)];
-        }
-        else {
-          *data_ptr = BX_MEM_THIS rom[(a20addr & EXROM_MASK) + BIOSROMSZ];
-        }
-      }
-
-inc_one:
-      a20addr++;
-#ifdef BX_LITTLE_ENDIAN
-      data_ptr++;
-#else // BX_BIG_ENDIAN
-      data_ptr--;
-#endif
-
-    }
-  }
-  else  // access outside limits of physical memory
-  {
-#if BX_PHY_ADDRESS_LONG
-    if (a20addr > BX_CONST64(0xffffffff)) {
+  switch (region->read) {
+    case BX_MEM_PAGE_CPU_RAM:
+      // devices are not allowed to access SMMRAM under VGA memory
+      if (! cpu) return;
+      // fall through
+    case BX_MEM_PAGE_RAM:
+      ptr = BX_MEM_THIS get_vector(a20addr);
+      break;
+    case BX_MEM_PAGE_EXROM:
+      ptr = &BX_MEM_THIS rom[(a20addr & EXROM_MASK) + BIOSROMSZ];
+      break;
+    case BX_MEM_PAGE_BIOS_LOW:
+      // last 128K of BIOS ROM mapped to 0xE0000-0xFFFFF
+      ptr = &BX_MEM_THIS rom[BIOS_MAP_LAST128K(a20addr)];
+      break;
+    case BX_MEM_PAGE_BIOS:
+      ptr = &BX_MEM_THIS rom[a20addr & BIOS_MASK];
+      break;
+    default:
+      // access outside limits of physical memory
       memset(data, 0xFF, len);
       return;
-    }
-#endif
+  }
+
+  if (len == 8) {
+    * (Bit64u*) data = ReadHostQWordFromLittleEndian((Bit64u*) ptr);
+    return;
+  }
+  if (len == 4) {
+    * (Bit32u*) data = ReadHostDWordFromLittleEndian((Bit32u*) ptr);
+    return;
+  }
+  if (len == 2) {
+    * (Bit16u*) data = ReadHostWordFromLittleEndian((Bit16u*) ptr);
+    return;
+  }
+  if (len == 1) {
+    * (Bit8u *) data = *ptr;
+    return;
+  }
+  // len == other case can just fall thru to special cases handling
 
 #ifdef BX_LITTLE_ENDIAN
-    data_ptr = (Bit8u *) data;
+  data_ptr = (Bit8u *) data;
 #else // BX_BIG_ENDIAN
-    data_ptr = (Bit8u *) data + (len - 1);
+  data_ptr = (Bit8u *) data + (len - 1);
 #endif
 
-    if (a20addr >= (bx_phy_address)~BIOS_MASK) {
-      for (unsigned i = 0; i < len; i++) {
-        *data_ptr = BX_MEM_THIS rom[a20addr & BIOS_MASK];
-         a20addr++;
+  for (unsigned i = 0; i < len; i++) {
+    *data_ptr = *ptr++;
 #ifdef BX_LITTLE_ENDIAN
-         data_ptr++;
+    data_ptr++;
 #else // BX_BIG_ENDIAN
-         data_ptr--;
+    data_ptr--;
 #endif
-      }
-    }
-    else {
-      memset(data, 0xFF, len);
-    }
   }
 }
 
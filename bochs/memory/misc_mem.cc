@@ -26,8 +26,20 @@
 #include "param_names.h"
 #include "cpu/cpu.h"
 #include "iodev/iodev.h"
+#include "bxthread.h"
 #define LOG_THIS BX_MEM(0)->
 
+#if BX_HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+// guest RAM is backed by a host mapping committed on first touch
+#if defined(MAP_ANONYMOUS) && defined(MAP_NORESERVE)
+#define BX_MEM_MMAP 1
+#else
+#define BX_MEM_MMAP 0
+#endif
+
 // alignment of memory vector, must be a power of 2
 #define BX_MEM_VECTOR_ALIGN 4096
 #define BX_MEM_HANDLERS   ((BX_CONST64(1) << BX_PHY_ADDRESS_WIDTH) >> 20) /* one per megabyte */
@@ -42,11 +54,29 @@ BX_MEM_C::BX_MEM_C()
 
   vector = NULL;
   actual_vector = NULL;
+  mapped_len = 0;
   blocks = NULL;
   len    = 0;
   used_blocks = 0;
 
   memory_handlers = NULL;
+  regions = NULL;
+  num_regions = 0;
+  page_map = NULL;
+  map_pages = 0;
+
+  dirty_pages = NULL;
+  dirty_pages_len = 0;
+  ram_base = NULL;
+  save_live = 0;
+
+  snap_pages = NULL;
+  snap_pending = NULL;
+  snap_copy = NULL;
+  snap_fp = NULL;
+  snap_dir = NULL;
+  snap_delta = 0;
+  snap_error = 0;
 
 #if BX_LARGE_RAMFILE
   next_swapout_idx = 0;
@@ -57,7 +87,7 @@ BX_MEM_C::BX_MEM_C()
 Bit8u* BX_MEM_C::alloc_vector_aligned(Bit64u bytes, Bit64u alignment)
 {
   Bit64u test_mask = alignment - 1;
-  BX_MEM_THIS actual_vector = new Bit8u [(Bit32u)(bytes + test_mask)];
+  BX_MEM_THIS actual_vector = new Bit8u [(size_t)(bytes + test_mask)];
   if (BX_MEM_THIS actual_vector == 0) {
     BX_PANIC(("alloc_vector_aligned: unable to allocate host RAM !"));
     return 0;
@@ -73,6 +103,475 @@ Bit8u* BX_MEM_C::alloc_vector_aligned(Bit64u bytes, Bit64u alignment)
   return vector;
 }
 
+// Map the memory vector without reserving host memory or swap space for it.
+// Host pages are committed by the kernel when the guest touches them, so
+// guest RAM of any size could be mapped and unused RAM costs nothing.
+Bit8u* BX_MEM_C::alloc_vector_mapped(Bit64u bytes)
+{
+#if BX_MEM_MMAP
+  if ((size_t) bytes != bytes) return NULL;
+
+  void *ptr = mmap(NULL, (size_t) bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (ptr == MAP_FAILED) {
+    BX_INFO(("failed to map " FMT_LL "u bytes of host memory", bytes));
+    return NULL;
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (SIM->get_param_bool(BXPN_MEM_HUGEPAGES)->get()) {
+    if (madvise(ptr, (size_t) bytes, MADV_HUGEPAGE) != 0)
+      BX_INFO(("host huge pages are not available for guest RAM"));
+  }
+#endif
+
+  // the mapping is page aligned
+  BX_MEM_THIS actual_vector = (Bit8u *) ptr;
+  BX_MEM_THIS mapped_len = bytes;
+  return BX_MEM_THIS actual_vector;
+#else
+  return NULL;
+#endif
+}
+
+void BX_MEM_C::free_vector(void)
+{
+#if BX_MEM_MMAP
+  if (BX_MEM_THIS mapped_len) {
+    munmap(BX_MEM_THIS actual_vector, (size_t) BX_MEM_THIS mapped_len);
+    BX_MEM_THIS mapped_len = 0;
+  }
+  else
+#endif
+  delete [] BX_MEM_THIS actual_vector;
+
+  BX_MEM_THIS actual_vector = NULL;
+  BX_MEM_THIS vector = NULL;
+}
+
+// Give the host pages of a block that holds only zeroes back to the host,
+// the block reads as zeroes afterwards and is committed again when written.
+void BX_MEM_C::release_zero_block(Bit8u *block)
+{
+#if BX_MEM_MMAP && defined(MADV_DONTNEED)
+  if (! BX_MEM_THIS mapped_len) return;
+
+  const Bit64u *data = (const Bit64u *) block;
+  for (unsigned n=0; n < BX_MEM_BLOCK_LEN / 8; n++)
+    if (data[n]) return;
+
+  madvise(block, BX_MEM_BLOCK_LEN, MADV_DONTNEED);
+#endif
+}
+
+// Load the saved full image of the mapped guest RAM. Copy-on-write restore
+// maps the image file in place of the guest RAM instead of reading it: pages
+// are faulted in from the host page cache when the guest touches them,
+// sessions restored from the same image share the unmodified pages and only
+// pages written by the guest get a private copy.
+void BX_MEM_C::load_ram_image(FILE *fp)
+{
+  struct stat stat_buf;
+  Bit64u size = 0, offset = 0;
+
+  if (fstat(fileno(fp), &stat_buf) == 0)
+    size = stat_buf.st_size;
+  if (size > BX_MEM_THIS len)
+    size = BX_MEM_THIS len;
+
+  if (SIM->get_param_bool(BXPN_RESTORE_COW)->get()) {
+#if BX_MEM_MMAP
+    // a partial last page reads as zeroes beyond the end of the image
+    size_t maplen = (size_t)((size + 4095) & ~BX_CONST64(4095));
+    if (maplen > 0) {
+      void *ptr = mmap(BX_MEM_THIS vector, maplen, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_FIXED, fileno(fp), 0);
+      if (ptr != MAP_FAILED) {
+        BX_INFO(("mapped " FMT_LL "u bytes of saved RAM copy-on-write", size));
+        return;
+      }
+    }
+#endif
+    BX_INFO(("copy-on-write restore not possible, reading saved RAM"));
+  }
+
+  rewind(fp);
+  while (offset < size) {
+    size_t chunk = (size - offset) < BX_MEM_BLOCK_LEN ? (size_t)(size - offset) : BX_MEM_BLOCK_LEN;
+    if (fread(BX_MEM_THIS vector + offset, 1, chunk, fp) != chunk)
+      BX_PANIC(("FATAL ERROR: Could not read from 0x" FMT_LL "x in saved RAM image!", offset));
+    // keep the mapped guest RAM sparse after restore
+    if (chunk == BX_MEM_BLOCK_LEN)
+      release_zero_block(BX_MEM_THIS vector + offset);
+    offset += chunk;
+  }
+}
+
+// Incremental RAM image: the magic, the path of the RAM image it is based on
+// terminated by a newline, then the runs of pages written after the base
+// image was saved. Every run is a 64-bit guest physical address and a 64-bit
+// length followed by the data. The base image may be incremental itself.
+#define BX_RAM_DELTA_MAGIC "BXRAMDELTA1\n"
+#define BX_RAM_DELTA_MAGIC_LEN 12
+
+static bx_bool is_absolute_path(const char *path)
+{
+#ifdef WIN32
+  if (isalpha(path[0]) && (path[1] == ':')) return 1;
+  if (path[0] == '\\') return 1;
+#endif
+  return (path[0] == '/');
+}
+
+// length of the folder part of path, without the trailing separator
+static size_t folder_len(const char *path)
+{
+  size_t len = strlen(path);
+  while ((len > 0) && (path[len-1] != '/')
+#ifdef WIN32
+         && (path[len-1] != '\\')
+#endif
+        ) len--;
+  return (len > 0) ? len - 1 : 0;
+}
+
+// The base image is stored relative to the folder of the incremental image
+// if both are checkpoint folders in the same folder, so that the chain can be
+// restored from any working directory and moved as a whole. Otherwise the
+// absolute path of the base image is stored.
+static bx_bool write_ram_delta_header(FILE *fp, const char *base_path)
+{
+  char ref[BX_PATHNAME_LEN], base_dir[BX_PATHNAME_LEN];
+  const char *delta_dir = SIM->get_param_string(BXPN_RESTORE_PATH)->getptr();
+  size_t parent_len = folder_len(delta_dir);
+
+  snprintf(base_dir, BX_PATHNAME_LEN, "%.*s", (int) folder_len(base_path), base_path);
+  if ((parent_len > 0) && (folder_len(base_dir) == parent_len) &&
+      !strncmp(base_dir, delta_dir, parent_len)) {
+    snprintf(ref, BX_PATHNAME_LEN, "..%s", base_path + parent_len);
+  }
+  else if (is_absolute_path(base_path)) {
+    snprintf(ref, BX_PATHNAME_LEN, "%s", base_path);
+  }
+  else {
+#ifdef WIN32
+    if (_fullpath(ref, base_path, BX_PATHNAME_LEN) == NULL) return 0;
+#else
+    char cwd[BX_PATHNAME_LEN];
+    if (getcwd(cwd, BX_PATHNAME_LEN) == NULL) return 0;
+    snprintf(ref, BX_PATHNAME_LEN, "%s/%s", cwd, base_path);
+#endif
+  }
+  return (fwrite(BX_RAM_DELTA_MAGIC, 1, BX_RAM_DELTA_MAGIC_LEN, fp) == BX_RAM_DELTA_MAGIC_LEN) &&
+         (fprintf(fp, "%s\n", ref) >= 0);
+}
+
+// returns 0 and rewinds the file if it is a full RAM image, a relative path
+// of the base image is resolved against the folder of the incremental image
+static bx_bool read_ram_delta_header(FILE *fp, const char *delta_dir, char *base_path)
+{
+  char magic[BX_RAM_DELTA_MAGIC_LEN], ref[BX_PATHNAME_LEN];
+  size_t len;
+
+  rewind(fp);
+  if ((fread(magic, 1, BX_RAM_DELTA_MAGIC_LEN, fp) != BX_RAM_DELTA_MAGIC_LEN) ||
+      memcmp(magic, BX_RAM_DELTA_MAGIC, BX_RAM_DELTA_MAGIC_LEN)) {
+    rewind(fp);
+    return 0;
+  }
+  if ((fgets(ref, BX_PATHNAME_LEN, fp) == NULL) ||
+      ((len = strlen(ref)) < 2) || (ref[len-1] != '\n'))
+    BX_PANIC(("malformed header of incremental RAM image"));
+  ref[len-1] = 0;
+  if (is_absolute_path(ref))
+    strcpy(base_path, ref);
+  else
+    snprintf(base_path, BX_PATHNAME_LEN, "%s/%s", delta_dir, ref);
+  return 1;
+}
+
+// Only one file of the chain is open at a time, the delta is reopened after
+// its base images were restored.
+static void restore_ram_image_from(const char *path)
+{
+  char base_path[BX_PATHNAME_LEN], dir[BX_PATHNAME_LEN];
+
+  snprintf(dir, BX_PATHNAME_LEN, "%.*s", (int) folder_len(path), path);
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    BX_PANIC(("could not open base RAM image '%s'", path));
+  if (read_ram_delta_header(fp, dir, base_path)) {
+    fclose(fp);
+    restore_ram_image_from(base_path);
+    fp = fopen(path, "rb");
+    if ((fp == NULL) || !read_ram_delta_header(fp, dir, base_path))
+      BX_PANIC(("could not reopen incremental RAM image '%s'", path));
+    BX_MEM(0)->apply_ram_delta(fp);
+  }
+  else {
+    BX_MEM(0)->load_ram_image(fp);
+  }
+  fclose(fp);
+}
+
+// Restore a full RAM image or merge the chain of incremental images ending
+// with this one, starting from the full image at its root.
+void BX_MEM_C::restore_ram_image(FILE *fp)
+{
+  char base_path[BX_PATHNAME_LEN];
+
+  if (read_ram_delta_header(fp, SIM->get_param_string(BXPN_RESTORE_PATH)->getptr(), base_path)) {
+    restore_ram_image_from(base_path);
+    apply_ram_delta(fp);
+  }
+  else {
+    load_ram_image(fp);
+  }
+}
+
+void BX_MEM_C::save_ram_delta(FILE *fp)
+{
+  Bit64u run[2], page = 0, num_pages = 0;
+
+  if (! write_ram_delta_header(fp, BX_MEM_THIS ram_base))
+    BX_PANIC(("FATAL ERROR: Could not write incremental RAM image header!"));
+
+  while (page < BX_MEM_THIS dirty_pages_len) {
+    if (! BX_MEM_THIS is_dirty_page(page << 12)) {
+      page++;
+      continue;
+    }
+    Bit64u first = page;
+    while (page < BX_MEM_THIS dirty_pages_len && BX_MEM_THIS is_dirty_page(page << 12))
+      page++;
+    run[0] = first << 12;
+    run[1] = (page - first) << 12;
+    if ((fwrite(run, sizeof(run), 1, fp) != 1) ||
+        (fwrite(BX_MEM_THIS vector + run[0], 1, (size_t) run[1], fp) != run[1]))
+      BX_PANIC(("FATAL ERROR: Could not write at 0x" FMT_LL "x in incremental RAM image!", run[0]));
+    num_pages += page - first;
+  }
+
+  BX_INFO(("saved " FMT_LL "u of " FMT_LL "u RAM pages written since '%s'",
+           num_pages, BX_MEM_THIS dirty_pages_len, BX_MEM_THIS ram_base));
+}
+
+void BX_MEM_C::apply_ram_delta(FILE *fp)
+{
+  Bit64u run[2];
+
+  while (fread(run, sizeof(run), 1, fp) == 1) {
+    if ((run[0] & 0xfff) || (run[1] & 0xfff) || (run[0] > BX_MEM_THIS len) ||
+        (run[1] > BX_MEM_THIS len - run[0]))
+      BX_PANIC(("malformed page run in incremental RAM image"));
+    if (fread(BX_MEM_THIS vector + run[0], 1, (size_t) run[1], fp) != run[1])
+      BX_PANIC(("FATAL ERROR: Could not read from 0x" FMT_LL "x in incremental RAM image!", run[0]));
+  }
+}
+
+// Make the RAM image saved into checkpoint_path the base of the next saved
+// image. The dirty page tracking starts over and the CPUs drop the write
+// access cached in their TLBs, the next write to a page marks it dirty.
+void BX_MEM_C::set_ram_base(const char *checkpoint_path)
+{
+  // without mapped guest RAM every image is saved in full
+  if (! BX_MEM_THIS mapped_len) return;
+
+  // file name of the 'ram' parameter of the 'memory' list
+  delete [] BX_MEM_THIS ram_base;
+  BX_MEM_THIS ram_base = new char[strlen(checkpoint_path) + 12];
+  sprintf(BX_MEM_THIS ram_base, "%s/memory.ram", checkpoint_path);
+
+  memset(BX_MEM_THIS dirty_pages, 0, (size_t)((BX_MEM_THIS dirty_pages_len + 31) >> 5) * sizeof(Bit32u));
+  for (int i=0; i<BX_SMP_PROCESSORS; i++)
+    BX_CPU(i)->TLB_writeProtect();
+}
+
+// The RAM snapshot thread, there is only one memory to save.
+static BX_THREAD_VAR(ram_snapshot_thread);
+static BX_MUTEX(ram_snapshot_mutex);
+static Bit64u snap_saved_pages, snap_copied_pages;
+
+BX_THREAD_FUNC(ram_snapshot_thread_func, arg)
+{
+  BX_MEM(0)->write_ram_snapshot();
+  BX_THREAD_EXIT;
+}
+
+// Save the RAM image in the background while the guest continues. Only the
+// delta header is written here, at the point the rest of the machine state
+// is saved. The pages of the image are write protected in the TLBs before
+// the guest runs again and the thread saves them from the guest RAM, or from
+// the copy of the page taken when the guest wrote it first.
+bx_bool BX_MEM_C::start_ram_snapshot(FILE *fp)
+{
+  Bit64u pages = BX_MEM_THIS dirty_pages_len;
+  size_t bitmap_len = (size_t)((pages + 31) >> 5) * sizeof(Bit32u);
+
+  BX_MEM_THIS finish_ram_snapshot();
+
+  int fd = dup(fileno(fp));
+  if (fd < 0) return 0;
+  BX_MEM_THIS snap_fp = fdopen(fd, "wb");
+  if (BX_MEM_THIS snap_fp == NULL) {
+    close(fd);
+    return 0;
+  }
+  const char *dir = SIM->get_param_string(BXPN_RESTORE_PATH)->getptr();
+  BX_MEM_THIS snap_dir = new char[strlen(dir) + 1];
+  strcpy(BX_MEM_THIS snap_dir, dir);
+  BX_MEM_THIS snap_delta = (BX_MEM_THIS ram_base != NULL);
+  if (BX_MEM_THIS snap_delta && !write_ram_delta_header(BX_MEM_THIS snap_fp, BX_MEM_THIS ram_base))
+    BX_PANIC(("FATAL ERROR: Could not write incremental RAM image header!"));
+
+  BX_MEM_THIS snap_pages = new Bit32u[bitmap_len / sizeof(Bit32u)];
+  if (BX_MEM_THIS snap_delta)
+    memcpy(BX_MEM_THIS snap_pages, BX_MEM_THIS dirty_pages, bitmap_len);
+  else
+    memset(BX_MEM_THIS snap_pages, 0xff, bitmap_len);
+
+  BX_MEM_THIS snap_copy = new Bit8u*[(size_t) pages];
+  memset(BX_MEM_THIS snap_copy, 0, (size_t) pages * sizeof(Bit8u*));
+  BX_MEM_THIS snap_error = 0;
+  snap_saved_pages = snap_copied_pages = 0;
+  BX_INIT_MUTEX(ram_snapshot_mutex);
+
+  // writes to RAM copy the pages aside from now on
+  Bit32u *pending = new Bit32u[bitmap_len / sizeof(Bit32u)];
+  memcpy(pending, BX_MEM_THIS snap_pages, bitmap_len);
+  BX_MEM_THIS snap_pending = pending;
+  for (int i=0; i<BX_SMP_PROCESSORS; i++)
+    BX_CPU(i)->TLB_writeProtect();
+
+  BX_THREAD_CREATE(ram_snapshot_thread_func, NULL, ram_snapshot_thread);
+  return 1;
+}
+
+// Called before a page of RAM is written while the snapshot is saved.
+void BX_MEM_C::save_page_aside(Bit64u page)
+{
+  Bit32u *pending = &BX_MEM_THIS snap_pending[page >> 5];
+  Bit32u bit = 1 << (page & 31);
+
+  if (! (BX_ATOMIC_LOAD32(pending) & bit)) return;
+
+  BX_LOCK(ram_snapshot_mutex);
+  if (*pending & bit) {
+    Bit8u *copy = new Bit8u[4096];
+    memcpy(copy, BX_MEM_THIS vector + (page << 12), 4096);
+    BX_MEM_THIS snap_copy[page] = copy;
+    BX_ATOMIC_AND32(pending, ~bit);
+    snap_copied_pages++;
+  }
+  BX_UNLOCK(ram_snapshot_mutex);
+}
+
+// Called by the snapshot thread, the pages saved are no longer protected.
+void BX_MEM_C::copy_snapshot_pages(Bit8u *buf, Bit64u page, unsigned num_pages)
+{
+  BX_LOCK(ram_snapshot_mutex);
+  for (unsigned n=0; n < num_pages; n++, page++, buf += 4096) {
+    Bit32u *pending = &BX_MEM_THIS snap_pending[page >> 5];
+    Bit32u bit = 1 << (page & 31);
+    if (*pending & bit) {
+      memcpy(buf, BX_MEM_THIS vector + (page << 12), 4096);
+      BX_ATOMIC_AND32(pending, ~bit);
+    }
+    else {
+      memcpy(buf, BX_MEM_THIS snap_copy[page], 4096);
+      delete [] BX_MEM_THIS snap_copy[page];
+      BX_MEM_THIS snap_copy[page] = NULL;
+    }
+  }
+  BX_UNLOCK(ram_snapshot_mutex);
+}
+
+// The snapshot thread writes the same image as the synchronous save.
+void BX_MEM_C::write_ram_snapshot(void)
+{
+  const unsigned block_pages = BX_MEM_BLOCK_LEN >> 12;
+  Bit8u *buf = new Bit8u[BX_MEM_BLOCK_LEN];
+  Bit64u run[2], page = 0, pages = BX_MEM_THIS dirty_pages_len;
+  FILE *fp = BX_MEM_THIS snap_fp;
+
+  while (page < pages && !BX_MEM_THIS snap_error) {
+    if (! ((BX_MEM_THIS snap_pages[page >> 5] >> (page & 31)) & 1)) {
+      page++;
+      continue;
+    }
+    Bit64u first = page;
+    while (page < pages && ((BX_MEM_THIS snap_pages[page >> 5] >> (page & 31)) & 1))
+      page++;
+    if (BX_MEM_THIS snap_delta) {
+      run[0] = first << 12;
+      run[1] = (page - first) << 12;
+      if (fwrite(run, sizeof(run), 1, fp) != 1) {
+        BX_MEM_THIS snap_error = 1;
+        break;
+      }
+    }
+    for (Bit64u p = first; p < page; p += block_pages) {
+      unsigned num_pages = (page - p) < block_pages ? (unsigned)(page - p) : block_pages;
+      BX_MEM_THIS copy_snapshot_pages(buf, p, num_pages);
+      if (fwrite(buf, 4096, num_pages, fp) != num_pages) {
+        BX_MEM_THIS snap_error = 1;
+        break;
+      }
+      snap_saved_pages += num_pages;
+    }
+  }
+  if (fclose(fp) != 0)
+    BX_MEM_THIS snap_error = 1;
+  BX_MEM_THIS snap_fp = NULL;
+  delete [] buf;
+
+  if (BX_MEM_THIS snap_error) {
+    // stop copying pages aside, the image is lost
+    BX_LOCK(ram_snapshot_mutex);
+    memset(BX_MEM_THIS snap_pending, 0, (size_t)((pages + 31) >> 5) * sizeof(Bit32u));
+    BX_UNLOCK(ram_snapshot_mutex);
+  }
+}
+
+// Wait for the snapshot thread to save the RAM image.
+void BX_MEM_C::finish_ram_snapshot(void)
+{
+  if (BX_MEM_THIS snap_pending == NULL) return;
+
+  BX_THREAD_JOIN(ram_snapshot_thread);
+  BX_FINI_MUTEX(ram_snapshot_mutex);
+
+  for (Bit64u page = 0; page < BX_MEM_THIS dirty_pages_len; page++)
+    delete [] BX_MEM_THIS snap_copy[page];
+  delete [] BX_MEM_THIS snap_copy;
+  BX_MEM_THIS snap_copy = NULL;
+  delete [] BX_MEM_THIS snap_pages;
+  BX_MEM_THIS snap_pages = NULL;
+  delete [] BX_MEM_THIS snap_pending;
+  BX_MEM_THIS snap_pending = NULL;
+
+  if (BX_MEM_THIS snap_error) {
+    // The state is unusable and may be the base of the next image already.
+    // Rename its folder, the next image is saved in full.
+    char invalid[BX_PATHNAME_LEN];
+    snprintf(invalid, BX_PATHNAME_LEN, "%s.invalid", BX_MEM_THIS snap_dir);
+    if (rename(BX_MEM_THIS snap_dir, invalid) == 0)
+      BX_ERROR(("could not write the RAM image saved in the background, renamed '%s' to '%s'",
+                BX_MEM_THIS snap_dir, invalid));
+    else
+      BX_ERROR(("could not write the RAM image saved in the background, '%s' is invalid",
+                BX_MEM_THIS snap_dir));
+    delete [] BX_MEM_THIS ram_base;
+    BX_MEM_THIS ram_base = NULL;
+  }
+  else {
+    BX_INFO(("saved " FMT_LL "u RAM pages in the background, " FMT_LL "u of them copied aside",
+             snap_saved_pages, snap_copied_pages));
+  }
+  delete [] BX_MEM_THIS snap_dir;
+  BX_MEM_THIS snap_dir = NULL;
+}
+
 BX_MEM_C::~BX_MEM_C()
 {
 #if BX_LARGE_RAMFILE
@@ -95,14 +594,22 @@ void BX_MEM_C::init_memory(Bit64u guest, Bit64u host)
 
   if (BX_MEM_THIS actual_vector != NULL) {
     BX_INFO(("freeing existing memory vector"));
-    delete [] BX_MEM_THIS actual_vector;
-    BX_MEM_THIS actual_vector = NULL;
-    BX_MEM_THIS vector = NULL;
+    finish_ram_snapshot();
+    free_vector();
     BX_MEM_THIS blocks = NULL;
   }
-  BX_MEM_THIS vector = alloc_vector_aligned(host + BIOSROMSZ + EXROMSIZE + 4096, BX_MEM_VECTOR_ALIGN);
-  BX_INFO(("allocated memory at %p. after alignment, vector=%p",
-        BX_MEM_THIS actual_vector, BX_MEM_THIS vector));
+  // map the whole guest RAM if possible, host memory is committed on demand
+  // and neither host memory size limit nor ramfile swapping is needed
+  BX_MEM_THIS vector = alloc_vector_mapped(guest + BIOSROMSZ + EXROMSIZE + 4096);
+  if (BX_MEM_THIS vector != NULL) {
+    host = guest;
+    BX_INFO(("mapped memory at %p", BX_MEM_THIS vector));
+  }
+  else {
+    BX_MEM_THIS vector = alloc_vector_aligned(host + BIOSROMSZ + EXROMSIZE + 4096, BX_MEM_VECTOR_ALIGN);
+    BX_INFO(("allocated memory at %p. after alignment, vector=%p",
+          BX_MEM_THIS actual_vector, BX_MEM_THIS vector));
+  }
 
   BX_MEM_THIS len = guest;
   BX_MEM_THIS allocated = host;
@@ -117,8 +624,8 @@ void BX_MEM_C::init_memory(Bit64u guest, Bit64u host)
   BX_INFO(("%.2fMB", (float)(BX_MEM_THIS len / (1024.0*1024.0))));
   BX_INFO(("mem block size = 0x%08x, blocks=%u", BX_MEM_BLOCK_LEN, num_blocks));
   BX_MEM_THIS blocks = new Bit8u* [num_blocks];
-  if (0) {
-    // all guest memory is allocated, just map it
+  if (BX_MEM_THIS mapped_len) {
+    // all guest memory is mapped, just assign the blocks
     for (idx = 0; idx < num_blocks; idx++) {
       BX_MEM_THIS blocks[idx] = BX_MEM_THIS vector + (idx * BX_MEM_BLOCK_LEN);
     }
@@ -149,6 +656,26 @@ void BX_MEM_C::init_memory(Bit64u guest, Bit64u host)
     BX_MEM_THIS memory_type[i][1] = 0;
   }
 
+  // the memory map covers the RAM and the 4G address space, it is extended
+  // when memory handlers are registered above
+  BX_MEM_THIS regions = new struct memory_region_struct[BX_MEM_MAX_REGIONS];
+  memset(BX_MEM_THIS regions, 0, 2 * sizeof(struct memory_region_struct));
+  BX_MEM_THIS regions[BX_MEM_REGION_RAM].read  = BX_MEM_PAGE_RAM;
+  BX_MEM_THIS regions[BX_MEM_REGION_RAM].write = BX_MEM_PAGE_RAM;
+  BX_MEM_THIS regions[BX_MEM_REGION_NONE].read  = BX_MEM_PAGE_NONE;
+  BX_MEM_THIS regions[BX_MEM_REGION_NONE].write = BX_MEM_PAGE_NONE;
+  BX_MEM_THIS num_regions = 2;
+  BX_MEM_THIS alloc_page_map(((BX_MEM_THIS len > BX_CONST64(0x100000000)) ?
+                              BX_MEM_THIS len : BX_CONST64(0x100000000)) >> 12);
+
+  // all pages are dirty until a RAM image is saved as base of the next one
+  delete [] BX_MEM_THIS dirty_pages;
+  BX_MEM_THIS dirty_pages_len = BX_MEM_THIS len >> 12;
+  BX_MEM_THIS dirty_pages = new Bit32u[(size_t)((BX_MEM_THIS dirty_pages_len + 31) >> 5)];
+  memset(BX_MEM_THIS dirty_pages, 0xff, (size_t)((BX_MEM_THIS dirty_pages_len + 31) >> 5) * sizeof(Bit32u));
+  delete [] BX_MEM_THIS ram_base;
+  BX_MEM_THIS ram_base = NULL;
+
   BX_MEM_THIS register_state();
 }
 
@@ -252,6 +779,33 @@ void ramfile_save_handler(void *devptr, FILE *fp)
 }
 #endif
 
+// The mapped guest RAM is saved as a plain image in guest physical order,
+// or as a delta to the base image if the dirty pages are tracked. Live
+// saving leaves writing the image to the snapshot thread.
+void ram_image_save_handler(void *devptr, FILE *fp)
+{
+  if (BX_MEM(0)->save_live && BX_MEM(0)->start_ram_snapshot(fp))
+    return;
+
+  // the base image must be complete
+  BX_MEM(0)->finish_ram_snapshot();
+
+  if (BX_MEM(0)->ram_base != NULL) {
+    BX_MEM(0)->save_ram_delta(fp);
+    return;
+  }
+
+  for (Bit64u offset = 0; offset < BX_MEM(0)->len; offset += BX_MEM_BLOCK_LEN) {
+    if (1 != fwrite(BX_MEM(0)->vector + offset, BX_MEM_BLOCK_LEN, 1, fp))
+      BX_PANIC(("FATAL ERROR: Could not write at 0x" FMT_LL "x in saved RAM image!", offset));
+  }
+}
+
+void ram_image_restore_handler(void *devptr, FILE *fp)
+{
+  BX_MEM(0)->restore_ram_image(fp);
+}
+
 // Note: This must be called before the memory file save handler is called.
 Bit64s memory_param_save_handler(void *devptr, bx_param_c *param)
 {
@@ -278,6 +832,12 @@ void memory_param_restore_handler(void *devptr, bx_param_c *param, Bit64s val)
   const char *pname = param->get_name();
   if (! strncmp(pname, "blk", 3)) {
     Bit32u blk_index = atoi(pname + 3);
+    if (BX_MEM(0)->mapped_len) {
+      // the saved RAM image was loaded by ram_image_restore_handler(),
+      // the mapped guest RAM keeps the blocks in place
+      BX_MEM(0)->blocks[blk_index] = BX_MEM(0)->vector + blk_index * BX_MEM_BLOCK_LEN;
+      return;
+    }
 #if BX_LARGE_RAMFILE
     if ((Bit32s) val == -2) {
       BX_MEM(0)->blocks[blk_index] = BX_MEM(0)->swapped_out;
@@ -295,18 +855,30 @@ void memory_param_restore_handler(void *devptr, bx_param_c *param, Bit64s val)
   }
 }
 
+void memtype_restore_handler(void *devptr, bx_list_c *list)
+{
+  BX_MEM(0)->update_page_map(0x000c0000, 0x000fffff);
+}
+
 void BX_MEM_C::register_state()
 {
   char param_name[15];
 
   bx_list_c *list = new bx_list_c(SIM->get_bochs_root(), "memory", "Memory State");
   Bit32u num_blocks = (Bit32u)(BX_MEM_THIS len / BX_MEM_BLOCK_LEN);
+  if (BX_MEM_THIS mapped_len) {
+    // no backing store, the handlers save and load the RAM image directly
+    bx_shadow_filedata_c *ramfile = new bx_shadow_filedata_c(list, "ram", NULL);
+    ramfile->set_sr_handlers(this, ram_image_save_handler, ram_image_restore_handler);
+  }
+  else {
 #if BX_LARGE_RAMFILE
-  bx_shadow_filedata_c *ramfile = new bx_shadow_filedata_c(list, "ram", &(BX_MEM_THIS overflow_file));
-  ramfile->set_sr_handlers(this, ramfile_save_handler, (filedata_restore_handler)NULL);
+    bx_shadow_filedata_c *ramfile = new bx_shadow_filedata_c(list, "ram", &(BX_MEM_THIS overflow_file));
+    ramfile->set_sr_handlers(this, ramfile_save_handler, (filedata_restore_handler)NULL);
 #else
-  new bx_shadow_data_c(list, "ram", BX_MEM_THIS vector, BX_MEM_THIS allocated);
+    new bx_shadow_data_c(list, "ram", BX_MEM_THIS vector, BX_MEM_THIS allocated);
 #endif
+  }
   BXRS_DEC_PARAM_FIELD(list, len, BX_MEM_THIS len);
   BXRS_DEC_PARAM_FIELD(list, allocated, BX_MEM_THIS allocated);
   BXRS_DEC_PARAM_FIELD(list, used_blocks, BX_MEM_THIS used_blocks);
@@ -319,6 +891,7 @@ void BX_MEM_C::register_state()
     param->set_sr_handlers(this, memory_param_save_handler, memory_param_restore_handler);
   }
   bx_list_c *memtype = new bx_list_c(list, "memtype");
+  memtype->set_restore_handler(this, memtype_restore_handler);
   for (int i = 0; i <= BX_MEM_AREA_F0000; i++) {
     sprintf(param_name, "%d_r", i);
     new bx_shadow_bool_c(memtype, param_name, &BX_MEM_THIS memory_type[i][0]);
@@ -332,9 +905,8 @@ void BX_MEM_C::cleanup_memory()
   unsigned idx;
 
   if (BX_MEM_THIS vector != NULL) {
-    delete [] BX_MEM_THIS actual_vector;
-    BX_MEM_THIS actual_vector = NULL;
-    BX_MEM_THIS vector = NULL;
+    finish_ram_snapshot();
+    free_vector();
     BX_MEM_THIS rom = NULL;
     BX_MEM_THIS bogus = NULL;
     delete [] BX_MEM_THIS blocks;
@@ -353,6 +925,17 @@ void BX_MEM_C::cleanup_memory()
       delete [] BX_MEM_THIS memory_handlers;
       BX_MEM_THIS memory_handlers = NULL;
     }
+    delete [] BX_MEM_THIS page_map;
+    BX_MEM_THIS page_map = NULL;
+    BX_MEM_THIS map_pages = 0;
+    delete [] BX_MEM_THIS regions;
+    BX_MEM_THIS regions = NULL;
+    BX_MEM_THIS num_regions = 0;
+    delete [] BX_MEM_THIS dirty_pages;
+    BX_MEM_THIS dirty_pages = NULL;
+    BX_MEM_THIS dirty_pages_len = 0;
+    delete [] BX_MEM_THIS ram_base;
+    BX_MEM_THIS ram_base = NULL;
   }
 }
 
@@ -621,6 +1204,8 @@ bx_bool BX_MEM_C::dbg_set_mem(bx_phy_address addr, unsigned len, Bit8u *buf)
     return(0); // error, beyond limits of memory
   }
   for (; len>0; len--) {
+    if (addr < BX_MEM_THIS len)
+      BX_MEM_THIS set_dirty_page(addr);
     // Write to standard PCI/ISA Video Mem / SMMRAM
     if (addr >= 0x000a0000 && addr < 0x000c0000) {
       if (BX_MEM_THIS smram_enable)
@@ -699,22 +1284,15 @@ bx_bool BX_MEM_C::dbg_crc32(bx_phy_address addr1, bx_phy_address addr2, Bit32u *
 Bit8u *BX_MEM_C::getHostMemAddr(BX_CPU_C *cpu, bx_phy_address addr, unsigned rw)
 {
   bx_phy_address a20addr = A20ADDR(addr);
-
-  bx_bool is_bios = (a20addr >= (bx_phy_address)~BIOS_MASK);
-#if BX_PHY_ADDRESS_LONG
-  if (a20addr > BX_CONST64(0xffffffff)) is_bios = 0;
-#endif
+  const struct memory_region_struct *region = BX_MEM_THIS get_region(a20addr);
 
   bx_bool write = rw & 1;
 
   // allow direct access to SMRAM memory space for code and veto data
-  if ((cpu != NULL) && (rw == BX_EXECUTE)) {
+  if ((cpu != NULL) && (rw == BX_EXECUTE) && region->smram_smm) {
     // reading from SMRAM memory space
-    if ((a20addr >= 0x000a0000 && a20addr < 0x000c0000) && (BX_MEM_THIS smram_available))
-    {
-      if (BX_MEM_THIS smram_enable || cpu->smm_mode())
-        return BX_MEM_THIS get_vector(a20addr);
-    }
+    if ((cpu->smm_mode() ? region->smram_smm : region->smram) & SMRAM_CODE)
+      return BX_MEM_THIS get_vector(a20addr);
   }
 
 #if BX_SUPPORT_MONITOR_MWAIT
@@ -724,93 +1302,45 @@ Bit8u *BX_MEM_C::getHostMemAddr(BX_CPU_C *cpu, bx_phy_address addr, unsigned rw)
   }
 #endif
 
-  struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handlers[a20addr >> 20];
-  while (memory_handler) {
-    if (memory_handler->begin <= a20addr &&
-        memory_handler->end >= a20addr) {
-      if (memory_handler->da_handler)
-        return memory_handler->da_handler(a20addr, rw, memory_handler->param);
-      else
-        return(NULL); // Vetoed! memory handler for i/o apic, vram, mmio and PCI PnP
-    }
-    memory_handler = memory_handler->next;
+  struct memory_handler_struct *memory_handler = region->handler;
+  if (memory_handler && memory_handler->begin <= a20addr && memory_handler->end >= a20addr) {
+    if (memory_handler->da_handler)
+      return memory_handler->da_handler(a20addr, rw, memory_handler->param);
+    else
+      return(NULL); // Vetoed! memory handler for i/o apic, vram, mmio and PCI PnP
   }
 
   if (! write) {
-    if ((a20addr >= 0x000a0000 && a20addr < 0x000c0000))
-      return(NULL); // Vetoed!  Mem mapped IO (VGA)
-#if BX_SUPPORT_PCI
-    else if (BX_MEM_THIS pci_enabled && (a20addr >= 0x000c0000 && a20addr < 0x00100000)) {
-      unsigned area = (unsigned)(a20addr >> 14) & 0x0f;
-      if (area > BX_MEM_AREA_F0000) area = BX_MEM_AREA_F0000;
-      if (BX_MEM_THIS memory_type[area][0] == 0) {
-        // Read from ROM
-        if ((a20addr & 0xfffe0000) == 0x000e0000) {
-          // last 128K of BIOS ROM mapped to 0xE0000-0xFFFFF
-          return (Bit8u *) &BX_MEM_THIS rom[BIOS_MAP_LAST128K(a20addr)];
-        } else {
-          return (Bit8u *) &BX_MEM_THIS rom[(a20addr & EXROM_MASK) + BIOSROMSZ];
-        }
-      } else {
-        // Read from ShadowRAM
+    switch (region->read) {
+      case BX_MEM_PAGE_RAM:
         return BX_MEM_THIS get_vector(a20addr);
-      }
-    }
-#endif
-    else if(a20addr < BX_MEM_THIS len && ! is_bios)
-    {
-      if (a20addr < 0x000c0000 || a20addr >= 0x00100000) {
-        return BX_MEM_THIS get_vector(a20addr);
-      }
-      // must be in C0000 - FFFFF range
-      else if ((a20addr & 0xfffe0000) == 0x000e0000) {
+      case BX_MEM_PAGE_CPU_RAM:
+        return(NULL); // Vetoed!  Mem mapped IO (VGA)
+      case BX_MEM_PAGE_EXROM:
+        return (Bit8u *) &BX_MEM_THIS rom[(a20addr & EXROM_MASK) + BIOSROMSZ];
+      case BX_MEM_PAGE_BIOS_LOW:
         // last 128K of BIOS ROM mapped to 0xE0000-0xFFFFF
         return (Bit8u *) &BX_MEM_THIS rom[BIOS_MAP_LAST128K(a20addr)];
-      }
-      else {
-        return((Bit8u *) &BX_MEM_THIS rom[(a20addr & EXROM_MASK) + BIOSROMSZ]);
-      }
-    }
-#if BX_PHY_ADDRESS_LONG
-    else if (a20addr > BX_CONST64(0xffffffff)) {
-      // Error, requested addr is out of bounds.
-      return (Bit8u *) &BX_MEM_THIS bogus[a20addr & 0xfff];
-    }
-#endif
-    else if (a20addr >= (bx_phy_address)~BIOS_MASK)
-    {
-      return (Bit8u *) &BX_MEM_THIS rom[a20addr & BIOS_MASK];
-    }
-    else
-    {
-      // Error, requested addr is out of bounds.
-      return (Bit8u *) &BX_MEM_THIS bogus[a20addr & 0xfff];
+      case BX_MEM_PAGE_BIOS:
+        return (Bit8u *) &BX_MEM_THIS rom[a20addr & BIOS_MASK];
+      default:
+        // Error, requested addr is out of bounds.
+        return (Bit8u *) &BX_MEM_THIS bogus[a20addr & 0xfff];
     }
   }
   else
   { // op == {BX_WRITE, BX_RW}
-    if (a20addr >= BX_MEM_THIS len || is_bios)
-      return(NULL); // Error, requested addr is out of bounds.
-    else if (a20addr >= 0x000a0000 && a20addr < 0x000c0000)
-      return(NULL); // Vetoed!  Mem mapped IO (VGA)
-#if BX_SUPPORT_PCI
-    else if (BX_MEM_THIS pci_enabled && (a20addr >= 0x000c0000 && a20addr < 0x00100000))
-    {
-      // Veto direct writes to this area. Otherwise, there is a chance
-      // for Guest2HostTLB and memory consistency problems, for example
-      // when some 16K block marked as write-only using PAM registers.
-      return(NULL);
+    // Veto direct writes to VGA memory, ROMs and shadow RAM. Otherwise, there
+    // is a chance for Guest2HostTLB and memory consistency problems, for
+    // example when some 16K block marked as write-only using PAM registers.
+    // The page is marked dirty in advance, all writes through the returned
+    // pointer are covered until the dirty page tracking is restarted.
+    if (region->write == BX_MEM_PAGE_RAM) {
+      BX_MEM_THIS set_dirty_page(a20addr);
+      return BX_MEM_THIS get_vector(a20addr);
     }
-#endif
     else
-    {
-      if (a20addr < 0x000c0000 || a20addr >= 0x00100000) {
-        return BX_MEM_THIS get_vector(a20addr);
-      }
-      else {
-        return(NULL);  // Vetoed!  ROMs
-      }
-    }
+      return(NULL);
   }
 }
 
@@ -838,6 +1368,7 @@ BX_MEM_C::registerMemoryHandlers(void *param, memory_handler_t read_handler,
     if (BX_MEM_THIS memory_handlers[page_idx] != NULL) {
       if ((bitmap & BX_MEM_THIS memory_handlers[page_idx]->bitmap) != 0) {
         BX_ERROR(("Register failed: overlapping memory handlers!"));
+        BX_MEM_THIS update_page_map(begin_addr, end_addr);
         return 0;
       } else {
         bitmap |= BX_MEM_THIS memory_handlers[page_idx]->bitmap;
@@ -854,6 +1385,9 @@ BX_MEM_C::registerMemoryHandlers(void *param, memory_handler_t read_handler,
     memory_handler->end = end_addr;
     memory_handler->bitmap = bitmap;
   }
+  if ((Bit64u)(end_addr >> 12) >= BX_MEM_THIS map_pages)
+    BX_MEM_THIS alloc_page_map((Bit64u)(end_addr >> 12) + 1);
+  BX_MEM_THIS update_page_map(begin_addr, end_addr);
   return 1;
 }
 
@@ -891,14 +1425,170 @@ BX_MEM_C::unregisterMemoryHandlers(void *param, bx_phy_address begin_addr, bx_ph
       BX_MEM_THIS memory_handlers[page_idx] = memory_handler->next;
     delete memory_handler;
   }
+  BX_MEM_THIS update_page_map(begin_addr, end_addr);
   return ret;
 }
 
+void BX_MEM_C::alloc_page_map(Bit64u pages)
+{
+  Bit32u old_pages = BX_MEM_THIS map_pages;
+  Bit16u *page_map = new Bit16u[(size_t) pages];
+
+  if (BX_MEM_THIS page_map != NULL) {
+    memcpy(page_map, BX_MEM_THIS page_map, old_pages * sizeof(Bit16u));
+    delete [] BX_MEM_THIS page_map;
+  }
+  BX_MEM_THIS page_map = page_map;
+  BX_MEM_THIS map_pages = (Bit32u) pages;
+  BX_MEM_THIS update_page_map((bx_phy_address)((Bit64u) old_pages << 12),
+                              (bx_phy_address)((pages << 12) - 1));
+}
+
+// Resolve the memory handler and the memory types of a page with the same
+// rules the physical memory accesses used to check on every access.
+void BX_MEM_C::resolve_page(bx_phy_address addr, struct memory_region_struct *region)
+{
+  memset(region, 0, sizeof(struct memory_region_struct));
+
+  // overlapping handlers are not allowed, a page has one handler at most
+  struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handlers[addr >> 20];
+  while (memory_handler) {
+    if (memory_handler->begin <= (addr | 0xfff) && memory_handler->end >= addr) {
+      region->handler = memory_handler;
+      break;
+    }
+    memory_handler = memory_handler->next;
+  }
+
+  bx_bool is_bios = (addr >= (bx_phy_address)~BIOS_MASK);
+#if BX_PHY_ADDRESS_LONG
+  if (addr > BX_CONST64(0xffffffff)) is_bios = 0;
+#endif
+
+  if (addr < BX_MEM_THIS len && ! is_bios) {
+    if (addr >= 0x000a0000 && addr < 0x000c0000) {
+      // Standard PCI/ISA Video Mem / SMMRAM
+      region->read = region->write = BX_MEM_PAGE_CPU_RAM;
+      if (BX_MEM_THIS smram_available) {
+        if (BX_MEM_THIS smram_enable) {
+          region->smram = region->smram_smm = SMRAM_CODE | SMRAM_DATA;
+        } else {
+          region->smram_smm = BX_MEM_THIS smram_restricted ? SMRAM_CODE : (SMRAM_CODE | SMRAM_DATA);
+        }
+      }
+    }
+    else if (addr >= 0x000c0000 && addr < 0x00100000) {
+      // adapter ROM     C0000 .. DFFFF
+      // ROM BIOS memory E0000 .. FFFFF
+      region->read = (addr >= 0x000e0000) ? BX_MEM_PAGE_BIOS_LOW : BX_MEM_PAGE_EXROM;
+      region->write = BX_MEM_PAGE_NONE;
+#if BX_SUPPORT_PCI
+      // Based on 440fx Programming
+      if (BX_MEM_THIS pci_enabled) {
+        unsigned area = (unsigned)(addr >> 14) & 0x0f;
+        if (area > BX_MEM_AREA_F0000) area = BX_MEM_AREA_F0000;
+        if (BX_MEM_THIS memory_type[area][0] == 1)
+          region->read = BX_MEM_PAGE_RAM;
+        if (BX_MEM_THIS memory_type[area][1] == 1)
+          region->write = BX_MEM_PAGE_SHADOW;
+        else if ((area >= BX_MEM_AREA_E0000) && BX_MEM_THIS bios_write_enabled)
+          region->write = BX_MEM_PAGE_BIOS_LOW;
+      }
+#endif
+    }
+    else {
+      region->read = region->write = BX_MEM_PAGE_RAM;
+    }
+  }
+  else if (is_bios) {
+    region->read = BX_MEM_PAGE_BIOS;
+    // volatile BIOS write support
+    region->write = BX_MEM_THIS bios_write_enabled ? BX_MEM_PAGE_BIOS : BX_MEM_PAGE_NONE;
+  }
+  else {
+    region->read = region->write = BX_MEM_PAGE_NONE;
+  }
+}
+
+Bit16u BX_MEM_C::get_region_index(const struct memory_region_struct *region)
+{
+  unsigned n;
+
+  for (n = 0; n < BX_MEM_THIS num_regions; n++) {
+    if (! memcmp(&BX_MEM_THIS regions[n], region, sizeof(struct memory_region_struct)))
+      return n;
+  }
+
+  if (BX_MEM_THIS num_regions == BX_MEM_MAX_REGIONS) {
+    BX_MEM_THIS compact_regions();
+    if (BX_MEM_THIS num_regions == BX_MEM_MAX_REGIONS)
+      BX_PANIC(("FATAL ERROR: too many physical memory regions"));
+  }
+  BX_MEM_THIS regions[BX_MEM_THIS num_regions] = *region;
+  return BX_MEM_THIS num_regions++;
+}
+
+// Drop the region descriptors of unregistered memory handlers and of the
+// old PAM or SMRAM state which are not referenced by any page anymore.
+void BX_MEM_C::compact_regions(void)
+{
+  Bit16u *remap = new Bit16u[BX_MEM_MAX_REGIONS];
+  Bit32u page;
+  unsigned n, count = 2;
+
+  // the RAM and no memory regions keep their indices
+  remap[BX_MEM_REGION_RAM] = BX_MEM_REGION_RAM;
+  remap[BX_MEM_REGION_NONE] = BX_MEM_REGION_NONE;
+  for (n = 2; n < BX_MEM_THIS num_regions; n++)
+    remap[n] = 0xffff;
+  for (page = 0; page < BX_MEM_THIS map_pages; page++) {
+    if (BX_MEM_THIS page_map[page] >= 2)
+      remap[BX_MEM_THIS page_map[page]] = 0;
+  }
+  for (n = 2; n < BX_MEM_THIS num_regions; n++) {
+    if (remap[n] != 0xffff) {
+      BX_MEM_THIS regions[count] = BX_MEM_THIS regions[n];
+      remap[n] = count++;
+    }
+  }
+  for (page = 0; page < BX_MEM_THIS map_pages; page++)
+    BX_MEM_THIS page_map[page] = remap[BX_MEM_THIS page_map[page]];
+
+  BX_MEM_THIS num_regions = count;
+  delete [] remap;
+}
+
+// Rebuild the memory map for the pages of a physical address range, called
+// when memory handlers are registered or removed and when the PAM, SMRAM or
+// BIOS write state changes.
+void BX_MEM_C::update_page_map(bx_phy_address begin_addr, bx_phy_address end_addr)
+{
+  struct memory_region_struct region, prev;
+  Bit16u index = BX_MEM_REGION_NONE;
+
+  if (BX_MEM_THIS page_map == NULL) return;
+
+  Bit64u first = begin_addr >> 12, last = end_addr >> 12;
+  if (last >= BX_MEM_THIS map_pages)
+    last = BX_MEM_THIS map_pages - 1;
+
+  for (Bit64u page = first; page <= last; page++) {
+    BX_MEM_THIS resolve_page((bx_phy_address)(page << 12), &region);
+    // neighbour pages mostly resolve to the same region
+    if (page == first || memcmp(&region, &prev, sizeof(struct memory_region_struct))) {
+      index = BX_MEM_THIS get_region_index(&region);
+      prev = region;
+    }
+    BX_MEM_THIS page_map[page] = index;
+  }
+}
+
 void BX_MEM_C::enable_smram(bx_bool enable, bx_bool restricted)
 {
   BX_MEM_THIS smram_available = 1;
   BX_MEM_THIS smram_enable = (enable > 0);
   BX_MEM_THIS smram_restricted = (restricted > 0);
+  BX_MEM_THIS update_page_map(0x000a0000, 0x000bffff);
 }
 
 void BX_MEM_C::disable_smram(void)
@@ -906,6 +1596,7 @@ void BX_MEM_C::disable_smram(void)
   BX_MEM_THIS smram_available  = 0;
   BX_MEM_THIS smram_enable     = 0;
   BX_MEM_THIS smram_restricted = 0;
+  BX_MEM_THIS update_page_map(0x000a0000, 0x000bffff);
 }
 
 // check if SMRAM is aavailable for CPU data accesses
@@ -919,12 +1610,15 @@ void BX_MEM_C::set_memory_type(memory_area_t area, bx_bool rw, bx_bool dram)
 {
   if (area <= BX_MEM_AREA_F0000) {
     BX_MEM_THIS memory_type[area][rw] = dram;
+    BX_MEM_THIS update_page_map(0x000c0000, 0x000fffff);
   }
 }
 
 void BX_MEM_C::set_bios_write(bx_bool enabled)
 {
   BX_MEM_THIS bios_write_enabled = enabled;
+  BX_MEM_THIS update_page_map(0x000e0000, 0x000fffff);
+  BX_MEM_THIS update_page_map((bx_phy_address)~BIOS_MASK, 0xffffffff);
 }
 
 #if BX_SUPPORT_MONITOR_MWAIT
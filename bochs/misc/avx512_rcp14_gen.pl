@@ -0,0 +1,97 @@
+#!/usr/bin/perl
+#
+# $Id$
+#
+# Computes the VRCP14/VRSQRT14 interpolation coefficients of
+# cpu/avx/avx512_rcp14.h and cpu/avx/avx512_rsqrt14.h from the original
+# lookup tables.
+#
+# usage: perl misc/avx512_rcp14_gen.pl misc/avx512_rcp14_tables.h
+#
+# Every table is split into intervals of 1024 entries. For each interval the
+# script finds the integer slope M and base C so that
+#
+#   table[i] == (C - M * (i & 0x3ff)) >> 9
+#
+# holds for every entry of the interval, and fails if there is none.
+#
+
+use strict;
+use warnings;
+
+my $SEGMENT = 1024;
+my $SHIFT = 9;
+
+my %tables;
+my $name;
+
+while (<>) {
+  if (/^static const Bit16u (\w+)\[\d+\] = \{/) {
+    $name = $1;
+    $tables{$name} = [];
+    next;
+  }
+  if (defined $name) {
+    if (/^\};/) {
+      undef $name;
+      next;
+    }
+    s|//.*||;
+    push @{$tables{$name}}, map { hex } /0x([0-9a-fA-F]+)/g;
+  }
+}
+
+# returns (M, C) with the smallest C for the slope closest to the secant
+sub solve_segment {
+  my @seg = @_;
+  my $scale = 1 << $SHIFT;
+  my $estimate = int(($seg[0] - $seg[-1]) / ($#seg) * $scale);
+
+  for (my $d = 0; $d < 4 * $scale + 50; $d++) {
+    foreach my $m ($estimate + $d, $estimate - $d) {
+      my ($lo, $hi);
+      for (my $j = 0; $j <= $#seg; $j++) {
+        my $min = $seg[$j] * $scale + $m * $j;
+        my $max = ($seg[$j] + 1) * $scale - 1 + $m * $j;
+        $lo = $min if (!defined $lo || $min > $lo);
+        $hi = $max if (!defined $hi || $max < $hi);
+      }
+      return ($m, $lo) if ($lo <= $hi);
+    }
+  }
+
+  return ();
+}
+
+sub print_array {
+  my ($type, $name, $digits, @values) = @_;
+
+  print "static const $type ${name}[" . scalar(@values) . "] = {\n";
+  for (my $n = 0; $n < @values; $n += 8) {
+    my $last = $n + 7;
+    $last = $#values if ($last > $#values);
+    print "    " . join(", ", map { sprintf("0x%0${digits}x", $_) } @values[$n..$last]);
+    print (($last == $#values) ? "\n" : ",\n");
+  }
+  print "};\n\n";
+}
+
+foreach my $table (['rcp14_table', 'rcp14_base', 'rcp14_slope'],
+                   ['rsqrt14_table0', 'rsqrt14_base0', 'rsqrt14_slope0'],
+                   ['rsqrt14_table1', 'rsqrt14_base1', 'rsqrt14_slope1'])
+{
+  my ($src, $base_name, $slope_name) = @$table;
+  my $values = $tables{$src} or die "table $src not found\n";
+  my (@base, @slope);
+
+  for (my $s = 0; $s < @$values; $s += $SEGMENT) {
+    my ($m, $c) = solve_segment(@$values[$s .. $s + $SEGMENT - 1]);
+    die "$src: no exact interpolation for entries $s.." . ($s + $SEGMENT - 1) . "\n"
+      unless defined $c;
+    push @base, $c;
+    push @slope, $m;
+  }
+
+  print_array('Bit32u', $base_name, 7, @base);
+  print_array('Bit16u', $slope_name, 3, @slope);
+}
@@ -0,0 +1,342 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2020  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+//
+// bench-timers.cc
+//
+// Micro-benchmark of the timer scheduler in pc_system.cc. It registers N
+// timers and reports the scheduler cost per fired timer for the old
+// scheduler, which scanned every timer slot on each expiry, and for the
+// min-heap used now.
+//
+// Half of the timers are continuous, the other half are one-shot timers
+// re-armed with a new period from their callback, like most device
+// timers. Both schedulers run the same sequence and must fire the same
+// timers at the same ticks.
+//
+// The real bx_pc_system_c cannot be linked without the rest of Bochs, so
+// both schedulers are copies of the countdownEvent() / activate_timer_ticks()
+// logic of pc_system.cc. Keep the heap version in sync with it.
+//
+// Build and run with "make bench-timers" in the build folder, optionally
+// followed by "./bench-timers <timers> ..." for other timer counts.
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "bochs.h"
+#include <time.h>
+
+#define NullTimerInterval 0xffffffff
+
+struct bench_timer_t {
+  Bit64u  period;
+  Bit64u  timeToFire;
+  bx_bool active;
+  bx_bool continuous;
+  int     heapIndex;
+};
+
+static Bit32u rnd_state = 1;
+
+// xorshift, both schedulers see the same sequence
+static Bit32u rnd(void)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return rnd_state;
+}
+
+static Bit64u rnd_period(void)
+{
+  return 100 + (rnd() % 20000);
+}
+
+class bench_scheduler_c {
+public:
+  bench_timer_t *timer;
+  unsigned numTimers;
+  Bit32u   currCountdown;
+  Bit32u   currCountdownPeriod;
+  Bit64u   ticksTotal;
+  Bit64u   events;
+  Bit64u   checksum;
+
+  bench_scheduler_c(unsigned n) {
+    timer = new bench_timer_t[n + 1];
+    memset(timer, 0, (n + 1) * sizeof(bench_timer_t));
+    numTimers = n + 1;
+    ticksTotal = 0;
+    currCountdown = currCountdownPeriod = NullTimerInterval;
+    events = checksum = 0;
+    // timer 0 is the null timer
+    timer[0].period = timer[0].timeToFire = NullTimerInterval;
+    timer[0].active = timer[0].continuous = 1;
+  }
+  virtual ~bench_scheduler_c() { delete [] timer; }
+
+  Bit64u time_ticks(void) {
+    return ticksTotal + Bit64u(currCountdownPeriod - currCountdown);
+  }
+
+  void fire(unsigned i) {
+    if (i == 0) return;
+    events++;
+    checksum = checksum * 31 + (i ^ ticksTotal);
+    if (! timer[i].continuous)
+      activate_timer_ticks(i, rnd_period(), 0);
+  }
+
+  void tickn(Bit32u n) {
+    while (n >= currCountdown) {
+      n -= currCountdown;
+      currCountdown = 0;
+      countdownEvent();
+    }
+    currCountdown -= n;
+  }
+
+  void skew_countdown(Bit64u ticks) {
+    if (ticks < Bit64u(currCountdown)) {
+      currCountdownPeriod -= (currCountdown - Bit32u(ticks));
+      currCountdown = Bit32u(ticks);
+    }
+  }
+
+  virtual void activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool continuous) = 0;
+  virtual void countdownEvent(void) = 0;
+};
+
+// the scheduler before the timer heap: every expiry scans all slots
+class bench_linear_c : public bench_scheduler_c {
+public:
+  bx_bool *triggered;
+
+  bench_linear_c(unsigned n): bench_scheduler_c(n) {
+    triggered = new bx_bool[numTimers];
+  }
+  virtual ~bench_linear_c() { delete [] triggered; }
+
+  virtual void activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool continuous) {
+    timer[i].period = ticks;
+    timer[i].timeToFire = time_ticks() + ticks;
+    timer[i].active = 1;
+    timer[i].continuous = continuous;
+    skew_countdown(ticks);
+  }
+
+  virtual void countdownEvent(void) {
+    unsigned i, first = numTimers, last = 0;
+    Bit64u minTimeToFire = (Bit64u) -1;
+
+    ticksTotal += Bit64u(currCountdownPeriod);
+
+    for (i = 0; i < numTimers; i++) {
+      triggered[i] = 0;
+      if (timer[i].active) {
+        if (ticksTotal == timer[i].timeToFire) {
+          triggered[i] = 1;
+          if (timer[i].continuous==0) {
+            timer[i].active = 0;
+          } else {
+            timer[i].timeToFire += timer[i].period;
+            if (timer[i].timeToFire < minTimeToFire)
+              minTimeToFire = timer[i].timeToFire;
+          }
+          if (i < first) first = i;
+          last = i;
+        } else {
+          if (timer[i].timeToFire < minTimeToFire)
+            minTimeToFire = timer[i].timeToFire;
+        }
+      }
+    }
+
+    currCountdown = currCountdownPeriod = Bit32u(minTimeToFire - ticksTotal);
+
+    for (i = first; i <= last; i++) {
+      if (triggered[i]) fire(i);
+    }
+  }
+};
+
+// the current scheduler: active timers in a min-heap by time to fire
+class bench_heap_c : public bench_scheduler_c {
+public:
+  unsigned *timerHeap;
+  unsigned  heapSize;
+  unsigned *triggered;
+
+  bench_heap_c(unsigned n): bench_scheduler_c(n) {
+    timerHeap = new unsigned[numTimers];
+    triggered = new unsigned[numTimers];
+    heapSize = 0;
+    for (unsigned i = 0; i < numTimers; i++)
+      timer[i].heapIndex = -1;
+    heap_insert(0);
+  }
+  virtual ~bench_heap_c() {
+    delete [] timerHeap;
+    delete [] triggered;
+  }
+
+  bx_bool timer_before(unsigned a, unsigned b) {
+    return (timer[a].timeToFire < timer[b].timeToFire) ||
+           (timer[a].timeToFire == timer[b].timeToFire && a < b);
+  }
+
+  void heap_sift_up(unsigned pos) {
+    unsigned i = timerHeap[pos];
+    while (pos > 0) {
+      unsigned parent = (pos - 1) / 2;
+      if (! timer_before(i, timerHeap[parent])) break;
+      timerHeap[pos] = timerHeap[parent];
+      timer[timerHeap[pos]].heapIndex = pos;
+      pos = parent;
+    }
+    timerHeap[pos] = i;
+    timer[i].heapIndex = pos;
+  }
+
+  void heap_sift_down(unsigned pos) {
+    unsigned i = timerHeap[pos];
+    for (;;) {
+      unsigned child = 2 * pos + 1;
+      if (child >= heapSize) break;
+      if (child + 1 < heapSize && timer_before(timerHeap[child + 1], timerHeap[child]))
+        child++;
+      if (! timer_before(timerHeap[child], i)) break;
+      timerHeap[pos] = timerHeap[child];
+      timer[timerHeap[pos]].heapIndex = pos;
+      pos = child;
+    }
+    timerHeap[pos] = i;
+    timer[i].heapIndex = pos;
+  }
+
+  void heap_insert(unsigned i) {
+    timerHeap[heapSize] = i;
+    heap_sift_up(heapSize++);
+  }
+
+  void heap_remove(unsigned i) {
+    unsigned pos = timer[i].heapIndex;
+    timer[i].heapIndex = -1;
+    if (pos != --heapSize) {
+      unsigned last = timerHeap[heapSize];
+      timerHeap[pos] = last;
+      heap_sift_up(pos);
+      heap_sift_down(timer[last].heapIndex);
+    }
+  }
+
+  virtual void activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool continuous) {
+    timer[i].period = ticks;
+    timer[i].timeToFire = time_ticks() + ticks;
+    timer[i].active = 1;
+    timer[i].continuous = continuous;
+    if (timer[i].heapIndex < 0) {
+      heap_insert(i);
+    } else {
+      heap_sift_up(timer[i].heapIndex);
+      heap_sift_down(timer[i].heapIndex);
+    }
+    skew_countdown(ticks);
+  }
+
+  virtual void countdownEvent(void) {
+    unsigned i, n, numTriggered = 0;
+
+    ticksTotal += Bit64u(currCountdownPeriod);
+
+    while (timer[timerHeap[0]].timeToFire == ticksTotal) {
+      i = timerHeap[0];
+      triggered[numTriggered++] = i;
+      if (timer[i].continuous==0) {
+        timer[i].active = 0;
+        heap_remove(i);
+      } else {
+        timer[i].timeToFire += timer[i].period;
+        heap_sift_down(0);
+      }
+    }
+
+    currCountdown = currCountdownPeriod =
+        Bit32u(timer[timerHeap[0]].timeToFire - ticksTotal);
+
+    for (n = 1; n < numTriggered; n++) {
+      i = triggered[n];
+      unsigned k = n;
+      for (; k > 0 && triggered[k-1] > i; k--)
+        triggered[k] = triggered[k-1];
+      triggered[k] = i;
+    }
+
+    for (n = 0; n < numTriggered; n++)
+      fire(triggered[n]);
+  }
+};
+
+// Runs the workload until the given number of timers fired, returns the
+// host time in ns per fired timer.
+static double run(bench_scheduler_c *s, unsigned timers, Bit64u events)
+{
+  rnd_state = 1;
+  for (unsigned i = 1; i <= timers; i++)
+    s->activate_timer_ticks(i, rnd_period(), i & 1);
+
+  // skip straight to the next expiry like the halted CPU does, only the
+  // scheduler work is measured
+  clock_t start = clock();
+  while (s->events < events)
+    s->tickn(s->currCountdown);
+  clock_t end = clock();
+
+  return double(end - start) * 1e9 / CLOCKS_PER_SEC / double(s->events);
+}
+
+int main(int argc, char *argv[])
+{
+  static const unsigned default_timers[] = { 4, 16, 64, 256 };
+  const Bit64u events = 5000000;
+  int failed = 0;
+
+  unsigned count = (argc > 1) ? argc - 1 : sizeof(default_timers) / sizeof(default_timers[0]);
+
+  printf("%8s %16s %16s\n", "timers", "scan ns/event", "heap ns/event");
+  for (unsigned n = 0; n < count; n++) {
+    unsigned timers = (argc > 1) ? atoi(argv[n+1]) : default_timers[n];
+    if (timers < 1) continue;
+
+    bench_linear_c linear(timers);
+    bench_heap_c heap(timers);
+    double linear_ns = run(&linear, timers, events);
+    double heap_ns = run(&heap, timers, events);
+
+    printf("%8u %16.1f %16.1f\n", timers, linear_ns, heap_ns);
+    if (linear.checksum != heap.checksum || linear.events != heap.events) {
+      printf("  the schedulers fired different timers!\n");
+      failed = 1;
+    }
+  }
+
+  return failed;
+}
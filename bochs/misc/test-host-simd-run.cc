@@ -0,0 +1,85 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2020  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Compiled with -DBX_SIMD_TEST_HOST=0 for the generic helpers and with
+// -DBX_SIMD_TEST_HOST=1 for the host SIMD helpers, whatever the configure
+// option says. The helpers are inline functions, every build keeps them
+// in its own namespace.
+
+#include "bochs.h"
+#include "cpu/cpu.h"
+
+#undef BX_SUPPORT_HOST_SIMD
+#define BX_SUPPORT_HOST_SIMD BX_SIMD_TEST_HOST
+
+#if BX_SIMD_TEST_HOST
+// the intrinsics headers must not end up in the namespace
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+namespace host {
+#else
+namespace generic {
+#endif
+
+#include "cpu/simd_int.h"
+#include "cpu/simd_compare.h"
+
+}
+
+#include "test-host-simd.h"
+
+#if BX_SIMD_TEST_HOST
+using namespace host;
+Bit32u bx_simd_test_host(unsigned k, BxPackedXmmRegister *a, const BxPackedXmmRegister *b, Bit64u count)
+#else
+using namespace generic;
+Bit32u bx_simd_test_generic(unsigned k, BxPackedXmmRegister *a, const BxPackedXmmRegister *b, Bit64u count)
+#endif
+{
+  BxPackedXmmRegister r;
+  unsigned n = 0;
+
+#define BX_SIMD_TEST_1OP(f)   if (k == n++) { f(a); return 0; }
+#define BX_SIMD_TEST_2OP(f)   if (k == n++) { f(a, b); return 0; }
+#define BX_SIMD_TEST_3OP(f)   if (k == n++) { f(&r, a, b); *a = r; return 0; }
+#define BX_SIMD_TEST_SHIFT(f) if (k == n++) { f(a, count); return 0; }
+#define BX_SIMD_TEST_MASK(f)  if (k == n++) { return f(a); }
+#define BX_SIMD_TEST_MASK2(f) if (k == n++) { return f(a, b); }
+
+  BX_SIMD_TEST_HELPERS
+
+  return 0;
+}
+
+#if BX_SIMD_TEST_HOST
+// highest host extension used by the helpers: 0 none, 2 SSE2, 3 SSSE3,
+// 41 SSE4.1, 42 SSE4.2
+unsigned bx_simd_test_host_level(void)
+{
+  if (BX_HOST_SSE4_2) return 42;
+  if (BX_HOST_SSE4_1) return 41;
+  if (BX_HOST_SSSE3) return 3;
+  if (BX_HOST_SSE2) return 2;
+  return 0;
+}
+#endif
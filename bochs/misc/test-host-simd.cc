@@ -0,0 +1,121 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2020  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+//
+// test-host-simd.cc
+//
+// Differential test of the host SIMD implementation of the packed integer
+// helpers (cpu/simd_int.h, cpu/simd_compare.h). Every helper runs on the
+// same random and edge value vectors through the generic code and through
+// the host SIMD code, the results must be identical.
+//
+// Build and run with "make test-host-simd" in the build folder. The host
+// extension level follows the compiler target, configure with e.g.
+// CXXFLAGS="-O2 -march=native" to cover the SSSE3 and SSE4 paths.
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "bochs.h"
+#include "cpu/cpu.h"
+#include "test-host-simd.h"
+
+static const char *helper_names[] = {
+#define BX_SIMD_TEST_1OP(f)   #f,
+#define BX_SIMD_TEST_2OP(f)   #f,
+#define BX_SIMD_TEST_3OP(f)   #f,
+#define BX_SIMD_TEST_SHIFT(f) #f,
+#define BX_SIMD_TEST_MASK(f)  #f,
+#define BX_SIMD_TEST_MASK2(f) #f,
+  BX_SIMD_TEST_HELPERS
+};
+
+#define N_HELPERS (sizeof(helper_names) / sizeof(helper_names[0]))
+
+// lane values at the signed and unsigned saturation boundaries
+static const Bit8u edge_bytes[8] = { 0x00, 0x01, 0x7f, 0x80, 0x81, 0xff, 0xfe, 0x40 };
+
+static Bit32u rnd_state = 1;
+
+// xorshift, the sequence is the same on every host
+static Bit32u rnd(void)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return rnd_state;
+}
+
+static void dump(const char *name, const BxPackedXmmRegister *r)
+{
+  printf("  %s = %08x_%08x_%08x_%08x\n", name,
+    r->xmm32u(3), r->xmm32u(2), r->xmm32u(1), r->xmm32u(0));
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned iterations = 100000, failed = 0;
+
+  if (argc > 1) iterations = atoi(argv[1]);
+
+  printf("host SIMD level: ");
+  switch (bx_simd_test_host_level()) {
+    case 42: printf("SSE4.2\n"); break;
+    case 41: printf("SSE4.1\n"); break;
+    case 3:  printf("SSSE3\n"); break;
+    case 2:  printf("SSE2\n"); break;
+    default:
+      printf("none, nothing to compare\n");
+      return 0;
+  }
+
+  for (unsigned k=0; k < N_HELPERS; k++) {
+    for (unsigned iter=0; iter < iterations; iter++) {
+      BxPackedXmmRegister a, b, a_host;
+
+      for (unsigned n=0; n < 16; n++) {
+        a.xmmubyte(n) = (iter & 1) ? edge_bytes[rnd() & 7] : (Bit8u) rnd();
+        b.xmmubyte(n) = (iter & 2) ? edge_bytes[rnd() & 7] : (Bit8u) rnd();
+      }
+      // shift counts around the lane sizes and counts wider than 32 bits
+      Bit64u count = (iter & 4) ? (((Bit64u) rnd() << 32) | rnd()) : (Bit64u)(rnd() % 72);
+      a_host = a;
+
+      BxPackedXmmRegister a_in = a;
+      Bit32u mask = bx_simd_test_generic(k, &a, &b, count);
+      Bit32u mask_host = bx_simd_test_host(k, &a_host, &b, count);
+
+      if (mask != mask_host || a.xmm64u(0) != a_host.xmm64u(0) || a.xmm64u(1) != a_host.xmm64u(1)) {
+        printf("%s: mismatch, count=" FMT_LL "x\n", helper_names[k], count);
+        dump("op1    ", &a_in);
+        dump("op2    ", &b);
+        dump("generic", &a);
+        dump("host   ", &a_host);
+        if (mask != mask_host)
+          printf("  mask generic=%08x host=%08x\n", mask, mask_host);
+        failed++;
+        break;
+      }
+    }
+  }
+
+  printf("%u helpers, %u iterations each, %u failed\n", (unsigned) N_HELPERS, iterations, failed);
+  return (failed != 0);
+}
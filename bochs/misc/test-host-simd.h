@@ -0,0 +1,134 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2020  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Packed integer helpers with a host SIMD implementation, checked by
+// test-host-simd against the generic code. The forms are:
+//   BX_SIMD_TEST_1OP(f)    f(a)
+//   BX_SIMD_TEST_2OP(f)    f(a, b)
+//   BX_SIMD_TEST_3OP(f)    f(&r, a, b), r is stored into a
+//   BX_SIMD_TEST_SHIFT(f)  f(a, count)
+//   BX_SIMD_TEST_MASK(f)   return f(a)
+//   BX_SIMD_TEST_MASK2(f)  return f(a, b)
+
+#define BX_SIMD_TEST_HELPERS \
+  BX_SIMD_TEST_1OP(xmm_pabsb) \
+  BX_SIMD_TEST_1OP(xmm_pabsw) \
+  BX_SIMD_TEST_1OP(xmm_pabsd) \
+  BX_SIMD_TEST_2OP(xmm_pminsb) \
+  BX_SIMD_TEST_2OP(xmm_pminub) \
+  BX_SIMD_TEST_2OP(xmm_pminsw) \
+  BX_SIMD_TEST_2OP(xmm_pminuw) \
+  BX_SIMD_TEST_2OP(xmm_pminsd) \
+  BX_SIMD_TEST_2OP(xmm_pminud) \
+  BX_SIMD_TEST_2OP(xmm_pmaxsb) \
+  BX_SIMD_TEST_2OP(xmm_pmaxub) \
+  BX_SIMD_TEST_2OP(xmm_pmaxsw) \
+  BX_SIMD_TEST_2OP(xmm_pmaxuw) \
+  BX_SIMD_TEST_2OP(xmm_pmaxsd) \
+  BX_SIMD_TEST_2OP(xmm_pmaxud) \
+  BX_SIMD_TEST_2OP(xmm_punpcklbw) \
+  BX_SIMD_TEST_2OP(xmm_punpckhbw) \
+  BX_SIMD_TEST_2OP(xmm_punpcklwd) \
+  BX_SIMD_TEST_2OP(xmm_punpckhwd) \
+  BX_SIMD_TEST_2OP(xmm_packuswb) \
+  BX_SIMD_TEST_2OP(xmm_packsswb) \
+  BX_SIMD_TEST_2OP(xmm_packusdw) \
+  BX_SIMD_TEST_2OP(xmm_packssdw) \
+  BX_SIMD_TEST_3OP(xmm_pshufb) \
+  BX_SIMD_TEST_2OP(xmm_psignb) \
+  BX_SIMD_TEST_2OP(xmm_psignw) \
+  BX_SIMD_TEST_2OP(xmm_psignd) \
+  BX_SIMD_TEST_MASK(xmm_pmovmskb) \
+  BX_SIMD_TEST_2OP(xmm_andps) \
+  BX_SIMD_TEST_2OP(xmm_andnps) \
+  BX_SIMD_TEST_2OP(xmm_orps) \
+  BX_SIMD_TEST_2OP(xmm_xorps) \
+  BX_SIMD_TEST_2OP(xmm_paddb) \
+  BX_SIMD_TEST_2OP(xmm_paddw) \
+  BX_SIMD_TEST_2OP(xmm_paddd) \
+  BX_SIMD_TEST_2OP(xmm_paddq) \
+  BX_SIMD_TEST_2OP(xmm_psubb) \
+  BX_SIMD_TEST_2OP(xmm_psubw) \
+  BX_SIMD_TEST_2OP(xmm_psubd) \
+  BX_SIMD_TEST_2OP(xmm_psubq) \
+  BX_SIMD_TEST_2OP(xmm_paddsb) \
+  BX_SIMD_TEST_2OP(xmm_paddsw) \
+  BX_SIMD_TEST_2OP(xmm_paddusb) \
+  BX_SIMD_TEST_2OP(xmm_paddusw) \
+  BX_SIMD_TEST_2OP(xmm_psubsb) \
+  BX_SIMD_TEST_2OP(xmm_psubsw) \
+  BX_SIMD_TEST_2OP(xmm_psubusb) \
+  BX_SIMD_TEST_2OP(xmm_psubusw) \
+  BX_SIMD_TEST_2OP(xmm_phaddw) \
+  BX_SIMD_TEST_2OP(xmm_phaddd) \
+  BX_SIMD_TEST_2OP(xmm_phaddsw) \
+  BX_SIMD_TEST_2OP(xmm_phsubw) \
+  BX_SIMD_TEST_2OP(xmm_phsubd) \
+  BX_SIMD_TEST_2OP(xmm_phsubsw) \
+  BX_SIMD_TEST_2OP(xmm_pavgb) \
+  BX_SIMD_TEST_2OP(xmm_pavgw) \
+  BX_SIMD_TEST_2OP(xmm_pmullw) \
+  BX_SIMD_TEST_2OP(xmm_pmulhw) \
+  BX_SIMD_TEST_2OP(xmm_pmulhuw) \
+  BX_SIMD_TEST_2OP(xmm_pmulld) \
+  BX_SIMD_TEST_2OP(xmm_pmuldq) \
+  BX_SIMD_TEST_2OP(xmm_pmuludq) \
+  BX_SIMD_TEST_2OP(xmm_pmulhrsw) \
+  BX_SIMD_TEST_2OP(xmm_pmaddubsw) \
+  BX_SIMD_TEST_2OP(xmm_pmaddwd) \
+  BX_SIMD_TEST_2OP(xmm_psadbw) \
+  BX_SIMD_TEST_SHIFT(xmm_psraw) \
+  BX_SIMD_TEST_SHIFT(xmm_psrad) \
+  BX_SIMD_TEST_SHIFT(xmm_psrlw) \
+  BX_SIMD_TEST_SHIFT(xmm_psrld) \
+  BX_SIMD_TEST_SHIFT(xmm_psrlq) \
+  BX_SIMD_TEST_SHIFT(xmm_psllw) \
+  BX_SIMD_TEST_SHIFT(xmm_pslld) \
+  BX_SIMD_TEST_SHIFT(xmm_psllq) \
+  BX_SIMD_TEST_2OP(xmm_pcmpeqb) \
+  BX_SIMD_TEST_2OP(xmm_pcmpeqw) \
+  BX_SIMD_TEST_2OP(xmm_pcmpeqd) \
+  BX_SIMD_TEST_2OP(xmm_pcmpeqq) \
+  BX_SIMD_TEST_2OP(xmm_pcmpgtb) \
+  BX_SIMD_TEST_2OP(xmm_pcmpgtw) \
+  BX_SIMD_TEST_2OP(xmm_pcmpgtd) \
+  BX_SIMD_TEST_2OP(xmm_pcmpgtq) \
+  BX_SIMD_TEST_2OP(xmm_pcmpltb) \
+  BX_SIMD_TEST_2OP(xmm_pcmpltw) \
+  BX_SIMD_TEST_2OP(xmm_pcmpltd) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpeqb_mask) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpeqw_mask) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpeqd_mask) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpeqq_mask) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpgtb_mask) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpgtw_mask) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpgtd_mask) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpgtq_mask) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpltb_mask) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpltw_mask) \
+  BX_SIMD_TEST_MASK2(xmm_pcmpltd_mask)
+
+// Runs helper number k on a (and b, count), returns the mask if it has one.
+// test-host-simd-run.cc is compiled once for each implementation.
+extern Bit32u bx_simd_test_generic(unsigned k, BxPackedXmmRegister *a, const BxPackedXmmRegister *b, Bit64u count);
+extern Bit32u bx_simd_test_host(unsigned k, BxPackedXmmRegister *a, const BxPackedXmmRegister *b, Bit64u count);
+extern unsigned bx_simd_test_host_level(void);
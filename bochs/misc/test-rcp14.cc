@@ -0,0 +1,64 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2020  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA B 02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+//
+// test-rcp14.cc
+//
+// Exhaustive check of the VRCP14/VRSQRT14 interpolation against the
+// original lookup tables: every index of the 64K-entry rcp14 table and of
+// both 32K-entry rsqrt14 tables must give the same value.
+//
+// Build and run with "make test-rcp14" in the build folder.
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "bochs.h"
+#include "cpu/avx/avx512_rcp14.h"
+#include "cpu/avx/avx512_rsqrt14.h"
+#include "avx512_rcp14_tables.h"
+
+static unsigned check(const char *name, const Bit16u *table, unsigned entries, unsigned odd_exp)
+{
+  unsigned failed = 0;
+
+  for (Bit32u index = 0; index < entries; index++) {
+    Bit32u value = (table == rcp14_table) ? rcp14_interpolate(index) : rsqrt14_interpolate(index, odd_exp);
+    if (value != table[index]) {
+      if (failed < 10)
+        printf("%s[%u]: table=%04x interpolated=%04x\n", name, index, table[index], value);
+      failed++;
+    }
+  }
+
+  printf("%s: %u entries, %u failed\n", name, entries, failed);
+  return failed;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned failed = 0;
+
+  failed += check("rcp14_table", rcp14_table, 65536, 0);
+  failed += check("rsqrt14_table0", rsqrt14_table0, 32768, 0);
+  failed += check("rsqrt14_table1", rsqrt14_table1, 32768, 1);
+
+  return (failed != 0);
+}
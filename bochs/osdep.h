@@ -362,6 +362,48 @@ BOCHSAPI_MSVCONLY extern Bit64u bx_get_realtime64_usec (void);
 }
 #endif   /* __cplusplus */
 
+//////////////////////////////////////////////////////////////////////
+// Thread local storage and atomic operations, required for threaded
+// SMP simulation where every emulated CPU runs in its own host thread
+//////////////////////////////////////////////////////////////////////
+
+#if defined(_MSC_VER)
+  #define BX_THREAD_LOCAL __declspec(thread)
+
+  #define BX_ATOMIC_OR32(ptr, val)  _InterlockedOr((volatile long*)(ptr), (long)(val))
+  #define BX_ATOMIC_AND32(ptr, val) _InterlockedAnd((volatile long*)(ptr), (long)(val))
+  #define BX_ATOMIC_INC32(ptr)      _InterlockedIncrement((volatile long*)(ptr))
+  #define BX_ATOMIC_LOAD32(ptr)     (MemoryBarrier(), *(volatile Bit32u*)(ptr))
+  #define BX_ATOMIC_STORE32(ptr, val) \
+    do { MemoryBarrier(); *(volatile Bit32u*)(ptr) = (val); MemoryBarrier(); } while (0)
+  #define BX_ATOMIC_CAS8(ptr, old, val) \
+    (_InterlockedCompareExchange8((volatile char*)(ptr), (char)(val), (char)(old)) == (char)(old))
+  #define BX_ATOMIC_CAS16(ptr, old, val) \
+    (_InterlockedCompareExchange16((volatile short*)(ptr), (short)(val), (short)(old)) == (short)(old))
+  #define BX_ATOMIC_CAS32(ptr, old, val) \
+    (_InterlockedCompareExchange((volatile long*)(ptr), (long)(val), (long)(old)) == (long)(old))
+  #define BX_ATOMIC_CAS64(ptr, old, val) \
+    (_InterlockedCompareExchange64((volatile __int64*)(ptr), (__int64)(val), (__int64)(old)) == (__int64)(old))
+  #define BX_CPU_RELAX()            YieldProcessor()
+#else
+  #define BX_THREAD_LOCAL __thread
+
+  #define BX_ATOMIC_OR32(ptr, val)  __sync_fetch_and_or((ptr), (val))
+  #define BX_ATOMIC_AND32(ptr, val) __sync_fetch_and_and((ptr), (val))
+  #define BX_ATOMIC_INC32(ptr)      __sync_add_and_fetch((ptr), 1)
+  #define BX_ATOMIC_LOAD32(ptr)     __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+  #define BX_ATOMIC_STORE32(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+  #define BX_ATOMIC_CAS8(ptr, old, val)  __sync_bool_compare_and_swap((Bit8u*)(ptr), (Bit8u)(old), (Bit8u)(val))
+  #define BX_ATOMIC_CAS16(ptr, old, val) __sync_bool_compare_and_swap((Bit16u*)(ptr), (Bit16u)(old), (Bit16u)(val))
+  #define BX_ATOMIC_CAS32(ptr, old, val) __sync_bool_compare_and_swap((Bit32u*)(ptr), (Bit32u)(old), (Bit32u)(val))
+  #define BX_ATOMIC_CAS64(ptr, old, val) __sync_bool_compare_and_swap((Bit64u*)(ptr), (Bit64u)(old), (Bit64u)(val))
+#if defined(__i386__) || defined(__x86_64__)
+  #define BX_CPU_RELAX()            __builtin_ia32_pause()
+#else
+  #define BX_CPU_RELAX()
+#endif
+#endif
+
 #if BX_LARGE_RAMFILE
 
 // these macros required for large ramfile option functionality
@@ -30,8 +30,11 @@
 #define BXPN_BOCHS_START                 "general.start_mode"
 #define BXPN_BOCHS_BENCHMARK             "general.benchmark"
 #define BXPN_DUMP_STATS                  "general.dumpstats"
+#define BXPN_CHECKPOINT                  "general.checkpoint"
+#define BXPN_CHECKPOINT_PATH             "general.checkpoint_path"
 #define BXPN_RESTORE_FLAG                "general.restore"
 #define BXPN_RESTORE_PATH                "general.restore_path"
+#define BXPN_RESTORE_COW                 "general.restore_cow"
 #define BXPN_DEBUG_RUNNING               "general.debug_running"
 #define BXPN_PLUGIN_CTRL                 "general.plugin_ctrl"
 #define BXPN_UNLOCK_IMAGES               "general.unlock_images"
@@ -41,9 +44,13 @@
 #define BXPN_CPU_MODEL                   "cpu.model"
 #define BXPN_IPS                         "cpu.ips"
 #define BXPN_SMP_QUANTUM                 "cpu.quantum"
+#define BXPN_SMP_THREADS                 "cpu.smp_threads"
+#define BXPN_SMP_THREAD_QUANTUM          "cpu.thread_quantum"
 #define BXPN_RESET_ON_TRIPLE_FAULT       "cpu.reset_on_triple_fault"
 #define BXPN_IGNORE_BAD_MSRS             "cpu.ignore_bad_msrs"
 #define BXPN_CONFIGURABLE_MSRS_PATH      "cpu.msrs"
+#define BXPN_CPU_TRACE_CACHE             "cpu.trace_cache"
+#define BXPN_CPU_SHARED_TRACE_CACHE      "cpu.shared_trace_cache"
 #define BXPN_CPUID_LIMIT_WINNT           "cpu.cpuid_limit_winnt"
 #define BXPN_MWAIT_IS_NOP                "cpu.mwait_is_nop"
 #define BXPN_VENDOR_STRING               "cpuid.vendor_string"
@@ -81,6 +88,7 @@
 #define BXPN_CPUID_SMAP                  "cpuid.smap"
 #define BXPN_MEM_SIZE                    "memory.standard.ram.size"
 #define BXPN_HOST_MEM_SIZE               "memory.standard.ram.host_size"
+#define BXPN_MEM_HUGEPAGES               "memory.standard.ram.hugepages"
 #define BXPN_ROMIMAGE                    "memory.standard.rom"
 #define BXPN_ROM_PATH                    "memory.standard.rom.file"
 #define BXPN_ROM_ADDRESS                 "memory.standard.rom.address"
@@ -21,8 +21,16 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include "bochs.h"
+#include "param_names.h"
 #include "cpu/cpu.h"
 #include "iodev/iodev.h"
+#include "iodev/virt_timer.h"
+#include "bxthread.h"
+
+#ifndef WIN32
+#include <dirent.h>
+#endif
+
 #define LOG_THIS bx_pc_system.
 
 #if defined(PROVIDE_M_IPS)
@@ -35,6 +43,13 @@ double     m_ips; // Millions of Instructions Per Second
 #define SpewPeriodicTimerInfo 0
 #define MinAllowableTimerPeriod 1
 
+// Limits of the host side wait of the halted CPU (microseconds)
+#define BX_IDLE_MIN_WAIT_USEC 100
+#define BX_IDLE_MAX_WAIT_USEC 10000
+
+static bx_thread_event_t idle_event;
+static bx_bool idle_event_created = 0;
+
 const Bit64u bx_pc_system_c::NullTimerInterval = 0xffffffff;
 
   // constructor
@@ -44,23 +59,30 @@ bx_pc_system_c::bx_pc_system_c()
 
   BX_ASSERT(numTimers == 0);
 
+  timerBlock = NULL;
+  timerHeap = NULL;
+  numTimerBlocks = 0;
+  heapSize = 0;
+  alloc_timer_block();
+
   // Timer[0] is the null timer.  It is initialized as a special
   // case here.  It should never be turned off or modified, and its
   // duration should always remain the same.
   ticksTotal = 0; // Reset ticks since emulator started.
-  timer[0].inUse      = 1;
-  timer[0].period     = NullTimerInterval;
-  timer[0].active     = 1;
-  timer[0].continuous = 1;
-  timer[0].funct      = nullTimer;
-  timer[0].this_ptr   = this;
+  timer(0).inUse      = 1;
+  timer(0).period     = NullTimerInterval;
+  timer(0).active     = 1;
+  timer(0).continuous = 1;
+  timer(0).funct      = nullTimer;
+  timer(0).this_ptr   = this;
   numTimers = 1; // So far, only the nullTimer.
+  heap_insert(0);
 }
 
 void bx_pc_system_c::initialize(Bit32u ips)
 {
   ticksTotal = 0;
-  timer[0].timeToFire = NullTimerInterval;
+  timer(0).timeToFire = NullTimerInterval;
   currCountdown       = NullTimerInterval;
   currCountdownPeriod = NullTimerInterval;
   lastTimeUsec = 0;
@@ -68,6 +90,14 @@ void bx_pc_system_c::initialize(Bit32u ips)
   triggeredTimer = 0;
   HRQ = 0;
   kill_bochs_request = 0;
+  checkpoint_request = 0;
+  clock_sync = SIM->get_param_enum(BXPN_CLOCK_SYNC)->get();
+
+  // the host side wait of the halted CPU, woken up by the GUI threads
+  if (! idle_event_created) {
+    bx_create_event(&idle_event);
+    idle_event_created = 1;
+  }
 
   // parameter 'ips' is the processor speed in Instructions-Per-Second
   m_ips = double(ips) / 1000000.0L;
@@ -173,18 +203,45 @@ bx_bool bx_pc_system_c::get_enable_a20(void)
 
 void bx_pc_system_c::MemoryMappingChanged(void)
 {
+#if BX_SUPPORT_SMP
+  // other CPUs are running in their own threads, flush them at the end of the round
+  int cpu = bx_smp_current_cpu();
+  if (bx_smp_threads_active && cpu >= 0) {
+    BX_CPU(cpu)->TLB_flush();
+    bx_smp_request_others(BX_SMP_REQ_TLB_FLUSH);
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
     BX_CPU(i)->TLB_flush();
 }
 
 void bx_pc_system_c::invlpg(bx_address addr)
 {
+#if BX_SUPPORT_SMP
+  int cpu = bx_smp_current_cpu();
+  if (bx_smp_threads_active && cpu >= 0) {
+    BX_CPU(cpu)->TLB_invlpg(addr);
+    bx_smp_request_others(BX_SMP_REQ_TLB_FLUSH);
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
     BX_CPU(i)->TLB_invlpg(addr);
 }
 
 int bx_pc_system_c::Reset(unsigned type)
 {
+#if BX_SUPPORT_SMP
+  // reset the machine when all the CPU threads are parked
+  if (bx_smp_threads_active && bx_smp_current_cpu() >= 0) {
+    bx_smp_defer_reset(type);
+    return(0);
+  }
+#endif
+
   // type is BX_RESET_HARDWARE or BX_RESET_SOFTWARE
   BX_INFO(("bx_pc_system_c::Reset(%s) called",type==BX_RESET_HARDWARE?"HARDWARE":"SOFTWARE"));
 
@@ -212,6 +269,7 @@ void bx_pc_system_c::exit(void)
 {
   // delete all registered timers (exception: null timer and APIC timer)
   numTimers = 1 + BX_SUPPORT_APIC;
+  heap_rebuild();
   bx_devices.exit();
   if (bx_gui) {
     bx_gui->cleanup();
@@ -236,15 +294,20 @@ void bx_pc_system_c::register_state(void)
     char name[4];
     sprintf(name, "%u", i);
     bx_list_c *bxtimer = new bx_list_c(timers, name);
-    BXRS_PARAM_BOOL(bxtimer, inUse, timer[i].inUse);
-    BXRS_DEC_PARAM_FIELD(bxtimer, period, timer[i].period);
-    BXRS_DEC_PARAM_FIELD(bxtimer, timeToFire, timer[i].timeToFire);
-    BXRS_PARAM_BOOL(bxtimer, active, timer[i].active);
-    BXRS_PARAM_BOOL(bxtimer, continuous, timer[i].continuous);
-    BXRS_DEC_PARAM_FIELD(bxtimer, param, timer[i].param);
+    BXRS_PARAM_BOOL(bxtimer, inUse, timer(i).inUse);
+    BXRS_DEC_PARAM_FIELD(bxtimer, period, timer(i).period);
+    BXRS_DEC_PARAM_FIELD(bxtimer, timeToFire, timer(i).timeToFire);
+    BXRS_PARAM_BOOL(bxtimer, active, timer(i).active);
+    BXRS_PARAM_BOOL(bxtimer, continuous, timer(i).continuous);
+    BXRS_DEC_PARAM_FIELD(bxtimer, param, timer(i).param);
   }
 }
 
+void bx_pc_system_c::after_restore_state(void)
+{
+  heap_rebuild();
+}
+
 // ================================================
 // Bochs internal timer delivery framework features
 // ================================================
@@ -263,6 +326,8 @@ int bx_pc_system_c::register_timer_ticks(void* this_ptr, bx_timer_handler_t func
 {
   unsigned i;
 
+  BX_SMP_LOCK();
+
   // If the timer frequency is rediculously low, make it more sane.
   // This happens when 'ips' is too low.
   if (ticks < MinAllowableTimerPeriod) {
@@ -273,13 +338,12 @@ int bx_pc_system_c::register_timer_ticks(void* this_ptr, bx_timer_handler_t func
 
   // search for new timer (i = 0 is reserved for NullTimer)
   for (i = 1; i < numTimers; i++) {
-    if (timer[i].inUse == 0)
+    if (timer(i).inUse == 0)
       break;
   }
 
-  if (numTimers >= BX_MAX_TIMERS) {
-    BX_PANIC(("register_timer: too many registered timers"));
-    return -1;
+  if (i == numTimerBlocks * BX_TIMER_BLOCK_SIZE) {
+    alloc_timer_block();
   }
 #if BX_TIMER_DEBUG
   if (this_ptr == NULL)
@@ -288,18 +352,19 @@ int bx_pc_system_c::register_timer_ticks(void* this_ptr, bx_timer_handler_t func
     BX_PANIC(("register_timer_ticks: funct is NULL!"));
 #endif
 
-  timer[i].inUse      = 1;
-  timer[i].period     = ticks;
-  timer[i].timeToFire = (ticksTotal + Bit64u(currCountdownPeriod-currCountdown)) + ticks;
-  timer[i].active     = active;
-  timer[i].continuous = continuous;
-  timer[i].funct      = funct;
-  timer[i].this_ptr   = this_ptr;
-  strncpy(timer[i].id, id, BxMaxTimerIDLen);
-  timer[i].id[BxMaxTimerIDLen-1] = 0; // Null terminate if not already.
-  timer[i].param      = 0;
+  timer(i).inUse      = 1;
+  timer(i).period     = ticks;
+  timer(i).timeToFire = (ticksTotal + Bit64u(currCountdownPeriod-currCountdown)) + ticks;
+  timer(i).active     = active;
+  timer(i).continuous = continuous;
+  timer(i).funct      = funct;
+  timer(i).this_ptr   = this_ptr;
+  strncpy(timer(i).id, id, BxMaxTimerIDLen);
+  timer(i).id[BxMaxTimerIDLen-1] = 0; // Null terminate if not already.
+  timer(i).param      = 0;
 
   if (active) {
+    heap_insert(i);
     if (ticks < Bit64u(currCountdown)) {
       // This new timer needs to fire before the current countdown.
       // Skew the current countdown and countdown period to be smaller
@@ -314,15 +379,16 @@ int bx_pc_system_c::register_timer_ticks(void* this_ptr, bx_timer_handler_t func
   if (i==numTimers)
     numTimers++; // One new timer installed.
 
+  BX_SMP_UNLOCK();
+
   // Return timer id.
   return i;
 }
 
 void bx_pc_system_c::countdownEvent(void)
 {
-  unsigned i, first = numTimers, last = 0;
-  Bit64u   minTimeToFire;
-  bx_bool  triggered[BX_MAX_TIMERS];
+  unsigned i, n, numTriggered = 0;
+  unsigned triggeredBuf[BX_TIMER_BLOCK_SIZE], *triggered = triggeredBuf;
 
   // The countdown decremented to 0.  We need to service all the active
   // timers, and invoke callbacks from those timers which have fired.
@@ -334,36 +400,32 @@ void bx_pc_system_c::countdownEvent(void)
   // Increment global ticks counter by number of ticks which have
   // elapsed since the last update.
   ticksTotal += Bit64u(currCountdownPeriod);
-  minTimeToFire = (Bit64u) -1;
 
-  for (i = 0; i < numTimers; i++) {
-    triggered[i] = 0; // Reset triggered flag.
-    if (timer[i].active) {
 #if BX_TIMER_DEBUG
-      if (ticksTotal > timer[i].timeToFire)
-        BX_PANIC(("countdownEvent: ticksTotal > timeToFire[%u], D " FMT_LL "u", i,
-                  timer[i].timeToFire-ticksTotal));
+  if (ticksTotal > timer(timerHeap[0]).timeToFire)
+    BX_PANIC(("countdownEvent: ticksTotal > timeToFire[%u], D " FMT_LL "u", timerHeap[0],
+              ticksTotal-timer(timerHeap[0]).timeToFire));
 #endif
-      if (ticksTotal == timer[i].timeToFire) {
-        // This timer is ready to fire.
-        triggered[i] = 1;
-
-        if (timer[i].continuous==0) {
-          // If triggered timer is one-shot, deactive.
-          timer[i].active = 0;
-        } else {
-          // Continuous timer, increment time-to-fire by period.
-          timer[i].timeToFire += timer[i].period;
-          if (timer[i].timeToFire < minTimeToFire)
-            minTimeToFire = timer[i].timeToFire;
-        }
-        if (i < first) first = i;
-        last = i;
-      } else {
-        // This timer is not ready to fire yet.
-        if (timer[i].timeToFire < minTimeToFire)
-          minTimeToFire = timer[i].timeToFire;
-      }
+
+  // The timers ready to fire are on top of the heap.  The null timer is
+  // always active, so the heap is never empty.
+  while (timer(timerHeap[0]).timeToFire == ticksTotal) {
+    i = timerHeap[0];
+    if (numTriggered == BX_TIMER_BLOCK_SIZE && triggered == triggeredBuf) {
+      // more timers fire at once, none of them can be in the heap twice
+      triggered = new unsigned[numTriggered + heapSize];
+      memcpy(triggered, triggeredBuf, sizeof(triggeredBuf));
+    }
+    triggered[numTriggered++] = i;
+
+    if (timer(i).continuous==0) {
+      // If triggered timer is one-shot, deactive.
+      timer(i).active = 0;
+      heap_remove(i);
+    } else {
+      // Continuous timer, increment time-to-fire by period.
+      timer(i).timeToFire += timer(i).period;
+      heap_sift_down(0);
     }
   }
 
@@ -371,17 +433,31 @@ void bx_pc_system_c::countdownEvent(void)
   // any of the callbacks, as they may call timer features, which need
   // to be advanced to the next countdown cycle.
   currCountdown = currCountdownPeriod =
-      Bit32u(minTimeToFire - ticksTotal);
+      Bit32u(timer(timerHeap[0]).timeToFire - ticksTotal);
+
+  // Callbacks are invoked in timer ID order.  Mostly a single timer
+  // fires at once, so an insertion sort is good enough.
+  for (n = 1; n < numTriggered; n++) {
+    i = triggered[n];
+    unsigned k = n;
+    for (; k > 0 && triggered[k-1] > i; k--)
+      triggered[k] = triggered[k-1];
+    triggered[k] = i;
+  }
 
-  for (i = first; i <= last; i++) {
+  for (n = 0; n < numTriggered; n++) {
     // Call requested timer function.  It may request a different
     // timer period or deactivate etc.
-    if (triggered[i] && (timer[i].funct != NULL)) {
+    i = triggered[n];
+    if (timer(i).funct != NULL) {
       triggeredTimer = i;
-      timer[i].funct(timer[i].this_ptr);
+      timer(i).funct(timer(i).this_ptr);
       triggeredTimer = 0;
     }
   }
+
+  if (triggered != triggeredBuf)
+    delete [] triggered;
 }
 
 void bx_pc_system_c::nullTimer(void* this_ptr)
@@ -401,10 +477,10 @@ void bx_pc_system_c::nullTimer(void* this_ptr)
 #if SpewPeriodicTimerInfo
   BX_INFO(("==================================="));
   for (unsigned i=0; i < bx_pc_system.numTimers; i++) {
-    if (bx_pc_system.timer[i].active) {
+    if (bx_pc_system.timer(i).active) {
       BX_INFO(("BxTimer(%s): period=" FMT_LL "u, continuous=%u",
-               bx_pc_system.timer[i].id, bx_pc_system.timer[i].period,
-               bx_pc_system.timer[i].continuous));
+               bx_pc_system.timer(i).id, bx_pc_system.timer(i).period,
+               bx_pc_system.timer(i).continuous));
     }
   }
 #endif
@@ -426,6 +502,95 @@ void bx_pc_system_c::dumpStatsTimer(void* this_ptr)
 }
 #endif
 
+// portable mkdir
+static int bx_mkdir(const char *path)
+{
+#ifndef WIN32
+  return mkdir(path, 0755);
+#else
+  return (CreateDirectory(path, NULL) != 0) ? 0 : -1;
+#endif
+}
+
+// number following the highest numbered folder in path
+static unsigned bx_next_checkpoint(const char *path)
+{
+  unsigned n, next = 0;
+  char c;
+#ifndef WIN32
+  DIR *dir = opendir(path);
+  struct dirent *entry;
+
+  if (dir == NULL) return 0;
+  while ((entry = readdir(dir)) != NULL) {
+    if ((sscanf(entry->d_name, "%u%c", &n, &c) == 1) && (n >= next))
+      next = n + 1;
+  }
+  closedir(dir);
+#else
+  char pattern[BX_PATHNAME_LEN];
+  WIN32_FIND_DATA data;
+
+  snprintf(pattern, BX_PATHNAME_LEN, "%s\\*", path);
+  HANDLE handle = FindFirstFile(pattern, &data);
+  if (handle == INVALID_HANDLE_VALUE) return 0;
+  do {
+    if ((sscanf(data.cFileName, "%u%c", &n, &c) == 1) && (n >= next))
+      next = n + 1;
+  } while (FindNextFile(handle, &data));
+  FindClose(handle);
+#endif
+  return next;
+}
+
+// A single CPU may be in the middle of a repeated string instruction when
+// the timer fires, the checkpoint is saved by the CPU at the next instruction
+// boundary. The timers of the SMP simulation fire between the traces.
+void bx_pc_system_c::checkpointTimer(void* this_ptr)
+{
+  bx_pc_system_c *class_ptr = (bx_pc_system_c *) this_ptr;
+
+  if (BX_SMP_PROCESSORS == 1) {
+    class_ptr->checkpoint_request = 1;
+    BX_CPU(0)->async_event = 1;
+  }
+  else {
+    class_ptr->save_checkpoint();
+  }
+}
+
+// Every checkpoint is saved into a new numbered folder, numbered after the
+// folders of a previous run that are still there. The first one saves
+// the full RAM image, the following ones only the RAM pages written since
+// the previous checkpoint, restore merges the chain of RAM images. Only the
+// device state is saved while the simulation is stopped, the RAM image is
+// written by a background thread while the guest continues.
+void bx_pc_system_c::save_checkpoint(void)
+{
+  static int checkpoints = -1;
+  char path[BX_PATHNAME_LEN];
+  const char *checkpoint_path = SIM->get_param_string(BXPN_CHECKPOINT_PATH)->getptr();
+
+  checkpoint_request = 0;
+  // the folder may exist already
+  bx_mkdir(checkpoint_path);
+  if (checkpoints < 0)
+    checkpoints = bx_next_checkpoint(checkpoint_path);
+  snprintf(path, BX_PATHNAME_LEN, "%s/%04d", checkpoint_path, checkpoints);
+  bx_mkdir(path);
+  BX_MEM(0)->set_save_live(1);
+  bx_bool saved = SIM->save_state(path);
+  BX_MEM(0)->set_save_live(0);
+  if (saved) {
+    BX_INFO(("checkpoint saved to '%s'", path));
+    BX_MEM(0)->set_ram_base(path);
+    checkpoints++;
+  }
+  else {
+    BX_ERROR(("failed to save checkpoint to '%s'", path));
+  }
+}
+
 #if BX_DEBUGGER
 void bx_pc_system_c::timebp_handler(void* this_ptr)
 {
@@ -477,11 +642,13 @@ void bx_pc_system_c::activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool cont
     BX_PANIC(("activate_timer_ticks: timer %u OOB", i));
   if (i == 0)
     BX_PANIC(("activate_timer_ticks: timer 0 is the NullTimer!"));
-  if (timer[i].period < MinAllowableTimerPeriod)
+  if (timer(i).period < MinAllowableTimerPeriod)
     BX_PANIC(("activate_timer_ticks: timer[%u].period of " FMT_LL "u < min of %u",
-              i, timer[i].period, MinAllowableTimerPeriod));
+              i, timer(i).period, MinAllowableTimerPeriod));
 #endif
 
+  BX_SMP_LOCK();
+
   // If the timer frequency is rediculously low, make it more sane.
   // This happens when 'ips' is too low.
   if (ticks < MinAllowableTimerPeriod) {
@@ -490,10 +657,18 @@ void bx_pc_system_c::activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool cont
     ticks = MinAllowableTimerPeriod;
   }
 
-  timer[i].period = ticks;
-  timer[i].timeToFire = (ticksTotal + Bit64u(currCountdownPeriod-currCountdown)) + ticks;
-  timer[i].active     = 1;
-  timer[i].continuous = continuous;
+  timer(i).period = ticks;
+  timer(i).timeToFire = (ticksTotal + Bit64u(currCountdownPeriod-currCountdown)) + ticks;
+  timer(i).active     = 1;
+  timer(i).continuous = continuous;
+
+  if (timer(i).heapIndex < 0) {
+    heap_insert(i);
+  } else {
+    // the timer can move in both directions
+    heap_sift_up(timer(i).heapIndex);
+    heap_sift_down(timer(i).heapIndex);
+  }
 
   if (ticks < Bit64u(currCountdown)) {
     // This new timer needs to fire before the current countdown.
@@ -502,6 +677,8 @@ void bx_pc_system_c::activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool cont
     currCountdownPeriod -= (currCountdown - Bit32u(ticks));
     currCountdown = Bit32u(ticks);
   }
+
+  BX_SMP_UNLOCK();
 }
 
 void bx_pc_system_c::activate_timer(unsigned i, Bit32u useconds, bx_bool continuous)
@@ -518,7 +695,7 @@ void bx_pc_system_c::activate_timer(unsigned i, Bit32u useconds, bx_bool continu
   // if useconds = 0, use default stored in period field
   // else set new period from useconds
   if (useconds==0) {
-    ticks = timer[i].period;
+    ticks = timer(i).period;
   } else {
     // convert useconds to number of ticks
     ticks = (Bit64u) (double(useconds) * m_ips);
@@ -529,7 +706,7 @@ void bx_pc_system_c::activate_timer(unsigned i, Bit32u useconds, bx_bool continu
       ticks = MinAllowableTimerPeriod;
     }
 
-    timer[i].period = ticks;
+    timer(i).period = ticks;
   }
 
   activate_timer_ticks(i, ticks, continuous);
@@ -542,7 +719,7 @@ void bx_pc_system_c::activate_timer_nsec(unsigned i, Bit64u nseconds, bx_bool co
   // if nseconds = 0, use default stored in period field
   // else set new period from useconds
   if (nseconds==0) {
-    ticks = timer[i].period;
+    ticks = timer(i).period;
   } else {
     // convert nseconds to number of ticks
     ticks = (Bit64u) (double(nseconds) * m_ips / 1000.0);
@@ -553,7 +730,7 @@ void bx_pc_system_c::activate_timer_nsec(unsigned i, Bit64u nseconds, bx_bool co
       ticks = MinAllowableTimerPeriod;
     }
 
-    timer[i].period = ticks;
+    timer(i).period = ticks;
   }
 
   activate_timer_ticks(i, ticks, continuous);
@@ -568,7 +745,11 @@ void bx_pc_system_c::deactivate_timer(unsigned i)
     BX_PANIC(("deactivate_timer: timer 0 is the nullTimer!"));
 #endif
 
-  timer[i].active = 0;
+  BX_SMP_LOCK();
+  timer(i).active = 0;
+  if (timer(i).heapIndex >= 0)
+    heap_remove(i);
+  BX_SMP_UNLOCK();
 }
 
 bx_bool bx_pc_system_c::unregisterTimer(unsigned timerIndex)
@@ -578,23 +759,23 @@ bx_bool bx_pc_system_c::unregisterTimer(unsigned timerIndex)
     BX_PANIC(("unregisterTimer: timer %u OOB", timerIndex));
   if (timerIndex == 0)
     BX_PANIC(("unregisterTimer: timer 0 is the nullTimer!"));
-  if (timer[timerIndex].inUse == 0)
+  if (timer(timerIndex).inUse == 0)
     BX_PANIC(("unregisterTimer: timer %u is not in-use!", timerIndex));
 #endif
 
-  if (timer[timerIndex].active) {
-    BX_PANIC(("unregisterTimer: timer '%s' is still active!", timer[timerIndex].id));
+  if (timer(timerIndex).active) {
+    BX_PANIC(("unregisterTimer: timer '%s' is still active!", timer(timerIndex).id));
     return 0; // Fail.
   }
 
   // Reset timer fields for good measure.
-  timer[timerIndex].inUse      = 0; // No longer registered.
-  timer[timerIndex].period     = BX_MAX_BIT64S; // Max value (invalid)
-  timer[timerIndex].timeToFire = BX_MAX_BIT64S; // Max value (invalid)
-  timer[timerIndex].continuous = 0;
-  timer[timerIndex].funct      = NULL;
-  timer[timerIndex].this_ptr   = NULL;
-  memset(timer[timerIndex].id, 0, BxMaxTimerIDLen);
+  timer(timerIndex).inUse      = 0; // No longer registered.
+  timer(timerIndex).period     = BX_MAX_BIT64S; // Max value (invalid)
+  timer(timerIndex).timeToFire = BX_MAX_BIT64S; // Max value (invalid)
+  timer(timerIndex).continuous = 0;
+  timer(timerIndex).funct      = NULL;
+  timer(timerIndex).this_ptr   = NULL;
+  memset(timer(timerIndex).id, 0, BxMaxTimerIDLen);
 
   if (timerIndex == (numTimers - 1)) numTimers--;
 
@@ -607,7 +788,98 @@ void bx_pc_system_c::setTimerParam(unsigned timerIndex, Bit32u param)
   if (timerIndex >= numTimers)
     BX_PANIC(("setTimerParam: timer %u OOB", timerIndex));
 #endif
-  timer[timerIndex].param = param;
+  timer(timerIndex).param = param;
+}
+
+void bx_pc_system_c::alloc_timer_block(void)
+{
+  bx_timer_t **blocks = new bx_timer_t*[numTimerBlocks + 1];
+  unsigned *heap = new unsigned[(numTimerBlocks + 1) * BX_TIMER_BLOCK_SIZE];
+
+  if (numTimerBlocks > 0) {
+    memcpy(blocks, timerBlock, numTimerBlocks * sizeof(bx_timer_t*));
+    memcpy(heap, timerHeap, heapSize * sizeof(unsigned));
+    delete [] timerBlock;
+    delete [] timerHeap;
+  }
+
+  bx_timer_t *block = new bx_timer_t[BX_TIMER_BLOCK_SIZE];
+  memset(block, 0, BX_TIMER_BLOCK_SIZE * sizeof(bx_timer_t));
+  for (unsigned i = 0; i < BX_TIMER_BLOCK_SIZE; i++)
+    block[i].heapIndex = -1;
+
+  blocks[numTimerBlocks++] = block;
+  timerBlock = blocks;
+  timerHeap = heap;
+}
+
+void bx_pc_system_c::heap_sift_up(unsigned pos)
+{
+  unsigned i = timerHeap[pos];
+
+  while (pos > 0) {
+    unsigned parent = (pos - 1) / 2;
+    if (! timer_before(i, timerHeap[parent])) break;
+    timerHeap[pos] = timerHeap[parent];
+    timer(timerHeap[pos]).heapIndex = pos;
+    pos = parent;
+  }
+
+  timerHeap[pos] = i;
+  timer(i).heapIndex = pos;
+}
+
+void bx_pc_system_c::heap_sift_down(unsigned pos)
+{
+  unsigned i = timerHeap[pos];
+
+  for (;;) {
+    unsigned child = 2 * pos + 1;
+    if (child >= heapSize) break;
+    if (child + 1 < heapSize && timer_before(timerHeap[child + 1], timerHeap[child]))
+      child++;
+    if (! timer_before(timerHeap[child], i)) break;
+    timerHeap[pos] = timerHeap[child];
+    timer(timerHeap[pos]).heapIndex = pos;
+    pos = child;
+  }
+
+  timerHeap[pos] = i;
+  timer(i).heapIndex = pos;
+}
+
+void bx_pc_system_c::heap_insert(unsigned i)
+{
+  timerHeap[heapSize] = i;
+  heap_sift_up(heapSize++);
+}
+
+void bx_pc_system_c::heap_remove(unsigned i)
+{
+  unsigned pos = timer(i).heapIndex;
+  timer(i).heapIndex = -1;
+
+  if (pos != --heapSize) {
+    // move the last timer into the hole
+    unsigned last = timerHeap[heapSize];
+    timerHeap[pos] = last;
+    heap_sift_up(pos);
+    heap_sift_down(timer(last).heapIndex);
+  }
+}
+
+void bx_pc_system_c::heap_rebuild(void)
+{
+  unsigned i;
+
+  heapSize = 0;
+  for (i = 0; i < numTimerBlocks * BX_TIMER_BLOCK_SIZE; i++)
+    timer(i).heapIndex = -1;
+
+  for (i = 0; i < numTimers; i++) {
+    if (timer(i).active)
+      heap_insert(i);
+  }
 }
 
 void bx_pc_system_c::isa_bus_delay(void)
@@ -617,3 +889,31 @@ void bx_pc_system_c::isa_bus_delay(void)
     tickn((Bit32u)(m_ips * 2.0));
   }
 }
+
+void bx_pc_system_c::idle_tick(void)
+{
+  if (clock_sync == BX_CLOCK_SYNC_BOTH) {
+    // the slowdown timer already sleeps on the host; advance the emulated
+    // time in small steps so the real time timers can follow it
+    tickn(10);
+    return;
+  }
+
+#if BX_HAVE_REALTIME_USEC
+  if (clock_sync == BX_CLOCK_SYNC_REALTIME) {
+    Bit64u usec = bx_virt_timer.realtime_usec_left();
+    if (usec >= BX_IDLE_MIN_WAIT_USEC) {
+      if (usec > BX_IDLE_MAX_WAIT_USEC) usec = BX_IDLE_MAX_WAIT_USEC;
+      bx_wait_for_event_timeout(&idle_event, (Bit32u) usec);
+    }
+  }
+#endif
+
+  tickn(currCountdown);
+}
+
+void bx_pc_system_c::idle_wakeup(void)
+{
+  if (idle_event_created)
+    bx_set_event(&idle_event);
+}
@@ -23,7 +23,8 @@
 #ifndef BX_PCSYS_H
 #define BX_PCSYS_H
 
-#define BX_MAX_TIMERS 64
+// Timers are allocated in blocks, the number of timers is not limited
+#define BX_TIMER_BLOCK_SIZE 64
 #define BX_NULL_TIMER_HANDLE 10000
 
 typedef void (*bx_timer_handler_t)(void *);
@@ -41,7 +42,7 @@ private:
   // Timer oriented private features
   // ===============================
 
-  struct {
+  struct bx_timer_t {
     bx_bool inUse;      // Timer slot is in-use (currently registered).
     Bit64u  period;     // Timer periodocity in cpu ticks.
     Bit64u  timeToFire; // Time to fire next (in absolute ticks).
@@ -54,7 +55,33 @@ private:
 #define BxMaxTimerIDLen 32
     char id[BxMaxTimerIDLen];  // String ID of timer.
     Bit32u param;              // Device-specific value assigned to timer (optional)
-  } timer[BX_MAX_TIMERS];
+    int heapIndex;             // Position in the timer heap, -1 if not queued.
+  };
+
+  // Timer slots are allocated in blocks of BX_TIMER_BLOCK_SIZE entries.
+  // The blocks never move, the save/restore parameters point into them.
+  bx_timer_t **timerBlock;
+  unsigned   numTimerBlocks;
+
+  BX_CPP_INLINE bx_timer_t& timer(unsigned i) {
+    return timerBlock[i / BX_TIMER_BLOCK_SIZE][i % BX_TIMER_BLOCK_SIZE];
+  }
+
+  // Binary min-heap of the active timers ordered by time to fire, the
+  // next timer to fire is always timerHeap[0].
+  unsigned  *timerHeap;
+  unsigned   heapSize;
+
+  BX_CPP_INLINE bx_bool timer_before(unsigned a, unsigned b) {
+    return (timer(a).timeToFire < timer(b).timeToFire) ||
+           (timer(a).timeToFire == timer(b).timeToFire && a < b);
+  }
+  void   heap_sift_up(unsigned pos);
+  void   heap_sift_down(unsigned pos);
+  void   heap_insert(unsigned i);
+  void   heap_remove(unsigned i);
+  void   heap_rebuild(void);
+  void   alloc_timer_block(void);
 
   unsigned   numTimers;  // Number of currently allocated timers.
   unsigned   triggeredTimer;  // ID of the actually triggered timer.
@@ -101,7 +128,7 @@ public:
     return triggeredTimer;
   }
   Bit32u triggeredTimerParam(void) {
-    return timer[triggeredTimer].param;
+    return timer(triggeredTimer).param;
   }
   static BX_CPP_INLINE void tick1(void) {
     if (--bx_pc_system.currCountdown == 0) {
@@ -135,6 +162,13 @@ public:
   static BX_CPP_INLINE Bit32u  getNumCpuTicksLeftNextEvent(void) {
     return bx_pc_system.currCountdown;
   }
+
+  // Called by the halted CPU instead of executing instructions: skips
+  // directly to the next timer event. With real time synchronization waits
+  // on the host first until the next real time timer is due or idle_wakeup()
+  // is called from another host thread.
+  void   idle_tick(void);
+  void   idle_wakeup(void);
 #if BX_DEBUGGER
   static void timebp_handler(void* this_ptr);
 #endif
@@ -142,6 +176,8 @@ public:
 #if BX_ENABLE_STATISTICS
   static void dumpStatsTimer(void* this_ptr);
 #endif
+  static void checkpointTimer(void* this_ptr);
+  void   save_checkpoint(void);
   void isa_bus_delay(void);
 
   // ===========================
@@ -150,6 +186,8 @@ public:
 
   bx_bool HRQ;     // Hold Request
 
+  unsigned clock_sync; // clock synchronization mode (BX_CLOCK_SYNC_*)
+
   // Address line 20 control:
   //   1 = enabled: extended memory is accessible
   //   0 = disabled: A20 address line is forced low to simulate
@@ -166,6 +204,7 @@ public:
   bx_phy_address a20_mask;
 
   volatile bx_bool kill_bochs_request;
+  bx_bool checkpoint_request; // save checkpoint at the next instruction boundary
 
   void set_HRQ(bx_bool val);  // set the Hold ReQuest line
 
@@ -186,6 +225,7 @@ public:
   void    invlpg(bx_address addr);    // flush TLB page in all CPUs
   void    exit(void);
   void    register_state(void);
+  void    after_restore_state(void);
 };
 
 #endif